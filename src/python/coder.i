@@ -21,63 +21,79 @@
 //   polygon.Encode(enc)
 //   data = enc.buffer()
 //
+// Decoder also accepts a memoryview or mmap (e.g. of a large encoded
+// EncodedS2ShapeIndex), which is used in place, and Encoder.view() returns
+// the encoded data as a memoryview without copying it.
+//
 
 %{
 #include "s2/util/coding/coder.h"
+
+// Sets "data" and "size" to the contiguous buffer exported by "obj" (e.g.
+// bytes, bytearray, memoryview or mmap) without copying it.  Sets a Python
+// exception and returns false if "obj" does not support the buffer protocol
+// (or is not writable, if "writable" is true).
+//
+// The buffer is released before returning, so the caller must keep it
+// alive and pinned by other means.  The Python wrappers below do this by
+// holding a memoryview of "obj", which also prevents an mmap from being
+// closed or resized while it is in use.
+static bool GetPinnedBuffer(PyObject *obj, bool writable, void **data,
+                            size_t *size) {
+  Py_buffer view;
+  if (PyObject_GetBuffer(obj, &view,
+                         writable ? PyBUF_WRITABLE : PyBUF_SIMPLE) != 0) {
+    return false;
+  }
+  *data = view.buf;
+  *size = view.len;
+  PyBuffer_Release(&view);
+  return true;
+}
 %}
 
-// For Decoder::reset to accept a bytes or bytearray object.
+// For Decoder::reset to accept any object that supports the buffer protocol.
 %typemap(in) (const void* buf, size_t maxn) {
-  if (PyBytes_Check($input)) {
-    $1 = (void *) PyBytes_AsString($input);
-    $2 = PyBytes_Size($input);
-  } else if (PyByteArray_Check($input)) {
-    $1 = (void *) PyByteArray_AsString($input);
-    $2 = PyByteArray_Size($input);
-  } else {
-    PyErr_Format(PyExc_TypeError,
-                 "bytes or bytearray needed, %s found",
-                 $input->ob_type->tp_name);
-    return nullptr;
-  }
+  void *data;
+  if (!GetPinnedBuffer($input, false, &data, &$2)) return nullptr;
+  $1 = data;
 };
-// For Encoder::reset to accept a bytearray object.
+// For Encoder::reset to accept any writable buffer (e.g. a bytearray).
 %typemap(in) (void* buf, size_t maxn) {
-  if (PyByteArray_Check($input)) {
-    $1 = (void *) PyByteArray_AsString($input);
-    $2 = PyByteArray_Size($input);
-  } else {
-    PyErr_Format(PyExc_TypeError,
-                 "bytearray needed, %s found", $input->ob_type->tp_name);
-    return nullptr;
-  }
+  if (!GetPinnedBuffer($input, true, &$1, &$2)) return nullptr;
 };
 
-// Keep a reference to the object so that outside users don't
-// have to keep one, or else it could be released.
+// Keep a memoryview of the buffer so that outside users don't have to keep
+// a reference to it, or else it could be released (or, for an mmap, closed).
 // The auto-generated code passes *args to each of the methods, but the use
 // cases we support is only when a single arg is passed in.
 %pythonprepend Decoder::Decoder %{
   if len(args) == 1:
-    self._data_keepalive = args[0]
+    self._data_keepalive = memoryview(args[0])
 %}
 
 %pythonprepend Decoder::reset %{
-  self._data_keepalive = args[0]
+  self._data_keepalive = memoryview(args[0])
+%}
+
+%pythonprepend Encoder::Encoder %{
+  if len(args) == 1:
+    self._data_keepalive = memoryview(args[0])
+%}
+
+%pythonprepend Encoder::reset %{
+  self._data_keepalive = memoryview(args[0])
 %}
 
 %extend Decoder {
-  // Allows direct construction with a bytes or bytearray objects.
+  // Allows direct construction from any object that supports the buffer
+  // protocol (bytes, bytearray, memoryview, mmap, ...).  The data is not
+  // copied.
   Decoder(PyObject *obj) {
-    if (PyBytes_Check(obj)) {
-      return new Decoder(PyBytes_AsString(obj), PyBytes_Size(obj));
-    }
-    if (PyByteArray_Check(obj)) {
-      return new Decoder(PyByteArray_AsString(obj), PyByteArray_Size(obj));
-    }
-    PyErr_Format(PyExc_TypeError,
-                 "bytes or bytearray needed, %s found", obj->ob_type->tp_name);
-    return nullptr;
+    void *data;
+    size_t size;
+    if (!GetPinnedBuffer(obj, false, &data, &size)) return nullptr;
+    return new Decoder(data, size);
   }
 }
 
@@ -86,6 +102,14 @@
   PyObject* buffer() {
     return PyByteArray_FromStringAndSize($self->base(), $self->length());
   }
+
+  // Returns a read-only memoryview of the encoded data without copying it.
+  // The view is only valid until the Encoder is modified or destroyed, so
+  // it should not outlive the Encoder.
+  PyObject* view() {
+    return PyMemoryView_FromMemory(const_cast<char*>($self->base()),
+                                   $self->length(), PyBUF_READ);
+  }
 }
 
 %ignoreall
@@ -110,6 +134,7 @@
 %unignore Encoder::Ensure(size_t);
 %unignore Encoder::avail() const;
 %unignore Encoder::buffer();
+%unignore Encoder::view();
 %unignore Encoder::clear();
 %unignore Encoder::length() const;
 %unignore Encoder::put8(unsigned char);
@@ -4,6 +4,8 @@
 // open source releases of s2.
 
 %{
+#include <cstdint>
+#include <cstring>
 #include <sstream>
 #include <string>
 
@@ -12,6 +14,7 @@
 #include "s2/s2builder.h"
 #include "s2/s2builder_layer.h"
 #include "s2/s2builderutil_s2polygon_layer.h"
+#include "s2/encoded_s2shape_index.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2region.h"
 #include "s2/s2cap.h"
@@ -30,7 +33,9 @@
 #include "s2/s2region_term_indexer.h"
 #include "s2/s2cell.h"
 #include "s2/s2cell_union.h"
+#include "s2/s2contains_point_query.h"
 #include "s2/s2shape_index.h"
+#include "s2/s2shapeutil_coding.h"
 #include "s2/mutable_s2shape_index.h"
 
 // Wrapper for S2BufferOperation::Options to work around the inability
@@ -121,6 +126,36 @@ public:
     SWIG_exception(SWIG_ValueError, $1->text().c_str());
 }
 
+// Release the GIL while long-running operations execute, so that Python
+// threads can run them in parallel.  This is only done for methods that
+// neither call back into Python nor touch Python objects: their arguments
+// and outputs (e.g. the S2Polygon of an S2PolygonLayer) are plain C++
+// objects.  As with any C++ object, the caller must ensure that these are
+// not modified by other threads while the call is in progress; for example
+// an S2Polygon must not be used as the output of two concurrent
+// operations.  The calls below are safe in this sense:
+//
+//   S2BooleanOperation::Build      S2BufferOperation::Build
+//   S2Builder::Build               MutableS2ShapeIndex::ForceBuild
+//   S2RegionCoverer::GetCovering   S2RegionCoverer::GetInteriorCovering
+//
+// Output typemaps (e.g. for S2Error or std::vector<S2CellId>) run after the
+// GIL has been reacquired.
+%define RELEASE_GIL(method)
+%exception method {
+  Py_BEGIN_ALLOW_THREADS
+  $action
+  Py_END_ALLOW_THREADS
+}
+%enddef
+
+RELEASE_GIL(S2BooleanOperation::Build)
+RELEASE_GIL(S2BufferOperation::Build)
+RELEASE_GIL(S2Builder::Build)
+RELEASE_GIL(MutableS2ShapeIndex::ForceBuild)
+RELEASE_GIL(S2RegionCoverer::GetCovering)
+RELEASE_GIL(S2RegionCoverer::GetInteriorCovering)
+
 // This overload shadows the one the takes vector<uint64>&, and it
 // does not work anyway.
 %ignore S2CellUnion::Init(std::vector<S2CellId> const& cell_ids);
@@ -215,6 +250,255 @@ std::vector<S2Polyline *> *out(std::vector<S2Polyline *> temp) {
   }
 %}
 
+// Array-level functions that operate on NumPy arrays (or any other object
+// that supports the buffer protocol) without creating a proxy object per
+// element.  The functions below fill caller-allocated output arrays and
+// release the GIL while they run; the Python wrappers at the end of this
+// file (S2CellIdsFromLatLngDegrees etc.) allocate the outputs.
+%{
+// A C-contiguous buffer obtained through the buffer protocol, viewed as a
+// flat array.
+class ArrayBuffer {
+ public:
+  ArrayBuffer() = default;
+  ~ArrayBuffer() {
+    if (acquired_) PyBuffer_Release(&view_);
+  }
+  ArrayBuffer(const ArrayBuffer&) = delete;
+  ArrayBuffer& operator=(const ArrayBuffer&) = delete;
+
+  // Acquires the buffer of "obj", whose elements must have the given size
+  // and one of the given struct module format codes (in native byte
+  // order).  Otherwise sets a Python exception and returns false.
+  bool Init(PyObject *obj, const char *name, Py_ssize_t itemsize,
+            const char *formats, bool writable) {
+    int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT;
+    if (writable) flags |= PyBUF_WRITABLE;
+    if (PyObject_GetBuffer(obj, &view_, flags) != 0) return false;
+    acquired_ = true;
+    const char *format = view_.format != nullptr ? view_.format : "B";
+    if (*format == '@') ++format;
+    if (view_.itemsize != itemsize || format[0] == '\0' || format[1] != '\0' ||
+        std::strchr(formats, format[0]) == nullptr) {
+      PyErr_Format(PyExc_TypeError, "%s: unsupported element type '%s'",
+                   name, view_.format != nullptr ? view_.format : "B");
+      return false;
+    }
+    return true;
+  }
+
+  Py_ssize_t size() const { return view_.len / view_.itemsize; }
+
+  template <class T>
+  T *data() const { return static_cast<T *>(view_.buf); }
+
+ private:
+  bool acquired_ = false;
+  Py_buffer view_;
+};
+
+// Element types used by the array functions.  The format codes for 64-bit
+// and 32-bit integers depend on the platform.
+static bool InitDoubleArray(ArrayBuffer *a, PyObject *obj, const char *name,
+                            bool writable = false) {
+  return a->Init(obj, name, sizeof(double), "d", writable);
+}
+
+static bool InitUint64Array(ArrayBuffer *a, PyObject *obj, const char *name,
+                            bool writable = false) {
+  return a->Init(obj, name, sizeof(uint64_t), "LQ", writable);
+}
+
+static bool InitInt32Array(ArrayBuffer *a, PyObject *obj, const char *name) {
+  return a->Init(obj, name, sizeof(int32_t), "il", true);
+}
+
+static bool InitBoolArray(ArrayBuffer *a, PyObject *obj, const char *name) {
+  return a->Init(obj, name, sizeof(bool), "?", true);
+}
+
+static bool CheckSameSize(const ArrayBuffer &a, const ArrayBuffer &b) {
+  if (a.size() == b.size()) return true;
+  PyErr_Format(PyExc_ValueError, "array sizes differ (%zd vs. %zd)",
+               a.size(), b.size());
+  return false;
+}
+
+// Returns a null PyObject after setting a ValueError that describes the
+// invalid element at "index", or None if "index" is negative.
+static PyObject *ArrayResult(Py_ssize_t index, const char *what) {
+  if (index >= 0) {
+    PyErr_Format(PyExc_ValueError, "%s at index %zd", what, index);
+    return nullptr;
+  }
+  Py_RETURN_NONE;
+}
+%}
+
+%inline %{
+  // Sets out[i] to the id of the cell at "level" that contains the point
+  // (lats[i], lngs[i]), given in degrees.
+  static PyObject *S2CellIdArray_FromLatLngDegrees(PyObject *lats,
+                                                   PyObject *lngs, int level,
+                                                   PyObject *out) {
+    ArrayBuffer lat_buf, lng_buf, out_buf;
+    if (!InitDoubleArray(&lat_buf, lats, "lats") ||
+        !InitDoubleArray(&lng_buf, lngs, "lngs") ||
+        !InitUint64Array(&out_buf, out, "out", true) ||
+        !CheckSameSize(lat_buf, lng_buf) || !CheckSameSize(lat_buf, out_buf)) {
+      return nullptr;
+    }
+    if (level < 0 || level > S2CellId::kMaxLevel) {
+      PyErr_Format(PyExc_ValueError, "invalid level %d", level);
+      return nullptr;
+    }
+    const double *lat = lat_buf.data<double>();
+    const double *lng = lng_buf.data<double>();
+    uint64_t *ids = out_buf.data<uint64_t>();
+    Py_ssize_t bad = -1;
+    Py_BEGIN_ALLOW_THREADS
+    for (Py_ssize_t i = 0; i < lat_buf.size(); ++i) {
+      S2LatLng ll = S2LatLng::FromDegrees(lat[i], lng[i]);
+      if (!ll.is_valid()) {
+        bad = i;
+        break;
+      }
+      ids[i] = S2CellId(ll).parent(level).id();
+    }
+    Py_END_ALLOW_THREADS
+    return ArrayResult(bad, "invalid latitude/longitude");
+  }
+
+  // Sets (lats[i], lngs[i]) to the center of cell ids[i], in degrees.
+  static PyObject *S2CellIdArray_ToLatLngDegrees(PyObject *ids,
+                                                 PyObject *lats,
+                                                 PyObject *lngs) {
+    ArrayBuffer id_buf, lat_buf, lng_buf;
+    if (!InitUint64Array(&id_buf, ids, "ids") ||
+        !InitDoubleArray(&lat_buf, lats, "lats", true) ||
+        !InitDoubleArray(&lng_buf, lngs, "lngs", true) ||
+        !CheckSameSize(id_buf, lat_buf) || !CheckSameSize(id_buf, lng_buf)) {
+      return nullptr;
+    }
+    const uint64_t *id = id_buf.data<uint64_t>();
+    double *lat = lat_buf.data<double>();
+    double *lng = lng_buf.data<double>();
+    Py_ssize_t bad = -1;
+    Py_BEGIN_ALLOW_THREADS
+    for (Py_ssize_t i = 0; i < id_buf.size(); ++i) {
+      S2CellId cell_id(id[i]);
+      if (!cell_id.is_valid()) {
+        bad = i;
+        break;
+      }
+      S2LatLng ll = cell_id.ToLatLng();
+      lat[i] = ll.lat().degrees();
+      lng[i] = ll.lng().degrees();
+    }
+    Py_END_ALLOW_THREADS
+    return ArrayResult(bad, "invalid S2CellId");
+  }
+
+  // Sets out[i] to the ancestor of ids[i] at "level".
+  static PyObject *S2CellIdArray_Parent(PyObject *ids, int level,
+                                        PyObject *out) {
+    ArrayBuffer id_buf, out_buf;
+    if (!InitUint64Array(&id_buf, ids, "ids") ||
+        !InitUint64Array(&out_buf, out, "out", true) ||
+        !CheckSameSize(id_buf, out_buf)) {
+      return nullptr;
+    }
+    const uint64_t *id = id_buf.data<uint64_t>();
+    uint64_t *parent = out_buf.data<uint64_t>();
+    Py_ssize_t bad = -1;
+    Py_BEGIN_ALLOW_THREADS
+    for (Py_ssize_t i = 0; i < id_buf.size(); ++i) {
+      S2CellId cell_id(id[i]);
+      if (!cell_id.is_valid() || level < 0 || level > cell_id.level()) {
+        bad = i;
+        break;
+      }
+      parent[i] = cell_id.parent(level).id();
+    }
+    Py_END_ALLOW_THREADS
+    return ArrayResult(bad, "invalid S2CellId or parent level");
+  }
+
+  // Sets out[i] to the level of ids[i].
+  static PyObject *S2CellIdArray_Level(PyObject *ids, PyObject *out) {
+    ArrayBuffer id_buf, out_buf;
+    if (!InitUint64Array(&id_buf, ids, "ids") ||
+        !InitInt32Array(&out_buf, out, "out") ||
+        !CheckSameSize(id_buf, out_buf)) {
+      return nullptr;
+    }
+    const uint64_t *id = id_buf.data<uint64_t>();
+    int32_t *level = out_buf.data<int32_t>();
+    Py_ssize_t bad = -1;
+    Py_BEGIN_ALLOW_THREADS
+    for (Py_ssize_t i = 0; i < id_buf.size(); ++i) {
+      S2CellId cell_id(id[i]);
+      if (!cell_id.is_valid()) {
+        bad = i;
+        break;
+      }
+      level[i] = cell_id.level();
+    }
+    Py_END_ALLOW_THREADS
+    return ArrayResult(bad, "invalid S2CellId");
+  }
+
+  // Returns a list containing the token of each element of "ids".
+  static PyObject *S2CellIdArray_ToToken(PyObject *ids) {
+    ArrayBuffer id_buf;
+    if (!InitUint64Array(&id_buf, ids, "ids")) return nullptr;
+    const uint64_t *id = id_buf.data<uint64_t>();
+    PyObject *result = PyList_New(id_buf.size());
+    if (result == nullptr) return nullptr;
+    for (Py_ssize_t i = 0; i < id_buf.size(); ++i) {
+      const std::string token = S2CellId(id[i]).ToToken();
+      PyObject *const o = PyUnicode_FromStringAndSize(token.data(),
+                                                     token.size());
+      if (o == nullptr) {
+        Py_DECREF(result);
+        return nullptr;
+      }
+      PyList_SET_ITEM(result, i, o);
+    }
+    return result;
+  }
+
+  // Sets out[i] to true if any shape of "index" contains the point
+  // (lats[i], lngs[i]), given in degrees.  Uses the SEMI_OPEN vertex model.
+  static PyObject *S2ShapeIndexArray_ContainsLatLngDegrees(
+      const S2ShapeIndex &index, PyObject *lats, PyObject *lngs,
+      PyObject *out) {
+    ArrayBuffer lat_buf, lng_buf, out_buf;
+    if (!InitDoubleArray(&lat_buf, lats, "lats") ||
+        !InitDoubleArray(&lng_buf, lngs, "lngs") ||
+        !InitBoolArray(&out_buf, out, "out") ||
+        !CheckSameSize(lat_buf, lng_buf) || !CheckSameSize(lat_buf, out_buf)) {
+      return nullptr;
+    }
+    const double *lat = lat_buf.data<double>();
+    const double *lng = lng_buf.data<double>();
+    bool *contains = out_buf.data<bool>();
+    Py_ssize_t bad = -1;
+    Py_BEGIN_ALLOW_THREADS
+    auto query = MakeS2ContainsPointQuery(&index);
+    for (Py_ssize_t i = 0; i < lat_buf.size(); ++i) {
+      S2LatLng ll = S2LatLng::FromDegrees(lat[i], lng[i]);
+      if (!ll.is_valid()) {
+        bad = i;
+        break;
+      }
+      contains[i] = query.Contains(ll.ToPoint());
+    }
+    Py_END_ALLOW_THREADS
+    return ArrayResult(bad, "invalid latitude/longitude");
+  }
+%}
+
 // We provide our own definition of S2Point, because the real one is too
 // difficult to wrap correctly.
 class S2Point {
@@ -334,6 +618,40 @@ public:
     auto polygon = std::unique_ptr<S2Polygon>(polygon_disown);
     $self->Add(std::unique_ptr<S2Shape>(new S2Polygon::OwningShape(std::move(polygon))));
   }
+
+  // Encodes the shapes followed by the index, in the format expected by
+  // EncodedS2ShapeIndex.Init().  Returns false if a shape could not be
+  // encoded.
+  bool EncodeWithTaggedShapes(Encoder* encoder) {
+    if (!s2shapeutil::CompactEncodeTaggedShapes(*$self, encoder)) {
+      return false;
+    }
+    $self->Encode(encoder);
+    return true;
+  }
+}
+
+// EncodedS2ShapeIndex decodes shapes and cells on demand, directly from
+// the Decoder's data.  Combined with a Decoder over an mmap, this allows
+// large indexes to be used without reading them into memory first:
+//
+//   with open(path, "rb") as f:
+//     data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+//   index = s2.EncodedS2ShapeIndex()
+//   if not index.Init(s2.Decoder(data)): ...
+//
+// The index keeps a reference to the Decoder (and hence its data).
+%pythonprepend EncodedS2ShapeIndex::Init %{
+  self._decoder_keepalive = args[0]
+%}
+
+%extend EncodedS2ShapeIndex {
+ public:
+  // Initializes the index from data written by
+  // MutableS2ShapeIndex.EncodeWithTaggedShapes(), returning true on success.
+  bool Init(Decoder* decoder) {
+    return $self->Init(decoder, s2shapeutil::LazyDecodeShapeFactory(decoder));
+  }
 }
 
 %extend S2BooleanOperation {
@@ -511,9 +829,17 @@ public:
 
 %ignoreall
 
+%unignore EncodedS2ShapeIndex;
+%unignore EncodedS2ShapeIndex::EncodedS2ShapeIndex();
+%unignore EncodedS2ShapeIndex::~EncodedS2ShapeIndex;
+%unignore EncodedS2ShapeIndex::Init(Decoder*);
+%unignore EncodedS2ShapeIndex::Minimize;
+%unignore EncodedS2ShapeIndex::num_shape_ids;
 %unignore MutableS2ShapeIndex;
 %unignore MutableS2ShapeIndex::~MutableS2ShapeIndex;
 %unignore MutableS2ShapeIndex::Add(S2Shape*);
+%unignore MutableS2ShapeIndex::ForceBuild;
+%unignore MutableS2ShapeIndex::EncodeWithTaggedShapes(Encoder*);
 %unignore R1Interval;
 %ignore R1Interval::operator[];
 %unignore R1Interval::GetLength;
@@ -916,6 +1242,7 @@ public:
 %include "s2/s2cell_union.h"
 %include "s2/s2shape_index.h"
 %include "s2/mutable_s2shape_index.h"
+%include "s2/encoded_s2shape_index.h"
 
 %unignoreall
 
@@ -1007,6 +1334,72 @@ USE_EQUALS_FN_FOR_EQ_AND_NE(S2Loop)
 USE_EQUALS_FN_FOR_EQ_AND_NE(S2Polygon)
 USE_EQUALS_FN_FOR_EQ_AND_NE(S2Polyline)
 
+%pythoncode %{
+# NumPy wrappers for the array-level functions defined above.  NumPy is
+# imported lazily so that it is only required by clients that use them.
+def _AsArray(values, dtype):
+  import numpy as np
+  return np.ascontiguousarray(values, dtype=dtype)
+
+def S2CellIdsFromLatLngDegrees(lats, lngs, level=30):
+  """
+  Return a uint64 array of the ids of the cells at the given level that
+  contain the given points (in degrees).
+  """
+  import numpy as np
+  lats = _AsArray(lats, np.float64)
+  lngs = _AsArray(lngs, np.float64)
+  out = np.empty(lats.shape, dtype=np.uint64)
+  S2CellIdArray_FromLatLngDegrees(lats, lngs, level, out)
+  return out
+
+def S2CellIdsToLatLngDegrees(ids):
+  """ Return (lats, lngs) arrays of the cell centers, in degrees. """
+  import numpy as np
+  ids = _AsArray(ids, np.uint64)
+  lats = np.empty(ids.shape, dtype=np.float64)
+  lngs = np.empty(ids.shape, dtype=np.float64)
+  S2CellIdArray_ToLatLngDegrees(ids, lats, lngs)
+  return lats, lngs
+
+def S2CellIdsParent(ids, level):
+  """ Return a uint64 array of the ancestors of the given cells at level. """
+  import numpy as np
+  ids = _AsArray(ids, np.uint64)
+  out = np.empty(ids.shape, dtype=np.uint64)
+  S2CellIdArray_Parent(ids, level, out)
+  return out
+
+def S2CellIdsLevel(ids):
+  """ Return an int32 array of the levels of the given cells. """
+  import numpy as np
+  ids = _AsArray(ids, np.uint64)
+  out = np.empty(ids.shape, dtype=np.int32)
+  S2CellIdArray_Level(ids, out)
+  return out
+
+def S2CellIdsToToken(ids):
+  """ Return an object array of the tokens of the given cells. """
+  import numpy as np
+  ids = _AsArray(ids, np.uint64)
+  tokens = np.empty(ids.size, dtype=object)
+  tokens[:] = S2CellIdArray_ToToken(ids)
+  return tokens.reshape(ids.shape)
+
+def S2ShapeIndexContainsLatLngDegrees(index, lats, lngs):
+  """
+  Return a bool array indicating whether any shape of the given
+  MutableS2ShapeIndex or EncodedS2ShapeIndex contains each point (in
+  degrees).
+  """
+  import numpy as np
+  lats = _AsArray(lats, np.float64)
+  lngs = _AsArray(lngs, np.float64)
+  out = np.empty(lats.shape, dtype=np.bool_)
+  S2ShapeIndexArray_ContainsLatLngDegrees(index, lats, lngs, out)
+  return out
+%}
+
 // Simple implementation of key S2Testing methods
 %pythoncode %{
 import random
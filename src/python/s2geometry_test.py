@@ -14,11 +14,19 @@
 # limitations under the License.
 #
 
+import mmap
+import tempfile
 import unittest
 from collections import defaultdict
+from concurrent import futures
 
 import s2geometry as s2
 
+try:
+  import numpy as np
+except ImportError:
+  np = None
+
 
 class PyWrapS2TestCase(unittest.TestCase):
 
@@ -501,6 +509,47 @@ class PyWrapS2TestCase(unittest.TestCase):
     self.assertEqual(decoded_polygon.num_loops(), 1)
     self.assertTrue(decoded_polygon.Equals(polygon))
 
+  def testDecodeFromMemoryview(self):
+    london = s2.S2LatLng.FromDegrees(51.5001525, -0.1262355)
+    polygon = s2.S2Polygon(s2.S2Cell(s2.S2CellId(london).parent(15)))
+    encoder = s2.Encoder()
+    polygon.Encode(encoder)
+    view = encoder.view()
+    self.assertIsInstance(view, memoryview)
+    self.assertEqual(bytes(encoder.buffer()), view.tobytes())
+
+    # Decoding from a memoryview (here of a larger buffer) does not copy.
+    data = b"xx" + view.tobytes()
+    decoder = s2.Decoder(memoryview(data)[2:])
+    decoded_polygon = s2.S2Polygon()
+    self.assertTrue(decoded_polygon.Decode(decoder))
+    self.assertTrue(decoded_polygon.Equals(polygon))
+
+  def testEncodedS2ShapeIndexFromMmap(self):
+    index = s2.MutableS2ShapeIndex()
+    cell_id = s2.S2CellId(s2.S2LatLng.FromDegrees(3.0, 4.0)).parent(8)
+    index.Add(s2.S2Polygon(s2.S2Cell(cell_id)))
+    encoder = s2.Encoder()
+    self.assertTrue(index.EncodeWithTaggedShapes(encoder))
+
+    with tempfile.TemporaryFile() as f:
+      f.write(encoder.view())
+      f.flush()
+      data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+      encoded_index = s2.EncodedS2ShapeIndex()
+      self.assertTrue(encoded_index.Init(s2.Decoder(data)))
+      self.assertEqual(1, encoded_index.num_shape_ids())
+
+      poly = s2.S2Polygon()
+      op = s2.S2BooleanOperation(s2.S2BooleanOperation.OpType_UNION,
+                                 s2.S2PolygonLayer(poly))
+      op.Build(encoded_index, s2.MutableS2ShapeIndex())
+      self.assertTrue(poly.Equals(s2.S2Polygon(s2.S2Cell(cell_id))))
+
+      # The mmap cannot be closed while the index refers to it.
+      del encoded_index
+      data.close()
+
   def testS2CapRegion(self):
     center = s2.S2LatLng.FromDegrees(2.0, 3.0).ToPoint()
     cap = s2.S2Cap(center, s2.S1Angle.Degrees(1.0))
@@ -1152,6 +1201,26 @@ class S2BooleanOperationTest(unittest.TestCase):
     loop = result.loop(0)
     self.assertEqual(4, loop.num_vertices())
 
+  def testBuildFromThreads(self):
+    # Build releases the GIL; operations on distinct objects may run
+    # concurrently.
+    def union(lat):
+      index1 = s2.MutableS2ShapeIndex()
+      index2 = s2.MutableS2ShapeIndex()
+      for i, index in enumerate([index1, index2]):
+        cell_id = s2.S2CellId(s2.S2LatLng.FromDegrees(lat + 10 * i, 4.0))
+        index.Add(s2.S2Polygon(s2.S2Cell(cell_id.parent(8))))
+        index.ForceBuild()
+      poly = s2.S2Polygon()
+      op = s2.S2BooleanOperation(s2.S2BooleanOperation.OpType_UNION,
+                                 s2.S2PolygonLayer(poly))
+      op.Build(index1, index2)
+      return poly.num_loops()
+
+    with futures.ThreadPoolExecutor(max_workers=4) as executor:
+      results = list(executor.map(union, [float(i) for i in range(16)]))
+    self.assertEqual([2] * 16, results)
+
   def testUnionDistinct(self):
     cell1 = s2.S2Cell(s2.S2CellId(s2.S2LatLng.FromDegrees(3.0, 4.0)).parent(8))
     self.index1.Add(s2.S2Polygon(cell1))
@@ -1227,5 +1296,56 @@ class S2BuilderTest(unittest.TestCase):
     with self.assertRaises(ValueError):
       b.Build()
 
+@unittest.skipIf(np is None, "requires numpy")
+class S2ArrayFunctionsTest(unittest.TestCase):
+
+  def setUp(self):
+    self.lats = np.array([51.5213527, -33.8688, 3.0, 89.9])
+    self.lngs = np.array([-0.0476026, 151.2093, 4.0, -179.5])
+
+  def testCellIdsMatchScalarConversion(self):
+    ids = s2.S2CellIdsFromLatLngDegrees(self.lats, self.lngs, 12)
+    self.assertEqual(np.uint64, ids.dtype)
+    for i in range(len(ids)):
+      cell = s2.S2CellId(s2.S2LatLng.FromDegrees(self.lats[i], self.lngs[i]))
+      self.assertEqual(cell.parent(12).id(), ids[i])
+    self.assertEqual([12] * 4, list(s2.S2CellIdsLevel(ids)))
+    self.assertEqual([s2.S2CellId(int(i)).ToToken() for i in ids],
+                     list(s2.S2CellIdsToToken(ids)))
+    parents = s2.S2CellIdsParent(ids, 5)
+    self.assertEqual([s2.S2CellId(int(i)).parent(5).id() for i in ids],
+                     list(parents))
+
+  def testCellCentersRoundTrip(self):
+    ids = s2.S2CellIdsFromLatLngDegrees(self.lats, self.lngs)
+    lats, lngs = s2.S2CellIdsToLatLngDegrees(ids)
+    np.testing.assert_allclose(self.lats, lats, atol=1e-6)
+    np.testing.assert_allclose(self.lngs, lngs, atol=1e-6)
+
+  def testPreservesShape(self):
+    ids = s2.S2CellIdsFromLatLngDegrees(self.lats.reshape(2, 2),
+                                        self.lngs.reshape(2, 2), 10)
+    self.assertEqual((2, 2), ids.shape)
+    self.assertEqual((2, 2), s2.S2CellIdsToToken(ids).shape)
+
+  def testInvalidInput(self):
+    with self.assertRaises(ValueError):
+      s2.S2CellIdsFromLatLngDegrees([91.0], [0.0])
+    with self.assertRaises(ValueError):
+      s2.S2CellIdsFromLatLngDegrees([1.0, 2.0], [0.0])
+    with self.assertRaises(ValueError):
+      s2.S2CellIdsLevel([0])
+    ids = s2.S2CellIdsFromLatLngDegrees([1.0], [2.0], 5)
+    with self.assertRaises(ValueError):
+      s2.S2CellIdsParent(ids, 6)
+
+  def testShapeIndexContains(self):
+    index = s2.MutableS2ShapeIndex()
+    cell = s2.S2CellId(s2.S2LatLng.FromDegrees(3.0, 4.0)).parent(8)
+    index.Add(s2.S2Polygon(s2.S2Cell(cell)))
+    contains = s2.S2ShapeIndexContainsLatLngDegrees(index, self.lats,
+                                                     self.lngs)
+    self.assertEqual([False, False, True, False], list(contains))
+
 if __name__ == "__main__":
   unittest.main()
@@ -0,0 +1,177 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/base/executor.h"
+
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/log/absl_check.h"
+#include "absl/synchronization/mutex.h"
+
+using std::vector;
+
+namespace s2base {
+
+namespace {
+
+// The state shared between RunConcurrently() and the tasks that it
+// schedules.  It is reference counted because tasks may start after
+// RunConcurrently() has returned.
+struct RunState {
+  absl::Mutex mutex;
+  bool closed ABSL_GUARDED_BY(mutex) = false;
+  int num_running ABSL_GUARDED_BY(mutex) = 0;
+};
+
+// The pool and worker index of the current thread (if it is a worker).
+thread_local const WorkStealingThreadPool* current_pool = nullptr;
+thread_local int current_worker = -1;
+
+}  // namespace
+
+void RunConcurrently(Executor* executor, int num_threads,
+                     absl::FunctionRef<void()> fn) {
+  if (num_threads <= 1) {
+    fn();
+    return;
+  }
+  if (executor == nullptr) {
+    vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+    for (int i = 1; i < num_threads; ++i) threads.emplace_back(fn);
+    fn();
+    for (auto& thread : threads) thread.join();
+    return;
+  }
+  auto state = std::make_shared<RunState>();
+  for (int i = 1; i < num_threads; ++i) {
+    // "fn" is only called if RunConcurrently() has not finished yet, in
+    // which case the function that it refers to still exists.
+    executor->Schedule([state, fn]() {
+      {
+        absl::MutexLock lock(&state->mutex);
+        if (state->closed) return;
+        ++state->num_running;
+      }
+      fn();
+      absl::MutexLock lock(&state->mutex);
+      --state->num_running;
+    });
+  }
+  fn();
+  absl::MutexLock lock(&state->mutex);
+  state->closed = true;
+  state->mutex.Await(absl::Condition(
+      +[](RunState* s) ABSL_EXCLUSIVE_LOCKS_REQUIRED(s->mutex) {
+        return s->num_running == 0;
+      },
+      state.get()));
+}
+
+WorkStealingThreadPool::WorkStealingThreadPool(int num_threads) {
+  ABSL_DCHECK_GE(num_threads, 1);
+  workers_.reserve(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    workers_[i]->thread = std::thread([this, i]() { Run(i); });
+  }
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+  {
+    absl::MutexLock lock(&mutex_);
+    shutting_down_ = true;
+  }
+  for (auto& worker : workers_) worker->thread.join();
+}
+
+int WorkStealingThreadPool::CurrentWorker() const {
+  return current_pool == this ? current_worker : -1;
+}
+
+void WorkStealingThreadPool::Schedule(std::function<void()> task) {
+  int i = CurrentWorker();
+  if (i < 0) {
+    absl::MutexLock lock(&mutex_);
+    i = next_worker_;
+    next_worker_ = (next_worker_ + 1) % num_threads();
+  }
+  {
+    absl::MutexLock lock(&workers_[i]->mutex);
+    workers_[i]->tasks.push_back(std::move(task));
+  }
+  // The task is counted only after it has been queued, so that a worker
+  // that claims it (below) is guaranteed to find it.
+  absl::MutexLock lock(&mutex_);
+  ++num_queued_;
+}
+
+bool WorkStealingThreadPool::PopTask(int i, bool own,
+                                     std::function<void()>* task) {
+  Worker& worker = *workers_[i];
+  absl::MutexLock lock(&worker.mutex);
+  if (worker.tasks.empty()) return false;
+  if (own) {
+    *task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+  } else {
+    *task = std::move(worker.tasks.front());
+    worker.tasks.pop_front();
+  }
+  return true;
+}
+
+void WorkStealingThreadPool::Run(int i) {
+  current_pool = this;
+  current_worker = i;
+  const int n = num_threads();
+  for (;;) {
+    // Wait until there is a queued task (or the pool is shutting down and
+    // all tasks have been run), and claim it.
+    {
+      absl::MutexLock lock(&mutex_);
+      mutex_.Await(absl::Condition(
+          +[](WorkStealingThreadPool* pool)
+               ABSL_EXCLUSIVE_LOCKS_REQUIRED(pool->mutex_) {
+                 return pool->num_queued_ > 0 || pool->shutting_down_;
+               },
+          this));
+      if (num_queued_ == 0) return;
+      --num_queued_;
+    }
+    // Every claimed task corresponds to a task that is (or will shortly be)
+    // in some queue, so keep looking until one is found.  Look in our own
+    // queue first, then steal from the other workers.
+    std::function<void()> task;
+    while (!PopTask(i, true, &task)) {
+      bool found = false;
+      for (int j = 1; j < n && !found; ++j) {
+        found = PopTask((i + j) % n, false, &task);
+      }
+      if (found) break;
+      std::this_thread::yield();
+    }
+    task();
+  }
+}
+
+}  // namespace s2base
@@ -0,0 +1,114 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_BASE_EXECUTOR_H_
+#define S2_BASE_EXECUTOR_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/synchronization/mutex.h"
+
+namespace s2base {
+
+// An Executor runs tasks asynchronously.  S2 algorithms that support
+// multi-threading accept an optional Executor in their Options, which lets
+// clients run S2 work on their own thread pools (or fiber schedulers)
+// rather than having S2 create threads of its own.
+//
+// Implementations must be thread-safe.
+class Executor {
+ public:
+  virtual ~Executor() = default;
+
+  // Arranges for "task" to be called exactly once, on some thread, at some
+  // point in the future.  Tasks may be scheduled from within other tasks.
+  //
+  // Note that S2 never blocks waiting for a task to start (see
+  // RunConcurrently below), so it is fine for tasks to be delayed
+  // arbitrarily, e.g. because the executor is busy.
+  virtual void Schedule(std::function<void()> task) = 0;
+};
+
+// Calls "fn()" concurrently on up to "num_threads" threads, including the
+// calling thread, and returns once all the calls have returned.  If
+// "executor" is nullptr then new threads are created for this purpose;
+// otherwise the additional calls are scheduled on "executor".
+//
+// Each call to "fn" is expected to repeatedly claim work items (e.g., using
+// an atomic counter) until no work is left.  The calling thread always
+// calls "fn", so all the work is done even if none of the scheduled tasks
+// ever start.  Scheduled tasks that have not started by the time the
+// calling thread has finished do not call "fn" at all; this also means
+// that it is safe to call RunConcurrently() from within an executor task.
+void RunConcurrently(Executor* executor, int num_threads,
+                     absl::FunctionRef<void()> fn);
+
+// A thread pool with a fixed number of worker threads that uses work
+// stealing to balance the load.  Each worker has its own task queue.  Tasks
+// scheduled from a worker thread are added to that worker's queue and are
+// run in LIFO order (which tends to be cache-friendly for nested
+// parallelism), while idle workers steal the oldest tasks from other
+// queues.  Tasks scheduled from other threads are distributed round-robin.
+//
+// The destructor waits for all scheduled tasks to finish.
+class WorkStealingThreadPool final : public Executor {
+ public:
+  // REQUIRES: num_threads >= 1
+  explicit WorkStealingThreadPool(int num_threads);
+  ~WorkStealingThreadPool() override;
+
+  WorkStealingThreadPool(const WorkStealingThreadPool&) = delete;
+  WorkStealingThreadPool& operator=(const WorkStealingThreadPool&) = delete;
+
+  int num_threads() const { return static_cast<int>(workers_.size()); }
+
+  void Schedule(std::function<void()> task) override;
+
+ private:
+  struct Worker {
+    absl::Mutex mutex;
+    std::deque<std::function<void()>> tasks ABSL_GUARDED_BY(mutex);
+    std::thread thread;
+  };
+
+  // The main loop of worker "i".
+  void Run(int i);
+
+  // Removes a task from the queue of worker "i" (from the back if "own" is
+  // true, otherwise from the front) and returns true, or returns false if
+  // the queue is empty.
+  bool PopTask(int i, bool own, std::function<void()>* task);
+
+  // Returns the index of the worker of this pool that is running on the
+  // current thread, or -1 if the current thread is not one of them.
+  int CurrentWorker() const;
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  // The total number of queued tasks, used to put idle workers to sleep.
+  absl::Mutex mutex_;
+  int num_queued_ ABSL_GUARDED_BY(mutex_) = 0;
+  int next_worker_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool shutting_down_ ABSL_GUARDED_BY(mutex_) = false;
+};
+
+}  // namespace s2base
+
+#endif  // S2_BASE_EXECUTOR_H_
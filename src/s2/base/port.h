@@ -80,6 +80,19 @@
 
 // Alignment
 
+// Prefetch
+
+// Hints that the cache line containing "addr" will be read soon, so that it
+// can be loaded while other work is done.  This never faults, so "addr" may
+// be any address (including one that is not mapped).
+inline void S2Prefetch(const void* addr) {
+#if defined(__GNUC__)
+  __builtin_prefetch(addr, 0, 3);
+#else
+  (void)addr;
+#endif
+}
+
 // Unaligned APIs
 
 // Portable handling of unaligned loads, stores, and copies. These are simply
@@ -0,0 +1,391 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/composite_s2shape_index.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "s2/base/types.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/log/absl_check.h"
+#include "absl/synchronization/mutex.h"
+#include "s2/util/coding/coder.h"
+#include "s2/util/coding/varint.h"
+#include "s2/encoded_s2cell_id_vector.h"
+#include "s2/encoded_string_vector.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/r2.h"
+#include "s2/r2rect.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2edge_clipping.h"
+#include "s2/s2edge_crosser.h"
+#include "s2/s2point.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+// The contents of a clipped shape while a composite cell is being built.
+struct CompositeS2ShapeIndex::ClippedShapeData {
+  int shape_id;
+  bool contains_center;
+  vector<int> edges;
+};
+
+CompositeS2ShapeIndex::CompositeS2ShapeIndex(
+    vector<const S2ShapeIndex*> indexes) {
+  Init(std::move(indexes));
+}
+
+CompositeS2ShapeIndex::~CompositeS2ShapeIndex() = default;
+
+void CompositeS2ShapeIndex::Init(vector<const S2ShapeIndex*> indexes) {
+  Minimize();
+  indexes_ = std::move(indexes);
+  shape_id_offsets_.assign(1, 0);
+  for (const S2ShapeIndex* index : indexes_) {
+    shape_id_offsets_.push_back(shape_id_offsets_.back() +
+                                index->num_shape_ids());
+  }
+}
+
+int CompositeS2ShapeIndex::index_for_shape_id(int shape_id) const {
+  ABSL_DCHECK_GE(shape_id, 0);
+  ABSL_DCHECK_LT(shape_id, num_shape_ids());
+  // Indexes without shapes share their offset with the next index, so we
+  // find the last offset that is not greater than "shape_id".
+  return std::upper_bound(shape_id_offsets_.begin(), shape_id_offsets_.end(),
+                          shape_id) -
+         shape_id_offsets_.begin() - 1;
+}
+
+const S2Shape* CompositeS2ShapeIndex::shape(int id) const {
+  int i = index_for_shape_id(id);
+  return indexes_[i]->shape(id - shape_id_offsets_[i]);
+}
+
+void CompositeS2ShapeIndex::Encode(Encoder* encoder) const {
+  // This must match MutableS2ShapeIndex::Encode() exactly.
+  encoder->Ensure(Varint::kMax64);
+  uint64 max_edges = MutableS2ShapeIndex::Options().max_edges_per_cell();
+  encoder->put_varint64(max_edges << 2 |
+                        MutableS2ShapeIndex::kCurrentEncodingVersionNumber);
+  vector<S2CellId> cell_ids;
+  s2coding::StringVectorEncoder encoded_cells;
+  for (Iterator it(this, S2ShapeIndex::BEGIN); !it.done(); it.Next()) {
+    // Empty cells cannot be encoded, and they are equivalent to no cell.
+    const S2ShapeIndexCell& cell = it.cell();
+    if (cell.num_clipped() == 0) continue;
+    cell_ids.push_back(it.id());
+    cell.Encode(num_shape_ids(), encoded_cells.AddViaEncoder());
+  }
+  s2coding::EncodeS2CellIdVector(cell_ids, encoder);
+  encoded_cells.Encode(encoder);
+}
+
+size_t CompositeS2ShapeIndex::SpaceUsed() const {
+  size_t size = sizeof(*this);
+  size += indexes_.capacity() * sizeof(const S2ShapeIndex*);
+  size += shape_id_offsets_.capacity() * sizeof(int);
+  absl::MutexLock l(&lock_);
+  size += cells_.capacity() *
+          (sizeof(S2CellId) + sizeof(unique_ptr<S2ShapeIndexCell>));
+  for (const auto& [id, cell] : cells_) {
+    size += sizeof(S2ShapeIndexCell) +
+            cell->num_clipped() * sizeof(S2ClippedShape);
+    for (const S2ClippedShape& clipped : cell->clipped_shapes()) {
+      if (clipped.num_edges() > 2) size += clipped.num_edges() * sizeof(int32);
+    }
+  }
+  return size;
+}
+
+void CompositeS2ShapeIndex::Minimize() {
+  absl::MutexLock l(&lock_);
+  cells_.clear();
+}
+
+unique_ptr<S2ShapeIndex::IteratorBase> CompositeS2ShapeIndex::NewIterator(
+    InitialPosition pos) const {
+  return make_unique<Iterator>(this, pos);
+}
+
+const S2ShapeIndexCell& CompositeS2ShapeIndex::GetCell(
+    S2CellId id, vector<S2ShapeIndex::Iterator>* its) const {
+  // Find the cell of each index that contains "id" (if any).  By
+  // construction, "id" never contains a cell of any index.
+  int num_containing = 0, last_containing = -1;
+  for (int i = 0; i < num_indexes(); ++i) {
+    S2ShapeIndex::Iterator& it = (*its)[i];
+    if (it.Locate(id) == S2CellRelation::INDEXED) {
+      ++num_containing;
+      last_containing = i;
+    }
+  }
+  ABSL_DCHECK_GT(num_containing, 0);
+  // Cells of the first index can be used directly, since its shape ids are
+  // unchanged.
+  if (num_containing == 1 && last_containing == 0 && (*its)[0].id() == id) {
+    return (*its)[0].cell();
+  }
+  {
+    absl::MutexLock l(&lock_);
+    auto it = cells_.find(id);
+    if (it != cells_.end()) return *it->second;
+  }
+  // Build the cell without holding the lock, since this may be slow.  The
+  // clipped shapes are sorted because the shape ids of each index follow
+  // those of the previous indexes.
+  vector<ClippedShapeData> shapes;
+  for (int i = 0; i < num_indexes(); ++i) {
+    S2ShapeIndex::Iterator& it = (*its)[i];
+    if (it.id().contains(id)) {
+      AppendClippedShapes(i, it.id(), it.cell(), id, &shapes);
+    }
+  }
+  unique_ptr<S2ShapeIndexCell> cell = MakeCell(shapes);
+  absl::MutexLock l(&lock_);
+  // If another thread built the same cell first, its copy is kept.
+  return *cells_.try_emplace(id, std::move(cell)).first->second;
+}
+
+// Appends the portion of each clipped shape of "cell" that intersects the
+// descendant cell "id".  The edges are selected conservatively, i.e. an edge
+// may be included even if it is slightly farther than
+// MutableS2ShapeIndex::kCellPadding from "id".
+void CompositeS2ShapeIndex::AppendClippedShapes(
+    int i, S2CellId cell_id, const S2ShapeIndexCell& cell, S2CellId id,
+    vector<ClippedShapeData>* shapes) const {
+  const double padding =
+      MutableS2ShapeIndex::kCellPadding + S2::kIntersectsRectErrorUVDist;
+  const R2Rect bound = id.GetBoundUV().Expanded(padding);
+  const S2Point cell_center = cell_id.ToPoint();
+  const S2Point center = id.ToPoint();
+  for (const S2ClippedShape& clipped : cell.clipped_shapes()) {
+    ClippedShapeData data;
+    data.shape_id = clipped.shape_id() + shape_id_offsets_[i];
+    data.contains_center = clipped.contains_center();
+    if (cell_id == id) {
+      for (int j = 0; j < clipped.num_edges(); ++j) {
+        data.edges.push_back(clipped.edge(j));
+      }
+      shapes->push_back(std::move(data));
+      continue;
+    }
+    const S2Shape& shape = *indexes_[i]->shape(clipped.shape_id());
+    const bool has_interior = (shape.dimension() == 2);
+    S2EdgeCrosser crosser(&cell_center, &center);
+    for (int j = 0; j < clipped.num_edges(); ++j) {
+      int e = clipped.edge(j);
+      S2Shape::Edge edge = shape.edge(e);
+      R2Point a_uv, b_uv;
+      if (S2::ClipToPaddedFace(edge.v0, edge.v1, id.face(), padding, &a_uv,
+                               &b_uv) &&
+          S2::IntersectsRect(a_uv, b_uv, bound)) {
+        data.edges.push_back(e);
+      }
+      // The path between the two cell centers stays within "cell_id", so
+      // only the edges of "clipped" can cross it.
+      if (has_interior) {
+        data.contains_center ^=
+            crosser.EdgeOrVertexCrossing(&edge.v0, &edge.v1);
+      }
+    }
+    if (!data.edges.empty() || data.contains_center) {
+      shapes->push_back(std::move(data));
+    }
+  }
+}
+
+/* static */
+unique_ptr<S2ShapeIndexCell> CompositeS2ShapeIndex::MakeCell(
+    const vector<ClippedShapeData>& shapes) {
+  auto cell = make_unique<S2ShapeIndexCell>();
+  S2ClippedShape* clipped = cell->add_shapes(shapes.size());
+  for (const ClippedShapeData& data : shapes) {
+    clipped->Init(data.shape_id, data.edges.size());
+    for (int i = 0; i < data.edges.size(); ++i) {
+      clipped->set_edge(i, data.edges[i]);
+    }
+    clipped->set_contains_center(data.contains_center);
+    ++clipped;
+  }
+  return cell;
+}
+
+CompositeS2ShapeIndex::Iterator::Iterator(const CompositeS2ShapeIndex* index,
+                                          InitialPosition pos) {
+  Init(index, pos);
+}
+
+void CompositeS2ShapeIndex::Iterator::Init(
+    const CompositeS2ShapeIndex* index, InitialPosition pos) {
+  index_ = index;
+  its_.clear();
+  for (const S2ShapeIndex* sub_index : index->indexes_) {
+    its_.emplace_back(sub_index);
+  }
+  if (pos == BEGIN) {
+    Begin();
+  } else {
+    Finish();
+  }
+}
+
+const S2ShapeIndexCell& CompositeS2ShapeIndex::Iterator::cell() const {
+  ABSL_DCHECK(!done());
+  return index_->GetCell(id_, &its_);
+}
+
+void CompositeS2ShapeIndex::Iterator::Begin() {
+  id_ = FindForward(S2CellId::Begin(S2CellId::kMaxLevel));
+}
+
+void CompositeS2ShapeIndex::Iterator::Finish() {
+  id_ = S2CellId::Sentinel();
+}
+
+void CompositeS2ShapeIndex::Iterator::Next() {
+  ABSL_DCHECK(!done());
+  id_ = FindForward(id_.range_max().next());
+}
+
+bool CompositeS2ShapeIndex::Iterator::Prev() {
+  if (!done() && id_.range_min() == S2CellId::Begin(S2CellId::kMaxLevel)) {
+    return false;
+  }
+  S2CellId leaf = done() ? S2CellId::End(S2CellId::kMaxLevel).prev()
+                         : id_.range_min().prev();
+  S2CellId prev = FindBackward(leaf);
+  if (prev == S2CellId::None()) return false;
+  id_ = prev;
+  return true;
+}
+
+void CompositeS2ShapeIndex::Iterator::Seek(S2CellId target) {
+  // Every cell whose range includes "target" also includes the leaf cell
+  // "leaf", so the first cell with id() >= target is either that cell or
+  // the following one.
+  S2CellId leaf(std::max(target.id() | 1,
+                         S2CellId::Begin(S2CellId::kMaxLevel).id()));
+  if (leaf >= S2CellId::End(S2CellId::kMaxLevel)) {
+    Finish();
+    return;
+  }
+  id_ = FindForward(leaf);
+  if (id_ < target) Next();
+}
+
+namespace {
+
+// Describes how the cells of one index relate to a given leaf cell.
+struct LeafNeighborhood {
+  // The cell containing the leaf, or S2CellId::None().
+  S2CellId containing = S2CellId::None();
+
+  // Otherwise, the closest cells before and after the leaf (or
+  // S2CellId::None() if there are none).
+  S2CellId before = S2CellId::None();
+  S2CellId after = S2CellId::None();
+};
+
+LeafNeighborhood GetNeighborhood(S2CellId leaf, S2ShapeIndex::Iterator* it) {
+  LeafNeighborhood result;
+  it->Seek(leaf);
+  if (!it->done()) {
+    if (it->id().range_min() <= leaf) {
+      result.containing = it->id();
+      return result;
+    }
+    result.after = it->id();
+  }
+  if (it->Prev()) {
+    if (it->id().range_max() >= leaf) {
+      result.containing = it->id();
+    } else {
+      result.before = it->id();
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+// Composite cells are the largest cells that are contained by at most one
+// cell of each index and do not partially overlap any other cell.  Given a
+// leaf cell that is contained by at least one index cell, the composite cell
+// containing it is therefore its largest ancestor that stays within the
+// range allowed by each index.
+S2CellId CompositeS2ShapeIndex::Iterator::FindForward(S2CellId leaf) {
+  const S2CellId kFirstLeaf = S2CellId::Begin(S2CellId::kMaxLevel);
+  const S2CellId kLastLeaf = S2CellId::End(S2CellId::kMaxLevel).prev();
+  for (;;) {
+    if (leaf > kLastLeaf) return S2CellId::Sentinel();
+    S2CellId lo = kFirstLeaf, hi = kLastLeaf;
+    S2CellId next_start = S2CellId::Sentinel();
+    bool contained = false;
+    for (S2ShapeIndex::Iterator& it : its_) {
+      LeafNeighborhood n = GetNeighborhood(leaf, &it);
+      if (n.containing != S2CellId::None()) {
+        contained = true;
+        lo = std::max(lo, n.containing.range_min());
+        hi = std::min(hi, n.containing.range_max());
+        continue;
+      }
+      if (n.before != S2CellId::None()) {
+        lo = std::max(lo, n.before.range_max().next());
+      }
+      if (n.after != S2CellId::None()) {
+        hi = std::min(hi, n.after.range_min().prev());
+        next_start = std::min(next_start, n.after.range_min());
+      }
+    }
+    if (contained) {
+      S2CellId id = leaf;
+      while (!id.is_face()) {
+        S2CellId parent = id.parent();
+        if (parent.range_min() < lo || parent.range_max() > hi) break;
+        id = parent;
+      }
+      return id;
+    }
+    // No index covers "leaf", so skip to the next cell of any index.
+    leaf = next_start;
+  }
+}
+
+S2CellId CompositeS2ShapeIndex::Iterator::FindBackward(S2CellId leaf) {
+  // Find the last leaf at or before "leaf" that is covered by some index
+  // cell.  The composite cell containing it ends at or before "leaf".
+  S2CellId last = S2CellId::None();
+  for (S2ShapeIndex::Iterator& it : its_) {
+    LeafNeighborhood n = GetNeighborhood(leaf, &it);
+    if (n.containing != S2CellId::None()) {
+      last = leaf;
+      break;
+    }
+    if (n.before != S2CellId::None()) {
+      last = std::max(last, n.before.range_max());
+    }
+  }
+  if (last == S2CellId::None()) return S2CellId::None();
+  return FindForward(last);
+}
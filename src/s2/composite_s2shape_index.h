@@ -0,0 +1,195 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_COMPOSITE_S2SHAPE_INDEX_H_
+#define S2_COMPOSITE_S2SHAPE_INDEX_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "s2/util/coding/coder.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2point.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+
+// CompositeS2ShapeIndex is a read-only S2ShapeIndex that presents several
+// existing indexes as a single index, without copying their shapes or
+// rebuilding their cells.  For example, if roads, water, and buildings are
+// indexed separately, queries over all of them can be done like this:
+//
+//   CompositeS2ShapeIndex all({&roads, &water, &buildings});
+//   S2ClosestEdgeQuery query(&all);
+//   auto contains = MakeS2ContainsPointQuery(&all);
+//
+// The shapes of the i-th index are numbered consecutively starting at
+// shape_id_offset(i), in the order that the indexes were given, so that a
+// result can be mapped back to its index using index_for_shape_id().
+//
+// The cells of the composite index are computed as they are visited.
+// Wherever the cells of the indexes do not overlap, the composite index has
+// the same cells.  Where the cells of different indexes overlap, the larger
+// cells are split so that each composite cell is contained by at most one
+// cell of each index, and the contents of the larger cells are clipped to
+// the composite cell.  (As a result a composite cell may occasionally have
+// no clipped shapes.)  Cells that need to be constructed are cached by the
+// index, so memory usage grows with the number of distinct cells that
+// queries visit; Minimize() discards them.
+//
+// The indexes must outlive this object and must not be modified while it is
+// in use.  As with the other index types, const methods may be called
+// concurrently.
+class CompositeS2ShapeIndex final : public S2ShapeIndex {
+ public:
+  // Default constructor; must be followed by a call to Init().
+  CompositeS2ShapeIndex() = default;
+
+  // Creates a view of the given indexes, which are not owned.
+  explicit CompositeS2ShapeIndex(std::vector<const S2ShapeIndex*> indexes);
+
+  CompositeS2ShapeIndex(const CompositeS2ShapeIndex&) = delete;
+  CompositeS2ShapeIndex& operator=(const CompositeS2ShapeIndex&) = delete;
+
+  ~CompositeS2ShapeIndex() override;
+
+  // Initializes the view with the given indexes, which are not owned.
+  void Init(std::vector<const S2ShapeIndex*> indexes);
+
+  // Returns the number of indexes and the i-th index.
+  int num_indexes() const { return indexes_.size(); }
+  const S2ShapeIndex& index(int i) const { return *indexes_[i]; }
+
+  // Returns the shape id of the first shape of the i-th index.
+  int shape_id_offset(int i) const { return shape_id_offsets_[i]; }
+
+  // Returns the index containing the given shape id.
+  //
+  // REQUIRES: 0 <= shape_id < num_shape_ids()
+  int index_for_shape_id(int shape_id) const;
+
+  int num_shape_ids() const override { return shape_id_offsets_.back(); }
+
+  const S2Shape* shape(int id) const override;
+
+  // Appends an encoded representation of the composite cells to "encoder" in
+  // the format used by MutableS2ShapeIndex::Encode(), so that it can be
+  // decoded by EncodedS2ShapeIndex.  The shapes must be encoded separately
+  // (e.g. by s2shapeutil::CompactEncodeTaggedShapes).  Composite cells with
+  // no clipped shapes are omitted.  Note that this visits every cell of every
+  // index.
+  void Encode(Encoder* encoder) const override;
+
+  // Returns the memory used by the view and its cached cells, not including
+  // the indexes themselves.
+  size_t SpaceUsed() const override;
+
+  // Discards all cached cells.
+  void Minimize() override;
+
+  class Iterator final : public IteratorBase {
+   public:
+    // Default constructor; must be followed by a call to Init().
+    Iterator() = default;
+
+    // Constructs an iterator positioned as specified.  By default iterators
+    // are unpositioned, since this avoids an extra seek in this situation
+    // where one of the seek methods (such as Locate) is immediately called.
+    explicit Iterator(const CompositeS2ShapeIndex* index,
+                      InitialPosition pos = UNPOSITIONED);
+
+    // Initializes an iterator for the given CompositeS2ShapeIndex.
+    void Init(const CompositeS2ShapeIndex* index,
+              InitialPosition pos = UNPOSITIONED);
+
+    S2CellId id() const override { return id_; }
+    bool done() const override { return id_ == S2CellId::Sentinel(); }
+    const S2ShapeIndexCell& cell() const override;
+
+    // S2CellIterator API:
+    void Begin() override;
+    void Finish() override;
+    void Next() override;
+    bool Prev() override;
+    void Seek(S2CellId target) override;
+
+    bool Locate(const S2Point& target) override {
+      return LocateImpl(*this, target);
+    }
+
+    S2CellRelation Locate(S2CellId target) override {
+      return LocateImpl(*this, target);
+    }
+
+    std::unique_ptr<IteratorBase> Clone() const override {
+      return std::make_unique<Iterator>(*this);
+    }
+
+   private:
+    // Returns the first composite cell whose range includes or follows the
+    // given leaf cell, or S2CellId::Sentinel() if there is none.
+    S2CellId FindForward(S2CellId leaf);
+
+    // Returns the last composite cell whose range includes or precedes the
+    // given leaf cell, or S2CellId::None() if there is none.
+    S2CellId FindBackward(S2CellId leaf);
+
+    const CompositeS2ShapeIndex* index_ = nullptr;
+    S2CellId id_ = S2CellId::Sentinel();
+
+    // One iterator for each index.  They are used to find the composite cells
+    // and are positioned arbitrarily.
+    mutable std::vector<S2ShapeIndex::Iterator> its_;
+  };
+
+ protected:
+  std::unique_ptr<IteratorBase> NewIterator(InitialPosition pos) const override;
+
+ private:
+  struct ClippedShapeData;
+
+  // Returns the contents of the composite cell "id", using "its" to find the
+  // cells of each index that contain it.
+  const S2ShapeIndexCell& GetCell(
+      S2CellId id, std::vector<S2ShapeIndex::Iterator>* its) const;
+
+  // Appends the clipped shapes of "cell" (the cell "cell_id" of the i-th
+  // index) to "shapes", clipping them to the descendant cell "id" if
+  // necessary.
+  void AppendClippedShapes(int i, S2CellId cell_id,
+                           const S2ShapeIndexCell& cell, S2CellId id,
+                           std::vector<ClippedShapeData>* shapes) const;
+
+  static std::unique_ptr<S2ShapeIndexCell> MakeCell(
+      const std::vector<ClippedShapeData>& shapes);
+
+  std::vector<const S2ShapeIndex*> indexes_;
+
+  // shape_id_offsets_[i] is the first shape id of the i-th index, and the
+  // last element is the total number of shape ids.
+  std::vector<int> shape_id_offsets_{0};
+
+  // The composite cells that have been constructed so far (all cells except
+  // those that are simply cells of the first index).  Like all index cells
+  // they remain valid until the index is minimized or destroyed.
+  mutable absl::Mutex lock_;
+  mutable absl::flat_hash_map<S2CellId, std::unique_ptr<S2ShapeIndexCell>>
+      cells_ ABSL_GUARDED_BY(lock_);
+};
+
+#endif  // S2_COMPOSITE_S2SHAPE_INDEX_H_
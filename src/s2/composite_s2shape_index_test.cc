@@ -0,0 +1,322 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/composite_s2shape_index.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/util/coding/coder.h"
+#include "s2/encoded_s2shape_index.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/r2.h"
+#include "s2/r2rect.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_iterator_testing.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2closest_edge_query.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2edge_clipping.h"
+#include "s2/s2fractal.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2lax_polyline_shape.h"
+#include "s2/s2latlng.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2polygon.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+#include "s2/s2shapeutil_coding.h"
+#include "s2/s2shapeutil_contains_brute_force.h"
+#include "s2/s2shapeutil_testing.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+const S2Point kCenter = S2LatLng::FromDegrees(10, 10).ToPoint();
+
+// Returns points, polylines, and polygons, including a fractal with enough
+// edges that its index has many cells.
+vector<unique_ptr<S2Shape>> MakeFirstLayer() {
+  vector<unique_ptr<S2Shape>> shapes = s2textformat::MakeIndexOrDie(
+      "0:0 | 1:1 | 2:2 # 3:3, 4:4, 5:5 | 6:6, 7:7 # 20:20, 20:30, 30:30")
+      ->ReleaseAll();
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3000);
+  S2Polygon polygon(fractal.MakeLoop(S2Testing::GetRandomFrameAt(kCenter),
+                                     S1Angle::Degrees(5)));
+  shapes.push_back(make_unique<S2LaxPolygonShape>(polygon));
+  return shapes;
+}
+
+// Returns shapes that overlap the first layer at both smaller and larger
+// scales, together with a shape far away from it.
+vector<unique_ptr<S2Shape>> MakeSecondLayer() {
+  vector<unique_ptr<S2Shape>> shapes;
+  auto add_loop = [&shapes](const S2Point& center, S1Angle radius, int n) {
+    S2Polygon polygon(S2Loop::MakeRegularLoop(center, radius, n));
+    shapes.push_back(make_unique<S2LaxPolygonShape>(polygon));
+  };
+  add_loop(kCenter, S1Angle::Degrees(8), 8);
+  add_loop(kCenter, S1Angle::Degrees(0.01), 5);
+  add_loop(S2LatLng::FromDegrees(-40, -100).ToPoint(), S1Angle::Degrees(1),
+           10);
+  shapes.push_back(make_unique<S2LaxPolylineShape>(
+      s2textformat::ParsePointsOrDie("0:5, 10:10, 13:12, 25:25")));
+  return shapes;
+}
+
+// Returns a second fractal that partly overlaps the first one.
+vector<unique_ptr<S2Shape>> MakeThirdLayer() {
+  S2Testing::rnd.Reset(2);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(1000);
+  S2Polygon polygon(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(S2LatLng::FromDegrees(12, 14).ToPoint()),
+      S1Angle::Degrees(3)));
+  vector<unique_ptr<S2Shape>> shapes;
+  shapes.push_back(make_unique<S2LaxPolygonShape>(polygon));
+  return shapes;
+}
+
+void AddShapes(vector<unique_ptr<S2Shape>> shapes,
+               MutableS2ShapeIndex* index) {
+  for (auto& shape : shapes) index->Add(std::move(shape));
+}
+
+// Verifies that "index_has_edge" is true if the edge AB intersects the given
+// cell and false if it is not close to the cell.  (CompositeS2ShapeIndex may
+// include edges slightly farther from the cell than MutableS2ShapeIndex.)
+void ValidateEdge(const S2Point& a, const S2Point& b, S2CellId id,
+                  bool index_has_edge) {
+  double padding = MutableS2ShapeIndex::kCellPadding;
+  padding += (index_has_edge ? 2 : -1) * S2::kIntersectsRectErrorUVDist;
+  R2Rect bound = id.GetBoundUV().Expanded(padding);
+  R2Point a_uv, b_uv;
+  EXPECT_EQ(S2::ClipToPaddedFace(a, b, id.face(), padding, &a_uv, &b_uv) &&
+                S2::IntersectsRect(a_uv, b_uv, bound),
+            index_has_edge)
+      << id;
+}
+
+// Verifies the contents of every cell of "index" (and of the gaps between
+// them) by brute force, like MutableS2ShapeIndexTest::QuadraticValidate().
+void QuadraticValidate(const S2ShapeIndex& index) {
+  S2CellId min_cellid = S2CellId::Begin(S2CellId::kMaxLevel);
+  for (S2ShapeIndex::Iterator it(&index, S2ShapeIndex::BEGIN);; it.Next()) {
+    S2CellUnion skipped;
+    if (!it.done()) {
+      ASSERT_GE(it.id(), min_cellid);
+      skipped.InitFromBeginEnd(min_cellid, it.id().range_min());
+      min_cellid = it.id().range_max().next();
+    } else {
+      skipped.InitFromBeginEnd(min_cellid, S2CellId::End(S2CellId::kMaxLevel));
+    }
+    for (int id = 0; id < index.num_shape_ids(); ++id) {
+      const S2Shape* shape = index.shape(id);
+      const S2ClippedShape* clipped =
+          it.done() ? nullptr : it.cell().find_clipped(id);
+      for (S2CellId skipped_id : skipped) {
+        EXPECT_FALSE(
+            s2shapeutil::ContainsBruteForce(*shape, skipped_id.ToPoint()));
+      }
+      if (!it.done()) {
+        EXPECT_EQ(s2shapeutil::ContainsBruteForce(*shape, it.id().ToPoint()),
+                  clipped != nullptr && clipped->contains_center())
+            << it.id() << " shape " << id;
+      }
+      for (int e = 0; e < shape->num_edges(); ++e) {
+        S2Shape::Edge edge = shape->edge(e);
+        for (S2CellId skipped_id : skipped) {
+          ValidateEdge(edge.v0, edge.v1, skipped_id, false);
+        }
+        if (!it.done()) {
+          ValidateEdge(edge.v0, edge.v1, it.id(),
+                       clipped != nullptr && clipped->ContainsEdge(e));
+        }
+      }
+    }
+    if (it.done()) break;
+  }
+}
+
+// Verifies that the non-empty cells of "a" are the cells of "b".
+void ExpectSameNonEmptyCells(const S2ShapeIndex& a, const S2ShapeIndex& b) {
+  S2ShapeIndex::Iterator b_it(&b, S2ShapeIndex::BEGIN);
+  for (S2ShapeIndex::Iterator a_it(&a, S2ShapeIndex::BEGIN); !a_it.done();
+       a_it.Next()) {
+    const S2ShapeIndexCell& a_cell = a_it.cell();
+    if (a_cell.num_clipped() == 0) continue;
+    ASSERT_FALSE(b_it.done());
+    ASSERT_EQ(a_it.id(), b_it.id());
+    const S2ShapeIndexCell& b_cell = b_it.cell();
+    ASSERT_EQ(a_cell.num_clipped(), b_cell.num_clipped());
+    for (int i = 0; i < a_cell.num_clipped(); ++i) {
+      const S2ClippedShape& a_clipped = a_cell.clipped(i);
+      const S2ClippedShape& b_clipped = b_cell.clipped(i);
+      EXPECT_EQ(a_clipped.shape_id(), b_clipped.shape_id());
+      EXPECT_EQ(a_clipped.contains_center(), b_clipped.contains_center());
+      ASSERT_EQ(a_clipped.num_edges(), b_clipped.num_edges());
+      for (int j = 0; j < a_clipped.num_edges(); ++j) {
+        EXPECT_EQ(a_clipped.edge(j), b_clipped.edge(j));
+      }
+    }
+    b_it.Next();
+  }
+  EXPECT_TRUE(b_it.done());
+}
+
+class CompositeS2ShapeIndexTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    // The layers are indexed in different ways, and one index is empty.
+    AddShapes(MakeFirstLayer(), &first_);
+    AddShapes(MakeSecondLayer(), &second_);
+    MutableS2ShapeIndex third;
+    AddShapes(MakeThirdLayer(), &third);
+    ASSERT_TRUE(s2shapeutil::CompactEncodeTaggedShapes(third, &encoder_));
+    third.Encode(&encoder_);
+    Decoder decoder(encoder_.base(), encoder_.length());
+    ASSERT_TRUE(third_.Init(&decoder,
+                            s2shapeutil::LazyDecodeShapeFactory(&decoder)));
+    index_.Init({&first_, &empty_, &second_, &third_});
+
+    AddShapes(MakeFirstLayer(), &expected_);
+    AddShapes(MakeSecondLayer(), &expected_);
+    AddShapes(MakeThirdLayer(), &expected_);
+  }
+
+  MutableS2ShapeIndex first_, empty_, second_;
+  Encoder encoder_;
+  EncodedS2ShapeIndex third_;
+  CompositeS2ShapeIndex index_;
+
+  // An index containing the shapes of all layers.
+  MutableS2ShapeIndex expected_;
+};
+
+TEST(CompositeS2ShapeIndex, Empty) {
+  MutableS2ShapeIndex empty;
+  CompositeS2ShapeIndex index({&empty, &empty});
+  EXPECT_EQ(index.num_shape_ids(), 0);
+  EXPECT_TRUE(CompositeS2ShapeIndex::Iterator(&index, S2ShapeIndex::BEGIN)
+                  .done());
+}
+
+TEST(CompositeS2ShapeIndex, SingleIndex) {
+  MutableS2ShapeIndex first;
+  AddShapes(MakeFirstLayer(), &first);
+  CompositeS2ShapeIndex index({&first});
+  s2testing::ExpectEqual(first, index);
+}
+
+TEST_F(CompositeS2ShapeIndexTest, ShapeIds) {
+  ASSERT_EQ(index_.num_shape_ids(), expected_.num_shape_ids());
+  EXPECT_EQ(index_.shape_id_offset(1), first_.num_shape_ids());
+  EXPECT_EQ(index_.shape_id_offset(2), first_.num_shape_ids());
+  EXPECT_EQ(index_.shape_id_offset(3),
+            first_.num_shape_ids() + second_.num_shape_ids());
+  for (int id = 0; id < index_.num_shape_ids(); ++id) {
+    int i = index_.index_for_shape_id(id);
+    EXPECT_NE(i, 1);
+    EXPECT_EQ(index_.shape(id),
+              index_.index(i).shape(id - index_.shape_id_offset(i)));
+    s2testing::ExpectEqual(*expected_.shape(id), *index_.shape(id));
+  }
+}
+
+TEST_F(CompositeS2ShapeIndexTest, CellsAreValid) {
+  QuadraticValidate(index_);
+}
+
+TEST_F(CompositeS2ShapeIndexTest, QueriesMatchCombinedIndex) {
+  S2ClosestEdgeQuery expected_query(&expected_);
+  S2ClosestEdgeQuery actual_query(&index_);
+  auto expected_contains = MakeS2ContainsPointQuery(&expected_);
+  auto actual_contains = MakeS2ContainsPointQuery(&index_);
+  S2Testing::rnd.Reset(3);
+  for (int i = 0; i < 200; ++i) {
+    // Test points both near the shapes and elsewhere.
+    S2Point point = (i % 2) ? S2Testing::RandomPoint()
+                            : S2Testing::SamplePoint(
+                                  S2Cap(kCenter, S1Angle::Degrees(10)));
+    S2ClosestEdgeQuery::PointTarget target(point);
+    EXPECT_EQ(expected_query.GetDistance(&target),
+              actual_query.GetDistance(&target));
+    EXPECT_EQ(expected_contains.GetContainingShapeIds(point),
+              actual_contains.GetContainingShapeIds(point));
+  }
+}
+
+TEST_F(CompositeS2ShapeIndexTest, IteratorMethods) {
+  vector<S2CellId> ids;
+  for (CompositeS2ShapeIndex::Iterator it(&index_, S2ShapeIndex::BEGIN);
+       !it.done(); it.Next()) {
+    ids.push_back(it.id());
+  }
+  ASSERT_FALSE(ids.empty());
+
+  // Iterate backward from the end.
+  CompositeS2ShapeIndex::Iterator it(&index_, S2ShapeIndex::END);
+  for (int i = ids.size() - 1; i >= 0; --i) {
+    ASSERT_TRUE(it.Prev());
+    EXPECT_EQ(it.id(), ids[i]);
+  }
+  EXPECT_FALSE(it.Prev());
+  EXPECT_EQ(it.id(), ids[0]);
+
+  // Seek to each cell, and to the gaps just before and after it.
+  for (int i = 0; i < ids.size(); ++i) {
+    it.Seek(ids[i].range_min());
+    EXPECT_EQ(it.id(), ids[i]);
+    it.Seek(ids[i].range_max().next());
+    EXPECT_EQ(it.done() ? S2CellId::Sentinel() : it.id(),
+              i + 1 < ids.size() ? ids[i + 1] : S2CellId::Sentinel());
+    EXPECT_EQ(it.Locate(ids[i].child_begin(S2CellId::kMaxLevel)),
+              S2CellRelation::INDEXED);
+    EXPECT_EQ(it.id(), ids[i]);
+  }
+  TestSeekNear(it);
+}
+
+TEST_F(CompositeS2ShapeIndexTest, EncodeAndMinimize) {
+  Encoder encoder;
+  ASSERT_TRUE(s2shapeutil::CompactEncodeTaggedShapes(index_, &encoder));
+  index_.Encode(&encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex decoded;
+  ASSERT_TRUE(decoded.Init(&decoder,
+                           s2shapeutil::LazyDecodeShapeFactory(&decoder)));
+  for (int id = 0; id < index_.num_shape_ids(); ++id) {
+    s2testing::ExpectEqual(*index_.shape(id), *decoded.shape(id));
+  }
+  ExpectSameNonEmptyCells(index_, decoded);
+
+  size_t space_used = index_.SpaceUsed();
+  index_.Minimize();
+  EXPECT_LT(index_.SpaceUsed(), space_used);
+  ExpectSameNonEmptyCells(index_, decoded);
+}
+
+}  // namespace
@@ -62,13 +62,53 @@ void EncodeBaseShift(Encoder* encoder, int shift, uint64 base, int base_len) {
 }
 
 void EncodeS2CellIdVector(Span<const S2CellId> v, Encoder* encoder) {
+  S2CellIdVectorStreamEncoder stream;
+  for (auto cellid : v) stream.Measure(cellid);
+  stream.EncodeHeader(encoder);
+  encoder->Ensure(v.size() * sizeof(uint64));
+  for (auto cellid : v) stream.Encode(cellid, encoder);
+}
+
+void EncodeS2CellIdVector(Span<const S2CellId> v, CodingHint hint,
+                          Encoder* encoder) {
+  if (hint == CodingHint::FAST) return EncodeS2CellIdVector(v, encoder);
+  S2CellIdVectorStreamEncoder stream;
+  for (auto cellid : v) stream.Measure(cellid);
+  stream.EncodeBaseAndShift(hint, encoder);
+  vector<uint64> deltas;
+  deltas.reserve(v.size());
+  for (auto cellid : v) {
+    deltas.push_back((cellid.id() - stream.base_) >> stream.shift_);
+  }
+  EncodeUintVector<uint64>(deltas, hint, encoder);
+}
+
+void S2CellIdVectorStreamEncoder::Measure(S2CellId id) {
+  ++size_;
+  v_or_ |= id.id();
+  v_and_ &= id.id();
+  v_min_ = min(v_min_, id.id());
+  v_max_ = max(v_max_, id.id());
+}
+
+void S2CellIdVectorStreamEncoder::EncodeHeader(Encoder* encoder) {
+  // Encode the base and shift followed by the header of the vector of
+  // deltas.  The largest delta is the one for "v_max".
+  uint64 max_delta = EncodeBaseAndShift(CodingHint::FAST, encoder);
+  len_ = EncodeUintVectorHeader<uint64>(size_, max_delta, encoder);
+}
+
+uint64 S2CellIdVectorStreamEncoder::EncodeBaseAndShift(CodingHint hint,
+                                                       Encoder* encoder) {
   // v[i] is encoded as (base + (deltas[i] << shift)).
   //
   // "base" consists of 0-7 bytes, and is always shifted so that its bytes are
   // the most-significant bytes of a uint64.
   //
   // "deltas" is an EncodedUintVector<uint64>, which means that all deltas
-  // have a fixed-length encoding determined by the largest delta.
+  // have a fixed-length encoding determined by the largest delta.  This is
+  // a whole number of bytes unless "hint" is CodingHint::COMPACT, in which
+  // case the deltas are bit-packed.
   //
   // "shift" is in the range 0..56.  The shift value is odd only if all
   // S2CellIds are at the same level, in which case the bit at position
@@ -91,13 +131,7 @@ void EncodeS2CellIdVector(Span<const S2CellId> v, Encoder* encoder) {
   //  Followed by 0-7 bytes of "base"
   //  Followed by an EncodedUintVector of deltas.
 
-  uint64 v_or = 0, v_and = ~0ULL, v_min = ~0ULL, v_max = 0;
-  for (auto cellid : v) {
-    v_or |= cellid.id();
-    v_and &= cellid.id();
-    v_min = min(v_min, cellid.id());
-    v_max = max(v_max, cellid.id());
-  }
+  const uint64 v_or = v_or_, v_and = v_and_, v_min = v_min_, v_max = v_max_;
   // These variables represent the values that will used during encoding.
   uint64 e_base = 0;      // Base value.
   int e_base_len = 0;       // Number of bytes to represent "base".
@@ -114,45 +148,57 @@ void EncodeS2CellIdVector(Span<const S2CellId> v, Encoder* encoder) {
     // "base" consists of the "base_len" most significant bytes of the minimum
     // S2CellId.  We consider all possible values of "base_len" (0..7) and
     // choose the one that minimizes the total encoding size.
-    uint64 e_bytes = ~0ULL;  // Best encoding size so far.
+    const bool bit_packed = (hint == CodingHint::COMPACT);
+    uint64 e_bits = ~0ULL;  // Best encoding size so far.
     for (int len = 0; len < 8; ++len) {
       // "t_base" is the base value being tested (first "len" bytes of v_min).
       // "t_max_delta_msb" is the most-significant bit position (i.e. bit-width
       // minus one) of the largest delta (or zero if there are no deltas, i.e.
-      // if v.size() == 0).  "t_bytes" is the total size of the variable
+      // if v.size() == 0).  "t_bits" is the total size of the variable
       // portion of the encoding.
       uint64 t_base = v_min & ~(~0ULL >> (8 * len));
       int t_max_delta_msb = max(
           0,
           static_cast<int>(absl::bit_width((v_max - t_base) >> e_shift)) - 1);
-      uint64 t_bytes = len + v.size() * ((t_max_delta_msb >> 3) + 1);
-      if (t_bytes < e_bytes) {
+      uint64 delta_bits = bit_packed ? t_max_delta_msb + 1
+                                     : 8 * ((t_max_delta_msb >> 3) + 1);
+      uint64 t_bits = 8 * len + size_ * delta_bits;
+      if (t_bits < e_bits) {
         e_base = t_base;
         e_base_len = len;
         e_max_delta_msb = t_max_delta_msb;
-        e_bytes = t_bytes;
+        e_bits = t_bits;
       }
     }
     // It takes one extra byte to encode odd shifts (i.e., the case where all
     // S2CellIds are at the same level), so check whether we can get the same
-    // encoding size per delta using an even shift.
-    if ((e_shift & 1) && (e_max_delta_msb & 7) != 7) --e_shift;
+    // encoding size per delta using an even shift.  (When the deltas are
+    // bit-packed, an even shift costs one extra bit per delta instead.)
+    if (bit_packed) {
+      if (e_shift >= 5 && (e_shift & 1) && size_ <= 8) --e_shift;
+    } else if ((e_shift & 1) && (e_max_delta_msb & 7) != 7) {
+      --e_shift;
+    }
   }
   ABSL_DCHECK_LE(e_base_len, 7);
   ABSL_DCHECK_LE(e_shift, 56);
 
   EncodeBaseShift(encoder, e_shift, e_base, e_base_len);
+  base_ = e_base;
+  shift_ = e_shift;
+  return (v_max - e_base) >> e_shift;
+}
 
-  // Finally, encode the vector of deltas.
-  vector<uint64> deltas;
-  deltas.reserve(v.size());
-  for (auto cellid : v) {
-    deltas.push_back((cellid.id() - e_base) >> e_shift);
-  }
-  EncodeUintVector<uint64>(deltas, encoder);
+void S2CellIdVectorStreamEncoder::Encode(S2CellId id, Encoder* encoder) const {
+  encoder->Ensure(len_);
+  EncodeUintWithLength<uint64>((id.id() - base_) >> shift_, len_, encoder);
 }
 
 bool EncodedS2CellIdVector::Init(Decoder* decoder) {
+  return Init(decoder, CodingHint::FAST);
+}
+
+bool EncodedS2CellIdVector::Init(Decoder* decoder, CodingHint hint) {
   // All encodings have at least 2 bytes (one for our header and one for the
   // EncodedUintVector header), so this is safe.
   if (decoder->avail() < 2) return false;
@@ -177,17 +223,162 @@ bool EncodedS2CellIdVector::Init(Decoder* decoder) {
   } else {
     shift_ = 2 * shift_code;
   }
-  return deltas_.Init(decoder);
+  return deltas_.Init(decoder, hint);
 }
 
 vector<S2CellId> EncodedS2CellIdVector::Decode() const {
   vector<S2CellId> result(size());
-  for (size_t i = 0; i < size(); ++i) {
-    result[i] = (*this)[i];
-  }
+  Decode(0, absl::MakeSpan(result));
   return result;
 }
 
+void EncodedS2CellIdVector::Decode(size_t begin, Span<S2CellId> out) const {
+  // The deltas are decoded in blocks into a local buffer, and then converted
+  // to S2CellIds using a loop that the compiler can vectorize.
+  constexpr size_t kBlockSize = 64;
+  uint64 deltas[kBlockSize];
+  for (size_t i = 0; i < out.size(); i += kBlockSize) {
+    size_t n = min(kBlockSize, out.size() - i);
+    deltas_.Decode(begin + i, absl::MakeSpan(deltas, n));
+    for (size_t j = 0; j < n; ++j) {
+      out[i + j] = S2CellId((deltas[j] << shift_) + base_);
+    }
+  }
+}
+
+namespace {
+
+// Returns the first position in [begin, size) for which "before" is false,
+// where "before" is true for a prefix of the positions.  The search gallops
+// forward from "begin" in exponentially increasing steps and then performs
+// a binary search within the bracketed range, so that it is fast when the
+// result is close to "begin".
+template <typename Predicate>
+size_t GallopPartition(size_t begin, size_t size, const Predicate& before) {
+  size_t lo = begin, hi = begin;
+  for (size_t step = 1; hi < size && before(hi); step *= 2) {
+    lo = hi + 1;
+    hi = lo + min(step, size - lo);
+  }
+  hi = min(hi, size);
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (before(mid)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// Returns true if the range of "x" ends before the range of "y" begins.
+bool EntirelyPrecedes(S2CellId x, S2CellId y) {
+  return x.range_max() < y.range_min();
+}
+
+}  // namespace
+
+bool EncodedS2CellIdVector::Contains(S2CellId id) const {
+  ABSL_DCHECK(id.is_valid()) << id;
+  // The cell containing "id" (if any) is either the first cell that is >=
+  // id.range_min() or the cell immediately before it.
+  size_t i = lower_bound(id.range_min());
+  return (i < size() && (*this)[i].contains(id)) ||
+         (i > 0 && (*this)[i - 1].contains(id));
+}
+
+bool EncodedS2CellIdVector::Intersects(S2CellId id) const {
+  ABSL_DCHECK(id.is_valid()) << id;
+  size_t i = lower_bound(id.range_min());
+  return (i < size() && (*this)[i].intersects(id)) ||
+         (i > 0 && (*this)[i - 1].intersects(id));
+}
+
+bool EncodedS2CellIdVector::Contains(Span<const S2CellId> y) const {
+  const size_t n = size();
+  size_t i = 0;
+  for (S2CellId y_id : y) {
+    // Advance to the first cell that does not entirely precede "y_id".
+    i = GallopPartition(i, n, [this, y_id](size_t k) {
+      return EntirelyPrecedes((*this)[k], y_id);
+    });
+    if (i == n || !(*this)[i].contains(y_id)) return false;
+  }
+  return true;
+}
+
+bool EncodedS2CellIdVector::Intersects(Span<const S2CellId> y) const {
+  const size_t nx = size(), ny = y.size();
+  for (size_t i = 0, j = 0; i < nx && j < ny;) {
+    const S2CellId x_id = (*this)[i];
+    if (EntirelyPrecedes(x_id, y[j])) {
+      // Advance "i" to the first cell that might overlap y[j].
+      i = GallopPartition(i + 1, nx, [this, &y, j](size_t k) {
+        return EntirelyPrecedes((*this)[k], y[j]);
+      });
+      continue;
+    }
+    if (EntirelyPrecedes(y[j], x_id)) {
+      // Advance "j" to the first cell that might overlap x_id.
+      j = GallopPartition(j + 1, ny, [&y, x_id](size_t k) {
+        return EntirelyPrecedes(y[k], x_id);
+      });
+      continue;
+    }
+    // Neither cell is to the left of the other, so they must intersect.
+    ABSL_DCHECK(x_id.intersects(y[j]));
+    return true;
+  }
+  return false;
+}
+
+void EncodedS2CellIdVector::GetIntersection(Span<const S2CellId> y,
+                                            vector<S2CellId>* out) const {
+  // This follows S2CellUnion::GetIntersection(), except that the positions
+  // are advanced by galloping rather than by full binary searches.
+  out->clear();
+  const size_t nx = size(), ny = y.size();
+  size_t i = 0, j = 0;
+  while (i < nx && j < ny) {
+    const S2CellId x_id = (*this)[i];
+    const S2CellId imin = x_id.range_min();
+    const S2CellId jmin = y[j].range_min();
+    if (imin > jmin) {
+      // Either y[j].contains(x_id) or the two cells are disjoint.
+      if (x_id <= y[j].range_max()) {
+        out->push_back(x_id);
+        ++i;
+      } else {
+        // Advance "j" to the first cell possibly contained by x_id.
+        j = GallopPartition(j + 1, ny,
+                            [&y, imin](size_t k) { return y[k] < imin; });
+        // The previous cell y[j-1] may now contain x_id.
+        if (x_id <= y[j - 1].range_max()) --j;
+      }
+    } else if (jmin > imin) {
+      // Identical to the code above with "i" and "j" reversed.
+      if (y[j] <= x_id.range_max()) {
+        out->push_back(y[j++]);
+      } else {
+        i = GallopPartition(i + 1, nx, [this, jmin](size_t k) {
+          return (*this)[k] < jmin;
+        });
+        if (y[j] <= (*this)[i - 1].range_max()) --i;
+      }
+    } else {
+      // "i" and "j" have the same range_min(), so one contains the other.
+      if (x_id < y[j]) {
+        out->push_back(x_id);
+        ++i;
+      } else {
+        out->push_back(y[j++]);
+      }
+    }
+  }
+  ABSL_DCHECK(std::is_sorted(out->begin(), out->end()));
+}
+
 void EncodedS2CellIdVector::Encode(Encoder* encoder) const {
   // Re-encode the base and shift values.
   EncodeBaseShift(encoder, shift_, base_, base_len_);
@@ -37,6 +37,50 @@ namespace s2coding {
 //           can be enlarged as necessary by calling Ensure(int).
 void EncodeS2CellIdVector(absl::Span<const S2CellId> v, Encoder* encoder);
 
+// Like EncodeS2CellIdVector() above, except that CodingHint::COMPACT
+// bit-packs the deltas (see EncodeUintVector).  The result must be decoded
+// using EncodedS2CellIdVector::Init() with the same hint.
+void EncodeS2CellIdVector(absl::Span<const S2CellId> v, CodingHint hint,
+                          Encoder* encoder);
+
+// Encodes a sequence of S2CellIds in the same format as EncodeS2CellIdVector()
+// without requiring them to be stored in memory.  The S2CellIds are passed in
+// twice, in the same order: first to Measure() and then to Encode().
+//
+//   S2CellIdVectorStreamEncoder stream;
+//   for (S2CellId id : ids) stream.Measure(id);
+//   stream.EncodeHeader(encoder);
+//   for (S2CellId id : ids) stream.Encode(id, encoder);
+class S2CellIdVectorStreamEncoder {
+ public:
+  // Accumulates the statistics needed to choose the encoding.
+  void Measure(S2CellId id);
+
+  // Chooses the encoding and encodes everything that precedes the values.
+  //
+  // REQUIRES: "encoder" uses the default constructor, so that its buffer
+  //           can be enlarged as necessary by calling Ensure(int).
+  void EncodeHeader(Encoder* encoder);
+
+  // Encodes the next S2CellId.
+  void Encode(S2CellId id, Encoder* encoder) const;
+
+ private:
+  friend void EncodeS2CellIdVector(absl::Span<const S2CellId> v,
+                                   CodingHint hint, Encoder* encoder);
+
+  // Chooses the base and shift that minimize the encoded size of the deltas
+  // in the format selected by "hint", encodes them, and sets base_ and
+  // shift_.  Returns the largest delta.
+  uint64 EncodeBaseAndShift(CodingHint hint, Encoder* encoder);
+
+  size_t size_ = 0;
+  uint64 v_or_ = 0, v_and_ = ~0ULL, v_min_ = ~0ULL, v_max_ = 0;
+  uint64 base_ = 0;
+  int shift_ = 0;
+  int len_ = 0;  // Bytes per encoded delta.
+};
+
 // This class represents an encoded vector of S2CellIds.  Values are decoded
 // only when they are accessed.  This allows for very fast initialization and
 // no additional memory use beyond the encoded data.  The encoded data is not
@@ -64,6 +108,10 @@ class EncodedS2CellIdVector {
   // REQUIRES: The Decoder data buffer must outlive this object.
   bool Init(Decoder* decoder);
 
+  // Like Init(Decoder*), but decodes the format written by
+  // EncodeS2CellIdVector() with the given hint.
+  bool Init(Decoder* decoder, CodingHint hint);
+
   // Returns the size of the original vector.
   size_t size() const;
 
@@ -79,9 +127,35 @@ class EncodedS2CellIdVector {
   // Decodes and returns the entire original vector.
   std::vector<S2CellId> Decode() const;
 
+  // Decodes the elements with indices [begin, begin + out.size()) into
+  // "out".  This is faster than calling operator[] for each element.
+  //
+  // REQUIRES: begin + out.size() <= size()
+  void Decode(size_t begin, absl::Span<S2CellId> out) const;
+
   // Copies the encoded byte stream to a new encoder.
   void Encode(Encoder* encoder) const;
 
+  // The following methods treat the vector as the cell ids of an S2CellUnion
+  // and are equivalent to the S2CellUnion methods with the same names.  They
+  // work directly on the encoded data without decoding the whole vector,
+  // using galloping searches to skip over runs of cells that cannot
+  // intersect the other operand.  This makes it cheap to test a query
+  // covering against many stored coverings.
+  //
+  // REQUIRES: The vector elements are sorted and the cells do not overlap
+  //           (e.g., they are the cell ids of a valid S2CellUnion).  The
+  //           same applies to "y" in the methods below.
+  bool Contains(S2CellId id) const;
+  bool Intersects(S2CellId id) const;
+  bool Contains(absl::Span<const S2CellId> y) const;
+  bool Intersects(absl::Span<const S2CellId> y) const;
+
+  // Like S2CellUnion::GetIntersection(), but where the first operand is this
+  // vector.  "out" is cleared first.
+  void GetIntersection(absl::Span<const S2CellId> y,
+                       std::vector<S2CellId>* out) const;
+
  private:
   // Values are decoded as (base_ + (deltas_[i] << shift_)).
   EncodedUintVector<uint64> deltas_;
@@ -17,6 +17,7 @@
 
 #include "s2/encoded_s2cell_id_vector.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 
@@ -25,10 +26,13 @@
 
 #include "s2/base/types.h"
 #include <gtest/gtest.h>
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "s2/util/coding/coder.h"
 #include "s2/mutable_s2shape_index.h"
 #include "s2/s1angle.h"
 #include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
 #include "s2/s2fractal.h"
 #include "s2/s2loop.h"
 #include "s2/s2point.h"
@@ -64,6 +68,37 @@ void TestEncodedS2CellIdVector(const vector<S2CellId>& expected,
   EncodedS2CellIdVector actual = MakeEncodedS2CellIdVector(expected, &encoder);
   EXPECT_EQ(expected_bytes, encoder.length());
   EXPECT_EQ(actual.Decode(), expected);
+  for (size_t begin : {size_t{0}, expected.size() / 2}) {
+    vector<S2CellId> range(expected.size() - begin);
+    actual.Decode(begin, absl::MakeSpan(range));
+    EXPECT_EQ(range, vector<S2CellId>(expected.begin() + begin,
+                                      expected.end()));
+  }
+}
+
+// Like the above, but uses CodingHint::COMPACT.  Also checks lower_bound()
+// and that re-encoding the vector preserves the format.
+void TestCompactEncodedS2CellIdVector(const vector<S2CellId>& expected,
+                                      size_t expected_bytes) {
+  Encoder encoder;
+  EncodeS2CellIdVector(expected, CodingHint::COMPACT, &encoder);
+  EXPECT_EQ(expected_bytes, encoder.length());
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2CellIdVector actual;
+  ASSERT_TRUE(actual.Init(&decoder, CodingHint::COMPACT));
+  EXPECT_EQ(0, decoder.avail());
+  EXPECT_EQ(actual.Decode(), expected);
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i], actual[i]);
+    if (!expected[i].is_valid()) continue;
+    EXPECT_EQ(std::lower_bound(expected.begin(), expected.end(),
+                               expected[i]) - expected.begin(),
+              actual.lower_bound(expected[i]));
+  }
+  Encoder reencoder;
+  actual.Encode(&reencoder);
+  EXPECT_EQ(absl::string_view(encoder.base(), encoder.length()),
+            absl::string_view(reencoder.base(), reencoder.length()));
 }
 
 // Like the above, but accepts a vector<uint64> rather than a vector<S2CellId>.
@@ -208,6 +243,7 @@ TEST(EncodedS2CellIdVector, FractalS2ShapeIndexCells) {
   }
   EXPECT_EQ(966, ids.size());
   TestEncodedS2CellIdVector(ids, 2902);
+  TestCompactEncodedS2CellIdVector(ids, 2059);
 }
 
 TEST(EncodedS2CellIdVector, CoveringCells) {
@@ -247,6 +283,18 @@ TEST(EncodedS2CellIdVector, CoveringCells) {
       0x46caf54000000000};
   EXPECT_EQ(97, ids.size());
   TestEncodedS2CellIdVector(ids, 488);
+  vector<S2CellId> cell_ids;
+  for (uint64 id : ids) cell_ids.push_back(S2CellId(id));
+  TestCompactEncodedS2CellIdVector(cell_ids, 405);
+}
+
+TEST(EncodedS2CellIdVector, CompactSmallVectors) {
+  TestCompactEncodedS2CellIdVector({}, 2);
+  TestCompactEncodedS2CellIdVector({S2CellId::Sentinel()}, 11);
+  TestCompactEncodedS2CellIdVector(
+      {MakeCellIdOrDie("3/0"), MakeCellIdOrDie("3/1"),
+       MakeCellIdOrDie("3/2"), MakeCellIdOrDie("3/3")},
+      7);
 }
 
 TEST(EncodedS2CellIdVector, LowerBoundLimits) {
@@ -265,5 +313,62 @@ TEST(EncodedS2CellIdVector, LowerBoundLimits) {
   EXPECT_EQ(2, cell_ids.lower_bound(S2CellId::Sentinel()));
 }
 
+// Returns a normalized union of random cells that are descendants of
+// "parent", so that unions with the same parent often overlap.
+S2CellUnion MakeRandomUnion(S2CellId parent, int num_cells) {
+  vector<S2CellId> ids;
+  for (int i = 0; i < num_cells; ++i) {
+    S2CellId id = parent;
+    for (int depth = S2Testing::rnd.Uniform(12); depth > 0; --depth) {
+      id = id.child(S2Testing::rnd.Uniform(4));
+    }
+    ids.push_back(id);
+  }
+  return S2CellUnion(std::move(ids));
+}
+
+TEST(EncodedS2CellIdVector, SetOperationsMatchS2CellUnion) {
+  S2Testing::rnd.Reset(1);
+  for (int iter = 0; iter < 200; ++iter) {
+    S2CellId parent = S2Testing::GetRandomCellId(5);
+    S2CellUnion x = MakeRandomUnion(parent, 1 + S2Testing::rnd.Uniform(200));
+    vector<S2CellUnion> ys = {
+        MakeRandomUnion(parent, 1 + S2Testing::rnd.Uniform(20)),
+        MakeRandomUnion(parent.parent(4), 1 + S2Testing::rnd.Uniform(20)),
+        S2CellUnion()};
+    // Also test a subset of "x", which "x" contains.
+    ys.push_back(x.Intersection(ys[0].Union(ys[1])));
+    Encoder encoder;
+    EncodedS2CellIdVector encoded =
+        MakeEncodedS2CellIdVector(x.cell_ids(), &encoder);
+    for (const S2CellUnion& y : ys) {
+      EXPECT_EQ(x.Contains(y), encoded.Contains(y.cell_ids()));
+      EXPECT_EQ(x.Intersects(y), encoded.Intersects(y.cell_ids()));
+      vector<S2CellId> intersection;
+      encoded.GetIntersection(y.cell_ids(), &intersection);
+      EXPECT_EQ(x.Intersection(y).cell_ids(), intersection);
+      for (S2CellId id : y) {
+        EXPECT_EQ(x.Contains(id), encoded.Contains(id));
+        EXPECT_EQ(x.Intersects(id), encoded.Intersects(id));
+      }
+    }
+    EXPECT_TRUE(encoded.Contains(ys.back().cell_ids()));
+  }
+}
+
+TEST(EncodedS2CellIdVector, SetOperationsEmpty) {
+  Encoder encoder;
+  EncodedS2CellIdVector empty = MakeEncodedS2CellIdVector({}, &encoder);
+  vector<S2CellId> y = {S2CellId::FromFace(2)};
+  EXPECT_FALSE(empty.Contains(y[0]));
+  EXPECT_FALSE(empty.Intersects(y[0]));
+  EXPECT_FALSE(empty.Contains(y));
+  EXPECT_TRUE(empty.Contains(vector<S2CellId>{}));
+  EXPECT_FALSE(empty.Intersects(y));
+  vector<S2CellId> intersection = y;
+  empty.GetIntersection(y, &intersection);
+  EXPECT_TRUE(intersection.empty());
+}
+
 }  // namespace
 }  // namespace s2coding
@@ -136,14 +136,27 @@ bool EncodedS2PointVector::Init(Decoder* decoder) {
 }
 
 vector<S2Point> EncodedS2PointVector::Decode() const {
-  vector<S2Point> points;
-  points.reserve(size_);
-  for (size_t i = 0; i < size_; ++i) {
-    points.push_back((*this)[i]);
-  }
+  vector<S2Point> points(size_);
+  Decode(0, MakeSpan(points));
   return points;
 }
 
+void EncodedS2PointVector::Decode(size_t begin, Span<S2Point> out) const {
+  ABSL_DCHECK_LE(begin + out.size(), size_);
+  switch (format_) {
+    case UNCOMPRESSED:
+      std::copy_n(uncompressed_.points + begin, out.size(), out.begin());
+      break;
+
+    case CELL_IDS:
+      DecodeCellIdsFormat(begin, out);
+      break;
+
+    default:
+      ABSL_LOG(FATAL) << "Unknown Format: " << static_cast<int>(format_);
+  }
+}
+
 // The encoding must be identical to EncodeS2PointVector().
 void EncodedS2PointVector::Encode(Encoder* encoder) const {
   switch (format_) {
@@ -818,6 +831,20 @@ bool EncodedS2PointVector::InitCellIdsFormat(Decoder* decoder) {
   return true;
 }
 
+// Converts a 64-bit value (as decoded below) at the given level to an
+// S2Point, where "sj" and "tj" are the deinterleaved bit pairs of the value.
+inline static S2Point CellValueToPoint(uint32 sj, uint32 tj, int level) {
+  int shift = S2CellId::kMaxLevel - level;
+
+  // The S2CellId version of the following code is:
+  //   return S2CellId(((value << 1) | 1) << (2 * shift)).ToPoint();
+  int si = (((sj << 1) | 1) << shift) & 0x7fffffff;
+  int ti = (((tj << 1) | 1) << shift) & 0x7fffffff;
+  int face = ((sj << shift) >> 30) | (((tj << (shift + 1)) >> 29) & 4);
+  return S2::FaceUVtoXYZ(face, S2::STtoUV(S2::SiTitoST(si)),
+                         S2::STtoUV(S2::SiTitoST(ti))).Normalize();
+}
+
 S2Point EncodedS2PointVector::DecodeCellIdsFormat(int i) const {
   // This function inverts the encodings documented above.
 
@@ -860,17 +887,81 @@ S2Point EncodedS2PointVector::DecodeCellIdsFormat(int i) const {
 
   // Otherwise convert the 64-bit value back to an S2Point.
   uint64 value = cell_ids_.base + offset + delta;
-  int shift = S2CellId::kMaxLevel - cell_ids_.level;
-
-  // The S2CellId version of the following code is:
-  //   return S2CellId(((value << 1) | 1) << (2 * shift)).ToPoint();
   uint32 sj, tj;
   DeinterleaveUint32BitPairs(value, &sj, &tj);
-  int si = (((sj << 1) | 1) << shift) & 0x7fffffff;
-  int ti = (((tj << 1) | 1) << shift) & 0x7fffffff;
-  int face = ((sj << shift) >> 30) | (((tj << (shift + 1)) >> 29) & 4);
-  return S2::FaceUVtoXYZ(face, S2::STtoUV(S2::SiTitoST(si)),
-                         S2::STtoUV(S2::SiTitoST(ti))).Normalize();
+  return CellValueToPoint(sj, tj, cell_ids_.level);
+}
+
+void EncodedS2PointVector::DecodeCellIdsFormat(size_t begin,
+                                               Span<S2Point> out) const {
+  // Decode each block (or the part of it that was requested) separately.
+  for (size_t i = 0; i < out.size();) {
+    size_t block_end = ((begin + i) | (kBlockSize - 1)) + 1;
+    size_t n = min(block_end - (begin + i), out.size() - i);
+    DecodeCellIdsBlock(begin + i, out.subspan(i, n));
+    i += n;
+  }
+}
+
+// Like DecodeCellIdsFormat(int), but decodes the points [begin, begin +
+// out.size()), which must all belong to the same block.  The work is split
+// into simple loops over the block so that the deinterleaving of several
+// values can be vectorized by the compiler.
+void EncodedS2PointVector::DecodeCellIdsBlock(size_t begin,
+                                              Span<S2Point> out) const {
+  const size_t block_begin = begin & ~(kBlockSize - 1);
+  ABSL_DCHECK_LE(begin + out.size(), block_begin + kBlockSize);
+
+  // Decode the block header and offset as in DecodeCellIdsFormat(int).
+  const char* ptr = cell_ids_.blocks.GetStart(begin >> kBlockShift);
+  uint8 header = *ptr++;
+  int overlap_nibbles = (header >> 3) & 1;
+  int offset_bytes = (header & 7) + overlap_nibbles;
+  int delta_nibbles = (header >> 4) + 1;
+  uint64 offset = 0;
+  if (offset_bytes > 0) {
+    int offset_shift = (delta_nibbles - overlap_nibbles) << 2;
+    offset = GetUintWithLength<uint64>(ptr, offset_bytes) << offset_shift;
+    ptr += offset_bytes;
+  }
+
+  // Decode the deltas.
+  const int n = out.size();
+  const int first = begin - block_begin;
+  const int delta_bytes = (delta_nibbles + 1) >> 1;
+  const uint64 delta_mask = BitMask(delta_nibbles << 2);
+  uint64 values[kBlockSize];
+  for (int k = 0; k < n; ++k) {
+    int delta_nibble_offset = (first + k) * delta_nibbles;
+    uint64 delta = GetUintWithLength<uint64>(ptr + (delta_nibble_offset >> 1),
+                                             delta_bytes);
+    values[k] = (delta >> ((delta_nibble_offset & 1) << 2)) & delta_mask;
+  }
+
+  // Copy any exceptions, and convert the remaining deltas to values.
+  uint64 value_base = cell_ids_.base + offset;
+  bool is_exception[kBlockSize] = {};
+  if (cell_ids_.have_exceptions) {
+    int block_size = min(kBlockSize, size_ - block_begin);
+    const char* exceptions = ptr + ((block_size * delta_nibbles + 1) >> 1);
+    for (int k = 0; k < n; ++k) {
+      if (values[k] < kBlockSize) {
+        is_exception[k] = true;
+        out[k] = *reinterpret_cast<const S2Point*>(
+            exceptions + values[k] * sizeof(S2Point));
+      }
+    }
+    value_base -= kBlockSize;
+  }
+  uint32 sj[kBlockSize], tj[kBlockSize];
+  for (int k = 0; k < n; ++k) {
+    DeinterleaveUint32BitPairs(value_base + values[k], &sj[k], &tj[k]);
+  }
+  for (int k = 0; k < n; ++k) {
+    if (!is_exception[k]) {
+      out[k] = CellValueToPoint(sj[k], tj[k], cell_ids_.level);
+    }
+  }
 }
 
 }  // namespace s2coding
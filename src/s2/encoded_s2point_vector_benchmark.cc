@@ -0,0 +1,97 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Benchmarks for decoding an EncodedS2PointVector.
+
+#include "s2/encoded_s2point_vector.h"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "s2/util/coding/coder.h"
+#include "s2/s1angle.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2coder.h"
+#include "s2/s2fractal.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2testing.h"
+
+using s2coding::CodingHint;
+using s2coding::EncodedS2PointVector;
+using std::vector;
+
+namespace {
+
+// Encodes the vertices of a fractal loop with approximately "num_points"
+// vertices.  If "snap_level" >= 0, vertices are first snapped to the centers
+// of cells at that level (which allows the COMPACT encoding to be used).
+void EncodeFractalPoints(int num_points, int snap_level, CodingHint hint,
+                         Encoder* encoder) {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(num_points);
+  auto loop = fractal.MakeLoop(S2Testing::GetRandomFrame(),
+                               S1Angle::Degrees(1));
+  vector<S2Point> points(loop->vertices_span().begin(),
+                         loop->vertices_span().end());
+  if (snap_level >= 0) {
+    for (S2Point& p : points) p = S2CellId(p).parent(snap_level).ToPoint();
+  }
+  s2coding::EncodeS2PointVector(points, hint, encoder);
+}
+
+// Decodes all points of an encoded vector with approximately state.range(0)
+// points.  state.range(1) is the snap level (or -1 for unsnapped points).
+void BM_DecodeAll(benchmark::State& state, CodingHint hint) {
+  Encoder encoder;
+  EncodeFractalPoints(state.range(0), state.range(1), hint, &encoder);
+  int num_points = 0;
+  for (auto _ : state) {
+    Decoder decoder(encoder.base(), encoder.length());
+    EncodedS2PointVector points;
+    points.Init(&decoder);
+    vector<S2Point> decoded = points.Decode();
+    num_points = decoded.size();
+    benchmark::DoNotOptimize(decoded.data());
+  }
+  state.SetItemsProcessed(state.iterations() * num_points);
+}
+BENCHMARK_CAPTURE(BM_DecodeAll, Fast, CodingHint::FAST)
+    ->ArgsProduct({{1 << 10, 1 << 16}, {-1}});
+BENCHMARK_CAPTURE(BM_DecodeAll, Compact, CodingHint::COMPACT)
+    ->ArgsProduct({{1 << 10, 1 << 16}, {-1, 20, 30}});
+
+// Decodes individual points of an encoded vector in random order.
+void BM_DecodeRandomAccess(benchmark::State& state) {
+  Encoder encoder;
+  EncodeFractalPoints(state.range(0), state.range(1), CodingHint::COMPACT,
+                      &encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2PointVector points;
+  points.Init(&decoder);
+  vector<int> indices;
+  for (int i = 0; i < 1024; ++i) {
+    indices.push_back(S2Testing::rnd.Uniform(points.size()));
+  }
+  int i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(points[indices[i]]);
+    i = (i + 1) & 1023;
+  }
+}
+BENCHMARK(BM_DecodeRandomAccess)->ArgsProduct({{1 << 10, 1 << 16}, {-1, 20}});
+
+}  // namespace
@@ -29,6 +29,7 @@
 #include "absl/log/absl_check.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "absl/types/span.h"
 
 #include "s2/base/log_severity.h"
 #include "s2/base/types.h"
@@ -71,6 +72,23 @@ size_t TestEncodedS2PointVector(const vector<S2Point>& expected,
   EncodedS2PointVector actual;
   EXPECT_TRUE(actual.Init(&decoder));
   EXPECT_EQ(actual.Decode(), expected);
+
+  // Check that operator[] and decoding ranges that start and end partway
+  // through a block give the same results.
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(actual[i], expected[i]) << i;
+  }
+  const size_t block_size = kBlockSize;
+  for (size_t begin : {size_t{1}, block_size - 1, block_size + 3}) {
+    if (begin >= expected.size()) continue;
+    for (size_t end : {begin + 1, (begin + expected.size() + 1) / 2,
+                       expected.size()}) {
+      vector<S2Point> range(end - begin);
+      actual.Decode(begin, absl::MakeSpan(range));
+      EXPECT_EQ(range, vector<S2Point>(expected.begin() + begin,
+                                       expected.begin() + end));
+    }
+  }
   return encoder.length();
 }
 
@@ -0,0 +1,196 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/encoded_s2polygon.h"
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/log/absl_check.h"
+#include "absl/types/span.h"
+#include "s2/base/commandlineflags.h"
+#include "s2/base/types.h"
+#include "s2/util/coding/coder.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2edge_crosser.h"
+#include "s2/s2latlng_rect.h"
+#include "s2/s2loop_measures.h"
+#include "s2/s2point.h"
+#include "s2/s2point_compression.h"
+#include "s2/s2point_span.h"
+#include "s2/s2pointutil.h"
+#include "s2/s2polygon.h"
+
+S2_DECLARE_int32(s2polygon_decode_max_num_loops);
+S2_DECLARE_int32(s2polygon_decode_max_num_vertices);
+
+// The encoding formats below must match S2Polygon and S2Loop.
+static const unsigned char kUncompressedPolygonVersion = 1;
+static const unsigned char kCompressedPolygonVersion = 4;
+static const unsigned char kUncompressedLoopVersion = 1;
+
+// The bits of the properties of a compressed loop.
+static const uint32 kOriginInsideBit = 1 << 0;
+static const uint32 kBoundEncodedBit = 1 << 1;
+
+bool EncodedS2Polygon::Init(Decoder* decoder) {
+  encoded_ = {};
+  vertices_.clear();
+  loops_.clear();
+  const char* start = decoder->skip(0);
+  if (decoder->avail() < sizeof(unsigned char)) return false;
+  bool success = false;
+  switch (decoder->get8()) {
+    case kUncompressedPolygonVersion:
+      success = DecodeUncompressed(decoder);
+      break;
+    case kCompressedPolygonVersion:
+      success = DecodeCompressed(decoder);
+      break;
+  }
+  if (!success) return false;
+  encoded_ = absl::MakeConstSpan(start, decoder->skip(0) - start);
+  return true;
+}
+
+void EncodedS2Polygon::AddLoop(int begin, int depth, bool origin_inside) {
+  // Like S2Polygon::Decode(), ignore any empty loops that were encoded.
+  const int num_vertices = vertices_.size() - begin;
+  if (num_vertices == 0 || (num_vertices == 1 && !origin_inside)) {
+    vertices_.resize(begin);
+  } else {
+    loops_.push_back(Loop{begin, depth, origin_inside});
+  }
+}
+
+bool EncodedS2Polygon::DecodeUncompressed(Decoder* decoder) {
+  if (decoder->avail() < 2 * sizeof(uint8) + sizeof(uint32)) return false;
+  decoder->get8();  // Ignore obsolete "owns_loops" field.
+  decoder->get8();  // Ignore obsolete "has_holes" field.
+  const uint32 num_loops = decoder->get32();
+  if (num_loops > static_cast<uint32>(
+                      absl::GetFlag(FLAGS_s2polygon_decode_max_num_loops))) {
+    return false;
+  }
+  loops_.reserve(num_loops);
+  for (uint32 i = 0; i < num_loops; ++i) {
+    if (decoder->avail() < sizeof(uint8) + sizeof(uint32)) return false;
+    if (decoder->get8() != kUncompressedLoopVersion) return false;
+    const uint32 num_vertices = decoder->get32();
+    if (num_vertices > static_cast<uint32>(absl::GetFlag(
+                           FLAGS_s2polygon_decode_max_num_vertices))) {
+      return false;
+    }
+    if (decoder->avail() < (num_vertices * sizeof(S2Point) + sizeof(uint8) +
+                            sizeof(uint32))) {
+      return false;
+    }
+    const int begin = vertices_.size();
+    vertices_.resize(begin + num_vertices);
+    decoder->getn(vertices_.data() + begin, num_vertices * sizeof(S2Point));
+    const bool origin_inside = decoder->get8();
+    const int depth = static_cast<int32>(decoder->get32());
+    S2LatLngRect bound;  // The loop bound is not needed.
+    if (!bound.Decode(decoder)) return false;
+    AddLoop(begin, depth, origin_inside);
+  }
+  S2LatLngRect bound;  // Neither is the polygon bound.
+  return bound.Decode(decoder);
+}
+
+bool EncodedS2Polygon::DecodeCompressed(Decoder* decoder) {
+  if (decoder->avail() < sizeof(uint8)) return false;
+  const int snap_level = decoder->get8();
+  if (snap_level > S2CellId::kMaxLevel) return false;
+  uint32 num_loops;
+  if (!decoder->get_varint32(&num_loops)) return false;
+  if (num_loops > static_cast<uint32>(
+                      absl::GetFlag(FLAGS_s2polygon_decode_max_num_loops))) {
+    return false;
+  }
+  loops_.reserve(num_loops);
+  for (uint32 i = 0; i < num_loops; ++i) {
+    uint32 num_vertices;
+    if (!decoder->get_varint32(&num_vertices)) return false;
+    if (num_vertices == 0 ||
+        num_vertices > static_cast<uint32>(absl::GetFlag(
+                           FLAGS_s2polygon_decode_max_num_vertices))) {
+      return false;
+    }
+    const int begin = vertices_.size();
+    vertices_.resize(begin + num_vertices);
+    if (!S2DecodePointsCompressed(
+            decoder, snap_level,
+            absl::MakeSpan(vertices_).subspan(begin, num_vertices))) {
+      return false;
+    }
+    uint32 properties, depth;
+    if (!decoder->get_varint32(&properties)) return false;
+    if (!decoder->get_varint32(&depth)) return false;
+    if (properties & kBoundEncodedBit) {
+      // The loop bound was encoded, but it is not needed.
+      S2LatLngRect bound;
+      if (!bound.Decode(decoder)) return false;
+    }
+    AddLoop(begin, depth, properties & kOriginInsideBit);
+  }
+  return true;
+}
+
+S2PointLoopSpan EncodedS2Polygon::loop_vertices(int i) const {
+  ABSL_DCHECK(i >= 0 && i < num_loops());
+  const int begin = loops_[i].begin;
+  const int end = (i + 1 < num_loops()) ? loops_[i + 1].begin
+                                        : static_cast<int>(vertices_.size());
+  return S2PointLoopSpan(vertices_.data() + begin, end - begin);
+}
+
+double EncodedS2Polygon::GetArea() const {
+  double area = 0;
+  for (int i = 0; i < num_loops(); ++i) {
+    S2PointLoopSpan loop = loop_vertices(i);
+    // S2Loop has its own convention for empty and full loops.
+    double loop_area = (loop.size() == 1)
+                           ? (loops_[i].origin_inside ? 4 * M_PI : 0)
+                           : S2::GetArea(loop);
+    area += (loops_[i].depth & 1) ? -loop_area : loop_area;
+  }
+  return area;
+}
+
+bool EncodedS2Polygon::Contains(const S2Point& p) const {
+  // This is the same algorithm as S2Loop::BruteForceContains().
+  const S2Point origin = S2::Origin();
+  bool inside = false;
+  for (int i = 0; i < num_loops(); ++i) {
+    S2PointLoopSpan loop = loop_vertices(i);
+    bool loop_inside = loops_[i].origin_inside;
+    if (loop.size() >= 3) {
+      S2EdgeCrosser crosser(&origin, &p, &loop[0]);
+      for (size_t j = 1; j <= loop.size(); ++j) {
+        loop_inside ^= crosser.EdgeOrVertexCrossing(&loop[j]);
+      }
+    }
+    inside ^= loop_inside;
+  }
+  return inside;
+}
+
+bool EncodedS2Polygon::Decode(S2Polygon* polygon) const {
+  Decoder decoder(encoded_.data(), encoded_.size());
+  return polygon->Decode(&decoder);
+}
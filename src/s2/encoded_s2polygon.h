@@ -0,0 +1,104 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_ENCODED_S2POLYGON_H_
+#define S2_ENCODED_S2POLYGON_H_
+
+#include <vector>
+
+#include "absl/log/absl_check.h"
+#include "absl/types/span.h"
+#include "s2/util/coding/coder.h"
+#include "s2/s2point.h"
+#include "s2/s2point_span.h"
+#include "s2/s2polygon.h"
+
+// EncodedS2Polygon provides the most common read-only S2Polygon operations on
+// a polygon encoded by S2Polygon::Encode() or S2Polygon::EncodeUncompressed()
+// without constructing an S2Polygon.  Init() decodes only the loop structure
+// and the vertices; it does not create S2Loop objects, compute any bounds, or
+// build any S2ShapeIndex.  This is much faster when many polygons are decoded
+// but only a few simple operations are performed on each one:
+//
+//   EncodedS2Polygon polygon;
+//   if (!polygon.Init(&decoder)) return false;
+//   if (polygon.Contains(point)) { ... }
+//
+// Contains(S2Point) uses brute force, so it takes time proportional to the
+// number of vertices.  For many queries or for other operations, use Decode()
+// to obtain a full S2Polygon.
+//
+// This class is thread-safe.
+class EncodedS2Polygon {
+ public:
+  // Constructs an empty polygon.
+  EncodedS2Polygon() = default;
+
+  // Initializes the polygon from data encoded by S2Polygon::Encode().  The
+  // encoded bytes are kept so that they can be passed to Decode() later, and
+  // therefore must persist until this object is destroyed or re-initialized.
+  // Returns true on success.
+  bool Init(Decoder* decoder);
+
+  int num_loops() const { return loops_.size(); }
+
+  // Returns the total number of vertices in all loops.
+  int num_vertices() const { return vertices_.size(); }
+
+  // Returns the vertices of the given loop.  Like S2Loop, the full loop is
+  // represented by a single vertex.
+  S2PointLoopSpan loop_vertices(int i) const;
+
+  // Returns the depth of the given loop in the nesting hierarchy (see
+  // S2Loop::depth).  Loops with odd depth are holes.
+  int loop_depth(int i) const {
+    ABSL_DCHECK(i >= 0 && i < num_loops());
+    return loops_[i].depth;
+  }
+
+  bool is_empty() const { return loops_.empty(); }
+  bool is_full() const {
+    return num_loops() == 1 && loop_vertices(0).size() == 1;
+  }
+
+  // Returns the same result as S2Polygon::GetArea().
+  double GetArea() const;
+
+  // Returns the same result as S2Polygon::Contains(const S2Point&).
+  bool Contains(const S2Point& p) const;
+
+  // Decodes the full S2Polygon (including its bound and S2ShapeIndex, as
+  // determined by the polygon's indexing mode).  Returns true on success.
+  //
+  // REQUIRES: Init() has succeeded.
+  bool Decode(S2Polygon* polygon) const;
+
+ private:
+  struct Loop {
+    int begin;  // The index of the first vertex in vertices_.
+    int depth;
+    bool origin_inside;
+  };
+
+  bool DecodeUncompressed(Decoder* decoder);
+  bool DecodeCompressed(Decoder* decoder);
+  void AddLoop(int begin, int depth, bool origin_inside);
+
+  absl::Span<const char> encoded_;
+  std::vector<S2Point> vertices_;
+  std::vector<Loop> loops_;
+};
+
+#endif  // S2_ENCODED_S2POLYGON_H_
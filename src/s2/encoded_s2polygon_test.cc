@@ -0,0 +1,141 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/encoded_s2polygon.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "s2/util/coding/coder.h"
+#include "s2/s1angle.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2coder.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2point_span.h"
+#include "s2/s2polygon.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+
+using s2coding::CodingHint;
+using s2textformat::MakePolygonOrDie;
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Encodes "polygon" with the given hint, checks that EncodedS2Polygon
+// returns the same results as S2Polygon, and returns the encoding version.
+int CheckEncodedPolygon(const S2Polygon& polygon, CodingHint hint) {
+  Encoder encoder;
+  polygon.Encode(&encoder, hint);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2Polygon encoded;
+  EXPECT_TRUE(encoded.Init(&decoder));
+  EXPECT_EQ(decoder.avail(), 0);
+
+  EXPECT_EQ(polygon.num_loops(), encoded.num_loops());
+  EXPECT_EQ(polygon.num_vertices(), encoded.num_vertices());
+  EXPECT_EQ(polygon.is_empty(), encoded.is_empty());
+  EXPECT_EQ(polygon.is_full(), encoded.is_full());
+  for (int i = 0; i < polygon.num_loops(); ++i) {
+    EXPECT_EQ(polygon.loop(i)->depth(), encoded.loop_depth(i));
+    S2PointLoopSpan expected = polygon.loop(i)->vertices_span();
+    S2PointLoopSpan actual = encoded.loop_vertices(i);
+    EXPECT_EQ(vector<S2Point>(expected.begin(), expected.end()),
+              vector<S2Point>(actual.begin(), actual.end()));
+  }
+  EXPECT_EQ(polygon.GetArea(), encoded.GetArea());
+  for (int i = 0; i < 100; ++i) {
+    S2Point p = S2Testing::RandomPoint();
+    EXPECT_EQ(polygon.Contains(p), encoded.Contains(p));
+  }
+  // Vertices are a good test of the semi-open boundary model.
+  for (int i = 0; i < polygon.num_loops(); ++i) {
+    for (const S2Point& p : polygon.loop(i)->vertices_span()) {
+      EXPECT_EQ(polygon.Contains(p), encoded.Contains(p));
+    }
+  }
+  S2Polygon decoded;
+  EXPECT_TRUE(encoded.Decode(&decoded));
+  EXPECT_TRUE(polygon.Equals(decoded));
+  return static_cast<unsigned char>(encoder.base()[0]);
+}
+
+TEST(EncodedS2Polygon, EmptyAndFull) {
+  for (auto hint : {CodingHint::FAST, CodingHint::COMPACT}) {
+    CheckEncodedPolygon(S2Polygon(), hint);
+    CheckEncodedPolygon(S2Polygon(make_unique<S2Loop>(S2Loop::kFull())),
+                        hint);
+  }
+}
+
+TEST(EncodedS2Polygon, Uncompressed) {
+  unique_ptr<S2Polygon> polygon = MakePolygonOrDie(
+      "0:0, 0:10, 10:10, 10:0; 2:2, 2:8, 8:8, 8:2; 4:4, 4:6, 6:6, 6:4; "
+      "20:20, 20:21, 21:20");
+  EXPECT_EQ(1, CheckEncodedPolygon(*polygon, CodingHint::FAST));
+  EXPECT_EQ(1, CheckEncodedPolygon(*polygon, CodingHint::COMPACT));
+}
+
+TEST(EncodedS2Polygon, Compressed) {
+  // Loops with at least 64 vertices also encode their bounds.
+  for (int num_vertices : {4, 100}) {
+    const S2Point center = S2Testing::RandomPoint();
+    vector<unique_ptr<S2Loop>> loops;
+    for (double radius : {1.0, 0.5}) {
+      // Vertices snapped to cell centers are encoded compactly.
+      vector<S2Point> vertices = S2Testing::MakeRegularPoints(
+          center, S1Angle::Degrees(radius), num_vertices);
+      for (S2Point& v : vertices) v = S2CellId(v).parent(20).ToPoint();
+      loops.push_back(make_unique<S2Loop>(vertices));
+    }
+    S2Polygon polygon(std::move(loops));
+    EXPECT_EQ(4, CheckEncodedPolygon(polygon, CodingHint::COMPACT));
+  }
+}
+
+TEST(EncodedS2Polygon, InitAdvancesDecoder) {
+  Encoder encoder;
+  MakePolygonOrDie("0:0, 0:1, 1:0")->Encode(&encoder);
+  MakePolygonOrDie("5:5, 5:6, 6:5")->EncodeUncompressed(&encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2Polygon a, b;
+  ASSERT_TRUE(a.Init(&decoder));
+  ASSERT_TRUE(b.Init(&decoder));
+  EXPECT_EQ(decoder.avail(), 0);
+  S2Polygon decoded;
+  ASSERT_TRUE(b.Decode(&decoded));
+  EXPECT_TRUE(decoded.Equals(*MakePolygonOrDie("5:5, 5:6, 6:5")));
+}
+
+TEST(EncodedS2Polygon, TruncatedEncodingFails) {
+  unique_ptr<S2Polygon> polygon = MakePolygonOrDie(
+      "0:0, 0:10, 10:10, 10:0; 2:2, 2:8, 8:8, 8:2");
+  for (auto hint : {CodingHint::FAST, CodingHint::COMPACT}) {
+    Encoder encoder;
+    polygon->Encode(&encoder, hint);
+    for (size_t len = 0; len < encoder.length(); ++len) {
+      Decoder decoder(encoder.base(), len);
+      EncodedS2Polygon encoded;
+      EXPECT_FALSE(encoded.Init(&decoder)) << len;
+    }
+  }
+}
+
+}  // namespace
@@ -17,14 +17,20 @@
 
 #include "s2/encoded_s2shape_index.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "s2/base/casts.h"
+#include "s2/base/port.h"
 #include "s2/base/types.h"
+#include "absl/log/absl_check.h"
+#include "absl/synchronization/mutex.h"
 #include "s2/util/bits/bits.h"
 #include "s2/util/coding/coder.h"
 #include "s2/util/coding/varint.h"
@@ -32,17 +38,95 @@
 #include "s2/encoded_string_vector.h"
 #include "s2/mutable_s2shape_index.h"
 #include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
 #include "s2/s2point.h"
 #include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
+#include "s2/s2telemetry.h"
 
 using std::make_unique;
+using std::min;
+using std::pair;
+using std::shared_ptr;
 using std::unique_ptr;
 using std::vector;
 
+namespace {
+
+// Returns the approximate number of bytes used by a decoded cell.  (Up to two
+// edge ids per clipped shape are stored inline.)
+uint32 CellBytes(const S2ShapeIndexCell& cell) {
+  size_t bytes = sizeof(S2ShapeIndexCell) +
+                 cell.num_clipped() * sizeof(S2ClippedShape);
+  for (const S2ClippedShape& clipped : cell.clipped_shapes()) {
+    if (clipped.num_edges() > 2) bytes += clipped.num_edges() * sizeof(int32);
+  }
+  return bytes;
+}
+
+}  // namespace
+
+EncodedS2ShapeIndex::DecodedCellCache::DecodedCellCache(size_t max_bytes)
+    : max_bytes_(max_bytes) {
+}
+
+EncodedS2ShapeIndex::DecodedCellCache::~DecodedCellCache() {
+  // Every attached index holds a reference to the cache.
+  ABSL_DCHECK(entries_.empty());
+}
+
+size_t EncodedS2ShapeIndex::DecodedCellCache::bytes_used() const {
+  absl::MutexLock l(&mutex_);
+  return bytes_used_;
+}
+
+EncodedS2ShapeIndex::DecodedCellCache::Stats
+EncodedS2ShapeIndex::DecodedCellCache::stats() const {
+  Stats stats;
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  stats.evictions = evictions_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void EncodedS2ShapeIndex::DecodedCellCache::Insert(
+    const EncodedS2ShapeIndex* index, int32 cell, uint32 bytes) {
+  absl::MutexLock l(&mutex_);
+  entries_.push_back(Entry{index, cell, bytes});
+  bytes_used_ += bytes;
+  while (bytes_used_ > max_bytes_) {
+    if (hand_ >= entries_.size()) hand_ = 0;
+    Entry& entry = entries_[hand_];
+    if (entry.index->TestAndClearCellReferenced(entry.cell)) {
+      ++hand_;  // Give the cell a second chance.
+      continue;
+    }
+    entry.index->EvictCell(entry.cell);
+    bytes_used_ -= entry.bytes;
+    evictions_.fetch_add(1, std::memory_order_relaxed);
+    // The hand now points to the entry that was previously last.
+    entry = entries_.back();
+    entries_.pop_back();
+  }
+}
+
+void EncodedS2ShapeIndex::DecodedCellCache::RemoveIndex(
+    const EncodedS2ShapeIndex* index) {
+  absl::MutexLock l(&mutex_);
+  auto it = std::remove_if(entries_.begin(), entries_.end(),
+                           [index, this](const Entry& entry) {
+                             if (entry.index != index) return false;
+                             bytes_used_ -= entry.bytes;
+                             return true;
+                           });
+  entries_.erase(it, entries_.end());
+  if (hand_ >= entries_.size()) hand_ = 0;
+}
+
 S2Shape* EncodedS2ShapeIndex::GetShape(int id) const {
   // This method is called when a shape has not been decoded yet.
   unique_ptr<S2Shape> shape = (*shape_factory_)[id];
+  S2_TELEMETRY_COUNTER_INC("encoded_s2shape_index.shapes_decoded");
   S2Shape* expected = kUndecodedShape();
   if (shapes_[id].compare_exchange_strong(expected, shape.get(),
                                           std::memory_order_acq_rel)) {
@@ -51,7 +135,11 @@ S2Shape* EncodedS2ShapeIndex::GetShape(int id) const {
   return expected;  // Another thread updated shapes_[id] first.
 }
 
-const S2ShapeIndexCell* EncodedS2ShapeIndex::GetCell(int i) const {
+const S2ShapeIndexCell* EncodedS2ShapeIndex::GetCell(int pos) const {
+  // The cell is decoded into its slot, which may be shared with other cells.
+  const int i = cell_slot(pos);
+  if (i < 0) return nullptr;
+
   // memory_order_release ensures that no reads or writes in the current
   // thread can be reordered after this store, and all writes in the current
   // thread are visible to other threads that acquire the same atomic
@@ -70,29 +158,116 @@ const S2ShapeIndexCell* EncodedS2ShapeIndex::GetCell(int i) const {
   //
   // Note that we do still use a lock for the write path to ensure that
   // cells_[i] and cell_decoded(i) are updated together atomically.
-  if (cell_decoded(i)) return cells_[i];
+  DecodedCellCache* cache = decoded_cell_cache_.get();
+  if (cell_decoded(i)) {
+    if (cache != nullptr) {
+      set_cell_referenced(i);
+      cache->hits_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return cells_[i];
+  }
 
   // Decode the cell before acquiring the spinlock in order to minimize the
   // time that the lock is held.
   auto cell = make_unique<S2ShapeIndexCell>();
   Decoder decoder = encoded_cells_.GetDecoder(i);
-  if (!cell->Decode(num_shape_ids(), &decoder)) {
+  if (trusted_data_) {
+    cell->DecodeTrusted(num_shape_ids(), &decoder);
+  } else if (!cell->Decode(num_shape_ids(), &decoder)) {
     return nullptr;
   }
-  // Recheck cell_decoded(i) once we hold the lock in case another thread
-  // has decoded this cell in the meantime.
-  SpinLockHolder l(&cells_lock_);
-  if (cell_decoded(i)) return cells_[i];
+  if (cache != nullptr) cache->misses_.fetch_add(1, std::memory_order_relaxed);
+  S2_TELEMETRY_COUNTER_INC("encoded_s2shape_index.cells_decoded");
+  {
+    // Recheck cell_decoded(i) once we hold the lock in case another thread
+    // has decoded this cell in the meantime.
+    SpinLockHolder l(&cells_lock_);
+    if (cell_decoded(i)) return cells_[i];
 
-  // Update the cell, setting cells_[i] before cell_decoded(i).
-  cells_[i] = cell.get();
-  set_cell_decoded(i);
-  if (cell_cache_.size() < static_cast<size_t>(max_cell_cache_size())) {
-    cell_cache_.push_back(i);
+    // Update the cell, setting cells_[i] before cell_decoded(i).
+    cells_[i] = cell.get();
+    set_cell_decoded(i);
+    if (cell_cache_.size() < static_cast<size_t>(max_cell_cache_size())) {
+      cell_cache_.push_back(i);
+    }
+  }
+  // The cache may evict cells from any index (including this one), so it
+  // must be called without holding cells_lock_.  Note that even if the new
+  // cell is evicted immediately, it remains valid until it is released.
+  if (cache != nullptr) {
+    set_cell_referenced(i);
+    cache->Insert(this, i, CellBytes(*cell));
   }
   return cell.release();  // Ownership has been transferred to cells_.
 }
 
+// Prefetches the cell at position "pos", which means the S2ShapeIndexCell
+// if the cell has already been decoded and its encoding otherwise.
+void EncodedS2ShapeIndex::PrefetchCell(int pos) const {
+  const int i = cell_slot(pos);
+  if (i < 0) return;
+  if (cell_decoded(i)) {
+    S2Prefetch(cells_[i]);
+  } else {
+    S2Prefetch(encoded_cells_.GetStart(i));
+  }
+}
+
+// Prefetches the cells ahead of the current position in the same three
+// stages as MutableS2ShapeIndex::Iterator, except that the clipped shapes
+// and edges of cells that have not been decoded yet are not prefetched
+// (since their encoding was already prefetched by the first stage).
+void EncodedS2ShapeIndex::Iterator::Prefetch() {
+  const int distance = prefetch_distance_;
+  if (num_ahead_ > 0) --num_ahead_;
+  // At most two cells are prefetched per call so that iterators that are
+  // advanced only a few times after each seek do not prefetch many cells
+  // that they never visit.
+  for (int i = 0; i < 2 && num_ahead_ < distance; ++i) {
+    int pos = cell_pos_ + num_ahead_ + 1;
+    if (pos >= num_cells_) break;
+    index_->PrefetchCell(pos);
+    ++num_ahead_;
+  }
+  if (num_ahead_ < distance) return;
+  int mid = index_->cell_slot(cell_pos_ + distance / 2);
+  int near = index_->cell_slot(cell_pos_ + distance / 4);
+  if (mid >= 0 && index_->cell_decoded(mid)) {
+    index_->cells_[mid]->PrefetchClippedShapes();
+  }
+  if (near >= 0 && index_->cell_decoded(near)) {
+    index_->cells_[near]->PrefetchEdges();
+  }
+}
+
+bool EncodedS2ShapeIndex::TestAndClearCellReferenced(int i) const {
+  uint64 mask = 1ULL << (i & 63);
+  return (cells_referenced_[i >> 6].fetch_and(
+              ~mask, std::memory_order_relaxed) & mask) != 0;
+}
+
+void EncodedS2ShapeIndex::EvictCell(int i) const {
+  // Readers that have already seen cell_decoded(i) may still be using the
+  // cell, so it is only freed by ReleaseEvictedCells().
+  SpinLockHolder l(&cells_lock_);
+  ABSL_DCHECK(cell_decoded(i));
+  std::atomic<uint64>* group = &cells_decoded_[i >> 6];
+  uint64 bits = group->load(std::memory_order_relaxed);
+  group->store(bits & ~(1ULL << (i & 63)), std::memory_order_release);
+  evicted_cells_.push_back(cells_[i]);
+}
+
+void EncodedS2ShapeIndex::set_decoded_cell_cache(
+    shared_ptr<DecodedCellCache> cache) {
+  ABSL_DCHECK(cells_ == nullptr) << "Must be called before Init()";
+  decoded_cell_cache_ = std::move(cache);
+}
+
+void EncodedS2ShapeIndex::set_trusted_data(bool trusted_data) {
+  ABSL_DCHECK(cells_ == nullptr) << "Must be called before Init()";
+  trusted_data_ = trusted_data;
+}
+
 EncodedS2ShapeIndex::EncodedS2ShapeIndex() = default;
 
 EncodedS2ShapeIndex::~EncodedS2ShapeIndex() {
@@ -108,7 +283,8 @@ bool EncodedS2ShapeIndex::Init(Decoder* decoder,
   uint64 max_edges_version;
   if (!decoder->get_varint64(&max_edges_version)) return false;
   version_ = max_edges_version & 3;
-  if (version_ != MutableS2ShapeIndex::kCurrentEncodingVersionNumber) {
+  if (!MutableS2ShapeIndex::DecodeEncodingFormat(version_, decoder, &hint_,
+                                                 &deduplicated_cells_)) {
     return false;
   }
   options_.set_max_edges_per_cell(max_edges_version >> 2);
@@ -118,7 +294,12 @@ bool EncodedS2ShapeIndex::Init(Decoder* decoder,
   // initializing all the elements twice.
   shapes_ = vector<AtomicShape>(shape_factory.size());
   shape_factory_ = shape_factory.Clone();
-  if (!cell_ids_.Init(decoder)) return false;
+  if (!cell_ids_.Init(decoder, hint_)) return false;
+  if (!encoded_cells_.Init(decoder, hint_)) return false;
+  if (deduplicated_cells_) {
+    if (!cell_encodings_.Init(decoder, hint_)) return false;
+    if (cell_encodings_.size() != cell_ids_.size()) return false;
+  }
 
   // The cells_ elements are *uninitialized memory*.  Instead we have bit
   // vector (cells_decoded_) to indicate which elements of cells_ are valid.
@@ -138,10 +319,12 @@ bool EncodedS2ShapeIndex::Init(Decoder* decoder,
   // cells_ = make_unique<S2ShapeIndexCell*>[](cell_ids_.size());
   // ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
   //                                NO NO NO
-  cells_.reset(new S2ShapeIndexCell*[cell_ids_.size()]);
-  cells_decoded_ = vector<std::atomic<uint64>>((cell_ids_.size() + 63) >> 6);
-
-  return encoded_cells_.Init(decoder);
+  cells_.reset(new S2ShapeIndexCell*[num_cell_slots()]);
+  cells_decoded_ = vector<std::atomic<uint64>>((num_cell_slots() + 63) >> 6);
+  if (decoded_cell_cache_ != nullptr) {
+    cells_referenced_ = vector<std::atomic<uint64>>(cells_decoded_.size());
+  }
+  return true;
 }
 
 void EncodedS2ShapeIndex::Encode(Encoder* encoder) const {
@@ -149,15 +332,34 @@ void EncodedS2ShapeIndex::Encode(Encoder* encoder) const {
   encoder->Ensure(Varint::kMax64);
   uint64 max_edges = options_.max_edges_per_cell();
   encoder->put_varint64(max_edges << 2 | version_);
+  if (version_ == MutableS2ShapeIndex::kExtendedEncodingVersionNumber) {
+    uint32 flags = 0;
+    if (hint_ == s2coding::CodingHint::COMPACT) {
+      flags |= MutableS2ShapeIndex::kEncodingFlagCompact;
+    }
+    if (deduplicated_cells_) {
+      flags |= MutableS2ShapeIndex::kEncodingFlagDeduplicatedCells;
+    }
+    encoder->Ensure(Varint::kMax32);
+    encoder->put_varint32(flags);
+  }
 
   // And copy the encoded cell ids and cells.
   cell_ids_.Encode(encoder);
   encoded_cells_.Encode(encoder);
+  if (deduplicated_cells_) cell_encodings_.Encode(encoder);
 }
 
 void EncodedS2ShapeIndex::Minimize() {
   if (cells_ == nullptr) return;  // Not initialized yet.
 
+  // This must be done first so that the cache stops evicting our cells.
+  if (decoded_cell_cache_ != nullptr) {
+    decoded_cell_cache_->RemoveIndex(this);
+    for (auto& group : cells_referenced_) {
+      group.store(0, std::memory_order_relaxed);
+    }
+  }
   for (auto& atomic_shape : shapes_) {
     S2Shape* shape = atomic_shape.load(std::memory_order_relaxed);
     if (shape != kUndecodedShape() && shape != nullptr) {
@@ -170,8 +372,15 @@ void EncodedS2ShapeIndex::Minimize() {
     // those cells in cell_cache_ to avoid the cost of scanning the
     // cells_decoded_ vector.  (The cost is only about 1 cycle per 64 cells,
     // but for a huge polygon with 1 million cells that's still 16000 cycles.)
+    //
+    // A cell may appear more than once if it was evicted and then decoded
+    // again, so the bits are cleared individually.
     for (int pos : cell_cache_) {
-      cells_decoded_[pos >> 6].store(0, std::memory_order_relaxed);
+      std::atomic<uint64>* group = &cells_decoded_[pos >> 6];
+      uint64 bits = group->load(std::memory_order_relaxed);
+      uint64 mask = 1ULL << (pos & 63);
+      if ((bits & mask) == 0) continue;
+      group->store(bits & ~mask, std::memory_order_relaxed);
       delete cells_[pos];
     }
   } else {
@@ -188,6 +397,87 @@ void EncodedS2ShapeIndex::Minimize() {
     }
   }
   cell_cache_.clear();
+  ReleaseEvictedCells();
+}
+
+void EncodedS2ShapeIndex::ReleaseEvictedCells() {
+  for (S2ShapeIndexCell* cell : evicted_cells_) delete cell;
+  evicted_cells_.clear();
+}
+
+void EncodedS2ShapeIndex::Warmup(int num_threads) const {
+  DecodeInParallel({{0, static_cast<int>(cell_ids_.size())}},
+                   true /*all_shapes*/, num_threads);
+}
+
+void EncodedS2ShapeIndex::Warmup(const S2CellUnion& region,
+                                 int num_threads) const {
+  // Find the ranges of index cells that intersect each cell of the region.
+  // Since the region is normalized, the ranges are in increasing order and
+  // can only overlap when several region cells share an index cell.
+  vector<pair<int, int>> ranges;
+  for (S2CellId id : region) {
+    int begin = cell_ids_.lower_bound(id.range_min());
+    if (begin > 0 && cell_ids_[begin - 1].contains(id)) --begin;
+    int end = cell_ids_.lower_bound(id.range_max().next());
+    if (!ranges.empty() && begin < ranges.back().second) {
+      begin = ranges.back().second;
+    }
+    if (begin >= end) continue;
+    if (!ranges.empty() && begin == ranges.back().second) {
+      ranges.back().second = end;
+    } else {
+      ranges.emplace_back(begin, end);
+    }
+  }
+  DecodeInParallel(ranges, false /*all_shapes*/, num_threads);
+}
+
+void EncodedS2ShapeIndex::DecodeInParallel(
+    const vector<pair<int, int>>& cell_ranges, bool all_shapes,
+    int num_threads) const {
+  // The work is divided into chunks of cells and shapes, which the threads
+  // claim one at a time so that the load stays balanced even though cells
+  // and shapes vary greatly in size.
+  static constexpr int kCellsPerChunk = 256;
+  static constexpr int kShapesPerChunk = 16;
+  struct Chunk {
+    bool is_shapes;
+    int begin, end;
+  };
+  vector<Chunk> chunks;
+  for (const auto& [begin, end] : cell_ranges) {
+    for (int i = begin; i < end; i += kCellsPerChunk) {
+      chunks.push_back({false, i, min(end, i + kCellsPerChunk)});
+    }
+  }
+  if (all_shapes) {
+    for (int i = 0; i < num_shape_ids(); i += kShapesPerChunk) {
+      chunks.push_back({true, i, min(num_shape_ids(), i + kShapesPerChunk)});
+    }
+  }
+  std::atomic<size_t> next_chunk(0);
+  auto decode_chunks = [this, &chunks, &next_chunk, all_shapes]() {
+    for (size_t c; (c = next_chunk.fetch_add(1)) < chunks.size(); ) {
+      const Chunk& chunk = chunks[c];
+      for (int i = chunk.begin; i < chunk.end; ++i) {
+        if (chunk.is_shapes) {
+          shape(i);
+          continue;
+        }
+        const S2ShapeIndexCell* cell = GetCell(i);
+        if (cell == nullptr || all_shapes) continue;
+        for (const S2ClippedShape& clipped : cell->clipped_shapes()) {
+          shape(clipped.shape_id());
+        }
+      }
+    }
+  };
+  vector<std::thread> threads;
+  num_threads = min<size_t>(num_threads, chunks.size());
+  for (int i = 1; i < num_threads; ++i) threads.emplace_back(decode_chunks);
+  decode_chunks();
+  for (auto& thread : threads) thread.join();
 }
 
 size_t EncodedS2ShapeIndex::SpaceUsed() const {
@@ -195,8 +485,10 @@ size_t EncodedS2ShapeIndex::SpaceUsed() const {
   // memory owned by the allocated S2Shapes (here and in S2ShapeIndex).
   size_t size = sizeof(*this);
   size += shapes_.capacity() * sizeof(std::atomic<S2Shape*>);
-  size += cell_ids_.size() * sizeof(std::atomic<S2ShapeIndexCell*>);  // cells_
+  size += num_cell_slots() * sizeof(S2ShapeIndexCell*);  // cells_
   size += cells_decoded_.capacity() * sizeof(std::atomic<uint64>);
   size += cell_cache_.capacity() * sizeof(int);
+  size += cells_referenced_.capacity() * sizeof(std::atomic<uint64>);
+  size += evicted_cells_.capacity() * sizeof(S2ShapeIndexCell*);
   return size;
 }
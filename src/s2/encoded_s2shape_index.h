@@ -22,16 +22,22 @@
 
 #include <atomic>
 #include <memory>
+#include <utility>
 #include <vector>
 
+#include "s2/base/commandlineflags.h"
 #include "s2/base/types.h"
+#include "absl/base/thread_annotations.h"
 #include "absl/log/absl_check.h"
 #include "absl/strings/cord.h"
+#include "absl/synchronization/mutex.h"
 #include "s2/util/coding/coder.h"
 #include "s2/encoded_s2cell_id_vector.h"
 #include "s2/encoded_string_vector.h"
+#include "s2/encoded_uint_vector.h"
 #include "s2/mutable_s2shape_index.h"
 #include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
 #include "s2/s2point.h"
 #include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
@@ -125,16 +131,106 @@
 // are actively using the index that you must use an external reader-writer
 // lock such as absl::Mutex to guard access to it.  (There is no global state
 // and therefore each index can be guarded independently.)
+//
+// By default decoded cells are kept until Minimize() is called.  Long-running
+// processes that hold many indexes can instead bound the memory used by
+// decoded cells using a DecodedCellCache (see below), which may be shared by
+// any number of indexes.
 class EncodedS2ShapeIndex final : public S2ShapeIndex {
  public:
   using Options = MutableS2ShapeIndex::Options;
   using ShapeFactory = S2ShapeIndex::ShapeFactory;
 
+  // A DecodedCellCache limits the total memory used by the decoded cells of
+  // all the indexes attached to it.  When the limit is exceeded, cells are
+  // evicted one at a time using the CLOCK algorithm: each cell has a
+  // "referenced" bit that is set whenever the cell is accessed, and a clock
+  // hand sweeps over the cached cells clearing these bits and evicting the
+  // first cell whose bit was already clear.  Evicted cells are decoded again
+  // if they are needed later.
+  //
+  // Since queries may hold references to cells while decoding others, the
+  // memory of an evicted cell is not freed immediately.  Instead it is kept
+  // by its index until the next call to ReleaseEvictedCells(), Minimize(),
+  // or Init(), or until the index is destroyed.  Processes should therefore
+  // call ReleaseEvictedCells() periodically on each index at a time when no
+  // other threads are using it (e.g., between requests).
+  //
+  // This class is thread-safe.
+  class DecodedCellCache {
+   public:
+    // Creates a cache that holds at most "max_bytes" of decoded cells.
+    explicit DecodedCellCache(size_t max_bytes);
+    ~DecodedCellCache();
+
+    DecodedCellCache(const DecodedCellCache&) = delete;
+    void operator=(const DecodedCellCache&) = delete;
+
+    size_t max_bytes() const { return max_bytes_; }
+
+    // Returns the approximate number of bytes used by the cells that are
+    // currently in the cache.  This does not include evicted cells that have
+    // not been released yet.
+    size_t bytes_used() const;
+
+    struct Stats {
+      int64 hits = 0;       // Cell accesses that found a decoded cell.
+      int64 misses = 0;     // Cell accesses that needed to decode the cell.
+      int64 evictions = 0;  // Cells evicted to stay within max_bytes().
+    };
+    Stats stats() const;
+
+   private:
+    friend class EncodedS2ShapeIndex;
+
+    struct Entry {
+      const EncodedS2ShapeIndex* index;
+      int32 cell;
+      uint32 bytes;
+    };
+
+    // Adds a newly decoded cell and evicts cells as necessary.
+    // REQUIRES: The index does not hold cells_lock_.
+    void Insert(const EncodedS2ShapeIndex* index, int32 cell, uint32 bytes);
+
+    // Removes all cells of the given index without evicting them.
+    void RemoveIndex(const EncodedS2ShapeIndex* index);
+
+    const size_t max_bytes_;
+    mutable absl::Mutex mutex_;
+    std::vector<Entry> entries_ ABSL_GUARDED_BY(mutex_);
+    size_t hand_ ABSL_GUARDED_BY(mutex_) = 0;
+    size_t bytes_used_ ABSL_GUARDED_BY(mutex_) = 0;
+    std::atomic<int64> hits_{0};
+    std::atomic<int64> misses_{0};
+    std::atomic<int64> evictions_{0};
+  };
+
   // Creates an index that must be initialized by calling Init().
   EncodedS2ShapeIndex();
 
   ~EncodedS2ShapeIndex() override;
 
+  // Attaches a cache that bounds the memory used by decoded cells (see
+  // DecodedCellCache above).  The cache may be shared with other indexes.
+  //
+  // REQUIRES: Init() has not been called yet.
+  void set_decoded_cell_cache(std::shared_ptr<DecodedCellCache> cache);
+  const std::shared_ptr<DecodedCellCache>& decoded_cell_cache() const {
+    return decoded_cell_cache_;
+  }
+
+  // Specifies that the encoded data is known to be valid, e.g. because it
+  // was produced by Encode() in this process or because it is protected by
+  // a checksum that the caller has already verified.  Cells are then decoded
+  // using S2ShapeIndexCell::DecodeTrusted(), which skips all bounds and
+  // consistency checks.  Init() validates the index structure either way,
+  // but the behavior is undefined if the encoded cells are invalid.
+  //
+  // REQUIRES: Init() has not been called yet.
+  void set_trusted_data(bool trusted_data);
+  bool trusted_data() const { return trusted_data_; }
+
   // Initializes the EncodedS2ShapeIndex, returning true on success.
   //
   // This method does not decode the S2Shape objects in the index; this is
@@ -168,6 +264,24 @@ class EncodedS2ShapeIndex final : public S2ShapeIndex {
   // Like all non-const methods, this method is not thread-safe.
   void Minimize() override;
 
+  // Frees the memory of all cells that have been evicted by the
+  // DecodedCellCache since the last call.  All references to cells that
+  // were obtained before calling this method are invalidated.
+  //
+  // Like all non-const methods, this method is not thread-safe.
+  void ReleaseEvictedCells();
+
+  // Decodes all cells and shapes in the index ahead of time using up to
+  // "num_threads" threads, so that subsequent queries do not need to pay for
+  // lazy decoding.  This is intended for warming up an index before it
+  // starts serving requests.  This method may be called concurrently with
+  // the other const methods.
+  void Warmup(int num_threads = 1) const;
+
+  // Like Warmup(), but only decodes the index cells that intersect the given
+  // region and the shapes that those cells refer to.
+  void Warmup(const S2CellUnion& region, int num_threads = 1) const;
+
   class Iterator final : public IteratorBase {
    public:
     // Default constructor; must be followed by a call to Init().
@@ -208,14 +322,33 @@ class EncodedS2ShapeIndex final : public S2ShapeIndex {
       return LocateImpl(*this, target);
     }
 
+    void SeekNear(S2CellId target) override;
+
+    bool LocateNear(const S2Point& target) override {
+      return LocateNearImpl(*this, target);
+    }
+
+    S2CellRelation LocateNear(S2CellId target) override {
+      return LocateNearImpl(*this, target);
+    }
+
     std::unique_ptr<IteratorBase> Clone() const override {
       return std::make_unique<Iterator>(*this);
     }
 
    private:
+    void Prefetch();
+
     const EncodedS2ShapeIndex* index_ = nullptr;
     int32 cell_pos_;  // Current position in the vector of index cells.
     int32 num_cells_;
+
+    // The number of cells ahead of cell_pos_ to prefetch as the iterator is
+    // advanced by Next() (see FLAGS_s2shape_index_prefetch_distance), and
+    // the number that have been prefetched since the iterator was last
+    // positioned.
+    int32 prefetch_distance_ = 0;
+    int32 num_ahead_ = 0;
   };
 
   // Returns the number of bytes currently occupied by the index (including any
@@ -241,11 +374,25 @@ class EncodedS2ShapeIndex final : public S2ShapeIndex {
   };
 
   S2Shape* GetShape(int id) const;
+  int cell_slot(int i) const;
+  int num_cell_slots() const { return encoded_cells_.size(); }
   const S2ShapeIndexCell* GetCell(int i) const;
+  void PrefetchCell(int i) const;
   bool cell_decoded(int i) const;
   void set_cell_decoded(int i) const;
   int max_cell_cache_size() const;
 
+  // Decodes the cells in the given ranges of cell positions [begin, end),
+  // along with the shapes that they refer to.  If "all_shapes" is true then
+  // every shape is decoded instead.
+  void DecodeInParallel(const std::vector<std::pair<int, int>>& cell_ranges,
+                        bool all_shapes, int num_threads) const;
+
+  // Methods used by DecodedCellCache.
+  void set_cell_referenced(int i) const;
+  bool TestAndClearCellReferenced(int i) const;
+  void EvictCell(int i) const;
+
   std::unique_ptr<ShapeFactory> shape_factory_;
 
   // The options specified for this index.
@@ -262,10 +409,23 @@ class EncodedS2ShapeIndex final : public S2ShapeIndex {
   // A vector containing the S2CellIds of each cell in the index.
   s2coding::EncodedS2CellIdVector cell_ids_;
 
-  // A vector containing the encoded contents of each cell in the index.
+  // The hint used to encode cell_ids_ and encoded_cells_.
+  s2coding::CodingHint hint_ = s2coding::CodingHint::FAST;
+
+  // A vector containing the encoded contents of each cell in the index.  If
+  // the index was encoded with deduplicate_cells == true then this is a
+  // dictionary of distinct cell encodings and cell_encodings_ maps each cell
+  // to its entry, otherwise it is indexed by cell position.
+  //
+  // The cells_, cells_decoded_, cells_referenced_, and cell_cache_ fields
+  // below are indexed by "slot", which is the position of a cell's encoding
+  // in this vector (see cell_slot).  This means that the cells that share an
+  // encoding also share a single decoded S2ShapeIndexCell.
   s2coding::EncodedStringVector encoded_cells_;
+  s2coding::EncodedUintVector<uint32> cell_encodings_;
+  bool deduplicated_cells_ = false;
 
-  // A raw array containing the decoded contents of each cell in the index.
+  // A raw array containing the decoded contents of each cell slot.
   // Initially all values are *uninitialized memory*.  The cells_decoded_
   // field below keeps track of which elements are present.
   mutable std::unique_ptr<S2ShapeIndexCell*[]> cells_;
@@ -280,9 +440,22 @@ class EncodedS2ShapeIndex final : public S2ShapeIndex {
   // vector when the number of cells decoded is very small.
   mutable std::vector<int> cell_cache_;
 
-  // Protects all updates to cells_ and cells_decoded_.
+  // Protects all updates to cells_, cells_decoded_, and evicted_cells_.
   mutable SpinLock cells_lock_;
 
+  // The cache that this index's decoded cells are charged to, if any.
+  std::shared_ptr<DecodedCellCache> decoded_cell_cache_;
+
+  // True if the cells should be decoded without validation.
+  bool trusted_data_ = false;
+
+  // A bit vector of the "referenced" bits used by decoded_cell_cache_.  It
+  // is only allocated when a cache is attached.
+  mutable std::vector<std::atomic<uint64>> cells_referenced_;
+
+  // Cells that have been evicted by decoded_cell_cache_ but not freed yet.
+  mutable std::vector<S2ShapeIndexCell*> evicted_cells_;
+
   EncodedS2ShapeIndex(const EncodedS2ShapeIndex&) = delete;
   void operator=(const EncodedS2ShapeIndex&) = delete;
 };
@@ -290,6 +463,10 @@ class EncodedS2ShapeIndex final : public S2ShapeIndex {
 
 //////////////////   Implementation details follow   ////////////////////
 
+inline EncodedS2ShapeIndex::Iterator::Iterator()
+    : cell_pos_(0), num_cells_(0) {
+}
+
 inline EncodedS2ShapeIndex::Iterator::Iterator(
     const EncodedS2ShapeIndex* index, InitialPosition pos) {
   Init(index, pos);
@@ -300,6 +477,8 @@ inline void EncodedS2ShapeIndex::Iterator::Init(
   index_ = index;
   num_cells_ = index->cell_ids_.size();
   cell_pos_ = (pos == BEGIN) ? 0 : num_cells_;
+  prefetch_distance_ = absl::GetFlag(FLAGS_s2shape_index_prefetch_distance);
+  num_ahead_ = 0;
 }
 
 inline S2CellId EncodedS2ShapeIndex::Iterator::id() const {
@@ -320,15 +499,18 @@ inline const S2ShapeIndexCell& EncodedS2ShapeIndex::Iterator::cell() const {
 
 inline void EncodedS2ShapeIndex::Iterator::Begin() {
   cell_pos_ = 0;
+  num_ahead_ = 0;
 }
 
 inline void EncodedS2ShapeIndex::Iterator::Finish() {
   cell_pos_ = num_cells_;
+  num_ahead_ = 0;
 }
 
 inline void EncodedS2ShapeIndex::Iterator::Next() {
   ABSL_DCHECK(!done());
   ++cell_pos_;
+  if (prefetch_distance_ > 0) Prefetch();
 }
 
 inline bool EncodedS2ShapeIndex::Iterator::Prev() {
@@ -336,11 +518,20 @@ inline bool EncodedS2ShapeIndex::Iterator::Prev() {
     return false;
   }
   --cell_pos_;
+  num_ahead_ = 0;
   return true;
 }
 
 inline void EncodedS2ShapeIndex::Iterator::Seek(S2CellId target) {
   cell_pos_ = index_->cell_ids_.lower_bound(target);
+  num_ahead_ = 0;
+}
+
+inline void EncodedS2ShapeIndex::Iterator::SeekNear(S2CellId target) {
+  cell_pos_ = GallopLowerBound(cell_pos_, num_cells_, target, [this](int i) {
+    return index_->cell_ids_[i];
+  });
+  num_ahead_ = 0;
 }
 
 inline std::unique_ptr<EncodedS2ShapeIndex::IteratorBase>
@@ -354,7 +545,15 @@ inline const S2Shape* EncodedS2ShapeIndex::shape(int id) const {
   return GetShape(id);
 }
 
-// Returns true if the given cell has already been decoded.
+// Returns the slot of the cell at position "i" (see encoded_cells_), or -1
+// if the encoding refers to a slot that does not exist.
+inline int EncodedS2ShapeIndex::cell_slot(int i) const {
+  if (!deduplicated_cells_) return i;
+  uint32 slot = cell_encodings_[i];
+  return slot < encoded_cells_.size() ? static_cast<int>(slot) : -1;
+}
+
+// Returns true if the given cell slot has already been decoded.
 inline bool EncodedS2ShapeIndex::cell_decoded(int i) const {
   // cell_decoded(i) uses acquire/release synchronization (see .cc file).
   uint64 group_bits = cells_decoded_[i >> 6].load(std::memory_order_acquire);
@@ -372,6 +571,17 @@ inline void EncodedS2ShapeIndex::set_cell_decoded(int i) const {
   group->store(bits | 1ULL << (i & 63), std::memory_order_release);
 }
 
+// Sets the "referenced" bit used by DecodedCellCache.
+inline void EncodedS2ShapeIndex::set_cell_referenced(int i) const {
+  // Test the bit first to avoid writing to a shared cache line on every
+  // access.  Relaxed ordering is sufficient since the bit is only a hint.
+  std::atomic<uint64>* group = &cells_referenced_[i >> 6];
+  uint64 mask = 1ULL << (i & 63);
+  if ((group->load(std::memory_order_relaxed) & mask) == 0) {
+    group->fetch_or(mask, std::memory_order_relaxed);
+  }
+}
+
 inline int EncodedS2ShapeIndex::max_cell_cache_size() const {
   // The cell cache is sized so that scanning decoded_cells_ in the destructor
   // costs about 30 cycles per decoded cell in the worst case.  (This overhead
@@ -382,7 +592,7 @@ inline int EncodedS2ShapeIndex::max_cell_cache_size() const {
   // takes about 1 cycle per 64 cells to scan encoded_cells_, so that works
   // out to (65536/64) == 1024 cycles.  However this cost is amortized over
   // the 32 cells decoded, which works out to 32 cycles per cell.
-  return cell_ids_.size() >> 11;
+  return num_cell_slots() >> 11;
 }
 
 #endif  // S2_ENCODED_S2SHAPE_INDEX_H_
@@ -26,7 +26,9 @@
 
 #include <gtest/gtest.h>
 #include "absl/base/call_once.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/flags/flag.h"
+#include "absl/flags/reflection.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
 #include "absl/strings/escaping.h"
@@ -40,6 +42,8 @@
 #include "s2/s2builderutil_snap_functions.h"
 #include "s2/s2cap.h"
 #include "s2/s2cell_id.h"
+#include "s2/s2cell_iterator_testing.h"
+#include "s2/s2cell_union.h"
 #include "s2/s2closest_edge_query.h"
 #include "s2/s2coder.h"
 #include "s2/s2contains_point_query.h"
@@ -91,6 +95,7 @@ void TestEncodedS2ShapeIndex(const MutableS2ShapeIndex& expected,
   EXPECT_EQ(expected.options().max_edges_per_cell(),
             actual.options().max_edges_per_cell());
   s2testing::ExpectEqual(expected, actual);
+  TestSeekNear(EncodedS2ShapeIndex::Iterator(&actual));
 
   // Make sure that re-encoding the index gives us back the original bytes.
   Encoder new_encoder;
@@ -281,15 +286,139 @@ TEST(EncodedS2ShapeIndex, SnappedFractalPolylines) {
       index, 8698);
 }
 
+// Checks that the CodingHint::COMPACT version of "expected" is smaller than
+// the default version and that it can be decoded by both EncodedS2ShapeIndex
+// and MutableS2ShapeIndex.
+void TestCompactEncoding(const MutableS2ShapeIndex& expected) {
+  Encoder shapes_encoder;
+  s2shapeutil::EncodeHomogeneousShapes<S2LaxPolygonShape>(expected,
+                                                          &shapes_encoder);
+  Encoder fast, compact;
+  expected.Encode(&fast, s2coding::CodingHint::FAST);
+  expected.Encode(&compact, s2coding::CodingHint::COMPACT);
+  EXPECT_LT(compact.length(), fast.length());
+
+  Encoder encoder;
+  encoder.Ensure(shapes_encoder.length() + compact.length());
+  encoder.putn(shapes_encoder.base(), shapes_encoder.length());
+  encoder.putn(compact.base(), compact.length());
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex actual;
+  ASSERT_TRUE(
+      DecodeHomegeneousShapeIndex<S2LaxPolygonShape>(&actual, &decoder));
+  s2testing::ExpectEqual(expected, actual);
+  TestSeekNear(EncodedS2ShapeIndex::Iterator(&actual));
+
+  // Re-encoding preserves the version.
+  Encoder new_encoder;
+  actual.Encode(&new_encoder);
+  EXPECT_EQ(string(compact.base(), compact.length()),
+            string(new_encoder.base(), new_encoder.length()));
+
+  Decoder mutable_decoder(encoder.base(), encoder.length());
+  MutableS2ShapeIndex mutable_index;
+  ASSERT_TRUE(mutable_index.Init(
+      &mutable_decoder,
+      s2shapeutil::HomogeneousShapeFactory<S2LaxPolygonShape>(
+          &mutable_decoder)));
+  s2testing::ExpectEqual(expected, mutable_index);
+}
+
+TEST(EncodedS2ShapeIndex, CompactEncodingOneLoop) {
+  MutableS2ShapeIndex index;
+  S2Polygon polygon(S2Loop::MakeRegularLoop(S2Point(3, 2, 1).Normalize(),
+                                            S1Angle::Degrees(0.1), 4096));
+  index.Add(make_unique<S2LaxPolygonShape>(polygon));
+  TestCompactEncoding(index);
+}
+
+TEST(EncodedS2ShapeIndex, CompactEncodingManyLoops) {
+  S2Testing::rnd.Reset(1);
+  MutableS2ShapeIndex index;
+  for (int i = 0; i < 100; ++i) {
+    S2Polygon polygon(S2Loop::MakeRegularLoop(
+        S2Testing::RandomPoint(), S1Angle::Degrees(10),
+        4 + S2Testing::rnd.Uniform(500)));
+    index.Add(make_unique<S2LaxPolygonShape>(polygon));
+  }
+  TestCompactEncoding(index);
+}
+
+// Checks that encoding "expected" with deduplicated cells is smaller than
+// the default encoding, that it can be decoded by both EncodedS2ShapeIndex
+// and MutableS2ShapeIndex, and that identical cells are decoded only once.
+void TestDeduplicatedEncoding(const MutableS2ShapeIndex& expected,
+                              s2coding::CodingHint hint) {
+  Encoder shapes_encoder;
+  s2shapeutil::EncodeHomogeneousShapes<S2LaxPolygonShape>(expected,
+                                                          &shapes_encoder);
+  Encoder plain, deduplicated;
+  expected.Encode(&plain, hint);
+  expected.Encode(&deduplicated, hint, /*deduplicate_cells=*/true);
+  EXPECT_LT(deduplicated.length(), plain.length());
+
+  Encoder encoder;
+  encoder.Ensure(shapes_encoder.length() + deduplicated.length());
+  encoder.putn(shapes_encoder.base(), shapes_encoder.length());
+  encoder.putn(deduplicated.base(), deduplicated.length());
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex actual;
+  ASSERT_TRUE(
+      DecodeHomegeneousShapeIndex<S2LaxPolygonShape>(&actual, &decoder));
+  s2testing::ExpectEqual(expected, actual);
+  TestSeekNear(EncodedS2ShapeIndex::Iterator(&actual));
+
+  // Cells with identical encodings share the same decoded cell.
+  int num_cells = 0;
+  absl::flat_hash_set<const S2ShapeIndexCell*> cells;
+  for (EncodedS2ShapeIndex::Iterator it(&actual, S2ShapeIndex::BEGIN);
+       !it.done(); it.Next()) {
+    ++num_cells;
+    cells.insert(&it.cell());
+  }
+  EXPECT_LT(cells.size(), num_cells);
+
+  // Re-encoding preserves the format.
+  Encoder new_encoder;
+  actual.Encode(&new_encoder);
+  EXPECT_EQ(string(deduplicated.base(), deduplicated.length()),
+            string(new_encoder.base(), new_encoder.length()));
+
+  Decoder mutable_decoder(encoder.base(), encoder.length());
+  MutableS2ShapeIndex mutable_index;
+  ASSERT_TRUE(mutable_index.Init(
+      &mutable_decoder,
+      s2shapeutil::HomogeneousShapeFactory<S2LaxPolygonShape>(
+          &mutable_decoder)));
+  s2testing::ExpectEqual(expected, mutable_index);
+}
+
+TEST(EncodedS2ShapeIndex, DeduplicatedCells) {
+  // Deduplication pays off when most cells are interior cells, since the
+  // interior cells between each pair of nested loops have the same encoding.
+  MutableS2ShapeIndex index;
+  for (int i = 0; i < 3; ++i) {
+    S2Polygon polygon(S2Loop::MakeRegularLoop(
+        S2Point(3, 2, 1).Normalize(), S1Angle::Degrees(10 + 10 * i), 2000));
+    index.Add(make_unique<S2LaxPolygonShape>(polygon));
+  }
+  TestDeduplicatedEncoding(index, s2coding::CodingHint::FAST);
+  TestDeduplicatedEncoding(index, s2coding::CodingHint::COMPACT);
+}
+
 // A test that repeatedly minimizes "index_" in one thread and then reads the
 // index_ concurrently from several other threads.  When all threads have
 // finished reading, the first thread minimizes the index again.
 //
 // Note that Minimize() is non-const and therefore does not need to be tested
 // concurrently with the const methods.
+//
+// If a DecodedCellCache is given, cells are also evicted concurrently and the
+// write operation releases the evicted cells instead.
 class LazyDecodeTest : public s2testing::ReaderWriterTest {
  public:
-  LazyDecodeTest() {
+  explicit LazyDecodeTest(
+      std::shared_ptr<EncodedS2ShapeIndex::DecodedCellCache> cache = nullptr) {
     // We generate one shape per dimension.  Each shape has vertices uniformly
     // distributed across the sphere, and the vertices for each dimension are
     // different.  Having fewer cells in the index is more likely to trigger
@@ -318,12 +447,17 @@ class LazyDecodeTest : public s2testing::ReaderWriterTest {
     encoded_.assign(encoder.base(), encoder.length());
 
     Decoder decoder(encoded_.data(), encoded_.size());
+    index_.set_decoded_cell_cache(std::move(cache));
     ABSL_CHECK(
         index_.Init(&decoder, s2shapeutil::LazyDecodeShapeFactory(&decoder)));
   }
 
   void WriteOp() override {
-    index_.Minimize();
+    if (index_.decoded_cell_cache() != nullptr) {
+      index_.ReleaseEvictedCells();
+    } else {
+      index_.Minimize();
+    }
   }
 
   void ReadOp() override {
@@ -339,6 +473,78 @@ class LazyDecodeTest : public s2testing::ReaderWriterTest {
   EncodedS2ShapeIndex index_;
 };
 
+TEST(EncodedS2ShapeIndex, TrustedData) {
+  // Check that cells decoded without validation match the original index,
+  // both for a single shape and for many overlapping shapes (which use
+  // different cell encodings).
+  for (int num_shapes : {1, 20}) {
+    S2Testing::rnd.Reset(num_shapes);
+    MutableS2ShapeIndex expected;
+    for (int i = 0; i < num_shapes; ++i) {
+      S2Point center = S2Testing::RandomPoint();
+      int num_edges = 4 + S2Testing::rnd.Uniform(1000);
+      S2Polygon polygon(S2Loop::MakeRegularLoop(
+          center, S1Angle::Degrees(num_shapes == 1 ? 0.1 : 90), num_edges));
+      expected.Add(make_unique<S2LaxPolygonShape>(polygon));
+    }
+    Encoder encoder;
+    s2shapeutil::EncodeHomogeneousShapes<S2LaxPolygonShape>(expected,
+                                                            &encoder);
+    expected.Encode(&encoder);
+    Decoder decoder(encoder.base(), encoder.length());
+    EncodedS2ShapeIndex actual;
+    actual.set_trusted_data(true);
+    EXPECT_TRUE(actual.trusted_data());
+    ASSERT_TRUE(
+        DecodeHomegeneousShapeIndex<EncodedS2LaxPolygonShape>(&actual,
+                                                              &decoder));
+    s2testing::ExpectEqual(expected, actual);
+  }
+}
+
+TEST(EncodedS2ShapeIndex, PrefetchDoesNotAffectIteration) {
+  // Iterates through an index where only some cells have been decoded, using
+  // several prefetch distances and with seeks in between.
+  S2Testing::rnd.Reset(1);
+  MutableS2ShapeIndex expected;
+  for (int i = 0; i < 10; ++i) {
+    S2Polygon polygon(S2Loop::MakeRegularLoop(
+        S2Testing::RandomPoint(), S1Angle::Degrees(20), 200));
+    expected.Add(make_unique<S2LaxPolygonShape>(polygon));
+  }
+  Encoder encoder;
+  s2shapeutil::EncodeHomogeneousShapes<S2LaxPolygonShape>(expected, &encoder);
+  expected.Encode(&encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex actual;
+  ASSERT_TRUE(DecodeHomegeneousShapeIndex<EncodedS2LaxPolygonShape>(
+      &actual, &decoder));
+  int num_cells = 0;
+  for (EncodedS2ShapeIndex::Iterator it(&actual, S2ShapeIndex::BEGIN);
+       !it.done(); it.Next()) {
+    if (++num_cells % 3 == 0) it.cell();
+  }
+  for (int distance : {0, 1, 2, 5, 8, 64}) {
+    absl::FlagSaver fs;
+    absl::SetFlag(&FLAGS_s2shape_index_prefetch_distance, distance);
+    MutableS2ShapeIndex::Iterator expected_it(&expected, S2ShapeIndex::BEGIN);
+    EncodedS2ShapeIndex::Iterator actual_it(&actual, S2ShapeIndex::BEGIN);
+    for (int i = 0; !expected_it.done(); ++i) {
+      ASSERT_EQ(expected_it.id(), actual_it.id());
+      EXPECT_EQ(expected_it.cell().num_edges(), actual_it.cell().num_edges());
+      if (i % 50 == 49) {
+        // Seek backward a few cells, which restarts prefetching.
+        S2CellId target = expected_it.id().prev();
+        expected_it.Seek(target);
+        actual_it.Seek(target);
+      }
+      expected_it.Next();
+      actual_it.Next();
+    }
+    EXPECT_TRUE(actual_it.done());
+  }
+}
+
 TEST(EncodedS2ShapeIndex, LazyDecode) {
   // Ensure that lazy decoding is thread-safe.  In other words, make sure that
   // nothing bad happens when multiple threads call "const" methods that cause
@@ -352,6 +558,114 @@ TEST(EncodedS2ShapeIndex, LazyDecode) {
   test.Run(kNumReaders, kIters);
 }
 
+TEST(EncodedS2ShapeIndex, LazyDecodeWithCellCache) {
+  // Like the test above, but with a cache that is small enough so that cells
+  // are constantly evicted while the readers are running.
+  auto cache = std::make_shared<EncodedS2ShapeIndex::DecodedCellCache>(2000);
+  LazyDecodeTest test(cache);
+  test.Run(8, 1000);
+  EXPECT_GT(cache->stats().evictions, 0);
+}
+
+TEST(EncodedS2ShapeIndex, DecodedCellCacheBoundsMemory) {
+  // Two indexes share a cache that can hold only a few of their cells.
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3000);
+  vector<MutableS2ShapeIndex> expected(2);
+  vector<string> encoded;
+  for (MutableS2ShapeIndex& index : expected) {
+    index.Add(make_unique<S2LaxPolygonShape>(S2Polygon(
+        fractal.MakeLoop(S2Testing::GetRandomFrame(), S1Angle::Degrees(5)))));
+    Encoder encoder;
+    ASSERT_TRUE(s2shapeutil::CompactEncodeTaggedShapes(index, &encoder));
+    index.Encode(&encoder);
+    encoded.emplace_back(encoder.base(), encoder.length());
+  }
+  const size_t kMaxBytes = 4096;
+  auto cache =
+      std::make_shared<EncodedS2ShapeIndex::DecodedCellCache>(kMaxBytes);
+  vector<Decoder> decoders;
+  for (const string& data : encoded) {
+    decoders.emplace_back(data.data(), data.size());
+  }
+  vector<EncodedS2ShapeIndex> actual(2);
+  for (int i = 0; i < 2; ++i) {
+    actual[i].set_decoded_cell_cache(cache);
+    ASSERT_TRUE(actual[i].Init(
+        &decoders[i], s2shapeutil::LazyDecodeShapeFactory(&decoders[i])));
+  }
+  for (int iter = 0; iter < 2; ++iter) {
+    for (int i = 0; i < 2; ++i) {
+      s2testing::ExpectEqual(expected[i], actual[i]);
+      EXPECT_LE(cache->bytes_used(), kMaxBytes);
+      S2ClosestEdgeQuery expected_query(&expected[i]);
+      S2ClosestEdgeQuery actual_query(&actual[i]);
+      for (int j = 0; j < 10; ++j) {
+        S2ClosestEdgeQuery::PointTarget target(S2Testing::RandomPoint());
+        EXPECT_EQ(expected_query.GetDistance(&target),
+                  actual_query.GetDistance(&target));
+      }
+      actual[i].ReleaseEvictedCells();
+    }
+  }
+  EncodedS2ShapeIndex::DecodedCellCache::Stats stats = cache->stats();
+  EXPECT_GT(stats.hits, 0);
+  EXPECT_GT(stats.misses, 0);
+  EXPECT_GT(stats.evictions, 0);
+
+  // Minimizing an index removes its cells from the cache.
+  actual[0].Minimize();
+  actual[1].Minimize();
+  EXPECT_EQ(cache->bytes_used(), 0);
+}
+
+TEST(EncodedS2ShapeIndex, Warmup) {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3000);
+  MutableS2ShapeIndex expected;
+  for (int i = 0; i < 3; ++i) {
+    expected.Add(make_unique<S2LaxPolygonShape>(S2Polygon(
+        fractal.MakeLoop(S2Testing::GetRandomFrame(), S1Angle::Degrees(5)))));
+  }
+  Encoder encoder;
+  ASSERT_TRUE(s2shapeutil::CompactEncodeTaggedShapes(expected, &encoder));
+  expected.Encode(&encoder);
+
+  // A cache that never evicts is used to count the cells that are decoded.
+  for (int num_threads : {1, 4}) {
+    auto cache =
+        std::make_shared<EncodedS2ShapeIndex::DecodedCellCache>(1 << 30);
+    Decoder decoder(encoder.base(), encoder.length());
+    EncodedS2ShapeIndex index;
+    index.set_decoded_cell_cache(cache);
+    ASSERT_TRUE(
+        index.Init(&decoder, s2shapeutil::LazyDecodeShapeFactory(&decoder)));
+
+    // Warm up the cells near one of the loops.
+    vector<S2CellId> cap_cells;
+    S2Cap(expected.shape(0)->edge(0).v0, S1Angle::Degrees(1))
+        .GetCellUnionBound(&cap_cells);
+    S2CellUnion region(std::move(cap_cells));
+    index.Warmup(region, num_threads);
+    int num_region_cells = 0;
+    for (EncodedS2ShapeIndex::Iterator it(&index, S2ShapeIndex::BEGIN);
+         !it.done(); it.Next()) {
+      if (region.Intersects(it.id())) ++num_region_cells;
+    }
+    EXPECT_GT(num_region_cells, 0);
+    EXPECT_EQ(cache->stats().misses, num_region_cells);
+
+    // Now warm up everything; afterwards no more cells are decoded.
+    index.Warmup(num_threads);
+    const int64 misses = cache->stats().misses;
+    s2testing::ExpectEqual(expected, index);
+    EXPECT_EQ(cache->stats().misses, misses);
+    EXPECT_EQ(cache->stats().evictions, 0);
+  }
+}
+
 TEST(EncodedS2ShapeIndex, JavaByteCompatibility) {
   MutableS2ShapeIndex expected;
   expected.Add(make_unique<S2Polyline::OwningShape>(
@@ -24,6 +24,7 @@
 #include <vector>
 
 #include "s2/base/types.h"
+#include "absl/log/absl_check.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "s2/util/coding/coder.h"
@@ -40,10 +41,14 @@ namespace s2coding {
 StringVectorEncoder::StringVectorEncoder() = default;
 
 void StringVectorEncoder::Encode(Encoder* encoder) {
+  Encode(encoder, CodingHint::FAST);
+}
+
+void StringVectorEncoder::Encode(Encoder* encoder, CodingHint hint) {
   offsets_.push_back(data_.length());
   // We don't encode the first element of "offsets_", which is always zero.
   EncodeUintVector<uint64>(
-      MakeSpan(offsets_.data() + 1, offsets_.data() + offsets_.size()),
+      MakeSpan(offsets_.data() + 1, offsets_.data() + offsets_.size()), hint,
       encoder);
   encoder->Ensure(data_.length());
   encoder->putn(data_.base(), data_.length());
@@ -55,8 +60,30 @@ void StringVectorEncoder::Encode(Span<const string> v, Encoder* encoder) {
   string_vector.Encode(encoder);
 }
 
+void StringVectorStreamEncoder::AddLength(uint64 length) {
+  ++size_;
+  total_length_ += length;
+}
+
+void StringVectorStreamEncoder::EncodeHeader(Encoder* encoder) {
+  // As in StringVectorEncoder, the offset of the first string (which is
+  // always zero) is not encoded.  The largest offset is the total length.
+  len_ = EncodeUintVectorHeader<uint64>(size_, total_length_, encoder);
+}
+
+void StringVectorStreamEncoder::EncodeOffset(uint64 length, Encoder* encoder) {
+  offset_ += length;
+  ABSL_DCHECK_LE(offset_, total_length_);
+  encoder->Ensure(len_);
+  EncodeUintWithLength<uint64>(offset_, len_, encoder);
+}
+
 bool EncodedStringVector::Init(Decoder* decoder) {
-  if (!offsets_.Init(decoder)) return false;
+  return Init(decoder, CodingHint::FAST);
+}
+
+bool EncodedStringVector::Init(Decoder* decoder, CodingHint hint) {
+  if (!offsets_.Init(decoder, hint)) return false;
   data_ = decoder->skip(0);
   uint64 length = 0;
   for (int i = 0, n = offsets_.size(); i < n; ++i) {
@@ -62,6 +62,11 @@ class StringVectorEncoder {
   //           can be enlarged as necessary by calling Ensure(int).
   void Encode(Encoder* encoder);
 
+  // Like Encode(Encoder*), except that CodingHint::COMPACT bit-packs the
+  // string offsets (see EncodeUintVector).  The result must be decoded
+  // using EncodedStringVector::Init() with the same hint.
+  void Encode(Encoder* encoder, CodingHint hint);
+
   // Encodes a vector of strings in a format that can later be decoded as an
   // EncodedStringVector.
   //
@@ -77,6 +82,33 @@ class StringVectorEncoder {
   Encoder data_;
 };
 
+// Encodes a sequence of strings in the same format as StringVectorEncoder
+// without requiring them to be stored in memory.  The length of each string
+// is passed in twice, in the same order: first to AddLength() and then to
+// EncodeOffset().  The strings themselves are appended after the last offset.
+//
+//   StringVectorStreamEncoder stream;
+//   for (const auto& str : v) stream.AddLength(str.size());
+//   stream.EncodeHeader(encoder);
+//   for (const auto& str : v) stream.EncodeOffset(str.size(), encoder);
+//   for (const auto& str : v) encoder->putn(str.data(), str.size());
+class StringVectorStreamEncoder {
+ public:
+  void AddLength(uint64 length);
+
+  // REQUIRES: "encoder" uses the default constructor, so that its buffer
+  //           can be enlarged as necessary by calling Ensure(int).
+  void EncodeHeader(Encoder* encoder);
+
+  void EncodeOffset(uint64 length, Encoder* encoder);
+
+ private:
+  uint64 size_ = 0;
+  uint64 total_length_ = 0;  // Sum of the lengths passed to AddLength().
+  uint64 offset_ = 0;        // Sum of the lengths passed to EncodeOffset().
+  int len_ = 0;              // Bytes per encoded offset.
+};
+
 // This class represents an encoded vector of strings.  Values are decoded
 // only when they are accessed.  This allows for very fast initialization and
 // no additional memory use beyond the encoded data.  The encoded data is not
@@ -98,6 +130,10 @@ class EncodedStringVector {
   // REQUIRES: The Decoder data buffer must outlive this object.
   bool Init(Decoder* decoder);
 
+  // Like Init(Decoder*), but decodes the format written by
+  // StringVectorEncoder::Encode() with the given hint.
+  bool Init(Decoder* decoder, CodingHint hint);
+
   // Resets the vector to be empty.
   void Clear();
 
@@ -80,4 +80,33 @@ TEST(EncodedStringVectorTest, TwoBigStrings) {
                           110007);
 }
 
+TEST(EncodedStringVectorTest, BitPackedOffsets) {
+  // 300 strings of 1-3 bytes each need 10 bits per offset rather than 16.
+  StringVectorEncoder fast, compact;
+  vector<string> input;
+  for (int i = 0; i < 300; ++i) {
+    input.push_back(string(1 + i % 3, 'a' + i % 26));
+    fast.Add(input.back());
+    compact.Add(input.back());
+  }
+  Encoder fast_encoder, compact_encoder;
+  fast.Encode(&fast_encoder);
+  compact.Encode(&compact_encoder, CodingHint::COMPACT);
+  EXPECT_EQ(978, compact_encoder.length());
+  EXPECT_EQ(1202, fast_encoder.length());
+
+  Decoder decoder(compact_encoder.base(), compact_encoder.length());
+  EncodedStringVector actual;
+  ASSERT_TRUE(actual.Init(&decoder, CodingHint::COMPACT));
+  EXPECT_EQ(0, decoder.avail());
+  ASSERT_EQ(input.size(), actual.size());
+  for (size_t i = 0; i < input.size(); ++i) {
+    EXPECT_EQ(input[i], actual[i]);
+  }
+  Encoder reencoder;
+  actual.Encode(&reencoder);
+  EXPECT_EQ(string_view(compact_encoder.base(), compact_encoder.length()),
+            string_view(reencoder.base(), reencoder.length()));
+}
+
 }  // namespace s2coding
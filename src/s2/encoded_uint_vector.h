@@ -18,6 +18,7 @@
 #ifndef S2_ENCODED_UINT_VECTOR_H_
 #define S2_ENCODED_UINT_VECTOR_H_
 
+#include <algorithm>
 #include <cstddef>
 
 #include <cstdint>
@@ -29,6 +30,7 @@
 #include "absl/log/absl_check.h"
 #include "absl/types/span.h"
 
+#include "s2/s2coder.h"
 #include "s2/util/bits/bits.h"
 #include "s2/util/coding/coder.h"
 #include "s2/util/coding/varint.h"
@@ -45,6 +47,38 @@ namespace s2coding {
 template <class T>
 void EncodeUintVector(absl::Span<const T> v, Encoder* encoder);
 
+// Like EncodeUintVector(), except that CodingHint::COMPACT selects the
+// bit-packed format, where each value uses the minimum number of bits needed
+// to represent the largest value (rather than a whole number of bytes).
+// E.g., values that need 9 bits use 9 bits each rather than 16.  CodingHint::
+// FAST selects the byte-aligned format produced by EncodeUintVector() above.
+//
+// The format is not self-describing, so the vector must be decoded using
+// EncodedUintVector::Init() with the same hint.  (Callers typically record
+// this in a version number.)
+//
+// REQUIRES: T is an unsigned integer type.
+// REQUIRES: 2 <= sizeof(T) <= 8
+// REQUIRES: "encoder" uses the default constructor, so that its buffer
+//           can be enlarged as necessary by calling Ensure(int).
+template <class T>
+void EncodeUintVector(absl::Span<const T> v, CodingHint hint,
+                      Encoder* encoder);
+
+// Like EncodeUintVector(), but only encodes the header, which allows the
+// elements to be encoded later without keeping them all in memory.
+// "max_value" must have the same most significant bit as the largest element
+// (e.g. it may be the largest element itself, or the bitwise OR of all
+// elements).  Returns the number of bytes per element; each element must
+// then be encoded using EncodeUintWithLength() with this length.
+//
+// REQUIRES: T is an unsigned integer type.
+// REQUIRES: 2 <= sizeof(T) <= 8
+// REQUIRES: "encoder" uses the default constructor, so that its buffer
+//           can be enlarged as necessary by calling Ensure(int).
+template <class T>
+int EncodeUintVectorHeader(size_t size, T max_value, Encoder* encoder);
+
 // This class represents an encoded vector of unsigned integers of type T.
 // Values are decoded only when they are accessed.  This allows for very fast
 // initialization and no additional memory use beyond the encoded data.
@@ -76,6 +110,14 @@ class EncodedUintVector {
   // REQUIRES: The Decoder data buffer must outlive this object.
   bool Init(Decoder* decoder);
 
+  // Like Init(Decoder*), but decodes the format that EncodeUintVector()
+  // selects for the given hint (see above).  Init(decoder) is equivalent to
+  // Init(decoder, CodingHint::FAST).
+  bool Init(Decoder* decoder, CodingHint hint);
+
+  // Returns true if this vector uses the bit-packed format.
+  bool bit_packed() const { return bit_packed_; }
+
   // Resets the vector to be empty.
   void Clear();
 
@@ -94,14 +136,39 @@ class EncodedUintVector {
   // Decodes and returns the entire original vector.
   std::vector<T> Decode() const;
 
+  // Decodes the elements with indices [begin, begin + out.size()) into "out".
+  // This is considerably faster than calling operator[] for each element,
+  // since the element length is only dispatched on once.
+  //
+  // REQUIRES: begin + out.size() <= size()
+  void Decode(size_t begin, absl::Span<T> out) const;
+
+  // Copies the encoded byte stream (in its current format) to "encoder".
   void Encode(Encoder* encoder) const;
 
  private:
   template <int length> size_t lower_bound(T target) const;
+  template <int length> void Decode(size_t begin, absl::Span<T> out) const;
+
+  // Returns the index of the first element x such that (x >= target), where
+  // "get(i)" returns element "i".
+  template <class GetFn>
+  size_t LowerBound(T target, GetFn get) const;
+
+  // Returns the bit-packed element that starts at bit "bit", given that the
+  // data has "bytes" bytes.
+  T GetBitPacked(uint64 bit, size_t bytes) const;
+
+  // Returns the number of encoded data bytes.
+  size_t data_bytes() const;
 
   const char* data_;
   uint32 size_;
+
+  // The number of bytes per element, or the number of bits per element when
+  // bit_packed_ is true.
   uint8 len_;
+  bool bit_packed_;
 };
 
 // Encodes an unsigned integer in little-endian format using "length" bytes.
@@ -213,22 +280,88 @@ void EncodeUintVector(absl::Span<const T> v, Encoder* encoder) {
   // Note that we don't allow (len == 0) since this would require an extra bit
   // to encode the length.
 
-  T one_bits = 1;  // Ensures len >= 1.
+  T one_bits = 0;
+  for (auto x : v) one_bits |= x;
+  int len = EncodeUintVectorHeader<T>(v.size(), one_bits, encoder);
+  encoder->Ensure(v.size() * len);
+  for (auto x : v) {
+    EncodeUintWithLength(x, len, encoder);
+  }
+}
+
+template <class T>
+void EncodeUintVector(absl::Span<const T> v, CodingHint hint,
+                      Encoder* encoder) {
+  if (hint == CodingHint::FAST) return EncodeUintVector(v, encoder);
+
+  // The bit-packed encoding is as follows:
+  //
+  //   varint64: (v.size() << 7) | bits
+  //   ceil(v.size() * bits / 8) bytes containing each value in turn, starting
+  //   from the least significant bit of the first byte
+  //
+  // where "bits" (0 to 64) is the number of bits per value.
+  T one_bits = 0;
   for (auto x : v) one_bits |= x;
-  int len = (Bits::FindMSBSetNonZero64(one_bits) >> 3) + 1;
+  int bits = (one_bits == 0) ? 0 : Bits::FindMSBSetNonZero64(one_bits) + 1;
+  size_t bytes = (uint64{v.size()} * bits + 7) >> 3;
+  encoder->Ensure(Varint::kMax64 + bytes);
+  encoder->put_varint64((uint64{v.size()} << 7) | bits);
+  uint64 buffer = 0;  // Bits that have not been written yet.
+  int buffered = 0;   // Always less than 8 between values.
+  for (auto x : v) {
+    uint64 value = x;
+    for (int n = bits; n > 0;) {
+      buffer |= value << buffered;
+      int taken = std::min(n, 64 - buffered);
+      value = (taken == 64) ? 0 : value >> taken;
+      n -= taken;
+      for (buffered += taken; buffered >= 8; buffered -= 8) {
+        encoder->put8(buffer);
+        buffer >>= 8;
+      }
+    }
+  }
+  if (buffered > 0) encoder->put8(buffer);
+}
+
+template <class T>
+int EncodeUintVectorHeader(size_t size, T max_value, Encoder* encoder) {
+  // "| 1" ensures len >= 1.
+  int len = (Bits::FindMSBSetNonZero64(max_value | 1) >> 3) + 1;
   ABSL_DCHECK(len >= 1 && len <= 8);
 
   // Note that the multiplication is optimized into a bit shift.
-  encoder->Ensure(Varint::kMax64 + v.size() * len);
-  uint64 size_len = (uint64{v.size()} * sizeof(T)) | (len - 1);
+  encoder->Ensure(Varint::kMax64);
+  uint64 size_len = (uint64{size} * sizeof(T)) | (len - 1);
   encoder->put_varint64(size_len);
-  for (auto x : v) {
-    EncodeUintWithLength(x, len, encoder);
+  return len;
+}
+
+template <class T>
+bool EncodedUintVector<T>::Init(Decoder* decoder, CodingHint hint) {
+  if (hint == CodingHint::FAST) return Init(decoder);
+  uint64 size_bits;
+  if (!decoder->get_varint64(&size_bits)) return false;
+  uint64 size = size_bits >> 7;
+  int bits = size_bits & 127;
+  if (bits > static_cast<int>(8 * sizeof(T)) ||
+      size > std::numeric_limits<uint32>::max()) {
+    return false;
   }
+  size_ = size;
+  len_ = bits;
+  bit_packed_ = true;
+  size_t bytes = data_bytes();
+  if (decoder->avail() < bytes) return false;
+  data_ = decoder->skip(0);
+  decoder->skip(bytes);
+  return true;
 }
 
 template <class T>
 bool EncodedUintVector<T>::Init(Decoder* decoder) {
+  bit_packed_ = false;
   uint64 size_len;
   if (!decoder->get_varint64(&size_len)) return false;
   size_ = size_len / sizeof(T);  // Optimized into bit shift.
@@ -245,6 +378,32 @@ template <class T>
 void EncodedUintVector<T>::Clear() {
   size_ = 0;
   data_ = nullptr;
+  bit_packed_ = false;
+}
+
+template <class T>
+inline size_t EncodedUintVector<T>::data_bytes() const {
+  if (bit_packed_) return (uint64{size_} * len_ + 7) >> 3;
+  return static_cast<size_t>(size_) * len_;
+}
+
+template <class T>
+inline T EncodedUintVector<T>::GetBitPacked(uint64 bit, size_t bytes) const {
+  // Each value is extracted from a 64-bit little-endian load starting at the
+  // byte that contains its first bit.  A second load is needed only when a
+  // value extends past those 64 bits (i.e., when len_ > 57).  Loads are
+  // shortened near the end of the data so that they never read past it.
+  size_t byte = bit >> 3;
+  int shift = bit & 7;
+  size_t avail = bytes - byte;
+  uint64 word = (avail >= 8) ? ABSL_INTERNAL_UNALIGNED_LOAD64(data_ + byte)
+                             : GetUintWithLength<uint64>(data_ + byte, avail);
+  uint64 value = word >> shift;
+  if (shift + len_ > 64) {
+    value |= uint64{static_cast<uint8>(data_[byte + 8])} << (64 - shift);
+  }
+  if (len_ < 64) value &= (uint64{1} << len_) - 1;
+  return static_cast<T>(value);
 }
 
 template <class T>
@@ -255,12 +414,18 @@ inline size_t EncodedUintVector<T>::size() const {
 template <class T>
 inline T EncodedUintVector<T>::operator[](int i) const {
   ABSL_DCHECK(i >= 0 && i < size_);
+  if (bit_packed_) return GetBitPacked(uint64{i} * len_, data_bytes());
   return GetUintWithLength<T>(data_ + i * len_, len_);
 }
 
 template <class T>
 size_t EncodedUintVector<T>::lower_bound(T target) const {
   static_assert(sizeof(T) & 0xe, "Unsupported integer length");
+  if (bit_packed_) {
+    return LowerBound(target, [this, bytes = data_bytes()](size_t i) {
+      return GetBitPacked(uint64{i} * len_, bytes);
+    });
+  }
   ABSL_DCHECK(len_ >= 1 && len_ <= sizeof(T));
 
   // TODO(ericv): Consider using the unused 28 bits of "len_" to store the
@@ -283,36 +448,80 @@ size_t EncodedUintVector<T>::lower_bound(T target) const {
 
 template <class T> template <int length>
 inline size_t EncodedUintVector<T>::lower_bound(T target) const {
-  size_t lo = 0, hi = size_;
-  while (lo < hi) {
-    size_t mid = (lo + hi) >> 1;
-    T value = GetUintWithLength<T>(data_ + mid * length, length);
-    if (value < target) {
-      lo = mid + 1;
-    } else {
-      hi = mid;
-    }
+  return LowerBound(target, [this](size_t i) {
+    return GetUintWithLength<T>(data_ + i * length, length);
+  });
+}
+
+template <class T> template <class GetFn>
+inline size_t EncodedUintVector<T>::LowerBound(T target, GetFn get) const {
+  // The search range is first narrowed using a binary search without
+  // data-dependent branches (the comparison result only selects the next
+  // "base"), which avoids branch mispredictions.  The last few elements are
+  // then compared all at once; since these comparisons are independent of
+  // each other the compiler can vectorize them.  The invariant is that the
+  // result is within [base, base + n].
+  constexpr size_t kLinearScanSize = 16;
+  size_t base = 0, n = size_;
+  while (n > kLinearScanSize) {
+    size_t half = n >> 1;
+    base = (get(base + half) < target) ? base + half : base;
+    n -= half;
   }
-  return lo;
+  size_t count = 0;
+  for (size_t i = 0; i < n; ++i) count += get(base + i) < target;
+  return base + count;
 }
 
 template <class T>
 std::vector<T> EncodedUintVector<T>::Decode() const {
   std::vector<T> result(size_);
-  for (int i = 0; i < size_; ++i) {
-    result[i] = (*this)[i];
-  }
+  Decode(0, absl::MakeSpan(result));
   return result;
 }
 
+template <class T>
+void EncodedUintVector<T>::Decode(size_t begin, absl::Span<T> out) const {
+  ABSL_DCHECK_LE(begin + out.size(), size_);
+  if (bit_packed_) {
+    const size_t bytes = data_bytes();
+    uint64 bit = uint64{begin} * len_;
+    for (size_t i = 0; i < out.size(); ++i, bit += len_) {
+      out[i] = GetBitPacked(bit, bytes);
+    }
+    return;
+  }
+  switch (len_) {
+    case 1: return Decode<1>(begin, out);
+    case 2: return Decode<2>(begin, out);
+    case 3: return Decode<3>(begin, out);
+    case 4: return Decode<4>(begin, out);
+    case 5: return Decode<5>(begin, out);
+    case 6: return Decode<6>(begin, out);
+    case 7: return Decode<7>(begin, out);
+    default: return Decode<8>(begin, out);
+  }
+}
+
+template <class T> template <int length>
+inline void EncodedUintVector<T>::Decode(size_t begin,
+                                         absl::Span<T> out) const {
+  // "length" is a constant, so each element is decoded using a fixed
+  // sequence of loads that the compiler can unroll and vectorize.
+  const char* ptr = data_ + begin * length;
+  for (size_t i = 0; i < out.size(); ++i) {
+    out[i] = GetUintWithLength<T>(ptr + i * length, length);
+  }
+}
+
 template <class T>
 // The encoding must be identical to StringVectorEncoder::Encode().
 void EncodedUintVector<T>::Encode(Encoder* encoder) const {
-  uint64 size_len = (uint64{size_} * sizeof(T)) | (len_ - 1);
-
-  encoder->Ensure(Varint::kMax64 + size_len);
-  encoder->put_varint64(size_len);
-  encoder->putn(data_, size_ * len_);
+  uint64 header = bit_packed_ ? (uint64{size_} << 7) | len_
+                              : (uint64{size_} * sizeof(T)) | (len_ - 1);
+  encoder->Ensure(Varint::kMax64 + data_bytes());
+  encoder->put_varint64(header);
+  encoder->putn(data_, data_bytes());
 }
 
 }  // namespace s2coding
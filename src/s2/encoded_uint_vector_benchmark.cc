@@ -0,0 +1,113 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Benchmarks comparing the byte-aligned (FAST) and bit-packed (COMPACT)
+// formats of EncodedUintVector.  Each benchmark reports the encoded size in
+// bytes per value as the "bytes_per_value" counter.
+
+#include "s2/encoded_uint_vector.h"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "s2/base/types.h"
+#include "s2/s2coder.h"
+#include "s2/s2testing.h"
+#include "s2/util/coding/coder.h"
+
+using s2coding::CodingHint;
+using s2coding::EncodedUintVector;
+using std::vector;
+
+namespace {
+
+// Encodes state.range(0) sorted values where each value has at most
+// state.range(1) bits, e.g. shape ids or cumulative edge counts.
+void EncodeSortedValues(benchmark::State& state, CodingHint hint,
+                        Encoder* encoder) {
+  const int num_values = state.range(0);
+  const uint32 limit = (uint64{1} << state.range(1)) - 1;
+  vector<uint32> values;
+  for (int i = 0; i < num_values; ++i) {
+    values.push_back(static_cast<uint64>(limit) * i / num_values);
+  }
+  s2coding::EncodeUintVector<uint32>(values, hint, encoder);
+  state.counters["bytes_per_value"] =
+      static_cast<double>(encoder->length()) / num_values;
+}
+
+EncodedUintVector<uint32> MakeVector(const Encoder& encoder,
+                                     CodingHint hint) {
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedUintVector<uint32> v;
+  v.Init(&decoder, hint);
+  return v;
+}
+
+void BM_RandomAccess(benchmark::State& state, CodingHint hint) {
+  Encoder encoder;
+  EncodeSortedValues(state, hint, &encoder);
+  EncodedUintVector<uint32> v = MakeVector(encoder, hint);
+  vector<int> indices;
+  for (int i = 0; i < 1024; ++i) {
+    indices.push_back(S2Testing::rnd.Uniform(v.size()));
+  }
+  int i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(v[indices[i]]);
+    i = (i + 1) & 1023;
+  }
+}
+BENCHMARK_CAPTURE(BM_RandomAccess, Fast, CodingHint::FAST)
+    ->ArgsProduct({{1 << 16}, {9, 17, 32}});
+BENCHMARK_CAPTURE(BM_RandomAccess, Compact, CodingHint::COMPACT)
+    ->ArgsProduct({{1 << 16}, {9, 17, 32}});
+
+void BM_LowerBound(benchmark::State& state, CodingHint hint) {
+  Encoder encoder;
+  EncodeSortedValues(state, hint, &encoder);
+  EncodedUintVector<uint32> v = MakeVector(encoder, hint);
+  const uint32 limit = (uint64{1} << state.range(1)) - 1;
+  vector<uint32> targets;
+  for (int i = 0; i < 1024; ++i) {
+    targets.push_back(S2Testing::rnd.Rand32() % limit);
+  }
+  int i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(v.lower_bound(targets[i]));
+    i = (i + 1) & 1023;
+  }
+}
+BENCHMARK_CAPTURE(BM_LowerBound, Fast, CodingHint::FAST)
+    ->ArgsProduct({{1 << 16}, {9, 17, 32}});
+BENCHMARK_CAPTURE(BM_LowerBound, Compact, CodingHint::COMPACT)
+    ->ArgsProduct({{1 << 16}, {9, 17, 32}});
+
+void BM_DecodeAll(benchmark::State& state, CodingHint hint) {
+  Encoder encoder;
+  EncodeSortedValues(state, hint, &encoder);
+  EncodedUintVector<uint32> v = MakeVector(encoder, hint);
+  for (auto _ : state) {
+    vector<uint32> decoded = v.Decode();
+    benchmark::DoNotOptimize(decoded.data());
+  }
+  state.SetItemsProcessed(state.iterations() * v.size());
+}
+BENCHMARK_CAPTURE(BM_DecodeAll, Fast, CodingHint::FAST)
+    ->ArgsProduct({{1 << 16}, {9, 17, 32}});
+BENCHMARK_CAPTURE(BM_DecodeAll, Compact, CodingHint::COMPACT)
+    ->ArgsProduct({{1 << 16}, {9, 17, 32}});
+
+}  // namespace
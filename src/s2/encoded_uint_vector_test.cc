@@ -26,7 +26,10 @@
 #include "s2/base/types.h"
 #include <gtest/gtest.h>
 #include "absl/log/absl_check.h"
+#include "absl/types/span.h"
+#include "s2/s2coder.h"
 #include "s2/util/coding/coder.h"
+#include "s2/util/coding/varint.h"
 
 using std::vector;
 
@@ -131,6 +134,124 @@ TEST(EncodedUintVector, LowerBound) {
   }
 }
 
+template <class T>
+void TestLowerBoundAndDecodeRange(int bytes_per_value) {
+  // Test sizes on both sides of the linear scan threshold, and with many
+  // repeated values so that lower_bound() must find the first occurrence.
+  for (int num_values : {1, 2, 15, 16, 17, 33, 100, 1000}) {
+    vector<T> v = MakeSortedTestVector<T>(bytes_per_value, num_values);
+    for (int i = 0; i < num_values; i += 3) v[i] = v[i / 2];
+    std::sort(v.begin(), v.end());
+    Encoder encoder;
+    auto actual = MakeEncodedVector(v, &encoder);
+    for (T x : v) {
+      for (T y : {x, static_cast<T>(x - 1), static_cast<T>(x + 1)}) {
+        EXPECT_EQ(std::lower_bound(v.begin(), v.end(), y) - v.begin(),
+                  actual.lower_bound(y));
+      }
+    }
+    for (int begin : {0, num_values / 3, num_values - 1}) {
+      vector<T> decoded(num_values - begin);
+      actual.Decode(begin, absl::MakeSpan(decoded));
+      EXPECT_EQ(decoded, vector<T>(v.begin() + begin, v.end()));
+    }
+  }
+}
+
+TEST(EncodedUintVector, LowerBoundAndDecodeRangeAllLengths) {
+  for (int bytes_per_value = 1; bytes_per_value <= 8; ++bytes_per_value) {
+    TestLowerBoundAndDecodeRange<uint64>(bytes_per_value);
+    if (bytes_per_value <= 4) {
+      TestLowerBoundAndDecodeRange<uint32>(bytes_per_value);
+      if (bytes_per_value <= 2) {
+        TestLowerBoundAndDecodeRange<uint16>(bytes_per_value);
+      }
+    }
+  }
+}
+
+template <class T>
+void TestBitPacked(int bits, int num_values) {
+  ABSL_DCHECK_LE(bits, 8 * sizeof(T));
+  // Note that ~T{0} is promoted to "int" when T is uint16.
+  T limit_value =
+      (bits == 0) ? 0 : static_cast<T>(~T{0}) >> (8 * sizeof(T) - bits);
+  vector<T> v;
+  for (int i = 0; i < num_values; ++i) {
+    v.push_back(limit_value * (static_cast<double>(i) / num_values));
+  }
+  if (num_values > 0) v.back() = limit_value;
+  Encoder encoder;
+  EncodeUintVector<T>(v, CodingHint::COMPACT, &encoder);
+  EXPECT_EQ(encoder.length(),
+            Varint::Length64(uint64{v.size()} << 7 | bits) +
+                (uint64{v.size()} * bits + 7) / 8);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedUintVector<T> actual;
+  ASSERT_TRUE(actual.Init(&decoder, CodingHint::COMPACT));
+  EXPECT_TRUE(actual.bit_packed());
+  ASSERT_EQ(actual.size(), v.size());
+  for (int i = 0; i < num_values; ++i) EXPECT_EQ(actual[i], v[i]);
+  EXPECT_EQ(actual.Decode(), v);
+  for (T x : v) {
+    EXPECT_EQ(std::lower_bound(v.begin(), v.end(), x) - v.begin(),
+              actual.lower_bound(x));
+  }
+
+  // Re-encoding preserves the format.
+  Encoder reencoder;
+  actual.Encode(&reencoder);
+  EXPECT_EQ(std::string(encoder.base(), encoder.length()),
+            std::string(reencoder.base(), reencoder.length()));
+}
+
+TEST(EncodedUintVectorTest, BitPackedAllWidths) {
+  for (int num_values : {0, 1, 7, 100}) {
+    for (int bits = 0; bits <= 64; ++bits) {
+      TestBitPacked<uint64>(bits, num_values);
+      if (bits <= 32) TestBitPacked<uint32>(bits, num_values);
+      if (bits <= 16) TestBitPacked<uint16>(bits, num_values);
+    }
+  }
+}
+
+TEST(EncodedUintVectorTest, BitPackedIsSmaller) {
+  vector<uint32> v;
+  for (uint32 i = 0; i < 100; ++i) v.push_back(5 * i);  // 9 bits each.
+  Encoder fast, compact;
+  EncodeUintVector<uint32>(v, CodingHint::FAST, &fast);
+  EncodeUintVector<uint32>(v, CodingHint::COMPACT, &compact);
+  EXPECT_EQ(fast.length(), 2 + 2 * 100);
+  EXPECT_EQ(compact.length(), 2 + (9 * 100 + 7) / 8);
+
+  // FAST is the original format.
+  Decoder decoder(fast.base(), fast.length());
+  EncodedUintVector<uint32> actual;
+  ASSERT_TRUE(actual.Init(&decoder));
+  EXPECT_FALSE(actual.bit_packed());
+  EXPECT_EQ(actual.Decode(), v);
+}
+
+TEST(EncodedUintVectorTest, BitPackedInvalid) {
+  // Too many bits per value.
+  Encoder encoder;
+  encoder.Ensure(Varint::kMax64);
+  encoder.put_varint64(uint64{1} << 7 | 33);
+  encoder.put32(0);
+  encoder.put32(0);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedUintVector<uint32> actual;
+  EXPECT_FALSE(actual.Init(&decoder, CodingHint::COMPACT));
+
+  // Truncated data.
+  vector<uint16> v(10, 0x1ff);
+  Encoder truncated;
+  EncodeUintVector<uint16>(v, CodingHint::COMPACT, &truncated);
+  Decoder short_decoder(truncated.base(), truncated.length() - 1);
+  EncodedUintVector<uint16> short_actual;
+  EXPECT_FALSE(short_actual.Init(&short_decoder, CodingHint::COMPACT));
+}
+
 TEST(EncodedUintVectorTest, RoundtripEncoding) {
   vector<uint64> values{10, 20, 30, 40};
 
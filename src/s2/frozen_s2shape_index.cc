@@ -0,0 +1,151 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/frozen_s2shape_index.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+
+#include "s2/base/types.h"
+#include "absl/log/absl_check.h"
+#include "s2/util/coding/coder.h"
+#include "s2/util/coding/varint.h"
+#include "s2/encoded_s2cell_id_vector.h"
+#include "s2/encoded_string_vector.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/r2rect.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+
+using std::unique_ptr;
+
+namespace {
+
+// Returns the number of rectangles in cell.edge_run_bounds().
+int NumEdgeRuns(const S2ShapeIndexCell& cell) {
+  int num_runs = 0;
+  for (const S2ClippedShape& clipped : cell.clipped_shapes()) {
+    num_runs += S2ShapeIndexCell::num_edge_runs(clipped);
+  }
+  return num_runs;
+}
+
+}  // namespace
+
+FrozenS2ShapeIndex::FrozenS2ShapeIndex()
+    : max_edges_per_cell_(
+          MutableS2ShapeIndex::Options().max_edges_per_cell()) {
+}
+
+FrozenS2ShapeIndex::FrozenS2ShapeIndex(MutableS2ShapeIndex* index)
+    : FrozenS2ShapeIndex() {
+  Init(index);
+}
+
+FrozenS2ShapeIndex::~FrozenS2ShapeIndex() {
+  Clear();
+}
+
+void FrozenS2ShapeIndex::Clear() {
+  // The edge arrays of non-inline clipped shapes belong to edges_, so we
+  // mark them as empty to prevent ~S2ShapeIndexCell from freeing them.
+  for (int i = 0; i < num_cells(); ++i) {
+    for (S2ClippedShape& clipped : cells_[i].shapes_) {
+      if (!clipped.is_inline()) clipped.num_edges_ = 0;
+    }
+  }
+  cells_.reset();
+  cell_ids_.clear();
+  edges_.clear();
+  shapes_.clear();
+}
+
+void FrozenS2ShapeIndex::Init(MutableS2ShapeIndex* index) {
+  Clear();
+  max_edges_per_cell_ = index->options().max_edges_per_cell();
+
+  // The first pass sizes the arrays exactly so that packing the cells below
+  // never needs to reallocate (which would invalidate the edge pointers).
+  size_t num_index_cells = 0, num_arena_edges = 0;
+  for (MutableS2ShapeIndex::Iterator it(index, S2ShapeIndex::BEGIN);
+       !it.done(); it.Next()) {
+    ++num_index_cells;
+    for (const S2ClippedShape& clipped : it.cell().clipped_shapes()) {
+      if (!clipped.is_inline()) num_arena_edges += clipped.num_edges();
+    }
+  }
+  cell_ids_.reserve(num_index_cells);
+  cells_ = std::make_unique<S2ShapeIndexCell[]>(num_index_cells);
+  edges_.resize(num_arena_edges);
+
+  int32* next_edges = edges_.data();
+  for (MutableS2ShapeIndex::Iterator it(index, S2ShapeIndex::BEGIN);
+       !it.done(); it.Next()) {
+    const S2ShapeIndexCell& src = it.cell();
+    S2ShapeIndexCell* dst = &cells_[cell_ids_.size()];
+    cell_ids_.push_back(it.id());
+    S2ClippedShape* clipped = dst->add_shapes(src.num_clipped());
+    for (const S2ClippedShape& src_clipped : src.clipped_shapes()) {
+      *clipped = src_clipped;
+      if (!clipped->is_inline()) {
+        std::copy_n(src_clipped.edges_, src_clipped.num_edges(), next_edges);
+        clipped->edges_ = next_edges;
+        next_edges += src_clipped.num_edges();
+      }
+      ++clipped;
+    }
+    if (src.edge_run_bounds_ != nullptr) {
+      int num_runs = NumEdgeRuns(src);
+      dst->edge_run_bounds_ = std::make_unique<R2Rect[]>(num_runs);
+      std::copy_n(src.edge_run_bounds_.get(), num_runs,
+                  dst->edge_run_bounds_.get());
+    }
+  }
+  ABSL_DCHECK_EQ(next_edges, edges_.data() + edges_.size());
+
+  // Take ownership of the shapes last, since this also resets "index".
+  shapes_ = index->ReleaseAll();
+}
+
+void FrozenS2ShapeIndex::Encode(Encoder* encoder) const {
+  // This must match MutableS2ShapeIndex::Encode() exactly.
+  encoder->Ensure(Varint::kMax64);
+  uint64 max_edges = max_edges_per_cell_;
+  encoder->put_varint64(max_edges << 2 |
+                        MutableS2ShapeIndex::kCurrentEncodingVersionNumber);
+  s2coding::StringVectorEncoder encoded_cells;
+  for (int i = 0; i < num_cells(); ++i) {
+    cells_[i].Encode(num_shape_ids(), encoded_cells.AddViaEncoder());
+  }
+  s2coding::EncodeS2CellIdVector(cell_ids_, encoder);
+  encoded_cells.Encode(encoder);
+}
+
+size_t FrozenS2ShapeIndex::SpaceUsed() const {
+  size_t size = sizeof(*this);
+  size += shapes_.capacity() * sizeof(unique_ptr<S2Shape>);
+  size += cell_ids_.capacity() * sizeof(S2CellId);
+  size += num_cells() * sizeof(S2ShapeIndexCell);
+  for (int i = 0; i < num_cells(); ++i) {
+    size += cells_[i].shapes_.capacity() * sizeof(S2ClippedShape);
+    if (cells_[i].edge_run_bounds_ != nullptr) {
+      size += NumEdgeRuns(cells_[i]) * sizeof(R2Rect);
+    }
+  }
+  size += edges_.capacity() * sizeof(int32);
+  return size;
+}
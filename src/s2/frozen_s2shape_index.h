@@ -0,0 +1,290 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_FROZEN_S2SHAPE_INDEX_H_
+#define S2_FROZEN_S2SHAPE_INDEX_H_
+
+#include <cstddef>
+
+#include <memory>
+#include <vector>
+
+#include "s2/base/types.h"
+#include "absl/log/absl_check.h"
+#include "s2/util/coding/coder.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2point.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+
+// FrozenS2ShapeIndex is a read-only S2ShapeIndex built from a fully
+// constructed MutableS2ShapeIndex.  MutableS2ShapeIndex keeps its cells in a
+// btree of individually allocated S2ShapeIndexCells so that it can be updated
+// incrementally, but once no further updates are needed this layout costs a
+// pointer dereference (and usually a cache miss) for every tree level and
+// every cell visited.  FrozenS2ShapeIndex instead stores
+//
+//  - the S2CellIds of all cells in a single sorted array,
+//  - the cells themselves in a single array parallel to the first, and
+//  - the edge ids of all clipped shapes that don't fit inline in a single
+//    flat arena shared by all cells.
+//
+// Seek() and Locate() use a branch-free binary search over the cell id
+// array, and iterating through the index visits the cells sequentially in
+// memory.  This makes FrozenS2ShapeIndex a good choice for indexes that are
+// built once and then queried many times, e.g. reference geometry that is
+// loaded at startup and served to many threads.
+//
+// Example usage:
+//
+//   MutableS2ShapeIndex builder;
+//   for (auto& shape : shapes) builder.Add(std::move(shape));
+//   FrozenS2ShapeIndex index(&builder);  // Takes ownership of the shapes.
+//   S2ClosestEdgeQuery query(&index);
+//   ...
+//
+// The encoding produced by Encode() is identical to that of the
+// MutableS2ShapeIndex it was built from, so it can be decoded using either
+// MutableS2ShapeIndex::Init() or EncodedS2ShapeIndex::Init().
+//
+// This class is thread-compatible; since it has no non-const methods other
+// than Init() and Minimize(), it may be queried concurrently from any number
+// of threads once it has been initialized.
+class FrozenS2ShapeIndex final : public S2ShapeIndex {
+ public:
+  // Creates an empty index.  Init() may be called to populate it.
+  FrozenS2ShapeIndex();
+
+  // Convenience constructor that calls Init().
+  explicit FrozenS2ShapeIndex(MutableS2ShapeIndex* index);
+
+  FrozenS2ShapeIndex(const FrozenS2ShapeIndex&) = delete;
+  FrozenS2ShapeIndex& operator=(const FrozenS2ShapeIndex&) = delete;
+
+  ~FrozenS2ShapeIndex() override;
+
+  // Builds this index from the given MutableS2ShapeIndex (building "index"
+  // first if necessary) and takes ownership of all of its shapes, after
+  // which "index" is reset to its original empty state.  Shape ids are
+  // preserved, including those of shapes that have been removed (for which
+  // shape(id) returns nullptr).  Any existing contents of this index are
+  // discarded.
+  //
+  // REQUIRES: No snapshots of "index" are still in use, since snapshots do
+  //           not own their shapes (see MutableS2ShapeIndex::NewSnapshot).
+  void Init(MutableS2ShapeIndex* index);
+
+  // The maximum number of edges per cell of the index this index was built
+  // from.  This value is recorded by Encode().
+  int max_edges_per_cell() const { return max_edges_per_cell_; }
+
+  // Returns the number of index cells.
+  int num_cells() const { return static_cast<int>(cell_ids_.size()); }
+
+  // The number of distinct shape ids that have been assigned.  This equals
+  // the number of shapes in the index provided that no shapes were removed
+  // from the original MutableS2ShapeIndex.
+  int num_shape_ids() const override {
+    return static_cast<int>(shapes_.size());
+  }
+
+  // Returns a pointer to the shape with the given id, or nullptr if the shape
+  // was removed from the original index.
+  const S2Shape* shape(int id) const override { return shapes_[id].get(); }
+
+  // Appends an encoded representation of the index to "encoder" in the same
+  // format as MutableS2ShapeIndex::Encode().  As with that method, the
+  // shapes themselves must be encoded separately.
+  void Encode(Encoder* encoder) const override;
+
+  // Returns the number of bytes currently occupied by the index (including
+  // any unused space at the end of vectors, etc).
+  size_t SpaceUsed() const override;
+
+  // FrozenS2ShapeIndex has no data structures that can be rebuilt, so this
+  // method does nothing.
+  void Minimize() override {}
+
+  class Iterator final : public IteratorBase {
+   public:
+    // Default constructor; must be followed by a call to Init().
+    Iterator() = default;
+
+    // Constructs an iterator positioned as specified.  By default iterators
+    // are unpositioned, since this avoids an extra seek in this situation
+    // where one of the seek methods (such as Locate) is immediately called.
+    //
+    // If you want to position the iterator at the beginning, e.g. in order to
+    // loop through the entire index, do this instead:
+    //
+    //   for (FrozenS2ShapeIndex::Iterator it(&index, S2ShapeIndex::BEGIN);
+    //        !it.done(); it.Next()) { ... }
+    explicit Iterator(const FrozenS2ShapeIndex* index,
+                      InitialPosition pos = UNPOSITIONED);
+
+    // Initializes an iterator for the given FrozenS2ShapeIndex.
+    void Init(const FrozenS2ShapeIndex* index,
+              InitialPosition pos = UNPOSITIONED);
+
+    S2CellId id() const override;
+    bool done() const override;
+    const S2ShapeIndexCell& cell() const override;
+
+    // S2CellIterator API:
+    void Begin() override;
+    void Finish() override;
+    void Next() override;
+    bool Prev() override;
+    void Seek(S2CellId target) override;
+
+    bool Locate(const S2Point& target) override {
+      return LocateImpl(*this, target);
+    }
+
+    S2CellRelation Locate(S2CellId target) override {
+      return LocateImpl(*this, target);
+    }
+
+    void SeekNear(S2CellId target) override;
+
+    bool LocateNear(const S2Point& target) override {
+      return LocateNearImpl(*this, target);
+    }
+
+    S2CellRelation LocateNear(S2CellId target) override {
+      return LocateNearImpl(*this, target);
+    }
+
+    std::unique_ptr<IteratorBase> Clone() const override {
+      return std::make_unique<Iterator>(*this);
+    }
+
+   private:
+    const FrozenS2ShapeIndex* index_ = nullptr;
+    int32 cell_pos_ = 0;  // Current position in the vector of index cells.
+    int32 num_cells_ = 0;
+  };
+
+ protected:
+  std::unique_ptr<IteratorBase> NewIterator(InitialPosition pos) const override;
+
+ private:
+  // Returns the position of the first cell whose id is >= "target", or
+  // num_cells() if there is no such cell.
+  int LowerBound(S2CellId target) const;
+
+  // Releases all cells and shapes.
+  void Clear();
+
+  std::vector<std::unique_ptr<S2Shape>> shapes_;
+  int max_edges_per_cell_;
+
+  // The ids of all index cells in increasing order.
+  std::vector<S2CellId> cell_ids_;
+
+  // The contents of each index cell, parallel to cell_ids_.
+  std::unique_ptr<S2ShapeIndexCell[]> cells_;
+
+  // The edge ids of every clipped shape that has too many edges to store
+  // them inline, concatenated in cell order.  The non-inline S2ClippedShapes
+  // in cells_ point into this array rather than owning their own storage.
+  std::vector<int32> edges_;
+};
+
+
+//////////////////   Implementation details follow   ////////////////////
+
+
+inline FrozenS2ShapeIndex::Iterator::Iterator(
+    const FrozenS2ShapeIndex* index, InitialPosition pos) {
+  Init(index, pos);
+}
+
+inline void FrozenS2ShapeIndex::Iterator::Init(
+    const FrozenS2ShapeIndex* index, InitialPosition pos) {
+  index_ = index;
+  num_cells_ = index->num_cells();
+  cell_pos_ = (pos == BEGIN) ? 0 : num_cells_;
+}
+
+inline S2CellId FrozenS2ShapeIndex::Iterator::id() const {
+  if (done()) {
+    return S2CellId::Sentinel();
+  }
+  return index_->cell_ids_[cell_pos_];
+}
+
+inline bool FrozenS2ShapeIndex::Iterator::done() const {
+  return cell_pos_ == num_cells_;
+}
+
+inline const S2ShapeIndexCell& FrozenS2ShapeIndex::Iterator::cell() const {
+  ABSL_DCHECK(!done());
+  return index_->cells_[cell_pos_];
+}
+
+inline void FrozenS2ShapeIndex::Iterator::Begin() {
+  cell_pos_ = 0;
+}
+
+inline void FrozenS2ShapeIndex::Iterator::Finish() {
+  cell_pos_ = num_cells_;
+}
+
+inline void FrozenS2ShapeIndex::Iterator::Next() {
+  ABSL_DCHECK(!done());
+  ++cell_pos_;
+}
+
+inline bool FrozenS2ShapeIndex::Iterator::Prev() {
+  if (cell_pos_ == 0) {
+    return false;
+  }
+  --cell_pos_;
+  return true;
+}
+
+inline void FrozenS2ShapeIndex::Iterator::Seek(S2CellId target) {
+  cell_pos_ = index_->LowerBound(target);
+}
+
+inline void FrozenS2ShapeIndex::Iterator::SeekNear(S2CellId target) {
+  const S2CellId* ids = index_->cell_ids_.data();
+  cell_pos_ = GallopLowerBound(cell_pos_, num_cells_, target,
+                               [ids](int i) { return ids[i]; });
+}
+
+inline std::unique_ptr<FrozenS2ShapeIndex::IteratorBase>
+FrozenS2ShapeIndex::NewIterator(InitialPosition pos) const {
+  return std::make_unique<Iterator>(this, pos);
+}
+
+inline int FrozenS2ShapeIndex::LowerBound(S2CellId target) const {
+  // Each iteration halves the search range using a conditional move rather
+  // than a branch, which avoids the branch mispredictions that dominate the
+  // cost of std::lower_bound on large arrays of random queries.
+  size_t n = cell_ids_.size();
+  if (n == 0) return 0;
+  const S2CellId* base = cell_ids_.data();
+  while (n > 1) {
+    size_t half = n / 2;
+    base = (base[half] < target) ? base + half : base;
+    n -= half;
+  }
+  return static_cast<int>(base - cell_ids_.data()) + (*base < target);
+}
+
+#endif  // S2_FROZEN_S2SHAPE_INDEX_H_
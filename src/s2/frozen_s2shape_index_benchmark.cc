@@ -0,0 +1,116 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Benchmarks comparing point location in FrozenS2ShapeIndex and
+// MutableS2ShapeIndex, with and without seek hints.
+
+#include "s2/frozen_s2shape_index.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2fractal.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2shape_index.h"
+#include "s2/s2testing.h"
+
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Returns an index containing a fractal loop with approximately
+// "num_edges" edges.  The loop is owned by the index's shape.
+unique_ptr<MutableS2ShapeIndex> MakeFractalIndex(int num_edges) {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(num_edges);
+  auto index = make_unique<MutableS2ShapeIndex>();
+  index->Add(make_unique<S2Loop::OwningShape>(
+      fractal.MakeLoop(S2Testing::GetRandomFrame(), S1Angle::Degrees(10))));
+  return index;
+}
+
+template <class Index>
+void LocateRandomPoints(const Index& index, benchmark::State& state) {
+  vector<S2Point> points;
+  for (int i = 0; i < 1024; ++i) points.push_back(S2Testing::RandomPoint());
+  typename Index::Iterator it(&index);
+  int i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(it.Locate(points[i++ & 1023]));
+  }
+}
+
+void BM_MutableLocatePoint(benchmark::State& state) {
+  auto index = MakeFractalIndex(state.range(0));
+  index->ForceBuild();
+  LocateRandomPoints(*index, state);
+}
+BENCHMARK(BM_MutableLocatePoint)->Range(1 << 10, 1 << 18);
+
+void BM_FrozenLocatePoint(benchmark::State& state) {
+  auto builder = MakeFractalIndex(state.range(0));
+  FrozenS2ShapeIndex index(builder.get());
+  LocateRandomPoints(index, state);
+}
+BENCHMARK(BM_FrozenLocatePoint)->Range(1 << 10, 1 << 18);
+
+// Locates a batch of points sorted by S2CellId, as is done when joining
+// sorted inputs against an index.  state.range(1) selects LocateNear()
+// rather than Locate().
+template <class Index>
+void LocateSortedPoints(const Index& index, benchmark::State& state) {
+  vector<S2CellId> ids;
+  for (int i = 0; i < 1 << 16; ++i) {
+    ids.push_back(S2Testing::GetRandomCellId(S2CellId::kMaxLevel));
+  }
+  std::sort(ids.begin(), ids.end());
+  vector<S2Point> points;
+  for (S2CellId id : ids) points.push_back(id.ToPoint());
+  bool near = state.range(1);
+  typename Index::Iterator it(&index, S2ShapeIndex::BEGIN);
+  for (auto _ : state) {
+    for (const S2Point& point : points) {
+      benchmark::DoNotOptimize(near ? it.LocateNear(point) : it.Locate(point));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * points.size());
+}
+
+void BM_MutableLocateSortedPoints(benchmark::State& state) {
+  auto index = MakeFractalIndex(state.range(0));
+  index->ForceBuild();
+  LocateSortedPoints(*index, state);
+}
+BENCHMARK(BM_MutableLocateSortedPoints)
+    ->ArgsProduct({{1 << 12, 1 << 18}, {0, 1}});
+
+void BM_FrozenLocateSortedPoints(benchmark::State& state) {
+  auto builder = MakeFractalIndex(state.range(0));
+  FrozenS2ShapeIndex index(builder.get());
+  LocateSortedPoints(index, state);
+}
+BENCHMARK(BM_FrozenLocateSortedPoints)
+    ->ArgsProduct({{1 << 12, 1 << 18}, {0, 1}});
+
+}  // namespace
@@ -0,0 +1,166 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/frozen_s2shape_index.h"
+
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+#include "s2/util/coding/coder.h"
+#include "s2/encoded_s2shape_index.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_iterator_testing.h"
+#include "s2/s2closest_edge_query.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2fractal.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2point.h"
+#include "s2/s2polygon.h"
+#include "s2/s2shape_index.h"
+#include "s2/s2shapeutil_coding.h"
+#include "s2/s2shapeutil_testing.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+
+using std::make_unique;
+using std::string;
+using std::unique_ptr;
+
+namespace {
+
+// Returns an index containing points, polylines, and polygons, including a
+// fractal with enough edges that many clipped shapes are not stored inline.
+unique_ptr<MutableS2ShapeIndex> MakeTestIndex() {
+  auto index = s2textformat::MakeIndexOrDie(
+      "0:0 | 1:1 | 2:2 # 3:3, 4:4, 5:5 | 6:6, 7:7 # 10:10, 10:20, 20:20");
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3000);
+  S2Polygon polygon(
+      fractal.MakeLoop(S2Testing::GetRandomFrame(), S1Angle::Degrees(5)));
+  index->Add(make_unique<S2LaxPolygonShape>(polygon));
+  return index;
+}
+
+TEST(FrozenS2ShapeIndex, Empty) {
+  MutableS2ShapeIndex expected, builder;
+  FrozenS2ShapeIndex frozen(&builder);
+  EXPECT_EQ(frozen.num_cells(), 0);
+  EXPECT_EQ(frozen.num_shape_ids(), 0);
+  EXPECT_TRUE(FrozenS2ShapeIndex::Iterator(&frozen, S2ShapeIndex::BEGIN)
+                  .done());
+  s2testing::ExpectEqual(expected, frozen);
+}
+
+TEST(FrozenS2ShapeIndex, MatchesMutableIndex) {
+  auto expected = MakeTestIndex();
+  auto builder = MakeTestIndex();
+  FrozenS2ShapeIndex frozen(builder.get());
+  EXPECT_EQ(builder->num_shape_ids(), 0);
+  EXPECT_GT(frozen.num_cells(), 0);
+  EXPECT_EQ(frozen.max_edges_per_cell(),
+            expected->options().max_edges_per_cell());
+  s2testing::ExpectEqual(*expected, frozen);
+
+  // Queries should give identical results.
+  S2ClosestEdgeQuery expected_query(expected.get());
+  S2ClosestEdgeQuery actual_query(&frozen);
+  auto expected_contains = MakeS2ContainsPointQuery(expected.get());
+  auto actual_contains = MakeS2ContainsPointQuery(&frozen);
+  for (int i = 0; i < 100; ++i) {
+    S2Point point = S2Testing::RandomPoint();
+    S2ClosestEdgeQuery::PointTarget target(point);
+    EXPECT_EQ(expected_query.GetDistance(&target),
+              actual_query.GetDistance(&target));
+    EXPECT_EQ(expected_contains.Contains(point),
+              actual_contains.Contains(point));
+  }
+}
+
+TEST(FrozenS2ShapeIndex, SeekAndLocateMatchMutableIndex) {
+  auto expected = MakeTestIndex();
+  auto builder = MakeTestIndex();
+  FrozenS2ShapeIndex frozen(builder.get());
+  MutableS2ShapeIndex::Iterator expected_it(expected.get());
+  FrozenS2ShapeIndex::Iterator actual_it(&frozen);
+  for (int i = 0; i < 1000; ++i) {
+    S2CellId id = S2Testing::GetRandomCellId();
+    expected_it.Seek(id);
+    actual_it.Seek(id);
+    EXPECT_EQ(expected_it.id(), actual_it.id());
+    EXPECT_EQ(expected_it.Locate(id), actual_it.Locate(id));
+    EXPECT_EQ(expected_it.id(), actual_it.id());
+
+    S2Point point = S2Testing::RandomPoint();
+    EXPECT_EQ(expected_it.Locate(point), actual_it.Locate(point));
+    EXPECT_EQ(expected_it.id(), actual_it.id());
+  }
+  // Seeking past the last cell and to the first cell.
+  actual_it.Seek(S2CellId::End(S2CellId::kMaxLevel));
+  EXPECT_TRUE(actual_it.done());
+  actual_it.Seek(S2CellId::Begin(S2CellId::kMaxLevel));
+  EXPECT_EQ(actual_it.id(),
+            MutableS2ShapeIndex::Iterator(expected.get(), S2ShapeIndex::BEGIN)
+                .id());
+  TestSeekNear(actual_it);
+}
+
+TEST(FrozenS2ShapeIndex, RemovedShapesKeepTheirIds) {
+  auto builder =
+      s2textformat::MakeIndexOrDie("0:0 # 1:1, 2:2 # 3:3, 3:4, 4:3");
+  builder->Release(1);
+  FrozenS2ShapeIndex frozen(builder.get());
+  ASSERT_EQ(frozen.num_shape_ids(), 3);
+  EXPECT_NE(frozen.shape(0), nullptr);
+  EXPECT_EQ(frozen.shape(1), nullptr);
+  EXPECT_EQ(frozen.shape(2)->dimension(), 2);
+}
+
+TEST(FrozenS2ShapeIndex, EncodingMatchesMutableIndex) {
+  auto builder = MakeTestIndex();
+  Encoder expected;
+  builder->Encode(&expected);
+  FrozenS2ShapeIndex frozen(builder.get());
+  Encoder actual;
+  frozen.Encode(&actual);
+  EXPECT_EQ(string(expected.base(), expected.length()),
+            string(actual.base(), actual.length()));
+
+  // The encoding can be decoded by EncodedS2ShapeIndex.
+  Encoder shapes;
+  ASSERT_TRUE(s2shapeutil::CompactEncodeTaggedShapes(frozen, &shapes));
+  Decoder shapes_decoder(shapes.base(), shapes.length());
+  Decoder index_decoder(actual.base(), actual.length());
+  EncodedS2ShapeIndex decoded;
+  ASSERT_TRUE(decoded.Init(
+      &index_decoder, s2shapeutil::LazyDecodeShapeFactory(&shapes_decoder)));
+  s2testing::ExpectEqual(frozen, decoded);
+}
+
+TEST(FrozenS2ShapeIndex, Reinit) {
+  auto expected = s2textformat::MakeIndexOrDie("# # 0:0, 0:1, 1:0");
+  auto first = MakeTestIndex();
+  auto second = s2textformat::MakeIndexOrDie("# # 0:0, 0:1, 1:0");
+  FrozenS2ShapeIndex frozen(first.get());
+  size_t first_space = frozen.SpaceUsed();
+  frozen.Init(second.get());
+  EXPECT_LT(frozen.SpaceUsed(), first_space);
+  s2testing::ExpectEqual(*expected, frozen);
+}
+
+}  // namespace
@@ -62,8 +62,19 @@ int32 IdSetLexicon::AddInternal(vector<int32>* ids) {
     // Singleton sets are represented by their element.
     return (*ids)[0];
   } else {
-    // Canonicalize the set by sorting and removing duplicates.
-    std::sort(ids->begin(), ids->end());
+    // Canonicalize the set by sorting and removing duplicates.  Sets of two
+    // or three elements are very common (e.g., S2Builder edges that were
+    // snapped together), so we sort them without calling std::sort.
+    int32* v = ids->data();
+    if (ids->size() <= 3) {
+      if (v[1] < v[0]) std::swap(v[0], v[1]);
+      if (ids->size() == 3) {
+        if (v[2] < v[1]) std::swap(v[1], v[2]);
+        if (v[1] < v[0]) std::swap(v[0], v[1]);
+      }
+    } else {
+      std::sort(ids->begin(), ids->end());
+    }
     ids->erase(std::unique(ids->begin(), ids->end()), ids->end());
 
     // After eliminating duplicates, we may now have a singleton.
@@ -83,7 +83,9 @@ class IdSetLexicon {
   IdSetLexicon(IdSetLexicon&&);
   IdSetLexicon& operator=(IdSetLexicon&&);
 
-  // Clears all data from the lexicon.
+  // Clears all data from the lexicon.  The memory used by the lexicon is
+  // retained so that it can be refilled without allocating (see
+  // SequenceLexicon::Clear).
   void Clear();
 
   // Add the given set of integers to the lexicon if it is not already
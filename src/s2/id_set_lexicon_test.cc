@@ -66,6 +66,24 @@ TEST(IdSetLexicon, SetsAreSorted) {
   ExpectIdSet({2, 3, 5}, lexicon.id_set(~1));
 }
 
+TEST(IdSetLexicon, SmallSetPermutations) {
+  // Sets of two or three elements are sorted using a special case.
+  IdSetLexicon lexicon;
+  Seq ids = {7, 3, 5};
+  std::sort(ids.begin(), ids.end());
+  do {
+    EXPECT_EQ(~0, lexicon.Add(ids));
+  } while (std::next_permutation(ids.begin(), ids.end()));
+  EXPECT_EQ(~1, lexicon.Add(Seq{5, 3}));
+  EXPECT_EQ(~1, lexicon.Add(Seq{3, 5}));
+  EXPECT_EQ(~2, lexicon.Add(Seq{7, 3, 7}));
+  EXPECT_EQ(~2, lexicon.Add(Seq{3, 7, 3}));
+  EXPECT_EQ(3, lexicon.Add(Seq{3, 3, 3}));
+  ExpectIdSet({3, 5, 7}, lexicon.id_set(~0));
+  ExpectIdSet({3, 5}, lexicon.id_set(~1));
+  ExpectIdSet({3, 7}, lexicon.id_set(~2));
+}
+
 TEST(IdSetLexicon, Clear) {
   IdSetLexicon lexicon;
   EXPECT_EQ(~0, lexicon.Add(Seq{1, 2}));
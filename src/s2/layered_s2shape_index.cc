@@ -0,0 +1,483 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/layered_s2shape_index.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "s2/base/types.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/log/absl_check.h"
+#include "absl/synchronization/mutex.h"
+#include "s2/util/coding/coder.h"
+#include "s2/util/coding/varint.h"
+#include "s2/encoded_s2cell_id_vector.h"
+#include "s2/encoded_string_vector.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/r2.h"
+#include "s2/r2rect.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2edge_clipping.h"
+#include "s2/s2edge_crosser.h"
+#include "s2/s2point.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+#include "s2/s2shapeutil_coding.h"
+
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+LayeredS2ShapeIndex::LayeredS2ShapeIndex(const S2ShapeIndex* base)
+    : LayeredS2ShapeIndex(base, MutableS2ShapeIndex::Options()) {
+}
+
+LayeredS2ShapeIndex::LayeredS2ShapeIndex(
+    const S2ShapeIndex* base, const MutableS2ShapeIndex::Options& options)
+    : base_(base), delta_(options) {
+}
+
+LayeredS2ShapeIndex::~LayeredS2ShapeIndex() = default;
+
+int LayeredS2ShapeIndex::Add(unique_ptr<S2Shape> shape) {
+  Invalidate();
+  return base_->num_shape_ids() + delta_.Add(std::move(shape));
+}
+
+void LayeredS2ShapeIndex::Remove(int shape_id) {
+  ABSL_DCHECK(shape(shape_id) != nullptr);
+  Invalidate();
+  int num_base_ids = base_->num_shape_ids();
+  if (shape_id < num_base_ids) {
+    removed_.insert(shape_id);
+  } else {
+    delta_.Release(shape_id - num_base_ids);
+  }
+}
+
+const S2Shape* LayeredS2ShapeIndex::shape(int id) const {
+  int num_base_ids = base_->num_shape_ids();
+  if (id >= num_base_ids) return delta_.shape(id - num_base_ids);
+  return is_removed(id) ? nullptr : base_->shape(id);
+}
+
+void LayeredS2ShapeIndex::Encode(Encoder* encoder) const {
+  Encode(encoder, s2coding::CodingHint::FAST);
+}
+
+void LayeredS2ShapeIndex::Encode(Encoder* encoder,
+                                 s2coding::CodingHint hint) const {
+  // This must match MutableS2ShapeIndex::Encode() exactly.
+  encoder->Ensure(Varint::kMax64);
+  uint64 max_edges = delta_.options().max_edges_per_cell();
+  uint64 version =
+      (hint == s2coding::CodingHint::COMPACT)
+          ? MutableS2ShapeIndex::kCompactEncodingVersionNumber
+          : MutableS2ShapeIndex::kCurrentEncodingVersionNumber;
+  encoder->put_varint64(max_edges << 2 | version);
+
+  vector<S2CellId> cell_ids;
+  s2coding::StringVectorEncoder encoded_cells;
+  for (Iterator it(this, S2ShapeIndex::BEGIN); !it.done(); it.Next()) {
+    cell_ids.push_back(it.id());
+    it.cell().Encode(num_shape_ids(), encoded_cells.AddViaEncoder());
+  }
+  s2coding::EncodeS2CellIdVector(cell_ids, hint, encoder);
+  encoded_cells.Encode(encoder, hint);
+}
+
+bool LayeredS2ShapeIndex::EncodeCompacted(Encoder* encoder) const {
+  if (!s2shapeutil::CompactEncodeTaggedShapes(*this, encoder)) return false;
+  Encode(encoder, s2coding::CodingHint::COMPACT);
+  return true;
+}
+
+// Returns the memory used by the given cell, not including sizeof(cell).
+static size_t CellSpaceUsed(const S2ShapeIndexCell& cell) {
+  size_t size = cell.num_clipped() * sizeof(S2ClippedShape);
+  for (const S2ClippedShape& clipped : cell.clipped_shapes()) {
+    if (clipped.num_edges() > 2) size += clipped.num_edges() * sizeof(int32);
+  }
+  return size;
+}
+
+size_t LayeredS2ShapeIndex::SpaceUsed() const {
+  size_t size = sizeof(*this) - sizeof(delta_);
+  size += base_->SpaceUsed();
+  size += delta_.SpaceUsed();
+  size += removed_.capacity() * sizeof(int);
+  size += regions_.capacity() * sizeof(S2CellId);
+  size += merged_cells_.capacity() * sizeof(MergedCell);
+  for (const MergedCell& merged : merged_cells_) {
+    size += sizeof(S2ShapeIndexCell) + CellSpaceUsed(*merged.cell);
+  }
+  absl::MutexLock l(&lock_);
+  size += filtered_cells_.capacity() *
+          (sizeof(S2CellId) + sizeof(unique_ptr<S2ShapeIndexCell>));
+  for (const auto& [id, cell] : filtered_cells_) {
+    size += sizeof(S2ShapeIndexCell) + CellSpaceUsed(*cell);
+  }
+  return size;
+}
+
+void LayeredS2ShapeIndex::Minimize() {
+  delta_.Minimize();
+  Invalidate();
+  regions_.shrink_to_fit();
+  merged_cells_.shrink_to_fit();
+}
+
+void LayeredS2ShapeIndex::Invalidate() {
+  absl::MutexLock l(&lock_);
+  merged_cells_valid_.store(false, std::memory_order_relaxed);
+  regions_.clear();
+  merged_cells_.clear();
+  filtered_cells_.clear();
+}
+
+unique_ptr<S2ShapeIndex::IteratorBase> LayeredS2ShapeIndex::NewIterator(
+    InitialPosition pos) const {
+  return make_unique<Iterator>(this, pos);
+}
+
+void LayeredS2ShapeIndex::MaybeBuildMergedCells() const {
+  // The merged cells are built at most once after each modification, even if
+  // several threads query the index concurrently.
+  if (merged_cells_valid_.load(std::memory_order_acquire)) return;
+  absl::MutexLock l(&lock_);
+  if (merged_cells_valid_.load(std::memory_order_relaxed)) return;
+  BuildMergedCells();
+  merged_cells_valid_.store(true, std::memory_order_release);
+}
+
+// The merged cells are computed as follows.  Every delta cell D either
+// overlaps no base cells, overlaps a single base cell that contains it, or
+// contains one or more base cells.  We replace the larger side of each such
+// overlap (the "region") by the smaller cells of the other side, together
+// with a covering of the remainder of the region.  The contents of the
+// region are clipped to each of these cells (which only requires examining
+// the edges in the region) and combined with the contents of the smaller
+// cells.  Since the cells of each index are disjoint, so are the regions.
+void LayeredS2ShapeIndex::BuildMergedCells() const {
+  S2ShapeIndex::Iterator base_it(base_);
+  S2ShapeIndex::Iterator delta_it(static_cast<const S2ShapeIndex*>(&delta_),
+                                  S2ShapeIndex::BEGIN);
+  vector<bool> base_is_coarse;
+  for (; !delta_it.done(); delta_it.Next()) {
+    S2CellId region = delta_it.id();
+    bool coarse = (base_it.Locate(region) == S2CellRelation::INDEXED);
+    if (coarse) region = base_it.id();
+    if (regions_.empty() || regions_.back() != region) {
+      regions_.push_back(region);
+      base_is_coarse.push_back(coarse);
+    }
+  }
+  for (int i = 0; i < regions_.size(); ++i) {
+    MergeRegion(regions_[i], base_is_coarse[i], &base_it, &delta_it);
+  }
+  std::sort(merged_cells_.begin(), merged_cells_.end(),
+            [](const MergedCell& a, const MergedCell& b) {
+              return a.id < b.id;
+            });
+}
+
+void LayeredS2ShapeIndex::MergeRegion(S2CellId region, bool base_is_coarse,
+                                      S2ShapeIndex::Iterator* base_it,
+                                      S2ShapeIndex::Iterator* delta_it) const {
+  // Shape ids are assigned so that base shapes precede delta shapes, which
+  // keeps the clipped shapes of each merged cell sorted.
+  const int delta_offset = base_->num_shape_ids();
+  S2ShapeIndex::Iterator* coarse_it = base_is_coarse ? base_it : delta_it;
+  S2ShapeIndex::Iterator* fine_it = base_is_coarse ? delta_it : base_it;
+  const S2ShapeIndex& coarse_index =
+      base_is_coarse ? *base_ : static_cast<const S2ShapeIndex&>(delta_);
+  const int coarse_offset = base_is_coarse ? 0 : delta_offset;
+  const int fine_offset = base_is_coarse ? delta_offset : 0;
+
+  coarse_it->Seek(region);
+  ABSL_DCHECK_EQ(coarse_it->id(), region);
+  const S2ShapeIndexCell& coarse_cell = coarse_it->cell();
+
+  vector<ClippedShapeData> shapes;
+  auto add_piece = [&](S2CellId id, const S2ShapeIndexCell* fine_cell) {
+    shapes.clear();
+    if (!base_is_coarse && fine_cell != nullptr) {
+      AppendClippedShapes(*fine_cell, fine_offset, &shapes);
+    }
+    for (const S2ClippedShape& clipped : coarse_cell.clipped_shapes()) {
+      if (base_is_coarse && is_removed(clipped.shape_id())) continue;
+      ClippedShapeData data;
+      data.shape_id = clipped.shape_id() + coarse_offset;
+      ClipToCell(*coarse_index.shape(clipped.shape_id()), clipped, region, id,
+                 &data);
+      if (!data.edges.empty() || data.contains_center) {
+        shapes.push_back(std::move(data));
+      }
+    }
+    if (base_is_coarse && fine_cell != nullptr) {
+      AppendClippedShapes(*fine_cell, fine_offset, &shapes);
+    }
+    if (shapes.empty()) return;
+    merged_cells_.push_back({id, make_unique<S2ShapeIndexCell>()});
+    InitCell(shapes, merged_cells_.back().cell.get());
+  };
+
+  vector<S2CellId> fine_ids;
+  for (fine_it->Seek(region.range_min());
+       !fine_it->done() && fine_it->id() <= region.range_max();
+       fine_it->Next()) {
+    fine_ids.push_back(fine_it->id());
+    add_piece(fine_it->id(), &fine_it->cell());
+  }
+  // The rest of the region only contains the coarse shapes.
+  S2CellUnion rest = S2CellUnion::FromVerbatim({region}).Difference(
+      S2CellUnion::FromVerbatim(std::move(fine_ids)));
+  for (S2CellId id : rest) add_piece(id, nullptr);
+}
+
+// Sets "data" to the portion of "clipped" (a clipped shape of the cell
+// "region") that intersects the descendant cell "id".  The edges are
+// selected conservatively, i.e. an edge may be included even if it is
+// slightly farther than MutableS2ShapeIndex::kCellPadding from the cell.
+void LayeredS2ShapeIndex::ClipToCell(const S2Shape& shape,
+                                     const S2ClippedShape& clipped,
+                                     S2CellId region, S2CellId id,
+                                     ClippedShapeData* data) {
+  const double padding =
+      MutableS2ShapeIndex::kCellPadding + S2::kIntersectsRectErrorUVDist;
+  const R2Rect bound = id.GetBoundUV().Expanded(padding);
+  const bool has_interior = (shape.dimension() == 2);
+  const S2Point region_center = region.ToPoint();
+  const S2Point center = id.ToPoint();
+  S2EdgeCrosser crosser(&region_center, &center);
+  bool contains_center = clipped.contains_center();
+  data->edges.clear();
+  for (int i = 0; i < clipped.num_edges(); ++i) {
+    int e = clipped.edge(i);
+    S2Shape::Edge edge = shape.edge(e);
+    R2Point a_uv, b_uv;
+    if (S2::ClipToPaddedFace(edge.v0, edge.v1, id.face(), padding, &a_uv,
+                             &b_uv) &&
+        S2::IntersectsRect(a_uv, b_uv, bound)) {
+      data->edges.push_back(e);
+    }
+    // The path from the region center to the cell center stays within the
+    // region, so only the edges of "clipped" can cross it.
+    if (has_interior && id != region) {
+      contains_center ^= crosser.EdgeOrVertexCrossing(&edge.v0, &edge.v1);
+    }
+  }
+  data->contains_center = contains_center;
+}
+
+void LayeredS2ShapeIndex::AppendClippedShapes(
+    const S2ShapeIndexCell& cell, int shape_id_offset,
+    vector<ClippedShapeData>* shapes) const {
+  for (const S2ClippedShape& clipped : cell.clipped_shapes()) {
+    if (shape_id_offset == 0 && is_removed(clipped.shape_id())) continue;
+    ClippedShapeData data;
+    data.shape_id = clipped.shape_id() + shape_id_offset;
+    data.contains_center = clipped.contains_center();
+    data.edges.reserve(clipped.num_edges());
+    for (int i = 0; i < clipped.num_edges(); ++i) {
+      data.edges.push_back(clipped.edge(i));
+    }
+    shapes->push_back(std::move(data));
+  }
+}
+
+/* static */
+void LayeredS2ShapeIndex::InitCell(const vector<ClippedShapeData>& shapes,
+                                   S2ShapeIndexCell* cell) {
+  S2ClippedShape* clipped = cell->add_shapes(shapes.size());
+  for (const ClippedShapeData& data : shapes) {
+    clipped->Init(data.shape_id, data.edges.size());
+    for (int i = 0; i < data.edges.size(); ++i) {
+      clipped->set_edge(i, data.edges[i]);
+    }
+    clipped->set_contains_center(data.contains_center);
+    ++clipped;
+  }
+}
+
+bool LayeredS2ShapeIndex::HasRemovedShapes(
+    const S2ShapeIndexCell& cell) const {
+  for (const S2ClippedShape& clipped : cell.clipped_shapes()) {
+    if (is_removed(clipped.shape_id())) return true;
+  }
+  return false;
+}
+
+bool LayeredS2ShapeIndex::AllShapesRemoved(
+    const S2ShapeIndexCell& cell) const {
+  for (const S2ClippedShape& clipped : cell.clipped_shapes()) {
+    if (!is_removed(clipped.shape_id())) return false;
+  }
+  return true;
+}
+
+const S2ShapeIndexCell& LayeredS2ShapeIndex::GetFilteredCell(
+    S2CellId id, const S2ShapeIndexCell& cell) const {
+  absl::MutexLock l(&lock_);
+  unique_ptr<S2ShapeIndexCell>& filtered = filtered_cells_[id];
+  if (filtered != nullptr) return *filtered;
+  filtered = make_unique<S2ShapeIndexCell>();
+  int num_kept = 0;
+  for (const S2ClippedShape& clipped : cell.clipped_shapes()) {
+    num_kept += !is_removed(clipped.shape_id());
+  }
+  S2ClippedShape* dst = filtered->add_shapes(num_kept);
+  for (const S2ClippedShape& clipped : cell.clipped_shapes()) {
+    if (is_removed(clipped.shape_id())) continue;
+    dst->Init(clipped.shape_id(), clipped.num_edges());
+    for (int i = 0; i < clipped.num_edges(); ++i) {
+      dst->set_edge(i, clipped.edge(i));
+    }
+    dst->set_contains_center(clipped.contains_center());
+    ++dst;
+  }
+  return *filtered;
+}
+
+S2CellId LayeredS2ShapeIndex::FindReplacedRegion(S2CellId id) const {
+  // The regions are disjoint, so they are also sorted by range_min().
+  auto it = std::upper_bound(
+      regions_.begin(), regions_.end(), id,
+      [](S2CellId x, S2CellId region) { return x < region.range_min(); });
+  if (it != regions_.begin() && (--it)->contains(id)) return *it;
+  return S2CellId::None();
+}
+
+LayeredS2ShapeIndex::Iterator::Iterator(const LayeredS2ShapeIndex* index,
+                                        InitialPosition pos) {
+  Init(index, pos);
+}
+
+void LayeredS2ShapeIndex::Iterator::Init(const LayeredS2ShapeIndex* index,
+                                         InitialPosition pos) {
+  index->MaybeBuildMergedCells();
+  index_ = index;
+  base_it_.Init(index->base_);
+  if (pos == BEGIN) {
+    Begin();
+  } else {
+    Finish();
+  }
+}
+
+bool LayeredS2ShapeIndex::Iterator::at_merged() const {
+  return merged_pos_ < index_->merged_cells_.size() &&
+         (base_it_.done() ||
+          index_->merged_cells_[merged_pos_].id < base_it_.id());
+}
+
+S2CellId LayeredS2ShapeIndex::Iterator::id() const {
+  if (at_merged()) return index_->merged_cells_[merged_pos_].id;
+  return base_it_.id();
+}
+
+bool LayeredS2ShapeIndex::Iterator::done() const {
+  return base_it_.done() && merged_pos_ == index_->merged_cells_.size();
+}
+
+const S2ShapeIndexCell& LayeredS2ShapeIndex::Iterator::cell() const {
+  ABSL_DCHECK(!done());
+  if (at_merged()) return *index_->merged_cells_[merged_pos_].cell;
+  const S2ShapeIndexCell& cell = base_it_.cell();
+  if (index_->removed_.empty() || !index_->HasRemovedShapes(cell)) {
+    return cell;
+  }
+  return index_->GetFilteredCell(base_it_.id(), cell);
+}
+
+void LayeredS2ShapeIndex::Iterator::Begin() {
+  base_it_.Begin();
+  SkipHiddenCells();
+  merged_pos_ = 0;
+}
+
+void LayeredS2ShapeIndex::Iterator::Finish() {
+  base_it_.Finish();
+  merged_pos_ = index_->merged_cells_.size();
+}
+
+// Both base_it_ and merged_pos_ are always positioned at their first cell
+// whose id is at least id(), so advancing one of them preserves this.
+void LayeredS2ShapeIndex::Iterator::Next() {
+  ABSL_DCHECK(!done());
+  if (at_merged()) {
+    ++merged_pos_;
+  } else {
+    base_it_.Next();
+    SkipHiddenCells();
+  }
+}
+
+bool LayeredS2ShapeIndex::Iterator::Prev() {
+  // Find the last visible base cell before the current position.
+  S2ShapeIndex::Iterator prev = base_it_;
+  bool has_prev_base = false;
+  while (prev.Prev()) {
+    S2CellId region = index_->FindReplacedRegion(prev.id());
+    if (region != S2CellId::None()) {
+      prev.Seek(region.range_min());
+    } else if (index_->removed_.empty() ||
+               !index_->AllShapesRemoved(prev.cell())) {
+      has_prev_base = true;
+      break;
+    }
+  }
+  bool has_prev_merged = merged_pos_ > 0;
+  if (has_prev_base &&
+      (!has_prev_merged ||
+       index_->merged_cells_[merged_pos_ - 1].id < prev.id())) {
+    base_it_ = std::move(prev);
+    return true;
+  }
+  if (!has_prev_merged) return false;
+  --merged_pos_;
+  return true;
+}
+
+void LayeredS2ShapeIndex::Iterator::Seek(S2CellId target) {
+  base_it_.Seek(target);
+  SkipHiddenCells();
+  const auto& merged = index_->merged_cells_;
+  merged_pos_ = std::lower_bound(merged.begin(), merged.end(), target,
+                                 [](const MergedCell& cell, S2CellId id) {
+                                   return cell.id < id;
+                                 }) -
+                merged.begin();
+}
+
+void LayeredS2ShapeIndex::Iterator::SkipHiddenCells() {
+  while (!base_it_.done()) {
+    S2CellId region = index_->FindReplacedRegion(base_it_.id());
+    if (region != S2CellId::None()) {
+      base_it_.Seek(region.range_max().next());
+    } else if (!index_->removed_.empty() &&
+               index_->AllShapesRemoved(base_it_.cell())) {
+      base_it_.Next();
+    } else {
+      break;
+    }
+  }
+}
@@ -0,0 +1,284 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_LAYERED_S2SHAPE_INDEX_H_
+#define S2_LAYERED_S2SHAPE_INDEX_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "s2/base/types.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
+#include "s2/util/coding/coder.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2coder.h"
+#include "s2/s2point.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+
+// LayeredS2ShapeIndex is an S2ShapeIndex that overlays a small number of
+// edits on a large read-only "base" index, such as an EncodedS2ShapeIndex or
+// the index of a MappedS2ShapeIndex.  Shapes added to the layered index are
+// stored in a MutableS2ShapeIndex (the "delta"), and shapes of the base index
+// can be removed, in which case their ids are simply recorded.  All queries
+// work unchanged on the combined index.
+//
+// This is intended for serving indexes that are almost entirely static.
+// Rather than rebuilding the encoded index after every batch of edits, or
+// keeping all the geometry in a MutableS2ShapeIndex (which uses several times
+// as much memory), the edits are applied to a layered index and periodically
+// compacted into a new base index:
+//
+//   EncodedS2ShapeIndex base;  // Decoded from the last compaction.
+//   auto index = std::make_unique<LayeredS2ShapeIndex>(&base);
+//   int id = index->Add(std::move(new_shape));
+//   index->Remove(old_shape_id);
+//   ...
+//   // Compaction, e.g. on a background thread:
+//   Encoder encoder;
+//   index->EncodeCompacted(&encoder);
+//   // Decode a new EncodedS2ShapeIndex from "encoder" (or write it to a file
+//   // for MappedS2ShapeIndex::Open), and replace "index" with a new
+//   // LayeredS2ShapeIndex on top of it.
+//
+// Shape ids of the base index are preserved, and shapes added to this index
+// are numbered starting at base().num_shape_ids().  shape(id) returns nullptr
+// for removed shapes.  EncodeCompacted() preserves all shape ids as well, so
+// the new base can replace the old one without renumbering.
+//
+// The index cells are those of the base index, except where they overlap a
+// cell of the delta.  Each such group of overlapping cells is replaced by a
+// set of merged cells, which are computed the first time the index is
+// queried after a modification.  The time and memory needed for this is
+// proportional to the size of the delta and the base cells that it
+// overlaps, not to the size of the base index.  Base cells that contain
+// removed shapes are filtered as they are visited, and cells whose shapes
+// have all been removed are skipped.
+//
+// This class has the same thread-safety properties as MutableS2ShapeIndex:
+// const methods may be called concurrently, but Add() and Remove() must not
+// be called concurrently with any other method.
+class LayeredS2ShapeIndex final : public S2ShapeIndex {
+ public:
+  // Creates an index on top of the given base index, which must outlive this
+  // object and must not be modified while it is in use.
+  explicit LayeredS2ShapeIndex(const S2ShapeIndex* base);
+
+  // Like the constructor above, but the delta is created with the given
+  // options.
+  LayeredS2ShapeIndex(const S2ShapeIndex* base,
+                      const MutableS2ShapeIndex::Options& options);
+
+  LayeredS2ShapeIndex(const LayeredS2ShapeIndex&) = delete;
+  LayeredS2ShapeIndex& operator=(const LayeredS2ShapeIndex&) = delete;
+
+  ~LayeredS2ShapeIndex() override;
+
+  // Returns the base index and the index of added shapes.  Note that shape
+  // ids in the delta are offset by base().num_shape_ids() in this index.
+  const S2ShapeIndex& base() const { return *base_; }
+  const MutableS2ShapeIndex& delta() const { return delta_; }
+
+  // Adds the given shape and returns its shape id, which is at least
+  // base().num_shape_ids().
+  int Add(std::unique_ptr<S2Shape> shape);
+
+  // Removes the shape with the given id.  Removing a shape of the base index
+  // only records its id; removing an added shape deletes it.
+  //
+  // REQUIRES: shape(shape_id) != nullptr
+  void Remove(int shape_id);
+
+  // Returns the number of shapes of the base index that have been removed.
+  int num_removed_base_shapes() const { return removed_.size(); }
+
+  int num_shape_ids() const override {
+    return base_->num_shape_ids() + delta_.num_shape_ids();
+  }
+
+  const S2Shape* shape(int id) const override;
+
+  // Appends an encoded representation of the index cells to "encoder" in the
+  // format used by MutableS2ShapeIndex::Encode(), so that it can be decoded
+  // by EncodedS2ShapeIndex.  As with the other index types, the shapes must
+  // be encoded separately (see EncodeCompacted).
+  void Encode(Encoder* encoder) const override;
+
+  // Like Encode(Encoder*), except that CodingHint::COMPACT selects the
+  // compact MutableS2ShapeIndex encoding.
+  void Encode(Encoder* encoder, s2coding::CodingHint hint) const;
+
+  // Encodes all shapes followed by the index, in the format read by
+  // MappedS2ShapeIndex::Open() (see s2shapeutil::CompactEncodeTaggedShapes
+  // and s2shapeutil::LazyDecodeShapeFactory).  Removed shapes are encoded as
+  // null shapes so that shape ids are preserved.  Returns false if any shape
+  // could not be encoded.
+  //
+  // This method may be called from a background thread while other threads
+  // query the index, as long as the index is not modified until it returns.
+  bool EncodeCompacted(Encoder* encoder) const;
+
+  // Returns the memory used by this index, including the base index.
+  size_t SpaceUsed() const override;
+
+  // Discards the merged cells and minimizes the delta.  They are rebuilt the
+  // next time the index is queried.
+  void Minimize() override;
+
+  class Iterator final : public IteratorBase {
+   public:
+    // Default constructor; must be followed by a call to Init().
+    Iterator() = default;
+
+    // Constructs an iterator positioned as specified.  By default iterators
+    // are unpositioned, since this avoids an extra seek in this situation
+    // where one of the seek methods (such as Locate) is immediately called.
+    explicit Iterator(const LayeredS2ShapeIndex* index,
+                      InitialPosition pos = UNPOSITIONED);
+
+    // Initializes an iterator for the given LayeredS2ShapeIndex.
+    void Init(const LayeredS2ShapeIndex* index,
+              InitialPosition pos = UNPOSITIONED);
+
+    S2CellId id() const override;
+    bool done() const override;
+    const S2ShapeIndexCell& cell() const override;
+
+    // S2CellIterator API:
+    void Begin() override;
+    void Finish() override;
+    void Next() override;
+    bool Prev() override;
+    void Seek(S2CellId target) override;
+
+    bool Locate(const S2Point& target) override {
+      return LocateImpl(*this, target);
+    }
+
+    S2CellRelation Locate(S2CellId target) override {
+      return LocateImpl(*this, target);
+    }
+
+    std::unique_ptr<IteratorBase> Clone() const override {
+      return std::make_unique<Iterator>(*this);
+    }
+
+   private:
+    // Returns true if the iterator is positioned at a merged cell rather
+    // than a base cell.
+    bool at_merged() const;
+
+    // Advances base_it_ past any base cells that were replaced by merged
+    // cells or whose shapes have all been removed.
+    void SkipHiddenCells();
+
+    const LayeredS2ShapeIndex* index_ = nullptr;
+
+    // The iterator is positioned at the smaller of the current base cell and
+    // the current merged cell.  base_it_ is never positioned at a hidden
+    // base cell (see SkipHiddenCells).
+    S2ShapeIndex::Iterator base_it_;
+    int merged_pos_ = 0;
+  };
+
+ protected:
+  std::unique_ptr<IteratorBase> NewIterator(InitialPosition pos) const override;
+
+ private:
+  // The contents of a clipped shape while a merged cell is being built.
+  struct ClippedShapeData {
+    int shape_id;
+    bool contains_center;
+    std::vector<int> edges;
+  };
+
+  struct MergedCell {
+    S2CellId id;
+    std::unique_ptr<S2ShapeIndexCell> cell;
+  };
+
+  // Builds the merged cells if the index has been modified since they were
+  // last built.
+  void MaybeBuildMergedCells() const;
+  void BuildMergedCells() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Discards all the cells computed since the last modification.
+  void Invalidate();
+
+  // Adds the merged cells that replace the given "region", which is either a
+  // base cell that contains delta cells (in which case "base_is_coarse" is
+  // true) or a delta cell that is not contained by any base cell.
+  void MergeRegion(S2CellId region, bool base_is_coarse,
+                   S2ShapeIndex::Iterator* base_it,
+                   S2ShapeIndex::Iterator* delta_it) const;
+
+  static void ClipToCell(const S2Shape& shape, const S2ClippedShape& clipped,
+                         S2CellId region, S2CellId id,
+                         ClippedShapeData* data);
+
+  // Appends the clipped shapes of "cell" to "shapes", adding
+  // "shape_id_offset" to each shape id.  Removed shapes are skipped if
+  // "shape_id_offset" is zero (i.e., "cell" is a base cell).
+  void AppendClippedShapes(const S2ShapeIndexCell& cell, int shape_id_offset,
+                           std::vector<ClippedShapeData>* shapes) const;
+
+  static void InitCell(const std::vector<ClippedShapeData>& shapes,
+                       S2ShapeIndexCell* cell);
+
+  // Methods that handle base cells containing removed shapes.
+  bool HasRemovedShapes(const S2ShapeIndexCell& cell) const;
+  bool AllShapesRemoved(const S2ShapeIndexCell& cell) const;
+  const S2ShapeIndexCell& GetFilteredCell(S2CellId id,
+                                          const S2ShapeIndexCell& cell) const;
+
+  // Returns the region containing the base cell "id", or S2CellId::None() if
+  // the base cell has not been replaced by merged cells.
+  S2CellId FindReplacedRegion(S2CellId id) const;
+
+  bool is_removed(int shape_id) const { return removed_.contains(shape_id); }
+
+  const S2ShapeIndex* base_;
+  MutableS2ShapeIndex delta_;
+
+  // The ids of base shapes that have been removed.
+  absl::flat_hash_set<int> removed_;
+
+  // The merged cells are built lazily after each modification, so we
+  // protect them with a mutex as MutableS2ShapeIndex does for its pending
+  // updates.
+  mutable absl::Mutex lock_;
+  mutable std::atomic<bool> merged_cells_valid_{false};
+
+  // The sorted, disjoint regions of the base and delta that have been
+  // replaced by merged cells.
+  mutable std::vector<S2CellId> regions_;
+
+  // The merged cells in increasing order of S2CellId.
+  mutable std::vector<MergedCell> merged_cells_;
+
+  // Copies of the base cells containing removed shapes, without those
+  // shapes.  They are created as the cells are visited and (like all index
+  // cells) remain valid until the index is modified.
+  mutable absl::flat_hash_map<S2CellId, std::unique_ptr<S2ShapeIndexCell>>
+      filtered_cells_ ABSL_GUARDED_BY(lock_);
+};
+
+#endif  // S2_LAYERED_S2SHAPE_INDEX_H_
@@ -0,0 +1,316 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/layered_s2shape_index.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/util/coding/coder.h"
+#include "s2/encoded_s2shape_index.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/r2.h"
+#include "s2/r2rect.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_iterator_testing.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2closest_edge_query.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2edge_clipping.h"
+#include "s2/s2fractal.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2lax_polyline_shape.h"
+#include "s2/s2latlng.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2polygon.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+#include "s2/s2shapeutil_coding.h"
+#include "s2/s2shapeutil_contains_brute_force.h"
+#include "s2/s2shapeutil_testing.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+const S2Point kCenter = S2LatLng::FromDegrees(10, 10).ToPoint();
+
+// Returns an index containing points, polylines, and polygons, including a
+// fractal with enough edges that the index has many cells.
+unique_ptr<MutableS2ShapeIndex> MakeBaseIndex() {
+  auto index = s2textformat::MakeIndexOrDie(
+      "0:0 | 1:1 | 2:2 # 3:3, 4:4, 5:5 | 6:6, 7:7 # 20:20, 20:30, 30:30");
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3000);
+  S2Polygon polygon(fractal.MakeLoop(S2Testing::GetRandomFrameAt(kCenter),
+                                     S1Angle::Degrees(5)));
+  index->Add(make_unique<S2LaxPolygonShape>(polygon));
+  return index;
+}
+
+// Returns shapes that overlap the base shapes at both smaller and larger
+// scales, together with a shape far away from them.
+vector<unique_ptr<S2Shape>> MakeDeltaShapes() {
+  vector<unique_ptr<S2Shape>> shapes;
+  auto add_loop = [&shapes](const S2Point& center, S1Angle radius, int n) {
+    S2Polygon polygon(S2Loop::MakeRegularLoop(center, radius, n));
+    shapes.push_back(make_unique<S2LaxPolygonShape>(polygon));
+  };
+  add_loop(kCenter, S1Angle::Degrees(8), 8);
+  add_loop(kCenter, S1Angle::Degrees(0.01), 5);
+  add_loop(S2LatLng::FromDegrees(-40, -100).ToPoint(), S1Angle::Degrees(1),
+           10);
+  shapes.push_back(make_unique<S2LaxPolylineShape>(
+      s2textformat::ParsePointsOrDie("0:5, 10:10, 13:12, 25:25")));
+  return shapes;
+}
+
+// Encodes the shapes and cells of "index" into "encoder" and decodes them
+// into "decoded".
+void EncodeAndDecode(const S2ShapeIndex& index, Encoder* encoder,
+                     EncodedS2ShapeIndex* decoded) {
+  ASSERT_TRUE(s2shapeutil::CompactEncodeTaggedShapes(index, encoder));
+  index.Encode(encoder);
+  Decoder decoder(encoder->base(), encoder->length());
+  ASSERT_TRUE(decoded->Init(&decoder,
+                            s2shapeutil::LazyDecodeShapeFactory(&decoder)));
+}
+
+// Verifies that "index_has_edge" is true if the edge AB intersects the given
+// cell and false if it is not close to the cell.  (LayeredS2ShapeIndex may
+// include edges slightly farther from the cell than MutableS2ShapeIndex.)
+void ValidateEdge(const S2Point& a, const S2Point& b, S2CellId id,
+                  bool index_has_edge) {
+  double padding = MutableS2ShapeIndex::kCellPadding;
+  padding += (index_has_edge ? 2 : -1) * S2::kIntersectsRectErrorUVDist;
+  R2Rect bound = id.GetBoundUV().Expanded(padding);
+  R2Point a_uv, b_uv;
+  EXPECT_EQ(S2::ClipToPaddedFace(a, b, id.face(), padding, &a_uv, &b_uv) &&
+                S2::IntersectsRect(a_uv, b_uv, bound),
+            index_has_edge)
+      << id;
+}
+
+// Verifies the contents of every cell of "index" (and of the gaps between
+// them) by brute force, like MutableS2ShapeIndexTest::QuadraticValidate().
+void QuadraticValidate(const S2ShapeIndex& index) {
+  S2CellId min_cellid = S2CellId::Begin(S2CellId::kMaxLevel);
+  for (S2ShapeIndex::Iterator it(&index, S2ShapeIndex::BEGIN);; it.Next()) {
+    S2CellUnion skipped;
+    if (!it.done()) {
+      ASSERT_GE(it.id(), min_cellid);
+      EXPECT_GT(it.cell().num_clipped(), 0);
+      skipped.InitFromBeginEnd(min_cellid, it.id().range_min());
+      min_cellid = it.id().range_max().next();
+    } else {
+      skipped.InitFromBeginEnd(min_cellid, S2CellId::End(S2CellId::kMaxLevel));
+    }
+    for (int id = 0; id < index.num_shape_ids(); ++id) {
+      const S2Shape* shape = index.shape(id);
+      const S2ClippedShape* clipped =
+          it.done() ? nullptr : it.cell().find_clipped(id);
+      if (shape == nullptr) {
+        EXPECT_EQ(clipped, nullptr);
+        continue;
+      }
+      for (S2CellId skipped_id : skipped) {
+        EXPECT_FALSE(
+            s2shapeutil::ContainsBruteForce(*shape, skipped_id.ToPoint()));
+      }
+      if (!it.done()) {
+        EXPECT_EQ(s2shapeutil::ContainsBruteForce(*shape, it.id().ToPoint()),
+                  clipped != nullptr && clipped->contains_center())
+            << it.id() << " shape " << id;
+      }
+      for (int e = 0; e < shape->num_edges(); ++e) {
+        S2Shape::Edge edge = shape->edge(e);
+        for (S2CellId skipped_id : skipped) {
+          ValidateEdge(edge.v0, edge.v1, skipped_id, false);
+        }
+        if (!it.done()) {
+          ValidateEdge(edge.v0, edge.v1, it.id(),
+                       clipped != nullptr && clipped->ContainsEdge(e));
+        }
+      }
+    }
+    if (it.done()) break;
+  }
+}
+
+class LayeredS2ShapeIndexTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    expected_ = MakeBaseIndex();
+    EncodeAndDecode(*expected_, &encoder_, &base_);
+  }
+
+  // Adds the shapes returned by MakeDeltaShapes() to both "index" and
+  // expected_, which therefore assign them the same shape ids.
+  void AddDeltaShapes(LayeredS2ShapeIndex* index) {
+    for (auto& shape : MakeDeltaShapes()) expected_->Add(std::move(shape));
+    for (auto& shape : MakeDeltaShapes()) index->Add(std::move(shape));
+  }
+
+  void Remove(int shape_id, LayeredS2ShapeIndex* index) {
+    expected_->Release(shape_id);
+    index->Remove(shape_id);
+  }
+
+  // Verifies that queries on "index" give the same results as on expected_.
+  void ExpectQueriesMatch(const S2ShapeIndex& index) {
+    ASSERT_EQ(index.num_shape_ids(), expected_->num_shape_ids());
+    for (int id = 0; id < index.num_shape_ids(); ++id) {
+      EXPECT_EQ(index.shape(id) == nullptr, expected_->shape(id) == nullptr);
+    }
+    S2ClosestEdgeQuery expected_query(expected_.get());
+    S2ClosestEdgeQuery actual_query(&index);
+    auto expected_contains = MakeS2ContainsPointQuery(expected_.get());
+    auto actual_contains = MakeS2ContainsPointQuery(&index);
+    S2Testing::rnd.Reset(2);
+    for (int i = 0; i < 200; ++i) {
+      // Test points both near the shapes and elsewhere.
+      S2Point point = (i % 2) ? S2Testing::RandomPoint()
+                              : S2Testing::SamplePoint(
+                                    S2Cap(kCenter, S1Angle::Degrees(10)));
+      S2ClosestEdgeQuery::PointTarget target(point);
+      EXPECT_EQ(expected_query.GetDistance(&target),
+                actual_query.GetDistance(&target));
+      EXPECT_EQ(expected_contains.GetContainingShapeIds(point),
+                actual_contains.GetContainingShapeIds(point));
+    }
+  }
+
+  unique_ptr<MutableS2ShapeIndex> expected_;
+  Encoder encoder_;
+  EncodedS2ShapeIndex base_;
+};
+
+TEST_F(LayeredS2ShapeIndexTest, NoChanges) {
+  LayeredS2ShapeIndex index(&base_);
+  EXPECT_EQ(index.num_shape_ids(), base_.num_shape_ids());
+  s2testing::ExpectEqual(base_, index);
+}
+
+TEST_F(LayeredS2ShapeIndexTest, EmptyBase) {
+  EncodedS2ShapeIndex empty_base;
+  Encoder encoder;
+  EncodeAndDecode(MutableS2ShapeIndex(), &encoder, &empty_base);
+  LayeredS2ShapeIndex index(&empty_base);
+  MutableS2ShapeIndex expected;
+  for (auto& shape : MakeDeltaShapes()) expected.Add(std::move(shape));
+  for (auto& shape : MakeDeltaShapes()) index.Add(std::move(shape));
+  s2testing::ExpectEqual(expected, index);
+}
+
+TEST_F(LayeredS2ShapeIndexTest, AddedShapes) {
+  LayeredS2ShapeIndex index(&base_);
+  AddDeltaShapes(&index);
+  EXPECT_EQ(index.num_shape_ids(),
+            base_.num_shape_ids() + index.delta().num_shape_ids());
+  QuadraticValidate(index);
+  ExpectQueriesMatch(index);
+}
+
+TEST_F(LayeredS2ShapeIndexTest, RemovedShapes) {
+  LayeredS2ShapeIndex index(&base_);
+  const int num_base_ids = base_.num_shape_ids();
+  AddDeltaShapes(&index);
+  Remove(num_base_ids - 1, &index);  // The fractal.
+  Remove(1, &index);                 // A point.
+  Remove(num_base_ids + 1, &index);  // An added loop.
+  EXPECT_EQ(index.num_removed_base_shapes(), 2);
+  EXPECT_EQ(index.shape(1), nullptr);
+  EXPECT_EQ(index.shape(num_base_ids + 1), nullptr);
+  QuadraticValidate(index);
+  ExpectQueriesMatch(index);
+}
+
+TEST_F(LayeredS2ShapeIndexTest, IteratorMethods) {
+  LayeredS2ShapeIndex index(&base_);
+  AddDeltaShapes(&index);
+  Remove(0, &index);
+  vector<S2CellId> ids;
+  for (LayeredS2ShapeIndex::Iterator it(&index, S2ShapeIndex::BEGIN);
+       !it.done(); it.Next()) {
+    ids.push_back(it.id());
+  }
+  ASSERT_FALSE(ids.empty());
+
+  // Iterate backward from the end.
+  LayeredS2ShapeIndex::Iterator it(&index, S2ShapeIndex::END);
+  for (int i = ids.size() - 1; i >= 0; --i) {
+    ASSERT_TRUE(it.Prev());
+    EXPECT_EQ(it.id(), ids[i]);
+  }
+  EXPECT_FALSE(it.Prev());
+  EXPECT_EQ(it.id(), ids[0]);
+
+  // Seek to each cell, and to the gaps just before and after it.
+  for (int i = 0; i < ids.size(); ++i) {
+    it.Seek(ids[i].range_min());
+    EXPECT_EQ(it.id(), ids[i]);
+    it.Seek(ids[i].range_max().next());
+    EXPECT_EQ(it.done() ? S2CellId::Sentinel() : it.id(),
+              i + 1 < ids.size() ? ids[i + 1] : S2CellId::Sentinel());
+    EXPECT_EQ(it.Locate(ids[i].child_begin(S2CellId::kMaxLevel)),
+              S2CellRelation::INDEXED);
+    EXPECT_EQ(it.id(), ids[i]);
+  }
+  TestSeekNear(it);
+}
+
+TEST_F(LayeredS2ShapeIndexTest, ChangesAfterQueries) {
+  LayeredS2ShapeIndex index(&base_);
+  ExpectQueriesMatch(index);
+  AddDeltaShapes(&index);
+  ExpectQueriesMatch(index);
+  Remove(base_.num_shape_ids(), &index);
+  ExpectQueriesMatch(index);
+  index.Minimize();
+  QuadraticValidate(index);
+}
+
+TEST_F(LayeredS2ShapeIndexTest, EncodeCompacted) {
+  LayeredS2ShapeIndex index(&base_);
+  AddDeltaShapes(&index);
+  Remove(2, &index);
+  Remove(base_.num_shape_ids() + 2, &index);
+
+  Encoder encoder;
+  ASSERT_TRUE(index.EncodeCompacted(&encoder));
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex compacted;
+  ASSERT_TRUE(compacted.Init(&decoder,
+                             s2shapeutil::LazyDecodeShapeFactory(&decoder)));
+  s2testing::ExpectEqual(index, compacted);
+
+  // The compacted index can be used as the base of another layered index.
+  LayeredS2ShapeIndex next(&compacted);
+  EXPECT_EQ(next.num_shape_ids(), index.num_shape_ids());
+  Remove(base_.num_shape_ids(), &next);
+  QuadraticValidate(next);
+  ExpectQueriesMatch(next);
+}
+
+}  // namespace
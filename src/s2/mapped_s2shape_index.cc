@@ -0,0 +1,217 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/mapped_s2shape_index.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "absl/log/absl_check.h"
+#include "absl/strings/string_view.h"
+#include "s2/util/coding/coder.h"
+#include "s2/encoded_s2shape_index.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s2encoding_sink.h"
+#include "s2/s2error.h"
+#include "s2/s2shape_index.h"
+#include "s2/s2shapeutil_coding.h"
+
+using std::make_unique;
+using std::string;
+
+MappedS2ShapeIndex::MappedS2ShapeIndex()
+    : index_(make_unique<EncodedS2ShapeIndex>()) {
+}
+
+MappedS2ShapeIndex::~MappedS2ShapeIndex() {
+  // Shapes and cells may refer to the mapped data.
+  index_.reset();
+  Unmap();
+}
+
+bool MappedS2ShapeIndex::Open(absl::string_view filename, S2Error* error) {
+  return Open(filename, Options(), error);
+}
+
+bool MappedS2ShapeIndex::Open(absl::string_view filename,
+                              const Options& options, S2Error* error) {
+  ABSL_DCHECK(data_ == nullptr) << "Open() may only be called once";
+  error->Clear();
+  string path(filename);
+#ifndef _WIN32
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    error->Init(S2Error::INVALID_ARGUMENT, "Could not open %s: %s", path,
+                strerror(errno));
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    error->Init(S2Error::INVALID_ARGUMENT, "Could not stat %s: %s", path,
+                strerror(errno));
+    close(fd);
+    return false;
+  }
+  size_ = st.st_size;
+  if (size_ > 0) {
+    int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    if (options.prefetch()) flags |= MAP_POPULATE;
+#endif
+    void* addr = mmap(nullptr, size_, PROT_READ, flags, fd, 0);
+    if (addr == MAP_FAILED) {
+      error->Init(S2Error::RESOURCE_EXHAUSTED, "Could not map %s: %s", path,
+                  strerror(errno));
+      close(fd);
+      size_ = 0;
+      return false;
+    }
+    data_ = static_cast<const char*>(addr);
+    mapped_ = true;
+  }
+  // The mapping remains valid after the file descriptor is closed.
+  close(fd);
+#else
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    error->Init(S2Error::INVALID_ARGUMENT, "Could not open %s", path);
+    return false;
+  }
+  buffer_.assign(std::istreambuf_iterator<char>(in),
+                 std::istreambuf_iterator<char>());
+  data_ = buffer_.data();
+  size_ = buffer_.size();
+#endif
+  Advise(options.advice());
+  if (options.prefetch()) Prefetch();
+
+  decoder_.reset(data_, size_);
+  index_->set_decoded_cell_cache(options.decoded_cell_cache());
+  auto shape_factory = s2shapeutil::LazyDecodeShapeFactory(&decoder_, *error);
+  if (!error->ok()) return false;
+  if (!index_->Init(&decoder_, shape_factory)) {
+    error->Init(S2Error::DATA_LOSS, "Corrupted encoded index in %s", path);
+    return false;
+  }
+  return true;
+}
+
+namespace {
+
+// Writes the shapes of "index" followed by the output of "encode_index".
+bool WriteIndexFile(const S2ShapeIndex& index, absl::string_view filename,
+                    const std::function<bool(S2EncodingSink*)>& encode_index,
+                    S2Error* error) {
+  error->Clear();
+  string path(filename);
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    error->Init(S2Error::INVALID_ARGUMENT, "Could not create %s: %s", path,
+                strerror(errno));
+    return false;
+  }
+  bool write_ok = true;
+  S2CallbackSink sink([file, &write_ok](absl::string_view data) {
+    write_ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    return write_ok;
+  });
+  bool ok = s2shapeutil::CompactEncodeTaggedShapes(index, &sink);
+  if (!ok && write_ok) {
+    std::fclose(file);
+    error->Init(S2Error::INVALID_ARGUMENT,
+                "Index contains shapes that cannot be encoded");
+    return false;
+  }
+  ok = ok && encode_index(&sink);
+  ok &= (std::fclose(file) == 0);
+  if (!ok) {
+    error->Init(S2Error::DATA_LOSS, "Could not write %s", path);
+  }
+  return ok;
+}
+
+}  // namespace
+
+bool MappedS2ShapeIndex::WriteFile(const S2ShapeIndex& index,
+                                   absl::string_view filename,
+                                   S2Error* error) {
+  return WriteIndexFile(
+      index, filename,
+      [&index](S2EncodingSink* sink) {
+        Encoder encoder;
+        index.Encode(&encoder);
+        return sink->Append(
+            absl::string_view(encoder.base(), encoder.length()));
+      },
+      error);
+}
+
+bool MappedS2ShapeIndex::WriteFile(const MutableS2ShapeIndex& index,
+                                   absl::string_view filename,
+                                   S2Error* error) {
+  return WriteIndexFile(
+      index, filename,
+      [&index](S2EncodingSink* sink) { return index.Encode(sink); }, error);
+}
+
+void MappedS2ShapeIndex::Advise(Advice advice, size_t offset,
+                                size_t length) const {
+#ifndef _WIN32
+  if (!mapped_ || offset >= size_) return;
+  length = std::min(length, size_ - offset);
+
+  // madvise() requires the start address to be page-aligned.
+  static const size_t kPageSize = sysconf(_SC_PAGESIZE);
+  size_t start = offset - offset % kPageSize;
+  length += offset - start;
+
+  int flag = MADV_NORMAL;
+  switch (advice) {
+    case Advice::NORMAL:     flag = MADV_NORMAL;     break;
+    case Advice::RANDOM:     flag = MADV_RANDOM;     break;
+    case Advice::SEQUENTIAL: flag = MADV_SEQUENTIAL; break;
+    case Advice::WILLNEED:   flag = MADV_WILLNEED;   break;
+    case Advice::DONTNEED:   flag = MADV_DONTNEED;   break;
+  }
+  // Advice is only a hint, so errors are ignored.
+  madvise(const_cast<char*>(data_) + start, length, flag);
+#endif
+}
+
+void MappedS2ShapeIndex::Unmap() {
+#ifndef _WIN32
+  if (mapped_) munmap(const_cast<char*>(data_), size_);
+#endif
+  mapped_ = false;
+  data_ = nullptr;
+  size_ = 0;
+  buffer_.clear();
+}
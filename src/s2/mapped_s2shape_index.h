@@ -0,0 +1,217 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_MAPPED_S2SHAPE_INDEX_H_
+#define S2_MAPPED_S2SHAPE_INDEX_H_
+
+#include <cstddef>
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/strings/string_view.h"
+#include "s2/util/coding/coder.h"
+#include "s2/encoded_s2shape_index.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s2error.h"
+#include "s2/s2shape_index.h"
+
+// MappedS2ShapeIndex is a file-backed EncodedS2ShapeIndex.  The file is
+// memory-mapped (read-only) and both the index cells and the shapes are
+// decoded lazily, directly from the mapping.  No data is copied or read
+// eagerly: the only I/O is the page faults that occur when a query touches a
+// portion of the file for the first time.  This makes it possible to open
+// very large indexes in constant time and to serve queries from indexes that
+// are larger than physical memory.
+//
+// The file format is the one produced by the example in
+// encoded_s2shape_index.h, i.e. an encoded shape vector (see
+// s2shapeutil::CompactEncodeTaggedShapes) followed by the encoded index.
+// WriteFile() is a convenience function that writes this format:
+//
+//   S2Error error;
+//   if (!MappedS2ShapeIndex::WriteFile(mutable_index, filename, &error)) ...
+//
+// Example code showing how to use a mapped index:
+//
+//   MappedS2ShapeIndex mapped;
+//   S2Error error;
+//   if (!mapped.Open(filename, &error)) { ... }
+//   S2ClosestEdgeQuery query(&mapped.index());
+//
+// The kernel can be told how the mapping will be accessed using Advise().
+// By default the whole mapping is advised as RANDOM, since queries typically
+// touch only a few widely separated cells.  Clients that know they will
+// visit most of the index (e.g., a full scan or a boolean operation against
+// a large region) can call Prefetch() to start reading the file in the
+// background.
+//
+// On platforms without mmap() the file is read into memory instead, and the
+// advice methods have no effect.
+//
+// MappedS2ShapeIndex is thread-compatible, with the same caveats as
+// EncodedS2ShapeIndex.
+class MappedS2ShapeIndex {
+ public:
+  // Access pattern hints for the mapped file (see madvise(2)).
+  enum class Advice {
+    NORMAL,      // No special treatment.
+    RANDOM,      // Pages are accessed in random order; disable read-ahead.
+    SEQUENTIAL,  // Pages are accessed sequentially; read ahead aggressively.
+    WILLNEED,    // Pages will be needed soon; start reading them now.
+    DONTNEED,    // Pages are not needed; they may be dropped from memory.
+  };
+
+  class Options {
+   public:
+    Options();
+
+    // The access pattern hint applied to the entire mapping when the file is
+    // opened.
+    //
+    // DEFAULT: Advice::RANDOM
+    Advice advice() const;
+    void set_advice(Advice advice);
+
+    // If true, the kernel is asked to populate the entire mapping when the
+    // file is opened (i.e., the file is read eagerly in the background).
+    // This is useful when most of the index will be accessed.
+    //
+    // DEFAULT: false
+    bool prefetch() const;
+    void set_prefetch(bool prefetch);
+
+    // If non-null, the memory used by decoded cells is bounded by the given
+    // cache, which may be shared with other indexes.  Evicted cells are
+    // freed by ReleaseEvictedCells().
+    //
+    // DEFAULT: nullptr
+    const std::shared_ptr<EncodedS2ShapeIndex::DecodedCellCache>&
+    decoded_cell_cache() const;
+    void set_decoded_cell_cache(
+        std::shared_ptr<EncodedS2ShapeIndex::DecodedCellCache> cache);
+
+   private:
+    Advice advice_ = Advice::RANDOM;
+    bool prefetch_ = false;
+    std::shared_ptr<EncodedS2ShapeIndex::DecodedCellCache> decoded_cell_cache_;
+  };
+
+  // Creates an object that must be initialized by calling Open().
+  MappedS2ShapeIndex();
+
+  // Unmaps the file.  All shapes and iterators obtained from index() are
+  // invalidated.
+  ~MappedS2ShapeIndex();
+
+  MappedS2ShapeIndex(const MappedS2ShapeIndex&) = delete;
+  MappedS2ShapeIndex& operator=(const MappedS2ShapeIndex&) = delete;
+
+  // Maps the given file into memory and initializes index() from it,
+  // returning true on success.  Otherwise returns false and sets "error".
+  // Shapes are decoded using s2shapeutil::LazyDecodeShape, so that all
+  // shape types that support lazy decoding are served from the mapping.
+  //
+  // REQUIRES: Open() has not been called before.
+  bool Open(absl::string_view filename, S2Error* error);
+  bool Open(absl::string_view filename, const Options& options,
+            S2Error* error);
+
+  // Writes the given index and its shapes to a file in the format expected
+  // by Open(), returning true on success.  Otherwise returns false and sets
+  // "error".  Shapes are encoded using s2shapeutil::CompactEncodeTaggedShapes.
+  //
+  // The output is streamed to the file so that only a bounded amount of it
+  // is held in memory.  (For index types other than MutableS2ShapeIndex the
+  // index portion is encoded into memory first.)
+  static bool WriteFile(const S2ShapeIndex& index, absl::string_view filename,
+                        S2Error* error);
+  static bool WriteFile(const MutableS2ShapeIndex& index,
+                        absl::string_view filename, S2Error* error);
+
+  // Returns the index backed by the mapped file.
+  //
+  // REQUIRES: Open() returned true.
+  const EncodedS2ShapeIndex& index() const { return *index_; }
+
+  // Returns the mapped file contents.
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+  // Applies the given access pattern hint to the byte range [offset, offset +
+  // length) of the mapped file.  The range is clamped to the file size and
+  // expanded to page boundaries.  Hints are advisory only and errors are
+  // ignored.
+  void Advise(Advice advice, size_t offset, size_t length) const;
+
+  // Applies the given access pattern hint to the entire mapped file.
+  void Advise(Advice advice) const { Advise(advice, 0, size_); }
+
+  // Asks the kernel to start reading the entire file into memory.
+  // Equivalent to Advise(Advice::WILLNEED).
+  void Prefetch() const { Advise(Advice::WILLNEED); }
+
+  // Frees the cells that have been evicted by the decoded cell cache (see
+  // EncodedS2ShapeIndex::ReleaseEvictedCells).
+  void ReleaseEvictedCells() { index_->ReleaseEvictedCells(); }
+
+ private:
+  void Unmap();
+
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  bool mapped_ = false;
+  std::string buffer_;  // Used only when mmap() is not available.
+  Decoder decoder_;
+
+  // The index is destroyed before the file is unmapped.
+  std::unique_ptr<EncodedS2ShapeIndex> index_;
+};
+
+
+//////////////////   Implementation details follow   ////////////////////
+
+
+inline MappedS2ShapeIndex::Options::Options() = default;
+
+inline MappedS2ShapeIndex::Advice
+MappedS2ShapeIndex::Options::advice() const {
+  return advice_;
+}
+
+inline void MappedS2ShapeIndex::Options::set_advice(Advice advice) {
+  advice_ = advice;
+}
+
+inline bool MappedS2ShapeIndex::Options::prefetch() const {
+  return prefetch_;
+}
+
+inline void MappedS2ShapeIndex::Options::set_prefetch(bool prefetch) {
+  prefetch_ = prefetch;
+}
+
+inline const std::shared_ptr<EncodedS2ShapeIndex::DecodedCellCache>&
+MappedS2ShapeIndex::Options::decoded_cell_cache() const {
+  return decoded_cell_cache_;
+}
+
+inline void MappedS2ShapeIndex::Options::set_decoded_cell_cache(
+    std::shared_ptr<EncodedS2ShapeIndex::DecodedCellCache> cache) {
+  decoded_cell_cache_ = std::move(cache);
+}
+
+#endif  // S2_MAPPED_S2SHAPE_INDEX_H_
@@ -0,0 +1,118 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/mapped_s2shape_index.h"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2closest_edge_query.h"
+#include "s2/s2error.h"
+#include "s2/s2fractal.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2polygon.h"
+#include "s2/s2shapeutil_testing.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+
+using absl::StrCat;
+using std::make_unique;
+using std::string;
+
+namespace {
+
+string TempFilename(const char* name) {
+  return StrCat(testing::TempDir(), "/mapped_s2shape_index_test_", name);
+}
+
+void WriteRawFile(const string& filename, const string& contents) {
+  std::FILE* file = std::fopen(filename.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  std::fwrite(contents.data(), 1, contents.size(), file);
+  std::fclose(file);
+}
+
+TEST(MappedS2ShapeIndex, Empty) {
+  MutableS2ShapeIndex expected;
+  string filename = TempFilename("empty");
+  S2Error error;
+  ASSERT_TRUE(MappedS2ShapeIndex::WriteFile(expected, filename, &error))
+      << error;
+  MappedS2ShapeIndex mapped;
+  ASSERT_TRUE(mapped.Open(filename, &error)) << error;
+  s2testing::ExpectEqual(expected, mapped.index());
+  std::remove(filename.c_str());
+}
+
+TEST(MappedS2ShapeIndex, MatchesInMemoryIndex) {
+  auto expected = s2textformat::MakeIndexOrDie(
+      "0:0 | 1:1 | 2:2 # 3:3, 4:4, 5:5 | 6:6, 7:7 # 10:10, 10:20, 20:20");
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3000);
+  S2Polygon polygon(
+      fractal.MakeLoop(S2Testing::GetRandomFrame(), S1Angle::Degrees(5)));
+  expected->Add(make_unique<S2LaxPolygonShape>(polygon));
+
+  string filename = TempFilename("fractal");
+  S2Error error;
+  ASSERT_TRUE(MappedS2ShapeIndex::WriteFile(*expected, filename, &error))
+      << error;
+
+  MappedS2ShapeIndex::Options options;
+  options.set_advice(MappedS2ShapeIndex::Advice::SEQUENTIAL);
+  MappedS2ShapeIndex mapped;
+  ASSERT_TRUE(mapped.Open(filename, options, &error)) << error;
+  EXPECT_GT(mapped.size(), 0);
+  mapped.Prefetch();
+  mapped.Advise(MappedS2ShapeIndex::Advice::RANDOM, 1, mapped.size() / 2);
+  s2testing::ExpectEqual(*expected, mapped.index());
+
+  // Queries served from the mapping should give identical results.
+  S2ClosestEdgeQuery expected_query(expected.get());
+  S2ClosestEdgeQuery actual_query(&mapped.index());
+  for (int i = 0; i < 20; ++i) {
+    S2ClosestEdgeQuery::PointTarget target(S2Testing::RandomPoint());
+    EXPECT_EQ(expected_query.GetDistance(&target),
+              actual_query.GetDistance(&target));
+  }
+  std::remove(filename.c_str());
+}
+
+TEST(MappedS2ShapeIndex, MissingFile) {
+  MappedS2ShapeIndex mapped;
+  S2Error error;
+  EXPECT_FALSE(mapped.Open(TempFilename("does_not_exist"), &error));
+  EXPECT_EQ(error.code(), S2Error::INVALID_ARGUMENT);
+}
+
+TEST(MappedS2ShapeIndex, CorruptFile) {
+  string filename = TempFilename("corrupt");
+  WriteRawFile(filename, "\xff\xff\xff");
+  MappedS2ShapeIndex mapped;
+  S2Error error;
+  EXPECT_FALSE(mapped.Open(filename, &error));
+  EXPECT_EQ(error.code(), S2Error::DATA_LOSS);
+  std::remove(filename.c_str());
+}
+
+}  // namespace
@@ -21,16 +21,26 @@
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cmath>
+#include <iterator>
 #include <memory>
+#include <memory_resource>
+#include <new>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "s2/base/casts.h"
 #include "s2/base/commandlineflags.h"
+#include "s2/base/executor.h"
+#include "s2/base/port.h"
 #include "s2/base/types.h"
 #include "absl/base/attributes.h"
+#include "absl/base/optimization.h"
+#include "absl/cleanup/cleanup.h"
 #include "absl/container/btree_map.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/flags/flag.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
@@ -40,6 +50,7 @@
 #include "s2/util/coding/varint.h"
 #include "s2/encoded_s2cell_id_vector.h"
 #include "s2/encoded_string_vector.h"
+#include "s2/encoded_uint_vector.h"
 #include "s2/r1interval.h"
 #include "s2/r2.h"
 #include "s2/r2rect.h"
@@ -48,22 +59,28 @@
 #include "s2/s2coords.h"
 #include "s2/s2edge_clipping.h"
 #include "s2/s2edge_crosser.h"
+#include "s2/s2encoding_sink.h"
 #include "s2/s2memory_tracker.h"
 #include "s2/s2metrics.h"
 #include "s2/s2padded_cell.h"
 #include "s2/s2point.h"
+#include "s2/s2point_span.h"
 #include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
 #include "s2/s2shapeutil_contains_brute_force.h"
 #include "s2/s2shapeutil_shape_edge_id.h"
+#include "s2/s2telemetry.h"
 #include "s2/util/gtl/compact_array.h"
 #include "s2/util/math/mathutil.h"
 
 using std::fabs;
 using std::make_pair;
+using std::make_shared;
 using std::make_unique;
 using std::max;
 using std::min;
+using std::shared_ptr;
+using std::string;
 using std::unique_ptr;
 using std::vector;
 
@@ -194,6 +211,11 @@ void MutableS2ShapeIndex::Options::set_max_edges_per_cell(
   max_edges_per_cell_ = max_edges_per_cell;
 }
 
+void MutableS2ShapeIndex::Options::set_num_threads(int num_threads) {
+  ABSL_DCHECK_GE(num_threads, 1);
+  num_threads_ = num_threads;
+}
+
 // FaceEdge and ClippedEdge store temporary edge data while the index is being
 // updated.  FaceEdge represents an edge that has been projected onto a given
 // face, while ClippedEdge represents the portion of that edge that has been
@@ -251,6 +273,11 @@ class MutableS2ShapeIndex::InteriorTracker {
   // that will be tracked before calling MoveTo() or DrawTo().
   InteriorTracker();
 
+  // Copies the state of the given tracker.  This is used to build disjoint
+  // parts of the index concurrently (see UpdateFacesInParallel).  Note that
+  // DrawTo() must be called before TestEdge() on the new tracker.
+  InteriorTracker(const InteriorTracker& other);
+
   // Returns the initial focus point when the InteriorTracker is constructed
   // (corresponding to the start of the S2CellId space-filling curve).
   static S2Point Origin();
@@ -354,6 +381,19 @@ MutableS2ShapeIndex::InteriorTracker::InteriorTracker()
     : b_(Origin()), next_cellid_(S2CellId::Begin(S2CellId::kMaxLevel)) {
 }
 
+MutableS2ShapeIndex::InteriorTracker::InteriorTracker(
+    const InteriorTracker& other)
+    : is_active_(other.is_active_),
+      a_(other.a_),
+      b_(other.b_),
+      next_cellid_(other.next_cellid_),
+      shape_ids_(other.shape_ids_),
+      saved_ids_(other.saved_ids_),
+      saved_is_active_(other.saved_is_active_),
+      partial_shape_id_(other.partial_shape_id_) {
+  // "crosser_" is not copied since it refers to the endpoints of "other".
+}
+
 S2Point MutableS2ShapeIndex::InteriorTracker::Origin() {
   // The start of the S2CellId space-filling curve.
   return S2::FaceUVtoXYZ(0, -1, -1).Normalize();
@@ -446,6 +486,11 @@ MutableS2ShapeIndex::MutableS2ShapeIndex(MutableS2ShapeIndex&& b)
       options_(std::move(b.options_)),
       pending_additions_begin_(std::exchange(b.pending_additions_begin_, 0)),
       pending_removals_(std::move(b.pending_removals_)),
+      update_stats_(b.update_stats_),
+      face_params_{b.face_params_[0], b.face_params_[1], b.face_params_[2],
+                   b.face_params_[3], b.face_params_[4], b.face_params_[5]},
+      epoch_(std::move(b.epoch_)),
+      published_snapshot_(std::move(b.published_snapshot_)),
       index_status_(b.index_status_.exchange(FRESH, std::memory_order_relaxed)),
       mem_tracker_(std::move(b.mem_tracker_)) {}
 
@@ -459,6 +504,10 @@ MutableS2ShapeIndex& MutableS2ShapeIndex::operator=(MutableS2ShapeIndex&& b) {
   options_ = std::move(b.options_);
   pending_additions_begin_ = std::exchange(b.pending_additions_begin_, 0);
   pending_removals_ = std::move(b.pending_removals_);
+  update_stats_ = b.update_stats_;
+  std::copy(b.face_params_, b.face_params_ + 6, face_params_);
+  epoch_ = std::move(b.epoch_);
+  published_snapshot_ = std::move(b.published_snapshot_);
   index_status_.store(
       b.index_status_.exchange(FRESH, std::memory_order_relaxed),
       std::memory_order_relaxed);
@@ -468,6 +517,14 @@ MutableS2ShapeIndex& MutableS2ShapeIndex::operator=(MutableS2ShapeIndex&& b) {
 
 void MutableS2ShapeIndex::Init(const Options& options) {
   ABSL_DCHECK(shapes_.empty());
+  if (options.memory_resource() != options_.memory_resource()) {
+    // Cells must be freed by the resource that allocated them, so we release
+    // any remaining cells now.  Snapshots keep the cells they refer to alive
+    // in the current epoch, which remembers the old resource.  Later epochs
+    // are not chained to it since they only hold cells from the new one.
+    Minimize();
+    epoch_.reset();
+  }
   options_ = options;
   // Memory tracking is not affected by this method.
 }
@@ -482,6 +539,39 @@ void MutableS2ShapeIndex::set_memory_tracker(S2MemoryTracker* tracker) {
   if (mem_tracker_.is_active()) mem_tracker_.Tally(SpaceUsed());
 }
 
+// Prefetches the cells ahead of the current position in three stages.  The
+// S2ShapeIndexCell "prefetch_distance_" cells ahead is prefetched first,
+// then its clipped shapes once it is half as far away, and finally its edge
+// ids once it is a quarter as far away.  Each stage reads only data that was
+// prefetched by the previous stage several calls earlier.
+void MutableS2ShapeIndex::Iterator::Prefetch() {
+  const int distance = prefetch_distance_;
+  const bool pipeline_full = (num_ahead_ == distance);
+  if (num_ahead_ > 0) {
+    --num_ahead_;
+  } else {
+    ahead_ = iter_;
+  }
+  // At most two cells are prefetched per call so that iterators that are
+  // advanced only a few times after each seek do not prefetch many cells
+  // that they never visit.
+  for (int i = 0; i < 2 && num_ahead_ < distance && ahead_ != end_; ++i) {
+    if (++ahead_ == end_) break;
+    S2Prefetch(ahead_->second);
+    ++num_ahead_;
+  }
+  if (num_ahead_ < distance) return;
+  if (pipeline_full) {
+    ++mid_;
+    ++near_;
+  } else {
+    mid_ = std::next(iter_, distance / 2);
+    near_ = std::next(iter_, distance / 4);
+  }
+  mid_->second->PrefetchClippedShapes();
+  near_->second->PrefetchEdges();
+}
+
 // Called to set the index status when the index needs to be rebuilt.
 void MutableS2ShapeIndex::MarkIndexStale() {
   // The UPDATING status can only be changed in ApplyUpdatesThreadSafe().
@@ -497,7 +587,7 @@ void MutableS2ShapeIndex::Minimize() {
   mem_tracker_.Tally(-mem_tracker_.client_usage_bytes());
   Iterator it;
   for (it.InitStale(this, S2ShapeIndex::BEGIN); !it.done(); it.Next()) {
-    delete &it.cell();
+    RetireCell(&it.cell());
   }
   cell_map_.clear();
   pending_removals_.reset();
@@ -517,6 +607,15 @@ int MutableS2ShapeIndex::Add(unique_ptr<S2Shape> shape) {
   return id;
 }
 
+int MutableS2ShapeIndex::AddShapes(vector<unique_ptr<S2Shape>> shapes) {
+  const int id = shapes_.size();
+  if (shapes.empty()) return id;
+  mem_tracker_.AddSpace(&shapes_, shapes.size());
+  for (auto& shape : shapes) shapes_.push_back(std::move(shape));
+  MarkIndexStale();
+  return id;
+}
+
 unique_ptr<S2Shape> MutableS2ShapeIndex::Release(int shape_id) {
   // This class updates itself lazily, because it is much more efficient to
   // process additions and removals in batches.  However this means that when
@@ -565,7 +664,52 @@ vector<unique_ptr<S2Shape>> MutableS2ShapeIndex::ReleaseAll() {
 }
 
 void MutableS2ShapeIndex::Clear() {
-  ReleaseAll();
+  for (auto& shape : ReleaseAll()) {
+    RetireShape(std::move(shape));
+  }
+}
+
+vector<int> MutableS2ShapeIndex::Compact() {
+  ForceBuild();
+  const int num_shape_ids = shapes_.size();
+  vector<int> new_ids(num_shape_ids, -1);
+  int num_shapes = 0;
+  int first_renumbered = num_shape_ids;  // The first id that is not kept.
+  for (int id = 0; id < num_shape_ids; ++id) {
+    if (shapes_[id] == nullptr) {
+      first_renumbered = std::min(first_renumbered, id);
+      continue;
+    }
+    new_ids[id] = num_shapes;
+    if (id != num_shapes) shapes_[num_shapes] = std::move(shapes_[id]);
+    ++num_shapes;
+  }
+  if (num_shapes == num_shape_ids) return new_ids;
+
+  shapes_.resize(num_shapes);
+  shapes_.shrink_to_fit();
+  pending_additions_begin_ = num_shapes;
+  // Renumbering preserves the order of the clipped shapes within each cell,
+  // so they can be updated in place.  Cells that only contain shapes
+  // preceding the first removed shape are unchanged.
+  for (auto it = cell_map_.begin(); it != cell_map_.end(); ++it) {
+    const S2ShapeIndexCell& cell = *it->second;
+    if (cell.clipped(cell.num_clipped() - 1).shape_id() < first_renumbered) {
+      continue;
+    }
+    for (S2ClippedShape& clipped : MutableCell(it)->shapes_) {
+      clipped.shape_id_ = new_ids[clipped.shape_id_];
+    }
+  }
+  // Rebuilding the cell map from its sorted contents packs its nodes densely,
+  // which reclaims the space left behind by removed cells.
+  CellMap packed;
+  packed.insert(cell_map_.begin(), cell_map_.end());
+  cell_map_.swap(packed);
+  if (mem_tracker_.is_active()) {
+    mem_tracker_.Tally(SpaceUsed() - mem_tracker_.client_usage_bytes());
+  }
+  return new_ids;
 }
 
 // Apply any pending updates in a thread-safe way.
@@ -574,15 +718,7 @@ void MutableS2ShapeIndex::ApplyUpdatesThreadSafe() {
   if (index_status_.load(std::memory_order_relaxed) == FRESH) {
     lock_.Unlock();
   } else if (index_status_.load(std::memory_order_relaxed) == UPDATING) {
-    // Wait until the updating thread is finished.  We do this by attempting
-    // to lock a mutex that is held by the updating thread.  When this mutex
-    // is unlocked the index_status_ is guaranteed to be FRESH.
-    ++update_state_->num_waiting;
-    lock_.Unlock();
-    update_state_->wait_mutex.Lock();
-    lock_.Lock();
-    --update_state_->num_waiting;
-    UnlockAndSignal();  // Notify other waiting threads.
+    UnlockAndWait();
   } else {
     ABSL_DCHECK_EQ(STALE, index_status_);
     index_status_.store(UPDATING, std::memory_order_relaxed);
@@ -609,16 +745,66 @@ void MutableS2ShapeIndex::ApplyUpdatesThreadSafe() {
   }
 }
 
+// Waits for the thread that is applying updates (if any) to finish without
+// ever applying them on this thread, and returns true if the index is then
+// fresh.
+bool MutableS2ShapeIndex::WaitForUpdatesThreadSafe() {
+  lock_.Lock();
+  IndexStatus status = index_status_.load(std::memory_order_relaxed);
+  if (status == UPDATING) {
+    UnlockAndWait();
+    return true;
+  }
+  lock_.Unlock();
+  return status == FRESH;
+}
+
+bool MutableS2ShapeIndex::TryBuild(BuildPolicy policy) const {
+  if (index_status_.load(std::memory_order_acquire) == FRESH) return true;
+  switch (policy) {
+    case BuildPolicy::BUILD:
+      const_cast<MutableS2ShapeIndex*>(this)->ApplyUpdatesThreadSafe();
+      return true;
+    case BuildPolicy::WAIT:
+      return const_cast<MutableS2ShapeIndex*>(this)->WaitForUpdatesThreadSafe();
+    case BuildPolicy::FAIL_FAST:
+      return false;
+  }
+  ABSL_UNREACHABLE();
+}
+
+// Releases lock_ and waits until the updating thread is finished.  We do this
+// by acquiring a shared lock on a mutex that is held exclusively by the
+// updating thread, so that all waiting threads proceed at once when it is
+// unlocked.  At that point index_status_ is guaranteed to be FRESH.  The last
+// waiting thread also deletes update_state_.
+// REQUIRES: lock_ is held.
+// REQUIRES: index_status_ == UPDATING.
+void MutableS2ShapeIndex::UnlockAndWait() {
+  ++update_state_->num_waiting;
+  lock_.Unlock();
+  update_state_->wait_mutex.ReaderLock();
+  lock_.Lock();
+  ABSL_DCHECK_EQ(FRESH, index_status_);
+  // The shared lock is released while holding lock_ so that no other waiting
+  // thread can delete update_state_ before we are done with it.
+  update_state_->wait_mutex.ReaderUnlock();
+  if (--update_state_->num_waiting == 0) {
+    update_state_.reset();
+  }
+  lock_.Unlock();
+}
+
 // Releases lock_ and wakes up any waiting threads by releasing wait_mutex.
-// If this was the last waiting thread, also deletes update_state_.
+// If there are no waiting threads, also deletes update_state_.
 // REQUIRES: lock_ is held.
 // REQUIRES: wait_mutex is held.
 inline void MutableS2ShapeIndex::UnlockAndSignal() {
   ABSL_DCHECK_EQ(FRESH, index_status_);
   int num_waiting = update_state_->num_waiting;
   lock_.Unlock();
-  // Allow another waiting thread to proceed.  Note that no new threads can
-  // start waiting because the index_status_ is now FRESH, and the caller is
+  // Allow the waiting threads to proceed.  Note that no new threads can start
+  // waiting because the index_status_ is now FRESH, and the caller is
   // required to prevent any new mutations from occurring while these const
   // methods are running.
   //
@@ -633,10 +819,38 @@ inline void MutableS2ShapeIndex::UnlockAndSignal() {
 // This method updates the index by applying all pending additions and
 // removals.  It does *not* update index_status_ (see ApplyUpdatesThreadSafe).
 void MutableS2ShapeIndex::ApplyUpdatesInternal() {
+  auto start = std::chrono::steady_clock::now();
+  update_stats_ = UpdateStats();
+  update_stats_.num_cells_before = cell_map_.size();
+  if (pending_removals_) {
+    update_stats_.num_shapes_removed = pending_removals_->size();
+    for (const auto& pending_removal : *pending_removals_) {
+      update_stats_.num_edges_removed += pending_removal.edges.size();
+    }
+  }
+  for (size_t id = pending_additions_begin_; id < shapes_.size(); ++id) {
+    const S2Shape* shape = this->shape(id);
+    if (shape == nullptr) continue;
+    ++update_stats_.num_shapes_added;
+    update_stats_.num_edges_added += shape->num_edges();
+  }
+  auto record_stats = absl::MakeCleanup([this, start]() {
+    update_stats_.num_cells_after = cell_map_.size();
+    update_stats_.elapsed =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+     S2_TELEMETRY_HISTOGRAM_RECORD(
+        "mutable_s2shape_index.update_us",
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            update_stats_.elapsed).count());
+  });
+
   // Check whether we have so many edges to process that we should process
   // them in multiple batches to save memory.  Building the index can use up
   // to 20x as much memory (per edge) as the final index size.
   vector<BatchDescriptor> batches = GetUpdateBatches();
+  update_stats_.num_batches = batches.size();
+  if (options_.auto_tune()) AutoTuneFaces();
   for (const BatchDescriptor& batch : batches) {
     if (mem_tracker_.is_active()) {
       ABSL_DCHECK_EQ(mem_tracker_.client_usage_bytes(),
@@ -665,10 +879,17 @@ void MutableS2ShapeIndex::ApplyUpdatesInternal() {
       AddShape(shape, begin.shape_id, begin.edge_id, edges_end, all_edges,
                &tracker);
     }
-    for (int face = 0; face < 6; ++face) {
-      UpdateFaceEdges(face, all_edges[face], &tracker);
-      // Save memory by clearing vectors after we are done with them.
-      vector<FaceEdge>().swap(all_edges[face]);
+    if (options_.num_threads() > 1) {
+      UpdateFacesInParallel(all_edges, &tracker);
+      for (int face = 0; face < 6; ++face) {
+        vector<FaceEdge>().swap(all_edges[face]);
+      }
+    } else {
+      for (int face = 0; face < 6; ++face) {
+        UpdateFaceEdges(face, all_edges[face], &tracker);
+        // Save memory by clearing vectors after we are done with them.
+        vector<FaceEdge>().swap(all_edges[face]);
+      }
     }
     pending_additions_begin_ = batch.end.shape_id;
     if (batch.begin.edge_id > 0 && batch.end.edge_id == 0) {
@@ -1017,11 +1238,44 @@ void MutableS2ShapeIndex::AddShape(const S2Shape* shape, int shape_id,
           s2shapeutil::ContainsBruteForce(*shape, tracker->focus()));
     }
   }
-  for (int e = edges_begin; e < edges_end; ++e) {
-    edge.edge_id = e;
-    edge.edge = shape->edge(e);
-    edge.max_level = GetEdgeMaxLevel(edge.edge);
-    AddFaceEdge(&edge, all_edges);
+  if (edges_begin >= edges_end) return;
+
+  // Visit the edges one chain at a time so that shapes whose chain vertices
+  // are stored contiguously can be read directly from memory.  For such
+  // chains the face and (u,v) coordinates of each vertex are computed once
+  // for the whole chain rather than twice per edge.
+  vector<S2::FaceUVPoint> face_uvs;
+  int e = edges_begin;
+  for (int i = shape->chain_position(e).chain_id; e < edges_end; ++i) {
+    S2Shape::Chain chain = shape->chain(i);
+    S2PointSpan v = shape->chain_vertex_span(i);
+    const int chain_end = min(chain.start + chain.length, edges_end);
+    if (v.empty()) {
+      for (; e < chain_end; ++e) {
+        edge.edge_id = e;
+        edge.edge = shape->chain_edge(i, e - chain.start);
+        edge.max_level = GetEdgeMaxLevel(edge.edge);
+        AddFaceEdge(&edge, all_edges);
+      }
+      continue;
+    }
+    // Convert vertices [j_begin, j_end] of this batch, where the last edge of
+    // a closed chain ends at vertex 0.
+    const int n = v.size();
+    const int j_begin = e - chain.start, j_end = chain_end - chain.start;
+    const int num_contiguous = min(j_end + 1, n) - j_begin;
+    face_uvs.resize(j_end - j_begin + 1);
+    S2::GetFaceUVPoints(v.subspan(j_begin, num_contiguous),
+                        absl::MakeSpan(face_uvs).first(num_contiguous));
+    if (j_end == n) face_uvs.back() = S2::GetFaceUVPoint(v[0]);
+    for (; e < chain_end; ++e) {
+      const int j = e - chain.start;
+      edge.edge_id = e;
+      edge.edge = S2Shape::ChainVertexSpanEdge(v, j);
+      edge.max_level = GetEdgeMaxLevel(edge.edge);
+      AddFaceEdge(&edge, face_uvs[j - j_begin], face_uvs[j - j_begin + 1],
+                  all_edges);
+    }
   }
 }
 
@@ -1090,7 +1344,7 @@ void MutableS2ShapeIndex::FinishPartialShape(int shape_id) {
                                         : S2CellId::End(S2CellId::kMaxLevel);
       if (begin != fill_end) {
         for (S2CellId cellid : S2CellUnion::FromBeginEnd(begin, fill_end)) {
-          S2ShapeIndexCell* cell = new S2ShapeIndexCell;
+          S2ShapeIndexCell* cell = NewCell();
           S2ClippedShape* clipped = cell->add_shapes(1);
           clipped->Init(shape_id, 0);
           clipped->set_contains_center(true);
@@ -1105,6 +1359,11 @@ void MutableS2ShapeIndex::FinishPartialShape(int shape_id) {
     S2CellId cellid = index_it->first;
     S2ShapeIndexCell* cell = index_it->second;
     int n = cell->shapes_.size();
+    if ((n > 0 && cell->shapes_[n - 1].shape_id() == shape_id) ||
+        !tracker.shape_ids().empty()) {
+      // This cell may be modified below.
+      cell = MutableCell(index_it);
+    }
     if (n > 0 && cell->shapes_[n - 1].shape_id() == shape_id) {
       // This cell contains edges of the partial shape.  If the partial shape
       // contains the center of this cell, we must update the index.
@@ -1168,15 +1427,161 @@ inline void MutableS2ShapeIndex::AddFaceEdge(
   }
 }
 
+inline void MutableS2ShapeIndex::AddFaceEdge(
+    FaceEdge* edge, const S2::FaceUVPoint& a, const S2::FaceUVPoint& b,
+    vector<FaceEdge> all_edges[6]) const {
+  // Same as above, except that the face and (u,v) coordinates of the
+  // endpoints have already been computed.
+  if (a.face == b.face) {
+    edge->a = a.uv;
+    edge->b = b.uv;
+    const double kMaxUV = 1 - kCellPadding;
+    if (fabs(edge->a[0]) <= kMaxUV && fabs(edge->a[1]) <= kMaxUV &&
+        fabs(edge->b[0]) <= kMaxUV && fabs(edge->b[1]) <= kMaxUV) {
+      all_edges[a.face].push_back(*edge);
+      return;
+    }
+  }
+  for (int face = 0; face < 6; ++face) {
+    if (S2::ClipToPaddedFace(edge->edge.v0, edge->edge.v1, a, b, face,
+                             kCellPadding, &edge->a, &edge->b)) {
+      all_edges[face].push_back(*edge);
+    }
+  }
+}
+
+MutableS2ShapeIndex::FaceParameters MutableS2ShapeIndex::face_parameters(
+    int face) const {
+  ABSL_DCHECK(face >= 0 && face < 6);
+  if (face_params_[face].auto_tuned) return face_params_[face];
+  FaceParameters params;
+  params.max_edges_per_cell = options_.max_edges_per_cell();
+  params.cell_size_to_long_edge_ratio =
+      absl::GetFlag(FLAGS_s2shape_index_cell_size_to_long_edge_ratio);
+  return params;
+}
+
+// Chooses the subdivision parameters of each face that does not contain any
+// existing index cells (see Options::auto_tune) by sampling the edges of the
+// shapes being added.
+//
+// For each face we estimate the number of edges "n", the median edge length
+// "len", and the number of cells occupied by the sampled edges at each level
+// (similar to the counts of an S2DensityTree).  From the latter we find the
+// "natural" level of the face, i.e. the first level where the occupied cells
+// contain at most max_edges_per_cell edges on average.  The long edge ratio
+// is then chosen so that edges of length "len" become long at that level.
+void MutableS2ShapeIndex::AutoTuneFaces() {
+  // The maximum number of edges sampled, and the minimum number of samples
+  // required on a face in order to tune it.
+  constexpr int kMaxSamples = 4096;
+  constexpr int kMinFaceSamples = 32;
+
+  // Faces with more than this many edges use a larger max_edges_per_cell.
+  constexpr double kLargeFaceEdges = 10000;
+  constexpr int kMaxTunedEdgesPerCell = 50;
+  constexpr double kMinLongEdgeRatio = 0.5, kMaxLongEdgeRatio = 4.0;
+
+  int64 num_edges = 0;
+  for (size_t id = pending_additions_begin_; id < shapes_.size(); ++id) {
+    const S2Shape* shape = this->shape(id);
+    if (shape) num_edges += shape->num_edges();
+  }
+  const int64 stride = max<int64>(1, num_edges / kMaxSamples);
+
+  // Sample every "stride"-th edge, keyed by the face of its first vertex.
+  vector<S2CellId> sample_ids[6];
+  vector<double> sample_lengths[6];
+  int64 next = 0, edge_count = 0;
+  for (size_t id = pending_additions_begin_; id < shapes_.size(); ++id) {
+    const S2Shape* shape = this->shape(id);
+    if (shape == nullptr) continue;
+    const int n = shape->num_edges();
+    for (; next < edge_count + n; next += stride) {
+      S2Shape::Edge edge = shape->edge(next - edge_count);
+      S2CellId cellid(edge.v0);
+      sample_ids[cellid.face()].push_back(cellid);
+      if (edge.v0 != edge.v1) {
+        sample_lengths[cellid.face()].push_back((edge.v0 - edge.v1).Norm());
+      }
+    }
+    edge_count += n;
+  }
+
+  // Only faces without existing index cells are tuned.
+  Iterator iter;
+  iter.InitStale(this);
+  for (int face = 0; face < 6; ++face) {
+    S2CellId face_id = S2CellId::FromFace(face);
+    if (iter.Locate(face_id) != S2CellRelation::DISJOINT) continue;
+    FaceParameters& params = face_params_[face];
+    params = FaceParameters();
+    vector<S2CellId>& ids = sample_ids[face];
+    if (ids.size() < kMinFaceSamples) continue;
+
+    // Larger faces use more edges per cell to save memory.
+    const int base_edges = options_.max_edges_per_cell();
+    const double face_edges = static_cast<double>(ids.size()) * stride;
+    params.max_edges_per_cell = base_edges;
+    if (face_edges > kLargeFaceEdges) {
+      params.max_edges_per_cell = min(
+          max(base_edges, kMaxTunedEdgesPerCell),
+          static_cast<int>(std::lround(
+              base_edges * (1 + std::log10(face_edges / kLargeFaceEdges)))));
+    }
+
+    params.cell_size_to_long_edge_ratio =
+        absl::GetFlag(FLAGS_s2shape_index_cell_size_to_long_edge_ratio);
+    vector<double>& lengths = sample_lengths[face];
+    if (!lengths.empty()) {
+      // Find the natural level by counting the distinct cells occupied by
+      // the samples at each level.  Once every sample is in its own cell the
+      // counts give no more information, so we assume that the number of
+      // edges per cell decreases by a factor of 4 per level after that.
+      std::sort(ids.begin(), ids.end());
+      int level = 0;
+      for (; level < S2CellId::kMaxLevel; ++level) {
+        int num_cells = 0;
+        S2CellId last = S2CellId::None();
+        for (S2CellId id : ids) {
+          S2CellId parent = id.parent(level);
+          num_cells += (parent != last);
+          last = parent;
+        }
+        double edges_per_cell = face_edges / num_cells;
+        if (edges_per_cell <= params.max_edges_per_cell) break;
+        if (num_cells == static_cast<int>(ids.size())) {
+          level += static_cast<int>(std::ceil(
+              0.5 * std::log2(edges_per_cell / params.max_edges_per_cell)));
+          level = min(level, S2CellId::kMaxLevel);
+          break;
+        }
+      }
+      auto median = lengths.begin() + lengths.size() / 2;
+      std::nth_element(lengths.begin(), median, lengths.end());
+      params.cell_size_to_long_edge_ratio =
+          std::clamp(S2::kAvgEdge.GetValue(level) / *median,
+                     kMinLongEdgeRatio, kMaxLongEdgeRatio);
+    }
+    params.auto_tuned = true;
+    ++update_stats_.num_faces_tuned;
+  }
+}
+
 // Returns the first level for which the given edge will be considered "long",
 // i.e. it will not count towards the max_edges_per_cell() limit.
 int MutableS2ShapeIndex::GetEdgeMaxLevel(const S2Shape::Edge& edge) const {
   // Compute the maximum cell edge length for which this edge is considered
   // "long".  The calculation does not need to be perfectly accurate, so we
-  // use Norm() rather than Angle() for speed.
-  double max_cell_edge =
-      ((edge.v0 - edge.v1).Norm() *
-       absl::GetFlag(FLAGS_s2shape_index_cell_size_to_long_edge_ratio));
+  // use Norm() rather than Angle() for speed.  Edges that span several
+  // faces use the ratio of the face containing their first vertex.
+  double ratio =
+      absl::GetFlag(FLAGS_s2shape_index_cell_size_to_long_edge_ratio);
+  if (options_.auto_tune()) {
+    const FaceParameters& params = face_params_[S2::GetFace(edge.v0)];
+    if (params.auto_tuned) ratio = params.cell_size_to_long_edge_ratio;
+  }
+  double max_cell_edge = (edge.v0 - edge.v1).Norm() * ratio;
 
   // Now return the first level encountered during subdivision where the
   // average cell edge length at that level is at most "max_cell_edge".
@@ -1199,6 +1604,7 @@ class MutableS2ShapeIndex::EdgeAllocator {
     if (size_ == clipped_edges_.size()) {
       clipped_edges_.emplace_back(new ClippedEdge);
     }
+    S2_TELEMETRY_COUNTER_INC("mutable_s2shape_index.edges_clipped");
     return clipped_edges_[size_++].get();
   }
   // Return the number of allocated edges.
@@ -1278,14 +1684,186 @@ void MutableS2ShapeIndex::UpdateFaceEdges(int face,
       SkipCellRange(face_id.range_min(), shrunk_id.range_min(),
                     tracker, &alloc, disjoint_from_index);
       pcell = S2PaddedCell(shrunk_id, kCellPadding);
-      UpdateEdges(pcell, &clipped_edges, tracker, &alloc, disjoint_from_index);
+      UpdateEdges(pcell, &clipped_edges, tracker, &alloc, disjoint_from_index,
+                  &cell_map_);
       SkipCellRange(shrunk_id.range_max().next(), face_id.range_max().next(),
                     tracker, &alloc, disjoint_from_index);
       return;
     }
   }
   // Otherwise (no edges, or no shrinking is possible), subdivide normally.
-  UpdateEdges(pcell, &clipped_edges, tracker, &alloc, disjoint_from_index);
+  UpdateEdges(pcell, &clipped_edges, tracker, &alloc, disjoint_from_index,
+              &cell_map_);
+}
+
+// A BuildTask represents a subtree of the index that does not overlap any
+// existing index cells and can therefore be built independently of all other
+// subtrees.  It consists of a cell, the edges that intersect that cell, and
+// the InteriorTracker state at the entry vertex of that cell.  The index cells
+// created by the task are merged into cell_map_ once all tasks are finished.
+struct MutableS2ShapeIndex::BuildTask {
+  BuildTask(const S2PaddedCell& _pcell,
+            const vector<const ClippedEdge*>& _edges,
+            const InteriorTracker& _tracker)
+      : pcell(_pcell), edges(_edges), tracker(_tracker) {}
+
+  S2PaddedCell pcell;
+  vector<const ClippedEdge*> edges;
+  InteriorTracker tracker;
+  CellMap cell_map;
+};
+
+// When building the index in parallel, subtrees are split into separate tasks
+// until each task has at most this many edges (or the total number of edges
+// divided by kBuildTasksPerThread times the number of threads, if larger).
+// Using several tasks per thread balances the load between threads when the
+// subtrees are of different sizes.
+static constexpr size_t kMinBuildTaskEdges = 1000;
+static constexpr int kBuildTasksPerThread = 8;
+
+// Like calling UpdateFaceEdges() for each face in turn, except that the
+// faces (and large subtrees within those faces) that do not overlap any
+// existing index cells are built concurrently using options_.num_threads()
+// threads.  Faces that contain existing index cells are updated sequentially.
+//
+// The key observation is that the InteriorTracker state at the entry vertex of
+// any cell can be computed in advance by moving the tracker along the
+// boundaries of the preceding cells (see AddBuildTasks).  Each subtree is then
+// built exactly as it would have been by the sequential algorithm, which
+// ensures that the resulting index is identical.
+void MutableS2ShapeIndex::UpdateFacesInParallel(
+    const vector<FaceEdge> all_edges[6], InteriorTracker* tracker) {
+  size_t total_edges = 0;
+  for (int face = 0; face < 6; ++face) total_edges += all_edges[face].size();
+  const size_t max_task_edges =
+      max(kMinBuildTaskEdges,
+          total_edges / (kBuildTasksPerThread * options_.num_threads()));
+
+  // The ClippedEdges referenced by the tasks must persist until all tasks are
+  // finished, and therefore "alloc" is never reset.
+  vector<ClippedEdge> clipped_edge_storage[6];
+  EdgeAllocator alloc;
+  vector<unique_ptr<BuildTask>> tasks;
+  for (int face = 0; face < 6; ++face) {
+    const vector<FaceEdge>& face_edges = all_edges[face];
+    S2CellId face_id = S2CellId::FromFace(face);
+    S2PaddedCell pcell(face_id, kCellPadding);
+    if (face_edges.empty() && tracker->shape_ids().empty()) continue;
+
+    // Use InitStale() to avoid applying updates recursively.
+    Iterator iter;
+    iter.InitStale(this);
+    if (iter.Locate(face_id) != S2CellRelation::DISJOINT) {
+      // Existing index cells need to be absorbed, which modifies cell_map_.
+      // We update this face immediately (before any tasks are started) and
+      // then move "tracker" along the face boundary to the next face.
+      InteriorTracker face_tracker(*tracker);
+      UpdateFaceEdges(face, face_edges, &face_tracker);
+      if (tracker->is_active()) {
+        tracker->MoveTo(pcell.GetEntryVertex());
+        tracker->DrawTo(pcell.GetExitVertex());
+        for (const FaceEdge& face_edge : face_edges) {
+          if (face_edge.has_interior) {
+            tracker->TestEdge(face_edge.shape_id, face_edge.edge);
+          }
+        }
+        tracker->set_next_cellid(face_id.next());
+      }
+      continue;
+    }
+    // Otherwise this face is disjoint from the index.  We split it into tasks
+    // following the same steps as UpdateFaceEdges().
+    vector<ClippedEdge>& storage = clipped_edge_storage[face];
+    vector<const ClippedEdge*> clipped_edges;
+    storage.reserve(face_edges.size());
+    clipped_edges.reserve(face_edges.size());
+    R2Rect bound = R2Rect::Empty();
+    for (const FaceEdge& face_edge : face_edges) {
+      ClippedEdge clipped;
+      clipped.face_edge = &face_edge;
+      clipped.bound = R2Rect::FromPointPair(face_edge.a, face_edge.b);
+      storage.push_back(clipped);
+      clipped_edges.push_back(&storage.back());
+      bound.AddRect(clipped.bound);
+    }
+    S2CellId shrunk_id = face_id;
+    if (!face_edges.empty()) shrunk_id = pcell.ShrinkToFit(bound);
+    const vector<const ClippedEdge*> no_edges;
+    if (shrunk_id != face_id && !tracker->shape_ids().empty()) {
+      for (S2CellId skipped_id : S2CellUnion::FromBeginEnd(
+               face_id.range_min(), shrunk_id.range_min())) {
+        tasks.push_back(make_unique<BuildTask>(
+            S2PaddedCell(skipped_id, kCellPadding), no_edges, *tracker));
+      }
+    }
+    AddBuildTasks(S2PaddedCell(shrunk_id, kCellPadding), clipped_edges,
+                  max_task_edges, tracker, &alloc, &tasks);
+    if (shrunk_id != face_id && !tracker->shape_ids().empty()) {
+      for (S2CellId skipped_id : S2CellUnion::FromBeginEnd(
+               shrunk_id.range_max().next(), face_id.range_max().next())) {
+        tasks.push_back(make_unique<BuildTask>(
+            S2PaddedCell(skipped_id, kCellPadding), no_edges, *tracker));
+      }
+    }
+  }
+
+  // Now run the tasks.  Each thread repeatedly claims the next unstarted task.
+  std::atomic<size_t> next_task(0);
+  auto run_tasks = [this, &tasks, &next_task]() {
+    EdgeAllocator task_alloc;
+    for (size_t i; (i = next_task.fetch_add(1)) < tasks.size(); ) {
+      BuildTask* task = tasks[i].get();
+      UpdateEdges(task->pcell, &task->edges, &task->tracker, &task_alloc,
+                  true /*disjoint_from_index*/, &task->cell_map);
+    }
+  };
+  const int num_threads = min<size_t>(options_.num_threads(), tasks.size());
+  s2base::RunConcurrently(options_.executor(), num_threads, run_tasks);
+
+  // The tasks are sorted in increasing S2CellId order, so when the index is
+  // first constructed all insertions are at the end of cell_map_.
+  for (const auto& task : tasks) {
+    cell_map_.insert(task->cell_map.begin(), task->cell_map.end());
+  }
+}
+
+// Given a cell that does not overlap any existing index cells and the edges
+// that intersect it, appends BuildTasks that cover this cell to "tasks" (in
+// increasing S2CellId order).  The cell is subdivided exactly as UpdateEdges()
+// would subdivide it until the number of edges in each cell is at most
+// "max_task_edges".  "tracker" must contain the state at the entry vertex of
+// the cell, and on return contains the state at the exit vertex of the cell.
+// ClippedEdges created by subdivision are allocated from "alloc".
+void MutableS2ShapeIndex::AddBuildTasks(
+    const S2PaddedCell& pcell, const vector<const ClippedEdge*>& edges,
+    size_t max_task_edges, InteriorTracker* tracker, EdgeAllocator* alloc,
+    vector<unique_ptr<BuildTask>>* tasks) const {
+  if (edges.size() > max_task_edges &&
+      HasTooManyShortEdges(pcell, edges, tracker->shape_ids().size())) {
+    // UpdateEdges() would subdivide this cell, so we do the same.
+    vector<const ClippedEdge*> child_edges[2][2];  // [i][j]
+    ClipEdgesToChildren(pcell, edges, child_edges, alloc);
+    for (int pos = 0; pos < 4; ++pos) {
+      int i, j;
+      pcell.GetChildIJ(pos, &i, &j);
+      if (!child_edges[i][j].empty() || !tracker->shape_ids().empty()) {
+        AddBuildTasks(S2PaddedCell(pcell, i, j), child_edges[i][j],
+                      max_task_edges, tracker, alloc, tasks);
+      }
+    }
+    return;
+  }
+  if (edges.empty() && tracker->shape_ids().empty()) return;
+  tasks->push_back(make_unique<BuildTask>(pcell, edges, *tracker));
+
+  // Move the tracker along the boundary of this cell from its entry vertex to
+  // its exit vertex.  Any edge that crosses this path must intersect the cell.
+  if (tracker->is_active() && !edges.empty()) {
+    tracker->MoveTo(pcell.GetEntryVertex());
+    tracker->DrawTo(pcell.GetExitVertex());
+    TestAllEdges(edges, tracker);
+    tracker->set_next_cellid(pcell.id().next());
+  }
 }
 
 S2CellId MutableS2ShapeIndex::ShrinkToFit(const S2PaddedCell& pcell,
@@ -1319,7 +1897,8 @@ void MutableS2ShapeIndex::SkipCellRange(S2CellId begin, S2CellId end,
   for (S2CellId skipped_id : S2CellUnion::FromBeginEnd(begin, end)) {
     vector<const ClippedEdge*> clipped_edges;
     UpdateEdges(S2PaddedCell(skipped_id, kCellPadding),
-                &clipped_edges, tracker, alloc, disjoint_from_index);
+                &clipped_edges, tracker, alloc, disjoint_from_index,
+                &cell_map_);
   }
 }
 
@@ -1345,16 +1924,64 @@ inline void MutableS2ShapeIndex::ClipVAxis(
   }
 }
 
+// Given a cell and the ClippedEdges whose bounding boxes intersect that cell,
+// appends each edge to the child cell(s) that it intersects.  Temporary space
+// for edges that need to be split is allocated from the given EdgeAllocator.
+/* static */ ABSL_ATTRIBUTE_ALWAYS_INLINE
+inline void MutableS2ShapeIndex::ClipEdgesToChildren(
+    const S2PaddedCell& pcell, const vector<const ClippedEdge*>& edges,
+    vector<const ClippedEdge*> child_edges[2][2], EdgeAllocator* alloc) {
+  // Compute the middle of the padded cell, defined as the rectangle in
+  // (u,v)-space that belongs to all four (padded) children.  By comparing
+  // against the four boundaries of "middle" we can determine which children
+  // each edge needs to be propagated to.
+  const R2Rect& middle = pcell.middle();
+
+  // Build up a vector edges to be passed to each child cell.  The (i,j)
+  // directions are left (i=0), right (i=1), lower (j=0), and upper (j=1).
+  // Note that the vast majority of edges are propagated to a single child.
+  // This case is very fast, consisting of between 2 and 4 floating-point
+  // comparisons and copying one pointer.  (ClipVAxis is inline.)
+  for (size_t e = 0; e < edges.size(); ++e) {
+    const ClippedEdge* edge = edges[e];
+    if (edge->bound[0].hi() <= middle[0].lo()) {
+      // Edge is entirely contained in the two left children.
+      ClipVAxis(edge, middle[1], child_edges[0], alloc);
+    } else if (edge->bound[0].lo() >= middle[0].hi()) {
+      // Edge is entirely contained in the two right children.
+      ClipVAxis(edge, middle[1], child_edges[1], alloc);
+    } else if (edge->bound[1].hi() <= middle[1].lo()) {
+      // Edge is entirely contained in the two lower children.
+      child_edges[0][0].push_back(ClipUBound(edge, 1, middle[0].hi(), alloc));
+      child_edges[1][0].push_back(ClipUBound(edge, 0, middle[0].lo(), alloc));
+    } else if (edge->bound[1].lo() >= middle[1].hi()) {
+      // Edge is entirely contained in the two upper children.
+      child_edges[0][1].push_back(ClipUBound(edge, 1, middle[0].hi(), alloc));
+      child_edges[1][1].push_back(ClipUBound(edge, 0, middle[0].lo(), alloc));
+    } else {
+      // The edge bound spans all four children.  The edge itself intersects
+      // either three or four (padded) children.
+      const ClippedEdge* left = ClipUBound(edge, 1, middle[0].hi(), alloc);
+      ClipVAxis(left, middle[1], child_edges[0], alloc);
+      const ClippedEdge* right = ClipUBound(edge, 0, middle[0].lo(), alloc);
+      ClipVAxis(right, middle[1], child_edges[1], alloc);
+    }
+  }
+}
+
 // Given a cell and a set of ClippedEdges whose bounding boxes intersect that
 // cell, add or remove all the edges from the index.  Temporary space for
 // edges that need to be subdivided is allocated from the given EdgeAllocator.
 // "disjoint_from_index" is an optimization hint indicating that cell_map_
-// does not contain any entries that overlap the given cell.
+// does not contain any entries that overlap the given cell.  New index cells
+// are inserted into "cell_map", which is normally &cell_map_ (but see
+// UpdateFacesInParallel).
 void MutableS2ShapeIndex::UpdateEdges(const S2PaddedCell& pcell,
                                       vector<const ClippedEdge*>* edges,
                                       InteriorTracker* tracker,
                                       EdgeAllocator* alloc,
-                                      bool disjoint_from_index) {
+                                      bool disjoint_from_index,
+                                      CellMap* cell_map) {
   // Cases where an index cell is not needed should be detected before this.
   ABSL_DCHECK(!edges->empty() || !tracker->shape_ids().empty());
 
@@ -1392,9 +2019,16 @@ void MutableS2ShapeIndex::UpdateEdges(const S2PaddedCell& pcell,
     if (r == S2CellRelation::DISJOINT) {
       disjoint_from_index = true;
     } else if (r == S2CellRelation::INDEXED) {
+      if (edges->empty()) {
+        // None of the edges being updated intersect this cell, so only the
+        // set of shapes that contain the entire cell has changed.
+        PatchIndexCell(iter, *tracker);
+        return;
+      }
       // Absorb the index cell by transferring its contents to "edges" and
       // deleting it.  We also start tracking the interior of any new shapes.
       AbsorbIndexCell(pcell, iter, edges, tracker, alloc);
+      ++update_stats_.num_cells_rebuilt;
       index_cell_absorbed = true;
       disjoint_from_index = true;
     } else {
@@ -1406,7 +2040,8 @@ void MutableS2ShapeIndex::UpdateEdges(const S2PaddedCell& pcell,
   // subdividing so that we can merge with those cells.  Otherwise,
   // MakeIndexCell checks if the number of edges is small enough, and creates
   // an index cell if possible (returning true when it does so).
-  if (!disjoint_from_index || !MakeIndexCell(pcell, *edges, tracker)) {
+  if (!disjoint_from_index ||
+      !MakeIndexCell(pcell, *edges, tracker, cell_map)) {
     // Reserve space for the edges that will be passed to each child.  This is
     // important since otherwise the running time is dominated by the time
     // required to grow the vectors.  The amount of memory involved is
@@ -1423,42 +2058,8 @@ void MutableS2ShapeIndex::UpdateEdges(const S2PaddedCell& pcell,
     // edges that are allocated during edge splitting.
     size_t alloc_size = alloc->size();
 
-    // Compute the middle of the padded cell, defined as the rectangle in
-    // (u,v)-space that belongs to all four (padded) children.  By comparing
-    // against the four boundaries of "middle" we can determine which children
-    // each edge needs to be propagated to.
-    const R2Rect& middle = pcell.middle();
-
-    // Build up a vector edges to be passed to each child cell.  The (i,j)
-    // directions are left (i=0), right (i=1), lower (j=0), and upper (j=1).
-    // Note that the vast majority of edges are propagated to a single child.
-    // This case is very fast, consisting of between 2 and 4 floating-point
-    // comparisons and copying one pointer.  (ClipVAxis is inline.)
-    for (int e = 0; e < num_edges; ++e) {
-      const ClippedEdge* edge = (*edges)[e];
-      if (edge->bound[0].hi() <= middle[0].lo()) {
-        // Edge is entirely contained in the two left children.
-        ClipVAxis(edge, middle[1], child_edges[0], alloc);
-      } else if (edge->bound[0].lo() >= middle[0].hi()) {
-        // Edge is entirely contained in the two right children.
-        ClipVAxis(edge, middle[1], child_edges[1], alloc);
-      } else if (edge->bound[1].hi() <= middle[1].lo()) {
-        // Edge is entirely contained in the two lower children.
-        child_edges[0][0].push_back(ClipUBound(edge, 1, middle[0].hi(), alloc));
-        child_edges[1][0].push_back(ClipUBound(edge, 0, middle[0].lo(), alloc));
-      } else if (edge->bound[1].lo() >= middle[1].hi()) {
-        // Edge is entirely contained in the two upper children.
-        child_edges[0][1].push_back(ClipUBound(edge, 1, middle[0].hi(), alloc));
-        child_edges[1][1].push_back(ClipUBound(edge, 0, middle[0].lo(), alloc));
-      } else {
-        // The edge bound spans all four children.  The edge itself intersects
-        // either three or four (padded) children.
-        const ClippedEdge* left = ClipUBound(edge, 1, middle[0].hi(), alloc);
-        ClipVAxis(left, middle[1], child_edges[0], alloc);
-        const ClippedEdge* right = ClipUBound(edge, 0, middle[0].lo(), alloc);
-        ClipVAxis(right, middle[1], child_edges[1], alloc);
-      }
-    }
+    ClipEdgesToChildren(pcell, *edges, child_edges, alloc);
+
     // Free any memory reserved for children that turned out to be empty.  This
     // step is cheap and reduces peak memory usage by about 10% when building
     // large indexes (> 10M edges).
@@ -1477,7 +2078,7 @@ void MutableS2ShapeIndex::UpdateEdges(const S2PaddedCell& pcell,
       pcell.GetChildIJ(pos, &i, &j);
       if (!child_edges[i][j].empty() || !tracker->shape_ids().empty()) {
         UpdateEdges(S2PaddedCell(pcell, i, j), &child_edges[i][j],
-                    tracker, alloc, disjoint_from_index);
+                    tracker, alloc, disjoint_from_index, cell_map);
       }
     }
     // Free any temporary edges that were allocated during clipping.
@@ -1675,14 +2276,257 @@ void MutableS2ShapeIndex::AbsorbIndexCell(const S2PaddedCell& pcell,
   // Update the edge list and delete this cell from the index.
   edges->swap(new_edges);
   cell_map_.erase(pcell.id());
-  delete &cell;
+  RetireCell(&cell);
+}
+
+// Updates an existing index cell that does not intersect any of the edges
+// being added or removed.  Such a cell is either entirely inside or entirely
+// outside each shape being updated, so its edges do not change.  Rather than
+// absorbing the cell (which reclips all of its edges and subdivides it again)
+// we simply replace it with a copy where the shapes being removed have been
+// deleted and the shapes being added that contain the cell (as given by
+// "tracker") have been inserted.
+//
+// REQUIRES: No ancestor of this cell was absorbed, so that "tracker" only
+//           contains shapes that are being added or removed.
+void MutableS2ShapeIndex::PatchIndexCell(const Iterator& iter,
+                                         const InteriorTracker& tracker) {
+  ++update_stats_.num_cells_patched;
+  const S2ShapeIndexCell& old_cell = iter.cell();
+  const ShapeIdSet& cshape_ids = tracker.shape_ids();
+
+  // Shapes being removed have already been removed from shapes_, but they
+  // are still present in "tracker" (since that is how we find this cell).
+  int num_shapes = 0;
+  for (int s = 0; s < old_cell.num_clipped(); ++s) {
+    num_shapes += (shape(old_cell.clipped(s).shape_id()) != nullptr);
+  }
+  for (int shape_id : cshape_ids) {
+    num_shapes += !is_shape_being_removed(shape_id);
+  }
+  CellMap::iterator it = cell_map_.find(iter.id());
+  if (num_shapes == 0) {
+    cell_map_.erase(it);
+  } else {
+    // Merge the remaining shapes with the containing shapes being added.
+    // Both sets of shape ids are already sorted.
+    S2ShapeIndexCell* cell = NewCell();
+    int num_packed_edges = 0;
+    for (const S2ClippedShape& old_clipped : old_cell.clipped_shapes()) {
+      if (shape(old_clipped.shape_id()) == nullptr) continue;
+      num_packed_edges += NumPackedEdges(old_clipped.num_edges());
+    }
+    int32* packed_edges = NewPackedEdges(cell, num_packed_edges);
+    S2ClippedShape* clipped = cell->add_shapes(num_shapes);
+    ShapeIdSet::const_iterator cnext = cshape_ids.begin();
+    for (int s = 0; s <= old_cell.num_clipped(); ++s) {
+      int old_shape_id = num_shape_ids();  // Sentinel
+      if (s < old_cell.num_clipped()) {
+        old_shape_id = old_cell.clipped(s).shape_id();
+      }
+      for (; cnext != cshape_ids.end() && *cnext < old_shape_id; ++cnext) {
+        if (is_shape_being_removed(*cnext)) continue;
+        clipped->Init(*cnext, 0);
+        clipped->set_contains_center(true);
+        ++clipped;
+      }
+      if (s == old_cell.num_clipped() || shape(old_shape_id) == nullptr) {
+        continue;
+      }
+      CopyClippedShape(old_cell.clipped(s), clipped++, &packed_edges);
+    }
+    // The shapes being removed don't have any edges in this cell, so the
+    // remaining edges are the same as before.
+    CopyEdgeRunBounds(old_cell, cell);
+    it->second = cell;
+  }
+  RetireCell(&old_cell);
+}
+
+// Allocates an empty index cell from the memory resource (if any).
+S2ShapeIndexCell* MutableS2ShapeIndex::NewCell() const {
+  S2_TELEMETRY_COUNTER_INC("mutable_s2shape_index.cells_created");
+  std::pmr::memory_resource* resource = options_.memory_resource();
+  if (resource == nullptr) return new S2ShapeIndexCell;
+  return new (resource->allocate(sizeof(S2ShapeIndexCell),
+                                 alignof(S2ShapeIndexCell))) S2ShapeIndexCell;
+}
+
+// If Options::pack_cell_edges() is true and "num_edges" is positive,
+// allocates an array of "num_edges" edge ids (from the memory resource, if
+// any) to hold the edges of all clipped shapes of "cell" that are not stored
+// inline, and returns a pointer to it.  Otherwise returns nullptr.
+int32* MutableS2ShapeIndex::NewPackedEdges(S2ShapeIndexCell* cell,
+                                           int num_edges) const {
+  if (!options_.pack_cell_edges() || num_edges == 0) return nullptr;
+  ABSL_DCHECK(cell->packed_edges_ == nullptr);
+  std::pmr::memory_resource* resource = options_.memory_resource();
+  if (resource == nullptr) {
+    cell->packed_edges_ = new int32[num_edges];
+  } else {
+    cell->packed_edges_ = static_cast<int32*>(
+        resource->allocate(num_edges * sizeof(int32), alignof(int32)));
+  }
+  return cell->packed_edges_;
+}
+
+// Returns the number of entries that a clipped shape with the given number
+// of edges needs in the packed edge array of its cell.
+/* static */
+inline int MutableS2ShapeIndex::NumPackedEdges(int num_edges) {
+  return num_edges > S2ClippedShape::kMaxInlineEdges ? num_edges : 0;
+}
+
+// Like S2ClippedShape::Init(), except that edge arrays that are not stored
+// inline are allocated from the memory resource (if any).  If
+// "packed_edges" is non-null, such edge arrays are instead taken from the
+// packed edge array of the cell (see NewPackedEdges), and "*packed_edges"
+// is advanced past them.
+void MutableS2ShapeIndex::InitClipped(S2ClippedShape* clipped, int32 shape_id,
+                                      int32 num_edges,
+                                      int32** packed_edges) const {
+  if (packed_edges != nullptr && *packed_edges != nullptr &&
+      num_edges > S2ClippedShape::kMaxInlineEdges) {
+    clipped->Init(shape_id, 0);
+    clipped->num_edges_ = num_edges;
+    clipped->edges_ = *packed_edges;
+    *packed_edges += num_edges;
+    return;
+  }
+  std::pmr::memory_resource* resource = options_.memory_resource();
+  if (resource == nullptr || num_edges <= S2ClippedShape::kMaxInlineEdges) {
+    clipped->Init(shape_id, num_edges);
+    return;
+  }
+  clipped->Init(shape_id, 0);
+  clipped->num_edges_ = num_edges;
+  clipped->edges_ = static_cast<int32*>(
+      resource->allocate(num_edges * sizeof(int32), alignof(int32)));
+}
+
+// Frees a cell allocated by NewCell() when "resource" was the memory
+// resource, including any edge arrays allocated by InitClipped().
+/* static */
+void MutableS2ShapeIndex::DeleteCell(const S2ShapeIndexCell* cell,
+                                     std::pmr::memory_resource* resource) {
+  if (resource == nullptr) {
+    delete cell;
+    return;
+  }
+  auto* mutable_cell = const_cast<S2ShapeIndexCell*>(cell);
+  int num_packed_edges = 0;
+  for (S2ClippedShape& clipped : mutable_cell->shapes_) {
+    if (clipped.is_inline()) continue;
+    if (mutable_cell->packed_edges_ != nullptr) {
+      num_packed_edges += clipped.num_edges();
+    } else {
+      resource->deallocate(clipped.edges_,
+                           clipped.num_edges() * sizeof(int32),
+                           alignof(int32));
+    }
+    // Prevent ~S2ShapeIndexCell from freeing the edges again.
+    clipped.num_edges_ = 0;
+  }
+  if (mutable_cell->packed_edges_ != nullptr) {
+    resource->deallocate(mutable_cell->packed_edges_,
+                         num_packed_edges * sizeof(int32), alignof(int32));
+    mutable_cell->packed_edges_ = nullptr;
+  }
+  mutable_cell->~S2ShapeIndexCell();
+  resource->deallocate(mutable_cell, sizeof(S2ShapeIndexCell),
+                       alignof(S2ShapeIndexCell));
+}
+
+void MutableS2ShapeIndex::CopyClippedShape(const S2ClippedShape& from,
+                                           S2ClippedShape* to,
+                                           int32** packed_edges) const {
+  InitClipped(to, from.shape_id(), from.num_edges(), packed_edges);
+  for (int i = 0; i < from.num_edges(); ++i) {
+    to->set_edge(i, from.edge(i));
+  }
+  to->set_contains_center(from.contains_center());
+}
+
+// Adds copies of all the clipped shapes of "from" to the empty cell "to".
+void MutableS2ShapeIndex::CopyClippedShapes(const S2ShapeIndexCell& from,
+                                            S2ShapeIndexCell* to) const {
+  int num_packed_edges = 0;
+  for (const S2ClippedShape& clipped : from.clipped_shapes()) {
+    num_packed_edges += NumPackedEdges(clipped.num_edges());
+  }
+  int32* packed_edges = NewPackedEdges(to, num_packed_edges);
+  S2ClippedShape* clipped = to->add_shapes(from.num_clipped());
+  for (int s = 0; s < from.num_clipped(); ++s) {
+    CopyClippedShape(from.clipped(s), clipped + s, &packed_edges);
+  }
+}
+
+// Copies the edge run bounds of "from" to "to", whose clipped shapes must
+// have the same edges as those of "from" (ignoring shapes with no edges).
+/* static */
+void MutableS2ShapeIndex::CopyEdgeRunBounds(const S2ShapeIndexCell& from,
+                                            S2ShapeIndexCell* to) {
+  if (from.edge_run_bounds_ == nullptr) return;
+  int num_runs = 0;
+  for (const S2ClippedShape& clipped : to->clipped_shapes()) {
+    num_runs += S2ShapeIndexCell::num_edge_runs(clipped);
+  }
+  to->edge_run_bounds_ = make_unique<R2Rect[]>(num_runs);
+  std::copy_n(from.edge_run_bounds_.get(), num_runs,
+              to->edge_run_bounds_.get());
+}
+
+// Returns the cell at the given position so that it can be modified.  If the
+// cell may be referenced by a snapshot, it is first replaced by a copy.
+S2ShapeIndexCell* MutableS2ShapeIndex::MutableCell(CellMap::iterator it) {
+  if (!SnapshotsMayExist()) return it->second;
+  const S2ShapeIndexCell* old_cell = it->second;
+  S2ShapeIndexCell* cell = NewCell();
+  CopyClippedShapes(*old_cell, cell);
+  CopyEdgeRunBounds(*old_cell, cell);
+  it->second = cell;
+  RetireCell(old_cell);
+  return cell;
+}
+
+// Returns the maximum number of short edges per cell on the given face.
+int MutableS2ShapeIndex::GetMaxEdgesPerCell(int face) const {
+  const FaceParameters& params = face_params_[face];
+  return params.auto_tuned ? params.max_edges_per_cell
+                           : options_.max_edges_per_cell();
+}
+
+// Returns true if an index cell for "pcell" containing the given edges would
+// have too many edges that are "short" relative to its size, in which case
+// the cell should be subdivided further (see MakeIndexCell for details).
+// "num_containing_shapes" is an upper bound on the number of shapes that
+// contain the entire cell.
+bool MutableS2ShapeIndex::HasTooManyShortEdges(
+    const S2PaddedCell& pcell, const vector<const ClippedEdge*>& edges,
+    int num_containing_shapes) const {
+  const int max_edges_per_cell = GetMaxEdgesPerCell(pcell.id().face());
+  if (edges.size() <= static_cast<size_t>(max_edges_per_cell)) {
+    return false;
+  }
+  int max_short_edges =
+      max(max_edges_per_cell,
+          static_cast<int>(
+              absl::GetFlag(FLAGS_s2shape_index_min_short_edge_fraction) *
+              (edges.size() + num_containing_shapes)));
+  int count = 0;
+  for (const ClippedEdge* edge : edges) {
+    count += (pcell.level() < edge->face_edge->max_level);
+    if (count > max_short_edges) return true;
+  }
+  return false;
 }
 
 // Attempt to build an index cell containing the given edges, and return true
 // if successful.  (Otherwise the edges should be subdivided further.)
 bool MutableS2ShapeIndex::MakeIndexCell(const S2PaddedCell& pcell,
                                         const vector<const ClippedEdge*>& edges,
-                                        InteriorTracker* tracker) {
+                                        InteriorTracker* tracker,
+                                        CellMap* cell_map) {
   if (edges.empty() && tracker->shape_ids().empty()) {
     // No index cell is needed.  (In most cases this situation is detected
     // before we get to this point, but this can happen when all shapes in a
@@ -1793,17 +2637,8 @@ bool MutableS2ShapeIndex::MakeIndexCell(const S2PaddedCell& pcell,
   // many" means more than options_.max_edges_per_cell(), but this value might
   // be increased if the cell has a lot of long edges and/or containing shapes.
   // This strategy ensures that the total index size is linear (see above).
-  if (edges.size() > static_cast<size_t>(options_.max_edges_per_cell())) {
-    int max_short_edges =
-        max(options_.max_edges_per_cell(),
-            static_cast<int>(
-                absl::GetFlag(FLAGS_s2shape_index_min_short_edge_fraction) *
-                (edges.size() + tracker->shape_ids().size())));
-    int count = 0;
-    for (const ClippedEdge* edge : edges) {
-      count += (pcell.level() < edge->face_edge->max_level);
-      if (count > max_short_edges) return false;
-    }
+  if (HasTooManyShortEdges(pcell, edges, tracker->shape_ids().size())) {
+    return false;
   }
 
   // Possible optimization: Continue subdividing as long as exactly one child
@@ -1841,7 +2676,21 @@ bool MutableS2ShapeIndex::MakeIndexCell(const S2PaddedCell& pcell,
   // with the shapes that happen to contain the cell center.
   const ShapeIdSet& cshape_ids = tracker->shape_ids();
   int num_shapes = CountShapes(edges, cshape_ids);
-  S2ShapeIndexCell* cell = new S2ShapeIndexCell;
+  S2ShapeIndexCell* cell = NewCell();
+  int32* packed_edges = nullptr;
+  if (options_.pack_cell_edges()) {
+    // Count the edges of each shape, which are consecutive in "edges".
+    int num_packed_edges = 0;
+    for (size_t e = 0; e < edges.size();) {
+      size_t ebegin = e;
+      const int shape_id = edges[e]->face_edge->shape_id;
+      while (e < edges.size() && edges[e]->face_edge->shape_id == shape_id) {
+        ++e;
+      }
+      num_packed_edges += NumPackedEdges(e - ebegin);
+    }
+    packed_edges = NewPackedEdges(cell, num_packed_edges);
+  }
   S2ClippedShape* base = cell->add_shapes(num_shapes);
 
   // To fill the index cell we merge the two sources of shapes: "edge shapes"
@@ -1872,7 +2721,7 @@ bool MutableS2ShapeIndex::MakeIndexCell(const S2PaddedCell& pcell,
              edges[enext]->face_edge->shape_id == eshape_id) {
         ++enext;
       }
-      clipped->Init(eshape_id, enext - ebegin);
+      InitClipped(clipped, eshape_id, enext - ebegin, &packed_edges);
       for (size_t e = ebegin; e < enext; ++e) {
         clipped->set_edge(e - ebegin, edges[e]->face_edge->edge_id);
       }
@@ -1882,12 +2731,34 @@ bool MutableS2ShapeIndex::MakeIndexCell(const S2PaddedCell& pcell,
       }
     }
   }
+  if (options_.edge_run_bounds() && !edges.empty()) {
+    // The edges are already in the same order as the edges of the clipped
+    // shapes.  Each run bound is padded by kCellPadding since that is the
+    // total error in the clipped edge bounds and the query edge bounds.
+    int num_runs = 0;
+    for (int i = 0; i < num_shapes; ++i) {
+      num_runs += S2ShapeIndexCell::num_edge_runs(base[i]);
+    }
+    cell->edge_run_bounds_ = make_unique<R2Rect[]>(num_runs);
+    R2Rect* run_bound = cell->edge_run_bounds_.get();
+    const ClippedEdge* const* edge = edges.data();
+    for (int i = 0; i < num_shapes; ++i) {
+      const int num_edges = base[i].num_edges();
+      for (int j = 0; j < num_edges; ++run_bound) {
+        R2Rect bound = R2Rect::Empty();
+        int run_end = min(j + S2ShapeIndexCell::kEdgesPerRun, num_edges);
+        for (; j < run_end; ++j) bound.AddRect((*edge++)->bound);
+        *run_bound = bound.Expanded(kCellPadding);
+      }
+    }
+    ABSL_DCHECK(edge == edges.data() + edges.size());
+  }
   // UpdateEdges() visits cells in increasing order of S2CellId, so during
   // initial construction of the index all insertions happen at the end.  It
   // is much faster to give an insertion hint in this case.  Otherwise the
   // hint doesn't do much harm.  With more effort we could provide a hint even
   // during incremental updates, but this is probably not worth the effort.
-  cell_map_.insert(cell_map_.end(), make_pair(pcell.id(), cell));
+  cell_map->insert(cell_map->end(), make_pair(pcell.id(), cell));
 
   // Shift the InteriorTracker focus point to the exit vertex of this cell.
   if (tracker->is_active() && !edges.empty()) {
@@ -1935,6 +2806,155 @@ int MutableS2ShapeIndex::CountShapes(const vector<const ClippedEdge*>& edges,
   return count;
 }
 
+// An Epoch owns the index cells and shapes that were retired after a given
+// snapshot was created (and before the next snapshot was created).  Each
+// epoch keeps the following epoch alive, so that a snapshot keeps alive
+// everything retired after it was created.  Since snapshots are typically
+// destroyed in the order they were created, epochs are usually freed in
+// order as well.
+struct MutableS2ShapeIndex::Epoch {
+  ~Epoch();
+
+  // The memory resource that allocated "cells".
+  std::pmr::memory_resource* resource = nullptr;
+  vector<const S2ShapeIndexCell*> cells;
+  vector<unique_ptr<S2Shape>> shapes;
+  shared_ptr<Epoch> next;
+};
+
+MutableS2ShapeIndex::Epoch::~Epoch() {
+  for (const S2ShapeIndexCell* cell : cells) DeleteCell(cell, resource);
+  // Free the chain of following epochs iteratively rather than recursively,
+  // since it can be arbitrarily long.
+  shared_ptr<Epoch> epoch = std::move(next);
+  while (epoch != nullptr && epoch.use_count() == 1) {
+    shared_ptr<Epoch> following = std::move(epoch->next);
+    epoch.reset();
+    epoch = std::move(following);
+  }
+}
+
+// Returns true if a snapshot may refer to cells or shapes that are retired
+// now.  Otherwise frees everything retired so far and returns false.
+bool MutableS2ShapeIndex::SnapshotsMayExist() {
+  if (epoch_ == nullptr) return false;
+  // Only this thread creates new references to epoch_, so if this is the
+  // last reference then no snapshot can refer to the current epoch.  The
+  // fence synchronizes with the release of the other references (which
+  // happens when the snapshots holding them are destroyed).
+  if (epoch_.use_count() > 1) return true;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  epoch_.reset();
+  return false;
+}
+
+void MutableS2ShapeIndex::RetireCell(const S2ShapeIndexCell* cell) {
+  if (SnapshotsMayExist()) {
+    epoch_->cells.push_back(cell);
+  } else {
+    DeleteCell(cell, options_.memory_resource());
+  }
+}
+
+void MutableS2ShapeIndex::RetireShape(unique_ptr<S2Shape> shape) {
+  if (shape != nullptr && SnapshotsMayExist()) {
+    epoch_->shapes.push_back(std::move(shape));
+  }
+}
+
+shared_ptr<const MutableS2ShapeIndex::Snapshot>
+MutableS2ShapeIndex::NewSnapshot() {
+  ForceBuild();
+  shared_ptr<Snapshot> snapshot(new Snapshot);
+  snapshot->shapes_.reserve(shapes_.size());
+  for (const auto& shape : shapes_) {
+    snapshot->shapes_.push_back(shape.get());
+  }
+  snapshot->cell_map_ = cell_map_;
+  snapshot->max_edges_per_cell_ = options_.max_edges_per_cell();
+
+  // Everything retired from now on may be referenced by this snapshot.
+  auto epoch = make_shared<Epoch>();
+  epoch->resource = options_.memory_resource();
+  if (epoch_ != nullptr) epoch_->next = epoch;
+  epoch_ = epoch;
+  snapshot->epoch_ = std::move(epoch);
+  return snapshot;
+}
+
+void MutableS2ShapeIndex::PublishSnapshot() {
+  std::atomic_store(&published_snapshot_, NewSnapshot());
+}
+
+shared_ptr<const MutableS2ShapeIndex::Snapshot>
+MutableS2ShapeIndex::published_snapshot() const {
+  return std::atomic_load(&published_snapshot_);
+}
+
+MutableS2ShapeIndex::Snapshot::~Snapshot() = default;
+
+void MutableS2ShapeIndex::Snapshot::Encode(Encoder* encoder) const {
+  encoder->Ensure(Varint::kMax64);
+  uint64 max_edges = max_edges_per_cell_;
+  encoder->put_varint64(max_edges << 2 | kCurrentEncodingVersionNumber);
+  vector<S2CellId> cell_ids;
+  cell_ids.reserve(cell_map_.size());
+  s2coding::StringVectorEncoder encoded_cells;
+  for (Iterator it(this, S2ShapeIndex::BEGIN); !it.done(); it.Next()) {
+    cell_ids.push_back(it.id());
+    it.cell().Encode(num_shape_ids(), encoded_cells.AddViaEncoder());
+  }
+  s2coding::EncodeS2CellIdVector(cell_ids, encoder);
+  encoded_cells.Encode(encoder);
+}
+
+bool MutableS2ShapeIndex::Encode(S2EncodingSink* sink) const {
+  // This produces the same output as Encode(Encoder*) in several passes over
+  // the index, so that only one cell needs to be held in memory at a time.
+  ForceBuild();
+  S2SinkEncoder out(sink);
+  Encoder* encoder = out.encoder();
+  encoder->Ensure(Varint::kMax64);
+  uint64 max_edges = options_.max_edges_per_cell();
+  encoder->put_varint64(max_edges << 2 | kCurrentEncodingVersionNumber);
+
+  // Measure both the cell ids and the encoded cells.
+  s2coding::S2CellIdVectorStreamEncoder cell_ids;
+  s2coding::StringVectorStreamEncoder encoded_cells;
+  Encoder scratch;
+  for (Iterator it(this, S2ShapeIndex::BEGIN); !it.done(); it.Next()) {
+    cell_ids.Measure(it.id());
+    scratch.clear();
+    it.cell().Encode(num_shape_ids(), &scratch);
+    encoded_cells.AddLength(scratch.length());
+  }
+  cell_ids.EncodeHeader(encoder);
+  for (Iterator it(this, S2ShapeIndex::BEGIN); !it.done(); it.Next()) {
+    cell_ids.Encode(it.id(), encoder);
+    if (!out.MaybeFlush()) return false;
+  }
+  encoded_cells.EncodeHeader(encoder);
+  for (Iterator it(this, S2ShapeIndex::BEGIN); !it.done(); it.Next()) {
+    scratch.clear();
+    it.cell().Encode(num_shape_ids(), &scratch);
+    encoded_cells.EncodeOffset(scratch.length(), encoder);
+    if (!out.MaybeFlush()) return false;
+  }
+  for (Iterator it(this, S2ShapeIndex::BEGIN); !it.done(); it.Next()) {
+    it.cell().Encode(num_shape_ids(), encoder);
+    if (!out.MaybeFlush()) return false;
+  }
+  return out.Flush();
+}
+
+size_t MutableS2ShapeIndex::Snapshot::SpaceUsed() const {
+  size_t size = sizeof(*this);
+  size += shapes_.capacity() * sizeof(shapes_[0]);
+  // cell_map_ itself is already included in sizeof(*this).
+  size += cell_map_.bytes_used() - sizeof(cell_map_);
+  return size;
+}
+
 size_t MutableS2ShapeIndex::SpaceUsed() const {
   size_t size = sizeof(*this);
   size += shapes_.capacity() * sizeof(unique_ptr<S2Shape>);
@@ -1951,6 +2971,11 @@ size_t MutableS2ShapeIndex::SpaceUsed() const {
         size += clipped.num_edges() * sizeof(int32);
       }
     }
+    if (cell.edge_run_bounds_ != nullptr) {
+      for (const S2ClippedShape& clipped : cell.clipped_shapes()) {
+        size += S2ShapeIndexCell::num_edge_runs(clipped) * sizeof(R2Rect);
+      }
+    }
   }
   if (pending_removals_ != nullptr) {
     size += sizeof(*pending_removals_);
@@ -1963,12 +2988,20 @@ size_t MutableS2ShapeIndex::SpaceUsed() const {
 }
 
 void MutableS2ShapeIndex::Encode(Encoder* encoder) const {
+  Encode(encoder, s2coding::CodingHint::FAST);
+}
+
+void MutableS2ShapeIndex::Encode(Encoder* encoder,
+                                 s2coding::CodingHint hint) const {
   // The version number is encoded in 2 bits, under the assumption that by the
   // time we need 5 versions the first version can be permanently retired.
   // This only saves 1 byte, but that's significant for very small indexes.
   encoder->Ensure(Varint::kMax64);
   uint64 max_edges = options_.max_edges_per_cell();
-  encoder->put_varint64(max_edges << 2 | kCurrentEncodingVersionNumber);
+  uint64 version = (hint == s2coding::CodingHint::COMPACT)
+                       ? kCompactEncodingVersionNumber
+                       : kCurrentEncodingVersionNumber;
+  encoder->put_varint64(max_edges << 2 | version);
 
   // The index will be built anyway when we iterate through it, but building
   // it in advance lets us size the cell_ids vector correctly.
@@ -1980,8 +3013,70 @@ void MutableS2ShapeIndex::Encode(Encoder* encoder) const {
     cell_ids.push_back(it.id());
     it.cell().Encode(num_shape_ids(), encoded_cells.AddViaEncoder());
   }
-  s2coding::EncodeS2CellIdVector(cell_ids, encoder);
-  encoded_cells.Encode(encoder);
+  s2coding::EncodeS2CellIdVector(cell_ids, hint, encoder);
+  encoded_cells.Encode(encoder, hint);
+}
+
+void MutableS2ShapeIndex::Encode(Encoder* encoder, s2coding::CodingHint hint,
+                                 bool deduplicate_cells) const {
+  if (!deduplicate_cells) return Encode(encoder, hint);
+  encoder->Ensure(Varint::kMax64 + Varint::kMax32);
+  uint64 max_edges = options_.max_edges_per_cell();
+  encoder->put_varint64(max_edges << 2 | kExtendedEncodingVersionNumber);
+  uint32 flags = kEncodingFlagDeduplicatedCells;
+  if (hint == s2coding::CodingHint::COMPACT) flags |= kEncodingFlagCompact;
+  encoder->put_varint32(flags);
+
+  ForceBuild();
+  vector<S2CellId> cell_ids;
+  vector<uint32> cell_encodings;
+  cell_ids.reserve(cell_map_.size());
+  cell_encodings.reserve(cell_map_.size());
+  s2coding::StringVectorEncoder encoded_cells;
+  absl::flat_hash_map<string, uint32> dictionary;
+  Encoder scratch;
+  for (Iterator it(this, S2ShapeIndex::BEGIN); !it.done(); it.Next()) {
+    cell_ids.push_back(it.id());
+    scratch.clear();
+    it.cell().Encode(num_shape_ids(), &scratch);
+    auto [entry, inserted] = dictionary.try_emplace(
+        string(scratch.base(), scratch.length()), dictionary.size());
+    if (inserted) encoded_cells.Add(entry->first);
+    cell_encodings.push_back(entry->second);
+  }
+  s2coding::EncodeS2CellIdVector(cell_ids, hint, encoder);
+  encoded_cells.Encode(encoder, hint);
+  s2coding::EncodeUintVector<uint32>(cell_encodings, hint, encoder);
+}
+
+bool MutableS2ShapeIndex::GetEncodingHint(int version,
+                                          s2coding::CodingHint* hint) {
+  if (version == kCurrentEncodingVersionNumber) {
+    *hint = s2coding::CodingHint::FAST;
+  } else if (version == kCompactEncodingVersionNumber) {
+    *hint = s2coding::CodingHint::COMPACT;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool MutableS2ShapeIndex::DecodeEncodingFormat(int version, Decoder* decoder,
+                                               s2coding::CodingHint* hint,
+                                               bool* deduplicated_cells) {
+  *deduplicated_cells = false;
+  if (version != kExtendedEncodingVersionNumber) {
+    return GetEncodingHint(version, hint);
+  }
+  uint32 flags;
+  if (!decoder->get_varint32(&flags)) return false;
+  if (flags & ~(kEncodingFlagCompact | kEncodingFlagDeduplicatedCells)) {
+    return false;
+  }
+  *hint = (flags & kEncodingFlagCompact) ? s2coding::CodingHint::COMPACT
+                                         : s2coding::CodingHint::FAST;
+  *deduplicated_cells = (flags & kEncodingFlagDeduplicatedCells) != 0;
+  return true;
 }
 
 bool MutableS2ShapeIndex::Init(Decoder* decoder,
@@ -1989,8 +3084,12 @@ bool MutableS2ShapeIndex::Init(Decoder* decoder,
   Clear();
   uint64 max_edges_version;
   if (!decoder->get_varint64(&max_edges_version)) return false;
-  int version = max_edges_version & 3;
-  if (version != kCurrentEncodingVersionNumber) return false;
+  s2coding::CodingHint hint;
+  bool deduplicated_cells;
+  if (!DecodeEncodingFormat(max_edges_version & 3, decoder, &hint,
+                            &deduplicated_cells)) {
+    return false;
+  }
   options_.set_max_edges_per_cell(max_edges_version >> 2);
   uint32 num_shapes = shape_factory.size();
   shapes_.reserve(num_shapes);
@@ -2001,16 +3100,34 @@ bool MutableS2ShapeIndex::Init(Decoder* decoder,
 
   s2coding::EncodedS2CellIdVector cell_ids;
   s2coding::EncodedStringVector encoded_cells;
-  if (!cell_ids.Init(decoder)) return false;
-  if (!encoded_cells.Init(decoder)) return false;
+  if (!cell_ids.Init(decoder, hint)) return false;
+  if (!encoded_cells.Init(decoder, hint)) return false;
+  s2coding::EncodedUintVector<uint32> cell_encodings;
+  if (deduplicated_cells) {
+    if (!cell_encodings.Init(decoder, hint)) return false;
+    if (cell_encodings.size() != cell_ids.size()) return false;
+  }
 
   for (size_t i = 0; i < cell_ids.size(); ++i) {
     S2CellId id = cell_ids[i];
-    S2ShapeIndexCell* cell = new S2ShapeIndexCell;
-    Decoder decoder = encoded_cells.GetDecoder(i);
-    if (!cell->Decode(num_shapes, &decoder)) {
-      delete cell;
-      return false;
+    size_t encoding = deduplicated_cells ? cell_encodings[i] : i;
+    if (encoding >= encoded_cells.size()) return false;
+    Decoder decoder = encoded_cells.GetDecoder(encoding);
+    S2ShapeIndexCell* cell;
+    if (options_.memory_resource() == nullptr &&
+        !options_.pack_cell_edges()) {
+      cell = new S2ShapeIndexCell;
+      if (!cell->Decode(num_shapes, &decoder)) {
+        delete cell;
+        return false;
+      }
+    } else {
+      // Decode into a temporary cell and then copy it into the resource
+      // and/or pack its edges.
+      S2ShapeIndexCell decoded;
+      if (!decoded.Decode(num_shapes, &decoder)) return false;
+      cell = NewCell();
+      CopyClippedShapes(decoded, cell);
     }
     cell_map_.insert(cell_map_.end(), make_pair(id, cell));
   }
@@ -20,8 +20,10 @@
 
 #include <array>
 #include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <memory>
+#include <memory_resource>
 #include <utility>
 #include <vector>
 
@@ -33,12 +35,16 @@
 
 #include "s2/base/commandlineflags.h"
 #include "s2/base/commandlineflags_declare.h"
+#include "s2/base/executor.h"
 #include "s2/base/spinlock.h"
 #include "s2/base/types.h"
 #include "s2/_fp_contract_off.h"
 #include "s2/r1interval.h"
 #include "s2/r2rect.h"
 #include "s2/s2cell_id.h"
+#include "s2/s2coder.h"
+#include "s2/s2edge_clipping.h"
+#include "s2/s2encoding_sink.h"
 #include "s2/s2memory_tracker.h"
 #include "s2/s2point.h"
 #include "s2/s2pointutil.h"
@@ -124,7 +130,9 @@ class BTreeMap : public absl::btree_map<Key, Value> {
 // has the same thread-safety properties as "vector": const methods are
 // thread-safe, while non-const methods are not thread-safe.  This means that
 // if one thread updates the index, you must ensure that no other thread is
-// reading or updating the index at the same time.
+// reading or updating the index at the same time.  Alternatively, readers can
+// query immutable snapshots of the index while a single writer continues to
+// update it (see NewSnapshot() and PublishSnapshot()).
 //
 // MutableS2ShapeIndex has an Encode() method that allows the index to be
 // serialized.  An encoded S2ShapeIndex can be decoded either into its
@@ -168,8 +176,103 @@ class MutableS2ShapeIndex final : public S2ShapeIndex {
     int max_edges_per_cell() const { return max_edges_per_cell_; }
     void set_max_edges_per_cell(int max_edges_per_cell);
 
+    // The number of threads used to apply pending updates.  If this value is
+    // greater than one, the cube faces (and large subtrees within each face)
+    // are indexed concurrently and the results are merged into the index.
+    // The resulting index is identical to the one built using a single
+    // thread.
+    //
+    // Note that only faces that do not contain any existing index cells are
+    // built concurrently.  This includes all faces when the index is first
+    // built, whereas incremental updates to faces that are already indexed
+    // are applied sequentially.
+    //
+    // DEFAULT: 1
+    int num_threads() const { return num_threads_; }
+    void set_num_threads(int num_threads);
+
+    // If non-null, the additional threads requested by num_threads() are
+    // run as tasks on this executor rather than being created by the index
+    // (see s2base::RunConcurrently).  The executor must outlive all updates
+    // of the index.
+    //
+    // DEFAULT: nullptr
+    s2base::Executor* executor() const { return executor_; }
+    void set_executor(s2base::Executor* executor) { executor_ = executor; }
+
+    // If true, each index cell also stores the (u,v)-coordinate bounds of
+    // each run of S2ShapeIndexCell::kEdgesPerRun consecutive edges of its
+    // clipped shapes (see S2ShapeIndexCell::edge_run_bounds).  This allows
+    // S2CrossingEdgeQuery to skip runs of edges that cannot cross the query
+    // edge, which reduces the number of candidates in cells with many edges
+    // at the cost of about 4 bytes per indexed edge.  This summary is not
+    // included in the encoded index.
+    //
+    // DEFAULT: false
+    bool edge_run_bounds() const { return edge_run_bounds_; }
+    void set_edge_run_bounds(bool edge_run_bounds) {
+      edge_run_bounds_ = edge_run_bounds;
+    }
+
+    // If true, the subdivision parameters (max_edges_per_cell() and the
+    // --s2shape_index_cell_size_to_long_edge_ratio flag) are chosen
+    // separately for each cube face based on a sample of the edges being
+    // indexed.  Faces with many edges use a larger max_edges_per_cell() (up
+    // to 50) to reduce memory usage, and the long edge ratio is chosen so
+    // that edges become "long" at the level where a cell typically contains
+    // max_edges_per_cell() edges, which avoids oversubdividing sparse
+    // geometry with long edges and undersubdividing long edges that are
+    // packed closely together.  max_edges_per_cell() is used as the
+    // starting point.  The chosen values are reported by face_parameters().
+    //
+    // Faces are tuned only when they do not contain any existing index
+    // cells, so that incremental updates do not change the parameters of
+    // faces that have already been indexed.  (In particular the parameters
+    // are chosen when the index is first built.)  This option is not
+    // included in the encoded index.
+    //
+    // DEFAULT: false
+    bool auto_tune() const { return auto_tune_; }
+    void set_auto_tune(bool auto_tune) { auto_tune_ = auto_tune; }
+
+    // If non-null, index cells and their edge arrays are allocated from this
+    // memory resource rather than the global heap.  The resource is not
+    // owned and must outlive the index and any snapshots of it.  It must be
+    // thread-safe if num_threads() > 1.  S2HugePageArena is a resource that
+    // places the cells in huge pages, which reduces TLB misses when querying
+    // large indexes and allows all of the cells to be freed at once.  (The
+    // shape vector and the index tree itself still use the global heap.)
+    //
+    // DEFAULT: nullptr
+    std::pmr::memory_resource* memory_resource() const {
+      return memory_resource_;
+    }
+    void set_memory_resource(std::pmr::memory_resource* resource) {
+      memory_resource_ = resource;
+    }
+
+    // If true, the edge ids of all clipped shapes in an index cell that have
+    // more than two edges (which do not fit inline) are packed into a single
+    // array per cell, rather than allocating a separate array for each
+    // clipped shape.  This reduces the number of allocations and improves
+    // locality when most cells contain several shapes with a few edges each,
+    // e.g. indexes of many small polygons or polylines.  It does not change
+    // the contents of the index or its encoding.
+    //
+    // DEFAULT: false
+    bool pack_cell_edges() const { return pack_cell_edges_; }
+    void set_pack_cell_edges(bool pack_cell_edges) {
+      pack_cell_edges_ = pack_cell_edges;
+    }
+
    private:
     int max_edges_per_cell_;
+    int num_threads_ = 1;
+    s2base::Executor* executor_ = nullptr;
+    bool edge_run_bounds_ = false;
+    bool auto_tune_ = false;
+    bool pack_cell_edges_ = false;
+    std::pmr::memory_resource* memory_resource_ = nullptr;
   };
 
   // Creates a MutableS2ShapeIndex that uses the default option settings.
@@ -187,6 +290,8 @@ class MutableS2ShapeIndex final : public S2ShapeIndex {
   // Initialize a MutableS2ShapeIndex with the given options.  This method may
   // only be called when the index is empty (i.e. newly created or Clear() has
   // just been called).  May be called before or after set_memory_tracker().
+  // If the memory resource changes, any cells that remain from a previous
+  // build are released first.
   void Init(const Options& options);
 
   const Options& options() const { return options_; }
@@ -281,6 +386,37 @@ class MutableS2ShapeIndex final : public S2ShapeIndex {
   //           can be enlarged as necessary by calling Ensure(int).
   void Encode(Encoder* encoder) const override;
 
+  // Like Encode(Encoder*), except that CodingHint::COMPACT selects a newer
+  // encoding version in which the cell ids and cell offsets are bit-packed
+  // rather than stored in a whole number of bytes each.  This typically
+  // reduces the size of the cell id table by 15-30% (and the total index
+  // size by 5-15%), at the cost of slightly slower random access.  Both
+  // versions can be decoded by EncodedS2ShapeIndex and
+  // MutableS2ShapeIndex::Init(), but binaries that predate this version can
+  // only decode the CodingHint::FAST version.
+  void Encode(Encoder* encoder, s2coding::CodingHint hint) const;
+
+  // Like Encode(Encoder*, CodingHint), except that if "deduplicate_cells" is
+  // true then identical cell encodings are stored only once, in a dictionary
+  // that each cell refers to by number.  This is only worthwhile when most
+  // cells are interior cells with identical contents (e.g., the cells of a
+  // large polygon that contain no edges), since every cell still needs a
+  // dictionary reference; otherwise the encoding may become larger.
+  // EncodedS2ShapeIndex also decodes each dictionary entry only once and
+  // shares the decoded cell among all the cells that refer to it.  Binaries
+  // that predate this option cannot decode its output.
+  void Encode(Encoder* encoder, s2coding::CodingHint hint,
+              bool deduplicate_cells) const;
+
+  // Like Encode(Encoder*), but writes the encoding to "sink" in chunks so
+  // that it never needs to be held in memory all at once.  The output is
+  // identical; this is intended for writing very large indexes to files or
+  // network streams.  The index is traversed four times and each cell is
+  // encoded three times (twice to measure it and once to write it), so this
+  // is somewhat slower than Encode(Encoder*).  Returns false if the sink
+  // reported an error.
+  bool Encode(S2EncodingSink* sink) const;
+
   // Decodes an S2ShapeIndex, returning true on success.
   //
   // This method does not decode the S2Shape objects in the index; this is
@@ -354,13 +490,35 @@ class MutableS2ShapeIndex final : public S2ShapeIndex {
       return LocateImpl(*this, target);
     }
 
+    void SeekNear(S2CellId target) override;
+
+    bool LocateNear(const S2Point& target) override {
+      return LocateNearImpl(*this, target);
+    }
+
+    S2CellRelation LocateNear(S2CellId target) override {
+      return LocateNearImpl(*this, target);
+    }
+
     std::unique_ptr<IteratorBase> Clone() const override {
       return std::make_unique<Iterator>(*this);
     }
 
    private:
+    void Prefetch();
+
     const MutableS2ShapeIndex* index_;
     CellMap::const_iterator iter_, end_;
+
+    // State used to prefetch cells as the iterator is advanced by Next() (see
+    // FLAGS_s2shape_index_prefetch_distance).  "ahead_" is the last cell that
+    // was prefetched and "num_ahead_" is its distance from iter_, or zero if
+    // no cells have been prefetched since the iterator was last positioned.
+    // Once num_ahead_ reaches prefetch_distance_, the clipped shapes of
+    // "mid_" and the edges of "near_" are prefetched as well.
+    int prefetch_distance_ = 0;
+    int num_ahead_ = 0;
+    CellMap::const_iterator ahead_, mid_, near_;
   };
 
   // Takes ownership of the given shape and adds it to the index.  Assigns a
@@ -372,6 +530,14 @@ class MutableS2ShapeIndex final : public S2ShapeIndex {
   // continue to be added even once the specified limit has been reached.
   int Add(std::unique_ptr<S2Shape> shape);
 
+  // Takes ownership of the given shapes and adds them to the index, assigning
+  // them consecutive shape ids.  Returns the id of the first shape (or the
+  // next unused id if "shapes" is empty).  This is equivalent to calling
+  // Add() for each shape but is more efficient for large numbers of shapes;
+  // see also S2ColumnarShapes, which represents many small shapes compactly.
+  // Invalidates all iterators and their associated data.
+  int AddShapes(std::vector<std::unique_ptr<S2Shape>> shapes);
+
   // Removes the given shape from the index and return ownership to the caller.
   // Invalidates all iterators and their associated data.
   std::unique_ptr<S2Shape> Release(int shape_id);
@@ -385,6 +551,19 @@ class MutableS2ShapeIndex final : public S2ShapeIndex {
   // options specified via Init() are preserved.
   void Clear();
 
+  // Renumbers the shapes so that their ids are consecutive, reclaiming the
+  // slots of removed shapes (which are otherwise kept forever so that shape
+  // ids remain stable).  Returns a vector that maps each old shape id to its
+  // new shape id, or to -1 if the shape was removed.  The relative order of
+  // the shapes is preserved.  Any pending updates are applied first.
+  // Invalidates all iterators and their associated data.
+  //
+  // The running time is linear in the number of index cells, but only the
+  // cells that contain a renumbered shape are modified.  Snapshots are not
+  // affected, so an index that is queried through published snapshots can be
+  // compacted by the updating thread while readers continue to be served.
+  std::vector<int> Compact();
+
   // Returns the number of bytes currently occupied by the index (including any
   // unused space at the end of vectors, etc). It has the same thread safety
   // as the other "const" methods (see introduction).
@@ -413,6 +592,34 @@ class MutableS2ShapeIndex final : public S2ShapeIndex {
   // Note that this method is thread-safe.
   void ForceBuild() const;
 
+  // Specifies what TryBuild() does when the index has pending updates.
+  enum class BuildPolicy {
+    // Applies the pending updates on the calling thread, or waits for the
+    // thread that is already applying them.  (Queries do this implicitly.)
+    BUILD,
+
+    // Waits if another thread is already applying the pending updates, but
+    // never starts applying them on the calling thread.
+    WAIT,
+
+    // Neither applies the pending updates nor waits for another thread.
+    FAIL_FAST,
+  };
+
+  // Returns true if the index is fresh after following the given policy, in
+  // which case queries made by the calling thread will neither build the
+  // index nor wait for another thread to build it.  This allows
+  // latency-sensitive readers to avoid being serialized behind a lazy build,
+  // e.g.
+  //
+  //   if (!index.TryBuild(MutableS2ShapeIndex::BuildPolicy::FAIL_FAST)) {
+  //     return BruteForceQuery(...);
+  //   }
+  //
+  // Unlike is_fresh(), the result is exact (for the calling thread).  Note
+  // that this method is thread-safe.
+  bool TryBuild(BuildPolicy policy) const;
+
   // Returns true if there are no pending updates that need to be applied.
   // This can be useful to avoid building the index unnecessarily, or for
   // choosing between two different algorithms depending on whether the index
@@ -424,19 +631,137 @@ class MutableS2ShapeIndex final : public S2ShapeIndex {
   // MaybeApplyUpdates).
   bool is_fresh() const;
 
+  // Statistics about a single application of pending updates, intended for
+  // monitoring the latency of incremental updates.
+  struct UpdateStats {
+    // The number of shapes and edges that were added and removed.
+    int num_shapes_added = 0;
+    int num_shapes_removed = 0;
+    int64 num_edges_added = 0;
+    int64 num_edges_removed = 0;
+
+    // The number of batches that the update was split into (see
+    // --s2shape_index_tmp_memory_budget).
+    int num_batches = 0;
+
+    // The number of existing index cells that intersected an edge being
+    // added or removed.  These cells are rebuilt from scratch, which may
+    // subdivide them further.
+    int num_cells_rebuilt = 0;
+
+    // The number of existing index cells that did not intersect any edge
+    // being added or removed but were contained by a shape being added or
+    // removed.  These cells are updated in place without reclipping their
+    // edges.  (All other existing index cells are not touched at all.)
+    int num_cells_patched = 0;
+
+    // The number of index cells before and after the update.
+    int64 num_cells_before = 0;
+    int64 num_cells_after = 0;
+
+    // The number of cube faces whose subdivision parameters were chosen by
+    // Options::auto_tune() during this update (see face_parameters()).
+    int num_faces_tuned = 0;
+
+    // The wall time taken to apply the updates.
+    std::chrono::nanoseconds elapsed{0};
+  };
+
+  // Returns statistics about the most recent time that pending updates were
+  // applied (either by ForceBuild() or lazily by a query).  This method does
+  // not apply pending updates itself, and it must not be called while
+  // another thread may be applying updates.  For example:
+  //
+  //   index.Add(std::move(shape));
+  //   index.ForceBuild();
+  //   RecordLatency(index.last_update_stats().elapsed);
+  const UpdateStats& last_update_stats() const { return update_stats_; }
+
+  // The subdivision parameters used for one cube face of the index.
+  struct FaceParameters {
+    int max_edges_per_cell = 0;
+    double cell_size_to_long_edge_ratio = 0;
+
+    // True if the values above were chosen by Options::auto_tune(), and
+    // false if they are the defaults given by the options and flags.
+    bool auto_tuned = false;
+  };
+
+  // Returns the subdivision parameters for the given cube face (see
+  // Options::auto_tune).  Like last_update_stats(), this method does not
+  // apply pending updates and must not be called while another thread may
+  // be applying updates.
+  FaceParameters face_parameters(int face) const;
+
+  // An immutable S2ShapeIndex that represents the contents of this index at
+  // the time the snapshot was created (see NewSnapshot).
+  class Snapshot;
+
+  // Applies any pending updates and returns an immutable snapshot of the
+  // current index contents.  Snapshots can be queried from any number of
+  // threads while this index continues to be updated, and they remain valid
+  // even after this index is destroyed.
+  //
+  // Snapshots share their index cells with this index, so creating one takes
+  // time proportional to the number of index cells but only copies one
+  // pointer per cell.  Once a snapshot exists, index cells that are removed
+  // or modified by later updates are retired rather than deleted.  Retired
+  // cells are freed when the last snapshot that could refer to them is
+  // destroyed (a form of epoch-based reclamation where each snapshot defines
+  // an epoch).
+  //
+  // Note that snapshots do not own their shapes.  Shapes returned by
+  // Release() or ReleaseAll() may still be referenced by existing snapshots,
+  // so rather than destroying them the caller should pass them to
+  // RetireShape() (or keep them alive until all older snapshots are
+  // destroyed).  Shapes deleted by Clear() or by the destructor are retired
+  // automatically.
+  //
+  // This method must be called by the thread that updates the index.
+  std::shared_ptr<const Snapshot> NewSnapshot();
+
+  // Creates a new snapshot and atomically replaces the snapshot returned by
+  // published_snapshot().  This method must be called by the thread that
+  // updates the index.  Example usage:
+  //
+  //   // Writer thread:
+  //   index.Add(std::move(shape));
+  //   index.RetireShape(index.Release(old_shape_id));
+  //   index.PublishSnapshot();
+  //
+  //   // Reader threads:
+  //   std::shared_ptr<const MutableS2ShapeIndex::Snapshot> snapshot =
+  //       index.published_snapshot();
+  //   S2ClosestEdgeQuery query(snapshot.get());
+  void PublishSnapshot();
+
+  // Returns the most recently published snapshot, or nullptr if no snapshot
+  // has been published.  This method may be called from any thread, even
+  // while the index is being updated.
+  std::shared_ptr<const Snapshot> published_snapshot() const;
+
+  // Destroys the given shape once no existing snapshot can refer to it.  If
+  // no snapshots exist the shape is destroyed immediately.
+  void RetireShape(std::unique_ptr<S2Shape> shape);
+
  protected:
   std::unique_ptr<IteratorBase> NewIterator(InitialPosition pos) const override;
 
  private:
+  friend class CompositeS2ShapeIndex;
   friend class EncodedS2ShapeIndex;
+  friend class FrozenS2ShapeIndex;
   friend class Iterator;
+  friend class LayeredS2ShapeIndex;
   friend class MutableS2ShapeIndexTest;
   friend class S2Stats;
 
   class BatchGenerator;
   class EdgeAllocator;
+  struct Epoch;
   class InteriorTracker;
   struct BatchDescriptor;
+  struct BuildTask;
   struct ClippedEdge;
   struct FaceEdge;
   struct RemovedShape;
@@ -448,11 +773,38 @@ class MutableS2ShapeIndex final : public S2ShapeIndex {
   // to decode it.
   static constexpr unsigned char kCurrentEncodingVersionNumber = 0;
 
+  // The version written by Encode() with CodingHint::COMPACT, which uses
+  // bit-packed cell ids and cell offsets.
+  static constexpr unsigned char kCompactEncodingVersionNumber = 1;
+
+  // The version written by Encode() with deduplicate_cells == true.  The
+  // version number is followed by a varint32 of the kEncodingFlag* bits
+  // below, so that further format options do not need new version numbers.
+  static constexpr unsigned char kExtendedEncodingVersionNumber = 2;
+
+  // The cell ids and cell offsets are bit-packed (CodingHint::COMPACT).
+  static constexpr uint32 kEncodingFlagCompact = 1;
+
+  // The encoded cells are followed by an EncodedUintVector<uint32> that maps
+  // each cell to its encoding, so that identical cells are stored only once.
+  static constexpr uint32 kEncodingFlagDeduplicatedCells = 2;
+
+  // Returns the hint used to encode the cell ids and cell offsets of the
+  // given version, or false if the version is not supported.
+  static bool GetEncodingHint(int version, s2coding::CodingHint* hint);
+
+  // Like GetEncodingHint(), but also reads the flags that follow the
+  // extended version number from "decoder" and sets "deduplicated_cells".
+  static bool DecodeEncodingFormat(int version, Decoder* decoder,
+                                   s2coding::CodingHint* hint,
+                                   bool* deduplicated_cells);
+
   // Internal methods are documented with their definitions.
   bool is_shape_being_removed(int shape_id) const;
   void MarkIndexStale();
   void MaybeApplyUpdates() const;
   void ApplyUpdatesThreadSafe();
+  bool WaitForUpdatesThreadSafe();
   void ApplyUpdatesInternal();
   std::vector<BatchDescriptor> GetUpdateBatches() const;
   void ReserveSpace(const BatchDescriptor& batch,
@@ -465,26 +817,58 @@ class MutableS2ShapeIndex final : public S2ShapeIndex {
                    InteriorTracker* tracker) const;
   void FinishPartialShape(int shape_id);
   void AddFaceEdge(FaceEdge* edge, std::vector<FaceEdge> all_edges[6]) const;
+  void AddFaceEdge(FaceEdge* edge, const S2::FaceUVPoint& a,
+                   const S2::FaceUVPoint& b,
+                   std::vector<FaceEdge> all_edges[6]) const;
   void UpdateFaceEdges(int face, const std::vector<FaceEdge>& face_edges,
                        InteriorTracker* tracker);
+  void UpdateFacesInParallel(const std::vector<FaceEdge> all_edges[6],
+                             InteriorTracker* tracker);
+  void AddBuildTasks(const S2PaddedCell& pcell,
+                     const std::vector<const ClippedEdge*>& edges,
+                     size_t max_task_edges, InteriorTracker* tracker,
+                     EdgeAllocator* alloc,
+                     std::vector<std::unique_ptr<BuildTask>>* tasks) const;
   S2CellId ShrinkToFit(const S2PaddedCell& pcell, const R2Rect& bound) const;
   void SkipCellRange(S2CellId begin, S2CellId end, InteriorTracker* tracker,
                      EdgeAllocator* alloc, bool disjoint_from_index);
   void UpdateEdges(const S2PaddedCell& pcell,
                    std::vector<const ClippedEdge*>* edges,
                    InteriorTracker* tracker, EdgeAllocator* alloc,
-                   bool disjoint_from_index);
+                   bool disjoint_from_index, CellMap* cell_map);
   void AbsorbIndexCell(const S2PaddedCell& pcell,
                        const Iterator& iter,
                        std::vector<const ClippedEdge*>* edges,
                        InteriorTracker* tracker,
                        EdgeAllocator* alloc);
+  void PatchIndexCell(const Iterator& iter, const InteriorTracker& tracker);
+  S2ShapeIndexCell* NewCell() const;
+  int32* NewPackedEdges(S2ShapeIndexCell* cell, int num_edges) const;
+  static int NumPackedEdges(int num_edges);
+  void InitClipped(S2ClippedShape* clipped, int32 shape_id, int32 num_edges,
+                   int32** packed_edges = nullptr) const;
+  void CopyClippedShape(const S2ClippedShape& from, S2ClippedShape* to,
+                        int32** packed_edges = nullptr) const;
+  void CopyClippedShapes(const S2ShapeIndexCell& from,
+                         S2ShapeIndexCell* to) const;
+  static void DeleteCell(const S2ShapeIndexCell* cell,
+                         std::pmr::memory_resource* resource);
+  static void CopyEdgeRunBounds(const S2ShapeIndexCell& from,
+                                S2ShapeIndexCell* to);
+  S2ShapeIndexCell* MutableCell(CellMap::iterator it);
+  bool SnapshotsMayExist();
+  void RetireCell(const S2ShapeIndexCell* cell);
+  void AutoTuneFaces();
   int GetEdgeMaxLevel(const S2Shape::Edge& edge) const;
+  int GetMaxEdgesPerCell(int face) const;
   static int CountShapes(const std::vector<const ClippedEdge*>& edges,
                          const ShapeIdSet& cshape_ids);
+  bool HasTooManyShortEdges(const S2PaddedCell& pcell,
+                            const std::vector<const ClippedEdge*>& edges,
+                            int num_containing_shapes) const;
   bool MakeIndexCell(const S2PaddedCell& pcell,
                      const std::vector<const ClippedEdge*>& edges,
-                     InteriorTracker* tracker);
+                     InteriorTracker* tracker, CellMap* cell_map);
   static void TestAllEdges(const std::vector<const ClippedEdge*>& edges,
                            InteriorTracker* tracker);
   inline static const ClippedEdge* UpdateBound(const ClippedEdge* edge,
@@ -500,6 +884,9 @@ class MutableS2ShapeIndex final : public S2ShapeIndex {
   static void ClipVAxis(const ClippedEdge* edge, const R1Interval& middle,
                         std::vector<const ClippedEdge*> child_edges[2],
                         EdgeAllocator* alloc);
+  static void ClipEdgesToChildren(
+      const S2PaddedCell& pcell, const std::vector<const ClippedEdge*>& edges,
+      std::vector<const ClippedEdge*> child_edges[2][2], EdgeAllocator* alloc);
 
   // The shapes in the index, accessed by their shape id.  Removed shapes are
   // replaced by nullptr pointers.
@@ -533,6 +920,22 @@ class MutableS2ShapeIndex final : public S2ShapeIndex {
   // only when there are removed shapes to process (to save memory).
   std::unique_ptr<std::vector<RemovedShape>> pending_removals_;
 
+  // Statistics about the most recent update (see last_update_stats()).
+  UpdateStats update_stats_;
+
+  // The parameters chosen for each face by Options::auto_tune().  Faces
+  // that have not been tuned have auto_tuned == false.
+  FaceParameters face_params_[6];
+
+  // The epoch of the most recent snapshot, which owns all the cells and
+  // shapes retired since that snapshot was created.  This field is present
+  // only once a snapshot has been created.
+  std::shared_ptr<Epoch> epoch_;
+
+  // The most recently published snapshot.  This field is only accessed using
+  // atomic operations (std::atomic_load and std::atomic_store).
+  std::shared_ptr<const Snapshot> published_snapshot_;
+
   // Additions and removals are queued and processed on the first subsequent
   // query.  There are several reasons to do this:
   //
@@ -570,7 +973,8 @@ class MutableS2ShapeIndex final : public S2ShapeIndex {
   struct UpdateState {
     // This mutex is used as a condition variable.  It is locked by the
     // updating thread for the entire duration of the update; other threads
-    // lock it in order to wait until the update is finished.
+    // acquire a shared lock in order to wait until the update is finished,
+    // so that they can all proceed at once.
     absl::Mutex wait_mutex;
 
     // The number of threads currently waiting on "wait_mutex_".  The
@@ -592,6 +996,7 @@ class MutableS2ShapeIndex final : public S2ShapeIndex {
   // Documented in the .cc file.
   void UnlockAndSignal() ABSL_UNLOCK_FUNCTION(lock_)
       ABSL_UNLOCK_FUNCTION(update_state_->wait_mutex);
+  void UnlockAndWait() ABSL_UNLOCK_FUNCTION(lock_);
 #endif
 
   MutableS2ShapeIndex(const MutableS2ShapeIndex&) = delete;
@@ -623,6 +1028,107 @@ struct MutableS2ShapeIndex::BatchDescriptor {
 // The purpose of BatchGenerator is to divide large updates into batches such
 // that all batches use approximately the same amount of high-water memory.
 // This class is defined here so that it can be tested independently.
+class MutableS2ShapeIndex::Snapshot final : public S2ShapeIndex {
+ public:
+  ~Snapshot() override;
+
+  Snapshot(const Snapshot&) = delete;
+  Snapshot& operator=(const Snapshot&) = delete;
+
+  // The number of distinct shape ids in the index at the time the snapshot
+  // was created.
+  int num_shape_ids() const override { return shapes_.size(); }
+
+  // Returns a pointer to the shape with the given id, or nullptr if the shape
+  // had been removed from the index when the snapshot was created.
+  const S2Shape* shape(int id) const override { return shapes_[id]; }
+
+  // Encodes the snapshot in the same format as MutableS2ShapeIndex::Encode().
+  void Encode(Encoder* encoder) const override;
+
+  // Returns the number of bytes used by the snapshot itself, not counting
+  // the index cells that it shares with other snapshots and the index.
+  size_t SpaceUsed() const override;
+
+  // Snapshots are immutable, so this method does nothing.
+  void Minimize() override {}
+
+  class Iterator final : public IteratorBase {
+   public:
+    // Default constructor; must be followed by a call to Init().
+    Iterator();
+
+    // Constructs an iterator positioned as specified.
+    explicit Iterator(const Snapshot* snapshot,
+                      InitialPosition pos = UNPOSITIONED);
+
+    // Initializes an iterator for the given snapshot.
+    void Init(const Snapshot* snapshot, InitialPosition pos = UNPOSITIONED);
+
+    S2CellId id() const override {
+      return done() ? S2CellId::Sentinel() : iter_->first;
+    }
+
+    const S2ShapeIndexCell& cell() const override {
+      ABSL_DCHECK(!done());
+      return *iter_->second;
+    }
+
+    bool done() const override { return iter_ == cell_map_->end(); }
+
+    // S2CellIterator API:
+    void Begin() override { iter_ = cell_map_->begin(); }
+    void Finish() override { iter_ = cell_map_->end(); }
+    void Next() override;
+    bool Prev() override;
+    void Seek(S2CellId target) override {
+      iter_ = cell_map_->lower_bound(target);
+    }
+
+    bool Locate(const S2Point& target) override {
+      return LocateImpl(*this, target);
+    }
+
+    S2CellRelation Locate(S2CellId target) override {
+      return LocateImpl(*this, target);
+    }
+
+    void SeekNear(S2CellId target) override;
+
+    bool LocateNear(const S2Point& target) override {
+      return LocateNearImpl(*this, target);
+    }
+
+    S2CellRelation LocateNear(S2CellId target) override {
+      return LocateNearImpl(*this, target);
+    }
+
+    std::unique_ptr<IteratorBase> Clone() const override {
+      return std::make_unique<Iterator>(*this);
+    }
+
+   private:
+    const CellMap* cell_map_ = nullptr;
+    CellMap::const_iterator iter_;
+  };
+
+ protected:
+  std::unique_ptr<IteratorBase> NewIterator(InitialPosition pos) const override;
+
+ private:
+  friend class MutableS2ShapeIndex;
+
+  Snapshot() = default;
+
+  std::vector<const S2Shape*> shapes_;
+  CellMap cell_map_;
+  int max_edges_per_cell_ = 0;
+
+  // Keeps alive all the cells and shapes retired after this snapshot was
+  // created (which may still be referenced by cell_map_ and shapes_).
+  std::shared_ptr<Epoch> epoch_;
+};
+
 class MutableS2ShapeIndex::BatchGenerator {
  public:
   // Given the total number of edges that will be removed and added, prepares
@@ -704,6 +1210,8 @@ inline void MutableS2ShapeIndex::Iterator::InitStale(
   index_ = index;
   end_ = index_->cell_map_.end();
   iter_ = end_;
+  prefetch_distance_ = absl::GetFlag(FLAGS_s2shape_index_prefetch_distance);
+  num_ahead_ = 0;
 
   if (pos == BEGIN) {
     iter_ = index_->cell_map_.begin();
@@ -714,15 +1222,18 @@ inline void MutableS2ShapeIndex::Iterator::Begin() {
   // Make sure that the index has not been modified since Init() was called.
   ABSL_DCHECK(index_->is_fresh());
   iter_ = index_->cell_map_.begin();
+  num_ahead_ = 0;
 }
 
 inline void MutableS2ShapeIndex::Iterator::Finish() {
   iter_ = end_;
+  num_ahead_ = 0;
 }
 
 inline void MutableS2ShapeIndex::Iterator::Next() {
   ABSL_DCHECK(!done());
   ++iter_;
+  if (prefetch_distance_ > 0) Prefetch();
 }
 
 inline bool MutableS2ShapeIndex::Iterator::Prev() {
@@ -730,11 +1241,17 @@ inline bool MutableS2ShapeIndex::Iterator::Prev() {
     return false;
   }
   --iter_;
+  num_ahead_ = 0;
   return true;
 }
 
 inline void MutableS2ShapeIndex::Iterator::Seek(S2CellId target) {
   iter_ = index_->cell_map_.lower_bound(target);
+  num_ahead_ = 0;
+}
+
+inline void MutableS2ShapeIndex::Iterator::SeekNear(S2CellId target) {
+  SeekNearImpl(*this, target);
 }
 
 inline std::unique_ptr<MutableS2ShapeIndex::IteratorBase>
@@ -742,6 +1259,40 @@ MutableS2ShapeIndex::NewIterator(InitialPosition pos) const {
   return std::make_unique<Iterator>(this, pos);
 }
 
+inline MutableS2ShapeIndex::Snapshot::Iterator::Iterator() = default;
+
+inline MutableS2ShapeIndex::Snapshot::Iterator::Iterator(
+    const Snapshot* snapshot, InitialPosition pos) {
+  Init(snapshot, pos);
+}
+
+inline void MutableS2ShapeIndex::Snapshot::Iterator::Init(
+    const Snapshot* snapshot, InitialPosition pos) {
+  cell_map_ = &snapshot->cell_map_;
+  iter_ = (pos == BEGIN) ? cell_map_->begin() : cell_map_->end();
+}
+
+inline void MutableS2ShapeIndex::Snapshot::Iterator::Next() {
+  ABSL_DCHECK(!done());
+  ++iter_;
+}
+
+inline bool MutableS2ShapeIndex::Snapshot::Iterator::Prev() {
+  if (iter_ == cell_map_->begin()) return false;
+  --iter_;
+  return true;
+}
+
+inline void MutableS2ShapeIndex::Snapshot::Iterator::SeekNear(
+    S2CellId target) {
+  SeekNearImpl(*this, target);
+}
+
+inline std::unique_ptr<MutableS2ShapeIndex::IteratorBase>
+MutableS2ShapeIndex::Snapshot::NewIterator(InitialPosition pos) const {
+  return std::make_unique<Iterator>(this, pos);
+}
+
 inline void MutableS2ShapeIndex::ForceBuild() const {
   MaybeApplyUpdates();
 }
@@ -0,0 +1,82 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Benchmarks for building a MutableS2ShapeIndex.
+
+#include "s2/mutable_s2shape_index.h"
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "s2/s1angle.h"
+#include "s2/s2fractal.h"
+#include "s2/s2hilbert_sort.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2testing.h"
+
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Builds an index containing a single fractal loop with approximately
+// state.range(0) edges, using state.range(1) threads.
+void BM_BuildFractalLoop(benchmark::State& state) {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(state.range(0));
+  unique_ptr<S2Loop> loop = fractal.MakeLoop(S2Testing::GetRandomFrame(),
+                                             S1Angle::Degrees(10));
+  MutableS2ShapeIndex::Options options;
+  options.set_num_threads(state.range(1));
+  for (auto _ : state) {
+    MutableS2ShapeIndex index(options);
+    index.Add(make_unique<S2Loop::Shape>(loop.get()));
+    index.ForceBuild();
+  }
+  state.SetItemsProcessed(state.iterations() * loop->num_vertices());
+}
+BENCHMARK(BM_BuildFractalLoop)
+    ->ArgsProduct({benchmark::CreateRange(1 << 10, 1 << 18, 8), {1, 4}});
+
+// Builds an index containing many small loops spread over the whole sphere.
+// If state.range(1) is true, the loops are added in Hilbert order (see
+// s2hilbert_sort.h) rather than in random order.
+void BM_BuildManyLoops(benchmark::State& state) {
+  S2Testing::rnd.Reset(1);
+  vector<unique_ptr<S2Loop>> loops;
+  for (int i = 0; i < state.range(0); ++i) {
+    loops.push_back(S2Loop::MakeRegularLoop(S2Testing::RandomPoint(),
+                                            S1Angle::Degrees(0.1), 16));
+  }
+  if (state.range(1)) {
+    S2::SortInHilbertOrderBy(
+        &loops, [](const unique_ptr<S2Loop>& loop) { return loop->vertex(0); });
+  }
+  for (auto _ : state) {
+    MutableS2ShapeIndex index;
+    for (const auto& loop : loops) {
+      index.Add(make_unique<S2Loop::Shape>(loop.get()));
+    }
+    index.ForceBuild();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BuildManyLoops)->ArgsProduct({{1 << 6, 1 << 12, 1 << 16}, {0, 1}});
+
+}  // namespace
@@ -21,7 +21,9 @@
 #include <cstddef>
 
 #include <algorithm>
+#include <atomic>
 #include <memory>
+#include <memory_resource>
 #include <numeric>
 #include <thread>
 #include <string>
@@ -38,18 +40,24 @@
 
 #include "s2/base/commandlineflags.h"
 #include "s2/base/commandlineflags_declare.h"
+#include "s2/base/executor.h"
 #include "s2/base/log_severity.h"
 #include "s2/base/types.h"
 #include "s2/r2.h"
 #include "s2/r2rect.h"
 #include "s2/s1angle.h"
+#include "s2/s1chord_angle.h"
+#include "s2/s2cap.h"
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
+#include "s2/s2cell_iterator_testing.h"
 #include "s2/s2cell_union.h"
+#include "s2/s2closest_edge_query.h"
 #include "s2/s2coords.h"
 #include "s2/s2edge_clipping.h"
 #include "s2/s2edge_distances.h"
 #include "s2/s2edge_vector_shape.h"
+#include "s2/s2encoding_sink.h"
 #include "s2/s2error.h"
 #include "s2/s2fractal.h"
 #include "s2/s2lax_polygon_shape.h"
@@ -96,6 +104,14 @@ class MutableS2ShapeIndexTest : public ::testing::Test {
   void ValidateEdge(const S2Point& a, const S2Point& b,
                     S2CellId id, bool index_has_edge);
 
+  // Given an edge AB whose edge id is "e" in the given clipped shape of the
+  // given index cell, verifies that if the cell has edge run bounds then the
+  // bound of the run that contains the edge also contains the portion of AB
+  // that intersects the padded cell.
+  void ValidateEdgeRunBound(const S2Point& a, const S2Point& b, int e,
+                            S2CellId id, const S2ShapeIndexCell& cell,
+                            const S2ClippedShape& clipped);
+
   // Given a shape and a cell id, determines whether or not the shape contains
   // the cell center and verify that this matches "index_contains_center".
   void ValidateInterior(const S2Shape* shape, S2CellId id,
@@ -175,6 +191,10 @@ void MutableS2ShapeIndexTest::QuadraticValidate() {
         if (!it.done()) {
           bool has_edge = clipped && clipped->ContainsEdge(e);
           ValidateEdge(edge.v0, edge.v1, it.id(), has_edge);
+          if (has_edge) {
+            ValidateEdgeRunBound(edge.v0, edge.v1, e, it.id(), it.cell(),
+                                 *clipped);
+          }
           int max_level = index_.GetEdgeMaxLevel(edge);
           if (has_edge) {
             ++num_edges;
@@ -186,8 +206,11 @@ void MutableS2ShapeIndexTest::QuadraticValidate() {
     // This mirrors the calculation in MutableS2ShapeIndex::MakeIndexCell().
     // It is designed to ensure that the index size is always linear in the
     // number of indexed edges.
+    int max_edges_per_cell =
+        it.done() ? index_.options().max_edges_per_cell()
+                  : index_.face_parameters(it.id().face()).max_edges_per_cell;
     int max_short_edges = std::max(
-        index_.options().max_edges_per_cell(),
+        max_edges_per_cell,
         static_cast<int>(
             absl::GetFlag(FLAGS_s2shape_index_min_short_edge_fraction) *
             (num_edges + num_containing_shapes)));
@@ -211,6 +234,29 @@ void MutableS2ShapeIndexTest::ValidateEdge(const S2Point& a, const S2Point& b,
             index_has_edge);
 }
 
+void MutableS2ShapeIndexTest::ValidateEdgeRunBound(
+    const S2Point& a, const S2Point& b, int e, S2CellId id,
+    const S2ShapeIndexCell& cell, const S2ClippedShape& clipped) {
+  const R2Rect* run_bound = cell.edge_run_bounds();
+  if (run_bound == nullptr) return;
+  for (const S2ClippedShape* s = cell.clipped_shapes().data(); s != &clipped;
+       ++s) {
+    run_bound += S2ShapeIndexCell::num_edge_runs(*s);
+  }
+  int j = 0;
+  while (clipped.edge(j) != e) ++j;
+  run_bound += j / S2ShapeIndexCell::kEdgesPerRun;
+
+  const double padding = MutableS2ShapeIndex::kCellPadding;
+  R2Point a_uv, b_uv;
+  ASSERT_TRUE(S2::ClipToPaddedFace(a, b, id.face(), padding, &a_uv, &b_uv));
+  R2Rect bound = R2Rect::FromPointPair(a_uv, b_uv);
+  if (S2::ClipEdgeBound(a_uv, b_uv, id.GetBoundUV().Expanded(padding),
+                        &bound)) {
+    EXPECT_TRUE(run_bound->Contains(bound)) << id << " edge " << e;
+  }
+}
+
 void MutableS2ShapeIndexTest::ValidateInterior(
     const S2Shape* shape, S2CellId id, bool index_contains_center) {
   if (shape == nullptr) {
@@ -228,6 +274,15 @@ void MutableS2ShapeIndexTest::TestEncodeDecode() {
   MutableS2ShapeIndex index2;
   ASSERT_TRUE(index2.Init(&decoder, s2shapeutil::WrappedShapeFactory(&index_)));
   s2testing::ExpectEqual(index_, index2);
+
+  // Encoding to a sink must give exactly the same bytes.
+  string streamed;
+  S2CallbackSink sink([&streamed](absl::string_view data) {
+    streamed.append(data.data(), data.size());
+    return true;
+  });
+  ASSERT_TRUE(index_.Encode(&sink));
+  EXPECT_EQ(streamed, string(encoder.base(), encoder.length()));
 }
 
 /*static*/ string MutableS2ShapeIndexTest::ToString(
@@ -313,6 +368,7 @@ void TestIteratorMethods(const MutableS2ShapeIndex& index) {
     ids.push_back(cellid);
     min_cellid = cellid.range_max().next();
   }
+  TestSeekNear(MutableS2ShapeIndex::Iterator(&index));
 }
 
 // NOTE(ericv): The tests below are all somewhat fragile since they depend on
@@ -548,6 +604,121 @@ TEST_F(MutableS2ShapeIndexTest, ManyTinyEdges) {
   EXPECT_TRUE(it.done());
 }
 
+// Verifies that the two indexes have exactly the same cells and contents.
+static void ExpectIdenticalIndexes(const MutableS2ShapeIndex& a,
+                                   const MutableS2ShapeIndex& b) {
+  MutableS2ShapeIndex::Iterator a_it(&a, S2ShapeIndex::BEGIN);
+  MutableS2ShapeIndex::Iterator b_it(&b, S2ShapeIndex::BEGIN);
+  for (; !a_it.done() && !b_it.done(); a_it.Next(), b_it.Next()) {
+    ASSERT_EQ(a_it.id(), b_it.id());
+    const S2ShapeIndexCell& a_cell = a_it.cell();
+    const S2ShapeIndexCell& b_cell = b_it.cell();
+    ASSERT_EQ(a_cell.num_clipped(), b_cell.num_clipped());
+    for (int i = 0; i < a_cell.num_clipped(); ++i) {
+      const S2ClippedShape& a_clipped = a_cell.clipped(i);
+      const S2ClippedShape& b_clipped = b_cell.clipped(i);
+      EXPECT_EQ(a_clipped.shape_id(), b_clipped.shape_id());
+      EXPECT_EQ(a_clipped.contains_center(), b_clipped.contains_center());
+      ASSERT_EQ(a_clipped.num_edges(), b_clipped.num_edges());
+      for (int j = 0; j < a_clipped.num_edges(); ++j) {
+        EXPECT_EQ(a_clipped.edge(j), b_clipped.edge(j));
+      }
+    }
+  }
+  EXPECT_TRUE(a_it.done());
+  EXPECT_TRUE(b_it.done());
+}
+
+TEST_F(MutableS2ShapeIndexTest, ParallelBuildOneEdge) {
+  MutableS2ShapeIndex::Options options;
+  options.set_num_threads(4);
+  index_.Init(options);
+  index_.Add(make_unique<S2EdgeVectorShape>(S2Point(1, 0, 0),
+                                            S2Point(0, 1, 0)));
+  QuadraticValidate();
+  TestEncodeDecode();
+}
+
+TEST_F(MutableS2ShapeIndexTest, ParallelBuildLoopsSpanningThreeFaces) {
+  MutableS2ShapeIndex::Options options;
+  options.set_num_threads(3);
+  index_.Init(options);
+  S2Polygon polygon;
+  const int kNumEdges = 100;  // Validation is quadratic
+  S2Testing::ConcentricLoopsPolygon(S2Point(1, -1, -1).Normalize(), 2,
+                                    kNumEdges, &polygon);
+  for (int i = 0; i < polygon.num_loops(); ++i) {
+    index_.Add(make_unique<S2Loop::Shape>(polygon.loop(i)));
+  }
+  QuadraticValidate();
+}
+
+TEST(MutableS2ShapeIndex, ParallelBuildMatchesSequentialBuild) {
+  // Build the same geometry using one thread and several threads, and check
+  // that the resulting indexes are identical.  The geometry includes loops
+  // spanning several faces, a loop containing most of a face (so that some
+  // index cells contain no edges), polylines, and points.
+  S2Testing::rnd.Reset(absl::GetFlag(FLAGS_s2_random_seed));
+  vector<unique_ptr<S2Loop>> loops;
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(20000);
+  loops.push_back(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(S2Point(1, -1, -1).Normalize()),
+      S1Angle::Degrees(30)));
+  loops.push_back(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(S2Point(0, 0, 1)), S1Angle::Degrees(5)));
+  loops.push_back(S2Loop::MakeRegularLoop(S2Point(1, 0.5, 0.5).Normalize(),
+                                          S1Angle::Degrees(89), 100));
+  vector<unique_ptr<S2Polyline>> polylines;
+  polylines.push_back(MakePolylineOrDie("0:0, 2:1, 0:2, 2:3, 0:4, 2:5, 0:6"));
+  polylines.push_back(MakePolylineOrDie("-60:100, 60:-80"));
+
+  MutableS2ShapeIndex::Options options;
+  options.set_num_threads(4);
+  MutableS2ShapeIndex sequential, parallel(options);
+  for (MutableS2ShapeIndex* index : {&sequential, &parallel}) {
+    for (const auto& loop : loops) {
+      index->Add(make_unique<S2Loop::Shape>(loop.get()));
+    }
+    for (const auto& polyline : polylines) {
+      index->Add(make_unique<S2Polyline::Shape>(polyline.get()));
+    }
+    index->Add(make_unique<S2PointVectorShape>(
+        vector<S2Point>{S2Point(0, -1, 0), S2Point(-1, 1, 1).Normalize()}));
+  }
+  ExpectIdenticalIndexes(sequential, parallel);
+
+  // Now check that incremental updates also produce identical results.  Some
+  // of these updates modify faces that were previously empty.
+  unique_ptr<S2Loop> loop = fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(S2Point(-1, 0, 0)), S1Angle::Degrees(20));
+  for (MutableS2ShapeIndex* index : {&sequential, &parallel}) {
+    index->Add(make_unique<S2Loop::Shape>(loop.get()));
+    index->Release(1);
+  }
+  ExpectIdenticalIndexes(sequential, parallel);
+}
+
+TEST(MutableS2ShapeIndex, ParallelBuildWithExecutor) {
+  // Building the index on an executor (with fewer threads than requested)
+  // gives the same result as building it on a single thread.
+  S2Testing::rnd.Reset(absl::GetFlag(FLAGS_s2_random_seed));
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(10000);
+  unique_ptr<S2Loop> loop = fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(S2Point(1, -1, -1).Normalize()),
+      S1Angle::Degrees(30));
+  s2base::WorkStealingThreadPool pool(2);
+  MutableS2ShapeIndex::Options options;
+  options.set_num_threads(4);
+  options.set_executor(&pool);
+  MutableS2ShapeIndex sequential, parallel(options);
+  for (MutableS2ShapeIndex* index : {&sequential, &parallel}) {
+    index->Add(make_unique<S2Loop::Shape>(loop.get()));
+  }
+  ExpectIdenticalIndexes(sequential, parallel);
+}
+
 TEST_F(MutableS2ShapeIndexTest, SimpleUpdates) {
   // Add 5 loops one at a time, then release them one at a time,
   // validating the index at each step.
@@ -639,6 +810,127 @@ TEST_F(MutableS2ShapeIndexTest, RandomUpdates) {
   }
 }
 
+TEST_F(MutableS2ShapeIndexTest, UpdateStats) {
+  // Index a fractal loop inside a larger loop with few edges.  Removing and
+  // re-adding the larger loop should update the cells of the fractal in place
+  // rather than rebuilding them.
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3000);
+  S2Point center = S2Testing::RandomPoint();
+  index_.Add(make_unique<S2Loop::OwningShape>(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(center), S1Angle::Degrees(1))));
+  index_.Add(make_unique<S2Loop::OwningShape>(
+      S2Loop::MakeRegularLoop(center, S1Angle::Degrees(10), 8)));
+  index_.ForceBuild();
+  const MutableS2ShapeIndex::UpdateStats& stats = index_.last_update_stats();
+  EXPECT_EQ(stats.num_shapes_added, 2);
+  EXPECT_EQ(stats.num_edges_added, index_.shape(0)->num_edges() + 8);
+  EXPECT_EQ(stats.num_batches, 1);
+  EXPECT_EQ(stats.num_cells_before, 0);
+  EXPECT_GT(stats.num_cells_after, 0);
+  int64 num_cells = stats.num_cells_after;
+
+  unique_ptr<S2Shape> loop = index_.Release(1);
+  index_.ForceBuild();
+  EXPECT_EQ(stats.num_shapes_added, 0);
+  EXPECT_EQ(stats.num_shapes_removed, 1);
+  EXPECT_EQ(stats.num_edges_removed, 8);
+  EXPECT_EQ(stats.num_cells_before, num_cells);
+  EXPECT_GT(stats.num_cells_patched, 0);
+  EXPECT_GT(stats.num_cells_patched, stats.num_cells_rebuilt);
+  QuadraticValidate();
+
+  index_.Add(std::move(loop));
+  index_.ForceBuild();
+  EXPECT_EQ(stats.num_shapes_added, 1);
+  EXPECT_GT(stats.num_cells_patched, stats.num_cells_rebuilt);
+  QuadraticValidate();
+  TestEncodeDecode();
+}
+
+TEST_F(MutableS2ShapeIndexTest, AutoTune) {
+  // A dense fractal with many short edges uses more edges per cell than the
+  // default, which yields a smaller index.
+  MutableS2ShapeIndex::Options options;
+  options.set_auto_tune(true);
+  index_.Init(options);
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(15000);
+  S2Point center = S2Testing::RandomPoint();
+  auto loop = fractal.MakeLoop(S2Testing::GetRandomFrameAt(center),
+                               S1Angle::Degrees(0.5));
+  MutableS2ShapeIndex default_index;
+  default_index.Add(make_unique<S2Loop::Shape>(loop.get()));
+  index_.Add(make_unique<S2Loop::Shape>(loop.get()));
+  index_.ForceBuild();
+  default_index.ForceBuild();
+  EXPECT_EQ(index_.last_update_stats().num_faces_tuned, 1);
+  const int face = S2::GetFace(center);
+  MutableS2ShapeIndex::FaceParameters params = index_.face_parameters(face);
+  EXPECT_TRUE(params.auto_tuned);
+  EXPECT_GT(params.max_edges_per_cell, options.max_edges_per_cell());
+  EXPECT_LE(params.max_edges_per_cell, 50);
+  EXPECT_GE(params.cell_size_to_long_edge_ratio, 0.5);
+  EXPECT_LE(params.cell_size_to_long_edge_ratio, 4.0);
+  EXPECT_FALSE(index_.face_parameters((face + 1) % 6).auto_tuned);
+  EXPECT_EQ(index_.face_parameters((face + 1) % 6).max_edges_per_cell,
+            options.max_edges_per_cell());
+  EXPECT_LT(index_.last_update_stats().num_cells_after,
+            default_index.last_update_stats().num_cells_after);
+  QuadraticValidate();
+
+  // Incremental updates do not retune faces that are already indexed.
+  index_.Add(make_unique<S2Loop::OwningShape>(
+      S2Loop::MakeRegularLoop(center, S1Angle::Degrees(10), 8)));
+  index_.ForceBuild();
+  EXPECT_EQ(index_.last_update_stats().num_faces_tuned, 0);
+  EXPECT_EQ(index_.face_parameters(face).max_edges_per_cell,
+            params.max_edges_per_cell);
+  QuadraticValidate();
+  TestEncodeDecode();
+}
+
+TEST_F(MutableS2ShapeIndexTest, EdgeRunBounds) {
+  // Checks the edge run bounds of cells that are built from scratch, patched
+  // in place (as in UpdateStats above), or absorbed and rebuilt.  A snapshot
+  // is kept so that cells that are modified in place are copied first.
+  MutableS2ShapeIndex::Options options;
+  options.set_edge_run_bounds(true);
+  index_.Init(options);
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3000);
+  S2Point center = S2Testing::RandomPoint();
+  index_.Add(make_unique<S2Loop::OwningShape>(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(center), S1Angle::Degrees(1))));
+  index_.Add(make_unique<S2Loop::OwningShape>(
+      S2Loop::MakeRegularLoop(center, S1Angle::Degrees(10), 8)));
+  index_.ForceBuild();
+  int num_cells_with_bounds = 0;
+  for (MutableS2ShapeIndex::Iterator it(&index_, S2ShapeIndex::BEGIN);
+       !it.done(); it.Next()) {
+    EXPECT_EQ(it.cell().edge_run_bounds() != nullptr,
+              it.cell().num_edges() > 0);
+    num_cells_with_bounds += (it.cell().edge_run_bounds() != nullptr);
+  }
+  EXPECT_GT(num_cells_with_bounds, 0);
+  QuadraticValidate();
+
+  auto snapshot = index_.NewSnapshot();
+  unique_ptr<S2Shape> loop = index_.Release(1);
+  index_.ForceBuild();
+  EXPECT_GT(index_.last_update_stats().num_cells_patched, 0);
+  QuadraticValidate();
+
+  index_.Add(std::move(loop));
+  index_.Add(make_unique<S2Polyline::OwningShape>(make_unique<S2Polyline>(
+      vector<S2Point>{S2Testing::RandomPoint(), center})));
+  QuadraticValidate();
+  TestEncodeDecode();
+}
+
 // A test that repeatedly updates "index_" in one thread and attempts to
 // concurrently read the index_ from several other threads.  When all threads
 // have finished reading, the first thread makes another update.
@@ -669,6 +961,20 @@ class LazyUpdatesTest : public s2testing::ReaderWriterTest {
   MutableS2ShapeIndex index_;
 };
 
+// Like LazyUpdatesTest, except that readers first try the build policies
+// that never apply updates on the calling thread.
+class TryBuildTest : public LazyUpdatesTest {
+ public:
+  void ReadOp() override {
+    using BuildPolicy = MutableS2ShapeIndex::BuildPolicy;
+    if (!index_.TryBuild(BuildPolicy::FAIL_FAST) &&
+        !index_.TryBuild(BuildPolicy::WAIT)) {
+      EXPECT_TRUE(index_.TryBuild(BuildPolicy::BUILD));
+    }
+    LazyUpdatesTest::ReadOp();
+  }
+};
+
 TEST(MutableS2ShapeIndex, ConstMethodsThreadSafe) {
   // Ensure that lazy updates are thread-safe.  In other words, make sure that
   // nothing bad happens when multiple threads call "const" methods that
@@ -682,6 +988,294 @@ TEST(MutableS2ShapeIndex, ConstMethodsThreadSafe) {
   test.Run(kNumReaders, kIters);
 }
 
+TEST(MutableS2ShapeIndex, TryBuildThreadSafe) {
+  TryBuildTest test;
+  test.Run(8 /*num_readers*/, 100 /*iters*/);
+}
+
+TEST(MutableS2ShapeIndex, TryBuild) {
+  using BuildPolicy = MutableS2ShapeIndex::BuildPolicy;
+  MutableS2ShapeIndex index;
+  EXPECT_TRUE(index.TryBuild(BuildPolicy::FAIL_FAST));
+  index.Add(
+      make_unique<S2Polyline::OwningShape>(MakePolylineOrDie("0:0, 1:1")));
+  // No other thread is applying the updates, so there is nothing to wait for.
+  EXPECT_FALSE(index.TryBuild(BuildPolicy::FAIL_FAST));
+  EXPECT_FALSE(index.TryBuild(BuildPolicy::WAIT));
+  EXPECT_FALSE(index.is_fresh());
+  EXPECT_TRUE(index.TryBuild(BuildPolicy::BUILD));
+  EXPECT_TRUE(index.is_fresh());
+  EXPECT_TRUE(index.TryBuild(BuildPolicy::FAIL_FAST));
+  EXPECT_TRUE(index.TryBuild(BuildPolicy::WAIT));
+}
+
+string EncodeIndex(const S2ShapeIndex& index) {
+  Encoder encoder;
+  index.Encode(&encoder);
+  return string(encoder.base(), encoder.length());
+}
+
+TEST(MutableS2ShapeIndex, SnapshotsAreUnaffectedByUpdates) {
+  // Use a small temporary memory budget so that the polygon below is split
+  // into several batches, which modifies existing index cells in place.
+  absl::FlagSaver fs;
+  absl::SetFlag(&FLAGS_s2shape_index_tmp_memory_budget, 10000);
+  S2Polygon polygon;
+  S2Testing::ConcentricLoopsPolygon(S2Point(1, 0, 0), 5, 20, &polygon);
+
+  MutableS2ShapeIndex index;
+  index.Add(make_unique<S2Loop::OwningShape>(S2Loop::MakeRegularLoop(
+      S2Point(1, 0, 0), S1Angle::Degrees(30), 10)));
+  // Points in the polygon interior ensure that some existing index cells are
+  // modified when the interior of the polygon is filled in.
+  S2Testing::rnd.Reset(1);
+  vector<S2Point> points;
+  S2Cap cap(S2Point(1, 0, 0), S1Angle::Radians(0.005));
+  for (int i = 0; i < 500; ++i) points.push_back(S2Testing::SamplePoint(cap));
+  index.Add(make_unique<S2PointVectorShape>(std::move(points)));
+  vector<std::shared_ptr<const MutableS2ShapeIndex::Snapshot>> snapshots;
+  vector<string> encodings;
+  auto take_snapshot = [&]() {
+    snapshots.push_back(index.NewSnapshot());
+    encodings.push_back(EncodeIndex(index));
+    EXPECT_EQ(snapshots.back()->num_shape_ids(), index.num_shape_ids());
+  };
+  take_snapshot();
+  index.Add(make_unique<S2Polygon::Shape>(&polygon));
+  take_snapshot();
+  EXPECT_GT(index.last_update_stats().num_batches, 1);
+  index.Add(make_unique<S2Loop::OwningShape>(
+      make_unique<S2Loop>(S2Loop::kFull())));
+  take_snapshot();
+  const S2Shape* removed = index.shape(0);
+  index.RetireShape(index.Release(0));
+  take_snapshot();
+  index.Clear();
+  EXPECT_EQ(snapshots[0]->shape(0), removed);
+  for (size_t i = 0; i < snapshots.size(); ++i) {
+    EXPECT_EQ(EncodeIndex(*snapshots[i]), encodings[i]) << i;
+  }
+  // The snapshot should also support queries.
+  S2ClosestEdgeQuery query(snapshots[1].get());
+  S2ClosestEdgeQuery::PointTarget target(S2Point(1, 0, 0));
+  EXPECT_EQ(query.GetDistance(&target), S1ChordAngle::Zero());
+}
+
+TEST_F(MutableS2ShapeIndexTest, Compact) {
+  S2Polygon polygon;
+  S2Testing::ConcentricLoopsPolygon(S2Point(1, 0, 0), 6, 20, &polygon);
+  for (int i = 0; i < polygon.num_loops(); ++i) {
+    index_.Add(make_unique<S2Loop::Shape>(polygon.loop(i)));
+  }
+  auto snapshot = index_.NewSnapshot();
+  const string snapshot_encoding = EncodeIndex(*snapshot);
+
+  // Removals are still pending when Compact() is called.
+  index_.RetireShape(index_.Release(1));
+  index_.RetireShape(index_.Release(4));
+  EXPECT_EQ(index_.Compact(), (vector<int>{0, -1, 1, 2, -1, 3}));
+  ASSERT_EQ(index_.num_shape_ids(), 4);
+  const vector<int> old_ids = {0, 2, 3, 5};
+  for (int id = 0; id < index_.num_shape_ids(); ++id) {
+    EXPECT_EQ(index_.shape(id)->edge(0).v0,
+              polygon.loop(old_ids[id])->vertex(0));
+  }
+  QuadraticValidate();
+  TestEncodeDecode();
+
+  // Shapes added later are numbered following the compacted shapes.
+  EXPECT_EQ(index_.Add(make_unique<S2Loop::Shape>(polygon.loop(1))), 4);
+  QuadraticValidate();
+  EXPECT_EQ(index_.Compact(), (vector<int>{0, 1, 2, 3, 4}));
+
+  // The snapshot still refers to the original shape ids.
+  EXPECT_EQ(snapshot->num_shape_ids(), 6);
+  EXPECT_EQ(EncodeIndex(*snapshot), snapshot_encoding);
+}
+
+TEST(MutableS2ShapeIndex, PrefetchDoesNotAffectIteration) {
+  MutableS2ShapeIndex index;
+  S2Polygon polygon;
+  S2Testing::ConcentricLoopsPolygon(S2Point(1, 0, 0), 10, 100, &polygon);
+  index.Add(make_unique<S2Polygon::Shape>(&polygon));
+  vector<S2CellId> expected;
+  for (MutableS2ShapeIndex::Iterator it(&index, S2ShapeIndex::BEGIN);
+       !it.done(); it.Next()) {
+    expected.push_back(it.id());
+  }
+  for (int distance : {0, 1, 2, 5, 8, 64}) {
+    absl::FlagSaver fs;
+    absl::SetFlag(&FLAGS_s2shape_index_prefetch_distance, distance);
+    vector<S2CellId> actual;
+    MutableS2ShapeIndex::Iterator it(&index, S2ShapeIndex::BEGIN);
+    for (int i = 0; !it.done(); ++i) {
+      actual.push_back(it.id());
+      if (i % 50 == 49) {
+        // Step back and forth, which restarts prefetching.
+        it.Prev();
+        it.Next();
+      }
+      it.Next();
+    }
+    EXPECT_EQ(actual, expected) << distance;
+  }
+}
+
+// A memory resource that counts the bytes it has outstanding.
+class CountingMemoryResource : public std::pmr::memory_resource {
+ public:
+  int64 bytes_outstanding() const { return bytes_outstanding_; }
+  int64 num_allocations() const { return num_allocations_; }
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    bytes_outstanding_ += bytes;
+    ++num_allocations_;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    bytes_outstanding_ -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  std::atomic<int64> bytes_outstanding_{0};
+  std::atomic<int64> num_allocations_{0};
+};
+
+TEST_F(MutableS2ShapeIndexTest, MemoryResource) {
+  CountingMemoryResource resource;
+  MutableS2ShapeIndex::Options options;
+  options.set_memory_resource(&resource);
+  options.set_num_threads(4);
+  index_.Init(options);
+  S2Polygon polygon;
+  S2Testing::ConcentricLoopsPolygon(S2Point(1, 0, 0), 6, 200, &polygon);
+  for (int i = 0; i < polygon.num_loops(); ++i) {
+    index_.Add(make_unique<S2Loop::Shape>(polygon.loop(i)));
+  }
+  QuadraticValidate();
+  EXPECT_GT(resource.num_allocations(), 0);
+
+  // Cells modified while a snapshot exists are copied into the resource, and
+  // the originals are freed to it when the snapshot is destroyed.
+  auto snapshot = index_.NewSnapshot();
+  const string snapshot_encoding = EncodeIndex(*snapshot);
+  index_.RetireShape(index_.Release(2));
+  QuadraticValidate();
+  TestEncodeDecode();
+  EXPECT_EQ(EncodeIndex(*snapshot), snapshot_encoding);
+
+  // Decoded cells are also allocated from the resource.
+  MutableS2ShapeIndex decoded(options);
+  string encoded = EncodeIndex(index_);
+  Decoder decoder(encoded.data(), encoded.size());
+  ASSERT_TRUE(
+      decoded.Init(&decoder, s2shapeutil::WrappedShapeFactory(&index_)));
+  s2testing::ExpectEqual(index_, decoded);
+  decoded.Clear();
+
+  // Changing the resource releases the cells allocated by the old one, but
+  // the snapshot keeps them alive until it is destroyed.
+  index_.Clear();
+  index_.Init(MutableS2ShapeIndex::Options());
+  EXPECT_GT(resource.bytes_outstanding(), 0);
+  EXPECT_EQ(EncodeIndex(*snapshot), snapshot_encoding);
+  snapshot.reset();
+  EXPECT_EQ(resource.bytes_outstanding(), 0);
+}
+
+TEST(MutableS2ShapeIndex, PackCellEdges) {
+  // Packing the edges of each cell does not change the index, including
+  // cells that are copied because a snapshot exists, cells that are patched
+  // when shapes are removed, and decoded cells.
+  S2Polygon polygon;
+  S2Testing::ConcentricLoopsPolygon(S2Point(1, 0, 0), 8, 300, &polygon);
+  CountingMemoryResource resource;
+  MutableS2ShapeIndex::Options options;
+  options.set_pack_cell_edges(true);
+  MutableS2ShapeIndex::Options resource_options = options;
+  resource_options.set_memory_resource(&resource);
+  resource_options.set_num_threads(3);
+  MutableS2ShapeIndex expected, packed(options), packed_resource(
+      resource_options);
+  for (MutableS2ShapeIndex* index : {&expected, &packed, &packed_resource}) {
+    for (int i = 0; i < polygon.num_loops(); ++i) {
+      index->Add(make_unique<S2Loop::Shape>(polygon.loop(i)));
+    }
+    index->ForceBuild();
+  }
+  ExpectIdenticalIndexes(expected, packed);
+  ExpectIdenticalIndexes(expected, packed_resource);
+
+  vector<std::shared_ptr<const MutableS2ShapeIndex::Snapshot>> snapshots;
+  for (MutableS2ShapeIndex* index : {&expected, &packed, &packed_resource}) {
+    snapshots.push_back(index->NewSnapshot());
+    index->Release(3);
+    index->Add(make_unique<S2Loop::Shape>(polygon.loop(3)));
+    index->ForceBuild();
+  }
+  ExpectIdenticalIndexes(expected, packed);
+  ExpectIdenticalIndexes(expected, packed_resource);
+
+  string encoded = EncodeIndex(expected);
+  for (const auto& index_options : {options, resource_options}) {
+    MutableS2ShapeIndex decoded(index_options);
+    Decoder decoder(encoded.data(), encoded.size());
+    ASSERT_TRUE(
+        decoded.Init(&decoder, s2shapeutil::WrappedShapeFactory(&expected)));
+    ExpectIdenticalIndexes(expected, decoded);
+  }
+
+  // All cells and their packed edges are returned to the resource.
+  snapshots.clear();
+  packed_resource.Clear();
+  EXPECT_EQ(resource.bytes_outstanding(), 0);
+}
+
+// A test where one thread repeatedly updates and publishes the index while
+// other threads query the published snapshot.
+TEST(MutableS2ShapeIndex, ConcurrentReadsOfPublishedSnapshots) {
+  MutableS2ShapeIndex index;
+  index.PublishSnapshot();
+  std::atomic<bool> done(false);
+  auto read = [&]() {
+    while (!done.load()) {
+      auto snapshot = index.published_snapshot();
+      for (MutableS2ShapeIndex::Snapshot::Iterator it(snapshot.get(),
+                                                      S2ShapeIndex::BEGIN);
+           !it.done(); it.Next()) {
+        const S2ShapeIndexCell& cell = it.cell();
+        for (int s = 0; s < cell.num_clipped(); ++s) {
+          const S2Shape* shape = snapshot->shape(cell.clipped(s).shape_id());
+          ASSERT_NE(shape, nullptr);
+          ASSERT_GE(shape->num_edges(), cell.clipped(s).num_edges());
+        }
+      }
+    }
+  };
+  vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) readers.emplace_back(read);
+  S2Testing::rnd.Reset(1);
+  vector<int> shape_ids;
+  for (int iter = 0; iter < 100; ++iter) {
+    if (shape_ids.size() > 5 || (!shape_ids.empty() && iter % 3 == 0)) {
+      int i = S2Testing::rnd.Uniform(shape_ids.size());
+      index.RetireShape(index.Release(shape_ids[i]));
+      shape_ids.erase(shape_ids.begin() + i);
+    }
+    shape_ids.push_back(index.Add(make_unique<S2Loop::OwningShape>(
+        S2Loop::MakeRegularLoop(S2Testing::RandomPoint(),
+                                S1Angle::Degrees(20), 100))));
+    index.PublishSnapshot();
+  }
+  done = true;
+  for (auto& reader : readers) reader.join();
+}
+
 TEST(MutableS2ShapeIndex, MixedGeometry) {
   // This test used to trigger a bug where the presence of a shape with an
   // interior could cause shapes that don't have an interior to suddenly
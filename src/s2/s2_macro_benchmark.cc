@@ -0,0 +1,306 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// End-to-end benchmarks of complete pipelines on large inputs, intended to
+// catch regressions that microbenchmarks miss.  Each benchmark runs once per
+// repetition and reports its wall time in milliseconds, plus:
+//
+//   allocs      - the number of calls to operator new
+//   peak_bytes  - the peak memory usage reported by S2MemoryTracker (only
+//                 for operations that support memory tracking)
+//
+// Use "s2_macro_benchmarks --benchmark_format=json" for machine-readable
+// output and --benchmark_repetitions to reduce noise.
+//
+// By default the input consists of random fractal polygons with about 12
+// edges each.  To use real data instead, set the environment variable
+// S2_MACRO_BENCHMARK_POLYGONS to the name of a file containing one polygon
+// per line in s2textformat format (see s2textformat::MakeLaxPolygon).  The
+// polygons are reused cyclically if the file contains fewer polygons than a
+// benchmark needs.
+//
+// These benchmarks are a separate binary because counting allocations
+// requires replacing the global operator new.
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "absl/log/absl_check.h"
+#include "s2/base/types.h"
+#include "s2/util/coding/coder.h"
+#include "s2/encoded_s2shape_index.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2builderutil_s2polygon_layer.h"
+#include "s2/s2cap.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2error.h"
+#include "s2/s2fractal.h"
+#include "s2/s2lax_loop_shape.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2loop.h"
+#include "s2/s2loop_measures.h"
+#include "s2/s2memory_tracker.h"
+#include "s2/s2point.h"
+#include "s2/s2point_span.h"
+#include "s2/s2pointutil.h"
+#include "s2/s2polygon.h"
+#include "s2/s2region_coverer.h"
+#include "s2/s2shape_index.h"
+#include "s2/s2shapeutil_coding.h"
+#include "s2/s2shapeutil_contains_brute_force.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+#include "s2/s2winding_operation.h"
+
+using s2builderutil::S2PolygonLayer;
+using std::make_unique;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+// The number of calls to operator new so far.
+static std::atomic<int64> num_allocations{0};
+
+void* operator new(size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+using Polygon = vector<S2LaxPolygonShape::Loop>;
+
+// The input polygons are located within this cap.
+S2Cap GetInputCap() {
+  return S2Cap(S2Point(1, 0, 0), S1Angle::Degrees(30));
+}
+
+// Returns "n" input polygons (see the comments at the top of this file).
+const vector<Polygon>& GetPolygons(int n) {
+  static auto* cache = new std::map<int, vector<Polygon>>;
+  vector<Polygon>& polygons = (*cache)[n];
+  if (!polygons.empty()) return polygons;
+
+  polygons.reserve(n);
+  if (const char* filename = std::getenv("S2_MACRO_BENCHMARK_POLYGONS")) {
+    std::ifstream file(filename);
+    ABSL_CHECK(file) << "Could not open " << filename;
+    vector<Polygon> file_polygons;
+    for (string line; std::getline(file, line);) {
+      unique_ptr<S2LaxPolygonShape> shape;
+      if (line.empty()) continue;
+      ABSL_CHECK(s2textformat::MakeLaxPolygon(line, &shape)) << line;
+      Polygon& polygon = file_polygons.emplace_back();
+      for (int i = 0; i < shape->num_loops(); ++i) {
+        S2LaxPolygonShape::Loop& loop = polygon.emplace_back();
+        for (int j = 0; j < shape->num_loop_vertices(i); ++j) {
+          loop.push_back(shape->loop_vertex(i, j));
+        }
+      }
+    }
+    ABSL_CHECK(!file_polygons.empty()) << filename;
+    for (int i = 0; i < n; ++i) {
+      polygons.push_back(file_polygons[i % file_polygons.size()]);
+    }
+  } else {
+    S2Testing::rnd.Reset(n);
+    S2Fractal fractal;
+    fractal.SetLevelForApproxMaxEdges(12);
+    const S2Cap cap = GetInputCap();
+    for (int i = 0; i < n; ++i) {
+      S1Angle radius =
+          S1Angle::Degrees(0.01 + 0.09 * S2Testing::rnd.RandDouble());
+      unique_ptr<S2Loop> loop = fractal.MakeLoop(
+          S2Testing::GetRandomFrameAt(S2Testing::SamplePoint(cap)), radius);
+      S2PointLoopSpan vertices = loop->vertices_span();
+      polygons.push_back({{vertices.begin(), vertices.end()}});
+    }
+  }
+  return polygons;
+}
+
+// Returns an index containing "n" input polygons.
+unique_ptr<MutableS2ShapeIndex> MakeIndex(int n) {
+  auto index = make_unique<MutableS2ShapeIndex>();
+  for (const Polygon& polygon : GetPolygons(n)) {
+    index->Add(make_unique<S2LaxPolygonShape>(polygon));
+  }
+  index->ForceBuild();
+  return index;
+}
+
+// Each benchmark runs exactly once (per repetition) since it is long-running.
+void MacroBenchmark(benchmark::internal::Benchmark* b) {
+  b->Iterations(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+}
+
+// Reports the number of allocations since "start_allocations".
+void ReportAllocations(benchmark::State& state, int64 start_allocations) {
+  state.counters["allocs"] =
+      num_allocations.load(std::memory_order_relaxed) - start_allocations;
+}
+
+// Builds an index of state.range(0) polygons.
+void BM_BuildIndex(benchmark::State& state) {
+  const vector<Polygon>& polygons = GetPolygons(state.range(0));
+  for (auto _ : state) {
+    const int64 start_allocations = num_allocations.load();
+    S2MemoryTracker tracker;
+    MutableS2ShapeIndex index;
+    index.set_memory_tracker(&tracker);
+    for (const Polygon& polygon : polygons) {
+      index.Add(make_unique<S2LaxPolygonShape>(polygon));
+    }
+    index.ForceBuild();
+    ReportAllocations(state, start_allocations);
+    state.counters["peak_bytes"] = tracker.max_usage_bytes();
+  }
+}
+BENCHMARK(BM_BuildIndex)->Arg(1000000)->Apply(MacroBenchmark);
+
+// Computes coverings of state.range(0) polygons.
+void BM_CoverRegions(benchmark::State& state) {
+  const vector<Polygon>& input = GetPolygons(state.range(0));
+  vector<unique_ptr<S2Polygon>> polygons;
+  for (const Polygon& polygon : input) {
+    vector<unique_ptr<S2Loop>> loops;
+    for (const auto& loop : polygon) {
+      loops.push_back(make_unique<S2Loop>(loop, S2Debug::DISABLE));
+    }
+    polygons.push_back(make_unique<S2Polygon>(std::move(loops),
+                                              S2Debug::DISABLE));
+  }
+  S2RegionCoverer::Options options;
+  options.set_max_cells(8);
+  S2RegionCoverer coverer(options);
+  for (auto _ : state) {
+    const int64 start_allocations = num_allocations.load();
+    int64 num_cells = 0;
+    for (const auto& polygon : polygons) {
+      num_cells += coverer.GetCovering(*polygon).num_cells();
+    }
+    ReportAllocations(state, start_allocations);
+    state.counters["num_cells"] = num_cells;
+  }
+}
+BENCHMARK(BM_CoverRegions)->Arg(100000)->Apply(MacroBenchmark);
+
+// Computes the union of state.range(0) polygons using S2WindingOperation.
+void BM_UnionPolygons(benchmark::State& state) {
+  const vector<Polygon>& polygons = GetPolygons(state.range(0));
+  // Compute the winding number of the reference point.  Each loop with an
+  // area of at most 2*Pi contributes +1 to the points it contains, and each
+  // larger loop (e.g. a hole) contributes -1 to the points it excludes.
+  const S2Point ref_p = S2::Origin();
+  int ref_winding = 0;
+  for (const Polygon& polygon : polygons) {
+    for (const auto& loop : polygon) {
+      ref_winding += s2shapeutil::ContainsBruteForce(S2LaxLoopShape(loop),
+                                                     ref_p) -
+                     !S2::IsNormalized(loop);
+    }
+  }
+  for (auto _ : state) {
+    const int64 start_allocations = num_allocations.load();
+    S2MemoryTracker tracker;
+    S2WindingOperation::Options options;
+    options.set_memory_tracker(&tracker);
+    S2Polygon result;
+    S2WindingOperation op(make_unique<S2PolygonLayer>(&result), options);
+    for (const Polygon& polygon : polygons) {
+      for (const auto& loop : polygon) op.AddLoop(loop);
+    }
+    S2Error error;
+    if (!op.Build(ref_p, ref_winding,
+                  S2WindingOperation::WindingRule::POSITIVE, &error)) {
+      state.SkipWithError(error.text().c_str());
+      return;
+    }
+    ReportAllocations(state, start_allocations);
+    state.counters["peak_bytes"] = tracker.max_usage_bytes();
+    state.counters["num_vertices"] = result.num_vertices();
+  }
+}
+BENCHMARK(BM_UnionPolygons)->Arg(100000)->Apply(MacroBenchmark);
+
+// Performs state.range(0) point-in-polygon lookups on an index of 100,000
+// polygons.
+void BM_PointInPolygon(benchmark::State& state) {
+  unique_ptr<MutableS2ShapeIndex> index = MakeIndex(100000);
+  S2Testing::rnd.Reset(1);
+  vector<S2Point> points;
+  const S2Cap cap = GetInputCap();
+  for (int i = 0; i < 1 << 20; ++i) {
+    points.push_back(S2Testing::SamplePoint(cap));
+  }
+  auto query = MakeS2ContainsPointQuery(index.get());
+  for (auto _ : state) {
+    const int64 start_allocations = num_allocations.load();
+    int64 num_contained = 0;
+    for (int64 i = 0; i < state.range(0); ++i) {
+      num_contained += query.Contains(points[i & ((1 << 20) - 1)]);
+    }
+    ReportAllocations(state, start_allocations);
+    state.counters["num_contained"] = num_contained;
+  }
+}
+BENCHMARK(BM_PointInPolygon)->Arg(10000000)->Apply(MacroBenchmark);
+
+// Encodes an index of state.range(0) polygons, then decodes it and all of
+// its shapes and cells.
+void BM_EncodeDecodeIndex(benchmark::State& state) {
+  unique_ptr<MutableS2ShapeIndex> index = MakeIndex(state.range(0));
+  for (auto _ : state) {
+    const int64 start_allocations = num_allocations.load();
+    Encoder encoder;
+    s2shapeutil::CompactEncodeTaggedShapes(*index, &encoder);
+    index->Encode(&encoder);
+
+    Decoder decoder(encoder.base(), encoder.length());
+    EncodedS2ShapeIndex decoded;
+    if (!decoded.Init(&decoder,
+                      s2shapeutil::LazyDecodeShapeFactory(&decoder))) {
+      state.SkipWithError("Could not decode index");
+      return;
+    }
+    int64 num_edges = 0;
+    for (int i = 0; i < decoded.num_shape_ids(); ++i) {
+      num_edges += decoded.shape(i)->num_edges();
+    }
+    int64 num_clipped = 0;
+    for (EncodedS2ShapeIndex::Iterator it(&decoded, S2ShapeIndex::BEGIN);
+         !it.done(); it.Next()) {
+      num_clipped += it.cell().num_clipped();
+    }
+    ReportAllocations(state, start_allocations);
+    state.counters["encoded_bytes"] = encoder.length();
+    benchmark::DoNotOptimize(num_edges + num_clipped);
+  }
+}
+BENCHMARK(BM_EncodeDecodeIndex)->Arg(1000000)->Apply(MacroBenchmark);
+
+}  // namespace
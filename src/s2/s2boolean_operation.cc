@@ -68,6 +68,8 @@
 #include <cmath>
 
 #include <algorithm>
+#include <atomic>
+#include <functional>
 #include <iostream>
 #include <limits>
 #include <memory>
@@ -79,29 +81,48 @@
 #include "absl/container/btree_map.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/inlined_vector.h"
+#include "absl/flags/flag.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 
+#include "s2/base/commandlineflags.h"
+#include "s2/base/executor.h"
 #include "s2/base/types.h"
 #include "s2/id_set_lexicon.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/r2.h"
 #include "s2/s1angle.h"
 #include "s2/s2builder.h"
 #include "s2/s2builder_graph.h"
 #include "s2/s2builder_layer.h"
+#include "s2/s2builderutil_lax_polygon_layer.h"
+#include "s2/s2builderutil_s2point_vector_layer.h"
+#include "s2/s2builderutil_s2polyline_vector_layer.h"
 #include "s2/s2builderutil_snap_functions.h"
+#include "s2/s2cap.h"
 #include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
 #include "s2/s2contains_point_query.h"
 #include "s2/s2crossing_edge_query.h"
+#include "s2/s2edge_clipping.h"
+#include "s2/s2edge_crosser.h"
 #include "s2/s2edge_crossings.h"
 #include "s2/s2error.h"
+#include "s2/s2hilbert_sort.h"
 #include "s2/s2measures.h"
 #include "s2/s2memory_tracker.h"
+#include "s2/s2phase_tracer.h"
 #include "s2/s2point.h"
+#include "s2/s2pointutil.h"
 #include "s2/s2predicates.h"
 #include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
 #include "s2/s2shape_index_measures.h"
+#include "s2/s2shape_index_region.h"
+#include "s2/s2shapeutil_contains_brute_force.h"
+#include "s2/s2shapeutil_count_edges.h"
 #include "s2/s2shapeutil_shape_edge.h"
 #include "s2/s2shapeutil_shape_edge_id.h"
 #include "s2/s2shapeutil_visit_crossing_edge_pairs.h"
@@ -110,9 +131,23 @@
 // TODO(ericv): Remove this debugging output at some point.
 extern bool s2builder_verbose;
 
+// FLAGS_s2boolean_operation_max_brute_force_edges
+//
+// If the two input regions have at most this many edges in total, then edge
+// crossings and point containment are computed by testing all the edges
+// directly rather than by querying the S2ShapeIndexes.  For small inputs this
+// is much faster, since building a MutableS2ShapeIndex takes longer than the
+// operation itself.  (In optimized builds, the indexes are not built at all
+// unless the client uses them for some other purpose.)
+S2_DEFINE_int32(
+    s2boolean_operation_max_brute_force_edges, 100,
+    "S2BooleanOperation inputs with at most this many edges in total are "
+    "processed by brute force rather than by querying their S2ShapeIndexes.");
+
 namespace {  // Anonymous namespace for helper classes.
 
 using absl::flat_hash_map;
+using absl::Span;
 using absl::string_view;
 using std::lower_bound;
 using std::make_pair;
@@ -141,6 +176,66 @@ using PolygonModel = S2BooleanOperation::PolygonModel;
 using PolylineModel = S2BooleanOperation::PolylineModel;
 using Precision = S2BooleanOperation::Precision;
 
+// Calls "fn(i)" for each i in [0, n) using up to "num_threads" threads.  The
+// work items are handed out in order, and the calling thread also runs them.
+// Additional threads are run on "executor" if it is non-null.
+template <class Fn>
+static void ParallelFor(int n, int num_threads, s2base::Executor* executor,
+                        const Fn& fn) {
+  std::atomic<int> next(0);
+  s2base::RunConcurrently(executor, min(num_threads, n), [&]() {
+    for (int i; (i = next.fetch_add(1)) < n; ) fn(i);
+  });
+}
+
+// Like s2shapeutil::VisitCrossingEdgePairs(a_index, b_index, ALL, visitor),
+// except that every edge of A is tested against every edge of B.  This
+// avoids building the S2ShapeIndex of either region.  Each crossing edge
+// pair is visited exactly once, although not in the same order.
+static bool VisitCrossingEdgePairsBruteForce(
+    const S2ShapeIndex& a_index, const S2ShapeIndex& b_index,
+    const s2shapeutil::EdgePairVisitor& visitor) {
+  for (int a_shape_id = 0; a_shape_id < a_index.num_shape_ids();
+       ++a_shape_id) {
+    const S2Shape* a_shape = a_index.shape(a_shape_id);
+    if (a_shape == nullptr) continue;
+    for (int i = 0; i < a_shape->num_edges(); ++i) {
+      s2shapeutil::ShapeEdge a(a_shape_id, i, a_shape->edge(i));
+      S2EdgeCrosser crosser(&a.v0(), &a.v1());
+      for (int b_shape_id = 0; b_shape_id < b_index.num_shape_ids();
+           ++b_shape_id) {
+        const S2Shape* b_shape = b_index.shape(b_shape_id);
+        if (b_shape == nullptr) continue;
+        for (int j = 0; j < b_shape->num_edges(); ++j) {
+          s2shapeutil::ShapeEdge b(b_shape_id, j, b_shape->edge(j));
+          int sign = crosser.CrossingSign(&b.v0(), &b.v1());
+          if (sign >= 0 && !visitor(a, b, sign == 1)) return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// Like S2ContainsPointQuery::VisitIncidentEdges(), except that all edges of
+// "index" are tested directly.
+static bool VisitIncidentEdgesBruteForce(
+    const S2ShapeIndex& index, const S2Point& p,
+    const S2ContainsPointQuery<S2ShapeIndex>::EdgeVisitor& visitor) {
+  for (int shape_id = 0; shape_id < index.num_shape_ids(); ++shape_id) {
+    const S2Shape* shape = index.shape(shape_id);
+    if (shape == nullptr) continue;
+    for (int e = 0; e < shape->num_edges(); ++e) {
+      S2Shape::Edge edge = shape->edge(e);
+      if ((edge.v0 == p || edge.v1 == p) &&
+          !visitor(s2shapeutil::ShapeEdge(shape_id, e, edge))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
 // A collection of special InputEdgeIds that allow the GraphEdgeClipper state
 // modifications to be inserted into the list of edge crossings.
 static const InputEdgeId kSetInside = -1;
@@ -950,6 +1045,16 @@ class S2BooleanOperation::Impl {
 
   bool is_boolean_output() const { return op_->result_empty_ != nullptr; }
 
+  // Returns the number of threads to use.  Boolean predicates always use a
+  // single thread since they usually terminate early.
+  int num_threads() const {
+    if (is_boolean_output() || use_brute_force_) return 1;
+    return max(1, op_->options_.num_threads());
+  }
+
+  // Returns the executor used to run additional threads (if any).
+  s2base::Executor* executor() const { return op_->options_.executor(); }
+
   // All of the methods below support "early exit" in the case of boolean
   // results by returning "false" as soon as the result is known to be
   // non-empty.
@@ -960,18 +1065,31 @@ class S2BooleanOperation::Impl {
   bool GetChainStarts(int a_region_id, bool invert_a, bool invert_b,
                       bool invert_result, CrossingProcessor* cp,
                       vector<ShapeEdgeId>* chain_starts);
-  bool ProcessIncidentEdges(const ShapeEdge& a,
+  bool GetPreparedChainStarts(bool invert_a, bool invert_result,
+                              vector<ShapeEdgeId>* chain_starts);
+  bool GetChainStartsInParallel(int a_region_id, bool invert_a, bool invert_b,
+                                bool invert_result,
+                                vector<ShapeEdgeId>* chain_starts);
+  bool ProcessIncidentEdges(const ShapeEdge& a, const S2ShapeIndex& b_index,
                             S2ContainsPointQuery<S2ShapeIndex>* query,
                             CrossingProcessor* cp);
+  bool Contains(const S2ShapeIndex& index,
+                S2ContainsPointQuery<S2ShapeIndex>* query,
+                const S2Point& p) const;
   static bool HasInterior(const S2ShapeIndex& index);
+  static IndexCrossing MakeIndexCrossing(const ShapeEdge& a,
+                                         const ShapeEdge& b, bool is_interior);
+  S2Point GetIntersection(const ShapeEdge& a, const ShapeEdge& b) const;
   bool AddIndexCrossing(const ShapeEdge& a, const ShapeEdge& b,
                         bool is_interior, IndexCrossings* crossings);
+  bool AddIndexCrossingsInParallel();
   bool InitIndexCrossings(int region_id);
   bool AddBoundaryPair(bool invert_a, bool invert_b, bool invert_result,
                        CrossingProcessor* cp);
   bool AreRegionsIdentical() const;
   bool BuildOpType(OpType op_type);
   bool IsFullPolygonResult(const S2Builder::Graph& g, S2Error* error) const;
+  uint8 GetFaceMask(const S2ShapeIndex& index) const;
   bool IsFullPolygonUnion(const S2ShapeIndex& a,
                           const S2ShapeIndex& b) const;
   bool IsFullPolygonIntersection(const S2ShapeIndex& a,
@@ -1021,6 +1139,11 @@ class S2BooleanOperation::Impl {
 
   // An object to track the memory usage of this class.
   MemoryTracker tracker_;
+
+  // Indicates that the input regions are small enough that crossings and
+  // point containment should be computed without querying their indexes
+  // (see FLAGS_s2boolean_operation_max_brute_force_edges).
+  bool use_brute_force_ = false;
 };
 
 const s2shapeutil::ShapeEdgeId S2BooleanOperation::Impl::kSentinel(
@@ -2113,6 +2236,15 @@ bool S2BooleanOperation::Impl::GetChainStarts(
     CrossingProcessor* cp, vector<ShapeEdgeId>* chain_starts) {
   const S2ShapeIndex& a_index = *op_->regions_[a_region_id];
   const S2ShapeIndex& b_index = *op_->regions_[1 - a_region_id];
+  const PreparedOperand* prepared = op_->prepared_b_;
+
+  // If region A was prepared and region B is not inverted, then only the
+  // chains of A that start within the index cells of region B can be
+  // contained, and these can be found directly.
+  if (a_region_id == 1 && prepared != nullptr && !invert_b &&
+      !is_boolean_output()) {
+    return GetPreparedChainStarts(invert_a, invert_result, chain_starts);
+  }
 
   if (is_boolean_output()) {
     // If boolean output is requested, then we use the CrossingProcessor to
@@ -2127,9 +2259,16 @@ bool S2BooleanOperation::Impl::GetChainStarts(
   // requested then we check for containment anyway, since as a side effect we
   // may discover that the result region is non-empty and terminate the entire
   // operation early.
-  bool b_has_interior = HasInterior(b_index);
+  bool b_has_interior = (a_region_id == 0 && prepared != nullptr)
+                            ? prepared->has_interior_
+                            : HasInterior(b_index);
+  if (b_has_interior && num_threads() > 1) {
+    return GetChainStartsInParallel(a_region_id, invert_a, invert_b,
+                                    invert_result, chain_starts);
+  }
   if (b_has_interior || invert_b || is_boolean_output()) {
-    auto query = MakeS2ContainsPointQuery(&b_index);
+    S2ContainsPointQuery<S2ShapeIndex> query;
+    if (!use_brute_force_) query.Init(&b_index);
     int num_shape_ids = a_index.num_shape_ids();
     for (int shape_id = 0; shape_id < num_shape_ids; ++shape_id) {
       const S2Shape* a_shape = a_index.shape(shape_id);
@@ -2146,30 +2285,142 @@ bool S2BooleanOperation::Impl::GetChainStarts(
         S2Shape::Chain chain = a_shape->chain(chain_id);
         if (chain.length == 0) continue;
         ShapeEdge a(shape_id, chain.start, a_shape->chain_edge(chain_id, 0));
-        bool inside = (b_has_interior && query.Contains(a.v0())) != invert_b;
+        bool inside =
+            (b_has_interior && Contains(b_index, &query, a.v0())) != invert_b;
         if (inside) {
           if (!tracker_.AddSpace(chain_starts, 1)) return false;
           chain_starts->push_back(ShapeEdgeId(shape_id, chain.start));
         }
         if (is_boolean_output()) {
           cp->StartChain(chain_id, chain, inside);
-          if (!ProcessIncidentEdges(a, &query, cp)) return false;
+          if (!ProcessIncidentEdges(a, b_index, &query, cp)) return false;
+        }
+      }
+    }
+  }
+  if (!tracker_.AddSpace(chain_starts, 1)) return false;
+  chain_starts->push_back(kSentinel);
+  return true;
+}
+
+// Like GetChainStarts(1, invert_a, false, invert_result, ...) when region 1
+// was prepared and boolean output was not requested.  A point is contained
+// by region 0 only if it belongs to one of the cells of its S2ShapeIndex, so
+// only the chain starts of region 1 within those cells need to be tested.
+bool S2BooleanOperation::Impl::GetPreparedChainStarts(
+    bool invert_a, bool invert_result, vector<ShapeEdgeId>* chain_starts) {
+  const PreparedOperand& prepared = *op_->prepared_b_;
+  const S2ShapeIndex& a_index = prepared.index();
+  const S2ShapeIndex& b_index = *op_->regions_[0];
+  if (HasInterior(b_index)) {
+    auto query = MakeS2ContainsPointQuery(&b_index);
+    const auto& starts = prepared.chain_starts_;
+    auto less = [](const PreparedOperand::ChainStart& x, S2CellId y) {
+      return x.id < y;
+    };
+    for (S2ShapeIndex::Iterator it(&b_index, S2ShapeIndex::BEGIN);
+         !it.done(); it.Next()) {
+      S2CellId range_max = it.id().range_max();
+      for (auto start = std::lower_bound(starts.begin(), starts.end(),
+                                         it.id().range_min(), less);
+           start != starts.end() && start->id <= range_max; ++start) {
+        // Points and polylines in region A can be ignored when region A is
+        // being subtracted (see GetChainStarts).
+        if (invert_a != invert_result &&
+            a_index.shape(start->edge_id.shape_id)->dimension() < 2) {
+          continue;
+        }
+        if (query.Contains(start->vertex)) {
+          if (!tracker_.AddSpace(chain_starts, 1)) return false;
+          chain_starts->push_back(start->edge_id);
         }
       }
     }
+    // The chain starts must be in the same order as the edges of region A.
+    std::sort(chain_starts->begin(), chain_starts->end());
   }
   if (!tracker_.AddSpace(chain_starts, 1)) return false;
   chain_starts->push_back(kSentinel);
   return true;
 }
 
+// Like GetChainStarts() when region B has an interior and boolean output was
+// not requested, except that the chain starts are tested for containment
+// using up to num_threads() threads.  The chain starts are returned in the
+// same order.
+bool S2BooleanOperation::Impl::GetChainStartsInParallel(
+    int a_region_id, bool invert_a, bool invert_b, bool invert_result,
+    vector<ShapeEdgeId>* chain_starts) {
+  const S2ShapeIndex& a_index = *op_->regions_[a_region_id];
+  const S2ShapeIndex& b_index = *op_->regions_[1 - a_region_id];
+  vector<pair<ShapeEdgeId, S2Point>> starts;
+  int num_shape_ids = a_index.num_shape_ids();
+  for (int shape_id = 0; shape_id < num_shape_ids; ++shape_id) {
+    const S2Shape* a_shape = a_index.shape(shape_id);
+    if (a_shape == nullptr) continue;
+    if (invert_a != invert_result && a_shape->dimension() < 2) continue;
+    int num_chains = a_shape->num_chains();
+    for (int chain_id = 0; chain_id < num_chains; ++chain_id) {
+      S2Shape::Chain chain = a_shape->chain(chain_id);
+      if (chain.length == 0) continue;
+      starts.emplace_back(ShapeEdgeId(shape_id, chain.start),
+                          a_shape->chain_edge(chain_id, 0).v0);
+    }
+  }
+  // Each work item tests a contiguous block of chain starts using its own
+  // S2ContainsPointQuery.
+  constexpr int kChainsPerItem = 256;
+  const int n = starts.size();
+  vector<char> inside(n);
+  const int num_items = (n + kChainsPerItem - 1) / kChainsPerItem;
+  ParallelFor(num_items, num_threads(), executor(),
+              [&](int item) {
+                auto query = MakeS2ContainsPointQuery(&b_index);
+                int end = min(n, (item + 1) * kChainsPerItem);
+                for (int i = item * kChainsPerItem; i < end; ++i) {
+                  inside[i] = query.Contains(starts[i].second) != invert_b;
+                }
+              });
+  for (int i = 0; i < n; ++i) {
+    if (!inside[i]) continue;
+    if (!tracker_.AddSpace(chain_starts, 1)) return false;
+    chain_starts->push_back(starts[i].first);
+  }
+  if (!tracker_.AddSpace(chain_starts, 1)) return false;
+  chain_starts->push_back(kSentinel);
+  return true;
+}
+
+// Returns true if "p" is contained by a polygon of "index".  "query" must be
+// initialized to query "index" unless use_brute_force_ is true.
+bool S2BooleanOperation::Impl::Contains(
+    const S2ShapeIndex& index, S2ContainsPointQuery<S2ShapeIndex>* query,
+    const S2Point& p) const {
+  if (!use_brute_force_) return query->Contains(p);
+
+  // Points and polylines do not contain anything (see S2VertexModel).
+  for (int s = 0; s < index.num_shape_ids(); ++s) {
+    const S2Shape* shape = index.shape(s);
+    if (shape && shape->dimension() == 2 &&
+        s2shapeutil::ContainsBruteForce(*shape, p)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 bool S2BooleanOperation::Impl::ProcessIncidentEdges(
-    const ShapeEdge& a, S2ContainsPointQuery<S2ShapeIndex>* query,
-    CrossingProcessor* cp) {
+    const ShapeEdge& a, const S2ShapeIndex& b_index,
+    S2ContainsPointQuery<S2ShapeIndex>* query, CrossingProcessor* cp) {
   tmp_crossings_.clear();
-  query->VisitIncidentEdges(a.v0(), [&a, this](const ShapeEdge& b) {
-      return AddIndexCrossing(a, b, false /*is_interior*/, &tmp_crossings_);
-    });
+  auto add_crossing = [&a, this](const ShapeEdge& b) {
+    return AddIndexCrossing(a, b, false /*is_interior*/, &tmp_crossings_);
+  };
+  if (use_brute_force_) {
+    VisitIncidentEdgesBruteForce(b_index, a.v0(), add_crossing);
+  } else {
+    query->VisitIncidentEdges(a.v0(), add_crossing);
+  }
   // Fast path for the common case where there are no incident edges.  We
   // return false (terminating early) if the first chain edge will be emitted.
   if (tmp_crossings_.empty()) {
@@ -2185,7 +2436,7 @@ bool S2BooleanOperation::Impl::ProcessIncidentEdges(
         tmp_crossings_.end());
   }
   tmp_crossings_.push_back(IndexCrossing(kSentinel, kSentinel));
-  CrossingIterator next_crossing(&query->index(), &tmp_crossings_,
+  CrossingIterator next_crossing(&b_index, &tmp_crossings_,
                                  false /*crossings_complete*/);
   return cp->ProcessEdge(a.id(),  &next_crossing);
 }
@@ -2198,30 +2449,85 @@ bool S2BooleanOperation::Impl::HasInterior(const S2ShapeIndex& index) {
   return false;
 }
 
-inline bool S2BooleanOperation::Impl::AddIndexCrossing(
-    const ShapeEdge& a, const ShapeEdge& b, bool is_interior,
-    IndexCrossings* crossings) {
-  if (!tracker_.AddSpace(crossings, 1)) return false;
-  crossings->push_back(IndexCrossing(a.id(), b.id()));
-  IndexCrossing* crossing = &crossings->back();
+// Returns the IndexCrossing for the given pair of crossing edges.  Note that
+// the intersection point of an interior crossing must be added to the
+// S2Builder separately.
+inline S2BooleanOperation::Impl::IndexCrossing
+S2BooleanOperation::Impl::MakeIndexCrossing(
+    const ShapeEdge& a, const ShapeEdge& b, bool is_interior) {
+  IndexCrossing crossing(a.id(), b.id());
   if (is_interior) {
-    crossing->is_interior_crossing = true;
+    crossing.is_interior_crossing = true;
     if (s2pred::Sign(a.v0(), a.v1(), b.v0()) > 0) {
-      crossing->left_to_right = true;
+      crossing.left_to_right = true;
     }
-    builder_->AddIntersection(
-        S2::GetIntersection(a.v0(), a.v1(), b.v0(), b.v1()));
   } else {
     // TODO(ericv): This field isn't used unless one shape is a polygon and
     // the other is a polyline or polygon, but we don't have the shape
     // dimension information readily available here.
     if (S2::VertexCrossing(a.v0(), a.v1(), b.v0(), b.v1())) {
-      crossing->is_vertex_crossing = true;
+      crossing.is_vertex_crossing = true;
     }
   }
+  return crossing;
+}
+
+// Returns the intersection point of two crossing edges, using the
+// edge_crossing_cache() if there is one.
+inline S2Point S2BooleanOperation::Impl::GetIntersection(
+    const ShapeEdge& a, const ShapeEdge& b) const {
+  S2EdgeCrossingCache* cache = op_->options_.edge_crossing_cache();
+  if (cache != nullptr) {
+    return cache->GetIntersection(a.v0(), a.v1(), b.v0(), b.v1());
+  }
+  return S2::GetIntersection(a.v0(), a.v1(), b.v0(), b.v1());
+}
+
+inline bool S2BooleanOperation::Impl::AddIndexCrossing(
+    const ShapeEdge& a, const ShapeEdge& b, bool is_interior,
+    IndexCrossings* crossings) {
+  if (!tracker_.AddSpace(crossings, 1)) return false;
+  crossings->push_back(MakeIndexCrossing(a, b, is_interior));
+  if (is_interior) builder_->AddIntersection(GetIntersection(a, b));
   return true;  // Continue visiting.
 }
 
+// Like calling AddIndexCrossing() for every crossing edge pair of the two
+// regions, except that the six cube faces are processed concurrently.  The
+// results are merged in face order, so that the crossings and intersection
+// points are added in exactly the same order as by a sequential visit.
+// Only used when is_boolean_output() is false.
+bool S2BooleanOperation::Impl::AddIndexCrossingsInParallel() {
+  struct FaceCrossings {
+    IndexCrossings crossings;
+    vector<S2Point> intersections;
+  };
+  FaceCrossings faces[6];
+  ParallelFor(6, num_threads(), executor(), [this, &faces](int face) {
+    FaceCrossings* out = &faces[face];
+    s2shapeutil::VisitCrossingEdgePairs(
+        *op_->regions_[0], *op_->regions_[1],
+        s2shapeutil::CrossingType::ALL, S2CellId::FromFace(face),
+        [this, out](const ShapeEdge& a, const ShapeEdge& b,
+                    bool is_interior) {
+          out->crossings.push_back(MakeIndexCrossing(a, b, is_interior));
+          if (is_interior) {
+            out->intersections.push_back(GetIntersection(a, b));
+          }
+          return true;
+        });
+  });
+  for (const FaceCrossings& face : faces) {
+    if (!tracker_.AddSpace(&index_crossings_, face.crossings.size())) {
+      return false;
+    }
+    index_crossings_.insert(index_crossings_.end(), face.crossings.begin(),
+                            face.crossings.end());
+    for (const S2Point& p : face.intersections) builder_->AddIntersection(p);
+  }
+  return true;
+}
+
 // Initialize index_crossings_ to the set of crossing edge pairs such that the
 // first element of each pair is an edge from "region_id".
 //
@@ -2231,19 +2537,28 @@ bool S2BooleanOperation::Impl::InitIndexCrossings(int region_id) {
   if (region_id == index_crossings_first_region_id_) return true;
   if (index_crossings_first_region_id_ < 0) {
     ABSL_DCHECK_EQ(region_id, 0);  // For efficiency, not correctness.
+    S2PhaseTracer::Scope scope(op_->options_.tracer(),
+                               "S2BooleanOperation::FindCrossings",
+                               op_->options_.memory_tracker());
     // TODO(ericv): This would be more efficient if VisitCrossingEdgePairs()
     // returned the sign (+1 or -1) of the interior crossing, i.e.
     // "int interior_crossing_sign" rather than "bool is_interior".
-    if (!s2shapeutil::VisitCrossingEdgePairs(
-            *op_->regions_[0], *op_->regions_[1],
-            s2shapeutil::CrossingType::ALL,
-            [this](const ShapeEdge& a, const ShapeEdge& b, bool is_interior) {
-              // For all supported operations (union, intersection, and
-              // difference), if the input edges have an interior crossing
-              // then the output is guaranteed to have at least one edge.
-              if (is_interior && is_boolean_output()) return false;
-              return AddIndexCrossing(a, b, is_interior, &index_crossings_);
-            })) {
+    auto visitor = [this](const ShapeEdge& a, const ShapeEdge& b,
+                          bool is_interior) {
+      // For all supported operations (union, intersection, and difference),
+      // if the input edges have an interior crossing then the output is
+      // guaranteed to have at least one edge.
+      if (is_interior && is_boolean_output()) return false;
+      return AddIndexCrossing(a, b, is_interior, &index_crossings_);
+    };
+    const S2ShapeIndex& a = *op_->regions_[0];
+    const S2ShapeIndex& b = *op_->regions_[1];
+    if (use_brute_force_) {
+      if (!VisitCrossingEdgePairsBruteForce(a, b, visitor)) return false;
+    } else if (num_threads() > 1) {
+      if (!AddIndexCrossingsInParallel()) return false;
+    } else if (!s2shapeutil::VisitCrossingEdgePairs(
+                   a, b, s2shapeutil::CrossingType::ALL, visitor)) {
       return false;
     }
     if (index_crossings_.size() > 1) {
@@ -2252,6 +2567,7 @@ bool S2BooleanOperation::Impl::InitIndexCrossings(int region_id) {
           std::unique(index_crossings_.begin(), index_crossings_.end()),
           index_crossings_.end());
     }
+    scope.set_num_items(index_crossings_.size());
     // Add a sentinel value to simplify the loop logic.
     tracker_.AddSpace(&index_crossings_, 1);
     index_crossings_.push_back(IndexCrossing(kSentinel, kSentinel));
@@ -2290,13 +2606,29 @@ bool S2BooleanOperation::Impl::AddBoundaryPair(
       tracker_.Untally(a_starts);
       tracker_.Untally(b_starts);
     });
-  if (!GetChainStarts(0, invert_a, invert_b, invert_result, cp, &a_starts) ||
-      !GetChainStarts(1, invert_b, invert_a, invert_result, cp, &b_starts) ||
-      !AddBoundary(0, invert_a, invert_b, invert_result, a_starts, cp) ||
-      !AddBoundary(1, invert_b, invert_a, invert_result, b_starts, cp)) {
-    return false;
+  S2PhaseTracer* tracer = op_->options_.tracer();
+  const S2MemoryTracker* memory_tracker = op_->options_.memory_tracker();
+  {
+    S2PhaseTracer::Scope scope(tracer, "S2BooleanOperation::GetChainStarts",
+                               memory_tracker);
+    if (!GetChainStarts(0, invert_a, invert_b, invert_result, cp,
+                        &a_starts) ||
+        !GetChainStarts(1, invert_b, invert_a, invert_result, cp,
+                        &b_starts)) {
+      return false;
+    }
+    scope.set_num_items(a_starts.size() + b_starts.size());
+  }
+  {
+    S2PhaseTracer::Scope scope(tracer, "S2BooleanOperation::AddBoundaries",
+                               memory_tracker);
+    if (!AddBoundary(0, invert_a, invert_b, invert_result, a_starts, cp) ||
+        !AddBoundary(1, invert_b, invert_a, invert_result, b_starts, cp)) {
+      return false;
+    }
+    if (!is_boolean_output()) cp->DoneBoundaryPair();
+    scope.set_num_items(input_crossings_.size());
   }
-  if (!is_boolean_output()) cp->DoneBoundaryPair();
   return tracker_.ok();
 }
 
@@ -2336,6 +2668,44 @@ bool S2BooleanOperation::Impl::BuildOpType(OpType op_type) {
   return false;
 }
 
+// Like GetFaceMask(), but computed directly from the shapes of "index" so
+// that the index does not need to be built.  A face intersects the index
+// contents if some edge intersects the face (padded in the same way as
+// MutableS2ShapeIndex), or if the face has no edges and is contained by some
+// polygon (in which case the entire face is contained).
+static uint8 GetFaceMaskBruteForce(const S2ShapeIndex& index) {
+  uint8 mask = 0;
+  for (int s = 0; s < index.num_shape_ids(); ++s) {
+    const S2Shape* shape = index.shape(s);
+    if (shape == nullptr) continue;
+    for (int e = 0; e < shape->num_edges(); ++e) {
+      S2Shape::Edge edge = shape->edge(e);
+      for (int face = 0; face < 6; ++face) {
+        R2Point a_uv, b_uv;
+        if (!(mask & (1 << face)) &&
+            S2::ClipToPaddedFace(edge.v0, edge.v1, face,
+                                 MutableS2ShapeIndex::kCellPadding, &a_uv,
+                                 &b_uv)) {
+          mask |= 1 << face;
+        }
+      }
+    }
+  }
+  for (int face = 0; face < 6; ++face) {
+    if (mask & (1 << face)) continue;
+    S2Point center = S2CellId::FromFace(face).ToPoint();
+    for (int s = 0; s < index.num_shape_ids(); ++s) {
+      const S2Shape* shape = index.shape(s);
+      if (shape && shape->dimension() == 2 &&
+          s2shapeutil::ContainsBruteForce(*shape, center)) {
+        mask |= 1 << face;
+        break;
+      }
+    }
+  }
+  return mask;
+}
+
 // Returns a bit mask indicating which of the 6 S2 cube faces intersect the
 // index contents.
 uint8 GetFaceMask(const S2ShapeIndex& index) {
@@ -2353,6 +2723,11 @@ uint8 GetFaceMask(const S2ShapeIndex& index) {
 // pairs, the purpose of this function is to decide whether the polygon is empty
 // or full except for the degeneracies, i.e. whether the degeneracies represent
 // shells or holes.
+uint8 S2BooleanOperation::Impl::GetFaceMask(const S2ShapeIndex& index) const {
+  return use_brute_force_ ? GetFaceMaskBruteForce(index)
+                          : ::GetFaceMask(index);
+}
+
 bool S2BooleanOperation::Impl::IsFullPolygonResult(
     const S2Builder::Graph& g, S2Error* error) const {
   // If there are no edges of dimension 2, the result could be either the
@@ -2586,6 +2961,17 @@ bool S2BooleanOperation::Impl::AreRegionsIdentical() const {
 
 void S2BooleanOperation::Impl::DoBuild(S2Error* error) {
   if (!tracker_.ok()) return;
+  if (op_->prepared_b_ == nullptr) {
+    const int max_edges =
+        absl::GetFlag(FLAGS_s2boolean_operation_max_brute_force_edges);
+    int num_edges = s2shapeutil::CountEdgesUpTo(*op_->regions_[0],
+                                                 max_edges + 1);
+    if (num_edges <= max_edges) {
+      num_edges += s2shapeutil::CountEdgesUpTo(*op_->regions_[1],
+                                               max_edges - num_edges + 1);
+    }
+    use_brute_force_ = (num_edges <= max_edges);
+  }
   builder_options_ = S2Builder::Options(op_->options_.snap_function());
   builder_options_.set_intersection_tolerance(S2::kIntersectionError);
   builder_options_.set_memory_tracker(tracker_.tracker());
@@ -2595,6 +2981,11 @@ void S2BooleanOperation::Impl::DoBuild(S2Error* error) {
   // TODO(ericv): Ideally idempotent() should be true, but existing clients
   // expect vertices closer than the full "snap_radius" to be snapped.
   builder_options_.set_idempotent(false);
+  builder_options_.set_num_threads(num_threads());
+  builder_options_.set_executor(executor());
+  builder_options_.set_edge_crossing_cache(
+      op_->options_.edge_crossing_cache());
+  builder_options_.set_tracer(op_->options_.tracer());
 
   if (is_boolean_output()) {
     // BuildOpType() returns true if and only if the result has no edges.
@@ -2623,6 +3014,9 @@ void S2BooleanOperation::Impl::DoBuild(S2Error* error) {
 bool S2BooleanOperation::Impl::Build(S2Error* error) {
   // This wrapper ensures that memory tracking errors are reported.
   error->Clear();
+  S2PhaseTracer::Scope scope(op_->options_.tracer(),
+                             "S2BooleanOperation::Build",
+                             op_->options_.memory_tracker());
   DoBuild(error);
   if (!tracker_.ok()) *error = tracker_.error();
   return error->ok();
@@ -2647,7 +3041,11 @@ S2BooleanOperation::Options::Options(const Options& options)
       precision_(options.precision_),
       conservative_output_(options.conservative_output_),
       source_id_lexicon_(options.source_id_lexicon_),
-      memory_tracker_(options.memory_tracker_) {
+      memory_tracker_(options.memory_tracker_),
+      num_threads_(options.num_threads_),
+      executor_(options.executor_),
+      edge_crossing_cache_(options.edge_crossing_cache_),
+      tracer_(options.tracer_) {
 }
 
 S2BooleanOperation::Options& S2BooleanOperation::Options::operator=(
@@ -2662,6 +3060,10 @@ S2BooleanOperation::Options& S2BooleanOperation::Options::operator=(
   conservative_output_ = options.conservative_output_;
   source_id_lexicon_ = options.source_id_lexicon_;
   memory_tracker_ = options.memory_tracker_;
+  num_threads_ = options.num_threads_;
+  executor_ = options.executor_;
+  edge_crossing_cache_ = options.edge_crossing_cache_;
+  tracer_ = options.tracer_;
   return *this;
 }
 
@@ -2729,6 +3131,40 @@ void S2BooleanOperation::Options::set_memory_tracker(S2MemoryTracker* tracker) {
   memory_tracker_ = tracker;
 }
 
+int S2BooleanOperation::Options::num_threads() const {
+  return num_threads_;
+}
+
+void S2BooleanOperation::Options::set_num_threads(int num_threads) {
+  num_threads_ = num_threads;
+}
+
+s2base::Executor* S2BooleanOperation::Options::executor() const {
+  return executor_;
+}
+
+void S2BooleanOperation::Options::set_executor(s2base::Executor* executor) {
+  executor_ = executor;
+}
+
+S2EdgeCrossingCache* S2BooleanOperation::Options::edge_crossing_cache()
+    const {
+  return edge_crossing_cache_;
+}
+
+void S2BooleanOperation::Options::set_edge_crossing_cache(
+    S2EdgeCrossingCache* cache) {
+  edge_crossing_cache_ = cache;
+}
+
+S2PhaseTracer* S2BooleanOperation::Options::tracer() const {
+  return tracer_;
+}
+
+void S2BooleanOperation::Options::set_tracer(S2PhaseTracer* tracer) {
+  tracer_ = tracer;
+}
+
 string_view S2BooleanOperation::OpTypeToString(OpType op_type) {
   switch (op_type) {
     case OpType::UNION:                return "UNION";
@@ -2785,9 +3221,125 @@ bool S2BooleanOperation::Build(const S2ShapeIndex& a,
                                S2Error* error) {
   regions_[0] = &a;
   regions_[1] = &b;
+  prepared_b_ = nullptr;
   return Impl(this).Build(error);
 }
 
+bool S2BooleanOperation::Build(const S2ShapeIndex& a,
+                               const PreparedOperand& b,
+                               S2Error* error) {
+  regions_[0] = &a;
+  regions_[1] = &b.index();
+  prepared_b_ = &b;
+  bool result = Impl(this).Build(error);
+  prepared_b_ = nullptr;
+  return result;
+}
+
+bool S2BooleanOperation::BuildAll(
+    OpType op_type, Span<const S2ShapeIndex* const> a,
+    const PreparedOperand& b,
+    const std::function<vector<unique_ptr<S2Builder::Layer>>(int)>&
+        make_layers,
+    vector<S2Error>* errors, const Options& options, int num_threads) {
+  ABSL_DCHECK(num_threads <= 1 || options.memory_tracker() == nullptr);
+  const int n = a.size();
+  errors->assign(n, S2Error());
+  ParallelFor(n, num_threads, options.executor(), [&](int i) {
+    S2BooleanOperation op(op_type, make_layers(i), options);
+    op.Build(*a[i], b, &(*errors)[i]);
+  });
+  for (const S2Error& error : *errors) {
+    if (!error.ok()) return false;
+  }
+  return true;
+}
+
+bool S2BooleanOperation::UnionAll(
+    Span<const S2ShapeIndex* const> regions,
+    vector<unique_ptr<S2Builder::Layer>> layers, S2Error* error,
+    const Options& options, int num_threads) {
+  ABSL_DCHECK(num_threads <= 1 || options.memory_tracker() == nullptr);
+  // A region at some level of the reduction tree, which owns its index if
+  // it is an intermediate result.
+  struct Region {
+    const S2ShapeIndex* index;
+    unique_ptr<MutableS2ShapeIndex> owned;
+  };
+  // Sort the regions along the Hilbert curve so that each union involves
+  // regions that are close together.
+  vector<S2Point> centroids;
+  centroids.reserve(regions.size());
+  for (const S2ShapeIndex* region : regions) {
+    S2Point centroid = S2::GetCentroid(*region);
+    centroids.push_back(centroid == S2Point() ? S2::Origin() : centroid);
+  }
+  vector<Region> level;
+  for (int i : S2::GetHilbertOrder(centroids, num_threads)) {
+    level.push_back(Region{regions[i], nullptr});
+  }
+  // Union adjacent pairs of regions until at most two are left.  If a level
+  // has an odd number of regions then the last one is passed up unchanged.
+  while (level.size() > 2) {
+    const int num_pairs = level.size() / 2;
+    vector<Region> next(num_pairs);
+    vector<S2Error> errors(num_pairs);
+    ParallelFor(num_pairs, num_threads, options.executor(), [&](int i) {
+      auto output = make_unique<MutableS2ShapeIndex>();
+      vector<unique_ptr<S2Builder::Layer>> output_layers(3);
+      output_layers[0] =
+          make_unique<s2builderutil::IndexedS2PointVectorLayer>(output.get());
+      output_layers[1] =
+          make_unique<s2builderutil::IndexedS2PolylineVectorLayer>(
+              output.get());
+      output_layers[2] =
+          make_unique<s2builderutil::IndexedLaxPolygonLayer>(output.get());
+      S2BooleanOperation op(OpType::UNION, std::move(output_layers), options);
+      op.Build(*level[2 * i].index, *level[2 * i + 1].index, &errors[i]);
+      // Build the index now so that the next level does not need to wait
+      // for it.
+      output->ForceBuild();
+      next[i].index = output.get();
+      next[i].owned = std::move(output);
+    });
+    for (const S2Error& pair_error : errors) {
+      if (!pair_error.ok()) {
+        *error = pair_error;
+        return false;
+      }
+    }
+    if (level.size() % 2 != 0) next.push_back(std::move(level.back()));
+    level.swap(next);
+  }
+  MutableS2ShapeIndex empty;
+  S2BooleanOperation op(OpType::UNION, std::move(layers), options);
+  return op.Build(level.size() > 0 ? *level[0].index : empty,
+                  level.size() > 1 ? *level[1].index : empty, error);
+}
+
+S2BooleanOperation::PreparedOperand::PreparedOperand(
+    const S2ShapeIndex* index)
+    : index_(index), has_interior_(false) {
+  for (int s = 0; s < index->num_shape_ids(); ++s) {
+    const S2Shape* shape = index->shape(s);
+    if (shape == nullptr) continue;
+    if (shape->dimension() == 2) has_interior_ = true;
+    int num_chains = shape->num_chains();
+    for (int chain_id = 0; chain_id < num_chains; ++chain_id) {
+      S2Shape::Chain chain = shape->chain(chain_id);
+      if (chain.length == 0) continue;
+      S2Point vertex = shape->chain_edge(chain_id, 0).v0;
+      chain_starts_.push_back(
+          {S2CellId(vertex), s2shapeutil::ShapeEdgeId(s, chain.start),
+           vertex});
+    }
+  }
+  std::sort(chain_starts_.begin(), chain_starts_.end(),
+            [](const ChainStart& x, const ChainStart& y) {
+              return x.id < y.id;
+            });
+}
+
 bool S2BooleanOperation::IsEmpty(
     OpType op_type, const S2ShapeIndex& a, const S2ShapeIndex& b,
     const Options& options) {
@@ -2798,3 +3350,113 @@ bool S2BooleanOperation::IsEmpty(
   ABSL_DCHECK(error.ok());
   return result_empty;
 }
+
+bool S2BooleanOperation::IsEmpty(
+    OpType op_type, const S2ShapeIndex& a, const PreparedOperand& b,
+    const Options& options) {
+  bool result_empty;
+  S2BooleanOperation op(op_type, &result_empty, options);
+  S2Error error;
+  op.Build(a, b, &error);
+  ABSL_DCHECK(error.ok());
+  return result_empty;
+}
+
+S2BooleanOperation::PreparedPredicate::PreparedPredicate(
+    const S2ShapeIndex* index, const Options& options)
+    : operand_(index), options_(options) {
+  is_empty_ = IsEmptyRegion(*index);
+  vector<S2CellId> cell_ids, interior_ids;
+  for (S2ShapeIndex::Iterator it(index, S2ShapeIndex::BEGIN); !it.done();
+       it.Next()) {
+    cell_ids.push_back(it.id());
+    // A cell is inside a polygon if the polygon contains its center and
+    // none of the polygon's edges are within the cell padding.
+    const S2ShapeIndexCell& cell = it.cell();
+    for (int i = 0; i < cell.num_clipped(); ++i) {
+      const S2ClippedShape& clipped = cell.clipped(i);
+      if (clipped.contains_center() && clipped.num_edges() == 0 &&
+          index->shape(clipped.shape_id())->dimension() == 2) {
+        interior_ids.push_back(it.id());
+        break;
+      }
+    }
+  }
+  covering_ = S2CellUnion(std::move(cell_ids));
+  interior_ = S2CellUnion(std::move(interior_ids));
+  cap_ = covering_.GetCapBound();
+}
+
+bool S2BooleanOperation::PreparedPredicate::Intersects(
+    const S2ShapeIndex& b) const {
+  switch (GetRelation(b)) {
+    case Relation::DISJOINT:
+      return false;
+    case Relation::INTERIOR:
+      return !IsEmptyRegion(b);
+    default:
+      return !S2BooleanOperation::IsEmpty(OpType::INTERSECTION, b, operand_,
+                                          options_);
+  }
+}
+
+bool S2BooleanOperation::PreparedPredicate::Contains(
+    const S2ShapeIndex& b) const {
+  switch (GetRelation(b)) {
+    case Relation::DISJOINT:
+      // Only the empty region is contained by a disjoint region.
+      return IsEmptyRegion(b);
+    case Relation::INTERIOR:
+      return true;
+    default:
+      return S2BooleanOperation::IsEmpty(OpType::DIFFERENCE, b, operand_,
+                                         options_);
+  }
+}
+
+bool S2BooleanOperation::PreparedPredicate::Within(
+    const S2ShapeIndex& b) const {
+  if (GetRelation(b) == Relation::DISJOINT) return is_empty_;
+  return S2BooleanOperation::IsEmpty(OpType::DIFFERENCE, index(), b,
+                                     options_);
+}
+
+bool S2BooleanOperation::PreparedPredicate::Equals(
+    const S2ShapeIndex& b) const {
+  if (GetRelation(b) == Relation::DISJOINT) {
+    return is_empty_ && IsEmptyRegion(b);
+  }
+  return S2BooleanOperation::IsEmpty(OpType::SYMMETRIC_DIFFERENCE, b,
+                                     operand_, options_);
+}
+
+S2BooleanOperation::PreparedPredicate::Relation
+S2BooleanOperation::PreparedPredicate::GetRelation(
+    const S2ShapeIndex& b) const {
+  // First test a coarse covering of "b", which can be computed without
+  // visiting every index cell.
+  vector<S2CellId> bound_ids;
+  MakeS2ShapeIndexRegion(&b).GetCellUnionBound(&bound_ids);
+  S2CellUnion bound(std::move(bound_ids));
+  if (!cap_.Intersects(bound.GetCapBound()) || !covering_.Intersects(bound)) {
+    return Relation::DISJOINT;
+  }
+  // Now test the index cells of "b".  Since the index cells of both regions
+  // include all edges within the cell padding, the regions are disjoint if
+  // their index cells are.
+  bool intersects = false, interior = !interior_.empty();
+  for (S2ShapeIndex::Iterator it(&b, S2ShapeIndex::BEGIN); !it.done();
+       it.Next()) {
+    if (!intersects) intersects = covering_.Intersects(it.id());
+    if (interior) interior = interior_.Contains(it.id());
+    if (intersects && !interior) break;
+  }
+  if (!intersects) return Relation::DISJOINT;
+  return interior ? Relation::INTERIOR : Relation::UNKNOWN;
+}
+
+bool S2BooleanOperation::PreparedPredicate::IsEmptyRegion(
+    const S2ShapeIndex& b) const {
+  MutableS2ShapeIndex empty;
+  return S2BooleanOperation::IsEmpty(OpType::UNION, b, empty, options_);
+}
@@ -18,18 +18,28 @@
 #ifndef S2_S2BOOLEAN_OPERATION_H_
 #define S2_S2BOOLEAN_OPERATION_H_
 
+#include <functional>
 #include <memory>
 #include <utility>
 #include <vector>
 
+#include "s2/base/executor.h"
 #include "s2/base/types.h"
 #include "absl/log/absl_log.h"
+#include "absl/types/span.h"
 #include "s2/s2builder.h"
 #include "s2/s2builder_graph.h"
 #include "s2/s2builder_layer.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2edge_crossing_cache.h"
 #include "s2/s2error.h"
 #include "s2/s2memory_tracker.h"
+#include "s2/s2phase_tracer.h"
+#include "s2/s2point.h"
 #include "s2/s2shape_index.h"
+#include "s2/s2shapeutil_shape_edge_id.h"
 #include "s2/value_lexicon.h"
 
 // This class implements boolean operations (intersection, union, difference,
@@ -437,6 +447,63 @@ class S2BooleanOperation {
     S2MemoryTracker* memory_tracker() const;
     void set_memory_tracker(S2MemoryTracker* tracker);
 
+    // The maximum number of threads used by Build().  When this is greater
+    // than one, the edge crossings between the two regions are computed
+    // concurrently for each S2 cube face, the chain starts of each region
+    // are tested for containment concurrently, and the same number of
+    // threads is used to snap the output (see S2Builder::Options).  The
+    // crossings are merged in a fixed order, so the output does not depend
+    // on this value.  Boolean predicates such as IsEmpty() always use one
+    // thread, since they usually terminate early.
+    //
+    // REQUIRES: memory_tracker() == nullptr if num_threads > 1
+    //           (S2MemoryTracker is not thread-safe).
+    //
+    // DEFAULT: 1
+    int num_threads() const;
+    void set_num_threads(int num_threads);
+
+    // If non-null, the additional threads requested by num_threads() are
+    // run as tasks on this executor rather than being created by Build().
+    // This executor is also passed to S2Builder (see s2base::Executor).
+    //
+    // DEFAULT: nullptr
+    s2base::Executor* executor() const;
+    void set_executor(s2base::Executor* executor);
+
+    // If non-null, the intersection points of crossing edges of the two
+    // regions are looked up in this cache and added to it, so that edge
+    // pairs that are crossed by many operations (e.g. along borders shared
+    // by many input polygons) are intersected only once (see
+    // S2EdgeCrossingCache).  The cache is also passed to S2Builder.  The
+    // output does not depend on this option.  The cache must outlive the
+    // S2BooleanOperation.
+    //
+    // DEFAULT: nullptr
+    S2EdgeCrossingCache* edge_crossing_cache() const;
+    void set_edge_crossing_cache(S2EdgeCrossingCache* cache);
+
+    // If non-null, Build() reports the beginning and end of each of its
+    // phases to this tracer (see S2PhaseTracer).  The phases and their item
+    // counts are:
+    //
+    //   S2BooleanOperation::Build           not applicable
+    //   S2BooleanOperation::GetChainStarts  the number of edge chains that
+    //                                       start inside the other region
+    //   S2BooleanOperation::AddBoundaries   the number of crossings passed to
+    //                                       the output
+    //   S2BooleanOperation::FindCrossings   the number of crossing edge pairs
+    //                                       (nested within AddBoundaries)
+    //
+    // followed by the S2Builder phases (see S2Builder::Options::tracer).
+    // GetChainStarts and AddBoundaries are reported twice for the
+    // SYMMETRIC_DIFFERENCE operation.  The tracer must outlive the
+    // S2BooleanOperation.
+    //
+    // DEFAULT: nullptr
+    S2PhaseTracer* tracer() const;
+    void set_tracer(S2PhaseTracer* tracer);
+
     // Options may be assigned and copied.
     Options(const Options& options);
     Options& operator=(const Options& options);
@@ -451,8 +518,20 @@ class S2BooleanOperation {
     bool conservative_output_ = false;
     ValueLexicon<SourceId>* source_id_lexicon_ = nullptr;
     S2MemoryTracker* memory_tracker_ = nullptr;
+    int num_threads_ = 1;
+    s2base::Executor* executor_ = nullptr;
+    S2EdgeCrossingCache* edge_crossing_cache_ = nullptr;
+    S2PhaseTracer* tracer_ = nullptr;
   };
 
+  // Preprocessed form of an S2ShapeIndex that is used as the second operand
+  // of many operations (see PreparedOperand below).
+  class PreparedOperand;
+
+  // Preprocessed form of an S2ShapeIndex that is tested against many other
+  // regions using the predicates below (see PreparedPredicate below).
+  class PreparedPredicate;
+
 #ifndef SWIG
   // Specifies that the output boundary edges should be sent to a single
   // S2Builder layer.  This version can be used when the dimension of the
@@ -494,12 +573,70 @@ class S2BooleanOperation {
   bool Build(const S2ShapeIndex& a, const S2ShapeIndex& b,
              S2Error* error);
 
+  // Like Build(a, b.index(), error), except that the preprocessing done by
+  // PreparedOperand is used to reduce the cost of the operation when "b" is
+  // much larger than "a".  The result is identical.
+  bool Build(const S2ShapeIndex& a, const PreparedOperand& b,
+             S2Error* error);
+
+  // Computes the given operation between each region "a[i]" and the region
+  // "b", using up to "num_threads" threads.  The output of operation "i" is
+  // sent to the layers returned by "make_layers(i)", which must return
+  // either one or three layers (see the constructors above), and its status
+  // is stored in (*errors)[i].  Returns true if all operations succeeded.
+  //
+  // When num_threads > 1, make_layers() and the Build() methods of the
+  // returned layers may be called concurrently from several threads, which
+  // means that each layer should only modify the output for its own "i".
+  // The results do not depend on the number of threads.  The additional
+  // threads are run on options.executor() if it is non-null.
+  //
+  // REQUIRES: options.memory_tracker() == nullptr if num_threads > 1
+  //           (S2MemoryTracker is not thread-safe).
+  static bool BuildAll(
+      OpType op_type, absl::Span<const S2ShapeIndex* const> a,
+      const PreparedOperand& b,
+      const std::function<std::vector<std::unique_ptr<S2Builder::Layer>>(
+          int)>& make_layers,
+      std::vector<S2Error>* errors, const Options& options = Options(),
+      int num_threads = 1);
+
+  // Computes the union of all the given regions and sends the result to the
+  // given layers, which must consist of either one or three layers (see the
+  // constructors above).  Returns true on success, and otherwise sets "error"
+  // appropriately.
+  //
+  // The regions are first sorted along the Hilbert curve according to their
+  // centroids, and then adjacent pairs of regions are unioned in a balanced
+  // reduction tree.  This is much faster than unioning the regions one at a
+  // time when there are many of them, since each intermediate result only
+  // involves regions that are close together.  The pairs at each level of
+  // the tree are unioned concurrently using up to "num_threads" threads
+  // (run on options.executor() if it is non-null); the result does not
+  // depend on the number of threads.
+  //
+  // Note that options.snap_function() is applied at every level of the tree
+  // (as with S2Polygon::DestructiveUnion), so the result may differ
+  // slightly from the union of all the regions computed in a single step.
+  //
+  // REQUIRES: options.memory_tracker() == nullptr if num_threads > 1.
+  static bool UnionAll(absl::Span<const S2ShapeIndex* const> regions,
+                       std::vector<std::unique_ptr<S2Builder::Layer>> layers,
+                       S2Error* error, const Options& options = Options(),
+                       int num_threads = 1);
+
   // Convenience method that returns true if the result of the given operation
   // is empty.
   static bool IsEmpty(OpType op_type,
                       const S2ShapeIndex& a, const S2ShapeIndex& b,
                       const Options& options = Options());
 
+  // Like IsEmpty(op_type, a, b.index(), options), except that the
+  // preprocessing done by PreparedOperand is used.  The result is identical.
+  static bool IsEmpty(OpType op_type, const S2ShapeIndex& a,
+                      const PreparedOperand& b,
+                      const Options& options = Options());
+
   // Convenience method that returns true if A intersects B.
   static bool Intersects(const S2ShapeIndex& a, const S2ShapeIndex& b,
                          const Options& options = Options()) {
@@ -539,6 +676,9 @@ class S2BooleanOperation {
   // The input regions.
   const S2ShapeIndex* regions_[2];
 
+  // Preprocessed data for regions_[1], or nullptr if none.
+  const PreparedOperand* prepared_b_ = nullptr;
+
   // The output consists either of zero layers, one layer, or three layers.
   std::vector<std::unique_ptr<S2Builder::Layer>> layers_;
 
@@ -546,6 +686,139 @@ class S2BooleanOperation {
   bool* result_empty_;
 };
 
+// A PreparedOperand stores information about an S2ShapeIndex that is used
+// as the second operand ("b") of many boolean operations, such as when a
+// large number of small features are clipped to the same tile or region.
+// Normally every operation tests the first vertex of each edge chain in "b"
+// for containment by "a", which takes time proportional to the size of "b"
+// even when the inputs barely overlap.  A PreparedOperand instead indexes
+// these vertices by S2CellId so that only the ones near "a" are examined.
+// This speeds up INTERSECTION and DIFFERENCE in particular, since the cost
+// of each operation then depends mainly on the size of "a" and of the
+// output.  Example usage:
+//
+//   S2BooleanOperation::PreparedOperand tile(&tile_index);
+//   for (const auto& feature : features) {
+//     S2Polygon clipped;
+//     S2BooleanOperation op(S2BooleanOperation::OpType::INTERSECTION,
+//                           std::make_unique<S2PolygonLayer>(&clipped));
+//     S2Error error;
+//     if (!op.Build(*feature, tile, &error)) { ... }
+//   }
+//
+// A PreparedOperand may be used by several threads at once (see BuildAll).
+// The S2ShapeIndex must not be modified while the PreparedOperand exists.
+class S2BooleanOperation::PreparedOperand {
+ public:
+  // Preprocesses the given index, which must persist for the lifetime of
+  // this object.
+  explicit PreparedOperand(const S2ShapeIndex* index);
+
+  PreparedOperand(PreparedOperand&&) = default;
+  PreparedOperand& operator=(PreparedOperand&&) = default;
+
+  const S2ShapeIndex& index() const { return *index_; }
+
+ private:
+  friend class S2BooleanOperation::Impl;
+
+  // The first edge of a non-empty edge chain and its first vertex.
+  struct ChainStart {
+    S2CellId id;  // The leaf cell containing "vertex".
+    s2shapeutil::ShapeEdgeId edge_id;
+    S2Point vertex;
+  };
+
+  const S2ShapeIndex* index_;
+
+  // True if the index contains any two-dimensional shapes.
+  bool has_interior_;
+
+  // The start of every non-empty edge chain, sorted by S2CellId.
+  std::vector<ChainStart> chain_starts_;
+};
+
+// A PreparedPredicate evaluates the boolean predicates Intersects(),
+// Contains(), Within() and Equals() between one fixed S2ShapeIndex and many
+// candidate regions, such as when finding which of thousands of polygons
+// are contained by a given region.  The fixed index is preprocessed once:
+//
+//  - Its chain starts are indexed as in PreparedOperand, so that the exact
+//    predicates do not examine every edge chain of the fixed index.
+//
+//  - Its S2Cap bound and the S2CellUnion of its index cells are computed, so
+//    that candidates far away from the fixed index are rejected without
+//    looking at any edges.
+//
+//  - The union of the index cells that are entirely inside its polygons is
+//    computed, so that candidates whose index cells lie within this union
+//    are known to be contained without looking at any edges.
+//
+// These filters are exact, so the results are always identical to the
+// corresponding static methods of S2BooleanOperation.  Example usage:
+//
+//   S2BooleanOperation::PreparedPredicate region(&region_index);
+//   for (const auto& candidate : candidates) {
+//     if (region.Contains(*candidate)) { ... }
+//   }
+//
+// A PreparedPredicate may be used by several threads at once.  Neither the
+// fixed index nor the candidate indexes may be modified while a predicate
+// is being evaluated.
+class S2BooleanOperation::PreparedPredicate {
+ public:
+  // Preprocesses the given index, which must persist for the lifetime of
+  // this object.  The given options are used to evaluate every predicate.
+  explicit PreparedPredicate(const S2ShapeIndex* index,
+                             const Options& options = Options());
+
+  const S2ShapeIndex& index() const { return operand_.index(); }
+  const Options& options() const { return options_; }
+
+  // Returns true if index() intersects "b".  Equivalent to
+  // S2BooleanOperation::Intersects(index(), b, options()).
+  bool Intersects(const S2ShapeIndex& b) const;
+
+  // Returns true if index() contains "b".  Equivalent to
+  // S2BooleanOperation::Contains(index(), b, options()).
+  bool Contains(const S2ShapeIndex& b) const;
+
+  // Returns true if "b" contains index().  Equivalent to
+  // S2BooleanOperation::Contains(b, index(), options()).
+  bool Within(const S2ShapeIndex& b) const;
+
+  // Returns true if index() and "b" are equal.  Equivalent to
+  // S2BooleanOperation::Equals(index(), b, options()).
+  bool Equals(const S2ShapeIndex& b) const;
+
+ private:
+  // The relationship of a candidate region to the fixed index as determined
+  // by the filters above.
+  enum class Relation : uint8 {
+    DISJOINT,  // The regions do not intersect.
+    INTERIOR,  // The candidate is inside the polygons of the fixed index.
+    UNKNOWN,   // The exact predicate must be evaluated.
+  };
+  Relation GetRelation(const S2ShapeIndex& b) const;
+
+  // Returns true if the given region is empty (e.g., if it consists only of
+  // degenerate edges that are not contained under the polygon model).
+  bool IsEmptyRegion(const S2ShapeIndex& b) const;
+
+  PreparedOperand operand_;
+  Options options_;
+
+  // True if index() is empty under the given options.
+  bool is_empty_;
+
+  // A bound for index() and the union of its index cells.
+  S2Cap cap_;
+  S2CellUnion covering_;
+
+  // The union of the index cells that are inside a polygon of index().
+  S2CellUnion interior_;
+};
+
 
 //////////////////   Implementation details follow   ////////////////////
 
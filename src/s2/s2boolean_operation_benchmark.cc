@@ -0,0 +1,91 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Benchmarks for S2BooleanOperation.
+
+#include "s2/s2boolean_operation.h"
+
+#include <memory>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2builderutil_s2polygon_layer.h"
+#include "s2/s2cap.h"
+#include "s2/s2error.h"
+#include "s2/s2fractal.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2polygon.h"
+#include "s2/s2testing.h"
+
+using std::make_unique;
+using OpType = S2BooleanOperation::OpType;
+
+namespace {
+
+// Builds indexes containing two overlapping fractal loops with approximately
+// "num_edges" edges each.
+void MakeOverlappingFractals(int num_edges, MutableS2ShapeIndex* a,
+                             MutableS2ShapeIndex* b) {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(num_edges);
+  S2Point center = S2Testing::RandomPoint();
+  S2Point offset_center = S2Testing::SamplePoint(
+      S2Cap(center, S1Angle::Degrees(2)));
+  a->Add(make_unique<S2Loop::OwningShape>(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(center), S1Angle::Degrees(5))));
+  b->Add(make_unique<S2Loop::OwningShape>(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(offset_center), S1Angle::Degrees(5))));
+  a->ForceBuild();
+  b->ForceBuild();
+}
+
+// Computes a boolean operation of type state.range(0) between two
+// overlapping fractal loops with approximately state.range(1) edges each.
+void BM_BuildPolygon(benchmark::State& state) {
+  MutableS2ShapeIndex a, b;
+  MakeOverlappingFractals(state.range(1), &a, &b);
+  auto op_type = static_cast<OpType>(state.range(0));
+  state.SetLabel(std::string(S2BooleanOperation::OpTypeToString(op_type)));
+  for (auto _ : state) {
+    S2Polygon result;
+    S2BooleanOperation op(
+        op_type, make_unique<s2builderutil::S2PolygonLayer>(&result));
+    S2Error error;
+    if (!op.Build(a, b, &error)) state.SkipWithError(error.text().c_str());
+    benchmark::DoNotOptimize(result.num_vertices());
+  }
+}
+BENCHMARK(BM_BuildPolygon)
+    ->ArgsProduct({{static_cast<int>(OpType::UNION),
+                    static_cast<int>(OpType::INTERSECTION),
+                    static_cast<int>(OpType::DIFFERENCE)},
+                   benchmark::CreateRange(1 << 8, 1 << 14, 8)});
+
+// Evaluates the Intersects() predicate between two overlapping fractal loops
+// with approximately state.range(0) edges each.
+void BM_Intersects(benchmark::State& state) {
+  MutableS2ShapeIndex a, b;
+  MakeOverlappingFractals(state.range(0), &a, &b);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(S2BooleanOperation::Intersects(a, b));
+  }
+}
+BENCHMARK(BM_Intersects)->Range(1 << 8, 1 << 14);
+
+}  // namespace
@@ -17,6 +17,7 @@
 
 #include "s2/s2boolean_operation.h"
 
+#include <algorithm>
 #include <cmath>
 
 #include <memory>
@@ -36,6 +37,7 @@
 #include "absl/strings/string_view.h"
 
 #include "s2/base/commandlineflags_declare.h"
+#include "s2/base/executor.h"
 #include "s2/mutable_s2shape_index.h"
 #include "s2/s1angle.h"
 #include "s2/s2builder.h"
@@ -46,6 +48,7 @@
 #include "s2/s2builderutil_s2polyline_vector_layer.h"
 #include "s2/s2builderutil_snap_functions.h"
 #include "s2/s2builderutil_testing.h"
+#include "s2/s2cap.h"
 #include "s2/s2edge_crossings.h"
 #include "s2/s2error.h"
 #include "s2/s2latlng.h"
@@ -53,6 +56,7 @@
 #include "s2/s2lax_polyline_shape.h"
 #include "s2/s2loop.h"
 #include "s2/s2memory_tracker.h"
+#include "s2/s2phase_tracer.h"
 #include "s2/s2point.h"
 #include "s2/s2point_vector_shape.h"
 #include "s2/s2pointutil.h"
@@ -60,11 +64,13 @@
 #include "s2/s2polyline.h"
 #include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
+#include "s2/s2shape_index_measures.h"
 #include "s2/s2shapeutil_contains_brute_force.h"
 #include "s2/s2testing.h"
 #include "s2/s2text_format.h"
 #include "s2/util/math/matrix3x3.h"
 
+S2_DECLARE_int32(s2boolean_operation_max_brute_force_edges);
 S2_DECLARE_int64(s2shape_index_tmp_memory_budget);
 
 namespace {
@@ -2298,6 +2304,424 @@ TEST(S2BooleanOperation, IntersectsEmptyAndFull) {
   EXPECT_TRUE(S2BooleanOperation::Intersects(*full, *full));
 }
 
+// Returns a region consisting of a grid of small squares (each a separate
+// loop, with a hole in every third square).  Optionally the region also
+// includes a polyline and some points.
+unique_ptr<MutableS2ShapeIndex> MakeGridIndex(bool add_points_and_polylines) {
+  auto index = make_unique<MutableS2ShapeIndex>();
+  vector<vector<S2Point>> loops;
+  for (int i = 0; i < 10; ++i) {
+    for (int j = 0; j < 10; ++j) {
+      double lat = i, lng = j;
+      loops.push_back({S2LatLng::FromDegrees(lat, lng).ToPoint(),
+                       S2LatLng::FromDegrees(lat, lng + 0.8).ToPoint(),
+                       S2LatLng::FromDegrees(lat + 0.8, lng + 0.8).ToPoint(),
+                       S2LatLng::FromDegrees(lat + 0.8, lng).ToPoint()});
+      if ((i + j) % 3 == 0) {
+        loops.push_back(
+            {S2LatLng::FromDegrees(lat + 0.2, lng + 0.2).ToPoint(),
+             S2LatLng::FromDegrees(lat + 0.6, lng + 0.2).ToPoint(),
+             S2LatLng::FromDegrees(lat + 0.6, lng + 0.6).ToPoint(),
+             S2LatLng::FromDegrees(lat + 0.2, lng + 0.6).ToPoint()});
+      }
+    }
+  }
+  index->Add(make_unique<S2LaxPolygonShape>(loops));
+  if (!add_points_and_polylines) return index;
+  index->Add(s2textformat::MakeLaxPolylineOrDie("-1:-1, 11:11, 11:-1"));
+  index->Add(make_unique<S2PointVectorShape>(
+      s2textformat::ParsePointsOrDie("0.9:0.9, 5.5:5.5, -2:3")));
+  return index;
+}
+
+// Returns the output of the given operation as a string.
+string BuildToString(OpType op_type, const S2ShapeIndex& a,
+                     const S2ShapeIndex* b,
+                     const S2BooleanOperation::PreparedOperand* prepared_b,
+                     const S2BooleanOperation::Options& options =
+                         S2BooleanOperation::Options()) {
+  MutableS2ShapeIndex output;
+  vector<unique_ptr<S2Builder::Layer>> layers(3);
+  layers[0] = make_unique<s2builderutil::IndexedS2PointVectorLayer>(&output);
+  layers[1] = make_unique<s2builderutil::IndexedS2PolylineVectorLayer>(&output);
+  layers[2] = make_unique<s2builderutil::IndexedLaxPolygonLayer>(&output);
+  S2BooleanOperation op(op_type, std::move(layers), options);
+  S2Error error;
+  if (prepared_b != nullptr) {
+    EXPECT_TRUE(op.Build(a, *prepared_b, &error)) << error;
+  } else {
+    EXPECT_TRUE(op.Build(a, *b, &error)) << error;
+  }
+  return s2textformat::ToString(output);
+}
+
+TEST(S2BooleanOperation, PreparedOperandMatchesUnprepared) {
+  auto b = MakeGridIndex(true);
+  S2BooleanOperation::PreparedOperand prepared_b(b.get());
+  EXPECT_EQ(b.get(), &prepared_b.index());
+  S2Testing::rnd.Reset(1);
+  for (int iter = 0; iter < 30; ++iter) {
+    // The inputs include polygons, polylines, and points of various sizes
+    // that overlap some of the grid squares, as well as some holes (so that
+    // the chain starts of B in the holes of A are tested).
+    S2Point center = S2LatLng::FromDegrees(
+        -1 + 12 * S2Testing::rnd.RandDouble(),
+        -1 + 12 * S2Testing::rnd.RandDouble()).ToPoint();
+    S1Angle radius = S1Angle::Degrees(0.1 + 3 * S2Testing::rnd.RandDouble());
+    MutableS2ShapeIndex a;
+    vector<vector<S2Point>> loops;
+    loops.push_back(S2Testing::MakeRegularPoints(center, radius, 10));
+    if (iter % 2 == 0) {
+      vector<S2Point> hole =
+          S2Testing::MakeRegularPoints(center, 0.5 * radius, 7);
+      std::reverse(hole.begin(), hole.end());
+      loops.push_back(hole);
+    }
+    a.Add(make_unique<S2LaxPolygonShape>(loops));
+    if (iter % 3 == 0) {
+      a.Add(make_unique<S2LaxPolylineShape>(
+          S2Testing::MakeRegularPoints(center, 2 * radius, 5)));
+      a.Add(make_unique<S2PointVectorShape>(
+          S2Testing::MakeRegularPoints(center, 1.5 * radius, 3)));
+    }
+    for (auto op_type : {OpType::UNION, OpType::INTERSECTION,
+                         OpType::DIFFERENCE, OpType::SYMMETRIC_DIFFERENCE}) {
+      EXPECT_EQ(BuildToString(op_type, a, b.get(), nullptr),
+                BuildToString(op_type, a, nullptr, &prepared_b))
+          << "iter=" << iter << ", op="
+          << S2BooleanOperation::OpTypeToString(op_type);
+    }
+  }
+}
+
+TEST(S2BooleanOperation, BuildAll) {
+  auto b = MakeGridIndex(false);
+  S2BooleanOperation::PreparedOperand prepared_b(b.get());
+  vector<unique_ptr<MutableS2ShapeIndex>> inputs;
+  vector<const S2ShapeIndex*> a;
+  for (int i = 0; i < 20; ++i) {
+    inputs.push_back(make_unique<MutableS2ShapeIndex>());
+    inputs.back()->Add(make_unique<S2LaxPolygonShape>(
+        vector<vector<S2Point>>{S2Testing::MakeRegularPoints(
+            S2LatLng::FromDegrees(0.5 * i, 0.4 * i).ToPoint(),
+            S1Angle::Degrees(1), 8)}));
+    a.push_back(inputs.back().get());
+  }
+  for (int num_threads : {1, 4}) {
+    vector<MutableS2ShapeIndex> outputs(a.size());
+    vector<S2Error> errors;
+    EXPECT_TRUE(S2BooleanOperation::BuildAll(
+        OpType::INTERSECTION, a, prepared_b,
+        [&outputs](int i) {
+          vector<unique_ptr<S2Builder::Layer>> layers;
+          layers.push_back(
+              make_unique<s2builderutil::IndexedLaxPolygonLayer>(&outputs[i]));
+          return layers;
+        },
+        &errors, S2BooleanOperation::Options(), num_threads));
+    ASSERT_EQ(a.size(), errors.size());
+    for (int i = 0; i < a.size(); ++i) {
+      EXPECT_TRUE(errors[i].ok()) << errors[i];
+      MutableS2ShapeIndex expected;
+      S2BooleanOperation op(
+          OpType::INTERSECTION,
+          make_unique<s2builderutil::IndexedLaxPolygonLayer>(&expected));
+      S2Error error;
+      ASSERT_TRUE(op.Build(*a[i], *b, &error)) << error;
+      EXPECT_EQ(s2textformat::ToString(expected),
+                s2textformat::ToString(outputs[i]));
+    }
+  }
+}
+
+TEST(S2BooleanOperation, PreparedPredicateMatchesUnprepared) {
+  vector<unique_ptr<MutableS2ShapeIndex>> fixed;
+  fixed.push_back(MakeGridIndex(true));
+  fixed.push_back(s2textformat::MakeIndexOrDie(
+      "# # -1:-1, -1:11, 11:11, 11:-1"));
+  fixed.push_back(s2textformat::MakeIndexOrDie("# # "));
+  fixed.push_back(s2textformat::MakeIndexOrDie("# # full"));
+  // The candidates include polygons, polylines, and points of various sizes
+  // (some of which are inside a single grid square), as well as the empty
+  // and full regions.
+  vector<unique_ptr<MutableS2ShapeIndex>> candidates;
+  candidates.push_back(s2textformat::MakeIndexOrDie("# # "));
+  candidates.push_back(s2textformat::MakeIndexOrDie("# # full"));
+  S2Testing::rnd.Reset(1);
+  for (int iter = 0; iter < 100; ++iter) {
+    S2Point center = S2LatLng::FromDegrees(
+        -2 + 14 * S2Testing::rnd.RandDouble(),
+        -2 + 14 * S2Testing::rnd.RandDouble()).ToPoint();
+    S1Angle radius = S1Angle::Degrees(
+        0.01 * std::pow(300, S2Testing::rnd.RandDouble()));
+    auto candidate = make_unique<MutableS2ShapeIndex>();
+    switch (iter % 3) {
+      case 0:
+        candidate->Add(make_unique<S2LaxPolygonShape>(vector<vector<S2Point>>{
+            S2Testing::MakeRegularPoints(center, radius, 8)}));
+        break;
+      case 1:
+        candidate->Add(make_unique<S2LaxPolylineShape>(
+            S2Testing::MakeRegularPoints(center, radius, 4)));
+        break;
+      default:
+        candidate->Add(make_unique<S2PointVectorShape>(
+            S2Testing::MakeRegularPoints(center, radius, 3)));
+        break;
+    }
+    candidates.push_back(std::move(candidate));
+  }
+  for (const auto& a : fixed) {
+    S2BooleanOperation::PreparedPredicate prepared_a(a.get());
+    EXPECT_EQ(a.get(), &prepared_a.index());
+    for (const auto& b : candidates) {
+      EXPECT_EQ(S2BooleanOperation::Intersects(*a, *b),
+                prepared_a.Intersects(*b));
+      EXPECT_EQ(S2BooleanOperation::Contains(*a, *b),
+                prepared_a.Contains(*b));
+      EXPECT_EQ(S2BooleanOperation::Contains(*b, *a), prepared_a.Within(*b));
+      EXPECT_EQ(S2BooleanOperation::Equals(*a, *b), prepared_a.Equals(*b));
+    }
+  }
+}
+
+// Returns a grid of squares covering most of the sphere, so that the edges
+// of the region intersect every cube face.
+unique_ptr<MutableS2ShapeIndex> MakeGlobalGridIndex(double lat_offset,
+                                                    double lng_offset) {
+  auto index = make_unique<MutableS2ShapeIndex>();
+  vector<vector<S2Point>> loops;
+  for (int i = -8; i < 8; ++i) {
+    for (int j = -18; j < 18; ++j) {
+      double lat = 10 * i + lat_offset, lng = 10 * j + lng_offset;
+      loops.push_back({S2LatLng::FromDegrees(lat, lng).ToPoint(),
+                       S2LatLng::FromDegrees(lat, lng + 7).ToPoint(),
+                       S2LatLng::FromDegrees(lat + 7, lng + 7).ToPoint(),
+                       S2LatLng::FromDegrees(lat + 7, lng).ToPoint()});
+    }
+  }
+  index->Add(make_unique<S2LaxPolygonShape>(loops));
+  vector<S2Point> polyline;
+  for (int lng = -180; lng < 180; lng += 15) {
+    polyline.push_back(S2LatLng::FromDegrees(lat_offset, lng).ToPoint());
+  }
+  index->Add(make_unique<S2LaxPolylineShape>(polyline));
+  return index;
+}
+
+TEST(S2BooleanOperation, NumThreadsDoesNotChangeOutput) {
+  auto a = MakeGlobalGridIndex(0, 0);
+  auto b = MakeGlobalGridIndex(4, 3);
+  for (bool snap : {false, true}) {
+    S2BooleanOperation::Options options;
+    if (snap) {
+      options.set_snap_function(s2builderutil::IntLatLngSnapFunction(1));
+    }
+    for (auto op_type : {OpType::UNION, OpType::INTERSECTION,
+                         OpType::DIFFERENCE, OpType::SYMMETRIC_DIFFERENCE}) {
+      string expected = BuildToString(op_type, *a, b.get(), nullptr, options);
+      options.set_num_threads(4);
+      EXPECT_EQ(expected,
+                BuildToString(op_type, *a, b.get(), nullptr, options))
+          << "snap=" << snap << ", op="
+          << S2BooleanOperation::OpTypeToString(op_type);
+      s2base::WorkStealingThreadPool pool(3);
+      options.set_executor(&pool);
+      EXPECT_EQ(expected,
+                BuildToString(op_type, *a, b.get(), nullptr, options))
+          << "snap=" << snap << ", op="
+          << S2BooleanOperation::OpTypeToString(op_type) << ", executor";
+      options.set_executor(nullptr);
+      options.set_num_threads(1);
+    }
+  }
+}
+
+// Records the beginning and end of each phase.
+class RecordingTracer : public S2PhaseTracer {
+ public:
+  void BeginPhase(string_view phase) override {
+    events.push_back(absl::StrCat("+", phase));
+  }
+  void EndPhase(string_view phase, const PhaseStats& stats) override {
+    events.push_back(absl::StrCat("-", phase, " ", stats.num_items));
+  }
+  vector<string> events;
+};
+
+TEST(S2BooleanOperation, TracerReportsPhases) {
+  auto a = s2textformat::MakeIndexOrDie("# # 0:0, 0:2, 2:2, 2:0");
+  auto b = s2textformat::MakeIndexOrDie("# # 1:1, 1:3, 3:3, 3:1");
+  RecordingTracer tracer;
+  S2BooleanOperation::Options options;
+  options.set_tracer(&tracer);
+  S2LaxPolygonShape result;
+  S2BooleanOperation op(OpType::INTERSECTION,
+                        make_unique<LaxPolygonLayer>(&result), options);
+  S2Error error;
+  ASSERT_TRUE(op.Build(*a, *b, &error)) << error;
+  EXPECT_EQ(tracer.events,
+            (vector<string>{"+S2BooleanOperation::Build",
+                            "+S2BooleanOperation::GetChainStarts",
+                            "-S2BooleanOperation::GetChainStarts 3",
+                            "+S2BooleanOperation::AddBoundaries",
+                            "+S2BooleanOperation::FindCrossings",
+                            "-S2BooleanOperation::FindCrossings 2",
+                            "-S2BooleanOperation::AddBoundaries 9",
+                            "+S2Builder::ChooseSites",
+                            "-S2Builder::ChooseSites 8",
+                            "+S2Builder::SnapEdges",
+                            "-S2Builder::SnapEdges 8",
+                            "+S2Builder::BuildLayer",
+                            "-S2Builder::BuildLayer 8",
+                            "-S2BooleanOperation::Build -1"}));
+}
+
+// Returns the union of the given regions computed by UnionAll() as a string.
+string UnionAllToString(const vector<const S2ShapeIndex*>& regions,
+                        int num_threads, MutableS2ShapeIndex* output,
+                        const S2BooleanOperation::Options& options =
+                            S2BooleanOperation::Options()) {
+  vector<unique_ptr<S2Builder::Layer>> layers(3);
+  layers[0] = make_unique<s2builderutil::IndexedS2PointVectorLayer>(output);
+  layers[1] = make_unique<s2builderutil::IndexedS2PolylineVectorLayer>(output);
+  layers[2] = make_unique<s2builderutil::IndexedLaxPolygonLayer>(output);
+  S2Error error;
+  EXPECT_TRUE(S2BooleanOperation::UnionAll(
+      regions, std::move(layers), &error, options, num_threads)) << error;
+  return s2textformat::ToString(*output);
+}
+
+TEST(S2BooleanOperation, UnionAllEmpty) {
+  MutableS2ShapeIndex output;
+  EXPECT_EQ("# #", UnionAllToString({}, 1, &output));
+}
+
+TEST(S2BooleanOperation, UnionAllDisjointRegions) {
+  // The union of disjoint squares has the same total area, and the point
+  // and polyline inputs are preserved.
+  vector<unique_ptr<MutableS2ShapeIndex>> inputs;
+  vector<const S2ShapeIndex*> regions;
+  double area = 0;
+  for (int i = 0; i < 25; ++i) {
+    inputs.push_back(s2textformat::MakeIndexOrDie(absl::StrCat(
+        "# # ", 2 * (i % 5), ":", 2 * (i / 5), ", ", 2 * (i % 5), ":",
+        2 * (i / 5) + 1, ", ", 2 * (i % 5) + 1, ":", 2 * (i / 5) + 1)));
+    area += S2::GetArea(*inputs.back());
+    regions.push_back(inputs.back().get());
+  }
+  inputs.push_back(
+      s2textformat::MakeIndexOrDie("20:20 | 30:30 # 20:0, 21:0 #"));
+  regions.push_back(inputs.back().get());
+  MutableS2ShapeIndex output;
+  UnionAllToString(regions, 1, &output);
+  EXPECT_NEAR(area, S2::GetArea(output), 1e-15);
+  ASSERT_EQ(3, output.num_shape_ids());
+  EXPECT_EQ(2, output.shape(0)->num_edges());  // Points
+  EXPECT_EQ(1, output.shape(1)->num_edges());  // Polyline
+  EXPECT_EQ(25, output.shape(2)->num_chains());  // Polygon loops
+}
+
+TEST(S2BooleanOperation, UnionAllNumThreadsDoesNotChangeOutput) {
+  S2Testing::rnd.Reset(3);
+  vector<unique_ptr<MutableS2ShapeIndex>> inputs;
+  vector<const S2ShapeIndex*> regions;
+  for (int i = 0; i < 50; ++i) {
+    S2Point center = S2LatLng::FromDegrees(
+        20 * S2Testing::rnd.RandDouble(),
+        20 * S2Testing::rnd.RandDouble()).ToPoint();
+    S1Angle radius = S1Angle::Degrees(0.5 + 2 * S2Testing::rnd.RandDouble());
+    inputs.push_back(make_unique<MutableS2ShapeIndex>());
+    inputs.back()->Add(make_unique<S2LaxPolygonShape>(vector<vector<S2Point>>{
+        S2Testing::MakeRegularPoints(center, radius, 8)}));
+    if (i % 5 == 0) {
+      inputs.back()->Add(make_unique<S2LaxPolylineShape>(
+          S2Testing::MakeRegularPoints(center, 2 * radius, 4)));
+    }
+    regions.push_back(inputs.back().get());
+  }
+  MutableS2ShapeIndex output1, output4, output_pool;
+  string expected = UnionAllToString(regions, 1, &output1);
+  EXPECT_EQ(expected, UnionAllToString(regions, 4, &output4));
+
+  // Both UnionAll() and the S2BooleanOperations that it runs schedule their
+  // threads on the same executor, which has fewer threads than requested.
+  s2base::WorkStealingThreadPool pool(2);
+  S2BooleanOperation::Options options;
+  options.set_num_threads(3);
+  options.set_executor(&pool);
+  EXPECT_EQ(expected, UnionAllToString(regions, 4, &output_pool, options));
+}
+
+// Returns a small random region near "center" that may include points,
+// polylines, and polygons.  The points and polylines may include vertices
+// from "shared".
+unique_ptr<MutableS2ShapeIndex> MakeSmallRandomIndex(
+    const S2Point& center, const vector<S2Point>& shared) {
+  auto& rnd = S2Testing::rnd;
+  auto index = make_unique<MutableS2ShapeIndex>();
+  S1Angle radius = S1Angle::Degrees(0.5 + 2 * rnd.RandDouble());
+  vector<S2Point> loop = S2Testing::MakeRegularPoints(
+      center, radius, 3 + rnd.Uniform(8));
+  if (rnd.OneIn(10)) {
+    // A loop covering most of the sphere.
+    std::reverse(loop.begin(), loop.end());
+  }
+  index->Add(make_unique<S2LaxPolygonShape>(vector<vector<S2Point>>{loop}));
+  if (rnd.OneIn(2)) {
+    vector<S2Point> polyline = S2Testing::MakeRegularPoints(
+        center, 1.5 * radius, 2 + rnd.Uniform(4));
+    if (!shared.empty() && rnd.OneIn(2)) polyline[0] = shared.back();
+    index->Add(make_unique<S2LaxPolylineShape>(polyline));
+  }
+  if (rnd.OneIn(2)) {
+    vector<S2Point> points = {
+        center, S2Testing::SamplePoint(S2Cap(center, 2 * radius))};
+    if (!shared.empty()) points.push_back(shared[0]);
+    index->Add(make_unique<S2PointVectorShape>(std::move(points)));
+  }
+  return index;
+}
+
+TEST(S2BooleanOperation, BruteForceMatchesIndex) {
+  S2Testing::rnd.Reset(4);
+  for (int iter = 0; iter < 200; ++iter) {
+    S2Point center = S2Testing::RandomPoint();
+    auto a = MakeSmallRandomIndex(center, {});
+    vector<S2Point> a_vertices;
+    for (const S2Shape* shape : *a) {
+      for (int e = 0; e < shape->num_edges(); ++e) {
+        a_vertices.push_back(shape->edge(e).v0);
+      }
+    }
+    S2Point b_center = S2Testing::SamplePoint(
+        S2Cap(center, S1Angle::Degrees(3)));
+    auto b = MakeSmallRandomIndex(b_center, a_vertices);
+    S2BooleanOperation::Options options;
+    if (iter % 2 == 1) {
+      options.set_polygon_model(PolygonModel::CLOSED);
+      options.set_polyline_model(PolylineModel::OPEN);
+    }
+    for (auto op_type : {OpType::UNION, OpType::INTERSECTION,
+                         OpType::DIFFERENCE, OpType::SYMMETRIC_DIFFERENCE}) {
+      bool brute_force_empty =
+          S2BooleanOperation::IsEmpty(op_type, *a, *b, options);
+      string brute_force =
+          BuildToString(op_type, *a, b.get(), nullptr, options);
+      absl::FlagSaver fs;
+      absl::SetFlag(&FLAGS_s2boolean_operation_max_brute_force_edges, 0);
+      EXPECT_EQ(S2BooleanOperation::IsEmpty(op_type, *a, *b, options),
+                brute_force_empty)
+          << "iter=" << iter << ", op="
+          << S2BooleanOperation::OpTypeToString(op_type);
+      EXPECT_EQ(BuildToString(op_type, *a, b.get(), nullptr, options),
+                brute_force)
+          << "iter=" << iter << ", op="
+          << S2BooleanOperation::OpTypeToString(op_type);
+    }
+  }
+}
+
 TEST(S2BooleanOperation, OptionsFieldsCopied) {
   S2BooleanOperation::Options options;
 
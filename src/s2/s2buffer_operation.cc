@@ -49,19 +49,25 @@
 #include "s2/s2buffer_operation.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <iterator>
 #include <memory>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "absl/log/absl_check.h"
 #include "absl/types/span.h"
+#include "s2/mutable_s2shape_index.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
+#include "s2/s2boolean_operation.h"
 #include "s2/s2builder.h"
 #include "s2/s2builder_layer.h"
+#include "s2/s2builderutil_lax_polygon_layer.h"
 #include "s2/s2builderutil_snap_functions.h"
+#include "s2/s2cell_id.h"
 #include "s2/s2contains_point_query.h"
 #include "s2/s2edge_crosser.h"
 #include "s2/s2edge_crossings.h"
@@ -160,7 +166,9 @@ S2BufferOperation::Options::Options(const Options& options)
       end_cap_style_(options.end_cap_style_),
       polyline_side_(options.polyline_side_),
       snap_function_(options.snap_function_->Clone()),
-      memory_tracker_(options.memory_tracker_) {
+      memory_tracker_(options.memory_tracker_),
+      num_threads_(options.num_threads_),
+      partition_level_(options.partition_level_) {
 }
 
 S2BufferOperation::Options& S2BufferOperation::Options::operator=(
@@ -171,6 +179,8 @@ S2BufferOperation::Options& S2BufferOperation::Options::operator=(
   polyline_side_ = options.polyline_side_;
   snap_function_ = options.snap_function_->Clone();
   memory_tracker_ = options.memory_tracker_;
+  num_threads_ = options.num_threads_;
+  partition_level_ = options.partition_level_;
   return *this;
 }
 
@@ -276,8 +286,37 @@ void S2BufferOperation::Options::set_memory_tracker(S2MemoryTracker* tracker) {
   memory_tracker_ = tracker;
 }
 
+int S2BufferOperation::Options::num_threads() const {
+  return num_threads_;
+}
+
+void S2BufferOperation::Options::set_num_threads(int num_threads) {
+  num_threads_ = num_threads;
+}
+
+int S2BufferOperation::Options::partition_level() const {
+  return partition_level_;
+}
+
+void S2BufferOperation::Options::set_partition_level(int partition_level) {
+  ABSL_DCHECK_GE(partition_level, 0);
+  ABSL_DCHECK_LE(partition_level, S2CellId::kMaxLevel);
+  partition_level_ = partition_level;
+}
+
+struct S2BufferOperation::Partition {
+  // The buffered output of this partition (unused when streaming).
+  MutableS2ShapeIndex index;
+
+  // Accumulates the buffered input layers of this partition.  This is reset
+  // as soon as the partition has been built.
+  unique_ptr<S2BufferOperation> op;
+};
+
 S2BufferOperation::S2BufferOperation() = default;
 
+S2BufferOperation::~S2BufferOperation() = default;
+
 S2BufferOperation::S2BufferOperation(unique_ptr<S2Builder::Layer> result_layer,
                                      const Options& options) {
   Init(std::move(result_layer), options);
@@ -285,7 +324,10 @@ S2BufferOperation::S2BufferOperation(unique_ptr<S2Builder::Layer> result_layer,
 
 void S2BufferOperation::Init(unique_ptr<S2Builder::Layer> result_layer,
                              const Options& options) {
+  ABSL_DCHECK(options.num_threads() <= 1 ||
+              options.memory_tracker() == nullptr);
   options_ = options;
+  num_polygon_layers_ = 0;
   ref_point_ = S2::Origin();
   ref_winding_ = 0;
   have_input_start_ = false;
@@ -336,14 +378,54 @@ void S2BufferOperation::Init(unique_ptr<S2Builder::Layer> result_layer,
   winding_options.set_include_degeneracies(
       buffer_sign_ == 0 && options_.buffer_radius() >= S1Angle::Zero());
   winding_options.set_memory_tracker(options.memory_tracker());
+
+  // Partitioning is only worthwhile when the buffer radius is positive,
+  // since otherwise the input may contain at most one polygon layer.
+  partitioned_ = options_.num_threads() > 1 && buffer_sign_ > 0;
+  layer_factory_ = nullptr;
+  partitions_.clear();
+  result_layer_.reset();
+  if (partitioned_) result_layer_ = std::move(result_layer);
   op_.Init(std::move(result_layer), winding_options);
   tracker_.Init(options.memory_tracker());
 }
 
+void S2BufferOperation::InitStreaming(PartitionLayerFactory layer_factory,
+                                      const Options& options) {
+  Init(nullptr, options);
+  partitioned_ = true;
+  layer_factory_ = std::move(layer_factory);
+}
+
 const S2BufferOperation::Options& S2BufferOperation::options() const {
   return options_;
 }
 
+// Returns the S2BufferOperation that buffers the input layers of the
+// partition containing "p", creating it if necessary.
+S2BufferOperation* S2BufferOperation::GetPartition(const S2Point& p) {
+  ABSL_DCHECK(partitioned_);
+  S2CellId id = S2CellId(p).parent(options_.partition_level());
+  unique_ptr<Partition>& partition = partitions_[id];
+  if (partition == nullptr) {
+    partition = make_unique<Partition>();
+    Options options = options_;
+    options.set_num_threads(1);
+    unique_ptr<S2Builder::Layer> layer;
+    if (layer_factory_) {
+      layer = layer_factory_(id);
+    } else {
+      // The snap function is applied when the partitions are merged.
+      options.set_snap_function(
+          s2builderutil::IdentitySnapFunction(S1Angle::Zero()));
+      layer = make_unique<s2builderutil::IndexedLaxPolygonLayer>(
+          &partition->index);
+    }
+    partition->op = make_unique<S2BufferOperation>(std::move(layer), options);
+  }
+  return partition->op.get();
+}
+
 S1Angle S2BufferOperation::GetMaxEdgeSpan(S1Angle radius,
                                           S1Angle requested_error) const {
   // If the allowable radius range spans Pi/2 then we can use edges as long as
@@ -444,6 +526,8 @@ void S2BufferOperation::AddFullPolygon() {
 }
 
 void S2BufferOperation::AddPoint(const S2Point& point) {
+  if (partitioned_) return GetPartition(point)->AddPoint(point);
+
   // If buffer_radius < 0, points are discarded.
   if (buffer_sign_ < 0) return;
 
@@ -653,6 +737,11 @@ void S2BufferOperation::BufferLoop(S2PointLoopSpan loop) {
 }
 
 void S2BufferOperation::AddPolyline(S2PointSpan polyline) {
+  if (partitioned_) {
+    if (!polyline.empty()) GetPartition(polyline[0])->AddPolyline(polyline);
+    return;
+  }
+
   // Left-sided buffering is supported by reversing the polyline and then
   // buffering on the right.
   vector<S2Point> reversed;
@@ -714,6 +803,7 @@ void S2BufferOperation::AddPolyline(S2PointSpan polyline) {
 
 void S2BufferOperation::AddLoop(S2PointLoopSpan loop) {
   if (loop.empty()) return;
+  if (partitioned_) return GetPartition(loop[0])->AddLoop(loop);
   BufferLoop(loop);
 
   // The vertex copying below could be avoided by adding a version of
@@ -744,12 +834,27 @@ void S2BufferOperation::BufferShape(const S2Shape& shape) {
 }
 
 void S2BufferOperation::AddShape(const S2Shape& shape) {
+  if (partitioned_) {
+    // Shapes with no edges are assigned to an arbitrary partition.
+    S2Point p = shape.num_edges() > 0 ? shape.edge(0).v0 : S2::Origin();
+    return GetPartition(p)->AddShape(shape);
+  }
   BufferShape(shape);
   ref_winding_ += s2shapeutil::ContainsBruteForce(shape, ref_point_);
   num_polygon_layers_ += (shape.dimension() == 2);
 }
 
 void S2BufferOperation::AddShapeIndex(const S2ShapeIndex& index) {
+  if (partitioned_) {
+    S2Point p = S2::Origin();
+    for (const S2Shape* shape : index) {
+      if (shape != nullptr && shape->num_edges() > 0) {
+        p = shape->edge(0).v0;
+        break;
+      }
+    }
+    return GetPartition(p)->AddShapeIndex(index);
+  }
   int max_dimension = -1;
   for (const S2Shape* shape : index) {
     if (shape == nullptr) continue;
@@ -761,11 +866,70 @@ void S2BufferOperation::AddShapeIndex(const S2ShapeIndex& index) {
 }
 
 bool S2BufferOperation::Build(S2Error* error) {
-  if (buffer_sign_ < 0 && num_polygon_layers_ > 1) {
+  int num_polygon_layers = num_polygon_layers_;
+  for (const auto& entry : partitions_) {
+    num_polygon_layers += entry.second->op->num_polygon_layers_;
+  }
+  if (buffer_sign_ < 0 && num_polygon_layers > 1) {
     error->Init(S2Error::FAILED_PRECONDITION,
                 "Negative buffer radius requires at most one polygon layer");
     return false;
   }
+  if (partitioned_) return BuildPartitions(error);
   return op_.Build(ref_point_, ref_winding_,
                    S2WindingOperation::WindingRule::POSITIVE, error);
 }
+
+bool S2BufferOperation::BuildPartitions(S2Error* error) {
+  vector<Partition*> partitions;
+  partitions.reserve(partitions_.size());
+  for (const auto& entry : partitions_) {
+    partitions.push_back(entry.second.get());
+  }
+
+  // Build the partitions concurrently.  The calling thread also builds
+  // partitions, and each one is claimed using an atomic counter.
+  const int n = partitions.size();
+  vector<S2Error> errors(n);
+  std::atomic<int> next(0);
+  auto build = [&]() {
+    for (int i; (i = next.fetch_add(1)) < n; ) {
+      Partition* partition = partitions[i];
+      partition->op->Build(&errors[i]);
+      partition->op.reset();
+      if (!layer_factory_) partition->index.ForceBuild();
+    }
+  };
+  vector<std::thread> threads;
+  for (int i = 1; i < min(options_.num_threads(), n); ++i) {
+    threads.emplace_back(build);
+  }
+  build();
+  for (auto& thread : threads) thread.join();
+  for (const S2Error& partition_error : errors) {
+    if (!partition_error.ok()) {
+      *error = partition_error;
+      partitions_.clear();
+      return false;
+    }
+  }
+  if (layer_factory_) {
+    partitions_.clear();
+    return true;
+  }
+
+  // Otherwise merge the buffered partitions into a single polygon.
+  vector<const S2ShapeIndex*> regions;
+  regions.reserve(n);
+  for (const Partition* partition : partitions) {
+    regions.push_back(&partition->index);
+  }
+  vector<unique_ptr<S2Builder::Layer>> layers;
+  layers.push_back(std::move(result_layer_));
+  bool ok = S2BooleanOperation::UnionAll(
+      regions, std::move(layers), error,
+      S2BooleanOperation::Options(options_.snap_function()),
+      options_.num_threads());
+  partitions_.clear();
+  return ok;
+}
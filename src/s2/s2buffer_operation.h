@@ -18,14 +18,17 @@
 #ifndef S2_S2BUFFER_OPERATION_H_
 #define S2_S2BUFFER_OPERATION_H_
 
+#include <functional>
 #include <memory>
 #include <vector>
 
 #include "s2/base/types.h"
+#include "absl/container/btree_map.h"
 #include "absl/log/absl_log.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s2builder.h"
+#include "s2/s2cell_id.h"
 #include "s2/s2error.h"
 #include "s2/s2memory_tracker.h"
 #include "s2/s2point.h"
@@ -206,6 +209,37 @@ class S2BufferOperation {
     S2MemoryTracker* memory_tracker() const;
     void set_memory_tracker(S2MemoryTracker* tracker);
 
+    // The maximum number of threads used by Build().  When this is greater
+    // than one and the buffer radius is positive, the input layers are
+    // partitioned according to the S2Cell at partition_level() that contains
+    // their first vertex, the partitions are buffered concurrently, and the
+    // results are merged using S2BooleanOperation::UnionAll.  This is much
+    // faster for inputs that consist of many small layers (e.g., a road
+    // network where each road is added as a separate polyline).
+    //
+    // The snap function is applied while merging the partitions rather than
+    // in a single step, so the output may differ slightly from the output
+    // computed using one thread.  The output does not otherwise depend on
+    // the number of threads.
+    //
+    // REQUIRES: memory_tracker() == nullptr if num_threads > 1
+    //           (S2MemoryTracker is not thread-safe).
+    //
+    // DEFAULT: 1
+    int num_threads() const;
+    void set_num_threads(int num_threads);
+
+    // The S2Cell level used to partition the input layers (see num_threads()
+    // and InitStreaming()).  Each input layer belongs to exactly one
+    // partition, so layers that are large compared to the partition cells
+    // (such as a continent-sized polygon) do not benefit from partitioning.
+    //
+    // REQUIRES: 0 <= partition_level() <= S2CellId::kMaxLevel
+    //
+    // DEFAULT: 6  (cells about 150 km across)
+    int partition_level() const;
+    void set_partition_level(int partition_level);
+
     // Options may be assigned and copied.
     Options(const Options& options);
     Options& operator=(const Options& options);
@@ -218,10 +252,19 @@ class S2BufferOperation {
     PolylineSide polyline_side_ = PolylineSide::BOTH;
     std::unique_ptr<S2Builder::SnapFunction> snap_function_;
     S2MemoryTracker* memory_tracker_ = nullptr;
+    int num_threads_ = 1;
+    int partition_level_ = 6;
   };
 
+  // A function that returns the S2Builder layer that should receive the
+  // buffered geometry of the partition with the given S2CellId (see
+  // InitStreaming).
+  using PartitionLayerFactory =
+      std::function<std::unique_ptr<S2Builder::Layer>(S2CellId partition)>;
+
   // Default constructor; requires Init() to be called.
   S2BufferOperation();
+  ~S2BufferOperation();
 
 #ifndef SWIG
   // Convenience constructor that calls Init().
@@ -239,6 +282,28 @@ class S2BufferOperation {
   void Init(std::unique_ptr<S2Builder::Layer> result_layer,
             const Options& options = Options());
 
+#ifndef SWIG
+  // Starts a buffer operation that streams its output one partition at a
+  // time rather than computing a single unified polygon.  The input layers
+  // are partitioned by S2Cell as described under Options::num_threads()
+  // (for any buffer radius), and the buffered geometry of each partition is
+  // sent to the layer returned by layer_factory(id), where "id" is the
+  // S2CellId at options.partition_level() that identifies the partition.
+  // This method may be called more than once.
+  //
+  // This is useful for clients that do not need one unified polygon, since
+  // the partitions are never merged and the intermediate geometry of each
+  // partition is discarded as soon as that partition has been built.  The
+  // union of the partition outputs is the buffered input, however the
+  // outputs of nearby partitions may overlap.
+  //
+  // "layer_factory" is called by the Add*() methods whenever an input layer
+  // is added to a partition that does not exist yet.  If num_threads() > 1
+  // then the layers of different partitions may be built concurrently.
+  void InitStreaming(PartitionLayerFactory layer_factory,
+                     const Options& options = Options());
+#endif
+
   const Options& options() const;
 
   // Each call below represents a different input layer.  Note that if the
@@ -282,14 +347,20 @@ class S2BufferOperation {
   void AddShapeIndex(const S2ShapeIndex& index);
 
   // Computes the union of the buffered input shapes and sends the output
-  // polygon to the S2Builder layer specified in the constructor.  Returns
-  // true on success and otherwise sets "error" appropriately.
+  // polygon to the S2Builder layer specified in the constructor (or to the
+  // partition layers specified by InitStreaming).  Returns true on success
+  // and otherwise sets "error" appropriately.
   //
   // Note that if the buffer radius is negative, only a single input layer is
   // allowed (ignoring any layers that contain only points and polylines).
   bool Build(S2Error* error);
 
  private:
+  // The buffered input layers and output of one partition.
+  struct Partition;
+
+  S2BufferOperation* GetPartition(const S2Point& p);
+  bool BuildPartitions(S2Error* error);
   S1Angle GetMaxEdgeSpan(S1Angle radius, S1Angle requested_error) const;
   void SetInputVertex(const S2Point& new_a);
   void AddOffsetVertex(const S2Point& new_b);
@@ -355,6 +426,16 @@ class S2BufferOperation {
   std::vector<S2Point> tmp_vertices_;
 
   S2MemoryTracker::Client tracker_;
+
+  // True if the input layers are sent to separate S2BufferOperations for
+  // each partition (see Options::num_threads) rather than buffered here.
+  bool partitioned_ = false;
+
+  // When partitioned_ is true, the final output goes either to the layers
+  // returned by layer_factory_ (if it is set) or to result_layer_.
+  PartitionLayerFactory layer_factory_;
+  std::unique_ptr<S2Builder::Layer> result_layer_;
+  absl::btree_map<S2CellId, std::unique_ptr<Partition>> partitions_;
 };
 
 #endif  // S2_S2BUFFER_OPERATION_H_
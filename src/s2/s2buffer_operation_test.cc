@@ -45,7 +45,9 @@
 #include "s2/s2boolean_operation.h"
 #include "s2/s2builder_layer.h"
 #include "s2/s2builderutil_lax_polygon_layer.h"
+#include "s2/s2builderutil_s2polygon_layer.h"
 #include "s2/s2builderutil_snap_functions.h"
+#include "s2/s2cap.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2closest_edge_query.h"
 #include "s2/s2closest_edge_query_base.h"
@@ -705,4 +707,135 @@ TEST(S2BufferOperation, ZigZagPolyline) {
   }
 }
 
+// Returns a road-like network of short random polylines scattered over a
+// region that spans many partitions.
+vector<vector<S2Point>> MakeRandomPolylines(int num_polylines) {
+  S2Testing::rnd.Reset(1);
+  S2Cap cap(s2textformat::MakePointOrDie("10:20"), S1Angle::Degrees(15));
+  vector<vector<S2Point>> polylines(num_polylines);
+  for (auto& polyline : polylines) {
+    polyline.push_back(S2Testing::SamplePoint(cap));
+    for (int i = 0, n = 1 + S2Testing::rnd.Uniform(4); i < n; ++i) {
+      polyline.push_back(S2Testing::SamplePoint(
+          S2Cap(polyline.back(), S1Angle::Degrees(0.5))));
+    }
+  }
+  return polylines;
+}
+
+unique_ptr<S2Polygon> BufferPolylines(
+    const vector<vector<S2Point>>& polylines,
+    const S2BufferOperation::Options& options) {
+  auto output = make_unique<S2Polygon>();
+  S2BufferOperation op(
+      make_unique<s2builderutil::S2PolygonLayer>(output.get()), options);
+  for (const auto& polyline : polylines) op.AddPolyline(polyline);
+  S2Error error;
+  EXPECT_TRUE(op.Build(&error)) << error;
+  return output;
+}
+
+TEST(S2BufferOperation, NumThreadsMatchesSequentialResult) {
+  auto polylines = MakeRandomPolylines(300);
+  S2BufferOperation::Options options(S1Angle::Degrees(0.2));
+  options.set_partition_level(3);
+  auto expected = BufferPolylines(polylines, options);
+  ASSERT_FALSE(expected->is_empty());
+  options.set_num_threads(2);
+  auto actual = BufferPolylines(polylines, options);
+  EXPECT_TRUE(actual->ApproxEquals(*expected, S1Angle::Degrees(1e-10)));
+
+  // The result does not depend on the exact number of threads.
+  options.set_num_threads(8);
+  EXPECT_TRUE(BufferPolylines(polylines, options)->Equals(*actual));
+}
+
+TEST(S2BufferOperation, NumThreadsMixedInput) {
+  // Check the other input methods, including a full polygon.
+  S2BufferOperation::Options options(S1Angle::Degrees(1));
+  options.set_num_threads(4);
+  options.set_partition_level(2);
+  auto output = make_unique<S2Polygon>();
+  S2BufferOperation op(
+      make_unique<s2builderutil::S2PolygonLayer>(output.get()), options);
+  op.AddPoint(s2textformat::MakePointOrDie("0:0"));
+  op.AddLoop(S2PointLoopSpan(
+      s2textformat::ParsePointsOrDie("40:40, 40:45, 45:40")));
+  op.AddShapeIndex(*s2textformat::MakeIndexOrDie("# -30:-30, -30:-20 #"));
+  S2Error error;
+  ASSERT_TRUE(op.Build(&error)) << error;
+  EXPECT_EQ(output->num_loops(), 3);
+  EXPECT_TRUE(output->Contains(s2textformat::MakePointOrDie("0:0.9")));
+  EXPECT_TRUE(output->Contains(s2textformat::MakePointOrDie("42:42")));
+  EXPECT_TRUE(output->Contains(s2textformat::MakePointOrDie("-30:-25")));
+
+  op.Init(make_unique<s2builderutil::S2PolygonLayer>(output.get()), options);
+  op.AddPoint(s2textformat::MakePointOrDie("0:0"));
+  op.AddShape(*s2textformat::MakeLaxPolygonOrDie("full"));
+  ASSERT_TRUE(op.Build(&error)) << error;
+  EXPECT_TRUE(output->is_full());
+}
+
+TEST(S2BufferOperation, InitStreaming) {
+  auto polylines = MakeRandomPolylines(300);
+  S2BufferOperation::Options options(S1Angle::Degrees(0.2));
+  options.set_partition_level(3);
+  auto expected = BufferPolylines(polylines, options);
+  for (int num_threads : {1, 4}) {
+    options.set_num_threads(num_threads);
+    vector<S2CellId> ids;
+    vector<unique_ptr<S2Polygon>> outputs;
+    S2BufferOperation op;
+    op.InitStreaming(
+        [&](S2CellId id) {
+          ids.push_back(id);
+          outputs.push_back(make_unique<S2Polygon>());
+          return make_unique<s2builderutil::S2PolygonLayer>(
+              outputs.back().get());
+        },
+        options);
+    for (const auto& polyline : polylines) {
+      op.AddPolyline(polyline);
+      // Every polyline belongs to the partition containing its first vertex.
+      auto it = std::find(ids.begin(), ids.end(),
+                          S2CellId(polyline[0]).parent(3));
+      ASSERT_TRUE(it != ids.end());
+    }
+    S2Error error;
+    ASSERT_TRUE(op.Build(&error)) << error;
+    EXPECT_GT(outputs.size(), 1);
+    for (const auto& output : outputs) EXPECT_FALSE(output->is_empty());
+    S2Polygon actual;
+    actual.InitToUnion(*outputs[0], *outputs[1]);
+    for (int i = 2; i < outputs.size(); ++i) {
+      S2Polygon tmp;
+      tmp.InitToUnion(actual, *outputs[i]);
+      actual = std::move(tmp);
+    }
+    EXPECT_TRUE(actual.ApproxEquals(*expected, S1Angle::Degrees(1e-10)));
+  }
+}
+
+TEST(S2BufferOperation, InitStreamingNegativeBufferRadiusMultipleLayers) {
+  // The restriction on negative buffer radii applies to the input as a
+  // whole, not to each partition.
+  vector<unique_ptr<S2Polygon>> outputs;
+  S2BufferOperation::Options options(S1Angle::Degrees(-0.1));
+  S2BufferOperation op;
+  op.InitStreaming(
+      [&](S2CellId id) {
+        outputs.push_back(make_unique<S2Polygon>());
+        return make_unique<s2builderutil::S2PolygonLayer>(
+            outputs.back().get());
+      },
+      options);
+  op.AddLoop(S2PointLoopSpan(s2textformat::ParsePointsOrDie("0:0, 0:1, 1:0")));
+  op.AddLoop(S2PointLoopSpan(
+      s2textformat::ParsePointsOrDie("50:50, 50:51, 51:50")));
+  EXPECT_EQ(outputs.size(), 2);
+  S2Error error;
+  EXPECT_FALSE(op.Build(&error));
+  EXPECT_EQ(error.code(), S2Error::FAILED_PRECONDITION);
+}
+
 }  // namespace
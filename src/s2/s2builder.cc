@@ -71,22 +71,28 @@
 #include <cstddef>
 
 #include <algorithm>
+#include <atomic>
 #include <cfloat>
 #include <cmath>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
+#include <new>
 #include <ostream>
 #include <utility>
 #include <vector>
 
 #include "absl/cleanup/cleanup.h"
 #include "absl/container/btree_map.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/container/inlined_vector.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
 #include "absl/types/span.h"
 
 #include "s2/base/casts.h"
+#include "s2/base/executor.h"
 #include "s2/base/log_severity.h"
 #include "s2/base/types.h"
 #include "s2/id_set_lexicon.h"
@@ -102,6 +108,7 @@
 #include "s2/s2closest_point_query.h"
 #include "s2/s2closest_point_query_base.h"
 #include "s2/s2crossing_edge_query.h"
+#include "s2/s2edge_crossing_cache.h"
 #include "s2/s2edge_crossings.h"
 #include "s2/s2edge_distances.h"
 #include "s2/s2error.h"
@@ -116,10 +123,12 @@
 #include "s2/s2shape.h"
 #include "s2/s2shapeutil_shape_edge.h"
 #include "s2/s2shapeutil_visit_crossing_edge_pairs.h"
+#include "s2/s2telemetry.h"
 #include "s2/s2text_format.h"
 #include "s2/util/bits/bits.h"
 #include "s2/util/gtl/compact_array.h"
 
+using absl::flat_hash_map;
 using absl::flat_hash_set;
 using gtl::compact_array;
 using std::make_unique;
@@ -146,7 +155,14 @@ S2Builder::Options::Options(const Options& options)
       intersection_tolerance_(options.intersection_tolerance_),
       simplify_edge_chains_(options.simplify_edge_chains_),
       idempotent_(options.idempotent_),
-      memory_tracker_(options.memory_tracker_) {
+      memory_tracker_(options.memory_tracker_),
+      memory_resource_(options.memory_resource_),
+      num_threads_(options.num_threads_),
+      executor_(options.executor_),
+      retain_capacity_(options.retain_capacity_),
+      deduplicate_input_edges_(options.deduplicate_input_edges_),
+      edge_crossing_cache_(options.edge_crossing_cache_),
+      tracer_(options.tracer_) {
 }
 
 S2Builder::Options& S2Builder::Options::operator=(const Options& options) {
@@ -156,6 +172,13 @@ S2Builder::Options& S2Builder::Options::operator=(const Options& options) {
   simplify_edge_chains_ = options.simplify_edge_chains_;
   idempotent_ = options.idempotent_;
   memory_tracker_ = options.memory_tracker_;
+  memory_resource_ = options.memory_resource_;
+  num_threads_ = options.num_threads_;
+  executor_ = options.executor_;
+  retain_capacity_ = options.retain_capacity_;
+  deduplicate_input_edges_ = options.deduplicate_input_edges_;
+  edge_crossing_cache_ = options.edge_crossing_cache_;
+  tracer_ = options.tracer_;
   return *this;
 }
 
@@ -209,6 +232,67 @@ static S1ChordAngle AddPointToEdgeError(S1ChordAngle ca) {
   return ca.PlusError(S2::GetUpdateMinDistanceMaxError(ca));
 }
 
+// Sets (*signs)[i] = s2pred::CompareEdgeDistance(point(i), x, y, r) for
+// 0 <= i < n, where "point" returns an S2Point.  The points are first copied
+// into arrays so that the batch predicate can be used.
+template <class PointFunction>
+static void CompareEdgeDistances(int n, PointFunction point,
+                                 const S2Point& x, const S2Point& y,
+                                 S1ChordAngle r,
+                                 absl::InlinedVector<int, 16>* signs) {
+  absl::InlinedVector<double, 16> xs(n), ys(n), zs(n);
+  for (int i = 0; i < n; ++i) {
+    const S2Point& p = point(i);
+    xs[i] = p.x();
+    ys[i] = p.y();
+    zs[i] = p.z();
+  }
+  signs->resize(n);
+  s2pred::BatchCompareEdgeDistance(
+      s2pred::PointArrays{xs, ys, zs}, x, y, r, absl::MakeSpan(*signs));
+}
+
+namespace {
+// Makes "v" allocate from the given memory resource.  (The allocator of a
+// std::pmr::vector cannot be changed by assignment, so instead the vector is
+// destroyed and reconstructed.)
+template <class T>
+void SetMemoryResource(std::pmr::memory_resource* resource,
+                       std::pmr::vector<T>* v) {
+  if (v->get_allocator().resource() == resource) return;
+  ABSL_DCHECK(v->empty());
+  v->~vector();
+  new (v) std::pmr::vector<T>(resource);
+}
+
+// Calls "fn(begin, end)" for a set of disjoint ranges that cover [0, n),
+// using up to "num_threads" threads (including the calling thread).  The
+// ranges are claimed one at a time so that the load stays balanced.
+// Additional threads are run on "executor" if it is non-null.
+template <class Fn>
+void ParallelFor(int n, int num_threads, s2base::Executor* executor,
+                 const Fn& fn) {
+  constexpr int kItemsPerChunk = 256;
+  const int num_chunks = (n + kItemsPerChunk - 1) / kItemsPerChunk;
+  std::atomic<int> next_chunk(0);
+  s2base::RunConcurrently(
+      executor, std::min(num_threads, num_chunks), [&]() {
+        for (int c; (c = next_chunk.fetch_add(1)) < num_chunks; ) {
+          int begin = c * kItemsPerChunk;
+          fn(begin, std::min(n, begin + kItemsPerChunk));
+        }
+      });
+}
+}  // namespace
+
+void S2Builder::SnapFunction::SnapPoints(absl::Span<const S2Point> points,
+                                         absl::Span<S2Point> sites) const {
+  ABSL_DCHECK_EQ(points.size(), sites.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    sites[i] = SnapPoint(points[i]);
+  }
+}
+
 S2Builder::S2Builder() = default;
 
 S2Builder::S2Builder(const Options& options) {
@@ -328,6 +412,12 @@ void S2Builder::Init(const Options& options) {
   snapping_needed_ = false;
 
   tracker_.Init(options.memory_tracker());
+
+  std::pmr::memory_resource* resource = options.memory_resource();
+  if (resource == nullptr) resource = std::pmr::get_default_resource();
+  SetMemoryResource(resource, &input_vertices_);
+  SetMemoryResource(resource, &input_edges_);
+  SetMemoryResource(resource, &edge_sites_);
 }
 
 void S2Builder::clear_labels() {
@@ -471,9 +561,14 @@ void S2Builder::AddPolygon(const S2Polygon& polygon) {
 }
 
 void S2Builder::AddShape(const S2Shape& shape) {
-  for (int e = 0, n = shape.num_edges(); e < n; ++e) {
-    S2Shape::Edge edge = shape.edge(e);
-    AddEdge(edge.v0, edge.v1);
+  for (int i = 0, num_chains = shape.num_chains(); i < num_chains; ++i) {
+    const int n = shape.chain(i).length;
+    S2PointSpan v = shape.chain_vertex_span(i);
+    for (int j = 0; j < n; ++j) {
+      S2Shape::Edge edge = v.empty() ? shape.chain_edge(i, j)
+                                     : S2Shape::ChainVertexSpanEdge(v, j);
+      AddEdge(edge.v0, edge.v1);
+    }
   }
 }
 
@@ -492,8 +587,8 @@ namespace {
 class VertexIdEdgeVectorShape final : public S2Shape {
  public:
   // Requires that "edges" is constant for the lifetime of this object.
-  VertexIdEdgeVectorShape(const vector<pair<int32, int32>>& edges,
-                          const vector<S2Point>& vertices)
+  VertexIdEdgeVectorShape(const std::pmr::vector<pair<int32, int32>>& edges,
+                          const std::pmr::vector<S2Point>& vertices)
       : edges_(edges), vertices_(vertices) {}
 
   const S2Point& vertex0(int e) const { return vertex(edges_[e].first); }
@@ -518,8 +613,8 @@ class VertexIdEdgeVectorShape final : public S2Shape {
  private:
   const S2Point& vertex(int i) const { return vertices_[i]; }
 
-  const vector<std::pair<int32, int32>>& edges_;
-  const vector<S2Point>& vertices_;
+  const std::pmr::vector<std::pair<int32, int32>>& edges_;
+  const std::pmr::vector<S2Point>& vertices_;
 };
 }  // namespace
 
@@ -531,6 +626,7 @@ bool S2Builder::Build(S2Error* error) {
   ABSL_CHECK(error != nullptr);
   error_ = error;
   error_->Clear();
+  S2_TELEMETRY_SCOPED_TIMER("s2builder.build_us");
 
   // Mark the end of the last layer.
   layer_begins_.push_back(input_edges_.size());
@@ -539,7 +635,12 @@ bool S2Builder::Build(S2Error* error) {
   if (snapping_requested_ && !options_.idempotent()) {
     snapping_needed_ = true;
   }
-  ChooseSites();
+  {
+    S2PhaseTracer::Scope scope(options_.tracer(), "S2Builder::ChooseSites",
+                               options_.memory_tracker());
+    ChooseSites();
+    scope.set_num_items(sites_.size());
+  }
   BuildLayers();
   Reset();
   if (!tracker_.ok()) *error_ = tracker_.error();
@@ -564,6 +665,7 @@ void S2Builder::Reset() {
 }
 
 void S2Builder::ChooseSites() {
+  S2_TELEMETRY_SCOPED_TIMER("s2builder.choose_sites_us");
   if (!tracker_.ok() || input_vertices_.empty()) return;
 
   // Note that although we always create an S2ShapeIndex, often it is not
@@ -574,10 +676,19 @@ void S2Builder::ChooseSites() {
   input_edge_index.Add(make_unique<VertexIdEdgeVectorShape>(input_edges_,
                                                             input_vertices_));
   if (options_.split_crossing_edges()) {
+    S2PhaseTracer::Scope scope(options_.tracer(), "S2Builder::AddEdgeCrossings",
+                               options_.memory_tracker());
+    const int64 num_vertices = input_vertices_.size();
     AddEdgeCrossings(input_edge_index);
+    scope.set_num_items(input_vertices_.size() - num_vertices);
   }
 
+  auto cleanup_duplicates = absl::MakeCleanup([this]() {
+    tracker_.Untally(duplicate_edges_);
+    vector<InputEdgeId>().swap(duplicate_edges_);
+  });
   if (snapping_requested_) {
+    if (options_.deduplicate_input_edges()) FindDuplicateInputEdges();
     S2PointIndex<SiteId> site_index;
     auto _ = absl::MakeCleanup([&]() { tracker_.DoneSiteIndex(site_index); });
     AddForcedSites(&site_index);
@@ -592,6 +703,27 @@ void S2Builder::ChooseSites() {
   }
 }
 
+// Sets duplicate_edges_[e] to the first input edge with the same endpoints as
+// edge "e", or -1 if there is none.  Edges are compared using their vertices
+// rather than their InputVertexIds, since AddVertex() only removes
+// consecutive duplicate vertices.
+void S2Builder::FindDuplicateInputEdges() {
+  const int num_edges = input_edges_.size();
+  if (!tracker_.AddSpaceExact(&duplicate_edges_, num_edges)) return;
+  using EdgeKey = pair<S2Point, S2Point>;
+  const int64 kTempPerEdge = sizeof(EdgeKey) + sizeof(InputEdgeId) + 1;
+  if (!tracker_.TallyTemp(num_edges * kTempPerEdge)) return;
+  flat_hash_map<EdgeKey, InputEdgeId> first_edges;
+  first_edges.reserve(num_edges);
+  duplicate_edges_.resize(num_edges);
+  for (InputEdgeId e = 0; e < num_edges; ++e) {
+    const InputEdge& edge = input_edges_[e];
+    auto [it, inserted] = first_edges.try_emplace(
+        EdgeKey(input_vertices_[edge.first], input_vertices_[edge.second]), e);
+    duplicate_edges_[e] = inserted ? -1 : it->second;
+  }
+}
+
 void S2Builder::ChooseAllVerticesAsSites() {
   // Sort the input vertices, discard duplicates, and use the result as the
   // list of sites.  (We sort in the same order used by ChooseInitialSites()
@@ -613,7 +745,8 @@ void S2Builder::ChooseAllVerticesAsSites() {
     }
     sites_.push_back(site);
   }
-  input_vertices_ = sites_;  // Does not change allocated size.
+  // Does not change allocated size.
+  input_vertices_.assign(sites_.begin(), sites_.end());
   for (InputEdge& e : input_edges_) {
     e.first = vmap[e.first];
     e.second = vmap[e.second];
@@ -696,18 +829,55 @@ void S2Builder::AddEdgeCrossings(const MutableS2ShapeIndex& input_edge_index) {
   if (!tracker_.ok()) return;
 
   // We need to build a list of intersections and add them afterwards so that
-  // we don't reallocate vertices_ during the VisitCrossings() call.
+  // we don't reallocate vertices_ during the VisitCrossings() call.  The
+  // crossing edge pairs are collected in batches so that their intersection
+  // points can be computed using S2::BatchGetIntersection().  With multiple
+  // threads the crossings are found concurrently (but visited in the same
+  // order as with one thread), and then all of their intersection points
+  // are computed concurrently.
+  vector<S2::CrossingEdgePair> crossings;
   vector<S2Point> new_vertices;
-  auto _ = absl::MakeCleanup([&]() { tracker_.Untally(new_vertices); });
-  s2shapeutil::VisitCrossingEdgePairs(
-      input_edge_index, s2shapeutil::CrossingType::INTERIOR,
-      [this, &new_vertices](const s2shapeutil::ShapeEdge& a,
-                            const s2shapeutil::ShapeEdge& b, bool) {
-        if (!tracker_.AddSpace(&new_vertices, 1)) return false;
-        new_vertices.push_back(
-            S2::GetIntersection(a.v0(), a.v1(), b.v0(), b.v1()));
-        return true;
-      });
+  auto _ = absl::MakeCleanup([&]() {
+    tracker_.Untally(crossings);
+    tracker_.Untally(new_vertices);
+  });
+  auto add_intersections = [&]() {
+    const int begin = new_vertices.size();
+    if (!tracker_.AddSpace(&new_vertices, crossings.size())) return false;
+    new_vertices.resize(begin + crossings.size());
+    S2EdgeCrossingCache* cache = options_.edge_crossing_cache();
+    ParallelFor(crossings.size(), num_threads(), options_.executor(),
+                [&](int i, int end) {
+                  auto pairs = absl::MakeConstSpan(&crossings[i], end - i);
+                  auto results =
+                      absl::MakeSpan(&new_vertices[begin + i], end - i);
+                  if (cache != nullptr) {
+                    cache->BatchGetIntersection(pairs, results);
+                  } else {
+                    S2::BatchGetIntersection(pairs, results);
+                  }
+                });
+    crossings.clear();
+    return true;
+  };
+  constexpr size_t kBatchSize = 256;
+  const bool single_batch = num_threads() > 1;
+  auto visitor = [&](const s2shapeutil::ShapeEdge& a,
+                     const s2shapeutil::ShapeEdge& b, bool) {
+    if (!tracker_.AddSpace(&crossings, 1)) return false;
+    crossings.push_back({a.v0(), a.v1(), b.v0(), b.v1()});
+    return single_batch || crossings.size() < kBatchSize ||
+           add_intersections();
+  };
+  if (num_threads() == 1) {
+    s2shapeutil::VisitCrossingEdgePairs(
+        input_edge_index, s2shapeutil::CrossingType::INTERIOR, visitor);
+  } else {
+    s2shapeutil::VisitCrossingEdgePairs(
+        input_edge_index, s2shapeutil::CrossingType::INTERIOR, num_threads(),
+        s2shapeutil::CrossingOrder::SEQUENTIAL, visitor);
+  }
+  if (!crossings.empty() && !add_intersections()) return;
   if (new_vertices.empty()) return;
 
   snapping_needed_ = true;
@@ -753,10 +923,35 @@ void S2Builder::ChooseInitialSites(S2PointIndex<SiteId>* site_index) {
   // Track the memory used by SortInputVertices() before calling it.
   if (!tracker_.Tally(input_vertices_.size() * sizeof(InputVertexKey))) return;
   vector<InputVertexKey> sorted_keys = SortInputVertices();
-  auto _ = absl::MakeCleanup([&]() { tracker_.Untally(sorted_keys); });
+  vector<S2Point> snapped_vertices;
+  auto _ = absl::MakeCleanup([&]() {
+    tracker_.Untally(sorted_keys);
+    tracker_.Untally(snapped_vertices);
+  });
+
+  // Snap all the input vertices before choosing any sites, since this lets
+  // the snap function process them in batches (see SnapPoints) and lets the
+  // work be divided among threads.
+  if (snapping_requested_) {
+    if (!tracker_.AddSpaceExact(&snapped_vertices, input_vertices_.size())) {
+      return;
+    }
+    snapped_vertices.resize(input_vertices_.size());
+    const SnapFunction& snap_function = options_.snap_function();
+    ParallelFor(input_vertices_.size(), num_threads(), options_.executor(),
+                [&](int begin, int end) {
+                  snap_function.SnapPoints(
+                      absl::MakeConstSpan(&input_vertices_[begin], end - begin),
+                      absl::MakeSpan(&snapped_vertices[begin], end - begin));
+                });
+  }
   for (const InputVertexKey& key : sorted_keys) {
     const S2Point& vertex = input_vertices_[key.second];
-    S2Point site = SnapSite(vertex);
+    S2Point site = vertex;
+    if (snapping_requested_) {
+      site = snapped_vertices[key.second];
+      CheckSnappedSite(vertex, site);
+    }
     // If any vertex moves when snapped, the output cannot be idempotent.
     snapping_needed_ = snapping_needed_ || site != vertex;
 
@@ -795,6 +990,14 @@ void S2Builder::ChooseInitialSites(S2PointIndex<SiteId>* site_index) {
 S2Point S2Builder::SnapSite(const S2Point& point) const {
   if (!snapping_requested_) return point;
   S2Point site = options_.snap_function().SnapPoint(point);
+  CheckSnappedSite(point, site);
+  return site;
+}
+
+// Reports an error if the snap function moved "point" to "site" by more than
+// the snap radius.
+void S2Builder::CheckSnappedSite(const S2Point& point,
+                                 const S2Point& site) const {
   S1ChordAngle dist_moved(site, point);
   if (dist_moved > site_snap_radius_ca_) {
     error_->Init(S2Error::BUILDER_SNAP_RADIUS_TOO_SMALL,
@@ -804,7 +1007,6 @@ S2Point S2Builder::SnapSite(const S2Point& point) const {
                  dist_moved.ToAngle().radians(),
                  site_snap_radius_ca_.ToAngle().radians());
   }
-  return site;
 }
 
 // For each edge, find all sites within edge_site_query_radius_ca_ and
@@ -818,11 +1020,17 @@ void S2Builder::CollectSiteEdges(const S2PointIndex<SiteId>& site_index) {
   // typically insignificant, and does not affect the high water mark.
   S2ClosestPointQueryOptions options;
   options.set_conservative_max_distance(edge_site_query_radius_ca_);
-  S2ClosestPointQuery<SiteId> site_query(&site_index, options);
-  vector<S2ClosestPointQuery<SiteId>::Result> results;
   if (!tracker_.AddSpaceExact(&edge_sites_, input_edges_.size())) return;
   edge_sites_.resize(input_edges_.size());  // Construct all elements.
-  for (InputEdgeId e = 0; static_cast<size_t>(e) < input_edges_.size(); ++e) {
+
+  // Finds the sites near edge "e" and stores them in edge_sites_[e].  Rather
+  // than modifying snapping_needed_ directly, sets "*snapping_needed" to true
+  // if any problems are found so that edges can be processed concurrently.
+  using Result = S2ClosestPointQuery<SiteId>::Result;
+  const auto find_edge_sites = [&](InputEdgeId e,
+                                   S2ClosestPointQuery<SiteId>* site_query,
+                                   vector<Result>* results,
+                                   bool* snapping_needed) {
     const InputEdge& edge = input_edges_[e];
     const S2Point& v0 = input_vertices_[edge.first];
     const S2Point& v1 = input_vertices_[edge.second];
@@ -831,21 +1039,67 @@ void S2Builder::CollectSiteEdges(const S2PointIndex<SiteId>& site_index) {
                 << ", " << s2textformat::ToString(v1) << "\n";
     }
     S2ClosestPointQueryEdgeTarget target(v0, v1);
-    site_query.FindClosestPoints(&target, &results);
+    site_query->FindClosestPoints(&target, results);
     auto* sites = &edge_sites_[e];
-    sites->reserve(results.size());
-    for (const auto& result : results) {
+    sites->reserve(results->size());
+    absl::InlinedVector<const S2Point*, 16> close_sites;
+    for (const auto& result : *results) {
       sites->push_back(result.data());
-      if (!snapping_needed_ &&
+      if (!*snapping_needed &&
           result.distance() < min_edge_site_separation_ca_limit_ &&
-          result.point() != v0 && result.point() != v1 &&
-          s2pred::CompareEdgeDistance(result.point(), v0, v1,
-                                      min_edge_site_separation_ca_) < 0) {
-        snapping_needed_ = true;
+          result.point() != v0 && result.point() != v1) {
+        close_sites.push_back(&result.point());
+      }
+    }
+    if (!close_sites.empty()) {
+      absl::InlinedVector<int, 16> signs;
+      CompareEdgeDistances(
+          close_sites.size(), [&](int i) { return *close_sites[i]; }, v0, v1,
+          min_edge_site_separation_ca_, &signs);
+      if (std::find(signs.begin(), signs.end(), -1) != signs.end()) {
+        *snapping_needed = true;
       }
     }
     SortSitesByDistance(v0, sites);
-    if (!tracker_.TallyEdgeSites(*sites)) return;
+  };
+
+  const int num_edges = input_edges_.size();
+  if (num_threads() == 1) {
+    S2ClosestPointQuery<SiteId> site_query(&site_index, options);
+    vector<Result> results;
+    for (InputEdgeId e = 0; e < num_edges; ++e) {
+      if (IsDuplicateInputEdge(e)) {
+        edge_sites_[e] = edge_sites_[duplicate_edges_[e]];
+      } else {
+        find_edge_sites(e, &site_query, &results, &snapping_needed_);
+      }
+      if (!tracker_.TallyEdgeSites(edge_sites_[e])) return;
+    }
+    return;
+  }
+  // Each thread uses its own query object.  The memory tracker is not
+  // thread-safe, so the sites are tallied after they have all been found.
+  std::atomic<bool> snapping_needed(false);
+  ParallelFor(num_edges, num_threads(), options_.executor(),
+              [&](int begin, int end) {
+                S2ClosestPointQuery<SiteId> site_query(&site_index, options);
+                vector<Result> results;
+                bool chunk_snapping_needed = snapping_needed_;
+                for (InputEdgeId e = begin; e < end; ++e) {
+                  if (IsDuplicateInputEdge(e)) continue;
+                  find_edge_sites(e, &site_query, &results,
+                                  &chunk_snapping_needed);
+                }
+                if (chunk_snapping_needed) {
+                  snapping_needed.store(true, std::memory_order_relaxed);
+                }
+              });
+  snapping_needed_ = snapping_needed_ || snapping_needed.load();
+  for (InputEdgeId e = 0; e < num_edges; ++e) {
+    if (IsDuplicateInputEdge(e)) {
+      edge_sites_[e] = edge_sites_[duplicate_edges_[e]];
+    }
+    if (!tracker_.TallyEdgeSites(edge_sites_[e])) return;
   }
 }
 
@@ -902,10 +1156,23 @@ void S2Builder::AddExtraSites(const MutableS2ShapeIndex& input_edge_index) {
   vector<SiteId> chain;  // Temporary storage.
   int num_edges_after_snapping = 0;
 
-  // CheckEdge() defines the body of the loops below.
-  const auto CheckEdge = [&](InputEdgeId e) -> bool {
+  // CheckEdge() defines the body of the loops below.  If "snapped" is not
+  // nullptr then it is the result of SnapEdge(e).
+  const auto CheckEdge = [&](InputEdgeId e,
+                             const compact_array<SiteId>* snapped) -> bool {
       if (!tracker_.ok()) return false;
-      SnapEdge(e, &chain);
+      if (IsDuplicateInputEdge(e)) {
+        // The edge has the same nearby sites as the first edge with the same
+        // endpoints (since AddExtraSite() updates both), so it snaps to the
+        // same chain and any extra sites are added by checking that edge.
+        edges_to_resnap.erase(e);
+        return true;
+      }
+      if (snapped == nullptr) {
+        SnapEdge(e, &chain);
+      } else {
+        chain.assign(snapped->begin(), snapped->end());
+      }
       edges_to_resnap.erase(e);
       num_edges_after_snapping += chain.size();
       MaybeAddExtraSites(e, chain, input_edge_index, &edges_to_resnap);
@@ -915,8 +1182,23 @@ void S2Builder::AddExtraSites(const MutableS2ShapeIndex& input_edge_index) {
   // The first pass is different because we snap every edge.  In the following
   // passes we only snap edges that are near the extra sites that were added.
   ABSL_VLOG(1) << "Before pass 0: sites=" << sites_.size();
-  for (InputEdgeId e = 0; static_cast<size_t>(e) < input_edges_.size(); ++e) {
-    if (!CheckEdge(e)) return;
+  const int num_edges = input_edges_.size();
+  if (num_threads() == 1) {
+    for (InputEdgeId e = 0; e < num_edges; ++e) {
+      if (!CheckEdge(e, nullptr)) return;
+    }
+  } else {
+    // Snap all the edges in parallel before checking them in order.  The
+    // nearby sites of an edge are only modified by AddExtraSite(), which also
+    // adds the edge to "edges_to_resnap", so any edge in that set is snapped
+    // again to get the same result as the sequential algorithm.
+    vector<compact_array<SiteId>> chains;
+    auto _ = absl::MakeCleanup([&]() { tracker_.Untally(chains); });
+    if (!SnapEdgesInParallel(0, num_edges, &chains)) return;
+    for (InputEdgeId e = 0; e < num_edges; ++e) {
+      bool resnap = edges_to_resnap.contains(e);
+      if (!CheckEdge(e, resnap ? nullptr : &chains[e])) return;
+    }
   }
   ABSL_VLOG(1) << "Pass 0: edges snapped=" << input_edges_.size()
                << ", output edges=" << num_edges_after_snapping
@@ -927,7 +1209,7 @@ void S2Builder::AddExtraSites(const MutableS2ShapeIndex& input_edge_index) {
     edges_to_resnap.clear();
     num_edges_after_snapping = 0;
     for (InputEdgeId e : edges_to_snap) {
-      if (!CheckEdge(e)) return;
+      if (!CheckEdge(e, nullptr)) return;
     }
     ABSL_VLOG(1) << "Pass " << num_passes
                  << ": edges snapped=" << edges_to_snap.size()
@@ -1182,16 +1464,21 @@ void S2Builder::SnapEdge(InputEdgeId e, vector<SiteId>* chain) const {
 
   // Now iterate through the sites.  We keep track of the sequence of sites
   // that are visited.
+  //
+  // We skip any sites that are too far away.  (There will be some of these,
+  // because we also keep track of "sites to avoid".)  Note that some sites
+  // may be close enough to the line containing the edge, but not to the
+  // edge itself, so we can just use the dot product with the edge normal.
+  // The distances to all candidate sites are compared in one batch.
   const auto& candidates = edge_sites_[e];
-  for (SiteId site_id : candidates) {
+  absl::InlinedVector<int, 16> signs;
+  CompareEdgeDistances(
+      candidates.size(), [&](int i) { return sites_[candidates[i]]; }, x, y,
+      edge_snap_radius_ca_, &signs);
+  for (int k = 0; k < candidates.size(); ++k) {
+    if (signs[k] > 0) continue;
+    const SiteId site_id = candidates[k];
     const S2Point& c = sites_[site_id];
-    // Skip any sites that are too far away.  (There will be some of these,
-    // because we also keep track of "sites to avoid".)  Note that some sites
-    // may be close enough to the line containing the edge, but not to the
-    // edge itself, so we can just use the dot product with the edge normal.
-    if (s2pred::CompareEdgeDistance(c, x, y, edge_snap_radius_ca_) > 0) {
-      continue;
-    }
     // Check whether the new site C excludes the previous site B.  If so,
     // repeat with the previous site, and so on.
     bool add_site_c = true;
@@ -1259,23 +1546,66 @@ void S2Builder::SnapEdge(InputEdgeId e, vector<SiteId>* chain) const {
   }
 }
 
+int S2Builder::num_threads() const {
+  // Verbose output is only useful when the edges are processed in order.
+  return s2builder_verbose ? 1 : max(1, options_.num_threads());
+}
+
+// Sets (*chains)[e - begin] to the result of SnapEdge(e) for every input edge
+// "e" in [begin, end), using up to num_threads() threads.  The memory used by
+// "chains" is tallied and should be untallied by the caller.  Returns false
+// if the memory limit was exceeded.
+bool S2Builder::SnapEdgesInParallel(InputEdgeId begin, InputEdgeId end,
+                                    vector<compact_array<SiteId>>* chains) {
+  if (!tracker_.AddSpaceExact(chains, end - begin)) return false;
+  chains->resize(end - begin);
+  ParallelFor(end - begin, num_threads(), options_.executor(),
+              [&](int i_begin, int i_end) {
+                vector<SiteId> chain;
+                for (int i = i_begin; i < i_end; ++i) {
+                  SnapEdge(begin + i, &chain);
+                  (*chains)[i] =
+                      compact_array<SiteId>(chain.begin(), chain.end());
+                }
+              });
+  return true;
+}
+
 void S2Builder::BuildLayers() {
+  S2_TELEMETRY_SCOPED_TIMER("s2builder.build_layers_us");
   if (!tracker_.ok()) return;
 
   // Each output edge has an "input edge id set id" (an int32) representing
   // the set of input edge ids that were snapped to this edge.  The actual
-  // InputEdgeIds can be retrieved using "input_edge_id_set_lexicon".
-  vector<vector<Edge>> layer_edges;
-  vector<vector<InputEdgeIdSetId>> layer_input_edge_ids;
-  IdSetLexicon input_edge_id_set_lexicon;
+  // InputEdgeIds can be retrieved using "input_edge_id_set_lexicon_".
+  //
+  // If capacity was retained from a previous call to Build(), first discard
+  // the storage of any layers that no longer exist.
+  for (size_t i = layers_.size(); i < layer_edges_.size(); ++i) {
+    tracker_.Untally(layer_edges_[i]);
+    tracker_.Untally(layer_input_edge_ids_[i]);
+  }
+  if (layer_edges_.size() > layers_.size()) {
+    layer_edges_.resize(layers_.size());
+    layer_input_edge_ids_.resize(layers_.size());
+  }
   vector<vector<S2Point>> layer_vertices;
-  BuildLayerEdges(&layer_edges, &layer_input_edge_ids,
-                  &input_edge_id_set_lexicon);
+  BuildLayerEdges(&layer_edges_, &layer_input_edge_ids_,
+                  &input_edge_id_set_lexicon_);
   auto _ = absl::MakeCleanup([&]() {
-    for (size_t i = 0; i < layers_.size(); ++i) {
-      tracker_.Untally(layer_edges[i]);
-      tracker_.Untally(layer_input_edge_ids[i]);
-      if (!layer_vertices.empty()) tracker_.Untally(layer_vertices[i]);
+    for (const auto& vertices : layer_vertices) tracker_.Untally(vertices);
+    if (options_.retain_capacity()) {
+      for (auto& edges : layer_edges_) edges.clear();
+      for (auto& input_edge_ids : layer_input_edge_ids_) input_edge_ids.clear();
+      input_edge_id_set_lexicon_.Clear();
+    } else {
+      for (size_t i = 0; i < layer_edges_.size(); ++i) {
+        tracker_.Untally(layer_edges_[i]);
+        tracker_.Untally(layer_input_edge_ids_[i]);
+      }
+      vector<vector<Edge>>().swap(layer_edges_);
+      vector<vector<InputEdgeIdSetId>>().swap(layer_input_edge_ids_);
+      input_edge_id_set_lexicon_ = IdSetLexicon();
     }
   });
 
@@ -1298,30 +1628,68 @@ void S2Builder::BuildLayers() {
       // (i.e., if the same vertex is referred to by multiple layers), it
       // never increases storage quadratically because there can be at most
       // two filtered vertices per edge.
-      if (!tracker_.TallyFilterVertices(sites_.size(), layer_edges)) return;
+      if (!tracker_.TallyFilterVertices(sites_.size(), layer_edges_)) return;
       auto _ = absl::MakeCleanup([this]() { tracker_.DoneFilterVertices(); });
       layer_vertices.resize(layers_.size());
       vector<Graph::VertexId> filter_tmp;  // Temporary used by FilterVertices.
       for (size_t i = 0; i < layers_.size(); ++i) {
-        layer_vertices[i] = Graph::FilterVertices(sites_, &layer_edges[i],
+        layer_vertices[i] = Graph::FilterVertices(sites_, &layer_edges_[i],
                                                   &filter_tmp);
         if (!tracker_.Tally(layer_vertices[i])) return;
       }
-      tracker_.Clear(&sites_);  // Releases memory.
+      if (!options_.retain_capacity()) tracker_.Clear(&sites_);
     }
   }
   if (!tracker_.ok()) return;
 
-  for (size_t i = 0; i < layers_.size(); ++i) {
+  // Don't free the layer data until all layers have been built, in order to
+  // support building multiple layers at once (e.g. ClosedSetNormalizer).
+  const auto build_layer = [&](int i, S2Error* error) {
+    S2PhaseTracer::Scope scope(options_.tracer(), "S2Builder::BuildLayer",
+                               options_.memory_tracker());
+    scope.set_num_items(layer_edges_[i].size());
     const vector<S2Point>& vertices = (layer_vertices.empty() ?
                                        sites_ : layer_vertices[i]);
-    Graph graph(layer_options_[i], &vertices, &layer_edges[i],
-                &layer_input_edge_ids[i], &input_edge_id_set_lexicon,
+    Graph graph(layer_options_[i], &vertices, &layer_edges_[i],
+                &layer_input_edge_ids_[i], &input_edge_id_set_lexicon_,
                 &label_set_ids_, &label_set_lexicon_,
                 layer_is_full_polygon_predicates_[i]);
-    layers_[i]->Build(graph, error_);
-    // Don't free the layer data until all layers have been built, in order to
-    // support building multiple layers at once (e.g. ClosedSetNormalizer).
+    layers_[i]->Build(graph, error);
+  };
+  vector<int> concurrent_layers;
+  if (num_threads() > 1 && error_->ok()) {
+    for (size_t i = 0; i < layers_.size(); ++i) {
+      if (layers_[i]->supports_concurrent_build()) {
+        concurrent_layers.push_back(i);
+      }
+    }
+  }
+  if (concurrent_layers.size() < 2) {
+    for (size_t i = 0; i < layers_.size(); ++i) build_layer(i, error_);
+    return;
+  }
+  // Each layer reports errors separately so that the error returned does not
+  // depend on the order in which the layers finish.  The layers that do not
+  // support concurrent building are built afterwards on this thread.
+  vector<S2Error> errors(layers_.size());
+  std::atomic<int> next_layer(0);
+  s2base::RunConcurrently(
+      options_.executor(),
+      std::min<int>(num_threads(), concurrent_layers.size()), [&]() {
+        for (int k; (k = next_layer.fetch_add(1)) <
+                    static_cast<int>(concurrent_layers.size()); ) {
+          const int i = concurrent_layers[k];
+          build_layer(i, &errors[i]);
+        }
+      });
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    if (!layers_[i]->supports_concurrent_build()) build_layer(i, &errors[i]);
+  }
+  for (const S2Error& error : errors) {
+    if (!error.ok()) {
+      *error_ = error;
+      break;
+    }
   }
 }
 
@@ -1342,6 +1710,13 @@ static void DumpEdges(const vector<S2Builder::Graph::Edge>& edges,
 //
 // This method is not "const" because Graph::ProcessEdges can modify
 // layer_options_ in some cases (changing undirected edges to directed ones).
+// Returns the total number of edges in all layers.
+static int64 CountEdges(const vector<vector<S2Builder::Graph::Edge>>& edges) {
+  int64 count = 0;
+  for (const auto& layer : edges) count += layer.size();
+  return count;
+}
+
 void S2Builder::BuildLayerEdges(
     vector<vector<Edge>>* layer_edges,
     vector<vector<InputEdgeIdSetId>>* layer_input_edge_ids,
@@ -1356,26 +1731,49 @@ void S2Builder::BuildLayerEdges(
 
   layer_edges->resize(layers_.size());
   layer_input_edge_ids->resize(layers_.size());
-  for (size_t i = 0; i < layers_.size(); ++i) {
-    AddSnappedEdges(layer_begins_[i], layer_begins_[i+1], layer_options_[i],
-                    &(*layer_edges)[i], &(*layer_input_edge_ids)[i],
-                    input_edge_id_set_lexicon, &site_vertices);
+
+  // When several threads are available, all the input edges are snapped in
+  // parallel first.  (The results are identical since SnapEdge() does not
+  // depend on the order in which edges are snapped.)
+  vector<compact_array<SiteId>> chains;
+  auto _ = absl::MakeCleanup([&]() { tracker_.Untally(chains); });
+  {
+    S2PhaseTracer::Scope scope(options_.tracer(), "S2Builder::SnapEdges",
+                               options_.memory_tracker());
+    if (num_threads() > 1 && snapping_needed_) {
+      if (!SnapEdgesInParallel(0, input_edges_.size(), &chains)) return;
+    }
+    for (size_t i = 0; i < layers_.size(); ++i) {
+      absl::Span<const compact_array<SiteId>> layer_chains;
+      if (!chains.empty()) {
+        layer_chains = absl::MakeConstSpan(chains).subspan(
+            layer_begins_[i], layer_begins_[i + 1] - layer_begins_[i]);
+      }
+      AddSnappedEdges(layer_begins_[i], layer_begins_[i+1], layer_options_[i],
+                      &(*layer_edges)[i], &(*layer_input_edge_ids)[i],
+                      input_edge_id_set_lexicon, &site_vertices, layer_chains);
+    }
+    scope.set_num_items(CountEdges(*layer_edges));
   }
 
   // We simplify edge chains before processing the per-layer GraphOptions
   // because simplification can create duplicate edges and/or sibling edge
   // pairs which may need to be removed.
   if (simplify) {
+    S2PhaseTracer::Scope scope(options_.tracer(),
+                               "S2Builder::SimplifyEdgeChains",
+                               options_.memory_tracker());
     SimplifyEdgeChains(site_vertices, layer_edges, layer_input_edge_ids,
                        input_edge_id_set_lexicon);
     vector<compact_array<InputVertexId>>().swap(site_vertices);
+    scope.set_num_items(CountEdges(*layer_edges));
   }
 
   // At this point we have no further need for nearby site data, so we clear
   // it to save space.  We keep input_vertices_ and input_edges_ so that
   // S2Builder::Layer implementations can access them if desired.  (This is
   // useful for determining how snapping has changed the input geometry.)
-  tracker_.ClearEdgeSites(&edge_sites_);
+  tracker_.ClearEdgeSites(&edge_sites_, options_.retain_capacity());
   for (size_t i = 0; i < layers_.size(); ++i) {
     // The errors generated by ProcessEdges are really warnings, so we simply
     // record them and continue.
@@ -1389,18 +1787,24 @@ void S2Builder::BuildLayerEdges(
 // Snaps all the input edges for a given layer, populating the given output
 // arguments.  If (*site_vertices) is non-empty then it is updated so that
 // (*site_vertices)[site] contains a list of all input vertices that were
-// snapped to that site.
+// snapped to that site.  If "chains" is non-empty then chains[e - begin] is
+// the result of SnapEdge(e).
 void S2Builder::AddSnappedEdges(
     InputEdgeId begin, InputEdgeId end, const GraphOptions& options,
     vector<Edge>* edges, vector<InputEdgeIdSetId>* input_edge_ids,
     IdSetLexicon* input_edge_id_set_lexicon,
-    vector<compact_array<InputVertexId>>* site_vertices) {
+    vector<compact_array<InputVertexId>>* site_vertices,
+    absl::Span<const compact_array<SiteId>> chains) {
   bool discard_degenerate_edges = (options.degenerate_edges() ==
                                    GraphOptions::DegenerateEdges::DISCARD);
   vector<SiteId> chain;
   for (InputEdgeId e = begin; e < end; ++e) {
     InputEdgeIdSetId id = input_edge_id_set_lexicon->AddSingleton(e);
-    SnapEdge(e, &chain);
+    if (chains.empty()) {
+      SnapEdge(e, &chain);
+    } else {
+      chain.assign(chains[e - begin].begin(), chains[e - begin].end());
+    }
     if (chain.empty()) {
       continue;
     }
@@ -1487,14 +1891,23 @@ class S2Builder::EdgeChainSimplifier {
   int graph_edge_layer(EdgeId e) const;
   int input_edge_layer(InputEdgeId id) const;
   bool IsInterior(VertexId v);
-  void SimplifyChain(VertexId v0, VertexId v1);
+  template <class OutputEdgeFn, class SimplifyChainFn>
+  void VisitChains(const OutputEdgeFn& output_edge,
+                   const SimplifyChainFn& simplify_chain);
+  void RunConcurrently();
+  void GetChain(VertexId v0, VertexId v1, vector<VertexId>* chain) const;
+  void GetSubchainEnds(absl::Span<const VertexId> chain,
+                       flat_hash_set<VertexId>* used_vertices,
+                       absl::Span<char> is_end) const;
+  void OutputChain(absl::Span<const VertexId> chain,
+                   absl::Span<const char> is_end);
   Graph::VertexId FollowChain(VertexId v0, VertexId v1) const;
   void OutputAllEdges(VertexId v0, VertexId v1);
   bool TargetInputVertices(VertexId v, S2PolylineSimplifier* simplifier) const;
   bool AvoidSites(VertexId v0, VertexId v1, VertexId v2,
                   flat_hash_set<VertexId>* used_vertices,
                   S2PolylineSimplifier* simplifier) const;
-  void MergeChain(const vector<VertexId>& vertices);
+  void MergeChain(absl::Span<const VertexId> vertices);
   void AssignDegenerateEdges(
       const vector<InputEdgeId>& degenerate_ids,
       vector<vector<InputEdgeId>>* merged_ids) const;
@@ -1525,6 +1938,7 @@ class S2Builder::EdgeChainSimplifier {
   // Temporary objects declared here to avoid repeated allocation.
   vector<VertexId> tmp_vertices_;
   vector<EdgeId> tmp_edges_;
+  vector<char> tmp_is_end_;
   flat_hash_set<VertexId> tmp_vertex_set_;
 
   // The output edges after simplification.
@@ -1540,7 +1954,10 @@ void S2Builder::SimplifyEdgeChains(
     vector<vector<InputEdgeIdSetId>>* layer_input_edge_ids,
     IdSetLexicon* input_edge_id_set_lexicon) {
   if (layers_.empty()) return;
-  if (!tracker_.TallySimplifyEdgeChains(site_vertices, *layer_edges)) return;
+  if (!tracker_.TallySimplifyEdgeChains(site_vertices, *layer_edges,
+                                        num_threads() > 1)) {
+    return;
+  }
 
   // Merge the edges from all layers (in order to build a single graph).
   vector<Edge> merged_edges;
@@ -1637,6 +2054,39 @@ void S2Builder::EdgeChainSimplifier::Run() {
   for (VertexId v = 0; v < g_.num_vertices(); ++v) {
     is_interior_[v] = IsInterior(v);
   }
+  if (builder_.num_threads() > 1) {
+    RunConcurrently();
+  } else {
+    VisitChains([this](EdgeId e) { OutputEdge(e); },
+                [this](const vector<VertexId>& chain) {
+                  tmp_is_end_.assign(chain.size(), false);
+                  GetSubchainEnds(chain, &tmp_vertex_set_,
+                                  absl::MakeSpan(tmp_is_end_));
+                  OutputChain(chain, tmp_is_end_);
+                });
+  }
+  // TODO(ericv): The graph is not needed past here, so we could save some
+  // memory by clearing the underlying Edge and InputEdgeIdSetId vectors.
+
+  // Finally, copy the output edges into the appropriate layers.  They don't
+  // need to be sorted because the input edges were also unsorted.
+  for (size_t e = 0; e < new_edges_.size(); ++e) {
+    int layer = new_edge_layers_[e];
+    (*layer_edges_)[layer].push_back(new_edges_[e]);
+    (*layer_input_edge_ids_)[layer].push_back(new_input_edge_ids_[e]);
+  }
+}
+
+// Calls "output_edge(e)" for each unused edge that should be copied to the
+// output unchanged, and "simplify_chain(chain)" for the vertices of each edge
+// chain that should be simplified (see GetChain), in the order that they
+// should be output.  The callbacks are responsible for marking the edges
+// that they consume as used.
+template <class OutputEdgeFn, class SimplifyChainFn>
+void S2Builder::EdgeChainSimplifier::VisitChains(
+    const OutputEdgeFn& output_edge, const SimplifyChainFn& simplify_chain) {
+  vector<VertexId>& chain = tmp_vertices_;  // Avoid allocating each time.
+
   // Attempt to simplify all edge chains that start from a non-interior
   // vertex.  (This takes care of all chains except loops.)
   for (EdgeId e = 0; e < g_.num_edges(); ++e) {
@@ -1644,9 +2094,10 @@ void S2Builder::EdgeChainSimplifier::Run() {
     Edge edge = g_.edge(e);
     if (is_interior_[edge.first]) continue;
     if (!is_interior_[edge.second]) {
-      OutputEdge(e);  // An edge between two non-interior vertices.
+      output_edge(e);  // An edge between two non-interior vertices.
     } else {
-      SimplifyChain(edge.first, edge.second);
+      GetChain(edge.first, edge.second, &chain);
+      simplify_chain(chain);
     }
   }
   // If there are any edges left, they form one or more disjoint loops where
@@ -1668,20 +2119,74 @@ void S2Builder::EdgeChainSimplifier::Run() {
       // Note that it is safe to output degenerate edges as we go along,
       // because this vertex has at least one non-degenerate outgoing edge and
       // therefore we will (or just did) start an edge chain here.
-      OutputEdge(e);
+      output_edge(e);
     } else {
-      SimplifyChain(edge.first, edge.second);
+      GetChain(edge.first, edge.second, &chain);
+      simplify_chain(chain);
     }
   }
-  // TODO(ericv): The graph is not needed past here, so we could save some
-  // memory by clearing the underlying Edge and InputEdgeIdSetId vectors.
+}
 
-  // Finally, copy the output edges into the appropriate layers.  They don't
-  // need to be sorted because the input edges were also unsorted.
-  for (size_t e = 0; e < new_edges_.size(); ++e) {
-    int layer = new_edge_layers_[e];
-    (*layer_edges_)[layer].push_back(new_edges_[e]);
-    (*layer_input_edge_ids_)[layer].push_back(new_input_edge_ids_[e]);
+// Like the sequential version of Run(), except that the edge chains are
+// simplified concurrently.  Since the chains do not depend on how other
+// chains are simplified, they are first collected along with the edges that
+// are output unchanged, then simplified using multiple threads, and finally
+// output in their original order.  The output is therefore identical.
+void S2Builder::EdgeChainSimplifier::RunConcurrently() {
+  // Each action either outputs the edge "edge" (if chain < 0) or simplifies
+  // the edge chain "chain".
+  struct Action {
+    EdgeId edge;
+    int chain;
+  };
+  vector<Action> actions;
+  vector<VertexId> chain_vertices;  // The vertices of all chains.
+  vector<int> chain_begin;          // The first vertex of each chain.
+  VisitChains(
+      [&](EdgeId e) {
+        actions.push_back(Action{e, -1});
+        used_[e] = true;
+      },
+      [&](const vector<VertexId>& chain) {
+        // Simplifying a chain marks all the edges between its consecutive
+        // vertices as used.  Degenerate edges that are merged into a chain
+        // are handled below, since this depends on how the chain is split.
+        actions.push_back(Action{-1, static_cast<int>(chain_begin.size())});
+        chain_begin.push_back(chain_vertices.size());
+        chain_vertices.insert(chain_vertices.end(), chain.begin(), chain.end());
+        for (size_t i = 1; i < chain.size(); ++i) {
+          VertexId v0 = chain[i - 1], v1 = chain[i];
+          for (EdgeId e : out_.edge_ids(v0, v1)) used_[e] = true;
+          for (EdgeId e : out_.edge_ids(v1, v0)) used_[e] = true;
+        }
+      });
+  chain_begin.push_back(chain_vertices.size());
+
+  const auto get_chain = [&](int i) {
+    return absl::MakeConstSpan(chain_vertices).subspan(
+        chain_begin[i], chain_begin[i + 1] - chain_begin[i]);
+  };
+  vector<char> is_end(chain_vertices.size(), false);
+  ParallelFor(chain_begin.size() - 1, builder_.num_threads(),
+              builder_.options_.executor(), [&](int begin, int end) {
+                flat_hash_set<VertexId> used_vertices;
+                for (int i = begin; i < end; ++i) {
+                  GetSubchainEnds(get_chain(i), &used_vertices,
+                                  absl::MakeSpan(is_end).subspan(
+                                      chain_begin[i], get_chain(i).size()));
+                }
+              });
+
+  // Now output everything in order, starting again from scratch.
+  used_.assign(used_.size(), false);
+  for (const Action& action : actions) {
+    if (action.chain < 0) {
+      if (!used_[action.edge]) OutputEdge(action.edge);
+    } else {
+      absl::Span<const VertexId> chain = get_chain(action.chain);
+      OutputChain(chain, absl::MakeConstSpan(is_end).subspan(
+                             chain_begin[action.chain], chain.size()));
+    }
   }
 }
 
@@ -1808,52 +2313,74 @@ bool S2Builder::EdgeChainSimplifier::IsInterior(VertexId v) {
   return true;
 }
 
-// Follows the edge chain starting with (v0, v1) until either we find a
-// non-interior vertex or we return to the original vertex v0.  At each vertex
-// we simplify a subchain of edges that is as long as possible.
-void S2Builder::EdgeChainSimplifier::SimplifyChain(VertexId v0, VertexId v1) {
-  // Avoid allocating "chain" each time by reusing it.
-  vector<VertexId>& chain = tmp_vertices_;
-  // Contains the set of vertices that have either been avoided or added to
-  // the chain so far.  This is necessary so that AvoidSites() doesn't try to
-  // avoid vertices that have already been added to the chain.
-  flat_hash_set<VertexId>& used_vertices = tmp_vertex_set_;
+// Sets "chain" to the vertices of the edge chain starting with (v0, v1),
+// which continues until either we find a non-interior vertex or we return to
+// the original vertex v0.
+void S2Builder::EdgeChainSimplifier::GetChain(VertexId v0, VertexId v1,
+                                              vector<VertexId>* chain) const {
+  const VertexId vstart = v0;
+  chain->clear();
+  chain->push_back(v0);
+  for (;;) {
+    chain->push_back(v1);
+    if (!is_interior_[v1] || v1 == vstart) break;
+    const VertexId vnext = FollowChain(v0, v1);
+    v0 = v1;
+    v1 = vnext;
+  }
+}
+
+// Divides the given edge chain into subchains that can each be replaced by a
+// single edge, by simplifying a subchain that is as long as possible at each
+// vertex.  Sets is_end[i] to true for each vertex "i" where a subchain ends.
+// "used_vertices" is used as temporary storage.
+void S2Builder::EdgeChainSimplifier::GetSubchainEnds(
+    absl::Span<const VertexId> chain, flat_hash_set<VertexId>* used_vertices,
+    absl::Span<char> is_end) const {
   S2PolylineSimplifier simplifier;
-  VertexId vstart = v0;
-  bool done = false;
-  do {
-    // Simplify a subchain of edges starting with (v0, v1).
-    chain.push_back(v0);
-    used_vertices.insert(v0);
-    simplifier.Init(g_.vertex(v0));
-    // Note that if the first edge (v0, v1) is longer than the maximum length
-    // allowed for simplification, then AvoidSites() will return false and we
-    // exit the loop below after the first iteration.
-    const bool simplify = AvoidSites(v0, v0, v1, &used_vertices, &simplifier);
-    do {
-      chain.push_back(v1);
-      used_vertices.insert(v1);
-      done = !is_interior_[v1] || v1 == vstart;
-      if (done) break;
-
-      // Attempt to extend the chain to the next vertex.
-      VertexId vprev = v0;
-      v0 = v1;
-      v1 = FollowChain(vprev, v0);
-    } while (simplify && TargetInputVertices(v0, &simplifier) &&
-             AvoidSites(chain[0], v0, v1, &used_vertices, &simplifier) &&
-             simplifier.Extend(g_.vertex(v1)));
-
-    if (chain.size() == 2) {
-      OutputAllEdges(chain[0], chain[1]);  // Could not simplify.
+  const int n = chain.size() - 1;
+  for (int i = 0; i < n; ) {
+    // Simplify a subchain of edges starting with (chain[i], chain[i + 1]).
+    //
+    // "used_vertices" contains the set of vertices that have either been
+    // avoided or added to the subchain so far.  This is necessary so that
+    // AvoidSites() doesn't try to avoid vertices that have already been added
+    // to the subchain.
+    used_vertices->clear();
+    used_vertices->insert(chain[i]);
+    simplifier.Init(g_.vertex(chain[i]));
+    // Note that if the first edge is longer than the maximum length allowed
+    // for simplification, then AvoidSites() will return false and the
+    // subchain consists of that edge alone.
+    const bool simplify = AvoidSites(chain[i], chain[i], chain[i + 1],
+                                     used_vertices, &simplifier);
+    int j = i + 1;
+    used_vertices->insert(chain[j]);
+    // Attempt to extend the subchain to the next vertex.
+    while (simplify && j < n && TargetInputVertices(chain[j], &simplifier) &&
+           AvoidSites(chain[i], chain[j], chain[j + 1], used_vertices,
+                      &simplifier) &&
+           simplifier.Extend(g_.vertex(chain[j + 1]))) {
+      used_vertices->insert(chain[++j]);
+    }
+    is_end[j] = true;
+    i = j;
+  }
+}
+
+// Outputs the subchains of the given edge chain (see GetSubchainEnds).
+void S2Builder::EdgeChainSimplifier::OutputChain(
+    absl::Span<const VertexId> chain, absl::Span<const char> is_end) {
+  for (size_t i = 0, j; i + 1 < chain.size(); i = j) {
+    for (j = i + 1; !is_end[j]; ++j) continue;
+    if (j == i + 1) {
+      OutputAllEdges(chain[i], chain[j]);  // Could not simplify.
     } else {
-      MergeChain(chain);
+      MergeChain(chain.subspan(i, j - i + 1));
     }
-    // Note that any degenerate edges that were not merged into a chain are
-    // output by EdgeChainSimplifier::Run().
-    chain.clear();
-    used_vertices.clear();
-  } while (!done);
+  }
+  // Note that any degenerate edges that were not merged into a chain are
+  // output by EdgeChainSimplifier::Run().
 }
 
 // Given an edge (v0, v1) where v1 is an interior vertex, returns the (unique)
@@ -1967,7 +2494,7 @@ bool S2Builder::EdgeChainSimplifier::AvoidSites(
 // there may be more than one copy of an edge chain (in either direction)
 // within a single layer.
 void S2Builder::EdgeChainSimplifier::MergeChain(
-    const vector<VertexId>& vertices) {
+    absl::Span<const VertexId> vertices) {
   // Suppose that all interior vertices have M outgoing edges and N incoming
   // edges.  Our goal is to group the edges into M outgoing chains and N
   // incoming chains, and then replace each chain by a single edge.
@@ -2119,12 +2646,16 @@ bool S2Builder::MemoryTracker::ReserveEdgeSite(compact_array<SiteId>* sites) {
   return Tally(added_bytes);
 }
 
-// Releases and tracks the memory used to store nearby edge sites.
+// Releases and tracks the memory used to store nearby edge sites.  If
+// "retain_capacity" is true, the capacity of the vector itself is kept.
 bool S2Builder::MemoryTracker::ClearEdgeSites(
-    vector<compact_array<SiteId>>* edge_sites) {
+    std::pmr::vector<compact_array<SiteId>>* edge_sites,
+    bool retain_capacity) {
   Tally(-edge_sites_bytes_);
   edge_sites_bytes_ = 0;
-  return Clear(edge_sites);
+  if (!retain_capacity) return Clear(edge_sites);
+  edge_sites->clear();
+  return ok();
 }
 
 // Called when a site is added to the S2PointIndex.
@@ -2159,7 +2690,7 @@ bool S2Builder::MemoryTracker::DoneSiteIndex(
 // LINT.IfChange(TallySimplifyEdgeChains)
 bool S2Builder::MemoryTracker::TallySimplifyEdgeChains(
     const vector<compact_array<InputVertexId>>& site_vertices,
-    const vector<vector<Edge>>& layer_edges) {
+    const vector<vector<Edge>>& layer_edges, bool concurrent) {
   if (!is_active()) return true;
 
   // The simplify_edge_chains() option uses temporary memory per site
@@ -2186,9 +2717,19 @@ bool S2Builder::MemoryTracker::TallySimplifyEdgeChains(
   //
   // Note that the temporary vector<LayerEdgeId> in MergeLayerEdges() does not
   // affect peak usage.
-  const int64 kTempPerEdge = sizeof(bool) + sizeof(EdgeId) +
-                               2 * sizeof(Edge) + 2 * sizeof(InputEdgeIdSetId) +
-                               2 * sizeof(int);
+  //
+  // When the chains are simplified concurrently, each chain has at most twice
+  // as many vertices as edges and there is at most one action per edge:
+  //  vector<Action> actions;             // RunConcurrently
+  //  vector<VertexId> chain_vertices;    // RunConcurrently
+  //  vector<int> chain_begin;            // RunConcurrently
+  //  vector<char> is_end;                // RunConcurrently
+  const int64 kTempPerEdge =
+      sizeof(bool) + sizeof(EdgeId) + 2 * sizeof(Edge) +
+      2 * sizeof(InputEdgeIdSetId) + 2 * sizeof(int) +
+      (concurrent ? 2 * sizeof(int) + sizeof(EdgeId) +
+                        2 * sizeof(Graph::VertexId) + 2 * sizeof(char)
+                  : 0);
   int64 simplify_bytes = site_vertices.size() * kTempPerSite;
   for (const auto& array : site_vertices) {
     simplify_bytes += GetCompactArrayAllocBytes(array);
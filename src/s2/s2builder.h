@@ -25,6 +25,7 @@
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <memory_resource>
 #include <utility>
 #include <vector>
 
@@ -32,17 +33,21 @@
 #include "absl/container/flat_hash_set.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
+#include "absl/types/span.h"
 
+#include "s2/base/executor.h"
 #include "s2/_fp_contract_off.h"
 #include "s2/id_set_lexicon.h"
 #include "s2/mutable_s2shape_index.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s2cell_id.h"
+#include "s2/s2edge_crossing_cache.h"
 #include "s2/s2edge_crossings.h"
 #include "s2/s2edge_distances.h"
 #include "s2/s2error.h"
 #include "s2/s2memory_tracker.h"
+#include "s2/s2phase_tracer.h"
 #include "s2/s2point.h"
 #include "s2/s2point_index.h"
 #include "s2/s2point_span.h"
@@ -264,6 +269,15 @@ class S2Builder {
     // distance from "x" is no greater than "snap_radius".
     virtual S2Point SnapPoint(const S2Point& point) const = 0;
 
+    // Sets sites[i] to SnapPoint(points[i]) for every point.  S2Builder uses
+    // this method to snap all the input vertices at once, so subclasses may
+    // override it to avoid the per-point overhead of SnapPoint().  The
+    // results must be identical to calling SnapPoint() on each point.
+    //
+    // REQUIRES: sites.size() == points.size()
+    virtual void SnapPoints(absl::Span<const S2Point> points,
+                            absl::Span<S2Point> sites) const;
+
     // Returns a deep copy of this SnapFunction.
     virtual std::unique_ptr<SnapFunction> Clone() const = 0;
   };
@@ -471,6 +485,123 @@ class S2Builder {
     S2MemoryTracker* memory_tracker() const;
     void set_memory_tracker(S2MemoryTracker* tracker);
 
+    // Specifies a memory resource used to allocate the main internal arrays
+    // of S2Builder (the input vertices and edges and the per-edge site
+    // lists).  Build() allocates and discards many of these arrays, so a
+    // bump allocator such as std::pmr::monotonic_buffer_resource can save a
+    // significant amount of time.  Since Build() does not release the
+    // capacity of these arrays, the same S2Builder can be reused for many
+    // Build() calls without allocating any additional memory from the
+    // resource once the arrays have reached their steady-state size.
+    // Memory obtained from the resource is still reported to the
+    // memory_tracker() (if any).  Example usage:
+    //
+    //   std::pmr::monotonic_buffer_resource arena;
+    //   S2Builder::Options options;
+    //   options.set_memory_resource(&arena);
+    //   S2Builder builder{options};
+    //
+    // The resource must outlive the S2Builder.  The sites, the label sets,
+    // and the edge vectors passed to the output layers are allocated from
+    // the heap since they are part of the S2Builder::Graph interface.
+    //
+    // DEFAULT: nullptr (uses std::pmr::get_default_resource())
+    std::pmr::memory_resource* memory_resource() const;
+    void set_memory_resource(std::pmr::memory_resource* resource);
+
+    // The maximum number of threads used by Build().  When this is greater
+    // than one, finding the crossings between input edges (see
+    // split_crossing_edges), snapping the input vertices, finding the sites
+    // near each input edge, snapping each input edge to a chain of sites, and
+    // simplifying edge chains (see simplify_edge_chains) are divided among
+    // several threads.  (This means that the const methods of
+    // snap_function() must be thread-safe.)  The output (including all site
+    // and vertex ids) does not depend on this value.  Choosing the sites
+    // themselves is inherently sequential and is always done on the calling
+    // thread.
+    //
+    // Output layers are also built concurrently when they support it (see
+    // S2Builder::Layer::supports_concurrent_build; the standard layers do so
+    // unless they have a label set lexicon).  In that case each layer reports
+    // errors separately, and Build() returns the error of the first failing
+    // layer in the order that the layers were added.
+    //
+    // DEFAULT: 1
+    int num_threads() const;
+    void set_num_threads(int num_threads);
+
+    // If non-null, the additional threads requested by num_threads() are
+    // run as tasks on this executor rather than being created by Build()
+    // (see s2base::RunConcurrently).
+    //
+    // DEFAULT: nullptr
+    s2base::Executor* executor() const;
+    void set_executor(s2base::Executor* executor);
+
+    // If true, Build() keeps the capacity of the internal arrays that it
+    // would otherwise release once they are no longer needed (the sites, the
+    // per-edge site lists, and the edge and input edge id vectors and
+    // IdSetLexicon that are used to construct the S2Builder::Graph for each
+    // output layer).  This is recommended when the same S2Builder is used to
+    // build a large number of small geometries, since once these arrays have
+    // reached their steady-state size later calls to Build() do not need to
+    // allocate them again.  The retained memory continues to be reported to
+    // the memory_tracker() (if any) and is released by the destructor.
+    //
+    // Note that some temporary storage (e.g., the S2PointIndex of sites,
+    // the S2ShapeIndex of input edges, and the storage used by
+    // Graph::ProcessEdges and by the output layers) is still allocated on
+    // each call to Build().
+    //
+    // DEFAULT: false
+    bool retain_capacity() const;
+    void set_retain_capacity(bool retain_capacity);
+
+    // If true, Build() uses a hash table to find input edges whose
+    // endpoints are identical to those of an earlier input edge (in any
+    // layer), and finds the sites near each distinct edge only once.  This
+    // is recommended when the input contains many duplicate edges (e.g.,
+    // tiled polygons that were clipped along shared borders), since the
+    // snapping work then scales with the amount of unique geometry.  The
+    // output does not depend on this option: duplicate edges are still
+    // passed to each layer (with their own InputEdgeIds and labels) and are
+    // handled according to its GraphOptions.
+    //
+    // Note that degenerate input edges are already discarded by AddEdge()
+    // when the current layer specifies DegenerateEdges::DISCARD.
+    //
+    // DEFAULT: false
+    bool deduplicate_input_edges() const;
+    void set_deduplicate_input_edges(bool deduplicate_input_edges);
+
+    // If non-null, the intersection points of crossing input edges (see
+    // split_crossing_edges()) are looked up in this cache and added to it,
+    // so that edge pairs shared by many S2Builder inputs are intersected
+    // only once (see S2EdgeCrossingCache).  The output does not depend on
+    // this option.  The cache must outlive the S2Builder.
+    //
+    // DEFAULT: nullptr
+    S2EdgeCrossingCache* edge_crossing_cache() const;
+    void set_edge_crossing_cache(S2EdgeCrossingCache* cache);
+
+    // If non-null, Build() reports the beginning and end of each of its
+    // phases to this tracer (see S2PhaseTracer).  The phases and their item
+    // counts are:
+    //
+    //   S2Builder::ChooseSites         the number of sites chosen
+    //   S2Builder::AddEdgeCrossings    the number of intersection vertices
+    //                                  added (nested within ChooseSites)
+    //   S2Builder::SnapEdges           the number of snapped edges
+    //   S2Builder::SimplifyEdgeChains  the number of edges after simplifying
+    //   S2Builder::BuildLayer          the number of edges in the layer
+    //                                  (reported once per output layer)
+    //
+    // The tracer must outlive the S2Builder.
+    //
+    // DEFAULT: nullptr
+    S2PhaseTracer* tracer() const;
+    void set_tracer(S2PhaseTracer* tracer);
+
     // Options may be assigned and copied.
     Options(const Options& options);
     Options& operator=(const Options& options);
@@ -482,6 +613,13 @@ class S2Builder {
     bool simplify_edge_chains_ = false;
     bool idempotent_ = true;
     S2MemoryTracker* memory_tracker_ = nullptr;
+    std::pmr::memory_resource* memory_resource_ = nullptr;
+    int num_threads_ = 1;
+    s2base::Executor* executor_ = nullptr;
+    bool retain_capacity_ = false;
+    bool deduplicate_input_edges_ = false;
+    S2EdgeCrossingCache* edge_crossing_cache_ = nullptr;
+    S2PhaseTracer* tracer_ = nullptr;
   };
 
   class Graph;
@@ -796,7 +934,9 @@ class S2Builder {
    public:
     bool TallyEdgeSites(const gtl::compact_array<SiteId>& sites);
     bool ReserveEdgeSite(gtl::compact_array<SiteId>* sites);
-    bool ClearEdgeSites(std::vector<gtl::compact_array<SiteId>>* edge_sites);
+    bool ClearEdgeSites(
+        std::pmr::vector<gtl::compact_array<SiteId>>* edge_sites,
+        bool retain_capacity);
 
     bool TallyIndexedSite();
     bool FixSiteIndexTally(const S2PointIndex<SiteId>& index);
@@ -804,7 +944,7 @@ class S2Builder {
 
     bool TallySimplifyEdgeChains(
         const std::vector<gtl::compact_array<InputVertexId>>& site_vertices,
-        const std::vector<std::vector<Edge>>& layer_edges);
+        const std::vector<std::vector<Edge>>& layer_edges, bool concurrent);
 
     bool TallyFilterVertices(int num_sites,
                              const std::vector<std::vector<Edge>>& layer_edges);
@@ -824,12 +964,17 @@ class S2Builder {
   InputVertexId AddVertex(const S2Point& v);
   void ChooseSites();
   void ChooseAllVerticesAsSites();
+  void FindDuplicateInputEdges();
+  bool IsDuplicateInputEdge(InputEdgeId e) const {
+    return !duplicate_edges_.empty() && duplicate_edges_[e] >= 0;
+  }
   std::vector<InputVertexKey> SortInputVertices();
   void AddEdgeCrossings(const MutableS2ShapeIndex& input_edge_index);
   void AddForcedSites(S2PointIndex<SiteId>* site_index);
   bool is_forced(SiteId v) const;
   void ChooseInitialSites(S2PointIndex<SiteId>* site_index);
   S2Point SnapSite(const S2Point& point) const;
+  void CheckSnappedSite(const S2Point& point, const S2Point& site) const;
   void CollectSiteEdges(const S2PointIndex<SiteId>& site_index);
   void SortSitesByDistance(const S2Point& x,
                            gtl::compact_array<SiteId>* sites) const;
@@ -847,6 +992,10 @@ class S2Builder {
                             InputEdgeId input_edge_id) const;
   S2Point GetCoverageEndpoint(const S2Point& p, const S2Point& n) const;
   void SnapEdge(InputEdgeId e, std::vector<SiteId>* chain) const;
+  int num_threads() const;
+  bool SnapEdgesInParallel(
+      InputEdgeId begin, InputEdgeId end,
+      std::vector<gtl::compact_array<SiteId>>* chains);
 
   void BuildLayers();
   void BuildLayerEdges(
@@ -857,7 +1006,8 @@ class S2Builder {
       InputEdgeId begin, InputEdgeId end, const GraphOptions& options,
       std::vector<Edge>* edges, std::vector<InputEdgeIdSetId>* input_edge_ids,
       IdSetLexicon* input_edge_id_set_lexicon,
-      std::vector<gtl::compact_array<InputVertexId>>* site_vertices);
+      std::vector<gtl::compact_array<InputVertexId>>* site_vertices,
+      absl::Span<const gtl::compact_array<SiteId>> chains);
   void MaybeAddInputVertex(
       InputVertexId v, SiteId id,
       std::vector<gtl::compact_array<InputVertexId>>* site_vertices) const;
@@ -938,8 +1088,10 @@ class S2Builder {
   // time label_set_id_ was computed.
   bool label_set_modified_;
 
-  std::vector<S2Point> input_vertices_;
-  std::vector<InputEdge> input_edges_;
+  // These vectors (and edge_sites_ below) are allocated using
+  // options_.memory_resource().
+  std::pmr::vector<S2Point> input_vertices_;
+  std::pmr::vector<InputEdge> input_edges_;
 
   std::vector<std::unique_ptr<Layer>> layers_;
   std::vector<GraphOptions> layer_options_;
@@ -979,7 +1131,26 @@ class S2Builder {
   // simplification was requested, in which case instead the sites are
   // filtered by removing the ones that each edge was snapped to, leaving only
   // the "sites to avoid" (needed for simplification).
-  std::vector<gtl::compact_array<SiteId>> edge_sites_;
+  std::pmr::vector<gtl::compact_array<SiteId>> edge_sites_;
+
+  // If options_.deduplicate_input_edges() is true, then during site
+  // selection duplicate_edges_[e] is the first input edge with the same
+  // endpoints as edge "e", or -1 if there is no earlier such edge.  Since
+  // such edges have the same nearby sites and snap to the same chain, only
+  // the first one needs to be checked.  Otherwise this vector is empty.
+  std::vector<InputEdgeId> duplicate_edges_;
+
+  ////////////// Data for Building Layers //////////////
+
+  // For each layer, the snapped edges and the corresponding "input edge id
+  // set ids" that are used to construct the S2Builder::Graph passed to that
+  // layer.  The InputEdgeIds themselves are stored in
+  // input_edge_id_set_lexicon_.  These fields are only used within
+  // BuildLayers(), and are kept between calls to Build() only when
+  // options_.retain_capacity() is true.
+  std::vector<std::vector<Edge>> layer_edges_;
+  std::vector<std::vector<InputEdgeIdSetId>> layer_input_edge_ids_;
+  IdSetLexicon input_edge_id_set_lexicon_;
 
   // An object to track the memory usage of this class.
   MemoryTracker tracker_;
@@ -1252,6 +1423,65 @@ inline void S2Builder::Options::set_memory_tracker(
   memory_tracker_ = tracker;
 }
 
+inline std::pmr::memory_resource* S2Builder::Options::memory_resource() const {
+  return memory_resource_;
+}
+
+inline void S2Builder::Options::set_memory_resource(
+    std::pmr::memory_resource* resource) {
+  memory_resource_ = resource;
+}
+
+inline int S2Builder::Options::num_threads() const {
+  return num_threads_;
+}
+
+inline void S2Builder::Options::set_num_threads(int num_threads) {
+  num_threads_ = num_threads;
+}
+
+inline s2base::Executor* S2Builder::Options::executor() const {
+  return executor_;
+}
+
+inline void S2Builder::Options::set_executor(s2base::Executor* executor) {
+  executor_ = executor;
+}
+
+inline bool S2Builder::Options::retain_capacity() const {
+  return retain_capacity_;
+}
+
+inline void S2Builder::Options::set_retain_capacity(bool retain_capacity) {
+  retain_capacity_ = retain_capacity;
+}
+
+inline bool S2Builder::Options::deduplicate_input_edges() const {
+  return deduplicate_input_edges_;
+}
+
+inline void S2Builder::Options::set_deduplicate_input_edges(
+    bool deduplicate_input_edges) {
+  deduplicate_input_edges_ = deduplicate_input_edges;
+}
+
+inline S2EdgeCrossingCache* S2Builder::Options::edge_crossing_cache() const {
+  return edge_crossing_cache_;
+}
+
+inline void S2Builder::Options::set_edge_crossing_cache(
+    S2EdgeCrossingCache* cache) {
+  edge_crossing_cache_ = cache;
+}
+
+inline S2PhaseTracer* S2Builder::Options::tracer() const {
+  return tracer_;
+}
+
+inline void S2Builder::Options::set_tracer(S2PhaseTracer* tracer) {
+  tracer_ = tracer;
+}
+
 inline S2Builder::GraphOptions::EdgeType
 S2Builder::GraphOptions::edge_type() const {
   return edge_type_;
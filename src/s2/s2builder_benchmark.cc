@@ -0,0 +1,93 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Benchmarks for S2Builder.
+
+#include "s2/s2builder.h"
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "s2/s1angle.h"
+#include "s2/s2builder_graph.h"
+#include "s2/s2builder_layer.h"
+#include "s2/s2builderutil_snap_functions.h"
+#include "s2/s2error.h"
+#include "s2/s2fractal.h"
+#include "s2/s2loop.h"
+#include "s2/s2testing.h"
+
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// A layer that only counts the edges, the input edge ids, and the labels of
+// its graph, so that the benchmark measures S2Builder itself.
+class CountingLayer : public S2Builder::Layer {
+ public:
+  explicit CountingLayer(int64* count) : count_(count) {}
+
+  GraphOptions graph_options() const override {
+    return GraphOptions(EdgeType::DIRECTED,
+                        GraphOptions::DegenerateEdges::DISCARD,
+                        GraphOptions::DuplicateEdges::MERGE,
+                        GraphOptions::SiblingPairs::KEEP);
+  }
+
+  void Build(const S2Builder::Graph& g, S2Error* error) override {
+    for (S2Builder::Graph::EdgeId e = 0; e < g.num_edges(); ++e) {
+      *count_ += g.input_edge_ids(e).size() + g.labels(e).size();
+    }
+  }
+
+ private:
+  int64* count_;
+};
+
+// Snaps "state.range(0)" copies of a fractal loop with approximately 4096
+// edges, each with a different label, to S2CellId level "state.range(1)".
+// All the copies snap to the same edges, which are merged so that each output
+// edge has a set of input edge ids and a set of labels that are stored in an
+// IdSetLexicon.
+void BM_BuildWithLabels(benchmark::State& state) {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(4096);
+  unique_ptr<S2Loop> loop = fractal.MakeLoop(S2Testing::GetRandomFrame(),
+                                             S1Angle::Degrees(10));
+  const int num_copies = state.range(0);
+  S2Builder::Options options(
+      s2builderutil::S2CellIdSnapFunction(state.range(1)));
+  options.set_retain_capacity(true);
+  S2Builder builder(options);
+  int64 count = 0;
+  for (auto _ : state) {
+    builder.StartLayer(make_unique<CountingLayer>(&count));
+    for (int i = 0; i < num_copies; ++i) {
+      builder.set_label(i);
+      builder.AddLoop(*loop);
+    }
+    S2Error error;
+    if (!builder.Build(&error)) state.SkipWithError(error.text().c_str());
+  }
+  benchmark::DoNotOptimize(count);
+}
+BENCHMARK(BM_BuildWithLabels)
+    ->ArgsProduct({{1, 3, 10}, {10, 16}});
+
+}  // namespace
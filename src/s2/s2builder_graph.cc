@@ -20,11 +20,13 @@
 #include <algorithm>
 #include <array>
 #include <limits>
+#include <memory>
 #include <numeric>
 #include <utility>
 #include <vector>
 
 #include "s2/base/types.h"
+#include "absl/base/call_once.h"
 #include "absl/container/btree_map.h"
 #include "absl/log/absl_check.h"
 #include "s2/id_set_lexicon.h"
@@ -59,19 +61,42 @@ Graph::Graph(const GraphOptions& options,
       input_edge_id_set_lexicon_(input_edge_id_set_lexicon),
       label_set_ids_(label_set_ids),
       label_set_lexicon_(label_set_lexicon),
-      is_full_polygon_predicate_(std::move(is_full_polygon_predicate)) {
+      is_full_polygon_predicate_(std::move(is_full_polygon_predicate)),
+      adjacency_(std::make_shared<Adjacency>()) {
   ABSL_DCHECK(std::is_sorted(edges->begin(), edges->end()));
   ABSL_DCHECK_EQ(edges->size(), input_edge_id_set_ids->size());
 }
 
+const Graph::Adjacency& Graph::adjacency() const {
+  absl::call_once(adjacency_->once, [this]() {
+    Adjacency* a = adjacency_.get();
+    const VertexId n = num_vertices();
+    a->out_begins.assign(n + 1, 0);
+    a->in_begins.assign(n + 1, 0);
+    for (const Edge& e : edges()) {
+      ++a->out_begins[e.first + 1];
+      ++a->in_begins[e.second + 1];
+    }
+    std::partial_sum(a->out_begins.begin(), a->out_begins.end(),
+                     a->out_begins.begin());
+    std::partial_sum(a->in_begins.begin(), a->in_begins.end(),
+                     a->in_begins.begin());
+
+    // Since the edges are sorted by (origin, destination), a stable counting
+    // sort by destination yields the ordering of GetInEdgeIds().  We use
+    // in_begins[v + 1] as the insertion position for vertex "v", which
+    // shifts the offsets into place as a side effect.
+    a->in_edge_ids.resize(num_edges());
+    for (VertexId v = n; v > 0; --v) a->in_begins[v] = a->in_begins[v - 1];
+    for (EdgeId e = 0; e < num_edges(); ++e) {
+      a->in_edge_ids[a->in_begins[edge(e).second + 1]++] = e;
+    }
+  });
+  return *adjacency_;
+}
+
 vector<Graph::EdgeId> Graph::GetInEdgeIds() const {
-  vector<EdgeId> in_edge_ids(num_edges());
-  std::iota(in_edge_ids.begin(), in_edge_ids.end(), 0);
-  std::sort(in_edge_ids.begin(), in_edge_ids.end(),
-            [this](EdgeId ai, EdgeId bi) {
-      return StableLessThan(reverse(edge(ai)), reverse(edge(bi)), ai, bi);
-    });
-  return in_edge_ids;
+  return adjacency().in_edge_ids;
 }
 
 vector<Graph::EdgeId> Graph::GetSiblingMap() const {
@@ -113,22 +138,14 @@ void Graph::MakeSiblingMap(vector<Graph::EdgeId>* in_edge_ids) const {
 
 void Graph::VertexOutMap::Init(const Graph& g) {
   edges_ = &g.edges();
-  edge_begins_.reserve(g.num_vertices() + 1);
-  EdgeId e = 0;
-  for (VertexId v = 0; v <= g.num_vertices(); ++v) {
-    while (e < g.num_edges() && g.edge(e).first < v) ++e;
-    edge_begins_.push_back(e);
-  }
+  edge_begins_ = g.adjacency().out_begins.data();
+  adjacency_ = g.adjacency_;
 }
 
 void Graph::VertexInMap::Init(const Graph& g) {
-  in_edge_ids_ = g.GetInEdgeIds();
-  in_edge_begins_.reserve(g.num_vertices() + 1);
-  EdgeId e = 0;
-  for (VertexId v = 0; v <= g.num_vertices(); ++v) {
-    while (e < g.num_edges() && g.edge(in_edge_ids_[e]).second < v) ++e;
-    in_edge_begins_.push_back(e);
-  }
+  in_edge_ids_ = g.adjacency().in_edge_ids.data();
+  in_edge_begins_ = g.adjacency().in_begins.data();
+  adjacency_ = g.adjacency_;
 }
 
 void Graph::LabelFetcher::Init(const Graph& g, S2Builder::EdgeType edge_type) {
@@ -367,7 +384,9 @@ bool Graph::GetDirectedLoops(LoopType loop_type, vector<EdgeLoop>* loops,
   ABSL_DCHECK(options_.edge_type() == EdgeType::DIRECTED);
 
   vector<EdgeId> left_turn_map;
-  if (!GetLeftTurnMap(GetInEdgeIds(), &left_turn_map, error)) return false;
+  if (!GetLeftTurnMap(adjacency().in_edge_ids, &left_turn_map, error)) {
+    return false;
+  }
   vector<InputEdgeId> min_input_ids = GetMinInputEdgeIds();
 
   // If we are breaking loops at repeated vertices, we maintain a map from
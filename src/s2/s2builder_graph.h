@@ -23,9 +23,11 @@
 #include <cstddef>
 #include <iterator>
 #include <limits>
+#include <memory>
 #include <utility>
 #include <vector>
 
+#include "absl/base/call_once.h"
 #include "s2/base/types.h"
 #include "s2/id_set_lexicon.h"
 #include "s2/s2builder.h"
@@ -49,9 +51,18 @@
 // all Graph objects passed to S2Builder::Layer::Build() methods will remain
 // valid until all layers have been built.
 //
+// The incoming and outgoing edges of every vertex are computed at most once
+// per graph, in compressed sparse row format, and shared by VertexInMap,
+// VertexOutMap, GetInEdgeIds(), and the methods that assemble edges into
+// loops and polylines (GetDirectedLoops, GetPolylines, etc).  Copies of a
+// graph share this data, and it may be computed and accessed concurrently.
+//
 // TODO(ericv): Consider pulling out the methods that are helper functions for
 // Layer implementations (such as GetDirectedLoops) into s2builderutil_graph.h.
 class S2Builder::Graph {
+ private:
+  struct Adjacency;  // Defined below.
+
  public:
   // Identifies a vertex in the graph.  Vertices are numbered sequentially
   // starting from zero.
@@ -142,8 +153,8 @@ class S2Builder::Graph {
   static Edge reverse(const Edge& e);
 
   // Returns a vector of edge ids sorted in lexicographic order by
-  // (destination, origin).  All of the incoming edges to each vertex form a
-  // contiguous subrange of this ordering.
+  // (destination, origin), with ties broken by edge id.  All of the incoming
+  // edges to each vertex form a contiguous subrange of this ordering.
   std::vector<EdgeId> GetInEdgeIds() const;
 
   // Given a graph such that every directed edge has a sibling, returns a map
@@ -244,7 +255,10 @@ class S2Builder::Graph {
 
    private:
     const std::vector<Edge>* edges_;
-    std::vector<EdgeId> edge_begins_;
+    const EdgeId* edge_begins_;
+
+    // Keeps edge_begins_ valid even if the graph itself is destroyed.
+    std::shared_ptr<const Adjacency> adjacency_;
     VertexOutMap(const VertexOutMap&) = delete;
     void operator=(const VertexOutMap&) = delete;
   };
@@ -277,11 +291,14 @@ class S2Builder::Graph {
     VertexInEdgeIds edge_ids(VertexId v) const;
 
     // Returns a sorted vector of all incoming edges (see GetInEdgeIds).
-    const std::vector<EdgeId>& in_edge_ids() const { return in_edge_ids_; }
+    const std::vector<EdgeId>& in_edge_ids() const;
 
    private:
-    std::vector<EdgeId> in_edge_ids_;
-    std::vector<EdgeId> in_edge_begins_;
+    const EdgeId* in_edge_ids_;
+    const EdgeId* in_edge_begins_;
+
+    // Keeps the arrays above valid even if the graph itself is destroyed.
+    std::shared_ptr<const Adjacency> adjacency_;
     VertexInMap(const VertexInMap&) = delete;
     void operator=(const VertexInMap&) = delete;
   };
@@ -694,6 +711,20 @@ class S2Builder::Graph {
   class EdgeProcessor;
   class PolylineBuilder;
 
+  // The edges of the graph in compressed sparse row format.  The outgoing
+  // edges of vertex "v" are the edge ids [out_begins[v], out_begins[v + 1])
+  // and its incoming edges are in_edge_ids[in_begins[v] .. in_begins[v + 1]),
+  // where "in_edge_ids" is ordered as described for GetInEdgeIds().
+  struct Adjacency {
+    absl::once_flag once;
+    std::vector<EdgeId> out_begins;
+    std::vector<EdgeId> in_edge_ids;
+    std::vector<EdgeId> in_begins;
+  };
+
+  // Returns the adjacency data, computing it if necessary.
+  const Adjacency& adjacency() const;
+
   GraphOptions options_;
   VertexId num_vertices_;  // Cached to avoid division by 24.
 
@@ -704,6 +735,9 @@ class S2Builder::Graph {
   const std::vector<LabelSetId>* label_set_ids_;
   const IdSetLexicon* label_set_lexicon_;
   IsFullPolygonPredicate is_full_polygon_predicate_;
+
+  // Computed on demand by adjacency() and shared by all copies of the graph.
+  std::shared_ptr<Adjacency> adjacency_;
 };
 
 
@@ -799,8 +833,13 @@ inline S2Builder::Graph::VertexInEdgeIds::VertexInEdgeIds(const EdgeId* begin,
 
 inline S2Builder::Graph::VertexInEdgeIds
 S2Builder::Graph::VertexInMap::edge_ids(VertexId v) const {
-  return VertexInEdgeIds(in_edge_ids_.data() + in_edge_begins_[v],
-                         in_edge_ids_.data() + in_edge_begins_[v + 1]);
+  return VertexInEdgeIds(in_edge_ids_ + in_edge_begins_[v],
+                         in_edge_ids_ + in_edge_begins_[v + 1]);
+}
+
+inline const std::vector<S2Builder::Graph::EdgeId>&
+S2Builder::Graph::VertexInMap::in_edge_ids() const {
+  return adjacency_->in_edge_ids;
 }
 
 inline int S2Builder::Graph::VertexInMap::degree(VertexId v) const {
@@ -20,8 +20,10 @@
 
 #include "s2/s2builder_graph.h"
 
+#include <algorithm>
 #include <array>
 #include <memory>
+#include <numeric>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -45,6 +47,7 @@ using std::vector;
 
 using EdgeType = S2Builder::EdgeType;
 using Graph = S2Builder::Graph;
+using VertexInMap = S2Builder::Graph::VertexInMap;
 using VertexOutMap = S2Builder::Graph::VertexOutMap;
 using VertexOutEdgeIds = S2Builder::Graph::VertexOutEdgeIds;
 using GraphOptions = S2Builder::GraphOptions;
@@ -158,6 +161,52 @@ TEST(S2BuilderGraph, BasicVertexOutApi) {
   }
 }
 
+TEST(S2BuilderGraph, VertexInAndOutMaps) {
+  GraphClone gc;
+  S2Builder builder{S2Builder::Options()};
+  GraphOptions graph_options(EdgeType::DIRECTED, DegenerateEdges::KEEP,
+                             DuplicateEdges::KEEP, SiblingPairs::KEEP);
+  builder.StartLayer(make_unique<GraphCloningLayer>(graph_options, &gc));
+  builder.AddShape(*MakeLaxPolylineOrDie("0:0, 1:1, 2:0, 1:1, 0:0"));
+  builder.AddShape(*MakeLaxPolylineOrDie("2:0, 1:1, 1:1, 0:0, 1:1"));
+  builder.AddShape(*MakeLaxPolylineOrDie("3:3, 3:3, 0:0"));
+  S2Error error;
+  ASSERT_TRUE(builder.Build(&error)) << error;
+  const Graph& g = gc.graph();
+
+  // Incoming edges are sorted by (destination, origin, edge id).
+  vector<EdgeId> expected(g.num_edges());
+  std::iota(expected.begin(), expected.end(), 0);
+  std::stable_sort(expected.begin(), expected.end(),
+                   [&g](EdgeId a, EdgeId b) {
+                     return Graph::reverse(g.edge(a)) <
+                            Graph::reverse(g.edge(b));
+                   });
+  EXPECT_EQ(g.GetInEdgeIds(), expected);
+
+  // The maps remain valid after the graph they were initialized from is
+  // destroyed, and agree with a direct count of the edges.
+  VertexInMap in;
+  VertexOutMap out;
+  {
+    Graph copy = g;
+    in.Init(copy);
+    out.Init(copy);
+  }
+  EXPECT_EQ(in.in_edge_ids(), expected);
+  for (VertexId v = 0; v < g.num_vertices(); ++v) {
+    int in_degree = 0, out_degree = 0;
+    for (const Edge& edge : g.edges()) {
+      in_degree += (edge.second == v);
+      out_degree += (edge.first == v);
+    }
+    EXPECT_EQ(in.degree(v), in_degree);
+    EXPECT_EQ(out.degree(v), out_degree);
+    for (EdgeId e : in.edge_ids(v)) EXPECT_EQ(g.edge(e).second, v);
+    for (EdgeId e : out.edge_ids(v)) EXPECT_EQ(g.edge(e).first, v);
+  }
+}
+
 TEST(GetUndirectedComponents, DegenerateEdges) {
   GraphClone gc;
   S2Builder builder{S2Builder::Options()};
@@ -47,6 +47,18 @@ class S2Builder::Layer {
   // from several layers and process them all at once (such as
   // s2builderutil::ClosedSetNormalizer).
   virtual void Build(const Graph& g, S2Error* error) = 0;
+
+  // Returns true if Build() may be called concurrently with the Build()
+  // methods of other layers (see S2Builder::Options::num_threads).  This
+  // requires that Build() does not modify any state shared with other
+  // layers, e.g. a MutableS2ShapeIndex or an IdSetLexicon that several
+  // layers add to.  Layers that gather the output graphs of several layers
+  // (such as s2builderutil::ClosedSetNormalizer) must return false; such
+  // layers are always built on the calling thread in the order they were
+  // added.
+  //
+  // The default implementation returns false.
+  virtual bool supports_concurrent_build() const { return false; }
 };
 
 #endif  // S2_S2BUILDER_LAYER_H_
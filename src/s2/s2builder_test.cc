@@ -23,6 +23,7 @@
 #include <cstdint>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
 #include <string>
 #include <utility>
 #include <vector>
@@ -65,6 +66,7 @@
 #include "s2/s2lax_polyline_shape.h"
 #include "s2/s2loop.h"
 #include "s2/s2memory_tracker.h"
+#include "s2/s2phase_tracer.h"
 #include "s2/s2point.h"
 #include "s2/s2polygon.h"
 #include "s2/s2polyline.h"
@@ -1499,6 +1501,328 @@ TEST(S2Builder, FractalStressTest) {
   }
 }
 
+TEST(S2Builder, NumThreadsDoesNotChangeOutput) {
+  for (int iter = 0; iter < 20; ++iter) {
+    S2Testing::rnd.Reset(iter + 1);  // Easier to reproduce a specific case.
+    S2Fractal fractal;
+    fractal.SetLevelForApproxMaxEdges(3000);
+    fractal.set_fractal_dimension(1.5 + 0.5 * S2Testing::rnd.RandDouble());
+    S2Point center = S2Testing::RandomPoint();
+    unique_ptr<S2Loop> loop = fractal.MakeLoop(
+        S2Testing::GetRandomFrameAt(center), S1Angle::Degrees(10));
+    S2Polyline polyline(S2Testing::MakeRegularPoints(
+        center, S1Angle::Degrees(8), 500));
+    S2Builder::Options options;
+    if (S2Testing::rnd.OneIn(2)) {
+      options.set_snap_function(
+          S2CellIdSnapFunction(8 + S2Testing::rnd.Uniform(8)));
+    } else {
+      options.set_snap_function(IdentitySnapFunction(
+          S1Angle::Degrees(pow(1e-3, S2Testing::rnd.RandDouble()))));
+    }
+    options.set_split_crossing_edges(S2Testing::rnd.OneIn(2));
+    options.set_simplify_edge_chains(S2Testing::rnd.OneIn(2));
+
+    // Builds the input using the given number of threads and returns the
+    // output polylines of both layers as a string.
+    const auto build = [&](int num_threads) {
+      options.set_num_threads(num_threads);
+      S2Builder builder(options);
+      vector<unique_ptr<S2Polyline>> output[2];
+      builder.StartLayer(make_unique<S2PolylineVectorLayer>(&output[0]));
+      builder.AddLoop(*loop);
+      builder.StartLayer(make_unique<S2PolylineVectorLayer>(&output[1]));
+      builder.AddPolyline(polyline);
+      S2Error error;
+      EXPECT_TRUE(builder.Build(&error)) << error;
+      string result;
+      for (const auto& polylines : output) {
+        for (const auto& p : polylines) {
+          StrAppend(&result, s2textformat::ToString(*p), "\n");
+        }
+        StrAppend(&result, "--\n");
+      }
+      return result;
+    };
+    string expected = build(1);
+    EXPECT_EQ(expected, build(4)) << "iter=" << iter;
+  }
+}
+
+TEST(S2Builder, SimplifyEdgeChainsNumThreadsDoesNotChangeOutput) {
+  // Tests edge chains that are closed loops, undirected edges, and
+  // degenerate edges, which are simplified in a different order than the
+  // polylines above.
+  for (int iter = 0; iter < 10; ++iter) {
+    S2Testing::rnd.Reset(iter + 1);
+    S2Builder::Options options(IdentitySnapFunction(S1Angle::Degrees(0.1)));
+    options.set_simplify_edge_chains(true);
+    S2PolylineVectorLayer::Options layer_options;
+    layer_options.set_edge_type(EdgeType::UNDIRECTED);
+    layer_options.set_duplicate_edges(
+        S2PolylineVectorLayer::Options::DuplicateEdges::KEEP);
+    const auto build = [&](int num_threads) {
+      options.set_num_threads(num_threads);
+      S2Builder builder(options);
+      vector<unique_ptr<S2Polyline>> output;
+      builder.StartLayer(
+          make_unique<S2PolylineVectorLayer>(&output, layer_options));
+      S2Testing::rnd.Reset(iter + 1);
+      for (int i = 0; i < 20; ++i) {
+        vector<S2Point> vertices = S2Testing::MakeRegularPoints(
+            S2Testing::RandomPoint(), S1Angle::Degrees(1),
+            50 + S2Testing::rnd.Uniform(50));
+        builder.AddLoop(S2Loop(vertices));
+        builder.AddEdge(vertices[0], vertices[0]);
+      }
+      S2Error error;
+      EXPECT_TRUE(builder.Build(&error)) << error;
+      string result;
+      for (const auto& p : output) {
+        StrAppend(&result, s2textformat::ToString(*p), "\n");
+      }
+      return result;
+    };
+    string expected = build(1);
+    EXPECT_EQ(expected, build(4)) << "iter=" << iter;
+  }
+}
+
+// Records each phase as "Phase" followed by its item count.
+class RecordingTracer : public S2PhaseTracer {
+ public:
+  void BeginPhase(string_view phase) override {}
+  void EndPhase(string_view phase, const PhaseStats& stats) override {
+    phases.push_back(StrCat(phase, " ", stats.num_items));
+  }
+  vector<string> phases;
+};
+
+TEST(S2Builder, TracerReportsPhases) {
+  RecordingTracer tracer;
+  S2MemoryTracker memory_tracker;
+  S2Builder::Options options(IdentitySnapFunction(S1Angle::Degrees(0.01)));
+  options.set_split_crossing_edges(true);
+  options.set_simplify_edge_chains(true);
+  options.set_memory_tracker(&memory_tracker);
+  options.set_tracer(&tracer);
+  S2Builder builder(options);
+  S2Polyline a, b;
+  builder.StartLayer(make_unique<S2PolylineLayer>(&a));
+  builder.AddPolyline(*MakePolylineOrDie("0:0, 0:5, 0:10"));
+  builder.StartLayer(make_unique<S2PolylineLayer>(&b));
+  builder.AddPolyline(*MakePolylineOrDie("-5:5, 5:5"));
+  S2Error error;
+  ASSERT_TRUE(builder.Build(&error)) << error;
+  // The crossing point (5:0) is also a vertex of the first polyline, so the
+  // intersection vertex snaps to an existing site and splits only the second
+  // polyline.
+  EXPECT_EQ(tracer.phases,
+            (vector<string>{"S2Builder::AddEdgeCrossings 1",
+                            "S2Builder::ChooseSites 5",
+                            "S2Builder::SnapEdges 4",
+                            "S2Builder::SimplifyEdgeChains 4",
+                            "S2Builder::BuildLayer 2",
+                            "S2Builder::BuildLayer 2"}));
+}
+
+TEST(S2Builder, ConcurrentLayersReportFirstError) {
+  // Layers 0 and 2 fail with different errors, and layer 3 has a label set
+  // lexicon so it is built after the others.  The error of layer 0 should
+  // always be returned.
+  for (int iter = 0; iter < 20; ++iter) {
+    S2Builder::Options options;
+    options.set_num_threads(4);
+    S2Builder builder(options);
+    S2Polyline polylines[4];
+    builder.StartLayer(make_unique<S2PolylineLayer>(&polylines[0]));
+    builder.AddPolyline(*MakePolylineOrDie("0:0, 0:1"));
+    builder.AddPolyline(*MakePolylineOrDie("5:5, 5:6"));
+    builder.StartLayer(make_unique<S2PolylineLayer>(&polylines[1]));
+    builder.AddPolyline(*MakePolylineOrDie("1:1, 1:2, 2:2"));
+    S2Polygon polygon;
+    S2PolygonLayer::Options polygon_options;
+    polygon_options.set_validate(true);
+    builder.StartLayer(make_unique<S2PolygonLayer>(&polygon, polygon_options));
+    const vector<S2Point> bowtie = s2textformat::ParsePointsOrDie(
+        "0:0, 0:10, 10:0, 10:10");
+    for (int i = 0; i < 4; ++i) builder.AddEdge(bowtie[i], bowtie[(i + 1) % 4]);
+    S2PolylineLayer::LabelSetIds label_set_ids;
+    IdSetLexicon label_set_lexicon;
+    builder.StartLayer(make_unique<S2PolylineLayer>(
+        &polylines[3], &label_set_ids, &label_set_lexicon));
+    builder.AddPolyline(*MakePolylineOrDie("3:3, 3:4"));
+    S2Error error;
+    EXPECT_FALSE(builder.Build(&error));
+    EXPECT_EQ(error.code(), S2Error::BUILDER_EDGES_DO_NOT_FORM_POLYLINE);
+    EXPECT_EQ(s2textformat::ToString(polylines[1]), "1:1, 1:2, 2:2");
+    EXPECT_EQ(s2textformat::ToString(polylines[3]), "3:3, 3:4");
+  }
+}
+
+TEST(S2Builder, DeduplicateInputEdgesDoesNotChangeOutput) {
+  // Builds several layers whose edges are mostly shared (as happens when
+  // adjacent polygons are snapped together) and checks that the output does
+  // not depend on deduplicate_input_edges().
+  for (int iter = 0; iter < 10; ++iter) {
+    S2Testing::rnd.Reset(iter + 1);  // Easier to reproduce a specific case.
+    S2Fractal fractal;
+    fractal.SetLevelForApproxMaxEdges(2000);
+    S2Point center = S2Testing::RandomPoint();
+    unique_ptr<S2Loop> loop = fractal.MakeLoop(
+        S2Testing::GetRandomFrameAt(center), S1Angle::Degrees(10));
+    S2Builder::Options options;
+    if (S2Testing::rnd.OneIn(2)) {
+      options.set_snap_function(
+          S2CellIdSnapFunction(8 + S2Testing::rnd.Uniform(8)));
+    } else {
+      options.set_snap_function(IdentitySnapFunction(
+          S1Angle::Degrees(pow(1e-3, S2Testing::rnd.RandDouble()))));
+    }
+    options.set_split_crossing_edges(S2Testing::rnd.OneIn(2));
+    options.set_simplify_edge_chains(S2Testing::rnd.OneIn(2));
+
+    const auto build = [&](bool deduplicate, int num_threads) {
+      options.set_deduplicate_input_edges(deduplicate);
+      options.set_num_threads(num_threads);
+      S2Builder builder(options);
+      vector<unique_ptr<S2Polyline>> output[3];
+      builder.StartLayer(make_unique<S2PolylineVectorLayer>(&output[0]));
+      builder.AddLoop(*loop);
+      builder.StartLayer(make_unique<S2PolylineVectorLayer>(&output[1]));
+      builder.AddLoop(*loop);
+      builder.AddEdge(loop->vertex(1), loop->vertex(0));
+      builder.StartLayer(make_unique<S2PolylineVectorLayer>(&output[2]));
+      S2PointLoopSpan vertices = loop->vertices_span();
+      builder.AddPolyline(S2Polyline(vector<S2Point>(
+          vertices.begin(), vertices.begin() + vertices.size() / 2)));
+      S2Error error;
+      EXPECT_TRUE(builder.Build(&error)) << error;
+      string result;
+      for (const auto& polylines : output) {
+        for (const auto& p : polylines) {
+          StrAppend(&result, s2textformat::ToString(*p), "\n");
+        }
+        StrAppend(&result, "--\n");
+      }
+      return result;
+    };
+    string expected = build(false, 1);
+    EXPECT_EQ(expected, build(true, 1)) << "iter=" << iter;
+    EXPECT_EQ(expected, build(true, 4)) << "iter=" << iter;
+  }
+}
+
+// A memory resource that counts the number of allocations.
+class CountingMemoryResource : public std::pmr::memory_resource {
+ public:
+  explicit CountingMemoryResource(std::pmr::memory_resource* upstream)
+      : upstream_(upstream) {}
+  int num_allocations() const { return num_allocations_; }
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    ++num_allocations_;
+    return upstream_->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    upstream_->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(const memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource* upstream_;
+  int num_allocations_ = 0;
+};
+
+TEST(S2Builder, MemoryResource) {
+  // Checks that using a memory resource does not change the output, that the
+  // resource is actually used, and that it works with memory tracking.
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3000);
+  S2Polygon input(fractal.MakeLoop(S2Testing::GetRandomFrame(),
+                                   S1Angle::Degrees(10)));
+  S2Builder::Options options(S2CellIdSnapFunction(12));
+  options.set_simplify_edge_chains(true);
+  S2Builder expected_builder(options);
+  S2Polygon expected;
+  expected_builder.StartLayer(make_unique<S2PolygonLayer>(&expected));
+  expected_builder.AddPolygon(input);
+  S2Error error;
+  ASSERT_TRUE(expected_builder.Build(&error)) << error;
+
+  std::pmr::monotonic_buffer_resource arena;
+  CountingMemoryResource resource(&arena);
+  S2MemoryTracker tracker;
+  options.set_memory_resource(&resource);
+  options.set_memory_tracker(&tracker);
+  S2Builder builder(options);
+  for (int iter = 0; iter < 2; ++iter) {
+    S2Polygon output;
+    builder.StartLayer(make_unique<S2PolygonLayer>(&output));
+    builder.AddPolygon(input);
+    ASSERT_TRUE(builder.Build(&error)) << error;
+    EXPECT_TRUE(output.Equals(expected));
+  }
+  EXPECT_GT(resource.num_allocations(), 0);
+  EXPECT_GT(tracker.max_usage_bytes(), 0);
+}
+
+TEST(S2Builder, RetainCapacity) {
+  // Checks that reusing an S2Builder with retain_capacity() does not change
+  // the output, and that the retained memory is tracked consistently.
+  S2Testing::rnd.Reset(1);
+  S2MemoryTracker tracker;
+  S2Builder::Options options(S2CellIdSnapFunction(14));
+  options.set_simplify_edge_chains(true);
+  options.set_memory_tracker(&tracker);
+  options.set_retain_capacity(true);
+  S2Builder builder(options);
+  int64_t usage_bytes = -1;
+  for (int iter = 0; iter < 20; ++iter) {
+    // Use a different number of layers each time, including enough layers
+    // that vertex filtering is used (see S2Builder::BuildLayers).
+    int num_layers = (iter % 5 == 4) ? 12 : 1 + iter % 3;
+    S2Fractal fractal;
+    fractal.SetLevelForApproxMaxEdges(300);
+    vector<S2Polygon> inputs;
+    for (int i = 0; i < num_layers; ++i) {
+      inputs.emplace_back(fractal.MakeLoop(
+          S2Testing::GetRandomFrame(), S1Angle::Degrees(1 + i)));
+    }
+    S2Builder::Options expected_options = options;
+    expected_options.set_memory_tracker(nullptr);
+    expected_options.set_retain_capacity(false);
+    S2Builder expected_builder(expected_options);
+    vector<S2Polygon> expected(num_layers), output(num_layers);
+    for (int i = 0; i < num_layers; ++i) {
+      expected_builder.StartLayer(make_unique<S2PolygonLayer>(&expected[i]));
+      expected_builder.AddPolygon(inputs[i]);
+      builder.StartLayer(make_unique<S2PolygonLayer>(&output[i]));
+      builder.AddPolygon(inputs[i]);
+    }
+    S2Error error;
+    ASSERT_TRUE(expected_builder.Build(&error)) << error;
+    ASSERT_TRUE(builder.Build(&error)) << error;
+    for (int i = 0; i < num_layers; ++i) {
+      EXPECT_TRUE(output[i].Equals(expected[i])) << "iter=" << iter;
+    }
+    // Repeating the last input does not change the amount of memory used.
+    if (iter == 19) {
+      usage_bytes = tracker.usage_bytes();
+      for (int i = 0; i < num_layers; ++i) {
+        builder.StartLayer(make_unique<S2PolygonLayer>(&output[i]));
+        builder.AddPolygon(inputs[i]);
+      }
+      ASSERT_TRUE(builder.Build(&error)) << error;
+      EXPECT_EQ(usage_bytes, tracker.usage_bytes());
+    }
+  }
+  EXPECT_GT(usage_bytes, 0);
+}
+
 void TestSnappingWithForcedVertices(string_view input_str, S1Angle snap_radius,
                                     string_view vertices_str,
                                     string_view expected_str) {
@@ -18,10 +18,13 @@
 #include "s2/s2builderutil_lax_polygon_layer.h"
 
 #include <algorithm>
+#include <numeric>
 #include <utility>
 #include <vector>
 
 #include "absl/log/absl_check.h"
+#include "s2/base/types.h"
+#include "s2/encoded_s2point_vector.h"
 #include "s2/id_set_lexicon.h"
 #include "s2/s2builder.h"
 #include "s2/s2builder_graph.h"
@@ -30,6 +33,7 @@
 #include "s2/s2error.h"
 #include "s2/s2lax_polygon_shape.h"
 #include "s2/s2point.h"
+#include "s2/util/coding/coder.h"
 
 using std::vector;
 
@@ -44,6 +48,7 @@ using SiblingPairs = GraphOptions::SiblingPairs;
 
 using Edge = Graph::Edge;
 using EdgeId = Graph::EdgeId;
+using EdgeLoop = Graph::EdgeLoop;
 using InputEdgeIdSetId = Graph::InputEdgeIdSetId;
 using LoopType = Graph::LoopType;
 
@@ -62,6 +67,18 @@ LaxPolygonLayer::LaxPolygonLayer(
   Init(polygon, label_set_ids, label_set_lexicon, options);
 }
 
+LaxPolygonLayer::LaxPolygonLayer(Encoder* encoder, s2coding::CodingHint hint,
+                                 const Options& options) {
+  Init(nullptr, nullptr, nullptr, options);
+  encoder_ = encoder;
+  hint_ = hint;
+}
+
+LaxPolygonLayer::LaxPolygonLayer(Callback callback, const Options& options) {
+  Init(nullptr, nullptr, nullptr, options);
+  callback_ = std::move(callback);
+}
+
 void LaxPolygonLayer::Init(
     S2LaxPolygonShape* polygon, LabelSetIds* label_set_ids,
     IdSetLexicon* label_set_lexicon, const Options& options) {
@@ -98,6 +115,80 @@ void LaxPolygonLayer::AppendPolygonLoops(
   }
 }
 
+void LaxPolygonLayer::EncodePolygonLoops(
+    const Graph& g, const vector<Graph::EdgeLoop>& edge_loops,
+    int num_full_loops) const {
+  // The vertices of all loops are gathered into a single vector, which is
+  // the representation used by S2LaxPolygonShape itself.
+  vector<S2Point> vertices;
+  vector<uint32> loop_starts(1 + num_full_loops, 0);
+  for (const auto& edge_loop : edge_loops) {
+    for (auto edge_id : edge_loop) {
+      vertices.push_back(g.vertex(g.edge(edge_id).first));
+    }
+    loop_starts.push_back(vertices.size());
+  }
+  S2LaxPolygonShape::EncodeLoops(vertices, loop_starts, hint_, encoder_);
+}
+
+void LaxPolygonLayer::StreamPolygonLoops(
+    const Graph& g, vector<EdgeLoop>* edge_loops,
+    vector<vector<S2Point>> full_loops, S2Error* error) const {
+  if (!full_loops.empty()) {
+    callback_(std::move(full_loops), error);
+    if (!error->ok()) return;
+  }
+  // Group the loops into connected components by merging the sets of loops
+  // that share a vertex (using union-find).
+  const int num_loops = edge_loops->size();
+  vector<int> parent(num_loops);
+  std::iota(parent.begin(), parent.end(), 0);
+  auto find = [&parent](int i) {
+    while (parent[i] != i) i = parent[i] = parent[parent[i]];
+    return i;
+  };
+  vector<int> vertex_loop(g.num_vertices(), -1);
+  for (int i = 0; i < num_loops; ++i) {
+    for (EdgeId e : (*edge_loops)[i]) {
+      int& j = vertex_loop[g.edge(e).first];
+      if (j < 0) {
+        j = i;
+      } else {
+        // Always link to the smaller root so that each root is the first
+        // loop of its component.
+        int a = find(i), b = find(j);
+        if (a != b) parent[std::max(a, b)] = std::min(a, b);
+      }
+    }
+  }
+  vector<int>().swap(vertex_loop);  // Release memory
+
+  // Sort the loops by component, preserving the loop order within each
+  // component and ordering the components by their first loop.
+  vector<int> order(num_loops);
+  for (int i = 0; i < num_loops; ++i) parent[i] = find(i);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&parent](int i, int j) {
+    return parent[i] < parent[j];
+  });
+  vector<vector<S2Point>> loops;
+  for (int k = 0; k < num_loops; ++k) {
+    EdgeLoop& edge_loop = (*edge_loops)[order[k]];
+    vector<S2Point> vertices;
+    vertices.reserve(edge_loop.size());
+    for (EdgeId e : edge_loop) {
+      vertices.push_back(g.vertex(g.edge(e).first));
+    }
+    EdgeLoop().swap(edge_loop);  // Release memory
+    loops.push_back(std::move(vertices));
+    if (k + 1 == num_loops || parent[order[k + 1]] != parent[order[k]]) {
+      callback_(std::move(loops), error);
+      if (!error->ok()) return;
+      loops.clear();
+    }
+  }
+}
+
 void LaxPolygonLayer::AppendEdgeLabels(
     const Graph& g,
     const vector<Graph::EdgeLoop>& edge_loops) {
@@ -197,8 +288,20 @@ void LaxPolygonLayer::BuildDirected(Graph g, S2Error* error) {
   if (!g.GetDirectedLoops(LoopType::CIRCUIT, &edge_loops, error)) {
     return;
   }
-  AppendPolygonLoops(g, edge_loops, &loops);
   AppendEdgeLabels(g, edge_loops);
+  if (callback_) {
+    if (!error->ok()) return;
+    // At this point "loops" contains only the full loop (if any).
+    StreamPolygonLoops(g, &edge_loops, std::move(loops), error);
+    return;
+  }
+  if (encoder_ != nullptr) {
+    if (!error->ok()) return;
+    // At this point "loops" contains only the full loop (if any).
+    EncodePolygonLoops(g, edge_loops, loops.size());
+    return;
+  }
+  AppendPolygonLoops(g, edge_loops, &loops);
   vector<Graph::EdgeLoop>().swap(edge_loops);  // Release memory
   vector<Edge>().swap(new_edges);
   vector<InputEdgeIdSetId>().swap(new_input_edge_id_set_ids);
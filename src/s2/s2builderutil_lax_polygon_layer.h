@@ -32,11 +32,13 @@
 #ifndef S2_S2BUILDERUTIL_LAX_POLYGON_LAYER_H_
 #define S2_S2BUILDERUTIL_LAX_POLYGON_LAYER_H_
 
+#include <functional>
 #include <memory>
 #include <utility>
 #include <vector>
 
 #include "s2/base/types.h"
+#include "s2/encoded_s2point_vector.h"
 #include "s2/id_set_lexicon.h"
 #include "s2/mutable_s2shape_index.h"
 #include "s2/s2builder.h"
@@ -46,6 +48,7 @@
 #include "s2/s2lax_polygon_shape.h"
 #include "s2/s2point.h"
 #include "s2/s2shape.h"
+#include "s2/util/coding/coder.h"
 
 namespace s2builderutil {
 
@@ -143,21 +146,53 @@ class LaxPolygonLayer : public S2Builder::Layer {
   // Layer interface:
   GraphOptions graph_options() const override;
   void Build(const Graph& g, S2Error* error) override;
+  bool supports_concurrent_build() const override {
+    return label_set_lexicon_ == nullptr;
+  }
 
  private:
+  friend class EncodedLaxPolygonLayer;
+  friend class StreamingLaxPolygonLayer;
+
+  using Callback = std::function<void(
+      std::vector<std::vector<S2Point>> loops, S2Error* error)>;
+
+  // Specifies that the polygon should be encoded to "encoder" rather than
+  // being returned as an S2LaxPolygonShape (see EncodedLaxPolygonLayer).
+  LaxPolygonLayer(Encoder* encoder, s2coding::CodingHint hint,
+                  const Options& options);
+
+  // Specifies that the loops of the polygon should be passed to "callback"
+  // one connected component at a time (see StreamingLaxPolygonLayer).
+  LaxPolygonLayer(Callback callback, const Options& options);
+
   void Init(S2LaxPolygonShape* polygon, LabelSetIds* label_set_ids,
             IdSetLexicon* label_set_lexicon, const Options& options);
   void AppendPolygonLoops(const Graph& g,
                           const std::vector<Graph::EdgeLoop>& edge_loops,
                           std::vector<std::vector<S2Point>>* loops) const;
+  void EncodePolygonLoops(const Graph& g,
+                          const std::vector<Graph::EdgeLoop>& edge_loops,
+                          int num_full_loops) const;
   void AppendEdgeLabels(const Graph& g,
                         const std::vector<Graph::EdgeLoop>& edge_loops);
+  void StreamPolygonLoops(const Graph& g,
+                          std::vector<Graph::EdgeLoop>* edge_loops,
+                          std::vector<std::vector<S2Point>> full_loops,
+                          S2Error* error) const;
   void BuildDirected(Graph g, S2Error* error);
 
   S2LaxPolygonShape* polygon_;
   LabelSetIds* label_set_ids_;
   IdSetLexicon* label_set_lexicon_;
   Options options_;
+
+  // If non-null, the polygon is encoded here instead of into "polygon_".
+  Encoder* encoder_ = nullptr;
+  s2coding::CodingHint hint_ = s2coding::CodingHint::COMPACT;
+
+  // If non-empty, the loops are passed here instead of to "polygon_".
+  Callback callback_;
 };
 
 // Like LaxPolygonLayer, but adds the polygon to a MutableS2ShapeIndex (if the
@@ -187,6 +222,81 @@ class IndexedLaxPolygonLayer : public S2Builder::Layer {
   LaxPolygonLayer layer_;
 };
 
+// Like LaxPolygonLayer, but appends the polygon to "encoder" in the format
+// produced by S2LaxPolygonShape::Encode() (which can be decoded using either
+// S2LaxPolygonShape or EncodedS2LaxPolygonShape).  This is equivalent to
+// building an S2LaxPolygonShape and then encoding it (e.g., using
+// s2shapeutil::CompactEncodeShape), except that the intermediate shape is
+// never constructed.  Nothing is appended if an error occurs.
+//
+// REQUIRES: "encoder" uses the default constructor, so that its buffer
+//           can be enlarged as necessary by calling Ensure(int).
+class EncodedLaxPolygonLayer : public S2Builder::Layer {
+ public:
+  using Options = LaxPolygonLayer::Options;
+  explicit EncodedLaxPolygonLayer(
+      Encoder* encoder,
+      s2coding::CodingHint hint = s2coding::CodingHint::COMPACT,
+      const Options& options = Options())
+      : layer_(encoder, hint, options) {}
+
+  GraphOptions graph_options() const override {
+    return layer_.graph_options();
+  }
+
+  void Build(const Graph& g, S2Error* error) override {
+    layer_.Build(g, error);
+  }
+
+ private:
+  LaxPolygonLayer layer_;
+};
+
+// Like LaxPolygonLayer, but passes the loops of the polygon to the given
+// callback as they are assembled rather than constructing an
+// S2LaxPolygonShape.  This is useful when the output is too large to keep in
+// memory, e.g. when the loops are written to disk.
+//
+// The loops are passed one connected component at a time, where a component
+// consists of the loops that are connected to each other by shared vertices.
+// (If the result is the full polygon, the first component consists of the
+// empty "full loop".)  Note that a component is not a polygon by itself,
+// since a hole that does not touch its shell belongs to a different
+// component than the shell.  Instead the polygon consists of all the loops
+// that were passed to the callback, so that for example
+//
+//   S2LaxPolygonShape polygon(all_loops);
+//
+// is equivalent to the polygon constructed by LaxPolygonLayer, except that
+// the loops of each component are contiguous.
+//
+// The callback may set "error" to stop the layer, in which case no further
+// loops are passed to it and the error is returned by S2Builder::Build().
+// Loops are not passed to the callback if S2Builder reports an error.
+//
+// Note that S2Builder still constructs the full output graph of the layer,
+// and frees it only when all layers have been built.  The callback is always
+// called on the thread that calls S2Builder::Build().
+class StreamingLaxPolygonLayer : public S2Builder::Layer {
+ public:
+  using Options = LaxPolygonLayer::Options;
+  using Callback = LaxPolygonLayer::Callback;
+  explicit StreamingLaxPolygonLayer(Callback callback,
+                                    const Options& options = Options())
+      : layer_(std::move(callback), options) {}
+
+  GraphOptions graph_options() const override {
+    return layer_.graph_options();
+  }
+
+  void Build(const Graph& g, S2Error* error) override {
+    layer_.Build(g, error);
+  }
+
+ private:
+  LaxPolygonLayer layer_;
+};
+
 
 //////////////////   Implementation details follow   ////////////////////
 
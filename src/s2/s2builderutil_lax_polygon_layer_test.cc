@@ -29,10 +29,12 @@
 #include "absl/base/optimization.h"
 #include "absl/container/btree_set.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
 
 #include "s2/base/casts.h"
 #include "s2/base/types.h"
+#include "s2/encoded_s2point_vector.h"
 #include "s2/id_set_lexicon.h"
 #include "s2/mutable_s2shape_index.h"
 #include "s2/s2builder.h"
@@ -43,12 +45,15 @@
 #include "s2/s2point.h"
 #include "s2/s2shape.h"
 #include "s2/s2text_format.h"
+#include "s2/util/coding/coder.h"
 
 using absl::btree_set;
 using absl::flat_hash_map;
 using absl::string_view;
+using s2builderutil::EncodedLaxPolygonLayer;
 using s2builderutil::IndexedLaxPolygonLayer;
 using s2builderutil::LaxPolygonLayer;
+using s2builderutil::StreamingLaxPolygonLayer;
 using s2textformat::MakeLaxPolygonOrDie;
 using s2textformat::MakePointOrDie;
 using s2textformat::MakePolylineOrDie;
@@ -56,6 +61,8 @@ using std::make_unique;
 using std::string;
 using std::vector;
 
+using s2coding::CodingHint;
+
 using EdgeType = S2Builder::EdgeType;
 using DegenerateBoundaries = LaxPolygonLayer::Options::DegenerateBoundaries;
 
@@ -377,4 +384,134 @@ TEST(IndexedLaxPolygonLayer, IgnoresEmptyShape) {
   EXPECT_EQ(0, index.num_shape_ids());
 }
 
+// Checks that EncodedLaxPolygonLayer yields the same encoding as building an
+// S2LaxPolygonShape with LaxPolygonLayer and then encoding it.
+void TestEncodedLaxPolygon(string_view input_str,
+                           DegenerateBoundaries degenerate_boundaries,
+                           CodingHint hint) {
+  SCOPED_TRACE(input_str);
+  SCOPED_TRACE(ToString(degenerate_boundaries));
+  auto polygon = MakeLaxPolygonOrDie(input_str);
+  bool has_full_loop = false;
+  for (int i = 0; i < polygon->num_loops(); ++i) {
+    if (polygon->num_loop_vertices(i) == 0) has_full_loop = true;
+  }
+  LaxPolygonLayer::Options options;
+  options.set_degenerate_boundaries(degenerate_boundaries);
+  S2Builder builder{S2Builder::Options()};
+  S2LaxPolygonShape output;
+  builder.StartLayer(make_unique<LaxPolygonLayer>(&output, options));
+  builder.AddShape(*polygon);
+  builder.AddIsFullPolygonPredicate(S2Builder::IsFullPolygon(has_full_loop));
+  Encoder actual;
+  builder.StartLayer(
+      make_unique<EncodedLaxPolygonLayer>(&actual, hint, options));
+  builder.AddShape(*polygon);
+  builder.AddIsFullPolygonPredicate(S2Builder::IsFullPolygon(has_full_loop));
+  S2Error error;
+  ASSERT_TRUE(builder.Build(&error)) << error;
+
+  Encoder expected;
+  output.Encode(&expected, hint);
+  EXPECT_EQ(string(expected.base(), expected.length()),
+            string(actual.base(), actual.length()));
+  Decoder decoder(actual.base(), actual.length());
+  EncodedS2LaxPolygonShape decoded;
+  ASSERT_TRUE(decoded.Init(&decoder));
+  EXPECT_EQ(s2textformat::ToString(static_cast<const S2Shape&>(output)),
+            s2textformat::ToString(decoded));
+}
+
+TEST(EncodedLaxPolygonLayer, MatchesLaxPolygonLayer) {
+  for (string_view input_str :
+       {"", "full", "0:0, 0:10, 10:0",
+        "0:0, 0:9, 9:9, 9:0; 0:10, 0:19, 9:19, 9:10; 1:11, 8:11, 8:18, 1:18",
+        "0:0, 0:9, 9:9, 9:0; 2:5; 3:6, 3:7; 20:20; 10:0, 10:1",
+        "full; 2:5; 3:6, 3:7"}) {
+    for (auto db : kAllDegenerateBoundaries()) {
+      for (auto hint : {CodingHint::FAST, CodingHint::COMPACT}) {
+        TestEncodedLaxPolygon(input_str, db, hint);
+      }
+    }
+  }
+}
+
+TEST(EncodedLaxPolygonLayer, NothingAppendedOnError) {
+  S2Builder builder{S2Builder::Options()};
+  Encoder encoder;
+  builder.StartLayer(make_unique<EncodedLaxPolygonLayer>(&encoder));
+  builder.AddPolyline(*MakePolylineOrDie("0:1, 2:3, 4:5"));
+  S2Error error;
+  EXPECT_FALSE(builder.Build(&error));
+  EXPECT_EQ(S2Error::BUILDER_EDGES_DO_NOT_FORM_LOOPS, error.code());
+  EXPECT_EQ(0, encoder.length());
+}
+
+// Checks that StreamingLaxPolygonLayer passes the loops of each connected
+// component to the callback, and that together these loops form the same
+// polygon as LaxPolygonLayer.
+void TestStreamingLaxPolygon(string_view input_str,
+                             DegenerateBoundaries degenerate_boundaries,
+                             string_view expected_components) {
+  SCOPED_TRACE(input_str);
+  SCOPED_TRACE(ToString(degenerate_boundaries));
+  auto polygon = MakeLaxPolygonOrDie(input_str);
+  bool has_full_loop = false;
+  for (int i = 0; i < polygon->num_loops(); ++i) {
+    if (polygon->num_loop_vertices(i) == 0) has_full_loop = true;
+  }
+  LaxPolygonLayer::Options options;
+  options.set_degenerate_boundaries(degenerate_boundaries);
+  S2Builder builder{S2Builder::Options()};
+  S2LaxPolygonShape expected;
+  builder.StartLayer(make_unique<LaxPolygonLayer>(&expected, options));
+  builder.AddShape(*polygon);
+  builder.AddIsFullPolygonPredicate(S2Builder::IsFullPolygon(has_full_loop));
+  vector<vector<S2Point>> all_loops;
+  vector<int> component_sizes;
+  builder.StartLayer(make_unique<StreamingLaxPolygonLayer>(
+      [&](vector<vector<S2Point>> loops, S2Error* error) {
+        component_sizes.push_back(loops.size());
+        for (auto& loop : loops) all_loops.push_back(std::move(loop));
+      },
+      options));
+  builder.AddShape(*polygon);
+  builder.AddIsFullPolygonPredicate(S2Builder::IsFullPolygon(has_full_loop));
+  S2Error error;
+  ASSERT_TRUE(builder.Build(&error)) << error;
+  EXPECT_EQ(expected_components, absl::StrJoin(component_sizes, ","));
+  EXPECT_EQ(s2textformat::ToString(expected, "; "),
+            s2textformat::ToString(S2LaxPolygonShape(all_loops), "; "));
+}
+
+TEST(StreamingLaxPolygonLayer, MatchesLaxPolygonLayer) {
+  TestStreamingLaxPolygon("", DegenerateBoundaries::KEEP, "");
+  TestStreamingLaxPolygon("full", DegenerateBoundaries::KEEP, "1");
+  TestStreamingLaxPolygon("0:0, 0:10, 10:0", DegenerateBoundaries::KEEP, "1");
+  // The input is the same as in NormalAndDegenerateShellsAndHoles.  The two
+  // shells are connected by a sibling pair, so that the first three loops
+  // form a single component when degenerate boundaries are kept.
+  const string kInput =
+      "0:0, 0:9, 1:8, 1:7, 1:8, 0:9, 9:9, 9:0; "
+      "0:10, 0:19, 9:19, 9:10, 0:10, 1:11, 8:11, 8:18, 1:18, 1:11; "
+      "0:9, 0:10; 2:12; 3:13, 3:14; 20:20; 10:0, 10:1; 2:5; 3:6, 3:7; 8:8";
+  TestStreamingLaxPolygon(kInput, DegenerateBoundaries::KEEP,
+                          "3,1,1,1,1,1,1,1");
+  TestStreamingLaxPolygon(kInput, DegenerateBoundaries::DISCARD, "1,1,1");
+}
+
+TEST(StreamingLaxPolygonLayer, NothingPassedOnError) {
+  S2Builder builder{S2Builder::Options()};
+  int num_calls = 0;
+  builder.StartLayer(make_unique<StreamingLaxPolygonLayer>(
+      [&num_calls](vector<vector<S2Point>> loops, S2Error* error) {
+        ++num_calls;
+      }));
+  builder.AddPolyline(*MakePolylineOrDie("0:1, 2:3, 4:5"));
+  S2Error error;
+  EXPECT_FALSE(builder.Build(&error));
+  EXPECT_EQ(S2Error::BUILDER_EDGES_DO_NOT_FORM_LOOPS, error.code());
+  EXPECT_EQ(0, num_calls);
+}
+
 }  // namespace
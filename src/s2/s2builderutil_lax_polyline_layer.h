@@ -89,6 +89,9 @@ class LaxPolylineLayer : public S2Builder::Layer {
   // Layer interface:
   GraphOptions graph_options() const override;
   void Build(const Graph& g, S2Error* error) override;
+  bool supports_concurrent_build() const override {
+    return label_set_lexicon_ == nullptr;
+  }
 
  private:
   void Init(S2LaxPolylineShape* polyline, LabelSetIds* label_set_ids,
@@ -65,6 +65,9 @@ class S2PointVectorLayer : public S2Builder::Layer {
   // Layer interface:
   GraphOptions graph_options() const override;
   void Build(const Graph& g, S2Error* error) override;
+  bool supports_concurrent_build() const override {
+    return label_set_lexicon_ == nullptr;
+  }
 
  private:
   std::vector<S2Point>* points_;
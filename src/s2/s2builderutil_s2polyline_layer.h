@@ -100,6 +100,9 @@ class S2PolylineLayer : public S2Builder::Layer {
   // Layer interface:
   GraphOptions graph_options() const override;
   void Build(const Graph& g, S2Error* error) override;
+  bool supports_concurrent_build() const override {
+    return label_set_lexicon_ == nullptr;
+  }
 
  private:
   void Init(S2Polyline* polyline, LabelSetIds* label_set_ids,
@@ -58,6 +58,12 @@ S2PolylineVectorLayer::S2PolylineVectorLayer(
   Init(polylines, label_set_ids, label_set_lexicon, options);
 }
 
+S2PolylineVectorLayer::S2PolylineVectorLayer(Callback callback,
+                                             const Options& options) {
+  Init(nullptr, nullptr, nullptr, options);
+  callback_ = std::move(callback);
+}
+
 void S2PolylineVectorLayer::Init(vector<unique_ptr<S2Polyline>>* polylines,
                                  LabelSetIds* label_set_ids,
                                  IdSetLexicon* label_set_lexicon,
@@ -77,22 +83,29 @@ GraphOptions S2PolylineVectorLayer::graph_options() const {
 void S2PolylineVectorLayer::Build(const Graph& g, S2Error* error) {
   vector<Graph::EdgePolyline> edge_polylines = g.GetPolylines(
       options_.polyline_type());
-  polylines_->reserve(edge_polylines.size());
+  if (polylines_) polylines_->reserve(edge_polylines.size());
   if (label_set_ids_) label_set_ids_->reserve(edge_polylines.size());
   vector<S2Point> vertices;  // Temporary storage for vertices.
   vector<Label> labels;  // Temporary storage for labels.
-  for (const auto& edge_polyline : edge_polylines) {
+  for (auto& edge_polyline : edge_polylines) {
     vertices.push_back(g.vertex(g.edge(edge_polyline[0]).first));
     for (EdgeId e : edge_polyline) {
       vertices.push_back(g.vertex(g.edge(e).second));
     }
-    S2Polyline* polyline = new S2Polyline(vertices,
-                                          options_.s2debug_override());
+    auto polyline = std::make_unique<S2Polyline>(vertices,
+                                                 options_.s2debug_override());
     vertices.clear();
     if (options_.validate()) {
       polyline->FindValidationError(error);
     }
-    polylines_->emplace_back(polyline);
+    if (callback_) {
+      if (!error->ok()) return;
+      Graph::EdgePolyline().swap(edge_polyline);  // Release memory
+      callback_(std::move(polyline), error);
+      if (!error->ok()) return;
+      continue;
+    }
+    polylines_->push_back(std::move(polyline));
     if (label_set_ids_) {
       Graph::LabelFetcher fetcher(g, options_.edge_type());
       vector<LabelSetId> polyline_labels;
@@ -18,6 +18,7 @@
 #ifndef S2_S2BUILDERUTIL_S2POLYLINE_VECTOR_LAYER_H_
 #define S2_S2BUILDERUTIL_S2POLYLINE_VECTOR_LAYER_H_
 
+#include <functional>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -169,8 +170,20 @@ class S2PolylineVectorLayer : public S2Builder::Layer {
   // Layer interface:
   GraphOptions graph_options() const override;
   void Build(const Graph& g, S2Error* error) override;
+  bool supports_concurrent_build() const override {
+    return label_set_lexicon_ == nullptr;
+  }
 
  private:
+  friend class StreamingS2PolylineVectorLayer;
+
+  using Callback =
+      std::function<void(std::unique_ptr<S2Polyline> polyline, S2Error*)>;
+
+  // Specifies that each polyline should be passed to "callback" rather than
+  // being appended to a vector (see StreamingS2PolylineVectorLayer).
+  S2PolylineVectorLayer(Callback callback, const Options& options);
+
   void Init(std::vector<std::unique_ptr<S2Polyline>>* polylines,
             LabelSetIds* label_set_ids, IdSetLexicon* label_set_lexicon,
             const Options& options);
@@ -179,6 +192,9 @@ class S2PolylineVectorLayer : public S2Builder::Layer {
   LabelSetIds* label_set_ids_;
   IdSetLexicon* label_set_lexicon_;
   Options options_;
+
+  // If non-empty, polylines are passed here instead of to "polylines_".
+  Callback callback_;
 };
 
 // Like S2PolylineVectorLayer, but adds the polylines to a MutableS2ShapeIndex.
@@ -209,6 +225,40 @@ class IndexedS2PolylineVectorLayer : public S2Builder::Layer {
   S2PolylineVectorLayer layer_;
 };
 
+// Like S2PolylineVectorLayer, but passes each polyline to the given callback
+// as soon as it has been assembled rather than returning all the polylines
+// at once.  This is useful when the output is too large to keep in memory,
+// e.g. when each polyline is written to disk.  The polylines and their order
+// are the same as for S2PolylineVectorLayer.
+//
+// The callback may set "error" to stop the layer, in which case no further
+// polylines are passed to it and the error is returned by S2Builder::Build().
+// If options.validate() is true, polylines that fail validation are not
+// passed to the callback and the validation error is returned instead.
+//
+// Note that S2Builder still constructs the full output graph of the layer,
+// and frees it only when all layers have been built.  The callback is always
+// called on the thread that calls S2Builder::Build().
+class StreamingS2PolylineVectorLayer : public S2Builder::Layer {
+ public:
+  using Options = S2PolylineVectorLayer::Options;
+  using Callback = S2PolylineVectorLayer::Callback;
+  explicit StreamingS2PolylineVectorLayer(Callback callback,
+                                          const Options& options = Options())
+      : layer_(std::move(callback), options) {}
+
+  GraphOptions graph_options() const override {
+    return layer_.graph_options();
+  }
+
+  void Build(const Graph& g, S2Error* error) override {
+    layer_.Build(g, error);
+  }
+
+ private:
+  S2PolylineVectorLayer layer_;
+};
+
 
 //////////////////   Implementation details follow   ////////////////////
 
@@ -41,6 +41,7 @@
 using absl::string_view;
 using s2builderutil::IndexedS2PolylineVectorLayer;
 using s2builderutil::S2PolylineVectorLayer;
+using s2builderutil::StreamingS2PolylineVectorLayer;
 using s2textformat::MakePolylineOrDie;
 using std::make_unique;
 using std::string;
@@ -260,4 +261,43 @@ TEST(IndexedS2PolylineVectorLayer, AddsShapes) {
   EXPECT_EQ(polyline1_str, s2textformat::ToString(*polyline1));
 }
 
+TEST(StreamingS2PolylineVectorLayer, MatchesS2PolylineVectorLayer) {
+  S2Builder builder{S2Builder::Options()};
+  vector<unique_ptr<S2Polyline>> expected, actual;
+  builder.StartLayer(make_unique<S2PolylineVectorLayer>(&expected));
+  for (auto input_str : {"0:0, 0:10, 10:10", "5:5, 0:10", "20:20, 21:21"}) {
+    builder.AddPolyline(*MakePolylineOrDie(input_str));
+  }
+  builder.StartLayer(make_unique<StreamingS2PolylineVectorLayer>(
+      [&actual](unique_ptr<S2Polyline> polyline, S2Error* error) {
+        actual.push_back(std::move(polyline));
+      }));
+  for (auto input_str : {"0:0, 0:10, 10:10", "5:5, 0:10", "20:20, 21:21"}) {
+    builder.AddPolyline(*MakePolylineOrDie(input_str));
+  }
+  S2Error error;
+  ASSERT_TRUE(builder.Build(&error)) << error;
+  ASSERT_EQ(expected.size(), actual.size());
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(s2textformat::ToString(*expected[i]),
+              s2textformat::ToString(*actual[i]));
+  }
+}
+
+TEST(StreamingS2PolylineVectorLayer, CallbackError) {
+  S2Builder builder{S2Builder::Options()};
+  int num_calls = 0;
+  builder.StartLayer(make_unique<StreamingS2PolylineVectorLayer>(
+      [&num_calls](unique_ptr<S2Polyline> polyline, S2Error* error) {
+        ++num_calls;
+        error->Init(S2Error::DATA_LOSS, "Write failed");
+      }));
+  builder.AddPolyline(*MakePolylineOrDie("0:0, 1:1"));
+  builder.AddPolyline(*MakePolylineOrDie("2:2, 3:3"));
+  S2Error error;
+  EXPECT_FALSE(builder.Build(&error));
+  EXPECT_EQ(S2Error::DATA_LOSS, error.code());
+  EXPECT_EQ(1, num_calls);
+}
+
 }  // namespace
@@ -24,6 +24,7 @@
 
 #include "s2/base/types.h"
 #include "absl/log/absl_check.h"
+#include "absl/types/span.h"
 #include "s2/s1angle.h"
 #include "s2/s2builder.h"
 #include "s2/s2cell_id.h"
@@ -206,6 +207,21 @@ S2Point S2CellIdSnapFunction::SnapPoint(const S2Point& point) const {
   return S2CellId(point).parent(level_).ToPoint();
 }
 
+void S2CellIdSnapFunction::SnapPoints(absl::Span<const S2Point> points,
+                                      absl::Span<S2Point> sites) const {
+  ABSL_DCHECK_EQ(points.size(), sites.size());
+  S2CellId prev_id = S2CellId::None();
+  S2Point prev_site;
+  for (size_t i = 0; i < points.size(); ++i) {
+    S2CellId id = S2CellId(points[i]).parent(level_);
+    if (id != prev_id) {
+      prev_id = id;
+      prev_site = id.ToPoint();
+    }
+    sites[i] = prev_site;
+  }
+}
+
 unique_ptr<S2Builder::SnapFunction> S2CellIdSnapFunction::Clone() const {
   return make_unique<S2CellIdSnapFunction>(*this);
 }
@@ -351,6 +367,35 @@ S2Point IntLatLngSnapFunction::SnapPoint(const S2Point& point) const {
   return S2LatLng::FromDegrees(lat * to_degrees_, lng * to_degrees_).ToPoint();
 }
 
+void IntLatLngSnapFunction::SnapPoints(absl::Span<const S2Point> points,
+                                       absl::Span<S2Point> sites) const {
+  ABSL_DCHECK_GE(exponent_, 0);  // Make sure the snap function was initialized.
+  ABSL_DCHECK_EQ(points.size(), sites.size());
+  // This computes exactly the same values as SnapPoint() and
+  // S2LatLng::ToPoint(), but caches the trigonometric functions of the
+  // previous snapped latitude and longitude.
+  int64 prev_lat = 0, prev_lng = 0;
+  double sin_lat = 0, cos_lat = 1, sin_lng = 0, cos_lng = 1;
+  for (size_t i = 0; i < points.size(); ++i) {
+    S2LatLng input(points[i]);
+    int64 lat = MathUtil::FastInt64Round(input.lat().degrees() * from_degrees_);
+    int64 lng = MathUtil::FastInt64Round(input.lng().degrees() * from_degrees_);
+    if (lat != prev_lat) {
+      double phi = S1Angle::Degrees(lat * to_degrees_).radians();
+      sin_lat = sin(phi);
+      cos_lat = cos(phi);
+      prev_lat = lat;
+    }
+    if (lng != prev_lng) {
+      double theta = S1Angle::Degrees(lng * to_degrees_).radians();
+      sin_lng = sin(theta);
+      cos_lng = cos(theta);
+      prev_lng = lng;
+    }
+    sites[i] = S2Point(cos_lng * cos_lat, sin_lng * cos_lat, sin_lat);
+  }
+}
+
 unique_ptr<S2Builder::SnapFunction> IntLatLngSnapFunction::Clone() const {
   return make_unique<IntLatLngSnapFunction>(*this);
 }
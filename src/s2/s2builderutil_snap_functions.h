@@ -20,6 +20,7 @@
 
 #include <memory>
 
+#include "absl/types/span.h"
 #include "s2/s1angle.h"
 #include "s2/s2builder.h"
 #include "s2/s2cell_id.h"
@@ -136,6 +137,12 @@ class S2CellIdSnapFunction : public S2Builder::SnapFunction {
 
   S2Point SnapPoint(const S2Point& point) const override;
 
+  // Equivalent to calling SnapPoint() on each point, except that the cell
+  // center is only recomputed when a point is not in the same cell as the
+  // previous point.
+  void SnapPoints(absl::Span<const S2Point> points,
+                  absl::Span<S2Point> sites) const override;
+
   std::unique_ptr<SnapFunction> Clone() const override;
 
  private:
@@ -227,6 +234,13 @@ class IntLatLngSnapFunction : public S2Builder::SnapFunction {
   // or more.
   S1Angle min_edge_vertex_separation() const override;
   S2Point SnapPoint(const S2Point& point) const override;
+
+  // Equivalent to calling SnapPoint() on each point, except that the sine and
+  // cosine of the snapped latitude (or longitude) are only recomputed when
+  // it differs from the one of the previous point.
+  void SnapPoints(absl::Span<const S2Point> points,
+                  absl::Span<S2Point> sites) const override;
+
   std::unique_ptr<SnapFunction> Clone() const override;
 
  private:
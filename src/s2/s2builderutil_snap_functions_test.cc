@@ -42,12 +42,14 @@
 #include "absl/log/absl_log.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 
 #include "s2/base/types.h"
 #include "s2/base/log_severity.h"
 #include "s2/r2.h"
 #include "s2/s1angle.h"
 #include "s2/s2builder.h"
+#include "s2/s2cap.h"
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2edge_distances.h"
@@ -99,6 +101,35 @@ TEST(S2CellIdSnapFunction, SnapPoint) {
   }
 }
 
+// Returns points that are clustered together, so that many adjacent points
+// snap to the same cell or share a snapped latitude or longitude.  Also
+// includes points near latitude and longitude zero.
+vector<S2Point> MakeClusteredPoints() {
+  vector<S2Point> points = {S2Point(1, 0, 0), S2Point(1, 1e-9, 0),
+                            S2Point(1, 0, -1e-9), S2Point(1, -1e-9, 1e-9)};
+  for (int i = 0; i < 100; ++i) {
+    S2Cap cap(S2Testing::RandomPoint(),
+              S1Angle::Degrees(pow(1e-6, S2Testing::rnd.RandDouble())));
+    for (int j = 0; j < 20; ++j) {
+      points.push_back(S2Testing::SamplePoint(cap));
+    }
+  }
+  return points;
+}
+
+TEST(S2CellIdSnapFunction, SnapPointsMatchesSnapPoint) {
+  S2Testing::rnd.Reset(1);
+  vector<S2Point> points = MakeClusteredPoints();
+  vector<S2Point> sites(points.size());
+  for (int level = 0; level <= S2CellId::kMaxLevel; ++level) {
+    S2CellIdSnapFunction f(level);
+    f.SnapPoints(points, absl::MakeSpan(sites));
+    for (size_t i = 0; i < points.size(); ++i) {
+      EXPECT_EQ(f.SnapPoint(points[i]), sites[i]);
+    }
+  }
+}
+
 TEST(IntLatLngSnapFunction, ExponentToFromSnapRadius) {
   for (int exponent = IntLatLngSnapFunction::kMinExponent;
        exponent <= IntLatLngSnapFunction::kMaxExponent; ++exponent) {
@@ -212,6 +243,21 @@ static double GetS2CellIdMinVertexSeparation(
   return scores[0].first;
 }
 
+TEST(IntLatLngSnapFunction, SnapPointsMatchesSnapPoint) {
+  S2Testing::rnd.Reset(1);
+  vector<S2Point> points = MakeClusteredPoints();
+  vector<S2Point> sites(points.size());
+  for (int exponent = IntLatLngSnapFunction::kMinExponent;
+       exponent <= IntLatLngSnapFunction::kMaxExponent; ++exponent) {
+    IntLatLngSnapFunction f(exponent);
+    f.SnapPoints(points, absl::MakeSpan(sites));
+    for (size_t i = 0; i < points.size(); ++i) {
+      // The results must be bitwise identical.
+      EXPECT_EQ(f.SnapPoint(points[i]), sites[i]);
+    }
+  }
+}
+
 TEST(S2CellIdSnapFunction, MinVertexSeparationSnapRadiusRatio) {
   // The purpose of this "test" is to compute a lower bound to the fraction
   // (min_vertex_separation() / snap_radius()).  Essentially this involves
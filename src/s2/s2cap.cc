@@ -27,11 +27,13 @@
 #include "absl/log/absl_check.h"
 #include "s2/util/coding/coder.h"
 #include "s2/r1interval.h"
+#include "s2/r2rect.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s1interval.h"
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
+#include "s2/s2coords.h"
 #include "s2/s2debug.h"
 #include "s2/s2edge_distances.h"
 #include "s2/s2latlng.h"
@@ -42,6 +44,7 @@
 
 using std::fabs;
 using std::max;
+using std::min;
 using std::vector;
 
 double S2Cap::GetArea() const {
@@ -291,6 +294,60 @@ bool S2Cap::MayIntersect(const S2Cell& cell) const {
   return Intersects(cell, vertices);
 }
 
+void S2Cap::GetChildRelations(const S2Cell children[4], bool check_contains,
+                              CellRelation relations[4]) const {
+  // The four children have only 9 distinct vertices, so we compute each one
+  // (and test whether the cap contains it) only once.  Sibling cells have
+  // exactly the same (u,v) coordinates along their shared edges, so these
+  // vertices are identical to the ones returned by S2Cell::GetVertex().
+  double u_min = children[0].GetBoundUV()[0].lo();
+  double v_min = children[0].GetBoundUV()[1].lo();
+  for (int i = 1; i < 4; ++i) {
+    u_min = min(u_min, children[i].GetBoundUV()[0].lo());
+    v_min = min(v_min, children[i].GetBoundUV()[1].lo());
+  }
+  int col[4], row[4];
+  double u[3], v[3];
+  for (int i = 0; i < 4; ++i) {
+    const R2Rect uv = children[i].GetBoundUV();
+    col[i] = uv[0].lo() == u_min ? 0 : 1;
+    row[i] = uv[1].lo() == v_min ? 0 : 1;
+    u[col[i]] = uv[0].lo();
+    u[col[i] + 1] = uv[0].hi();
+    v[row[i]] = uv[1].lo();
+    v[row[i] + 1] = uv[1].hi();
+  }
+  const int face = children[0].face();
+  S2Point grid[3][3];
+  bool grid_contains[3][3];
+  for (int a = 0; a < 3; ++a) {
+    for (int b = 0; b < 3; ++b) {
+      grid[a][b] = S2::FaceUVtoXYZ(face, u[a], v[b]).Normalize();
+      grid_contains[a][b] = Contains(grid[a][b]);
+    }
+  }
+  const S2Cap complement = check_contains ? Complement() : S2Cap();
+  for (int i = 0; i < 4; ++i) {
+    // Vertex k of a cell is at the (u,v) position given by R2Rect::GetVertex.
+    S2Point vertices[4];
+    int num_contained = 0;
+    for (int k = 0; k < 4; ++k) {
+      const int a = col[i] + ((k >> 1) ^ (k & 1));
+      const int b = row[i] + (k >> 1);
+      vertices[k] = grid[a][b];
+      num_contained += grid_contains[a][b];
+    }
+    if (num_contained == 0 && !Intersects(children[i], vertices)) {
+      relations[i] = CellRelation::DISJOINT;
+    } else if (check_contains && num_contained == 4 &&
+               !complement.Intersects(children[i], vertices)) {
+      relations[i] = CellRelation::CONTAINS;
+    } else {
+      relations[i] = CellRelation::MAY_INTERSECT;
+    }
+  }
+}
+
 bool S2Cap::Contains(const S2Point& p) const {
   ABSL_DCHECK(S2::IsUnitLength(p));
   return S1ChordAngle(center_, p) <= radius_;
@@ -194,6 +194,8 @@ class S2Cap final : public S2Region {
   void GetCellUnionBound(std::vector<S2CellId> *cell_ids) const override;
   bool Contains(const S2Cell& cell) const override;
   bool MayIntersect(const S2Cell& cell) const override;
+  void GetChildRelations(const S2Cell children[4], bool check_contains,
+                         CellRelation relations[4]) const override;
 
   // The point "p" should be a unit-length vector.
   bool Contains(const S2Point& p) const override;
@@ -318,18 +318,25 @@ bool S2Cell::Decode(Decoder* const decoder) {
   return true;
 }
 
+// Returns the squared chord distance from point P to the cell vertex with the
+// given (u,v)-coordinates.
+static inline S1ChordAngle UVVertexChordDist(const S2Point& p, double u,
+                                             double v) {
+  S2Point vertex = S2Point(u, v, 1).Normalize();
+  return S1ChordAngle(p, vertex);
+}
+
 // Return the squared chord distance from point P to corner vertex (i,j).
 inline S1ChordAngle S2Cell::VertexChordDist(
     const S2Point& p, int i, int j) const {
-  S2Point vertex = S2Point(uv_[0][i], uv_[1][j], 1).Normalize();
-  return S1ChordAngle(p, vertex);
+  return UVVertexChordDist(p, uv_[0][i], uv_[1][j]);
 }
 
-// Given a point P and either the lower or upper edge of the S2Cell (specified
-// by setting "v_end" to 0 or 1 respectively), return true if P is closer to
-// the interior of that edge than it is to either endpoint.
-bool S2Cell::UEdgeIsClosest(const S2Point& p, int v_end) const {
-  double u0 = uv_[0][0], u1 = uv_[0][1], v = uv_[1][v_end];
+// Given a point P and the (u,v)-coordinates of a cell edge of constant "v"
+// from "u0" to "u1", return true if P is closer to the interior of that edge
+// than it is to either endpoint.
+static inline bool UEdgeIsClosest(const S2Point& p, double u0, double u1,
+                                  double v) {
   // These are the normals to the planes that are perpendicular to the edge
   // and pass through one of its two endpoints.
   S2Point dir0(v * v + 1, -u0 * v, -u0);
@@ -337,11 +344,9 @@ bool S2Cell::UEdgeIsClosest(const S2Point& p, int v_end) const {
   return p.DotProd(dir0) > 0 && p.DotProd(dir1) < 0;
 }
 
-// Given a point P and either the left or right edge of the S2Cell (specified
-// by setting "u_end" to 0 or 1 respectively), return true if P is closer to
-// the interior of that edge than it is to either endpoint.
-bool S2Cell::VEdgeIsClosest(const S2Point& p, int u_end) const {
-  double v0 = uv_[1][0], v1 = uv_[1][1], u = uv_[0][u_end];
+// Like UEdgeIsClosest, but for an edge of constant "u" from "v0" to "v1".
+static inline bool VEdgeIsClosest(const S2Point& p, double v0, double v1,
+                                  double u) {
   // See comments above.
   S2Point dir0(-u * v0, u * u + 1, -v0);
   S2Point dir1(-u * v1, u * u + 1, -v1);
@@ -366,35 +371,46 @@ inline static S1ChordAngle EdgeDistance(double dirIJ, double uv) {
   return S1ChordAngle::FromLength2(pq2 + qr * qr);
 }
 
-S1ChordAngle S2Cell::GetDistanceInternal(const S2Point& target_xyz,
-                                         bool to_interior) const {
-  // All calculations are done in the (u,v,w) coordinates of this cell's face.
-  S2Point target = S2::FaceXYZtoUVW(face_, target_xyz);
-
-  // Compute dot products with all four upward or rightward-facing edge
-  // normals.  "dirIJ" is the dot product for the edge corresponding to axis
-  // I, endpoint J.  For example, dir01 is the right edge of the S2Cell
-  // (corresponding to the upper endpoint of the u-axis).
-  double dir00 = target[0] - target[2] * uv_[0][0];
-  double dir01 = target[0] - target[2] * uv_[0][1];
-  double dir10 = target[1] - target[2] * uv_[1][0];
-  double dir11 = target[1] - target[2] * uv_[1][1];
+// Returns the distance from "target" (in the (u,v,w) coordinates of the
+// cell's face) to the interior of the cell with bounds [u[0], u[1]] x
+// [v[0], v[1]] if "to_interior" is true, and to its boundary otherwise.
+// "dir_u[k]" and "dir_v[k]" must be the dot products of "target" with the
+// normals of the cell edges at u[k] and v[k] respectively, and
+// "vertex_dist(i, j)" must return the distance to the vertex (u[i], v[j]).
+// This allows the work to be shared between adjacent cells.
+template <class VertexDist>
+static inline S1ChordAngle GetUVRectDistance(
+    const S2Point& target, const double u[2], const double v[2],
+    const double dir_u[2], const double dir_v[2], bool to_interior,
+    VertexDist vertex_dist) {
+  // "dirIJ" in the comments below is the dot product for the edge
+  // corresponding to axis I, endpoint J.  For example, dir01 (i.e., dir_u[1])
+  // is the right edge of the S2Cell (corresponding to the upper endpoint of
+  // the u-axis).
   bool inside = true;
-  if (dir00 < 0) {
+  if (dir_u[0] < 0) {
     inside = false;  // Target is to the left of the cell
-    if (VEdgeIsClosest(target, 0)) return EdgeDistance(-dir00, uv_[0][0]);
+    if (VEdgeIsClosest(target, v[0], v[1], u[0])) {
+      return EdgeDistance(-dir_u[0], u[0]);
+    }
   }
-  if (dir01 > 0) {
+  if (dir_u[1] > 0) {
     inside = false;  // Target is to the right of the cell
-    if (VEdgeIsClosest(target, 1)) return EdgeDistance(dir01, uv_[0][1]);
+    if (VEdgeIsClosest(target, v[0], v[1], u[1])) {
+      return EdgeDistance(dir_u[1], u[1]);
+    }
   }
-  if (dir10 < 0) {
+  if (dir_v[0] < 0) {
     inside = false;  // Target is below the cell
-    if (UEdgeIsClosest(target, 0)) return EdgeDistance(-dir10, uv_[1][0]);
+    if (UEdgeIsClosest(target, u[0], u[1], v[0])) {
+      return EdgeDistance(-dir_v[0], v[0]);
+    }
   }
-  if (dir11 > 0) {
+  if (dir_v[1] > 0) {
     inside = false;  // Target is above the cell
-    if (UEdgeIsClosest(target, 1)) return EdgeDistance(dir11, uv_[1][1]);
+    if (UEdgeIsClosest(target, u[0], u[1], v[1])) {
+      return EdgeDistance(dir_v[1], v[1]);
+    }
   }
   if (inside) {
     if (to_interior) return S1ChordAngle::Zero();
@@ -402,20 +418,109 @@ S1ChordAngle S2Cell::GetDistanceInternal(const S2Point& target_xyz,
     // arbitrary quadrilaterals after they are projected onto the sphere.
     // Therefore the simplest approach is just to find the minimum distance to
     // any of the four edges.
-    return min(min(EdgeDistance(-dir00, uv_[0][0]),
-                   EdgeDistance(dir01, uv_[0][1])),
-               min(EdgeDistance(-dir10, uv_[1][0]),
-                   EdgeDistance(dir11, uv_[1][1])));
+    return min(min(EdgeDistance(-dir_u[0], u[0]), EdgeDistance(dir_u[1], u[1])),
+               min(EdgeDistance(-dir_v[0], v[0]),
+                   EdgeDistance(dir_v[1], v[1])));
   }
   // Otherwise, the closest point is one of the four cell vertices.  Note that
   // it is *not* trivial to narrow down the candidates based on the edge sign
   // tests above, because (1) the edges don't meet at right angles and (2)
   // there are points on the far side of the sphere that are both above *and*
   // below the cell, etc.
-  return min(min(VertexChordDist(target, 0, 0),
-                 VertexChordDist(target, 1, 0)),
-             min(VertexChordDist(target, 0, 1),
-                 VertexChordDist(target, 1, 1)));
+  return min(min(vertex_dist(0, 0), vertex_dist(1, 0)),
+             min(vertex_dist(0, 1), vertex_dist(1, 1)));
+}
+
+S1ChordAngle S2Cell::GetDistanceInternal(const S2Point& target_xyz,
+                                         bool to_interior) const {
+  // All calculations are done in the (u,v,w) coordinates of this cell's face.
+  S2Point target = S2::FaceXYZtoUVW(face_, target_xyz);
+
+  // Compute dot products with all four upward or rightward-facing edge
+  // normals.
+  const double u[2] = {uv_[0][0], uv_[0][1]};
+  const double v[2] = {uv_[1][0], uv_[1][1]};
+  const double dir_u[2] = {target[0] - target[2] * u[0],
+                           target[0] - target[2] * u[1]};
+  const double dir_v[2] = {target[1] - target[2] * v[0],
+                           target[1] - target[2] * v[1]};
+  return GetUVRectDistance(
+      target, u, v, dir_u, dir_v, to_interior,
+      [&](int i, int j) { return VertexChordDist(target, i, j); });
+}
+
+void S2Cell::GetChildDistances(const S2Point& target_xyz,
+                               S1ChordAngle distances[4]) const {
+  ABSL_DCHECK(!is_leaf());
+  // The edges of the four children lie on three lines of constant "u" and
+  // three lines of constant "v", and their vertices form a 3x3 grid.  We
+  // compute the edge dot products once for all children, and the vertex
+  // distances only when they are needed (and then only once each).  The
+  // arithmetic is otherwise identical to GetDistance(), so the results are
+  // exactly the same as calling GetDistance() on each child.
+  const S2Point target = S2::FaceXYZtoUVW(face_, target_xyz);
+  const R2Point uv_mid = id_.GetCenterUV();
+  const double u[3] = {uv_[0][0], uv_mid[0], uv_[0][1]};
+  const double v[3] = {uv_[1][0], uv_mid[1], uv_[1][1]};
+  double dir_u[3], dir_v[3];
+  for (int k = 0; k < 3; ++k) {
+    dir_u[k] = target[0] - target[2] * u[k];
+    dir_v[k] = target[1] - target[2] * v[k];
+  }
+  S1ChordAngle vertex_dist[3][3];
+  bool have_vertex_dist[3][3] = {};
+  for (int pos = 0; pos < 4; ++pos) {
+    // As in Subdivide(), bit 1 of "ij" is the child's position along the
+    // u-axis and bit 0 is its position along the v-axis.
+    const int ij = kPosToIJ[orientation_][pos];
+    const int i = ij >> 1, j = ij & 1;
+    distances[pos] = GetUVRectDistance(
+        target, u + i, v + j, dir_u + i, dir_v + j, true /*to_interior*/,
+        [&](int di, int dj) {
+          if (!have_vertex_dist[i + di][j + dj]) {
+            have_vertex_dist[i + di][j + dj] = true;
+            vertex_dist[i + di][j + dj] =
+                UVVertexChordDist(target, u[i + di], v[j + dj]);
+          }
+          return vertex_dist[i + di][j + dj];
+        });
+  }
+}
+
+void S2Cell::GetChildMaxDistances(const S2Point& target,
+                                  S1ChordAngle distances[4]) const {
+  ABSL_DCHECK(!is_leaf());
+  // This follows GetMaxDistance(), except that the vertex distances are
+  // shared between children.
+  const S2Point target_uvw = S2::FaceXYZtoUVW(face_, target);
+  const R2Point uv_mid = id_.GetCenterUV();
+  const double u[3] = {uv_[0][0], uv_mid[0], uv_[0][1]};
+  const double v[3] = {uv_[1][0], uv_mid[1], uv_[1][1]};
+  S1ChordAngle vertex_dist[3][3];
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      vertex_dist[i][j] = UVVertexChordDist(target_uvw, u[i], v[j]);
+    }
+  }
+  bool need_antipodal = false;
+  for (int pos = 0; pos < 4; ++pos) {
+    const int ij = kPosToIJ[orientation_][pos];
+    const int i = ij >> 1, j = ij & 1;
+    distances[pos] = max(max(vertex_dist[i][j], vertex_dist[i + 1][j]),
+                         max(vertex_dist[i][j + 1], vertex_dist[i + 1][j + 1]));
+    need_antipodal |= distances[pos] > S1ChordAngle::Right();
+  }
+  if (!need_antipodal) return;
+
+  // Otherwise, for children where the maximum distance is not attained at a
+  // vertex, it is Pi minus the minimum distance to the antipodal point.
+  S1ChordAngle antipodal_distances[4];
+  GetChildDistances(-target, antipodal_distances);
+  for (int pos = 0; pos < 4; ++pos) {
+    if (distances[pos] > S1ChordAngle::Right()) {
+      distances[pos] = S1ChordAngle::Straight() - antipodal_distances[pos];
+    }
+  }
 }
 
 S1ChordAngle S2Cell::GetDistance(const S2Point& target) const {
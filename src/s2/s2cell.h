@@ -225,6 +225,19 @@ class S2Cell final : public S2Region {
   // given point.
   S1ChordAngle GetMaxDistance(const S2Point& target) const;
 
+  // Sets "distances[k]" to the distance from the given point to child "k" of
+  // this cell (in the order returned by Subdivide), and
+  // GetChildMaxDistances() does the same for the maximum distance.  The
+  // results are exactly the same as calling GetDistance() or
+  // GetMaxDistance() on each child, but several times faster because the
+  // children share their edges and vertices and are never constructed.
+  //
+  // REQUIRES: !is_leaf()
+  void GetChildDistances(const S2Point& target,
+                         S1ChordAngle distances[4]) const;
+  void GetChildMaxDistances(const S2Point& target,
+                            S1ChordAngle distances[4]) const;
+
   // Returns the minimum distance from the cell to the given edge AB.  Returns
   // zero if the edge intersects the cell interior.
   S1ChordAngle GetDistance(const S2Point& a, const S2Point& b) const;
@@ -279,8 +292,6 @@ class S2Cell final : public S2Region {
   double GetLongitude(int i, int j) const;
 
   S1ChordAngle VertexChordDist(const S2Point& p, int i, int j) const;
-  bool UEdgeIsClosest(const S2Point& target, int v_end) const;
-  bool VEdgeIsClosest(const S2Point& target, int u_end) const;
 
   // Returns the distance from the given point to the interior of the cell if
   // "to_interior" is true, and to the boundary of the cell otherwise.
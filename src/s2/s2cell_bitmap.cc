@@ -0,0 +1,577 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2cell_bitmap.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "absl/log/absl_check.h"
+#include "absl/numeric/bits.h"
+#include "absl/types/span.h"
+#include "s2/base/types.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2latlng_rect.h"
+#include "s2/s2point.h"
+
+using absl::Span;
+using std::max;
+using std::min;
+using std::vector;
+
+namespace {
+
+// Each block covers 2**16 consecutive cell positions.
+constexpr int kBlockBits = 16;
+constexpr uint32 kBlockSize = 1 << kBlockBits;
+constexpr uint64 kBlockMask = kBlockSize - 1;
+
+// The number of 64-bit words in a BITMAP block.
+constexpr int kBitmapWords = kBlockSize / 64;
+
+// The size of a BITMAP block, in bytes.
+constexpr size_t kBitmapBytes = kBlockSize / 8;
+
+// Returns the mask of bits in word "w" that represent positions [lo, hi).
+inline uint64 RangeMask(int w, uint32 lo, uint32 hi) {
+  uint64 mask = ~uint64{0};
+  if (w == static_cast<int>(lo >> 6)) mask &= ~uint64{0} << (lo & 63);
+  if (w == static_cast<int>((hi - 1) >> 6)) {
+    mask &= ~uint64{0} >> (63 - ((hi - 1) & 63));
+  }
+  return mask;
+}
+
+}  // namespace
+
+S2CellBitmap::S2CellBitmap(int level)
+    : level_(level), shift_(2 * (S2CellId::kMaxLevel - level) + 1) {
+  ABSL_DCHECK_GE(level, 0);
+  ABSL_DCHECK_LE(level, S2CellId::kMaxLevel);
+}
+
+S2CellBitmap::S2CellBitmap(const S2CellUnion& cell_union, int level)
+    : S2CellBitmap(level) {
+  vector<GlobalRun> runs;
+  runs.reserve(cell_union.num_cells());
+  for (S2CellId id : cell_union) runs.push_back(GetRange(id));
+  InitFromRuns(runs);
+}
+
+S2CellBitmap S2CellBitmap::FromCellIds(Span<const S2CellId> cell_ids,
+                                       int level) {
+  S2CellBitmap result(level);
+  vector<GlobalRun> runs;
+  runs.reserve(cell_ids.size());
+  for (S2CellId id : cell_ids) runs.push_back(result.GetRange(id));
+  std::sort(runs.begin(), runs.end(),
+            [](const GlobalRun& x, const GlobalRun& y) {
+              return x.start < y.start;
+            });
+  result.InitFromRuns(runs);
+  return result;
+}
+
+S2CellBitmap::GlobalRun S2CellBitmap::GetRange(S2CellId id) const {
+  ABSL_DCHECK(id.is_valid());
+  if (id.level() >= level_) {
+    uint64 pos = PositionOf(id);
+    return {pos, pos + 1};
+  }
+  return {PositionOf(id.range_min()), PositionOf(id.range_max()) + 1};
+}
+
+void S2CellBitmap::InitFromRuns(Span<const GlobalRun> runs) {
+  blocks_.clear();
+  cardinality_ = 0;
+  vector<Run> block_runs;
+  uint64 key = 0;
+  uint64 limit = 0;  // The end of the positions added so far.
+  for (GlobalRun run : runs) {
+    ABSL_DCHECK_LT(run.start, run.limit);
+    uint64 start = max(run.start, limit);
+    // Split the run at block boundaries.
+    for (; start < run.limit; start = limit) {
+      uint64 start_key = start >> kBlockBits;
+      limit = min(run.limit, (start_key + 1) << kBlockBits);
+      if (start_key != key && !block_runs.empty()) {
+        AddBlock(MakeBlock(key, block_runs));
+        block_runs.clear();
+      }
+      key = start_key;
+      uint32 offset = start & kBlockMask;
+      uint32 end = offset + (limit - start);
+      if (!block_runs.empty() && block_runs.back().limit == offset) {
+        block_runs.back().limit = end;
+      } else {
+        block_runs.push_back({offset, end});
+      }
+    }
+    limit = max(limit, run.limit);
+  }
+  if (!block_runs.empty()) AddBlock(MakeBlock(key, block_runs));
+}
+
+void S2CellBitmap::AddBlock(Block block) {
+  ABSL_DCHECK(blocks_.empty() || blocks_.back().key < block.key);
+  cardinality_ += block.cardinality;
+  blocks_.push_back(std::move(block));
+}
+
+void S2CellBitmap::GetRuns(const Block& block, vector<Run>* runs) {
+  runs->clear();
+  switch (block.type) {
+    case BlockType::ARRAY:
+      for (uint16 value : block.values) {
+        if (!runs->empty() && runs->back().limit == value) {
+          ++runs->back().limit;
+        } else {
+          runs->push_back({value, value + 1u});
+        }
+      }
+      break;
+
+    case BlockType::RUNS:
+      for (size_t i = 0; i < block.values.size(); i += 2) {
+        runs->push_back({block.values[i], block.values[i + 1] + 1u});
+      }
+      break;
+
+    case BlockType::BITMAP:
+      for (int w = 0; w < kBitmapWords; ++w) {
+        uint64 word = block.words[w];
+        while (word != 0) {
+          int s = absl::countr_zero(word);
+          int len = absl::countr_one(word >> s);
+          uint32 start = w * 64 + s;
+          if (!runs->empty() && runs->back().limit == start) {
+            runs->back().limit += len;
+          } else {
+            runs->push_back({start, start + len});
+          }
+          word = (s + len >= 64) ? 0 : word & (~uint64{0} << (s + len));
+        }
+      }
+      break;
+  }
+}
+
+// Chooses the smallest representation for the given runs, which must be
+// sorted, non-empty, and non-adjacent.
+S2CellBitmap::Block S2CellBitmap::MakeBlock(uint64 key, Span<const Run> runs) {
+  ABSL_DCHECK(!runs.empty());
+  Block block;
+  block.key = key;
+  block.cardinality = 0;
+  for (Run run : runs) block.cardinality += run.limit - run.start;
+  const size_t array_bytes = 2 * size_t{block.cardinality};
+  const size_t run_bytes = 4 * runs.size();
+  if (run_bytes <= min(array_bytes, kBitmapBytes)) {
+    block.type = BlockType::RUNS;
+    block.values.reserve(2 * runs.size());
+    for (Run run : runs) {
+      block.values.push_back(run.start);
+      block.values.push_back(run.limit - 1);
+    }
+  } else if (array_bytes <= kBitmapBytes) {
+    block.type = BlockType::ARRAY;
+    block.values.reserve(block.cardinality);
+    for (Run run : runs) {
+      for (uint32 i = run.start; i < run.limit; ++i) block.values.push_back(i);
+    }
+  } else {
+    block.type = BlockType::BITMAP;
+    block.words.assign(kBitmapWords, 0);
+    for (Run run : runs) {
+      for (int w = run.start >> 6; w <= static_cast<int>((run.limit - 1) >> 6);
+           ++w) {
+        block.words[w] |= RangeMask(w, run.start, run.limit);
+      }
+    }
+  }
+  return block;
+}
+
+bool S2CellBitmap::BlockContains(const Block& block, uint32 lo, uint32 hi) {
+  ABSL_DCHECK_LT(lo, hi);
+  if (hi - lo > block.cardinality) return false;
+  if (hi - lo == kBlockSize) return true;  // The block is full.
+  switch (block.type) {
+    case BlockType::ARRAY: {
+      auto begin = block.values.begin(), end = block.values.end();
+      auto first = std::lower_bound(begin, end, lo);
+      return static_cast<uint32>(end - first) >= hi - lo &&
+             first[hi - lo - 1] == hi - 1;
+    }
+    case BlockType::RUNS: {
+      // Find the first run whose last element is >= lo.
+      size_t i = 0, n = block.values.size() / 2;
+      while (i < n) {
+        size_t mid = (i + n) / 2;
+        if (block.values[2 * mid + 1] < lo) {
+          i = mid + 1;
+        } else {
+          n = mid;
+        }
+      }
+      return 2 * i < block.values.size() && block.values[2 * i] <= lo &&
+             block.values[2 * i + 1] >= hi - 1;
+    }
+    case BlockType::BITMAP:
+      for (int w = lo >> 6; w <= static_cast<int>((hi - 1) >> 6); ++w) {
+        uint64 mask = RangeMask(w, lo, hi);
+        if ((block.words[w] & mask) != mask) return false;
+      }
+      return true;
+  }
+  return false;
+}
+
+bool S2CellBitmap::BlockIntersects(const Block& block, uint32 lo, uint32 hi) {
+  ABSL_DCHECK_LT(lo, hi);
+  switch (block.type) {
+    case BlockType::ARRAY: {
+      auto it = std::lower_bound(block.values.begin(), block.values.end(), lo);
+      return it != block.values.end() && *it < hi;
+    }
+    case BlockType::RUNS: {
+      size_t i = 0, n = block.values.size() / 2;
+      while (i < n) {
+        size_t mid = (i + n) / 2;
+        if (block.values[2 * mid + 1] < lo) {
+          i = mid + 1;
+        } else {
+          n = mid;
+        }
+      }
+      return 2 * i < block.values.size() && block.values[2 * i] < hi;
+    }
+    case BlockType::BITMAP:
+      for (int w = lo >> 6; w <= static_cast<int>((hi - 1) >> 6); ++w) {
+        if (block.words[w] & RangeMask(w, lo, hi)) return true;
+      }
+      return false;
+  }
+  return false;
+}
+
+bool S2CellBitmap::ContainsRange(GlobalRun range) const {
+  const uint64 first_key = range.start >> kBlockBits;
+  const uint64 last_key = (range.limit - 1) >> kBlockBits;
+  auto it = std::lower_bound(
+      blocks_.begin(), blocks_.end(), first_key,
+      [](const Block& block, uint64 key) { return block.key < key; });
+  // Every block in the range must be present.
+  if (static_cast<uint64>(blocks_.end() - it) < last_key - first_key + 1) {
+    return false;
+  }
+  for (uint64 key = first_key; key <= last_key; ++key, ++it) {
+    if (it->key != key) return false;
+    uint32 lo = (key == first_key) ? range.start & kBlockMask : 0;
+    uint32 hi = (key == last_key) ? ((range.limit - 1) & kBlockMask) + 1
+                                  : kBlockSize;
+    if (!BlockContains(*it, lo, hi)) return false;
+  }
+  return true;
+}
+
+bool S2CellBitmap::IntersectsRange(GlobalRun range) const {
+  const uint64 first_key = range.start >> kBlockBits;
+  const uint64 last_key = (range.limit - 1) >> kBlockBits;
+  auto it = std::lower_bound(
+      blocks_.begin(), blocks_.end(), first_key,
+      [](const Block& block, uint64 key) { return block.key < key; });
+  // Blocks are never empty, so at most the first and last blocks in the
+  // range need to be examined.
+  for (; it != blocks_.end() && it->key <= last_key; ++it) {
+    if (it->key != first_key && it->key != last_key) return true;
+    uint32 lo = (it->key == first_key) ? range.start & kBlockMask : 0;
+    uint32 hi = (it->key == last_key) ? ((range.limit - 1) & kBlockMask) + 1
+                                      : kBlockSize;
+    if (BlockIntersects(*it, lo, hi)) return true;
+  }
+  return false;
+}
+
+bool S2CellBitmap::NextPosition(uint64 pos, uint64* next) const {
+  auto it = std::lower_bound(
+      blocks_.begin(), blocks_.end(), pos >> kBlockBits,
+      [](const Block& block, uint64 key) { return block.key < key; });
+  vector<Run> runs;
+  for (; it != blocks_.end(); ++it) {
+    uint64 base = it->key << kBlockBits;
+    GetRuns(*it, &runs);
+    for (Run run : runs) {
+      if (base + run.limit > pos) {
+        *next = max(pos, base + run.start);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool S2CellBitmap::PrevPosition(uint64 pos, uint64* prev) const {
+  if (pos == 0) return false;
+  auto it = std::upper_bound(
+      blocks_.begin(), blocks_.end(), (pos - 1) >> kBlockBits,
+      [](uint64 key, const Block& block) { return key < block.key; });
+  vector<Run> runs;
+  while (it != blocks_.begin()) {
+    --it;
+    uint64 base = it->key << kBlockBits;
+    GetRuns(*it, &runs);
+    for (auto run = runs.rbegin(); run != runs.rend(); ++run) {
+      if (base + run->start < pos) {
+        *prev = min(pos - 1, base + run->limit - 1);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+S2CellUnion S2CellBitmap::ToCellUnion() const {
+  // Gather the maximal runs of positions, joining runs that cross block
+  // boundaries, and then cover each run with the largest possible cells.
+  vector<GlobalRun> global_runs;
+  vector<Run> runs;
+  for (const Block& block : blocks_) {
+    uint64 base = block.key << kBlockBits;
+    GetRuns(block, &runs);
+    for (Run run : runs) {
+      GlobalRun global = {base + run.start, base + run.limit};
+      if (!global_runs.empty() && global_runs.back().limit == global.start) {
+        global_runs.back().limit = global.limit;
+      } else {
+        global_runs.push_back(global);
+      }
+    }
+  }
+  vector<S2CellId> ids;
+  for (GlobalRun run : global_runs) {
+    S2CellId begin = CellAt(run.start).range_min();
+    S2CellId end = CellAt(run.limit - 1).range_max().next();
+    for (S2CellId id = begin.maximum_tile(end);
+         id != end; id = id.next().maximum_tile(end)) {
+      ids.push_back(id);
+    }
+  }
+  // The runs are disjoint and non-adjacent, so the result is normalized.
+  return S2CellUnion::FromVerbatim(std::move(ids));
+}
+
+bool S2CellBitmap::Contains(S2CellId id) const {
+  return ContainsRange(GetRange(id));
+}
+
+bool S2CellBitmap::Intersects(S2CellId id) const {
+  return IntersectsRange(GetRange(id));
+}
+
+void S2CellBitmap::CombineBlocks(const Block& x, const Block& y, Op op,
+                                 S2CellBitmap* result) {
+  if (x.type == BlockType::BITMAP && y.type == BlockType::BITMAP) {
+    Block block;
+    block.key = x.key;
+    block.type = BlockType::BITMAP;
+    block.words.resize(kBitmapWords);
+    uint64 cardinality = 0, num_runs = 0, carry = 0;
+    for (int w = 0; w < kBitmapWords; ++w) {
+      uint64 word;
+      switch (op) {
+        case Op::UNION:
+          word = x.words[w] | y.words[w];
+          break;
+        case Op::INTERSECTION:
+          word = x.words[w] & y.words[w];
+          break;
+        case Op::DIFFERENCE:
+        default:
+          word = x.words[w] & ~y.words[w];
+          break;
+      }
+      block.words[w] = word;
+      cardinality += absl::popcount(word);
+      // Count the bits that start a run of consecutive positions.
+      num_runs += absl::popcount(word & ~((word << 1) | carry));
+      carry = word >> 63;
+    }
+    if (cardinality == 0) return;
+    block.cardinality = cardinality;
+    // Convert to a smaller representation if possible (as in MakeBlock).
+    if (4 * num_runs <= kBitmapBytes || 2 * cardinality <= kBitmapBytes) {
+      vector<Run> runs;
+      GetRuns(block, &runs);
+      result->AddBlock(MakeBlock(block.key, runs));
+    } else {
+      result->AddBlock(std::move(block));
+    }
+    return;
+  }
+  vector<Run> x_runs, y_runs, runs;
+  GetRuns(x, &x_runs);
+  GetRuns(y, &y_runs);
+  auto add = [&runs](uint32 start, uint32 limit) {
+    if (start >= limit) return;
+    if (!runs.empty() && runs.back().limit >= start) {
+      runs.back().limit = max(runs.back().limit, limit);
+    } else {
+      runs.push_back({start, limit});
+    }
+  };
+  size_t i = 0, j = 0;
+  switch (op) {
+    case Op::UNION:
+      while (i < x_runs.size() || j < y_runs.size()) {
+        if (j == y_runs.size() ||
+            (i < x_runs.size() && x_runs[i].start < y_runs[j].start)) {
+          add(x_runs[i].start, x_runs[i].limit);
+          ++i;
+        } else {
+          add(y_runs[j].start, y_runs[j].limit);
+          ++j;
+        }
+      }
+      break;
+
+    case Op::INTERSECTION:
+      while (i < x_runs.size() && j < y_runs.size()) {
+        add(max(x_runs[i].start, y_runs[j].start),
+            min(x_runs[i].limit, y_runs[j].limit));
+        if (x_runs[i].limit < y_runs[j].limit) {
+          ++i;
+        } else {
+          ++j;
+        }
+      }
+      break;
+
+    case Op::DIFFERENCE:
+      for (Run run : x_runs) {
+        uint32 start = run.start;
+        // Skip the runs of "y" that end before this run.
+        while (j < y_runs.size() && y_runs[j].limit <= start) ++j;
+        for (size_t k = j; k < y_runs.size() && y_runs[k].start < run.limit;
+             ++k) {
+          add(start, y_runs[k].start);
+          start = max(start, y_runs[k].limit);
+        }
+        add(start, run.limit);
+      }
+      break;
+  }
+  if (!runs.empty()) result->AddBlock(MakeBlock(x.key, runs));
+}
+
+S2CellBitmap S2CellBitmap::Combine(const S2CellBitmap& y, Op op) const {
+  ABSL_DCHECK_EQ(level_, y.level_);
+  S2CellBitmap result(level_);
+  size_t i = 0, j = 0;
+  while (i < blocks_.size() || j < y.blocks_.size()) {
+    if (j == y.blocks_.size() ||
+        (i < blocks_.size() && blocks_[i].key < y.blocks_[j].key)) {
+      if (op != Op::INTERSECTION) result.AddBlock(blocks_[i]);
+      ++i;
+    } else if (i == blocks_.size() || y.blocks_[j].key < blocks_[i].key) {
+      if (op == Op::UNION) result.AddBlock(y.blocks_[j]);
+      ++j;
+    } else {
+      CombineBlocks(blocks_[i], y.blocks_[j], op, &result);
+      ++i;
+      ++j;
+    }
+  }
+  return result;
+}
+
+S2CellBitmap S2CellBitmap::Union(const S2CellBitmap& y) const {
+  return Combine(y, Op::UNION);
+}
+
+S2CellBitmap S2CellBitmap::Intersection(const S2CellBitmap& y) const {
+  return Combine(y, Op::INTERSECTION);
+}
+
+S2CellBitmap S2CellBitmap::Difference(const S2CellBitmap& y) const {
+  return Combine(y, Op::DIFFERENCE);
+}
+
+size_t S2CellBitmap::SpaceUsed() const {
+  size_t size = sizeof(*this) + blocks_.capacity() * sizeof(Block);
+  for (const Block& block : blocks_) {
+    size += block.values.capacity() * sizeof(uint16) +
+            block.words.capacity() * sizeof(uint64);
+  }
+  return size;
+}
+
+bool S2CellBitmap::BlocksEqual(const Block& x, const Block& y) {
+  // Blocks with the same contents always use the same representation.
+  return x.key == y.key && x.cardinality == y.cardinality &&
+         x.type == y.type && x.values == y.values && x.words == y.words;
+}
+
+bool operator==(const S2CellBitmap& x, const S2CellBitmap& y) {
+  return x.level_ == y.level_ && x.cardinality_ == y.cardinality_ &&
+         std::equal(x.blocks_.begin(), x.blocks_.end(), y.blocks_.begin(),
+                    y.blocks_.end(), S2CellBitmap::BlocksEqual);
+}
+
+S2CellBitmap* S2CellBitmap::Clone() const {
+  return new S2CellBitmap(*this);
+}
+
+S2Cap S2CellBitmap::GetCapBound() const {
+  vector<S2CellId> cell_ids;
+  GetCellUnionBound(&cell_ids);
+  return S2CellUnion(std::move(cell_ids)).GetCapBound();
+}
+
+S2LatLngRect S2CellBitmap::GetRectBound() const {
+  vector<S2CellId> cell_ids;
+  GetCellUnionBound(&cell_ids);
+  return S2CellUnion(std::move(cell_ids)).GetRectBound();
+}
+
+void S2CellBitmap::GetCellUnionBound(vector<S2CellId>* cell_ids) const {
+  cell_ids->clear();
+  for (int face = 0; face < 6; ++face) {
+    S2CellId face_id = S2CellId::FromFace(face);
+    GlobalRun range = GetRange(face_id);
+    uint64 first, last;
+    if (!NextPosition(range.start, &first) || first >= range.limit) continue;
+    PrevPosition(range.limit, &last);
+    S2CellId a = CellAt(first), b = CellAt(last);
+    cell_ids->push_back(a.parent(a.GetCommonAncestorLevel(b)));
+  }
+}
+
+bool S2CellBitmap::Contains(const S2Cell& cell) const {
+  return Contains(cell.id());
+}
+
+bool S2CellBitmap::MayIntersect(const S2Cell& cell) const {
+  return Intersects(cell.id());
+}
+
+bool S2CellBitmap::Contains(const S2Point& p) const {
+  return Contains(S2CellId(p));
+}
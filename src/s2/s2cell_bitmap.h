@@ -0,0 +1,191 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2CELL_BITMAP_H_
+#define S2_S2CELL_BITMAP_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "s2/base/types.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2latlng_rect.h"
+#include "s2/s2point.h"
+#include "s2/s2region.h"
+
+// S2CellBitmap represents a set of S2CellIds that all have the same level,
+// stored as a compressed bitmap indexed by position along the Hilbert curve.
+// It is intended for very large coverings (e.g., hundreds of millions of
+// level-13 cells) where a vector<S2CellId> would use too much memory.
+//
+// The bitmap uses the "Roaring" scheme: the cell positions are divided into
+// blocks of 2**16 consecutive cells, and each non-empty block is stored as
+// either a sorted array of 16-bit offsets, a run-length list, or a plain
+// 8KB bitmap, whichever is smallest.  A block containing a single run of
+// cells uses only 4 bytes, so large contiguous areas are cheap.  Note that
+// memory is proportional to the number of non-empty blocks, so very fine
+// levels (where a single cell union element can span billions of blocks)
+// are not suitable.
+//
+// Set operations (Union, Intersection, Difference) take time proportional
+// to the size of the compressed representation, and cardinality() is
+// constant time.  S2CellBitmap is also an S2Region, so it can be passed
+// directly to S2RegionCoverer, S2RegionSharder, etc.
+//
+// S2CellBitmap is movable and copyable.
+class S2CellBitmap final : public S2Region {
+ public:
+  // Constructs an empty set of cells at the given level.
+  explicit S2CellBitmap(int level = S2CellId::kMaxLevel);
+
+  // Constructs the set of cells at the given level that intersect
+  // "cell_union".  Cells of the union that are smaller than "level" are
+  // replaced by their ancestor at "level".
+  S2CellBitmap(const S2CellUnion& cell_union, int level);
+
+  // Like the constructor above, but the given cells do not need to be
+  // sorted and may overlap.
+  static S2CellBitmap FromCellIds(absl::Span<const S2CellId> cell_ids,
+                                  int level);
+
+  // Returns the level of the cells in this set.
+  int level() const { return level_; }
+
+  // Returns the number of cells in this set.
+  uint64 cardinality() const { return cardinality_; }
+
+  bool empty() const { return cardinality_ == 0; }
+
+  // Returns the set as a normalized S2CellUnion.
+  S2CellUnion ToCellUnion() const;
+
+  // Returns true if every leaf cell of "id" is covered by this set.
+  bool Contains(S2CellId id) const;
+
+  // Returns true if some leaf cell of "id" is covered by this set.
+  bool Intersects(S2CellId id) const;
+
+  // Set operations.
+  //
+  // REQUIRES: y.level() == level()
+  S2CellBitmap Union(const S2CellBitmap& y) const;
+  S2CellBitmap Intersection(const S2CellBitmap& y) const;
+  S2CellBitmap Difference(const S2CellBitmap& y) const;
+
+  // Returns the approximate number of bytes used by this object.
+  size_t SpaceUsed() const;
+
+  friend bool operator==(const S2CellBitmap& x, const S2CellBitmap& y);
+  friend bool operator!=(const S2CellBitmap& x, const S2CellBitmap& y) {
+    return !(x == y);
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // S2Region interface (see s2region.h for details):
+
+  S2CellBitmap* Clone() const override;
+
+  // The bounds are computed from GetCellUnionBound() and are not tight.
+  S2Cap GetCapBound() const override;
+  S2LatLngRect GetRectBound() const override;
+
+  // Returns at most one cell per face, namely the smallest cell containing
+  // all the cells of this set on that face.
+  void GetCellUnionBound(std::vector<S2CellId>* cell_ids) const override;
+
+  // This is a fast operation (logarithmic in the number of blocks).
+  bool Contains(const S2Cell& cell) const override;
+
+  // This is a fast operation (logarithmic in the number of blocks).
+  bool MayIntersect(const S2Cell& cell) const override;
+
+  // The point 'p' does not need to be normalized.
+  bool Contains(const S2Point& p) const override;
+
+ private:
+  enum class BlockType : uint8 { ARRAY, RUNS, BITMAP };
+
+  // A range [start, limit) of cell positions within a block.
+  struct Run {
+    uint32 start, limit;
+  };
+
+  // A range [start, limit) of cell positions.
+  struct GlobalRun {
+    uint64 start, limit;
+  };
+
+  // The cells whose positions are in [key << 16, (key + 1) << 16).  For
+  // ARRAY blocks "values" holds the sorted offsets of the cells, and for
+  // RUNS blocks it holds (start, last) pairs of inclusive offset ranges.
+  // BITMAP blocks store one bit per cell in "words".
+  struct Block {
+    uint64 key;
+    uint32 cardinality;
+    BlockType type;
+    std::vector<uint16> values;
+    std::vector<uint64> words;
+  };
+
+  enum class Op { UNION, INTERSECTION, DIFFERENCE };
+
+  // Returns the position along the Hilbert curve of the cell at level()
+  // that contains "id".  REQUIRES: id.level() >= level()
+  uint64 PositionOf(S2CellId id) const { return id.id() >> shift_; }
+
+  // Returns the cell at level() with the given position.
+  S2CellId CellAt(uint64 pos) const {
+    return S2CellId(((pos << 1) | 1) << (shift_ - 1));
+  }
+
+  // Returns the range of positions covered by "id".
+  GlobalRun GetRange(S2CellId id) const;
+
+  bool ContainsRange(GlobalRun range) const;
+  bool IntersectsRange(GlobalRun range) const;
+
+  // Returns the smallest position >= "pos" that is in the set, or
+  // false if there is no such position.
+  bool NextPosition(uint64 pos, uint64* next) const;
+
+  // Returns the largest position < "pos" that is in the set, or false if
+  // there is no such position.
+  bool PrevPosition(uint64 pos, uint64* prev) const;
+
+  // Initializes the set from sorted runs that may overlap.
+  void InitFromRuns(absl::Span<const GlobalRun> runs);
+
+  S2CellBitmap Combine(const S2CellBitmap& y, Op op) const;
+  void AddBlock(Block block);
+
+  static void GetRuns(const Block& block, std::vector<Run>* runs);
+  static Block MakeBlock(uint64 key, absl::Span<const Run> runs);
+  static void CombineBlocks(const Block& x, const Block& y, Op op,
+                            S2CellBitmap* result);
+  static bool BlockContains(const Block& block, uint32 lo, uint32 hi);
+  static bool BlockIntersects(const Block& block, uint32 lo, uint32 hi);
+  static bool BlocksEqual(const Block& x, const Block& y);
+
+  int level_;
+  int shift_;  // The number of low-order bits dropped by PositionOf().
+  uint64 cardinality_ = 0;
+  std::vector<Block> blocks_;  // Sorted by key.
+};
+
+#endif  // S2_S2CELL_BITMAP_H_
@@ -0,0 +1,182 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2cell_bitmap.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/base/types.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2region_coverer.h"
+#include "s2/s2testing.h"
+
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+constexpr int kLevel = 12;
+
+S2CellId GetRandomDescendant(S2CellId parent, int level) {
+  S2CellId id = parent;
+  while (id.level() < level) id = id.child(S2Testing::rnd.Uniform(4));
+  return id;
+}
+
+// Returns a cell union whose cells have levels <= kLevel, containing a mix
+// of large cells, scattered small cells, and a dense random region, so that
+// all of the block representations are used.
+S2CellUnion GetRandomCellUnion(S2CellId root) {
+  vector<S2CellId> ids;
+  for (int i = 0; i < 4; ++i) {
+    ids.push_back(GetRandomDescendant(root, 4 + S2Testing::rnd.Uniform(3)));
+  }
+  for (int i = 0; i < 500; ++i) {
+    ids.push_back(GetRandomDescendant(root, kLevel));
+  }
+  S2CellId dense = GetRandomDescendant(root, 5);
+  for (S2CellId id = dense.child_begin(kLevel); id != dense.child_end(kLevel);
+       id = id.next()) {
+    if (S2Testing::rnd.OneIn(2)) ids.push_back(id);
+  }
+  return S2CellUnion(std::move(ids));
+}
+
+// Returns the number of cells at kLevel covered by "cell_union".
+uint64 CountCells(const S2CellUnion& cell_union) {
+  uint64 count = 0;
+  for (S2CellId id : cell_union) {
+    count += uint64{1} << 2 * (kLevel - id.level());
+  }
+  return count;
+}
+
+TEST(S2CellBitmap, Empty) {
+  S2CellBitmap empty(kLevel);
+  EXPECT_TRUE(empty.empty());
+  EXPECT_EQ(0, empty.cardinality());
+  EXPECT_TRUE(empty.ToCellUnion().empty());
+  EXPECT_FALSE(empty.Intersects(S2CellId::FromFace(0)));
+  EXPECT_TRUE(empty.GetCapBound().is_empty());
+  vector<S2CellId> bound;
+  empty.GetCellUnionBound(&bound);
+  EXPECT_TRUE(bound.empty());
+  EXPECT_EQ(empty, S2CellBitmap(S2CellUnion(), kLevel));
+}
+
+TEST(S2CellBitmap, CellUnionRoundTrip) {
+  S2Testing::rnd.Reset(1);
+  S2CellId root = S2Testing::GetRandomCellId(3);
+  S2CellUnion cell_union = GetRandomCellUnion(root);
+  S2CellBitmap bitmap(cell_union, kLevel);
+  EXPECT_EQ(CountCells(cell_union), bitmap.cardinality());
+  EXPECT_EQ(cell_union, bitmap.ToCellUnion());
+  vector<S2CellId> cells;
+  cell_union.Denormalize(kLevel, 1, &cells);
+  std::reverse(cells.begin(), cells.end());
+  EXPECT_EQ(bitmap, S2CellBitmap::FromCellIds(cells, kLevel));
+
+  // The covering uses much less space than the equivalent vector of cells.
+  EXPECT_LT(bitmap.SpaceUsed(), 2 * bitmap.cardinality());
+}
+
+TEST(S2CellBitmap, SmallCellsAreReplacedByAncestors) {
+  S2CellId id = S2CellId::FromFace(4).child_begin(kLevel + 5);
+  S2CellBitmap bitmap = S2CellBitmap::FromCellIds({id, id.next()}, kLevel);
+  EXPECT_EQ(1, bitmap.cardinality());
+  EXPECT_EQ(S2CellUnion({id.parent(kLevel)}), bitmap.ToCellUnion());
+  EXPECT_TRUE(bitmap.Contains(id));
+  EXPECT_TRUE(bitmap.Contains(id.parent(kLevel)));
+  EXPECT_FALSE(bitmap.Contains(id.parent(kLevel - 1)));
+  EXPECT_TRUE(bitmap.Intersects(id.parent(kLevel - 1)));
+}
+
+TEST(S2CellBitmap, SetOperationsMatchS2CellUnion) {
+  for (int iter = 0; iter < 10; ++iter) {
+    S2Testing::rnd.Reset(iter);
+    S2CellId root = S2Testing::GetRandomCellId(3);
+    S2CellUnion x = GetRandomCellUnion(root);
+    S2CellUnion y = GetRandomCellUnion(root);
+    S2CellBitmap bx(x, kLevel), by(y, kLevel);
+    S2CellBitmap bunion = bx.Union(by);
+    S2CellBitmap bintersection = bx.Intersection(by);
+    S2CellBitmap bdifference = bx.Difference(by);
+    EXPECT_EQ(x.Union(y), bunion.ToCellUnion());
+    EXPECT_EQ(x.Intersection(y), bintersection.ToCellUnion());
+    EXPECT_EQ(x.Difference(y), bdifference.ToCellUnion());
+    EXPECT_EQ(CountCells(x.Union(y)), bunion.cardinality());
+    EXPECT_EQ(CountCells(x.Intersection(y)), bintersection.cardinality());
+    EXPECT_EQ(CountCells(x.Difference(y)), bdifference.cardinality());
+
+    // The results must be canonical so that they compare equal to bitmaps
+    // constructed directly.
+    EXPECT_EQ(S2CellBitmap(x.Union(y), kLevel), bunion);
+    EXPECT_EQ(S2CellBitmap(x.Intersection(y), kLevel), bintersection);
+    EXPECT_EQ(S2CellBitmap(x.Difference(y), kLevel), bdifference);
+    EXPECT_TRUE(bx.Difference(bx).empty());
+  }
+}
+
+TEST(S2CellBitmap, ContainsAndIntersectsMatchS2CellUnion) {
+  S2Testing::rnd.Reset(2);
+  S2CellId root = S2Testing::GetRandomCellId(3);
+  S2CellUnion cell_union = GetRandomCellUnion(root);
+  S2CellBitmap bitmap(cell_union, kLevel);
+  for (int i = 0; i < 2000; ++i) {
+    S2CellId id = GetRandomDescendant(root.parent(S2Testing::rnd.Uniform(4)),
+                                      S2Testing::rnd.Uniform(kLevel + 1));
+    EXPECT_EQ(cell_union.Contains(id), bitmap.Contains(id)) << id;
+    EXPECT_EQ(cell_union.Intersects(id), bitmap.Intersects(id)) << id;
+    EXPECT_EQ(cell_union.Contains(S2Cell(id)), bitmap.Contains(S2Cell(id)));
+    EXPECT_EQ(cell_union.MayIntersect(S2Cell(id)),
+              bitmap.MayIntersect(S2Cell(id)));
+    S2Point p = GetRandomDescendant(id, S2CellId::kMaxLevel).ToPoint();
+    EXPECT_EQ(cell_union.Contains(p), bitmap.Contains(p));
+  }
+}
+
+TEST(S2CellBitmap, RegionInterface) {
+  S2Testing::rnd.Reset(3);
+  S2CellUnion cell_union = GetRandomCellUnion(S2Testing::GetRandomCellId(3));
+  // Add a cell on another face so that the bound has more than one cell.
+  cell_union = cell_union.Union(S2CellUnion({S2CellId::FromFace(5).child(2)}));
+  S2CellBitmap bitmap(cell_union, kLevel);
+
+  vector<S2CellId> bound;
+  bitmap.GetCellUnionBound(&bound);
+  EXPECT_EQ(2, bound.size());
+  EXPECT_TRUE(S2CellUnion(bound).Contains(cell_union));
+  for (S2CellId id : cell_union) {
+    EXPECT_TRUE(bitmap.GetCapBound().Contains(S2Cell(id)));
+    EXPECT_TRUE(bitmap.GetRectBound().Contains(S2Cell(id).GetRectBound()));
+  }
+  unique_ptr<S2CellBitmap> clone(bitmap.Clone());
+  EXPECT_EQ(bitmap, *clone);
+
+  S2RegionCoverer coverer;
+  coverer.mutable_options()->set_max_cells(20);
+  S2CellUnion covering = coverer.GetCovering(bitmap);
+  EXPECT_TRUE(covering.Contains(cell_union));
+  S2CellUnion interior = coverer.GetInteriorCovering(bitmap);
+  EXPECT_TRUE(cell_union.Contains(interior));
+}
+
+}  // namespace
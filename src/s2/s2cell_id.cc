@@ -21,19 +21,27 @@
 #include <cfloat>
 #include <cmath>
 #include <cstddef>
+#include <cstring>
 #include <ostream>
 #include <string>
 #include <vector>
 
-#include "absl/base/call_once.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include "absl/base/casts.h"
 #include "absl/log/absl_check.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 
 #include "s2/base/types.h"
 #include "s2/util/bits/bits.h"
 #include "s2/util/coding/coder.h"
+#include "s2/util/endian/endian.h"
 #include "s2/r1interval.h"
 #include "s2/r2.h"
 #include "s2/r2rect.h"
@@ -85,41 +93,49 @@ const int S2CellId::kPosBits;
 const int S2CellId::kMaxSize;
 
 static const int kLookupBits = 4;
-static uint16 lookup_pos[1 << (2 * kLookupBits + 2)];
-static uint16 lookup_ij[1 << (2 * kLookupBits + 2)];
-
-static void InitLookupCell(int level, int i, int j, int orig_orientation,
-                           int pos, int orientation) {
-  if (level == kLookupBits) {
-    int ij = (i << kLookupBits) + j;
-    lookup_pos[(ij << 2) + orig_orientation] = (pos << 2) + orientation;
-    lookup_ij[(pos << 2) + orig_orientation] = (ij << 2) + orientation;
-  } else {
-    level++;
-    i <<= 1;
-    j <<= 1;
-    pos <<= 2;
-    const int* r = kPosToIJ[orientation];
-    InitLookupCell(level, i + (r[0] >> 1), j + (r[0] & 1), orig_orientation,
-                   pos, orientation ^ kPosToOrientation[0]);
-    InitLookupCell(level, i + (r[1] >> 1), j + (r[1] & 1), orig_orientation,
-                   pos + 1, orientation ^ kPosToOrientation[1]);
-    InitLookupCell(level, i + (r[2] >> 1), j + (r[2] & 1), orig_orientation,
-                   pos + 2, orientation ^ kPosToOrientation[2]);
-    InitLookupCell(level, i + (r[3] >> 1), j + (r[3] & 1), orig_orientation,
-                   pos + 3, orientation ^ kPosToOrientation[3]);
-  }
-}
-
-static absl::once_flag flag;
-inline static void MaybeInit() {
-  absl::call_once(flag, []{
+
+namespace {
+
+// The lookup tables are computed at compile time so that they do not need to
+// be initialized (and checked for initialization) on first use.
+struct LookupTables {
+  uint16 pos[1 << (2 * kLookupBits + 2)] = {};
+  uint16 ij[1 << (2 * kLookupBits + 2)] = {};
+
+  constexpr LookupTables() {
     InitLookupCell(0, 0, 0, 0, 0, 0);
     InitLookupCell(0, 0, 0, kSwapMask, 0, kSwapMask);
     InitLookupCell(0, 0, 0, kInvertMask, 0, kInvertMask);
     InitLookupCell(0, 0, 0, kSwapMask|kInvertMask, 0, kSwapMask|kInvertMask);
-  });
-}
+  }
+
+  constexpr void InitLookupCell(int level, int i, int j, int orig_orientation,
+                                int pos, int orientation) {
+    if (level == kLookupBits) {
+      int ij_index = (i << kLookupBits) + j;
+      this->pos[(ij_index << 2) + orig_orientation] = (pos << 2) + orientation;
+      this->ij[(pos << 2) + orig_orientation] = (ij_index << 2) + orientation;
+    } else {
+      level++;
+      i <<= 1;
+      j <<= 1;
+      pos <<= 2;
+      const int* r = kPosToIJ[orientation];
+      for (int k = 0; k < 4; ++k) {
+        InitLookupCell(level, i + (r[k] >> 1), j + (r[k] & 1),
+                       orig_orientation, pos + k,
+                       orientation ^ kPosToOrientation[k]);
+      }
+    }
+  }
+};
+
+constexpr LookupTables kLookupTables;
+
+}  // namespace
+
+static constexpr const uint16* lookup_pos = kLookupTables.pos;
+static constexpr const uint16* lookup_ij = kLookupTables.ij;
 
 S2CellId S2CellId::advance(int64 steps) const {
   if (steps == 0) return *this;
@@ -206,12 +222,93 @@ int S2CellId::GetCommonAncestorLevel(S2CellId other) const {
   return max(60 - Bits::FindMSBSetNonZero64(bits), -1) >> 1;
 }
 
-// Print the num_digits low order hex digits.
-static string HexFormatString(uint64 val, size_t num_digits) {
-  string result(num_digits, ' ');
-  for (; num_digits--; val >>= 4)
-    result[num_digits] = "0123456789abcdef"[val & 0xF];
-  return result;
+// Writes the 16 hex digits of "val" to "out", most significant first.
+static void WriteHexDigits(uint64 val, char* out) {
+#if defined(__AVX2__)
+  // Spread the nibbles of each byte into separate bytes (in big-endian
+  // order) and then convert them to digits using a table lookup.
+  const __m128i bytes = _mm_cvtsi64_si128(gbswap_64(val));
+  const __m128i mask = _mm_set1_epi8(0xf);
+  const __m128i nibbles =
+      _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(bytes, 4), mask),
+                        _mm_and_si128(bytes, mask));
+  const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                                       '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                   _mm_shuffle_epi8(digits, nibbles));
+#else
+  for (int i = 15; i >= 0; --i, val >>= 4) {
+    out[i] = "0123456789abcdef"[val & 0xF];
+  }
+#endif
+}
+
+// Writes the token of the given id to "out", which must have room for
+// kMaxTokenLength characters, and returns its length.
+static int WriteToken(uint64 id, char* out) {
+  // "0" with trailing 0s stripped is the empty string, which is not a
+  // reasonable token.  Encode as "X".
+  if (id == 0) {
+    out[0] = 'X';
+    return 1;
+  }
+  WriteHexDigits(id, out);
+  return S2CellId::kMaxTokenLength - Bits::FindLSBSetNonZero64(id) / 4;
+}
+
+// Parses a token of "len" characters starting at "p".  If "can_read_16" is
+// true then 16 characters may be read starting at "p" regardless of "len".
+static S2CellId ParseToken(const char* p, size_t len, bool can_read_16) {
+  if (len > S2CellId::kMaxTokenLength) return S2CellId::None();
+#if defined(__AVX2__)
+  char buf[16];
+  if (!can_read_16) {
+    std::memset(buf, '0', sizeof(buf));
+    std::memcpy(buf, p, len);
+    p = buf;
+  }
+  // Characters after the end of the token are treated as '0'.
+  __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  const __m128i in_token = _mm_cmpgt_epi8(
+      _mm_set1_epi8(len),
+      _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+  x = _mm_blendv_epi8(_mm_set1_epi8('0'), x, in_token);
+
+  // Classify each character as a decimal digit or a (case-insensitive)
+  // letter 'a' to 'f' using unsigned range checks.
+  const __m128i d = _mm_sub_epi8(x, _mm_set1_epi8('0'));
+  const __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+  const __m128i a = _mm_sub_epi8(_mm_or_si128(x, _mm_set1_epi8(0x20)),
+                                 _mm_set1_epi8('a'));
+  const __m128i is_letter =
+      _mm_cmpeq_epi8(_mm_min_epu8(a, _mm_set1_epi8(5)), a);
+  if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_letter)) != 0xffff) {
+    return S2CellId::None();
+  }
+  // Combine pairs of nibbles into bytes (as 16 * hi + lo), pack them, and
+  // convert from big-endian order.
+  const __m128i nibbles =
+      _mm_blendv_epi8(_mm_add_epi8(a, _mm_set1_epi8(10)), d, is_digit);
+  const __m128i pairs = _mm_maddubs_epi16(nibbles, _mm_set1_epi16(0x0110));
+  return S2CellId(
+      gbswap_64(_mm_cvtsi128_si64(_mm_packus_epi16(pairs, pairs))));
+#else
+  uint64 id = 0;
+  for (size_t i = 0, pos = 60; i < len; ++i, pos -= 4) {
+    uint64 d;
+    if ('0' <= p[i] && p[i] <= '9') {
+      d = p[i] - '0';
+    } else if ('a' <= p[i] && p[i] <= 'f') {
+      d = p[i] - 'a' + 10;
+    } else if ('A' <= p[i] && p[i] <= 'F') {
+      d = p[i] - 'A' + 10;
+    } else {
+      return S2CellId::None();
+    }
+    id |= d << pos;
+  }
+  return S2CellId(id);
+#endif
 }
 
 string S2CellId::ToToken() const {
@@ -224,33 +321,51 @@ string S2CellId::ToToken() const {
   // Using base 64 would produce slightly shorter tokens, but for typical cell
   // sizes used during indexing (up to level 15 or so) the average savings
   // would be less than 2 bytes per cell which doesn't seem worth it.
-
-  // "0" with trailing 0s stripped is the empty string, which is not a
-  // reasonable token.  Encode as "X".
-  if (id_ == 0) return "X";
-  const size_t num_zero_digits = Bits::FindLSBSetNonZero64(id_) / 4;
-  return HexFormatString(id_ >> (4 * num_zero_digits), 16 - num_zero_digits);
+  char buf[kMaxTokenLength];
+  return string(buf, WriteToken(id_, buf));
 }
 
 S2CellId S2CellId::FromToken(const string_view token) {
-  if (token.length() > 16) return S2CellId::None();
-  uint64 id = 0;
-  // Use size_t to fix signed/unsigned comparison for client that use `-Wextra`
-  // (e.g. Chrome).
-  for (size_t i = 0, pos = 60; i < token.length(); ++i, pos -= 4) {
-    uint64 d;
-    if ('0' <= token[i] && token[i] <= '9') {
-      d = token[i] - '0';
-    } else if ('a' <= token[i] && token[i] <= 'f') {
-      d = token[i] - 'a' + 10;
-    } else if ('A' <= token[i] && token[i] <= 'F') {
-      d = token[i] - 'A' + 10;
-    } else {
-      return S2CellId::None();
-    }
-    id |= d << pos;
+  return ParseToken(token.data(), token.size(), false /*can_read_16*/);
+}
+
+size_t S2CellId::ToTokens(absl::Span<const S2CellId> ids,
+                          absl::Span<char> chars,
+                          absl::Span<uint32> token_ends) {
+  ABSL_DCHECK_GE(chars.size(), kMaxTokenLength * ids.size());
+  ABSL_DCHECK_EQ(token_ends.size(), ids.size());
+  // Every token is written using a full 16-character store, which fits
+  // because the first k tokens have at most 16 * k characters.
+  size_t pos = 0;
+  for (size_t k = 0; k < ids.size(); ++k) {
+    pos += WriteToken(ids[k].id(), chars.data() + pos);
+    token_ends[k] = pos;
+  }
+  return pos;
+}
+
+void S2CellId::FromTokens(string_view chars,
+                          absl::Span<const uint32> token_ends,
+                          absl::Span<S2CellId> ids) {
+  ABSL_DCHECK_EQ(ids.size(), token_ends.size());
+  size_t begin = 0;
+  for (size_t k = 0; k < ids.size(); ++k) {
+    const size_t end = token_ends[k];
+    ABSL_DCHECK_LE(begin, end);
+    ABSL_DCHECK_LE(end, chars.size());
+    ids[k] = ParseToken(chars.data() + begin, end - begin,
+                        begin + 16 <= chars.size());
+    begin = end;
+  }
+}
+
+void S2CellId::FromTokens(absl::Span<const string_view> tokens,
+                          absl::Span<S2CellId> ids) {
+  ABSL_DCHECK_EQ(ids.size(), tokens.size());
+  for (size_t k = 0; k < ids.size(); ++k) {
+    ids[k] = ParseToken(tokens[k].data(), tokens[k].size(),
+                        false /*can_read_16*/);
   }
-  return S2CellId(id);
 }
 
 void S2CellId::Encode(Encoder* const encoder) const {
@@ -265,9 +380,6 @@ bool S2CellId::Decode(Decoder* const decoder) {
 }
 
 S2CellId S2CellId::FromFaceIJ(int face, int i, int j) {
-  // Initialization if not done yet
-  MaybeInit();
-
   // Optimization notes:
   //  - Non-overlapping bit fields can be combined with either "+" or "|".
   //    Generally "+" seems to produce better code, but not always.
@@ -320,10 +432,163 @@ S2CellId::S2CellId(const S2LatLng& ll)
   : S2CellId(ll.ToPoint()) {
 }
 
-int S2CellId::ToFaceIJOrientation(int* pi, int* pj, int* orientation) const {
-  // Initialization if not done yet
-  MaybeInit();
+// The batch conversion functions below process their input in blocks of
+// this many points, so that the temporary arrays fit on the stack.
+static constexpr int kBatchSize = 64;
+
+// Sets ij[k] = STtoIJ(UVtoST(num[k] / den[k])) for all k < n.
+//
+// The vectorized loops use exactly the same sequence of IEEE operations as
+// the scalar functions in s2coords.h (which are compiled without fused
+// multiply-adds), so that the results are bitwise identical.
+static void BatchUVtoIJ(const double* num, const double* den, int n,
+                        int* ij) {
+  int k = 0;
+#if S2_PROJECTION == S2_QUADRATIC_PROJECTION
+#if defined(__AVX2__)
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d half = _mm256_set1_pd(0.5);
+  const __m256d one = _mm256_set1_pd(1);
+  const __m256d three = _mm256_set1_pd(3);
+  const __m256d limit = _mm256_set1_pd(S2::kLimitIJ);
+  const __m128i min_ij = _mm_setzero_si128();
+  const __m128i max_ij = _mm_set1_epi32(S2::kLimitIJ - 1);
+  for (; k + 4 <= n; k += 4) {
+    __m256d u = _mm256_div_pd(_mm256_loadu_pd(num + k),
+                              _mm256_loadu_pd(den + k));
+    __m256d u3 = _mm256_mul_pd(three, u);
+    __m256d s_pos = _mm256_mul_pd(half, _mm256_sqrt_pd(_mm256_add_pd(one, u3)));
+    __m256d s_neg = _mm256_sub_pd(
+        one, _mm256_mul_pd(half, _mm256_sqrt_pd(_mm256_sub_pd(one, u3))));
+    __m256d s = _mm256_blendv_pd(s_neg, s_pos,
+                                 _mm256_cmp_pd(u, zero, _CMP_GE_OQ));
+    // _mm256_cvtpd_epi32 rounds using the current rounding mode, exactly
+    // like the "cvtsd2si" instruction used by MathUtil::FastIntRound().
+    __m128i i = _mm256_cvtpd_epi32(_mm256_sub_pd(_mm256_mul_pd(limit, s),
+                                                 half));
+    i = _mm_max_epi32(min_ij, _mm_min_epi32(max_ij, i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(ij + k), i);
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  // The final rounding step is done using scalar code, since
+  // MathUtil::FastIntRound() does not use the hardware rounding mode here.
+  const float64x2_t zero = vdupq_n_f64(0);
+  const float64x2_t half = vdupq_n_f64(0.5);
+  const float64x2_t one = vdupq_n_f64(1);
+  const float64x2_t three = vdupq_n_f64(3);
+  for (; k + 2 <= n; k += 2) {
+    float64x2_t u = vdivq_f64(vld1q_f64(num + k), vld1q_f64(den + k));
+    float64x2_t u3 = vmulq_f64(three, u);
+    float64x2_t s_pos = vmulq_f64(half, vsqrtq_f64(vaddq_f64(one, u3)));
+    float64x2_t s_neg =
+        vsubq_f64(one, vmulq_f64(half, vsqrtq_f64(vsubq_f64(one, u3))));
+    float64x2_t s = vbslq_f64(vcgeq_f64(u, zero), s_pos, s_neg);
+    ij[k] = S2::STtoIJ(vgetq_lane_f64(s, 0));
+    ij[k + 1] = S2::STtoIJ(vgetq_lane_f64(s, 1));
+  }
+#endif
+#endif  // S2_PROJECTION == S2_QUADRATIC_PROJECTION
+  for (; k < n; ++k) ij[k] = S2::STtoIJ(S2::UVtoST(num[k] / den[k]));
+}
+
+// Sets uv[k] = STtoUV(SiTitoST(siti[k])) for all k < n, where each siti[k]
+// is the (s,t)-coordinate of a cell center (and therefore less than 2**31).
+static void BatchSiTitoUV(const int* siti, int n, double* uv) {
+  int k = 0;
+#if S2_PROJECTION == S2_QUADRATIC_PROJECTION
+#if defined(__AVX2__)
+  const __m256d half = _mm256_set1_pd(0.5);
+  const __m256d one = _mm256_set1_pd(1);
+  const __m256d third = _mm256_set1_pd(1 / 3.);
+  const __m256d four = _mm256_set1_pd(4);
+  const __m256d scale = _mm256_set1_pd(1.0 / S2::kMaxSiTi);
+  for (; k + 4 <= n; k += 4) {
+    __m256d s = _mm256_mul_pd(scale, _mm256_cvtepi32_pd(_mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(siti + k))));
+    __m256d u_pos = _mm256_mul_pd(
+        third, _mm256_sub_pd(_mm256_mul_pd(_mm256_mul_pd(four, s), s), one));
+    __m256d t = _mm256_sub_pd(one, s);
+    __m256d u_neg = _mm256_mul_pd(
+        third, _mm256_sub_pd(one, _mm256_mul_pd(_mm256_mul_pd(four, t), t)));
+    _mm256_storeu_pd(uv + k, _mm256_blendv_pd(
+        u_neg, u_pos, _mm256_cmp_pd(s, half, _CMP_GE_OQ)));
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  const float64x2_t half = vdupq_n_f64(0.5);
+  const float64x2_t one = vdupq_n_f64(1);
+  const float64x2_t third = vdupq_n_f64(1 / 3.);
+  const float64x2_t four = vdupq_n_f64(4);
+  const float64x2_t scale = vdupq_n_f64(1.0 / S2::kMaxSiTi);
+  for (; k + 2 <= n; k += 2) {
+    int64x2_t si = vmovl_s32(vld1_s32(siti + k));
+    float64x2_t s = vmulq_f64(scale, vcvtq_f64_s64(si));
+    float64x2_t u_pos =
+        vmulq_f64(third, vsubq_f64(vmulq_f64(vmulq_f64(four, s), s), one));
+    float64x2_t t = vsubq_f64(one, s);
+    float64x2_t u_neg =
+        vmulq_f64(third, vsubq_f64(one, vmulq_f64(vmulq_f64(four, t), t)));
+    vst1q_f64(uv + k, vbslq_f64(vcgeq_f64(s, half), u_pos, u_neg));
+  }
+#endif
+#endif  // S2_PROJECTION == S2_QUADRATIC_PROJECTION
+  for (; k < n; ++k) uv[k] = S2::STtoUV(S2::SiTitoST(siti[k]));
+}
+
+// Sets ids[k] = S2CellId(points[k]).parent(level) for k < n <= kBatchSize.
+static void FromPointsBlock(const S2Point* points, int n, int level,
+                            S2CellId* ids) {
+  // For each point we select the face and then store the numerators and
+  // denominators of its (u,v)-coordinates (see S2::ValidFaceXYZtoUV), so
+  // that the divisions can be vectorized along with the rest of the (u,v) to
+  // (i,j) transformation.  The u- and v-coordinates are interleaved.
+  int faces[kBatchSize];
+  double num[2 * kBatchSize], den[2 * kBatchSize];
+  for (int k = 0; k < n; ++k) {
+    const S2Point& p = points[k];
+    int face = S2::GetFace(p);
+    faces[k] = face;
+    double* nk = num + 2 * k;
+    switch (face) {
+      case 0:  nk[0] =  p[1]; nk[1] =  p[2]; den[2 * k] = p[0]; break;
+      case 1:  nk[0] = -p[0]; nk[1] =  p[2]; den[2 * k] = p[1]; break;
+      case 2:  nk[0] = -p[0]; nk[1] = -p[1]; den[2 * k] = p[2]; break;
+      case 3:  nk[0] =  p[2]; nk[1] =  p[1]; den[2 * k] = p[0]; break;
+      case 4:  nk[0] =  p[2]; nk[1] = -p[0]; den[2 * k] = p[1]; break;
+      default: nk[0] = -p[1]; nk[1] = -p[0]; den[2 * k] = p[2]; break;
+    }
+    den[2 * k + 1] = den[2 * k];
+  }
+  int ij[2 * kBatchSize];
+  BatchUVtoIJ(num, den, 2 * n, ij);
+  for (int k = 0; k < n; ++k) {
+    ids[k] = S2CellId::FromFaceIJ(faces[k], ij[2 * k], ij[2 * k + 1])
+                 .parent(level);
+  }
+}
+
+void S2CellId::FromPoints(absl::Span<const S2Point> points, int level,
+                          absl::Span<S2CellId> ids) {
+  ABSL_DCHECK_EQ(points.size(), ids.size());
+  ABSL_DCHECK(level >= 0 && level <= kMaxLevel);
+  for (size_t i = 0; i < points.size(); i += kBatchSize) {
+    int n = min<size_t>(kBatchSize, points.size() - i);
+    FromPointsBlock(points.data() + i, n, level, ids.data() + i);
+  }
+}
 
+void S2CellId::FromLatLngs(absl::Span<const S2LatLng> lat_lngs, int level,
+                           absl::Span<S2CellId> ids) {
+  ABSL_DCHECK_EQ(lat_lngs.size(), ids.size());
+  ABSL_DCHECK(level >= 0 && level <= kMaxLevel);
+  S2Point points[kBatchSize];
+  for (size_t i = 0; i < lat_lngs.size(); i += kBatchSize) {
+    int n = min<size_t>(kBatchSize, lat_lngs.size() - i);
+    for (int k = 0; k < n; ++k) points[k] = lat_lngs[i + k].ToPoint();
+    FromPointsBlock(points, n, level, ids.data() + i);
+  }
+}
+
+int S2CellId::ToFaceIJOrientation(int* pi, int* pj, int* orientation) const {
   int i = 0, j = 0;
   int face = this->face();
   int bits = (face & kSwapMask);
@@ -387,6 +652,41 @@ S2LatLng S2CellId::ToLatLng() const {
   return S2LatLng(ToPointRaw());
 }
 
+// Sets points[k] = ids[k].ToPointRaw() for k < n <= kBatchSize.
+static void ToPointsRawBlock(const S2CellId* ids, int n, S2Point* points) {
+  int faces[kBatchSize], siti[2 * kBatchSize];
+  for (int k = 0; k < n; ++k) {
+    faces[k] = ids[k].GetCenterSiTi(&siti[2 * k], &siti[2 * k + 1]);
+  }
+  double uv[2 * kBatchSize];
+  BatchSiTitoUV(siti, 2 * n, uv);
+  for (int k = 0; k < n; ++k) {
+    points[k] = S2::FaceUVtoXYZ(faces[k], uv[2 * k], uv[2 * k + 1]);
+  }
+}
+
+void S2CellId::ToPoints(absl::Span<const S2CellId> ids,
+                        absl::Span<S2Point> points) {
+  ABSL_DCHECK_EQ(ids.size(), points.size());
+  for (size_t i = 0; i < ids.size(); i += kBatchSize) {
+    int n = min<size_t>(kBatchSize, ids.size() - i);
+    S2Point* block = points.data() + i;
+    ToPointsRawBlock(ids.data() + i, n, block);
+    for (int k = 0; k < n; ++k) block[k] = block[k].Normalize();
+  }
+}
+
+void S2CellId::ToLatLngs(absl::Span<const S2CellId> ids,
+                         absl::Span<S2LatLng> lat_lngs) {
+  ABSL_DCHECK_EQ(ids.size(), lat_lngs.size());
+  S2Point points[kBatchSize];
+  for (size_t i = 0; i < ids.size(); i += kBatchSize) {
+    int n = min<size_t>(kBatchSize, ids.size() - i);
+    ToPointsRawBlock(ids.data() + i, n, points);
+    for (int k = 0; k < n; ++k) lat_lngs[i + k] = S2LatLng(points[k]);
+  }
+}
+
 R2Point S2CellId::GetCenterST() const {
   int si, ti;
   GetCenterSiTi(&si, &ti);
@@ -33,6 +33,7 @@
 #include "absl/log/absl_check.h"
 #include "absl/numeric/bits.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 
 #include "s2/_fp_contract_off.h"
 #include "s2/base/types.h"
@@ -122,6 +123,20 @@ class S2CellId {
   // Construct a leaf cell containing the given normalized S2LatLng.
   explicit S2CellId(const S2LatLng& ll);
 
+  // Sets ids[k] = S2CellId(points[k]).parent(level) for all k.  This is
+  // faster than constructing the cells one at a time because the (u,v) and
+  // (i,j) coordinate transformations are vectorized (using AVX2 or NEON when
+  // available).  The results are always identical to the scalar versions.
+  //
+  // REQUIRES: ids.size() == points.size()
+  // REQUIRES: 0 <= level <= kMaxLevel
+  static void FromPoints(absl::Span<const S2Point> points, int level,
+                         absl::Span<S2CellId> ids);
+
+  // Like FromPoints(), but sets ids[k] = S2CellId(lat_lngs[k]).parent(level).
+  static void FromLatLngs(absl::Span<const S2LatLng> lat_lngs, int level,
+                          absl::Span<S2CellId> ids);
+
   // The default constructor returns an invalid cell id.
   IFNDEF_SWIG(constexpr) S2CellId() : id_(0) {}
   // Returns an invalid cell id.
@@ -209,6 +224,16 @@ class S2CellId {
   // Return the S2LatLng corresponding to the center of the given cell.
   S2LatLng ToLatLng() const;
 
+  // Batch versions of ToPoint() and ToLatLng(), which set points[k] =
+  // ids[k].ToPoint() and lat_lngs[k] = ids[k].ToLatLng() respectively.  As
+  // with FromPoints(), the results are identical to the scalar versions.
+  //
+  // REQUIRES: points.size() == ids.size(), lat_lngs.size() == ids.size()
+  static void ToPoints(absl::Span<const S2CellId> ids,
+                       absl::Span<S2Point> points);
+  static void ToLatLngs(absl::Span<const S2CellId> ids,
+                        absl::Span<S2LatLng> lat_lngs);
+
   // The 64-bit unique identifier for this cell.
   uint64 id() const { return id_; }
 
@@ -386,6 +411,43 @@ class S2CellId {
   std::string ToToken() const;
   static S2CellId FromToken(absl::string_view token);
 
+  // The maximum length of a token.
+  static constexpr int kMaxTokenLength = 16;
+
+  // Batch versions of ToToken() and FromToken() for columns of tokens that
+  // are stored back to back in a single character buffer, with the end
+  // offset of each token stored separately (e.g. Arrow string arrays).
+  // These functions do not allocate memory, and the hex conversions are
+  // vectorized when AVX2 is available.
+  //
+  // ToTokens() writes the token of each id to "chars", sets token_ends[k] to
+  // the offset just past the end of the token of ids[k], and returns the
+  // total number of characters written.  Note that characters of "chars"
+  // after the end of the last token may also be overwritten.
+  //
+  // REQUIRES: chars.size() >= kMaxTokenLength * ids.size()
+  // REQUIRES: token_ends.size() == ids.size()
+  static size_t ToTokens(absl::Span<const S2CellId> ids,
+                         absl::Span<char> chars,
+                         absl::Span<uint32> token_ends);
+
+  // Sets ids[k] = FromToken(token) for every token of a column written by
+  // ToTokens(), where token k extends from token_ends[k-1] (or 0) to
+  // token_ends[k].
+  //
+  // REQUIRES: token_ends is non-decreasing and token_ends.back() <=
+  //           chars.size()
+  // REQUIRES: ids.size() == token_ends.size()
+  static void FromTokens(absl::string_view chars,
+                         absl::Span<const uint32> token_ends,
+                         absl::Span<S2CellId> ids);
+
+  // Sets ids[k] = FromToken(tokens[k]) for all k.
+  //
+  // REQUIRES: ids.size() == tokens.size()
+  static void FromTokens(absl::Span<const absl::string_view> tokens,
+                         absl::Span<S2CellId> ids);
+
   // Legacy coder for S2CellId that delegates to the token representation.
   // Storage is variable depending on the level of the cell.
   class Coder : public s2coding::S2Coder<S2CellId> {
@@ -0,0 +1,89 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Benchmarks comparing the scalar and batch conversions between S2CellIds
+// and points.
+
+#include "s2/s2cell_id.h"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "absl/types/span.h"
+#include "s2/s2point.h"
+#include "s2/s2testing.h"
+
+using std::vector;
+
+namespace {
+
+constexpr int kNumPoints = 4096;
+
+vector<S2Point> RandomPoints() {
+  S2Testing::rnd.Reset(1);
+  vector<S2Point> points;
+  for (int i = 0; i < kNumPoints; ++i) {
+    points.push_back(S2Testing::RandomPoint());
+  }
+  return points;
+}
+
+void BM_FromPoint(benchmark::State& state) {
+  vector<S2Point> points = RandomPoints();
+  vector<S2CellId> ids(points.size());
+  for (auto _ : state) {
+    for (int i = 0; i < kNumPoints; ++i) ids[i] = S2CellId(points[i]);
+    benchmark::DoNotOptimize(ids.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kNumPoints);
+}
+BENCHMARK(BM_FromPoint);
+
+void BM_FromPoints(benchmark::State& state) {
+  vector<S2Point> points = RandomPoints();
+  vector<S2CellId> ids(points.size());
+  for (auto _ : state) {
+    S2CellId::FromPoints(points, S2CellId::kMaxLevel, absl::MakeSpan(ids));
+    benchmark::DoNotOptimize(ids.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kNumPoints);
+}
+BENCHMARK(BM_FromPoints);
+
+void BM_ToPoint(benchmark::State& state) {
+  vector<S2Point> points = RandomPoints();
+  vector<S2CellId> ids;
+  for (const S2Point& p : points) ids.push_back(S2CellId(p));
+  for (auto _ : state) {
+    for (int i = 0; i < kNumPoints; ++i) points[i] = ids[i].ToPoint();
+    benchmark::DoNotOptimize(points.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kNumPoints);
+}
+BENCHMARK(BM_ToPoint);
+
+void BM_ToPoints(benchmark::State& state) {
+  vector<S2Point> points = RandomPoints();
+  vector<S2CellId> ids;
+  for (const S2Point& p : points) ids.push_back(S2CellId(p));
+  for (auto _ : state) {
+    S2CellId::ToPoints(ids, absl::MakeSpan(points));
+    benchmark::DoNotOptimize(points.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kNumPoints);
+}
+BENCHMARK(BM_ToPoints);
+
+}  // namespace
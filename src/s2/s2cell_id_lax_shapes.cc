@@ -0,0 +1,224 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2cell_id_lax_shapes.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/log/absl_check.h"
+#include "absl/log/absl_log.h"
+#include "absl/types/span.h"
+#include "s2/base/types.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2coords.h"
+#include "s2/s2point.h"
+#include "s2/s2shape.h"
+#include "s2/s2shapeutil_get_reference_point.h"
+
+using absl::Span;
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Appends the cells whose centers are the given points to "ids" and returns
+// true, or returns false if some point is not exactly the center of a cell.
+bool AppendCenterCellIds(Span<const S2Point> points, vector<S2CellId>* ids) {
+  for (const S2Point& p : points) {
+    int face;
+    unsigned int si, ti;
+    int level = S2::XYZtoFaceSiTi(p, &face, &si, &ti);
+    if (level < 0) return false;
+    S2CellId id = S2CellId::FromFaceIJ(face, si >> 1, ti >> 1).parent(level);
+    ABSL_DCHECK_EQ(id.ToPoint(), p);
+    ids->push_back(id);
+  }
+  return true;
+}
+
+}  // namespace
+
+S2CellIdLaxPolylineShape::S2CellIdLaxPolylineShape(
+    S2CellIdLaxPolylineShape&& other)
+    : S2Shape(std::move(other)),
+      num_vertices_(std::exchange(other.num_vertices_, 0)),
+      vertices_(std::move(other.vertices_)) {}
+
+S2CellIdLaxPolylineShape& S2CellIdLaxPolylineShape::operator=(
+    S2CellIdLaxPolylineShape&& other) {
+  S2Shape::operator=(static_cast<S2Shape&&>(other));
+  num_vertices_ = std::exchange(other.num_vertices_, 0);
+  vertices_ = std::move(other.vertices_);
+  return *this;
+}
+
+S2CellIdLaxPolylineShape::S2CellIdLaxPolylineShape(
+    Span<const S2CellId> vertices) {
+  Init(vertices);
+}
+
+void S2CellIdLaxPolylineShape::Init(Span<const S2CellId> vertices) {
+  num_vertices_ = vertices.size();
+  ABSL_LOG_IF(WARNING, num_vertices_ == 1)
+      << "S2CellIdLaxPolylineShape with one vertex has no edges";
+  vertices_ = make_unique<S2CellId[]>(num_vertices_);
+  std::copy(vertices.begin(), vertices.end(), vertices_.get());
+}
+
+bool S2CellIdLaxPolylineShape::Init(Span<const S2Point> vertices) {
+  vector<S2CellId> ids;
+  ids.reserve(vertices.size());
+  if (!AppendCenterCellIds(vertices, &ids)) return false;
+  Init(ids);
+  return true;
+}
+
+S2Shape::Edge S2CellIdLaxPolylineShape::edge(int e) const {
+  ABSL_DCHECK_LT(e, num_edges());
+  return Edge(vertex(e), vertex(e + 1));
+}
+
+int S2CellIdLaxPolylineShape::num_chains() const {
+  return std::min(1, S2CellIdLaxPolylineShape::num_edges());
+}
+
+S2Shape::Chain S2CellIdLaxPolylineShape::chain(int i) const {
+  return Chain(0, S2CellIdLaxPolylineShape::num_edges());
+}
+
+S2Shape::Edge S2CellIdLaxPolylineShape::chain_edge(int i, int j) const {
+  ABSL_DCHECK_EQ(i, 0);
+  ABSL_DCHECK_LT(j, num_edges());
+  return Edge(vertex(j), vertex(j + 1));
+}
+
+S2Shape::ChainPosition S2CellIdLaxPolylineShape::chain_position(int e) const {
+  return S2Shape::ChainPosition(0, e);
+}
+
+S2CellIdLaxPolygonShape::S2CellIdLaxPolygonShape(
+    S2CellIdLaxPolygonShape&& b)
+    : S2Shape(std::move(b)),
+      num_loops_(std::exchange(b.num_loops_, 0)),
+      prev_loop_(b.prev_loop_.exchange(0, std::memory_order_relaxed)),
+      num_vertices_(std::exchange(b.num_vertices_, 0)),
+      vertices_(std::move(b.vertices_)),
+      loop_starts_(std::move(b.loop_starts_)) {}
+
+S2CellIdLaxPolygonShape& S2CellIdLaxPolygonShape::operator=(
+    S2CellIdLaxPolygonShape&& b) {
+  using std::memory_order_relaxed;
+
+  S2Shape::operator=(static_cast<S2Shape&&>(b));
+  num_loops_ = std::exchange(b.num_loops_, 0);
+  prev_loop_.store(b.prev_loop_.exchange(0, memory_order_relaxed),
+                   memory_order_relaxed);
+  num_vertices_ = std::exchange(b.num_vertices_, 0);
+  vertices_ = std::move(b.vertices_);
+  loop_starts_ = std::move(b.loop_starts_);
+  return *this;
+}
+
+S2CellIdLaxPolygonShape::S2CellIdLaxPolygonShape(
+    Span<const Span<const S2CellId>> loops) {
+  Init(loops);
+}
+
+void S2CellIdLaxPolygonShape::Init(Span<const Span<const S2CellId>> loops) {
+  num_loops_ = loops.size();
+  prev_loop_.store(0, std::memory_order_relaxed);
+  loop_starts_.reset();
+  num_vertices_ = 0;
+  if (num_loops_ > 1) {
+    // Don't use make_unique<> here in order to avoid zero initialization.
+    loop_starts_ = unique_ptr<uint32[]>(new uint32[num_loops_ + 1]);
+    for (int i = 0; i < num_loops_; ++i) {
+      loop_starts_[i] = num_vertices_;
+      num_vertices_ += loops[i].size();
+    }
+    loop_starts_[num_loops_] = num_vertices_;
+  } else if (num_loops_ == 1) {
+    num_vertices_ = loops[0].size();
+  }
+  vertices_ = make_unique<S2CellId[]>(num_vertices_);
+  S2CellId* next = vertices_.get();
+  for (Span<const S2CellId> loop : loops) {
+    next = std::copy(loop.begin(), loop.end(), next);
+  }
+}
+
+bool S2CellIdLaxPolygonShape::Init(Span<const Span<const S2Point>> loops) {
+  vector<S2CellId> ids;
+  vector<Span<const S2CellId>> spans;
+  size_t num_vertices = 0;
+  for (Span<const S2Point> loop : loops) num_vertices += loop.size();
+  ids.reserve(num_vertices);
+  for (Span<const S2Point> loop : loops) {
+    if (!AppendCenterCellIds(loop, &ids)) return false;
+  }
+  spans.reserve(loops.size());
+  const S2CellId* next = ids.data();
+  for (Span<const S2Point> loop : loops) {
+    spans.emplace_back(next, loop.size());
+    next += loop.size();
+  }
+  Init(spans);
+  return true;
+}
+
+int S2CellIdLaxPolygonShape::num_loop_vertices(int i) const {
+  ABSL_DCHECK_LT(i, num_loops());
+  if (num_loops() == 1) {
+    return num_vertices_;
+  } else {
+    return loop_starts_[i + 1] - loop_starts_[i];
+  }
+}
+
+S2CellId S2CellIdLaxPolygonShape::loop_vertex_id(int i, int j) const {
+  ABSL_DCHECK_LT(i, num_loops());
+  ABSL_DCHECK_LT(j, num_loop_vertices(i));
+  if (i == 0) {
+    return vertices_[j];
+  } else {
+    return vertices_[loop_starts_[i] + j];
+  }
+}
+
+S2Shape::Edge S2CellIdLaxPolygonShape::edge(int e) const {
+  // Method names are fully specified to enable inlining.
+  ChainPosition pos = S2CellIdLaxPolygonShape::chain_position(e);
+  return S2CellIdLaxPolygonShape::chain_edge(pos.chain_id, pos.offset);
+}
+
+S2Shape::ReferencePoint S2CellIdLaxPolygonShape::GetReferencePoint() const {
+  return s2shapeutil::GetReferencePoint(*this);
+}
+
+S2Shape::Chain S2CellIdLaxPolygonShape::chain(int i) const {
+  ABSL_DCHECK_LT(i, num_loops());
+  if (num_loops() == 1) {
+    return Chain(0, num_vertices_);
+  } else {
+    int start = loop_starts_[i];
+    return Chain(start, loop_starts_[i + 1] - start);
+  }
+}
@@ -0,0 +1,225 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// This file defines S2Shape types whose vertices are stored as S2CellIds:
+//
+// S2CellIdLaxPolylineShape
+//   - like S2LaxPolylineShape, but each vertex is stored as the S2CellId
+//     whose center is that vertex.
+//
+// S2CellIdLaxPolygonShape
+//   - like S2LaxPolygonShape, but each vertex is stored as the S2CellId
+//     whose center is that vertex.
+//
+// These classes are intended for geometry that has been snapped to cell
+// centers (e.g., by S2Builder using s2builderutil::S2CellIdSnapFunction).
+// Each vertex uses 8 bytes rather than the 24 bytes of an S2Point, and is
+// decoded exactly using S2CellId::ToPoint() when it is accessed.  This is
+// the same representation as the CELL_IDS format of EncodedS2PointVector,
+// except that the shapes are constructed directly and own their data.
+//
+// Vertices do not all need to be snapped to the same level.  The shapes
+// cannot represent points that are not cell centers; use the Init() methods
+// that return "bool" to convert S2Points safely.
+
+#ifndef S2_S2CELL_ID_LAX_SHAPES_H_
+#define S2_S2CELL_ID_LAX_SHAPES_H_
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "absl/base/attributes.h"
+#include "absl/log/absl_check.h"
+#include "absl/types/span.h"
+#include "s2/base/types.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2point.h"
+#include "s2/s2shape.h"
+
+// S2CellIdLaxPolylineShape represents a polyline whose vertices are the
+// centers of the given S2CellIds.  Like S2LaxPolylineShape, adjacent vertices
+// may be identical or antipodal.
+class S2CellIdLaxPolylineShape : public S2Shape {
+ public:
+  // Constructs an empty polyline.
+  S2CellIdLaxPolylineShape() : num_vertices_(0) {}
+
+  S2CellIdLaxPolylineShape(S2CellIdLaxPolylineShape&& other);
+
+  S2CellIdLaxPolylineShape& operator=(S2CellIdLaxPolylineShape&& other);
+
+  // Constructs a polyline whose vertices are the centers of the given cells.
+  //
+  // REQUIRES: All cell ids are valid.
+  explicit S2CellIdLaxPolylineShape(absl::Span<const S2CellId> vertices);
+
+  // Initializes a polyline whose vertices are the centers of the given cells.
+  //
+  // REQUIRES: All cell ids are valid.
+  void Init(absl::Span<const S2CellId> vertices);
+
+  // Initializes the polyline from the given vertices and returns true if
+  // every vertex is exactly the center of some S2Cell.  Otherwise returns
+  // false and leaves the polyline unchanged.
+  bool Init(absl::Span<const S2Point> vertices);
+
+  int num_vertices() const { return num_vertices_; }
+  S2CellId vertex_id(int i) const { return vertices_[i]; }
+  S2Point vertex(int i) const { return vertices_[i].ToPoint(); }
+
+  // S2Shape interface:
+  int num_edges() const final { return std::max(0, num_vertices() - 1); }
+  Edge edge(int e) const final;
+  int dimension() const final { return 1; }
+  ReferencePoint GetReferencePoint() const final {
+    return ReferencePoint::Contained(false);
+  }
+  int num_chains() const final;
+  Chain chain(int i) const final;
+  Edge chain_edge(int i, int j) const final;
+  ChainPosition chain_position(int e) const final;
+
+ private:
+  // For clients that have many small polylines, we save some memory by
+  // representing the vertices as an array rather than using std::vector.
+  int32 num_vertices_;
+  std::unique_ptr<S2CellId[]> vertices_;
+};
+
+// S2CellIdLaxPolygonShape represents a polygon whose vertices are the
+// centers of the given S2CellIds.  It has the same semantics and
+// requirements as S2LaxPolygonShape (see s2lax_polygon_shape.h).
+class S2CellIdLaxPolygonShape : public S2Shape {
+ public:
+  // Constructs an empty polygon.
+  S2CellIdLaxPolygonShape() : num_loops_(0), num_vertices_(0) {}
+
+  S2CellIdLaxPolygonShape(S2CellIdLaxPolygonShape&& b);
+  S2CellIdLaxPolygonShape& operator=(S2CellIdLaxPolygonShape&& b);
+
+  // Constructs a polygon from the given loops, where each vertex is the
+  // center of the corresponding cell.
+  //
+  // REQUIRES: All cell ids are valid.
+  explicit S2CellIdLaxPolygonShape(
+      absl::Span<const absl::Span<const S2CellId>> loops);
+
+  // Initializes a polygon from the given loops, where each vertex is the
+  // center of the corresponding cell.
+  //
+  // REQUIRES: All cell ids are valid.
+  void Init(absl::Span<const absl::Span<const S2CellId>> loops);
+
+  // Initializes the polygon from the given vertex loops and returns true if
+  // every vertex is exactly the center of some S2Cell.  Otherwise returns
+  // false and leaves the polygon unchanged.
+  bool Init(absl::Span<const absl::Span<const S2Point>> loops);
+
+  // Returns the number of loops.
+  int num_loops() const { return num_loops_; }
+
+  // Returns the total number of vertices in all loops.
+  int num_vertices() const { return num_vertices_; }
+
+  // Returns the number of vertices in the given loop.
+  int num_loop_vertices(int i) const;
+
+  // Returns the cell id of the vertex from loop "i" at index "j".
+  // REQUIRES: 0 <= i < num_loops()
+  // REQUIRES: 0 <= j < num_loop_vertices(i)
+  S2CellId loop_vertex_id(int i, int j) const;
+
+  // Returns the vertex from loop "i" at index "j".
+  // REQUIRES: 0 <= i < num_loops()
+  // REQUIRES: 0 <= j < num_loop_vertices(i)
+  S2Point loop_vertex(int i, int j) const {
+    return loop_vertex_id(i, j).ToPoint();
+  }
+
+  // S2Shape interface:
+  int num_edges() const final { return num_vertices(); }
+  Edge edge(int e) const final;
+  int dimension() const final { return 2; }
+  ReferencePoint GetReferencePoint() const final;
+  int num_chains() const final { return num_loops(); }
+  Chain chain(int i) const final;
+  Edge chain_edge(int i, int j) const final;
+  ChainPosition chain_position(int e) const final;
+
+ private:
+  int32 num_loops_;
+
+  // The loop that contained the edge returned by the previous call to the
+  // edge() method.  This is used as a hint to speed up edge location when
+  // there are many loops.
+  mutable std::atomic<int> prev_loop_{0};
+
+  int32 num_vertices_;
+  std::unique_ptr<S2CellId[]> vertices_;
+
+  // When num_loops_ > 1, stores an array of size (num_loops_ + 1) where
+  // element "i" represents the total number of vertices in loops 0..i-1.
+  std::unique_ptr<uint32[]> loop_starts_;
+};
+
+
+//////////////////   Implementation details follow   ////////////////////
+
+
+ABSL_ATTRIBUTE_ALWAYS_INLINE
+inline S2Shape::Edge S2CellIdLaxPolygonShape::chain_edge(int i, int j) const {
+  ABSL_DCHECK_LT(i, num_loops());
+  ABSL_DCHECK_LT(j, num_loop_vertices(i));
+  int n = num_loop_vertices(i);
+  int k = (j + 1 == n) ? 0 : j + 1;
+  int start = (num_loops() == 1) ? 0 : loop_starts_[i];
+  return Edge(vertices_[start + j].ToPoint(), vertices_[start + k].ToPoint());
+}
+
+ABSL_ATTRIBUTE_ALWAYS_INLINE
+inline S2Shape::ChainPosition S2CellIdLaxPolygonShape::chain_position(
+    int e) const {
+  ABSL_DCHECK_LT(e, num_edges());
+  if (num_loops() == 1) {
+    return ChainPosition(0, e);
+  }
+  // Test if this edge belongs to the loop returned by the previous call.
+  const uint32* start =
+      &loop_starts_[0] + prev_loop_.load(std::memory_order_relaxed);
+  if (static_cast<uint32>(e) >= start[0] && static_cast<uint32>(e) < start[1]) {
+    // This edge belongs to the same loop as the previous call.
+  } else {
+    if (static_cast<uint32>(e) == start[1]) {
+      // This is the edge immediately following the previous loop.
+      do {
+        ++start;
+      } while (static_cast<uint32>(e) == start[1]);
+    } else {
+      start = &loop_starts_[0];
+      constexpr int kMaxLinearSearchLoops = 12;  // From benchmarks.
+      if (num_loops() <= kMaxLinearSearchLoops) {
+        while (start[1] <= static_cast<uint32>(e)) ++start;
+      } else {
+        start = std::upper_bound(start + 1, start + num_loops(), e) - 1;
+      }
+    }
+    prev_loop_.store(start - &loop_starts_[0], std::memory_order_relaxed);
+  }
+  return ChainPosition(start - &loop_starts_[0], e - start[0]);
+}
+
+#endif  // S2_S2CELL_ID_LAX_SHAPES_H_
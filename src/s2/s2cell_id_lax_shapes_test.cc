@@ -0,0 +1,195 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2cell_id_lax_shapes.h"
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/types/span.h"
+#include "s2/s1angle.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2latlng.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2lax_polyline_shape.h"
+#include "s2/s2point.h"
+#include "s2/s2shape.h"
+#include "s2/s2shapeutil_testing.h"
+#include "s2/s2testing.h"
+
+using absl::Span;
+using std::vector;
+
+namespace {
+
+// Returns the cells at random levels between 20 and 30 that contain the
+// given points.
+vector<S2CellId> SnapPoints(Span<const S2Point> points) {
+  vector<S2CellId> ids;
+  for (const S2Point& p : points) {
+    ids.push_back(S2CellId(p).parent(20 + S2Testing::rnd.Uniform(11)));
+  }
+  return ids;
+}
+
+vector<S2Point> ToPoints(Span<const S2CellId> ids) {
+  vector<S2Point> points;
+  for (S2CellId id : ids) points.push_back(id.ToPoint());
+  return points;
+}
+
+TEST(S2CellIdLaxPolylineShape, NoVertices) {
+  S2CellIdLaxPolylineShape shape;
+  EXPECT_EQ(0, shape.num_edges());
+  EXPECT_EQ(0, shape.num_chains());
+  EXPECT_EQ(1, shape.dimension());
+  EXPECT_TRUE(shape.is_empty());
+}
+
+TEST(S2CellIdLaxPolylineShape, MatchesS2LaxPolylineShape) {
+  S2Testing::rnd.Reset(1);
+  vector<S2CellId> ids = SnapPoints(S2Testing::MakeRegularPoints(
+      S2Testing::RandomPoint(), S1Angle::Degrees(1), 100));
+  S2CellIdLaxPolylineShape shape(ids);
+  ASSERT_EQ(ids.size(), shape.num_vertices());
+  for (int i = 0; i < ids.size(); ++i) {
+    EXPECT_EQ(ids[i], shape.vertex_id(i));
+    EXPECT_EQ(ids[i].ToPoint(), shape.vertex(i));
+  }
+  s2testing::ExpectEqual(S2LaxPolylineShape(ToPoints(ids)), shape);
+}
+
+TEST(S2CellIdLaxPolylineShape, InitFromPoints) {
+  S2Testing::rnd.Reset(2);
+  vector<S2CellId> ids = SnapPoints(S2Testing::MakeRegularPoints(
+      S2Testing::RandomPoint(), S1Angle::Degrees(1), 20));
+  // Include a face cell to check the coarsest level.
+  ids.push_back(S2CellId::FromFace(3));
+  vector<S2Point> points = ToPoints(ids);
+  S2CellIdLaxPolylineShape shape;
+  ASSERT_TRUE(shape.Init(points));
+  for (int i = 0; i < ids.size(); ++i) {
+    EXPECT_EQ(ids[i], shape.vertex_id(i));
+  }
+
+  // Points that are not cell centers are rejected, and the shape is left
+  // unchanged.
+  points.push_back(S2Point(1, 2, 3).Normalize());
+  EXPECT_FALSE(shape.Init(points));
+  EXPECT_EQ(ids.size(), shape.num_vertices());
+}
+
+TEST(S2CellIdLaxPolylineShape, Move) {
+  S2Testing::rnd.Reset(3);
+  vector<S2CellId> ids = SnapPoints(S2Testing::MakeRegularPoints(
+      S2Testing::RandomPoint(), S1Angle::Degrees(1), 10));
+  S2CellIdLaxPolylineShape original(ids);
+  S2CellIdLaxPolylineShape moved(std::move(original));
+  EXPECT_EQ(ids.size(), moved.num_vertices());
+  S2CellIdLaxPolylineShape assigned;
+  assigned = std::move(moved);
+  s2testing::ExpectEqual(S2LaxPolylineShape(ToPoints(ids)), assigned);
+}
+
+TEST(S2CellIdLaxPolygonShape, EmptyAndFull) {
+  S2CellIdLaxPolygonShape empty;
+  EXPECT_EQ(0, empty.num_loops());
+  EXPECT_TRUE(empty.is_empty());
+  EXPECT_FALSE(empty.GetReferencePoint().contained);
+
+  vector<Span<const S2CellId>> loops(1);
+  S2CellIdLaxPolygonShape full(loops);
+  EXPECT_EQ(1, full.num_loops());
+  EXPECT_EQ(0, full.num_vertices());
+  EXPECT_TRUE(full.is_full());
+  EXPECT_TRUE(full.GetReferencePoint().contained);
+}
+
+TEST(S2CellIdLaxPolygonShape, ManyLoopsMatchS2LaxPolygonShape) {
+  // Use enough loops so that binary search is used to find the loop
+  // containing a given edge.
+  S2Testing::rnd.Reset(4);
+  vector<vector<S2CellId>> id_loops;
+  vector<vector<S2Point>> point_loops;
+  for (int i = 0; i < 100; ++i) {
+    S2Point center(S2LatLng::FromDegrees(0, i));
+    id_loops.push_back(SnapPoints(S2Testing::MakeRegularPoints(
+        center, S1Angle::Degrees(0.1), S2Testing::rnd.Uniform(5))));
+    point_loops.push_back(ToPoints(id_loops.back()));
+  }
+  vector<Span<const S2CellId>> spans(id_loops.begin(), id_loops.end());
+  S2CellIdLaxPolygonShape shape(spans);
+  S2LaxPolygonShape expected(point_loops);
+  s2testing::ExpectEqual(expected, shape);
+  for (int i = 0; i < id_loops.size(); ++i) {
+    ASSERT_EQ(id_loops[i].size(), shape.num_loop_vertices(i));
+    for (int j = 0; j < id_loops[i].size(); ++j) {
+      EXPECT_EQ(id_loops[i][j], shape.loop_vertex_id(i, j));
+      EXPECT_EQ(point_loops[i][j], shape.loop_vertex(i, j));
+    }
+  }
+
+  // Now test all the edges in a random order in order to exercise the cases
+  // involving prev_loop_.
+  vector<int> edges(shape.num_edges());
+  for (int e = 0; e < edges.size(); ++e) edges[e] = e;
+  std::shuffle(edges.begin(), edges.end(), std::mt19937_64());
+  for (int e : edges) {
+    EXPECT_EQ(expected.chain_position(e), shape.chain_position(e));
+    EXPECT_EQ(expected.edge(e), shape.edge(e));
+  }
+}
+
+TEST(S2CellIdLaxPolygonShape, InitFromPoints) {
+  S2Testing::rnd.Reset(5);
+  vector<vector<S2Point>> loops;
+  for (int i = 0; i < 3; ++i) {
+    loops.push_back(ToPoints(SnapPoints(S2Testing::MakeRegularPoints(
+        S2Testing::RandomPoint(), S1Angle::Degrees(1), 5 + i))));
+  }
+  vector<Span<const S2Point>> spans(loops.begin(), loops.end());
+  S2CellIdLaxPolygonShape shape;
+  ASSERT_TRUE(shape.Init(spans));
+  s2testing::ExpectEqual(S2LaxPolygonShape(loops), shape);
+
+  loops[1][2] = S2Point(1, 2, 3).Normalize();
+  spans.assign(loops.begin(), loops.end());
+  S2CellIdLaxPolygonShape rejected;
+  EXPECT_FALSE(rejected.Init(spans));
+  EXPECT_EQ(0, rejected.num_loops());
+}
+
+TEST(S2CellIdLaxPolygonShape, Move) {
+  S2Testing::rnd.Reset(6);
+  vector<vector<S2CellId>> loops;
+  for (int i = 0; i < 2; ++i) {
+    loops.push_back(SnapPoints(S2Testing::MakeRegularPoints(
+        S2Testing::RandomPoint(), S1Angle::Degrees(1), 4)));
+  }
+  vector<Span<const S2CellId>> spans(loops.begin(), loops.end());
+  S2CellIdLaxPolygonShape original(spans);
+  S2CellIdLaxPolygonShape moved(std::move(original));
+  EXPECT_EQ(2, moved.num_loops());
+  S2CellIdLaxPolygonShape assigned;
+  assigned = std::move(moved);
+  EXPECT_EQ(2, assigned.num_loops());
+  EXPECT_EQ(8, assigned.num_edges());
+  EXPECT_EQ(loops[1][3], assigned.loop_vertex_id(1, 3));
+}
+
+}  // namespace
@@ -34,6 +34,7 @@
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 
 #include "s2/r1interval.h"
 #include "s2/r2.h"
@@ -299,6 +300,42 @@ TEST(S2CellId, Inverses) {
   }
 }
 
+TEST(S2CellId, BatchConversionsMatchScalar) {
+  // Include points on face boundaries, the cube corners, unnormalized points,
+  // and points whose (u,v)-coordinates are zero.  The number of points is not
+  // a multiple of the vector width or the internal batch size.
+  vector<S2Point> points = {
+      S2Point(1, 0, 0),  S2Point(0, -1, 0), S2Point(0, 0, 1),
+      S2Point(1, 1, 1),  S2Point(-1, 1, -1), S2Point(1, -1, 0),
+      S2Point(3, 2, 1),  S2Point(-1e-300, 1e-300, 2e-300),
+      S2Point(0.5, 0.5, -0.5)};
+  for (int i = 0; i < 1000; ++i) {
+    points.push_back(S2Testing::RandomPoint() * (i % 3 + 0.5));
+  }
+  vector<S2LatLng> lat_lngs;
+  for (const S2Point& p : points) lat_lngs.push_back(S2LatLng(p));
+  for (int level : {0, 10, S2CellId::kMaxLevel}) {
+    vector<S2CellId> ids(points.size()), ll_ids(points.size());
+    S2CellId::FromPoints(points, level, absl::MakeSpan(ids));
+    S2CellId::FromLatLngs(lat_lngs, level, absl::MakeSpan(ll_ids));
+    for (size_t i = 0; i < points.size(); ++i) {
+      ASSERT_EQ(ids[i], S2CellId(points[i]).parent(level)) << points[i];
+      ASSERT_EQ(ll_ids[i], S2CellId(lat_lngs[i]).parent(level));
+    }
+    vector<S2Point> centers(ids.size());
+    vector<S2LatLng> center_lat_lngs(ids.size());
+    S2CellId::ToPoints(ids, absl::MakeSpan(centers));
+    S2CellId::ToLatLngs(ids, absl::MakeSpan(center_lat_lngs));
+    for (size_t i = 0; i < ids.size(); ++i) {
+      ASSERT_EQ(centers[i], ids[i].ToPoint());
+      ASSERT_EQ(center_lat_lngs[i], ids[i].ToLatLng());
+    }
+  }
+  // Empty spans are allowed.
+  S2CellId::FromPoints({}, 0, {});
+  S2CellId::ToPoints({}, {});
+}
+
 TEST(S2CellId, Tokens) {
   // Test random cell ids at all levels.
   for (int i = 0; i < 10000; ++i) {
@@ -328,6 +365,48 @@ TEST(S2CellId, Tokens) {
   EXPECT_EQ(S2CellId::None(), S2CellId::FromToken(" 876bee99"));
 }
 
+TEST(S2CellId, BatchTokensMatchScalar) {
+  // Include ids at every level, invalid ids, and tokens of every length.
+  vector<S2CellId> ids = {S2CellId::None(), S2CellId::Sentinel(),
+                          S2CellId::FromFace(7), S2CellId(1)};
+  for (int i = 0; i < 1000; ++i) ids.push_back(S2Testing::GetRandomCellId());
+  vector<char> chars(S2CellId::kMaxTokenLength * ids.size());
+  vector<uint32> token_ends(ids.size());
+  const size_t length = S2CellId::ToTokens(ids, absl::MakeSpan(chars),
+                                           absl::MakeSpan(token_ends));
+  ASSERT_EQ(length, token_ends.back());
+  string_view column(chars.data(), length);
+  vector<string_view> tokens;
+  for (size_t k = 0, begin = 0; k < ids.size(); begin = token_ends[k++]) {
+    tokens.push_back(column.substr(begin, token_ends[k] - begin));
+    ASSERT_EQ(tokens.back(), ids[k].ToToken());
+  }
+
+  // Decode the column both from the single buffer (where most tokens can
+  // be read using 16-byte loads) and from separate strings.
+  vector<S2CellId> column_ids(ids.size()), token_ids(ids.size());
+  S2CellId::FromTokens(column, token_ends, absl::MakeSpan(column_ids));
+  S2CellId::FromTokens(tokens, absl::MakeSpan(token_ids));
+  EXPECT_EQ(column_ids, ids);
+  EXPECT_EQ(token_ids, ids);
+
+  // Malformed tokens are decoded as S2CellId::None(), like FromToken().
+  vector<string_view> bad_tokens = {"876b e99", "876bee99\n", "876[ee99",
+                                    " 876bee99", "876bEE99g", "X",
+                                    "0123456789abcdef0", "", "3/", "@", "`"};
+  vector<S2CellId> bad_ids(bad_tokens.size());
+  S2CellId::FromTokens(bad_tokens, absl::MakeSpan(bad_ids));
+  for (size_t k = 0; k < bad_tokens.size(); ++k) {
+    EXPECT_EQ(bad_ids[k], S2CellId::FromToken(bad_tokens[k])) << k;
+  }
+  // Upper-case digits are accepted.
+  vector<string_view> upper = {"89C25", "89c25ABCDEF"};
+  vector<S2CellId> upper_ids(upper.size());
+  S2CellId::FromTokens(upper, absl::MakeSpan(upper_ids));
+  EXPECT_EQ(upper_ids[0], S2CellId::FromToken("89c25"));
+  EXPECT_EQ(upper_ids[1], S2CellId::FromToken("89c25abcdef"));
+}
+
 TEST(S2CellId, EncodeDecode) {
   S2CellId id(0x7837423);
   Encoder encoder;
@@ -18,24 +18,127 @@
 #include "s2/s2cell_index.h"
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <thread>
 #include <vector>
 
 #include "absl/container/flat_hash_set.h"
 #include "absl/log/absl_check.h"
+#include "absl/types/span.h"
+#include "s2/base/port.h"
+#include "s2/base/types.h"
+#include "s2/util/coding/coder.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_union.h"
 
 using absl::flat_hash_set;
+using absl::Span;
+using std::max;
+using std::min;
 using std::vector;
 
 using Label = S2CellIndex::Label;
 
+namespace {
+
+// To build the cell tree and leaf cell ranges, we maintain a stack of
+// (cell_id, label) pairs that contain the current leaf cell.  This class
+// represents an instruction to push or pop a (cell_id, label) pair.
+//
+// If label >= 0, the (cell_id, label) pair is pushed on the stack.
+// If cell_id == S2CellId::Sentinel(), a pair is popped from the stack.
+// Otherwise the stack is unchanged but a RangeNode is still emitted.
+struct Delta {
+  S2CellId start_id, cell_id;
+  Label label;
+
+  Delta() = default;
+  Delta(S2CellId _start_id, S2CellId _cell_id, Label _label)
+      : start_id(_start_id), cell_id(_cell_id), label(_label) {}
+
+  // Deltas are sorted first by start_id, then in reverse order by cell_id,
+  // and then by label.  This is necessary to ensure that (1) larger cells
+  // are pushed on the stack before smaller cells, and (2) cells are popped
+  // off the stack before any new cells are added.
+  bool operator<(const Delta& y) const {
+    if (start_id < y.start_id) return true;
+    if (y.start_id < start_id) return false;
+    if (y.cell_id < cell_id) return true;
+    if (cell_id < y.cell_id) return false;
+    return label < y.label;
+  }
+};
+
+// Sorting fewer deltas than this per thread is not worth starting a thread.
+constexpr size_t kMinDeltasPerThread = 1 << 14;
+
+// Sorts "deltas" using up to "num_threads" threads.  The deltas are divided
+// into one chunk per thread, the chunks are sorted concurrently, and then
+// pairs of adjacent chunks are merged concurrently until one chunk remains.
+void SortDeltas(vector<Delta>* deltas, int num_threads) {
+  const size_t n = deltas->size();
+  num_threads = min<size_t>(max(num_threads, 1),
+                            max<size_t>(n / kMinDeltasPerThread, 1));
+  if (num_threads == 1) {
+    std::sort(deltas->begin(), deltas->end());
+    return;
+  }
+  vector<size_t> bounds(num_threads + 1);
+  for (int i = 0; i <= num_threads; ++i) bounds[i] = n * i / num_threads;
+  const auto begin = deltas->begin();
+  vector<std::thread> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back([begin, &bounds, i]() {
+      std::sort(begin + bounds[i], begin + bounds[i + 1]);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  for (int width = 1; width < num_threads; width *= 2) {
+    threads.clear();
+    for (int i = 0; i + width < num_threads; i += 2 * width) {
+      const int end = min(i + 2 * width, num_threads);
+      threads.emplace_back([begin, &bounds, i, width, end]() {
+        std::inplace_merge(begin + bounds[i], begin + bounds[i + width],
+                           begin + bounds[end]);
+      });
+    }
+    for (auto& thread : threads) thread.join();
+  }
+}
+
+// The current version of the encoding format.
+constexpr uint32 kCurrentEncodingVersion = 1;
+
+// The number of bytes in the encoding header.
+constexpr size_t kEncodingHeaderSize = 16;
+
+}  // namespace
+
 void S2CellIndex::RangeIterator::Seek(S2CellId target) {
   ABSL_DCHECK(target.is_leaf());
-  it_ = std::upper_bound(range_nodes_->begin(), range_nodes_->end(),
+  it_ = std::upper_bound(range_nodes_.begin(), range_nodes_.end(),
                          target) - 1;
 }
 
+void S2CellIndex::RangeIterator::SeekForward(S2CellId target) {
+  ABSL_DCHECK(target.is_leaf());
+  ABSL_DCHECK_LE(start_id(), target);
+  // Find a node "hi" that follows "target" using steps of increasing size,
+  // and then do a binary search in the last step.  The sentinel node always
+  // follows "target".
+  const RangeNode* last = range_nodes_.end() - 1;
+  const RangeNode* lo = it_;
+  ptrdiff_t step = 1;
+  while (step < last - lo && lo[step].start_id <= target) {
+    lo += step;
+    step *= 2;
+  }
+  const RangeNode* hi = std::min(lo + step, last);
+  it_ = std::upper_bound(lo, hi, target) - 1;
+}
+
 void S2CellIndex::ContentsIterator::StartUnion(const RangeIterator& range) {
   if (range.start_id() < prev_start_id_) {
     node_cutoff_ = -1;  // Can't automatically eliminate duplicates.
@@ -72,51 +175,26 @@ void S2CellIndex::Add(const S2CellUnion& cell_ids, Label label) {
   }
 }
 
-void S2CellIndex::Build() {
-  // To build the cell tree and leaf cell ranges, we maintain a stack of
-  // (cell_id, label) pairs that contain the current leaf cell.  This class
-  // represents an instruction to push or pop a (cell_id, label) pair.
-  //
-  // If label >= 0, the (cell_id, label) pair is pushed on the stack.
-  // If cell_id == S2CellId::Sentinel(), a pair is popped from the stack.
-  // Otherwise the stack is unchanged but a RangeNode is still emitted.
-  struct Delta {
-    S2CellId start_id, cell_id;
-    Label label;
-
-    Delta(S2CellId _start_id, S2CellId _cell_id, Label _label)
-        : start_id(_start_id), cell_id(_cell_id), label(_label) {}
-
-    // Deltas are sorted first by start_id, then in reverse order by cell_id,
-    // and then by label.  This is necessary to ensure that (1) larger cells
-    // are pushed on the stack before smaller cells, and (2) cells are popped
-    // off the stack before any new cells are added.
-    bool operator<(const Delta& y) const {
-      if (start_id < y.start_id) return true;
-      if (y.start_id < start_id) return false;
-      if (y.cell_id < cell_id) return true;
-      if (cell_id < y.cell_id) return false;
-      return label < y.label;
-    }
-  };
-
-  vector<Delta> deltas;
-  deltas.reserve(2 * cell_tree_.size() + 2);
+void S2CellIndex::Build(int num_threads) {
+  ABSL_DCHECK(ranges_.empty()) << "Build() may only be called once";
   // Create two deltas for each (cell_id, label) pair: one to add the pair to
   // the stack (at the start of its leaf cell range), and one to remove it from
   // the stack (at the end of its leaf cell range).
-  for (const CellNode& node : cell_tree_) {
-    deltas.push_back(Delta(node.cell_id.range_min(), node.cell_id, node.label));
-    deltas.push_back(Delta(node.cell_id.range_max().next(),
-                           S2CellId::Sentinel(), -1));
+  const size_t n = cell_tree_.size();
+  vector<Delta> deltas(2 * n + 2);
+  for (size_t i = 0; i < n; ++i) {
+    const CellNode& node = cell_tree_[i];
+    deltas[2 * i] = Delta(node.cell_id.range_min(), node.cell_id, node.label);
+    deltas[2 * i + 1] = Delta(node.cell_id.range_max().next(),
+                              S2CellId::Sentinel(), -1);
   }
   // We also create two special deltas to ensure that a RangeNode is emitted at
   // the beginning and end of the S2CellId range.
-  deltas.push_back(
-      Delta(S2CellId::Begin(S2CellId::kMaxLevel), S2CellId::None(), -1));
-  deltas.push_back(
-      Delta(S2CellId::End(S2CellId::kMaxLevel), S2CellId::None(), -1));
-  std::sort(deltas.begin(), deltas.end());
+  deltas[2 * n] =
+      Delta(S2CellId::Begin(S2CellId::kMaxLevel), S2CellId::None(), -1);
+  deltas[2 * n + 1] =
+      Delta(S2CellId::End(S2CellId::kMaxLevel), S2CellId::None(), -1);
+  SortDeltas(&deltas, num_threads);
 
   // Now walk through the deltas to build the leaf cell ranges and cell tree
   // (which is essentially a permanent form of the "stack" described above).
@@ -136,6 +214,108 @@ void S2CellIndex::Build() {
     }
     range_nodes_.push_back({start_id, contents});
   }
+  cells_ = cell_tree_;
+  ranges_ = range_nodes_;
+}
+
+void S2CellIndex::Encode(Encoder* encoder) const {
+  ABSL_DCHECK(!ranges_.empty()) << "Call Build() first.";
+  // The encoding consists of a 16-byte header
+  //
+  //   version (fixed32), num_cells (fixed32), num_ranges (fixed32), 0
+  //
+  // followed by the cell tree and the leaf cell ranges.  Each CellNode is
+  // encoded as (cell_id (fixed64), label (fixed32), parent (fixed32)) and
+  // each RangeNode as (start_id (fixed64), contents (fixed32)).  This is the
+  // same as their in-memory layout on little-endian platforms (S2CellId is
+  // packed, so neither struct has any padding).
+  encoder->Ensure(kEncodingHeaderSize + cells_.size() * sizeof(CellNode) +
+                  ranges_.size() * sizeof(RangeNode));
+  encoder->put32(kCurrentEncodingVersion);
+  encoder->put32(cells_.size());
+  encoder->put32(ranges_.size());
+  encoder->put32(0);
+  for (const CellNode& node : cells_) {
+    encoder->put64(node.cell_id.id());
+    encoder->put32(node.label);
+    encoder->put32(node.parent);
+  }
+  for (const RangeNode& node : ranges_) {
+    encoder->put64(node.start_id.id());
+    encoder->put32(node.contents);
+  }
+}
+
+bool S2CellIndex::Decode(Decoder* decoder) {
+  static_assert(sizeof(CellNode) == 16, "Encoding assumes CellNode layout");
+  static_assert(sizeof(RangeNode) == 12, "Encoding assumes RangeNode layout");
+  Clear();
+  if (decoder->avail() < kEncodingHeaderSize) return false;
+  if (decoder->get32() != kCurrentEncodingVersion) return false;
+  const uint32 num_cells = decoder->get32();
+  const uint32 num_ranges = decoder->get32();
+  decoder->get32();
+  const uint64 cells_bytes = uint64{num_cells} * sizeof(CellNode);
+  const uint64 bytes = cells_bytes + uint64{num_ranges} * sizeof(RangeNode);
+  if (num_cells > std::numeric_limits<int32>::max() || num_ranges < 2 ||
+      decoder->avail() < bytes) {
+    return false;
+  }
+  const char* data = decoder->skip(0);
+#ifdef IS_LITTLE_ENDIAN
+  if (reinterpret_cast<uintptr_t>(data) % alignof(CellNode) == 0) {
+    static_assert(alignof(RangeNode) <= alignof(CellNode));
+    cells_ = Span<const CellNode>(reinterpret_cast<const CellNode*>(data),
+                                  num_cells);
+    ranges_ = Span<const RangeNode>(
+        reinterpret_cast<const RangeNode*>(data + cells_bytes), num_ranges);
+  }
+#endif
+  if (ranges_.empty()) {
+    Decoder copy(data, bytes);
+    cell_tree_.reserve(num_cells);
+    for (uint32 i = 0; i < num_cells; ++i) {
+      S2CellId cell_id(copy.get64());
+      Label label = copy.get32();
+      int32 parent = copy.get32();
+      cell_tree_.push_back({cell_id, label, parent});
+    }
+    range_nodes_.reserve(num_ranges);
+    for (uint32 i = 0; i < num_ranges; ++i) {
+      S2CellId start_id(copy.get64());
+      int32 contents = copy.get32();
+      range_nodes_.push_back({start_id, contents});
+    }
+    cells_ = cell_tree_;
+    ranges_ = range_nodes_;
+  }
+  decoder->skip(bytes);
+
+  // Validate the decoded data so that the iterators cannot access memory
+  // outside the index.
+  for (size_t i = 0; i < cells_.size(); ++i) {
+    const CellNode& node = cells_[i];
+    if (!node.cell_id.is_valid() || node.label < 0 || node.parent < -1 ||
+        node.parent >= static_cast<int64>(i)) {
+      Clear();
+      return false;
+    }
+  }
+  if (ranges_.front().start_id != S2CellId::Begin(S2CellId::kMaxLevel) ||
+      ranges_.back().start_id != S2CellId::End(S2CellId::kMaxLevel)) {
+    Clear();
+    return false;
+  }
+  for (size_t i = 0; i < ranges_.size(); ++i) {
+    const RangeNode& node = ranges_[i];
+    if (node.contents < -1 ||
+        node.contents >= static_cast<int64>(cells_.size()) ||
+        (i > 0 && !(ranges_[i - 1].start_id < node.start_id))) {
+      Clear();
+      return false;
+    }
+  }
+  return true;
 }
 
 flat_hash_set<Label> S2CellIndex::GetIntersectingLabels(
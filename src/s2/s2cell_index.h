@@ -25,11 +25,13 @@
 
 #include "absl/container/flat_hash_set.h"
 #include "absl/log/absl_check.h"
+#include "absl/types/span.h"
 
 #include "s2/base/types.h"
 #include "s2/base/log_severity.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_union.h"
+#include "s2/util/coding/coder.h"
 
 // S2CellIndex stores a collection of (cell_id, label) pairs.  The S2CellIds
 // may be overlapping or contain duplicate values.  For example, an
@@ -65,6 +67,10 @@
 // Note that the index is not dynamic; the contents of the index cannot be
 // changed once it has been built.
 //
+// A built index can be serialized using Encode().  Decode() can use the
+// encoded data in place without copying it (e.g., from a memory-mapped
+// file), so that servers do not need to rebuild the index at startup.
+//
 // There are several options for retrieving data from the index.  The simplest
 // is to use a built-in method such as GetIntersectingLabels (which returns
 // the labels of all cells that intersect a given target S2CellUnion):
@@ -160,7 +166,31 @@ class S2CellIndex {
 
   // Constructs the index.  This method may only be called once.  No iterators
   // may be used until the index is built.
-  void Build();
+  //
+  // If num_threads > 1 and the index is large enough to make it worthwhile,
+  // the cell ranges are sorted using multiple threads.  The resulting index
+  // does not depend on num_threads.
+  void Build(int num_threads = 1);
+
+  // Appends an encoded representation of the index to "encoder".  The
+  // encoding is a fixed-size header followed by the arrays used by the
+  // index, stored so that Decode() can use them in place.
+  //
+  // REQUIRES: Build() has been called.
+  // REQUIRES: "encoder" uses the default constructor, so that its buffer
+  //           can be enlarged as necessary by calling Ensure(int).
+  void Encode(Encoder* encoder) const;
+
+  // Initializes the index from data written by Encode(), replacing any
+  // existing contents.  Returns false if the data is invalid.  The decoded
+  // index supports all the same operations as a built index (including
+  // S2ClosestCellQuery), except that Add() and Build() may not be called.
+  //
+  // On little-endian platforms, if the encoded data is 4-byte aligned then
+  // the index uses it in place (the data is still validated, but it is not
+  // copied).  In that case the Decoder data buffer must outlive this object.
+  // Otherwise the data is copied.
+  bool Decode(Decoder* decoder);
 
   // Clears the index so that it can be re-used.
   void Clear();
@@ -178,6 +208,12 @@ class S2CellIndex {
   bool VisitIntersectingCells(const S2CellUnion& target,
                               const CellVisitor& visitor) const;
 
+  // Like the method above, but the target is a single cell.  This avoids
+  // constructing an S2CellUnion, e.g. when the target is the leaf cell that
+  // contains a query point.
+  bool VisitIntersectingCells(S2CellId target,
+                              const CellVisitor& visitor) const;
+
   // Convenience function that returns the labels of all indexed cells that
   // intersect the given S2CellUnion "target".
   absl::flat_hash_set<Label> GetIntersectingLabels(const S2CellUnion& target)
@@ -238,8 +274,9 @@ class S2CellIndex {
 
    private:
     // NOTE(ericv): There is a potential optimization that would require this
-    // class to iterate over both cell_tree_ *and* range_nodes_.
-    std::vector<CellNode>::const_iterator cell_it_, cell_end_;
+    // class to iterate over both cells_ *and* ranges_.
+    const CellNode* cell_it_;
+    const CellNode* cell_end_;
   };
 
   // An iterator that seeks and iterates over a set of non-overlapping leaf
@@ -286,6 +323,15 @@ class S2CellIndex {
     // REQUIRES: target.is_leaf()
     void Seek(S2CellId target);
 
+    // Equivalent to Seek(target), but searches forward from the current
+    // position so that it takes O(log d) time when the target is "d" ranges
+    // ahead.  This is faster than Seek() when visiting targets in increasing
+    // S2CellId order.
+    //
+    // REQUIRES: target.is_leaf()
+    // REQUIRES: start_id() <= target
+    void SeekForward(S2CellId target);
+
     // Returns true if no (s2cell_id, label) pairs intersect this range.
     // Also returns true if done() is true.
     bool is_empty() const;
@@ -298,15 +344,15 @@ class S2CellIndex {
    private:
     // A special value used to indicate that the RangeIterator has not yet
     // been initialized by calling Begin() or Seek().
-    std::vector<RangeNode>::const_iterator kUninitialized() const {
+    const RangeNode* kUninitialized() const {
       // Note that since the last element of range_nodes_ is a sentinel value,
-      // it_ will never legitimately be positioned at range_nodes_->end().
-      return range_nodes_->end();
+      // it_ will never legitimately be positioned at range_nodes_.end().
+      return range_nodes_.end();
     }
 
     friend class ContentsIterator;
-    const std::vector<RangeNode>* range_nodes_;
-    std::vector<RangeNode>::const_iterator it_;
+    absl::Span<const RangeNode> range_nodes_;
+    const RangeNode* it_;
   };
 
   // Like RangeIterator, but only visits leaf cell ranges that overlap at
@@ -336,6 +382,14 @@ class S2CellIndex {
     //
     // REQUIRES: target.is_leaf()
     void Seek(S2CellId target);
+
+    // Equivalent to Seek(target), but searches forward from the current
+    // position (see RangeIterator::SeekForward).
+    //
+    // REQUIRES: target.is_leaf()
+    // REQUIRES: the iterator was positioned by Seek() or SeekForward() with
+    //           a target that is less than or equal to "target".
+    void SeekForward(S2CellId target);
   };
 
   // An iterator that visits the (cell_id, label) pairs that cover a set of
@@ -392,8 +446,9 @@ class S2CellIndex {
     // node_.label == kDoneContents indicates that done() is true.
     void set_done() { node_.label = kDoneContents; }
 
-    // A pointer to the cell tree itself (owned by the S2CellIndex).
-    const std::vector<CellNode>* cell_tree_;
+    // A pointer to the cell tree itself (owned by the S2CellIndex).  Note
+    // that Init() may be called before the index is built.
+    const absl::Span<const CellNode>* cell_tree_;
 
     // The value of it.start_id() from the previous call to StartUnion().
     // This is used to check whether these values are monotonically
@@ -443,6 +498,12 @@ class S2CellIndex {
   // in order to represent the range covered by the previous element.
   std::vector<RangeNode> range_nodes_;
 
+  // The cell tree and leaf cell ranges used by the iterators.  These refer
+  // either to cell_tree_ and range_nodes_, or to encoded data that is being
+  // used in place (see Decode).  "ranges_" is empty until the index is built.
+  absl::Span<const CellNode> cells_;
+  absl::Span<const RangeNode> ranges_;
+
   S2CellIndex(const S2CellIndex&) = delete;
   void operator=(const S2CellIndex&) = delete;
 };
@@ -452,9 +513,9 @@ std::ostream& operator<<(std::ostream& os, S2CellIndex::LabelledCell x);
 
 
 inline S2CellIndex::CellIterator::CellIterator(const S2CellIndex* index)
-    : cell_it_(index->cell_tree_.begin()),
-      cell_end_(index->cell_tree_.end()) {
-  ABSL_DCHECK(!index->range_nodes_.empty()) << "Call Build() first.";
+    : cell_it_(index->cells_.data()),
+      cell_end_(index->cells_.data() + index->cells_.size()) {
+  ABSL_DCHECK(!index->ranges_.empty()) << "Call Build() first.";
 }
 
 inline S2CellId S2CellIndex::CellIterator::cell_id() const {
@@ -483,8 +544,8 @@ inline void S2CellIndex::CellIterator::Next() {
 }
 
 inline S2CellIndex::RangeIterator::RangeIterator(const S2CellIndex* index)
-    : range_nodes_(&index->range_nodes_), it_() {
-  ABSL_DCHECK(!range_nodes_->empty()) << "Call Build() first.";
+    : range_nodes_(index->ranges_), it_() {
+  ABSL_DCHECK(!range_nodes_.empty()) << "Call Build() first.";
   if (google::DEBUG_MODE) it_ = kUninitialized();  // See done().
 }
 
@@ -501,16 +562,16 @@ inline bool S2CellIndex::RangeIterator::done() const {
   ABSL_DCHECK(it_ != kUninitialized()) << "Call Begin() or Seek() first.";
 
   // Note that the last element of range_nodes_ is a sentinel value.
-  return it_ >= range_nodes_->end() - 1;
+  return it_ >= range_nodes_.end() - 1;
 }
 
 inline void S2CellIndex::RangeIterator::Begin() {
-  it_ = range_nodes_->begin();
+  it_ = range_nodes_.begin();
 }
 
 inline void S2CellIndex::RangeIterator::Finish() {
   // Note that the last element of range_nodes_ is a sentinel value.
-  it_ = range_nodes_->end() - 1;
+  it_ = range_nodes_.end() - 1;
 }
 
 inline void S2CellIndex::RangeIterator::Next() {
@@ -524,7 +585,7 @@ inline bool S2CellIndex::RangeIterator::is_empty() const {
 
 inline bool S2CellIndex::RangeIterator::Advance(int n) {
   // Note that the last element of range_nodes_ is a sentinel value.
-  if (n >= range_nodes_->end() - 1 - it_) return false;
+  if (n >= range_nodes_.end() - 1 - it_) return false;
   it_ += n;
   return true;
 }
@@ -559,8 +620,17 @@ inline void S2CellIndex::NonEmptyRangeIterator::Seek(S2CellId target) {
   while (is_empty() && !done()) RangeIterator::Next();
 }
 
+inline void S2CellIndex::NonEmptyRangeIterator::SeekForward(
+    S2CellId target) {
+  // If the current range follows "target", then the previous target was in
+  // an empty range that "target" also belongs to (or that precedes it).
+  if (start_id() > target) return;
+  RangeIterator::SeekForward(target);
+  while (is_empty() && !done()) RangeIterator::Next();
+}
+
 inline bool S2CellIndex::RangeIterator::Prev() {
-  if (it_ == range_nodes_->begin()) return false;
+  if (it_ == range_nodes_.begin()) return false;
   --it_;
   return true;
 }
@@ -575,7 +645,7 @@ inline S2CellIndex::ContentsIterator::ContentsIterator(
 }
 
 inline void S2CellIndex::ContentsIterator::Init(const S2CellIndex* index) {
-  cell_tree_ = &index->cell_tree_;
+  cell_tree_ = &index->cells_;
   Clear();
 }
 
@@ -618,10 +688,12 @@ inline void S2CellIndex::ContentsIterator::Next() {
 }
 
 inline int S2CellIndex::num_cells() const {
-  return cell_tree_.size();
+  // Until the index is built, the cells are only stored in cell_tree_.
+  return ranges_.empty() ? cell_tree_.size() : cells_.size();
 }
 
 inline void S2CellIndex::Add(S2CellId cell_id, Label label) {
+  ABSL_DCHECK(ranges_.empty()) << "Add() called after Build() or Decode()";
   ABSL_DCHECK(cell_id.is_valid());
   ABSL_DCHECK_GE(label, 0);
   cell_tree_.push_back(CellNode(cell_id, label, -1));
@@ -630,6 +702,8 @@ inline void S2CellIndex::Add(S2CellId cell_id, Label label) {
 inline void S2CellIndex::Clear() {
   cell_tree_.clear();
   range_nodes_.clear();
+  cells_ = {};
+  ranges_ = {};
 }
 
 inline bool S2CellIndex::VisitIntersectingCells(
@@ -663,6 +737,21 @@ inline bool S2CellIndex::VisitIntersectingCells(
   return true;
 }
 
+inline bool S2CellIndex::VisitIntersectingCells(
+    S2CellId target, const CellVisitor& visitor) const {
+  ContentsIterator contents(this);
+  RangeIterator range(this);
+  range.Seek(target.range_min());
+  for (; range.start_id() <= target.range_max(); range.Next()) {
+    for (contents.StartUnion(range); !contents.done(); contents.Next()) {
+      if (!visitor(contents.cell_id(), contents.label())) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
 inline std::ostream& operator<<(std::ostream& os,
                                 S2CellIndex::LabelledCell x) {
   return os << "(" << x.cell_id << ", " << x.label << ")";
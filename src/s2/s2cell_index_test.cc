@@ -32,6 +32,7 @@
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_union.h"
 #include "s2/s2testing.h"
+#include "s2/util/coding/coder.h"
 
 using absl::flat_hash_set;
 using absl::string_view;
@@ -418,4 +419,99 @@ TEST_F(S2CellIndexTest, IntersectionSemiRandomUnions) {
   }
 }
 
+// Returns the encoding of the given index.
+string EncodeIndex(const S2CellIndex& index) {
+  Encoder encoder;
+  index.Encode(&encoder);
+  return string(encoder.base(), encoder.length());
+}
+
+TEST_F(S2CellIndexTest, EncodeDecode) {
+  for (int i = 0; i < 100; ++i) {
+    Add(GetRandomCellUnion(), i);
+  }
+  Build();
+  Encoder encoder;
+  index_.Encode(&encoder);
+  const string encoded(encoder.base(), encoder.length());
+
+  // Decode from an aligned buffer (which is used in place on
+  // little-endian platforms) and also from a misaligned copy.
+  string misaligned = "x" + encoded;
+  vector<Decoder> decoders = {Decoder(encoder.base(), encoder.length()),
+                              Decoder(misaligned.data() + 1, encoded.size())};
+  for (Decoder& decoder : decoders) {
+    S2CellIndex decoded;
+    ASSERT_TRUE(decoded.Decode(&decoder));
+    EXPECT_EQ(0, decoder.avail());
+    EXPECT_EQ(index_.num_cells(), decoded.num_cells());
+    EXPECT_EQ(encoded, EncodeIndex(decoded));
+    for (int j = 0; j < 20; ++j) {
+      S2CellUnion target = GetRandomCellUnion();
+      EXPECT_EQ(index_.GetIntersectingLabels(target),
+                decoded.GetIntersectingLabels(target));
+    }
+    index_.Clear();
+    Decoder copy(encoded.data(), encoded.size());
+    ASSERT_TRUE(index_.Decode(&copy));
+    VerifyCellIterator();
+    VerifyRangeIterators();
+  }
+}
+
+TEST_F(S2CellIndexTest, DecodeInvalid) {
+  Add("0/", 1);
+  Add("0/12", 2);
+  Build();
+  string encoded = EncodeIndex(index_);
+  S2CellIndex decoded;
+  for (size_t len = 0; len < encoded.size(); ++len) {
+    Decoder decoder(encoded.data(), len);
+    EXPECT_FALSE(decoded.Decode(&decoder)) << len;
+  }
+  // Corrupt the parent of the first cell node so that it is out of range.
+  string corrupt = encoded;
+  corrupt[16 + 12] = 0;
+  Decoder decoder(corrupt.data(), corrupt.size());
+  EXPECT_FALSE(decoded.Decode(&decoder));
+  EXPECT_EQ(0, decoded.num_cells());
+}
+
+TEST_F(S2CellIndexTest, ParallelBuildMatchesSerial) {
+  S2CellIndex serial, parallel;
+  for (int i = 0; i < 40000; ++i) {
+    S2CellId id = S2Testing::GetRandomCellId();
+    serial.Add(id, i);
+    parallel.Add(id, i);
+  }
+  serial.Build();
+  parallel.Build(4);
+  EXPECT_EQ(EncodeIndex(serial), EncodeIndex(parallel));
+}
+
+TEST_F(S2CellIndexTest, SeekForwardMatchesSeek) {
+  for (int i = 0; i < 1000; ++i) {
+    Add(S2Testing::GetRandomCellId(), i);
+  }
+  Build();
+  vector<S2CellId> targets;
+  for (int i = 0; i < 2000; ++i) {
+    targets.push_back(S2CellId(S2Testing::RandomPoint()));
+  }
+  std::sort(targets.begin(), targets.end());
+  S2CellIndex::RangeIterator range(&index_), expected_range(&index_);
+  S2CellIndex::NonEmptyRangeIterator non_empty(&index_),
+      expected_non_empty(&index_);
+  range.Begin();
+  non_empty.Begin();
+  for (S2CellId target : targets) {
+    range.SeekForward(target);
+    expected_range.Seek(target);
+    EXPECT_EQ(range.start_id(), expected_range.start_id());
+    non_empty.SeekForward(target);
+    expected_non_empty.Seek(target);
+    EXPECT_EQ(non_empty.start_id(), expected_non_empty.start_id());
+  }
+}
+
 }  // namespace
@@ -132,6 +132,28 @@ class S2CellIterator {
   // (but valid) state.
   virtual S2CellRelation Locate(S2CellId target) = 0;
 
+  // Like Seek(), but uses the current position as a hint ("finger search").
+  // Iterators over random-access collections take time logarithmic in the
+  // distance between the current position and the result rather than in the
+  // size of the collection, so that a sorted sequence of seeks costs close
+  // to linear time overall.  Other iterators step a few positions toward the
+  // target before falling back to Seek().  The target may be before or after
+  // the current position; the result is always the same as Seek(target).
+  //
+  // REQUIRES: The iterator has been initialized (an unpositioned iterator
+  //           behaves as though it were positioned at the end).
+  virtual void SeekNear(S2CellId target) { SeekNearImpl(*this, target); }
+
+  // Equivalent to the corresponding Locate() methods, except that SeekNear()
+  // is used to position the iterator.  These are useful when locating a
+  // sorted sequence of targets.
+  virtual bool LocateNear(const S2Point& target) {
+    return LocateNearImpl(*this, target);
+  }
+  virtual S2CellRelation LocateNear(S2CellId target) {
+    return LocateNearImpl(*this, target);
+  }
+
  protected:
   template <typename Iterator>
   static inline bool LocateImpl(Iterator& iter, const S2Point& point);
@@ -139,6 +161,40 @@ class S2CellIterator {
   template <typename Iterator>
   static inline S2CellRelation LocateImpl(Iterator& iter, S2CellId target);
 
+  template <typename Iterator>
+  static inline bool LocateNearImpl(Iterator& iter, const S2Point& point);
+
+  template <typename Iterator>
+  static inline S2CellRelation LocateNearImpl(Iterator& iter,
+                                              S2CellId target);
+
+  // A default implementation of SeekNear() for iterators that only support
+  // sequential access.
+  template <typename Iterator>
+  static inline void SeekNearImpl(Iterator& iter, S2CellId target);
+
+  // A finger search for iterators over random-access collections.  Returns
+  // the first position in [0, size) whose id is >= "target" (or "size" if
+  // there is no such position), where "id_at(i)" returns the S2CellId at
+  // position "i" and ids are sorted.  The search gallops outward from
+  // position "hint" in exponentially increasing steps and then performs a
+  // binary search within the bracketed range.
+  //
+  // REQUIRES: 0 <= hint <= size
+  template <typename IdFunction>
+  static inline int GallopLowerBound(int hint, int size, S2CellId target,
+                                     const IdFunction& id_at);
+
+  // Helper functions for LocateImpl() and LocateNearImpl() that complete the
+  // operation once the iterator has been positioned at Seek(target) (for
+  // points) or Seek(target.range_min()) (for cells).
+  template <typename Iterator>
+  static inline bool LocatePointAfterSeek(Iterator& iter, S2CellId target);
+
+  template <typename Iterator>
+  static inline S2CellRelation LocateCellAfterSeek(Iterator& iter,
+                                                   S2CellId target);
+
   // Disable public copying and assigning via abstract base class pointer.
   S2CellIterator(const S2CellIterator&) = default;
   S2CellIterator& operator=(const S2CellIterator&) = default;
@@ -150,14 +206,46 @@ template <typename Iterator>
 inline bool S2CellIterator::LocateImpl(Iterator& iter, const S2Point& point) {
   static_assert(S2CellIterator::ImplementedBy<Iterator>{},
                 "Iterator must implement the S2CellIterator API.");
+  S2CellId target(point);
+  iter.Seek(target);
+  return LocatePointAfterSeek(iter, target);
+}
+
+template <typename Iterator>
+inline S2CellRelation S2CellIterator::LocateImpl(Iterator& iter,
+                                                 S2CellId target) {
+  static_assert(S2CellIterator::ImplementedBy<Iterator>{},
+                "Iterator must implement the S2CellIterator API.");
+  iter.Seek(target.range_min());
+  return LocateCellAfterSeek(iter, target);
+}
+
+template <typename Iterator>
+inline bool S2CellIterator::LocateNearImpl(Iterator& iter,
+                                           const S2Point& point) {
+  static_assert(S2CellIterator::ImplementedBy<Iterator>{},
+                "Iterator must implement the S2CellIterator API.");
+  S2CellId target(point);
+  iter.SeekNear(target);
+  return LocatePointAfterSeek(iter, target);
+}
 
+template <typename Iterator>
+inline S2CellRelation S2CellIterator::LocateNearImpl(Iterator& iter,
+                                                     S2CellId target) {
+  static_assert(S2CellIterator::ImplementedBy<Iterator>{},
+                "Iterator must implement the S2CellIterator API.");
+  iter.SeekNear(target.range_min());
+  return LocateCellAfterSeek(iter, target);
+}
+
+template <typename Iterator>
+inline bool S2CellIterator::LocatePointAfterSeek(Iterator& iter,
+                                                 S2CellId target) {
   // Let I = Seek(T), where T is the leaf cell containing the target point, and
   // let Prev(I) be the predecessor of I.  If T is contained by an index cell,
   // then the containing cell is either I or Prev(I).  We test for containment
   // by comparing the ranges of leaf cells spanned by T, I, and Prev(I).
-  S2CellId target(point);
-
-  iter.Seek(target);
   if (!iter.done() && iter.id().range_min() <= target) {
     return true;
   }
@@ -169,17 +257,13 @@ inline bool S2CellIterator::LocateImpl(Iterator& iter, const S2Point& point) {
 }
 
 template <typename Iterator>
-inline S2CellRelation S2CellIterator::LocateImpl(Iterator& iter,
-                                                 S2CellId target) {
-  static_assert(S2CellIterator::ImplementedBy<Iterator>{},
-                "Iterator must implement the S2CellIterator API.");
-
+inline S2CellRelation S2CellIterator::LocateCellAfterSeek(Iterator& iter,
+                                                          S2CellId target) {
   // Let T be the target cell id, let I = Seek(T.range_min()) and let Prev(I) be
   // the predecessor of I.  If T contains any index cells, then T contains I.
   // Similarly, if T is contained by an index cell, then the containing cell is
   // either I or Prev(I).  We test for containment by comparing the ranges of
   // leaf cells spanned by T, I, and Prev(I).
-  iter.Seek(target.range_min());
   if (!iter.done()) {
     // The target is contained by the cell we landed on, so it's indexed.
     if (iter.id() >= target && iter.id().range_min() <= target) {
@@ -200,4 +284,76 @@ inline S2CellRelation S2CellIterator::LocateImpl(Iterator& iter,
   return S2CellRelation::DISJOINT;
 }
 
+template <typename Iterator>
+inline void S2CellIterator::SeekNearImpl(Iterator& iter, S2CellId target) {
+  static_assert(S2CellIterator::ImplementedBy<Iterator>{},
+                "Iterator must implement the S2CellIterator API.");
+
+  // Sequential access is cheap compared to a full Seek(), but its cost grows
+  // linearly with distance, so we only take a few steps.
+  constexpr int kMaxSteps = 4;
+  if (!iter.done() && iter.id() < target) {
+    for (int i = 0; i < kMaxSteps; ++i) {
+      iter.Next();
+      if (iter.done() || iter.id() >= target) return;
+    }
+  } else {
+    // The current position satisfies id() >= target; the result is the
+    // first position with this property.
+    for (int i = 0; i < kMaxSteps; ++i) {
+      if (!iter.Prev()) return;
+      if (iter.id() < target) {
+        iter.Next();
+        return;
+      }
+    }
+  }
+  iter.Seek(target);
+}
+
+template <typename IdFunction>
+inline int S2CellIterator::GallopLowerBound(int hint, int size,
+                                            S2CellId target,
+                                            const IdFunction& id_at) {
+  // First find a range (lo, hi] that contains the result, where lo is either
+  // -1 or a position with id_at(lo) < target, and hi is either "size" or a
+  // position with id_at(hi) >= target.
+  int lo, hi;
+  if (hint < size && id_at(hint) < target) {
+    lo = hint;
+    for (int step = 1;; step *= 2) {
+      if (size - lo <= step) {
+        hi = size;
+        break;
+      }
+      hi = lo + step;
+      if (id_at(hi) >= target) break;
+      lo = hi;
+    }
+  } else {
+    hi = hint;
+    for (int step = 1;; step *= 2) {
+      if (hi < step) {
+        lo = -1;
+        break;
+      }
+      lo = hi - step;
+      if (id_at(lo) < target) break;
+      hi = lo;
+    }
+  }
+  // Now do a binary search for the first position in (lo, hi) whose id is
+  // >= target, returning "hi" if there is no such position.
+  ++lo;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (id_at(mid) < target) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
 #endif  // S2_S2CELL_ITERATOR_H_
@@ -16,9 +16,16 @@
 #ifndef S2_S2CELL_ITERATOR_TESTING_H_
 #define S2_S2CELL_ITERATOR_TESTING_H_
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
 #include "absl/container/btree_map.h"
 #include "absl/log/absl_check.h"
+#include "s2/s2cell_id.h"
 #include "s2/s2cell_iterator.h"
+#include "s2/s2testing.h"
 
 // A mock iterator for testing.  Iterates an absl::btree_map mapping S2CellId to
 // another type.  Rather than instantiating directly, consider using
@@ -117,4 +124,51 @@ MockS2CellIterator<T> MakeMockS2CellIterator(
   return MockS2CellIterator<T>(map);
 }
 
+// Verifies that SeekNear() and LocateNear() give the same results as Seek()
+// and Locate() for a set of targets visited in increasing order, decreasing
+// order, and random order.  The targets include every cell id in the
+// iterator's collection and its neighbors, plus "num_random" random cell ids.
+template <typename Iterator>
+void TestSeekNear(const Iterator& iter, int num_random = 100) {
+  std::vector<S2CellId> targets = {S2CellId::Begin(S2CellId::kMaxLevel),
+                                   S2CellId::End(S2CellId::kMaxLevel)};
+  Iterator it = iter;
+  for (it.Begin(); !it.done(); it.Next()) {
+    targets.push_back(it.id());
+    targets.push_back(it.id().range_min());
+    targets.push_back(it.id().range_max().next());
+    if (!it.id().is_face()) targets.push_back(it.id().parent());
+  }
+  for (int i = 0; i < num_random; ++i) {
+    targets.push_back(S2Testing::GetRandomCellId());
+  }
+  std::sort(targets.begin(), targets.end());
+  std::vector<S2CellId> reversed(targets.rbegin(), targets.rend());
+  std::vector<S2CellId> shuffled = targets;
+  for (int i = static_cast<int>(shuffled.size()) - 1; i > 0; --i) {
+    std::swap(shuffled[i], shuffled[S2Testing::rnd.Uniform(i + 1)]);
+  }
+
+  for (const auto* order : {&targets, &reversed, &shuffled}) {
+    Iterator expected = iter, actual = iter;
+    actual.Finish();
+    for (S2CellId target : *order) {
+      expected.Seek(target);
+      actual.SeekNear(target);
+      ASSERT_EQ(expected.done(), actual.done()) << target;
+      if (!expected.done()) ASSERT_EQ(expected.id(), actual.id()) << target;
+    }
+    actual.Begin();
+    for (S2CellId target : *order) {
+      if (!target.is_valid()) continue;
+      EXPECT_EQ(expected.Locate(target), actual.LocateNear(target)) << target;
+      EXPECT_EQ(expected.Locate(target.ToPoint()),
+                actual.LocateNear(target.ToPoint()))
+          << target;
+      ASSERT_EQ(expected.done(), actual.done()) << target;
+      if (!expected.done()) EXPECT_EQ(expected.id(), actual.id()) << target;
+    }
+  }
+}
+
 #endif  // S2_S2CELL_ITERATOR_TESTING_H_
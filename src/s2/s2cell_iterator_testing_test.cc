@@ -22,6 +22,7 @@
 #include "absl/container/btree_map.h"
 #include "absl/strings/string_view.h"
 #include "s2/s2cell_id.h"
+#include "s2/s2testing.h"
 
 namespace {
 
@@ -82,4 +83,10 @@ TEST(MockIterator, BasicFunctionality) {
   EXPECT_THAT(iter.done(), IsTrue());
 }
 
+TEST(MockIterator, SeekNear) {
+  absl::btree_map<S2CellId, int> map;
+  for (int i = 0; i < 100; ++i) map[S2Testing::GetRandomCellId(10)] = i;
+  TestSeekNear(MakeMockS2CellIterator(&map));
+}
+
 }  // namespace
@@ -0,0 +1,120 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2cell_neighborhood.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "absl/log/absl_check.h"
+#include "absl/types/span.h"
+#include "s2/base/types.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
+
+using std::vector;
+
+namespace S2 {
+
+namespace {
+
+// Sorts "cells" and removes duplicates.
+void SortAndUnique(vector<S2CellId>* cells) {
+  std::sort(cells->begin(), cells->end());
+  cells->erase(std::unique(cells->begin(), cells->end()), cells->end());
+}
+
+// If the k-ring of "id" lies entirely within its face, appends it to
+// "output" in (i,j) order and returns true.  Otherwise returns false.
+bool AppendSameFaceKRing(S2CellId id, int k, vector<S2CellId>* output) {
+  int i, j;
+  const int face = id.ToFaceIJOrientation(&i, &j, nullptr);
+  const int level = id.level();
+  const int size = S2CellId::GetSizeIJ(level);
+  i &= -size;
+  j &= -size;
+
+  // Use 64-bit arithmetic so that large values of "k" cannot overflow.
+  const int64 reach = int64{k} * size;
+  if (i - reach < 0 || j - reach < 0 ||
+      i + size + reach > S2CellId::kMaxSize ||
+      j + size + reach > S2CellId::kMaxSize) {
+    return false;
+  }
+  const int imin = i - k * size, jmin = j - k * size;
+  const int n = 2 * k + 1;
+  for (int di = 0; di < n; ++di) {
+    for (int dj = 0; dj < n; ++dj) {
+      output->push_back(S2CellId::FromFaceIJ(face, imin + di * size,
+                                             jmin + dj * size).parent(level));
+    }
+  }
+  return true;
+}
+
+// Appends the k-ring of "id" to "output" by expanding it one step at a time.
+// This handles k-rings that cross face boundaries.  "output" is not sorted.
+void AppendExpandedKRing(S2CellId id, int k, vector<S2CellId>* output) {
+  const int level = id.level();
+  vector<S2CellId> visited = {id}, frontier = {id}, neighbors, merged;
+  for (int step = 0; step < k && !frontier.empty(); ++step) {
+    neighbors.clear();
+    for (S2CellId cell : frontier) cell.AppendAllNeighbors(level, &neighbors);
+    SortAndUnique(&neighbors);
+    frontier.clear();
+    std::set_difference(neighbors.begin(), neighbors.end(), visited.begin(),
+                        visited.end(), std::back_inserter(frontier));
+    merged.clear();
+    std::merge(visited.begin(), visited.end(), frontier.begin(),
+               frontier.end(), std::back_inserter(merged));
+    visited.swap(merged);
+  }
+  output->insert(output->end(), visited.begin(), visited.end());
+}
+
+void AppendKRing(S2CellId id, int k, vector<S2CellId>* output) {
+  ABSL_DCHECK(id.is_valid());
+  ABSL_DCHECK_GE(k, 0);
+  if (!AppendSameFaceKRing(id, k, output)) {
+    AppendExpandedKRing(id, k, output);
+  }
+}
+
+}  // namespace
+
+void GetKRing(S2CellId id, int k, vector<S2CellId>* output) {
+  output->clear();
+  AppendKRing(id, k, output);
+  // Cells generated in (i,j) order are distinct, but cells generated by
+  // expansion may not be.
+  SortAndUnique(output);
+}
+
+void GetKRings(absl::Span<const S2CellId> ids, int k,
+               vector<S2CellId>* output) {
+  output->clear();
+  for (S2CellId id : ids) AppendKRing(id, k, output);
+  SortAndUnique(output);
+}
+
+S2CellUnion GetKRingCellUnion(absl::Span<const S2CellId> ids, int k) {
+  vector<S2CellId> cells;
+  GetKRings(ids, k, &cells);
+  return S2CellUnion(std::move(cells));
+}
+
+}  // namespace S2
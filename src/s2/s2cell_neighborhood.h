@@ -0,0 +1,67 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Functions for enumerating the cells near a given S2CellId.
+//
+// The "k-ring" of a cell is the set of cells at the same level that can be
+// reached from it in at most "k" steps, where each step moves to a neighbor
+// as defined by S2CellId::AppendAllNeighbors() (i.e., including cells that
+// only share a vertex).  Within a single face this is the (2k+1)x(2k+1) block
+// of cells centered on the given cell.  Near face boundaries the block wraps
+// onto the adjacent faces, and near the 8 cube vertices (where only 3 cells
+// meet at a vertex) the k-ring contains fewer cells.
+//
+// Unlike repeatedly calling AppendAllNeighbors(), k-rings that lie within a
+// single face are computed directly in (i,j)-space without any intermediate
+// buffers, and only those that cross a face boundary need to be expanded one
+// step at a time.  Either way the cost is O(k^2) cells per center.
+
+#ifndef S2_S2CELL_NEIGHBORHOOD_H_
+#define S2_S2CELL_NEIGHBORHOOD_H_
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
+
+namespace S2 {
+
+// Sets "output" to the k-ring of "id" (see above), which includes "id"
+// itself.  The cells are sorted and distinct.  The previous contents of
+// "output" are discarded, but its capacity is reused.
+//
+// REQUIRES: k >= 0
+void GetKRing(S2CellId id, int k, std::vector<S2CellId>* output);
+
+// Sets "output" to the union of the k-rings of all the given cells, sorted
+// and with duplicates removed.  The cells need not all be at the same level,
+// in which case the output may contain cells that contain other cells (use
+// GetKRingCellUnion() to normalize the result).
+//
+// REQUIRES: k >= 0
+void GetKRings(absl::Span<const S2CellId> ids, int k,
+               std::vector<S2CellId>* output);
+
+// Returns the union of the k-rings of all the given cells as a normalized
+// S2CellUnion (i.e., groups of 4 sibling cells are replaced by their
+// parent).
+//
+// REQUIRES: k >= 0
+S2CellUnion GetKRingCellUnion(absl::Span<const S2CellId> ids, int k);
+
+}  // namespace S2
+
+#endif  // S2_S2CELL_NEIGHBORHOOD_H_
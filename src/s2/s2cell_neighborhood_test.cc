@@ -0,0 +1,120 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2cell_neighborhood.h"
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2testing.h"
+
+using std::set;
+using std::vector;
+
+namespace {
+
+// Computes the k-ring of "id" by brute force.
+vector<S2CellId> GetKRingBruteForce(S2CellId id, int k) {
+  set<S2CellId> result = {id};
+  for (int step = 0; step < k; ++step) {
+    vector<S2CellId> neighbors;
+    for (S2CellId cell : result) {
+      cell.AppendAllNeighbors(id.level(), &neighbors);
+    }
+    result.insert(neighbors.begin(), neighbors.end());
+  }
+  return vector<S2CellId>(result.begin(), result.end());
+}
+
+TEST(GetKRing, ZeroIsCellItself) {
+  S2CellId id = S2CellId::FromFacePosLevel(3, 0x12345678, 10);
+  vector<S2CellId> output = {S2CellId::FromFace(0)};
+  S2::GetKRing(id, 0, &output);
+  EXPECT_EQ(output, vector<S2CellId>{id});
+}
+
+TEST(GetKRing, InteriorCellIsSquareBlock) {
+  S2CellId id = S2CellId::FromFace(2).child_begin(10).advance(123456);
+  vector<S2CellId> output;
+  for (int k = 1; k <= 4; ++k) {
+    S2::GetKRing(id, k, &output);
+    EXPECT_EQ(output.size(), static_cast<size_t>((2 * k + 1) * (2 * k + 1)));
+    EXPECT_TRUE(std::is_sorted(output.begin(), output.end()));
+    EXPECT_EQ(output, GetKRingBruteForce(id, k));
+  }
+}
+
+TEST(GetKRing, MatchesBruteForceEverywhere) {
+  // Check every cell at a low level, so that many k-rings cross face
+  // boundaries and include cube vertices.
+  vector<S2CellId> output;
+  for (int level = 0; level <= 3; ++level) {
+    for (S2CellId id = S2CellId::Begin(level); id != S2CellId::End(level);
+         id = id.next()) {
+      for (int k = 0; k <= 3; ++k) {
+        S2::GetKRing(id, k, &output);
+        ASSERT_EQ(output, GetKRingBruteForce(id, k)) << id << " " << k;
+      }
+    }
+  }
+}
+
+TEST(GetKRing, MatchesBruteForceRandomCells) {
+  vector<S2CellId> output;
+  for (int iter = 0; iter < 200; ++iter) {
+    S2CellId id = S2Testing::GetRandomCellId();
+    int k = S2Testing::rnd.Uniform(4);
+    S2::GetKRing(id, k, &output);
+    ASSERT_EQ(output, GetKRingBruteForce(id, k)) << id << " " << k;
+  }
+}
+
+TEST(GetKRings, UnionOfKRings) {
+  S2CellId a = S2CellId::FromFace(1).child_begin(12).advance(5000);
+  S2CellId b = a.next().next();
+  S2CellId c = S2CellId::FromFace(5).child_begin(12);
+  vector<S2CellId> expected;
+  for (S2CellId id : {a, b, c}) {
+    vector<S2CellId> ring = GetKRingBruteForce(id, 2);
+    expected.insert(expected.end(), ring.begin(), ring.end());
+  }
+  std::sort(expected.begin(), expected.end());
+  expected.erase(std::unique(expected.begin(), expected.end()),
+                 expected.end());
+  vector<S2CellId> output;
+  S2::GetKRings({a, b, c}, 2, &output);
+  EXPECT_EQ(output, expected);
+
+  S2::GetKRings({}, 2, &output);
+  EXPECT_TRUE(output.empty());
+}
+
+TEST(GetKRingCellUnion, IsNormalized) {
+  // The 1-ring of a cell at level 10 includes all four children of some
+  // level 9 cells, which should be replaced by their parents.
+  S2CellId id = S2CellId::FromFace(0).child_begin(10).advance(1000);
+  S2CellUnion cell_union = S2::GetKRingCellUnion({id}, 3);
+  EXPECT_TRUE(cell_union.IsNormalized());
+  vector<S2CellId> ring;
+  S2::GetKRing(id, 3, &ring);
+  EXPECT_LT(cell_union.num_cells(), static_cast<int>(ring.size()));
+  EXPECT_EQ(cell_union, S2CellUnion(ring));
+}
+
+}  // namespace
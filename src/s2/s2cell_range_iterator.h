@@ -69,6 +69,7 @@ class S2CellRangeIterator final : public S2CellIterator {
   void Next() override;
   bool Prev() override;
   void Seek(S2CellId target) override;
+  void SeekNear(S2CellId target) override;
   void Finish() override;
   bool done() const override { return it_.done(); }
   bool Locate(const S2Point& target) override;
@@ -150,6 +151,13 @@ void S2CellRangeIterator<Iterator>::S2CellRangeIterator::Seek(S2CellId target) {
   Refresh();
 }
 
+template <typename Iterator>
+void S2CellRangeIterator<Iterator>::S2CellRangeIterator::SeekNear(
+    S2CellId target) {
+  it_.SeekNear(target);
+  Refresh();
+}
+
 template <typename Iterator>
 void S2CellRangeIterator<Iterator>::S2CellRangeIterator::Finish() {
   it_.Finish();
@@ -222,7 +230,9 @@ template <typename Iterator>
 template <typename T>
 void S2CellRangeIterator<Iterator>::SeekTo(
     const S2CellRangeIterator<T>& target) {
-  Seek(target.range_min());
+  // SeekTo() and SeekBeyond() are typically used to advance one iterator past
+  // another in a join, so the target is usually close to the current cell.
+  SeekNear(target.range_min());
 
   // If the current cell does not overlap "target", it is possible that the
   // previous cell is the one we are looking for.  This can only happen when
@@ -239,7 +249,7 @@ template <typename Iterator>
 template <typename T>
 void S2CellRangeIterator<Iterator>::SeekBeyond(
     const S2CellRangeIterator<T>& target) {
-  Seek(target.range_max().next());
+  SeekNear(target.range_max().next());
   if (!done() && range_min() <= target.range_max()) {
     Next();
   }
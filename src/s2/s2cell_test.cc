@@ -549,6 +549,41 @@ TEST(S2Cell, GetDistanceToPoint) {
   }
 }
 
+TEST(S2Cell, GetChildDistancesMatchesChildren) {
+  S2Testing::rnd.Reset(absl::GetFlag(FLAGS_s2_random_seed));
+  for (int iter = 0; iter < 2000; ++iter) {
+    SCOPED_TRACE(StrCat("Iteration ", iter));
+    S2CellId id = S2Testing::GetRandomCellId();
+    if (id.is_leaf()) id = id.parent();
+    S2Cell cell(id);
+    // Choose targets inside, near, and far from the cell (including points
+    // near the antipode, where the maximum distance is not at a vertex).
+    S2Point target;
+    switch (S2Testing::rnd.Uniform(3)) {
+      case 0:
+        target = S2Testing::RandomPoint();
+        break;
+      case 1:
+        target = S2Testing::SamplePoint(
+            S2Cap(cell.GetCenter(), 2 * cell.GetCapBound().GetRadius()));
+        break;
+      default:
+        target = -S2Testing::SamplePoint(
+            S2Cap(cell.GetCenter(), 2 * cell.GetCapBound().GetRadius()));
+        break;
+    }
+    S2Cell children[4];
+    ASSERT_TRUE(cell.Subdivide(children));
+    S1ChordAngle distances[4], max_distances[4];
+    cell.GetChildDistances(target, distances);
+    cell.GetChildMaxDistances(target, max_distances);
+    for (int k = 0; k < 4; ++k) {
+      EXPECT_EQ(distances[k], children[k].GetDistance(target));
+      EXPECT_EQ(max_distances[k], children[k].GetMaxDistance(target));
+    }
+  }
+}
+
 static void ChooseEdgeNearCell(const S2Cell& cell, S2Point* a, S2Point* b) {
   S2Cap cap = cell.GetCapBound();
   if (S2Testing::rnd.OneIn(5)) {
@@ -20,13 +20,18 @@
 #include <cstddef>
 
 #include <algorithm>
+#include <functional>
+#include <queue>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "absl/flags/flag.h"
 #include "absl/log/absl_check.h"
+#include "absl/numeric/bits.h"
 #include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
 
 #include "s2/base/commandlineflags.h"
 #include "s2/base/types.h"
@@ -39,6 +44,7 @@
 #include "s2/s2point.h"
 #include "s2/util/coding/coder.h"
 
+using absl::Span;
 using std::is_sorted;
 using std::max;
 using std::min;
@@ -138,6 +144,29 @@ inline static bool AreSiblings(S2CellId a, S2CellId b, S2CellId c, S2CellId d) {
           !d.is_face());
 }
 
+// Adds "id" to the normalized cells ids[0, out) and returns the new number
+// of cells.  This is the inner loop of Normalize().
+// REQUIRES: No cell in ids[0, out) is greater than "id".
+inline static size_t AddNormalized(S2CellId id, S2CellId* ids, size_t out) {
+  ABSL_DCHECK(id.is_valid()) << id;
+  // Check whether this cell is contained by the previous cell.
+  if (out > 0 && ids[out - 1].contains(id)) return out;
+
+  // Discard any previous cells contained by this cell.
+  while (out > 0 && id.contains(ids[out - 1])) --out;
+
+  // Check whether the last 3 elements plus "id" can be collapsed into a
+  // single parent cell.
+  while (out >= 3 &&
+         AreSiblings(ids[out - 3], ids[out - 2], ids[out - 1], id)) {
+    // Replace four children by their parent cell.
+    id = id.parent();
+    out -= 3;
+  }
+  ids[out++] = id;
+  return out;
+}
+
 bool S2CellUnion::IsValid() const {
   if (num_cells() > 0 && !cell_id(0).is_valid()) return false;
   for (int i = 1; i < num_cells(); ++i) {
@@ -171,22 +200,7 @@ void S2CellUnion::Normalize() {
   std::sort(ids->begin(), ids->end());
   size_t out = 0;
   for (S2CellId id : *ids) {
-    ABSL_DCHECK(id.is_valid()) << id;
-    // Check whether this cell is contained by the previous cell.
-    if (out > 0 && (*ids)[out-1].contains(id)) continue;
-
-    // Discard any previous cells contained by this cell.
-    while (out > 0 && id.contains((*ids)[out-1])) --out;
-
-    // Check whether the last 3 elements plus "id" can be collapsed into a
-    // single parent cell.
-    while (out >= 3 && AreSiblings((*ids)[out - 3], (*ids)[out - 2],
-                                   (*ids)[out - 1], id)) {
-      // Replace four children by their parent cell.
-      id = id.parent();
-      out -= 3;
-    }
-    (*ids)[out++] = id;
+    out = AddNormalized(id, ids->data(), out);
   }
   if (ids->size() != out)
     ids->resize(out);
@@ -197,6 +211,78 @@ void S2CellUnion::Denormalize(int min_level, int level_mod,
   Denormalize(cell_ids_, min_level, level_mod, out);
 }
 
+S2CellUnion::CellRange S2CellUnion::DenormalizedCells(int min_level,
+                                                      int level_mod) const {
+  return DenormalizedCells(cell_ids_, min_level, level_mod);
+}
+
+S2CellUnion::CellRange S2CellUnion::CellsAtLevel(int level) const {
+  return CellsAtLevel(cell_ids_, level);
+}
+
+S2CellUnion::CellRange S2CellUnion::DenormalizedCells(
+    Span<const S2CellId> in, int min_level, int level_mod) {
+  ABSL_DCHECK_GE(min_level, 0);
+  ABSL_DCHECK_LE(min_level, S2CellId::kMaxLevel);
+  ABSL_DCHECK_GE(level_mod, 1);
+  ABSL_DCHECK_LE(level_mod, 3);
+  return CellRange(in, min_level, level_mod, S2CellId::kMaxLevel);
+}
+
+S2CellUnion::CellRange S2CellUnion::CellsAtLevel(
+    Span<const S2CellId> in, int level) {
+  ABSL_DCHECK_GE(level, 0);
+  ABSL_DCHECK_LE(level, S2CellId::kMaxLevel);
+  return CellRange(in, level, 1, level);
+}
+
+int S2CellUnion::CellRange::GetOutputLevel(int level) const {
+  // This is the same computation as in Denormalize().
+  int new_level = max(min_level_, level);
+  if (level_mod_ > 1) {
+    new_level += (S2CellId::kMaxLevel - (new_level - min_level_)) % level_mod_;
+    new_level = min(S2CellId::kMaxLevel, new_level);
+  }
+  return min(max_level_, new_level);
+}
+
+S2CellUnion::CellRange::const_iterator::const_iterator(const CellRange* range,
+                                                       const S2CellId* pos)
+    : range_(range), pos_(pos) {
+  StartCell();
+}
+
+void S2CellUnion::CellRange::const_iterator::StartCell() {
+  if (pos_ == range_->cells_.end()) {
+    id_ = S2CellId::None();
+    return;
+  }
+  const int level = pos_->level();
+  const int new_level = range_->GetOutputLevel(level);
+  if (new_level >= level) {
+    id_ = pos_->child_begin(new_level);
+    end_ = pos_->child_end(new_level);
+  } else {
+    id_ = pos_->parent(new_level);
+    end_ = id_.next();
+  }
+}
+
+S2CellUnion::CellRange::const_iterator&
+S2CellUnion::CellRange::const_iterator::operator++() {
+  const S2CellId last = id_;
+  id_ = id_.next();
+  if (id_ != end_) return *this;
+
+  // Skip any further input cells that are contained by the last output cell
+  // (which happens only when it is an ancestor of the input cell).
+  do {
+    ++pos_;
+  } while (pos_ != range_->cells_.end() && last.contains(*pos_));
+  StartCell();
+  return *this;
+}
+
 void S2CellUnion::Denormalize(const vector<S2CellId>& in,
                               int min_level, int level_mod,
                               vector<S2CellId>* out) {
@@ -303,6 +389,95 @@ bool S2CellUnion::Intersects(S2CellId id) const {
   return i != end() && i->intersects(id);
 }
 
+namespace {
+
+// Builds a copy of the sorted vector "ids" in Eytzinger order, where the
+// children of the element at position "k" are at positions 2k and 2k+1 (and
+// position 0 is unused).  Returns the next position of "ids" to be copied.
+size_t BuildEytzinger(const vector<S2CellId>& ids, size_t i, size_t k,
+                      vector<S2CellId>* out) {
+  if (k < out->size()) {
+    i = BuildEytzinger(ids, i, 2 * k, out);
+    (*out)[k] = ids[i++];
+    i = BuildEytzinger(ids, i, 2 * k + 1, out);
+  }
+  return i;
+}
+
+// Sets "indices" to the positions "i" such that "test(cell, ids[i])" is
+// true, where "cell" is the first cell of "cell_ids" that does not entirely
+// precede ids[i] (or "test" is not called if there is no such cell).
+template <typename Test>
+void GetMatchingIndices(const vector<S2CellId>& cell_ids,
+                        Span<const S2CellId> ids, const Test& test,
+                        vector<int>* indices) {
+  indices->clear();
+  if (cell_ids.empty()) return;
+  const int n = ids.size();
+  if (std::is_sorted(ids.begin(), ids.end())) {
+    // Merge the two sorted sequences, skipping over runs of cells that
+    // precede the current id.  Since the ids may overlap, a large id may
+    // also intersect cells that were skipped for previous ids.  However in
+    // that case it also intersects the last skipped cell, so only the cell
+    // before "i" needs to be checked as well.
+    const auto begin = cell_ids.begin(), end = cell_ids.end();
+    auto i = begin;
+    for (int j = 0; j < n; ++j) {
+      S2CellId id = ids[j];
+      if (i != end && EntirelyPrecedes(*i, id)) {
+        i = std::lower_bound(i + 1, end, id, EntirelyPrecedes);
+      }
+      if ((i != end && test(*i, id)) || (i != begin && test(i[-1], id))) {
+        indices->push_back(j);
+      }
+    }
+    return;
+  }
+  // Building the Eytzinger layout takes time proportional to the size of
+  // the cell union, so it is only worthwhile for large batches.
+  constexpr int kMinIdsPerCell = 4;
+  if (n < kMinIdsPerCell * static_cast<int64>(cell_ids.size())) {
+    for (int j = 0; j < n; ++j) {
+      auto i = std::lower_bound(cell_ids.begin(), cell_ids.end(), ids[j],
+                                EntirelyPrecedes);
+      if (i != cell_ids.end() && test(*i, ids[j])) indices->push_back(j);
+    }
+    return;
+  }
+  vector<S2CellId> tree(cell_ids.size() + 1);
+  BuildEytzinger(cell_ids, 0, 1, &tree);
+  const size_t size = tree.size();
+  for (int j = 0; j < n; ++j) {
+    S2CellId id = ids[j];
+    size_t k = 1;
+    while (k < size) {
+      k = 2 * k + EntirelyPrecedes(tree[k], id);
+    }
+    // The path to the result went left for the last time at the lowest zero
+    // bit of "k".  If the path never went left then k == 0 after the shift,
+    // which means that every cell precedes "id".
+    k >>= absl::countr_zero(~k) + 1;
+    if (k != 0 && test(tree[k], id)) indices->push_back(j);
+  }
+}
+
+}  // namespace
+
+void S2CellUnion::GetContainedIndices(Span<const S2CellId> ids,
+                                      vector<int>* indices) const {
+  GetMatchingIndices(
+      cell_ids_, ids,
+      [](S2CellId cell, S2CellId id) { return cell.contains(id); }, indices);
+}
+
+void S2CellUnion::GetIntersectedIndices(Span<const S2CellId> ids,
+                                        vector<int>* indices) const {
+  GetMatchingIndices(
+      cell_ids_, ids,
+      [](S2CellId cell, S2CellId id) { return cell.intersects(id); },
+      indices);
+}
+
 bool S2CellUnion::Contains(const S2CellUnion& y) const {
   if (y.empty()) return true;
   if (empty()) return false;
@@ -372,6 +547,292 @@ S2CellUnion S2CellUnion::Intersection(const S2CellUnion& y) const {
   return result;
 }
 
+namespace {
+
+// A half-open range [begin, end) of leaf cells.
+struct LeafRange {
+  S2CellId begin, end;
+};
+
+// Appends to "out" the maximal ranges of leaf cells within [lo, hi) that are
+// covered by at least "k" of the given unions, in increasing order.
+//
+// This is a sweep over the endpoints of the input cells.  Each input has
+// exactly one pending endpoint in a priority queue (either the start or the
+// end of its current cell), so that the queue size is bounded by the number
+// of inputs.
+void GetCoveredRanges(Span<const S2CellUnion> unions, int k, S2CellId lo,
+                      S2CellId hi, vector<LeafRange>* out) {
+  struct Event {
+    S2CellId pos;
+    int input;
+    bool operator>(const Event& y) const { return pos > y.pos; }
+  };
+  std::priority_queue<Event, vector<Event>, std::greater<Event>> queue;
+  vector<int> next_cell(unions.size());
+  vector<bool> in_cell(unions.size(), false);
+  for (int i = 0; i < static_cast<int>(unions.size()); ++i) {
+    const vector<S2CellId>& ids = unions[i].cell_ids();
+    // Skip the cells that end before "lo".  Since the cells are disjoint,
+    // their range_max() values are also sorted.
+    auto it = std::lower_bound(
+        ids.begin(), ids.end(), lo,
+        [](S2CellId id, S2CellId target) { return id.range_max() < target; });
+    next_cell[i] = it - ids.begin();
+    if (it != ids.end() && it->range_min() < hi) {
+      queue.push(Event{max(it->range_min(), lo), i});
+    }
+  }
+  int depth = 0;
+  S2CellId begin;
+  while (!queue.empty()) {
+    // Process all the endpoints at the same position together, so that
+    // adjacent or coincident input cells do not split the output ranges.
+    const S2CellId pos = queue.top().pos;
+    const int old_depth = depth;
+    do {
+      const int i = queue.top().input;
+      queue.pop();
+      const vector<S2CellId>& ids = unions[i].cell_ids();
+      if (!in_cell[i]) {
+        ++depth;
+        in_cell[i] = true;
+        queue.push(Event{min(ids[next_cell[i]].range_max().next(), hi), i});
+      } else {
+        --depth;
+        in_cell[i] = false;
+        int next = ++next_cell[i];
+        if (next < static_cast<int>(ids.size()) &&
+            ids[next].range_min() < hi) {
+          queue.push(Event{ids[next].range_min(), i});
+        }
+      }
+    } while (!queue.empty() && queue.top().pos == pos);
+    if (old_depth < k && depth >= k) {
+      begin = pos;
+    } else if (old_depth >= k && depth < k) {
+      out->push_back(LeafRange{begin, pos});
+    }
+  }
+}
+
+// Dividing the S2CellId range into pieces smaller than this is not worth
+// starting a thread.
+constexpr size_t kMinCellsPerThread = 1 << 13;
+
+// The number of input cells sampled per piece when choosing the boundaries
+// between pieces.
+constexpr size_t kSamplesPerPiece = 64;
+
+// Returns the boundaries that divide the leaf cells into "num_pieces"
+// ranges containing roughly the same number of input cells.  The result has
+// num_pieces + 1 elements and is sorted.
+vector<S2CellId> GetPieceBounds(Span<const S2CellUnion> unions,
+                                size_t num_cells, int num_pieces) {
+  const size_t step = max<size_t>(1, num_cells /
+                                         (kSamplesPerPiece * num_pieces));
+  vector<S2CellId> samples;
+  for (const S2CellUnion& cell_union : unions) {
+    const vector<S2CellId>& ids = cell_union.cell_ids();
+    for (size_t j = 0; j < ids.size(); j += step) {
+      samples.push_back(ids[j].range_min());
+    }
+  }
+  std::sort(samples.begin(), samples.end());
+  vector<S2CellId> bounds;
+  bounds.push_back(S2CellId::Begin(S2CellId::kMaxLevel));
+  for (int i = 1; i < num_pieces; ++i) {
+    bounds.push_back(samples[samples.size() * i / num_pieces]);
+  }
+  bounds.push_back(S2CellId::End(S2CellId::kMaxLevel));
+  return bounds;
+}
+
+}  // namespace
+
+/*static*/ S2CellUnion S2CellUnion::CoveredByAtLeast(
+    Span<const S2CellUnion> unions, int k, int num_threads) {
+  ABSL_DCHECK_GE(k, 1);
+  size_t num_cells = 0;
+  for (const S2CellUnion& cell_union : unions) {
+    ABSL_DCHECK(cell_union.IsValid());
+    num_cells += cell_union.num_cells();
+  }
+  S2CellUnion result;
+  if (k > static_cast<int>(unions.size())) return result;
+
+  const int num_pieces = min<size_t>(
+      max(num_threads, 1), max<size_t>(num_cells / kMinCellsPerThread, 1));
+  vector<LeafRange> ranges;
+  if (num_pieces == 1) {
+    GetCoveredRanges(unions, k, S2CellId::Begin(S2CellId::kMaxLevel),
+                     S2CellId::End(S2CellId::kMaxLevel), &ranges);
+  } else {
+    vector<S2CellId> bounds = GetPieceBounds(unions, num_cells, num_pieces);
+    vector<vector<LeafRange>> pieces(num_pieces);
+    vector<std::thread> threads;
+    for (int i = 0; i < num_pieces; ++i) {
+      threads.emplace_back([&unions, k, &bounds, &pieces, i]() {
+        GetCoveredRanges(unions, k, bounds[i], bounds[i + 1], &pieces[i]);
+      });
+    }
+    for (auto& thread : threads) thread.join();
+
+    // Ranges that meet at a piece boundary are joined together.
+    for (const vector<LeafRange>& piece : pieces) {
+      for (const LeafRange& range : piece) {
+        if (!ranges.empty() && ranges.back().end == range.begin) {
+          ranges.back().end = range.end;
+        } else {
+          ranges.push_back(range);
+        }
+      }
+    }
+  }
+  // Since the ranges are maximal, they are separated by gaps and the cells
+  // used to tile them form a normalized union.
+  for (const LeafRange& range : ranges) {
+    for (S2CellId id = range.begin.maximum_tile(range.end); id != range.end;
+         id = id.next().maximum_tile(range.end)) {
+      result.cell_ids_.push_back(id);
+    }
+  }
+  ABSL_DCHECK(result.IsNormalized());
+  return result;
+}
+
+/*static*/ S2CellUnion S2CellUnion::UnionAll(Span<const S2CellUnion> unions,
+                                             int num_threads) {
+  return CoveredByAtLeast(unions, 1, num_threads);
+}
+
+/*static*/ S2CellUnion S2CellUnion::IntersectionAll(
+    Span<const S2CellUnion> unions, int num_threads) {
+  if (unions.empty()) return S2CellUnion();
+  return CoveredByAtLeast(unions, unions.size(), num_threads);
+}
+
+namespace {
+
+// Calls fn(i) for each i in [0, n), using one thread per call.
+template <class Fn>
+void ParallelFor(int n, const Fn& fn) {
+  vector<std::thread> threads;
+  for (int i = 0; i < n; ++i) {
+    threads.emplace_back([&fn, i]() { fn(i); });
+  }
+  for (auto& thread : threads) thread.join();
+}
+
+}  // namespace
+
+/*static*/ S2CellUnion S2CellUnion::FromUnsortedParallel(
+    vector<S2CellId> cell_ids, int num_threads) {
+  const size_t n = cell_ids.size();
+  const int num_pieces = min<size_t>(
+      max(num_threads, 1), max<size_t>(n / kMinCellsPerThread, 1));
+  if (num_pieces == 1) return S2CellUnion(std::move(cell_ids));
+
+  // Divide the S2CellId range into pieces containing roughly the same number
+  // of input cells, using a sample of the input to choose the boundaries.
+  const size_t step = max<size_t>(1, n / (kSamplesPerPiece * num_pieces));
+  vector<S2CellId> samples;
+  for (size_t i = 0; i < n; i += step) samples.push_back(cell_ids[i]);
+  std::sort(samples.begin(), samples.end());
+  vector<S2CellId> splitters;
+  for (int i = 1; i < num_pieces; ++i) {
+    splitters.push_back(samples[samples.size() * i / num_pieces]);
+  }
+  auto get_piece = [&splitters](S2CellId id) {
+    return static_cast<int>(
+        std::upper_bound(splitters.begin(), splitters.end(), id) -
+        splitters.begin());
+  };
+
+  // Each thread counts the cells of one chunk of the input that belong to
+  // each piece, and then copies them to the positions reserved for them.
+  // counts[t][p] is converted from the number of cells of chunk "t" in piece
+  // "p" to the position of the first of those cells in "ids".
+  auto chunk_begin = [n, num_pieces](int t) { return n * t / num_pieces; };
+  vector<vector<size_t>> counts(num_pieces, vector<size_t>(num_pieces));
+  ParallelFor(num_pieces, [&](int t) {
+    for (size_t i = chunk_begin(t); i < chunk_begin(t + 1); ++i) {
+      ++counts[t][get_piece(cell_ids[i])];
+    }
+  });
+  vector<size_t> piece_begin(num_pieces);
+  size_t pos = 0;
+  for (int p = 0; p < num_pieces; ++p) {
+    piece_begin[p] = pos;
+    for (int t = 0; t < num_pieces; ++t) {
+      const size_t count = counts[t][p];
+      counts[t][p] = pos;
+      pos += count;
+    }
+  }
+  vector<S2CellId> ids(n);
+  ParallelFor(num_pieces, [&](int t) {
+    for (size_t i = chunk_begin(t); i < chunk_begin(t + 1); ++i) {
+      const S2CellId id = cell_ids[i];
+      ids[counts[t][get_piece(id)]++] = id;
+    }
+  });
+  vector<S2CellId>().swap(cell_ids);
+
+  // Sort and normalize each piece in place.
+  vector<size_t> piece_size(num_pieces);
+  ParallelFor(num_pieces, [&](int p) {
+    S2CellId* begin = ids.data() + piece_begin[p];
+    S2CellId* end = ids.data() + (p + 1 < num_pieces ? piece_begin[p + 1] : n);
+    std::sort(begin, end);
+    size_t out = 0;
+    for (const S2CellId* id = begin; id != end; ++id) {
+      out = AddNormalized(*id, begin, out);
+    }
+    piece_size[p] = out;
+  });
+
+  // Concatenate the normalized pieces.  Since every cell of a piece is
+  // greater than or equal to the cells of the previous pieces, only the cells
+  // near the start of each piece need to be merged with the result so far.
+  size_t out = 0;
+  for (int p = 0; p < num_pieces; ++p) {
+    const S2CellId* piece = ids.data() + piece_begin[p];
+    const size_t size = piece_size[p];
+    size_t i = 0;
+    if (out > 0) {
+      // Skip the cells contained by the last cell so far.  These form a
+      // prefix of the piece, unless the first cell of the piece contains the
+      // last cell instead.
+      const S2CellId last = ids[out - 1];
+      i = std::upper_bound(piece, piece + size, last.range_max(),
+                           [](S2CellId max_id, S2CellId id) {
+                             return max_id < id.range_min();
+                           }) - piece;
+      if (i > 0 && !last.contains(piece[0])) i = 0;
+    }
+    // A cell can only be merged with the result so far if the leaf cells
+    // between them are covered, so we can stop at the first gap between the
+    // cells of the piece.  (A normalized union has O(S2CellId::kMaxLevel)
+    // cells without gaps between them.)
+    for (S2CellId prev = S2CellId::None(); i < size; ++i) {
+      const S2CellId id = piece[i];
+      if (prev != S2CellId::None() &&
+          id.range_min() != prev.range_max().next()) {
+        break;
+      }
+      out = AddNormalized(id, ids.data(), out);
+      prev = id;
+    }
+    if (ids.data() + out != piece + i) {
+      std::copy(piece + i, piece + size, ids.data() + out);
+    }
+    out += size - i;
+  }
+  ids.resize(out);
+  return FromNormalized(std::move(ids));
+}
+
 /*static*/ void S2CellUnion::GetIntersection(const vector<S2CellId>& x,
                                              const vector<S2CellId>& y,
                                              vector<S2CellId>* out) {
@@ -19,6 +19,7 @@
 #define S2_S2CELL_UNION_H_
 
 #include <cstddef>
+#include <iterator>
 #include <ostream>
 #include <string>
 #include <utility>
@@ -29,6 +30,7 @@
 #include "absl/flags/flag.h"
 #include "absl/hash/hash.h"
 #include "absl/log/absl_check.h"
+#include "absl/types/span.h"
 
 #include "s2/_fp_contract_off.h"
 #include "s2/base/commandlineflags.h"
@@ -91,6 +93,9 @@ class S2CellUnion final : public S2Region {
     void Seek(S2CellId target) override;
     bool Locate(const S2Point& target) override;
     S2CellRelation Locate(S2CellId target) override;
+    void SeekNear(S2CellId target) override;
+    bool LocateNear(const S2Point& target) override;
+    S2CellRelation LocateNear(S2CellId target) override;
 
    private:
     const S2CellUnion* cell_union_ = nullptr;
@@ -116,6 +121,13 @@ class S2CellUnion final : public S2Region {
   // unlike the constructor above, this one makes a copy of "cell_ids".
   explicit S2CellUnion(const std::vector<uint64>& cell_ids);
 
+  // Like the constructor above, but sorts and normalizes "cell_ids" using up
+  // to "num_threads" threads when the input is large enough to make this
+  // worthwhile (e.g., a level-20 covering of a country).  The result does not
+  // depend on num_threads.
+  static S2CellUnion FromUnsortedParallel(std::vector<S2CellId> cell_ids,
+                                          int num_threads);
+
   // Constructs a cell union for the whole sphere.
   static S2CellUnion WholeSphere();
 
@@ -221,6 +233,25 @@ class S2CellUnion final : public S2Region {
   void Denormalize(int min_level, int level_mod,
                    std::vector<S2CellId>* output) const;
 
+  // A forward range over S2CellIds that are generated on the fly from the
+  // cells of a union (see DenormalizedCells and CellsAtLevel below).  The
+  // range refers to the underlying cells, which must outlive it.
+  class CellRange;
+
+  // Like Denormalize(), but returns a range that generates the output cells
+  // as it is iterated rather than storing them.  This is useful when the
+  // output is large and is consumed only once (e.g., when enumerating index
+  // terms or key ranges for fine cell levels):
+  //
+  //   for (S2CellId id : cell_union.DenormalizedCells(min_level, 1)) { ... }
+  CellRange DenormalizedCells(int min_level, int level_mod) const;
+
+  // Returns a range over all cells at the given level that intersect the
+  // union, in increasing order.  Cells of the union that are larger than
+  // "level" are replaced by their descendants at that level, and cells that
+  // are smaller are replaced by their ancestor (which is returned once).
+  CellRange CellsAtLevel(int level) const;
+
   // If there are more than "excess" elements of the cell_ids() vector that
   // are allocated but unused, reallocates the array to eliminate the excess
   // space.  This reduces memory usage when many cell unions need to be held
@@ -241,6 +272,21 @@ class S2CellUnion final : public S2Region {
   // This is a fast operation (logarithmic in the size of the cell union).
   bool Intersects(S2CellId id) const;
 
+  // Sets "indices" to the positions "i" such that Contains(ids[i]) is true,
+  // in increasing order.  This is equivalent to calling Contains() for each
+  // id, but is much faster when testing many ids (e.g., filtering a stream
+  // of point cell ids against a geofence).  If "ids" is sorted, it is merged
+  // with the cell union in a single pass.  Otherwise each id is located
+  // using a copy of the cell union in Eytzinger (breadth-first) order, which
+  // makes better use of the cache than binary search.
+  void GetContainedIndices(absl::Span<const S2CellId> ids,
+                           std::vector<int>* indices) const;
+
+  // Like GetContainedIndices(), but returns the positions "i" such that
+  // Intersects(ids[i]) is true.
+  void GetIntersectedIndices(absl::Span<const S2CellId> ids,
+                             std::vector<int>* indices) const;
+
   // Returns true if this cell union contains the given other cell union.
   //
   // CAVEAT: If you have constructed a non-normalized S2CellUnion using
@@ -266,6 +312,34 @@ class S2CellUnion final : public S2Region {
   // Returns the difference of the two given cell unions.
   S2CellUnion Difference(const S2CellUnion& y) const;
 
+  // Returns the region covered by at least "k" of the given cell unions.
+  // This is computed by a single k-way merge over all the inputs, which
+  // takes O(n log m) time for "m" inputs with a total of "n" cells, rather
+  // than the O(n m) time needed to combine the inputs one at a time.  For
+  // example, this can be used to find the parts of a tile that are covered
+  // by at least 3 of a collection of coverings.
+  //
+  // If num_threads > 1 and the inputs are large enough to make it
+  // worthwhile, the S2CellId range is divided into pieces that are merged
+  // concurrently.  The result does not depend on num_threads.
+  //
+  // REQUIRES: k >= 1
+  // REQUIRES: Each input is valid (see IsValid).  The inputs do not need to
+  //           be normalized, but the result always is.
+  static S2CellUnion CoveredByAtLeast(absl::Span<const S2CellUnion> unions,
+                                      int k, int num_threads = 1);
+
+  // Returns the union of all the given cell unions.  Equivalent to
+  // CoveredByAtLeast(unions, 1, num_threads).
+  static S2CellUnion UnionAll(absl::Span<const S2CellUnion> unions,
+                              int num_threads = 1);
+
+  // Returns the intersection of all the given cell unions, or an empty cell
+  // union if "unions" is empty.  Equivalent to
+  // CoveredByAtLeast(unions, unions.size(), num_threads).
+  static S2CellUnion IntersectionAll(absl::Span<const S2CellUnion> unions,
+                                     int num_threads = 1);
+
   // Expands the cell union by adding a buffer of cells at "expand_level"
   // around the union boundary.
   //
@@ -371,6 +445,13 @@ class S2CellUnion final : public S2Region {
                           int min_level, int level_mod,
                           std::vector<S2CellId>* out);
 
+  // Like DenormalizedCells() and CellsAtLevel(), but work with a sequence of
+  // S2CellIds.
+  // REQUIRES: "in" is sorted and non-overlapping.
+  static CellRange DenormalizedCells(absl::Span<const S2CellId> in,
+                                     int min_level, int level_mod);
+  static CellRange CellsAtLevel(absl::Span<const S2CellId> in, int level);
+
   // Like GetIntersection(), but works directly with vectors of S2CellIds,
   // Equivalent to:
   //
@@ -404,6 +485,67 @@ class S2CellUnion final : public S2Region {
 };
 
 
+class S2CellUnion::CellRange {
+ public:
+  class const_iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = S2CellId;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const S2CellId*;
+    using reference = const S2CellId&;
+
+    const_iterator() = default;
+
+    reference operator*() const { return id_; }
+    pointer operator->() const { return &id_; }
+    const_iterator& operator++();
+    const_iterator operator++(int) {
+      const_iterator result = *this;
+      ++*this;
+      return result;
+    }
+
+    friend bool operator==(const const_iterator& x, const const_iterator& y) {
+      return x.pos_ == y.pos_ && x.id_ == y.id_;
+    }
+    friend bool operator!=(const const_iterator& x, const const_iterator& y) {
+      return !(x == y);
+    }
+
+   private:
+    friend class CellRange;
+    const_iterator(const CellRange* range, const S2CellId* pos);
+
+    // Positions the iterator at the first output cell for *pos_.
+    void StartCell();
+
+    const CellRange* range_ = nullptr;
+    const S2CellId* pos_ = nullptr;
+
+    // The current output cell, and the end of the output cells for *pos_.
+    S2CellId id_, end_;
+  };
+  using iterator = const_iterator;
+
+  const_iterator begin() const { return const_iterator(this, cells_.begin()); }
+  const_iterator end() const { return const_iterator(this, cells_.end()); }
+
+ private:
+  friend class S2CellUnion;
+  CellRange(absl::Span<const S2CellId> cells, int min_level, int level_mod,
+            int max_level)
+      : cells_(cells), min_level_(min_level), level_mod_(level_mod),
+        max_level_(max_level) {}
+
+  // Returns the level of the output cells for an input cell at "level".
+  int GetOutputLevel(int level) const;
+
+  absl::Span<const S2CellId> cells_;
+  int min_level_, level_mod_, max_level_;
+};
+
+
 //////////////////   Implementation details follow   ////////////////////
 
 
@@ -505,4 +647,21 @@ inline S2CellRelation S2CellUnion::Iterator::Locate(S2CellId target) {
   return LocateImpl(*this, target);
 }
 
+inline void S2CellUnion::Iterator::SeekNear(S2CellId target) {
+  ABSL_DCHECK_NE(cell_union_, nullptr);
+  const std::vector<S2CellId>& ids = cell_union_->cell_ids_;
+  int pos = GallopLowerBound(static_cast<int>(iter_ - ids.begin()),
+                             static_cast<int>(ids.size()), target,
+                             [&ids](int i) { return ids[i]; });
+  iter_ = ids.begin() + pos;
+}
+
+inline bool S2CellUnion::Iterator::LocateNear(const S2Point& target) {
+  return LocateNearImpl(*this, target);
+}
+
+inline S2CellRelation S2CellUnion::Iterator::LocateNear(S2CellId target) {
+  return LocateNearImpl(*this, target);
+}
+
 #endif  // S2_S2CELL_UNION_H_
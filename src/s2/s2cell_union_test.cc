@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <random>
 #include <string>
 #include <utility>
 #include <vector>
@@ -38,6 +39,7 @@
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_iterator_join.h"
+#include "s2/s2cell_iterator_testing.h"
 #include "s2/s2coder_testing.h"
 #include "s2/s2edge_distances.h"
 #include "s2/s2error.h"
@@ -413,6 +415,138 @@ TEST(S2CellUnion, DifferenceInclusionExclusion) {
   }
 }
 
+// Returns the number of the given unions that contain "id".
+static int CountContaining(const vector<S2CellUnion>& unions, S2CellId id) {
+  int count = 0;
+  for (const S2CellUnion& cell_union : unions) {
+    count += cell_union.Contains(id);
+  }
+  return count;
+}
+
+TEST(S2CellUnion, CoveredByAtLeastMatchesCounts) {
+  const int num_iters = absl::GetFlag(FLAGS_iters);
+  for (int iter = 0; iter < num_iters; ++iter) {
+    vector<S2CellUnion> unions;
+    for (int i = 0; i < 5; ++i) {
+      vector<S2CellId> input;
+      AddCells(S2CellId::None(), /*selected=*/false, &input,
+               /*expected=*/nullptr);
+      unions.emplace_back(std::move(input));
+    }
+    // The coverage depth can only change at the endpoints of input cells, so
+    // it is enough to test the leaf cells at and around those endpoints.
+    vector<S2CellId> probes;
+    for (const S2CellUnion& cell_union : unions) {
+      for (S2CellId id : cell_union) {
+        probes.push_back(id.range_min());
+        probes.push_back(id.range_max());
+        if (id.range_min() != S2CellId::Begin(S2CellId::kMaxLevel)) {
+          probes.push_back(id.range_min().prev());
+        }
+        if (id.range_max().next().is_valid()) {
+          probes.push_back(id.range_max().next());
+        }
+      }
+    }
+    for (int k = 1; k <= 6; ++k) {
+      S2CellUnion result = S2CellUnion::CoveredByAtLeast(unions, k);
+      EXPECT_TRUE(result.IsNormalized());
+      for (S2CellId probe : probes) {
+        ASSERT_EQ(CountContaining(unions, probe) >= k, result.Contains(probe))
+            << "k=" << k << ", probe=" << probe;
+      }
+    }
+    S2CellUnion expected_union = unions[0];
+    S2CellUnion expected_intersection = unions[0];
+    for (int i = 1; i < unions.size(); ++i) {
+      expected_union = expected_union.Union(unions[i]);
+      expected_intersection = expected_intersection.Intersection(unions[i]);
+    }
+    EXPECT_EQ(expected_union, S2CellUnion::UnionAll(unions));
+    EXPECT_EQ(expected_intersection, S2CellUnion::IntersectionAll(unions));
+  }
+}
+
+TEST(S2CellUnion, CoveredByAtLeastEmptyInputs) {
+  vector<S2CellUnion> unions;
+  EXPECT_TRUE(S2CellUnion::UnionAll(unions).empty());
+  EXPECT_TRUE(S2CellUnion::IntersectionAll(unions).empty());
+  unions.push_back(S2CellUnion::WholeSphere());
+  unions.push_back(S2CellUnion());
+  EXPECT_EQ(S2CellUnion::WholeSphere(), S2CellUnion::UnionAll(unions));
+  EXPECT_TRUE(S2CellUnion::IntersectionAll(unions).empty());
+  EXPECT_TRUE(S2CellUnion::CoveredByAtLeast(unions, 3).empty());
+}
+
+TEST(S2CellUnion, CoveredByAtLeastThreadsMatchSerial) {
+  // Use enough cells that the inputs are divided among several threads.
+  vector<S2CellUnion> unions;
+  for (int i = 0; i < 20; ++i) {
+    vector<S2CellId> ids;
+    for (int j = 0; j < 3000; ++j) {
+      ids.push_back(S2Testing::GetRandomCellId(8 + rnd.Uniform(6)));
+    }
+    unions.emplace_back(std::move(ids));
+  }
+  for (int k : {1, 2, 5, 20}) {
+    S2CellUnion serial = S2CellUnion::CoveredByAtLeast(unions, k);
+    EXPECT_EQ(serial, S2CellUnion::CoveredByAtLeast(unions, k, 4)) << k;
+    EXPECT_EQ(serial, S2CellUnion::CoveredByAtLeast(unions, k, 3)) << k;
+  }
+  S2CellUnion expected = unions[0];
+  for (int i = 1; i < unions.size(); ++i) {
+    expected = expected.Union(unions[i]);
+  }
+  EXPECT_EQ(expected, S2CellUnion::UnionAll(unions, 4));
+}
+
+// Checks GetContainedIndices() and GetIntersectedIndices() against
+// Contains() and Intersects().
+static void TestBatchMembership(const S2CellUnion& cell_union,
+                                const vector<S2CellId>& ids) {
+  vector<int> expected_contained, expected_intersected;
+  for (int i = 0; i < ids.size(); ++i) {
+    if (cell_union.Contains(ids[i])) expected_contained.push_back(i);
+    if (cell_union.Intersects(ids[i])) expected_intersected.push_back(i);
+  }
+  vector<int> indices = {-1};
+  cell_union.GetContainedIndices(ids, &indices);
+  EXPECT_EQ(expected_contained, indices);
+  cell_union.GetIntersectedIndices(ids, &indices);
+  EXPECT_EQ(expected_intersected, indices);
+}
+
+TEST(S2CellUnion, BatchMembershipMatchesContainsAndIntersects) {
+  const int num_iters = absl::GetFlag(FLAGS_iters);
+  for (int iter = 0; iter < num_iters; ++iter) {
+    vector<S2CellId> input;
+    AddCells(S2CellId::None(), /*selected=*/false, &input,
+             /*expected=*/nullptr);
+    S2CellUnion cell_union(std::move(input));
+
+    // Test leaf cells (like points) and larger cells, some of which are
+    // inside the union, in both sorted and unsorted order.  Both the small
+    // and large batches are tested since they use different algorithms for
+    // unsorted input.
+    for (int num_ids : {3, 10 * cell_union.num_cells()}) {
+      vector<S2CellId> ids;
+      for (int i = 0; i < num_ids; ++i) {
+        S2CellId id = rnd.OneIn(2) || cell_union.empty()
+                          ? S2Testing::GetRandomCellId()
+                          : cell_union.cell_id(rnd.Uniform(cell_union.size()));
+        ids.push_back(rnd.OneIn(2) ? id.child_begin(S2CellId::kMaxLevel)
+                                   : id.parent(rnd.Uniform(id.level() + 1)));
+      }
+      TestBatchMembership(cell_union, ids);
+      std::sort(ids.begin(), ids.end());
+      TestBatchMembership(cell_union, ids);
+    }
+  }
+  TestBatchMembership(S2CellUnion(), {S2CellId::FromFace(1)});
+  TestBatchMembership(S2CellUnion::WholeSphere(), {});
+}
+
 TEST(S2CellUnion, ContainsIntersectsBruteForce) {
   const int num_iters = absl::GetFlag(FLAGS_iters);
   for (int i = 0; i < num_iters; ++i) {
@@ -789,6 +923,77 @@ TEST(S2CellUnion, ToStringTwoCells) {
       "Size:2 S2CellIds:3,5");
 }
 
+// Returns a random cell union whose cells are at levels 5 to 15.
+S2CellUnion GetRandomCellUnion() {
+  vector<S2CellId> ids;
+  for (int n = S2Testing::rnd.Uniform(20); n > 0; --n) {
+    ids.push_back(S2Testing::GetRandomCellId(5 + S2Testing::rnd.Uniform(11)));
+  }
+  return S2CellUnion(std::move(ids));
+}
+
+TEST(S2CellUnion, DenormalizedCellsMatchesDenormalize) {
+  for (int iter = 0; iter < 200; ++iter) {
+    S2CellUnion cell_union = GetRandomCellUnion();
+    int min_level = S2Testing::rnd.Uniform(11);
+    int level_mod = 1 + S2Testing::rnd.Uniform(3);
+    vector<S2CellId> expected;
+    cell_union.Denormalize(min_level, level_mod, &expected);
+    auto range = cell_union.DenormalizedCells(min_level, level_mod);
+    EXPECT_EQ(vector<S2CellId>(range.begin(), range.end()), expected);
+  }
+}
+
+TEST(S2CellUnion, CellsAtLevel) {
+  for (int iter = 0; iter < 200; ++iter) {
+    S2CellUnion cell_union = GetRandomCellUnion();
+    int level = S2Testing::rnd.Uniform(13);
+    vector<S2CellId> expected;
+    for (S2CellId id : cell_union) {
+      if (id.level() > level) {
+        expected.push_back(id.parent(level));
+      } else {
+        for (S2CellId child = id.child_begin(level);
+             child != id.child_end(level); child = child.next()) {
+          expected.push_back(child);
+        }
+      }
+    }
+    expected.erase(std::unique(expected.begin(), expected.end()),
+                   expected.end());
+    auto range = cell_union.CellsAtLevel(level);
+    EXPECT_EQ(vector<S2CellId>(range.begin(), range.end()), expected);
+  }
+  const S2CellUnion empty;
+  auto range = empty.CellsAtLevel(10);
+  EXPECT_TRUE(range.begin() == range.end());
+}
+
+TEST(S2CellUnion, FromUnsortedParallel) {
+  for (int iter = 0; iter < 10; ++iter) {
+    // Combine the cells of denormalized unions (which contain many groups of
+    // siblings) with random cells, some of which contain other input cells,
+    // so that cells need to be merged across the boundaries between pieces.
+    vector<S2CellId> ids;
+    for (int i = 0; i < 20; ++i) {
+      vector<S2CellId> cells;
+      GetRandomCellUnion().Denormalize(9, 1, &cells);
+      ids.insert(ids.end(), cells.begin(), cells.end());
+    }
+    for (int i = 0; i < 60000; ++i) {
+      ids.push_back(S2Testing::GetRandomCellId(S2Testing::rnd.Uniform(20)));
+    }
+    for (int i = 0; i < 1000; ++i) ids.push_back(ids[i].parent(7));
+    std::shuffle(ids.begin(), ids.end(), std::mt19937_64(iter));
+
+    const S2CellUnion expected(ids);
+    for (int num_threads : {1, 2, 3, 8}) {
+      EXPECT_EQ(S2CellUnion::FromUnsortedParallel(ids, num_threads),
+                expected);
+    }
+  }
+}
+
 TEST(S2CellUnion, ToStringOver500Cells) {
   vector<S2CellId> ids;
   S2CellUnion({S2CellId::FromFace(1)}).Denormalize(6, 1, &ids);  // 4096 cells
@@ -842,3 +1047,12 @@ TEST(S2CellUnion, IteratorWorks) {
   EXPECT_THAT(iter.id(), Eq(S2CellId::FromFace(0)));
 }
 
+TEST(S2CellUnion, IteratorSeekNear) {
+  vector<S2CellId> ids;
+  for (int i = 0; i < 200; ++i) ids.push_back(S2Testing::GetRandomCellId());
+  S2CellUnion cell_union(std::move(ids));
+  S2CellUnion complement = S2CellUnion::WholeSphere().Difference(cell_union);
+  TestSeekNear(S2CellUnion::Iterator(&cell_union));
+  TestSeekNear(S2CellUnion::Iterator(&complement));
+}
+
@@ -30,6 +30,13 @@ S2Point PlanarCentroid(const S2Point& a, const S2Point& b, const S2Point& c) {
 }
 
 S2Point TrueCentroid(const S2Point& a, const S2Point& b, const S2Point& c) {
+  // Use Angle() in order to get accurate results for small triangles.
+  return internal::TrueCentroid(a, b, c, b.Angle(c), c.Angle(a), a.Angle(b));
+}
+
+S2Point internal::TrueCentroid(const S2Point& a, const S2Point& b,
+                               const S2Point& c, double angle_a,
+                               double angle_b, double angle_c) {
   ABSL_DCHECK(IsUnitLength(a));
   ABSL_DCHECK(IsUnitLength(b));
   ABSL_DCHECK(IsUnitLength(c));
@@ -37,11 +44,6 @@ S2Point TrueCentroid(const S2Point& a, const S2Point& b, const S2Point& c) {
   // I couldn't find any references for computing the true centroid of a
   // spherical triangle...  I have a truly marvellous demonstration of this
   // formula which this margin is too narrow to contain :)
-
-  // Use Angle() in order to get accurate results for small triangles.
-  double angle_a = b.Angle(c);
-  double angle_b = c.Angle(a);
-  double angle_c = a.Angle(b);
   double ra = (angle_a == 0) ? 1 : (angle_a / std::sin(angle_a));
   double rb = (angle_b == 0) ? 1 : (angle_b / std::sin(angle_b));
   double rc = (angle_c == 0) ? 1 : (angle_c / std::sin(angle_c));
@@ -82,6 +82,17 @@ S2Point TrueCentroid(const S2Point& a, const S2Point& b, const S2Point& c);
 // if the edge is degenerate (and that this is intended behavior).
 S2Point TrueCentroid(const S2Point& a, const S2Point& b);
 
+namespace internal {
+
+// Like TrueCentroid(a, b, c), but takes the side lengths of the triangle as
+// computed by b.Angle(c), c.Angle(a), and a.Angle(b).  This allows callers
+// that sum over many triangles with shared edges (such as triangle fans) to
+// compute the length of each edge only once.  The result is identical to
+// TrueCentroid(a, b, c).
+S2Point TrueCentroid(const S2Point& a, const S2Point& b, const S2Point& c,
+                     double angle_a, double angle_b, double angle_c);
+
+}  // namespace internal
 }  // namespace S2
 
 #endif  // S2_S2CENTROIDS_H_
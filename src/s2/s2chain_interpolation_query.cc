@@ -16,14 +16,60 @@
 #include "s2/s2chain_interpolation_query.h"
 
 #include <algorithm>
+#include <memory>
 #include <vector>
 
 #include "absl/log/absl_check.h"
+#include "absl/types/span.h"
+#include "s2/mutable_s2shape_index.h"
 #include "s2/s1angle.h"
+#include "s2/s1chord_angle.h"
+#include "s2/s2closest_edge_query.h"
 #include "s2/s2edge_distances.h"
 #include "s2/s2point.h"
 #include "s2/s2shape.h"
 
+using absl::Span;
+using std::make_shared;
+using std::make_unique;
+using std::vector;
+
+// Projections onto chains with at most this many edges are computed by brute
+// force rather than using an index.
+static constexpr int kMaxBruteForceProjectionEdges = 32;
+
+// A shape consisting of the edges being interpolated, as a collection of
+// single-edge chains.  Edge "i" of this shape is edge "first_edge_id + i" of
+// the underlying shape.
+class S2ChainInterpolationQuery::EdgeRangeShape final : public S2Shape {
+ public:
+  EdgeRangeShape(const S2Shape* shape, int first_edge_id, int num_edges)
+      : shape_(shape), first_edge_id_(first_edge_id), num_edges_(num_edges) {}
+
+  int num_edges() const override { return num_edges_; }
+  Edge edge(int edge_id) const override {
+    return shape_->edge(first_edge_id_ + edge_id);
+  }
+  int dimension() const override { return 1; }
+  ReferencePoint GetReferencePoint() const override {
+    return ReferencePoint::Contained(false);
+  }
+  int num_chains() const override { return num_edges_; }
+  Chain chain(int chain_id) const override { return Chain(chain_id, 1); }
+  Edge chain_edge(int chain_id, int offset) const override {
+    ABSL_DCHECK_EQ(offset, 0);
+    return edge(chain_id);
+  }
+  ChainPosition chain_position(int edge_id) const override {
+    return ChainPosition(edge_id, 0);
+  }
+
+ private:
+  const S2Shape* shape_;
+  int first_edge_id_;
+  int num_edges_;
+};
+
 S2ChainInterpolationQuery::S2ChainInterpolationQuery(const S2Shape* shape,
                                                      int chain_id) {
   Init(shape, chain_id);
@@ -63,6 +109,14 @@ void S2ChainInterpolationQuery::Init(const S2Shape* shape, int chain_id) {
   shape_ = shape;
   first_edge_id_ = first_edge_id;
   last_edge_id_ = last_edge_id;
+
+  // The index is not built until Project() is called.
+  index_.reset();
+  const int num_edges = last_edge_id - first_edge_id + 1;
+  if (num_edges > kMaxBruteForceProjectionEdges) {
+    index_ = make_shared<MutableS2ShapeIndex>();
+    index_->Add(make_unique<EdgeRangeShape>(shape, first_edge_id, num_edges));
+  }
 }
 
 S1Angle S2ChainInterpolationQuery::GetLength() const {
@@ -94,9 +148,13 @@ S2ChainInterpolationQuery::Result S2ChainInterpolationQuery::AtDistance(
 
   // Binary search in the list of cumulative values, which by construction are
   // sorted in ascending order.
-  const auto it = std::lower_bound(cumulative_values_.begin(),
-                                   cumulative_values_.end(), distance);
+  return GetResult(std::lower_bound(cumulative_values_.begin(),
+                                    cumulative_values_.end(), distance),
+                   distance);
+}
 
+S2ChainInterpolationQuery::Result S2ChainInterpolationQuery::GetResult(
+    vector<S1Angle>::const_iterator it, const S1Angle& distance) const {
   if (it == cumulative_values_.begin()) {
     // Corner case: the first vertex of the shape at distance = 0.
     return Result(shape_->edge(first_edge_id_).v0, first_edge_id_,
@@ -122,16 +180,81 @@ S2ChainInterpolationQuery::Result S2ChainInterpolationQuery::AtFraction(
   return AtDistance(fraction * GetLength());
 }
 
-std::vector<S2Point> S2ChainInterpolationQuery::Slice(
+void S2ChainInterpolationQuery::AtDistances(Span<const S1Angle> distances,
+                                            vector<Result>* results) const {
+  results->clear();
+  if (cumulative_values_.empty()) {
+    results->resize(distances.size());
+    return;
+  }
+  results->reserve(distances.size());
+  const bool sorted = std::is_sorted(distances.begin(), distances.end());
+  auto begin = cumulative_values_.begin();
+  for (const S1Angle& distance : distances) {
+    const auto it =
+        std::lower_bound(begin, cumulative_values_.end(), distance);
+    // For sorted inputs, the next position is never before this one.
+    if (sorted) begin = it;
+    results->push_back(GetResult(it, distance));
+  }
+}
+
+S2ChainInterpolationQuery::Result S2ChainInterpolationQuery::GetProjection(
+    const S2Point& point, int edge_id) const {
+  const S2Shape::Edge edge = shape_->edge(edge_id);
+  const S2Point projection = S2::Project(point, edge.v0, edge.v1);
+  return Result(projection, edge_id,
+                cumulative_values_[edge_id - first_edge_id_] +
+                    S1Angle(edge.v0, projection));
+}
+
+S2ChainInterpolationQuery::Result S2ChainInterpolationQuery::Project(
+    const S2Point& point) const {
+  vector<Result> results;
+  Project(Span<const S2Point>(&point, 1), &results);
+  return results[0];
+}
+
+void S2ChainInterpolationQuery::Project(Span<const S2Point> points,
+                                        vector<Result>* results) const {
+  results->clear();
+  if (cumulative_values_.empty()) {
+    results->resize(points.size());
+    return;
+  }
+  results->reserve(points.size());
+  if (index_ == nullptr) {
+    for (const S2Point& point : points) {
+      int closest_edge_id = first_edge_id_;
+      S1ChordAngle min_dist = S1ChordAngle::Infinity();
+      for (int edge_id = first_edge_id_; edge_id <= last_edge_id_; ++edge_id) {
+        const S2Shape::Edge edge = shape_->edge(edge_id);
+        if (S2::UpdateMinDistance(point, edge.v0, edge.v1, &min_dist)) {
+          closest_edge_id = edge_id;
+        }
+      }
+      results->push_back(GetProjection(point, closest_edge_id));
+    }
+    return;
+  }
+  S2ClosestEdgeQuery query(index_.get());
+  for (const S2Point& point : points) {
+    S2ClosestEdgeQuery::PointTarget target(point);
+    const S2ClosestEdgeQuery::Result result = query.FindClosestEdge(&target);
+    results->push_back(GetProjection(point, first_edge_id_ + result.edge_id()));
+  }
+}
+
+vector<S2Point> S2ChainInterpolationQuery::Slice(
     double begin_fraction, double end_fraction) const {
-  std::vector<S2Point> slice;
+  vector<S2Point> slice;
   AddSlice(begin_fraction, end_fraction, slice);
   return slice;
 }
 
 void S2ChainInterpolationQuery::AddSlice(double begin_fraction,
                                          double end_fraction,
-                                         std::vector<S2Point>& slice) const {
+                                         vector<S2Point>& slice) const {
   if (cumulative_values_.empty()) {
     return;
   }
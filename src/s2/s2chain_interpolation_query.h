@@ -20,6 +20,8 @@
 #include <memory>
 #include <vector>
 
+#include "absl/types/span.h"
+#include "s2/mutable_s2shape_index.h"
 #include "s2/s1angle.h"
 #include "s2/s2point.h"
 #include "s2/s2shape.h"
@@ -39,6 +41,12 @@
 // Once the query object is initialized, the complexity of each subsequent query
 // is O( log(number of edges) ).  The complexity of the initialization and the
 // memory footprint of the query object are both O(number of edges).
+//
+// The query also supports linear referencing, i.e. projecting points onto the
+// edges (see Project()).  For chains with many edges this uses an
+// S2ShapeIndex that is built the first time it is needed, so that each
+// projection takes O(log(number of edges)) time rather than O(number of
+// edges).
 class S2ChainInterpolationQuery {
  public:
   S2ChainInterpolationQuery() = default;
@@ -135,6 +143,28 @@ class S2ChainInterpolationQuery {
   // fraction to distance by multiplying it by the total length.
   Result AtFraction(double fraction) const;
 
+  // Equivalent to calling AtDistance() for each element of "distances", and
+  // storing the results in "results" (which is resized as necessary).  If the
+  // distances are sorted in ascending order (e.g., evenly spaced offsets along
+  // a route), each search starts where the previous one ended.
+  void AtDistances(absl::Span<const S1Angle> distances,
+                   std::vector<Result>* results) const;
+
+  // Returns the point on the edges being interpolated that is closest to
+  // "point", together with its edge id and its distance along the chain(s).
+  // If several edges are equally close, any of them may be used.  The
+  // resulting distance can be passed to AtDistance() to recover
+  // the projected point (up to kGetPointOnLineError).
+  //
+  // This method returns a valid Result iff the query has been initialized
+  // with at least one edge.
+  Result Project(const S2Point& point) const;
+
+  // Equivalent to calling Project() for each element of "points", but more
+  // efficient since the internal query objects are reused.
+  void Project(absl::Span<const S2Point> points,
+               std::vector<Result>* results) const;
+
   // Returns the vector of points that is a slice of the chain from
   // begin_fraction to end_fraction. If begin_fraction is greater than
   // end_fraction, then the points are returned in reverse order.
@@ -159,10 +189,25 @@ class S2ChainInterpolationQuery {
                 std::vector<S2Point>& slice) const;
 
  private:
+  class EdgeRangeShape;
+
+  // Returns the result for the given distance, where "it" is the first
+  // cumulative value that is not less than "distance".
+  Result GetResult(std::vector<S1Angle>::const_iterator it,
+                   const S1Angle& distance) const;
+
+  // Returns the result of projecting "point" onto the given edge.
+  Result GetProjection(const S2Point& point, int edge_id) const;
+
   const S2Shape* shape_;
   std::vector<S1Angle> cumulative_values_;
   int first_edge_id_;
   int last_edge_id_;
+
+  // An index of the edges being interpolated, used by Project() when there
+  // are many edges.  It is shared by copies of the query since the index is
+  // built lazily in a thread-safe way and does not change afterwards.
+  std::shared_ptr<MutableS2ShapeIndex> index_;
 };
 
 #endif  // S2_S2CHAIN_INTERPOLATION_QUERY_H_
@@ -21,12 +21,15 @@
 #include <gtest/gtest.h>
 #include "absl/types/span.h"
 #include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2edge_distances.h"
 #include "s2/s2latlng.h"
 #include "s2/s2lax_polygon_shape.h"
 #include "s2/s2lax_polyline_shape.h"
 #include "s2/s2point.h"
 #include "s2/s2polyline.h"
 #include "s2/s2shape.h"
+#include "s2/s2testing.h"
 #include "s2/s2text_format.h"
 
 using std::vector;
@@ -305,3 +308,72 @@ TEST(S2ChainInterpolationQueryTest, Slice) {
   EXPECT_EQ(s2textformat::ToString(query.Slice(0.25, 0.75)),
             "0:0.5, 0:1, 0:1.5");
 }
+
+TEST(S2ChainInterpolationQueryTest, AtDistances) {
+  const S2LaxPolylineShape shape(
+      s2textformat::ParsePointsOrDie("0:0, 0:1, 1:1, 1:1, 3:1, 3:4"));
+  S2ChainInterpolationQuery query(&shape);
+  vector<S1Angle> distances;
+  for (int i = -2; i < 40; ++i) distances.push_back(S1Angle::Degrees(0.2 * i));
+  vector<S1Angle> unsorted = distances;
+  std::reverse(unsorted.begin(), unsorted.end());
+
+  for (const auto& input : {distances, unsorted}) {
+    vector<S2ChainInterpolationQuery::Result> results;
+    query.AtDistances(input, &results);
+    ASSERT_EQ(input.size(), results.size());
+    for (int i = 0; i < input.size(); ++i) {
+      const auto expected = query.AtDistance(input[i]);
+      EXPECT_EQ(expected.point(), results[i].point());
+      EXPECT_EQ(expected.edge_id(), results[i].edge_id());
+      EXPECT_EQ(expected.distance(), results[i].distance());
+    }
+  }
+
+  vector<S2ChainInterpolationQuery::Result> results;
+  S2ChainInterpolationQuery().AtDistances(distances, &results);
+  ASSERT_EQ(distances.size(), results.size());
+  EXPECT_FALSE(results[0].is_valid());
+}
+
+TEST(S2ChainInterpolationQueryTest, Project) {
+  // Test chains that are projected onto both by brute force and by using an
+  // index.
+  for (int num_vertices : {2, 10, 1000}) {
+    S2Testing::rnd.Reset(num_vertices);
+    vector<S2Point> vertices;
+    S2Point v = S2Testing::RandomPoint();
+    for (int i = 0; i < num_vertices; ++i) {
+      vertices.push_back(v);
+      v = S2Testing::SamplePoint(S2Cap(v, S1Angle::Degrees(0.1)));
+    }
+    const S2LaxPolylineShape shape(vertices);
+    S2ChainInterpolationQuery query(&shape);
+    vector<S2Point> points;
+    for (int i = 0; i < 100; ++i) {
+      points.push_back(S2Testing::SamplePoint(
+          S2Cap(vertices[S2Testing::rnd.Uniform(num_vertices)],
+                S1Angle::Degrees(0.2))));
+    }
+    vector<S2ChainInterpolationQuery::Result> results;
+    query.Project(points, &results);
+    ASSERT_EQ(points.size(), results.size());
+    for (int i = 0; i < points.size(); ++i) {
+      const S2ChainInterpolationQuery::Result& result = results[i];
+      ASSERT_TRUE(result.is_valid());
+      S1ChordAngle min_dist = S1ChordAngle::Infinity();
+      for (int j = 0; j + 1 < num_vertices; ++j) {
+        S2::UpdateMinDistance(points[i], vertices[j], vertices[j + 1],
+                              &min_dist);
+      }
+      EXPECT_LE(S1Angle(points[i], result.point()),
+                min_dist.ToAngle() + kEpsilonAngle);
+      EXPECT_LE(S1Angle(result.point(), query.AtDistance(result.distance())
+                                            .point()),
+                kEpsilonAngle);
+      EXPECT_EQ(result.edge_id(), query.Project(points[i]).edge_id());
+    }
+  }
+  EXPECT_FALSE(S2ChainInterpolationQuery().Project(S2Point(1, 0, 0))
+                   .is_valid());
+}
@@ -17,10 +17,16 @@
 
 #include "s2/s2closest_cell_query.h"
 
+#include <vector>
+
+#include "absl/types/span.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s2closest_cell_query_base.h"
 #include "s2/s2edge_distances.h"
+#include "s2/s2point.h"
+
+using std::vector;
 
 void S2ClosestCellQuery::Options::set_conservative_max_distance(
     S1ChordAngle max_distance) {
@@ -88,7 +94,7 @@ S2ClosestCellQuery::~S2ClosestCellQuery() {
 }
 
 bool S2ClosestCellQuery::IsDistanceLess(Target* target, S1ChordAngle limit) {
-  static_assert(sizeof(Options) <= 32, "Consider not copying Options here");
+  static_assert(sizeof(Options) <= 64, "Consider not copying Options here");
   Options tmp_options = options_;
   tmp_options.set_max_results(1);
   tmp_options.set_max_distance(limit);
@@ -98,7 +104,7 @@ bool S2ClosestCellQuery::IsDistanceLess(Target* target, S1ChordAngle limit) {
 
 bool S2ClosestCellQuery::IsDistanceLessOrEqual(Target* target,
                                                S1ChordAngle limit) {
-  static_assert(sizeof(Options) <= 32, "Consider not copying Options here");
+  static_assert(sizeof(Options) <= 64, "Consider not copying Options here");
   Options tmp_options = options_;
   tmp_options.set_max_results(1);
   tmp_options.set_inclusive_max_distance(limit);
@@ -108,10 +114,22 @@ bool S2ClosestCellQuery::IsDistanceLessOrEqual(Target* target,
 
 bool S2ClosestCellQuery::IsConservativeDistanceLessOrEqual(
     Target* target, S1ChordAngle limit) {
-  static_assert(sizeof(Options) <= 32, "Consider not copying Options here");
+  static_assert(sizeof(Options) <= 64, "Consider not copying Options here");
   Options tmp_options = options_;
   tmp_options.set_max_results(1);
   tmp_options.set_conservative_max_distance(limit);
   tmp_options.set_max_error(S1ChordAngle::Straight());
   return !base_.FindClosestCell(target, tmp_options).is_empty();
 }
+
+void S2ClosestCellQuery::FindClosestCells(absl::Span<const S2Point> points,
+                                          vector<vector<Result>>* results,
+                                          int num_threads) {
+  vector<PointTarget> point_targets;
+  point_targets.reserve(points.size());
+  for (const S2Point& point : points) point_targets.emplace_back(point);
+  vector<Target*> targets;
+  targets.reserve(points.size());
+  for (PointTarget& target : point_targets) targets.push_back(&target);
+  FindClosestCells(targets, results, num_threads);
+}
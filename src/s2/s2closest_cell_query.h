@@ -21,6 +21,7 @@
 #include <utility>
 #include <vector>
 
+#include "absl/types/span.h"
 #include "s2/_fp_contract_off.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
@@ -29,6 +30,7 @@
 #include "s2/s2cell_index.h"
 #include "s2/s2cell_union.h"
 #include "s2/s2closest_cell_query_base.h"
+#include "s2/s2distance_query_stats.h"
 #include "s2/s2min_distance_targets.h"
 #include "s2/s2point.h"
 #include "s2/s2shape_index.h"
@@ -239,6 +241,15 @@ class S2ClosestCellQuery {
   const Options& options() const;
   Options* mutable_options();
 
+  // Returns true if the most recent query stopped early because it reached
+  // one of the work limits in Options (max_visited_cells(), etc), in which
+  // case the results are the best cells found so far.
+  bool last_query_approximate() const;
+
+  // Returns statistics about the most recent query for which
+  // options().record_stats() was true.
+  const S2DistanceQueryStats& last_query_stats() const;
+
   // Returns the closest cells to the given target that satisfy the current
   // options.  This method may be called multiple times.
   std::vector<Result> FindClosestCells(Target* target);
@@ -247,6 +258,21 @@ class S2ClosestCellQuery {
   // since it does not require allocating a new vector on each call.
   void FindClosestCells(Target* target, std::vector<Result>* results);
 
+  // Finds the closest cells to each of the given targets, storing the results
+  // for targets[i] in (*results)[i].  This is equivalent to calling
+  // FindClosestCells() on each target, but is faster when there are many
+  // targets (see S2ClosestCellQueryBase for details).  If num_threads > 1,
+  // the targets are processed concurrently and must not share mutable state.
+  void FindClosestCells(absl::Span<Target* const> targets,
+                        std::vector<std::vector<Result>>* results,
+                        int num_threads = 1);
+
+  // Convenience version of the method above that finds the closest cells to
+  // each of the given points.
+  void FindClosestCells(absl::Span<const S2Point> points,
+                        std::vector<std::vector<Result>>* results,
+                        int num_threads = 1);
+
   //////////////////////// Convenience Methods ////////////////////////
 
   // Returns the closest cell to the target.  If no cell satisfies the search
@@ -364,6 +390,15 @@ inline S2ClosestCellQuery::Options* S2ClosestCellQuery::mutable_options() {
   return &options_;
 }
 
+inline bool S2ClosestCellQuery::last_query_approximate() const {
+  return base_.last_query_approximate();
+}
+
+inline const S2DistanceQueryStats& S2ClosestCellQuery::last_query_stats()
+    const {
+  return base_.last_query_stats();
+}
+
 inline std::vector<S2ClosestCellQuery::Result>
 S2ClosestCellQuery::FindClosestCells(Target* target) {
   return base_.FindClosestCells(target, options_);
@@ -374,9 +409,15 @@ inline void S2ClosestCellQuery::FindClosestCells(Target* target,
   base_.FindClosestCells(target, options_, results);
 }
 
+inline void S2ClosestCellQuery::FindClosestCells(
+    absl::Span<Target* const> targets,
+    std::vector<std::vector<Result>>* results, int num_threads) {
+  base_.FindClosestCells(targets, options_, results, num_threads);
+}
+
 inline S2ClosestCellQuery::Result S2ClosestCellQuery::FindClosestCell(
     Target* target) {
-  static_assert(sizeof(Options) <= 32, "Consider not copying Options here");
+  static_assert(sizeof(Options) <= 64, "Consider not copying Options here");
   Options tmp_options = options_;
   tmp_options.set_max_results(1);
   return base_.FindClosestCell(target, tmp_options);
@@ -23,10 +23,15 @@
 #include <cstddef>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iterator>
 #include <limits>
+#include <memory>
+#include <optional>
 #include <queue>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "absl/container/btree_set.h"
@@ -35,12 +40,17 @@
 #include "absl/hash/hash.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "s2/base/executor.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s2cap.h"
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_index.h"
 #include "s2/s2cell_union.h"
+#include "s2/s2distance_query_stats.h"
 #include "s2/s2distance_target.h"
 #include "s2/s2region.h"
 #include "s2/s2region_coverer.h"
@@ -148,12 +158,55 @@ class S2ClosestCellQueryBase {
     bool use_brute_force() const;
     void set_use_brute_force(bool use_brute_force);
 
+    // The following options bound the amount of work done by each query.
+    // When a limit is reached the search stops and the best results found so
+    // far are returned, and last_query_approximate() returns true.  Such
+    // results satisfy all the other search criteria, but closer cells may
+    // exist.
+
+    // Specifies the maximum number of cells that are removed from the
+    // priority queue and subdivided.
+    //
+    // DEFAULT: kNoWorkLimit
+    int max_visited_cells() const;
+    void set_max_visited_cells(int max_visited_cells);
+    static constexpr int kNoWorkLimit = std::numeric_limits<int>::max();
+
+    // Specifies the maximum number of indexed (cell_id, label) pairs whose
+    // distance to the target is computed.  Note that when the index is used
+    // this limit is only checked between cells, so it may be exceeded by the
+    // contents of one cell.
+    //
+    // DEFAULT: kNoWorkLimit
+    int max_tested_cells() const;
+    void set_max_tested_cells(int max_tested_cells);
+
+    // Specifies a time after which the search should stop.  The deadline is
+    // checked periodically rather than after every step, so queries may run
+    // slightly past it.
+    //
+    // DEFAULT: absl::InfiniteFuture()
+    absl::Time deadline() const;
+    void set_deadline(absl::Time deadline);
+
+    // Specifies that statistics about each query should be recorded (see
+    // last_query_stats).  Otherwise no statistics are recorded, which adds
+    // no overhead.
+    //
+    // DEFAULT: false
+    bool record_stats() const;
+    void set_record_stats(bool record_stats);
+
    private:
     Distance max_distance_ = Distance::Infinity();
     Delta max_error_ = Delta::Zero();
     const S2Region* region_ = nullptr;
     int max_results_ = kMaxMaxResults;
+    int max_visited_cells_ = kNoWorkLimit;
+    int max_tested_cells_ = kNoWorkLimit;
+    absl::Time deadline_ = absl::InfiniteFuture();
     bool use_brute_force_ = false;
+    bool record_stats_ = false;
   };
 
   // The Target class represents the geometry to which the distance is
@@ -261,6 +314,37 @@ class S2ClosestCellQueryBase {
   // REQUIRES: options.max_results() == 1
   Result FindClosestCell(Target* target, const Options& options);
 
+  // Finds the closest cells to each of the given targets, storing the results
+  // for targets[i] in (*results)[i].  The results are identical to calling
+  // FindClosestCells() on each target in turn.  The targets are processed in
+  // S2CellId order of their bounding cap centers, so that consecutive queries
+  // visit nearby parts of the index, and when max_results() == 1 the leaf
+  // cell range containing each target is found by searching forward from the
+  // range of the previous target rather than by seeking from scratch.
+  //
+  // If num_threads > 1, the sorted targets are divided into small groups
+  // that are claimed by up to "num_threads" threads.  Each thread uses its
+  // own query object, which is kept for subsequent calls so that repeated
+  // batches do not need to allocate any query state.  In this case the
+  // targets must not share mutable state.
+  //
+  // last_query_approximate() returns true if any query was approximate, and
+  // last_query_stats() (if requested) is the sum over all queries.
+  void FindClosestCells(absl::Span<Target* const> targets,
+                        const Options& options,
+                        std::vector<std::vector<Result>>* results,
+                        int num_threads = 1);
+
+  // Returns true if the most recent query stopped early because it reached
+  // one of the work limits in Options (see max_visited_cells()).  In that
+  // case the results are the best ones found so far.
+  bool last_query_approximate() const { return approximate_; }
+
+  // Returns statistics about the most recent query for which
+  // options.record_stats() was true.
+  using QueryStats = S2DistanceQueryStats;
+  const QueryStats& last_query_stats() const { return stats_; }
+
  private:
   using CellIterator = S2CellIndex::CellIterator;
   using ContentsIterator = S2CellIndex::ContentsIterator;
@@ -269,14 +353,29 @@ class S2ClosestCellQueryBase {
 
   const Options& options() const { return *options_; }
   void FindClosestCellsInternal(Target* target, const Options& options);
+  void FindClosestCellsSorted(
+      absl::Span<Target* const> targets,
+      absl::Span<const std::pair<S2CellId, int>> order, const Options& options,
+      std::vector<std::vector<Result>>* results);
+  void FindClosestCellsImpl(Target* target, const Options& options);
   void FindClosestCellsBruteForce();
   void FindClosestCellsOptimized();
   void InitQueue();
   void InitCovering();
   void AddInitialRange(S2CellId first_id, S2CellId last_id);
   void MaybeAddResult(S2CellId cell_id, Label label);
-  bool ProcessOrEnqueue(S2CellId id, NonEmptyRangeIterator* iter, bool seek);
+  // The children of a cell being subdivided that need to be enqueued.
+  struct ChildCells {
+    int size = 0;
+    S2CellId ids[4];
+  };
+  bool ProcessOrEnqueue(S2CellId id, NonEmptyRangeIterator* iter, bool seek,
+                        ChildCells* children = nullptr);
+  void EnqueueChildren(S2CellId parent, const ChildCells& children);
+  void MaybeEnqueue(S2CellId id);
+  void Enqueue(S2CellId id, Distance distance);
   void AddRange(const RangeIterator& range);
+  bool WorkLimitReached();
 
   const S2CellIndex* index_;
   const Options* options_;
@@ -288,6 +387,13 @@ class S2ClosestCellQueryBase {
   // return faster results, and 0 < max_error() < distance_limit_.
   bool use_conservative_cell_distance_;
 
+  // When at least kMinChildDistances children of a subdivided cell need to
+  // be enqueued, their distances are computed together (see
+  // S2DistanceTarget::GetChildCellDistances).  use_child_distances_ is set to
+  // false if the target does not support this.
+  static constexpr int kMinChildDistances = 3;
+  bool use_child_distances_;
+
   // For the optimized algorithm we precompute the top-level S2CellIds that
   // will be added to the priority queue.  There can be at most 6 of these
   // cells.  Essentially this is just a covering of the indexed cells.
@@ -302,6 +408,23 @@ class S2ClosestCellQueryBase {
   // but it can also be updated by the algorithm (see MaybeAddResult).
   Distance distance_limit_;
 
+  // The work done by the current query, which is compared against the work
+  // limits in Options only if has_work_limit_ is true.  approximate_ is set
+  // if the query stops early because a limit was reached.
+  bool has_work_limit_;
+  bool approximate_ = false;
+  int num_visited_cells_;
+  int num_tested_cells_;
+  int num_work_checks_;
+
+  // Additional work counters that are only reported by last_query_stats().
+  // search_start_ is the time at which the current query started searching
+  // the index, and is only set when options().record_stats() is true.
+  int num_queue_pushes_;
+  int num_queue_pops_;
+  std::chrono::steady_clock::time_point search_start_;
+  QueryStats stats_;
+
   // The current result set is stored in one of three ways:
   //
   //  - If max_results() == 1, the best result is kept in result_singleton_.
@@ -359,8 +482,12 @@ class S2ClosestCellQueryBase {
       return other.distance < distance;
     }
   };
-  using CellQueue =
-      std::priority_queue<QueueEntry, absl::InlinedVector<QueueEntry, 16>>;
+  class CellQueue : public std::priority_queue<
+                        QueueEntry, absl::InlinedVector<QueueEntry, 16>> {
+   public:
+    // Removes all entries without releasing the queue's storage.
+    void clear() { this->c.erase(this->c.begin(), this->c.end()); }
+  };
   CellQueue queue_;
 
   // Used to iterate over the contents of an S2CellIndex range.  It is defined
@@ -370,8 +497,19 @@ class S2ClosestCellQueryBase {
 
   // Temporaries, defined here to avoid multiple allocations / initializations.
 
+  S2RegionCoverer max_distance_coverer_;
   std::vector<S2CellId> max_distance_covering_;
   std::vector<S2CellId> intersection_with_max_distance_;
+
+  // While processing a batch of targets in sorted order (see
+  // FindClosestCellsSorted), the non-empty range found for the previous
+  // target.  Otherwise this is empty.
+  std::optional<NonEmptyRangeIterator> batch_range_;
+
+  // The query objects used by the additional threads of FindClosestCells()
+  // with multiple targets.  They are kept so that their storage can be
+  // reused by later calls.
+  std::vector<std::unique_ptr<S2ClosestCellQueryBase>> thread_queries_;
 };
 
 
@@ -439,6 +577,54 @@ inline void S2ClosestCellQueryBase<Distance>::Options::set_use_brute_force(
   use_brute_force_ = use_brute_force;
 }
 
+template <class Distance>
+inline int S2ClosestCellQueryBase<Distance>::Options::max_visited_cells()
+    const {
+  return max_visited_cells_;
+}
+
+template <class Distance>
+inline void S2ClosestCellQueryBase<Distance>::Options::set_max_visited_cells(
+    int max_visited_cells) {
+  ABSL_DCHECK_GE(max_visited_cells, 0);
+  max_visited_cells_ = max_visited_cells;
+}
+
+template <class Distance>
+inline int S2ClosestCellQueryBase<Distance>::Options::max_tested_cells()
+    const {
+  return max_tested_cells_;
+}
+
+template <class Distance>
+inline void S2ClosestCellQueryBase<Distance>::Options::set_max_tested_cells(
+    int max_tested_cells) {
+  ABSL_DCHECK_GE(max_tested_cells, 0);
+  max_tested_cells_ = max_tested_cells;
+}
+
+template <class Distance>
+inline absl::Time S2ClosestCellQueryBase<Distance>::Options::deadline() const {
+  return deadline_;
+}
+
+template <class Distance>
+inline void S2ClosestCellQueryBase<Distance>::Options::set_deadline(
+    absl::Time deadline) {
+  deadline_ = deadline;
+}
+
+template <class Distance>
+inline bool S2ClosestCellQueryBase<Distance>::Options::record_stats() const {
+  return record_stats_;
+}
+
+template <class Distance>
+inline void S2ClosestCellQueryBase<Distance>::Options::set_record_stats(
+    bool record_stats) {
+  record_stats_ = record_stats;
+}
+
 template <class Distance>
 S2ClosestCellQueryBase<Distance>::S2ClosestCellQueryBase()
     : tested_cells_(/*bucket_count=*/1) {}
@@ -459,12 +645,14 @@ void S2ClosestCellQueryBase<Distance>::Init(
     const S2CellIndex* index) {
   index_ = index;
   contents_it_.Init(index);
+  thread_queries_.clear();
   ReInit();
 }
 
 template <class Distance>
 void S2ClosestCellQueryBase<Distance>::ReInit() {
   index_covering_.clear();
+  for (auto& query : thread_queries_) query->ReInit();
 }
 
 template <class Distance>
@@ -511,16 +699,132 @@ void S2ClosestCellQueryBase<Distance>::FindClosestCells(
   }
 }
 
+template <class Distance>
+void S2ClosestCellQueryBase<Distance>::FindClosestCells(
+    absl::Span<Target* const> targets, const Options& options,
+    std::vector<std::vector<Result>>* results, int num_threads) {
+  ABSL_DCHECK_GE(num_threads, 1);
+  results->resize(targets.size());
+
+  // Sort the targets along the Hilbert curve so that consecutive queries
+  // tend to touch the same index cells.
+  std::vector<std::pair<S2CellId, int>> order;
+  order.reserve(targets.size());
+  for (int i = 0; i < static_cast<int>(targets.size()); ++i) {
+    order.emplace_back(S2CellId(targets[i]->GetCapBound().center()), i);
+  }
+  std::sort(order.begin(), order.end());
+
+  // Threads claim small groups of consecutive targets, so that each thread
+  // still visits its targets in increasing S2CellId order.
+  constexpr int kTargetsPerGroup = 64;
+  const int n = order.size();
+  const int num_groups = (n + kTargetsPerGroup - 1) / kTargetsPerGroup;
+  num_threads = std::min(num_threads, num_groups);
+  if (num_threads <= 1) {
+    FindClosestCellsSorted(targets, order, options, results);
+    return;
+  }
+  // Each thread copies the index covering rather than recomputing it.
+  if (index_covering_.empty()) InitCovering();
+  while (thread_queries_.size() < static_cast<size_t>(num_threads)) {
+    thread_queries_.push_back(
+        std::make_unique<S2ClosestCellQueryBase>(index_));
+  }
+  std::atomic<int> next_query(0), next_group(0);
+  s2base::RunConcurrently(nullptr, num_threads, [&]() {
+    S2ClosestCellQueryBase* query = thread_queries_[next_query++].get();
+    if (query->index_covering_.empty()) {
+      query->index_covering_ = index_covering_;
+    }
+    bool approximate = false;
+    QueryStats stats;
+    int group;
+    while ((group = next_group.fetch_add(1)) < num_groups) {
+      const int begin = group * kTargetsPerGroup;
+      const int end = std::min(begin + kTargetsPerGroup, n);
+      query->FindClosestCellsSorted(
+          targets, absl::MakeConstSpan(order).subspan(begin, end - begin),
+          options, results);
+      approximate |= query->approximate_;
+      if (options.record_stats()) stats += query->stats_;
+    }
+    query->approximate_ = approximate;
+    query->stats_ = stats;
+  });
+  approximate_ = false;
+  stats_ = QueryStats();
+  for (int t = 0; t < num_threads; ++t) {
+    approximate_ |= thread_queries_[t]->approximate_;
+    if (options.record_stats()) stats_ += thread_queries_[t]->stats_;
+  }
+}
+
+// Finds the closest cells to the given targets, which are visited in the
+// given order.  The S2CellIds in "order" must be sorted.
+template <class Distance>
+void S2ClosestCellQueryBase<Distance>::FindClosestCellsSorted(
+    absl::Span<Target* const> targets,
+    absl::Span<const std::pair<S2CellId, int>> order, const Options& options,
+    std::vector<std::vector<Result>>* results) {
+  bool approximate = false;
+  QueryStats stats;
+  batch_range_.emplace(index_);
+  batch_range_->Begin();
+  for (const auto& [id, i] : order) {
+    FindClosestCells(targets[i], options, &(*results)[i]);
+    approximate |= approximate_;
+    if (options.record_stats()) stats += stats_;
+  }
+  batch_range_.reset();
+  approximate_ = approximate;
+  if (options.record_stats()) stats_ = stats;
+}
+
 template <class Distance>
 void S2ClosestCellQueryBase<Distance>::FindClosestCellsInternal(
     Target* target, const Options& options) {
+  if (!options.record_stats()) {
+    FindClosestCellsImpl(target, options);
+    return;
+  }
+  // FindClosestCellsImpl() sets search_start_ unless it returns before
+  // searching the index.
+  auto start = std::chrono::steady_clock::now();
+  search_start_ = std::chrono::steady_clock::time_point::max();
+  stats_ = QueryStats();
+  FindClosestCellsImpl(target, options);
+  auto end = std::chrono::steady_clock::now();
+  stats_.num_queries = 1;
+  stats_.num_approximate_queries = approximate_;
+  stats_.num_queue_pushes = num_queue_pushes_;
+  stats_.num_queue_pops = num_queue_pops_;
+  stats_.num_visited_cells = num_visited_cells_;
+  stats_.num_distance_tests = num_tested_cells_;
+  stats_.setup_time = std::min(search_start_, end) - start;
+  stats_.elapsed = end - start;
+}
+
+template <class Distance>
+void S2ClosestCellQueryBase<Distance>::FindClosestCellsImpl(
+    Target* target, const Options& options) {
   target_ = target;
   options_ = &options;
+  use_child_distances_ = true;
 
   tested_cells_.clear();
   contents_it_.Clear();
   distance_limit_ = options.max_distance();
   result_singleton_ = Result();
+  has_work_limit_ = (options.max_visited_cells() != Options::kNoWorkLimit ||
+                     options.max_tested_cells() != Options::kNoWorkLimit ||
+                     options.deadline() != absl::InfiniteFuture());
+  approximate_ = false;
+  num_visited_cells_ = 0;
+  num_tested_cells_ = 0;
+  num_work_checks_ = 0;
+  num_queue_pushes_ = 0;
+  num_queue_pops_ = 0;
   ABSL_DCHECK(result_vector_.empty());
   ABSL_DCHECK(result_set_.empty());
   ABSL_DCHECK_GE(target->max_brute_force_index_size(), 0);
@@ -564,8 +868,14 @@ void S2ClosestCellQueryBase<Distance>::FindClosestCellsInternal(
        Distance::Zero() < distance_limit_ - options.max_error());
 
   // Use the brute force algorithm if the index is small enough.
-  if (options.use_brute_force() ||
-      index_->num_cells() <= target_->max_brute_force_index_size()) {
+  bool use_brute_force = (options.use_brute_force() ||
+                          index_->num_cells() <=
+                              target_->max_brute_force_index_size());
+  if (options.record_stats()) {
+    stats_.num_brute_force_queries = use_brute_force;
+    search_start_ = std::chrono::steady_clock::now();
+  }
+  if (use_brute_force) {
     avoid_duplicates_ = false;
     FindClosestCellsBruteForce();
   } else {
@@ -579,6 +889,10 @@ void S2ClosestCellQueryBase<Distance>::FindClosestCellsInternal(
 template <class Distance>
 void S2ClosestCellQueryBase<Distance>::FindClosestCellsBruteForce() {
   for (CellIterator it(index_); !it.done(); it.Next()) {
+    if (has_work_limit_ && WorkLimitReached()) {
+      approximate_ = true;
+      return;
+    }
     MaybeAddResult(it.cell_id(), it.label());
   }
 }
@@ -591,23 +905,30 @@ void S2ClosestCellQueryBase<Distance>::FindClosestCellsOptimized() {
     // it before adding any new entries to the queue.
     QueueEntry entry = queue_.top();
     queue_.pop();
+    ++num_queue_pops_;
     // Work around weird parse error in gcc 4.9 by using a local variable for
     // entry.distance.
     Distance distance = entry.distance;
-    if (!(distance < distance_limit_)) {
-      queue_ = CellQueue();  // Clear any remaining entries.
+    if (!(distance < distance_limit_)) break;
+    if (has_work_limit_ && WorkLimitReached()) {
+      approximate_ = true;
       break;
     }
+    ++num_visited_cells_;
     S2CellId child = entry.id.child_begin();
     // We already know that it has too many cells, so process its children.
     // Each child may either be processed directly or enqueued again.  The
     // loop is optimized so that we don't seek unnecessarily.
     bool seek = true;
     NonEmptyRangeIterator range(index_);
+    ChildCells children;
     for (int i = 0; i < 4; ++i, child = child.next()) {
-      seek = ProcessOrEnqueue(child, &range, seek);
+      seek = ProcessOrEnqueue(child, &range, seek, &children);
     }
+    EnqueueChildren(entry.id, children);
   }
+  num_queue_pushes_ = num_queue_pops_ + queue_.size();
+  queue_.clear();  // Clear any remaining entries.
 }
 
 template <class Distance>
@@ -633,7 +954,13 @@ void S2ClosestCellQueryBase<Distance>::InitQueue() {
     // First check the range containing or immediately following "center".
     NonEmptyRangeIterator range(index_);
     S2CellId target(cap.center());
-    range.Seek(target);
+    if (batch_range_) {
+      // The targets of a batch are visited in increasing S2CellId order.
+      batch_range_->SeekForward(target);
+      range = *batch_range_;
+    } else {
+      range.Seek(target);
+    }
     AddRange(range);
     if (distance_limit_ == Distance::Zero()) return;
 
@@ -663,11 +990,10 @@ void S2ClosestCellQueryBase<Distance>::InitQueue() {
   if (index_covering_.empty()) InitCovering();
   const std::vector<S2CellId>* initial_cells = &index_covering_;
   if (distance_limit_ < Distance::Infinity()) {
-    S2RegionCoverer coverer;
-    coverer.mutable_options()->set_max_cells(4);
+    max_distance_coverer_.mutable_options()->set_max_cells(4);
     S1ChordAngle radius = cap.radius() + distance_limit_.GetChordAngleBound();
     S2Cap search_cap(cap.center(), radius);
-    coverer.GetFastCovering(search_cap, &max_distance_covering_);
+    max_distance_coverer_.GetFastCovering(search_cap, &max_distance_covering_);
     S2CellUnion::GetIntersection(*initial_cells, max_distance_covering_,
                                  &intersection_with_max_distance_);
     initial_cells = &intersection_with_max_distance_;
@@ -753,6 +1079,8 @@ void S2ClosestCellQueryBase<Distance>::MaybeAddResult(S2CellId cell_id,
     return;
   }
 
+  ++num_tested_cells_;
+
   // TODO(ericv): It may be relatively common to add the same S2CellId
   // multiple times with different labels.  This could be optimized by
   // remembering the last "cell_id" argument and its distance.  However this
@@ -787,6 +1115,21 @@ void S2ClosestCellQueryBase<Distance>::MaybeAddResult(S2CellId cell_id,
   }
 }
 
+// Returns true if the current query has reached one of the work limits
+// specified in options().
+template <class Distance>
+bool S2ClosestCellQueryBase<Distance>::WorkLimitReached() {
+  if (num_visited_cells_ >= options().max_visited_cells() ||
+      num_tested_cells_ >= options().max_tested_cells()) {
+    return true;
+  }
+  // absl::Now() is relatively expensive, so the deadline is only checked on
+  // every 16th call.
+  return (num_work_checks_++ & 15) == 0 &&
+         options().deadline() != absl::InfiniteFuture() &&
+         absl::Now() >= options().deadline();
+}
+
 // Either process the contents of the given cell immediately, or add it to the
 // queue to be subdivided.  If "seek" is false, then "iter" must be positioned
 // at the first non-empty range (if any) with start_id() >= id.range_min().
@@ -796,7 +1139,8 @@ void S2ClosestCellQueryBase<Distance>::MaybeAddResult(S2CellId cell_id,
 // non-empty range (if any) with start_id() > id.range_max().
 template <class Distance>
 bool S2ClosestCellQueryBase<Distance>::ProcessOrEnqueue(
-    S2CellId id, NonEmptyRangeIterator* iter, bool seek) {
+    S2CellId id, NonEmptyRangeIterator* iter, bool seek,
+    ChildCells* children) {
   if (seek) iter->Seek(id.range_min());
   S2CellId last = id.range_max();
   if (iter->start_id() > last) {
@@ -809,16 +1153,10 @@ bool S2ClosestCellQueryBase<Distance>::ProcessOrEnqueue(
   RangeIterator max_it = *iter;
   if (max_it.Advance(kMinRangesToEnqueue - 1) && max_it.start_id() <= last) {
     // This cell intersects at least kMinRangesToEnqueue ranges, so enqueue it.
-    S2Cell cell(id);
-    Distance distance = distance_limit_;
-    // We check "region_" second because it may be relatively expensive.
-    if (target_->UpdateMinDistance(cell, &distance) &&
-        (!options().region() || options().region()->MayIntersect(cell))) {
-      if (use_conservative_cell_distance_) {
-        // Ensure that "distance" is a lower bound on distance to the cell.
-        distance = distance - options().max_error();
-      }
-      queue_.push(QueueEntry(distance, id));
+    if (children) {
+      children->ids[children->size++] = id;
+    } else {
+      MaybeEnqueue(id);
     }
     return true;  // Seek to next child.
   }
@@ -829,6 +1167,54 @@ bool S2ClosestCellQueryBase<Distance>::ProcessOrEnqueue(
   return false;  // No need to seek to next child.
 }
 
+// Adds the given children of "parent" to the queue unless they are too far
+// away or do not intersect options().region().
+template <class Distance>
+void S2ClosestCellQueryBase<Distance>::EnqueueChildren(
+    S2CellId parent, const ChildCells& children) {
+  if (use_child_distances_ && children.size >= kMinChildDistances) {
+    Distance distances[4];
+    if (target_->GetChildCellDistances(S2Cell(parent), distances)) {
+      for (int i = 0; i < children.size; ++i) {
+        const S2CellId id = children.ids[i];
+        const Distance& distance = distances[id.child_position()];
+        if (distance < distance_limit_ &&
+            (!options().region() ||
+             options().region()->MayIntersect(S2Cell(id)))) {
+          Enqueue(id, distance);
+        }
+      }
+      return;
+    }
+    use_child_distances_ = false;
+  }
+  for (int i = 0; i < children.size; ++i) MaybeEnqueue(children.ids[i]);
+}
+
+// Adds the given cell to the queue unless it is too far away or does not
+// intersect options().region().
+template <class Distance>
+void S2ClosestCellQueryBase<Distance>::MaybeEnqueue(S2CellId id) {
+  S2Cell cell(id);
+  Distance distance = distance_limit_;
+  // We check "region_" second because it may be relatively expensive.
+  if (target_->UpdateMinDistance(cell, &distance) &&
+      (!options().region() || options().region()->MayIntersect(cell))) {
+    Enqueue(id, distance);
+  }
+}
+
+// Adds the given cell to the queue, where "distance" is the distance to it.
+template <class Distance>
+inline void S2ClosestCellQueryBase<Distance>::Enqueue(S2CellId id,
+                                                      Distance distance) {
+  if (use_conservative_cell_distance_) {
+    // Ensure that "distance" is a lower bound on distance to the cell.
+    distance = distance - options().max_error();
+  }
+  queue_.push(QueueEntry(distance, id));
+}
+
 template <class Distance>
 void S2ClosestCellQueryBase<Distance>::AddRange(const RangeIterator& range) {
   for (contents_it_.StartUnion(range);
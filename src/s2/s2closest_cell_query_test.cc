@@ -31,6 +31,8 @@
 #include "absl/flags/flag.h"
 #include "absl/log/absl_check.h"
 #include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 
 #include "s2/mutable_s2shape_index.h"
 #include "s2/s1angle.h"
@@ -42,6 +44,7 @@
 #include "s2/s2cell_union.h"
 #include "s2/s2closest_cell_query_base.h"
 #include "s2/s2closest_edge_query_testing.h"
+#include "s2/s2distance_query_stats.h"
 #include "s2/s2edge_distances.h"
 #include "s2/s2latlng.h"
 #include "s2/s2latlng_rect.h"
@@ -175,6 +178,113 @@ TEST(S2ClosestCellQuery, EmptyTargetOptimized) {
   EXPECT_EQ(0, query.FindClosestCells(&target).size());
 }
 
+TEST(S2ClosestCellQuery, WorkLimits) {
+  S2CellIndex index;
+  for (int i = 0; i < 1000; ++i) {
+    index.Add(S2Testing::GetRandomCellId(), i);
+  }
+  index.Build();
+  S2ClosestCellQuery query(&index);
+  query.mutable_options()->set_max_results(5);
+  S2ClosestCellQuery::PointTarget target(S2Testing::RandomPoint());
+  auto expected = query.FindClosestCells(&target);
+  ASSERT_EQ(expected.size(), 5);
+  EXPECT_FALSE(query.last_query_approximate());
+
+  // Approximate results can't be closer than the exact results.
+  auto check_approximate = [&](const vector<S2ClosestCellQuery::Result>&
+                                   actual) {
+    EXPECT_TRUE(query.last_query_approximate());
+    ASSERT_LE(actual.size(), expected.size());
+    for (int i = 0; i < actual.size(); ++i) {
+      EXPECT_LE(expected[i].distance(), actual[i].distance());
+    }
+  };
+  query.mutable_options()->set_max_visited_cells(1);
+  check_approximate(query.FindClosestCells(&target));
+  query.mutable_options()->set_max_visited_cells(
+      S2ClosestCellQuery::Options::kNoWorkLimit);
+
+  // The cell limit is exact when the brute force algorithm is used.
+  query.mutable_options()->set_use_brute_force(true);
+  query.mutable_options()->set_max_tested_cells(10);
+  check_approximate(query.FindClosestCells(&target));
+  query.mutable_options()->set_use_brute_force(false);
+  query.mutable_options()->set_max_tested_cells(
+      S2ClosestCellQuery::Options::kNoWorkLimit);
+
+  query.mutable_options()->set_deadline(absl::InfinitePast());
+  check_approximate(query.FindClosestCells(&target));
+
+  query.mutable_options()->set_deadline(absl::Now() + absl::Hours(1));
+  EXPECT_EQ(query.FindClosestCells(&target), expected);
+  EXPECT_FALSE(query.last_query_approximate());
+}
+
+TEST(S2ClosestCellQuery, BatchQueryMatchesIndividualQueries) {
+  S2Testing::rnd.Reset(1);
+  S2CellIndex index;
+  for (int i = 0; i < 1000; ++i) {
+    index.Add(S2Testing::GetRandomCellId(), i);
+  }
+  index.Build();
+  vector<S2Point> points;
+  for (int i = 0; i < 500; ++i) points.push_back(S2Testing::RandomPoint());
+
+  S2ClosestCellQuery query(&index);
+  for (int max_results :
+       {1, 5, S2ClosestCellQuery::Options::kMaxMaxResults}) {
+    SCOPED_TRACE(absl::StrFormat("max_results = %d", max_results));
+    query.mutable_options()->set_max_results(max_results);
+    query.mutable_options()->set_max_distance(S1Angle::Degrees(5));
+    vector<vector<S2ClosestCellQuery::Result>> expected;
+    for (const S2Point& point : points) {
+      S2ClosestCellQuery::PointTarget target(point);
+      expected.push_back(query.FindClosestCells(&target));
+    }
+    // Repeated calls reuse the query objects of the additional threads.
+    for (int num_threads : {1, 4, 4}) {
+      vector<vector<S2ClosestCellQuery::Result>> actual;
+      query.FindClosestCells(points, &actual, num_threads);
+      EXPECT_EQ(expected, actual) << "num_threads = " << num_threads;
+      EXPECT_FALSE(query.last_query_approximate());
+    }
+  }
+
+  // Statistics are summed over all targets.
+  query.mutable_options()->set_record_stats(true);
+  vector<vector<S2ClosestCellQuery::Result>> results;
+  query.FindClosestCells(points, &results, /*num_threads=*/4);
+  EXPECT_EQ(query.last_query_stats().num_queries, points.size());
+}
+
+TEST(S2ClosestCellQuery, RecordStats) {
+  S2CellIndex index;
+  for (int i = 0; i < 1000; ++i) {
+    index.Add(S2Testing::GetRandomCellId(), i);
+  }
+  index.Build();
+  S2ClosestCellQuery query(&index);
+  query.mutable_options()->set_max_results(5);
+  query.mutable_options()->set_record_stats(true);
+  S2ClosestCellQuery::PointTarget target(S2Testing::RandomPoint());
+  query.FindClosestCells(&target);
+  const S2DistanceQueryStats& stats = query.last_query_stats();
+  EXPECT_EQ(stats.num_queries, 1);
+  EXPECT_EQ(stats.num_brute_force_queries, 0);
+  EXPECT_GT(stats.num_visited_cells, 0);
+  EXPECT_GE(stats.num_queue_pops, stats.num_visited_cells);
+  EXPECT_GE(stats.num_queue_pushes, stats.num_queue_pops);
+  EXPECT_GT(stats.num_distance_tests, 0);
+  EXPECT_LT(stats.num_distance_tests, index.num_cells());
+
+  query.mutable_options()->set_use_brute_force(true);
+  query.FindClosestCells(&target);
+  EXPECT_EQ(stats.num_brute_force_queries, 1);
+  EXPECT_EQ(stats.num_queue_pushes, 0);
+  EXPECT_EQ(stats.num_distance_tests, index.num_cells());
+}
+
 TEST(S2ClosestCellQuery, EmptyCellUnionTarget) {
   // Verifies that distances are measured correctly to empty S2CellUnion
   // targets.
@@ -0,0 +1,465 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2CLOSEST_EDGE_POINT_QUERY_H_
+#define S2_S2CLOSEST_EDGE_POINT_QUERY_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "absl/container/inlined_vector.h"
+#include "absl/log/absl_check.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1chord_angle.h"
+#include "s2/s2cell.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2closest_edge_query.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2edge_distances.h"
+#include "s2/s2point.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+#include "s2/s2shapeutil_count_edges.h"
+#include "s2/s2tuning.h"
+
+// S2ClosestEdgePointQuery is a specialized version of S2ClosestEdgeQuery
+// that finds the closest edge of an S2ShapeIndex to a single point.  It is
+// intended for hot paths that perform many such queries (e.g., snapping GPS
+// fixes to the nearest road).  Compared with S2ClosestEdgeQuery and its
+// PointTarget, it has the following restrictions:
+//
+//  - The target is always a point, and only the single closest edge is
+//    returned (i.e., max_results() == 1 and max_error() == 0).
+//
+//  - Distances are always S1ChordAngles, so no S1Angle conversions are
+//    needed.
+//
+//  - Shape filters, work limits, visitors, and statistics are not supported.
+//
+// In exchange, the distance computations for the point target are inlined
+// rather than dispatched through the S2DistanceTarget interface, and the
+// index is traversed using IndexType::Iterator directly.  When IndexType is
+// MutableS2ShapeIndex (the default), this avoids virtual calls except for
+// fetching the edges of each S2Shape.
+//
+// The results are the same as S2ClosestEdgeQuery::FindClosestEdge() with a
+// PointTarget, except that if several edges are at exactly the same distance
+// then either one may be returned.  Example usage:
+//
+//   S2ClosestEdgePointQuery<MutableS2ShapeIndex> query(&road_index);
+//   query.mutable_options()->set_max_distance(S1ChordAngle::Degrees(0.01));
+//   for (const S2Point& fix : gps_fixes) {
+//     S2ClosestEdgeQuery::Result result = query.FindClosestEdge(fix);
+//     if (!result.is_empty()) { ... }
+//   }
+//
+// This class is not thread-safe.  To use it in parallel, each thread should
+// construct its own instance.
+template <class IndexType = MutableS2ShapeIndex>
+class S2ClosestEdgePointQuery {
+ public:
+  using Iterator = typename IndexType::Iterator;
+  using Result = S2ClosestEdgeQuery::Result;
+
+  class Options {
+   public:
+    // Specifies that only edges whose distance to the target is less than
+    // "max_distance" should be returned.
+    //
+    // DEFAULT: S1ChordAngle::Infinity()
+    S1ChordAngle max_distance() const { return max_distance_; }
+    void set_max_distance(S1ChordAngle max_distance) {
+      max_distance_ = max_distance;
+    }
+
+    // Like set_max_distance(), except that edges whose distance is exactly
+    // equal to "max_distance" are also returned.
+    void set_inclusive_max_distance(S1ChordAngle max_distance) {
+      max_distance_ = max_distance.Successor();
+    }
+
+    // Specifies that polygon interiors should be included when measuring
+    // distances, as in S2ClosestEdgeQuery::Options::include_interiors().
+    //
+    // DEFAULT: true
+    bool include_interiors() const { return include_interiors_; }
+    void set_include_interiors(bool include_interiors) {
+      include_interiors_ = include_interiors;
+    }
+
+    // Specifies that edges should be tested exhaustively rather than by
+    // traversing the index (this is mainly useful for testing).
+    //
+    // DEFAULT: false
+    bool use_brute_force() const { return use_brute_force_; }
+    void set_use_brute_force(bool use_brute_force) {
+      use_brute_force_ = use_brute_force;
+    }
+
+   private:
+    S1ChordAngle max_distance_ = S1ChordAngle::Infinity();
+    bool include_interiors_ = true;
+    bool use_brute_force_ = false;
+  };
+
+  // Default constructor; requires Init() to be called.
+  S2ClosestEdgePointQuery() = default;
+
+  // Convenience constructor that calls Init().
+  explicit S2ClosestEdgePointQuery(const IndexType* index,
+                                   const Options& options = Options());
+
+  // Initializes the query.  The index must persist for the lifetime of this
+  // object.  ReInit() must be called if the index is modified.
+  void Init(const IndexType* index, const Options& options = Options());
+
+  // Reinitializes the query.  This method must be called whenever the
+  // underlying index is modified.
+  void ReInit();
+
+  const IndexType& index() const { return *index_; }
+  const Options& options() const { return options_; }
+  Options* mutable_options() { return &options_; }
+
+  // Returns the closest edge to "point".  If no edge satisfies the search
+  // criteria, then the Result object will have distance == Infinity() and
+  // shape_id == edge_id == -1.  If "point" is contained by a polygon and
+  // include_interiors() is true, then the result has distance == Zero() and
+  // edge_id == -1 (see S2ClosestEdgeQuery::Result).
+  Result FindClosestEdge(const S2Point& point);
+
+  // Returns the minimum distance to "point", or S1ChordAngle::Infinity() if
+  // the index is empty.  Note that max_distance() is ignored.
+  S1ChordAngle GetDistance(const S2Point& point);
+
+  // Returns true if the distance to "point" is less than "limit".  This is
+  // faster than GetDistance() since the search stops as soon as any edge
+  // closer than "limit" is found.  Note that max_distance() is ignored.
+  bool IsDistanceLess(const S2Point& point, S1ChordAngle limit);
+
+ private:
+  // An S2CellId to be processed, together with its distance to the target
+  // and its S2ShapeIndexCell (or nullptr if "id" is not an index cell).
+  struct QueueEntry {
+    S1ChordAngle distance;
+    S2CellId id;
+    const S2ShapeIndexCell* index_cell;
+
+    // The queue is a min-heap ordered by distance.
+    bool operator<(const QueueEntry& other) const {
+      return other.distance < distance;
+    }
+  };
+
+  void FindClosestEdgeInternal(const S2Point& point, S1ChordAngle limit,
+                               bool stop_at_any);
+  void FindClosestEdgeBruteForce();
+  void FindClosestEdgeOptimized();
+  void InitCovering();
+  void AddInitialRange(const Iterator& first, const Iterator& last);
+  void ProcessEdges(const S2ShapeIndexCell& index_cell);
+  void ProcessOrEnqueue(S2CellId id, const S2ShapeIndexCell* index_cell,
+                        S1ChordAngle distance);
+  void AddResult(S1ChordAngle distance, int shape_id, int edge_id);
+
+  Options options_;
+  const IndexType* index_ = nullptr;
+
+  // The number of edges in the index, up to the brute force threshold.
+  int index_num_edges_ = -1;
+
+  // The top-level cells that cover the index and the corresponding index
+  // cells (or nullptr), computed lazily as in S2ClosestEdgeQueryBase.
+  std::vector<S2CellId> index_covering_;
+  absl::InlinedVector<const S2ShapeIndexCell*, 6> index_cells_;
+
+  Iterator iter_;
+  S2ContainsPointQuery<IndexType> contains_query_;
+  bool contains_query_initialized_ = false;
+
+  // State of the current query.
+  S2Point point_;
+  S1ChordAngle distance_limit_;
+  bool stop_at_any_ = false;
+  Result result_;
+  std::vector<QueueEntry> queue_;  // Reused between queries.
+};
+
+// Returns an S2ClosestEdgePointQuery for the given S2ShapeIndex.  Example:
+//
+//   auto query = MakeS2ClosestEdgePointQuery(&index);
+//   S1ChordAngle distance = query.GetDistance(point);
+//
+// This is simply a convenience function that avoids the need to specify
+// the IndexType template argument.
+template <class IndexType>
+inline S2ClosestEdgePointQuery<IndexType> MakeS2ClosestEdgePointQuery(
+    const IndexType* index,
+    const typename S2ClosestEdgePointQuery<IndexType>::Options& options =
+        typename S2ClosestEdgePointQuery<IndexType>::Options()) {
+  return S2ClosestEdgePointQuery<IndexType>(index, options);
+}
+
+
+//////////////////   Implementation details follow   ////////////////////
+
+
+template <class IndexType>
+S2ClosestEdgePointQuery<IndexType>::S2ClosestEdgePointQuery(
+    const IndexType* index, const Options& options) {
+  Init(index, options);
+}
+
+template <class IndexType>
+void S2ClosestEdgePointQuery<IndexType>::Init(const IndexType* index,
+                                              const Options& options) {
+  options_ = options;
+  index_ = index;
+  ReInit();
+}
+
+template <class IndexType>
+void S2ClosestEdgePointQuery<IndexType>::ReInit() {
+  index_num_edges_ = -1;
+  index_covering_.clear();
+  index_cells_.clear();
+  contains_query_initialized_ = false;
+  // We don't initialize iter_ here to make queries on small indexes a bit
+  // faster (i.e., where brute force is used).
+}
+
+template <class IndexType>
+inline typename S2ClosestEdgePointQuery<IndexType>::Result
+S2ClosestEdgePointQuery<IndexType>::FindClosestEdge(const S2Point& point) {
+  FindClosestEdgeInternal(point, options_.max_distance(), false);
+  return result_;
+}
+
+template <class IndexType>
+inline S1ChordAngle S2ClosestEdgePointQuery<IndexType>::GetDistance(
+    const S2Point& point) {
+  FindClosestEdgeInternal(point, S1ChordAngle::Infinity(), false);
+  return S1ChordAngle(result_.distance());
+}
+
+template <class IndexType>
+inline bool S2ClosestEdgePointQuery<IndexType>::IsDistanceLess(
+    const S2Point& point, S1ChordAngle limit) {
+  FindClosestEdgeInternal(point, limit, true);
+  return !result_.is_empty();
+}
+
+template <class IndexType>
+void S2ClosestEdgePointQuery<IndexType>::FindClosestEdgeInternal(
+    const S2Point& point, S1ChordAngle limit, bool stop_at_any) {
+  point_ = point;
+  distance_limit_ = limit;
+  stop_at_any_ = stop_at_any;
+  result_ = Result();
+  if (distance_limit_ == S1ChordAngle::Zero()) return;
+
+  if (options_.include_interiors()) {
+    if (!contains_query_initialized_) {
+      contains_query_.Init(index_);
+      contains_query_initialized_ = true;
+    }
+    // As with S2ClosestEdgeQuery, the first containing shape is returned.
+    contains_query_.VisitContainingShapeIds(point, [this](int shape_id) {
+      AddResult(S1ChordAngle::Zero(), shape_id, -1);
+      return false;
+    });
+    if (distance_limit_ == S1ChordAngle::Zero()) return;
+  }
+
+  // Use the brute force algorithm if the index is small enough.
+  const int min_optimized_edges =
+      s2tuning::max_brute_force_closest_edge_point_target() + 1;
+  if (index_num_edges_ < 0) {
+    index_num_edges_ = s2shapeutil::CountEdgesUpTo(*index_,
+                                                   min_optimized_edges);
+  }
+  if (options_.use_brute_force() || index_num_edges_ < min_optimized_edges) {
+    FindClosestEdgeBruteForce();
+  } else {
+    FindClosestEdgeOptimized();
+  }
+}
+
+template <class IndexType>
+void S2ClosestEdgePointQuery<IndexType>::FindClosestEdgeBruteForce() {
+  const int num_shape_ids = index_->num_shape_ids();
+  for (int shape_id = 0; shape_id < num_shape_ids; ++shape_id) {
+    const S2Shape* shape = index_->shape(shape_id);
+    if (shape == nullptr) continue;
+    const int num_edges = shape->num_edges();
+    for (int e = 0; e < num_edges; ++e) {
+      S2Shape::Edge edge = shape->edge(e);
+      S1ChordAngle distance = distance_limit_;
+      if (S2::UpdateMinDistance(point_, edge.v0, edge.v1, &distance)) {
+        AddResult(distance, shape_id, e);
+        if (distance_limit_ == S1ChordAngle::Zero()) return;
+      }
+    }
+  }
+}
+
+template <class IndexType>
+void S2ClosestEdgePointQuery<IndexType>::FindClosestEdgeOptimized() {
+  if (index_covering_.empty()) {
+    iter_.Init(index_, S2ShapeIndex::UNPOSITIONED);
+    InitCovering();
+  }
+  // First process the edges of the index cell containing the target (if
+  // any), which usually limits the search to a small disc around it.
+  if (iter_.Locate(point_)) {
+    ProcessEdges(iter_.cell());
+    if (distance_limit_ == S1ChordAngle::Zero()) return;
+  }
+  ABSL_DCHECK(queue_.empty());
+  for (size_t i = 0; i < index_covering_.size(); ++i) {
+    S2CellId id = index_covering_[i];
+    ProcessOrEnqueue(id, index_cells_[i], S2Cell(id).GetDistance(point_));
+  }
+  // Repeatedly find the closest S2Cell to the target and either split it
+  // into its four children or process all of its edges.
+  while (!queue_.empty()) {
+    std::pop_heap(queue_.begin(), queue_.end());
+    QueueEntry entry = queue_.back();
+    queue_.pop_back();
+    if (!(entry.distance < distance_limit_)) break;
+    if (entry.index_cell != nullptr) {
+      ProcessEdges(*entry.index_cell);
+      continue;
+    }
+    // Otherwise split the cell into its four children, skipping children
+    // that do not contain any index cells (see S2ClosestEdgeQueryBase).
+    S2CellId id = entry.id;
+    S1ChordAngle distances[4];
+    S2Cell(id).GetChildDistances(point_, distances);
+    iter_.Seek(id.child(1).range_min());
+    if (!iter_.done() && iter_.id() <= id.child(1).range_max()) {
+      ProcessOrEnqueue(id.child(1),
+                       iter_.id() == id.child(1) ? &iter_.cell() : nullptr,
+                       distances[1]);
+    }
+    if (iter_.Prev() && iter_.id() >= id.range_min()) {
+      ProcessOrEnqueue(id.child(0),
+                       iter_.id() == id.child(0) ? &iter_.cell() : nullptr,
+                       distances[0]);
+    }
+    iter_.Seek(id.child(3).range_min());
+    if (!iter_.done() && iter_.id() <= id.range_max()) {
+      ProcessOrEnqueue(id.child(3),
+                       iter_.id() == id.child(3) ? &iter_.cell() : nullptr,
+                       distances[3]);
+    }
+    if (iter_.Prev() && iter_.id() >= id.child(2).range_min()) {
+      ProcessOrEnqueue(id.child(2),
+                       iter_.id() == id.child(2) ? &iter_.cell() : nullptr,
+                       distances[2]);
+    }
+  }
+  queue_.clear();  // Clear any remaining entries.
+}
+
+// Computes the top-level cells that cover the index, exactly as
+// S2ClosestEdgeQueryBase::InitCovering() does.
+template <class IndexType>
+void S2ClosestEdgePointQuery<IndexType>::InitCovering() {
+  index_covering_.reserve(6);
+  Iterator next(index_, S2ShapeIndex::BEGIN);
+  Iterator last(index_, S2ShapeIndex::END);
+  if (next.done()) return;  // Empty index.
+  last.Prev();
+  if (next.id() != last.id()) {
+    int level = next.id().GetCommonAncestorLevel(last.id()) + 1;
+    S2CellId last_id = last.id().parent(level);
+    for (S2CellId id = next.id().parent(level); id != last_id; id = id.next()) {
+      if (id.range_max() < next.id()) continue;
+      Iterator cell_first = next;
+      next.Seek(id.range_max().next());
+      Iterator cell_last = next;
+      cell_last.Prev();
+      AddInitialRange(cell_first, cell_last);
+    }
+  }
+  AddInitialRange(next, last);
+}
+
+template <class IndexType>
+void S2ClosestEdgePointQuery<IndexType>::AddInitialRange(
+    const Iterator& first, const Iterator& last) {
+  if (first.id() == last.id()) {
+    index_covering_.push_back(first.id());
+    index_cells_.push_back(&first.cell());
+  } else {
+    int level = first.id().GetCommonAncestorLevel(last.id());
+    ABSL_DCHECK_GE(level, 0);
+    index_covering_.push_back(first.id().parent(level));
+    index_cells_.push_back(nullptr);
+  }
+}
+
+template <class IndexType>
+void S2ClosestEdgePointQuery<IndexType>::ProcessEdges(
+    const S2ShapeIndexCell& index_cell) {
+  for (int s = 0; s < index_cell.num_clipped(); ++s) {
+    const S2ClippedShape& clipped = index_cell.clipped(s);
+    const int shape_id = clipped.shape_id();
+    const S2Shape* shape = index_->shape(shape_id);
+    const int num_edges = clipped.num_edges();
+    for (int j = 0; j < num_edges; ++j) {
+      const int edge_id = clipped.edge(j);
+      S2Shape::Edge edge = shape->edge(edge_id);
+      S1ChordAngle distance = distance_limit_;
+      if (S2::UpdateMinDistance(point_, edge.v0, edge.v1, &distance)) {
+        AddResult(distance, shape_id, edge_id);
+        if (distance_limit_ == S1ChordAngle::Zero()) return;
+      }
+    }
+  }
+}
+
+// Processes the edges of "index_cell" immediately if it has only a few of
+// them, skips it if it has no edges, and otherwise adds the cell to the
+// queue if it is closer than distance_limit_.
+template <class IndexType>
+void S2ClosestEdgePointQuery<IndexType>::ProcessOrEnqueue(
+    S2CellId id, const S2ShapeIndexCell* index_cell, S1ChordAngle distance) {
+  if (!(distance < distance_limit_)) return;
+  if (index_cell != nullptr) {
+    static constexpr int kMinEdgesToEnqueue = 10;
+    int num_edges = 0;
+    for (int s = 0; s < index_cell->num_clipped(); ++s) {
+      num_edges += index_cell->clipped(s).num_edges();
+    }
+    if (num_edges == 0) return;
+    if (num_edges < kMinEdgesToEnqueue) {
+      ProcessEdges(*index_cell);
+      return;
+    }
+  }
+  queue_.push_back(QueueEntry{distance, id, index_cell});
+  std::push_heap(queue_.begin(), queue_.end());
+}
+
+template <class IndexType>
+inline void S2ClosestEdgePointQuery<IndexType>::AddResult(
+    S1ChordAngle distance, int shape_id, int edge_id) {
+  result_ = Result(S2MinDistance(distance), shape_id, edge_id);
+  distance_limit_ = stop_at_any_ ? S1ChordAngle::Zero() : distance;
+}
+
+#endif  // S2_S2CLOSEST_EDGE_POINT_QUERY_H_
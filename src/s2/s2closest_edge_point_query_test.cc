@@ -0,0 +1,141 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2closest_edge_point_query.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "absl/strings/str_cat.h"
+
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s1chord_angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2closest_edge_query.h"
+#include "s2/s2closest_edge_query_testing.h"
+#include "s2/s2edge_distances.h"
+#include "s2/s2point.h"
+#include "s2/s2point_vector_shape.h"
+#include "s2/s2shape.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+
+using s2textformat::MakeIndexOrDie;
+using s2textformat::MakePointOrDie;
+using std::make_unique;
+using std::vector;
+
+TEST(S2ClosestEdgePointQuery, NoEdges) {
+  MutableS2ShapeIndex index;
+  auto query = MakeS2ClosestEdgePointQuery(&index);
+  auto result = query.FindClosestEdge(S2Point(1, 0, 0));
+  EXPECT_TRUE(result.is_empty());
+  EXPECT_EQ(S1ChordAngle::Infinity(), query.GetDistance(S2Point(1, 0, 0)));
+  EXPECT_FALSE(query.IsDistanceLess(S2Point(1, 0, 0),
+                                    S1ChordAngle::Infinity()));
+}
+
+TEST(S2ClosestEdgePointQuery, TargetPointInsideIndexedPolygon) {
+  auto index = MakeIndexOrDie("# 0:0, 0:5, 5:5, 5:0 # 0:10, 0:15, 5:15, 5:10");
+  auto query = MakeS2ClosestEdgePointQuery(index.get());
+  auto result = query.FindClosestEdge(MakePointOrDie("2:12"));
+  EXPECT_EQ(S1ChordAngle::Zero(), S1ChordAngle(result.distance()));
+  EXPECT_EQ(1, result.shape_id());
+  EXPECT_EQ(-1, result.edge_id());
+  EXPECT_TRUE(result.is_interior());
+
+  query.mutable_options()->set_include_interiors(false);
+  result = query.FindClosestEdge(MakePointOrDie("2:12"));
+  EXPECT_EQ(1, result.shape_id());
+  EXPECT_NE(-1, result.edge_id());
+  EXPECT_LT(S1ChordAngle::Zero(), S1ChordAngle(result.distance()));
+}
+
+TEST(S2ClosestEdgePointQuery, MaxDistance) {
+  auto index = MakeIndexOrDie("1:1 | 1:2 | 1:3 # #");
+  auto query = MakeS2ClosestEdgePointQuery(index.get());
+  S2Point target = MakePointOrDie("2:2");
+  S1ChordAngle distance(S2Point(MakePointOrDie("1:2")), target);
+  query.mutable_options()->set_max_distance(distance);
+  EXPECT_TRUE(query.FindClosestEdge(target).is_empty());
+  query.mutable_options()->set_inclusive_max_distance(distance);
+  auto result = query.FindClosestEdge(target);
+  EXPECT_EQ(0, result.shape_id());
+  EXPECT_EQ(1, result.edge_id());
+  EXPECT_EQ(distance, S1ChordAngle(result.distance()));
+}
+
+TEST(S2ClosestEdgePointQuery, ReInitAfterIndexModified) {
+  auto index = MakeIndexOrDie("2:2 # #");
+  auto query = MakeS2ClosestEdgePointQuery(index.get());
+  S2Point target = MakePointOrDie("1:1");
+  EXPECT_EQ(S1ChordAngle(MakePointOrDie("2:2"), target),
+            query.GetDistance(target));
+  index->Add(make_unique<S2PointVectorShape>(
+      vector<S2Point>{MakePointOrDie("1:1.5")}));
+  query.ReInit();
+  EXPECT_EQ(S1ChordAngle(MakePointOrDie("1:1.5"), target),
+            query.GetDistance(target));
+}
+
+// Checks that S2ClosestEdgePointQuery returns the same distances as
+// S2ClosestEdgeQuery with a PointTarget, for both the brute force and the
+// optimized algorithms.
+TEST(S2ClosestEdgePointQuery, MatchesS2ClosestEdgeQuery) {
+  S2Testing::rnd.Reset(1);
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+  MutableS2ShapeIndex index;
+  s2testing::FractalLoopShapeIndexFactory().AddEdges(cap, 1000, &index);
+  index.Add(make_unique<S2PointVectorShape>(vector<S2Point>(
+      {S2Testing::SamplePoint(cap), S2Testing::SamplePoint(cap)})));
+
+  S2ClosestEdgeQuery expected_query(&index);
+  auto query = MakeS2ClosestEdgePointQuery(&index);
+  for (bool use_brute_force : {false, true}) {
+    for (bool include_interiors : {false, true}) {
+      SCOPED_TRACE(absl::StrCat("use_brute_force = ", use_brute_force,
+                                ", include_interiors = ", include_interiors));
+      query.mutable_options()->set_use_brute_force(use_brute_force);
+      query.mutable_options()->set_include_interiors(include_interiors);
+      expected_query.mutable_options()->set_include_interiors(
+          include_interiors);
+      for (int i = 0; i < 200; ++i) {
+        S2Point point =
+            S2Testing::SamplePoint(S2Cap(cap.center(), S1Angle::Degrees(2)));
+        S2ClosestEdgeQuery::PointTarget target(point);
+        auto expected = expected_query.FindClosestEdge(&target);
+        auto actual = query.FindClosestEdge(point);
+        ASSERT_EQ(expected.distance(), actual.distance());
+        ASSERT_EQ(expected.is_interior(), actual.is_interior());
+        if (!actual.is_interior()) {
+          // Several edges may be at the same distance, so check that the
+          // returned edge is really at the returned distance.
+          S2Shape::Edge edge =
+              index.shape(actual.shape_id())->edge(actual.edge_id());
+          S1ChordAngle edge_distance = S1ChordAngle::Infinity();
+          S2::UpdateMinDistance(point, edge.v0, edge.v1, &edge_distance);
+          EXPECT_EQ(S1ChordAngle(actual.distance()), edge_distance);
+        }
+        S1ChordAngle distance = query.GetDistance(point);
+        EXPECT_EQ(S1ChordAngle(expected.distance()), distance);
+        EXPECT_FALSE(query.IsDistanceLess(point, distance));
+        EXPECT_TRUE(query.IsDistanceLess(point, distance.Successor()));
+      }
+    }
+  }
+}
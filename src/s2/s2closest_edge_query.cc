@@ -17,10 +17,17 @@
 
 #include "s2/s2closest_edge_query.h"
 
+#include <vector>
+
+#include "absl/types/span.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s2closest_edge_query_base.h"
 #include "s2/s2edge_distances.h"
+#include "s2/s2point.h"
+#include "s2/s2tuning.h"
+
+using std::vector;
 
 void S2ClosestEdgeQuery::Options::set_conservative_max_distance(
     S1ChordAngle max_distance) {
@@ -33,33 +40,22 @@ void S2ClosestEdgeQuery::Options::set_conservative_max_distance(
   set_conservative_max_distance(S1ChordAngle(max_distance));
 }
 
+// The break-even points for each target type are documented in s2tuning.h.
+
 int S2ClosestEdgeQuery::PointTarget::max_brute_force_index_size() const {
-  // Using BM_FindClosest (which finds the single closest edge), the
-  // break-even points are approximately 80, 100, and 250 edges for point
-  // cloud, fractal, and regular loop geometry respectively.
-  return 120;
+  return s2tuning::max_brute_force_closest_edge_point_target();
 }
 
 int S2ClosestEdgeQuery::EdgeTarget::max_brute_force_index_size() const {
-  // Using BM_FindClosestToEdge (which finds the single closest edge), the
-  // break-even points are approximately 40, 50, and 100 edges for point
-  // cloud, fractal, and regular loop geometry respectively.
-  return 60;
+  return s2tuning::max_brute_force_closest_edge_edge_target();
 }
 
 int S2ClosestEdgeQuery::CellTarget::max_brute_force_index_size() const {
-  // Using BM_FindClosestToCell (which finds the single closest edge), the
-  // break-even points are approximately 20, 25, and 40 edges for point cloud,
-  // fractal, and regular loop geometry respectively.
-  return 30;
+  return s2tuning::max_brute_force_closest_edge_cell_target();
 }
 
 int S2ClosestEdgeQuery::ShapeIndexTarget::max_brute_force_index_size() const {
-  // For BM_FindClosestToSameSizeAbuttingIndex (which uses two nearby indexes
-  // with similar edge counts), the break-even points are approximately 20,
-  // 30, and 40 edges for point cloud, fractal, and regular loop geometry
-  // respectively.
-  return 25;
+  return s2tuning::max_brute_force_closest_edge_index_target();
 }
 
 S2ClosestEdgeQuery::S2ClosestEdgeQuery() {
@@ -72,7 +68,7 @@ S2ClosestEdgeQuery::~S2ClosestEdgeQuery() {
 
 bool S2ClosestEdgeQuery::IsDistanceLess(Target* target, S1ChordAngle limit,
                                         ShapeFilter filter) {
-  static_assert(sizeof(Options) <= 32, "Consider not copying Options here");
+  static_assert(sizeof(Options) <= 64, "Consider not copying Options here");
   Options tmp_options = options_;
   tmp_options.set_max_results(1);
   tmp_options.set_max_distance(limit);
@@ -83,7 +79,7 @@ bool S2ClosestEdgeQuery::IsDistanceLess(Target* target, S1ChordAngle limit,
 bool S2ClosestEdgeQuery::IsDistanceLessOrEqual(Target* target,
                                                S1ChordAngle limit,
                                                ShapeFilter filter) {
-  static_assert(sizeof(Options) <= 32, "Consider not copying Options here");
+  static_assert(sizeof(Options) <= 64, "Consider not copying Options here");
   Options tmp_options = options_;
   tmp_options.set_max_results(1);
   tmp_options.set_inclusive_max_distance(limit);
@@ -94,10 +90,23 @@ bool S2ClosestEdgeQuery::IsDistanceLessOrEqual(Target* target,
 bool S2ClosestEdgeQuery::IsConservativeDistanceLessOrEqual(Target* target,
                                                            S1ChordAngle limit,
                                                            ShapeFilter filter) {
-  static_assert(sizeof(Options) <= 32, "Consider not copying Options here");
+  static_assert(sizeof(Options) <= 64, "Consider not copying Options here");
   Options tmp_options = options_;
   tmp_options.set_max_results(1);
   tmp_options.set_conservative_max_distance(limit);
   tmp_options.set_max_error(S1ChordAngle::Straight());
   return !base_.FindClosestEdge(target, tmp_options, filter).is_empty();
 }
+
+void S2ClosestEdgeQuery::FindClosestEdges(absl::Span<const S2Point> points,
+                                          vector<vector<Result>>* results,
+                                          int num_threads,
+                                          ShapeFilter filter) {
+  vector<PointTarget> point_targets;
+  point_targets.reserve(points.size());
+  for (const S2Point& point : points) point_targets.emplace_back(point);
+  vector<Target*> targets;
+  targets.reserve(points.size());
+  for (PointTarget& target : point_targets) targets.push_back(&target);
+  FindClosestEdges(targets, results, num_threads, filter);
+}
@@ -25,12 +25,14 @@
 
 #include "absl/base/macros.h"
 #include "absl/container/inlined_vector.h"
+#include "absl/types/span.h"
 #include "s2/_fp_contract_off.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2closest_edge_query_base.h"
+#include "s2/s2distance_query_stats.h"
 #include "s2/s2edge_distances.h"
 #include "s2/s2min_distance_targets.h"
 #include "s2/s2point.h"
@@ -256,6 +258,15 @@ class S2ClosestEdgeQuery {
   const Options& options() const;
   Options* mutable_options();
 
+  // Returns true if the most recent query stopped early because it reached
+  // one of the work limits in Options (max_visited_cells(), etc), in which
+  // case the results are the best edges found so far.
+  bool last_query_approximate() const;
+
+  // Returns statistics about the most recent query for which
+  // options().record_stats() was true.
+  const S2DistanceQueryStats& last_query_stats() const;
+
   // Returns the closest edges to the given target that satisfy the current
   // options.  This method may be called multiple times.
   //
@@ -270,6 +281,36 @@ class S2ClosestEdgeQuery {
   void FindClosestEdges(Target* target, std::vector<Result>* results,
                         ShapeFilter filter = {});
 
+  // Finds the closest edges to each of the given targets, storing the results
+  // for targets[i] in (*results)[i].  This is equivalent to calling
+  // FindClosestEdges() on each target, but is faster when there are many
+  // targets (see S2ClosestEdgeQueryBase for details).  If num_threads > 1,
+  // the targets are processed concurrently and must not share mutable state.
+  void FindClosestEdges(absl::Span<Target* const> targets,
+                        std::vector<std::vector<Result>>* results,
+                        int num_threads = 1, ShapeFilter filter = {});
+
+  // Convenience version of the method above that finds the closest edges to
+  // each of the given points.
+  void FindClosestEdges(absl::Span<const S2Point> points,
+                        std::vector<std::vector<Result>>* results,
+                        int num_threads = 1, ShapeFilter filter = {});
+
+  // Visits the closest edges to the given target in order of increasing
+  // distance, terminating early if "visitor" returns false (in which case
+  // this method returns false as well).  Each result is visited as soon as
+  // it is known to be the next closest, so this method is much faster than
+  // FindClosestEdges() when only the first few results are needed, and it
+  // reuses the query's internal storage so that steady-state queries usually
+  // don't allocate memory.  Note that options().max_error() is ignored.
+  //
+  //   query.VisitClosestEdges(&target, [&](const Result& result) {
+  //     return !IsAcceptable(result);  // Stop at the first acceptable edge.
+  //   });
+  using ResultVisitor = Base::ResultVisitor;
+  bool VisitClosestEdges(Target* target, ResultVisitor visitor,
+                         ShapeFilter filter = {});
+
   //////////////////////// Convenience Methods ////////////////////////
 
   // Returns the closest edge to the target.  If no edge satisfies the search
@@ -403,6 +444,15 @@ inline S2ClosestEdgeQuery::Options* S2ClosestEdgeQuery::mutable_options() {
   return &options_;
 }
 
+inline bool S2ClosestEdgeQuery::last_query_approximate() const {
+  return base_.last_query_approximate();
+}
+
+inline const S2DistanceQueryStats& S2ClosestEdgeQuery::last_query_stats()
+    const {
+  return base_.last_query_stats();
+}
+
 inline std::vector<S2ClosestEdgeQuery::Result>
 S2ClosestEdgeQuery::FindClosestEdges(Target* target, ShapeFilter filter) {
   return base_.FindClosestEdges(target, options_, filter);
@@ -414,9 +464,22 @@ inline void S2ClosestEdgeQuery::FindClosestEdges(Target* target,
   base_.FindClosestEdges(target, options_, results, filter);
 }
 
+inline void S2ClosestEdgeQuery::FindClosestEdges(
+    absl::Span<Target* const> targets,
+    std::vector<std::vector<Result>>* results, int num_threads,
+    ShapeFilter filter) {
+  base_.FindClosestEdges(targets, options_, results, num_threads, filter);
+}
+
+inline bool S2ClosestEdgeQuery::VisitClosestEdges(Target* target,
+                                                  ResultVisitor visitor,
+                                                  ShapeFilter filter) {
+  return base_.VisitClosestEdges(target, options_, visitor, filter);
+}
+
 inline S2ClosestEdgeQuery::Result S2ClosestEdgeQuery::FindClosestEdge(
     Target* target, ShapeFilter filter) {
-  static_assert(sizeof(Options) <= 32, "Consider not copying Options here");
+  static_assert(sizeof(Options) <= 64, "Consider not copying Options here");
   Options tmp_options = options_;
   tmp_options.set_max_results(1);
   return base_.FindClosestEdge(target, tmp_options, filter);
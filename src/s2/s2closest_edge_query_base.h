@@ -19,6 +19,7 @@
 #define S2_S2CLOSEST_EDGE_QUERY_BASE_H_
 
 #include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <iterator>
@@ -26,17 +27,23 @@
 #include <memory>
 #include <optional>
 #include <queue>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "s2/base/port.h"
 #include "s2/base/types.h"
 #include "absl/container/btree_set.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/container/inlined_vector.h"
+#include "absl/flags/flag.h"
 #include "absl/functional/function_ref.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "s2/_fp_contract_off.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
@@ -44,13 +51,17 @@
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_union.h"
+#include "s2/s2distance_query_stats.h"
 #include "s2/s2distance_target.h"
+#include "s2/s2index_edge_cache.h"
+#include "s2/s2memory_tracker.h"
 #include "s2/s2point.h"
 #include "s2/s2region_coverer.h"
 #include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
 #include "s2/s2shapeutil_count_edges.h"
 #include "s2/s2shapeutil_shape_edge_id.h"
+#include "s2/s2telemetry.h"
 
 // S2ClosestEdgeQueryBase is a templatized class for finding the closest
 // edge(s) between two geometries.  It is not intended to be used directly,
@@ -158,12 +169,83 @@ class S2ClosestEdgeQueryBase {
     bool use_brute_force() const;
     void set_use_brute_force(bool use_brute_force);
 
+    // The following options bound the amount of work done by each query.
+    // When a limit is reached the search stops and the best results found so
+    // far are returned, and last_query_approximate() returns true.  Such
+    // results satisfy max_results() and max_distance(), but closer edges
+    // may exist.  This can be used to bound the latency of queries with
+    // pathological targets (e.g., very large S2ShapeIndex targets).
+
+    // Specifies the maximum number of cells that are removed from the
+    // priority queue and then either subdivided or processed.
+    //
+    // DEFAULT: kNoWorkLimit
+    int max_visited_cells() const;
+    void set_max_visited_cells(int max_visited_cells);
+    static constexpr int kNoWorkLimit = std::numeric_limits<int>::max();
+
+    // Specifies the maximum number of edges whose distance to the target is
+    // computed.  Note that when the index is used this limit is only checked
+    // between index cells, so it may be exceeded by the number of edges in
+    // one cell.
+    //
+    // DEFAULT: kNoWorkLimit
+    int max_tested_edges() const;
+    void set_max_tested_edges(int max_tested_edges);
+
+    // Specifies a time after which the search should stop.  The deadline is
+    // checked periodically rather than after every step, so queries may run
+    // slightly past it.
+    //
+    // DEFAULT: absl::InfiniteFuture()
+    absl::Time deadline() const;
+    void set_deadline(absl::Time deadline);
+
+    // Specifies that the memory used by the priority queue and the candidate
+    // results of each query should be tracked using the given
+    // S2MemoryTracker.  If the tracker's memory limit would be exceeded (or
+    // its periodic callback cancels the operation), the search stops in the
+    // same way as when a work limit is reached: the best results found so
+    // far are returned and last_query_approximate() returns true.  The
+    // reason is available as memory_tracker()->error(), e.g.
+    // S2Error::RESOURCE_EXHAUSTED.  The tracked memory is released when
+    // each query finishes.
+    //
+    // DEFAULT: nullptr (memory tracking is disabled)
+    S2MemoryTracker* memory_tracker() const;
+    void set_memory_tracker(S2MemoryTracker* tracker);
+
+    // Specifies that statistics about each query should be recorded (see
+    // last_query_stats).  Otherwise no statistics are recorded, which adds
+    // no overhead.
+    //
+    // DEFAULT: false
+    bool record_stats() const;
+    void set_record_stats(bool record_stats);
+
+    // If non-null, the edges of each index cell are fetched from this cache,
+    // so that repeated queries that visit the same cells do not fetch the
+    // same edges from their shapes again (see S2IndexEdgeCache).  The cache
+    // is not thread-safe and is typically shared by all the queries of one
+    // thread.
+    //
+    // DEFAULT: nullptr
+    S2IndexEdgeCache* edge_cache() const;
+    void set_edge_cache(S2IndexEdgeCache* edge_cache);
+
    private:
     Distance max_distance_ = Distance::Infinity();
     Delta max_error_ = Delta::Zero();
     int max_results_ = kMaxMaxResults;
+    int max_visited_cells_ = kNoWorkLimit;
+    int max_tested_edges_ = kNoWorkLimit;
+    // The flags are declared here to fill the padding before deadline_.
     bool include_interiors_ = true;
     bool use_brute_force_ = false;
+    bool record_stats_ = false;
+    absl::Time deadline_ = absl::InfiniteFuture();
+    S2MemoryTracker* memory_tracker_ = nullptr;
+    S2IndexEdgeCache* edge_cache_ = nullptr;
   };
 
   // The Target class represents the geometry to which the distance is
@@ -288,11 +370,63 @@ class S2ClosestEdgeQueryBase {
   Result FindClosestEdge(Target* target, const Options& options,
                          ShapeFilter filter = {});
 
+  // Finds the closest edges to each of the given targets, storing the results
+  // for targets[i] in (*results)[i].  The results are identical to calling
+  // FindClosestEdges() on each target in turn, but this method is faster
+  // when there are many targets: the targets are processed in S2CellId order
+  // of their bounding cap centers, so that consecutive queries visit nearby
+  // index cells while reusing the same iterator, queue, and result storage.
+  //
+  // If num_threads > 1, the sorted targets are split into contiguous batches
+  // that are processed concurrently, each by its own query object.  In that
+  // case the targets must not share mutable state, and "filter" must be safe
+  // to call from multiple threads.
+  void FindClosestEdges(absl::Span<Target* const> targets,
+                        const Options& options,
+                        std::vector<std::vector<Result>>* results,
+                        int num_threads = 1, ShapeFilter filter = {});
+
+  // A function that is called with each result of VisitClosestEdges().  It
+  // should return false if no further results are needed.
+  using ResultVisitor = absl::FunctionRef<bool(const Result&)>;
+
+  // Visits the edges that satisfy the given options in order of increasing
+  // distance from the target, terminating early if "visitor" returns false
+  // (in which case this method returns false as well).  At most
+  // options.max_results() results are visited.  Results at the same distance
+  // are visited in an unspecified order.
+  //
+  // Each result is visited as soon as no closer edge can exist, so when only
+  // the first few results are needed this is much faster than calling
+  // FindClosestEdges() with a large max_results().  The query object keeps
+  // its working storage between calls, so that steady-state queries usually
+  // don't allocate any memory.
+  //
+  // options.max_error() is ignored, since results can only be visited in
+  // order if their distances are exact.  If options.include_interiors() is
+  // true, the results may include entries with edge_id == -1 just as with
+  // FindClosestEdges().
+  bool VisitClosestEdges(Target* target, const Options& options,
+                         ResultVisitor visitor, ShapeFilter filter = {});
+
+  // Returns true if the most recent query stopped early because it reached
+  // one of the work limits in Options (see max_visited_cells()).  In that
+  // case the results are the best ones found so far.  After a batch query
+  // this returns true if any of the individual queries stopped early.
+  bool last_query_approximate() const { return approximate_; }
+
+  // Returns statistics about the most recent query for which
+  // options.record_stats() was true.  After a batch query these are the sums
+  // of the statistics of the individual queries.
+  using QueryStats = S2DistanceQueryStats;
+  const QueryStats& last_query_stats() const { return stats_; }
+
  private:
   struct QueueEntry;
 
   const Options& options() const { return *options_; }
   void FindClosestEdgesInternal(Target* target, const Options& options);
+  void FindClosestEdgesImpl(Target* target, const Options& options);
   void FindClosestEdgesBruteForce();
   void FindClosestEdgesOptimized();
   void InitQueue();
@@ -300,10 +434,25 @@ class S2ClosestEdgeQueryBase {
   void AddInitialRange(const S2ShapeIndex::Iterator& first,
                        const S2ShapeIndex::Iterator& last);
   void MaybeAddResult(const S2Shape& shape, int shape_id, int edge_id);
+  void MaybeAddResult(int shape_id, int edge_id, const S2Shape::Edge& edge);
+  bool FindClosestEdgeUsingTarget();
   void AddResult(const Result& result);
+  bool VisitPendingResults(Distance limit);
+  bool WorkLimitReached();
+  bool UpdateMemoryUsage();
   void ProcessEdges(const QueueEntry& entry);
-  void ProcessOrEnqueue(S2CellId id);
+  // The children of a cell being subdivided that need to be enqueued.
+  struct ChildCells {
+    int size = 0;
+    S2CellId ids[4];
+    const S2ShapeIndexCell* index_cells[4];
+  };
+  void AddChild(S2CellId id, ChildCells* children);
+  void EnqueueChildren(S2CellId parent, const ChildCells& children);
   void ProcessOrEnqueue(S2CellId id, const S2ShapeIndexCell* index_cell);
+  bool ProcessOrSkip(S2CellId id, const S2ShapeIndexCell* index_cell);
+  void Enqueue(S2CellId id, const S2ShapeIndexCell* index_cell,
+               Distance distance);
 
   // An optional call back for filtering shapes out as we scan the index.  This
   // is only set temporarily while a query is running.
@@ -347,6 +496,27 @@ class S2ClosestEdgeQueryBase {
   // but it can also be updated by the algorithm (see MaybeAddResult).
   Distance distance_limit_;
 
+  // The work done by the current query, which is compared against the work
+  // limits in Options only if has_work_limit_ is true.  approximate_ is set
+  // if the query stops early because a limit was reached.
+  bool has_work_limit_;
+  bool approximate_ = false;
+  int num_visited_cells_;
+  int num_tested_edges_;
+  int num_work_checks_;
+
+  // Tracks the memory used by the current query when
+  // options().memory_tracker() is set (see UpdateMemoryUsage).
+  S2MemoryTracker::Client tracker_;
+
+  // Additional work counters that are only reported by last_query_stats().
+  // search_start_ is the time at which the current query started searching
+  // for edges, and is only set when options().record_stats() is true.
+  int num_queue_pushes_;
+  int num_queue_pops_;
+  std::chrono::steady_clock::time_point search_start_;
+  QueryStats stats_;
+
   // The current result set is stored in one of three ways:
   //
   //  - If max_results() == 1, the best result is kept in result_singleton_.
@@ -365,6 +535,15 @@ class S2ClosestEdgeQueryBase {
   std::vector<Result> result_vector_;
   absl::btree_set<Result> result_set_;
 
+  // While VisitClosestEdges() is running, "visitor_" is the client's visitor
+  // and candidate results are kept in a min-heap (result_heap_) until no
+  // closer edge can exist.  num_visited_ counts the results visited so far,
+  // and visitor_stopped_ is set when the visitor returns false.
+  const ResultVisitor* visitor_ = nullptr;
+  std::vector<Result> result_heap_;
+  int num_visited_;
+  bool visitor_stopped_;
+
   // When the result edges are stored in a btree_set (see above), usually
   // duplicates can be removed simply by inserting candidate edges in the
   // current set.  However this is not true if Options::max_error() > 0 and
@@ -386,6 +565,25 @@ class S2ClosestEdgeQueryBase {
   using ShapeEdgeId = s2shapeutil::ShapeEdgeId;
   absl::flat_hash_set<ShapeEdgeId> tested_edges_;
 
+  // ProcessEdges() asks the target to reject the edges of each clipped shape
+  // with at least kMinEdgeCandidates edges in a single batch (see
+  // S2DistanceTarget::GetEdgeCandidates).  use_edge_candidates_ is set to
+  // false if the target does not support this.  The vectors are kept as
+  // members to avoid reallocation.
+  static constexpr int kMinEdgeCandidates = 8;
+  bool use_edge_candidates_;
+  std::vector<int> edge_ids_;
+  std::vector<int> candidate_ids_;
+
+  // When at least kMinChildDistances children of a subdivided cell need to
+  // be enqueued, their distances are computed together (see
+  // S2DistanceTarget::GetChildCellDistances).  This is not worthwhile for
+  // fewer children, since computing all four distances together costs about
+  // as much as computing two of them separately.  use_child_distances_ is set
+  // to false if the target does not support this.
+  static constexpr int kMinChildDistances = 3;
+  bool use_child_distances_;
+
   // The algorithm maintains a priority queue of unprocessed S2CellIds, sorted
   // in increasing order of distance from the target.
   struct QueueEntry {
@@ -412,13 +610,25 @@ class S2ClosestEdgeQueryBase {
       return other.distance < distance;
     }
   };
-  using CellQueue =
-      std::priority_queue<QueueEntry, absl::InlinedVector<QueueEntry, 16>>;
+  class CellQueue : public std::priority_queue<
+                        QueueEntry, absl::InlinedVector<QueueEntry, 16>> {
+   public:
+    // Removes all entries without releasing the queue's storage.
+    void clear() { this->c.erase(this->c.begin(), this->c.end()); }
+
+    // Returns the number of bytes allocated outside the queue object itself.
+    int64 heap_bytes() const {
+      return this->c.capacity() > 16 ? this->c.capacity() * sizeof(QueueEntry)
+                                     : 0;
+    }
+  };
   CellQueue queue_;
 
   // Temporaries, defined here to avoid multiple allocations / initializations.
 
   S2ShapeIndex::Iterator iter_;
+  std::vector<int32> containing_shape_ids_;
+  S2RegionCoverer coverer_;
   std::vector<S2CellId> max_distance_covering_;
   std::vector<S2CellId> initial_cells_;
 };
@@ -488,6 +698,78 @@ inline void S2ClosestEdgeQueryBase<Distance>::Options::set_use_brute_force(
   use_brute_force_ = use_brute_force;
 }
 
+template <class Distance>
+inline int S2ClosestEdgeQueryBase<Distance>::Options::max_visited_cells()
+    const {
+  return max_visited_cells_;
+}
+
+template <class Distance>
+inline void S2ClosestEdgeQueryBase<Distance>::Options::set_max_visited_cells(
+    int max_visited_cells) {
+  ABSL_DCHECK_GE(max_visited_cells, 0);
+  max_visited_cells_ = max_visited_cells;
+}
+
+template <class Distance>
+inline int S2ClosestEdgeQueryBase<Distance>::Options::max_tested_edges()
+    const {
+  return max_tested_edges_;
+}
+
+template <class Distance>
+inline void S2ClosestEdgeQueryBase<Distance>::Options::set_max_tested_edges(
+    int max_tested_edges) {
+  ABSL_DCHECK_GE(max_tested_edges, 0);
+  max_tested_edges_ = max_tested_edges;
+}
+
+template <class Distance>
+inline absl::Time S2ClosestEdgeQueryBase<Distance>::Options::deadline() const {
+  return deadline_;
+}
+
+template <class Distance>
+inline void S2ClosestEdgeQueryBase<Distance>::Options::set_deadline(
+    absl::Time deadline) {
+  deadline_ = deadline;
+}
+
+template <class Distance>
+inline S2MemoryTracker*
+S2ClosestEdgeQueryBase<Distance>::Options::memory_tracker() const {
+  return memory_tracker_;
+}
+
+template <class Distance>
+inline void S2ClosestEdgeQueryBase<Distance>::Options::set_memory_tracker(
+    S2MemoryTracker* tracker) {
+  memory_tracker_ = tracker;
+}
+
+template <class Distance>
+inline S2IndexEdgeCache*
+S2ClosestEdgeQueryBase<Distance>::Options::edge_cache() const {
+  return edge_cache_;
+}
+
+template <class Distance>
+inline void S2ClosestEdgeQueryBase<Distance>::Options::set_edge_cache(
+    S2IndexEdgeCache* edge_cache) {
+  edge_cache_ = edge_cache;
+}
+
+template <class Distance>
+inline bool S2ClosestEdgeQueryBase<Distance>::Options::record_stats() const {
+  return record_stats_;
+}
+
+template <class Distance>
+inline void S2ClosestEdgeQueryBase<Distance>::Options::set_record_stats(
+    bool record_stats) {
+  record_stats_ = record_stats;
+}
+
 template <class Distance>
 S2ClosestEdgeQueryBase<Distance>::S2ClosestEdgeQueryBase()
     : tested_edges_(/*bucket_count=*/1) {}
@@ -578,35 +860,167 @@ void S2ClosestEdgeQueryBase<Distance>::FindClosestEdges(
   }
 }
 
+template <class Distance>
+void S2ClosestEdgeQueryBase<Distance>::FindClosestEdges(
+    absl::Span<Target* const> targets, const Options& options,
+    std::vector<std::vector<Result>>* results, int num_threads,
+    ShapeFilter filter) {
+  ABSL_DCHECK_GE(num_threads, 1);
+  results->resize(targets.size());
+
+  // Sort the targets along the Hilbert curve so that consecutive queries
+  // tend to touch the same index cells.
+  std::vector<std::pair<S2CellId, int>> order;
+  order.reserve(targets.size());
+  for (int i = 0; i < static_cast<int>(targets.size()); ++i) {
+    order.emplace_back(S2CellId(targets[i]->GetCapBound().center()), i);
+  }
+  std::sort(order.begin(), order.end());
+
+  // Avoid starting threads that would have very little work to do.
+  constexpr int kMinTargetsPerThread = 64;
+  const int n = order.size();
+  num_threads = std::min(num_threads,
+                         (n + kMinTargetsPerThread - 1) / kMinTargetsPerThread);
+  if (num_threads <= 1) {
+    bool approximate = false;
+    QueryStats stats;
+    for (const auto& [id, i] : order) {
+      FindClosestEdges(targets[i], options, &(*results)[i], filter);
+      approximate |= approximate_;
+      if (options.record_stats()) stats += stats_;
+    }
+    approximate_ = approximate;
+    if (options.record_stats()) stats_ = stats;
+    return;
+  }
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  std::vector<char> approximate(num_threads, false);
+  std::vector<QueryStats> stats(num_threads);
+  for (int t = 0; t < num_threads; ++t) {
+    int begin = static_cast<int64_t>(n) * t / num_threads;
+    int end = static_cast<int64_t>(n) * (t + 1) / num_threads;
+    threads.emplace_back([this, &order, &targets, &options, results, filter,
+                          &approximate, &stats, t, begin, end]() {
+      S2ClosestEdgeQueryBase query(index_);
+      for (int k = begin; k < end; ++k) {
+        int i = order[k].second;
+        query.FindClosestEdges(targets[i], options, &(*results)[i], filter);
+        approximate[t] |= query.approximate_;
+        if (options.record_stats()) stats[t] += query.stats_;
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  approximate_ = std::find(approximate.begin(), approximate.end(), true) !=
+                 approximate.end();
+  if (options.record_stats()) {
+    stats_ = QueryStats();
+    for (const QueryStats& thread_stats : stats) stats_ += thread_stats;
+  }
+}
+
+template <class Distance>
+bool S2ClosestEdgeQueryBase<Distance>::VisitClosestEdges(
+    Target* target, const Options& options, ResultVisitor visitor,
+    ShapeFilter filter) {
+  Options exact_options = options;
+  exact_options.set_max_error(Delta::Zero());
+  if (filter) {
+    shape_filter_.emplace(*filter);
+  }
+  visitor_ = &visitor;
+  num_visited_ = 0;
+  visitor_stopped_ = false;
+  FindClosestEdgesInternal(target, exact_options);
+  // Any candidates that remain are closer than every unprocessed cell.
+  VisitPendingResults(Distance::Infinity());
+  visitor_ = nullptr;
+  shape_filter_.reset();
+  result_heap_.clear();
+  return !visitor_stopped_;
+}
+
 template <class Distance>
 void S2ClosestEdgeQueryBase<Distance>::FindClosestEdgesInternal(
     Target* target, const Options& options) {
+  tracker_.Init(options.memory_tracker());
+  if (!options.record_stats()) {
+    FindClosestEdgesImpl(target, options);
+  } else {
+    // FindClosestEdgesImpl() sets search_start_ unless it returns before
+    // searching for edges.
+    auto start = std::chrono::steady_clock::now();
+    search_start_ = std::chrono::steady_clock::time_point::max();
+    stats_ = QueryStats();
+    FindClosestEdgesImpl(target, options);
+    auto end = std::chrono::steady_clock::now();
+    stats_.num_queries = 1;
+    stats_.num_approximate_queries = approximate_;
+    stats_.num_queue_pushes = num_queue_pushes_;
+    stats_.num_queue_pops = num_queue_pops_;
+    stats_.num_visited_cells = num_visited_cells_;
+    stats_.num_distance_tests = num_tested_edges_;
+    stats_.setup_time = std::min(search_start_, end) - start;
+    stats_.elapsed = end - start;
+  }
+  S2_TELEMETRY_COUNTER_INC("s2closest_edge_query_base.queries");
+  S2_TELEMETRY_COUNTER_ADD("s2closest_edge_query_base.visited_cells",
+                           num_visited_cells_);
+  S2_TELEMETRY_COUNTER_ADD("s2closest_edge_query_base.tested_edges",
+                           num_tested_edges_);
+  tracker_.Tally(-tracker_.client_usage_bytes());
+}
+
+template <class Distance>
+void S2ClosestEdgeQueryBase<Distance>::FindClosestEdgesImpl(
+    Target* target, const Options& options) {
   target_ = target;
   options_ = &options;
 
   tested_edges_.clear();
+  use_edge_candidates_ = true;
+  use_child_distances_ = true;
   distance_limit_ = options.max_distance();
   result_singleton_ = Result();
+  has_work_limit_ = (options.max_visited_cells() != Options::kNoWorkLimit ||
+                     options.max_tested_edges() != Options::kNoWorkLimit ||
+                     options.deadline() != absl::InfiniteFuture() ||
+                     tracker_.is_active());
+  approximate_ = false;
+  num_visited_cells_ = 0;
+  num_tested_edges_ = 0;
+  num_work_checks_ = 0;
+  num_queue_pushes_ = 0;
+  num_queue_pops_ = 0;
   ABSL_DCHECK(result_vector_.empty());
   ABSL_DCHECK(result_set_.empty());
   ABSL_DCHECK_GE(target->max_brute_force_index_size(), 0);
   if (distance_limit_ == Distance::Zero()) return;
 
   if (options.max_results() == Options::kMaxMaxResults &&
-      options.max_distance() == Distance::Infinity()) {
+      options.max_distance() == Distance::Infinity() && visitor_ == nullptr) {
     ABSL_LOG(WARNING)
         << "Returning all edges (max_results/max_distance not set)";
   }
 
   if (options.include_interiors()) {
-    absl::btree_set<int32> shape_ids;
+    // The containing shape ids are kept sorted and distinct.  A vector is
+    // used rather than a set so that its storage can be reused.
+    std::vector<int32>& shape_ids = containing_shape_ids_;
+    shape_ids.clear();
+    auto insert = [&shape_ids](int id) {
+      auto it = std::lower_bound(shape_ids.begin(), shape_ids.end(), id);
+      if (it == shape_ids.end() || *it != id) shape_ids.insert(it, id);
+    };
 
     const size_t max_results = static_cast<size_t>(options.max_results());
     if (!shape_filter_) {
       // By default just insert shape ids into the output set.
       (void)target->VisitContainingShapeIds(
           *index_, [&](int id, const S2Point&) {
-            shape_ids.insert(id);
+            insert(id);
             return shape_ids.size() < max_results;
           });
     } else {
@@ -614,7 +1028,7 @@ void S2ClosestEdgeQueryBase<Distance>::FindClosestEdgesInternal(
       (void)target->VisitContainingShapeIds(
           *index_, [&](int id, const S2Point&) {
             if ((*shape_filter_)(id)) {
-              shape_ids.insert(id);
+              insert(id);
             }
             return shape_ids.size() < max_results;
           });
@@ -668,18 +1082,48 @@ void S2ClosestEdgeQueryBase<Distance>::FindClosestEdgesInternal(
     index_num_edges_limit_ = min_optimized_edges;
   }
 
-  if (options.use_brute_force() || index_num_edges_ < min_optimized_edges) {
+  bool use_brute_force = (options.use_brute_force() ||
+                          index_num_edges_ < min_optimized_edges);
+  if (options.record_stats()) {
+    stats_.num_brute_force_queries = use_brute_force;
+    search_start_ = std::chrono::steady_clock::now();
+  }
+  if (use_brute_force) {
     // The brute force algorithm considers each edge exactly once.
     avoid_duplicates_ = false;
     FindClosestEdgesBruteForce();
+  } else if (FindClosestEdgeUsingTarget()) {
+    // The target found the closest edge itself.
   } else {
     // If the target takes advantage of max_error() then we need to avoid
-    // duplicate edges explicitly.  (Otherwise it happens automatically.)
-    avoid_duplicates_ = (target_uses_max_error && options.max_results() > 1);
+    // duplicate edges explicitly.  (Otherwise it happens automatically,
+    // except when visiting results since they are not kept in a set.)
+    avoid_duplicates_ = (target_uses_max_error && options.max_results() > 1) ||
+                        visitor_ != nullptr;
     FindClosestEdgesOptimized();
   }
 }
 
+// Gives the target a chance to find the single closest edge itself (see
+// S2DistanceTarget::FindClosestEdge).  This is only done for queries that do
+// not need the features of the general algorithm (work limits, shape
+// filters, visitors, or multiple results).  Returns true if the target
+// handled the query.
+template <class Distance>
+bool S2ClosestEdgeQueryBase<Distance>::FindClosestEdgeUsingTarget() {
+  if (options().max_results() != 1 || visitor_ != nullptr ||
+      has_work_limit_ || shape_filter_) {
+    return false;
+  }
+  Distance distance = distance_limit_;
+  int shape_id = -1, edge_id = -1;
+  if (!target_->FindClosestEdge(*index_, &distance, &shape_id, &edge_id)) {
+    return false;
+  }
+  if (shape_id >= 0) AddResult(Result(distance, shape_id, edge_id));
+  return true;
+}
+
 template <class Distance>
 void S2ClosestEdgeQueryBase<Distance>::FindClosestEdgesBruteForce() {
   for (int shape_id = 0; shape_id < index_->num_shape_ids(); ++shape_id) {
@@ -691,6 +1135,10 @@ void S2ClosestEdgeQueryBase<Distance>::FindClosestEdgesBruteForce() {
     if (!shape_filter_ || (*shape_filter_)(shape_id)) {
       int num_edges = shape->num_edges();
       for (int e = 0; e < num_edges; ++e) {
+        if (has_work_limit_ && WorkLimitReached()) {
+          approximate_ = true;
+          return;
+        }
         MaybeAddResult(*shape, shape_id, e);
       }
     }
@@ -699,6 +1147,8 @@ void S2ClosestEdgeQueryBase<Distance>::FindClosestEdgesBruteForce() {
 
 template <class Distance>
 void S2ClosestEdgeQueryBase<Distance>::FindClosestEdgesOptimized() {
+  const bool prefetch =
+      absl::GetFlag(FLAGS_s2shape_index_prefetch_distance) > 0;
   InitQueue();
   // Repeatedly find the closest S2Cell to "target" and either split it into
   // its four children or process all of its edges.
@@ -707,15 +1157,25 @@ void S2ClosestEdgeQueryBase<Distance>::FindClosestEdgesOptimized() {
     // remove it before adding any new entries to the queue.
     QueueEntry entry = queue_.top();
     queue_.pop();
+    ++num_queue_pops_;
     // Work around weird parse error in gcc 4.9 by using a local variable for
     // entry.distance.
     Distance distance = entry.distance;
-    if (!(distance < distance_limit_)) {
-      queue_ = CellQueue();  // Clear any remaining entries.
+    if (!(distance < distance_limit_)) break;
+    if (has_work_limit_ && WorkLimitReached()) {
+      approximate_ = true;
       break;
     }
+    ++num_visited_cells_;
+
+    // When visiting results, every candidate that is no further away than
+    // this cell can be visited now since all remaining cells are further.
+    if (visitor_ != nullptr && !VisitPendingResults(distance)) break;
     // If this is already known to be an index cell, just process it.
     if (entry.index_cell != nullptr) {
+      // The next entry is likely to be processed right after this one, so
+      // its index cell is loaded while the edges of this one are processed.
+      if (prefetch && !queue_.empty()) S2Prefetch(queue_.top().index_cell);
       ProcessEdges(entry);
       continue;
     }
@@ -724,21 +1184,25 @@ void S2ClosestEdgeQueryBase<Distance>::FindClosestEdgesOptimized() {
     // this in two seek operations rather than four by seeking to the key
     // between children 0 and 1 and to the key between children 2 and 3.
     S2CellId id = entry.id;
+    ChildCells children;
     iter_.Seek(id.child(1).range_min());
     if (!iter_.done() && iter_.id() <= id.child(1).range_max()) {
-      ProcessOrEnqueue(id.child(1));
+      AddChild(id.child(1), &children);
     }
     if (iter_.Prev() && iter_.id() >= id.range_min()) {
-      ProcessOrEnqueue(id.child(0));
+      AddChild(id.child(0), &children);
     }
     iter_.Seek(id.child(3).range_min());
     if (!iter_.done() && iter_.id() <= id.range_max()) {
-      ProcessOrEnqueue(id.child(3));
+      AddChild(id.child(3), &children);
     }
     if (iter_.Prev() && iter_.id() >= id.child(2).range_min()) {
-      ProcessOrEnqueue(id.child(2));
+      AddChild(id.child(2), &children);
     }
+    EnqueueChildren(id, children);
   }
+  num_queue_pushes_ = num_queue_pops_ + queue_.size();
+  queue_.clear();  // Clear any remaining entries.
 }
 
 template <class Distance>
@@ -777,11 +1241,10 @@ void S2ClosestEdgeQueryBase<Distance>::InitQueue() {
   } else {
     // Compute a covering of the search disc and intersect it with the
     // precomputed index covering.
-    S2RegionCoverer coverer;
-    coverer.mutable_options()->set_max_cells(4);
+    coverer_.mutable_options()->set_max_cells(4);
     S1ChordAngle radius = cap.radius() + distance_limit_.GetChordAngleBound();
     S2Cap search_cap(cap.center(), radius);
-    coverer.GetFastCovering(search_cap, &max_distance_covering_);
+    coverer_.GetFastCovering(search_cap, &max_distance_covering_);
     S2CellUnion::GetIntersection(index_covering_, max_distance_covering_,
                                  &initial_cells_);
 
@@ -899,6 +1362,7 @@ void S2ClosestEdgeQueryBase<Distance>::MaybeAddResult(const S2Shape& shape,
       !tested_edges_.insert(ShapeEdgeId(shape_id, edge_id)).second) {
     return;
   }
+  ++num_tested_edges_;
   auto edge = shape.edge(edge_id);
   Distance distance = distance_limit_;
   if (target_->UpdateMinDistance(edge.v0, edge.v1, &distance)) {
@@ -906,9 +1370,30 @@ void S2ClosestEdgeQueryBase<Distance>::MaybeAddResult(const S2Shape& shape,
   }
 }
 
+// Like the method above, except that the edge has already been fetched.
+template <class Distance>
+void S2ClosestEdgeQueryBase<Distance>::MaybeAddResult(
+    int shape_id, int edge_id, const S2Shape::Edge& edge) {
+  if (avoid_duplicates_ &&
+      !tested_edges_.insert(ShapeEdgeId(shape_id, edge_id)).second) {
+    return;
+  }
+  ++num_tested_edges_;
+  Distance distance = distance_limit_;
+  if (target_->UpdateMinDistance(edge.v0, edge.v1, &distance)) {
+    AddResult(Result(distance, shape_id, edge_id));
+  }
+}
+
 template <class Distance>
 void S2ClosestEdgeQueryBase<Distance>::AddResult(const Result& result) {
-  if (options().max_results() == 1) {
+  if (visitor_ != nullptr) {
+    // The result is visited once no closer edge can exist (see
+    // VisitPendingResults), so distance_limit_ is not reduced.
+    result_heap_.push_back(result);
+    std::push_heap(result_heap_.begin(), result_heap_.end(),
+                   [](const Result& x, const Result& y) { return y < x; });
+  } else if (options().max_results() == 1) {
     // Optimization for the common case where only the closest edge is wanted.
     result_singleton_ = result;
     distance_limit_ = result.distance() - options().max_error();
@@ -930,6 +1415,53 @@ void S2ClosestEdgeQueryBase<Distance>::AddResult(const Result& result) {
   }
 }
 
+// Visits the candidate results whose distance is at most "limit" in order of
+// increasing distance.  Returns false if no further results should be
+// visited, i.e. the visitor returned false or max_results() results have been
+// visited.
+template <class Distance>
+bool S2ClosestEdgeQueryBase<Distance>::VisitPendingResults(Distance limit) {
+  auto greater = [](const Result& x, const Result& y) { return y < x; };
+  while (!visitor_stopped_ && num_visited_ < options().max_results() &&
+         !result_heap_.empty() && !(limit < result_heap_.front().distance())) {
+    std::pop_heap(result_heap_.begin(), result_heap_.end(), greater);
+    ++num_visited_;
+    if (!(*visitor_)(result_heap_.back())) visitor_stopped_ = true;
+    result_heap_.pop_back();
+  }
+  return !visitor_stopped_ && num_visited_ < options().max_results();
+}
+
+// Returns true if the current query has reached one of the work limits
+// specified in options().
+template <class Distance>
+bool S2ClosestEdgeQueryBase<Distance>::WorkLimitReached() {
+  if (num_visited_cells_ >= options().max_visited_cells() ||
+      num_tested_edges_ >= options().max_tested_edges()) {
+    return true;
+  }
+  if (tracker_.is_active() && !UpdateMemoryUsage()) return true;
+  // absl::Now() is relatively expensive, so the deadline is only checked on
+  // every 16th call.
+  return (num_work_checks_++ & 15) == 0 &&
+         options().deadline() != absl::InfiniteFuture() &&
+         absl::Now() >= options().deadline();
+}
+
+// Updates the memory usage of the current query as reported to
+// options().memory_tracker(), and returns false if the query should stop.
+template <class Distance>
+bool S2ClosestEdgeQueryBase<Distance>::UpdateMemoryUsage() {
+  using BtreeSet = absl::btree_set<Result>;
+  int64 bytes =
+      queue_.heap_bytes() +
+      (result_vector_.capacity() + result_heap_.capacity()) * sizeof(Result) +
+      result_set_.size() *
+          S2MemoryTracker::Client::GetBtreeMinBytesPerEntry<BtreeSet>() +
+      tested_edges_.capacity() * sizeof(ShapeEdgeId);
+  return tracker_.Tally(bytes - tracker_.client_usage_bytes());
+}
+
 // Return the number of edges in the given index cell.
 inline static int CountEdges(const S2ShapeIndexCell* cell) {
   int count = 0;
@@ -943,6 +1475,11 @@ inline static int CountEdges(const S2ShapeIndexCell* cell) {
 template <class Distance>
 void S2ClosestEdgeQueryBase<Distance>::ProcessEdges(const QueueEntry& entry) {
   const S2ShapeIndexCell* index_cell = entry.index_cell;
+  const S2IndexEdgeCache::CellEdges* cell_edges = nullptr;
+  if (options().edge_cache() != nullptr) {
+    cell_edges =
+        &options().edge_cache()->Load(*index_, entry.id, *index_cell);
+  }
 
   for (int s = 0; s < index_cell->num_clipped(); ++s) {
     const S2ClippedShape& clipped = index_cell->clipped(s);
@@ -950,23 +1487,74 @@ void S2ClosestEdgeQueryBase<Distance>::ProcessEdges(const QueueEntry& entry) {
     int shape_id = clipped.shape_id();
     if (!shape_filter_ || (*shape_filter_)(shape_id)) {
       const S2Shape* shape = index_->shape(shape_id);
-      for (int j = 0; j < clipped.num_edges(); ++j) {
+      const int num_edges = clipped.num_edges();
+      if (use_edge_candidates_ && num_edges >= kMinEdgeCandidates) {
+        edge_ids_.resize(num_edges);
+        for (int j = 0; j < num_edges; ++j) edge_ids_[j] = clipped.edge(j);
+        candidate_ids_.clear();
+        if (target_->GetEdgeCandidates(*shape, edge_ids_, distance_limit_,
+                                       &candidate_ids_)) {
+          // The rejected edges still count towards max_tested_edges().
+          num_tested_edges_ += num_edges - candidate_ids_.size();
+          for (int edge_id : candidate_ids_) {
+            MaybeAddResult(*shape, shape_id, edge_id);
+          }
+          continue;
+        }
+        use_edge_candidates_ = false;
+      }
+      if (cell_edges != nullptr) {
+        absl::Span<const S2Shape::Edge> edges = cell_edges->clipped_edges(s);
+        for (int j = 0; j < num_edges; ++j) {
+          MaybeAddResult(shape_id, clipped.edge(j), edges[j]);
+        }
+        continue;
+      }
+      for (int j = 0; j < num_edges; ++j) {
         MaybeAddResult(*shape, shape_id, clipped.edge(j));
       }
     }
   }
 }
 
-// Enqueue the given cell id.
+// Processes the child cell "id" immediately if possible, and otherwise adds
+// it to "children" so that it can be enqueued by EnqueueChildren().
 // REQUIRES: iter_ is positioned at a cell contained by "id".
 template <class Distance>
-inline void S2ClosestEdgeQueryBase<Distance>::ProcessOrEnqueue(
-    S2CellId id) {
+inline void S2ClosestEdgeQueryBase<Distance>::AddChild(S2CellId id,
+                                                       ChildCells* children) {
   ABSL_DCHECK(id.contains(iter_.id()));
-  if (iter_.id() == id) {
-    ProcessOrEnqueue(id, &iter_.cell());
-  } else {
-    ProcessOrEnqueue(id, nullptr);
+  const S2ShapeIndexCell* index_cell =
+      (iter_.id() == id) ? &iter_.cell() : nullptr;
+  if (!ProcessOrSkip(id, index_cell)) return;
+  children->ids[children->size] = id;
+  children->index_cells[children->size] = index_cell;
+  ++children->size;
+}
+
+// Adds the given children of "parent" to the queue, unless they are too far
+// away.
+template <class Distance>
+void S2ClosestEdgeQueryBase<Distance>::EnqueueChildren(
+    S2CellId parent, const ChildCells& children) {
+  if (use_child_distances_ && children.size >= kMinChildDistances) {
+    Distance distances[4];
+    if (target_->GetChildCellDistances(S2Cell(parent), distances)) {
+      for (int i = 0; i < children.size; ++i) {
+        const Distance& distance = distances[children.ids[i].child_position()];
+        if (distance < distance_limit_) {
+          Enqueue(children.ids[i], children.index_cells[i], distance);
+        }
+      }
+      return;
+    }
+    use_child_distances_ = false;
+  }
+  for (int i = 0; i < children.size; ++i) {
+    Distance distance = distance_limit_;
+    if (target_->UpdateMinDistance(S2Cell(children.ids[i]), &distance)) {
+      Enqueue(children.ids[i], children.index_cells[i], distance);
+    }
   }
 }
 
@@ -977,17 +1565,32 @@ inline void S2ClosestEdgeQueryBase<Distance>::ProcessOrEnqueue(
 template <class Distance>
 void S2ClosestEdgeQueryBase<Distance>::ProcessOrEnqueue(
     S2CellId id, const S2ShapeIndexCell* index_cell) {
+  if (!ProcessOrSkip(id, index_cell)) return;
+
+  // Otherwise compute the minimum distance to any point in the cell and add
+  // it to the priority queue.
+  Distance distance = distance_limit_;
+  if (!target_->UpdateMinDistance(S2Cell(id), &distance)) return;
+  Enqueue(id, index_cell, distance);
+}
+
+// Processes the edges of "index_cell" immediately if it has only a few of
+// them, and skips it if it has no edges or all of its shapes are filtered
+// out.  Returns true if the cell still needs to be enqueued.
+template <class Distance>
+bool S2ClosestEdgeQueryBase<Distance>::ProcessOrSkip(
+    S2CellId id, const S2ShapeIndexCell* index_cell) {
   if (index_cell) {
     // If this index cell has only a few edges, then it is faster to check
     // them directly rather than computing the minimum distance to the S2Cell
     // and inserting it into the queue.
     static const int kMinEdgesToEnqueue = 10;
     int num_edges = CountEdges(index_cell);
-    if (num_edges == 0) return;
+    if (num_edges == 0) return false;
     if (num_edges < kMinEdgesToEnqueue) {
       // Set "distance" to zero to avoid the expense of computing it.
       ProcessEdges(QueueEntry(Distance::Zero(), id, index_cell));
-      return;
+      return false;
     }
 
     // If we have a shape filter, we can skip cells where all the shapes would
@@ -1002,16 +1605,17 @@ void S2ClosestEdgeQueryBase<Distance>::ProcessOrEnqueue(
       }
 
       if (skip_cell) {
-        return;
+        return false;
       }
     }
   }
+  return true;
+}
 
-  // Otherwise compute the minimum distance to any point in the cell and add
-  // it to the priority queue.
-  S2Cell cell(id);
-  Distance distance = distance_limit_;
-  if (!target_->UpdateMinDistance(cell, &distance)) return;
+// Adds the given cell to the queue, where "distance" is the distance to it.
+template <class Distance>
+inline void S2ClosestEdgeQueryBase<Distance>::Enqueue(
+    S2CellId id, const S2ShapeIndexCell* index_cell, Distance distance) {
   if (use_conservative_cell_distance_) {
     // Ensure that "distance" is a lower bound on the true distance to the cell.
     distance = distance - options().max_error();  // operator-=() not defined.
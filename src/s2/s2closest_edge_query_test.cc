@@ -30,6 +30,9 @@
 #include "absl/flags/flag.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 
 #include "s2/encoded_s2shape_index.h"
 #include "s2/mutable_s2shape_index.h"
@@ -40,9 +43,12 @@
 #include "s2/s2cell_id.h"
 #include "s2/s2closest_edge_query_base.h"
 #include "s2/s2closest_edge_query_testing.h"
+#include "s2/s2distance_query_stats.h"
 #include "s2/s2edge_distances.h"
 #include "s2/s2latlng.h"
+#include "s2/s2error.h"
 #include "s2/s2loop.h"
+#include "s2/s2memory_tracker.h"
 #include "s2/s2metrics.h"
 #include "s2/s2min_distance_targets.h"
 #include "s2/s2point.h"
@@ -387,6 +393,185 @@ TEST(S2ClosestEdgeQuery, IsConservativeDistanceLessOrEqual) {
   EXPECT_GE(num_conservative_needed, 25);
 }
 
+TEST(S2ClosestEdgeQuery, BatchQueryMatchesIndividualQueries) {
+  S2Testing::rnd.Reset(1);
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+  MutableS2ShapeIndex index;
+  s2testing::FractalLoopShapeIndexFactory().AddEdges(cap, 1000, &index);
+  index.Add(make_unique<S2PointVectorShape>(vector<S2Point>(
+      {S2Testing::SamplePoint(cap), S2Testing::SamplePoint(cap)})));
+
+  vector<S2Point> points;
+  for (int i = 0; i < 500; ++i) {
+    points.push_back(S2Testing::SamplePoint(S2Cap(cap.center(),
+                                                  S1Angle::Degrees(2))));
+  }
+  S2ClosestEdgeQuery query(&index);
+  for (int max_results : {1, 5, S2ClosestEdgeQuery::Options::kMaxMaxResults}) {
+    SCOPED_TRACE(absl::StrCat("max_results = ", max_results));
+    query.mutable_options()->set_max_results(max_results);
+    query.mutable_options()->set_max_distance(S1Angle::Degrees(0.2));
+    vector<vector<S2ClosestEdgeQuery::Result>> expected;
+    for (const S2Point& point : points) {
+      S2ClosestEdgeQuery::PointTarget target(point);
+      expected.push_back(query.FindClosestEdges(&target));
+    }
+    for (int num_threads : {1, 4}) {
+      vector<vector<S2ClosestEdgeQuery::Result>> actual;
+      query.FindClosestEdges(points, &actual, num_threads);
+      EXPECT_EQ(expected, actual) << "num_threads = " << num_threads;
+    }
+  }
+}
+
+TEST(S2ClosestEdgeQuery, IndexTargetMatchesBruteForceTarget) {
+  // FindClosestEdge() with a ShapeIndexTarget traverses both indexes at once
+  // unless the target uses brute force; both methods must agree.
+  S2Testing::rnd.Reset(1);
+  for (int iter = 0; iter < 20; ++iter) {
+    S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+    MutableS2ShapeIndex index, target_index;
+    s2testing::FractalLoopShapeIndexFactory().AddEdges(cap, 1000, &index);
+    S2Cap target_cap(S2Testing::SamplePoint(S2Cap(cap.center(),
+                                                  S1Angle::Degrees(3))),
+                     S1Angle::Degrees(0.5));
+    s2testing::FractalLoopShapeIndexFactory().AddEdges(target_cap, 1000,
+                                                       &target_index);
+    S2ClosestEdgeQuery query(&index);
+    query.mutable_options()->set_include_interiors(iter % 2 == 0);
+    S2ClosestEdgeQuery::ShapeIndexTarget target(&target_index);
+    target.set_include_interiors(iter % 4 < 2);
+    S2ClosestEdgeQuery::Result actual = query.FindClosestEdge(&target);
+    target.set_use_brute_force(true);
+    S2ClosestEdgeQuery::Result expected = query.FindClosestEdge(&target);
+    ASSERT_FALSE(actual.is_empty());
+    EXPECT_EQ(expected.distance(), actual.distance()) << "iter = " << iter;
+  }
+}
+
+TEST(S2ClosestEdgeQuery, WorkLimits) {
+  S2Testing::rnd.Reset(1);
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+  MutableS2ShapeIndex index;
+  s2testing::FractalLoopShapeIndexFactory().AddEdges(cap, 1000, &index);
+  S2ClosestEdgeQuery query(&index);
+  query.mutable_options()->set_max_results(5);
+  query.mutable_options()->set_include_interiors(false);
+  S2ClosestEdgeQuery::PointTarget target(cap.center());
+  auto expected = query.FindClosestEdges(&target);
+  ASSERT_EQ(expected.size(), 5);
+  EXPECT_FALSE(query.last_query_approximate());
+
+  // Approximate results can't be closer than the exact results.
+  auto check_approximate = [&](const vector<S2ClosestEdgeQuery::Result>&
+                                   actual) {
+    EXPECT_TRUE(query.last_query_approximate());
+    ASSERT_LE(actual.size(), expected.size());
+    for (int i = 0; i < actual.size(); ++i) {
+      EXPECT_LE(expected[i].distance(), actual[i].distance());
+    }
+  };
+  query.mutable_options()->set_max_visited_cells(1);
+  check_approximate(query.FindClosestEdges(&target));
+  query.mutable_options()->set_max_visited_cells(
+      S2ClosestEdgeQuery::Options::kNoWorkLimit);
+
+  // The edge limit is exact when the brute force algorithm is used.
+  query.mutable_options()->set_use_brute_force(true);
+  query.mutable_options()->set_max_tested_edges(10);
+  auto actual = query.FindClosestEdges(&target);
+  check_approximate(actual);
+  for (const auto& result : actual) EXPECT_LT(result.edge_id(), 10);
+  query.mutable_options()->set_use_brute_force(false);
+  query.mutable_options()->set_max_tested_edges(
+      S2ClosestEdgeQuery::Options::kNoWorkLimit);
+
+  query.mutable_options()->set_deadline(absl::InfinitePast());
+  check_approximate(query.FindClosestEdges(&target));
+
+  query.mutable_options()->set_deadline(absl::Now() + absl::Hours(1));
+  EXPECT_EQ(query.FindClosestEdges(&target), expected);
+  EXPECT_FALSE(query.last_query_approximate());
+}
+
+TEST(S2ClosestEdgeQuery, MemoryTracker) {
+  S2Testing::rnd.Reset(1);
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+  MutableS2ShapeIndex index;
+  s2testing::FractalLoopShapeIndexFactory().AddEdges(cap, 1000, &index);
+  S2ClosestEdgeQuery query(&index);
+  query.mutable_options()->set_max_distance(S1Angle::Degrees(2));
+  S2ClosestEdgeQuery::PointTarget target(cap.center());
+  auto expected = query.FindClosestEdges(&target);
+  ASSERT_GT(expected.size(), 500);
+
+  // The results alone need more memory than the limit allows.
+  S2MemoryTracker tracker;
+  tracker.set_limit_bytes(1000);
+  query.mutable_options()->set_memory_tracker(&tracker);
+  for (bool use_brute_force : {false, true}) {
+    tracker.Reset();
+    query.mutable_options()->set_use_brute_force(use_brute_force);
+    auto actual = query.FindClosestEdges(&target);
+    EXPECT_TRUE(query.last_query_approximate());
+    EXPECT_LT(actual.size(), expected.size());
+    EXPECT_EQ(tracker.error().code(), S2Error::RESOURCE_EXHAUSTED);
+    EXPECT_EQ(tracker.usage_bytes(), 0);
+  }
+
+  // Without a limit the results are exact, and all tracked memory is
+  // released once the query finishes.
+  tracker.Reset();
+  tracker.set_limit_bytes(S2MemoryTracker::kNoLimit);
+  EXPECT_EQ(query.FindClosestEdges(&target), expected);
+  EXPECT_FALSE(query.last_query_approximate());
+  EXPECT_TRUE(tracker.ok());
+  EXPECT_GT(tracker.max_usage_bytes(), 1000);
+  EXPECT_EQ(tracker.usage_bytes(), 0);
+}
+
+TEST(S2ClosestEdgeQuery, RecordStats) {
+  S2Testing::rnd.Reset(1);
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+  MutableS2ShapeIndex index;
+  s2testing::FractalLoopShapeIndexFactory().AddEdges(cap, 1000, &index);
+  S2ClosestEdgeQuery query(&index);
+  query.mutable_options()->set_max_results(5);
+  query.mutable_options()->set_record_stats(true);
+  S2ClosestEdgeQuery::PointTarget target(cap.center());
+  query.FindClosestEdges(&target);
+  const S2DistanceQueryStats& stats = query.last_query_stats();
+  EXPECT_EQ(stats.num_queries, 1);
+  EXPECT_EQ(stats.num_brute_force_queries, 0);
+  EXPECT_EQ(stats.num_approximate_queries, 0);
+  EXPECT_GT(stats.num_visited_cells, 0);
+  EXPECT_GE(stats.num_queue_pops, stats.num_visited_cells);
+  EXPECT_GE(stats.num_queue_pushes, stats.num_queue_pops);
+  EXPECT_GT(stats.num_distance_tests, 0);
+  EXPECT_LT(stats.num_distance_tests, s2shapeutil::CountEdges(index));
+  EXPECT_LE(stats.setup_time, stats.elapsed);
+
+  // The brute force algorithm tests every edge.
+  query.mutable_options()->set_use_brute_force(true);
+  query.FindClosestEdges(&target);
+  EXPECT_EQ(stats.num_queries, 1);
+  EXPECT_EQ(stats.num_brute_force_queries, 1);
+  EXPECT_EQ(stats.num_queue_pushes, 0);
+  EXPECT_EQ(stats.num_distance_tests, s2shapeutil::CountEdges(index));
+
+  // Batch queries report the sum over all targets.
+  query.mutable_options()->set_use_brute_force(false);
+  vector<S2Point> points(100, cap.center());
+  vector<vector<S2ClosestEdgeQuery::Result>> results;
+  query.FindClosestEdges(points, &results, /*num_threads=*/2);
+  EXPECT_EQ(stats.num_queries, 100);
+
+  // Statistics are not updated unless requested.
+  query.mutable_options()->set_record_stats(false);
+  query.FindClosestEdges(&target);
+  EXPECT_EQ(stats.num_queries, 100);
+}
+
 // The approximate radius of S2Cap from which query edges are chosen.
 static const S1Angle kTestCapRadius = S2Testing::KmToAngle(10);
 
@@ -408,6 +593,84 @@ vector<TestingResult> ConvertResults(
   return testing_results;
 }
 
+TEST(S2ClosestEdgeQuery, VisitClosestEdgesMatchesFindClosestEdges) {
+  S2Testing::rnd.Reset(1);
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+  MutableS2ShapeIndex index;
+  s2testing::FractalLoopShapeIndexFactory().AddEdges(cap, 1000, &index);
+  index.Add(make_unique<S2PointVectorShape>(vector<S2Point>(
+      {S2Testing::SamplePoint(cap), S2Testing::SamplePoint(cap)})));
+
+  S2ClosestEdgeQuery query(&index);
+  query.mutable_options()->set_max_distance(S1Angle::Degrees(0.2));
+  for (bool include_interiors : {false, true}) {
+    query.mutable_options()->set_include_interiors(include_interiors);
+    for (int max_results :
+         {1, 5, S2ClosestEdgeQuery::Options::kMaxMaxResults}) {
+      SCOPED_TRACE(absl::StrCat("max_results = ", max_results,
+                                ", include_interiors = ", include_interiors));
+      query.mutable_options()->set_max_results(max_results);
+      for (int i = 0; i < 100; ++i) {
+        S2ClosestEdgeQuery::PointTarget target(
+            S2Testing::SamplePoint(S2Cap(cap.center(), S1Angle::Degrees(2))));
+        vector<S2ClosestEdgeQuery::Result> actual;
+        EXPECT_TRUE(query.VisitClosestEdges(
+            &target, [&](const S2ClosestEdgeQuery::Result& result) {
+              actual.push_back(result);
+              return true;
+            }));
+        // Edges that share a closest vertex are equidistant, and ties may be
+        // broken differently by the two methods.
+        auto expected = query.FindClosestEdges(&target);
+        ASSERT_EQ(expected.size(), actual.size());
+        for (int j = 0; j < expected.size(); ++j) {
+          EXPECT_EQ(expected[j].distance(), actual[j].distance());
+        }
+        EXPECT_TRUE(CheckDistanceResults(
+            ConvertResults(expected), ConvertResults(actual), max_results,
+            query.options().max_distance(), S1ChordAngle::Zero()));
+      }
+    }
+  }
+}
+
+TEST(S2ClosestEdgeQuery, VisitClosestEdgesStopsEarly) {
+  S2Testing::rnd.Reset(1);
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+  MutableS2ShapeIndex index;
+  s2testing::FractalLoopShapeIndexFactory().AddEdges(cap, 1000, &index);
+  S2ClosestEdgeQuery query(&index);
+  S2ClosestEdgeQuery::PointTarget target(cap.center());
+  query.mutable_options()->set_include_interiors(false);
+  query.mutable_options()->set_max_results(3);
+  auto expected = query.FindClosestEdges(&target);
+  ASSERT_EQ(expected.size(), 3);
+
+  // With no limit on the number of results, stopping after three results
+  // should yield the three closest edges.
+  query.mutable_options()->set_max_results(
+      S2ClosestEdgeQuery::Options::kMaxMaxResults);
+  vector<S2ClosestEdgeQuery::Result> actual;
+  EXPECT_FALSE(query.VisitClosestEdges(
+      &target, [&](const S2ClosestEdgeQuery::Result& result) {
+        actual.push_back(result);
+        return actual.size() < 3;
+      }));
+  ASSERT_EQ(actual.size(), 3);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(expected[i].distance(), actual[i].distance());
+  }
+
+  // The query can be reused after stopping early.
+  actual.clear();
+  EXPECT_TRUE(query.VisitClosestEdges(
+      &target, [&](const S2ClosestEdgeQuery::Result& result) {
+        actual.push_back(result);
+        return true;
+      }));
+  EXPECT_EQ(actual.size(), s2shapeutil::CountEdges(index));
+}
+
 // Use "query" to find the closest edge(s) to the given target.  Verify that
 // the results satisfy the search criteria.
 static void GetClosestEdges(S2ClosestEdgeQuery::Target* target,
@@ -26,6 +26,7 @@
 #include "s2/s1chord_angle.h"
 #include "s2/s2cell.h"
 #include "s2/s2closest_point_query_base.h"
+#include "s2/s2distance_query_stats.h"
 #include "s2/s2min_distance_targets.h"
 #include "s2/s2point.h"
 #include "s2/s2point_index.h"
@@ -261,6 +262,15 @@ class S2ClosestPointQuery {
   const Options& options() const;
   Options* mutable_options();
 
+  // Returns true if the most recent query stopped early because it reached
+  // one of the work limits in Options (max_visited_cells(), etc), in which
+  // case the results are the best points found so far.
+  bool last_query_approximate() const;
+
+  // Returns statistics about the most recent query for which
+  // options().record_stats() was true.
+  const S2DistanceQueryStats& last_query_stats() const;
+
   // Returns the closest points to the given target that satisfy the current
   // options.  This method may be called multiple times.
   std::vector<Result> FindClosestPoints(Target* target);
@@ -405,6 +415,17 @@ S2ClosestPointQuery<Data>::mutable_options() {
   return &options_;
 }
 
+template <class Data>
+inline bool S2ClosestPointQuery<Data>::last_query_approximate() const {
+  return base_.last_query_approximate();
+}
+
+template <class Data>
+inline const S2DistanceQueryStats&
+S2ClosestPointQuery<Data>::last_query_stats() const {
+  return base_.last_query_stats();
+}
+
 template <class Data>
 inline std::vector<typename S2ClosestPointQuery<Data>::Result>
 S2ClosestPointQuery<Data>::FindClosestPoints(Target* target) {
@@ -420,7 +441,7 @@ inline void S2ClosestPointQuery<Data>::FindClosestPoints(
 template <class Data>
 inline typename S2ClosestPointQuery<Data>::Result
 S2ClosestPointQuery<Data>::FindClosestPoint(Target* target) {
-  static_assert(sizeof(Options) <= 32, "Consider not copying Options here");
+  static_assert(sizeof(Options) <= 64, "Consider not copying Options here");
   Options tmp_options = options_;
   tmp_options.set_max_results(1);
   return base_.FindClosestPoint(target, tmp_options);
@@ -434,7 +455,7 @@ inline S1ChordAngle S2ClosestPointQuery<Data>::GetDistance(Target* target) {
 template <class Data>
 bool S2ClosestPointQuery<Data>::IsDistanceLess(
     Target* target, S1ChordAngle limit) {
-  static_assert(sizeof(Options) <= 32, "Consider not copying Options here");
+  static_assert(sizeof(Options) <= 64, "Consider not copying Options here");
   Options tmp_options = options_;
   tmp_options.set_max_results(1);
   tmp_options.set_max_distance(limit);
@@ -445,7 +466,7 @@ bool S2ClosestPointQuery<Data>::IsDistanceLess(
 template <class Data>
 bool S2ClosestPointQuery<Data>::IsDistanceLessOrEqual(
     Target* target, S1ChordAngle limit) {
-  static_assert(sizeof(Options) <= 32, "Consider not copying Options here");
+  static_assert(sizeof(Options) <= 64, "Consider not copying Options here");
   Options tmp_options = options_;
   tmp_options.set_max_results(1);
   tmp_options.set_inclusive_max_distance(limit);
@@ -456,7 +477,7 @@ bool S2ClosestPointQuery<Data>::IsDistanceLessOrEqual(
 template <class Data>
 bool S2ClosestPointQuery<Data>::IsConservativeDistanceLessOrEqual(
     Target* target, S1ChordAngle limit) {
-  static_assert(sizeof(Options) <= 32, "Consider not copying Options here");
+  static_assert(sizeof(Options) <= 64, "Consider not copying Options here");
   Options tmp_options = options_;
   tmp_options.set_max_results(1);
   tmp_options.set_conservative_max_distance(limit);
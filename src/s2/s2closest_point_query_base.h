@@ -21,6 +21,8 @@
 #define S2_S2CLOSEST_POINT_QUERY_BASE_H_
 
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <iterator>
 #include <limits>
 #include <queue>
@@ -29,15 +31,20 @@
 #include "absl/container/inlined_vector.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s2cap.h"
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_union.h"
+#include "s2/s2distance_query_stats.h"
 #include "s2/s2distance_target.h"
 #include "s2/s2edge_distances.h"
 #include "s2/s2point.h"
 #include "s2/s2point_index.h"
+#include "s2/s2predicates.h"
 #include "s2/s2region.h"
 #include "s2/s2region_coverer.h"
 
@@ -119,12 +126,54 @@ class S2ClosestPointQueryBaseOptions {
   bool use_brute_force() const;
   void set_use_brute_force(bool use_brute_force);
 
+  // The following options bound the amount of work done by each query.
+  // When a limit is reached the search stops and the best results found so
+  // far are returned, and last_query_approximate() returns true.  Such
+  // results satisfy all the other search criteria, but closer points may
+  // exist.
+
+  // Specifies the maximum number of cells that are removed from the priority
+  // queue and subdivided.
+  //
+  // DEFAULT: kNoWorkLimit
+  int max_visited_cells() const;
+  void set_max_visited_cells(int max_visited_cells);
+  static constexpr int kNoWorkLimit = std::numeric_limits<int>::max();
+
+  // Specifies the maximum number of points whose distance to the target is
+  // computed.  Note that when the index is used this limit is only checked
+  // between cells, so it may be exceeded by the points of one cell.
+  //
+  // DEFAULT: kNoWorkLimit
+  int max_tested_points() const;
+  void set_max_tested_points(int max_tested_points);
+
+  // Specifies a time after which the search should stop.  The deadline is
+  // checked periodically rather than after every step, so queries may run
+  // slightly past it.
+  //
+  // DEFAULT: absl::InfiniteFuture()
+  absl::Time deadline() const;
+  void set_deadline(absl::Time deadline);
+
+  // Specifies that statistics about each query should be recorded (see
+  // last_query_stats).  Otherwise no statistics are recorded, which adds
+  // no overhead.
+  //
+  // DEFAULT: false
+  bool record_stats() const;
+  void set_record_stats(bool record_stats);
+
  private:
   Distance max_distance_ = Distance::Infinity();
   Delta max_error_ = Delta::Zero();
   const S2Region* region_ = nullptr;
   int max_results_ = kMaxMaxResults;
+  int max_visited_cells_ = kNoWorkLimit;
+  int max_tested_points_ = kNoWorkLimit;
+  absl::Time deadline_ = absl::InfiniteFuture();
   bool use_brute_force_ = false;
+  bool record_stats_ = false;
 };
 
 // S2ClosestPointQueryBase is a templatized class for finding the closest
@@ -226,6 +275,12 @@ class S2ClosestPointQueryBase {
 
   // Initializes the query.
   // REQUIRES: ReInit() must be called if "index" is modified.
+  //
+  // If the target supports rejecting points in batches (see
+  // S2DistanceTarget::GetPointCandidates), the first query also makes a
+  // contiguous copy of the index S2CellIds and point pointers (16 bytes per
+  // point) unless the index is frozen.  This copy is kept until ReInit() is
+  // called.
   void Init(const Index* index);
 
   // Reinitializes the query.  This method must be called whenever the
@@ -251,18 +306,46 @@ class S2ClosestPointQueryBase {
   // REQUIRES: options.max_results() == 1
   Result FindClosestPoint(Target* target, const Options& options);
 
+  // Returns true if the most recent query stopped early because it reached
+  // one of the work limits in Options (see max_visited_cells()).  In that
+  // case the results are the best ones found so far.
+  bool last_query_approximate() const { return approximate_; }
+
+  // Returns statistics about the most recent query for which
+  // options.record_stats() was true.
+  using QueryStats = S2DistanceQueryStats;
+  const QueryStats& last_query_stats() const { return stats_; }
+
  private:
   using Iterator = typename Index::Iterator;
 
   const Options& options() const { return *options_; }
   void FindClosestPointsInternal(Target* target, const Options& options);
+  void FindClosestPointsImpl(Target* target, const Options& options);
   void FindClosestPointsBruteForce();
   void FindClosestPointsOptimized();
   void InitQueue();
   void InitCovering();
   void AddInitialRange(S2CellId first_id, S2CellId last_id);
   void MaybeAddResult(const PointData* point_data);
-  bool ProcessOrEnqueue(S2CellId id, Iterator* iter, bool seek);
+  // The children of a cell being subdivided that need to be enqueued.
+  struct ChildCells {
+    int size = 0;
+    S2CellId ids[4];
+  };
+  bool ProcessOrEnqueue(S2CellId id, Iterator* iter, bool seek,
+                        ChildCells* children = nullptr);
+  bool ProcessOrEnqueue(S2CellId id, size_t* pos, bool seek,
+                        ChildCells* children = nullptr);
+  void EnqueueChildren(S2CellId parent, const ChildCells& children);
+  void MaybeEnqueue(S2CellId id);
+  void Enqueue(S2CellId id, Distance distance);
+  void InitPointArrays();
+  const PointData* GetPointData(size_t i) const {
+    return frozen_points_ ? &frozen_points_[i] : point_data_[i];
+  }
+  void ProcessPoints(size_t begin, size_t end);
+  bool WorkLimitReached();
 
   const Index* index_;
   const Options* options_;
@@ -288,6 +371,23 @@ class S2ClosestPointQueryBase {
   // but it can also be updated by the algorithm (see MaybeAddResult).
   Distance distance_limit_;
 
+  // The work done by the current query, which is compared against the work
+  // limits in Options only if has_work_limit_ is true.  approximate_ is set
+  // if the query stops early because a limit was reached.
+  bool has_work_limit_;
+  bool approximate_ = false;
+  int num_visited_cells_;
+  int num_tested_points_;
+  int num_work_checks_;
+
+  // Additional work counters that are only reported by last_query_stats().
+  // search_start_ is the time at which the current query started searching
+  // the index, and is only set when options().record_stats() is true.
+  int num_queue_pushes_;
+  int num_queue_pops_;
+  std::chrono::steady_clock::time_point search_start_;
+  QueryStats stats_;
+
   // The current result set is stored in one of three ways:
   //
   //  - If max_results() == 1, the best result is kept in result_singleton_.
@@ -328,11 +428,34 @@ class S2ClosestPointQueryBase {
   // Temporaries, defined here to avoid multiple allocations / initializations.
 
   Iterator iter_;
+
+  // The index points in S2CellId order, which are used instead of "iter_"
+  // when use_point_arrays_ is true (i.e., when the target supports
+  // S2DistanceTarget::GetPointCandidates).  If the index is frozen these
+  // refer to its arrays (frozen_points_); otherwise the ids and pointers are
+  // copied by the first such query and discarded by ReInit().  The
+  // coordinates of each batch of points are gathered into point_coords_ in
+  // structure-of-arrays layout.
+  bool use_point_arrays_;
+  absl::Span<const S2CellId> point_ids_;
+  const PointData* frozen_points_ = nullptr;
+  std::vector<S2CellId> point_id_storage_;
+  std::vector<const PointData*> point_data_;
+  std::vector<double> point_coords_[3];
+  std::vector<int> candidate_ids_;
+
   std::vector<S2CellId> region_covering_;
   std::vector<S2CellId> max_distance_covering_;
   std::vector<S2CellId> intersection_with_region_;
   std::vector<S2CellId> intersection_with_max_distance_;
   const PointData* tmp_point_data_[kMinPointsToEnqueue - 1];
+
+  // When at least kMinChildDistances children of a subdivided cell need to
+  // be enqueued, their distances are computed together (see
+  // S2DistanceTarget::GetChildCellDistances).  use_child_distances_ is set to
+  // false if the target does not support this.
+  static constexpr int kMinChildDistances = 3;
+  bool use_child_distances_;
 };
 
 
@@ -401,6 +524,52 @@ inline void S2ClosestPointQueryBaseOptions<Distance>::set_use_brute_force(
   use_brute_force_ = use_brute_force;
 }
 
+template <class Distance>
+inline int S2ClosestPointQueryBaseOptions<Distance>::max_visited_cells() const {
+  return max_visited_cells_;
+}
+
+template <class Distance>
+inline void S2ClosestPointQueryBaseOptions<Distance>::set_max_visited_cells(
+    int max_visited_cells) {
+  ABSL_DCHECK_GE(max_visited_cells, 0);
+  max_visited_cells_ = max_visited_cells;
+}
+
+template <class Distance>
+inline int S2ClosestPointQueryBaseOptions<Distance>::max_tested_points() const {
+  return max_tested_points_;
+}
+
+template <class Distance>
+inline void S2ClosestPointQueryBaseOptions<Distance>::set_max_tested_points(
+    int max_tested_points) {
+  ABSL_DCHECK_GE(max_tested_points, 0);
+  max_tested_points_ = max_tested_points;
+}
+
+template <class Distance>
+inline absl::Time S2ClosestPointQueryBaseOptions<Distance>::deadline() const {
+  return deadline_;
+}
+
+template <class Distance>
+inline void S2ClosestPointQueryBaseOptions<Distance>::set_deadline(
+    absl::Time deadline) {
+  deadline_ = deadline;
+}
+
+template <class Distance>
+inline bool S2ClosestPointQueryBaseOptions<Distance>::record_stats() const {
+  return record_stats_;
+}
+
+template <class Distance>
+inline void S2ClosestPointQueryBaseOptions<Distance>::set_record_stats(
+    bool record_stats) {
+  record_stats_ = record_stats;
+}
+
 template <class Distance, class Data>
 S2ClosestPointQueryBase<Distance, Data>::S2ClosestPointQueryBase() = default;
 
@@ -426,6 +595,10 @@ template <class Distance, class Data>
 void S2ClosestPointQueryBase<Distance, Data>::ReInit() {
   iter_.Init(index_);
   index_covering_.clear();
+  point_ids_ = {};
+  frozen_points_ = nullptr;
+  point_id_storage_.clear();
+  point_data_.clear();
 }
 
 template <class Distance, class Data>
@@ -480,11 +653,45 @@ void S2ClosestPointQueryBase<Distance, Data>::FindClosestPoints(
 template <class Distance, class Data>
 void S2ClosestPointQueryBase<Distance, Data>::FindClosestPointsInternal(
     Target* target, const Options& options) {
+  if (!options.record_stats()) {
+    FindClosestPointsImpl(target, options);
+    return;
+  }
+  // FindClosestPointsImpl() sets search_start_ unless it returns before
+  // searching the index.
+  auto start = std::chrono::steady_clock::now();
+  search_start_ = std::chrono::steady_clock::time_point::max();
+  stats_ = QueryStats();
+  FindClosestPointsImpl(target, options);
+  auto end = std::chrono::steady_clock::now();
+  stats_.num_queries = 1;
+  stats_.num_approximate_queries = approximate_;
+  stats_.num_queue_pushes = num_queue_pushes_;
+  stats_.num_queue_pops = num_queue_pops_;
+  stats_.num_visited_cells = num_visited_cells_;
+  stats_.num_distance_tests = num_tested_points_;
+  stats_.setup_time = std::min(search_start_, end) - start;
+  stats_.elapsed = end - start;
+}
+
+template <class Distance, class Data>
+void S2ClosestPointQueryBase<Distance, Data>::FindClosestPointsImpl(
+    Target* target, const Options& options) {
   target_ = target;
   options_ = &options;
+  use_child_distances_ = true;
 
   distance_limit_ = options.max_distance();
   result_singleton_ = Result();
+  has_work_limit_ = (options.max_visited_cells() != Options::kNoWorkLimit ||
+                     options.max_tested_points() != Options::kNoWorkLimit ||
+                     options.deadline() != absl::InfiniteFuture());
+  approximate_ = false;
+  num_visited_cells_ = 0;
+  num_tested_points_ = 0;
+  num_work_checks_ = 0;
+  num_queue_pushes_ = 0;
+  num_queue_pops_ = 0;
   ABSL_DCHECK(result_vector_.empty());
   ABSL_DCHECK(result_set_.empty());
   ABSL_DCHECK_GE(target->max_brute_force_index_size(), 0);
@@ -527,11 +734,23 @@ void S2ClosestPointQueryBase<Distance, Data>::FindClosestPointsInternal(
       (distance_limit_ == Distance::Infinity() ||
        Distance::Zero() < distance_limit_ - options.max_error());
 
+  // An empty batch is used to check whether the target can reject points in
+  // batches.
+  use_point_arrays_ = target_->GetPointCandidates(
+      s2pred::PointArrays(), distance_limit_, &candidate_ids_);
+  if (use_point_arrays_ && point_ids_.empty()) InitPointArrays();
+
   // Note that given point is processed only once (unlike S2ClosestEdgeQuery),
   // and therefore we don't need to worry about the possibility of having
   // duplicate points in the results.
-  if (options.use_brute_force() ||
-      index_->num_points() <= target_->max_brute_force_index_size()) {
+  bool use_brute_force = (options.use_brute_force() ||
+                          index_->num_points() <=
+                              target_->max_brute_force_index_size());
+  if (options.record_stats()) {
+    stats_.num_brute_force_queries = use_brute_force;
+    search_start_ = std::chrono::steady_clock::now();
+  }
+  if (use_brute_force) {
     FindClosestPointsBruteForce();
   } else {
     FindClosestPointsOptimized();
@@ -540,7 +759,20 @@ void S2ClosestPointQueryBase<Distance, Data>::FindClosestPointsInternal(
 
 template <class Distance, class Data>
 void S2ClosestPointQueryBase<Distance, Data>::FindClosestPointsBruteForce() {
+  if (use_point_arrays_ && !has_work_limit_) {
+    // Points are processed in batches so that distance_limit_ can shrink as
+    // closer points are found.
+    constexpr size_t kBatchSize = 256;
+    for (size_t i = 0; i < point_ids_.size(); i += kBatchSize) {
+      ProcessPoints(i, std::min(i + kBatchSize, point_ids_.size()));
+    }
+    return;
+  }
   for (iter_.Begin(); !iter_.done(); iter_.Next()) {
+    if (has_work_limit_ && WorkLimitReached()) {
+      approximate_ = true;
+      return;
+    }
     MaybeAddResult(&iter_.point_data());
   }
 }
@@ -553,22 +785,32 @@ void S2ClosestPointQueryBase<Distance, Data>::FindClosestPointsOptimized() {
     // it before adding any new entries to the queue.
     QueueEntry entry = queue_.top();
     queue_.pop();
+    ++num_queue_pops_;
     // Work around weird parse error in gcc 4.9 by using a local variable for
     // entry.distance.
     Distance distance = entry.distance;
-    if (!(distance < distance_limit_)) {
-      queue_ = CellQueue();  // Clear any remaining entries.
+    if (!(distance < distance_limit_)) break;
+    if (has_work_limit_ && WorkLimitReached()) {
+      approximate_ = true;
       break;
     }
+    ++num_visited_cells_;
     S2CellId child = entry.id.child_begin();
     // We already know that it has too many points, so process its children.
     // Each child may either be processed directly or enqueued again.  The
     // loop is optimized so that we don't seek unnecessarily.
     bool seek = true;
+    size_t pos = 0;
+    ChildCells children;
     for (int i = 0; i < 4; ++i, child = child.next()) {
-      seek = ProcessOrEnqueue(child, &iter_, seek);
+      seek = use_point_arrays_
+                 ? ProcessOrEnqueue(child, &pos, seek, &children)
+                 : ProcessOrEnqueue(child, &iter_, seek, &children);
     }
+    EnqueueChildren(entry.id, children);
   }
+  num_queue_pushes_ = num_queue_pops_ + queue_.size();
+  queue_ = CellQueue();  // Clear any remaining entries.
 }
 
 template <class Distance, class Data>
@@ -627,6 +869,15 @@ void S2ClosestPointQueryBase<Distance, Data>::InitQueue() {
                                  &intersection_with_max_distance_);
     initial_cells = &intersection_with_max_distance_;
   }
+  if (use_point_arrays_) {
+    size_t pos = 0;
+    for (size_t i = 0; i < initial_cells->size() && pos < point_ids_.size();
+         ++i) {
+      S2CellId id = (*initial_cells)[i];
+      ProcessOrEnqueue(id, &pos, id.range_min() > point_ids_[pos] /*seek*/);
+    }
+    return;
+  }
   iter_.Begin();
   for (size_t i = 0; i < initial_cells->size() && !iter_.done(); ++i) {
     S2CellId id = (*initial_cells)[i];
@@ -697,6 +948,7 @@ void S2ClosestPointQueryBase<Distance, Data>::AddInitialRange(
 template <class Distance, class Data>
 void S2ClosestPointQueryBase<Distance, Data>::MaybeAddResult(
     const PointData* point_data) {
+  ++num_tested_points_;
   Distance distance = distance_limit_;
   if (!target_->UpdateMinDistance(point_data->point(), &distance)) return;
 
@@ -725,6 +977,21 @@ void S2ClosestPointQueryBase<Distance, Data>::MaybeAddResult(
   }
 }
 
+// Returns true if the current query has reached one of the work limits
+// specified in options().
+template <class Distance, class Data>
+bool S2ClosestPointQueryBase<Distance, Data>::WorkLimitReached() {
+  if (num_visited_cells_ >= options().max_visited_cells() ||
+      num_tested_points_ >= options().max_tested_points()) {
+    return true;
+  }
+  // absl::Now() is relatively expensive, so the deadline is only checked on
+  // every 16th call.
+  return (num_work_checks_++ & 15) == 0 &&
+         options().deadline() != absl::InfiniteFuture() &&
+         absl::Now() >= options().deadline();
+}
+
 // Either process the contents of the given cell immediately, or add it to the
 // queue to be subdivided.  If "seek" is false, then "iter" must already be
 // positioned at the first indexed point within or after this cell.
@@ -734,7 +1001,7 @@ void S2ClosestPointQueryBase<Distance, Data>::MaybeAddResult(
 // cell in S2CellId order.
 template <class Distance, class Data>
 bool S2ClosestPointQueryBase<Distance, Data>::ProcessOrEnqueue(
-    S2CellId id, Iterator* iter, bool seek) {
+    S2CellId id, Iterator* iter, bool seek, ChildCells* children) {
   if (seek) iter->Seek(id.range_min());
   if (id.is_leaf()) {
     // Leaf cells can't be subdivided.
@@ -748,16 +1015,10 @@ bool S2ClosestPointQueryBase<Distance, Data>::ProcessOrEnqueue(
   for (; !iter->done() && iter->id() <= last; iter->Next()) {
     if (num_points == kMinPointsToEnqueue - 1) {
       // This cell has too many points (including this one), so enqueue it.
-      S2Cell cell(id);
-      Distance distance = distance_limit_;
-      // We check "region_" second because it may be relatively expensive.
-      if (target_->UpdateMinDistance(cell, &distance) &&
-          (!options().region() || options().region()->MayIntersect(cell))) {
-        if (use_conservative_cell_distance_) {
-          // Ensure that "distance" is a lower bound on distance to the cell.
-          distance = distance - options().max_error();
-        }
-        queue_.push(QueueEntry(distance, id));
+      if (children) {
+        children->ids[children->size++] = id;
+      } else {
+        MaybeEnqueue(id);
       }
       return true;  // Seek to next child.
     }
@@ -770,4 +1031,125 @@ bool S2ClosestPointQueryBase<Distance, Data>::ProcessOrEnqueue(
   return false;  // No need to seek to next child.
 }
 
+// Like the function above, except that "pos" is a position in point_ids_
+// rather than an iterator.
+template <class Distance, class Data>
+bool S2ClosestPointQueryBase<Distance, Data>::ProcessOrEnqueue(
+    S2CellId id, size_t* pos, bool seek, ChildCells* children) {
+  if (seek) {
+    *pos = std::lower_bound(point_ids_.begin(), point_ids_.end(),
+                            id.range_min()) - point_ids_.begin();
+  }
+  size_t begin = *pos;
+  if (id.is_leaf()) {
+    // Leaf cells can't be subdivided.
+    *pos = std::upper_bound(point_ids_.begin() + begin, point_ids_.end(), id) -
+           point_ids_.begin();
+  } else {
+    S2CellId last = id.range_max();
+    size_t limit = std::min(point_ids_.size(), begin + kMinPointsToEnqueue);
+    while (*pos < limit && point_ids_[*pos] <= last) ++*pos;
+    if (*pos - begin == kMinPointsToEnqueue) {
+      // This cell has too many points, so enqueue it.
+      if (children) {
+        children->ids[children->size++] = id;
+      } else {
+        MaybeEnqueue(id);
+      }
+      return true;  // Seek to next child.
+    }
+  }
+  // There were few enough points that we might as well process them now.
+  ProcessPoints(begin, *pos);
+  return false;  // No need to seek to next child.
+}
+
+// Adds the given cell to the queue unless it is too far away or does not
+// intersect options().region().
+template <class Distance, class Data>
+void S2ClosestPointQueryBase<Distance, Data>::MaybeEnqueue(S2CellId id) {
+  S2Cell cell(id);
+  Distance distance = distance_limit_;
+  // We check "region_" second because it may be relatively expensive.
+  if (target_->UpdateMinDistance(cell, &distance) &&
+      (!options().region() || options().region()->MayIntersect(cell))) {
+    Enqueue(id, distance);
+  }
+}
+
+// Adds the given children of "parent" to the queue unless they are too far
+// away or do not intersect options().region().
+template <class Distance, class Data>
+void S2ClosestPointQueryBase<Distance, Data>::EnqueueChildren(
+    S2CellId parent, const ChildCells& children) {
+  if (use_child_distances_ && children.size >= kMinChildDistances) {
+    Distance distances[4];
+    if (target_->GetChildCellDistances(S2Cell(parent), distances)) {
+      for (int i = 0; i < children.size; ++i) {
+        const S2CellId id = children.ids[i];
+        const Distance& distance = distances[id.child_position()];
+        if (distance < distance_limit_ &&
+            (!options().region() ||
+             options().region()->MayIntersect(S2Cell(id)))) {
+          Enqueue(id, distance);
+        }
+      }
+      return;
+    }
+    use_child_distances_ = false;
+  }
+  for (int i = 0; i < children.size; ++i) MaybeEnqueue(children.ids[i]);
+}
+
+// Adds the given cell to the queue, where "distance" is the distance to it.
+template <class Distance, class Data>
+inline void S2ClosestPointQueryBase<Distance, Data>::Enqueue(
+    S2CellId id, Distance distance) {
+  if (use_conservative_cell_distance_) {
+    // Ensure that "distance" is a lower bound on distance to the cell.
+    distance = distance - options().max_error();
+  }
+  queue_.push(QueueEntry(distance, id));
+}
+
+template <class Distance, class Data>
+void S2ClosestPointQueryBase<Distance, Data>::InitPointArrays() {
+  if (index_->is_frozen()) {
+    point_ids_ = index_->ids_;
+    frozen_points_ = index_->points_.data();
+    return;
+  }
+  const size_t n = index_->num_points();
+  point_id_storage_.reserve(n);
+  point_data_.reserve(n);
+  for (Iterator it(index_); !it.done(); it.Next()) {
+    point_id_storage_.push_back(it.id());
+    point_data_.push_back(&it.point_data());
+  }
+  point_ids_ = point_id_storage_;
+}
+
+// Calls MaybeAddResult() on the points in positions [begin, end) of
+// point_data_ that the target does not reject.  Rejected points are still
+// counted towards max_tested_points().
+template <class Distance, class Data>
+void S2ClosestPointQueryBase<Distance, Data>::ProcessPoints(size_t begin,
+                                                            size_t end) {
+  if (begin == end) return;
+  const size_t n = end - begin;
+  for (auto& coords : point_coords_) coords.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    const S2Point& p = GetPointData(begin + i)->point();
+    for (int j = 0; j < 3; ++j) point_coords_[j][i] = p[j];
+  }
+  candidate_ids_.clear();
+  target_->GetPointCandidates({point_coords_[0], point_coords_[1],
+                               point_coords_[2]},
+                              distance_limit_, &candidate_ids_);
+  num_tested_points_ += n - candidate_ids_.size();
+  for (int i : candidate_ids_) {
+    MaybeAddResult(GetPointData(begin + i));
+  }
+}
+
 #endif  // S2_S2CLOSEST_POINT_QUERY_BASE_H_
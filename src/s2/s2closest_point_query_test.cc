@@ -28,6 +28,8 @@
 
 #include "absl/flags/flag.h"
 #include "absl/log/absl_check.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 
 #include "s2/base/types.h"
 #include "s2/mutable_s2shape_index.h"
@@ -38,6 +40,7 @@
 #include "s2/s2cell_id.h"
 #include "s2/s2closest_edge_query_testing.h"
 #include "s2/s2closest_point_query_base.h"
+#include "s2/s2distance_query_stats.h"
 #include "s2/s2fractal.h"
 #include "s2/s2latlng.h"
 #include "s2/s2latlng_rect.h"
@@ -94,6 +97,132 @@ TEST(S2ClosestPointQuery, EmptyTargetOptimized) {
   EXPECT_EQ(0, query.FindClosestPoints(&target).size());
 }
 
+TEST(S2ClosestPointQuery, WorkLimits) {
+  TestIndex index;
+  for (int i = 0; i < 1000; ++i) {
+    index.Add(S2Testing::RandomPoint(), i);
+  }
+  TestQuery query(&index);
+  query.mutable_options()->set_max_results(5);
+  S2ClosestPointQueryPointTarget target(S2Testing::RandomPoint());
+  auto expected = query.FindClosestPoints(&target);
+  ASSERT_EQ(expected.size(), 5);
+  EXPECT_FALSE(query.last_query_approximate());
+
+  // Approximate results can't be closer than the exact results.
+  auto check_approximate = [&](const vector<TestQuery::Result>& actual) {
+    EXPECT_TRUE(query.last_query_approximate());
+    ASSERT_LE(actual.size(), expected.size());
+    for (int i = 0; i < actual.size(); ++i) {
+      EXPECT_LE(expected[i].distance(), actual[i].distance());
+    }
+  };
+  query.mutable_options()->set_max_visited_cells(1);
+  check_approximate(query.FindClosestPoints(&target));
+  query.mutable_options()->set_max_visited_cells(
+      TestQuery::Options::kNoWorkLimit);
+
+  // The point limit is exact when the brute force algorithm is used.
+  query.mutable_options()->set_use_brute_force(true);
+  query.mutable_options()->set_max_tested_points(10);
+  auto actual = query.FindClosestPoints(&target);
+  check_approximate(actual);
+  TestIndex::Iterator it(&index);
+  for (int i = 0; i < 10; ++i) it.Next();
+  for (const auto& result : actual) {
+    EXPECT_LT(S2CellId(result.point()), it.id());
+  }
+  query.mutable_options()->set_use_brute_force(false);
+  query.mutable_options()->set_max_tested_points(
+      TestQuery::Options::kNoWorkLimit);
+
+  query.mutable_options()->set_deadline(absl::InfinitePast());
+  check_approximate(query.FindClosestPoints(&target));
+
+  query.mutable_options()->set_deadline(absl::Now() + absl::Hours(1));
+  EXPECT_EQ(query.FindClosestPoints(&target), expected);
+  EXPECT_FALSE(query.last_query_approximate());
+}
+
+TEST(S2ClosestPointQuery, RecordStats) {
+  TestIndex index;
+  for (int i = 0; i < 1000; ++i) {
+    index.Add(S2Testing::RandomPoint(), i);
+  }
+  TestQuery query(&index);
+  query.mutable_options()->set_max_results(5);
+  query.mutable_options()->set_record_stats(true);
+  S2ClosestPointQueryPointTarget target(S2Testing::RandomPoint());
+  query.FindClosestPoints(&target);
+  const S2DistanceQueryStats& stats = query.last_query_stats();
+  EXPECT_EQ(stats.num_queries, 1);
+  EXPECT_EQ(stats.num_brute_force_queries, 0);
+  EXPECT_GT(stats.num_visited_cells, 0);
+  EXPECT_GE(stats.num_queue_pops, stats.num_visited_cells);
+  EXPECT_GE(stats.num_queue_pushes, stats.num_queue_pops);
+  EXPECT_GT(stats.num_distance_tests, 0);
+  EXPECT_LT(stats.num_distance_tests, index.num_points());
+
+  query.mutable_options()->set_use_brute_force(true);
+  query.FindClosestPoints(&target);
+  EXPECT_EQ(stats.num_brute_force_queries, 1);
+  EXPECT_EQ(stats.num_queue_pushes, 0);
+  EXPECT_EQ(stats.num_distance_tests, index.num_points());
+}
+
+TEST(S2ClosestPointQuery, PointArraysAreDiscardedByReInit) {
+  // S2ClosestPointQueryPointTarget supports rejecting points in batches, so
+  // the query works with a contiguous copy of the index points.
+  TestIndex index;
+  for (int i = 0; i < 1000; ++i) {
+    index.Add(S2Testing::RandomPoint(), i);
+  }
+  const S2Point target_point = S2Testing::RandomPoint();
+  vector<S1ChordAngle> expected;
+  for (TestIndex::Iterator it(&index); !it.done(); it.Next()) {
+    expected.push_back(S1ChordAngle(target_point, it.point()));
+  }
+  std::sort(expected.begin(), expected.end());
+  TestQuery query(&index);
+  query.mutable_options()->set_max_results(5);
+  S2ClosestPointQueryPointTarget target(target_point);
+  for (bool use_brute_force : {false, true}) {
+    query.mutable_options()->set_use_brute_force(use_brute_force);
+    const auto results = query.FindClosestPoints(&target);
+    ASSERT_EQ(5, results.size());
+    for (int i = 0; i < 5; ++i) {
+      EXPECT_EQ(expected[i], results[i].distance());
+    }
+  }
+  index.Add(target_point, 1000);
+  query.ReInit();
+  EXPECT_EQ(1000, query.FindClosestPoint(&target).data());
+}
+
+TEST(S2ClosestPointQuery, FrozenIndex) {
+  TestIndex index;
+  vector<TestIndex::PointData> points;
+  for (int i = 0; i < 1000; ++i) {
+    points.emplace_back(S2Testing::RandomPoint(), i);
+    index.Add(points.back());
+  }
+  TestIndex frozen(std::move(points));
+  ASSERT_TRUE(frozen.is_frozen());
+  TestQuery query(&index), frozen_query(&frozen);
+  query.mutable_options()->set_max_results(10);
+  *frozen_query.mutable_options() = query.options();
+  for (int i = 0; i < 20; ++i) {
+    S2ClosestPointQueryPointTarget target(S2Testing::RandomPoint());
+    const auto expected = query.FindClosestPoints(&target);
+    const auto actual = frozen_query.FindClosestPoints(&target);
+    ASSERT_EQ(expected.size(), actual.size());
+    for (int j = 0; j < expected.size(); ++j) {
+      EXPECT_EQ(expected[j].distance(), actual[j].distance());
+      EXPECT_EQ(expected[j].data(), actual[j].data());
+    }
+  }
+}
+
 // An abstract class that adds points to an S2PointIndex for benchmarking.
 struct PointIndexFactory {
  public:
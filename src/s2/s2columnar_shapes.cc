@@ -0,0 +1,149 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2columnar_shapes.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/log/absl_check.h"
+#include "s2/s2point.h"
+#include "s2/s2point_span.h"
+#include "s2/s2shape.h"
+#include "s2/s2shapeutil_get_reference_point.h"
+
+using std::make_unique;
+using std::shared_ptr;
+using std::unique_ptr;
+using std::vector;
+
+S2ColumnarShapes::S2ColumnarShapes(int dimension, vector<S2Point> vertices,
+                                   vector<int> chain_starts,
+                                   vector<int> shape_starts)
+    : dimension_(dimension),
+      vertices_(std::move(vertices)),
+      chain_starts_(std::move(chain_starts)),
+      shape_starts_(std::move(shape_starts)) {
+  ABSL_DCHECK(dimension_ >= 0 && dimension_ <= 2);
+  ABSL_DCHECK(!chain_starts_.empty() && chain_starts_.front() == 0);
+  ABSL_DCHECK_EQ(chain_starts_.back(), vertices_.size());
+  ABSL_DCHECK(std::is_sorted(chain_starts_.begin(), chain_starts_.end()));
+  ABSL_DCHECK(!shape_starts_.empty() && shape_starts_.front() == 0);
+  ABSL_DCHECK_EQ(shape_starts_.back(), num_chains());
+  ABSL_DCHECK(std::is_sorted(shape_starts_.begin(), shape_starts_.end()));
+
+  if (dimension_ == 0) {
+    chain_edge_starts_ = chain_starts_;
+  } else {
+    chain_edge_starts_.reserve(chain_starts_.size());
+    chain_edge_starts_.push_back(0);
+    for (int i = 0; i < num_chains(); ++i) {
+      int n = chain_size(i);
+      if (dimension_ == 1) n = std::max(n - 1, 0);
+      chain_edge_starts_.push_back(chain_edge_starts_.back() + n);
+    }
+  }
+}
+
+vector<unique_ptr<S2Shape>> S2ColumnarShapes::MakeShapes(
+    shared_ptr<const S2ColumnarShapes> data) {
+  vector<unique_ptr<S2Shape>> shapes;
+  shapes.reserve(data->num_shapes());
+  for (int i = 0; i < data->num_shapes(); ++i) {
+    shapes.push_back(make_unique<Shape>(data, i));
+  }
+  return shapes;
+}
+
+int S2ColumnarShapes::ChainOfEdge(int e, int first_chain,
+                                  int last_chain) const {
+  // Find the last chain that starts at or before "e".  This skips over any
+  // chains that have no edges.
+  auto start = chain_edge_starts_.begin();
+  return std::upper_bound(start + first_chain + 1, start + last_chain, e) -
+         start - 1;
+}
+
+S2Shape::Edge S2ColumnarShapes::ChainEdge(int i, int offset) const {
+  const int v0 = chain_starts_[i] + offset;
+  int v1 = v0 + 1;
+  if (dimension_ == 2 && v1 == chain_starts_[i + 1]) v1 = chain_starts_[i];
+  return S2Shape::Edge(vertices_[v0], vertices_[v1]);
+}
+
+S2ColumnarShapes::Shape::Shape(shared_ptr<const S2ColumnarShapes> data,
+                               int shape_index)
+    : data_(std::move(data)), shape_index_(shape_index) {
+  ABSL_DCHECK(shape_index >= 0 && shape_index < data_->num_shapes());
+  first_chain_ = data_->shape_starts_[shape_index];
+  last_chain_ = data_->shape_starts_[shape_index + 1];
+  first_edge_ = data_->chain_edge_starts_[first_chain_];
+  num_edges_ = data_->chain_edge_starts_[last_chain_] - first_edge_;
+}
+
+S2Shape::Edge S2ColumnarShapes::Shape::edge(int e) const {
+  ABSL_DCHECK(e >= 0 && e < num_edges_);
+  const int global_e = first_edge_ + e;
+  if (data_->dimension_ == 0) {
+    const S2Point& p = data_->vertices_[global_e];
+    return Edge(p, p);
+  }
+  const int i = data_->ChainOfEdge(global_e, first_chain_, last_chain_);
+  return data_->ChainEdge(i, global_e - data_->chain_edge_starts_[i]);
+}
+
+S2Shape::ReferencePoint S2ColumnarShapes::Shape::GetReferencePoint() const {
+  if (data_->dimension_ < 2) return ReferencePoint::Contained(false);
+  return s2shapeutil::GetReferencePoint(*this);
+}
+
+int S2ColumnarShapes::Shape::num_chains() const {
+  // Points are represented as one chain per point.
+  return data_->dimension_ == 0 ? num_edges_ : last_chain_ - first_chain_;
+}
+
+S2Shape::Chain S2ColumnarShapes::Shape::chain(int i) const {
+  if (data_->dimension_ == 0) return Chain(i, 1);
+  const vector<int>& starts = data_->chain_edge_starts_;
+  const int c = first_chain_ + i;
+  return Chain(starts[c] - first_edge_, starts[c + 1] - starts[c]);
+}
+
+S2Shape::Edge S2ColumnarShapes::Shape::chain_edge(int i, int j) const {
+  if (data_->dimension_ == 0) {
+    ABSL_DCHECK_EQ(j, 0);
+    return edge(i);
+  }
+  return data_->ChainEdge(first_chain_ + i, j);
+}
+
+S2Shape::ChainPosition S2ColumnarShapes::Shape::chain_position(int e) const {
+  if (data_->dimension_ == 0) return ChainPosition(e, 0);
+  const int global_e = first_edge_ + e;
+  const int i = data_->ChainOfEdge(global_e, first_chain_, last_chain_);
+  return ChainPosition(i - first_chain_,
+                       global_e - data_->chain_edge_starts_[i]);
+}
+
+S2PointSpan S2ColumnarShapes::Shape::chain_vertex_span(int i) const {
+  if (data_->dimension_ == 0) {
+    return S2PointSpan(data_->vertices_.data() + first_edge_ + i, 1);
+  }
+  const int c = first_chain_ + i;
+  return S2PointSpan(data_->vertices_.data() + data_->chain_starts_[c],
+                     data_->chain_size(c));
+}
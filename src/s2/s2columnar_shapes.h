@@ -0,0 +1,140 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2COLUMNAR_SHAPES_H_
+#define S2_S2COLUMNAR_SHAPES_H_
+
+#include <memory>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "s2/s2point.h"
+#include "s2/s2point_span.h"
+#include "s2/s2shape.h"
+
+// S2ColumnarShapes stores a large collection of points, polylines, or
+// polygons (all of the same dimension) in columnar form: a single vertex
+// buffer, the offsets of each chain (polyline or loop) within that buffer,
+// and the offsets of each shape's chains.  This is the same layout as
+// GeoArrow's native encodings once the coordinates have been converted to
+// S2Points, and it is much more compact than creating a separate
+// S2LaxPolygonShape (say) for every geometry.
+//
+// Each geometry is exposed as a small S2Shape view (S2ColumnarShapes::Shape)
+// that shares the columnar data, so that the whole collection can be added
+// to an index in one call:
+//
+//   auto data = std::make_shared<S2ColumnarShapes>(
+//       2, std::move(vertices), std::move(chain_starts),
+//       std::move(shape_starts));
+//   MutableS2ShapeIndex index;
+//   index.AddShapes(S2ColumnarShapes::MakeShapes(std::move(data)));
+//
+// Like S2LaxPolygonShape, this class does not check that the geometry is
+// valid.  The views have no type tag, i.e. they cannot be encoded using
+// s2shapeutil::EncodeTaggedShapes.
+class S2ColumnarShapes {
+ public:
+  // Constructs a collection of geometries of the given dimension:
+  //
+  //  - "vertices" contains the vertices of all chains, in order.
+  //  - Chain i consists of vertices [chain_starts[i], chain_starts[i+1]).
+  //    Hence chain_starts.size() is the number of chains plus one,
+  //    chain_starts.front() == 0 and chain_starts.back() == vertices.size().
+  //  - Shape i consists of chains [shape_starts[i], shape_starts[i+1]),
+  //    with shape_starts.front() == 0 and shape_starts.back() equal to the
+  //    number of chains.
+  //
+  // The chains are interpreted according to "dimension":
+  //
+  //  - 0: Every vertex is a point (the chains of a shape simply group its
+  //       points, e.g. a GeoArrow multipoint has one chain per shape).
+  //  - 1: Every chain is a polyline.  A chain with n vertices has n - 1
+  //       edges.  Chains with fewer than two vertices have no edges but are
+  //       still reported as chains (unlike S2LaxPolylineShape), so that chain
+  //       ids match the columnar data.
+  //  - 2: Every chain is a loop, exactly as in S2LaxPolygonShape: the last
+  //       vertex is not repeated, a loop with n vertices has n edges, and a
+  //       loop with no vertices is the full loop.
+  S2ColumnarShapes(int dimension, std::vector<S2Point> vertices,
+                   std::vector<int> chain_starts,
+                   std::vector<int> shape_starts);
+
+  S2ColumnarShapes(const S2ColumnarShapes&) = delete;
+  S2ColumnarShapes& operator=(const S2ColumnarShapes&) = delete;
+
+  int dimension() const { return dimension_; }
+  int num_shapes() const { return static_cast<int>(shape_starts_.size()) - 1; }
+  int num_chains() const { return static_cast<int>(chain_starts_.size()) - 1; }
+  absl::Span<const S2Point> vertices() const { return vertices_; }
+
+  // Returns one S2Shape view per geometry (in order), each of which keeps a
+  // reference to "data".  The result is suitable for passing to
+  // MutableS2ShapeIndex::AddShapes().
+  static std::vector<std::unique_ptr<S2Shape>> MakeShapes(
+      std::shared_ptr<const S2ColumnarShapes> data);
+
+  // An S2Shape representing one geometry of an S2ColumnarShapes object.
+  class Shape final : public S2Shape {
+   public:
+    // REQUIRES: 0 <= shape_index < data->num_shapes()
+    Shape(std::shared_ptr<const S2ColumnarShapes> data, int shape_index);
+
+    const S2ColumnarShapes& data() const { return *data_; }
+    int shape_index() const { return shape_index_; }
+
+    // S2Shape interface:
+    int num_edges() const override { return num_edges_; }
+    Edge edge(int e) const override;
+    int dimension() const override { return data_->dimension_; }
+    ReferencePoint GetReferencePoint() const override;
+    int num_chains() const override;
+    Chain chain(int i) const override;
+    Edge chain_edge(int i, int j) const override;
+    ChainPosition chain_position(int e) const override;
+    S2PointSpan chain_vertex_span(int i) const override;
+
+   private:
+    std::shared_ptr<const S2ColumnarShapes> data_;
+    int shape_index_;
+    int first_chain_, last_chain_;  // Range of chains in "data_".
+    int first_edge_, num_edges_;    // Range of edges in "data_".
+  };
+
+ private:
+  // Returns the number of vertices in chain "i".
+  int chain_size(int i) const {
+    return chain_starts_[i + 1] - chain_starts_[i];
+  }
+
+  // Returns the chain in the range [first_chain, last_chain) that contains
+  // the edge with global id "e".
+  int ChainOfEdge(int e, int first_chain, int last_chain) const;
+
+  // Returns the edge at the given offset within chain "i" of a polyline or
+  // polygon.
+  S2Shape::Edge ChainEdge(int i, int offset) const;
+
+  int dimension_;
+  std::vector<S2Point> vertices_;
+  std::vector<int> chain_starts_;
+  std::vector<int> shape_starts_;
+
+  // The global id of the first edge of each chain, plus a final entry equal
+  // to the total number of edges.  (For points this equals chain_starts_.)
+  std::vector<int> chain_edge_starts_;
+};
+
+#endif  // S2_S2COLUMNAR_SHAPES_H_
@@ -0,0 +1,183 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2columnar_shapes.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2lax_polyline_shape.h"
+#include "s2/s2point.h"
+#include "s2/s2point_vector_shape.h"
+#include "s2/s2shape.h"
+#include "s2/s2shapeutil_testing.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+
+using std::make_shared;
+using std::make_unique;
+using std::vector;
+
+namespace {
+
+// Each shape is a vector of chains.
+using Geometry = vector<vector<S2Point>>;
+
+std::shared_ptr<S2ColumnarShapes> MakeColumnarShapes(
+    int dimension, const vector<Geometry>& geometries) {
+  vector<S2Point> vertices;
+  vector<int> chain_starts = {0}, shape_starts = {0};
+  for (const Geometry& geometry : geometries) {
+    for (const auto& chain : geometry) {
+      vertices.insert(vertices.end(), chain.begin(), chain.end());
+      chain_starts.push_back(vertices.size());
+    }
+    shape_starts.push_back(chain_starts.size() - 1);
+  }
+  return make_shared<S2ColumnarShapes>(dimension, std::move(vertices),
+                                       std::move(chain_starts),
+                                       std::move(shape_starts));
+}
+
+vector<Geometry> MakeRandomPolygons(int num_polygons) {
+  vector<Geometry> polygons;
+  for (int i = 0; i < num_polygons; ++i) {
+    Geometry polygon;
+    S2Point center = S2Testing::RandomPoint();
+    polygon.push_back(S2Testing::MakeRegularPoints(
+        center, S1Angle::Degrees(1), 3 + S2Testing::rnd.Uniform(10)));
+    if (S2Testing::rnd.OneIn(2)) {
+      // Add a hole.
+      auto hole = S2Testing::MakeRegularPoints(center, S1Angle::Degrees(0.5),
+                                               3);
+      std::reverse(hole.begin(), hole.end());
+      polygon.push_back(std::move(hole));
+    }
+    polygons.push_back(std::move(polygon));
+  }
+  return polygons;
+}
+
+TEST(S2ColumnarShapes, PolygonsMatchLaxPolygonShape) {
+  S2Testing::rnd.Reset(1);
+  vector<Geometry> polygons = MakeRandomPolygons(20);
+  // Also test the empty and full polygons, and degenerate loops.
+  polygons.push_back({});
+  polygons.push_back({{}});
+  polygons.push_back({{S2Testing::RandomPoint()},
+                      {S2Testing::RandomPoint(), S2Testing::RandomPoint()}});
+  auto shapes = S2ColumnarShapes::MakeShapes(
+      MakeColumnarShapes(2, polygons));
+  ASSERT_EQ(shapes.size(), polygons.size());
+  for (int i = 0; i < polygons.size(); ++i) {
+    s2testing::ExpectEqual(*shapes[i], S2LaxPolygonShape(polygons[i]));
+  }
+}
+
+TEST(S2ColumnarShapes, PolylinesMatchLaxPolylineShape) {
+  vector<Geometry> polylines = {
+      {s2textformat::ParsePointsOrDie("0:0, 0:1, 1:1")},
+      {s2textformat::ParsePointsOrDie("2:2, 3:3")},
+      {s2textformat::ParsePointsOrDie("5:5")},
+  };
+  auto shapes = S2ColumnarShapes::MakeShapes(
+      MakeColumnarShapes(1, polylines));
+  for (int i = 0; i < 2; ++i) {
+    s2testing::ExpectEqual(*shapes[i], S2LaxPolylineShape(polylines[i][0]));
+  }
+  // Unlike S2LaxPolylineShape, a single-vertex polyline has one empty chain.
+  EXPECT_EQ(shapes[2]->num_edges(), 0);
+  EXPECT_EQ(shapes[2]->num_chains(), 1);
+  EXPECT_EQ(shapes[2]->chain(0), S2Shape::Chain(0, 0));
+}
+
+TEST(S2ColumnarShapes, MultiPolyline) {
+  // A shape with several chains, including ones with no edges.
+  vector<Geometry> polylines = {
+      {s2textformat::ParsePointsOrDie("9:9, 9:8")},
+      {s2textformat::ParsePointsOrDie("0:0, 0:1, 0:2"),
+       s2textformat::ParsePointsOrDie("1:1"),
+       s2textformat::ParsePointsOrDie("2:0, 2:1")},
+  };
+  auto shapes = S2ColumnarShapes::MakeShapes(
+      MakeColumnarShapes(1, polylines));
+  const S2Shape& shape = *shapes[1];
+  EXPECT_EQ(shape.dimension(), 1);
+  ASSERT_EQ(shape.num_edges(), 3);
+  ASSERT_EQ(shape.num_chains(), 3);
+  EXPECT_EQ(shape.chain(0), S2Shape::Chain(0, 2));
+  EXPECT_EQ(shape.chain(1), S2Shape::Chain(2, 0));
+  EXPECT_EQ(shape.chain(2), S2Shape::Chain(2, 1));
+  EXPECT_EQ(shape.chain_position(2), S2Shape::ChainPosition(2, 0));
+  EXPECT_EQ(shape.edge(2), shape.chain_edge(2, 0));
+  EXPECT_EQ(shape.edge(2).v0, polylines[1][2][0]);
+  EXPECT_FALSE(shape.GetReferencePoint().contained);
+  s2testing::ExpectChainVertexSpansValid(shape);
+}
+
+TEST(S2ColumnarShapes, PointsMatchPointVectorShape) {
+  vector<Geometry> points = {
+      {s2textformat::ParsePointsOrDie("0:0, 0:1")},
+      {},
+      {s2textformat::ParsePointsOrDie("1:1"),
+       s2textformat::ParsePointsOrDie("2:2, 3:3")},
+  };
+  auto shapes = S2ColumnarShapes::MakeShapes(MakeColumnarShapes(0, points));
+  s2testing::ExpectEqual(*shapes[0], S2PointVectorShape(points[0][0]));
+  s2testing::ExpectEqual(*shapes[1], S2PointVectorShape());
+  s2testing::ExpectEqual(
+      *shapes[2], S2PointVectorShape(s2textformat::ParsePointsOrDie(
+                      "1:1, 2:2, 3:3")));
+}
+
+TEST(S2ColumnarShapes, AddShapesMatchesAdd) {
+  S2Testing::rnd.Reset(2);
+  vector<Geometry> polygons = MakeRandomPolygons(100);
+  MutableS2ShapeIndex expected, actual;
+  for (const Geometry& polygon : polygons) {
+    expected.Add(make_unique<S2LaxPolygonShape>(polygon));
+  }
+  actual.Add(make_unique<S2LaxPolygonShape>());
+  EXPECT_EQ(actual.AddShapes(S2ColumnarShapes::MakeShapes(
+                MakeColumnarShapes(2, polygons))),
+            1);
+  EXPECT_EQ(actual.AddShapes({}), actual.num_shape_ids());
+  ASSERT_EQ(actual.num_shape_ids(), polygons.size() + 1);
+
+  auto expected_query = MakeS2ContainsPointQuery(&expected);
+  auto actual_query = MakeS2ContainsPointQuery(&actual);
+  for (int i = 0; i < 1000; ++i) {
+    S2Point p = S2Testing::RandomPoint();
+    vector<int> expected_ids, actual_ids;
+    expected_query.VisitContainingShapeIds(p, [&](int shape_id) {
+      expected_ids.push_back(shape_id + 1);
+      return true;
+    });
+    actual_query.VisitContainingShapeIds(p, [&](int shape_id) {
+      actual_ids.push_back(shape_id);
+      return true;
+    });
+    EXPECT_EQ(actual_ids, expected_ids);
+  }
+}
+
+}  // namespace
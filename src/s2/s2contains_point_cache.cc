@@ -0,0 +1,75 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2contains_point_cache.h"
+
+#include <vector>
+
+#include "absl/log/absl_check.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "s2/s2cell_id.h"
+
+void S2ContainsPointCache::Options::set_level(int level) {
+  ABSL_DCHECK_GE(level, 0);
+  ABSL_DCHECK_LE(level, S2CellId::kMaxLevel);
+  level_ = level;
+}
+
+S2ContainsPointCache::S2ContainsPointCache()
+    : S2ContainsPointCache(Options()) {}
+
+S2ContainsPointCache::S2ContainsPointCache(const Options& options)
+    : options_(options) {
+  ABSL_DCHECK_GE(options.max_cells(), 0);
+}
+
+bool S2ContainsPointCache::Lookup(S2CellId key,
+                                  std::vector<int>* shape_ids) const {
+  {
+    absl::ReaderMutexLock l(&lock_);
+    auto it = cells_.find(key);
+    if (it != cells_.end()) {
+      shape_ids->assign(it->second.begin(), it->second.end());
+      num_hits_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  num_misses_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void S2ContainsPointCache::Insert(S2CellId key,
+                                  absl::Span<const int> shape_ids) {
+  ABSL_DCHECK_EQ(key.level(), options_.level());
+  absl::MutexLock l(&lock_);
+  if (static_cast<int>(cells_.size()) >= options_.max_cells()) return;
+  cells_.try_emplace(key, shape_ids.begin(), shape_ids.end());
+}
+
+void S2ContainsPointCache::Clear() {
+  absl::MutexLock l(&lock_);
+  cells_.clear();
+}
+
+int S2ContainsPointCache::num_cells() const {
+  absl::ReaderMutexLock l(&lock_);
+  return static_cast<int>(cells_.size());
+}
+
+double S2ContainsPointCache::hit_rate() const {
+  int64 hits = num_hits(), total = hits + num_misses();
+  return total == 0 ? 0 : static_cast<double>(hits) / total;
+}
@@ -0,0 +1,124 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2CONTAINS_POINT_CACHE_H_
+#define S2_S2CONTAINS_POINT_CACHE_H_
+
+#include <atomic>
+#include <vector>
+
+#include "s2/base/types.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "s2/s2cell_id.h"
+
+// S2ContainsPointCache remembers the shapes that contain the points of
+// S2CellIds at a fixed level, so that S2ContainsPointQuery can answer
+// queries that land in the same cells without locating the point in the
+// index.  This is useful when the query points are heavily concentrated in a
+// few areas (e.g., cities).
+//
+// A cell is only cached when it is contained by an index cell that has no
+// edges at all, since then every point in the cell is contained by exactly
+// the same shapes (namely those whose S2ClippedShape::contains_center() is
+// true).  Query points that land near shape boundaries are therefore never
+// answered from the cache, and results do not depend on the vertex model.
+//
+// A cache is passed to S2ContainsPointQuery using its options (see
+// S2ContainsPointQueryOptions::set_result_cache), and unlike S2IndexEdgeCache
+// it is thread-safe, so that it can be shared by the queries of all threads:
+//
+//   S2ContainsPointCache cache;  // Shared by all threads.
+//   ...
+//   S2ContainsPointQueryOptions options;
+//   options.set_result_cache(&cache);
+//   auto query = MakeS2ContainsPointQuery(&index, options);
+//
+// A cache may only be used with a single S2ShapeIndex, and Clear() must be
+// called whenever that index is modified.
+class S2ContainsPointCache {
+ public:
+  class Options {
+   public:
+    // The level of the S2CellIds used as cache keys.  Smaller cells are more
+    // likely to be contained by an edge-free index cell, but each entry
+    // applies to a smaller area.
+    //
+    // DEFAULT: 16 (about 150 meters)
+    int level() const { return level_; }
+    void set_level(int level);
+
+    // The maximum number of cells that are cached.  Once the cache is full,
+    // new cells are not added until Clear() is called.
+    //
+    // DEFAULT: 65536
+    int max_cells() const { return max_cells_; }
+    void set_max_cells(int max_cells) { max_cells_ = max_cells; }
+
+   private:
+    int level_ = 16;
+    int max_cells_ = 1 << 16;
+  };
+
+  S2ContainsPointCache();
+  explicit S2ContainsPointCache(const Options& options);
+
+  S2ContainsPointCache(const S2ContainsPointCache&) = delete;
+  S2ContainsPointCache& operator=(const S2ContainsPointCache&) = delete;
+
+  const Options& options() const { return options_; }
+
+  // Returns the cache key for the given leaf cell, i.e. its ancestor at
+  // options().level().
+  S2CellId GetKey(S2CellId leaf) const { return leaf.parent(options_.level()); }
+
+  // If the containing shapes of the cell "key" are cached, sets "shape_ids"
+  // to their ids in increasing order and returns true.  Otherwise returns
+  // false.
+  bool Lookup(S2CellId key, std::vector<int>* shape_ids) const;
+
+  // Records that every point of the cell "key" is contained by exactly the
+  // shapes in "shape_ids", which must be in increasing order.  Does nothing
+  // if the cell is already cached or the cache is full.
+  void Insert(S2CellId key, absl::Span<const int> shape_ids);
+
+  // Removes all cells from the cache.  The statistics are not reset.
+  void Clear();
+
+  // Returns the number of cached cells.
+  int num_cells() const;
+
+  // The number of calls to Lookup() that found and did not find the cell.
+  int64 num_hits() const { return num_hits_.load(std::memory_order_relaxed); }
+  int64 num_misses() const {
+    return num_misses_.load(std::memory_order_relaxed);
+  }
+
+  // Returns num_hits() / (num_hits() + num_misses()), or 0 if there have
+  // been no lookups.
+  double hit_rate() const;
+
+ private:
+  const Options options_;
+  mutable absl::Mutex lock_;
+  absl::flat_hash_map<S2CellId, std::vector<int>, S2CellIdHash> cells_
+      ABSL_GUARDED_BY(lock_);
+  mutable std::atomic<int64> num_hits_{0};
+  mutable std::atomic<int64> num_misses_{0};
+};
+
+#endif  // S2_S2CONTAINS_POINT_CACHE_H_
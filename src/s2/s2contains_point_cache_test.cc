@@ -0,0 +1,145 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2contains_point_cache.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2latlng.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+TEST(S2ContainsPointCache, LookupAndInsert) {
+  S2ContainsPointCache::Options options;
+  options.set_level(10);
+  options.set_max_cells(2);
+  S2ContainsPointCache cache(options);
+  S2CellId key1 = cache.GetKey(S2CellId(S2Point(1, 0, 0)));
+  S2CellId key2 = cache.GetKey(S2CellId(S2Point(0, 1, 0)));
+  S2CellId key3 = cache.GetKey(S2CellId(S2Point(0, 0, 1)));
+  EXPECT_EQ(key1.level(), 10);
+
+  vector<int> ids = {99};
+  EXPECT_FALSE(cache.Lookup(key1, &ids));
+  cache.Insert(key1, {1, 3});
+  cache.Insert(key2, {});
+  EXPECT_TRUE(cache.Lookup(key1, &ids));
+  EXPECT_EQ(ids, (vector<int>{1, 3}));
+  EXPECT_TRUE(cache.Lookup(key2, &ids));
+  EXPECT_TRUE(ids.empty());
+
+  // The cache is full.
+  cache.Insert(key3, {2});
+  EXPECT_FALSE(cache.Lookup(key3, &ids));
+  EXPECT_EQ(cache.num_cells(), 2);
+  EXPECT_EQ(cache.num_hits(), 2);
+  EXPECT_EQ(cache.num_misses(), 2);
+  EXPECT_DOUBLE_EQ(cache.hit_rate(), 0.5);
+
+  cache.Clear();
+  EXPECT_EQ(cache.num_cells(), 0);
+  EXPECT_FALSE(cache.Lookup(key1, &ids));
+}
+
+// Returns an index of overlapping polygons and a polyline.  The polygons
+// have enough edges that the index has many edge-free cells both inside and
+// outside them.
+unique_ptr<MutableS2ShapeIndex> MakeIndex() {
+  auto index = make_unique<MutableS2ShapeIndex>();
+  for (double radius : {3.0, 6.0}) {
+    index->Add(make_unique<S2Loop::OwningShape>(S2Loop::MakeRegularLoop(
+        S2Point(1, 0, 0), S1Angle::Degrees(radius), 2000)));
+  }
+  index->Add(s2textformat::MakeLaxPolygonOrDie("-5:-5, -5:5, 5:5, 5:-5"));
+  index->Add(s2textformat::MakeLaxPolylineOrDie("0:0, 1:1, 2:0"));
+  index->ForceBuild();
+  return index;
+}
+
+TEST(S2ContainsPointCache, QueryMatchesUncached) {
+  auto index = MakeIndex();
+  S2Testing::rnd.Reset(1);
+  // Concentrate the query points in a few areas, as in real workloads.
+  vector<S2Point> centers;
+  for (int i = 0; i < 10; ++i) {
+    centers.push_back(S2Testing::SamplePoint(
+        S2Cap(S2Point(1, 0, 0), S1Angle::Degrees(8))));
+  }
+  for (S2VertexModel model : {S2VertexModel::OPEN, S2VertexModel::SEMI_OPEN,
+                              S2VertexModel::CLOSED}) {
+    S2ContainsPointCache::Options cache_options;
+    cache_options.set_level(12);
+    S2ContainsPointCache cache(cache_options);
+    S2ContainsPointQueryOptions options(model);
+    auto query = MakeS2ContainsPointQuery(index.get(), options);
+    options.set_result_cache(&cache);
+    auto cached_query = MakeS2ContainsPointQuery(index.get(), options);
+    for (int i = 0; i < 5000; ++i) {
+      S2Point p = S2Testing::SamplePoint(S2Cap(
+          centers[i % centers.size()], S1Angle::Degrees(0.2)));
+      ASSERT_EQ(query.GetContainingShapeIds(p),
+                cached_query.GetContainingShapeIds(p));
+      ASSERT_EQ(query.Contains(p), cached_query.Contains(p));
+      for (int shape_id = 0; shape_id < index->num_shape_ids(); ++shape_id) {
+        ASSERT_EQ(query.ShapeContains(shape_id, p),
+                  cached_query.ShapeContains(shape_id, p));
+      }
+    }
+    EXPECT_GT(cache.num_cells(), 0);
+    EXPECT_GT(cache.hit_rate(), 0.25);
+  }
+}
+
+TEST(S2ContainsPointCache, SharedByThreads) {
+  auto index = MakeIndex();
+  S2ContainsPointCache cache;
+  constexpr int kNumThreads = 4;
+  vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&index, &cache, t]() {
+      S2ContainsPointQueryOptions options;
+      auto query = MakeS2ContainsPointQuery(index.get(), options);
+      options.set_result_cache(&cache);
+      auto cached_query = MakeS2ContainsPointQuery(index.get(), options);
+      for (int i = 0; i < 2000; ++i) {
+        // Each point is queried repeatedly, by every thread.
+        S2Point p = S2LatLng::FromDegrees(-1.5 + 0.001 * (i % 100),
+                                          -1.0 + 0.001 * t).ToPoint();
+        ASSERT_EQ(query.GetContainingShapeIds(p),
+                  cached_query.GetContainingShapeIds(p));
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  EXPECT_GT(cache.num_hits(), 0);
+}
+
+}  // namespace
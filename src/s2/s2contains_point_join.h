@@ -0,0 +1,254 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2CONTAINS_POINT_JOIN_H_
+#define S2_S2CONTAINS_POINT_JOIN_H_
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include "s2/base/executor.h"
+#include "absl/container/inlined_vector.h"
+#include "absl/functional/function_ref.h"
+#include "absl/log/absl_check.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_iterator.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2point.h"
+#include "s2/s2shape_index.h"
+
+// S2ContainsPointJoin assigns a very large stream of points to the shapes of
+// an S2ShapeIndex that contain them (e.g., assigning billions of points to
+// administrative regions).  Each point is given as a leaf S2CellId together
+// with an arbitrary payload, and points are supplied in chunks.  Each chunk
+// is sorted by S2CellId (if it is not sorted already) and then scanned in
+// lockstep with the index, so that each index cell is located once per run
+// of points that it contains rather than once per point.
+//
+// Index cells that have no edges (i.e., cells that are entirely inside or
+// outside every shape that they intersect) are resolved without any
+// geometric predicates, which is the common case for points that are not
+// near a shape boundary.
+//
+// Example usage:
+//
+//   using Join = S2ContainsPointJoin<MutableS2ShapeIndex, int64_t>;
+//   S2ContainsPointQueryOptions options;
+//   options.set_num_threads(8);
+//   Join join(&index, options);
+//   join.Join(
+//       [&](Join::Chunk* chunk) { return ReadNextChunk(chunk); },
+//       [&](const Join::Record& record, int shape_id) {
+//         Emit(record.second, shape_id);
+//         return true;
+//       });
+//
+// The results are identical to calling S2ContainsPointQuery::
+// VisitContainingShapeIds() on the center of each leaf cell, using the
+// vertex model specified in the options.
+//
+// This class is thread-safe for const methods, i.e. different threads may
+// run joins on the same object concurrently.
+template <class IndexType, class Payload>
+class S2ContainsPointJoin {
+ public:
+  using Options = S2ContainsPointQueryOptions;
+
+  // A point (represented by a leaf S2CellId) and its payload.
+  using Record = std::pair<S2CellId, Payload>;
+  using Chunk = std::vector<Record>;
+
+  // A function that fills "chunk" with the next records of the input and
+  // returns true, or returns false if there is no more input.  "chunk" is
+  // cleared before each call.
+  using ChunkSource = absl::FunctionRef<bool(Chunk* chunk)>;
+
+  // A function that is called with a record and the id of a shape that
+  // contains it.  It may return false to stop the join.
+  using Visitor = absl::FunctionRef<bool(const Record& record, int shape_id)>;
+
+  // Options::num_threads() is the maximum number of chunks that Join()
+  // processes concurrently, and Options::executor() (if non-null) is used to
+  // run the additional threads.
+  explicit S2ContainsPointJoin(const IndexType* index,
+                               const Options& options = Options());
+
+  const IndexType& index() const { return *index_; }
+  const Options& options() const { return options_; }
+
+  // Visits every (record, shape_id) pair such that the given shape contains
+  // the record's point, and returns false if "visitor" returned false.
+  // The records are first sorted by S2CellId (stably, so that records with
+  // the same S2CellId retain their order) unless they are already sorted.
+  // Records are visited in sorted order, and the shapes containing each
+  // record are visited in increasing order of shape id.
+  //
+  // REQUIRES: Every record's S2CellId is a leaf cell.
+  bool JoinChunk(Chunk* chunk, Visitor visitor) const;
+
+  // Like JoinChunk(), but reads chunks from "source" until it returns false
+  // and processes up to options().num_threads() chunks concurrently.  Calls
+  // to "source" and "visitor" are serialized, and all the pairs of a chunk
+  // are visited consecutively (as in JoinChunk), but the order in which
+  // chunks are visited is unspecified when more than one thread is used.
+  bool Join(ChunkSource source, Visitor visitor) const;
+
+ private:
+  using Iterator = typename IndexType::Iterator;
+
+  // Sorts "chunk" if necessary and stores the ids of the shapes containing
+  // each record in compressed sparse row format (see
+  // S2ContainsPointBatchResult).
+  void ProcessChunk(Chunk* chunk, Iterator* it,
+                    S2ContainsPointBatchResult* result) const;
+
+  // Visits the pairs computed by ProcessChunk().
+  static bool VisitChunk(const Chunk& chunk,
+                         const S2ContainsPointBatchResult& result,
+                         Visitor visitor);
+
+  const IndexType* index_;
+  Options options_;
+  // Used only for its const ShapeContains() method.
+  S2ContainsPointQuery<IndexType> query_;
+};
+
+
+//////////////////   Implementation details follow   ////////////////////
+
+
+template <class IndexType, class Payload>
+S2ContainsPointJoin<IndexType, Payload>::S2ContainsPointJoin(
+    const IndexType* index, const Options& options)
+    : index_(index), options_(options), query_(index, options) {}
+
+template <class IndexType, class Payload>
+bool S2ContainsPointJoin<IndexType, Payload>::JoinChunk(
+    Chunk* chunk, Visitor visitor) const {
+  Iterator it(index_);
+  S2ContainsPointBatchResult result;
+  ProcessChunk(chunk, &it, &result);
+  return VisitChunk(*chunk, result, visitor);
+}
+
+template <class IndexType, class Payload>
+bool S2ContainsPointJoin<IndexType, Payload>::Join(ChunkSource source,
+                                                   Visitor visitor) const {
+  absl::Mutex source_mutex, visitor_mutex;
+  bool source_done = false;  // Protected by source_mutex.
+  std::atomic<bool> cancelled(false);
+  auto run = [&]() {
+    Iterator it(index_);
+    Chunk chunk;
+    S2ContainsPointBatchResult result;
+    while (!cancelled.load(std::memory_order_relaxed)) {
+      chunk.clear();
+      {
+        absl::MutexLock lock(&source_mutex);
+        if (source_done || !source(&chunk)) {
+          source_done = true;
+          return;
+        }
+      }
+      ProcessChunk(&chunk, &it, &result);
+      absl::MutexLock lock(&visitor_mutex);
+      if (cancelled.load(std::memory_order_relaxed)) return;
+      if (!VisitChunk(chunk, result, visitor)) {
+        cancelled.store(true, std::memory_order_relaxed);
+      }
+    }
+  };
+  s2base::RunConcurrently(options_.executor(), options_.num_threads(), run);
+  return !cancelled.load();
+}
+
+template <class IndexType, class Payload>
+void S2ContainsPointJoin<IndexType, Payload>::ProcessChunk(
+    Chunk* chunk, Iterator* it, S2ContainsPointBatchResult* result) const {
+  auto id_less = [](const Record& a, const Record& b) {
+    return a.first < b.first;
+  };
+  if (!std::is_sorted(chunk->begin(), chunk->end(), id_less)) {
+    std::stable_sort(chunk->begin(), chunk->end(), id_less);
+  }
+  result->offsets.assign(1, 0);
+  result->shape_ids.clear();
+
+  // The range of leaf cells covered by the current index cell, and the ids
+  // of the shapes that contain the entire cell.  "cell" is nullptr if the
+  // current range is not covered by any index cell.
+  S2CellId range_min = S2CellId::Sentinel(), range_max = S2CellId::None();
+  S2CellId cell_id;
+  const S2ShapeIndexCell* cell = nullptr;
+  bool cell_has_edges = false;
+  absl::InlinedVector<int, 4> interior_ids;
+  for (const Record& record : *chunk) {
+    const S2CellId id = record.first;
+    ABSL_DCHECK(id.is_leaf());
+    if (id < range_min || id > range_max) {
+      if (it->LocateNear(id) == S2CellRelation::INDEXED) {
+        cell_id = it->id();
+        cell = &it->cell();
+        range_min = cell_id.range_min();
+        range_max = cell_id.range_max();
+        cell_has_edges = false;
+        interior_ids.clear();
+        for (const S2ClippedShape& clipped : cell->clipped_shapes()) {
+          if (clipped.num_edges() > 0) {
+            cell_has_edges = true;
+          } else if (clipped.contains_center()) {
+            interior_ids.push_back(clipped.shape_id());
+          }
+        }
+      } else {
+        cell = nullptr;
+        range_min = range_max = id;
+      }
+    }
+    if (cell != nullptr) {
+      if (!cell_has_edges) {
+        // Every shape either contains or excludes the entire cell.
+        result->shape_ids.insert(result->shape_ids.end(),
+                                 interior_ids.begin(), interior_ids.end());
+      } else {
+        const S2Point p = id.ToPoint();
+        for (const S2ClippedShape& clipped : cell->clipped_shapes()) {
+          if (query_.ShapeContains(cell_id, clipped, p)) {
+            result->shape_ids.push_back(clipped.shape_id());
+          }
+        }
+      }
+    }
+    result->offsets.push_back(static_cast<int>(result->shape_ids.size()));
+  }
+}
+
+template <class IndexType, class Payload>
+bool S2ContainsPointJoin<IndexType, Payload>::VisitChunk(
+    const Chunk& chunk, const S2ContainsPointBatchResult& result,
+    Visitor visitor) {
+  for (int i = 0; i < static_cast<int>(chunk.size()); ++i) {
+    for (int shape_id : result.containing_shape_ids(i)) {
+      if (!visitor(chunk[i], shape_id)) return false;
+    }
+  }
+  return true;
+}
+
+#endif  // S2_S2CONTAINS_POINT_JOIN_H_
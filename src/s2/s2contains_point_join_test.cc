@@ -0,0 +1,183 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2contains_point_join.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2point.h"
+#include "s2/s2testing.h"
+
+using std::make_unique;
+using std::pair;
+using std::vector;
+
+namespace {
+
+using Join = S2ContainsPointJoin<MutableS2ShapeIndex, int>;
+
+// Builds an index of overlapping polygons within "cap" and appends their
+// vertices (snapped to leaf cell centers) to "vertices", so that test points
+// can be chosen at polygon vertices where the vertex model matters.
+void BuildIndex(const S2Cap& cap, MutableS2ShapeIndex* index,
+                vector<S2Point>* vertices) {
+  for (int i = 0; i < 10; ++i) {
+    S1Angle radius = cap.GetRadius() * S2Testing::rnd.RandDouble();
+    vector<S2Point> loop = S2Testing::MakeRegularPoints(
+        S2Testing::SamplePoint(cap), radius, 3 + S2Testing::rnd.Uniform(20));
+    for (S2Point& p : loop) p = S2CellId(p).ToPoint();
+    vertices->insert(vertices->end(), loop.begin(), loop.end());
+    index->Add(make_unique<S2LaxPolygonShape>(
+        vector<vector<S2Point>>{std::move(loop)}));
+  }
+}
+
+Join::Chunk MakeChunk(const S2Cap& cap, const vector<S2Point>& vertices,
+                      int num_records, int first_payload) {
+  Join::Chunk chunk;
+  for (int i = 0; i < num_records; ++i) {
+    S2Point p = S2Testing::rnd.OneIn(10)
+                    ? vertices[S2Testing::rnd.Uniform(vertices.size())]
+                    : S2Testing::SamplePoint(cap);
+    chunk.emplace_back(S2CellId(p), first_payload + i);
+  }
+  return chunk;
+}
+
+// Returns the (payload, shape_id) pairs computed by S2ContainsPointQuery.
+vector<pair<int, int>> GetPairsBruteForce(
+    const MutableS2ShapeIndex& index, const Join::Chunk& chunk,
+    const S2ContainsPointQueryOptions& options) {
+  auto query = MakeS2ContainsPointQuery(&index, options);
+  vector<pair<int, int>> pairs;
+  for (const auto& record : chunk) {
+    query.VisitContainingShapeIds(record.first.ToPoint(), [&](int shape_id) {
+      pairs.emplace_back(record.second, shape_id);
+      return true;
+    });
+  }
+  return pairs;
+}
+
+TEST(S2ContainsPointJoin, EmptyIndex) {
+  MutableS2ShapeIndex index;
+  Join join(&index);
+  Join::Chunk chunk = {{S2CellId(S2Point(1, 0, 0)), 0}};
+  EXPECT_TRUE(join.JoinChunk(&chunk, [](const Join::Record&, int) {
+    ADD_FAILURE();
+    return true;
+  }));
+}
+
+TEST(S2ContainsPointJoin, JoinChunkMatchesQuery) {
+  S2Testing::rnd.Reset(1);
+  for (S2VertexModel model : {S2VertexModel::OPEN, S2VertexModel::SEMI_OPEN,
+                              S2VertexModel::CLOSED}) {
+    S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(5));
+    MutableS2ShapeIndex index;
+    vector<S2Point> vertices;
+    BuildIndex(cap, &index, &vertices);
+    S2ContainsPointQueryOptions options(model);
+    Join join(&index, options);
+
+    Join::Chunk chunk = MakeChunk(cap, vertices, 2000, 0);
+    Join::Chunk sorted = chunk;
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const Join::Record& a, const Join::Record& b) {
+                       return a.first < b.first;
+                     });
+    vector<pair<int, int>> actual;
+    EXPECT_TRUE(join.JoinChunk(&chunk, [&](const Join::Record& record,
+                                           int shape_id) {
+      actual.emplace_back(record.second, shape_id);
+      return true;
+    }));
+    EXPECT_EQ(chunk, sorted);
+    EXPECT_EQ(actual, GetPairsBruteForce(index, sorted, options));
+  }
+}
+
+TEST(S2ContainsPointJoin, StreamMatchesQuery) {
+  S2Testing::rnd.Reset(2);
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(5));
+  MutableS2ShapeIndex index;
+  vector<S2Point> vertices;
+  BuildIndex(cap, &index, &vertices);
+  vector<Join::Chunk> chunks;
+  for (int i = 0; i < 20; ++i) {
+    chunks.push_back(MakeChunk(cap, vertices, 500, 500 * i));
+  }
+  vector<pair<int, int>> expected;
+  for (const Join::Chunk& chunk : chunks) {
+    auto pairs = GetPairsBruteForce(index, chunk, {});
+    expected.insert(expected.end(), pairs.begin(), pairs.end());
+  }
+  std::sort(expected.begin(), expected.end());
+
+  for (int num_threads : {1, 4}) {
+    S2ContainsPointQueryOptions options;
+    options.set_num_threads(num_threads);
+    Join join(&index, options);
+    int next_chunk = 0;
+    vector<pair<int, int>> actual;
+    EXPECT_TRUE(join.Join(
+        [&](Join::Chunk* chunk) {
+          if (next_chunk == static_cast<int>(chunks.size())) return false;
+          *chunk = chunks[next_chunk++];
+          return true;
+        },
+        [&](const Join::Record& record, int shape_id) {
+          actual.emplace_back(record.second, shape_id);
+          return true;
+        }));
+    std::sort(actual.begin(), actual.end());
+    EXPECT_EQ(actual, expected) << "num_threads = " << num_threads;
+  }
+}
+
+TEST(S2ContainsPointJoin, StopsEarly) {
+  S2Testing::rnd.Reset(3);
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(5));
+  MutableS2ShapeIndex index;
+  vector<S2Point> vertices;
+  BuildIndex(cap, &index, &vertices);
+  S2ContainsPointQueryOptions options;
+  options.set_num_threads(3);
+  Join join(&index, options);
+  int num_chunks = 0, num_visited = 0;
+  EXPECT_FALSE(join.Join(
+      [&](Join::Chunk* chunk) {
+        if (num_chunks == 100) return false;
+        *chunk = MakeChunk(cap, vertices, 100, 100 * num_chunks++);
+        return true;
+      },
+      [&](const Join::Record&, int) {
+        ++num_visited;
+        return false;
+      }));
+  EXPECT_EQ(num_visited, 1);
+}
+
+}  // namespace
@@ -18,14 +18,20 @@
 #ifndef S2_S2CONTAINS_POINT_QUERY_H_
 #define S2_S2CONTAINS_POINT_QUERY_H_
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <vector>
 
+#include "s2/base/executor.h"
 #include "s2/base/types.h"
 #include "absl/functional/function_ref.h"
+#include "absl/types/span.h"
 #include "s2/s2cell_id.h"
+#include "s2/s2contains_point_cache.h"
 #include "s2/s2edge_crosser.h"
 #include "s2/s2edge_crossings.h"
+#include "s2/s2index_edge_cache.h"
 #include "s2/s2point.h"
 #include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
@@ -66,8 +72,69 @@ class S2ContainsPointQueryOptions {
   S2VertexModel vertex_model() const;
   void set_vertex_model(S2VertexModel model);
 
+  // The maximum number of threads used by the batch version of
+  // GetContainingShapeIds().  The sorted points are divided into shards that
+  // the threads claim on demand, and each thread uses its own iterator.  The
+  // results do not depend on this value.  Single-point methods always run on
+  // the calling thread.
+  //
+  // DEFAULT: 1
+  int num_threads() const;
+  void set_num_threads(int num_threads);
+
+  // If non-null, the additional threads requested by num_threads() are run
+  // as tasks on this executor rather than being created by the query (see
+  // s2base::RunConcurrently).
+  //
+  // DEFAULT: nullptr
+  s2base::Executor* executor() const;
+  void set_executor(s2base::Executor* executor);
+
+  // If non-null, the single-point methods (Contains, ShapeContains,
+  // VisitContainingShapeIds, etc.) fetch the edges of each index cell from
+  // this cache, so that repeated queries that land in the same cells do not
+  // fetch the same edges from their shapes again (see S2IndexEdgeCache).
+  // The cache is not thread-safe and is typically shared by all the queries
+  // of one thread.  The batch version of GetContainingShapeIds() already
+  // fetches the edges of each cell once and does not use the cache.
+  //
+  // DEFAULT: nullptr
+  S2IndexEdgeCache* edge_cache() const;
+  void set_edge_cache(S2IndexEdgeCache* edge_cache);
+
+  // If non-null, the single-point methods first look up the containing
+  // shapes of the query point in this cache, and add the result to the cache
+  // when the point's index cell has no edges (see S2ContainsPointCache).
+  // The cache is thread-safe and may be shared by the queries of all
+  // threads, but only for a single index.  The batch version of
+  // GetContainingShapeIds() does not use the cache.
+  //
+  // DEFAULT: nullptr
+  S2ContainsPointCache* result_cache() const;
+  void set_result_cache(S2ContainsPointCache* result_cache);
+
  private:
   S2VertexModel vertex_model_ = S2VertexModel::SEMI_OPEN;
+  int num_threads_ = 1;
+  s2base::Executor* executor_ = nullptr;
+  S2IndexEdgeCache* edge_cache_ = nullptr;
+  S2ContainsPointCache* result_cache_ = nullptr;
+};
+
+// The result of a batch point containment query, in compressed sparse row
+// (CSR) form.  The ids of the shapes containing the i-th query point are
+// shape_ids[offsets[i]], ..., shape_ids[offsets[i + 1] - 1], in increasing
+// order.
+struct S2ContainsPointBatchResult {
+  // The number of entries is one more than the number of query points.
+  std::vector<int> offsets;
+  std::vector<int> shape_ids;
+
+  // Returns the ids of the shapes containing the i-th query point.
+  absl::Span<const int> containing_shape_ids(int i) const {
+    return absl::MakeConstSpan(shape_ids.data() + offsets[i],
+                               shape_ids.data() + offsets[i + 1]);
+  }
 };
 
 // S2ContainsPointQuery determines whether one or more shapes in an
@@ -156,6 +223,18 @@ class S2ContainsPointQuery {
   // point "p".
   std::vector<int> GetContainingShapeIds(const S2Point& p);
 
+  // Batch version of the method above, intended for testing very large
+  // numbers of points.  The containing shape ids of every point are stored
+  // in "result" (see S2ContainsPointBatchResult), which is cleared first.
+  //
+  // The points are sorted internally by S2CellId so that the index is
+  // traversed in order once per batch, and the edges of each index cell are
+  // fetched once and then tested against all the points in that cell.  Up
+  // to options().num_threads() threads are used.  The results are identical
+  // to calling GetContainingShapeIds() on each point.
+  void GetContainingShapeIds(absl::Span<const S2Point> points,
+                             S2ContainsPointBatchResult* result);
+
   // Visits all edges in the given index() that are incident to the point "p"
   // (i.e., "p" is one of the edge endpoints), terminating early if the given
   // EdgeVisitor function returns false (in which case VisitIncidentEdges
@@ -179,9 +258,55 @@ class S2ContainsPointQuery {
                      const S2Point& p) const;
 
  private:
+  // The number of sorted points that a thread claims at once in the batch
+  // version of GetContainingShapeIds().
+  static constexpr int kPointsPerShard = 1024;
+
+  // Computes the containing shapes of the points whose indices are given in
+  // "order" (which is approximately sorted by leaf cell id) using the given
+  // iterator.  The number of containing shapes of each point is stored in
+  // counts[point index], and the shape ids are appended to "shape_ids".
+  void GetContainingShapeIdsSorted(absl::Span<const S2Point> points,
+                                   const S2CellId* leaf_ids,
+                                   absl::Span<const int> order, Iterator* it,
+                                   int* counts,
+                                   std::vector<int>* shape_ids) const;
+
+  // Returns the edges of the current cell of it_ from options_.edge_cache(),
+  // or nullptr if there is no cache.
+  const S2IndexEdgeCache::CellEdges* LoadCellEdges() const;
+
+  // If options_.result_cache() contains the result for "p", stores the
+  // containing shape ids in cached_ids_ and returns true.  Otherwise sets
+  // "key" to the cache key for "p" (or S2CellId::None() if there is no
+  // cache) and returns false.
+  bool LookupCachedResult(const S2Point& p, S2CellId* key);
+
+  // Adds the result for the cell "key" to options_.result_cache() if the
+  // current cell of it_ contains "key" and has no edges.
+  void MaybeCacheResult(S2CellId key);
+
+  // Like ShapeContains(it_.id(), it_.cell().clipped(s), p), except that the
+  // edges are taken from "edges" if it is non-null (see LoadCellEdges).
+  bool ShapeContains(const S2IndexEdgeCache::CellEdges* edges, int s,
+                     const S2Point& p) const;
+
+  // Like ShapeContains(cell_id, clipped, p), except that the edges of
+  // "clipped" are supplied by the caller, and "center" is the center of the
+  // index cell.  If "float_edges" is non-empty, it must contain the same
+  // edges rounded to single precision, and is used to skip edges that
+  // certainly do not cross.
+  bool ShapeContains(
+      const S2Point& center, const S2ClippedShape& clipped, int dimension,
+      absl::Span<const S2Shape::Edge> edges, const S2Point& p,
+      absl::Span<const S2IndexEdgeCache::FloatEdge> float_edges = {}) const;
+
   const IndexType* index_;
   Options options_;
   Iterator it_;
+
+  // Temporary storage for results from options_.result_cache().
+  std::vector<int> cached_ids_;
 };
 
 // Returns an S2ContainsPointQuery for the given S2ShapeIndex.  Note that
@@ -211,6 +336,42 @@ inline void S2ContainsPointQueryOptions::set_vertex_model(S2VertexModel model) {
   vertex_model_ = model;
 }
 
+inline int S2ContainsPointQueryOptions::num_threads() const {
+  return num_threads_;
+}
+
+inline void S2ContainsPointQueryOptions::set_num_threads(int num_threads) {
+  num_threads_ = num_threads;
+}
+
+inline s2base::Executor* S2ContainsPointQueryOptions::executor() const {
+  return executor_;
+}
+
+inline S2IndexEdgeCache* S2ContainsPointQueryOptions::edge_cache() const {
+  return edge_cache_;
+}
+
+inline void S2ContainsPointQueryOptions::set_edge_cache(
+    S2IndexEdgeCache* edge_cache) {
+  edge_cache_ = edge_cache;
+}
+
+inline S2ContainsPointCache* S2ContainsPointQueryOptions::result_cache()
+    const {
+  return result_cache_;
+}
+
+inline void S2ContainsPointQueryOptions::set_result_cache(
+    S2ContainsPointCache* result_cache) {
+  result_cache_ = result_cache;
+}
+
+inline void S2ContainsPointQueryOptions::set_executor(
+    s2base::Executor* executor) {
+  executor_ = executor;
+}
+
 template <class IndexType>
 inline S2ContainsPointQuery<IndexType>::S2ContainsPointQuery()
     : index_(nullptr) {
@@ -238,12 +399,15 @@ void S2ContainsPointQuery<IndexType>::Init(const IndexType* index,
 
 template <class IndexType>
 bool S2ContainsPointQuery<IndexType>::Contains(const S2Point& p) {
+  S2CellId key;
+  if (LookupCachedResult(p, &key)) return !cached_ids_.empty();
   if (!it_.Locate(p)) return false;
+  MaybeCacheResult(key);
 
-  const S2ShapeIndexCell& cell = it_.cell();
-  int num_clipped = cell.num_clipped();
+  const S2IndexEdgeCache::CellEdges* edges = LoadCellEdges();
+  int num_clipped = it_.cell().num_clipped();
   for (int s = 0; s < num_clipped; ++s) {
-    if (ShapeContains(it_.id(), cell.clipped(s), p)) return true;
+    if (ShapeContains(edges, s, p)) return true;
   }
   return false;
 }
@@ -251,16 +415,25 @@ bool S2ContainsPointQuery<IndexType>::Contains(const S2Point& p) {
 template <class IndexType>
 bool S2ContainsPointQuery<IndexType>::ShapeContains(int shape_id,
                                                     const S2Point& p) {
+  S2CellId key;
+  if (LookupCachedResult(p, &key)) {
+    return std::binary_search(cached_ids_.begin(), cached_ids_.end(),
+                              shape_id);
+  }
   if (!it_.Locate(p)) {
     return false;
   }
+  MaybeCacheResult(key);
 
-  const S2ClippedShape* clipped = it_.cell().find_clipped(shape_id);
+  const S2ShapeIndexCell& cell = it_.cell();
+  const S2ClippedShape* clipped = cell.find_clipped(shape_id);
   if (clipped == nullptr) {
     return false;
   }
 
-  return ShapeContains(it_.id(), *clipped, p);
+  return ShapeContains(LoadCellEdges(),
+                       static_cast<int>(clipped - cell.clipped_shapes().data()),
+                       p);
 }
 
 template <class IndexType>
@@ -268,10 +441,21 @@ bool S2ContainsPointQuery<IndexType>::VisitContainingShapeIds(
     const S2Point& p, absl::FunctionRef<bool(int shape_id)> visitor) {
   // This function returns "false" only if the algorithm terminates early
   // because the "visitor" function returned false.
+  S2CellId key;
+  if (LookupCachedResult(p, &key)) {
+    for (int shape_id : cached_ids_) {
+      if (!visitor(shape_id)) return false;
+    }
+    return true;
+  }
   if (!it_.Locate(p)) return true;
+  MaybeCacheResult(key);
 
-  for (const S2ClippedShape& clipped : it_.cell().clipped_shapes()) {
-    if (ShapeContains(it_.id(), clipped, p) && !visitor(clipped.shape_id())) {
+  const S2IndexEdgeCache::CellEdges* edges = LoadCellEdges();
+  const S2ShapeIndexCell& cell = it_.cell();
+  for (int s = 0; s < cell.num_clipped(); ++s) {
+    if (ShapeContains(edges, s, p) &&
+        !visitor(cell.clipped(s).shape_id())) {
       return false;
     }
   }
@@ -333,6 +517,214 @@ std::vector<int> S2ContainsPointQuery<IndexType>::GetContainingShapeIds(
   return results;
 }
 
+template <class IndexType>
+void S2ContainsPointQuery<IndexType>::GetContainingShapeIds(
+    absl::Span<const S2Point> points, S2ContainsPointBatchResult* result) {
+  const int num_points = static_cast<int>(points.size());
+  std::vector<S2CellId> leaf_ids(num_points);
+  for (int i = 0; i < num_points; ++i) leaf_ids[i] = S2CellId(points[i]);
+
+  // The points only need to be sorted well enough for consecutive points
+  // to usually fall in the same index cell, so we sort them by the high 32
+  // bits of their leaf cell ids (i.e., to within a cell at about level 14)
+  // using an LSD radix sort, which is several times faster than std::sort.
+  // The point index is stored in the low 32 bits of each key.
+  std::vector<uint64> keys(num_points), buffer(num_points);
+  for (int i = 0; i < num_points; ++i) {
+    keys[i] = (leaf_ids[i].id() & ~uint64{0xffffffff}) | i;
+  }
+  for (int shift = 32; shift < 64; shift += 8) {
+    int offsets[257] = {0};
+    for (uint64 key : keys) ++offsets[((key >> shift) & 0xff) + 1];
+    for (int d = 0; d < 256; ++d) offsets[d + 1] += offsets[d];
+    for (uint64 key : keys) buffer[offsets[(key >> shift) & 0xff]++] = key;
+    keys.swap(buffer);
+  }
+  std::vector<int> order(num_points);
+  for (int j = 0; j < num_points; ++j) order[j] = keys[j] & 0xffffffff;
+
+  // Each shard of sorted points appends its shape ids to its own vector, so
+  // that the results are independent of how the shards are scheduled.
+  const int num_shards = (num_points + kPointsPerShard - 1) / kPointsPerShard;
+  std::vector<int> counts(num_points);
+  std::vector<std::vector<int>> shard_ids(num_shards);
+  std::atomic<int> next_shard(0);
+  auto run = [&](Iterator* it) {
+    int shard;
+    while ((shard = next_shard.fetch_add(1)) < num_shards) {
+      int begin = shard * kPointsPerShard;
+      int end = std::min(begin + kPointsPerShard, num_points);
+      GetContainingShapeIdsSorted(
+          points, leaf_ids.data(),
+          absl::MakeConstSpan(order).subspan(begin, end - begin), it,
+          counts.data(), &shard_ids[shard]);
+    }
+  };
+  int num_threads = std::min(std::max(options_.num_threads(), 1),
+                             std::max(num_shards, 1));
+  s2base::RunConcurrently(options_.executor(), num_threads, [this, &run]() {
+    Iterator it(index_);
+    run(&it);
+  });
+
+  // Convert the results to CSR form in the original point order.
+  result->offsets.resize(num_points + 1);
+  result->offsets[0] = 0;
+  for (int i = 0; i < num_points; ++i) {
+    result->offsets[i + 1] = result->offsets[i] + counts[i];
+  }
+  result->shape_ids.resize(result->offsets[num_points]);
+  for (int shard = 0; shard < num_shards; ++shard) {
+    const int* ids = shard_ids[shard].data();
+    int end = std::min((shard + 1) * kPointsPerShard, num_points);
+    for (int j = shard * kPointsPerShard; j < end; ++j) {
+      int i = order[j];
+      std::copy(ids, ids + counts[i],
+                result->shape_ids.begin() + result->offsets[i]);
+      ids += counts[i];
+    }
+  }
+}
+
+template <class IndexType>
+void S2ContainsPointQuery<IndexType>::GetContainingShapeIdsSorted(
+    absl::Span<const S2Point> points, const S2CellId* leaf_ids,
+    absl::Span<const int> order, Iterator* it, int* counts,
+    std::vector<int>* shape_ids) const {
+  // The edges of each clipped shape in the current index cell.  The edges of
+  // the i-th clipped shape are edges[edge_begin[i]..edge_begin[i+1]-1].
+  std::vector<S2Shape::Edge> edges;
+  std::vector<int> edge_begin, dimensions;
+  S2CellId cell_id = S2CellId::None();
+  S2Point center;
+  for (int point_index : order) {
+    counts[point_index] = 0;
+    if (it->LocateNear(leaf_ids[point_index]) != S2CellRelation::INDEXED) {
+      continue;
+    }
+
+    const S2ShapeIndexCell& cell = it->cell();
+    if (it->id() != cell_id) {
+      cell_id = it->id();
+      center = cell_id.ToPoint();
+      edges.clear();
+      edge_begin.assign(1, 0);
+      dimensions.clear();
+      for (const S2ClippedShape& clipped : cell.clipped_shapes()) {
+        const S2Shape& shape = *index_->shape(clipped.shape_id());
+        dimensions.push_back(shape.dimension());
+        // Points and polylines don't need their edges unless the vertex
+        // model is CLOSED (see ShapeContains).
+        if (shape.dimension() == 2 ||
+            options_.vertex_model() == S2VertexModel::CLOSED) {
+          for (int i = 0; i < clipped.num_edges(); ++i) {
+            edges.push_back(shape.edge(clipped.edge(i)));
+          }
+        }
+        edge_begin.push_back(static_cast<int>(edges.size()));
+      }
+    }
+    const S2Point& p = points[point_index];
+    for (int s = 0; s < cell.num_clipped(); ++s) {
+      const S2ClippedShape& clipped = cell.clipped(s);
+      auto clipped_edges = absl::MakeConstSpan(edges).subspan(
+          edge_begin[s], edge_begin[s + 1] - edge_begin[s]);
+      if (ShapeContains(center, clipped, dimensions[s], clipped_edges, p)) {
+        shape_ids->push_back(clipped.shape_id());
+        ++counts[point_index];
+      }
+    }
+  }
+}
+
+template <class IndexType>
+inline const S2IndexEdgeCache::CellEdges*
+S2ContainsPointQuery<IndexType>::LoadCellEdges() const {
+  if (options_.edge_cache() == nullptr) return nullptr;
+  return &options_.edge_cache()->Load(*index_, it_.id(), it_.cell());
+}
+
+template <class IndexType>
+inline bool S2ContainsPointQuery<IndexType>::LookupCachedResult(
+    const S2Point& p, S2CellId* key) {
+  S2ContainsPointCache* cache = options_.result_cache();
+  if (cache == nullptr) {
+    *key = S2CellId::None();
+    return false;
+  }
+  *key = cache->GetKey(S2CellId(p));
+  return cache->Lookup(*key, &cached_ids_);
+}
+
+template <class IndexType>
+void S2ContainsPointQuery<IndexType>::MaybeCacheResult(S2CellId key) {
+  if (key == S2CellId::None() || !it_.id().contains(key)) return;
+  cached_ids_.clear();
+  for (const S2ClippedShape& clipped : it_.cell().clipped_shapes()) {
+    if (clipped.num_edges() > 0) return;
+    if (clipped.contains_center()) cached_ids_.push_back(clipped.shape_id());
+  }
+  options_.result_cache()->Insert(key, cached_ids_);
+}
+
+template <class IndexType>
+inline bool S2ContainsPointQuery<IndexType>::ShapeContains(
+    const S2IndexEdgeCache::CellEdges* edges, int s, const S2Point& p) const {
+  const S2ClippedShape& clipped = it_.cell().clipped(s);
+  if (edges == nullptr || clipped.num_edges() == 0) {
+    return ShapeContains(it_.id(), clipped, p);
+  }
+  return ShapeContains(it_.id().ToPoint(), clipped,
+                       index_->shape(clipped.shape_id())->dimension(),
+                       edges->clipped_edges(s), p,
+                       edges->clipped_float_edges(s));
+}
+
+template <class IndexType>
+bool S2ContainsPointQuery<IndexType>::ShapeContains(
+    const S2Point& center, const S2ClippedShape& clipped, int dimension,
+    absl::Span<const S2Shape::Edge> edges, const S2Point& p,
+    absl::Span<const S2IndexEdgeCache::FloatEdge> float_edges) const {
+  // This must return the same results as the method below.
+  bool inside = clipped.contains_center();
+  if (clipped.num_edges() == 0) return inside;
+  if (dimension < 2) {
+    if (options_.vertex_model() != S2VertexModel::CLOSED) return false;
+    for (const S2Shape::Edge& edge : edges) {
+      if (edge.v0 == p || edge.v1 == p) return true;
+    }
+    return false;
+  }
+  // Edges are usually stored as chains, in which case the crosser can reuse
+  // the orientation computed for the shared vertex.
+  S2EdgeCrosser crosser(&center, &p);
+  const S2Point* last = nullptr;
+  for (size_t i = 0; i < edges.size(); ++i) {
+    if (!float_edges.empty() &&
+        crosser.IsDefinitelyNotCrossing(float_edges[i].v0,
+                                        float_edges[i].v1)) {
+      last = nullptr;
+      continue;
+    }
+    const S2Shape::Edge& edge = edges[i];
+    int sign = (last != nullptr && *last == edge.v0)
+                   ? crosser.CrossingSign(&edge.v1)
+                   : crosser.CrossingSign(&edge.v0, &edge.v1);
+    last = &edge.v1;
+    if (sign < 0) continue;
+    if (sign == 0) {
+      // For the OPEN and CLOSED models, check whether "p" is a vertex.
+      if (options_.vertex_model() != S2VertexModel::SEMI_OPEN &&
+          (edge.v0 == p || edge.v1 == p)) {
+        return (options_.vertex_model() == S2VertexModel::CLOSED);
+      }
+      sign = S2::VertexCrossing(center, p, edge.v0, edge.v1);
+    }
+    inside ^= sign;
+  }
+  return inside;
+}
+
 template <class IndexType>
 bool S2ContainsPointQuery<IndexType>::ShapeContains(
     S2CellId cell_id, const S2ClippedShape& clipped, const S2Point& p) const {
@@ -0,0 +1,130 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Benchmarks for S2ContainsPointQuery.
+
+#include "s2/s2contains_point_query.h"
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2contains_point_raster.h"
+#include "s2/s2fractal.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2testing.h"
+
+using std::make_unique;
+using std::vector;
+
+namespace {
+
+// Tests points near a fractal loop with approximately state.range(0) edges
+// for containment.
+void BM_ContainsFractalLoop(benchmark::State& state) {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(state.range(0));
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(10));
+  MutableS2ShapeIndex index;
+  index.Add(make_unique<S2Loop::OwningShape>(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(cap.center()), cap.GetRadius())));
+  index.ForceBuild();
+
+  // Sample points from a slightly larger cap so that some are outside.
+  S2Cap sample_cap = S2Cap(cap.center(), cap.GetRadius() * 1.2);
+  vector<S2Point> points;
+  for (int i = 0; i < 1024; ++i) {
+    points.push_back(S2Testing::SamplePoint(sample_cap));
+  }
+  auto query = MakeS2ContainsPointQuery(&index);
+  int i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(query.Contains(points[i]));
+    i = (i + 1) & 1023;
+  }
+}
+BENCHMARK(BM_ContainsFractalLoop)->Range(1 << 8, 1 << 16);
+
+// Like BM_ContainsFractalLoop, but uses an S2ContainsPointRaster with
+// state.range(1) cells per covering.
+void BM_ContainsFractalLoopRaster(benchmark::State& state) {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(state.range(0));
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(10));
+  MutableS2ShapeIndex index;
+  index.Add(make_unique<S2Loop::OwningShape>(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(cap.center()), cap.GetRadius())));
+  index.ForceBuild();
+
+  S2Cap sample_cap = S2Cap(cap.center(), cap.GetRadius() * 1.2);
+  vector<S2Point> points;
+  for (int i = 0; i < 1024; ++i) {
+    points.push_back(S2Testing::SamplePoint(sample_cap));
+  }
+  S2ContainsPointRaster::Options options;
+  options.set_max_cells(state.range(1));
+  S2ContainsPointRaster raster(&index, options);
+  int i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(raster.Contains(points[i]));
+    i = (i + 1) & 1023;
+  }
+}
+BENCHMARK(BM_ContainsFractalLoopRaster)
+    ->ArgsProduct({{1 << 8, 1 << 12, 1 << 16}, {256, 4096}});
+
+// Like BM_ContainsFractalLoop, but tests a batch of 64K points using
+// state.range(1) threads, or one point at a time if state.range(1) is zero.
+void BM_ContainsFractalLoopBatch(benchmark::State& state) {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(state.range(0));
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(10));
+  MutableS2ShapeIndex index;
+  index.Add(make_unique<S2Loop::OwningShape>(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(cap.center()), cap.GetRadius())));
+  index.ForceBuild();
+
+  S2Cap sample_cap = S2Cap(cap.center(), cap.GetRadius() * 1.2);
+  vector<S2Point> points;
+  for (int i = 0; i < (1 << 16); ++i) {
+    points.push_back(S2Testing::SamplePoint(sample_cap));
+  }
+  S2ContainsPointQueryOptions options;
+  options.set_num_threads(state.range(1));
+  auto query = MakeS2ContainsPointQuery(&index, options);
+  S2ContainsPointBatchResult result;
+  for (auto _ : state) {
+    if (state.range(1) == 0) {
+      for (const S2Point& point : points) {
+        benchmark::DoNotOptimize(query.GetContainingShapeIds(point));
+      }
+    } else {
+      query.GetContainingShapeIds(points, &result);
+      benchmark::DoNotOptimize(result.shape_ids.data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_ContainsFractalLoopBatch)
+    ->ArgsProduct({{1 << 8, 1 << 12, 1 << 16}, {0, 1, 4}});
+
+}  // namespace
@@ -27,8 +27,10 @@
 #include "s2/mutable_s2shape_index.h"
 #include "s2/s1angle.h"
 #include "s2/s2cap.h"
+#include "s2/s2lax_polyline_shape.h"
 #include "s2/s2loop.h"
 #include "s2/s2point.h"
+#include "s2/s2point_vector_shape.h"
 #include "s2/s2shape.h"
 #include "s2/s2shapeutil_shape_edge.h"
 #include "s2/s2shapeutil_shape_edge_id.h"
@@ -167,6 +169,51 @@ TEST(S2ContainsPointQuery, GetContainingShapes) {
   }
 }
 
+TEST(S2ContainsPointQuery, BatchMatchesSinglePointQueries) {
+  const S1Angle kMaxLoopRadius = S2Testing::KmToAngle(10);
+  const S2Cap center_cap(S2Testing::RandomPoint(), kMaxLoopRadius);
+  MutableS2ShapeIndex index;
+  vector<S2Point> points;
+  for (int i = 0; i < 100; ++i) {
+    unique_ptr<S2Loop> loop = S2Loop::MakeRegularLoop(
+        S2Testing::SamplePoint(center_cap),
+        S2Testing::rnd.RandDouble() * kMaxLoopRadius, 10);
+    // Include the loop vertices so that all vertex models are exercised.
+    for (const S2Point& vertex : loop->vertices_span()) {
+      points.push_back(vertex);
+    }
+    index.Add(make_unique<S2Loop::OwningShape>(std::move(loop)));
+  }
+  // Also add some points and polylines.
+  index.Add(s2textformat::MakeLaxPolylineOrDie("0:0, 0:1, 1:1"));
+  index.Add(make_unique<S2PointVectorShape>(vector<S2Point>(
+      points.begin(), points.begin() + 10)));
+  while (points.size() < 5000) {
+    points.push_back(S2Testing::SamplePoint(center_cap));
+  }
+  for (S2VertexModel model : {S2VertexModel::OPEN, S2VertexModel::SEMI_OPEN,
+                              S2VertexModel::CLOSED}) {
+    for (int num_threads : {1, 3}) {
+      S2ContainsPointQueryOptions options(model);
+      options.set_num_threads(num_threads);
+      auto query = MakeS2ContainsPointQuery(&index, options);
+      S2ContainsPointBatchResult result;
+      query.GetContainingShapeIds(points, &result);
+      ASSERT_EQ(result.offsets.size(), points.size() + 1);
+      for (int i = 0; i < static_cast<int>(points.size()); ++i) {
+        auto actual = result.containing_shape_ids(i);
+        EXPECT_EQ(vector<int>(actual.begin(), actual.end()),
+                  query.GetContainingShapeIds(points[i]));
+      }
+    }
+  }
+  // An empty batch.
+  S2ContainsPointBatchResult result;
+  MakeS2ContainsPointQuery(&index).GetContainingShapeIds({}, &result);
+  EXPECT_EQ(result.offsets, vector<int>{0});
+  EXPECT_TRUE(result.shape_ids.empty());
+}
+
 using EdgeIdVector = vector<ShapeEdgeId>;
 
 void ExpectIncidentEdgeIds(const EdgeIdVector& expected,
@@ -0,0 +1,160 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2contains_point_raster.h"
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "absl/container/inlined_vector.h"
+#include "absl/types/span.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_index.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2point.h"
+#include "s2/s2region_coverer.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index_region.h"
+#include "s2/s2wrapped_shape.h"
+
+using std::make_unique;
+using std::vector;
+
+S2ContainsPointRaster::S2ContainsPointRaster(const MutableS2ShapeIndex* index)
+    : S2ContainsPointRaster(index, Options()) {}
+
+S2ContainsPointRaster::S2ContainsPointRaster(const MutableS2ShapeIndex* index,
+                                             const Options& options)
+    : index_(index), options_(options) {
+  Init();
+}
+
+void S2ContainsPointRaster::Init() {
+  S2RegionCoverer::Options coverer_options;
+  coverer_options.set_max_cells(options_.max_cells());
+  coverer_options.set_max_level(options_.max_level());
+  S2RegionCoverer coverer(coverer_options);
+  S2CellIndex cells;
+  for (int shape_id = 0; shape_id < index_->num_shape_ids(); ++shape_id) {
+    const S2Shape* shape = index_->shape(shape_id);
+    if (shape == nullptr) continue;
+    // Points and polylines only contain their vertices, and only in the
+    // CLOSED model.  Their coverings consist entirely of boundary cells.
+    const int dimension = shape->dimension();
+    if (dimension < 2 && options_.vertex_model() != S2VertexModel::CLOSED) {
+      continue;
+    }
+    // Each shape is covered separately, since S2ShapeIndexRegion does not
+    // distinguish between the shapes of an index.
+    MutableS2ShapeIndex shape_index;
+    shape_index.Add(make_unique<S2WrappedShape>(shape));
+    auto region = MakeS2ShapeIndexRegion(&shape_index);
+    S2CellUnion covering = coverer.GetCovering(region);
+    if (dimension == 2) {
+      S2CellUnion interior = coverer.GetInteriorCovering(region);
+      covering = covering.Difference(interior);
+      cells.Add(interior, MakeLabel(shape_id, false));
+      num_interior_cells_ += interior.num_cells();
+    }
+    cells.Add(covering, MakeLabel(shape_id, true));
+    num_boundary_cells_ += covering.num_cells();
+  }
+  cells.Build();
+
+  // Flatten the S2CellIndex into a sorted vector of leaf cell ranges, each
+  // with the labels of the cells that contain it, merging adjacent ranges
+  // with the same labels.  This makes each query a single binary search.
+  absl::InlinedVector<S2CellIndex::Label, 4> range_labels;
+  S2CellIndex::ContentsIterator contents(&cells);
+  S2CellIndex::RangeIterator range(&cells);
+  for (range.Begin(); !range.done(); range.Next()) {
+    range_labels.clear();
+    contents.Clear();  // Don't suppress cells seen in previous ranges.
+    for (contents.StartUnion(range); !contents.done(); contents.Next()) {
+      range_labels.push_back(contents.label());
+    }
+    std::sort(range_labels.begin(), range_labels.end());
+    if (!range_starts_.empty() &&
+        std::equal(range_labels.begin(), range_labels.end(),
+                   labels_.begin() + label_begin_.back(), labels_.end())) {
+      continue;
+    }
+    range_starts_.push_back(range.start_id());
+    label_begin_.push_back(static_cast<int>(labels_.size()));
+    labels_.insert(labels_.end(), range_labels.begin(), range_labels.end());
+  }
+  label_begin_.push_back(static_cast<int>(labels_.size()));
+}
+
+absl::Span<const S2CellIndex::Label> S2ContainsPointRaster::GetLabels(
+    const S2Point& p) const {
+  // The first range starts at S2CellId::Begin(kMaxLevel), so there is always
+  // a range containing "p".
+  int i = std::upper_bound(range_starts_.begin(), range_starts_.end(),
+                           S2CellId(p)) - range_starts_.begin() - 1;
+  return absl::MakeConstSpan(labels_.data() + label_begin_[i],
+                             labels_.data() + label_begin_[i + 1]);
+}
+
+S2ContainsPointQuery<MutableS2ShapeIndex> S2ContainsPointRaster::MakeQuery()
+    const {
+  return MakeS2ContainsPointQuery(
+      index_, S2ContainsPointQueryOptions(options_.vertex_model()));
+}
+
+bool S2ContainsPointRaster::Contains(const S2Point& p) const {
+  absl::Span<const S2CellIndex::Label> labels = GetLabels(p);
+  bool has_boundary = false;
+  for (S2CellIndex::Label label : labels) {
+    if (!IsBoundary(label)) return true;
+    has_boundary = true;
+  }
+  if (!has_boundary) return false;
+  auto query = MakeQuery();
+  for (S2CellIndex::Label label : labels) {
+    if (query.ShapeContains(GetShapeId(label), p)) return true;
+  }
+  return false;
+}
+
+bool S2ContainsPointRaster::ShapeContains(int shape_id,
+                                          const S2Point& p) const {
+  for (S2CellIndex::Label label : GetLabels(p)) {
+    if (GetShapeId(label) == shape_id) {
+      return !IsBoundary(label) || MakeQuery().ShapeContains(shape_id, p);
+    }
+  }
+  return false;
+}
+
+vector<int> S2ContainsPointRaster::GetContainingShapeIds(
+    const S2Point& p) const {
+  // Labels are sorted, so the results are sorted by shape id.
+  vector<int> result;
+  std::optional<S2ContainsPointQuery<MutableS2ShapeIndex>> query;
+  for (S2CellIndex::Label label : GetLabels(p)) {
+    int shape_id = GetShapeId(label);
+    if (IsBoundary(label)) {
+      if (!query) query.emplace(MakeQuery());
+      if (!query->ShapeContains(shape_id, p)) continue;
+    }
+    result.push_back(shape_id);
+  }
+  return result;
+}
@@ -0,0 +1,144 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2CONTAINS_POINT_RASTER_H_
+#define S2_S2CONTAINS_POINT_RASTER_H_
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_index.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2point.h"
+
+// S2ContainsPointRaster answers point containment queries for the shapes of
+// a MutableS2ShapeIndex using precomputed cell coverings, and only falls
+// back to S2ContainsPointQuery for points near shape boundaries.  It is
+// intended for very high query rates against a fixed set of large polygons
+// (e.g., geofencing).
+//
+// For each shape, the raster stores an interior covering (cells that are
+// entirely contained by the shape) and a boundary covering (the remaining
+// cells of a covering of the shape).  All coverings are flattened into a
+// single sorted vector of leaf cell ranges, so a query point is resolved by
+// one binary search:
+//
+//  - shapes with an interior cell containing the point contain it,
+//  - shapes with a boundary cell containing the point are tested exactly
+//    using the index, and
+//  - all other shapes do not contain the point.
+//
+// The results are identical to those of S2ContainsPointQuery with the same
+// vertex model.  Larger values of Options::max_cells() reduce the fraction
+// of points that need an exact test, at the cost of memory and build time.
+//
+// Example usage:
+//
+//   S2ContainsPointRaster raster(&index);
+//   if (raster.Contains(point)) { ... }
+//
+// This class is thread-safe provided that the index is not modified.  The
+// raster must be rebuilt (by constructing a new one) whenever the index is
+// modified.
+class S2ContainsPointRaster {
+ public:
+  class Options {
+   public:
+    // The maximum number of cells in the interior covering and in the
+    // covering of each shape (see S2RegionCoverer::Options::max_cells).
+    //
+    // DEFAULT: 1024
+    int max_cells() const { return max_cells_; }
+    void set_max_cells(int max_cells) { max_cells_ = max_cells; }
+
+    // The maximum level of the covering cells.  Points in cells near the
+    // boundary that are smaller than this are tested exactly.
+    //
+    // DEFAULT: S2CellId::kMaxLevel
+    int max_level() const { return max_level_; }
+    void set_max_level(int max_level) { max_level_ = max_level; }
+
+    // The vertex model used for points that are tested exactly (see
+    // S2ContainsPointQueryOptions).  Shapes of dimension 0 and 1 are only
+    // included when this is S2VertexModel::CLOSED.
+    //
+    // DEFAULT: S2VertexModel::SEMI_OPEN
+    S2VertexModel vertex_model() const { return vertex_model_; }
+    void set_vertex_model(S2VertexModel model) { vertex_model_ = model; }
+
+   private:
+    int max_cells_ = 1024;
+    int max_level_ = S2CellId::kMaxLevel;
+    S2VertexModel vertex_model_ = S2VertexModel::SEMI_OPEN;
+  };
+
+  // Builds the coverings of all shapes in "index", which must persist for
+  // the lifetime of this object.
+  explicit S2ContainsPointRaster(const MutableS2ShapeIndex* index);
+  S2ContainsPointRaster(const MutableS2ShapeIndex* index,
+                        const Options& options);
+
+  S2ContainsPointRaster(const S2ContainsPointRaster&) = delete;
+  S2ContainsPointRaster& operator=(const S2ContainsPointRaster&) = delete;
+
+  const MutableS2ShapeIndex& index() const { return *index_; }
+  const Options& options() const { return options_; }
+
+  // Returns true if any shape contains "p".
+  bool Contains(const S2Point& p) const;
+
+  // Returns true if the given shape contains "p".
+  bool ShapeContains(int shape_id, const S2Point& p) const;
+
+  // Returns the ids of the shapes that contain "p", in increasing order.
+  std::vector<int> GetContainingShapeIds(const S2Point& p) const;
+
+  // The total number of interior and boundary cells of all shapes.
+  int num_interior_cells() const { return num_interior_cells_; }
+  int num_boundary_cells() const { return num_boundary_cells_; }
+
+ private:
+  // Each cell is labelled with (shape_id << 1) | is_boundary.
+  static S2CellIndex::Label MakeLabel(int shape_id, bool boundary) {
+    return (shape_id << 1) | static_cast<int>(boundary);
+  }
+  static int GetShapeId(S2CellIndex::Label label) { return label >> 1; }
+  static bool IsBoundary(S2CellIndex::Label label) { return label & 1; }
+
+  void Init();
+
+  // Returns the labels of the cells that contain "p", in increasing order.
+  absl::Span<const S2CellIndex::Label> GetLabels(const S2Point& p) const;
+
+  // Returns a query for testing points in boundary cells exactly.
+  S2ContainsPointQuery<MutableS2ShapeIndex> MakeQuery() const;
+
+  const MutableS2ShapeIndex* index_;
+  Options options_;
+
+  // The labels of the cells containing the leaf cells in the range
+  // [range_starts_[i], range_starts_[i + 1]) are
+  // labels_[label_begin_[i]], ..., labels_[label_begin_[i + 1] - 1].
+  std::vector<S2CellId> range_starts_;
+  std::vector<int> label_begin_;
+  std::vector<S2CellIndex::Label> labels_;
+
+  int num_interior_cells_ = 0;
+  int num_boundary_cells_ = 0;
+};
+
+#endif  // S2_S2CONTAINS_POINT_RASTER_H_
@@ -0,0 +1,115 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2contains_point_raster.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2fractal.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2shape.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Returns an index containing overlapping polygons, a polyline, and a point
+// set, all within 10 degrees of (1, 0, 0).
+unique_ptr<MutableS2ShapeIndex> MakeIndex() {
+  S2Testing::rnd.Reset(1);
+  auto index = make_unique<MutableS2ShapeIndex>();
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(1000);
+  index->Add(make_unique<S2Loop::OwningShape>(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(S2Point(1, 0, 0)), S1Angle::Degrees(8))));
+  index->Add(s2textformat::MakeLaxPolygonOrDie(
+      "-5:-5, -5:5, 5:5, 5:-5; -1:-1, 1:-1, 1:1, -1:1"));
+  index->Add(s2textformat::MakeLaxPolylineOrDie("0:0, 3:3, 6:0"));
+  index->Add(make_unique<S2Loop::OwningShape>(
+      s2textformat::MakeLoopOrDie("full")));
+  index->Add(s2textformat::MakeLaxPolylineOrDie("-3:-3, -3:3"));
+  index->ForceBuild();
+  return index;
+}
+
+// Returns points near the shapes of MakeIndex(), including all of their
+// vertices.
+vector<S2Point> GetTestPoints(const MutableS2ShapeIndex& index) {
+  vector<S2Point> points;
+  for (int i = 0; i < 2000; ++i) {
+    points.push_back(S2Testing::SamplePoint(
+        S2Cap(S2Point(1, 0, 0), S1Angle::Degrees(10))));
+  }
+  for (const S2Shape* shape : index) {
+    for (int e = 0; e < shape->num_edges(); ++e) {
+      points.push_back(shape->edge(e).v0);
+    }
+  }
+  return points;
+}
+
+TEST(S2ContainsPointRaster, MatchesContainsPointQuery) {
+  auto index = MakeIndex();
+  vector<S2Point> points = GetTestPoints(*index);
+  for (S2VertexModel model : {S2VertexModel::OPEN, S2VertexModel::SEMI_OPEN,
+                              S2VertexModel::CLOSED}) {
+    S2ContainsPointRaster::Options options;
+    options.set_max_cells(64);
+    options.set_vertex_model(model);
+    S2ContainsPointRaster raster(index.get(), options);
+    EXPECT_GT(raster.num_interior_cells(), 0);
+    EXPECT_GT(raster.num_boundary_cells(), 0);
+    auto query = MakeS2ContainsPointQuery(
+        index.get(), S2ContainsPointQueryOptions(model));
+    for (const S2Point& p : points) {
+      ASSERT_EQ(raster.GetContainingShapeIds(p),
+                query.GetContainingShapeIds(p));
+      ASSERT_EQ(raster.Contains(p), query.Contains(p));
+      for (int shape_id = 0; shape_id < index->num_shape_ids(); ++shape_id) {
+        ASSERT_EQ(raster.ShapeContains(shape_id, p),
+                  query.ShapeContains(shape_id, p));
+      }
+    }
+  }
+}
+
+TEST(S2ContainsPointRaster, LowerDimensionalShapesOnlyInClosedModel) {
+  auto index = s2textformat::MakeIndexOrDie("1:1 # 2:2, 3:3 #");
+  S2ContainsPointRaster open_raster(index.get());
+  EXPECT_EQ(open_raster.num_boundary_cells(), 0);
+  EXPECT_FALSE(open_raster.Contains(s2textformat::MakePointOrDie("1:1")));
+
+  S2ContainsPointRaster::Options options;
+  options.set_vertex_model(S2VertexModel::CLOSED);
+  S2ContainsPointRaster closed_raster(index.get(), options);
+  EXPECT_EQ(closed_raster.num_interior_cells(), 0);
+  EXPECT_TRUE(closed_raster.Contains(s2textformat::MakePointOrDie("1:1")));
+  EXPECT_TRUE(closed_raster.ShapeContains(
+      1, s2textformat::MakePointOrDie("3:3")));
+  EXPECT_FALSE(closed_raster.Contains(s2textformat::MakePointOrDie("2:3")));
+}
+
+}  // namespace
@@ -19,6 +19,9 @@
 // Graham scan (see https://en.wikipedia.org/wiki/Graham_scan).  The time
 // complexity is O(n log n), and the space required is O(n).  In fact only the
 // call to "sort" takes O(n log n) time; the rest of the algorithm is linear.
+// When Options::max_buffered_points() is set, the input is periodically
+// reduced to the vertices of its convex hull, which bounds the space required
+// without changing the result.
 //
 // Demonstration of the algorithm and code:
 // en.wikibooks.org/wiki/Algorithm_Implementation/Geometry/Convex_hull/Monotone_chain
@@ -26,10 +29,14 @@
 #include "s2/s2convex_hull_query.h"
 
 #include <algorithm>
+#include <atomic>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "absl/log/absl_check.h"
+#include "absl/synchronization/mutex.h"
+#include "s2/base/executor.h"
 #include "s2/s2cap.h"
 #include "s2/s2edge_distances.h"
 #include "s2/s2latlng_rect.h"
@@ -40,24 +47,35 @@
 #include "s2/s2polyline.h"
 #include "s2/s2predicates.h"
 #include "s2/s2predicates_internal.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+#include "s2/s2shape_measures.h"
 
 using std::make_unique;
+using std::max;
+using std::min;
 using std::unique_ptr;
 using std::vector;
 
 S2ConvexHullQuery::S2ConvexHullQuery()
-    : bound_(S2LatLngRect::Empty()), points_() {
+    : S2ConvexHullQuery(Options()) {
+}
+
+S2ConvexHullQuery::S2ConvexHullQuery(const Options& options)
+    : options_(options), bound_(S2LatLngRect::Empty()), points_() {
 }
 
 void S2ConvexHullQuery::AddPoint(const S2Point& point) {
   bound_.AddPoint(point);
   points_.push_back(point);
+  MaybeReducePoints();
 }
 
 void S2ConvexHullQuery::AddPolyline(const S2Polyline& polyline) {
   bound_ = bound_.Union(polyline.GetRectBound());
   for (int i = 0; i < polyline.num_vertices(); ++i) {
     points_.push_back(polyline.vertex(i));
+    MaybeReducePoints();
   }
 }
 
@@ -70,6 +88,7 @@ void S2ConvexHullQuery::AddLoop(const S2Loop& loop) {
   }
   for (int i = 0; i < loop.num_vertices(); ++i) {
     points_.push_back(loop.vertex(i));
+    MaybeReducePoints();
   }
 }
 
@@ -83,6 +102,86 @@ void S2ConvexHullQuery::AddPolygon(const S2Polygon& polygon) {
   }
 }
 
+void S2ConvexHullQuery::AddShape(const S2Shape& shape) {
+  AddShapeEdges(shape, 0, shape.num_edges(), true /*add_bound*/);
+}
+
+void S2ConvexHullQuery::AddShapeEdges(const S2Shape& shape, int begin,
+                                      int end, bool add_bound) {
+  const int dimension = shape.dimension();
+  if (dimension == 0) {
+    for (int i = begin; i < end; ++i) AddPoint(shape.edge(i).v0);
+    return;
+  }
+  // As with AddPolyline() and AddLoop(), the bound must include the edges
+  // and (for polygons) the interior, not just the vertices.
+  if (add_bound) bound_ = bound_.Union(S2::GetRectBound(shape));
+  for (int i = begin; i < end; ++i) {
+    S2Shape::Edge edge = shape.edge(i);
+    points_.push_back(edge.v0);
+    // Every polygon vertex is the start of some edge, but the last vertex of
+    // each polyline is not.
+    if (dimension == 1) points_.push_back(edge.v1);
+    MaybeReducePoints();
+  }
+}
+
+void S2ConvexHullQuery::AddShapeIndex(const S2ShapeIndex& index) {
+  // Each task adds a contiguous range of edges from a single shape, so that
+  // a single huge shape can also be processed in parallel.  Every shape has
+  // at least one task so that the bounds of shapes without edges (e.g., the
+  // full polygon) are added.
+  constexpr int kEdgesPerTask = 4096;
+  struct Task {
+    const S2Shape* shape;
+    int begin, end;
+  };
+  vector<Task> tasks;
+  for (const S2Shape* shape : index) {
+    if (shape == nullptr) continue;
+    const int num_edges = shape->num_edges();
+    int begin = 0;
+    do {
+      int end = min(begin + kEdgesPerTask, num_edges);
+      tasks.push_back(Task{shape, begin, end});
+      begin = end;
+    } while (begin < num_edges);
+  }
+  const int num_tasks = tasks.size();
+  const int num_threads =
+      min(max(options_.num_threads(), 1), max(num_tasks, 1));
+  if (num_threads == 1) {
+    for (const Task& task : tasks) {
+      AddShapeEdges(*task.shape, task.begin, task.end, task.begin == 0);
+    }
+    return;
+  }
+  // Each thread reduces its share of the input to a partial convex hull,
+  // which is then merged into this query.
+  Options thread_options = options_;
+  thread_options.set_num_threads(1);
+  std::atomic<int> next_task(0);
+  absl::Mutex mutex;
+  s2base::RunConcurrently(options_.executor(), num_threads, [&]() {
+    S2ConvexHullQuery query(thread_options);
+    int i;
+    while ((i = next_task.fetch_add(1)) < num_tasks) {
+      const Task& task = tasks[i];
+      query.AddShapeEdges(*task.shape, task.begin, task.end,
+                          task.begin == 0);
+    }
+    query.ReduceToHullVertices();
+    absl::MutexLock lock(&mutex);
+    AddQuery(query);
+  });
+}
+
+void S2ConvexHullQuery::AddQuery(const S2ConvexHullQuery& other) {
+  bound_ = bound_.Union(other.bound_);
+  points_.insert(points_.end(), other.points_.begin(), other.points_.end());
+  MaybeReducePoints();
+}
+
 S2Cap S2ConvexHullQuery::GetCapBound() {
   // We keep track of a rectangular bound rather than a spherical cap because
   // it is easy to compute a tight bound for a union of rectangles, whereas it
@@ -113,12 +212,42 @@ class OrderedCcwAround {
 };
 
 unique_ptr<S2Loop> S2ConvexHullQuery::GetConvexHull() {
+  if (!ReduceToHullVertices()) {
+    return make_unique<S2Loop>(S2Loop::kFull());
+  }
+
+  // Special cases for fewer than 3 points.
+  if (points_.size() < 3) {
+    if (points_.empty()) {
+      return make_unique<S2Loop>(S2Loop::kEmpty());
+    } else if (points_.size() == 1) {
+      return GetSinglePointLoop(points_[0]);
+    } else {
+      return GetSingleEdgeLoop(points_[0], points_[1]);
+    }
+  }
+  return make_unique<S2Loop>(points_);
+}
+
+void S2ConvexHullQuery::MaybeReducePoints() {
+  if (options_.max_buffered_points() > 0 &&
+      points_.size() >= static_cast<size_t>(num_reduced_points_) +
+                            options_.max_buffered_points()) {
+    ReduceToHullVertices();
+  }
+}
+
+bool S2ConvexHullQuery::ReduceToHullVertices() {
   // Test whether the bounding cap is convex.  We need this to proceed with
   // the algorithm below in order to construct a point "origin" that is
-  // definitely outside the convex hull.
+  // definitely outside the convex hull.  Since the bound never shrinks, once
+  // this test fails the convex hull remains full and there is no need to
+  // keep any points.
   S2Cap cap = GetCapBound();
   if (cap.height() >= 1 - 10 * s2pred::DBL_ERR) {
-    return make_unique<S2Loop>(S2Loop::kFull());
+    points_.clear();
+    num_reduced_points_ = 0;
+    return false;
   }
   // This code implements Andrew's monotone chain algorithm, which is a simple
   // variant of the Graham scan.  Rather than sorting by x-coordinate, instead
@@ -131,19 +260,12 @@ unique_ptr<S2Loop> S2ConvexHullQuery::GetConvexHull() {
   std::sort(points_.begin(), points_.end(), OrderedCcwAround(origin));
 
   // Remove duplicates.  We need to do this before checking whether there are
-  // fewer than 3 points.
+  // fewer than 3 points.  Note that the convex hull of 1 or 2 points is not
+  // computed here, since GetConvexHull() needs the original points.
   points_.erase(std::unique(points_.begin(), points_.end()), points_.end());
 
-  // Special cases for fewer than 3 points.
-  if (points_.size() < 3) {
-    if (points_.empty()) {
-      return make_unique<S2Loop>(S2Loop::kEmpty());
-    } else if (points_.size() == 1) {
-      return GetSinglePointLoop(points_[0]);
-    } else {
-      return GetSingleEdgeLoop(points_[0], points_[1]);
-    }
-  }
+  num_reduced_points_ = points_.size();
+  if (points_.size() < 3) return true;
 
   // Verify that all points lie within a 180 degree span around the origin.
   ABSL_DCHECK_GE(s2pred::Sign(origin, points_.front(), points_.back()), 0);
@@ -162,7 +284,9 @@ unique_ptr<S2Loop> S2ConvexHullQuery::GetConvexHull() {
   lower.pop_back();
   upper.pop_back();
   lower.insert(lower.end(), upper.begin(), upper.end());
-  return make_unique<S2Loop>(lower);
+  points_ = std::move(lower);
+  num_reduced_points_ = points_.size();
+  return true;
 }
 
 // Iterate through the given points, selecting the maximal subset of points
@@ -22,12 +22,15 @@
 #include <vector>
 
 #include "s2/_fp_contract_off.h"
+#include "s2/base/executor.h"
 #include "s2/s2cap.h"
 #include "s2/s2latlng_rect.h"
 #include "s2/s2loop.h"
 #include "s2/s2point.h"
 #include "s2/s2polygon.h"
 #include "s2/s2polyline.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
 
 // S2ConvexHullQuery builds the convex hull of any collection of points,
 // polylines, loops, and polygons.  It returns a single convex loop.
@@ -57,10 +60,61 @@
 // hull again.  If you want to start from scratch, simply declare a new
 // S2ConvexHullQuery object (they are cheap to create).
 //
+// By default all input vertices are kept in memory until GetConvexHull() is
+// called.  To compute the convex hull of a very large stream of points, set
+// Options::max_buffered_points() so that the input is periodically reduced to
+// the vertices of its convex hull.  The convex hull of a huge collection of
+// geometry can also be computed in parallel by building a separate
+// S2ConvexHullQuery for each part of the input and combining them with
+// AddQuery(), or (for geometry in an S2ShapeIndex) by calling AddShapeIndex()
+// with Options::num_threads() > 1.
+//
 // This class is not thread-safe.  There are no "const" methods.
 class S2ConvexHullQuery {
  public:
+  class Options {
+   public:
+    Options() = default;
+
+    // If positive, then whenever at least this many points have been added
+    // since the last reduction, the input points are replaced by the
+    // vertices of their convex hull.  This does not change the result, but
+    // bounds the memory used to O(max_buffered_points() + h) where "h" is the
+    // number of vertices of the convex hull.  Once the input spans more than
+    // half of the sphere (so that the convex hull is full), no points are
+    // kept at all.
+    //
+    // DEFAULT: 0 (all input points are kept)
+    int max_buffered_points() const;
+    void set_max_buffered_points(int max_buffered_points);
+
+    // The maximum number of threads used by AddShapeIndex().  The edges of
+    // the index are divided into chunks that are reduced in parallel, and
+    // the partial results are then merged as if by AddQuery().  The convex
+    // hull does not depend on this value.
+    //
+    // DEFAULT: 1
+    int num_threads() const;
+    void set_num_threads(int num_threads);
+
+    // If non-null, the additional threads requested by num_threads() are
+    // run as tasks on this executor rather than being created by
+    // AddShapeIndex() (see s2base::RunConcurrently).
+    //
+    // DEFAULT: nullptr
+    s2base::Executor* executor() const;
+    void set_executor(s2base::Executor* executor);
+
+   private:
+    int max_buffered_points_ = 0;
+    int num_threads_ = 1;
+    s2base::Executor* executor_ = nullptr;
+  };
+
   S2ConvexHullQuery();
+  explicit S2ConvexHullQuery(const Options& options);
+
+  const Options& options() const { return options_; }
 
   // Add a point to the input geometry.
   void AddPoint(const S2Point& point);
@@ -74,6 +128,23 @@ class S2ConvexHullQuery {
   // Add a polygon to the input geometry.
   void AddPolygon(const S2Polygon& polygon);
 
+  // Add the vertices of an S2Shape to the input geometry.  Points and
+  // polylines are handled as with AddPoint() and AddPolyline().  For
+  // polygons all the loop vertices are added, which is equivalent to adding
+  // the polygon since holes cannot contribute to the convex hull.
+  void AddShape(const S2Shape& shape);
+
+  // Add all the shapes of an S2ShapeIndex to the input geometry.  The shape
+  // vertices are read directly from the shapes rather than being copied
+  // first, and the work is divided among options().num_threads() threads.
+  // When max_buffered_points() is set, each thread uses O(max_buffered_points
+  // + h) memory where "h" is the number of vertices of the convex hull.
+  void AddShapeIndex(const S2ShapeIndex& index);
+
+  // Add all the input geometry of another query (e.g., one that processed a
+  // different part of the input on another thread).
+  void AddQuery(const S2ConvexHullQuery& other);
+
   // Compute a bounding cap for the input geometry provided.
   //
   // Note that this method does not clear the geometry; you can continue
@@ -97,15 +168,66 @@ class S2ConvexHullQuery {
   std::unique_ptr<S2Loop> GetConvexHull();
 
  private:
+  // Adds the vertices of edges [begin, end) of "shape".  The bound of the
+  // shape is added only if "add_bound" is true, except that points
+  // (dimension 0) are always added to the bound individually.
+  void AddShapeEdges(const S2Shape& shape, int begin, int end,
+                     bool add_bound);
+
+  // Calls ReduceToHullVertices() if max_buffered_points() is positive and
+  // enough points have been added since the last reduction.
+  void MaybeReducePoints();
+
+  // Replaces points_ with the vertices of their convex hull in CCW order,
+  // except that duplicates are merely removed if fewer than 3 distinct
+  // points remain.  Returns false (and clears points_) if the input spans
+  // more than half of the sphere, in which case the convex hull is full.
+  bool ReduceToHullVertices();
+
   void GetMonotoneChain(std::vector<S2Point>* output);
   std::unique_ptr<S2Loop> GetSinglePointLoop(const S2Point& p);
   std::unique_ptr<S2Loop> GetSingleEdgeLoop(const S2Point& a, const S2Point& b);
 
+  Options options_;
   S2LatLngRect bound_;
   std::vector<S2Point> points_;
 
+  // The size of points_ after the last call to ReduceToHullVertices().
+  int num_reduced_points_ = 0;
+
   S2ConvexHullQuery(const S2ConvexHullQuery&) = delete;
   void operator=(const S2ConvexHullQuery&) = delete;
 };
 
+
+
+//////////////////   Implementation details follow   ////////////////////
+
+
+inline int S2ConvexHullQuery::Options::max_buffered_points() const {
+  return max_buffered_points_;
+}
+
+inline void S2ConvexHullQuery::Options::set_max_buffered_points(
+    int max_buffered_points) {
+  max_buffered_points_ = max_buffered_points;
+}
+
+inline int S2ConvexHullQuery::Options::num_threads() const {
+  return num_threads_;
+}
+
+inline void S2ConvexHullQuery::Options::set_num_threads(int num_threads) {
+  num_threads_ = num_threads;
+}
+
+inline s2base::Executor* S2ConvexHullQuery::Options::executor() const {
+  return executor_;
+}
+
+inline void S2ConvexHullQuery::Options::set_executor(
+    s2base::Executor* executor) {
+  executor_ = executor;
+}
+
 #endif  // S2_S2CONVEX_HULL_QUERY_H_
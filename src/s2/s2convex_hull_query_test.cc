@@ -238,4 +238,91 @@ TEST(S2ConvexHullQuery, PointsInsideHull) {
   }
 }
 
+TEST(S2ConvexHullQuery, BufferedPointsMatchUnbuffered) {
+  S2Testing::rnd.Reset(1);
+  for (int iter = 0; iter < 100; ++iter) {
+    S2Cap cap = S2Testing::GetRandomCap(1e-10, 1.9 * M_PI);
+    S2ConvexHullQuery query;
+    S2ConvexHullQuery::Options options;
+    options.set_max_buffered_points(1 + S2Testing::rnd.Uniform(50));
+    S2ConvexHullQuery buffered_query(options);
+    for (int i = 0; i < 1000; ++i) {
+      S2Point p = S2Testing::SamplePoint(cap);
+      query.AddPoint(p);
+      buffered_query.AddPoint(p);
+    }
+    unique_ptr<S2Loop> hull = query.GetConvexHull();
+    unique_ptr<S2Loop> buffered_hull = buffered_query.GetConvexHull();
+    EXPECT_TRUE(buffered_hull->BoundaryEquals(*hull)) << "Iteration: " << iter;
+  }
+}
+
+TEST(S2ConvexHullQuery, BufferedPointsFullHull) {
+  // Once the input spans more than a hemisphere the hull stays full, even
+  // though the buffered points are discarded.
+  S2ConvexHullQuery::Options options;
+  options.set_max_buffered_points(10);
+  S2ConvexHullQuery query(options);
+  for (int i = 0; i < 100; ++i) query.AddPoint(S2Testing::RandomPoint());
+  query.AddPoint(S2Point(1, 0, 0));
+  EXPECT_TRUE(query.GetConvexHull()->is_full());
+}
+
+TEST(S2ConvexHullQuery, AddShapeIndexMatchesAddGeometry) {
+  // The shapes are offset from each other so that their hull has vertices
+  // from all of them.
+  auto polyline = s2textformat::MakePolylineOrDie("0:0, 2:5, 1:10");
+  auto polygon = s2textformat::MakePolygonOrDie(
+      "10:0, 10:5, 15:5, 15:0; 11:1, 14:1, 14:4, 11:4");
+  S2Point point = MakePointOrDie("-5:5");
+  S2ConvexHullQuery expected_query;
+  expected_query.AddPolyline(*polyline);
+  expected_query.AddPolygon(*polygon);
+  expected_query.AddPoint(point);
+  unique_ptr<S2Loop> expected = expected_query.GetConvexHull();
+
+  auto index = s2textformat::MakeIndexOrDie(
+      "-5:5 # 0:0, 2:5, 1:10 # 10:0, 10:5, 15:5, 15:0; "
+      "11:1, 14:1, 14:4, 11:4");
+  for (int num_threads : {1, 4}) {
+    S2ConvexHullQuery::Options options;
+    options.set_num_threads(num_threads);
+    options.set_max_buffered_points(3);
+    S2ConvexHullQuery query(options);
+    query.AddShapeIndex(*index);
+    EXPECT_TRUE(query.GetConvexHull()->BoundaryEquals(*expected))
+        << "num_threads: " << num_threads;
+  }
+}
+
+TEST(S2ConvexHullQuery, AddShapeIndexFullPolygon) {
+  auto index = s2textformat::MakeIndexOrDie("# # full");
+  S2ConvexHullQuery query;
+  query.AddShapeIndex(*index);
+  EXPECT_TRUE(query.GetConvexHull()->is_full());
+}
+
+TEST(S2ConvexHullQuery, AddQueryMergesPartialHulls) {
+  // Split a set of points among several queries and check that merging them
+  // gives the same result as adding all the points to one query.
+  S2Testing::rnd.Reset(2);
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(30));
+  S2ConvexHullQuery query;
+  vector<unique_ptr<S2ConvexHullQuery>> parts;
+  for (int i = 0; i < 4; ++i) {
+    parts.push_back(std::make_unique<S2ConvexHullQuery>());
+  }
+  for (int i = 0; i < 1000; ++i) {
+    S2Point p = S2Testing::SamplePoint(cap);
+    query.AddPoint(p);
+    parts[i % parts.size()]->AddPoint(p);
+  }
+  S2ConvexHullQuery merged;
+  for (const auto& part : parts) {
+    part->GetConvexHull();  // Reduces the part to its hull vertices.
+    merged.AddQuery(*part);
+  }
+  EXPECT_TRUE(merged.GetConvexHull()->BoundaryEquals(*query.GetConvexHull()));
+}
+
 }  // namespace
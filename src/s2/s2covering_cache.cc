@@ -0,0 +1,127 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2covering_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2region.h"
+#include "s2/s2region_coverer.h"
+
+using absl::string_view;
+using std::string;
+
+namespace {
+
+// Returns a key that identifies the covering of the given region with the
+// given options.  The deadline is not included since approximate coverings
+// are not cached.
+string MakeKey(const void* type_tag, string_view region_key,
+               const S2RegionCoverer::Options& options, bool interior) {
+  const int32 fields[] = {interior,
+                          options.max_cells(),
+                          options.min_level(),
+                          options.max_level(),
+                          options.level_mod(),
+                          options.max_region_predicates()};
+  const uintptr_t tag = reinterpret_cast<uintptr_t>(type_tag);
+  string key;
+  key.reserve(sizeof(tag) + sizeof(fields) + region_key.size());
+  key.append(reinterpret_cast<const char*>(&tag), sizeof(tag));
+  key.append(reinterpret_cast<const char*>(fields), sizeof(fields));
+  key.append(region_key.data(), region_key.size());
+  return key;
+}
+
+}  // namespace
+
+S2CoveringCache::S2CoveringCache(size_t max_bytes) : max_bytes_(max_bytes) {}
+
+S2CellUnion S2CoveringCache::GetCovering(
+    const S2Region& region, string_view region_key,
+    const S2RegionCoverer::Options& options) {
+  return GetCoveringInternal(region, nullptr, region_key, options, false);
+}
+
+S2CellUnion S2CoveringCache::GetInteriorCovering(
+    const S2Region& region, string_view region_key,
+    const S2RegionCoverer::Options& options) {
+  return GetCoveringInternal(region, nullptr, region_key, options, true);
+}
+
+S2CoveringCache::Stats S2CoveringCache::stats() const {
+  absl::MutexLock lock(&mutex_);
+  return stats_;
+}
+
+void S2CoveringCache::Clear() {
+  absl::MutexLock lock(&mutex_);
+  map_.clear();
+  entries_.clear();
+  stats_.num_entries = 0;
+  stats_.bytes_used = 0;
+}
+
+S2CellUnion S2CoveringCache::GetCoveringInternal(
+    const S2Region& region, const void* type_tag, string_view region_key,
+    const S2RegionCoverer::Options& options, bool interior) {
+  string key = MakeKey(type_tag, region_key, options, interior);
+  {
+    absl::MutexLock lock(&mutex_);
+    if (auto it = map_.find(key); it != map_.end()) {
+      ++stats_.hits;
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return it->second->covering;
+    }
+    ++stats_.misses;
+  }
+
+  // Compute the covering without holding the lock, so that other threads
+  // can use the cache in the meantime.
+  S2RegionCoverer coverer(options);
+  S2CellUnion covering = interior ? coverer.GetInteriorCovering(region)
+                                  : coverer.GetCovering(region);
+  const size_t bytes = sizeof(Entry) + key.size() +
+                       covering.num_cells() * sizeof(S2CellId);
+  if (coverer.last_covering_approximate() || bytes > max_bytes_) {
+    return covering;
+  }
+
+  absl::MutexLock lock(&mutex_);
+  if (map_.contains(key)) {
+    // Another thread computed the same covering.
+    return covering;
+  }
+  entries_.push_front(Entry{std::move(key), covering, bytes});
+  map_.emplace(entries_.front().key, entries_.begin());
+  ++stats_.num_entries;
+  stats_.bytes_used += bytes;
+  while (stats_.bytes_used > max_bytes_) {
+    const Entry& last = entries_.back();
+    stats_.bytes_used -= last.bytes;
+    --stats_.num_entries;
+    ++stats_.evictions;
+    map_.erase(last.key);
+    entries_.pop_back();
+  }
+  return covering;
+}
@@ -0,0 +1,163 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2COVERING_CACHE_H_
+#define S2_S2COVERING_CACHE_H_
+
+#include <cstddef>
+#include <list>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "s2/util/coding/coder.h"
+#include "s2/base/types.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2region.h"
+#include "s2/s2region_coverer.h"
+
+// S2CoveringCache is a thread-safe, size-bounded LRU cache of coverings
+// computed by S2RegionCoverer.  It is useful when the same regions (e.g.,
+// S2Caps or S2LatLngRects for popular map viewports) are covered repeatedly
+// with the same options.
+//
+// Entries are keyed by the exact encoding of the region (as produced by its
+// Encode() method) together with the type of the region and the covering
+// options, so a cached covering is only returned for a region that is
+// bitwise identical to the one it was computed for.  Coverings that stopped
+// early because of a work limit (see S2RegionCoverer::Options::deadline())
+// are never cached.
+//
+// Example usage:
+//
+//   S2CoveringCache cache(/*max_bytes=*/1 << 20);
+//   S2RegionCoverer::Options options;
+//   options.set_max_cells(20);
+//   S2CellUnion covering = cache.GetCovering(cap, options);
+//
+// To use the cache with S2RegionTermIndexer, look up the covering using the
+// indexer's options and then convert it to terms:
+//
+//   S2CellUnion covering = cache.GetCovering(rect, indexer.options());
+//   auto terms = indexer.GetQueryTermsForCanonicalCovering(covering, prefix);
+class S2CoveringCache {
+ public:
+  // Constructs a cache whose entries use at most approximately 'max_bytes'
+  // of memory in total.
+  explicit S2CoveringCache(size_t max_bytes);
+
+  S2CoveringCache(const S2CoveringCache&) = delete;
+  S2CoveringCache& operator=(const S2CoveringCache&) = delete;
+
+  // Returns S2RegionCoverer(options).GetCovering(region), using the cached
+  // result if there is one.  'Region' must be an S2Region type with an
+  // Encode(Encoder*) method, such as S2Cap, S2LatLngRect, S2Cell,
+  // S2CellUnion, S2Loop, or S2Polygon.
+  template <class Region>
+  S2CellUnion GetCovering(const Region& region,
+                          const S2RegionCoverer::Options& options);
+
+  // Like GetCovering(), but returns the interior covering.
+  template <class Region>
+  S2CellUnion GetInteriorCovering(const Region& region,
+                                  const S2RegionCoverer::Options& options);
+
+  // Like the methods above, but for regions without an Encode() method.  The
+  // caller must supply a 'region_key' that uniquely identifies the region
+  // among all the regions that use this cache.
+  S2CellUnion GetCovering(const S2Region& region, absl::string_view region_key,
+                          const S2RegionCoverer::Options& options);
+  S2CellUnion GetInteriorCovering(const S2Region& region,
+                                  absl::string_view region_key,
+                                  const S2RegionCoverer::Options& options);
+
+  struct Stats {
+    int64 hits = 0;
+    int64 misses = 0;
+    int64 evictions = 0;
+    size_t num_entries = 0;
+    size_t bytes_used = 0;
+  };
+  Stats stats() const;
+
+  // Removes all entries from the cache.  The hit, miss, and eviction counts
+  // are preserved.
+  void Clear();
+
+ private:
+  struct Entry {
+    std::string key;
+    S2CellUnion covering;
+    size_t bytes;
+  };
+
+  // A unique tag for each region type, since different types may have the
+  // same encoding.
+  template <class Region>
+  struct RegionTypeTag {
+    static constexpr char kTag = 0;
+  };
+
+  template <class Region>
+  S2CellUnion GetEncodedRegionCovering(const Region& region,
+                                       const S2RegionCoverer::Options& options,
+                                       bool interior);
+
+  S2CellUnion GetCoveringInternal(const S2Region& region, const void* type_tag,
+                                  absl::string_view region_key,
+                                  const S2RegionCoverer::Options& options,
+                                  bool interior);
+
+  const size_t max_bytes_;
+
+  mutable absl::Mutex mutex_;
+  // The most recently used entry is at the front.  The map keys point into
+  // the keys of the list entries.
+  std::list<Entry> entries_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<absl::string_view, std::list<Entry>::iterator> map_
+      ABSL_GUARDED_BY(mutex_);
+  Stats stats_ ABSL_GUARDED_BY(mutex_);
+};
+
+
+//////////////////   Implementation details follow   ////////////////////
+
+
+template <class Region>
+inline S2CellUnion S2CoveringCache::GetCovering(
+    const Region& region, const S2RegionCoverer::Options& options) {
+  return GetEncodedRegionCovering(region, options, false);
+}
+
+template <class Region>
+inline S2CellUnion S2CoveringCache::GetInteriorCovering(
+    const Region& region, const S2RegionCoverer::Options& options) {
+  return GetEncodedRegionCovering(region, options, true);
+}
+
+template <class Region>
+S2CellUnion S2CoveringCache::GetEncodedRegionCovering(
+    const Region& region, const S2RegionCoverer::Options& options,
+    bool interior) {
+  Encoder encoder;
+  region.Encode(&encoder);
+  return GetCoveringInternal(
+      region, &RegionTypeTag<Region>::kTag,
+      absl::string_view(encoder.base(), encoder.length()), options, interior);
+}
+
+#endif  // S2_S2COVERING_CACHE_H_
@@ -0,0 +1,174 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2covering_cache.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/time/time.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2latlng.h"
+#include "s2/s2latlng_rect.h"
+#include "s2/s2region_coverer.h"
+#include "s2/s2region_term_indexer.h"
+#include "s2/s2testing.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+S2Cap GetTestCap() {
+  return S2Cap(S2LatLng::FromDegrees(37.4, -122.1).ToPoint(),
+               S1Angle::Degrees(0.5));
+}
+
+TEST(S2CoveringCache, HitsAndMisses) {
+  S2CoveringCache cache(1 << 20);
+  S2RegionCoverer::Options options;
+  options.set_max_cells(20);
+  S2RegionCoverer coverer(options);
+  const S2Cap cap = GetTestCap();
+
+  EXPECT_EQ(coverer.GetCovering(cap), cache.GetCovering(cap, options));
+  EXPECT_EQ(coverer.GetCovering(cap), cache.GetCovering(cap, options));
+  EXPECT_EQ(coverer.GetInteriorCovering(cap),
+            cache.GetInteriorCovering(cap, options));
+  S2CoveringCache::Stats stats = cache.stats();
+  EXPECT_EQ(1, stats.hits);
+  EXPECT_EQ(2, stats.misses);
+  EXPECT_EQ(2, stats.num_entries);
+  EXPECT_GT(stats.bytes_used, 0);
+
+  // Different options produce a different covering.
+  options.set_max_cells(5);
+  EXPECT_EQ(S2RegionCoverer(options).GetCovering(cap),
+            cache.GetCovering(cap, options));
+  EXPECT_EQ(3, cache.stats().misses);
+
+  cache.Clear();
+  stats = cache.stats();
+  EXPECT_EQ(0, stats.num_entries);
+  EXPECT_EQ(0, stats.bytes_used);
+  EXPECT_EQ(1, stats.hits);
+}
+
+TEST(S2CoveringCache, RegionTypesAndKeysAreDistinct) {
+  S2CoveringCache cache(1 << 20);
+  S2RegionCoverer::Options options;
+  const S2Cap cap = GetTestCap();
+  const S2LatLngRect rect = cap.GetRectBound();
+  EXPECT_EQ(S2RegionCoverer(options).GetCovering(rect),
+            cache.GetCovering(rect, options));
+  EXPECT_EQ(S2RegionCoverer(options).GetCovering(cap),
+            cache.GetCovering(cap, options));
+  EXPECT_EQ(0, cache.stats().hits);
+
+  // Caller-supplied keys.
+  const S2CellUnion expected = S2RegionCoverer(options).GetCovering(cap);
+  EXPECT_EQ(expected, cache.GetCovering(cap, "cap", options));
+  EXPECT_EQ(expected, cache.GetCovering(cap, "cap", options));
+  EXPECT_EQ(1, cache.stats().hits);
+  EXPECT_EQ(3, cache.stats().num_entries);
+}
+
+TEST(S2CoveringCache, EvictsLeastRecentlyUsed) {
+  S2RegionCoverer::Options options;
+  const S2Cap cap1 = GetTestCap();
+  const S2Cap cap2(cap1.center(), S1Angle::Degrees(1));
+  const S2Cap cap3(cap1.center(), S1Angle::Degrees(2));
+
+  // Find the size of a single entry.
+  S2CoveringCache probe(1 << 20);
+  probe.GetCovering(cap1, options);
+  const size_t entry_bytes = probe.stats().bytes_used;
+
+  // Room for about two entries.
+  S2CoveringCache cache(2 * entry_bytes + entry_bytes / 2);
+  cache.GetCovering(cap1, options);
+  cache.GetCovering(cap2, options);
+  cache.GetCovering(cap1, options);  // cap1 is now the most recently used.
+  cache.GetCovering(cap3, options);  // Evicts cap2.
+  S2CoveringCache::Stats stats = cache.stats();
+  EXPECT_GE(stats.evictions, 1);
+  EXPECT_LE(stats.bytes_used, 2 * entry_bytes + entry_bytes / 2);
+
+  const int64 hits = stats.hits;
+  cache.GetCovering(cap1, options);
+  EXPECT_EQ(hits + 1, cache.stats().hits);
+
+  // An entry larger than the cache is not stored.
+  S2CoveringCache tiny(1);
+  tiny.GetCovering(cap1, options);
+  EXPECT_EQ(0, tiny.stats().num_entries);
+}
+
+TEST(S2CoveringCache, ApproximateCoveringsAreNotCached) {
+  S2CoveringCache cache(1 << 20);
+  S2RegionCoverer::Options options;
+  options.set_deadline(absl::InfinitePast());
+  const S2Cap cap = GetTestCap();
+  cache.GetCovering(cap, options);
+  cache.GetCovering(cap, options);
+  EXPECT_EQ(0, cache.stats().hits);
+  EXPECT_EQ(0, cache.stats().num_entries);
+}
+
+TEST(S2CoveringCache, WorksWithRegionTermIndexer) {
+  S2CoveringCache cache(1 << 20);
+  S2RegionTermIndexer::Options options;
+  options.set_max_cells(8);
+  S2RegionTermIndexer indexer(options);
+  const S2LatLngRect rect = GetTestCap().GetRectBound();
+  vector<string> expected = indexer.GetQueryTerms(rect, "");
+  for (int i = 0; i < 2; ++i) {
+    S2CellUnion covering = cache.GetCovering(rect, indexer.options());
+    EXPECT_EQ(expected,
+              indexer.GetQueryTermsForCanonicalCovering(covering, ""));
+  }
+  EXPECT_EQ(1, cache.stats().hits);
+}
+
+TEST(S2CoveringCache, ConcurrentAccess) {
+  S2CoveringCache cache(1 << 16);
+  S2RegionCoverer::Options options;
+  vector<S2Cap> caps;
+  vector<S2CellUnion> expected;
+  S2Testing::rnd.Reset(1);
+  for (int i = 0; i < 20; ++i) {
+    caps.push_back(S2Testing::GetRandomCap(1e-6, 1e-2));
+    expected.push_back(S2RegionCoverer(options).GetCovering(caps.back()));
+  }
+  vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < 200; ++i) {
+        const int j = (i * 7 + t) % caps.size();
+        EXPECT_EQ(expected[j], cache.GetCovering(caps[j], options));
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  S2CoveringCache::Stats stats = cache.stats();
+  EXPECT_EQ(800, stats.hits + stats.misses);
+  EXPECT_GT(stats.hits, 0);
+}
+
+}  // namespace
@@ -21,12 +21,16 @@
 #include <vector>
 
 #include "absl/log/absl_check.h"
+#include "absl/types/span.h"
+#include "s2/encoded_s2shape_index.h"
+#include "s2/mutable_s2shape_index.h"
 #include "s2/r1interval.h"
 #include "s2/r2.h"
 #include "s2/r2rect.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2edge_clipping.h"
 #include "s2/s2edge_crosser.h"
+#include "s2/s2index_edge_cache.h"
 #include "s2/s2padded_cell.h"
 #include "s2/s2point.h"
 #include "s2/s2shape.h"
@@ -34,22 +38,43 @@
 #include "s2/s2shapeutil_count_edges.h"
 #include "s2/s2shapeutil_shape_edge.h"
 #include "s2/s2shapeutil_shape_edge_id.h"
+#include "s2/s2tuning.h"
 
 using s2shapeutil::ShapeEdge;
 using s2shapeutil::ShapeEdgeId;
 using std::vector;
 
-// For small loops it is faster to use brute force.  The threshold below was
-// determined using the benchmarks in the unit test.
-static const int kMaxBruteForceEdges = 27;
-
 S2CrossingEdgeQuery::S2CrossingEdgeQuery() = default;
 
 S2CrossingEdgeQuery::~S2CrossingEdgeQuery() = default;
 
 void S2CrossingEdgeQuery::Init(const S2ShapeIndex* index) {
   index_ = index;
-  iter_.Init(index);
+  mutable_index_ = dynamic_cast<const MutableS2ShapeIndex*>(index);
+  encoded_index_ = dynamic_cast<const EncodedS2ShapeIndex*>(index);
+  if (mutable_index_ != nullptr) {
+    mutable_iter_.Init(mutable_index_);
+  } else if (encoded_index_ != nullptr) {
+    encoded_iter_.Init(encoded_index_);
+  } else {
+    iter_.Init(index);
+  }
+}
+
+// Calls "f" with a pointer to the iterator used to traverse the index (see
+// mutable_iter_ and friends).
+template <class Function>
+inline bool S2CrossingEdgeQuery::WithIterator(const Function& f) {
+  if (mutable_index_ != nullptr) return f(&mutable_iter_);
+  if (encoded_index_ != nullptr) return f(&encoded_iter_);
+  return f(&iter_);
+}
+
+// Passes the cell at the current position of "it" to visitor_.
+template <class IteratorType>
+inline bool S2CrossingEdgeQuery::VisitCell(const IteratorType& it) {
+  visited_id_ = it.id();
+  return (*visitor_)(it.cell());
 }
 
 vector<s2shapeutil::ShapeEdge> S2CrossingEdgeQuery::GetCrossingEdges(
@@ -71,6 +96,13 @@ void S2CrossingEdgeQuery::GetCrossingEdges(
     const S2Point& a0, const S2Point& a1, CrossingType type,
     vector<ShapeEdge>* edges) {
   edges->clear();
+  const int max_brute_force_edges =
+      s2tuning::max_brute_force_crossing_edges();
+  if (edge_cache_ != nullptr &&
+      s2shapeutil::CountEdgesUpTo(*index_, max_brute_force_edges + 1) >
+          max_brute_force_edges) {
+    return GetCrossingEdgesCached(a0, a1, -1, type, edges);
+  }
   GetCandidates(a0, a1, &tmp_candidates_);
   int min_sign = (type == CrossingType::ALL) ? 0 : 1;
   S2CopyingEdgeCrosser crosser(a0, a1);
@@ -94,6 +126,10 @@ void S2CrossingEdgeQuery::GetCrossingEdges(const S2Point& a0, const S2Point& a1,
                                            CrossingType type,
                                            vector<ShapeEdge>* edges) {
   edges->clear();
+  if (edge_cache_ != nullptr &&
+      shape.num_edges() > s2tuning::max_brute_force_crossing_edges()) {
+    return GetCrossingEdgesCached(a0, a1, shape_id, type, edges);
+  }
   GetCandidates(a0, a1, shape_id, shape, &tmp_candidates_);
   int min_sign = (type == CrossingType::ALL) ? 0 : 1;
   S2CopyingEdgeCrosser crosser(a0, a1);
@@ -106,6 +142,189 @@ void S2CrossingEdgeQuery::GetCrossingEdges(const S2Point& a0, const S2Point& a1,
   }
 }
 
+// Like GetCrossingEdges(), except that the edges of each candidate cell are
+// fetched from edge_cache_.  If "shape_id" is non-negative then only the
+// edges of that shape are returned.
+void S2CrossingEdgeQuery::GetCrossingEdgesCached(
+    const S2Point& a0, const S2Point& a1, int shape_id, CrossingType type,
+    vector<ShapeEdge>* edges) {
+  int min_sign = (type == CrossingType::ALL) ? 0 : 1;
+  S2CopyingEdgeCrosser crosser(a0, a1);
+  VisitCells(a0, a1, [&](const S2ShapeIndexCell& cell) {
+    const S2IndexEdgeCache::CellEdges& cell_edges =
+        edge_cache_->Load(*index_, visited_id_, cell);
+    const R2Rect edge_bound = R2Rect::FromPointPair(a0_, a1_);
+    const R2Rect* run_bounds = cell.edge_run_bounds();
+    for (int s = 0; s < cell.num_clipped(); ++s) {
+      const S2ClippedShape& clipped = cell.clipped(s);
+      const int num_edges = clipped.num_edges();
+      if (shape_id >= 0 && clipped.shape_id() != shape_id) {
+        if (run_bounds != nullptr) {
+          run_bounds += S2ShapeIndexCell::num_edge_runs(clipped);
+        }
+        continue;
+      }
+      absl::Span<const S2Shape::Edge> clipped_edges =
+          cell_edges.clipped_edges(s);
+      absl::Span<const S2IndexEdgeCache::FloatEdge> float_edges =
+          cell_edges.clipped_float_edges(s);
+      // Skip runs of edges whose bounds do not intersect the query edge, as
+      // in VisitClippedEdges().
+      for (int j = 0; j < num_edges;) {
+        int run_end = num_edges;
+        if (run_bounds != nullptr) {
+          run_end = std::min(j + S2ShapeIndexCell::kEdgesPerRun, num_edges);
+          if (!run_bounds++->Intersects(edge_bound)) {
+            j = run_end;
+            continue;
+          }
+        }
+        for (; j < run_end; ++j) {
+          if (!float_edges.empty() &&
+              crosser.IsDefinitelyNotCrossing(float_edges[j].v0,
+                                              float_edges[j].v1)) {
+            continue;
+          }
+          const S2Shape::Edge& b = clipped_edges[j];
+          if (crosser.CrossingSign(b.v0, b.v1) >= min_sign) {
+            edges->push_back(ShapeEdge(clipped.shape_id(), clipped.edge(j), b));
+          }
+        }
+      }
+    }
+    return true;
+  });
+  if (edges->size() > 1) {
+    std::sort(edges->begin(), edges->end(),
+              [](const ShapeEdge& x, const ShapeEdge& y) {
+                return x.id() < y.id();
+              });
+    edges->erase(std::unique(edges->begin(), edges->end(),
+                             [](const ShapeEdge& x, const ShapeEdge& y) {
+                               return x.id() == y.id();
+                             }),
+                 edges->end());
+  }
+}
+
+void S2CrossingEdgeQuery::GetChainCrossingEdges(
+    absl::Span<const S2Point> vertices, CrossingType type,
+    vector<vector<ShapeEdge>>* crossings) {
+  const int num_query_edges = std::max<int>(0, vertices.size() - 1);
+  crossings->resize(num_query_edges);
+  const int max_brute_force_edges =
+      s2tuning::max_brute_force_crossing_edges();
+  if (s2shapeutil::CountEdgesUpTo(*index_, max_brute_force_edges + 1) <=
+      max_brute_force_edges) {
+    // There is no index traversal to share between edges.
+    for (int i = 0; i < num_query_edges; ++i) {
+      GetCrossingEdges(vertices[i], vertices[i + 1], type, &(*crossings)[i]);
+    }
+    return;
+  }
+  if (use_candidate_bitmap_) {
+    const int num_shape_ids = index_->num_shape_ids();
+    edge_offsets_.resize(num_shape_ids);
+    int num_edges = 0;
+    for (int s = 0; s < num_shape_ids; ++s) {
+      edge_offsets_[s] = num_edges;
+      const S2Shape* shape = index_->shape(s);
+      if (shape != nullptr) num_edges += shape->num_edges();
+    }
+    candidate_bits_.assign((num_edges + 63) >> 6, 0);
+  }
+  // The cells of the generic S2ShapeIndex::Iterator are not guaranteed to
+  // remain valid once the iterator has moved, so they are never reused.
+  const bool reuse_cells =
+      mutable_index_ != nullptr || encoded_index_ != nullptr;
+  const int min_sign = (type == CrossingType::ALL) ? 0 : 1;
+  chain_cells_.clear();
+  S2::FaceSegmentVector segments;
+  for (int i = 0; i < num_query_edges; ++i) {
+    const S2Point& a0 = vertices[i];
+    const S2Point& a1 = vertices[i + 1];
+    vector<ShapeEdge>* edges = &(*crossings)[i];
+    edges->clear();
+    S2CopyingEdgeCrosser crosser(a0, a1);
+    int shape_id = -1;
+    const S2Shape* shape = nullptr;
+    const ShapeEdgeIdVisitor visitor = [&](ShapeEdgeId id) {
+      if (use_candidate_bitmap_) {
+        const int pos = edge_offsets_[id.shape_id] + id.edge_id;
+        const uint64 mask = uint64{1} << (pos & 63);
+        if (candidate_bits_[pos >> 6] & mask) return true;
+        candidate_bits_[pos >> 6] |= mask;
+        candidate_bit_positions_.push_back(pos);
+      }
+      if (id.shape_id != shape_id) {
+        shape_id = id.shape_id;
+        shape = index_->shape(shape_id);
+      }
+      S2Shape::Edge b = shape->edge(id.edge_id);
+      if (crosser.CrossingSign(b.v0, b.v1) >= min_sign) {
+        edges->push_back(ShapeEdge(id.shape_id, id.edge_id, b));
+      }
+      return true;
+    };
+    const auto visit_cell = [&](const S2ShapeIndexCell& cell) {
+      const R2Rect* run_bounds = cell.edge_run_bounds();
+      for (const S2ClippedShape& clipped : cell.clipped_shapes()) {
+        VisitClippedEdges(clipped, run_bounds, visitor);
+        if (run_bounds != nullptr) {
+          run_bounds += S2ShapeIndexCell::num_edge_runs(clipped);
+        }
+      }
+    };
+
+    // If the edge lies within one of the cells visited by the previous edge,
+    // that cell contains every indexed edge that could cross it.
+    bool reused = false;
+    if (reuse_cells) {
+      S2::GetFaceSegments(a0, a1, &segments);
+      if (segments.size() == 1) {
+        const R2Rect edge_bound =
+            R2Rect::FromPointPair(segments[0].a, segments[0].b);
+        for (const ChainCell& chain_cell : chain_cells_) {
+          if (chain_cell.id.face() == segments[0].face &&
+              chain_cell.bound.Contains(edge_bound)) {
+            a0_ = segments[0].a;
+            a1_ = segments[0].b;
+            visit_cell(*chain_cell.cell);
+            reused = true;
+            break;
+          }
+        }
+      }
+    }
+    if (!reused) {
+      chain_cells_.clear();
+      VisitCells(a0, a1, [&](const S2ShapeIndexCell& cell) {
+        if (reuse_cells) {
+          chain_cells_.push_back(
+              {visited_id_, S2PaddedCell(visited_id_, 0).bound(), &cell});
+        }
+        visit_cell(cell);
+        return true;
+      });
+    }
+    for (int pos : candidate_bit_positions_) {
+      candidate_bits_[pos >> 6] = 0;
+    }
+    candidate_bit_positions_.clear();
+    if (edges->size() > 1) {
+      std::sort(edges->begin(), edges->end(),
+                [](const ShapeEdge& x, const ShapeEdge& y) {
+                  return x.id() < y.id();
+                });
+      edges->erase(std::unique(edges->begin(), edges->end(),
+                               [](const ShapeEdge& x, const ShapeEdge& y) {
+                                 return x.id() == y.id();
+                               }),
+                   edges->end());
+    }
+  }
+}
+
 vector<ShapeEdgeId> S2CrossingEdgeQuery::GetCandidates(
     const S2Point& a0, const S2Point& a1) {
   vector<ShapeEdgeId> edges;
@@ -125,8 +344,11 @@ vector<ShapeEdgeId> S2CrossingEdgeQuery::GetCandidates(const S2Point& a0,
 void S2CrossingEdgeQuery::GetCandidates(const S2Point& a0, const S2Point& a1,
                                         vector<ShapeEdgeId>* edges) {
   edges->clear();
-  int num_edges = s2shapeutil::CountEdgesUpTo(*index_, kMaxBruteForceEdges + 1);
-  if (num_edges <= kMaxBruteForceEdges) {
+  const int max_brute_force_edges =
+      s2tuning::max_brute_force_crossing_edges();
+  int num_edges =
+      s2shapeutil::CountEdgesUpTo(*index_, max_brute_force_edges + 1);
+  if (num_edges <= max_brute_force_edges) {
     edges->reserve(num_edges);
   }
   VisitRawCandidates(a0, a1, [edges](ShapeEdgeId id) {
@@ -144,7 +366,7 @@ void S2CrossingEdgeQuery::GetCandidates(const S2Point& a0, const S2Point& a1,
                                         vector<ShapeEdgeId>* edges) {
   edges->clear();
   int num_edges = shape.num_edges();
-  if (num_edges <= kMaxBruteForceEdges) {
+  if (num_edges <= s2tuning::max_brute_force_crossing_edges()) {
     edges->reserve(num_edges);
   }
   VisitRawCandidates(a0, a1, shape_id, shape, [edges](ShapeEdgeId id) {
@@ -159,8 +381,11 @@ void S2CrossingEdgeQuery::GetCandidates(const S2Point& a0, const S2Point& a1,
 
 bool S2CrossingEdgeQuery::VisitRawCandidates(
     const S2Point& a0, const S2Point& a1, const ShapeEdgeIdVisitor& visitor) {
-  int num_edges = s2shapeutil::CountEdgesUpTo(*index_, kMaxBruteForceEdges + 1);
-  if (num_edges <= kMaxBruteForceEdges) {
+  const int max_brute_force_edges =
+      s2tuning::max_brute_force_crossing_edges();
+  int num_edges =
+      s2shapeutil::CountEdgesUpTo(*index_, max_brute_force_edges + 1);
+  if (num_edges <= max_brute_force_edges) {
     int num_shape_ids = index_->num_shape_ids();
     for (int s = 0; s < num_shape_ids; ++s) {
       const S2Shape* shape = index_->shape(s);
@@ -172,13 +397,12 @@ bool S2CrossingEdgeQuery::VisitRawCandidates(
     }
     return true;
   }
-  return VisitCells(a0, a1, [&visitor](const S2ShapeIndexCell& cell) {
-      for (int s = 0; s < cell.num_clipped(); ++s) {
-        const S2ClippedShape& clipped = cell.clipped(s);
-        for (int j = 0; j < clipped.num_edges(); ++j) {
-          if (!visitor(ShapeEdgeId(clipped.shape_id(), clipped.edge(j)))) {
-            return false;
-          }
+  return VisitCells(a0, a1, [this, &visitor](const S2ShapeIndexCell& cell) {
+      const R2Rect* run_bounds = cell.edge_run_bounds();
+      for (const S2ClippedShape& clipped : cell.clipped_shapes()) {
+        if (!VisitClippedEdges(clipped, run_bounds, visitor)) return false;
+        if (run_bounds != nullptr) {
+          run_bounds += S2ShapeIndexCell::num_edge_runs(clipped);
         }
       }
       return true;
@@ -189,7 +413,7 @@ bool S2CrossingEdgeQuery::VisitRawCandidates(
     const S2Point& a0, const S2Point& a1, int shape_id, const S2Shape& shape,
     const ShapeEdgeIdVisitor& visitor) {
   int num_edges = shape.num_edges();
-  if (num_edges <= kMaxBruteForceEdges) {
+  if (num_edges <= s2tuning::max_brute_force_crossing_edges()) {
     for (int e = 0; e < num_edges; ++e) {
       if (!visitor(ShapeEdgeId(shape_id, e))) return false;
     }
@@ -198,16 +422,54 @@ bool S2CrossingEdgeQuery::VisitRawCandidates(
   return VisitCells(a0, a1, [&](const S2ShapeIndexCell& cell) {
     const S2ClippedShape* clipped = cell.find_clipped(shape_id);
     if (clipped == nullptr) return true;
-    for (int j = 0; j < clipped->num_edges(); ++j) {
-      if (!visitor(ShapeEdgeId(shape_id, clipped->edge(j)))) return false;
+    const R2Rect* run_bounds = cell.edge_run_bounds();
+    if (run_bounds != nullptr) {
+      for (const S2ClippedShape* s = cell.clipped_shapes().data();
+           s != clipped; ++s) {
+        run_bounds += S2ShapeIndexCell::num_edge_runs(*s);
+      }
     }
-    return true;
+    return VisitClippedEdges(*clipped, run_bounds, visitor);
   });
 }
 
+// Visits the edges of "clipped" except for the runs of edges whose bounds
+// (the consecutive rectangles starting at "run_bounds", or nullptr if there
+// are none) do not intersect the current query edge (a0_, a1_).
+bool S2CrossingEdgeQuery::VisitClippedEdges(
+    const S2ClippedShape& clipped, const R2Rect* run_bounds,
+    const ShapeEdgeIdVisitor& visitor) const {
+  const int num_edges = clipped.num_edges();
+  const R2Rect edge_bound = R2Rect::FromPointPair(a0_, a1_);
+  for (int j = 0; j < num_edges;) {
+    int run_end = num_edges;
+    if (run_bounds != nullptr) {
+      run_end = std::min(j + S2ShapeIndexCell::kEdgesPerRun, num_edges);
+      if (!run_bounds++->Intersects(edge_bound)) {
+        j = run_end;
+        continue;
+      }
+    }
+    for (; j < run_end; ++j) {
+      if (!visitor(ShapeEdgeId(clipped.shape_id(), clipped.edge(j)))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
 bool S2CrossingEdgeQuery::VisitCells(const S2Point& a0, const S2Point& a1,
                                      const CellVisitor& visitor) {
   visitor_ = &visitor;
+  return WithIterator([&](auto* it) { return VisitEdgeCells(it, a0, a1); });
+}
+
+// Calls visitor_ for each index cell that might contain edges intersecting
+// the edge (a0, a1), using "it" to traverse the index.
+template <class IteratorType>
+bool S2CrossingEdgeQuery::VisitEdgeCells(IteratorType* it, const S2Point& a0,
+                                         const S2Point& a1) {
   S2::FaceSegmentVector segments;
   S2::GetFaceSegments(a0, a1, &segments);
   for (const auto& segment : segments) {
@@ -231,16 +493,16 @@ bool S2CrossingEdgeQuery::VisitCells(const S2Point& a0, const S2Point& a1,
     //     we recursively subdivide to find the cells intersected by a0a1.
     //  3. edge_root does not intersect any index cells.  In this case there
     //     is nothing to do.
-    S2CellRelation relation = iter_.Locate(edge_root);
+    S2CellRelation relation = it->Locate(edge_root);
     if (relation == S2CellRelation::INDEXED) {
       // edge_root is an index cell or is contained by an index cell (case 1).
-      ABSL_DCHECK(iter_.id().contains(edge_root));
-      if (!visitor(iter_.cell())) return false;
+      ABSL_DCHECK(it->id().contains(edge_root));
+      if (!VisitCell(*it)) return false;
     } else if (relation == S2CellRelation::SUBDIVIDED) {
       // edge_root is subdivided into one or more index cells (case 2).  We
       // find the cells intersected by a0a1 using recursive subdivision.
       if (!edge_root.is_face()) pcell = S2PaddedCell(edge_root, 0);
-      if (!VisitCells(pcell, edge_bound)) return false;
+      if (!VisitCells(it, pcell, edge_bound)) return false;
     }
   }
   return true;
@@ -257,7 +519,8 @@ bool S2CrossingEdgeQuery::VisitCells(
                            S2::kFaceClipErrorUVCoord, &a0_, &a1_)) {
     R2Rect edge_bound = R2Rect::FromPointPair(a0_, a1_);
     if (root.bound().Intersects(edge_bound)) {
-      return VisitCells(root, edge_bound);
+      return WithIterator(
+          [&](auto* it) { return VisitCells(it, root, edge_bound); });
     }
   }
   return true;
@@ -270,45 +533,47 @@ bool S2CrossingEdgeQuery::VisitCells(
 // size is about 2K in versions of GCC prior to 4.7 due to poor overlapping
 // of storage for temporaries.  This is fixed in GCC 4.7, reducing the frame
 // size to about 350 bytes (i.e., worst-case total stack usage of about 10K).
-bool S2CrossingEdgeQuery::VisitCells(const S2PaddedCell& pcell,
+template <class IteratorType>
+bool S2CrossingEdgeQuery::VisitCells(IteratorType* it,
+                                     const S2PaddedCell& pcell,
                                      const R2Rect& edge_bound) {
   // This code uses S2PaddedCell because it has the methods we need for
   // efficient splitting, however the actual padding is required to be zero.
   ABSL_DCHECK_EQ(pcell.padding(), 0);
 
-  iter_.Seek(pcell.id().range_min());
-  if (iter_.done() || iter_.id() > pcell.id().range_max()) {
+  it->Seek(pcell.id().range_min());
+  if (it->done() || it->id() > pcell.id().range_max()) {
     // The index does not contain "pcell" or any of its descendants.
     return true;
   }
-  if (iter_.id() == pcell.id()) {
-    return (*visitor_)(iter_.cell());
+  if (it->id() == pcell.id()) {
+    return VisitCell(*it);
   }
 
   // Otherwise, split the edge among the four children of "pcell".
   R2Point center = pcell.middle().lo();
   if (edge_bound[0].hi() < center[0]) {
     // Edge is entirely contained in the two left children.
-    return ClipVAxis(edge_bound, center[1], 0, pcell);
+    return ClipVAxis(it, edge_bound, center[1], 0, pcell);
   } else if (edge_bound[0].lo() >= center[0]) {
     // Edge is entirely contained in the two right children.
-    return ClipVAxis(edge_bound, center[1], 1, pcell);
+    return ClipVAxis(it, edge_bound, center[1], 1, pcell);
   } else {
     R2Rect child_bounds[2];
     SplitUBound(edge_bound, center[0], child_bounds);
     if (edge_bound[1].hi() < center[1]) {
       // Edge is entirely contained in the two lower children.
-      return (VisitCells(S2PaddedCell(pcell, 0, 0), child_bounds[0]) &&
-              VisitCells(S2PaddedCell(pcell, 1, 0), child_bounds[1]));
+      return (VisitCells(it, S2PaddedCell(pcell, 0, 0), child_bounds[0]) &&
+              VisitCells(it, S2PaddedCell(pcell, 1, 0), child_bounds[1]));
     } else if (edge_bound[1].lo() >= center[1]) {
       // Edge is entirely contained in the two upper children.
-      return (VisitCells(S2PaddedCell(pcell, 0, 1), child_bounds[0]) &&
-              VisitCells(S2PaddedCell(pcell, 1, 1), child_bounds[1]));
+      return (VisitCells(it, S2PaddedCell(pcell, 0, 1), child_bounds[0]) &&
+              VisitCells(it, S2PaddedCell(pcell, 1, 1), child_bounds[1]));
     } else {
       // The edge bound spans all four children.  The edge itself intersects
       // at most three children (since no padding is being used).
-      return (ClipVAxis(child_bounds[0], center[1], 0, pcell) &&
-              ClipVAxis(child_bounds[1], center[1], 1, pcell));
+      return (ClipVAxis(it, child_bounds[0], center[1], 0, pcell) &&
+              ClipVAxis(it, child_bounds[1], center[1], 1, pcell));
     }
   }
 }
@@ -317,21 +582,23 @@ bool S2CrossingEdgeQuery::VisitCells(const S2PaddedCell& pcell,
 // determine whether the current edge intersects the lower child, upper child,
 // or both children, and call VisitCells() recursively on those children.
 // "center" is the v-coordinate at the center of "pcell".
-inline bool S2CrossingEdgeQuery::ClipVAxis(const R2Rect& edge_bound,
+template <class IteratorType>
+inline bool S2CrossingEdgeQuery::ClipVAxis(IteratorType* it,
+                                           const R2Rect& edge_bound,
                                            double center, int i,
                                            const S2PaddedCell& pcell) {
   if (edge_bound[1].hi() < center) {
     // Edge is entirely contained in the lower child.
-    return VisitCells(S2PaddedCell(pcell, i, 0), edge_bound);
+    return VisitCells(it, S2PaddedCell(pcell, i, 0), edge_bound);
   } else if (edge_bound[1].lo() >= center) {
     // Edge is entirely contained in the upper child.
-    return VisitCells(S2PaddedCell(pcell, i, 1), edge_bound);
+    return VisitCells(it, S2PaddedCell(pcell, i, 1), edge_bound);
   } else {
     // The edge intersects both children.
     R2Rect child_bounds[2];
     SplitVBound(edge_bound, center, child_bounds);
-    return (VisitCells(S2PaddedCell(pcell, i, 0), child_bounds[0]) &&
-            VisitCells(S2PaddedCell(pcell, i, 1), child_bounds[1]));
+    return (VisitCells(it, S2PaddedCell(pcell, i, 0), child_bounds[0]) &&
+            VisitCells(it, S2PaddedCell(pcell, i, 1), child_bounds[1]));
   }
 }
 
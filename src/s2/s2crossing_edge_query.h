@@ -26,9 +26,15 @@
 #include "absl/base/macros.h"
 #include "absl/container/inlined_vector.h"
 #include "absl/log/absl_check.h"
+#include "absl/types/span.h"
 #include "s2/_fp_contract_off.h"
+#include "s2/base/types.h"
+#include "s2/encoded_s2shape_index.h"
+#include "s2/mutable_s2shape_index.h"
 #include "s2/r2.h"
 #include "s2/r2rect.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2index_edge_cache.h"
 #include "s2/s2padded_cell.h"
 #include "s2/s2point.h"
 #include "s2/s2shape.h"
@@ -88,6 +94,18 @@ class S2CrossingEdgeQuery {
   // REQUIRES: "index" is not modified after this method is called.
   void Init(const S2ShapeIndex* index);
 
+  // If non-null, GetCrossingEdges() fetches the edges of each index cell
+  // from this cache, so that repeated queries that visit the same cells do
+  // not fetch the same edges from their shapes again (see S2IndexEdgeCache).
+  // The cache is not thread-safe and is typically shared by all the queries
+  // of one thread.
+  //
+  // DEFAULT: nullptr
+  S2IndexEdgeCache* edge_cache() const { return edge_cache_; }
+  void set_edge_cache(S2IndexEdgeCache* edge_cache) {
+    edge_cache_ = edge_cache;
+  }
+
   // Returns all edges that intersect the given query edge (a0,a1) and that
   // have the given CrossingType (ALL or INTERIOR).  Edges are sorted and
   // unique.
@@ -111,6 +129,35 @@ class S2CrossingEdgeQuery {
                         const S2Shape& shape, CrossingType type,
                         std::vector<s2shapeutil::ShapeEdge>* edges);
 
+  // Returns the edges that intersect each edge of the chain "vertices" and
+  // that have the given CrossingType, grouped by query edge: (*crossings)[i]
+  // contains the edges that intersect (vertices[i], vertices[i+1]).  Each
+  // group is sorted and unique.  The inner vectors are reused, so it is
+  // efficient to call this method repeatedly with the same "crossings".
+  //
+  // This is equivalent to calling GetCrossingEdges() for each edge of the
+  // chain, but is faster for long polylines because consecutive edges
+  // usually lie in the same index cells.  When a query edge is contained by
+  // one of the cells visited by the previous query edge, that cell is used
+  // directly rather than descending the index again.
+  void GetChainCrossingEdges(
+      absl::Span<const S2Point> vertices, CrossingType type,
+      std::vector<std::vector<s2shapeutil::ShapeEdge>>* crossings);
+
+  // If true, GetChainCrossingEdges() uses a bitmap with one bit per edge of
+  // the index to skip candidate edges that have already been tested against
+  // the current query edge (which happens when a query edge spans several
+  // index cells that contain the same indexed edge).  Otherwise duplicate
+  // candidates are tested again and removed from the result by sorting.
+  // The bitmap is worthwhile for dense indexes whose edges are split across
+  // many cells, but costs (num_edges / 8) bytes per call.
+  //
+  // DEFAULT: false
+  bool use_candidate_bitmap() const { return use_candidate_bitmap_; }
+  void set_use_candidate_bitmap(bool use_candidate_bitmap) {
+    use_candidate_bitmap_ = use_candidate_bitmap;
+  }
+
   /////////////////////////// Low-Level Methods ////////////////////////////
   //
   // Most clients will not need the following methods.  They can be slightly
@@ -195,9 +242,24 @@ class S2CrossingEdgeQuery {
 
  private:
   // Internal methods are documented with their definitions.
-  bool VisitCells(const S2PaddedCell& pcell, const R2Rect& edge_bound);
-  bool ClipVAxis(const R2Rect& edge_bound, double center, int i,
-                 const S2PaddedCell& pcell);
+  void GetCrossingEdgesCached(const S2Point& a0, const S2Point& a1,
+                              int shape_id, CrossingType type,
+                              std::vector<s2shapeutil::ShapeEdge>* edges);
+  template <class IteratorType>
+  bool VisitEdgeCells(IteratorType* it, const S2Point& a0, const S2Point& a1);
+  template <class IteratorType>
+  bool VisitCells(IteratorType* it, const S2PaddedCell& pcell,
+                  const R2Rect& edge_bound);
+  template <class IteratorType>
+  bool ClipVAxis(IteratorType* it, const R2Rect& edge_bound, double center,
+                 int i, const S2PaddedCell& pcell);
+  template <class IteratorType>
+  bool VisitCell(const IteratorType& it);
+  template <class Function>
+  bool WithIterator(const Function& f);
+  bool VisitClippedEdges(const S2ClippedShape& clipped,
+                         const R2Rect* run_bounds,
+                         const ShapeEdgeIdVisitor& visitor) const;
   void SplitUBound(const R2Rect& edge_bound, double u,
                    R2Rect child_bounds[2]) const;
   void SplitVBound(const R2Rect& edge_bound, double v,
@@ -206,15 +268,45 @@ class S2CrossingEdgeQuery {
                          int v_end, double v, R2Rect child_bounds[2]);
 
   const S2ShapeIndex* index_ = nullptr;
+  S2IndexEdgeCache* edge_cache_ = nullptr;
+  bool use_candidate_bitmap_ = false;
 
   //////////// Temporary storage used while processing a query ///////////
 
   R2Point a0_, a1_;
-  S2ShapeIndex::Iterator iter_;
   const CellVisitor* visitor_;
 
+  // The id of the cell most recently passed to visitor_.
+  S2CellId visited_id_;
+
+  // The iterator used to traverse the index.  MutableS2ShapeIndex and
+  // EncodedS2ShapeIndex are traversed using their own iterator types, so
+  // that the iterator methods called while recursively subdividing the query
+  // edge are not virtual and can be inlined.  Only one of these is used.
+  const MutableS2ShapeIndex* mutable_index_ = nullptr;
+  const EncodedS2ShapeIndex* encoded_index_ = nullptr;
+  MutableS2ShapeIndex::Iterator mutable_iter_;
+  EncodedS2ShapeIndex::Iterator encoded_iter_;
+  S2ShapeIndex::Iterator iter_;
+
   // Avoids repeated allocation when methods are called many times.
   std::vector<s2shapeutil::ShapeEdgeId> tmp_candidates_;
+
+  // The index cells visited by the previous edge in GetChainCrossingEdges(),
+  // together with their (u,v) bounds.
+  struct ChainCell {
+    S2CellId id;
+    R2Rect bound;
+    const S2ShapeIndexCell* cell;
+  };
+  std::vector<ChainCell> chain_cells_;
+
+  // The position of the first edge of each shape in candidate_bits_, and the
+  // positions that are set for the current query edge (so that they can be
+  // cleared without clearing the entire bitmap).
+  std::vector<int> edge_offsets_;
+  std::vector<uint64> candidate_bits_;
+  std::vector<int> candidate_bit_positions_;
 };
 
 
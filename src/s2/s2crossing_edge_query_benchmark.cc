@@ -0,0 +1,76 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2crossing_edge_query.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2fractal.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2shapeutil_shape_edge.h"
+#include "s2/s2testing.h"
+
+using s2shapeutil::CrossingType;
+using s2shapeutil::ShapeEdge;
+using std::make_unique;
+using std::pair;
+using std::vector;
+
+namespace {
+
+// Finds the edges of a fractal loop with about 64K edges that cross short
+// random query edges near the loop.  state.range(0) is max_edges_per_cell()
+// and state.range(1) selects the edge_run_bounds() option.
+void BM_GetCrossingEdges(benchmark::State& state) {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(1 << 16);
+  S2Point center = S2Testing::RandomPoint();
+  MutableS2ShapeIndex::Options options;
+  options.set_max_edges_per_cell(state.range(0));
+  options.set_edge_run_bounds(state.range(1));
+  MutableS2ShapeIndex index(options);
+  index.Add(make_unique<S2Loop::OwningShape>(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(center), S1Angle::Degrees(1))));
+  index.ForceBuild();
+
+  S2Cap cap(center, S1Angle::Degrees(1));
+  S1Angle length = S1Angle::Degrees(0.002);
+  vector<pair<S2Point, S2Point>> edges;
+  for (int i = 0; i < 1024; ++i) {
+    S2Point a = S2Testing::SamplePoint(cap);
+    S2Point b = S2Testing::SamplePoint(S2Cap(a, length));
+    edges.emplace_back(a, b);
+  }
+  S2CrossingEdgeQuery query(&index);
+  vector<ShapeEdge> crossings;
+  int i = 0;
+  for (auto _ : state) {
+    const auto& edge = edges[i++ & 1023];
+    query.GetCrossingEdges(edge.first, edge.second, CrossingType::ALL,
+                           &crossings);
+    benchmark::DoNotOptimize(crossings.size());
+  }
+}
+BENCHMARK(BM_GetCrossingEdges)->ArgsProduct({{10, 50}, {0, 1}});
+
+}  // namespace
@@ -32,6 +32,9 @@
 #include "absl/strings/str_cat.h"
 
 #include "s2/base/casts.h"
+#include "s2/util/coding/coder.h"
+#include "s2/composite_s2shape_index.h"
+#include "s2/encoded_s2shape_index.h"
 #include "s2/mutable_s2shape_index.h"
 #include "s2/r2.h"
 #include "s2/s1angle.h"
@@ -43,12 +46,17 @@
 #include "s2/s2edge_crossings.h"
 #include "s2/s2edge_distances.h"
 #include "s2/s2edge_vector_shape.h"
+#include "s2/s2fractal.h"
+#include "s2/s2index_edge_cache.h"
+#include "s2/s2lax_polygon_shape.h"
 #include "s2/s2metrics.h"
 #include "s2/s2padded_cell.h"
 #include "s2/s2point.h"
+#include "s2/s2polygon.h"
 #include "s2/s2polyline.h"
 #include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
+#include "s2/s2shapeutil_coding.h"
 #include "s2/s2shapeutil_shape_edge.h"
 #include "s2/s2shapeutil_shape_edge_id.h"
 #include "s2/s2testing.h"
@@ -126,7 +134,7 @@ static vector<ShapeEdgeId> GetShapeEdgeIds(
   return shape_edge_ids;
 }
 
-void TestAllCrossings(const vector<TestEdge>& edges) {
+void TestAllCrossings(const vector<TestEdge>& edges, bool edge_run_bounds) {
   auto shape = new S2EdgeVectorShape;  // raw pointer since "shape" used below
   for (const TestEdge& edge : edges) {
     shape->Add(edge.first, edge.second);
@@ -134,6 +142,7 @@ void TestAllCrossings(const vector<TestEdge>& edges) {
   // Force more subdivision than usual to make the test more challenging.
   MutableS2ShapeIndex::Options options;
   options.set_max_edges_per_cell(1);
+  options.set_edge_run_bounds(edge_run_bounds);
   MutableS2ShapeIndex index(options);
   const int shape_id = index.Add(absl::WrapUnique(shape));
   EXPECT_EQ(0, shape_id);
@@ -211,6 +220,15 @@ void TestAllCrossings(const vector<TestEdge>& edges) {
   EXPECT_LE(num_candidates, 3 * num_nearby_pairs);
 }
 
+// Runs the test above with and without edge run bounds, which should only
+// reduce the number of candidates.
+void TestAllCrossings(const vector<TestEdge>& edges) {
+  for (bool edge_run_bounds : {false, true}) {
+    SCOPED_TRACE(StrCat("edge_run_bounds = ", edge_run_bounds));
+    TestAllCrossings(edges, edge_run_bounds);
+  }
+}
+
 // Test edges that lie in the plane of one of the S2 cube edges.  Such edges
 // may lie on the boundary between two cube faces, or pass through a cube
 // vertex, or follow a 45 diagonal across a cube face toward its center.
@@ -340,6 +358,104 @@ TEST(GetCrossings, ShapeIdsAreCorrect) {
   TestPolylineCrossings(index, MakePointOrDie("1:-10"), MakePointOrDie("1:30"));
 }
 
+// MutableS2ShapeIndex and EncodedS2ShapeIndex are traversed using their own
+// iterator types.  Check that the results match those obtained through the
+// generic S2ShapeIndex::Iterator interface.
+TEST(GetCrossings, IndexTypesAgree) {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3000);
+  const S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(5));
+  MutableS2ShapeIndex mutable_index;
+  mutable_index.Add(make_unique<S2LaxPolygonShape>(S2Polygon(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(cap.center()), cap.GetRadius()))));
+  Encoder encoder;
+  ASSERT_TRUE(s2shapeutil::CompactEncodeTaggedShapes(mutable_index, &encoder));
+  mutable_index.Encode(&encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex encoded_index;
+  ASSERT_TRUE(encoded_index.Init(
+      &decoder, s2shapeutil::LazyDecodeShapeFactory(&decoder)));
+  // CompositeS2ShapeIndex is not specialized, so it uses the generic iterator.
+  CompositeS2ShapeIndex generic_index({&mutable_index});
+
+  S2CrossingEdgeQuery mutable_query(&mutable_index);
+  S2CrossingEdgeQuery encoded_query(&encoded_index);
+  S2CrossingEdgeQuery generic_query(&generic_index);
+  S2IndexEdgeCache edge_cache;
+  vector<TestEdge> edges;
+  GetCapEdges(cap, S1Angle::Degrees(2), 100, &edges);
+  for (bool use_cache : {false, true}) {
+    SCOPED_TRACE(StrCat("use_cache = ", use_cache));
+    encoded_query.set_edge_cache(use_cache ? &edge_cache : nullptr);
+    for (const TestEdge& edge : edges) {
+      const S2Point& a = edge.first;
+      const S2Point& b = edge.second;
+      const vector<ShapeEdgeId> expected = GetShapeEdgeIds(
+          generic_query.GetCrossingEdges(a, b, CrossingType::ALL));
+      EXPECT_EQ(GetShapeEdgeIds(
+                    mutable_query.GetCrossingEdges(a, b, CrossingType::ALL)),
+                expected);
+      EXPECT_EQ(GetShapeEdgeIds(
+                    encoded_query.GetCrossingEdges(a, b, CrossingType::ALL)),
+                expected);
+      EXPECT_EQ(mutable_query.GetCandidates(a, b),
+                generic_query.GetCandidates(a, b));
+    }
+  }
+}
+
+TEST(GetCrossings, ChainCrossingsMatchEdgeCrossings) {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3000);
+  const S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(5));
+  MutableS2ShapeIndex mutable_index;
+  mutable_index.Add(make_unique<S2LaxPolygonShape>(S2Polygon(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(cap.center()), cap.GetRadius()))));
+  mutable_index.Add(make_unique<S2Polyline::OwningShape>(
+      make_unique<S2Polyline>(fractal.MakeLoop(
+          S2Testing::GetRandomFrameAt(cap.center()), cap.GetRadius())
+          ->vertices_span())));
+  CompositeS2ShapeIndex generic_index({&mutable_index});
+
+  // A random walk with edges of various lengths, some of which cross the
+  // boundaries of the fractals many times.
+  vector<S2Point> chain = {cap.center()};
+  for (int i = 0; i < 500; ++i) {
+    S1Angle length = S1Angle::Degrees(S2Testing::rnd.RandDouble() *
+                                      (i % 50 == 0 ? 5 : 0.1));
+    chain.push_back(S2::GetPointOnLine(chain.back(), S2Testing::RandomPoint(),
+                                       length));
+  }
+  S2CrossingEdgeQuery expected_query(&mutable_index);
+  for (const S2ShapeIndex* index :
+       {static_cast<const S2ShapeIndex*>(&mutable_index),
+        static_cast<const S2ShapeIndex*>(&generic_index)}) {
+    S2CrossingEdgeQuery query(index);
+    for (bool use_candidate_bitmap : {false, true}) {
+      SCOPED_TRACE(StrCat("use_candidate_bitmap = ", use_candidate_bitmap));
+      query.set_use_candidate_bitmap(use_candidate_bitmap);
+      for (CrossingType type : {CrossingType::ALL, CrossingType::INTERIOR}) {
+        vector<vector<ShapeEdge>> crossings;
+        query.GetChainCrossingEdges(chain, type, &crossings);
+        ASSERT_EQ(crossings.size(), chain.size() - 1);
+        int num_crossings = 0;
+        for (int i = 0; i + 1 < chain.size(); ++i) {
+          EXPECT_EQ(GetShapeEdgeIds(crossings[i]),
+                    GetShapeEdgeIds(expected_query.GetCrossingEdges(
+                        chain[i], chain[i + 1], type)));
+          num_crossings += crossings[i].size();
+        }
+        EXPECT_GT(num_crossings, 0);
+      }
+    }
+  }
+  vector<vector<ShapeEdge>> crossings;
+  expected_query.GetChainCrossingEdges({}, CrossingType::ALL, &crossings);
+  EXPECT_TRUE(crossings.empty());
+}
+
 // Verifies that when VisitCells() is called with a specified root cell and a
 // query edge that barely intersects that cell, that at least one cell is
 // visited.  (At one point this was not always true, because when the query edge
@@ -23,8 +23,10 @@
 #include <functional>
 #include <iterator>
 #include <limits>
+#include <memory>
 #include <optional>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -33,6 +35,7 @@
 #include "absl/container/btree_set.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
+#include "absl/numeric/int128.h"
 #include "absl/strings/string_view.h"
 #include "s2/util/coding/coder.h"
 #include "s2/util/coding/varint.h"
@@ -49,12 +52,18 @@
 using absl::btree_map;
 using absl::btree_set;
 using absl::string_view;
+using std::make_shared;
 using std::string;
 using std::vector;
 
 static constexpr string_view kVersion = "S2DensityTree0";
 static constexpr int kNumChildrenPerCell = 4;
 
+// The minimum number of cells weighed by each thread when building a tree
+// with multiple threads.  Weighing a cell typically requires a query of an
+// S2ShapeIndex, so this can be fairly small.
+static constexpr int kMinCellsPerThread = 64;
+
 // A Node associates an S2CellId and its decoded state within an
 // S2DensityTree.
 class Node {
@@ -194,23 +203,43 @@ bool S2DensityTree::InitToShapeDensity(const S2ShapeIndex& index,
                                        const ShapeWeightFunction& weight_fn,
                                        int64 approximate_size_bytes,
                                        int max_level, S2Error* error) {
+  return InitToShapeDensity(index, weight_fn, approximate_size_bytes,
+                            max_level, /*num_threads=*/1, error);
+}
+
+bool S2DensityTree::InitToShapeDensity(const S2ShapeIndex& index,
+                                       const ShapeWeightFunction& weight_fn,
+                                       int64 approximate_size_bytes,
+                                       int max_level, int num_threads,
+                                       S2Error* error) {
   ABSL_DCHECK(error != nullptr) << "error must be non-nullptr";
   error->Clear();
 
-  IndexCellWeightFunction index_cell_weight_fn(&index, weight_fn);
-
   TreeEncoder encoder;
   BreadthFirstTreeBuilder builder(approximate_size_bytes, max_level, encoder);
   return builder.Build(
-      [&](const S2CellId cell_id, S2Error* error) {
-        return index_cell_weight_fn.WeighCell(cell_id, error);
+      [&]() -> BreadthFirstTreeBuilder::CellWeightFunction {
+        // Each thread gets its own S2ShapeIndexRegion.
+        auto index_cell_weight_fn =
+            make_shared<IndexCellWeightFunction>(&index, weight_fn);
+        return [index_cell_weight_fn](const S2CellId cell_id, S2Error* error) {
+          return index_cell_weight_fn->WeighCell(cell_id, error);
+        };
       },
-      this, error);
+      num_threads, this, error);
 }
 
 bool S2DensityTree::InitToVertexDensity(const S2ShapeIndex& index,
                                         int64 approximate_size_bytes,
                                         int max_level, S2Error* error) {
+  return InitToVertexDensity(index, approximate_size_bytes, max_level,
+                             /*num_threads=*/1, error);
+}
+
+bool S2DensityTree::InitToVertexDensity(const S2ShapeIndex& index,
+                                        int64 approximate_size_bytes,
+                                        int max_level, int num_threads,
+                                        S2Error* error) {
   return InitToShapeDensity(
       index,
       [&](const S2Shape& shape) {
@@ -226,7 +255,7 @@ bool S2DensityTree::InitToVertexDensity(const S2ShapeIndex& index,
                          << " dimensions";
         return 0;
       },
-      approximate_size_bytes, max_level, error);
+      approximate_size_bytes, max_level, num_threads, error);
 }
 
 bool S2DensityTree::InitToSumDensity(vector<const S2DensityTree*>& trees,
@@ -502,6 +531,97 @@ vector<S2CellUnion> S2DensityTree::GetPartitioning(int64 max_weight,
   return partitioning;
 }
 
+vector<S2CellUnion> S2DensityTree::GetBalancedPartitioning(
+    int num_shards, S2Error* error) const {
+  ABSL_DCHECK(error != nullptr) << "error must be non-nullptr";
+  error->Clear();
+
+  if (num_shards <= 0) {
+    error->Init(S2Error::INVALID_ARGUMENT,
+                "num_shards must be positive, got %d", num_shards);
+    return {};
+  }
+
+  // The weight of each face cell is already normalized.
+  int64 total_weight = 0;
+  for (int face = 0; face < decoded_faces_.size(); ++face) {
+    if (decoded_faces_[face] < 0) continue;
+    Cell cell;
+    if (!cell.DecodeAt(this, decoded_faces_[face], error)) {
+      return {};
+    }
+    total_weight += cell.weight();
+  }
+
+  // Collect cells in Hilbert curve order whose normalized weight is at most
+  // 1/16th of the average shard weight, or which have no children.
+  const int64 target_weight = total_weight / num_shards / 16;
+  DecodedPath decoder(this);
+  vector<std::pair<S2CellId, int64>> candidates;
+  VisitCells(
+      [&](const S2CellId cell_id, const S2DensityTree::Cell& cell) {
+        const int64 normal_weight =
+            Node(cell_id, &cell, &decoder).GetNormalCellWeight();
+        if (normal_weight > target_weight && cell.has_children()) {
+          return VisitAction::ENTER_CELL;
+        }
+        if (normal_weight > 0) {
+          candidates.push_back({cell_id, normal_weight});
+        }
+        return VisitAction::SKIP_CELL;
+      },
+      error);
+  if (!error->ok()) {
+    return {};
+  }
+
+  // The normalized weights are rounded, so recompute the total from the
+  // candidates.
+  absl::int128 sum = 0;
+  for (const auto& candidate : candidates) sum += candidate.second;
+
+  // Assign each cell to the shard containing the midpoint of its weight along
+  // the curve.  This keeps the shards contiguous and bounds the error in each
+  // shard's weight by the weight of its largest cell.
+  vector<vector<S2CellId>> shards(num_shards);
+  absl::int128 prefix = 0;
+  for (const auto& [cell_id, weight] : candidates) {
+    const int shard = static_cast<int>(std::min<absl::int128>(
+        num_shards - 1, (2 * prefix + weight) * num_shards / (2 * sum)));
+    shards[shard].push_back(cell_id);
+    prefix += weight;
+  }
+
+  // Replace each cell by its largest ancestor that does not intersect any
+  // other shard.  Since the shards are contiguous along the Hilbert curve it
+  // is sufficient to check the neighboring non-empty shards.
+  vector<S2CellUnion> partitioning(num_shards);
+  S2CellId prev_max = S2CellId::None();
+  for (int i = 0; i < num_shards; ++i) {
+    vector<S2CellId>& cells = shards[i];
+    if (cells.empty()) continue;
+
+    S2CellId next_min = S2CellId::Sentinel();
+    for (int j = i + 1; j < num_shards; ++j) {
+      if (!shards[j].empty()) {
+        next_min = shards[j].front().range_min();
+        break;
+      }
+    }
+
+    for (S2CellId& cell_id : cells) {
+      while (!cell_id.is_face() && cell_id.parent().range_min() > prev_max &&
+             cell_id.parent().range_max() < next_min) {
+        cell_id = cell_id.parent();
+      }
+    }
+    partitioning[i] = S2CellUnion(std::move(cells));
+    prev_max = partitioning[i].cell_ids().back().range_max();
+  }
+
+  return partitioning;
+}
+
 btree_map<S2CellId, int64> S2DensityTree::Decode(S2Error* error) const {
   btree_map<S2CellId, int64> weights;
 
@@ -561,55 +681,108 @@ int64 S2DensityTree::IndexCellWeightFunction::WeighCell(
 bool S2DensityTree::BreadthFirstTreeBuilder::Build(
     const CellWeightFunction& weight_fn, S2DensityTree* tree,
     S2Error* error) const {
+  return Build([&weight_fn] { return weight_fn; }, /*num_threads=*/1, tree,
+               error);
+}
+
+bool S2DensityTree::BreadthFirstTreeBuilder::Build(
+    const CellWeightFunctionFactory& weight_fn_factory, int num_threads,
+    S2DensityTree* tree, S2Error* error) const {
   vector<std::pair<S2CellId, S2CellId>> ranges{{
       S2CellId::Begin(S2CellId::kMaxLevel),
       S2CellId::End(S2CellId::kMaxLevel),
   }};
   vector<std::pair<S2CellId, S2CellId>> next_level_ranges;
 
+  // The weight functions are created lazily, one per thread.
+  vector<CellWeightFunction> weight_fns;
+  vector<S2CellId> cell_ids;
+  vector<int64> weights;
+
   for (int level = 0, size_estimate_bytes = 0;
        !ranges.empty() && level <= max_level_ &&
        size_estimate_bytes < approximate_size_bytes_;
        ++level) {
-    S2CellId last_range_end = S2CellId::Sentinel();
-
+    cell_ids.clear();
     for (auto& range : ranges) {
       for (S2CellId cell_id = range.first.parent(level); cell_id < range.second;
            cell_id = cell_id.next()) {
-        // Get the weight and skip this cell_id unless it's larger than 0.
-        int64 weight = weight_fn(cell_id, error);
+        cell_ids.push_back(cell_id);
+      }
+    }
+
+    // Weigh the cells of this level, splitting them into contiguous chunks
+    // when using multiple threads.
+    const int num_cells = cell_ids.size();
+    const int num_chunks = std::max(
+        1, std::min(num_threads, num_cells / kMinCellsPerThread));
+    while (static_cast<int>(weight_fns.size()) < num_chunks) {
+      weight_fns.push_back(weight_fn_factory());
+    }
+    weights.resize(num_cells);
+    if (num_chunks == 1) {
+      for (int i = 0; i < num_cells; ++i) {
+        weights[i] = weight_fns[0](cell_ids[i], error);
         if (!error->ok()) {
           return false;
         }
-
-        if (weight == 0) {
-          // Skip disjoint cells.
-          continue;
-        } else if (weight < 0) {
-          // Get the absolute weight and skip searching the children.
-          weight = -weight;
-        } else {
-          // Add this hilbert range to the ranges to scan at the next level.
-          const S2CellId begin = cell_id.range_min();
-          const S2CellId end = cell_id.range_max().next();
-          if (begin == last_range_end) {
-            // Extend the existing range.
-            next_level_ranges.back().second = end;
-          } else {
-            // Add a new range.
-            next_level_ranges.push_back({begin, end});
+      }
+    } else {
+      vector<S2Error> errors(num_chunks);
+      vector<std::thread> threads;
+      threads.reserve(num_chunks);
+      for (int t = 0; t < num_chunks; ++t) {
+        const int begin = static_cast<int64>(num_cells) * t / num_chunks;
+        const int end = static_cast<int64>(num_cells) * (t + 1) / num_chunks;
+        threads.emplace_back([&, t, begin, end] {
+          for (int i = begin; i < end; ++i) {
+            weights[i] = weight_fns[t](cell_ids[i], &errors[t]);
+            if (!errors[t].ok()) return;
           }
-          last_range_end = end;
+        });
+      }
+      for (std::thread& thread : threads) thread.join();
+      for (const S2Error& chunk_error : errors) {
+        if (!chunk_error.ok()) {
+          *error = chunk_error;
+          return false;
         }
+      }
+    }
 
-        // Save the weight for repacking later and estimate the size it will
-        // consume.
-        ABSL_DCHECK_LE(weight, kMaxWeight)
-            << "CellIdWeightFn produced weight greater than kMaxWeight: "
-            << weight;
-        encoder_.Put(cell_id, std::min(weight, kMaxWeight));
-        size_estimate_bytes += TreeEncoder::EstimateSize(weight);
+    S2CellId last_range_end = S2CellId::Sentinel();
+    for (int i = 0; i < num_cells; ++i) {
+      const S2CellId cell_id = cell_ids[i];
+      // Skip this cell_id unless its weight is larger than 0.
+      int64 weight = weights[i];
+
+      if (weight == 0) {
+        // Skip disjoint cells.
+        continue;
+      } else if (weight < 0) {
+        // Get the absolute weight and skip searching the children.
+        weight = -weight;
+      } else {
+        // Add this hilbert range to the ranges to scan at the next level.
+        const S2CellId begin = cell_id.range_min();
+        const S2CellId end = cell_id.range_max().next();
+        if (begin == last_range_end) {
+          // Extend the existing range.
+          next_level_ranges.back().second = end;
+        } else {
+          // Add a new range.
+          next_level_ranges.push_back({begin, end});
+        }
+        last_range_end = end;
       }
+
+      // Save the weight for repacking later and estimate the size it will
+      // consume.
+      ABSL_DCHECK_LE(weight, kMaxWeight)
+          << "CellIdWeightFn produced weight greater than kMaxWeight: "
+          << weight;
+      encoder_.Put(cell_id, std::min(weight, kMaxWeight));
+      size_estimate_bytes += TreeEncoder::EstimateSize(weight);
     }
 
     ranges = std::move(next_level_ranges);
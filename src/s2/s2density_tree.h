@@ -23,6 +23,7 @@
 #include <array>
 #include <functional>
 #include <limits>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -150,12 +151,26 @@ class S2DensityTree {
                           int64 approximate_size_bytes, int max_level,
                           S2Error* error);
 
+  // Same as above, but the cells of each level of the tree are weighed using
+  // up to 'num_threads' threads.  The resulting tree is identical to the one
+  // built by a single thread.  'weight_fn' must be safe to call concurrently,
+  // and 'index' must not be modified until this method returns.
+  bool InitToShapeDensity(const S2ShapeIndex& index,
+                          const ShapeWeightFunction& weight_fn,
+                          int64 approximate_size_bytes, int max_level,
+                          int num_threads, S2Error* error);
+
   // A wrapper around InitToShapeDensity which uses the number of vertices in
   // each shape to calculate weights.
   bool InitToVertexDensity(const S2ShapeIndex& index,
                            int64 approximate_size_bytes, int max_level,
                            S2Error* error);
 
+  // Same as above, but uses up to 'num_threads' threads.
+  bool InitToVertexDensity(const S2ShapeIndex& index,
+                           int64 approximate_size_bytes, int max_level,
+                           int num_threads, S2Error* error);
+
   // Type definition for a function that returns a pointer to the associated T
   // for a given S2Shape. This function is allowed to return nullptr if the user
   // wishes not to create an association to a given S2Shape.
@@ -185,6 +200,15 @@ class S2DensityTree {
                             int64 approximate_size_bytes, int max_level,
                             S2Error* error);
 
+  // Same as above, but uses up to 'num_threads' threads.  Both functions must
+  // be safe to call concurrently.
+  template <typename T>
+  bool InitToFeatureDensity(const S2ShapeIndex& index,
+                            const FeatureLookupFunction<T>& feature_lookup_fn,
+                            const FeatureWeightFunction<T>& feature_weight_fn,
+                            int64 approximate_size_bytes, int max_level,
+                            int num_threads, S2Error* error);
+
   // Returns a new S2DensityTree that contains the combined weights across the
   // cells the given input trees.  The new tree will be held to the constraints
   // of 'approximate_size_bytes' and 'max_level' which may result in a lossy
@@ -240,6 +264,22 @@ class S2DensityTree {
   std::vector<S2CellUnion> GetPartitioning(int64 max_weight,
                                            S2Error* error) const;
 
+  // Returns a partitioning of the weighted cells of the tree into exactly
+  // 'num_shards' S2CellUnions of approximately equal weight, which can be
+  // passed directly to S2RegionSharder.  Each union covers a contiguous range
+  // of the Hilbert curve, and the unions are disjoint.
+  //
+  // The weight of each union differs from the average by at most the weight
+  // of the largest cell used to build it, which is at most 1/16th of the
+  // average unless the tree lacks detail (see the CAVEAT above).  Unlike
+  // GetPartitioning(), each union is normalized and extended to the largest
+  // cells that do not intersect any other union, so that the unions are as
+  // small as possible.  As a result they may include cells that are not
+  // represented in the tree.  Some unions may be empty if the tree has fewer
+  // cells than 'num_shards'.
+  std::vector<S2CellUnion> GetBalancedPartitioning(int num_shards,
+                                                   S2Error* error) const;
+
   // Returns a fully-decoded map of this tree.  This is only useful if far more
   // lookups will be done than there are entries in the map, and the lookups are
   // sufficiently random that a DecodedPath is not sufficient.  In that case
@@ -432,6 +472,16 @@ class S2DensityTree {
     bool Build(const CellWeightFunction& weight_fn, S2DensityTree* tree,
                S2Error* error) const;
 
+    // Returns a new CellWeightFunction.  Each thread calls the factory once,
+    // so the functions it returns do not need to be thread-safe.
+    using CellWeightFunctionFactory = std::function<CellWeightFunction()>;
+
+    // Same as above, but weighs the cells of each level using up to
+    // 'num_threads' threads.  The resulting tree does not depend on the
+    // number of threads.
+    bool Build(const CellWeightFunctionFactory& weight_fn_factory,
+               int num_threads, S2DensityTree* tree, S2Error* error) const;
+
    private:
     const int64 approximate_size_bytes_;
     const int max_level_;
@@ -442,6 +492,7 @@ class S2DensityTree {
   friend class SumDensityTreesTest;
   friend class TreeEncoderTest;
   friend class Node;
+  friend class S2MutableDensityTree;
 
   // DecodedFaces stores the offsets to each of the face cells encoded in the
   // tree. The index into the array indicates the face cell. A negative offset
@@ -472,19 +523,34 @@ bool S2DensityTree::InitToFeatureDensity(
     const FeatureLookupFunction<T>& feature_lookup_fn,
     const FeatureWeightFunction<T>& feature_weight_fn,
     int64 approximate_size_bytes, int max_level, S2Error* error) {
+  return InitToFeatureDensity(index, feature_lookup_fn, feature_weight_fn,
+                              approximate_size_bytes, max_level,
+                              /*num_threads=*/1, error);
+}
+
+template <typename T>
+bool S2DensityTree::InitToFeatureDensity(
+    const S2ShapeIndex& index,
+    const FeatureLookupFunction<T>& feature_lookup_fn,
+    const FeatureWeightFunction<T>& feature_weight_fn,
+    int64 approximate_size_bytes, int max_level, int num_threads,
+    S2Error* error) {
   ABSL_DCHECK(error != nullptr) << "error must be non-nullptr";
   error->Clear();
 
-  FeatureCellWeightFunction<T> index_cell_weight_fn(&index, feature_lookup_fn,
-                                                    feature_weight_fn);
-
   TreeEncoder encoder;
   BreadthFirstTreeBuilder builder(approximate_size_bytes, max_level, encoder);
   return builder.Build(
-      [&](const S2CellId cell_id, S2Error* error) {
-        return index_cell_weight_fn.WeighCell(cell_id, error);
+      [&]() -> BreadthFirstTreeBuilder::CellWeightFunction {
+        // Each thread gets its own S2ShapeIndexRegion.
+        auto index_cell_weight_fn =
+            std::make_shared<FeatureCellWeightFunction<T>>(
+                &index, feature_lookup_fn, feature_weight_fn);
+        return [index_cell_weight_fn](const S2CellId cell_id, S2Error* error) {
+          return index_cell_weight_fn->WeighCell(cell_id, error);
+        };
       },
-      this, error);
+      num_threads, this, error);
 }
 
 template <typename T>
@@ -34,6 +34,7 @@
 #include "absl/random/random.h"
 #include "s2/util/coding/coder.h"
 #include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
 #include "s2/s2cap.h"
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
@@ -49,6 +50,7 @@
 #include "s2/s2point.h"
 #include "s2/s2point_vector_shape.h"
 #include "s2/s2region_coverer.h"
+#include "s2/s2region_sharder.h"
 #include "s2/s2shape.h"
 #include "s2/s2shape_index_region.h"
 #include "s2/s2testing.h"
@@ -430,6 +432,36 @@ TEST(S2DensityTreeTest, InitToFeatureDensity) {
                           testing::Pair(S2CellId(q).parent(1), 1)));
 }
 
+TEST(S2DensityTreeTest, ParallelBuildMatchesSerial) {
+  S2Testing::rnd.Reset(1);
+  MutableS2ShapeIndex index;
+  for (int i = 0; i < 2000; ++i) {
+    index.Add(make_unique<S2PointVectorShape>(
+        vector<S2Point>{S2Testing::RandomPoint()}));
+  }
+  index.Add(make_unique<S2LaxPolygonShape>(
+      vector<vector<S2Point>>{S2Testing::MakeRegularPoints(
+          S2Testing::RandomPoint(), S1Angle::Degrees(10), 100)}));
+
+  S2Error error;
+  S2DensityTree serial;
+  ASSERT_TRUE(serial.InitToVertexDensity(index, 50'000, 20, &error)) << error;
+  Encoder encoder;
+  serial.Encode(&encoder);
+  const std::string expected(encoder.base(), encoder.length());
+
+  for (int num_threads : {2, 4, 7}) {
+    S2DensityTree parallel;
+    ASSERT_TRUE(
+        parallel.InitToVertexDensity(index, 50'000, 20, num_threads, &error))
+        << error;
+    encoder.clear();
+    parallel.Encode(&encoder);
+    EXPECT_EQ(expected, std::string(encoder.base(), encoder.length()))
+        << num_threads;
+  }
+}
+
 class DecodedPathTest : public TreeEncoderTest {};
 
 TEST_F(DecodedPathTest, DecoderScalesWeightsBasedOnParent) {
@@ -631,6 +663,83 @@ TEST_F(GetPartitioningTest, OversizeCells) {
   }
 }
 
+TEST(GetBalancedPartitioningTest, InvalidNumShards) {
+  S2DensityTree tree;
+  S2Error error;
+  EXPECT_TRUE(tree.GetBalancedPartitioning(0, &error).empty());
+  EXPECT_EQ(S2Error::INVALID_ARGUMENT, error.code());
+}
+
+TEST_F(GetPartitioningTest, BalancedPartitioningWithTooFewCells) {
+  absl::btree_map<S2CellId, int64> base{
+      {S2CellId::FromFacePosLevel(3, 0, 10), 1000},
+  };
+  for (const auto& weighted_cell : SumToRoot(base)) {
+    Put(weighted_cell.first, weighted_cell.second);
+  }
+  auto tree = BuildTree();
+
+  S2Error error;
+  vector<S2CellUnion> partitioning = tree.GetBalancedPartitioning(3, &error);
+  ASSERT_TRUE(error.ok()) << error;
+
+  // The single leaf cell is assigned to the middle shard, and since there are
+  // no other weighted cells it is replaced by its face.
+  ASSERT_EQ(3, partitioning.size());
+  EXPECT_TRUE(partitioning[0].empty());
+  EXPECT_EQ(S2CellUnion({S2CellId::FromFace(3)}), partitioning[1]);
+  EXPECT_TRUE(partitioning[2].empty());
+}
+
+TEST(GetBalancedPartitioningTest, ShardsAreBalancedAndDisjoint) {
+  S2Testing::rnd.Reset(2);
+  MutableS2ShapeIndex index;
+  vector<S2Point> points;
+  // Use a mix of uniformly distributed and clustered points.
+  for (int i = 0; i < 5000; ++i) {
+    points.push_back(S2Testing::RandomPoint());
+  }
+  const S2Cap cluster(S2Testing::RandomPoint(), S1Angle::Degrees(5));
+  for (int i = 0; i < 5000; ++i) {
+    points.push_back(S2Testing::SamplePoint(cluster));
+  }
+  for (const S2Point& point : points) {
+    index.Add(make_unique<S2PointVectorShape>(vector<S2Point>{point}));
+  }
+
+  S2Error error;
+  S2DensityTree tree;
+  ASSERT_TRUE(tree.InitToVertexDensity(index, 200'000, 30, 4, &error))
+      << error;
+
+  constexpr int kNumShards = 10;
+  vector<S2CellUnion> partitioning =
+      tree.GetBalancedPartitioning(kNumShards, &error);
+  ASSERT_TRUE(error.ok()) << error;
+  ASSERT_EQ(kNumShards, partitioning.size());
+
+  for (int i = 0; i < kNumShards; ++i) {
+    EXPECT_TRUE(partitioning[i].IsNormalized());
+    for (int j = i + 1; j < kNumShards; ++j) {
+      EXPECT_FALSE(partitioning[i].Intersects(partitioning[j])) << i << j;
+    }
+  }
+
+  // Every point belongs to exactly one shard, and each shard has roughly the
+  // same number of points.
+  S2RegionSharder sharder(partitioning);
+  vector<int> counts(kNumShards);
+  for (const S2Point& point : points) {
+    const int shard = sharder.GetContainingShard(point, -1);
+    ASSERT_GE(shard, 0);
+    ++counts[shard];
+  }
+  const int average = points.size() / kNumShards;
+  for (int count : counts) {
+    EXPECT_NEAR(average, count, average / 4);
+  }
+}
+
 class SumDensityTreesTest : public ::testing::TestWithParam<bool> {
  public:
   SumDensityTreesTest() = default;
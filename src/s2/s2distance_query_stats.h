@@ -0,0 +1,109 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2DISTANCE_QUERY_STATS_H_
+#define S2_S2DISTANCE_QUERY_STATS_H_
+
+#include <chrono>
+
+#include "s2/base/types.h"
+#include "absl/functional/function_ref.h"
+#include "absl/strings/string_view.h"
+
+// Statistics about the work done by a distance query (S2ClosestEdgeQuery,
+// S2ClosestPointQuery, S2ClosestCellQuery, and the corresponding "furthest"
+// queries), intended for finding out why some queries are much slower than
+// others.  Statistics are only recorded when the query's record_stats()
+// option is true, and are then available from last_query_stats().
+//
+// The counters are additive, so statistics from many queries can be
+// accumulated using operator+=.  VisitCounters() can be used to export them,
+// for example:
+//
+//   query.mutable_options()->set_record_stats(true);
+//   query.FindClosestEdges(&target, &results);
+//   query.last_query_stats().VisitCounters(
+//       [&](absl::string_view name, int64 value) {
+//         metrics->Record(name, value);
+//       });
+struct S2DistanceQueryStats {
+  // The number of queries that these statistics describe, the number of
+  // those queries that examined every indexed item (the "brute force"
+  // algorithm) rather than using the index, and the number that stopped
+  // early because they reached a work limit (see max_visited_cells() in the
+  // query options).
+  int64 num_queries = 0;
+  int64 num_brute_force_queries = 0;
+  int64 num_approximate_queries = 0;
+
+  // The number of cells added to and removed from the priority queue, and
+  // the number of removed cells that were then subdivided or processed.
+  // (The last cell removed may be discarded because it is too far away.)
+  int64 num_queue_pushes = 0;
+  int64 num_queue_pops = 0;
+  int64 num_visited_cells = 0;
+
+  // The number of indexed edges, points, or cells whose distance to the
+  // target was computed.
+  int64 num_distance_tests = 0;
+
+  // The wall time spent setting up each query before searching the index,
+  // which includes target-specific work such as finding the indexed shapes
+  // that contain the target when include_interiors() is true, and the total
+  // wall time of each query.
+  std::chrono::nanoseconds setup_time{0};
+  std::chrono::nanoseconds elapsed{0};
+
+  S2DistanceQueryStats& operator+=(const S2DistanceQueryStats& other);
+
+  // Calls "visitor(name, value)" for each statistic above, where "name" is
+  // the field name without any "num_" prefix.  Times are reported in
+  // nanoseconds.
+  void VisitCounters(
+      absl::FunctionRef<void(absl::string_view, int64)> visitor) const;
+};
+
+
+//////////////////   Implementation details follow   ////////////////////
+
+
+inline S2DistanceQueryStats& S2DistanceQueryStats::operator+=(
+    const S2DistanceQueryStats& other) {
+  num_queries += other.num_queries;
+  num_brute_force_queries += other.num_brute_force_queries;
+  num_approximate_queries += other.num_approximate_queries;
+  num_queue_pushes += other.num_queue_pushes;
+  num_queue_pops += other.num_queue_pops;
+  num_visited_cells += other.num_visited_cells;
+  num_distance_tests += other.num_distance_tests;
+  setup_time += other.setup_time;
+  elapsed += other.elapsed;
+  return *this;
+}
+
+inline void S2DistanceQueryStats::VisitCounters(
+    absl::FunctionRef<void(absl::string_view, int64)> visitor) const {
+  visitor("queries", num_queries);
+  visitor("brute_force_queries", num_brute_force_queries);
+  visitor("approximate_queries", num_approximate_queries);
+  visitor("queue_pushes", num_queue_pushes);
+  visitor("queue_pops", num_queue_pops);
+  visitor("visited_cells", num_visited_cells);
+  visitor("distance_tests", num_distance_tests);
+  visitor("setup_time", setup_time.count());
+  visitor("elapsed", elapsed.count());
+}
+
+#endif  // S2_S2DISTANCE_QUERY_STATS_H_
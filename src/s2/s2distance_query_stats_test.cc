@@ -0,0 +1,66 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2distance_query_stats.h"
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/strings/string_view.h"
+#include "s2/base/types.h"
+
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace {
+
+TEST(S2DistanceQueryStats, AddAndVisitCounters) {
+  S2DistanceQueryStats a, b;
+  a.num_queries = 1;
+  a.num_brute_force_queries = 1;
+  a.num_distance_tests = 10;
+  a.elapsed = std::chrono::nanoseconds(100);
+  b.num_queries = 1;
+  b.num_approximate_queries = 1;
+  b.num_queue_pushes = 5;
+  b.num_queue_pops = 4;
+  b.num_visited_cells = 3;
+  b.num_distance_tests = 20;
+  b.setup_time = std::chrono::nanoseconds(7);
+  b.elapsed = std::chrono::nanoseconds(50);
+  a += b;
+
+  vector<pair<string, int64>> counters;
+  a.VisitCounters([&](absl::string_view name, int64 value) {
+    counters.emplace_back(string(name), value);
+  });
+  EXPECT_EQ(counters, (vector<pair<string, int64>>{
+                          {"queries", 2},
+                          {"brute_force_queries", 1},
+                          {"approximate_queries", 1},
+                          {"queue_pushes", 5},
+                          {"queue_pops", 4},
+                          {"visited_cells", 3},
+                          {"distance_tests", 30},
+                          {"setup_time", 7},
+                          {"elapsed", 150},
+                      }));
+}
+
+}  // namespace
@@ -19,11 +19,14 @@
 #define S2_S2DISTANCE_TARGET_H_
 
 #include <functional>
+#include <vector>
 
 #include "absl/functional/function_ref.h"
+#include "absl/types/span.h"
 #include "s2/s2cap.h"
 #include "s2/s2cell.h"
 #include "s2/s2point.h"
+#include "s2/s2predicates.h"
 #include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
 
@@ -165,6 +168,65 @@ class S2DistanceTarget {
   // the default implementation which simply returns false.)
   virtual bool set_max_error(const Delta& max_error) { return false; }
 
+  // Optionally appends to "candidates" a subset of "edge_ids" (a set of edge
+  // ids of "shape") that includes every edge for which UpdateMinDistance()
+  // might return true when called with "min_dist".  Since "min_dist" only
+  // decreases as a query progresses, the remaining edges can be skipped.
+  // This allows targets to reject many edges at once more cheaply than by
+  // calling UpdateMinDistance() on each one.
+  //
+  // Returns false (without modifying "candidates") if the target does not
+  // implement this method, in which case every edge must be tested.  (This
+  // is what the default implementation does.)
+  virtual bool GetEdgeCandidates(const S2Shape& shape,
+                                 absl::Span<const int> edge_ids,
+                                 const Distance& min_dist,
+                                 std::vector<int>* candidates) {
+    return false;
+  }
+
+  // Like GetEdgeCandidates(), but appends the positions within "points" of
+  // every point for which UpdateMinDistance() might return true when called
+  // with "min_dist".  Returns false if the target does not implement this
+  // method (which is what the default implementation does).
+  virtual bool GetPointCandidates(const s2pred::PointArrays& points,
+                                  const Distance& min_dist,
+                                  std::vector<int>* candidates) {
+    return false;
+  }
+
+  // Optionally sets "distances[k]" to the distance from this target to child
+  // "k" of "cell" (in the order returned by S2Cell::Subdivide), i.e. to the
+  // distance that UpdateMinDistance() would compute for that child.  This
+  // allows targets to share work between the children of a cell, which
+  // queries typically process together when they subdivide it.
+  //
+  // Returns false (without modifying "distances") if the target does not
+  // implement this method, in which case the distance to each child must be
+  // computed separately.  (This is what the default implementation does.)
+  //
+  // REQUIRES: !cell.is_leaf()
+  virtual bool GetChildCellDistances(const S2Cell& cell,
+                                     Distance distances[4]) {
+    return false;
+  }
+
+  // Finds the edge of "index" that is closest to this target, for targets
+  // that can do this faster than S2ClosestEdgeQuery itself (for example, by
+  // traversing their own index together with "index").  Only edges closer
+  // than "*min_dist" are considered; if one is found, this method sets
+  // "*min_dist", "*shape_id", and "*edge_id" accordingly.  As with
+  // UpdateMinDistance(), the result may be suboptimal by up to the error
+  // passed to set_max_error().
+  //
+  // Returns false (without modifying any arguments) if the target does not
+  // implement this method, in which case the caller must use its usual
+  // algorithm.  (This is what the default implementation does.)
+  virtual bool FindClosestEdge(const S2ShapeIndex& index, Distance* min_dist,
+                               int* shape_id, int* edge_id) {
+    return false;
+  }
+
   // The following method is provided as a convenience for classes that
   // compute distances to a collection of indexed geometry, such as
   // S2ClosestPointQuery, S2ClosestEdgeQuery, and S2ClosestCellQuery.  It
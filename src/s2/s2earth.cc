@@ -19,8 +19,14 @@
 
 #include <algorithm>
 
+#include "absl/log/absl_check.h"
+#include "absl/types/span.h"
 #include "s2/s1angle.h"
 #include "s2/s2latlng.h"
+#include "s2/s2point.h"
+#include "s2/s2point_span.h"
+
+using absl::Span;
 
 namespace {
 
@@ -54,3 +60,56 @@ S1Angle S2Earth::GetInitialBearing(const S2LatLng& a, const S2LatLng& b) {
   const double y = sin(lng_diff) * cosLat2;
   return S1Angle::Radians(atan2(y, x));
 }
+
+void S2Earth::GetDistancesMeters(const S2Point& a, S2PointSpan b,
+                                 Span<double> meters) {
+  ABSL_DCHECK_EQ(b.size(), meters.size());
+  // The cross and dot products are computed for a block of points at a time
+  // in a loop without library calls, followed by a loop of atan2() calls.
+  // The arithmetic is the same as in S2Point::Angle().
+  constexpr size_t kBlockSize = 256;
+  double dot[kBlockSize];
+  const double a0 = a[0], a1 = a[1], a2 = a[2];
+  for (size_t begin = 0; begin < b.size(); begin += kBlockSize) {
+    const size_t n = std::min(kBlockSize, b.size() - begin);
+    const S2Point* q = b.data() + begin;
+    double* out = meters.data() + begin;
+    for (size_t i = 0; i < n; ++i) {
+      const double c0 = a1 * q[i][2] - a2 * q[i][1];
+      const double c1 = a2 * q[i][0] - a0 * q[i][2];
+      const double c2 = a0 * q[i][1] - a1 * q[i][0];
+      out[i] = sqrt(0.0 + c0 * c0 + c1 * c1 + c2 * c2);
+      dot[i] = 0.0 + a0 * q[i][0] + a1 * q[i][1] + a2 * q[i][2];
+    }
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = RadiansToMeters(atan2(out[i], dot[i]));
+    }
+  }
+}
+
+void S2Earth::GetDistancesMeters(const S2LatLng& a,
+                                 Span<const double> lat_radians,
+                                 Span<const double> lng_radians,
+                                 Span<double> meters) {
+  ABSL_DCHECK_EQ(lat_radians.size(), lng_radians.size());
+  ABSL_DCHECK_EQ(lat_radians.size(), meters.size());
+  // This is S2LatLng::GetDistance() with cos(lat1) hoisted out of the loop.
+  const double lat1 = a.lat().radians();
+  const double lng1 = a.lng().radians();
+  const double cos_lat1 = cos(lat1);
+  for (size_t i = 0; i < meters.size(); ++i) {
+    const double lat2 = lat_radians[i];
+    const double dlat = sin(0.5 * (lat2 - lat1));
+    const double dlng = sin(0.5 * (lng_radians[i] - lng1));
+    const double x = dlat * dlat + dlng * dlng * cos_lat1 * cos(lat2);
+    meters[i] = ToMeters(S1Angle::Radians(2 * asin(sqrt(std::min(1.0, x)))));
+  }
+}
+
+void S2Earth::GetDistanceMatrixMeters(S2PointSpan a, S2PointSpan b,
+                                      Span<double> meters) {
+  ABSL_DCHECK_EQ(a.size() * b.size(), meters.size());
+  for (size_t i = 0; i < a.size(); ++i) {
+    GetDistancesMeters(a[i], b, meters.subspan(i * b.size(), b.size()));
+  }
+}
@@ -21,10 +21,12 @@
 #ifndef S2_S2EARTH_H_
 #define S2_S2EARTH_H_
 
+#include "absl/types/span.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s2latlng.h"
 #include "s2/s2point.h"
+#include "s2/s2point_span.h"
 #include "s2/util/units/length-units.h"
 
 class S2Earth {
@@ -105,6 +107,28 @@ class S2Earth {
   static inline double GetDistanceKm(const S2Point& a, const S2Point& b);
   static inline double GetDistanceKm(const S2LatLng& a, const S2LatLng& b);
 
+  // Batch versions of GetDistanceMeters() that compute the distance from "a"
+  // to every point of "b" and store the results in "meters" (which must have
+  // the same size as "b").  The results are identical to calling
+  // GetDistanceMeters(a, b[i]) for each point, but the cross and dot
+  // products are computed in a separate loop that the compiler can vectorize.
+  static void GetDistancesMeters(const S2Point& a, S2PointSpan b,
+                                 absl::Span<double> meters);
+
+  // Like the above, but with "b" given as separate arrays of latitudes and
+  // longitudes in radians.  The results are identical to calling
+  // GetDistanceMeters(a, S2LatLng::FromRadians(lat[i], lng[i])), except that
+  // the terms that depend only on "a" are computed once.
+  static void GetDistancesMeters(const S2LatLng& a,
+                                 absl::Span<const double> lat_radians,
+                                 absl::Span<const double> lng_radians,
+                                 absl::Span<double> meters);
+
+  // Sets meters[i * b.size() + j] to GetDistanceMeters(a[i], b[j]) for all
+  // points in "a" and "b".  "meters" must have size a.size() * b.size().
+  static void GetDistanceMatrixMeters(S2PointSpan a, S2PointSpan b,
+                                      absl::Span<double> meters);
+
   // CAVEAT: These versions are not as accurate because util::units::Meters
   // uses "float" rather than "double" as the underlying representation.
   static inline util::units::Meters GetDistance(const S2Point& a,
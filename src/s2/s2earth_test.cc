@@ -19,12 +19,15 @@
 
 #include <cmath>
 #include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
+#include "absl/types/span.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s2latlng.h"
 #include "s2/s2point.h"
+#include "s2/s2testing.h"
 #include "s2/util/units/length-units.h"
 #include "s2/util/units/physical-units.h"
 
@@ -164,3 +167,43 @@ TEST(S2EarthTest, TestGetDistance) {
                                               S2LatLng::FromDegrees(55, -153)),
                    1000 * S2Earth::RadiusKm() * M_PI / 4);
 }
+
+TEST(S2EarthTest, TestGetDistancesMeters) {
+  // Include some antipodal and identical points along with random ones.
+  S2Point a = S2Testing::RandomPoint();
+  std::vector<S2Point> points = {a, -a, S2Point(0, 0, 1)};
+  for (int i = 0; i < 1000; ++i) points.push_back(S2Testing::RandomPoint());
+
+  std::vector<double> meters(points.size());
+  S2Earth::GetDistancesMeters(a, points, absl::MakeSpan(meters));
+  for (int i = 0; i < points.size(); ++i) {
+    EXPECT_EQ(S2Earth::GetDistanceMeters(a, points[i]), meters[i]);
+  }
+
+  S2LatLng a_ll(a);
+  std::vector<double> lats, lngs;
+  for (const S2Point& p : points) {
+    lats.push_back(S2LatLng::Latitude(p).radians());
+    lngs.push_back(S2LatLng::Longitude(p).radians());
+  }
+  S2Earth::GetDistancesMeters(a_ll, lats, lngs, absl::MakeSpan(meters));
+  for (int i = 0; i < points.size(); ++i) {
+    EXPECT_EQ(S2Earth::GetDistanceMeters(
+                  a_ll, S2LatLng::FromRadians(lats[i], lngs[i])),
+              meters[i]);
+  }
+}
+
+TEST(S2EarthTest, TestGetDistanceMatrixMeters) {
+  std::vector<S2Point> a, b;
+  for (int i = 0; i < 7; ++i) a.push_back(S2Testing::RandomPoint());
+  for (int i = 0; i < 300; ++i) b.push_back(S2Testing::RandomPoint());
+  std::vector<double> meters(a.size() * b.size());
+  S2Earth::GetDistanceMatrixMeters(a, b, absl::MakeSpan(meters));
+  for (int i = 0; i < a.size(); ++i) {
+    for (int j = 0; j < b.size(); ++j) {
+      EXPECT_EQ(S2Earth::GetDistanceMeters(a[i], b[j]),
+                meters[i * b.size() + j]);
+    }
+  }
+}
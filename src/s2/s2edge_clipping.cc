@@ -22,12 +22,14 @@
 #include <cmath>
 
 #include "absl/log/absl_check.h"
+#include "absl/types/span.h"
 #include "s2/r1interval.h"
 #include "s2/r2.h"
 #include "s2/r2rect.h"
 #include "s2/s2coords.h"
 #include "s2/s2edge_crossings.h"
 #include "s2/s2point.h"
+#include "s2/s2point_span.h"
 #include "s2/s2pointutil.h"
 
 namespace S2 {
@@ -203,16 +205,67 @@ static int GetNextFace(int face, const R2Point& exit, int axis,
   return S2::GetUVWFace(face, axis, exit[axis] > 0);
 }
 
+namespace {
+
+// The coordinate mapping used by ValidFaceXYZtoUV for each face, i.e.
+// u = u_sign * p[u_axis] / p[w_axis] and v = v_sign * p[v_axis] / p[w_axis].
+struct FaceAxes {
+  int u_axis, v_axis, w_axis;
+  double u_sign, v_sign;
+};
+constexpr FaceAxes kFaceAxes[6] = {
+  {1, 2, 0,  1,  1},
+  {0, 2, 1, -1,  1},
+  {0, 1, 2, -1, -1},
+  {2, 1, 0,  1,  1},
+  {2, 0, 1,  1, -1},
+  {1, 0, 2, -1, -1},
+};
+
+}  // namespace
+
+void GetFaceUVPoints(S2PointSpan points, absl::Span<FaceUVPoint> result) {
+  ABSL_DCHECK_EQ(points.size(), result.size());
+  const size_t n = points.size();
+  for (size_t i = 0; i < n; ++i) result[i].face = S2::GetFace(points[i]);
+
+  // Convert each run of points on the same face using that face's coordinate
+  // mapping.  Hoisting the mapping out of the loop removes the per-point
+  // branch and lets the compiler vectorize the divisions.  Multiplying by
+  // the sign is exact, so the results match ValidFaceXYZtoUV() bit for bit.
+  for (size_t begin = 0; begin < n;) {
+    const int face = result[begin].face;
+    size_t end = begin + 1;
+    while (end < n && result[end].face == face) ++end;
+    const FaceAxes& axes = kFaceAxes[face];
+    for (size_t i = begin; i < end; ++i) {
+      const S2Point& p = points[i];
+      const double w = p[axes.w_axis];
+      result[i].uv = R2Point(axes.u_sign * (p[axes.u_axis] / w),
+                             axes.v_sign * (p[axes.v_axis] / w));
+    }
+    begin = end;
+  }
+}
+
 void GetFaceSegments(const S2Point& a, const S2Point& b,
                      FaceSegmentVector* segments) {
+  GetFaceSegments(a, b, GetFaceUVPoint(a), GetFaceUVPoint(b), segments);
+}
+
+void GetFaceSegments(const S2Point& a, const S2Point& b,
+                     const FaceUVPoint& a_fuv, const FaceUVPoint& b_fuv,
+                     FaceSegmentVector* segments) {
   ABSL_DCHECK(S2::IsUnitLength(a));
   ABSL_DCHECK(S2::IsUnitLength(b));
   segments->clear();
 
   // Fast path: both endpoints are on the same face.
   FaceSegment segment;
-  int a_face = S2::XYZtoFaceUV(a, &segment.a);
-  int b_face = S2::XYZtoFaceUV(b, &segment.b);
+  int a_face = a_fuv.face;
+  int b_face = b_fuv.face;
+  segment.a = a_fuv.uv;
+  segment.b = b_fuv.uv;
   if (a_face == b_face) {
     segment.face = a_face;
     segments->push_back(segment);
@@ -320,15 +373,12 @@ static int ClipDestination(
   return score;
 }
 
-bool ClipToPaddedFace(const S2Point& a_xyz, const S2Point& b_xyz, int face,
-                      double padding, R2Point* a_uv, R2Point* b_uv) {
-  ABSL_DCHECK_GE(padding, 0);
-  // Fast path: both endpoints are on the given face.
-  if (S2::GetFace(a_xyz) == face && S2::GetFace(b_xyz) == face) {
-    S2::ValidFaceXYZtoUV(face, a_xyz, a_uv);
-    S2::ValidFaceXYZtoUV(face, b_xyz, b_uv);
-    return true;
-  }
+// Clips AB to the given padded face.  This is the general case of
+// ClipToPaddedFace, used when at least one endpoint is on a different face.
+static bool ClipToPaddedFaceGeneral(const S2Point& a_xyz,
+                                    const S2Point& b_xyz, int face,
+                                    double padding, R2Point* a_uv,
+                                    R2Point* b_uv) {
   // Convert everything into the (u,v,w) coordinates of the given face.  Note
   // that the cross product *must* be computed in the original (x,y,z)
   // coordinate system because RobustCrossProd (unlike the mathematical cross
@@ -361,6 +411,31 @@ bool ClipToPaddedFace(const S2Point& a_xyz, const S2Point& b_xyz, int face,
   return a_score + b_score < 3;
 }
 
+bool ClipToPaddedFace(const S2Point& a_xyz, const S2Point& b_xyz, int face,
+                      double padding, R2Point* a_uv, R2Point* b_uv) {
+  ABSL_DCHECK_GE(padding, 0);
+  // Fast path: both endpoints are on the given face.
+  if (S2::GetFace(a_xyz) == face && S2::GetFace(b_xyz) == face) {
+    S2::ValidFaceXYZtoUV(face, a_xyz, a_uv);
+    S2::ValidFaceXYZtoUV(face, b_xyz, b_uv);
+    return true;
+  }
+  return ClipToPaddedFaceGeneral(a_xyz, b_xyz, face, padding, a_uv, b_uv);
+}
+
+bool ClipToPaddedFace(const S2Point& a_xyz, const S2Point& b_xyz,
+                      const FaceUVPoint& a_fuv, const FaceUVPoint& b_fuv,
+                      int face, double padding, R2Point* a_uv, R2Point* b_uv) {
+  ABSL_DCHECK_GE(padding, 0);
+  // Fast path: both endpoints are on the given face.
+  if (a_fuv.face == face && b_fuv.face == face) {
+    *a_uv = a_fuv.uv;
+    *b_uv = b_fuv.uv;
+    return true;
+  }
+  return ClipToPaddedFaceGeneral(a_xyz, b_xyz, face, padding, a_uv, b_uv);
+}
+
 bool IntersectsRect(const R2Point& a, const R2Point& b, const R2Rect& rect) {
   // First check whether the bound of AB intersects "rect".
   R2Rect bound = R2Rect::FromPointPair(a, b);
@@ -33,10 +33,13 @@
 
 #include "absl/container/inlined_vector.h"
 #include "absl/log/absl_check.h"
+#include "absl/types/span.h"
 #include "s2/_fp_contract_off.h"
 #include "s2/r2.h"
 #include "s2/r2rect.h"
+#include "s2/s2coords.h"
 #include "s2/s2point.h"
+#include "s2/s2point_span.h"
 
 namespace S2 {
 
@@ -79,6 +82,43 @@ bool ClipToFace(const S2Point& a, const S2Point& b, int face,
 bool ClipToPaddedFace(const S2Point& a, const S2Point& b, int face,
                       double padding, R2Point* a_uv, R2Point* b_uv);
 
+// FaceUVPoint represents a point by the cube face that contains it and its
+// (u,v) coordinates on that face, exactly as returned by S2::XYZtoFaceUV.
+struct FaceUVPoint {
+  int face;
+  R2Point uv;
+};
+
+// Returns the face and (u,v) coordinates of the given point.
+inline FaceUVPoint GetFaceUVPoint(const S2Point& p) {
+  FaceUVPoint result;
+  result.face = S2::XYZtoFaceUV(p, &result.uv);
+  return result;
+}
+
+// Converts every point of "points" to its face and (u,v) coordinates, storing
+// the results in "result" (which must have the same size).  This is
+// equivalent to calling GetFaceUVPoint() on each point, but is faster for
+// chains of vertices since consecutive vertices are usually on the same face
+// and can be converted without dispatching on the face of each point.
+void GetFaceUVPoints(S2PointSpan points, absl::Span<FaceUVPoint> result);
+
+// Like GetFaceSegments(a, b, segments), but takes the face and (u,v)
+// coordinates of the endpoints precomputed by GetFaceUVPoint(s).  This
+// allows the endpoints shared by adjacent edges of a chain to be converted
+// only once.
+void GetFaceSegments(const S2Point& a, const S2Point& b,
+                     const FaceUVPoint& a_fuv, const FaceUVPoint& b_fuv,
+                     FaceSegmentVector* segments);
+
+// Like ClipToPaddedFace(a, b, face, ...), but takes the face and (u,v)
+// coordinates of the endpoints precomputed by GetFaceUVPoint(s).  This is
+// faster when the same edge is clipped to several faces, or when the edges
+// of a chain are clipped one after another.
+bool ClipToPaddedFace(const S2Point& a, const S2Point& b,
+                      const FaceUVPoint& a_fuv, const FaceUVPoint& b_fuv,
+                      int face, double padding, R2Point* a_uv, R2Point* b_uv);
+
 // The maximum error in the vertices returned by GetFaceSegments and
 // ClipToFace (compared to an exact calculation):
 //
@@ -27,6 +27,7 @@
 #include "absl/container/inlined_vector.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "s2/r1interval.h"
 #include "s2/r2.h"
 #include "s2/r2rect.h"
@@ -209,6 +210,56 @@ TEST(S2, FaceClipping) {
   }
 }
 
+TEST(S2, FaceUVPoints) {
+  // Build a chain whose vertices alternate between long runs on one face and
+  // edges that cross cube edges, including points near cube corners.
+  S2Testing::Random* rnd = &S2Testing::rnd;
+  R2Rect biunit(R1Interval(-1, 1), R1Interval(-1, 1));
+  vector<S2Point> points;
+  for (int i = 0; i < 500; ++i) {
+    if (rnd->OneIn(3)) {
+      int face = rnd->Uniform(6);
+      S2Point p = S2::FaceUVtoXYZ(face, biunit.GetVertex(rnd->Uniform(4)));
+      S2Point q = S2::FaceUVtoXYZ(face, biunit.GetVertex(rnd->Uniform(4)));
+      points.push_back(PerturbedCornerOrMidpoint(p, q));
+    } else {
+      points.push_back(S2Testing::RandomPoint());
+    }
+  }
+  vector<S2::FaceUVPoint> fuvs(points.size());
+  S2::GetFaceUVPoints(points, absl::MakeSpan(fuvs));
+  for (int i = 0; i < points.size(); ++i) {
+    R2Point uv;
+    EXPECT_EQ(S2::XYZtoFaceUV(points[i], &uv), fuvs[i].face);
+    EXPECT_EQ(uv, fuvs[i].uv);
+  }
+
+  // The overloads that take precomputed endpoints must match the originals.
+  for (int i = 0; i + 1 < points.size(); ++i) {
+    const S2Point& a = points[i];
+    const S2Point& b = points[i + 1];
+    S2::FaceSegmentVector expected, actual;
+    S2::GetFaceSegments(a, b, &expected);
+    S2::GetFaceSegments(a, b, fuvs[i], fuvs[i + 1], &actual);
+    ASSERT_EQ(expected.size(), actual.size());
+    for (int k = 0; k < expected.size(); ++k) {
+      EXPECT_EQ(expected[k].face, actual[k].face);
+      EXPECT_EQ(expected[k].a, actual[k].a);
+      EXPECT_EQ(expected[k].b, actual[k].b);
+    }
+    for (int face = 0; face < 6; ++face) {
+      R2Point a_uv, b_uv, a_uv2, b_uv2;
+      bool clipped = S2::ClipToPaddedFace(a, b, face, 1e-10, &a_uv, &b_uv);
+      ASSERT_EQ(clipped, S2::ClipToPaddedFace(a, b, fuvs[i], fuvs[i + 1], face,
+                                              1e-10, &a_uv2, &b_uv2));
+      if (clipped) {
+        EXPECT_EQ(a_uv, a_uv2);
+        EXPECT_EQ(b_uv, b_uv2);
+      }
+    }
+  }
+}
+
 // Choose a random point in the rectangle defined by points A and B, sometimes
 // returning a point on the edge AB or the points A and B themselves.
 R2Point ChooseRectPoint(const R2Point& a, const R2Point& b) {
@@ -18,6 +18,8 @@
 #ifndef S2_S2EDGE_CROSSER_H_
 #define S2_S2EDGE_CROSSER_H_
 
+#include <cfloat>
+
 #include "absl/log/absl_check.h"
 #include "s2/_fp_contract_off.h"
 #include "s2/s2edge_crossings.h"
@@ -178,6 +180,16 @@ class S2EdgeCrosserBase {
   // return value is undefined.
   int last_interior_crossing_sign() const;
 
+  // Returns true if CrossingSign(c, d) is certain to return -1 (i.e., the
+  // edges do not cross or share a vertex), given the vertices C and D
+  // rounded to single precision (see S2IndexEdgeCache::FloatEdge).  Returns
+  // false if the result is uncertain, in which case the edge should be
+  // tested using the methods above.  This test is only conclusive when C and
+  // D are strictly on the same side of the great circle through AB, but this
+  // is by far the most common case when testing many edges.  It does not
+  // affect the current vertex chain.
+  bool IsDefinitelyNotCrossing(const Vector3_f& c, const Vector3_f& d);
+
   ///////////////////////// Edge Chain Methods ///////////////////////////
   //
   // You don't need to use these unless you're trying to squeeze out every
@@ -260,6 +272,10 @@ class S2EdgeCrosserBase {
   PointRep b_;
   Vector3_d a_cross_b_;
 
+  // The maximum error in (AxB).C when C is rounded to single precision, or
+  // -1 if not computed yet (see IsDefinitelyNotCrossing).
+  double float_det_error_ = -1;
+
   // To reduce the number of calls to s2pred::ExpensiveSign(), we compute an
   // outward-facing tangent at A and B if necessary.  If the plane
   // perpendicular to one of these tangents separates AB from CD (i.e., one
@@ -314,6 +330,7 @@ inline void S2EdgeCrosserBase<PointRep>::Init(ArgType a, ArgType b) {
   a_ = a;
   b_ = b;
   a_cross_b_ = a_->CrossProd(*b_);
+  float_det_error_ = -1;
   have_tangents_ = false;
   c_ = PointRep();
 }
@@ -346,6 +363,26 @@ inline int S2EdgeCrosserBase<PointRep>::last_interior_crossing_sign() const {
   return acb_;
 }
 
+template <class PointRep>
+inline bool S2EdgeCrosserBase<PointRep>::IsDefinitelyNotCrossing(
+    const Vector3_f& c, const Vector3_f& d) {
+  if (float_det_error_ < 0) {
+    // Rounding the coordinates of a unit-length vector to single precision
+    // moves it by at most 2**-24, which changes (AxB).C by at most
+    // |AxB| * 2**-24.  The remaining error is the same as for a
+    // double-precision C (see s2pred::TriageSign), and 6e-8 rather than
+    // 2**-24 allows for vectors that are not exactly unit length.
+    constexpr double kMaxDetError = 3.6548 * DBL_EPSILON;
+    float_det_error_ = kMaxDetError + 6e-8 * a_cross_b_.Norm();
+  }
+  const double acb = a_cross_b_[0] * c[0] + a_cross_b_[1] * c[1] +
+                     a_cross_b_[2] * c[2];
+  const double abd = a_cross_b_[0] * d[0] + a_cross_b_[1] * d[1] +
+                     a_cross_b_[2] * d[2];
+  return (acb > float_det_error_ && abd > float_det_error_) ||
+         (acb < -float_det_error_ && abd < -float_det_error_);
+}
+
 template <class PointRep>
 inline S2EdgeCrosserBase<PointRep>::S2EdgeCrosserBase(
     ArgType a, ArgType b, ArgType c)
@@ -0,0 +1,112 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Benchmarks for S2EdgeCrosser.
+
+#include "s2/s2edge_crosser.h"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "absl/types/span.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2edge_crossings.h"
+#include "s2/s2fractal.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2predicates.h"
+#include "s2/s2testing.h"
+
+using std::vector;
+
+namespace {
+
+// Returns "num_points" random points within a small cap, so that many of the
+// edges formed by consecutive points cross each other.
+vector<S2Point> MakeRandomPoints(int num_points) {
+  S2Testing::rnd.Reset(1);
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+  vector<S2Point> points;
+  for (int i = 0; i < num_points; ++i) {
+    points.push_back(S2Testing::SamplePoint(cap));
+  }
+  return points;
+}
+
+// Tests a fixed edge against a sequence of edges with random endpoints
+// (i.e., without chaining).
+void BM_CrossingSign(benchmark::State& state) {
+  vector<S2Point> points = MakeRandomPoints(2048);
+  S2EdgeCrosser crosser(&points[0], &points[1]);
+  int i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        crosser.CrossingSign(&points[i], &points[i + 1]));
+    i = (i + 2) & 2047;
+  }
+}
+BENCHMARK(BM_CrossingSign);
+
+// Tests a fixed edge against the edges of a fractal loop using the chained
+// interface, which is the common case when testing against a shape.
+void BM_ChainCrossingSign(benchmark::State& state) {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(state.range(0));
+  auto loop = fractal.MakeLoop(S2Testing::GetRandomFrame(),
+                               S1Angle::Degrees(1));
+  S2Point a = loop->vertex(0), b = loop->vertex(loop->num_vertices() / 2);
+  for (auto _ : state) {
+    S2EdgeCrosser crosser(&a, &b, &loop->vertex(0));
+    int num_crossings = 0;
+    for (int i = 1; i <= loop->num_vertices(); ++i) {
+      num_crossings += crosser.CrossingSign(&loop->vertex(i)) > 0;
+    }
+    benchmark::DoNotOptimize(num_crossings);
+  }
+  state.SetItemsProcessed(state.iterations() * loop->num_vertices());
+}
+BENCHMARK(BM_ChainCrossingSign)->Range(1 << 8, 1 << 14);
+
+// Like BM_ChainCrossingSign, but uses S2::BatchCrossingSign() with the loop
+// edges stored in structure-of-arrays layout.
+void BM_BatchCrossingSign(benchmark::State& state) {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(state.range(0));
+  auto loop = fractal.MakeLoop(S2Testing::GetRandomFrame(),
+                               S1Angle::Degrees(1));
+  S2Point a = loop->vertex(0), b = loop->vertex(loop->num_vertices() / 2);
+  vector<double> x[2], y[2], z[2];
+  for (int i = 0; i < loop->num_vertices(); ++i) {
+    for (int j = 0; j < 2; ++j) {
+      const S2Point& p = loop->vertex(i + j);
+      x[j].push_back(p.x());
+      y[j].push_back(p.y());
+      z[j].push_back(p.z());
+    }
+  }
+  s2pred::PointArrays c{x[0], y[0], z[0]}, d{x[1], y[1], z[1]};
+  vector<int> signs(loop->num_vertices());
+  for (auto _ : state) {
+    S2::BatchCrossingSign(a, b, c, d, absl::MakeSpan(signs));
+    benchmark::DoNotOptimize(signs.data());
+  }
+  state.SetItemsProcessed(state.iterations() * loop->num_vertices());
+}
+BENCHMARK(BM_BatchCrossingSign)->Range(1 << 8, 1 << 14);
+
+}  // namespace
@@ -254,6 +254,45 @@ TEST(S2, CollinearEdgesThatDontTouch) {
   }
 }
 
+TEST(S2, IsDefinitelyNotCrossing) {
+  // Test edges CD whose vertices are very close to the great circle through
+  // AB, where rounding C and D to single precision can change their
+  // orientation with respect to AB.
+  const int kIters = 20000;
+  int num_definite = 0;
+  for (int iter = 0; iter < kIters; ++iter) {
+    S2Point a = S2Testing::RandomPoint();
+    S2Point b = S2::Interpolate(
+        a, S2Testing::RandomPoint(),
+        pow(1e-10, S2Testing::rnd.RandDouble()));
+    S2Point normal = a.CrossProd(b).Normalize();
+    auto near_ab = [&]() {
+      double dist = pow(1e-12, S2Testing::rnd.RandDouble());
+      if (S2Testing::rnd.OneIn(2)) dist = -dist;
+      S2Point x = S2::Interpolate(a, b, S2Testing::rnd.UniformDouble(-1, 2));
+      return (x + dist * normal).Normalize();
+    };
+    S2Point c = near_ab(), d = near_ab();
+    S2CopyingEdgeCrosser crosser(a, b);
+    if (crosser.IsDefinitelyNotCrossing(Vector3_f::Cast(c),
+                                        Vector3_f::Cast(d))) {
+      ++num_definite;
+      ASSERT_EQ(crosser.CrossingSign(c, d), -1) << a << b << c << d;
+    }
+  }
+  // Most edges are far enough from AB to be decided.
+  EXPECT_GT(num_definite, kIters / 10);
+
+  // An edge that shares a vertex with AB is never decided.
+  S2Point a(1, 0, 0), b = S2Point(1, 1, 0).Normalize();
+  S2Point c = S2Point(1, 1, 1).Normalize();
+  S2CopyingEdgeCrosser crosser(a, b);
+  EXPECT_FALSE(crosser.IsDefinitelyNotCrossing(Vector3_f::Cast(a),
+                                               Vector3_f::Cast(c)));
+  EXPECT_TRUE(crosser.IsDefinitelyNotCrossing(
+      Vector3_f::Cast(c), Vector3_f::Cast(S2Point(0, 1, 1).Normalize())));
+}
+
 
 TEST(S2, CoincidentZeroLengthEdgesThatDontTouch) {
   // It is important that the edge primitives can handle vertices that exactly
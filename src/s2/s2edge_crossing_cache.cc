@@ -0,0 +1,165 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2edge_crossing_cache.h"
+
+#include <cstddef>
+#include <cstring>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/base/casts.h"
+#include "absl/hash/hash.h"
+#include "absl/log/absl_check.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "s2/base/types.h"
+#include "s2/s2edge_crossings.h"
+#include "s2/s2point.h"
+
+using std::vector;
+
+// Compares points by the bit patterns of their coordinates.
+static bool BitLess(const S2Point& a, const S2Point& b) {
+  auto bits = [](const S2Point& p) {
+    return std::make_tuple(absl::bit_cast<uint64>(p[0]),
+                           absl::bit_cast<uint64>(p[1]),
+                           absl::bit_cast<uint64>(p[2]));
+  };
+  return bits(a) < bits(b);
+}
+
+bool S2EdgeCrossingCache::Key::operator==(const Key& other) const {
+  return std::memcmp(v, other.v, sizeof(v)) == 0;
+}
+
+/* static */
+S2EdgeCrossingCache::Key S2EdgeCrossingCache::MakeKey(const S2Point& a0,
+                                                      const S2Point& a1,
+                                                      const S2Point& b0,
+                                                      const S2Point& b1) {
+  Key key{{a0, a1, b0, b1}};
+  if (BitLess(key.v[1], key.v[0])) std::swap(key.v[0], key.v[1]);
+  if (BitLess(key.v[3], key.v[2])) std::swap(key.v[2], key.v[3]);
+  if (BitLess(key.v[2], key.v[0]) ||
+      (!BitLess(key.v[0], key.v[2]) && BitLess(key.v[3], key.v[1]))) {
+    std::swap(key.v[0], key.v[2]);
+    std::swap(key.v[1], key.v[3]);
+  }
+  return key;
+}
+
+S2EdgeCrossingCache::Shard& S2EdgeCrossingCache::GetShard(const Key& key) {
+  return shards_[absl::HashOf(key) % kNumShards];
+}
+
+int S2EdgeCrossingCache::CrossingSign(const S2Point& a0, const S2Point& a1,
+                                      const S2Point& b0, const S2Point& b1) {
+  const Key key = MakeKey(a0, a1, b0, b1);
+  Shard& shard = GetShard(key);
+  {
+    absl::MutexLock lock(&shard.mutex);
+    auto it = shard.map.find(key);
+    if (it != shard.map.end() && it->second.sign != kUnknownSign) {
+      num_hits_.fetch_add(1, std::memory_order_relaxed);
+      return it->second.sign;
+    }
+  }
+  num_misses_.fetch_add(1, std::memory_order_relaxed);
+  const int sign = S2::CrossingSign(a0, a1, b0, b1);
+  absl::MutexLock lock(&shard.mutex);
+  shard.map[key].sign = sign;
+  return sign;
+}
+
+bool S2EdgeCrossingCache::LookupIntersection(const Key& key,
+                                             S2Point* result) {
+  Shard& shard = GetShard(key);
+  absl::MutexLock lock(&shard.mutex);
+  auto it = shard.map.find(key);
+  if (it == shard.map.end() || !it->second.has_intersection) {
+    num_misses_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  num_hits_.fetch_add(1, std::memory_order_relaxed);
+  *result = it->second.intersection;
+  return true;
+}
+
+void S2EdgeCrossingCache::InsertIntersection(const Key& key,
+                                             const S2Point& intersection) {
+  Shard& shard = GetShard(key);
+  absl::MutexLock lock(&shard.mutex);
+  Entry& entry = shard.map[key];
+  entry.has_intersection = true;
+  entry.intersection = intersection;
+}
+
+S2Point S2EdgeCrossingCache::GetIntersection(const S2Point& a0,
+                                             const S2Point& a1,
+                                             const S2Point& b0,
+                                             const S2Point& b1) {
+  const Key key = MakeKey(a0, a1, b0, b1);
+  S2Point result;
+  if (LookupIntersection(key, &result)) return result;
+  result = S2::GetIntersection(a0, a1, b0, b1);
+  InsertIntersection(key, result);
+  return result;
+}
+
+void S2EdgeCrossingCache::BatchGetIntersection(
+    absl::Span<const S2::CrossingEdgePair> pairs,
+    absl::Span<S2Point> results) {
+  ABSL_DCHECK_EQ(pairs.size(), results.size());
+  // The pairs that are not in the cache are computed together so that
+  // S2::BatchGetIntersection() can handle the easy cases in a tight loop.
+  vector<int> missing;
+  vector<Key> keys;
+  keys.reserve(pairs.size());
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    const S2::CrossingEdgePair& p = pairs[i];
+    keys.push_back(MakeKey(p.a0, p.a1, p.b0, p.b1));
+    if (!LookupIntersection(keys.back(), &results[i])) missing.push_back(i);
+  }
+  if (missing.empty()) return;
+  vector<S2::CrossingEdgePair> missing_pairs;
+  missing_pairs.reserve(missing.size());
+  for (int i : missing) missing_pairs.push_back(pairs[i]);
+  vector<S2Point> missing_results(missing.size());
+  S2::BatchGetIntersection(missing_pairs, absl::MakeSpan(missing_results));
+  for (size_t j = 0; j < missing.size(); ++j) {
+    results[missing[j]] = missing_results[j];
+    InsertIntersection(keys[missing[j]], missing_results[j]);
+  }
+}
+
+size_t S2EdgeCrossingCache::size() const {
+  size_t size = 0;
+  for (const Shard& shard : shards_) {
+    absl::MutexLock lock(&shard.mutex);
+    size += shard.map.size();
+  }
+  return size;
+}
+
+void S2EdgeCrossingCache::Clear() {
+  for (Shard& shard : shards_) {
+    absl::MutexLock lock(&shard.mutex);
+    shard.map.clear();
+  }
+  num_hits_.store(0, std::memory_order_relaxed);
+  num_misses_.store(0, std::memory_order_relaxed);
+}
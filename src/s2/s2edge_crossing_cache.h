@@ -0,0 +1,148 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2EDGE_CROSSING_CACHE_H_
+#define S2_S2EDGE_CROSSING_CACHE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#include "absl/base/casts.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "s2/base/types.h"
+#include "s2/s2edge_crossings.h"
+#include "s2/s2point.h"
+
+// S2EdgeCrossingCache remembers the crossing signs and intersection points
+// of edge pairs, so that they are not recomputed when the same edge pairs
+// are crossed by many operations.  For example, when many pairs of
+// administrative polygons that share long borders are intersected with
+// each other, the same border edges are crossed repeatedly, and computing
+// their intersection points sometimes requires exact arithmetic.
+//
+// Edge pairs are keyed by the exact coordinates of their vertices.  Since
+// CrossingSign() and GetIntersection() do not depend on the order of the
+// two edges or of the vertices within each edge, all such permutations
+// share a single entry.  The results are always identical to
+// S2::CrossingSign() and S2::GetIntersection().
+//
+// The cache is owned and scoped by the caller, who passes it to each
+// operation (see S2Builder::Options::edge_crossing_cache() and
+// S2BooleanOperation::Options::edge_crossing_cache()), and it grows until
+// Clear() is called.  This class is thread-safe.
+//
+// Example usage:
+//
+//   S2EdgeCrossingCache cache;
+//   S2BooleanOperation::Options options;
+//   options.set_edge_crossing_cache(&cache);
+//   for (const auto& [county, area] : pairs) {
+//     S2Polygon result;
+//     S2BooleanOperation op(S2BooleanOperation::OpType::INTERSECTION,
+//                           make_unique<S2PolygonLayer>(&result), options);
+//     op.Build(county.index(), area.index(), &error);
+//   }
+class S2EdgeCrossingCache {
+ public:
+  S2EdgeCrossingCache() = default;
+
+  S2EdgeCrossingCache(const S2EdgeCrossingCache&) = delete;
+  S2EdgeCrossingCache& operator=(const S2EdgeCrossingCache&) = delete;
+
+  // Returns S2::CrossingSign(a0, a1, b0, b1).
+  int CrossingSign(const S2Point& a0, const S2Point& a1, const S2Point& b0,
+                   const S2Point& b1);
+
+  // Returns S2::GetIntersection(a0, a1, b0, b1).
+  //
+  // REQUIRES: S2::CrossingSign(a0, a1, b0, b1) > 0
+  S2Point GetIntersection(const S2Point& a0, const S2Point& a1,
+                          const S2Point& b0, const S2Point& b1);
+
+  // Like S2::BatchGetIntersection(), except that the intersection points of
+  // edge pairs that are already in the cache are not recomputed.
+  //
+  // REQUIRES: results.size() == pairs.size()
+  void BatchGetIntersection(absl::Span<const S2::CrossingEdgePair> pairs,
+                            absl::Span<S2Point> results);
+
+  // Returns the number of edge pairs in the cache.
+  size_t size() const;
+
+  // Returns the number of lookups that found (or did not find) the
+  // requested result in the cache.
+  int64 num_hits() const { return num_hits_.load(std::memory_order_relaxed); }
+  int64 num_misses() const {
+    return num_misses_.load(std::memory_order_relaxed);
+  }
+
+  // Removes all entries and resets the statistics.
+  void Clear();
+
+ private:
+  // The vertices of an edge pair in canonical order: the vertices of each
+  // edge are sorted, and then the edges are sorted.  Vertices are compared
+  // by their bit patterns, so that (for example) 0.0 and -0.0 are distinct.
+  struct Key {
+    S2Point v[4];
+
+    bool operator==(const Key& other) const;
+
+    template <typename H>
+    friend H AbslHashValue(H h, const Key& key) {
+      for (const S2Point& p : key.v) {
+        h = H::combine(std::move(h), absl::bit_cast<uint64>(p[0]),
+                       absl::bit_cast<uint64>(p[1]),
+                       absl::bit_cast<uint64>(p[2]));
+      }
+      return h;
+    }
+  };
+
+  static constexpr int8 kUnknownSign = -2;
+  struct Entry {
+    // The crossing sign, or kUnknownSign if it has not been computed.
+    int8 sign = kUnknownSign;
+    bool has_intersection = false;
+    S2Point intersection;
+  };
+
+  // The cache is divided into shards with separate locks to reduce
+  // contention between threads.
+  static constexpr int kNumShards = 16;
+  struct Shard {
+    mutable absl::Mutex mutex;
+    absl::flat_hash_map<Key, Entry> map ABSL_GUARDED_BY(mutex);
+  };
+
+  static Key MakeKey(const S2Point& a0, const S2Point& a1, const S2Point& b0,
+                     const S2Point& b1);
+  Shard& GetShard(const Key& key);
+
+  // Returns true and sets "result" if the intersection of the given edge
+  // pair is cached.
+  bool LookupIntersection(const Key& key, S2Point* result);
+  void InsertIntersection(const Key& key, const S2Point& intersection);
+
+  Shard shards_[kNumShards];
+  std::atomic<int64> num_hits_{0};
+  std::atomic<int64> num_misses_{0};
+};
+
+#endif  // S2_S2EDGE_CROSSING_CACHE_H_
@@ -0,0 +1,189 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2edge_crossing_cache.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/types/span.h"
+#include "s2/s1angle.h"
+#include "s2/s2boolean_operation.h"
+#include "s2/s2builder.h"
+#include "s2/s2builderutil_s2polygon_layer.h"
+#include "s2/s2builderutil_s2polyline_vector_layer.h"
+#include "s2/s2cap.h"
+#include "s2/s2edge_crossings.h"
+#include "s2/s2error.h"
+#include "s2/s2fractal.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2polygon.h"
+#include "s2/s2polyline.h"
+#include "s2/s2testing.h"
+
+using s2builderutil::S2PolygonLayer;
+using s2builderutil::S2PolylineVectorLayer;
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Returns random pairs of crossing edges within the given cap.
+vector<S2::CrossingEdgePair> GetCrossingEdgePairs(const S2Cap& cap, int n) {
+  vector<S2::CrossingEdgePair> pairs;
+  while (pairs.size() < n) {
+    S2::CrossingEdgePair p{
+        S2Testing::SamplePoint(cap), S2Testing::SamplePoint(cap),
+        S2Testing::SamplePoint(cap), S2Testing::SamplePoint(cap)};
+    if (S2::CrossingSign(p.a0, p.a1, p.b0, p.b1) > 0) pairs.push_back(p);
+  }
+  return pairs;
+}
+
+TEST(S2EdgeCrossingCache, MatchesS2EdgeCrossings) {
+  S2Testing::rnd.Reset(1);
+  const S2Cap cap(S2Point(1, 1, 1).Normalize(), S1Angle::Degrees(1));
+  vector<S2::CrossingEdgePair> pairs = GetCrossingEdgePairs(cap, 100);
+  S2EdgeCrossingCache cache;
+  for (const auto& p : pairs) {
+    EXPECT_EQ(cache.GetIntersection(p.a0, p.a1, p.b0, p.b1),
+              S2::GetIntersection(p.a0, p.a1, p.b0, p.b1));
+    EXPECT_EQ(cache.CrossingSign(p.a0, p.a1, p.b0, p.b1), 1);
+    // Edge pairs that share a vertex or do not cross.
+    EXPECT_EQ(cache.CrossingSign(p.a0, p.a1, p.a1, p.b0),
+              S2::CrossingSign(p.a0, p.a1, p.a1, p.b0));
+    EXPECT_EQ(cache.CrossingSign(p.a0, p.b0, p.a1, p.b1),
+              S2::CrossingSign(p.a0, p.b0, p.a1, p.b1));
+  }
+  EXPECT_EQ(cache.num_hits(), 0);
+  EXPECT_EQ(cache.size(), 300);
+
+  // Swapping the edges or the vertices of either edge yields cache hits.
+  for (const auto& p : pairs) {
+    EXPECT_EQ(cache.GetIntersection(p.b1, p.b0, p.a0, p.a1),
+              S2::GetIntersection(p.a0, p.a1, p.b0, p.b1));
+    EXPECT_EQ(cache.CrossingSign(p.b0, p.b1, p.a1, p.a0), 1);
+  }
+  EXPECT_EQ(cache.num_hits(), 200);
+  EXPECT_EQ(cache.size(), 300);
+
+  cache.Clear();
+  EXPECT_EQ(cache.size(), 0);
+  EXPECT_EQ(cache.num_hits(), 0);
+  EXPECT_EQ(cache.num_misses(), 0);
+}
+
+TEST(S2EdgeCrossingCache, BatchGetIntersection) {
+  S2Testing::rnd.Reset(2);
+  const S2Cap cap(S2Point(1, 0, 0), S1Angle::Degrees(10));
+  vector<S2::CrossingEdgePair> pairs = GetCrossingEdgePairs(cap, 50);
+  vector<S2Point> expected(pairs.size()), actual(pairs.size());
+  S2::BatchGetIntersection(pairs, absl::MakeSpan(expected));
+
+  S2EdgeCrossingCache cache;
+  cache.GetIntersection(pairs[0].a0, pairs[0].a1, pairs[0].b0, pairs[0].b1);
+  cache.BatchGetIntersection(pairs, absl::MakeSpan(actual));
+  EXPECT_EQ(actual, expected);
+  EXPECT_EQ(cache.num_hits(), 1);
+  EXPECT_EQ(cache.num_misses(), pairs.size());
+
+  actual.assign(pairs.size(), S2Point());
+  cache.BatchGetIntersection(pairs, absl::MakeSpan(actual));
+  EXPECT_EQ(actual, expected);
+  EXPECT_EQ(cache.num_hits(), 1 + pairs.size());
+}
+
+// Returns the intersection of "a" and "b" computed by S2BooleanOperation.
+unique_ptr<S2Polygon> Intersect(const S2Polygon& a, const S2Polygon& b,
+                                S2EdgeCrossingCache* cache) {
+  S2BooleanOperation::Options options;
+  options.set_edge_crossing_cache(cache);
+  auto result = make_unique<S2Polygon>();
+  S2BooleanOperation op(S2BooleanOperation::OpType::INTERSECTION,
+                        make_unique<S2PolygonLayer>(result.get()), options);
+  S2Error error;
+  EXPECT_TRUE(op.Build(a.index(), b.index(), &error)) << error;
+  return result;
+}
+
+TEST(S2EdgeCrossingCache, S2BooleanOperation) {
+  // Intersect a fractal "county" with several "service areas" that cross
+  // its border, and then repeat the operations with the operands reversed.
+  S2Testing::rnd.Reset(3);
+  const S2Point center(1, 0, 0);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(1000);
+  S2Polygon county(fractal.MakeLoop(S2Testing::GetRandomFrameAt(center),
+                                    S1Angle::Degrees(1)));
+  vector<unique_ptr<S2Polygon>> areas;
+  for (int i = 0; i < 3; ++i) {
+    areas.push_back(make_unique<S2Polygon>(S2Loop::MakeRegularLoop(
+        S2Testing::SamplePoint(S2Cap(center, S1Angle::Degrees(1))),
+        S1Angle::Degrees(0.5), 50)));
+  }
+  S2EdgeCrossingCache cache;
+  for (const auto& area : areas) {
+    EXPECT_TRUE(Intersect(county, *area, &cache)
+                    ->Equals(*Intersect(county, *area, nullptr)));
+  }
+  const int64 num_misses = cache.num_misses();
+  EXPECT_GT(num_misses, 10);
+  for (const auto& area : areas) {
+    EXPECT_TRUE(Intersect(*area, county, &cache)
+                    ->Equals(*Intersect(*area, county, nullptr)));
+  }
+  // No new intersection points were computed.
+  EXPECT_GE(cache.num_hits(), num_misses);
+  EXPECT_EQ(cache.num_misses(), num_misses);
+}
+
+TEST(S2EdgeCrossingCache, S2BuilderSplitCrossingEdges) {
+  S2Testing::rnd.Reset(4);
+  const S2Cap cap(S2Point(0, 1, 0), S1Angle::Degrees(1));
+  vector<S2Point> vertices;
+  for (int i = 0; i < 30; ++i) vertices.push_back(S2Testing::SamplePoint(cap));
+  S2Polyline polyline(vertices);
+
+  // Build the polyline twice using the cache and then once without it.
+  S2EdgeCrossingCache cache;
+  vector<unique_ptr<S2Polyline>> expected;
+  for (int iter = 0; iter < 3; ++iter) {
+    S2Builder::Options options;
+    options.set_split_crossing_edges(true);
+    options.set_edge_crossing_cache(iter < 2 ? &cache : nullptr);
+    S2Builder builder(options);
+    vector<unique_ptr<S2Polyline>> output;
+    builder.StartLayer(make_unique<S2PolylineVectorLayer>(&output));
+    builder.AddPolyline(polyline);
+    S2Error error;
+    ASSERT_TRUE(builder.Build(&error)) << error;
+    if (iter == 0) {
+      expected = std::move(output);
+      continue;
+    }
+    ASSERT_EQ(output.size(), expected.size());
+    for (int i = 0; i < output.size(); ++i) {
+      EXPECT_TRUE(output[i]->Equals(*expected[i]));
+    }
+  }
+  EXPECT_GT(cache.num_misses(), 10);
+  EXPECT_EQ(cache.num_hits(), cache.num_misses());
+}
+
+}  // namespace
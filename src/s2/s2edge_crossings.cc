@@ -19,12 +19,15 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstddef>
 #include <limits>
 #include <utility>
 
+#include "absl/container/inlined_vector.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 
 #include "s2/s1angle.h"
 #include "s2/s2edge_crosser.h"
@@ -50,6 +53,7 @@ using s2pred::ToExact;
 using s2pred::ToLD;
 using std::fabs;
 using std::max;
+using std::min;
 using std::sqrt;
 
 using Vector3_ld = s2pred::Vector3_ld;
@@ -362,6 +366,36 @@ int CrossingSign(const S2Point& a, const S2Point& b,
   return crosser.CrossingSign(&d);
 }
 
+void BatchCrossingSign(const S2Point& a, const S2Point& b,
+                       const s2pred::PointArrays& c,
+                       const s2pred::PointArrays& d, absl::Span<int> signs) {
+  ABSL_DCHECK_EQ(c.size(), d.size());
+  ABSL_DCHECK_EQ(c.size(), signs.size());
+  const Vector3_d a_cross_b = a.CrossProd(b);
+  S2CopyingEdgeCrosser crosser(a, b);
+
+  // The triage signs are computed in fixed-size blocks to avoid allocation.
+  constexpr size_t kBlockSize = 64;
+  int abc[kBlockSize], abd[kBlockSize];
+  for (size_t start = 0; start < c.size(); start += kBlockSize) {
+    size_t len = min(kBlockSize, c.size() - start);
+    s2pred::BatchTriageSign(a_cross_b, c.subspan(start, len),
+                            absl::MakeSpan(abc, len));
+    s2pred::BatchTriageSign(a_cross_b, d.subspan(start, len),
+                            absl::MakeSpan(abd, len));
+    for (size_t k = 0; k < len; ++k) {
+      // This is the fast path of S2EdgeCrosser::CrossingSign(): if C and D
+      // are definitely on the same side of AB, the edges do not cross.
+      if (abc[k] == abd[k] && abd[k] != 0) {
+        signs[start + k] = -1;
+      } else {
+        size_t i = start + k;
+        signs[i] = crosser.CrossingSign(c[i], d[i]);
+      }
+    }
+  }
+}
+
 bool VertexCrossing(const S2Point& a, const S2Point& b,
                     const S2Point& c, const S2Point& d) {
   // If A == B or C == D there is no intersection.  We need to check this
@@ -413,6 +447,55 @@ bool EdgeOrVertexCrossing(const S2Point& a, const S2Point& b,
   return VertexCrossing(a, b, c, d);
 }
 
+bool EdgeOrVertexCrossingParity(const S2Point& a, const S2Point& b,
+                                absl::Span<const S2Point> v) {
+  const int n = v.size();
+  if (n == 0) return false;
+
+  // An edge CD cannot cross AB when C and D are strictly on the same side of
+  // the great circle through AB, which is true of almost every edge.  We
+  // compute the orientation of each vertex in blocks (which is vectorized),
+  // and call EdgeOrVertexCrossing() only for the remaining edges.  Since
+  // BatchTriageSign() is bitwise identical to the TriageSign() test used by
+  // S2EdgeCrosser, the result is the same as chaining S2EdgeCrosser.
+  static constexpr int kBlockSize = 64;
+  double x[kBlockSize], y[kBlockSize], z[kBlockSize];
+  int signs[kBlockSize];
+  const Vector3_d a_cross_b = a.CrossProd(b);
+  int prev_sign = s2pred::TriageSign(a, b, v[0], a_cross_b);
+  bool parity = false;
+  for (int start = 0; start < n; start += kBlockSize) {
+    // Block entry k is vertex (start + k + 1), wrapping around to vertex 0.
+    const int len = min(kBlockSize, n - start);
+    const int num_copied = min(len, n - start - 1);
+    for (int k = 0; k < num_copied; ++k) {
+      const S2Point& p = v[start + k + 1];
+      x[k] = p.x();
+      y[k] = p.y();
+      z[k] = p.z();
+    }
+    if (num_copied < len) {
+      x[len - 1] = v[0].x();
+      y[len - 1] = v[0].y();
+      z[len - 1] = v[0].z();
+    }
+    s2pred::BatchTriageSign(
+        a_cross_b, {{x, static_cast<size_t>(len)},
+                    {y, static_cast<size_t>(len)},
+                    {z, static_cast<size_t>(len)}},
+        absl::MakeSpan(signs, len));
+    for (int k = 0; k < len; ++k) {
+      const int sign = signs[k];
+      if (sign != prev_sign || sign == 0) {
+        const int i = start + k;
+        parity ^= EdgeOrVertexCrossing(a, b, v[i], v[i + 1 == n ? 0 : i + 1]);
+      }
+      prev_sign = sign;
+    }
+  }
+  return parity;
+}
+
 // Computes the cross product of "x" and "y", normalizes it to be unit length,
 // and stores the result in "result".  Also returns the length of the cross
 // product before normalization, which is useful for estimating the amount of
@@ -726,6 +809,33 @@ static bool ApproximatelyOrdered(const S2Point& a, const S2Point& x,
   return s2pred::OrderedCCW(a, x, b, S2::RobustCrossProd(a, b).Normalize());
 }
 
+// Computes the intersection point when GetIntersectionStable() fails in
+// double precision, and sets "method" to the method that was used.
+static S2Point GetIntersectionFallback(const S2Point& a0, const S2Point& a1,
+                                       const S2Point& b0, const S2Point& b1,
+                                       IntersectionMethod* method) {
+  S2Point result;
+  if (kHasLongDouble && GetIntersectionStableLD(a0, a1, b0, b1, &result)) {
+    *method = IntersectionMethod::STABLE_LD;
+  } else {
+    result = GetIntersectionExact(a0, a1, b0, b1);
+    *method = IntersectionMethod::EXACT;
+  }
+  return result;
+}
+
+// Records the method used to compute the intersection point "x" of the given
+// edges, and checks that "x" lies on both edges.
+static void CheckIntersection(const S2Point& a0, const S2Point& a1,
+                              const S2Point& b0, const S2Point& b1,
+                              const S2Point& x, IntersectionMethod method) {
+  if (intersection_method_tally_) {
+    ++intersection_method_tally_[static_cast<int>(method)];
+  }
+  ABSL_DCHECK(ApproximatelyOrdered(a0, x, a1, kIntersectionError.radians()));
+  ABSL_DCHECK(ApproximatelyOrdered(b0, x, b1, kIntersectionError.radians()));
+}
+
 S2Point GetIntersection(const S2Point& a0, const S2Point& a1,
                         const S2Point& b0, const S2Point& b1) {
   ABSL_DCHECK_GT(CrossingSign(a0, a1, b0, b1), 0);
@@ -774,24 +884,33 @@ S2Point GetIntersection(const S2Point& a0, const S2Point& a1,
     method = IntersectionMethod::SIMPLE_LD;
   } else if (GetIntersectionStable(a0, a1, b0, b1, &result)) {
     method = IntersectionMethod::STABLE;
-  } else if (kHasLongDouble &&
-             GetIntersectionStableLD(a0, a1, b0, b1, &result)) {
-    method = IntersectionMethod::STABLE_LD;
   } else {
-    result = GetIntersectionExact(a0, a1, b0, b1);
-    method = IntersectionMethod::EXACT;
-  }
-  if (intersection_method_tally_) {
-    ++intersection_method_tally_[static_cast<int>(method)];
+    result = GetIntersectionFallback(a0, a1, b0, b1, &method);
   }
-
-  // Make sure that the intersection point lies on both edges.
-  ABSL_DCHECK(
-      ApproximatelyOrdered(a0, result, a1, kIntersectionError.radians()));
-  ABSL_DCHECK(
-      ApproximatelyOrdered(b0, result, b1, kIntersectionError.radians()));
-
+  CheckIntersection(a0, a1, b0, b1, result, method);
   return result;
 }
 
+void BatchGetIntersection(absl::Span<const CrossingEdgePair> pairs,
+                          absl::Span<S2Point> results) {
+  ABSL_DCHECK_EQ(pairs.size(), results.size());
+  absl::InlinedVector<size_t, 8> remaining;
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    const CrossingEdgePair& p = pairs[i];
+    ABSL_DCHECK_GT(CrossingSign(p.a0, p.a1, p.b0, p.b1), 0);
+    if (GetIntersectionStable(p.a0, p.a1, p.b0, p.b1, &results[i])) {
+      CheckIntersection(p.a0, p.a1, p.b0, p.b1, results[i],
+                        IntersectionMethod::STABLE);
+    } else {
+      remaining.push_back(i);
+    }
+  }
+  for (size_t i : remaining) {
+    const CrossingEdgePair& p = pairs[i];
+    IntersectionMethod method;
+    results[i] = GetIntersectionFallback(p.a0, p.a1, p.b0, p.b1, &method);
+    CheckIntersection(p.a0, p.a1, p.b0, p.b1, results[i], method);
+  }
+}
+
 }  // namespace S2
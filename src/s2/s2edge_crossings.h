@@ -34,6 +34,7 @@
 #include "absl/base/macros.h"
 #include "absl/container/inlined_vector.h"
 #include "absl/log/absl_check.h"
+#include "absl/types/span.h"
 #include "s2/_fp_contract_off.h"
 #include "s2/r2.h"
 #include "s2/r2rect.h"
@@ -112,6 +113,18 @@ constexpr S1Angle kRobustCrossProdError = S1Angle::Radians(6 * s2pred::DBL_ERR);
 int CrossingSign(const S2Point& a, const S2Point& b,
                  const S2Point& c, const S2Point& d);
 
+// Sets signs[i] = CrossingSign(a, b, c[i], d[i]) for a batch of edges CD
+// stored in structure-of-arrays layout.  The initial orientation tests
+// (which determine the result for the vast majority of non-crossing edges)
+// are vectorized using s2pred::BatchTriageSign(); the remaining edges are
+// tested using S2EdgeCrosser, so the results are always identical to
+// CrossingSign().
+//
+// REQUIRES: c.size() == d.size() == signs.size()
+void BatchCrossingSign(const S2Point& a, const S2Point& b,
+                       const s2pred::PointArrays& c,
+                       const s2pred::PointArrays& d, absl::Span<int> signs);
+
 // Returns true if the angle ABC contains its vertex B.  Containment is
 // defined such that if several polygons tile the region around a vertex, then
 // exactly one of those polygons contains that vertex.  Returns false for
@@ -193,6 +206,18 @@ int SignedVertexCrossing(const S2Point& a, const S2Point& b,
 bool EdgeOrVertexCrossing(const S2Point& a, const S2Point& b,
                           const S2Point& c, const S2Point& d);
 
+// Returns true if EdgeOrVertexCrossing(a, b, v[i], v[i+1]) is true for an odd
+// number of the edges of the closed loop "v" (including the edge from the
+// last vertex back to the first).  This is the core of brute-force
+// point-in-polygon tests, and is equivalent to chaining
+// S2EdgeCrosser::EdgeOrVertexCrossing() over the vertices.  It is faster
+// because the orientation of each vertex with respect to AB is computed for
+// blocks of vertices at once (see s2pred::BatchTriageSign), and only edges
+// whose endpoints are not definitely on the same side of AB are tested
+// individually.
+bool EdgeOrVertexCrossingParity(const S2Point& a, const S2Point& b,
+                                absl::Span<const S2Point> v);
+
 // Given two edges AB and CD such that CrossingSign(A, B, C, D) > 0, returns
 // their intersection point.  Useful properties of GetIntersection (GI):
 //
@@ -205,6 +230,22 @@ bool EdgeOrVertexCrossing(const S2Point& a, const S2Point& b,
 S2Point GetIntersection(const S2Point& a, const S2Point& b,
                         const S2Point& c, const S2Point& d);
 
+// Two edges (a0, a1) and (b0, b1) such that CrossingSign(a0, a1, b0, b1) > 0.
+struct CrossingEdgePair {
+  S2Point a0, a1, b0, b1;
+};
+
+// Sets results[i] to the intersection point of the edges in pairs[i].  This
+// is faster than calling GetIntersection() in a loop because the pairs whose
+// intersection can be computed in double precision (which is almost all of
+// them) are handled first in a tight loop, and only the remaining pairs are
+// passed to the extended precision and exact arithmetic methods.  The
+// results are always identical to GetIntersection().
+//
+// REQUIRES: results.size() == pairs.size()
+void BatchGetIntersection(absl::Span<const CrossingEdgePair> pairs,
+                          absl::Span<S2Point> results);
+
 // kIntersectionError is an upper bound on the distance from the intersection
 // point returned by GetIntersection() to the true intersection point.
 constexpr S1Angle kIntersectionError = S1Angle::Radians(8 * s2pred::DBL_ERR);
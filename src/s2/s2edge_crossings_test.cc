@@ -30,8 +30,11 @@
 #include "absl/log/absl_log.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2edge_crosser.h"
 #include "s2/s2edge_crossings_internal.h"
 #include "s2/s2edge_distances.h"
 #include "s2/s2point.h"
@@ -412,6 +415,92 @@ S2Point GetIntersectionExact(const S2Point& a0, const S2Point& a1,
 // The approximate maximum error in GetDistance() for small distances.
 S1Angle kGetDistanceAbsError = S1Angle::Radians(3 * DBL_EPSILON);
 
+TEST(S2, BatchCrossingSignMatchesCrossingSign) {
+  // Build a pool of vertices that includes nearly collinear points, so that
+  // some edges need the exact predicates.  Edges are chosen from the pool so
+  // that shared vertices and degenerate edges also occur.
+  S2Testing::rnd.Reset(1);
+  S2Point center = S2Testing::RandomPoint();
+  S2Point dir = S2Testing::RandomPoint();
+  vector<S2Point> pool;
+  for (int i = 0; i < 20; ++i) {
+    pool.push_back(S2Testing::SamplePoint(S2Cap(center, S1Angle::Degrees(1))));
+    pool.push_back(S2::GetPointOnLine(
+        center, dir, S1Angle::Degrees(S2Testing::rnd.UniformDouble(-1, 1))));
+  }
+  vector<S2Point> c, d;
+  vector<double> cx, cy, cz, dx, dy, dz;
+  for (int i = 0; i < 203; ++i) {
+    // Mostly form chains (where D[i] == C[i+1]) since that is common.
+    c.push_back(i > 0 && !S2Testing::rnd.OneIn(4)
+                    ? d.back()
+                    : pool[S2Testing::rnd.Uniform(pool.size())]);
+    d.push_back(pool[S2Testing::rnd.Uniform(pool.size())]);
+    cx.push_back(c.back().x());
+    cy.push_back(c.back().y());
+    cz.push_back(c.back().z());
+    dx.push_back(d.back().x());
+    dy.push_back(d.back().y());
+    dz.push_back(d.back().z());
+  }
+  s2pred::PointArrays c_arrays{cx, cy, cz}, d_arrays{dx, dy, dz};
+  vector<int> signs(c.size());
+  int num_crossings = 0;
+  for (int i = 0; i < pool.size(); i += 3) {
+    for (int j = 0; j < pool.size(); j += 2) {
+      const S2Point& a = pool[i];
+      const S2Point& b = pool[j];
+      S2::BatchCrossingSign(a, b, c_arrays, d_arrays, absl::MakeSpan(signs));
+      for (int k = 0; k < c.size(); ++k) {
+        ASSERT_EQ(S2::CrossingSign(a, b, c[k], d[k]), signs[k])
+            << "a=" << a << " b=" << b << " c=" << c[k] << " d=" << d[k];
+        num_crossings += signs[k] > 0;
+      }
+    }
+  }
+  EXPECT_GT(num_crossings, 0);
+}
+
+TEST(S2, EdgeOrVertexCrossingParityMatchesEdgeCrosser) {
+  // Loops are built from a pool that includes nearly collinear points, and
+  // the query edges often end at loop vertices, so that the exact predicates
+  // and VertexCrossing() are exercised.  Loop sizes straddle the block size
+  // used by EdgeOrVertexCrossingParity().
+  S2Testing::rnd.Reset(2);
+  S2Point center = S2Testing::RandomPoint();
+  S2Point dir = S2Testing::RandomPoint();
+  vector<S2Point> pool;
+  for (int i = 0; i < 20; ++i) {
+    pool.push_back(S2Testing::SamplePoint(S2Cap(center, S1Angle::Degrees(1))));
+    pool.push_back(S2::GetPointOnLine(
+        center, dir, S1Angle::Degrees(S2Testing::rnd.UniformDouble(-1, 1))));
+  }
+  for (int n : {0, 1, 2, 3, 5, 63, 64, 65, 129}) {
+    vector<S2Point> loop;
+    for (int i = 0; i < n; ++i) {
+      loop.push_back(S2Testing::rnd.OneIn(2)
+                         ? pool[S2Testing::rnd.Uniform(pool.size())]
+                         : S2Testing::SamplePoint(
+                               S2Cap(center, S1Angle::Degrees(1))));
+    }
+    for (int i = 0; i < 50; ++i) {
+      S2Point a = S2Testing::rnd.OneIn(2)
+                      ? S2::Origin()
+                      : pool[S2Testing::rnd.Uniform(pool.size())];
+      S2Point b = pool[S2Testing::rnd.Uniform(pool.size())];
+      bool expected = false;
+      if (n > 0) {
+        S2EdgeCrosser crosser(&a, &b, &loop[0]);
+        for (int j = 1; j <= n; ++j) {
+          expected ^= crosser.EdgeOrVertexCrossing(&loop[j == n ? 0 : j]);
+        }
+      }
+      EXPECT_EQ(S2::EdgeOrVertexCrossingParity(a, b, loop), expected)
+          << "n=" << n << " a=" << a << " b=" << b;
+    }
+  }
+}
+
 TEST(S2, IntersectionError) {
   // We repeatedly construct two edges that cross near a random point "p", and
   // measure the distance from the actual intersection point "x" to the
@@ -531,6 +620,32 @@ TEST(S2, GrazingIntersections) {
   stats.Print();
 }
 
+TEST(S2, BatchGetIntersectionMatchesGetIntersection) {
+  // Mix grazing intersections (which need the extended precision and exact
+  // methods) with ordinary ones.
+  vector<S2::CrossingEdgePair> pairs;
+  while (pairs.size() < 500) {
+    S2Point x, y, z;
+    S2Testing::GetRandomFrame(&x, &y, &z);
+    S2::CrossingEdgePair p;
+    if (S2Testing::rnd.OneIn(2)) {
+      p = {ChooseSemicirclePoint(x, y), ChooseSemicirclePoint(x, y),
+           ChooseSemicirclePoint(x, y), ChooseSemicirclePoint(x, y)};
+    } else {
+      S2Cap cap(x, S1Angle::Degrees(1));
+      p = {S2Testing::SamplePoint(cap), S2Testing::SamplePoint(cap),
+           S2Testing::SamplePoint(cap), S2Testing::SamplePoint(cap)};
+    }
+    if (S2::CrossingSign(p.a0, p.a1, p.b0, p.b1) > 0) pairs.push_back(p);
+  }
+  vector<S2Point> results(pairs.size());
+  S2::BatchGetIntersection(pairs, absl::MakeSpan(results));
+  for (int i = 0; i < pairs.size(); ++i) {
+    const S2::CrossingEdgePair& p = pairs[i];
+    EXPECT_EQ(S2::GetIntersection(p.a0, p.a1, p.b0, p.b1), results[i]);
+  }
+}
+
 TEST(S2, ExactIntersectionUnderflow) {
   // Tests that a correct intersection is computed even when two edges are
   // exactly collinear and the normals of both edges underflow in double
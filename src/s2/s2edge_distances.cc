@@ -20,9 +20,18 @@
 #include <algorithm>
 #include <cfloat>
 #include <cmath>
+#include <cstddef>
 #include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "absl/base/optimization.h"
+#include "absl/numeric/bits.h"
 #include "absl/log/absl_check.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
@@ -33,6 +42,7 @@
 
 using std::max;
 using std::min;
+using std::vector;
 
 namespace S2 {
 
@@ -233,6 +243,179 @@ bool UpdateMinDistance(const S2Point& x, const S2Point& a, const S2Point& b,
   return AlwaysUpdateMinDistance<false>(x, a, b, min_dist);
 }
 
+void GetMinDistanceCandidates(const S2Point& x, const s2pred::PointArrays& a,
+                              const s2pred::PointArrays& b,
+                              S1ChordAngle limit, vector<int>* candidates) {
+  ABSL_DCHECK_EQ(a.size(), b.size());
+  // The tests below are slightly more conservative than the ones in
+  // AlwaysUpdateMinInteriorDistance() and AlwaysUpdateMinDistance(), so that
+  // no edge that passes those tests is skipped even if the compiler evaluates
+  // the scalar expressions differently (e.g. using fused multiply-adds).
+  // An edge is a candidate if
+  //
+  //   |XA^2 - XB^2| < AB^2 + kErrorFactor * (XA^2 + XB^2 + AB^2) + kMinError
+  //
+  // (i.e., the closest point may lie in the edge interior) or if
+  //
+  //   min(XA^2, XB^2) * kVertexFactor < limit.length2() .
+  constexpr double kErrorFactor = 6.75 * DBL_EPSILON;
+  constexpr double kMinError = 8 * DBL_EPSILON * DBL_EPSILON;
+  constexpr double kVertexFactor = 1 - 2 * DBL_EPSILON;
+  const double limit2 = limit.length2();
+  const size_t n = a.size();
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256d xx = _mm256_set1_pd(x[0]);
+  const __m256d xy = _mm256_set1_pd(x[1]);
+  const __m256d xz = _mm256_set1_pd(x[2]);
+  const __m256d error_factor = _mm256_set1_pd(kErrorFactor);
+  const __m256d min_error = _mm256_set1_pd(kMinError);
+  const __m256d vertex_factor = _mm256_set1_pd(kVertexFactor);
+  const __m256d limit2_v = _mm256_set1_pd(limit2);
+  const __m256d sign_mask = _mm256_set1_pd(-0.0);
+  auto norm2 = [](__m256d dx, __m256d dy, __m256d dz) {
+    __m256d sum = _mm256_mul_pd(dx, dx);
+    sum = _mm256_add_pd(sum, _mm256_mul_pd(dy, dy));
+    return _mm256_add_pd(sum, _mm256_mul_pd(dz, dz));
+  };
+  for (; i + 4 <= n; i += 4) {
+    const __m256d ax = _mm256_loadu_pd(a.x.data() + i);
+    const __m256d ay = _mm256_loadu_pd(a.y.data() + i);
+    const __m256d az = _mm256_loadu_pd(a.z.data() + i);
+    const __m256d bx = _mm256_loadu_pd(b.x.data() + i);
+    const __m256d by = _mm256_loadu_pd(b.y.data() + i);
+    const __m256d bz = _mm256_loadu_pd(b.z.data() + i);
+    const __m256d xa2 = norm2(_mm256_sub_pd(xx, ax), _mm256_sub_pd(xy, ay),
+                              _mm256_sub_pd(xz, az));
+    const __m256d xb2 = norm2(_mm256_sub_pd(xx, bx), _mm256_sub_pd(xy, by),
+                              _mm256_sub_pd(xz, bz));
+    const __m256d ab2 = norm2(_mm256_sub_pd(ax, bx), _mm256_sub_pd(ay, by),
+                              _mm256_sub_pd(az, bz));
+    const __m256d sum2 = _mm256_add_pd(_mm256_add_pd(xa2, xb2), ab2);
+    const __m256d bound = _mm256_add_pd(
+        ab2, _mm256_add_pd(_mm256_mul_pd(error_factor, sum2), min_error));
+    const __m256d diff = _mm256_andnot_pd(sign_mask, _mm256_sub_pd(xa2, xb2));
+    const __m256d interior = _mm256_cmp_pd(diff, bound, _CMP_LT_OQ);
+    const __m256d vertex = _mm256_cmp_pd(
+        _mm256_mul_pd(_mm256_min_pd(xa2, xb2), vertex_factor), limit2_v,
+        _CMP_LT_OQ);
+    int mask = _mm256_movemask_pd(_mm256_or_pd(interior, vertex));
+    for (; mask != 0; mask &= mask - 1) {
+      int k = absl::countr_zero(static_cast<unsigned>(mask));
+      candidates->push_back(static_cast<int>(i) + k);
+    }
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  const float64x2_t xx = vdupq_n_f64(x[0]);
+  const float64x2_t xy = vdupq_n_f64(x[1]);
+  const float64x2_t xz = vdupq_n_f64(x[2]);
+  const float64x2_t error_factor = vdupq_n_f64(kErrorFactor);
+  const float64x2_t min_error = vdupq_n_f64(kMinError);
+  const float64x2_t vertex_factor = vdupq_n_f64(kVertexFactor);
+  const float64x2_t limit2_v = vdupq_n_f64(limit2);
+  auto norm2 = [](float64x2_t dx, float64x2_t dy, float64x2_t dz) {
+    float64x2_t sum = vmulq_f64(dx, dx);
+    sum = vaddq_f64(sum, vmulq_f64(dy, dy));
+    return vaddq_f64(sum, vmulq_f64(dz, dz));
+  };
+  for (; i + 2 <= n; i += 2) {
+    const float64x2_t ax = vld1q_f64(a.x.data() + i);
+    const float64x2_t ay = vld1q_f64(a.y.data() + i);
+    const float64x2_t az = vld1q_f64(a.z.data() + i);
+    const float64x2_t bx = vld1q_f64(b.x.data() + i);
+    const float64x2_t by = vld1q_f64(b.y.data() + i);
+    const float64x2_t bz = vld1q_f64(b.z.data() + i);
+    const float64x2_t xa2 = norm2(vsubq_f64(xx, ax), vsubq_f64(xy, ay),
+                                  vsubq_f64(xz, az));
+    const float64x2_t xb2 = norm2(vsubq_f64(xx, bx), vsubq_f64(xy, by),
+                                  vsubq_f64(xz, bz));
+    const float64x2_t ab2 = norm2(vsubq_f64(ax, bx), vsubq_f64(ay, by),
+                                  vsubq_f64(az, bz));
+    const float64x2_t sum2 = vaddq_f64(vaddq_f64(xa2, xb2), ab2);
+    const float64x2_t bound =
+        vaddq_f64(ab2, vaddq_f64(vmulq_f64(error_factor, sum2), min_error));
+    const uint64x2_t interior =
+        vcltq_f64(vabsq_f64(vsubq_f64(xa2, xb2)), bound);
+    const uint64x2_t vertex = vcltq_f64(
+        vmulq_f64(vminq_f64(xa2, xb2), vertex_factor), limit2_v);
+    const uint64x2_t keep = vorrq_u64(interior, vertex);
+    if (vgetq_lane_u64(keep, 0)) candidates->push_back(static_cast<int>(i));
+    if (vgetq_lane_u64(keep, 1)) {
+      candidates->push_back(static_cast<int>(i + 1));
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    const S2Point ai = a[i], bi = b[i];
+    double xa2 = (x - ai).Norm2(), xb2 = (x - bi).Norm2();
+    double ab2 = (ai - bi).Norm2();
+    double bound = ab2 + (kErrorFactor * (xa2 + xb2 + ab2) + kMinError);
+    if (std::fabs(xa2 - xb2) < bound ||
+        min(xa2, xb2) * kVertexFactor < limit2) {
+      candidates->push_back(static_cast<int>(i));
+    }
+  }
+}
+
+void GetMinPointDistanceCandidates(const S2Point& x,
+                                   const s2pred::PointArrays& points,
+                                   S1ChordAngle limit,
+                                   vector<int>* candidates) {
+  // The test below is slightly more conservative than the one in
+  // S1ChordAngle::UpdateMin(S1ChordAngle(x, p)), so that no point that passes
+  // that test is skipped even if the compiler evaluates the scalar expression
+  // differently (e.g. using fused multiply-adds).
+  constexpr double kFactor = 1 - 2 * DBL_EPSILON;
+  const double limit2 = limit.length2();
+  const size_t n = points.size();
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256d xx = _mm256_set1_pd(x[0]);
+  const __m256d xy = _mm256_set1_pd(x[1]);
+  const __m256d xz = _mm256_set1_pd(x[2]);
+  const __m256d factor = _mm256_set1_pd(kFactor);
+  const __m256d limit2_v = _mm256_set1_pd(limit2);
+  for (; i + 4 <= n; i += 4) {
+    const __m256d dx = _mm256_sub_pd(xx, _mm256_loadu_pd(points.x.data() + i));
+    const __m256d dy = _mm256_sub_pd(xy, _mm256_loadu_pd(points.y.data() + i));
+    const __m256d dz = _mm256_sub_pd(xz, _mm256_loadu_pd(points.z.data() + i));
+    __m256d dist2 = _mm256_mul_pd(dx, dx);
+    dist2 = _mm256_add_pd(dist2, _mm256_mul_pd(dy, dy));
+    dist2 = _mm256_add_pd(dist2, _mm256_mul_pd(dz, dz));
+    int mask = _mm256_movemask_pd(_mm256_cmp_pd(
+        _mm256_mul_pd(dist2, factor), limit2_v, _CMP_LT_OQ));
+    for (; mask != 0; mask &= mask - 1) {
+      int k = absl::countr_zero(static_cast<unsigned>(mask));
+      candidates->push_back(static_cast<int>(i) + k);
+    }
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  const float64x2_t xx = vdupq_n_f64(x[0]);
+  const float64x2_t xy = vdupq_n_f64(x[1]);
+  const float64x2_t xz = vdupq_n_f64(x[2]);
+  const float64x2_t factor = vdupq_n_f64(kFactor);
+  const float64x2_t limit2_v = vdupq_n_f64(limit2);
+  for (; i + 2 <= n; i += 2) {
+    const float64x2_t dx = vsubq_f64(xx, vld1q_f64(points.x.data() + i));
+    const float64x2_t dy = vsubq_f64(xy, vld1q_f64(points.y.data() + i));
+    const float64x2_t dz = vsubq_f64(xz, vld1q_f64(points.z.data() + i));
+    float64x2_t dist2 = vmulq_f64(dx, dx);
+    dist2 = vaddq_f64(dist2, vmulq_f64(dy, dy));
+    dist2 = vaddq_f64(dist2, vmulq_f64(dz, dz));
+    const uint64x2_t keep = vcltq_f64(vmulq_f64(dist2, factor), limit2_v);
+    if (vgetq_lane_u64(keep, 0)) candidates->push_back(static_cast<int>(i));
+    if (vgetq_lane_u64(keep, 1)) {
+      candidates->push_back(static_cast<int>(i + 1));
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    if ((x - points[i]).Norm2() * kFactor < limit2) {
+      candidates->push_back(static_cast<int>(i));
+    }
+  }
+}
+
 bool UpdateMaxDistance(const S2Point& x, const S2Point& a, const S2Point& b,
                        S1ChordAngle* max_dist) {
   auto dist = max(S1ChordAngle(x, a), S1ChordAngle(x, b));
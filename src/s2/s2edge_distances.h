@@ -23,6 +23,7 @@
 
 #include <cfloat>
 #include <utility>
+#include <vector>
 
 #include "absl/base/macros.h"
 #include "absl/log/absl_check.h"
@@ -31,6 +32,7 @@
 #include "s2/s2edge_crossings.h"
 #include "s2/s2point.h"
 #include "s2/s2pointutil.h"
+#include "s2/s2predicates.h"
 #include "s2/s2predicates_internal.h"
 
 namespace S2 {
@@ -70,6 +72,33 @@ bool IsDistanceLess(const S2Point& x, const S2Point& a, const S2Point& b,
 bool UpdateMinDistance(const S2Point& x, const S2Point& a, const S2Point& b,
                        S1ChordAngle* min_dist);
 
+// Appends to "candidates" the index of every edge (a[i], b[i]) for which
+// UpdateMinDistance(x, a[i], b[i], &min_dist) might return true when
+// min_dist == "limit" (plus possibly a few others).  UpdateMinDistance()
+// returns false for all the remaining edges, for "limit" or any smaller
+// distance, so callers that process edges in order of a decreasing limit can
+// skip them without changing their results.
+//
+// This is faster than calling UpdateMinDistance() on every edge because the
+// squared vertex distances and the conservative test for whether the closest
+// point may lie in the edge interior are vectorized (using AVX2 or NEON when
+// available).  Edges that pass the interior test are always appended.
+//
+// REQUIRES: a.size() == b.size()
+void GetMinDistanceCandidates(const S2Point& x, const s2pred::PointArrays& a,
+                              const s2pred::PointArrays& b,
+                              S1ChordAngle limit, std::vector<int>* candidates);
+
+// Appends to "candidates" the index of every point p[i] for which
+// S1ChordAngle(x, p[i]) might be less than "limit" (plus possibly a few
+// others whose distance is within a few ULPs of "limit").  As with
+// GetMinDistanceCandidates(), the squared distances are computed using AVX2 or
+// NEON when available.
+void GetMinPointDistanceCandidates(const S2Point& x,
+                                   const s2pred::PointArrays& points,
+                                   S1ChordAngle limit,
+                                   std::vector<int>* candidates);
+
 // If the maximum distance from X to the edge AB is greater than "max_dist",
 // this method updates "max_dist" and returns true.  Otherwise it returns false.
 // The case A == B is handled correctly.
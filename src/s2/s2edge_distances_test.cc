@@ -17,12 +17,14 @@
 
 #include "s2/s2edge_distances.h"
 
+#include <algorithm>
 #include <cmath>
 
 #include <limits>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -44,6 +46,7 @@
 using absl::string_view;
 using std::string;
 using std::unique_ptr;
+using std::vector;
 
 namespace {
 
@@ -213,6 +216,73 @@ TEST(S2, UpdateMinInteriorDistanceRejectionTestIsConservative) {
   }
 }
 
+TEST(S2, GetMinDistanceCandidates) {
+  // Checks that every edge for which UpdateMinDistance() returns true is a
+  // candidate, using edges of many different lengths and distances
+  // (including the nearly antipodal edges above).
+  S2Testing::rnd.Reset(1);
+  for (int iter = 0; iter < 200; ++iter) {
+    const S2Point x = S2Testing::RandomPoint();
+    const int num_edges = S2Testing::rnd.Uniform(40);
+    vector<double> coords[6];
+    for (int i = 0; i < num_edges; ++i) {
+      S2Point a = S2Testing::SamplePoint(S2Cap(
+          x, S1Angle::Radians(M_PI * pow(1e-10, S2Testing::rnd.RandDouble()))));
+      S2Point b = S2Testing::SamplePoint(S2Cap(
+          a, S1Angle::Radians(M_PI * pow(1e-10, S2Testing::rnd.RandDouble()))));
+      if (S2Testing::rnd.OneIn(10)) b = -a;
+      for (int j = 0; j < 3; ++j) {
+        coords[j].push_back(a[j]);
+        coords[3 + j].push_back(b[j]);
+      }
+    }
+    const s2pred::PointArrays a{coords[0], coords[1], coords[2]};
+    const s2pred::PointArrays b{coords[3], coords[4], coords[5]};
+    const S1ChordAngle limit = S1ChordAngle::Radians(
+        M_PI * pow(1e-12, S2Testing::rnd.RandDouble()));
+    vector<int> candidates = {-1};  // Results are appended.
+    S2::GetMinDistanceCandidates(x, a, b, limit, &candidates);
+    ASSERT_EQ(-1, candidates[0]);
+    ASSERT_TRUE(std::is_sorted(candidates.begin(), candidates.end()));
+    int num_updated = 0;
+    for (int i = 0; i < num_edges; ++i) {
+      S1ChordAngle min_dist = limit;
+      if (S2::UpdateMinDistance(x, a[i], b[i], &min_dist)) {
+        ++num_updated;
+        EXPECT_TRUE(std::binary_search(candidates.begin(), candidates.end(), i))
+            << "Edge " << i << " is closer than " << limit;
+      }
+    }
+    EXPECT_GE(candidates.size() - 1, num_updated);
+  }
+}
+
+TEST(S2, GetMinPointDistanceCandidates) {
+  S2Testing::rnd.Reset(1);
+  for (int iter = 0; iter < 200; ++iter) {
+    const S2Point x = S2Testing::RandomPoint();
+    const int num_points = S2Testing::rnd.Uniform(40);
+    vector<double> coords[3];
+    for (int i = 0; i < num_points; ++i) {
+      S2Point p = S2Testing::SamplePoint(S2Cap(
+          x, S1Angle::Radians(M_PI * pow(1e-10, S2Testing::rnd.RandDouble()))));
+      for (int j = 0; j < 3; ++j) coords[j].push_back(p[j]);
+    }
+    const s2pred::PointArrays points{coords[0], coords[1], coords[2]};
+    const S1ChordAngle limit = S1ChordAngle::Radians(
+        M_PI * pow(1e-12, S2Testing::rnd.RandDouble()));
+    vector<int> candidates;
+    S2::GetMinPointDistanceCandidates(x, points, limit, &candidates);
+    ASSERT_TRUE(std::is_sorted(candidates.begin(), candidates.end()));
+    for (int i = 0; i < num_points; ++i) {
+      if (S1ChordAngle(x, points[i]) < limit) {
+        EXPECT_TRUE(std::binary_search(candidates.begin(), candidates.end(), i))
+            << "Point " << i << " is closer than " << limit;
+      }
+    }
+  }
+}
+
 void CheckMaxDistance(S2Point x, S2Point a, S2Point b,
                       double distance_radians) {
   x = x.Normalize();
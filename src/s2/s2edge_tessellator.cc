@@ -18,18 +18,25 @@
 #include "s2/s2edge_tessellator.h"
 
 #include <algorithm>
+#include <atomic>
+#include <thread>
 #include <vector>
 
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
+#include "absl/types/span.h"
 #include "s2/r2.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s2edge_distances.h"
 #include "s2/s2point.h"
+#include "s2/s2point_span.h"
 #include "s2/s2pointutil.h"
 #include "s2/s2projections.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
 
+using absl::Span;
 using std::vector;
 // Tessellation is implemented by subdividing the edge until the estimated
 // maximum error is below the given tolerance.  Estimating error is a hard
@@ -226,25 +233,26 @@ void S2EdgeTessellator::AppendProjected(
     ABSL_DCHECK_EQ(vertices->back(), pa) << "Appended edges must form a chain";
   }
   R2Point pb = proj_.Project(b);
-  AppendProjected(pa, a, pb, b, vertices);
+  AppendProjected(pa, a, pb, b,
+                  [vertices](const R2Point& p) { vertices->push_back(p); });
 }
 
-// Given a geodesic edge AB, split the edge as necessary and append all
-// projected vertices except the first to "vertices".
+// Given a geodesic edge AB, split the edge as necessary and pass all
+// projected vertices except the first to "visitor".
 //
 // The maximum recursion depth is (M_PI / kMinTolerance()) < 45, and the
 // frame size is small so stack overflow should not be an issue.
 void S2EdgeTessellator::AppendProjected(const R2Point& pa, const S2Point& a,
                                         const R2Point& pb_in, const S2Point& b,
-                                        vector<R2Point>* vertices) const {
+                                        R2PointVisitor visitor) const {
   R2Point pb = proj_.WrapDestination(pa, pb_in);
   if (EstimateMaxError(pa, a, pb, b) <= scaled_tolerance_) {
-    vertices->push_back(pb);
+    visitor(pb);
   } else {
     S2Point mid = (a + b).Normalize();
     R2Point pmid = proj_.WrapDestination(pa, proj_.Project(mid));
-    AppendProjected(pa, a, pmid, mid, vertices);
-    AppendProjected(pmid, mid, pb, b, vertices);
+    AppendProjected(pa, a, pmid, mid, visitor);
+    AppendProjected(pmid, mid, pb, b, visitor);
   }
 }
 
@@ -263,22 +271,127 @@ void S2EdgeTessellator::AppendUnprojected(
     ABSL_DCHECK(S2::ApproxEquals(vertices->back(), a))
         << "Appended edges must form a chain";
   }
-  AppendUnprojected(pa, a, pb, b, vertices);
+  AppendUnprojected(pa, a, pb, b,
+                    [vertices](const S2Point& p) { vertices->push_back(p); });
 }
 
-// Like AppendProjected, but interpolates a projected edge and appends the
-// corresponding points on the sphere.
+// Like AppendProjected, but interpolates a projected edge and passes the
+// corresponding points on the sphere to "visitor".
 void S2EdgeTessellator::AppendUnprojected(
     const R2Point& pa, const S2Point& a,
-    const R2Point& pb_in, const S2Point& b, vector<S2Point>* vertices) const {
+    const R2Point& pb_in, const S2Point& b, S2PointVisitor visitor) const {
   // See notes above regarding measuring the interpolation error.
   R2Point pb = proj_.WrapDestination(pa, pb_in);
   if (EstimateMaxError(pa, a, pb, b) <= scaled_tolerance_) {
-    vertices->push_back(b);
+    visitor(b);
   } else {
     R2Point pmid = proj_.Interpolate(0.5, pa, pb);
     S2Point mid = proj_.Unproject(pmid);
-    AppendUnprojected(pa, a, pmid, mid, vertices);
-    AppendUnprojected(pmid, mid, pb, b, vertices);
+    AppendUnprojected(pa, a, pmid, mid, visitor);
+    AppendUnprojected(pmid, mid, pb, b, visitor);
   }
 }
+
+// Tessellates the chain vertex(0), ..., vertex(n-1).  Each vertex is
+// projected once, and the last output vertex of each edge (which has been
+// wrapped to be close to its predecessor) is used as the start of the next
+// edge, just as AppendProjected() does with vertices->back().
+template <class VertexFunction>
+void S2EdgeTessellator::VisitProjected(int n, const VertexFunction& vertex,
+                                       R2PointVisitor visitor) const {
+  if (n == 0) return;
+  S2Point a = vertex(0);
+  R2Point pa = proj_.Project(a);
+  visitor(pa);
+  R2Point last = pa;
+  for (int i = 1; i < n; ++i) {
+    S2Point b = vertex(i);
+    AppendProjected(pa, a, proj_.Project(b), b, [&](const R2Point& p) {
+      last = p;
+      visitor(p);
+    });
+    a = b;
+    pa = last;
+  }
+}
+
+void S2EdgeTessellator::VisitProjected(S2PointSpan vertices,
+                                       R2PointVisitor visitor) const {
+  VisitProjected(
+      vertices.size(), [vertices](int i) { return vertices[i]; }, visitor);
+}
+
+void S2EdgeTessellator::VisitUnprojected(Span<const R2Point> vertices,
+                                         S2PointVisitor visitor) const {
+  if (vertices.empty()) return;
+  S2Point a = proj_.Unproject(vertices[0]);
+  visitor(a);
+  for (int i = 1; i < vertices.size(); ++i) {
+    S2Point b = proj_.Unproject(vertices[i]);
+    AppendUnprojected(vertices[i - 1], a, vertices[i], b, visitor);
+    a = b;
+  }
+}
+
+void S2EdgeTessellator::ProjectShape(const S2Shape& shape, int shape_id,
+                                     ProjectedChainVisitor visitor) const {
+  vector<R2Point> buffer;
+  ProjectShape(shape, shape_id, visitor, &buffer);
+}
+
+void S2EdgeTessellator::ProjectShape(const S2Shape& shape, int shape_id,
+                                     ProjectedChainVisitor visitor,
+                                     vector<R2Point>* buffer) const {
+  auto emit = [buffer](const R2Point& p) { buffer->push_back(p); };
+  for (int i = 0; i < shape.num_chains(); ++i) {
+    buffer->clear();
+    const int length = shape.chain(i).length;
+    if (shape.dimension() == 0) {
+      for (int j = 0; j < length; ++j) {
+        buffer->push_back(proj_.Project(shape.chain_edge(i, j).v0));
+      }
+    } else if (length > 0) {
+      // A chain of "length" edges has length + 1 vertices, where the last
+      // vertex of a closed chain is the same as the first.
+      S2PointSpan v = shape.chain_vertex_span(i);
+      if (!v.empty()) {
+        const int n = v.size();
+        VisitProjected(
+            length + 1, [v, n](int j) { return v[j == n ? 0 : j]; }, emit);
+      } else {
+        VisitProjected(
+            length + 1,
+            [&shape, i](int j) {
+              return j == 0 ? shape.chain_edge(i, 0).v0
+                            : shape.chain_edge(i, j - 1).v1;
+            },
+            emit);
+      }
+    }
+    visitor(shape_id, i, *buffer);
+  }
+}
+
+void S2EdgeTessellator::ProjectIndex(const S2ShapeIndex& index,
+                                     ProjectedChainVisitor visitor,
+                                     int num_threads) const {
+  const int num_shape_ids = index.num_shape_ids();
+  num_threads = std::min(std::max(num_threads, 1), num_shape_ids);
+  // Each thread claims the next unprocessed shape, so that a few large
+  // shapes do not leave the other threads idle.
+  std::atomic<int> next_shape_id(0);
+  auto project_shapes = [&]() {
+    vector<R2Point> buffer;
+    for (int id; (id = next_shape_id++) < num_shape_ids;) {
+      const S2Shape* shape = index.shape(id);
+      if (shape != nullptr) ProjectShape(*shape, id, visitor, &buffer);
+    }
+  };
+  if (num_threads <= 1) {
+    project_shapes();
+    return;
+  }
+  vector<std::thread> threads;
+  for (int i = 0; i < num_threads; ++i) threads.emplace_back(project_shapes);
+  for (auto& thread : threads) thread.join();
+}
@@ -20,11 +20,16 @@
 
 #include <vector>
 
+#include "absl/functional/function_ref.h"
+#include "absl/types/span.h"
 #include "s2/r2.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s2point.h"
+#include "s2/s2point_span.h"
 #include "s2/s2projections.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
 
 // Given an edge in some 2D projection (e.g., Mercator), S2EdgeTessellator
 // converts the edge into a chain of spherical geodesic edges such that the
@@ -77,6 +82,45 @@ class S2EdgeTessellator {
   void AppendUnprojected(const R2Point& a, const R2Point& b,
                          std::vector<S2Point>* vertices) const;
 
+  // Callbacks that receive output vertices one at a time.
+  using R2PointVisitor = absl::FunctionRef<void(const R2Point&)>;
+  using S2PointVisitor = absl::FunctionRef<void(const S2Point&)>;
+
+  // Converts the chain of spherical geodesic edges with the given vertices to
+  // a chain of planar edges and passes each output vertex to "visitor" in
+  // order.  The vertices visited are exactly those that calling
+  // AppendProjected() on each edge of the chain would append to an empty
+  // vector, but nothing is stored and each input vertex is projected only
+  // once.  If "vertices" contains a single point, only its projection is
+  // visited.
+  void VisitProjected(S2PointSpan vertices, R2PointVisitor visitor) const;
+
+  // Like VisitProjected, but converts a chain of planar edges to spherical
+  // geodesics (see AppendUnprojected).
+  void VisitUnprojected(absl::Span<const R2Point> vertices,
+                        S2PointVisitor visitor) const;
+
+  // Receives the projected vertices of edge chain "chain_id" of shape
+  // "shape_id".  The "vertices" span is only valid during the call.
+  using ProjectedChainVisitor = absl::FunctionRef<void(
+      int shape_id, int chain_id, absl::Span<const R2Point> vertices)>;
+
+  // Projects every edge chain of the given shape and passes the results to
+  // "visitor" one chain at a time, reusing a single vertex buffer.  The
+  // chains of polygons include their closing edge, so that the last vertex
+  // of each loop matches the first (up to coordinate wrapping).  Each chain
+  // of a point shape yields its single projected point, and chains with no
+  // edges yield no vertices.
+  void ProjectShape(const S2Shape& shape, int shape_id,
+                    ProjectedChainVisitor visitor) const;
+
+  // Like ProjectShape(), but projects every shape of "index".  The shapes are
+  // divided among up to "num_threads" threads, in which case "visitor" may be
+  // called concurrently from several threads and must be thread-safe.  All
+  // chains of a given shape are visited in order by a single thread.
+  void ProjectIndex(const S2ShapeIndex& index, ProjectedChainVisitor visitor,
+                    int num_threads = 1) const;
+
   // Returns the minimum supported tolerance (which corresponds to a distance
   // less than one micrometer on the Earth's surface).
   static S1Angle kMinTolerance();
@@ -87,11 +131,19 @@ class S2EdgeTessellator {
 
   void AppendUnprojected(const R2Point& pa, const S2Point& a,
                          const R2Point& pb, const S2Point& b,
-                         std::vector<S2Point>* vertices) const;
+                         S2PointVisitor visitor) const;
 
   void AppendProjected(const R2Point& pa, const S2Point& a,
                        const R2Point& pb, const S2Point& b,
-                       std::vector<R2Point>* vertices) const;
+                       R2PointVisitor visitor) const;
+
+  template <class VertexFunction>
+  void VisitProjected(int n, const VertexFunction& vertex,
+                      R2PointVisitor visitor) const;
+
+  void ProjectShape(const S2Shape& shape, int shape_id,
+                    ProjectedChainVisitor visitor,
+                    std::vector<R2Point>* buffer) const;
 
   const S2::Projection& proj_;
 
@@ -29,6 +29,7 @@
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
 #include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
 
 #include "s2/base/log_severity.h"
 #include "s2/r2.h"
@@ -38,6 +39,7 @@
 #include "s2/s2latlng.h"
 #include "s2/s2point.h"
 #include "s2/s2projections.h"
+#include "s2/s2shape.h"
 #include "s2/s2testing.h"
 #include "s2/s2text_format.h"
 
@@ -268,6 +270,73 @@ TEST(S2EdgeTessellator, ProjectedWrappingMultipleCrossings) {
   EXPECT_EQ(640, max_lng);
 }
 
+TEST(S2EdgeTessellator, VisitProjectedMatchesAppendProjected) {
+  auto loop = ParsePointsOrDie("0:160, 0:-40, 0:120, 0:-80, 10:120, "
+                               "10:-40, 0:160");
+  S2::PlateCarreeProjection proj(180);
+  S2EdgeTessellator tess(&proj, S1Angle::E7(1));
+  vector<R2Point> expected, actual;
+  for (int i = 0; i + 1 < loop.size(); ++i) {
+    tess.AppendProjected(loop[i], loop[i + 1], &expected);
+  }
+  tess.VisitProjected(loop, [&](const R2Point& p) { actual.push_back(p); });
+  EXPECT_EQ(expected, actual);
+}
+
+TEST(S2EdgeTessellator, VisitUnprojectedMatchesAppendUnprojected) {
+  vector<R2Point> chain;
+  for (double lat = 1; lat <= 60; ++lat) {
+    chain.push_back(R2Point(180 - 0.03 * lat, lat));
+    chain.push_back(R2Point(-180 + 0.07 * lat, lat));
+  }
+  S2::PlateCarreeProjection proj(180);
+  S2EdgeTessellator tess(&proj, S1Angle::Degrees(0.01));
+  vector<S2Point> expected, actual;
+  for (int i = 0; i + 1 < chain.size(); ++i) {
+    tess.AppendUnprojected(chain[i], chain[i + 1], &expected);
+  }
+  tess.VisitUnprojected(chain, [&](const S2Point& p) { actual.push_back(p); });
+  EXPECT_EQ(expected, actual);
+}
+
+TEST(S2EdgeTessellator, ProjectIndex) {
+  auto index = s2textformat::MakeIndexOrDie(
+      "0:0 | 10:170 # 0:160, 0:-40, 10:120 # 0:0, 0:10, 10:10; "
+      "20:170, 20:-170, 30:-170, 30:170");
+  S2::PlateCarreeProjection proj(180);
+  S2EdgeTessellator tess(&proj, S1Angle::Degrees(0.01));
+
+  // Build the expected chains using AppendProjected.
+  vector<vector<vector<R2Point>>> expected(index->num_shape_ids());
+  for (int id = 0; id < index->num_shape_ids(); ++id) {
+    const S2Shape& shape = *index->shape(id);
+    for (int i = 0; i < shape.num_chains(); ++i) {
+      vector<R2Point> vertices;
+      for (int j = 0; j < shape.chain(i).length; ++j) {
+        S2Shape::Edge e = shape.chain_edge(i, j);
+        if (shape.dimension() == 0) {
+          vertices.push_back(proj.Project(e.v0));
+        } else {
+          tess.AppendProjected(e.v0, e.v1, &vertices);
+        }
+      }
+      expected[id].push_back(vertices);
+    }
+  }
+  for (int num_threads : {1, 3}) {
+    vector<vector<vector<R2Point>>> actual(index->num_shape_ids());
+    tess.ProjectIndex(
+        *index,
+        [&](int shape_id, int chain_id, absl::Span<const R2Point> vertices) {
+          // Each shape is written by a single thread, in chain order.
+          EXPECT_EQ(chain_id, actual[shape_id].size());
+          actual[shape_id].emplace_back(vertices.begin(), vertices.end());
+        },
+        num_threads);
+    EXPECT_EQ(expected, actual);
+  }
+}
+
 TEST(S2EdgeTessellator, InfiniteRecursionBug) {
   S2::PlateCarreeProjection proj(180);
   S1Angle kOneMicron = S1Angle::Radians(1e-6 / 6371.0);
@@ -0,0 +1,71 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2encoding_sink.h"
+
+#include <cerrno>
+#include <cstddef>
+
+#include <utility>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "absl/strings/string_view.h"
+#include "s2/util/coding/coder.h"
+
+using absl::string_view;
+
+S2EncodingSink::~S2EncodingSink() = default;
+
+S2CallbackSink::S2CallbackSink(Callback callback)
+    : callback_(std::move(callback)) {
+}
+
+bool S2CallbackSink::Append(string_view data) {
+  return callback_(data);
+}
+
+#ifndef _WIN32
+S2FileDescriptorSink::S2FileDescriptorSink(int fd) : fd_(fd) {
+}
+
+bool S2FileDescriptorSink::Append(string_view data) {
+  while (!data.empty()) {
+    ssize_t n = write(fd_, data.data(), data.size());
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data.remove_prefix(n);
+  }
+  return true;
+}
+#endif
+
+S2SinkEncoder::S2SinkEncoder(S2EncodingSink* sink, size_t chunk_size)
+    : sink_(sink), chunk_size_(chunk_size) {
+}
+
+bool S2SinkEncoder::Flush() {
+  if (ok_ && buffer_.length() > 0) {
+    ok_ = sink_->Append(string_view(buffer_.base(), buffer_.length()));
+    if (ok_) bytes_flushed_ += buffer_.length();
+  }
+  // The buffer is discarded even on errors so that memory stays bounded.
+  buffer_.clear();
+  return ok_;
+}
@@ -0,0 +1,118 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2ENCODING_SINK_H_
+#define S2_S2ENCODING_SINK_H_
+
+#include <cstddef>
+
+#include <functional>
+
+#include "absl/strings/string_view.h"
+#include "s2/base/types.h"
+#include "s2/util/coding/coder.h"
+
+// S2EncodingSink is an interface for receiving encoded data incrementally.
+// It allows very large objects (such as a MutableS2ShapeIndex) to be encoded
+// without holding the entire encoding in memory.  For example:
+//
+//   S2FileDescriptorSink sink(fd);
+//   if (!s2shapeutil::CompactEncodeTaggedShapes(index, &sink) ||
+//       !index.Encode(&sink)) { ... }
+//
+// The output is identical to the corresponding methods that write to an
+// Encoder.
+class S2EncodingSink {
+ public:
+  virtual ~S2EncodingSink();
+
+  // Appends the given bytes to the output.  Returns false if an error
+  // occurred, in which case no further data will be appended.
+  virtual bool Append(absl::string_view data) = 0;
+};
+
+// An S2EncodingSink that passes each chunk of data to a callback function.
+class S2CallbackSink final : public S2EncodingSink {
+ public:
+  using Callback = std::function<bool(absl::string_view)>;
+
+  explicit S2CallbackSink(Callback callback);
+  bool Append(absl::string_view data) override;
+
+ private:
+  Callback callback_;
+};
+
+#ifndef _WIN32
+// An S2EncodingSink that writes to a file descriptor (which is not owned).
+class S2FileDescriptorSink final : public S2EncodingSink {
+ public:
+  explicit S2FileDescriptorSink(int fd);
+  bool Append(absl::string_view data) override;
+
+ private:
+  int fd_;
+};
+#endif
+
+// S2SinkEncoder accumulates output in an Encoder and passes it to an
+// S2EncodingSink in chunks of approximately "chunk_size" bytes, so that the
+// memory used is proportional to the chunk size rather than to the size of
+// the output.  Typical usage:
+//
+//   S2SinkEncoder out(sink);
+//   for (...) {
+//     Encoder* encoder = out.encoder();
+//     encoder->Ensure(...);
+//     ...
+//     if (!out.MaybeFlush()) return false;
+//   }
+//   return out.Flush();
+class S2SinkEncoder {
+ public:
+  static constexpr size_t kDefaultChunkSize = 1 << 20;
+
+  explicit S2SinkEncoder(S2EncodingSink* sink,
+                         size_t chunk_size = kDefaultChunkSize);
+
+  S2SinkEncoder(const S2SinkEncoder&) = delete;
+  void operator=(const S2SinkEncoder&) = delete;
+
+  // Returns the Encoder where output should be written.  The Encoder uses
+  // the default constructor, so its buffer can be enlarged using Ensure().
+  Encoder* encoder() { return &buffer_; }
+
+  // Passes the buffered output to the sink if it is at least chunk_size
+  // bytes long.  Returns false if the sink has reported an error.
+  bool MaybeFlush() {
+    return buffer_.length() < chunk_size_ ? ok_ : Flush();
+  }
+
+  // Passes all buffered output to the sink.  Returns false if the sink has
+  // reported an error.
+  bool Flush();
+
+  // Returns the total number of bytes passed to the sink so far.
+  uint64 bytes_flushed() const { return bytes_flushed_; }
+
+ private:
+  S2EncodingSink* sink_;
+  size_t chunk_size_;
+  Encoder buffer_;
+  uint64 bytes_flushed_ = 0;
+  bool ok_ = true;
+};
+
+#endif  // S2_S2ENCODING_SINK_H_
@@ -0,0 +1,132 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2encoding_sink.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/strings/string_view.h"
+#include "s2/util/coding/coder.h"
+#include "s2/encoded_s2cell_id_vector.h"
+#include "s2/encoded_string_vector.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2testing.h"
+
+using absl::string_view;
+using std::string;
+using std::vector;
+
+namespace {
+
+TEST(S2SinkEncoder, FlushesInChunks) {
+  vector<string> chunks;
+  S2CallbackSink sink([&chunks](string_view data) {
+    chunks.emplace_back(data);
+    return true;
+  });
+  S2SinkEncoder out(&sink, 10);
+  for (int i = 0; i < 25; ++i) {
+    out.encoder()->Ensure(1);
+    out.encoder()->put8('a' + i);
+    EXPECT_TRUE(out.MaybeFlush());
+  }
+  EXPECT_TRUE(out.Flush());
+  EXPECT_EQ(out.bytes_flushed(), 25);
+  ASSERT_EQ(chunks.size(), 3);
+  EXPECT_EQ(chunks[0], "abcdefghij");
+  EXPECT_EQ(chunks[2], "uvwxy");
+}
+
+TEST(S2SinkEncoder, SinkError) {
+  int num_calls = 0;
+  S2CallbackSink sink([&num_calls](string_view data) {
+    ++num_calls;
+    return false;
+  });
+  S2SinkEncoder out(&sink, 1);
+  out.encoder()->Ensure(2);
+  out.encoder()->put16(7);
+  EXPECT_FALSE(out.MaybeFlush());
+  out.encoder()->Ensure(2);
+  out.encoder()->put16(7);
+  EXPECT_FALSE(out.Flush());
+  EXPECT_EQ(num_calls, 1);  // The sink is not called again after an error.
+  EXPECT_EQ(out.bytes_flushed(), 0);
+  EXPECT_EQ(out.encoder()->length(), 0);
+}
+
+#ifndef _WIN32
+TEST(S2FileDescriptorSink, WritesFile) {
+  std::FILE* file = std::tmpfile();
+  ASSERT_NE(file, nullptr);
+  S2FileDescriptorSink sink(fileno(file));
+  EXPECT_TRUE(sink.Append("hello, "));
+  EXPECT_TRUE(sink.Append("world"));
+  std::rewind(file);
+  char buf[32] = {};
+  EXPECT_EQ(std::fread(buf, 1, sizeof(buf), file), 12);
+  EXPECT_EQ(string(buf), "hello, world");
+  std::fclose(file);
+}
+#endif
+
+TEST(S2CellIdVectorStreamEncoder, MatchesEncodeS2CellIdVector) {
+  for (int iter = 0; iter < 50; ++iter) {
+    vector<S2CellId> ids;
+    int n = S2Testing::rnd.Uniform(100);
+    int level = S2Testing::rnd.Uniform(S2CellId::kMaxLevel + 1);
+    for (int i = 0; i < n; ++i) {
+      // Sometimes use a single level, since this has a special encoding.
+      ids.push_back(iter % 2 ? S2Testing::GetRandomCellId(level)
+                             : S2Testing::GetRandomCellId());
+    }
+    Encoder expected;
+    s2coding::EncodeS2CellIdVector(ids, &expected);
+
+    s2coding::S2CellIdVectorStreamEncoder stream;
+    for (S2CellId id : ids) stream.Measure(id);
+    Encoder actual;
+    stream.EncodeHeader(&actual);
+    for (S2CellId id : ids) stream.Encode(id, &actual);
+    EXPECT_EQ(string_view(expected.base(), expected.length()),
+              string_view(actual.base(), actual.length()));
+  }
+}
+
+TEST(StringVectorStreamEncoder, MatchesStringVectorEncoder) {
+  vector<string> strings = {"", "a", string(300, 'b'), "", "cd"};
+  for (size_t n = 0; n <= strings.size(); ++n) {
+    vector<string> v(strings.begin(), strings.begin() + n);
+    Encoder expected;
+    s2coding::StringVectorEncoder::Encode(v, &expected);
+
+    s2coding::StringVectorStreamEncoder stream;
+    for (const string& str : v) stream.AddLength(str.size());
+    Encoder actual;
+    stream.EncodeHeader(&actual);
+    for (const string& str : v) stream.EncodeOffset(str.size(), &actual);
+    for (const string& str : v) {
+      actual.Ensure(str.size());
+      actual.putn(str.data(), str.size());
+    }
+    EXPECT_EQ(string_view(expected.base(), expected.length()),
+              string_view(actual.base(), actual.length()));
+  }
+}
+
+}  // namespace
@@ -0,0 +1,209 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2flat_shape_index.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "s2/base/executor.h"
+#include "s2/base/types.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2point.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+
+using std::vector;
+
+// The maximum error in computing (A x B) . C for unit-length vectors when
+// the result is rounded to double precision (see s2pred::TriageSign).
+static constexpr double kMaxDetError = 3.6548 * DBL_EPSILON;
+
+// The maximum distance that rounding the coordinates of a unit-length
+// vertex to single precision moves it.  (This is 2**-24, rounded up to
+// allow for vertices that are not exactly unit length.)
+static constexpr double kMaxVertexError = 6e-8;
+
+S2FlatShapeIndex::S2FlatShapeIndex(const S2ShapeIndex* index)
+    : index_(index) {
+  arrays_.cell_clipped_begin.push_back(0);
+  arrays_.clipped_edge_begin.push_back(0);
+  for (S2ShapeIndex::Iterator it(index, S2ShapeIndex::BEGIN); !it.done();
+       it.Next()) {
+    const size_t num_clipped = arrays_.clipped_shape_ids.size();
+    for (const S2ClippedShape& clipped : it.cell().clipped_shapes()) {
+      const S2Shape* shape = index->shape(clipped.shape_id());
+      if (shape == nullptr || shape->dimension() != 2) continue;
+      arrays_.clipped_shape_ids.push_back(clipped.shape_id());
+      arrays_.clipped_contains_center.push_back(clipped.contains_center());
+      for (int i = 0; i < clipped.num_edges(); ++i) {
+        S2Shape::Edge edge = shape->edge(clipped.edge(i));
+        for (const S2Point* v : {&edge.v0, &edge.v1}) {
+          for (int j = 0; j < 3; ++j) {
+            arrays_.edge_vertices.push_back(static_cast<float>((*v)[j]));
+          }
+        }
+      }
+      arrays_.clipped_edge_begin.push_back(arrays_.edge_vertices.size() / 6);
+    }
+    if (arrays_.clipped_shape_ids.size() == num_clipped) continue;
+    arrays_.cell_ids.push_back(it.id().id());
+    S2Point center = it.id().ToPoint();
+    for (int j = 0; j < 3; ++j) arrays_.cell_centers.push_back(center[j]);
+    arrays_.cell_clipped_begin.push_back(arrays_.clipped_shape_ids.size());
+  }
+}
+
+size_t S2FlatShapeIndex::SpaceUsed() const {
+  return sizeof(*this) +
+         arrays_.cell_ids.capacity() * sizeof(uint64) +
+         arrays_.cell_centers.capacity() * sizeof(double) +
+         arrays_.cell_clipped_begin.capacity() * sizeof(uint32) +
+         arrays_.clipped_shape_ids.capacity() * sizeof(int32) +
+         arrays_.clipped_contains_center.capacity() * sizeof(uint8) +
+         arrays_.clipped_edge_begin.capacity() * sizeof(uint32) +
+         arrays_.edge_vertices.capacity() * sizeof(float);
+}
+
+/* static */
+int S2FlatShapeIndex::LocateCell(const Arrays& arrays, S2CellId leaf_id) {
+  // Find the last cell whose range begins at or before "leaf_id".  Since the
+  // cells are disjoint, it is the only cell that may contain "leaf_id".
+  const uint64 target = leaf_id.id();
+  int lo = 0, hi = static_cast<int>(arrays.cell_ids.size());
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    const uint64 id = arrays.cell_ids[mid];
+    const uint64 range_min = id - ((id & (~id + 1)) - 1);
+    if (range_min <= target) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == 0) return -1;
+  const uint64 id = arrays.cell_ids[lo - 1];
+  const uint64 range_max = id + ((id & (~id + 1)) - 1);
+  return target <= range_max ? lo - 1 : -1;
+}
+
+/* static */
+S2FlatShapeIndex::Containment S2FlatShapeIndex::ClippedContains(
+    const Arrays& arrays, int cell, int clipped, const S2Point& p) {
+  bool inside = arrays.clipped_contains_center[clipped] != 0;
+  const uint32 begin = arrays.clipped_edge_begin[clipped];
+  const uint32 end = arrays.clipped_edge_begin[clipped + 1];
+
+  // Count the edges crossed by the segment AB from the cell center to "p".
+  // Two edges cross if and only if Sign(ACB) == Sign(BDA) == Sign(CBD) ==
+  // Sign(DAC) (see S2EdgeCrosser).  The determinants are computed using the
+  // rounded vertices C and D, and the result is uncertain whenever one of
+  // them might have the wrong sign.
+  const double* a_coords = &arrays.cell_centers[3 * cell];
+  const S2Point a(a_coords[0], a_coords[1], a_coords[2]);
+  const S2Point a_cross_b = a.CrossProd(p);
+  const double ab_error = kMaxDetError + kMaxVertexError * a_cross_b.Norm();
+  for (uint32 k = begin; k < end; ++k) {
+    const float* v = &arrays.edge_vertices[6 * k];
+    const S2Point c(v[0], v[1], v[2]), d(v[3], v[4], v[5]);
+    const double abc = a_cross_b.DotProd(c);
+    const double abd = a_cross_b.DotProd(d);
+    if ((abc > ab_error && abd > ab_error) ||
+        (abc < -ab_error && abd < -ab_error)) {
+      continue;  // C and D are on the same side of AB.
+    }
+    if (std::fabs(abc) <= ab_error || std::fabs(abd) <= ab_error) {
+      return Containment::UNCERTAIN;
+    }
+    // Rounding C and D by errors "dc" and "dd" changes (C x D) . A by
+    // dc . (D x A) + dd . (A x C) + (dc x dd) . A, which is small when the
+    // edges are short since |D x A| <= |D - A|.  Computing C x D from
+    // single-precision coordinates adds at most a few DBL_EPSILON.
+    const S2Point c_cross_d = c.CrossProd(d);
+    const double cda = c_cross_d.DotProd(a);
+    const double cda_error =
+        8 * DBL_EPSILON + kMaxVertexError * ((c - a).Norm() + (d - a).Norm() +
+                                             3 * kMaxVertexError);
+    if (std::fabs(cda) <= cda_error) return Containment::UNCERTAIN;
+    const double cdb = c_cross_d.DotProd(p);
+    const double cdb_error =
+        8 * DBL_EPSILON + kMaxVertexError * ((c - p).Norm() + (d - p).Norm() +
+                                             3 * kMaxVertexError);
+    if (std::fabs(cdb) <= cdb_error) return Containment::UNCERTAIN;
+    // Since Sign(ACB) == -Sign(ABC) and Sign(BDA) == Sign(ABD) have opposite
+    // signs, the edges cross if Sign(DAC) == Sign(CDA) equals Sign(ABD) and
+    // Sign(CBD) == -Sign(CDB) equals -Sign(ABC).
+    if ((cda > 0) == (abd > 0) && (cdb > 0) == (abc > 0)) inside = !inside;
+  }
+  return inside ? Containment::INSIDE : Containment::OUTSIDE;
+}
+
+void S2FlatShapeIndex::GetContainingShapeIds(
+    absl::Span<const S2Point> points, S2ContainsPointBatchResult* result,
+    int num_threads) const {
+  // Each shard of points appends its shape ids to its own vector, so that
+  // the results are independent of how the shards are scheduled.
+  const int num_points = static_cast<int>(points.size());
+  const int num_shards = (num_points + kPointsPerShard - 1) / kPointsPerShard;
+  vector<int> counts(num_points);
+  vector<vector<int>> shard_ids(num_shards);
+  std::atomic<int> next_shard(0);
+  num_threads = std::min(std::max(num_threads, 1), std::max(num_shards, 1));
+  s2base::RunConcurrently(nullptr, num_threads, [&]() {
+    // Uncertain cases are decided exactly using the original index.
+    S2ContainsPointQuery<S2ShapeIndex> query(index_);
+    int shard;
+    while ((shard = next_shard.fetch_add(1)) < num_shards) {
+      int end = std::min((shard + 1) * kPointsPerShard, num_points);
+      for (int i = shard * kPointsPerShard; i < end; ++i) {
+        const S2Point& p = points[i];
+        const int cell = LocateCell(arrays_, S2CellId(p));
+        if (cell < 0) continue;
+        for (uint32 c = arrays_.cell_clipped_begin[cell];
+             c < arrays_.cell_clipped_begin[cell + 1]; ++c) {
+          const int shape_id = arrays_.clipped_shape_ids[c];
+          Containment containment = ClippedContains(arrays_, cell, c, p);
+          if (containment == Containment::UNCERTAIN) {
+            containment = query.ShapeContains(shape_id, p)
+                              ? Containment::INSIDE
+                              : Containment::OUTSIDE;
+          }
+          if (containment == Containment::INSIDE) {
+            shard_ids[shard].push_back(shape_id);
+            ++counts[i];
+          }
+        }
+      }
+    }
+  });
+
+  // The shards are in point order, so the results can simply be
+  // concatenated.
+  result->offsets.resize(num_points + 1);
+  result->offsets[0] = 0;
+  for (int i = 0; i < num_points; ++i) {
+    result->offsets[i + 1] = result->offsets[i] + counts[i];
+  }
+  result->shape_ids.clear();
+  result->shape_ids.reserve(result->offsets[num_points]);
+  for (const vector<int>& ids : shard_ids) {
+    result->shape_ids.insert(result->shape_ids.end(), ids.begin(), ids.end());
+  }
+}
@@ -0,0 +1,119 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2FLAT_SHAPE_INDEX_H_
+#define S2_S2FLAT_SHAPE_INDEX_H_
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "s2/base/types.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2point.h"
+#include "s2/s2shape_index.h"
+
+// S2FlatShapeIndex is a copy of the polygon cells of an S2ShapeIndex (any
+// subtype, e.g. MutableS2ShapeIndex, EncodedS2ShapeIndex, or
+// FrozenS2ShapeIndex) stored in a few flat arrays of plain integers and
+// floating-point numbers, for evaluating very large batches of point
+// containment queries.  The arrays contain no pointers, so they can be
+// copied as-is into the memory of an accelerator (e.g. a GPU) or shared
+// between processes, and the containment test for one point (see
+// LocateCell and ClippedContains) only reads these arrays.
+//
+// The edge vertices are stored in single precision, which halves the
+// memory that must be read or transferred.  The containment test computes
+// the crossing signs using the rounded vertices together with a bound on
+// their error, and reports the (rare) cases where the result is uncertain,
+// e.g. points that are very close to an edge or that coincide with a
+// vertex.  These cases are then decided by S2ContainsPointQuery using the
+// original index and exact predicates, so the results are identical to
+// those of S2ContainsPointQuery with the SEMI_OPEN vertex model.
+//
+// Example usage:
+//
+//   S2FlatShapeIndex flat_index(&index);
+//   S2ContainsPointBatchResult result;
+//   flat_index.GetContainingShapeIds(points, &result, /*num_threads=*/8);
+//
+// Only shapes of dimension 2 are included, since points and polylines do
+// not contain any points in the SEMI_OPEN model.  The index must not be
+// modified while this object is in use.  This class is thread-safe.
+class S2FlatShapeIndex {
+ public:
+  // The flattened cells.  Cell "i" has S2CellId cell_ids[i], its center is
+  // (cell_centers[3*i], cell_centers[3*i+1], cell_centers[3*i+2]), and its
+  // clipped shapes are cell_clipped_begin[i], ...,
+  // cell_clipped_begin[i+1]-1.  Clipped shape "j" has shape id
+  // clipped_shape_ids[j], contains the cell center if
+  // clipped_contains_center[j] is non-zero, and has the edges
+  // clipped_edge_begin[j], ..., clipped_edge_begin[j+1]-1.  The vertices of
+  // edge "k" are edge_vertices[6*k], ..., edge_vertices[6*k+5].  Cells are
+  // sorted by S2CellId and clipped shapes by shape id, as in the index, and
+  // cells without any polygons are omitted.
+  struct Arrays {
+    std::vector<uint64> cell_ids;
+    std::vector<double> cell_centers;
+    std::vector<uint32> cell_clipped_begin;
+    std::vector<int32> clipped_shape_ids;
+    std::vector<uint8> clipped_contains_center;
+    std::vector<uint32> clipped_edge_begin;
+    std::vector<float> edge_vertices;
+  };
+
+  // REQUIRES: "index" is not modified while this object is in use.
+  explicit S2FlatShapeIndex(const S2ShapeIndex* index);
+
+  const S2ShapeIndex& index() const { return *index_; }
+  const Arrays& arrays() const { return arrays_; }
+
+  // Returns the number of bytes used by the arrays.
+  size_t SpaceUsed() const;
+
+  // The result of testing whether a clipped shape contains a point.
+  enum class Containment : uint8 { OUTSIDE, INSIDE, UNCERTAIN };
+
+  // Returns the position in "arrays" of the cell containing the given leaf
+  // cell, or -1 if there is no such cell.
+  static int LocateCell(const Arrays& arrays, S2CellId leaf_id);
+
+  // Returns whether the given clipped shape of the given cell contains "p",
+  // using only the contents of "arrays".  Returns UNCERTAIN if the result
+  // cannot be determined from the single-precision vertices.
+  //
+  // REQUIRES: "p" is contained by the given cell.
+  static Containment ClippedContains(const Arrays& arrays, int cell,
+                                     int clipped, const S2Point& p);
+
+  // Computes the ids of the shapes that contain each of the given points
+  // and stores them in "result" (which is cleared first).  The results are
+  // identical to S2ContainsPointQuery::GetContainingShapeIds() with the
+  // SEMI_OPEN vertex model.  The points are divided into shards that are
+  // processed using up to "num_threads" threads.
+  void GetContainingShapeIds(absl::Span<const S2Point> points,
+                             S2ContainsPointBatchResult* result,
+                             int num_threads = 1) const;
+
+ private:
+  // The number of consecutive points that a thread claims at once in
+  // GetContainingShapeIds().
+  static constexpr int kPointsPerShard = 4096;
+
+  const S2ShapeIndex* index_;
+  Arrays arrays_;
+};
+
+#endif  // S2_S2FLAT_SHAPE_INDEX_H_
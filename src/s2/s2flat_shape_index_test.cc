@@ -0,0 +1,110 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2flat_shape_index.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2edge_distances.h"
+#include "s2/s2fractal.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2polyline.h"
+#include "s2/s2testing.h"
+
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+using Containment = S2FlatShapeIndex::Containment;
+
+TEST(S2FlatShapeIndex, EmptyIndex) {
+  MutableS2ShapeIndex index;
+  S2FlatShapeIndex flat_index(&index);
+  EXPECT_TRUE(flat_index.arrays().cell_ids.empty());
+  S2ContainsPointBatchResult result;
+  flat_index.GetContainingShapeIds({S2Point(1, 0, 0)}, &result);
+  EXPECT_EQ(result.offsets, vector<int>({0, 0}));
+}
+
+TEST(S2FlatShapeIndex, MatchesS2ContainsPointQuery) {
+  S2Testing::rnd.Reset(1);
+  const S2Point center(1, 0, 0);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3000);
+  vector<unique_ptr<S2Loop>> loops;
+  for (double radius : {10.0, 5.0, 2.0}) {
+    loops.push_back(fractal.MakeLoop(S2Testing::GetRandomFrameAt(center),
+                                     S1Angle::Degrees(radius)));
+  }
+  MutableS2ShapeIndex index;
+  for (const auto& loop : loops) {
+    index.Add(make_unique<S2Loop::Shape>(loop.get()));
+  }
+  // Polylines are ignored.
+  S2Polyline polyline(vector<S2Point>{center, S2Point(1, 1, 0).Normalize()});
+  index.Add(make_unique<S2Polyline::Shape>(&polyline));
+
+  // Test random points, every vertex, and points very close to edges.
+  const S2Cap cap(center, S1Angle::Degrees(12));
+  vector<S2Point> points;
+  for (int i = 0; i < 20000; ++i) points.push_back(S2Testing::SamplePoint(cap));
+  for (const auto& loop : loops) {
+    for (int i = 0; i < loop->num_vertices(); ++i) {
+      points.push_back(loop->vertex(i));
+      points.push_back(
+          S2::Interpolate(loop->vertex(i), loop->vertex(i + 1), 0.3));
+    }
+  }
+
+  S2FlatShapeIndex flat_index(&index);
+  EXPECT_GT(flat_index.SpaceUsed(), 0);
+  S2ContainsPointBatchResult result, expected;
+  flat_index.GetContainingShapeIds(points, &result, /*num_threads=*/4);
+  MakeS2ContainsPointQuery(&index).GetContainingShapeIds(points, &expected);
+  EXPECT_EQ(result.offsets, expected.offsets);
+  EXPECT_EQ(result.shape_ids, expected.shape_ids);
+
+  // Nearly all random points are decided without the exact fallback, while
+  // the vertices are always uncertain.
+  const auto& arrays = flat_index.arrays();
+  auto is_uncertain = [&](const S2Point& p) {
+    int cell = S2FlatShapeIndex::LocateCell(arrays, S2CellId(p));
+    if (cell < 0) return false;
+    for (uint32 c = arrays.cell_clipped_begin[cell];
+         c < arrays.cell_clipped_begin[cell + 1]; ++c) {
+      if (S2FlatShapeIndex::ClippedContains(arrays, cell, c, p) ==
+          Containment::UNCERTAIN) {
+        return true;
+      }
+    }
+    return false;
+  };
+  int num_uncertain = 0;
+  for (int i = 0; i < 20000; ++i) num_uncertain += is_uncertain(points[i]);
+  EXPECT_LT(num_uncertain, 20);
+  EXPECT_TRUE(is_uncertain(loops[0]->vertex(0)));
+}
+
+}  // namespace
@@ -15,12 +15,18 @@
 
 #include "s2/s2furthest_edge_query.h"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include <vector>
 
+#include "absl/log/absl_check.h"
+#include "absl/types/span.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s2closest_edge_query_base.h"
 #include "s2/s2edge_distances.h"
+#include "s2/s2point.h"
 
 using std::vector;
 
@@ -35,8 +41,8 @@ void S2FurthestEdgeQuery::Options::set_conservative_min_distance(
   set_conservative_min_distance(S1ChordAngle(min_distance));
 }
 
-// See s2closest_edge_query.cc for justifications of
-// max_brute_force_index_size() for that query.
+// See s2tuning.h for justifications of S2ClosestEdgeQuery's
+// max_brute_force_index_size() thresholds.
 int S2FurthestEdgeQuery::PointTarget::max_brute_force_index_size() const {
   // Using BM_FindFurthest (which finds the single furthest edge), the
   // break-even points are approximately 100, 400, and 600 edges for point
@@ -76,15 +82,112 @@ S2FurthestEdgeQuery::~S2FurthestEdgeQuery() {
 
 void S2FurthestEdgeQuery::FindFurthestEdges(
     Target* target, vector<S2FurthestEdgeQuery::Result>* results) {
+  base_.FindClosestEdges(target, options_, &base_results_);
   results->clear();
-  for (auto result : base_.FindClosestEdges(target, options_)) {
+  for (const auto& result : base_results_) {
     results->push_back(S2FurthestEdgeQuery::Result(result));
   }
 }
 
+void S2FurthestEdgeQuery::FindFurthestEdges(
+    absl::Span<Target* const> targets, vector<vector<Result>>* results,
+    int num_threads) {
+  vector<vector<Base::Result>> base_results;
+  base_.FindClosestEdges(targets, options_, &base_results, num_threads);
+  results->resize(targets.size());
+  for (int i = 0; i < static_cast<int>(targets.size()); ++i) {
+    vector<Result>& target_results = (*results)[i];
+    target_results.clear();
+    for (const auto& result : base_results[i]) {
+      target_results.push_back(Result(result));
+    }
+  }
+}
+
+void S2FurthestEdgeQuery::FindFurthestEdges(absl::Span<const S2Point> points,
+                                            vector<vector<Result>>* results,
+                                            int num_threads) {
+  vector<PointTarget> point_targets;
+  point_targets.reserve(points.size());
+  for (const S2Point& point : points) point_targets.emplace_back(point);
+  vector<Target*> targets;
+  targets.reserve(points.size());
+  for (PointTarget& target : point_targets) targets.push_back(&target);
+  FindFurthestEdges(targets, results, num_threads);
+}
+
+S2FurthestEdgeQuery::Result S2FurthestEdgeQuery::FindFurthestEdge(
+    absl::Span<Target* const> targets, int* target_index, int num_threads) {
+  ABSL_DCHECK_GE(num_threads, 1);
+  struct Best {
+    Result result;
+    int target_index = -1;
+  };
+  // Each thread searches only for edges at least as far as the furthest edge
+  // found by any thread so far (stored as an S1ChordAngle length2).  Equal
+  // distances are still searched so that ties can be broken consistently.
+  std::atomic<double> shared_max(options_.min_distance().length2());
+  auto search = [this, &targets, &shared_max](Base* query, int begin, int end,
+                                              int stride, Best* best) {
+    Options tmp_options = options_;
+    tmp_options.set_max_results(1);
+    for (int i = begin; i < end; i += stride) {
+      S1ChordAngle limit = S1ChordAngle::FromLength2(shared_max.load());
+      if (options_.min_distance() < limit) {
+        tmp_options.set_inclusive_min_distance(limit);
+      }
+      Result result(query->FindClosestEdge(targets[i], tmp_options));
+      if (result.is_empty() || !(best->result.distance() < result.distance())) {
+        continue;
+      }
+      best->result = result;
+      best->target_index = i;
+      double length2 = result.distance().length2();
+      double old_length2 = shared_max.load();
+      while (old_length2 < length2 &&
+             !shared_max.compare_exchange_weak(old_length2, length2)) {
+      }
+    }
+  };
+
+  // Avoid starting threads that would have very little work to do.
+  constexpr int kMinTargetsPerThread = 64;
+  const int n = targets.size();
+  num_threads = std::min(num_threads,
+                         (n + kMinTargetsPerThread - 1) / kMinTargetsPerThread);
+  vector<Best> bests(std::max(num_threads, 1));
+  if (num_threads <= 1) {
+    search(&base_, 0, n, 1, &bests[0]);
+  } else {
+    // Targets are interleaved among the threads so that each thread quickly
+    // finds a good lower bound wherever the furthest target is.
+    vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (int t = 0; t < num_threads; ++t) {
+      threads.emplace_back([this, &search, &bests, t, n, num_threads]() {
+        Base query(&index());
+        search(&query, t, n, num_threads, &bests[t]);
+      });
+    }
+    for (auto& thread : threads) thread.join();
+  }
+  const Best* best = &bests[0];
+  for (const Best& other : bests) {
+    if (other.result.is_empty()) continue;
+    if (best->result.is_empty() ||
+        best->result.distance() < other.result.distance() ||
+        (best->result.distance() == other.result.distance() &&
+         other.target_index < best->target_index)) {
+      best = &other;
+    }
+  }
+  if (target_index != nullptr) *target_index = best->target_index;
+  return best->result;
+}
+
 S2FurthestEdgeQuery::Result S2FurthestEdgeQuery::FindFurthestEdge(
     Target* target) {
-  static_assert(sizeof(Options) <= 32, "Consider not copying Options here");
+  static_assert(sizeof(Options) <= 64, "Consider not copying Options here");
   Options tmp_options = options_;
   tmp_options.set_max_results(1);
   Base::Result base_result = base_.FindClosestEdge(target, tmp_options);
@@ -93,7 +196,7 @@ S2FurthestEdgeQuery::Result S2FurthestEdgeQuery::FindFurthestEdge(
 
 bool S2FurthestEdgeQuery::IsDistanceGreater(
     Target* target, S1ChordAngle limit) {
-  static_assert(sizeof(Options) <= 32, "Consider not copying Options here");
+  static_assert(sizeof(Options) <= 64, "Consider not copying Options here");
   Options tmp_options = options_;
   tmp_options.set_max_results(1);
   tmp_options.set_min_distance(limit);
@@ -103,7 +206,7 @@ bool S2FurthestEdgeQuery::IsDistanceGreater(
 
 bool S2FurthestEdgeQuery::IsDistanceGreaterOrEqual(
     Target* target, S1ChordAngle limit) {
-  static_assert(sizeof(Options) <= 32, "Consider not copying Options here");
+  static_assert(sizeof(Options) <= 64, "Consider not copying Options here");
   Options tmp_options = options_;
   tmp_options.set_max_results(1);
   tmp_options.set_inclusive_min_distance(limit);
@@ -113,7 +216,7 @@ bool S2FurthestEdgeQuery::IsDistanceGreaterOrEqual(
 
 bool S2FurthestEdgeQuery::IsConservativeDistanceGreaterOrEqual(
     Target* target, S1ChordAngle limit) {
-  static_assert(sizeof(Options) <= 32, "Consider not copying Options here");
+  static_assert(sizeof(Options) <= 64, "Consider not copying Options here");
   Options tmp_options = options_;
   tmp_options.set_max_results(1);
   tmp_options.set_conservative_min_distance(limit);
@@ -24,6 +24,7 @@
 #include "s2/base/types.h"
 #include "absl/base/macros.h"
 #include "absl/container/inlined_vector.h"
+#include "absl/types/span.h"
 #include "s2/_fp_contract_off.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
@@ -316,6 +317,34 @@ class S2FurthestEdgeQuery {
   // since it does not require allocating a new vector on each call.
   void FindFurthestEdges(Target* target, std::vector<Result>* results);
 
+  // Finds the furthest edges to each of the given targets, storing the
+  // results for targets[i] in (*results)[i].  This is equivalent to calling
+  // FindFurthestEdges() on each target, but is faster when there are many
+  // targets (see S2ClosestEdgeQueryBase for details).  If num_threads > 1,
+  // the targets are processed concurrently and must not share mutable state.
+  void FindFurthestEdges(absl::Span<Target* const> targets,
+                         std::vector<std::vector<Result>>* results,
+                         int num_threads = 1);
+
+  // Convenience version of the method above that finds the furthest edges to
+  // each of the given points.
+  void FindFurthestEdges(absl::Span<const S2Point> points,
+                         std::vector<std::vector<Result>>* results,
+                         int num_threads = 1);
+
+  // Returns the furthest edge to any of the given targets, i.e. the result
+  // that FindFurthestEdge() returns with the greatest distance, and sets
+  // "*target_index" (if non-null) to the index of the corresponding target
+  // (or -1 if there is no such edge).  Ties are broken in favor of the
+  // earliest target.  This is much faster than calling FindFurthestEdge()
+  // for every target, since each search only needs to look for edges further
+  // than the best distance found so far.  For example, this method can be
+  // used to compute the radius of a service area about a set of centers.
+  // If num_threads > 1, the targets are processed concurrently and must not
+  // share mutable state.
+  Result FindFurthestEdge(absl::Span<Target* const> targets,
+                          int* target_index = nullptr, int num_threads = 1);
+
   //////////////////////// Convenience Methods ////////////////////////
 
   // Returns the furthest edge to the target.  If no edge satisfies the search
@@ -358,6 +387,9 @@ class S2FurthestEdgeQuery {
  private:
   Options options_;
   Base base_;
+
+  // Temporary storage reused by FindFurthestEdges() to avoid allocating.
+  std::vector<Base::Result> base_results_;
 };
 
 
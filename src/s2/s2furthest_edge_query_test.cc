@@ -340,6 +340,72 @@ TEST(S2FurthestEdgeQuery, FullS2PolygonTarget) {
   EXPECT_EQ(S1ChordAngle::Straight(), full_query.GetDistance(&target));
 }
 
+TEST(S2FurthestEdgeQuery, BatchQueryMatchesIndividualQueries) {
+  S2Testing::rnd.Reset(1);
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+  MutableS2ShapeIndex index;
+  s2testing::FractalLoopShapeIndexFactory().AddEdges(cap, 1000, &index);
+
+  vector<S2Point> points;
+  for (int i = 0; i < 500; ++i) {
+    points.push_back(S2Testing::SamplePoint(S2Cap(cap.center(),
+                                                  S1Angle::Degrees(10))));
+  }
+  S2FurthestEdgeQuery query(&index);
+  for (int max_results : {1, 5}) {
+    query.mutable_options()->set_max_results(max_results);
+    vector<vector<S2FurthestEdgeQuery::Result>> expected;
+    for (const S2Point& point : points) {
+      S2FurthestEdgeQuery::PointTarget target(point);
+      expected.push_back(query.FindFurthestEdges(&target));
+    }
+    for (int num_threads : {1, 4}) {
+      vector<vector<S2FurthestEdgeQuery::Result>> actual;
+      query.FindFurthestEdges(points, &actual, num_threads);
+      EXPECT_EQ(expected, actual) << "max_results = " << max_results
+                                  << ", num_threads = " << num_threads;
+    }
+  }
+}
+
+TEST(S2FurthestEdgeQuery, FurthestEdgeToAnyTarget) {
+  S2Testing::rnd.Reset(1);
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+  MutableS2ShapeIndex index;
+  s2testing::FractalLoopShapeIndexFactory().AddEdges(cap, 1000, &index);
+
+  vector<S2FurthestEdgeQuery::PointTarget> point_targets;
+  for (int i = 0; i < 500; ++i) {
+    point_targets.emplace_back(S2Testing::SamplePoint(
+        S2Cap(cap.center(), S1Angle::Degrees(10))));
+  }
+  S2FurthestEdgeQuery query(&index);
+  S2FurthestEdgeQuery::Result expected;
+  int expected_index = -1;
+  for (int i = 0; i < static_cast<int>(point_targets.size()); ++i) {
+    S2FurthestEdgeQuery::Result result =
+        query.FindFurthestEdge(&point_targets[i]);
+    if (expected.distance() < result.distance()) {
+      expected = result;
+      expected_index = i;
+    }
+  }
+  // Include a duplicate of the furthest target to check tie breaking.
+  point_targets.push_back(point_targets[expected_index]);
+  vector<S2FurthestEdgeQuery::Target*> targets;
+  for (auto& target : point_targets) targets.push_back(&target);
+
+  for (int num_threads : {1, 4}) {
+    int target_index;
+    EXPECT_EQ(expected, query.FindFurthestEdge(targets, &target_index,
+                                               num_threads));
+    EXPECT_EQ(expected_index, target_index);
+  }
+  int target_index;
+  EXPECT_TRUE(query.FindFurthestEdge({}, &target_index).is_empty());
+  EXPECT_EQ(-1, target_index);
+}
+
 TEST(S2FurthestEdgeQuery, CheckSettings) {
   auto full_polygon_index = MakeIndexOrDie("# #");
   full_polygon_index->Add(make_unique<S2Polygon::OwningShape>(
@@ -15,9 +15,20 @@
 
 #include "s2/s2hausdorff_distance_query.h"
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
 #include "absl/types/optional.h"
 #include "s2/s1chord_angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell.h"
+#include "s2/s2cell_id.h"
 #include "s2/s2closest_edge_query.h"
+#include "s2/s2edge_distances.h"
 #include "s2/s2point.h"
 #include "s2/s2predicates.h"
 #include "s2/s2shape.h"
@@ -26,36 +37,108 @@
 using DirectedResult = S2HausdorffDistanceQuery::DirectedResult;
 using Options = S2HausdorffDistanceQuery::Options;
 using Result = S2HausdorffDistanceQuery::Result;
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
 
 namespace {
-// This internally used function computes the closest edge distance from point
-// to the source index via closest_edge_query, and, if necessary, updates the
-// max_distance, the target_point and the source_point.
-void UpdateMaxDistance(const S2Point& point,
-                       S2ClosestEdgeQuery& closest_edge_query,
-                       S1ChordAngle& max_distance, S2Point& target_point,
-                       S2Point& source_point) {
-  // In case we already have a valid result, it can be used as the lower
-  // bound estimate for the final Hausdorff distance. Therefore, if the
-  // distance between the current target point and the last source point
-  // does not exceed this lower bound, we can safely skip this target point, not
-  // updating the maximum distance.
-  if (!max_distance.is_negative() &&
-      s2pred::CompareDistance(point, source_point, max_distance) <= 0) {
-    return;
+
+// A cell of the target index, in the order returned by its iterator.
+struct TargetCell {
+  S2CellId id;
+  const S2ShapeIndexCell* cell;
+  int num_edges;
+};
+
+// Cells with fewer edges than this are not worth bounding as a whole, since
+// computing the bound costs one closest-edge query.
+constexpr int kMinEdgesToBoundCell = 4;
+
+vector<TargetCell> GetTargetCells(const S2ShapeIndex& target) {
+  vector<TargetCell> cells;
+  for (S2ShapeIndex::Iterator it(&target, S2ShapeIndex::BEGIN); !it.done();
+       it.Next()) {
+    int num_edges = 0;
+    for (int i = 0; i < it.cell().num_clipped(); ++i) {
+      num_edges += it.cell().clipped(i).num_edges();
+    }
+    cells.push_back({it.id(), &it.cell(), num_edges});
+  }
+  return cells;
+}
+
+// Returns the largest value that the distance from any point of "cell" to
+// the source index can have (or Infinity() if the source index is empty).
+S1ChordAngle GetMaxCellDistance(S2CellId id,
+                                S2ClosestEdgeQuery& closest_edge_query) {
+  S2Cap cap = S2Cell(id).GetCapBound();
+  S2ClosestEdgeQuery::PointTarget target(cap.center());
+  S1ChordAngle center_distance = closest_edge_query.GetDistance(&target);
+  if (center_distance.is_infinity()) return center_distance;
+  S1ChordAngle bound = center_distance + cap.radius();
+  return bound.PlusError(
+      S2::GetUpdateMinDistanceMaxError(center_distance) +
+      bound.GetS2PointConstructorMaxError());
+}
+
+// Calls "visitor" for each vertex of the target index that is contained by
+// the given index cell.  (Every vertex is contained by exactly one index
+// cell, and that cell contains all of its incident edges.)  Stops early and
+// returns false if "visitor" returns false.
+bool VisitCellVertices(const S2ShapeIndex& target, const TargetCell& cell,
+                       absl::FunctionRef<bool(const S2Point&)> visitor) {
+  for (int i = 0; i < cell.cell->num_clipped(); ++i) {
+    const S2ClippedShape& clipped = cell.cell->clipped(i);
+    const S2Shape& shape = *target.shape(clipped.shape_id());
+    for (int j = 0; j < clipped.num_edges(); ++j) {
+      int edge_id = clipped.edge(j);
+      S2Shape::Edge edge = shape.edge(edge_id);
+      if (cell.id.contains(S2CellId(edge.v0)) && !visitor(edge.v0)) {
+        return false;
+      }
+      // Polylines are the only shapes with a vertex that does not start an
+      // edge, namely the last vertex of each chain.
+      if (shape.dimension() == 1 && cell.id.contains(S2CellId(edge.v1))) {
+        S2Shape::ChainPosition pos = shape.chain_position(edge_id);
+        if (pos.offset + 1 == shape.chain(pos.chain_id).length &&
+            !visitor(edge.v1)) {
+          return false;
+        }
+      }
+    }
   }
+  return true;
+}
 
-  // Find the closest edge and the closest point in the source geometry
-  // to the target point.
-  S2ClosestEdgeQuery::PointTarget target(point);
-  const S2ClosestEdgeQuery::Result closest_edge =
-      closest_edge_query.FindClosestEdge(&target);
-  if (!closest_edge.is_empty() && max_distance < closest_edge.distance()) {
-    max_distance = closest_edge.distance();
-    target_point = point;
-    source_point = closest_edge_query.Project(point, closest_edge);
+// Calls "process" for every target cell index, dividing the cells among
+// "num_threads" threads.  Each thread processes its cells in increasing
+// order.
+void ForEachTargetCell(int num_cells, int num_threads,
+                       absl::FunctionRef<void(int thread, int cell)> process) {
+  num_threads = std::max(1, std::min(num_threads, num_cells));
+  if (num_threads == 1) {
+    for (int i = 0; i < num_cells; ++i) process(0, i);
+    return;
   }
+  std::atomic<int> next_cell(0);
+  vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i; (i = next_cell.fetch_add(1)) < num_cells;) process(t, i);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+}
+
+unique_ptr<S2ClosestEdgeQuery> MakeClosestEdgeQuery(
+    const S2ShapeIndex* source, const Options& options) {
+  auto query = make_unique<S2ClosestEdgeQuery>(source);
+  query->mutable_options()->set_max_results(1);
+  query->mutable_options()->set_include_interiors(options.include_interiors());
+  return query;
 }
+
 }  // namespace
 
 S2HausdorffDistanceQuery::S2HausdorffDistanceQuery(
@@ -100,61 +183,114 @@ S1ChordAngle S2HausdorffDistanceQuery::GetDirectedDistance(
 
 absl::optional<DirectedResult> S2HausdorffDistanceQuery::GetDirectedResult(
     const S2ShapeIndex* target, const S2ShapeIndex* source) const {
-  S2ClosestEdgeQuery closest_edge_query(source);
-  closest_edge_query.mutable_options()->set_max_results(1);
-  closest_edge_query.mutable_options()->set_include_interiors(
-      options_.include_interiors());
-  S1ChordAngle max_distance = S1ChordAngle::Negative();
-  S2Point source_point, target_point;
-
   // This approximation of Haussdorff distance is based on computing closest
   // point distances from the _vertices_ of the target index to _edges_ of the
-  // source index.  Hence we iterate over all shapes in the target index, then
-  // over all chains in those shapes, then over all edges in those chains, and
-  // then over the edges' vertices.
-  for (const S2Shape* shape : *target) {
-    for (auto chain : shape->chains()) {
-      for (const S2Point& vertex : shape->vertices(chain)) {
-        UpdateMaxDistance(vertex, closest_edge_query, max_distance,
-                          target_point, source_point);
-      }
-    }
+  // source index.  The vertices are visited one target index cell at a time,
+  // which allows skipping any cell whose vertices are all provably closer to
+  // the source than the maximum distance found so far.
+  struct ThreadState {
+    unique_ptr<S2ClosestEdgeQuery> query;
+    S1ChordAngle max_distance = S1ChordAngle::Negative();
+    S2Point target_point, source_point;
+    int cell_index = -1;
+  };
+  const vector<TargetCell> cells = GetTargetCells(*target);
+  const int num_threads =
+      std::max(1, std::min<int>(options_.num_threads(), cells.size()));
+  vector<ThreadState> states(num_threads);
+  for (auto& state : states) {
+    state.query = MakeClosestEdgeQuery(source, options_);
   }
 
-  if (max_distance.is_negative()) {
-    return absl::nullopt;
-  } else {
-    return DirectedResult(max_distance, target_point);
+  // The maximum distance found by any thread, as an S1ChordAngle length2.
+  std::atomic<double> shared_max(S1ChordAngle::Negative().length2());
+  ForEachTargetCell(cells.size(), num_threads, [&](int t, int i) {
+    ThreadState& state = states[t];
+    S2ClosestEdgeQuery& query = *state.query;
+    const TargetCell& cell = cells[i];
+    if (cell.num_edges >= kMinEdgesToBoundCell) {
+      // Ties are not skipped, so that the result does not depend on the
+      // order in which threads process the cells.
+      S1ChordAngle max_cell_distance = GetMaxCellDistance(cell.id, query);
+      if (max_cell_distance.length2() < shared_max.load()) return;
+    }
+    VisitCellVertices(*target, cell, [&](const S2Point& point) {
+      // Any distance not exceeding the maximum distance so far cannot change
+      // the result, so if "point" is that close to the last source point we
+      // can skip it.
+      if (!state.max_distance.is_negative() &&
+          s2pred::CompareDistance(point, state.source_point,
+                                  state.max_distance) <= 0) {
+        return true;
+      }
+      S2ClosestEdgeQuery::PointTarget point_target(point);
+      const S2ClosestEdgeQuery::Result closest_edge =
+          query.FindClosestEdge(&point_target);
+      if (!closest_edge.is_empty() &&
+          state.max_distance < closest_edge.distance()) {
+        state.max_distance = closest_edge.distance();
+        state.target_point = point;
+        state.source_point = query.Project(point, closest_edge);
+        state.cell_index = i;
+        double length2 = state.max_distance.length2();
+        double old_length2 = shared_max.load();
+        while (old_length2 < length2 &&
+               !shared_max.compare_exchange_weak(old_length2, length2)) {
+        }
+      }
+      return true;
+    });
+  });
+
+  // Ties between threads are broken in favor of the earliest cell, which is
+  // what a single thread would have found.
+  const ThreadState* best = nullptr;
+  for (const ThreadState& state : states) {
+    if (state.max_distance.is_negative()) continue;
+    if (best == nullptr || best->max_distance < state.max_distance ||
+        (best->max_distance == state.max_distance &&
+         state.cell_index < best->cell_index)) {
+      best = &state;
+    }
   }
+  if (best == nullptr) return absl::nullopt;
+  return DirectedResult(best->max_distance, best->target_point);
 }
 
 bool S2HausdorffDistanceQuery::IsDirectedDistanceLess(
     const S2ShapeIndex* target, const S2ShapeIndex* source,
     S1ChordAngle distance_limit) const {
-  S2ClosestEdgeQuery closest_edge_query(source);
-  closest_edge_query.mutable_options()->set_max_results(1);
-  closest_edge_query.mutable_options()->set_include_interiors(
-      options_.include_interiors());
-  S1ChordAngle max_distance = S1ChordAngle::Negative();
-  S2Point source_point, target_point;
+  const vector<TargetCell> cells = GetTargetCells(*target);
+  const int num_threads =
+      std::max(1, std::min<int>(options_.num_threads(), cells.size()));
+  vector<unique_ptr<S2ClosestEdgeQuery>> queries(num_threads);
+  for (auto& query : queries) query = MakeClosestEdgeQuery(source, options_);
 
-  // This approximation of Haussdorff distance is based on computing closest
-  // point distances from the _vertices_ of the target index to _edges_ of the
-  // source index.  Hence we iterate over all shapes in the target index, then
-  // over all chains in those shapes, then over all edges in those chains, and
-  // then over the edges' vertices.
-  for (const S2Shape* shape : *target) {
-    for (auto chain : shape->chains()) {
-      for (const S2Point& vertex : shape->vertices(chain)) {
-        UpdateMaxDistance(vertex, closest_edge_query, max_distance,
-                          target_point, source_point);
-        if (max_distance > distance_limit) {
-          return false;
-        }
+  // The search stops as soon as any thread finds a vertex that is farther
+  // than "distance_limit" from the source (or has no distance at all because
+  // the source is empty).
+  std::atomic<bool> exceeded(false);
+  std::atomic<bool> found_vertex(false);
+  ForEachTargetCell(cells.size(), num_threads, [&](int t, int i) {
+    if (exceeded.load(std::memory_order_relaxed)) return;
+    S2ClosestEdgeQuery& query = *queries[t];
+    const TargetCell& cell = cells[i];
+    if (cell.num_edges >= kMinEdgesToBoundCell) {
+      S1ChordAngle max_cell_distance = GetMaxCellDistance(cell.id, query);
+      if (!max_cell_distance.is_infinity() &&
+          max_cell_distance <= distance_limit) {
+        found_vertex.store(true, std::memory_order_relaxed);
+        return;
       }
     }
-  }
-  return !max_distance.is_negative();
+    bool within_limit = VisitCellVertices(*target, cell, [&](const S2Point& p) {
+      found_vertex.store(true, std::memory_order_relaxed);
+      S2ClosestEdgeQuery::PointTarget point_target(p);
+      return query.IsDistanceLessOrEqual(&point_target, distance_limit);
+    });
+    if (!within_limit) exceeded.store(true, std::memory_order_relaxed);
+  });
+  return found_vertex.load() && !exceeded.load();
 }
 
 bool S2HausdorffDistanceQuery::IsDistanceLess(
@@ -104,8 +104,17 @@ class S2HausdorffDistanceQuery {
       include_interiors_ = include_interiors;
     }
 
+    // The number of threads used to compute directed distances (default 1).
+    // The target index cells are divided among the threads, each of which
+    // runs its own closest-edge queries against the source index.  The
+    // results do not depend on the number of threads.
+    int num_threads() const { return num_threads_; }
+
+    void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
    private:
     bool include_interiors_ = true;
+    int num_threads_ = 1;
   };
 
   // DirectedResult stores the results of directed Hausdorff distance queries
@@ -183,7 +192,11 @@ class S2HausdorffDistanceQuery {
   S1ChordAngle GetDirectedDistance(const S2ShapeIndex* target,
                                    const S2ShapeIndex* source) const;
 
-  // Computes if the directed Hausdorff distance is within the distance limit.
+  // Computes if the directed Hausdorff distance is within the distance limit
+  // (inclusive).  This is faster than GetDirectedDistance(), since the search
+  // stops as soon as a target vertex farther than "distance_limit" is found,
+  // and target index cells that are provably within the limit are skipped
+  // without examining their vertices.
   bool IsDirectedDistanceLess(const S2ShapeIndex* target,
                               const S2ShapeIndex* source,
                               S1ChordAngle distance_limit) const;
@@ -23,7 +23,11 @@
 #include <gtest/gtest.h>
 #include "absl/types/optional.h"
 #include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2closest_edge_query.h"
+#include "s2/s2closest_edge_query_testing.h"
 #include "s2/s2latlng.h"
 #include "s2/s2lax_polygon_shape.h"
 #include "s2/s2lax_polyline_shape.h"
@@ -31,6 +35,7 @@
 #include "s2/s2point_vector_shape.h"
 #include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
+#include "s2/s2testing.h"
 #include "s2/s2text_format.h"
 
 using s2textformat::ParsePointsOrDie;
@@ -66,9 +71,12 @@ TEST(S2HausdorffDistanceQueryTest, OptionsConstructorsAndAccessorsWork) {
   Options default_options;
   Options options;
   options.set_include_interiors(!default_options.include_interiors());
+  options.set_num_threads(4);
 
   EXPECT_TRUE(default_options.include_interiors());
   EXPECT_FALSE(options.include_interiors());
+  EXPECT_EQ(default_options.num_threads(), 1);
+  EXPECT_EQ(options.num_threads(), 4);
 }
 
 // Test the constructors and accessors of the Options.
@@ -403,3 +411,53 @@ TEST(S2HausdorffDistanceQueryTest, WholeWorldSameReference) {
   EXPECT_FALSE(a_to_b_distance_less_inf);
   EXPECT_FALSE(a_to_a_distance_less_inf);
 }
+
+// Returns the directed Hausdorff distance computed by querying every vertex
+// of "target" in turn.
+static S1ChordAngle GetDirectedDistanceBruteForce(const S2ShapeIndex& target,
+                                                  const S2ShapeIndex& source,
+                                                  bool include_interiors) {
+  S2ClosestEdgeQuery query(&source);
+  query.mutable_options()->set_include_interiors(include_interiors);
+  S1ChordAngle max_distance = S1ChordAngle::Negative();
+  for (const S2Shape* shape : target) {
+    for (auto chain : shape->chains()) {
+      for (const S2Point& vertex : shape->vertices(chain)) {
+        S2ClosestEdgeQuery::PointTarget point_target(vertex);
+        max_distance = std::max(max_distance, query.GetDistance(&point_target));
+      }
+    }
+  }
+  return max_distance;
+}
+
+TEST(S2HausdorffDistanceQueryTest, MatchesBruteForceWithAnyNumberOfThreads) {
+  S2Testing::rnd.Reset(1);
+  for (int iter = 0; iter < 10; ++iter) {
+    S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+    MutableS2ShapeIndex a, b;
+    s2testing::FractalLoopShapeIndexFactory().AddEdges(cap, 1000, &a);
+    S2Cap b_cap(S2Testing::SamplePoint(cap), S1Angle::Degrees(0.8));
+    s2testing::FractalLoopShapeIndexFactory().AddEdges(b_cap, 500, &b);
+
+    Options options;
+    options.set_include_interiors(iter % 2 == 0);
+    S1ChordAngle expected =
+        GetDirectedDistanceBruteForce(a, b, options.include_interiors());
+    absl::optional<DirectedResult> single_thread =
+        S2HausdorffDistanceQuery(options).GetDirectedResult(&a, &b);
+    ASSERT_TRUE(single_thread);
+    EXPECT_EQ(single_thread->distance(), expected);
+
+    options.set_num_threads(4);
+    S2HausdorffDistanceQuery query(options);
+    absl::optional<DirectedResult> multi_thread =
+        query.GetDirectedResult(&a, &b);
+    ASSERT_TRUE(multi_thread);
+    EXPECT_EQ(multi_thread->distance(), single_thread->distance());
+    EXPECT_EQ(multi_thread->target_point(), single_thread->target_point());
+
+    EXPECT_TRUE(query.IsDirectedDistanceLess(&a, &b, expected));
+    EXPECT_FALSE(query.IsDirectedDistanceLess(&a, &b, expected.Predecessor()));
+  }
+}
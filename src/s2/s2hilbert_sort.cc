@@ -0,0 +1,141 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2hilbert_sort.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "s2/base/types.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2point.h"
+#include "s2/s2pointutil.h"
+#include "s2/s2shape.h"
+
+using absl::Span;
+using std::max;
+using std::min;
+using std::unique_ptr;
+using std::vector;
+
+namespace S2 {
+
+namespace {
+
+// Each element is sorted by its leaf cell id and then by its original
+// position, which makes the sort stable and the keys unique.
+struct SortKey {
+  uint64 id;
+  int index;
+
+  bool operator<(const SortKey& y) const {
+    return id < y.id || (id == y.id && index < y.index);
+  }
+};
+
+// The number of ids computed per call to S2CellId::FromPoints().
+constexpr size_t kBatchSize = 256;
+
+// Sorting fewer keys than this per thread is not worth starting a thread.
+constexpr size_t kMinKeysPerThread = 1 << 14;
+
+// Sorts "keys" using up to "num_threads" threads.  The keys are divided into
+// one chunk per thread, the chunks are sorted concurrently, and then pairs
+// of adjacent chunks are merged concurrently until one chunk remains.
+void SortKeys(vector<SortKey>* keys, int num_threads) {
+  const size_t n = keys->size();
+  num_threads = min<size_t>(max(num_threads, 1),
+                            max<size_t>(n / kMinKeysPerThread, 1));
+  if (num_threads == 1) {
+    std::sort(keys->begin(), keys->end());
+    return;
+  }
+  vector<size_t> bounds(num_threads + 1);
+  for (int i = 0; i <= num_threads; ++i) bounds[i] = n * i / num_threads;
+  const auto begin = keys->begin();
+  vector<std::thread> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back([begin, &bounds, i]() {
+      std::sort(begin + bounds[i], begin + bounds[i + 1]);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  for (int width = 1; width < num_threads; width *= 2) {
+    threads.clear();
+    for (int i = 0; i + width < num_threads; i += 2 * width) {
+      const int end = min(i + 2 * width, num_threads);
+      threads.emplace_back([begin, &bounds, i, width, end]() {
+        std::inplace_merge(begin + bounds[i], begin + bounds[i + width],
+                           begin + bounds[end]);
+      });
+    }
+    for (auto& thread : threads) thread.join();
+  }
+}
+
+}  // namespace
+
+vector<int> GetHilbertOrder(Span<const S2Point> points, int num_threads) {
+  vector<SortKey> keys(points.size());
+  S2CellId ids[kBatchSize];
+  for (size_t i = 0; i < points.size(); i += kBatchSize) {
+    const size_t n = min(kBatchSize, points.size() - i);
+    S2CellId::FromPoints(points.subspan(i, n), S2CellId::kMaxLevel,
+                         Span<S2CellId>(ids, n));
+    for (size_t j = 0; j < n; ++j) {
+      keys[i + j] = SortKey{ids[j].id(), static_cast<int>(i + j)};
+    }
+  }
+  SortKeys(&keys, num_threads);
+  vector<int> order(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) order[i] = keys[i].index;
+  return order;
+}
+
+void SortInHilbertOrder(vector<S2Point>* points, int num_threads) {
+  vector<int> order = GetHilbertOrder(*points, num_threads);
+  vector<S2Point> sorted(points->size());
+  for (size_t i = 0; i < order.size(); ++i) sorted[i] = (*points)[order[i]];
+  points->swap(sorted);
+}
+
+void SortInHilbertOrder(vector<S2Shape::Edge>* edges, int num_threads) {
+  SortInHilbertOrderBy(
+      edges,
+      [](const S2Shape::Edge& e) {
+        // The sum of the endpoints is proportional to the midpoint, except
+        // when the endpoints are antipodal.
+        S2Point sum = e.v0 + e.v1;
+        return sum == S2Point(0, 0, 0) ? e.v0 : sum;
+      },
+      num_threads);
+}
+
+void SortInHilbertOrder(vector<unique_ptr<S2Shape>>* shapes,
+                        int num_threads) {
+  SortInHilbertOrderBy(
+      shapes,
+      [](const unique_ptr<S2Shape>& shape) {
+        return shape->num_edges() > 0 ? shape->edge(0).v0 : S2::Origin();
+      },
+      num_threads);
+}
+
+}  // namespace S2
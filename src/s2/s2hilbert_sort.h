@@ -0,0 +1,94 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Utilities for reordering points, edges, and shapes along the Hilbert curve
+// (i.e., in increasing S2CellId order).  Processing geometry in this order
+// greatly improves cache locality in many algorithms, since consecutive
+// objects are usually close together on the sphere.  For example, adding
+// shapes to a MutableS2ShapeIndex in Hilbert order gives nearby shapes
+// nearby shape ids (so that the clipped shapes of each index cell refer to
+// nearby S2Shape objects), and inserting points into an S2PointIndex in
+// Hilbert order turns random btree insertions into nearly sequential ones.
+//
+// All functions accept a "num_threads" argument; the sort is done in
+// parallel when num_threads > 1 and the input is large enough to make this
+// worthwhile.  The resulting order does not depend on num_threads.
+
+#ifndef S2_S2HILBERT_SORT_H_
+#define S2_S2HILBERT_SORT_H_
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "s2/s2point.h"
+#include "s2/s2shape.h"
+
+namespace S2 {
+
+// Returns a permutation "order" of [0, points.size()) such that the points
+// points[order[0]], points[order[1]], ... are in increasing order of their
+// leaf S2CellIds.  Points with the same leaf cell keep their original
+// relative order.  The points do not need to be unit length.
+std::vector<int> GetHilbertOrder(absl::Span<const S2Point> points,
+                                 int num_threads = 1);
+
+// Reorders "values" into Hilbert order, where "get_point(value)" returns a
+// representative point for each value.  For example:
+//
+//   struct Store { S2Point location; std::string name; };
+//   std::vector<Store> stores = ...;
+//   S2::SortInHilbertOrderBy(
+//       &stores, [](const Store& store) { return store.location; });
+template <class T, class GetPoint>
+void SortInHilbertOrderBy(std::vector<T>* values, GetPoint get_point,
+                          int num_threads = 1);
+
+// Reorders points into Hilbert order.
+void SortInHilbertOrder(std::vector<S2Point>* points, int num_threads = 1);
+
+// Reorders edges into Hilbert order according to their midpoints.
+void SortInHilbertOrder(std::vector<S2Shape::Edge>* edges,
+                        int num_threads = 1);
+
+// Reorders shapes into Hilbert order according to their first vertex.
+// Shapes with no edges are ordered as though they were located at
+// S2::Origin().  (This representative point is cheap to compute and works
+// well for collections of shapes that are small compared to the distances
+// between them, which is when the order matters most.)
+void SortInHilbertOrder(std::vector<std::unique_ptr<S2Shape>>* shapes,
+                        int num_threads = 1);
+
+
+//////////////////   Implementation details follow   ////////////////////
+
+
+template <class T, class GetPoint>
+void SortInHilbertOrderBy(std::vector<T>* values, GetPoint get_point,
+                          int num_threads) {
+  std::vector<S2Point> points;
+  points.reserve(values->size());
+  for (const T& value : *values) points.push_back(get_point(value));
+  std::vector<int> order = GetHilbertOrder(points, num_threads);
+  std::vector<T> sorted;
+  sorted.reserve(values->size());
+  for (int i : order) sorted.push_back(std::move((*values)[i]));
+  values->swap(sorted);
+}
+
+}  // namespace S2
+
+#endif  // S2_S2HILBERT_SORT_H_
@@ -0,0 +1,63 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2hilbert_sort.h"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "s2/s2point.h"
+#include "s2/s2point_index.h"
+#include "s2/s2testing.h"
+
+using std::vector;
+
+namespace {
+
+vector<S2Point> RandomPoints(int n) {
+  S2Testing::rnd.Reset(1);
+  vector<S2Point> points;
+  for (int i = 0; i < n; ++i) points.push_back(S2Testing::RandomPoint());
+  return points;
+}
+
+// Sorts state.range(0) random points using state.range(1) threads.
+void BM_SortPoints(benchmark::State& state) {
+  const vector<S2Point> points = RandomPoints(state.range(0));
+  for (auto _ : state) {
+    vector<S2Point> sorted = points;
+    S2::SortInHilbertOrder(&sorted, state.range(1));
+    benchmark::DoNotOptimize(sorted.data());
+  }
+  state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_SortPoints)->ArgsProduct({{1 << 10, 1 << 20}, {1, 4}});
+
+// Inserts state.range(0) random points into an S2PointIndex, either in
+// random order (state.range(1) == 0) or in Hilbert order.  The time to sort
+// the points is not included.
+void BM_PointIndexAdd(benchmark::State& state) {
+  vector<S2Point> points = RandomPoints(state.range(0));
+  if (state.range(1)) S2::SortInHilbertOrder(&points);
+  for (auto _ : state) {
+    S2PointIndex<int> index;
+    for (int i = 0; i < points.size(); ++i) index.Add(points[i], i);
+    benchmark::DoNotOptimize(index.num_points());
+  }
+  state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_PointIndexAdd)->ArgsProduct({{1 << 12, 1 << 18}, {0, 1}});
+
+}  // namespace
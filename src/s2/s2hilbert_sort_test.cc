@@ -0,0 +1,144 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2hilbert_sort.h"
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/s2cell_id.h"
+#include "s2/s2lax_polyline_shape.h"
+#include "s2/s2point.h"
+#include "s2/s2pointutil.h"
+#include "s2/s2shape.h"
+#include "s2/s2testing.h"
+
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+vector<S2Point> RandomPoints(int n) {
+  vector<S2Point> points;
+  for (int i = 0; i < n; ++i) points.push_back(S2Testing::RandomPoint());
+  return points;
+}
+
+TEST(GetHilbertOrder, MatchesStableSortByCellId) {
+  S2Testing::rnd.Reset(1);
+  vector<S2Point> points = RandomPoints(1000);
+  // Add some duplicates and non-unit-length points.
+  for (int i = 0; i < 100; ++i) {
+    points.push_back(points[i]);
+    points.push_back(3 * points[2 * i]);
+  }
+  vector<int> expected(points.size());
+  std::iota(expected.begin(), expected.end(), 0);
+  std::stable_sort(expected.begin(), expected.end(), [&](int a, int b) {
+    return S2CellId(points[a]) < S2CellId(points[b]);
+  });
+  EXPECT_EQ(S2::GetHilbertOrder(points), expected);
+}
+
+TEST(GetHilbertOrder, ParallelSortMatchesSerialSort) {
+  S2Testing::rnd.Reset(2);
+  vector<S2Point> points = RandomPoints(200000);
+  // Force many duplicates so that ties are broken across chunks.
+  for (size_t i = 0; i < points.size(); i += 3) points[i] = points[i / 7];
+  vector<int> expected = S2::GetHilbertOrder(points, 1);
+  for (int num_threads : {2, 3, 8}) {
+    EXPECT_EQ(S2::GetHilbertOrder(points, num_threads), expected);
+  }
+}
+
+TEST(SortInHilbertOrder, Points) {
+  S2Testing::rnd.Reset(3);
+  vector<S2Point> points = RandomPoints(5000);
+  vector<S2Point> sorted = points;
+  S2::SortInHilbertOrder(&sorted);
+  EXPECT_TRUE(std::is_sorted(sorted.begin(), sorted.end(),
+                             [](const S2Point& a, const S2Point& b) {
+                               return S2CellId(a) < S2CellId(b);
+                             }));
+  std::sort(points.begin(), points.end());
+  std::sort(sorted.begin(), sorted.end());
+  EXPECT_EQ(points, sorted);
+}
+
+TEST(SortInHilbertOrder, Edges) {
+  S2Testing::rnd.Reset(4);
+  vector<S2Shape::Edge> edges;
+  for (int i = 0; i < 1000; ++i) {
+    // Include some antipodal edges.
+    S2Point a = S2Testing::RandomPoint();
+    S2Point b = (i % 100 == 0) ? -a : S2Testing::RandomPoint();
+    edges.push_back(S2Shape::Edge(a, b));
+  }
+  S2::SortInHilbertOrder(&edges);
+  ASSERT_EQ(edges.size(), 1000);
+  auto key = [](const S2Shape::Edge& e) {
+    S2Point sum = e.v0 + e.v1;
+    return S2CellId(sum == S2Point(0, 0, 0) ? e.v0 : sum);
+  };
+  for (size_t i = 1; i < edges.size(); ++i) {
+    EXPECT_LE(key(edges[i - 1]), key(edges[i]));
+  }
+}
+
+TEST(SortInHilbertOrder, Shapes) {
+  S2Testing::rnd.Reset(5);
+  vector<unique_ptr<S2Shape>> shapes;
+  for (int i = 0; i < 100; ++i) {
+    shapes.push_back(make_unique<S2LaxPolylineShape>(vector<S2Point>{
+        S2Testing::RandomPoint(), S2Testing::RandomPoint()}));
+  }
+  shapes.push_back(make_unique<S2LaxPolylineShape>(vector<S2Point>{}));
+  S2::SortInHilbertOrder(&shapes, 4);
+  ASSERT_EQ(shapes.size(), 101);
+  auto key = [](const unique_ptr<S2Shape>& shape) {
+    return S2CellId(shape->num_edges() > 0 ? shape->edge(0).v0
+                                           : S2::Origin());
+  };
+  for (size_t i = 1; i < shapes.size(); ++i) {
+    EXPECT_LE(key(shapes[i - 1]), key(shapes[i]));
+  }
+}
+
+TEST(SortInHilbertOrderBy, CustomType) {
+  struct Feature {
+    S2Point location;
+    int id;
+  };
+  S2Testing::rnd.Reset(6);
+  vector<Feature> features;
+  for (int i = 0; i < 500; ++i) {
+    features.push_back({S2Testing::RandomPoint(), i});
+  }
+  vector<Feature> sorted = features;
+  S2::SortInHilbertOrderBy(&sorted,
+                           [](const Feature& f) { return f.location; });
+  for (size_t i = 1; i < sorted.size(); ++i) {
+    EXPECT_LE(S2CellId(sorted[i - 1].location), S2CellId(sorted[i].location));
+  }
+  for (const Feature& f : sorted) {
+    EXPECT_EQ(f.location, features[f.id].location);
+  }
+}
+
+}  // namespace
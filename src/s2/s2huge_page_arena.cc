@@ -0,0 +1,125 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2huge_page_arena.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include "absl/log/absl_check.h"
+#include "s2/base/spinlock.h"
+
+S2HugePageArena::~S2HugePageArena() {
+  for (const Chunk& chunk : chunks_) FreeChunk(chunk);
+}
+
+size_t S2HugePageArena::bytes_allocated() const {
+  SpinLockHolder l(&lock_);
+  return bytes_allocated_;
+}
+
+size_t S2HugePageArena::bytes_reserved() const {
+  SpinLockHolder l(&lock_);
+  size_t total = 0;
+  for (const Chunk& chunk : chunks_) total += chunk.size;
+  return total;
+}
+
+int S2HugePageArena::num_huge_page_chunks() const {
+  SpinLockHolder l(&lock_);
+  int count = 0;
+  for (const Chunk& chunk : chunks_) count += chunk.huge_tlb;
+  return count;
+}
+
+void* S2HugePageArena::do_allocate(size_t bytes, size_t alignment) {
+  ABSL_DCHECK_LE(alignment, kChunkSize);
+  SpinLockHolder l(&lock_);
+  bytes_allocated_ += bytes;
+  uintptr_t next = reinterpret_cast<uintptr_t>(next_);
+  uintptr_t aligned = (next + alignment - 1) & ~(uintptr_t{alignment} - 1);
+  if (next_ != nullptr &&
+      aligned + bytes <= reinterpret_cast<uintptr_t>(end_)) {
+    next_ = reinterpret_cast<char*>(aligned + bytes);
+    return reinterpret_cast<void*>(aligned);
+  }
+  // Chunks are aligned to kChunkSize (or at least to the system page size),
+  // so the start of a new chunk satisfies any supported alignment.
+  size_t size = (bytes + kChunkSize - 1) / kChunkSize * kChunkSize;
+  if (size == 0) size = kChunkSize;
+  Chunk chunk = NewChunk(size);
+  chunks_.push_back(chunk);
+  // Allocations that need a chunk of their own leave the current chunk in
+  // place, since it probably still has room for small allocations.
+  if (size == kChunkSize || next_ == nullptr) {
+    next_ = chunk.data + bytes;
+    end_ = chunk.data + chunk.size;
+  }
+  return chunk.data;
+}
+
+/* static */
+S2HugePageArena::Chunk S2HugePageArena::NewChunk(size_t size) {
+#ifndef _WIN32
+  void* addr;
+#ifdef MAP_HUGETLB
+  addr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (addr != MAP_FAILED) {
+    return Chunk{static_cast<char*>(addr), size, true, true};
+  }
+#endif
+  // Fall back to normal pages.  We over-allocate by one chunk so that the
+  // result can be aligned to a huge page boundary, which allows the kernel
+  // to back it with transparent huge pages.
+  addr = mmap(nullptr, size + kChunkSize, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED) throw std::bad_alloc();
+  char* begin = static_cast<char*>(addr);
+  uintptr_t start = reinterpret_cast<uintptr_t>(begin);
+  uintptr_t aligned = (start + kChunkSize - 1) & ~(uintptr_t{kChunkSize} - 1);
+  char* data = reinterpret_cast<char*>(aligned);
+  // Unmap the unused head and tail of the mapping.
+  if (data != begin) munmap(begin, data - begin);
+  char* tail = data + size;
+  size_t tail_size = begin + size + kChunkSize - tail;
+  if (tail_size > 0) munmap(tail, tail_size);
+#ifdef MADV_HUGEPAGE
+  // Advice is only a hint, so errors are ignored.
+  madvise(data, size, MADV_HUGEPAGE);
+#endif
+  return Chunk{data, size, true, false};
+#else
+  char* data = static_cast<char*>(
+      ::operator new(size, std::align_val_t{kChunkSize}));
+  return Chunk{data, size, false, false};
+#endif
+}
+
+/* static */
+void S2HugePageArena::FreeChunk(const Chunk& chunk) {
+#ifndef _WIN32
+  if (chunk.mapped) {
+    munmap(chunk.data, chunk.size);
+    return;
+  }
+#endif
+  ::operator delete(chunk.data, std::align_val_t{kChunkSize});
+}
@@ -0,0 +1,97 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2HUGE_PAGE_ARENA_H_
+#define S2_S2HUGE_PAGE_ARENA_H_
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "s2/base/spinlock.h"
+
+// S2HugePageArena is a thread-safe bump allocator that carves allocations
+// out of 2MB chunks backed by huge pages where the platform supports them.
+// It is intended to be passed to MutableS2ShapeIndex::Options::
+// set_memory_resource() for large indexes, where placing the index cells in
+// a small number of huge pages reduces TLB misses during queries and makes
+// destroying the index nearly free.
+//
+// Memory is never returned to the arena before it is destroyed (i.e.,
+// deallocate() is a no-op), so an index that is updated many times should
+// use a std::pmr::synchronized_pool_resource on top of the arena so that
+// freed cells are recycled:
+//
+//   S2HugePageArena arena;
+//   std::pmr::synchronized_pool_resource pool(&arena);
+//   MutableS2ShapeIndex::Options options;
+//   options.set_memory_resource(&pool);
+//   MutableS2ShapeIndex index(options);
+//
+// On Linux, chunks are first requested with MAP_HUGETLB (which only succeeds
+// if huge pages have been reserved by the administrator), and otherwise are
+// mapped normally with madvise(MADV_HUGEPAGE) so that transparent huge pages
+// can be used.  On other platforms chunks are allocated with operator new.
+class S2HugePageArena final : public std::pmr::memory_resource {
+ public:
+  // The size of a huge page and of each chunk.  Allocations larger than this
+  // get a chunk of their own, rounded up to a multiple of kChunkSize.
+  static constexpr size_t kChunkSize = size_t{2} << 20;
+
+  S2HugePageArena() = default;
+
+  // Frees all memory allocated by the arena.
+  ~S2HugePageArena() override;
+
+  S2HugePageArena(const S2HugePageArena&) = delete;
+  S2HugePageArena& operator=(const S2HugePageArena&) = delete;
+
+  // Returns the total number of bytes handed out by allocate().
+  size_t bytes_allocated() const;
+
+  // Returns the total size of the chunks obtained from the system.
+  size_t bytes_reserved() const;
+
+  // Returns the number of chunks that were mapped with MAP_HUGETLB (i.e.,
+  // are guaranteed to be backed by huge pages).
+  int num_huge_page_chunks() const;
+
+ private:
+  struct Chunk {
+    char* data;
+    size_t size;
+    bool mapped;     // Allocated with mmap() rather than operator new.
+    bool huge_tlb;   // Mapped with MAP_HUGETLB.
+  };
+
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {}
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  static Chunk NewChunk(size_t size);
+  static void FreeChunk(const Chunk& chunk);
+
+  mutable SpinLock lock_;
+  std::vector<Chunk> chunks_ ABSL_GUARDED_BY(lock_);
+  char* next_ ABSL_GUARDED_BY(lock_) = nullptr;
+  char* end_ ABSL_GUARDED_BY(lock_) = nullptr;
+  size_t bytes_allocated_ ABSL_GUARDED_BY(lock_) = 0;
+};
+
+#endif  // S2_S2HUGE_PAGE_ARENA_H_
@@ -0,0 +1,102 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2huge_page_arena.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2polygon.h"
+#include "s2/s2shape_index.h"
+#include "s2/s2shapeutil_testing.h"
+#include "s2/s2testing.h"
+
+using std::make_unique;
+using std::vector;
+
+namespace {
+
+TEST(S2HugePageArena, AllocationsAreAlignedAndDisjoint) {
+  S2HugePageArena arena;
+  vector<char*> blocks;
+  for (size_t i = 1; i <= 1000; ++i) {
+    size_t alignment = size_t{1} << (i % 7);
+    char* p = static_cast<char*>(arena.allocate(i, alignment));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % alignment, 0);
+    std::memset(p, static_cast<int>(i), i);
+    blocks.push_back(p);
+  }
+  for (size_t i = 1; i <= blocks.size(); ++i) {
+    for (size_t j = 0; j < i; ++j) {
+      ASSERT_EQ(blocks[i - 1][j], static_cast<char>(i));
+    }
+  }
+  EXPECT_EQ(arena.bytes_allocated(), 1000 * 1001 / 2);
+  EXPECT_EQ(arena.bytes_reserved(), S2HugePageArena::kChunkSize);
+}
+
+TEST(S2HugePageArena, LargeAllocations) {
+  S2HugePageArena arena;
+  void* small = arena.allocate(16);
+  size_t large_size = 3 * S2HugePageArena::kChunkSize + 1;
+  char* large = static_cast<char*>(arena.allocate(large_size));
+  std::memset(large, 1, large_size);
+  // Small allocations continue to use the first chunk.
+  void* small2 = arena.allocate(16);
+  EXPECT_EQ(static_cast<char*>(small2), static_cast<char*>(small) + 16);
+  EXPECT_EQ(arena.bytes_reserved(), 5 * S2HugePageArena::kChunkSize);
+}
+
+TEST(S2HugePageArena, ConcurrentAllocations) {
+  S2HugePageArena arena;
+  constexpr int kNumThreads = 4, kNumAllocations = 100000;
+  vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&arena, t]() {
+      for (int i = 0; i < kNumAllocations; ++i) {
+        *static_cast<int*>(arena.allocate(sizeof(int), alignof(int))) = t;
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  EXPECT_EQ(arena.bytes_allocated(), kNumThreads * kNumAllocations * 4);
+}
+
+TEST(S2HugePageArena, MutableS2ShapeIndex) {
+  S2HugePageArena arena;
+  std::pmr::synchronized_pool_resource pool(&arena);
+  MutableS2ShapeIndex::Options options;
+  options.set_memory_resource(&pool);
+  MutableS2ShapeIndex index(options), expected;
+  S2Polygon polygon;
+  S2Testing::ConcentricLoopsPolygon(S2Point(1, 0, 0), 10, 100, &polygon);
+  for (int i = 0; i < polygon.num_loops(); ++i) {
+    index.Add(make_unique<S2Loop::Shape>(polygon.loop(i)));
+    expected.Add(make_unique<S2Loop::Shape>(polygon.loop(i)));
+  }
+  s2testing::ExpectEqual(expected, index);
+  EXPECT_GT(arena.bytes_allocated(), 0);
+}
+
+}  // namespace
@@ -0,0 +1,79 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2index_edge_cache.h"
+
+#include "absl/log/absl_check.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+#include "s2/util/math/vector.h"
+
+S2IndexEdgeCache::S2IndexEdgeCache(int max_cells) {
+  options_.set_max_cells(max_cells);
+  ABSL_DCHECK_GT(max_cells, 0);
+}
+
+S2IndexEdgeCache::S2IndexEdgeCache(const Options& options)
+    : options_(options) {
+  ABSL_DCHECK_GT(options.max_cells(), 0);
+}
+
+const S2IndexEdgeCache::CellEdges& S2IndexEdgeCache::Load(
+    const S2ShapeIndex& index, S2CellId id, const S2ShapeIndexCell& cell) {
+  // The cache is small, so a linear search is faster than hashing.
+  for (const CellEdges& cached : cells_) {
+    if (cached.id_ == id && cached.cell_ == &cell && cached.index_ == &index) {
+      ++num_hits_;
+      return cached;
+    }
+  }
+  ++num_misses_;
+  const int max_cells = options_.max_cells();
+  if (static_cast<int>(cells_.size()) < max_cells) {
+    cells_.emplace_back();
+    next_ = cells_.size() - 1;
+  }
+  // Cells are replaced in round-robin order, which approximates LRU order
+  // well enough for small caches.
+  CellEdges& result = cells_[next_];
+  next_ = (next_ + 1) % max_cells;
+  result.index_ = &index;
+  result.id_ = id;
+  result.cell_ = &cell;
+  result.edges_.clear();
+  result.begin_.assign(1, 0);
+  for (const S2ClippedShape& clipped : cell.clipped_shapes()) {
+    const S2Shape& shape = *index.shape(clipped.shape_id());
+    for (int i = 0; i < clipped.num_edges(); ++i) {
+      result.edges_.push_back(shape.edge(clipped.edge(i)));
+    }
+    result.begin_.push_back(result.edges_.size());
+  }
+  result.float_edges_.clear();
+  if (options_.float_edges()) {
+    result.float_edges_.reserve(result.edges_.size());
+    for (const S2Shape::Edge& edge : result.edges_) {
+      result.float_edges_.push_back(
+          {Vector3_f::Cast(edge.v0), Vector3_f::Cast(edge.v1)});
+    }
+  }
+  return result;
+}
+
+void S2IndexEdgeCache::Clear() {
+  cells_.clear();
+  next_ = 0;
+}
@@ -0,0 +1,152 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2INDEX_EDGE_CACHE_H_
+#define S2_S2INDEX_EDGE_CACHE_H_
+
+#include <vector>
+
+#include "s2/base/types.h"
+#include "absl/types/span.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+#include "s2/util/math/vector.h"
+
+// S2IndexEdgeCache stores the edges of the most recently visited
+// S2ShapeIndex cells, so that queries that repeatedly visit the same cells
+// do not need to fetch each edge from its S2Shape again.  This matters most
+// for shapes whose edges are expensive to fetch, e.g. the encoded shapes of
+// an EncodedS2ShapeIndex, which are decoded on every call to edge().
+//
+// A cache is passed to a query using its options (see for example
+// S2ContainsPointQueryOptions::set_edge_cache), and may be shared by any
+// number of queries of different types and on different indexes.  Like
+// S2IndexCellData (which decodes all the data of a single cell), this class
+// is not thread-safe; the intended usage is one cache per thread:
+//
+//   thread_local S2IndexEdgeCache cache;
+//   S2ContainsPointQueryOptions options;
+//   options.set_edge_cache(&cache);
+//   auto query = MakeS2ContainsPointQuery(&index, options);
+//
+// The cache identifies cells by their index, S2CellId, and S2ShapeIndexCell
+// address, so Clear() must be called if an index is modified or destroyed
+// while its cells may still be cached.
+//
+// Optionally the cache also stores a copy of each edge whose vertices are
+// rounded to single precision (see Options::set_float_edges).  Queries use
+// these to rule out most non-crossing edges while reading half as much
+// memory, and only read the original edge when the result is uncertain (see
+// S2EdgeCrosser::IsDefinitelyNotCrossing).
+class S2IndexEdgeCache {
+ public:
+  // The default maximum number of cells whose edges are cached.
+  static constexpr int kDefaultMaxCells = 16;
+
+  class Options {
+   public:
+    // The maximum number of cells whose edges are cached.
+    //
+    // DEFAULT: kDefaultMaxCells
+    int max_cells() const { return max_cells_; }
+    void set_max_cells(int max_cells) { max_cells_ = max_cells; }
+
+    // If true, Load() also stores each edge with its vertices rounded to
+    // single precision (see CellEdges::clipped_float_edges).  This increases
+    // the cost of loading a cell by about 50%, and is worthwhile when the
+    // cached cells are typically tested against several query edges or
+    // points.
+    //
+    // DEFAULT: false
+    bool float_edges() const { return float_edges_; }
+    void set_float_edges(bool float_edges) { float_edges_ = float_edges; }
+
+   private:
+    int max_cells_ = kDefaultMaxCells;
+    bool float_edges_ = false;
+  };
+
+  explicit S2IndexEdgeCache(int max_cells = kDefaultMaxCells);
+  explicit S2IndexEdgeCache(const Options& options);
+
+  S2IndexEdgeCache(const S2IndexEdgeCache&) = delete;
+  S2IndexEdgeCache& operator=(const S2IndexEdgeCache&) = delete;
+
+  int max_cells() const { return options_.max_cells(); }
+  const Options& options() const { return options_; }
+
+  // An edge whose vertices have been rounded to single precision.
+  struct FloatEdge {
+    Vector3_f v0, v1;
+  };
+
+  // The edges of one index cell.
+  class CellEdges {
+   public:
+    // Returns the edges of the i-th clipped shape of the cell, in the same
+    // order as its edge ids (see S2ClippedShape::edge).
+    absl::Span<const S2Shape::Edge> clipped_edges(int i) const {
+      return absl::MakeConstSpan(edges_.data() + begin_[i],
+                                 edges_.data() + begin_[i + 1]);
+    }
+
+    // Like clipped_edges(), but returns the edges rounded to single
+    // precision.  Returns an empty span unless Options::float_edges() is
+    // true.
+    absl::Span<const FloatEdge> clipped_float_edges(int i) const {
+      if (float_edges_.empty()) return {};
+      return absl::MakeConstSpan(float_edges_.data() + begin_[i],
+                                 float_edges_.data() + begin_[i + 1]);
+    }
+
+   private:
+    friend class S2IndexEdgeCache;
+
+    const S2ShapeIndex* index_ = nullptr;
+    S2CellId id_ = S2CellId::None();
+    const S2ShapeIndexCell* cell_ = nullptr;
+    std::vector<S2Shape::Edge> edges_;
+    std::vector<FloatEdge> float_edges_;
+    std::vector<int> begin_;
+  };
+
+  // Returns the edges of the given index cell, fetching them from the shapes
+  // in "index" only if the cell is not one of the max_cells() most recently
+  // loaded cells.  The result remains valid until the next call to Load()
+  // or Clear().
+  const CellEdges& Load(const S2ShapeIndex& index, S2CellId id,
+                        const S2ShapeIndexCell& cell);
+
+  // Removes all cells from the cache.
+  void Clear();
+
+  // The number of calls to Load() that found the cell in the cache and that
+  // needed to fetch its edges.
+  int64 num_hits() const { return num_hits_; }
+  int64 num_misses() const { return num_misses_; }
+
+ private:
+  Options options_;
+  std::vector<CellEdges> cells_;
+
+  // The position in cells_ of the next cell to be replaced.
+  int next_ = 0;
+
+  int64 num_hits_ = 0;
+  int64 num_misses_ = 0;
+};
+
+#endif  // S2_S2INDEX_EDGE_CACHE_H_
@@ -0,0 +1,202 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2index_edge_cache.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2closest_edge_query.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2crossing_edge_query.h"
+#include "s2/s2fractal.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+#include "s2/s2shapeutil_shape_edge.h"
+#include "s2/s2shapeutil_shape_edge_id.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+
+using s2shapeutil::CrossingType;
+using s2shapeutil::ShapeEdgeId;
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Returns an index containing a fractal loop with many edges, so that the
+// queries below visit many different cells.
+unique_ptr<MutableS2ShapeIndex> MakeFractalIndex() {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3000);
+  auto index = make_unique<MutableS2ShapeIndex>();
+  index->Add(make_unique<S2Loop::OwningShape>(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(S2Point(1, 0, 0)), S1Angle::Degrees(10))));
+  index->ForceBuild();
+  return index;
+}
+
+S2Point RandomNearbyPoint() {
+  return S2Testing::SamplePoint(
+      S2Cap(S2Point(1, 0, 0), S1Angle::Degrees(12)));
+}
+
+TEST(S2IndexEdgeCache, LoadReturnsCellEdges) {
+  auto index = s2textformat::MakeIndexOrDie(
+      "0:0 # 1:1, 2:2 # 0:0, 0:5, 5:0");
+  S2IndexEdgeCache cache;
+  MutableS2ShapeIndex::Iterator it(index.get(), S2ShapeIndex::BEGIN);
+  const S2IndexEdgeCache::CellEdges& edges =
+      cache.Load(*index, it.id(), it.cell());
+  EXPECT_EQ(cache.num_misses(), 1);
+  for (int s = 0; s < it.cell().num_clipped(); ++s) {
+    const S2ClippedShape& clipped = it.cell().clipped(s);
+    const S2Shape& shape = *index->shape(clipped.shape_id());
+    ASSERT_EQ(edges.clipped_edges(s).size(), clipped.num_edges());
+    for (int i = 0; i < clipped.num_edges(); ++i) {
+      EXPECT_EQ(edges.clipped_edges(s)[i], shape.edge(clipped.edge(i)));
+    }
+  }
+  EXPECT_EQ(&cache.Load(*index, it.id(), it.cell()), &edges);
+  EXPECT_EQ(cache.num_hits(), 1);
+  EXPECT_EQ(cache.num_misses(), 1);
+}
+
+TEST(S2IndexEdgeCache, FloatEdges) {
+  auto index = s2textformat::MakeIndexOrDie("# 1:1, 2:2 # 0:0, 0:5, 5:0");
+  MutableS2ShapeIndex::Iterator it(index.get(), S2ShapeIndex::BEGIN);
+  S2IndexEdgeCache cache;
+  EXPECT_TRUE(cache.Load(*index, it.id(), it.cell())
+                  .clipped_float_edges(0).empty());
+
+  S2IndexEdgeCache::Options options;
+  options.set_float_edges(true);
+  S2IndexEdgeCache float_cache(options);
+  const S2IndexEdgeCache::CellEdges& edges =
+      float_cache.Load(*index, it.id(), it.cell());
+  for (int s = 0; s < it.cell().num_clipped(); ++s) {
+    ASSERT_EQ(edges.clipped_float_edges(s).size(),
+              edges.clipped_edges(s).size());
+    for (int i = 0; i < edges.clipped_edges(s).size(); ++i) {
+      const S2Shape::Edge& edge = edges.clipped_edges(s)[i];
+      EXPECT_EQ(edges.clipped_float_edges(s)[i].v0, Vector3_f::Cast(edge.v0));
+      EXPECT_EQ(edges.clipped_float_edges(s)[i].v1, Vector3_f::Cast(edge.v1));
+    }
+  }
+}
+
+TEST(S2IndexEdgeCache, EvictsOldestCell) {
+  auto index = MakeFractalIndex();
+  S2IndexEdgeCache cache(2);
+  vector<MutableS2ShapeIndex::Iterator> cells;
+  for (MutableS2ShapeIndex::Iterator it(index.get(), S2ShapeIndex::BEGIN);
+       !it.done() && cells.size() < 3; it.Next()) {
+    cells.push_back(it);
+  }
+  ASSERT_EQ(cells.size(), 3);
+  for (const auto& it : cells) cache.Load(*index, it.id(), it.cell());
+  EXPECT_EQ(cache.num_misses(), 3);
+
+  // The first cell was replaced by the third one.
+  cache.Load(*index, cells[2].id(), cells[2].cell());
+  EXPECT_EQ(cache.num_hits(), 1);
+  cache.Load(*index, cells[0].id(), cells[0].cell());
+  EXPECT_EQ(cache.num_misses(), 4);
+
+  cache.Clear();
+  cache.Load(*index, cells[0].id(), cells[0].cell());
+  EXPECT_EQ(cache.num_misses(), 5);
+}
+
+// Returns a cache that optionally stores single-precision edges.
+unique_ptr<S2IndexEdgeCache> MakeCache(bool float_edges) {
+  S2IndexEdgeCache::Options options;
+  options.set_float_edges(float_edges);
+  return make_unique<S2IndexEdgeCache>(options);
+}
+
+class S2IndexEdgeCacheQueryTest : public testing::TestWithParam<bool> {};
+
+TEST_P(S2IndexEdgeCacheQueryTest, ContainsPointQueryMatchesUncached) {
+  auto index = MakeFractalIndex();
+  auto cache = MakeCache(GetParam());
+  for (S2VertexModel model : {S2VertexModel::OPEN, S2VertexModel::SEMI_OPEN,
+                              S2VertexModel::CLOSED}) {
+    S2ContainsPointQueryOptions options(model);
+    auto query = MakeS2ContainsPointQuery(index.get(), options);
+    options.set_edge_cache(cache.get());
+    auto cached_query = MakeS2ContainsPointQuery(index.get(), options);
+    for (int i = 0; i < 1000; ++i) {
+      S2Point p = RandomNearbyPoint();
+      ASSERT_EQ(query.Contains(p), cached_query.Contains(p));
+      ASSERT_EQ(query.ShapeContains(0, p), cached_query.ShapeContains(0, p));
+    }
+  }
+  EXPECT_GT(cache->num_misses(), 0);
+}
+
+vector<ShapeEdgeId> GetIds(const vector<s2shapeutil::ShapeEdge>& edges) {
+  vector<ShapeEdgeId> ids;
+  for (const auto& edge : edges) ids.push_back(edge.id());
+  return ids;
+}
+
+TEST_P(S2IndexEdgeCacheQueryTest, CrossingEdgeQueryMatchesUncached) {
+  auto index = MakeFractalIndex();
+  auto cache = MakeCache(GetParam());
+  S2CrossingEdgeQuery query(index.get());
+  S2CrossingEdgeQuery cached_query(index.get());
+  cached_query.set_edge_cache(cache.get());
+  for (auto type : {CrossingType::ALL, CrossingType::INTERIOR}) {
+    for (int i = 0; i < 200; ++i) {
+      S2Point a0 = RandomNearbyPoint(), a1 = RandomNearbyPoint();
+      ASSERT_EQ(GetIds(query.GetCrossingEdges(a0, a1, type)),
+                GetIds(cached_query.GetCrossingEdges(a0, a1, type)));
+      const S2Shape& shape = *index->shape(0);
+      ASSERT_EQ(GetIds(query.GetCrossingEdges(a0, a1, 0, shape, type)),
+                GetIds(cached_query.GetCrossingEdges(a0, a1, 0, shape, type)));
+    }
+  }
+  EXPECT_GT(cache->num_misses(), 0);
+}
+
+INSTANTIATE_TEST_SUITE_P(FloatEdges, S2IndexEdgeCacheQueryTest,
+                         testing::Bool());
+
+TEST(S2IndexEdgeCache, ClosestEdgeQueryMatchesUncached) {
+  auto index = MakeFractalIndex();
+  S2IndexEdgeCache cache;
+  S2ClosestEdgeQuery query(index.get());
+  S2ClosestEdgeQuery::Options options;
+  options.set_max_results(5);
+  options.set_edge_cache(&cache);
+  S2ClosestEdgeQuery cached_query(index.get(), options);
+  query.mutable_options()->set_max_results(5);
+  for (int i = 0; i < 200; ++i) {
+    S2ClosestEdgeQuery::PointTarget target(RandomNearbyPoint());
+    ASSERT_EQ(query.FindClosestEdges(&target),
+              cached_query.FindClosestEdges(&target));
+  }
+  EXPECT_GT(cache.num_misses(), 0);
+}
+
+}  // namespace
@@ -0,0 +1,38 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2INDEXING_MODE_H_
+#define S2_S2INDEXING_MODE_H_
+
+#include "s2/base/types.h"
+
+// Controls the internal S2ShapeIndex that S2Loop and S2Polygon use to
+// accelerate queries (see S2Loop::set_indexing_mode()).
+//
+// NONE is intended for large numbers of objects that are only encoded,
+// measured (e.g., GetArea()), or tested for point containment.  Such objects
+// do not store any index data, and queries that need an index build a
+// temporary one that is discarded afterwards, so NONE should not be used for
+// objects that are queried repeatedly.
+enum class S2IndexingMode : uint8 {
+  DEFAULT,  // LAZY or EAGER as determined by --s2loop_lazy_indexing (for
+            // S2Loop) or --s2polygon_lazy_indexing (for S2Polygon).
+  LAZY,     // The index is built the first time it is needed.
+  EAGER,    // The index is built when the object is initialized.
+  NONE      // There is no index; queries use brute force or a temporary
+            // index instead.
+};
+
+#endif  // S2_S2INDEXING_MODE_H_
@@ -20,10 +20,13 @@
 #include <cmath>
 
 #include <algorithm>
+#include <cstddef>
 #include <ostream>
 #include <string>
 
+#include "absl/log/absl_check.h"
 #include "absl/strings/str_format.h"
+#include "absl/types/span.h"
 #include "s2/util/coding/coder.h"
 #include "s2/r2.h"
 #include "s2/s1angle.h"
@@ -75,6 +78,98 @@ S2LatLng::S2LatLng(const S2Point& p)
       << "Invalid S2LatLng in constructor: " << *this;
 }
 
+namespace {
+
+// The batch conversions process this many elements at a time, so that the
+// intermediate values fit in arrays on the stack.
+constexpr size_t kBlockSize = 256;
+
+// Sets points[i] to the point with latitude lat(i) and longitude lng(i) in
+// radians, using the same arithmetic as S2LatLng::ToPoint().
+template <class LatFunction, class LngFunction>
+void ToPointsImpl(size_t n, LatFunction lat, LngFunction lng,
+                  S2Point* points) {
+  double sin_phi[kBlockSize], cos_phi[kBlockSize];
+  double sin_theta[kBlockSize], cos_theta[kBlockSize];
+  for (size_t begin = 0; begin < n; begin += kBlockSize) {
+    const size_t m = min(kBlockSize, n - begin);
+    for (size_t i = 0; i < m; ++i) {
+      const double phi = lat(begin + i), theta = lng(begin + i);
+      sin_phi[i] = sin(phi);
+      cos_phi[i] = cos(phi);
+      sin_theta[i] = sin(theta);
+      cos_theta[i] = cos(theta);
+    }
+    S2Point* out = points + begin;
+    for (size_t i = 0; i < m; ++i) {
+      out[i] = S2Point(cos_theta[i] * cos_phi[i], sin_theta[i] * cos_phi[i],
+                       sin_phi[i]);
+    }
+  }
+}
+
+// Sets (lat[i], lng[i]) to the latitude and longitude of points[i] in
+// radians, using the same arithmetic as S2LatLng::Latitude() and
+// S2LatLng::Longitude().
+template <class Output>
+void FromPointsImpl(absl::Span<const S2Point> points, Output output) {
+  double r[kBlockSize];
+  for (size_t begin = 0; begin < points.size(); begin += kBlockSize) {
+    const size_t m = min(kBlockSize, points.size() - begin);
+    const S2Point* p = points.data() + begin;
+    for (size_t i = 0; i < m; ++i) {
+      r[i] = sqrt(p[i][0] * p[i][0] + p[i][1] * p[i][1]);
+    }
+    for (size_t i = 0; i < m; ++i) {
+      output(begin + i, atan2(p[i][2] + 0.0, r[i]),
+             atan2(p[i][1] + 0.0, p[i][0] + 0.0));
+    }
+  }
+}
+
+}  // namespace
+
+void S2LatLng::ToPoints(absl::Span<const S2LatLng> lat_lngs,
+                        absl::Span<S2Point> points) {
+  ABSL_DCHECK_EQ(lat_lngs.size(), points.size());
+  ToPointsImpl(
+      points.size(), [&](size_t i) { return lat_lngs[i].coords_[0]; },
+      [&](size_t i) { return lat_lngs[i].coords_[1]; }, points.data());
+}
+
+void S2LatLng::ToPoints(absl::Span<const double> lat_radians,
+                        absl::Span<const double> lng_radians,
+                        absl::Span<S2Point> points) {
+  ABSL_DCHECK_EQ(lat_radians.size(), points.size());
+  ABSL_DCHECK_EQ(lng_radians.size(), points.size());
+  ToPointsImpl(
+      points.size(), [&](size_t i) { return lat_radians[i]; },
+      [&](size_t i) { return lng_radians[i]; }, points.data());
+}
+
+void S2LatLng::FromPoints(absl::Span<const S2Point> points,
+                          absl::Span<S2LatLng> lat_lngs) {
+  ABSL_DCHECK_EQ(lat_lngs.size(), points.size());
+  FromPointsImpl(points, [&](size_t i, double lat, double lng) {
+    lat_lngs[i] = S2LatLng(lat, lng);
+  });
+}
+
+void S2LatLng::FromPoints(absl::Span<const S2Point> points,
+                          absl::Span<double> lat_radians,
+                          absl::Span<double> lng_radians) {
+  ABSL_DCHECK_EQ(lat_radians.size(), points.size());
+  ABSL_DCHECK_EQ(lng_radians.size(), points.size());
+  FromPointsImpl(points, [&](size_t i, double lat, double lng) {
+    lat_radians[i] = lat;
+    lng_radians[i] = lng;
+  });
+}
+
+void S2LatLng::NormalizeAll(absl::Span<S2LatLng> lat_lngs) {
+  for (S2LatLng& ll : lat_lngs) ll = ll.Normalized();
+}
+
 S1Angle S2LatLng::GetDistance(const S2LatLng& o) const {
   // This implements the Haversine formula, which is numerically stable for
   // small distances but only gets about 8 digits of precision for very large
@@ -26,6 +26,7 @@
 #include <utility>
 
 #include "absl/hash/hash.h"
+#include "absl/types/span.h"
 
 #include "s2/_fp_contract_off.h"
 #include "s2/base/types.h"
@@ -123,6 +124,37 @@ class S2LatLng {
   // Converts to an S2Point (equivalent to the operator above).
   S2Point ToPoint() const;
 
+  // Batch versions of ToPoint() for an array of S2LatLngs or for separate
+  // arrays of latitudes and longitudes in radians, which set points[i] to
+  // the point corresponding to the i-th input.  The results are identical
+  // to ToPoint(), but the trigonometric functions are evaluated in a
+  // separate loop from the remaining arithmetic (which the compiler can
+  // vectorize).  These are intended for converting large coordinate arrays,
+  // e.g. when parsing input data.
+  //
+  // REQUIRES: points.size() == lat_lngs.size()
+  // REQUIRES: lat_radians.size() == lng_radians.size() == points.size()
+  static void ToPoints(absl::Span<const S2LatLng> lat_lngs,
+                       absl::Span<S2Point> points);
+  static void ToPoints(absl::Span<const double> lat_radians,
+                       absl::Span<const double> lng_radians,
+                       absl::Span<S2Point> points);
+
+  // Batch versions of S2LatLng(const S2Point&), which convert points[i] to
+  // an S2LatLng or to a latitude and longitude in radians.  The results are
+  // identical to the scalar constructor.
+  //
+  // REQUIRES: lat_lngs.size() == points.size()
+  // REQUIRES: lat_radians.size() == lng_radians.size() == points.size()
+  static void FromPoints(absl::Span<const S2Point> points,
+                         absl::Span<S2LatLng> lat_lngs);
+  static void FromPoints(absl::Span<const S2Point> points,
+                         absl::Span<double> lat_radians,
+                         absl::Span<double> lng_radians);
+
+  // Replaces every element of "lat_lngs" with its Normalized() value.
+  static void NormalizeAll(absl::Span<S2LatLng> lat_lngs);
+
   // Returns the distance (measured along the surface of the sphere) to the
   // given S2LatLng, implemented using the Haversine formula.  This is
   // equivalent to
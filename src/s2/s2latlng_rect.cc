@@ -353,6 +353,21 @@ bool S2LatLngRect::MayIntersect(const S2Cell& cell) const {
   return Intersects(cell.GetRectBound());
 }
 
+void S2LatLngRect::GetChildRelations(const S2Cell children[4],
+                                     bool check_contains,
+                                     CellRelation relations[4]) const {
+  for (int i = 0; i < 4; ++i) {
+    const S2LatLngRect bound = children[i].GetRectBound();
+    if (!Intersects(bound)) {
+      relations[i] = CellRelation::DISJOINT;
+    } else if (check_contains && Contains(bound)) {
+      relations[i] = CellRelation::CONTAINS;
+    } else {
+      relations[i] = CellRelation::MAY_INTERSECT;
+    }
+  }
+}
+
 void S2LatLngRect::Encode(Encoder* encoder) const {
   encoder->Ensure(40);  // sufficient
 
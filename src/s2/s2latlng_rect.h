@@ -349,6 +349,10 @@ class S2LatLngRect final : public S2Region {
   // method goes up as the cells get smaller.
   bool MayIntersect(const S2Cell& cell) const override;
 
+  // Computes the bounding rectangle of each child only once.
+  void GetChildRelations(const S2Cell children[4], bool check_contains,
+                         CellRelation relations[4]) const override;
+
   // The point 'p' does not need to be normalized.
   bool Contains(const S2Point& p) const override;
 
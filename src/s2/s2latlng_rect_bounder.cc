@@ -20,8 +20,10 @@
 #include <algorithm>
 #include <cfloat>
 #include <cmath>
+#include <cstddef>
 
 #include "absl/log/absl_check.h"
+#include "absl/types/span.h"
 #include "s2/r1interval.h"
 #include "s2/s1angle.h"
 #include "s2/s1interval.h"
@@ -39,6 +41,25 @@ void S2LatLngRectBounder::AddPoint(const S2Point& b) {
   AddInternal(b, S2LatLng(b));
 }
 
+void S2LatLngRectBounder::AddPoints(absl::Span<const S2Point> points) {
+  // Converting a point to an S2LatLng requires two calls to atan2().  Doing
+  // this for a batch of independent points at once allows these calls to be
+  // overlapped, whereas the edge computations below depend on the previous
+  // vertex and must be done sequentially.
+  constexpr size_t kBatchSize = 32;
+  S2LatLng latlngs[kBatchSize];
+  for (size_t start = 0; start < points.size(); start += kBatchSize) {
+    const size_t n = min(kBatchSize, points.size() - start);
+    for (size_t i = 0; i < n; ++i) {
+      ABSL_DCHECK(S2::IsUnitLength(points[start + i]));
+      latlngs[i] = S2LatLng(points[start + i]);
+    }
+    for (size_t i = 0; i < n; ++i) {
+      AddInternal(points[start + i], latlngs[i]);
+    }
+  }
+}
+
 void S2LatLngRectBounder::AddLatLng(const S2LatLng& b_latlng) {
   AddInternal(b_latlng.ToPoint(), b_latlng);
 }
@@ -18,6 +18,7 @@
 #ifndef S2_S2LATLNG_RECT_BOUNDER_H_
 #define S2_S2LATLNG_RECT_BOUNDER_H_
 
+#include "absl/types/span.h"
 #include "s2/s2latlng.h"
 #include "s2/s2latlng_rect.h"
 #include "s2/s2point.h"
@@ -42,6 +43,11 @@ class S2LatLngRectBounder {
   // vertices are ignored.
   void AddPoint(const S2Point& b);
 
+  // Equivalent to calling AddPoint() for each point in turn, but faster
+  // because the points are converted to S2LatLngs in batches before the
+  // edges are processed.  Requires that all points have unit length.
+  void AddPoints(absl::Span<const S2Point> points);
+
   // This method is called to add a vertex to the chain when the vertex is
   // represented as an S2LatLng.  Repeated vertices are ignored.
   void AddLatLng(const S2LatLng& b_latlng);
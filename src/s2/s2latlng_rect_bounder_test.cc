@@ -342,3 +342,27 @@ TEST(RectBounder, AccuracyBug) {
   EXPECT_GE(ac_expanded.lat().hi(), ac.lat().hi());
 }
 
+TEST(RectBounder, AddPointsMatchesAddPoint) {
+  S2Testing::rnd.Reset(1);
+  for (int iter = 0; iter < 100; ++iter) {
+    // Use enough points to span several batches, including random points,
+    // repeated points, and points near the poles.
+    vector<S2Point> points;
+    const int n = S2Testing::rnd.Uniform(200);
+    for (int i = 0; i < n; ++i) {
+      if (i > 0 && S2Testing::rnd.OneIn(10)) {
+        points.push_back(points.back());
+      } else if (S2Testing::rnd.OneIn(10)) {
+        points.push_back(S2LatLng::FromDegrees(
+            S2Testing::rnd.OneIn(2) ? 89.9 : -89.9,
+            360 * S2Testing::rnd.RandDouble()).ToPoint());
+      } else {
+        points.push_back(S2Testing::RandomPoint());
+      }
+    }
+    S2LatLngRectBounder expected, actual;
+    for (const S2Point& p : points) expected.AddPoint(p);
+    actual.AddPoints(points);
+    EXPECT_EQ(expected.GetBound(), actual.GetBound());
+  }
+}
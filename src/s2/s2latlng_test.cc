@@ -19,12 +19,14 @@
 
 #include <cmath>
 #include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 #include "absl/base/macros.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
 
 #include "s2/s1angle.h"
 #include "s2/s2coder_testing.h"
@@ -37,6 +39,7 @@ using absl::StrCat;
 using std::fabs;
 using std::signbit;
 using std::string;
+using std::vector;
 
 TEST(S2LatLng, TestBasic) {
   S2LatLng ll_rad = S2LatLng::FromRadians(M_PI_4, M_PI_2);
@@ -120,6 +123,43 @@ TEST(S2LatLng, NegativeZeros) {
       S2LatLng::Longitude(S2Point(-0., -0., 1.)).radians(), +0.));
 }
 
+TEST(S2LatLng, BatchConversions) {
+  // Convert enough points to span several blocks, including some unnormalized
+  // lat/lngs and some special cases.
+  vector<S2LatLng> lat_lngs = {S2LatLng::FromDegrees(90, 65),
+                               S2LatLng::FromRadians(-M_PI_2, 1),
+                               S2LatLng::FromDegrees(12.2, 180),
+                               S2LatLng::FromDegrees(95, -200),
+                               S2LatLng::FromRadians(-0.0, -0.0)};
+  for (int i = 0; i < 1000; ++i) {
+    lat_lngs.push_back(S2LatLng(S2Testing::RandomPoint()));
+  }
+  vector<double> lat_radians, lng_radians;
+  for (const S2LatLng& ll : lat_lngs) {
+    lat_radians.push_back(ll.lat().radians());
+    lng_radians.push_back(ll.lng().radians());
+  }
+  const size_t n = lat_lngs.size();
+  vector<S2Point> points(n), soa_points(n);
+  S2LatLng::ToPoints(lat_lngs, absl::MakeSpan(points));
+  S2LatLng::ToPoints(lat_radians, lng_radians, absl::MakeSpan(soa_points));
+  vector<S2LatLng> from_points(n);
+  vector<double> lat_out(n), lng_out(n);
+  S2LatLng::FromPoints(points, absl::MakeSpan(from_points));
+  S2LatLng::FromPoints(points, absl::MakeSpan(lat_out),
+                       absl::MakeSpan(lng_out));
+  vector<S2LatLng> normalized = lat_lngs;
+  S2LatLng::NormalizeAll(absl::MakeSpan(normalized));
+  for (size_t i = 0; i < n; ++i) {
+    EXPECT_EQ(points[i], lat_lngs[i].ToPoint());
+    EXPECT_EQ(soa_points[i], lat_lngs[i].ToPoint());
+    EXPECT_EQ(from_points[i], S2LatLng(points[i]));
+    EXPECT_TRUE(IsIdentical(lat_out[i], S2LatLng(points[i]).lat().radians()));
+    EXPECT_TRUE(IsIdentical(lng_out[i], S2LatLng(points[i]).lng().radians()));
+    EXPECT_EQ(normalized[i], lat_lngs[i].Normalized());
+  }
+}
+
 TEST(S2LatLng, TestDistance) {
   EXPECT_EQ(0.0,
             S2LatLng::FromDegrees(90, 0).GetDistance(
@@ -40,6 +40,7 @@
 #include "absl/types/span.h"
 #include "s2/s2loop.h"
 #include "s2/s2point.h"
+#include "s2/s2point_span.h"
 #include "s2/s2shape.h"
 
 // S2LaxLoopShape represents a closed loop of edges surrounding an interior
@@ -90,6 +91,9 @@ class S2LaxLoopShape : public S2Shape {
   ChainPosition chain_position(int e) const final {
     return ChainPosition(0, e);
   }
+  S2PointSpan chain_vertex_span(int i) const final {
+    return S2PointSpan(vertices_.get(), num_vertices_);
+  }
 
  private:
   // For clients that have many small loops, we save some memory by
@@ -60,6 +60,19 @@ unique_ptr<T> make_unique_for_overwrite(size_t n) {
 // to decode it.
 static const unsigned char kCurrentEncodingVersionNumber = 1;
 
+// Like version 1, except that the loop starts are encoded in the bit-packed
+// EncodedUintVector format.  This version is only used for polygons with
+// multiple loops that are encoded with CodingHint::COMPACT.
+static const unsigned char kBitPackedLoopStartsVersionNumber = 2;
+
+// Returns the CodingHint that selects the EncodedUintVector format of the
+// loop starts in an encoding with the given version number.
+static s2coding::CodingHint LoopStartsHint(uint8 version) {
+  return version == kBitPackedLoopStartsVersionNumber
+             ? s2coding::CodingHint::COMPACT
+             : s2coding::CodingHint::FAST;
+}
+
 S2LaxPolygonShape::S2LaxPolygonShape(
     const vector<S2LaxPolygonShape::Loop>& loops) {
   Init(loops);
@@ -79,7 +92,8 @@ S2LaxPolygonShape::S2LaxPolygonShape(S2LaxPolygonShape&& b)
       prev_loop_(b.prev_loop_.exchange(0, std::memory_order_relaxed)),
       num_vertices_(std::exchange(b.num_vertices_, 0)),
       vertices_(std::move(b.vertices_)),
-      loop_starts_(std::move(b.loop_starts_)) {}
+      loop_starts_(std::move(b.loop_starts_)),
+      lookup_tables_(std::move(b.lookup_tables_)) {}
 
 S2LaxPolygonShape& S2LaxPolygonShape::operator=(S2LaxPolygonShape&& b) {
   using std::memory_order_relaxed;
@@ -94,6 +108,7 @@ S2LaxPolygonShape& S2LaxPolygonShape::operator=(S2LaxPolygonShape&& b) {
   num_vertices_ = std::exchange(b.num_vertices_, 0);
   vertices_ = std::move(b.vertices_);
   loop_starts_ = std::move(b.loop_starts_);
+  lookup_tables_ = std::move(b.lookup_tables_);
   return *this;
 }
 
@@ -129,6 +144,7 @@ void S2LaxPolygonShape::Init(const S2Polygon& polygon) {
 }
 
 void S2LaxPolygonShape::Init(Span<const Span<const S2Point>> loops) {
+  lookup_tables_.reset();
   num_loops_ = loops.size();
   if (num_loops_ == 0) {
     num_vertices_ = 0;
@@ -182,21 +198,46 @@ const S2Point& S2LaxPolygonShape::loop_vertex(int i, int j) const {
 
 void S2LaxPolygonShape::Encode(Encoder* encoder,
                                s2coding::CodingHint hint) const {
+  // loop_starts_ is only allocated when there are at least two loops.
+  uint32 loop_starts[2] = {0, static_cast<uint32>(num_vertices())};
+  EncodeLoops(MakeSpan(vertices_.get(), num_vertices()),
+              num_loops() > 1 ? MakeSpan(loop_starts_.get(), num_loops() + 1)
+                              : MakeSpan(loop_starts, num_loops() + 1),
+              hint, encoder);
+}
+
+void S2LaxPolygonShape::EncodeLoops(Span<const S2Point> vertices,
+                                    Span<const uint32> loop_starts,
+                                    s2coding::CodingHint hint,
+                                    Encoder* encoder) {
+  ABSL_DCHECK(!loop_starts.empty());
+  ABSL_DCHECK_EQ(loop_starts.front(), 0);
+  ABSL_DCHECK_EQ(loop_starts.back(), vertices.size());
+  const int num_loops = loop_starts.size() - 1;
+  const bool bit_packed =
+      num_loops > 1 && hint == s2coding::CodingHint::COMPACT;
   encoder->Ensure(1 + Varint::kMax32);
-  encoder->put8(kCurrentEncodingVersionNumber);
-  encoder->put_varint32(num_loops());
-  s2coding::EncodeS2PointVector(MakeSpan(vertices_.get(), num_vertices()),
-                                hint, encoder);
-  if (num_loops() > 1) {
+  encoder->put8(bit_packed ? kBitPackedLoopStartsVersionNumber
+                           : kCurrentEncodingVersionNumber);
+  encoder->put_varint32(num_loops);
+  s2coding::EncodeS2PointVector(vertices, hint, encoder);
+  if (num_loops > 1) {
     s2coding::EncodeUintVector<uint32>(
-        MakeSpan(loop_starts_.get(), num_loops() + 1), encoder);
+        loop_starts,
+        bit_packed ? s2coding::CodingHint::COMPACT
+                   : s2coding::CodingHint::FAST,
+        encoder);
   }
 }
 
 bool S2LaxPolygonShape::Init(Decoder* decoder) {
+  lookup_tables_.reset();
   if (decoder->avail() < 1) return false;
   uint8 version = decoder->get8();
-  if (version != kCurrentEncodingVersionNumber) return false;
+  if (version != kCurrentEncodingVersionNumber &&
+      version != kBitPackedLoopStartsVersionNumber) {
+    return false;
+  }
 
   uint32 num_loops;
   if (!decoder->get_varint32(&num_loops)) return false;
@@ -209,12 +250,10 @@ bool S2LaxPolygonShape::Init(Decoder* decoder) {
   } else {
     num_vertices_ = vertices.size();
     vertices_ = make_unique<S2Point[]>(num_vertices_);  // TODO(see above)
-    for (int i = 0; i < num_vertices_; ++i) {
-      vertices_[i] = vertices[i];
-    }
+    vertices.Decode(0, MakeSpan(vertices_.get(), num_vertices_));
     if (num_loops_ > 1) {
       s2coding::EncodedUintVector<uint32> loop_starts;
-      if (!loop_starts.Init(decoder)) return false;
+      if (!loop_starts.Init(decoder, LoopStartsHint(version))) return false;
       loop_starts_ = make_unique_for_overwrite<uint32[]>(loop_starts.size());
       for (size_t i = 0; i < loop_starts.size(); ++i) {
         loop_starts_[i] = loop_starts[i];
@@ -240,9 +279,55 @@ S2Shape::Edge S2LaxPolygonShape::edge(int e) const {
 }
 
 S2Shape::ReferencePoint S2LaxPolygonShape::GetReferencePoint() const {
+  if (lookup_tables_ != nullptr) return lookup_tables_->reference_point;
   return s2shapeutil::GetReferencePoint(*this);
 }
 
+// Returns the lookup tables for a shape with the given loop boundaries.
+template <class LoopStarts>
+static unique_ptr<s2internal::LaxPolygonLookupTables> BuildLookupTables(
+    const S2Shape& shape, int num_loops, const LoopStarts& loop_starts) {
+  auto tables = make_unique<s2internal::LaxPolygonLookupTables>();
+  if (num_loops > 1) {
+    tables->edge_loops =
+        make_unique_for_overwrite<uint32[]>(shape.num_edges());
+    uint32* edge_loops = tables->edge_loops.get();
+    for (int i = 0; i < num_loops; ++i) {
+      std::fill(edge_loops + loop_starts[i], edge_loops + loop_starts[i + 1],
+                i);
+    }
+  }
+  // This must be computed before the tables are installed, since
+  // GetReferencePoint() returns the cached value once they are.
+  tables->reference_point = s2shapeutil::GetReferencePoint(shape);
+  return tables;
+}
+
+void S2LaxPolygonShape::CacheLookupTables() {
+  if (lookup_tables_ != nullptr) return;
+  lookup_tables_ = BuildLookupTables(*this, num_loops_, loop_starts_);
+}
+
+size_t S2LaxPolygonShape::SpaceUsed() const {
+  size_t size = sizeof(*this) + num_vertices_ * sizeof(S2Point);
+  if (num_loops_ > 1) size += (num_loops_ + 1) * sizeof(uint32);
+  if (lookup_tables_ != nullptr) {
+    size += sizeof(*lookup_tables_);
+    if (lookup_tables_->edge_loops) size += num_edges() * sizeof(uint32);
+  }
+  return size;
+}
+
+S2PointSpan S2LaxPolygonShape::chain_vertex_span(int i) const {
+  ABSL_DCHECK_LT(i, num_loops());
+  if (num_loops() == 1) {
+    return S2PointSpan(vertices_.get(), num_vertices_);
+  } else {
+    int start = loop_starts_[i];
+    return S2PointSpan(vertices_.get() + start, loop_starts_[i + 1] - start);
+  }
+}
+
 S2Shape::Chain S2LaxPolygonShape::chain(int i) const {
   ABSL_DCHECK_LT(i, num_loops());
   if (num_loops() == 1) {
@@ -258,7 +343,9 @@ EncodedS2LaxPolygonShape::EncodedS2LaxPolygonShape(EncodedS2LaxPolygonShape&& b)
       num_loops_(std::exchange(b.num_loops_, 0)),
       prev_loop_(b.prev_loop_.exchange(0, std::memory_order_relaxed)),
       vertices_(std::move(b.vertices_)),
-      loop_starts_(std::move(b.loop_starts_)) {}
+      loop_starts_(std::move(b.loop_starts_)),
+      cached_vertices_(std::move(b.cached_vertices_)),
+      lookup_tables_(std::move(b.lookup_tables_)) {}
 
 EncodedS2LaxPolygonShape& EncodedS2LaxPolygonShape::operator=(
     EncodedS2LaxPolygonShape&& b) {
@@ -271,13 +358,20 @@ EncodedS2LaxPolygonShape& EncodedS2LaxPolygonShape::operator=(
                    std::memory_order_relaxed);
   vertices_ = std::move(b.vertices_);
   loop_starts_ = std::move(b.loop_starts_);
+  cached_vertices_ = std::move(b.cached_vertices_);
+  lookup_tables_ = std::move(b.lookup_tables_);
   return *this;
 }
 
 bool EncodedS2LaxPolygonShape::Init(Decoder* decoder) {
+  cached_vertices_.reset();
+  lookup_tables_.reset();
   if (decoder->avail() < 1) return false;
   uint8 version = decoder->get8();
-  if (version != kCurrentEncodingVersionNumber) return false;
+  if (version != kCurrentEncodingVersionNumber &&
+      version != kBitPackedLoopStartsVersionNumber) {
+    return false;
+  }
 
   uint32 num_loops;
   if (!decoder->get_varint32(&num_loops)) return false;
@@ -286,16 +380,39 @@ bool EncodedS2LaxPolygonShape::Init(Decoder* decoder) {
   if (!vertices_.Init(decoder)) return false;
 
   if (num_loops_ > 1) {
-    if (!loop_starts_.Init(decoder)) return false;
+    if (!loop_starts_.Init(decoder, LoopStartsHint(version))) return false;
   }
   return true;
 }
 
+void EncodedS2LaxPolygonShape::CacheVertices() {
+  if (cached_vertices_ || vertices_.is_uncompressed()) return;
+  cached_vertices_ = make_unique_for_overwrite<S2Point[]>(vertices_.size());
+  vertices_.Decode(0, MakeSpan(cached_vertices_.get(), vertices_.size()));
+}
+
+void EncodedS2LaxPolygonShape::CacheLookupTables() {
+  if (lookup_tables_ != nullptr) return;
+  lookup_tables_ = BuildLookupTables(*this, num_loops_, loop_starts_);
+}
+
+size_t EncodedS2LaxPolygonShape::SpaceUsed() const {
+  size_t size = sizeof(*this);
+  if (cached_vertices_) size += vertices_.size() * sizeof(S2Point);
+  if (lookup_tables_ != nullptr) {
+    size += sizeof(*lookup_tables_);
+    if (lookup_tables_->edge_loops) size += num_edges() * sizeof(uint32);
+  }
+  return size;
+}
+
 // The encoding must be identical to S2LaxPolygonShape::Encode().
 void EncodedS2LaxPolygonShape::Encode(Encoder* encoder,
                                       s2coding::CodingHint) const {
   encoder->Ensure(1 + Varint::kMax32);
-  encoder->put8(kCurrentEncodingVersionNumber);
+  encoder->put8(num_loops_ > 1 && loop_starts_.bit_packed()
+                    ? kBitPackedLoopStartsVersionNumber
+                    : kCurrentEncodingVersionNumber);
   encoder->put_varint32(num_loops_);
   vertices_.Encode(encoder);
   if (num_loops_ > 1) {
@@ -324,9 +441,9 @@ S2Point EncodedS2LaxPolygonShape::loop_vertex(int i, int j) const {
   ABSL_DCHECK_LT(i, num_loops());
   ABSL_DCHECK_LT(j, num_loop_vertices(i));
   if (num_loops() == 1) {
-    return vertices_[j];
+    return vertex(j);
   } else {
-    return vertices_[loop_starts_[i] + j];
+    return vertex(loop_starts_[i] + j);
   }
 }
 
@@ -335,7 +452,7 @@ S2Shape::Edge EncodedS2LaxPolygonShape::edge(int e) const {
   size_t e1 = e + 1;
   if (num_loops() == 1) {
     if (e1 == vertices_.size()) { e1 = 0; }
-    return Edge(vertices_[e], vertices_[e1]);
+    return Edge(vertex(e), vertex(e1));
   } else {
     // Method names are fully specified to enable inlining.
     ChainPosition pos = EncodedS2LaxPolygonShape::chain_position(e);
@@ -344,6 +461,7 @@ S2Shape::Edge EncodedS2LaxPolygonShape::edge(int e) const {
 }
 
 S2Shape::ReferencePoint EncodedS2LaxPolygonShape::GetReferencePoint() const {
+  if (lookup_tables_ != nullptr) return lookup_tables_->reference_point;
   return s2shapeutil::GetReferencePoint(*this);
 }
 
@@ -356,3 +474,71 @@ S2Shape::Chain EncodedS2LaxPolygonShape::chain(int i) const {
     return Chain(start, loop_starts_[i + 1] - start);
   }
 }
+
+S2LaxPolygonView::S2LaxPolygonView(S2PointLoopSpan loop)
+    : num_loops_(1), vertices_(loop) {}
+
+S2LaxPolygonView::S2LaxPolygonView(S2PointSpan vertices,
+                                   Span<const uint32> loop_starts)
+    : num_loops_(std::max<int>(0, loop_starts.size() - 1)),
+      vertices_(vertices),
+      loop_starts_(loop_starts) {
+  ABSL_DCHECK(loop_starts.empty() || loop_starts.front() == 0);
+  ABSL_DCHECK(loop_starts.empty() || loop_starts.back() == vertices.size());
+}
+
+int S2LaxPolygonView::num_loop_vertices(int i) const {
+  ABSL_DCHECK_LT(i, num_loops());
+  if (num_loops() == 1) {
+    return vertices_.size();
+  } else {
+    return loop_starts_[i + 1] - loop_starts_[i];
+  }
+}
+
+const S2Point& S2LaxPolygonView::loop_vertex(int i, int j) const {
+  ABSL_DCHECK_LT(i, num_loops());
+  ABSL_DCHECK_LT(j, num_loop_vertices(i));
+  if (i == 0) {
+    return vertices_[j];
+  } else {
+    return vertices_[loop_starts_[i] + j];
+  }
+}
+
+void S2LaxPolygonView::Encode(Encoder* encoder,
+                              s2coding::CodingHint hint) const {
+  // loop_starts_ is not used when there is only one loop.
+  uint32 loop_starts[2] = {0, static_cast<uint32>(num_vertices())};
+  S2LaxPolygonShape::EncodeLoops(
+      vertices_,
+      num_loops() > 1 ? loop_starts_ : MakeSpan(loop_starts, num_loops() + 1),
+      hint, encoder);
+}
+
+S2Shape::Edge S2LaxPolygonView::edge(int e) const {
+  ABSL_DCHECK_LT(e, num_edges());
+  ChainPosition pos = S2LaxPolygonView::chain_position(e);
+  return S2LaxPolygonView::chain_edge(pos.chain_id, pos.offset);
+}
+
+S2Shape::ReferencePoint S2LaxPolygonView::GetReferencePoint() const {
+  return s2shapeutil::GetReferencePoint(*this);
+}
+
+S2Shape::Chain S2LaxPolygonView::chain(int i) const {
+  ABSL_DCHECK_LT(i, num_loops());
+  if (num_loops() == 1) {
+    return Chain(0, vertices_.size());
+  } else {
+    int start = loop_starts_[i];
+    return Chain(start, loop_starts_[i + 1] - start);
+  }
+}
+
+S2PointSpan S2LaxPolygonView::chain_vertex_span(int i) const {
+  ABSL_DCHECK_LT(i, num_loops());
+  if (num_loops() == 1) return vertices_;
+  int start = loop_starts_[i];
+  return vertices_.subspan(start, loop_starts_[i + 1] - start);
+}
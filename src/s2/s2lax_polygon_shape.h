@@ -34,10 +34,22 @@
 #include "s2/s2coder.h"
 #include "s2/s2error.h"
 #include "s2/s2point.h"
+#include "s2/s2point_span.h"
 #include "s2/s2polygon.h"
 #include "s2/s2shape.h"
 #include "s2/util/coding/coder.h"
 
+namespace s2internal {
+// The tables built by S2LaxPolygonShape::CacheLookupTables() and
+// EncodedS2LaxPolygonShape::CacheLookupTables().
+struct LaxPolygonLookupTables {
+  S2Shape::ReferencePoint reference_point;
+
+  // When there is more than one loop, the loop containing each edge.
+  std::unique_ptr<uint32[]> edge_loops;
+};
+}  // namespace s2internal
+
 // S2LaxPolygonShape represents a region defined by a collection of zero or
 // more closed loops.  The interior is the region to the left of all loops.
 // This is similar to S2Polygon::Shape except that this class supports
@@ -140,6 +152,20 @@ class S2LaxPolygonShape : public S2Shape {
   //           can be enlarged as necessary by calling Ensure(int).
   void Encode(Encoder* encoder, s2coding::CodingHint hint) const override;
 
+  // Appends the encoding of a polygon with the given loops to "encoder",
+  // without constructing an S2LaxPolygonShape.  The result is the same as
+  // calling Init() followed by Encode().  "vertices" contains the vertices
+  // of all loops concatenated together, and "loop_starts" has num_loops + 1
+  // elements where element "i" is the total number of vertices in loops
+  // 0..i-1.  (So for example, the full polygon has loop_starts == {0, 0}.)
+  //
+  // REQUIRES: "encoder" uses the default constructor.
+  // REQUIRES: loop_starts.front() == 0 && loop_starts.back() ==
+  //           vertices.size()
+  static void EncodeLoops(absl::Span<const S2Point> vertices,
+                          absl::Span<const uint32> loop_starts,
+                          s2coding::CodingHint hint, Encoder* encoder);
+
   // Decodes an S2LaxPolygonShape, returning true on success.  (The method
   // name is chosen for compatibility with EncodedS2LaxPolygonShape below.)
   bool Init(Decoder* decoder);
@@ -147,6 +173,23 @@ class S2LaxPolygonShape : public S2Shape {
   // Populates an S2Error if decoding fails.
   bool Init(Decoder* decoder, S2Error& error);
 
+  // Precomputes the reference point and a table that maps each edge to its
+  // loop, so that GetReferencePoint() and chain_position() take constant
+  // time.  Otherwise GetReferencePoint() may scan many edges on every call
+  // and chain_position() searches the loop boundaries.  This is worthwhile
+  // for shapes that are accessed many times (e.g. added to several indexes
+  // or tested repeatedly by brute force), at the cost of 4 bytes per edge
+  // when there is more than one loop plus a small constant (see
+  // SpaceUsed()).  The cache is discarded by Init().
+  //
+  // This method is not thread-safe; it must be called before the shape is
+  // accessed from multiple threads.
+  void CacheLookupTables();
+
+  // Returns the total number of bytes used by the shape, including any
+  // lookup tables built by CacheLookupTables().
+  size_t SpaceUsed() const;
+
   // S2Shape interface:
   int num_edges() const final { return num_vertices(); }
   Edge edge(int e) const final;
@@ -156,6 +199,7 @@ class S2LaxPolygonShape : public S2Shape {
   Chain chain(int i) const final;
   Edge chain_edge(int i, int j) const final;
   ChainPosition chain_position(int e) const final;
+  S2PointSpan chain_vertex_span(int i) const final;
   TypeTag type_tag() const override { return kTypeTag; }
 
  private:
@@ -175,6 +219,9 @@ class S2LaxPolygonShape : public S2Shape {
   // When num_loops_ > 1, stores an array of size (num_loops_ + 1) where
   // element "i" represents the total number of vertices in loops 0..i-1.
   std::unique_ptr<uint32[]> loop_starts_;
+
+  // Built by CacheLookupTables(), otherwise nullptr.
+  std::unique_ptr<s2internal::LaxPolygonLookupTables> lookup_tables_;
 };
 
 // Exactly like S2LaxPolygonShape, except that the vertices are kept in an
@@ -210,6 +257,26 @@ class EncodedS2LaxPolygonShape : public S2Shape {
   int num_loop_vertices(int i) const;
   S2Point loop_vertex(int i, int j) const;
 
+  // Decodes all vertices into memory owned by this shape, so that they no
+  // longer need to be decoded each time they are accessed.  This is
+  // worthwhile for "hot" shapes that are accessed many times (e.g. by
+  // repeated queries), at the cost of 24 bytes per vertex.  Does nothing if
+  // the vertices were encoded uncompressed (CodingHint::FAST), since they
+  // are then accessed directly.  The encoding is not affected.
+  //
+  // This method is not thread-safe; it must be called before the shape is
+  // accessed from multiple threads.
+  void CacheVertices();
+
+  // Like S2LaxPolygonShape::CacheLookupTables().  The encoding is not
+  // affected.  This method is not thread-safe.
+  void CacheLookupTables();
+
+  // Returns the number of bytes used by the shape, including any vertices
+  // and lookup tables cached by the methods above but not the encoded data
+  // (which is not owned by this object).
+  size_t SpaceUsed() const;
+
   // S2Shape interface:
   int num_edges() const final { return num_vertices(); }
   Edge edge(int e) const final;
@@ -222,6 +289,9 @@ class EncodedS2LaxPolygonShape : public S2Shape {
   TypeTag type_tag() const override { return kTypeTag; }
 
  private:
+  // Returns vertex "i" of the concatenated loops.
+  S2Point vertex(int i) const;
+
   int32 num_loops_;
 
   // The loop that contained the edge returned by the previous call to the
@@ -231,6 +301,76 @@ class EncodedS2LaxPolygonShape : public S2Shape {
 
   s2coding::EncodedS2PointVector vertices_;
   s2coding::EncodedUintVector<uint32> loop_starts_;
+
+  // The decoded vertices, if CacheVertices() has been called.
+  std::unique_ptr<S2Point[]> cached_vertices_;
+
+  // Built by CacheLookupTables(), otherwise nullptr.
+  std::unique_ptr<s2internal::LaxPolygonLookupTables> lookup_tables_;
+};
+
+// Exactly like S2LaxPolygonShape, except that the vertices and loop starts
+// are not copied: the shape refers to caller-owned arrays, e.g. ones that
+// are part of a memory-mapped columnar file.  This avoids doubling the
+// memory used by the vertices and the time needed to copy them.  The shape
+// can be used anywhere that an S2Shape is accepted (S2ShapeIndex,
+// s2shapeutil, the query classes, etc).
+class S2LaxPolygonView : public S2Shape {
+ public:
+  // The encoding is the same as S2LaxPolygonShape, so that encoded views can
+  // be decoded as S2LaxPolygonShape or EncodedS2LaxPolygonShape.
+  static constexpr TypeTag kTypeTag = S2LaxPolygonShape::kTypeTag;
+
+  // Constructs an empty polygon.
+  S2LaxPolygonView() = default;
+
+  // Constructs a view of a polygon with a single loop.  (Note that an empty
+  // loop is the full loop.)
+  //
+  // REQUIRES: "loop" persists for the lifetime of this object.
+  explicit S2LaxPolygonView(S2PointLoopSpan loop);
+
+  // Constructs a view of a polygon whose loops are stored contiguously, in
+  // the format described under S2LaxPolygonShape::EncodeLoops().  Loop "i"
+  // consists of vertices[loop_starts[i]], ..., vertices[loop_starts[i+1]-1].
+  //
+  // REQUIRES: loop_starts.empty() ||
+  //           (loop_starts.front() == 0 &&
+  //            loop_starts.back() == vertices.size())
+  // REQUIRES: "vertices" and "loop_starts" persist for the lifetime of this
+  //           object.
+  S2LaxPolygonView(S2PointSpan vertices, absl::Span<const uint32> loop_starts);
+
+  int num_loops() const { return num_loops_; }
+  int num_vertices() const { return vertices_.size(); }
+  int num_loop_vertices(int i) const;
+  const S2Point& loop_vertex(int i, int j) const;
+
+  // Appends an encoded representation of the polygon to "encoder".
+  //
+  // REQUIRES: "encoder" uses the default constructor, so that its buffer
+  //           can be enlarged as necessary by calling Ensure(int).
+  void Encode(Encoder* encoder, s2coding::CodingHint hint) const override;
+
+  // S2Shape interface:
+  int num_edges() const final { return num_vertices(); }
+  Edge edge(int e) const final;
+  int dimension() const final { return 2; }
+  ReferencePoint GetReferencePoint() const final;
+  int num_chains() const final { return num_loops(); }
+  Chain chain(int i) const final;
+  Edge chain_edge(int i, int j) const final;
+  ChainPosition chain_position(int e) const final;
+  S2PointSpan chain_vertex_span(int i) const final;
+  TypeTag type_tag() const override { return kTypeTag; }
+
+ private:
+  int32 num_loops_ = 0;
+  S2PointSpan vertices_;
+
+  // When num_loops_ > 1, has (num_loops_ + 1) elements where element "i" is
+  // the total number of vertices in loops 0..i-1.  Otherwise unused.
+  absl::Span<const uint32> loop_starts_;
 };
 
 
@@ -257,6 +397,10 @@ inline S2Shape::ChainPosition S2LaxPolygonShape::chain_position(int e) const {
   if (num_loops() == 1) {
     return ChainPosition(0, e);
   }
+  if (lookup_tables_ != nullptr) {
+    int i = lookup_tables_->edge_loops[e];
+    return ChainPosition(i, e - loop_starts_[i]);
+  }
   // Test if this edge belongs to the loop returned by the previous call.
   const uint32* start =
       &loop_starts_[0] + prev_loop_.load(std::memory_order_relaxed);
@@ -282,6 +426,10 @@ inline S2Shape::ChainPosition S2LaxPolygonShape::chain_position(int e) const {
   return ChainPosition(start - &loop_starts_[0], e - start[0]);
 }
 
+inline S2Point EncodedS2LaxPolygonShape::vertex(int i) const {
+  return cached_vertices_ ? cached_vertices_[i] : vertices_[i];
+}
+
 ABSL_ATTRIBUTE_ALWAYS_INLINE
 inline S2Shape::Edge EncodedS2LaxPolygonShape::chain_edge(int i, int j) const {
   ABSL_DCHECK_LT(i, num_loops());
@@ -289,10 +437,10 @@ inline S2Shape::Edge EncodedS2LaxPolygonShape::chain_edge(int i, int j) const {
   int n = num_loop_vertices(i);
   int k = (j + 1 == n) ? 0 : j + 1;
   if (num_loops() == 1) {
-    return Edge(vertices_[j], vertices_[k]);
+    return Edge(vertex(j), vertex(k));
   } else {
     int start = loop_starts_[i];
-    return Edge(vertices_[start + j], vertices_[start + k]);
+    return Edge(vertex(start + j), vertex(start + k));
   }
 }
 
@@ -303,6 +451,10 @@ inline S2Shape::ChainPosition EncodedS2LaxPolygonShape::chain_position(int e)
   if (num_loops() == 1) {
     return ChainPosition(0, e);
   }
+  if (lookup_tables_ != nullptr) {
+    int i = lookup_tables_->edge_loops[e];
+    return ChainPosition(i, e - loop_starts_[i]);
+  }
   constexpr int kMaxLinearSearchLoops = 12;  // From benchmarks.
   int i = prev_loop_.load(std::memory_order_relaxed);
   if (i == 0 && static_cast<uint32>(e) < loop_starts_[1]) {
@@ -328,4 +480,33 @@ inline S2Shape::ChainPosition EncodedS2LaxPolygonShape::chain_position(int e)
   return ChainPosition(i, e - loop_starts_[i]);
 }
 
+ABSL_ATTRIBUTE_ALWAYS_INLINE
+inline S2Shape::Edge S2LaxPolygonView::chain_edge(int i, int j) const {
+  ABSL_DCHECK_LT(i, num_loops());
+  ABSL_DCHECK_LT(j, num_loop_vertices(i));
+  int n = num_loop_vertices(i);
+  int k = (j + 1 == n) ? 0 : j + 1;
+  int start = (num_loops() == 1) ? 0 : loop_starts_[i];
+  return Edge(vertices_[start + j], vertices_[start + k]);
+}
+
+ABSL_ATTRIBUTE_ALWAYS_INLINE
+inline S2Shape::ChainPosition S2LaxPolygonView::chain_position(int e) const {
+  ABSL_DCHECK_LT(e, num_edges());
+  if (num_loops() == 1) {
+    return ChainPosition(0, e);
+  }
+  constexpr int kMaxLinearSearchLoops = 12;  // From benchmarks.
+  int i;
+  if (num_loops() <= kMaxLinearSearchLoops) {
+    for (i = 0; loop_starts_[i + 1] <= static_cast<uint32>(e); ++i) {
+    }
+  } else {
+    i = std::upper_bound(loop_starts_.begin() + 1,
+                         loop_starts_.begin() + num_loops(), e) -
+        loop_starts_.begin() - 1;
+  }
+  return ChainPosition(i, e - loop_starts_[i]);
+}
+
 #endif  // S2_S2LAX_POLYGON_SHAPE_H_
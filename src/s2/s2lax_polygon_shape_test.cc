@@ -29,6 +29,7 @@
 #include <gtest/gtest.h>
 
 #include "absl/log/absl_log.h"
+#include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
 
 #include "s2/base/casts.h"
@@ -36,6 +37,7 @@
 #include "s2/mutable_s2shape_index.h"
 #include "s2/s1angle.h"
 #include "s2/s2cap.h"
+#include "s2/s2cell_id.h"
 #include "s2/s2coder.h"
 #include "s2/s2coder_testing.h"
 #include "s2/s2contains_point_query.h"
@@ -253,6 +255,113 @@ TEST(S2LaxPolygonShape, MultiLoopPolygon) {
   TestEncodedS2LaxPolygonShape(shape);
 }
 
+TEST(S2LaxPolygonShape, BitPackedLoopStarts) {
+  // COMPACT encodings of polygons with multiple loops use a newer version
+  // with bit-packed loop starts, while FAST encodings are unchanged.
+  vector<S2LaxPolygonShape::Loop> loops;
+  for (int i = 0; i < 20; ++i) {
+    loops.push_back(s2textformat::ParsePointsOrDie(
+        absl::StrFormat("%d:0, %d:1, %d:1", i, i + 1, i + 1)));
+  }
+  S2LaxPolygonShape shape(loops);
+  Encoder fast, compact;
+  shape.Encode(&fast, s2coding::CodingHint::FAST);
+  shape.Encode(&compact, s2coding::CodingHint::COMPACT);
+  ASSERT_GT(fast.length(), 0);
+  ASSERT_GT(compact.length(), 0);
+  EXPECT_EQ(fast.base()[0], 1);
+  EXPECT_EQ(compact.base()[0], 2);
+  for (const Encoder* encoder : {&fast, &compact}) {
+    Decoder decoder(encoder->base(), encoder->length());
+    S2LaxPolygonShape decoded;
+    ASSERT_TRUE(decoded.Init(&decoder));
+    s2testing::ExpectEqual(shape, decoded);
+  }
+  TestEncodedS2LaxPolygonShape(shape);
+}
+
+TEST(EncodedS2LaxPolygonShape, CacheVertices) {
+  // Snap the vertices to cell centers so that the COMPACT encoding actually
+  // compresses them.
+  vector<S2LaxPolygonShape::Loop> loops;
+  for (int i = 0; i < 3; ++i) {
+    S2LaxPolygonShape::Loop loop;
+    for (const S2Point& p :
+         S2Testing::MakeRegularPoints(S2LatLng::FromDegrees(0, i).ToPoint(),
+                                      S1Angle::Degrees(0.2), 10 + i)) {
+      loop.push_back(S2CellId(p).parent(20).ToPoint());
+    }
+    loops.push_back(loop);
+  }
+  for (int num_loops : {1, 3}) {
+    S2LaxPolygonShape shape(vector<S2LaxPolygonShape::Loop>(
+        loops.begin(), loops.begin() + num_loops));
+    Encoder encoder;
+    shape.Encode(&encoder, s2coding::CodingHint::COMPACT);
+    Decoder decoder(encoder.base(), encoder.length());
+    EncodedS2LaxPolygonShape encoded;
+    ASSERT_TRUE(encoded.Init(&decoder));
+    encoded.CacheVertices();
+    s2testing::ExpectEqual(shape, encoded);
+    for (int i = 0; i < num_loops; ++i) {
+      for (int j = 0; j < shape.num_loop_vertices(i); ++j) {
+        EXPECT_EQ(encoded.loop_vertex(i, j), shape.loop_vertex(i, j));
+      }
+    }
+
+    // Moving the shape keeps the cached vertices.
+    EncodedS2LaxPolygonShape moved(std::move(encoded));
+    s2testing::ExpectEqual(shape, moved);
+
+    Encoder reencoder;
+    moved.Encode(&reencoder, s2coding::CodingHint::COMPACT);
+    EXPECT_EQ(string_view(encoder.base(), encoder.length()),
+              string_view(reencoder.base(), reencoder.length()));
+  }
+}
+
+TEST(S2LaxPolygonShape, CacheLookupTables) {
+  // Include empty loops so that some loops contain no edges.
+  vector<S2LaxPolygonShape::Loop> loops;
+  for (int i = 0; i < 30; ++i) {
+    loops.push_back(S2Testing::MakeRegularPoints(
+        S2LatLng::FromDegrees(0, i).ToPoint(), S1Angle::Degrees(0.1),
+        i % 5));
+  }
+  for (int num_loops : {1, 30}) {
+    vector<S2LaxPolygonShape::Loop> shape_loops(loops.begin(),
+                                                loops.begin() + num_loops);
+    S2LaxPolygonShape expected(shape_loops);
+    S2LaxPolygonShape shape(shape_loops);
+    size_t space_used = shape.SpaceUsed();
+    shape.CacheLookupTables();
+    EXPECT_GT(shape.SpaceUsed(), space_used);
+    s2testing::ExpectEqual(expected, shape);
+    EXPECT_EQ(shape.GetReferencePoint(), expected.GetReferencePoint());
+
+    Encoder encoder;
+    shape.Encode(&encoder, s2coding::CodingHint::COMPACT);
+    Decoder decoder(encoder.base(), encoder.length());
+    EncodedS2LaxPolygonShape encoded;
+    ASSERT_TRUE(encoded.Init(&decoder));
+    space_used = encoded.SpaceUsed();
+    encoded.CacheLookupTables();
+    EXPECT_GT(encoded.SpaceUsed(), space_used);
+    s2testing::ExpectEqual(expected, encoded);
+
+    // Moving the shapes keeps the tables.
+    S2LaxPolygonShape moved(std::move(shape));
+    s2testing::ExpectEqual(expected, moved);
+    EncodedS2LaxPolygonShape moved_encoded(std::move(encoded));
+    s2testing::ExpectEqual(expected, moved_encoded);
+
+    // Init() discards the tables.
+    moved.Init(vector<S2LaxPolygonShape::Loop>{loops[3]});
+    s2testing::ExpectEqual(
+        S2LaxPolygonShape(vector<S2LaxPolygonShape::Loop>{loops[3]}), moved);
+  }
+}
+
 TEST(S2LaxPolygonShape, MultiLoopS2Polygon) {
   // Verify that the orientation of loops representing holes is reversed when
   // converting from an S2Polygon to an S2LaxPolygonShape.
@@ -285,6 +394,7 @@ TEST(S2LaxPolygonShape, ManyLoopPolygon) {
     EXPECT_EQ(loops[i].size(), shape.num_loop_vertices(i));
     EXPECT_EQ(num_vertices, shape.chain(i).start);
     EXPECT_EQ(loops[i].size(), shape.chain(i).length);
+    EXPECT_EQ(loops[i].size(), shape.chain_vertex_span(i).size());
     for (int j = 0; j < loops[i].size(); ++j) {
       EXPECT_EQ(loops[i][j], shape.loop_vertex(i, j));
       int e = num_vertices + j;
@@ -296,6 +406,7 @@ TEST(S2LaxPolygonShape, ManyLoopPolygon) {
   }
   EXPECT_EQ(num_vertices, shape.num_vertices());
   EXPECT_EQ(num_vertices, shape.num_edges());
+  s2testing::ExpectChainVertexSpansValid(shape);
 
   // Now test all the edges in a random order in order to exercise the cases
   // involving prev_loop_.
@@ -456,3 +567,60 @@ TEST(S2LaxPolygonShape, ChainVertexIteratorWorks) {
     ++chain_counter;
   }
 }
+
+TEST(S2LaxPolygonView, MatchesS2LaxPolygonShape) {
+  // Test polygons with few and many loops (so that both linear and binary
+  // search are used to find the loop containing each edge), as well as the
+  // full and empty polygons.
+  for (int num_loops : {0, 1, 3, 100}) {
+    vector<S2Point> vertices;
+    vector<uint32> loop_starts = {0};
+    vector<vector<S2Point>> loops;
+    for (int i = 0; i < num_loops; ++i) {
+      S2Point center(S2LatLng::FromDegrees(0, i));
+      loops.push_back(S2Testing::MakeRegularPoints(
+          center, S1Angle::Degrees(0.1), S2Testing::rnd.Uniform(5)));
+      vertices.insert(vertices.end(), loops.back().begin(),
+                      loops.back().end());
+      loop_starts.push_back(vertices.size());
+    }
+    S2LaxPolygonShape shape(loops);
+    S2LaxPolygonView view(vertices, loop_starts);
+    EXPECT_EQ(view.num_loops(), shape.num_loops());
+    EXPECT_EQ(view.num_vertices(), shape.num_vertices());
+    for (int i = 0; i < num_loops; ++i) {
+      EXPECT_EQ(view.num_loop_vertices(i), shape.num_loop_vertices(i));
+      // The view refers to the caller's vertices rather than copying them.
+      EXPECT_EQ(view.chain_vertex_span(i).data(),
+                vertices.data() + loop_starts[i]);
+    }
+    s2testing::ExpectEqual(view, shape);
+    s2testing::ExpectChainVertexSpansValid(view);
+
+    // The encoding is the same as S2LaxPolygonShape.
+    Encoder shape_encoder, view_encoder;
+    shape.Encode(&shape_encoder, s2coding::CodingHint::COMPACT);
+    view.Encode(&view_encoder, s2coding::CodingHint::COMPACT);
+    EXPECT_EQ(string_view(shape_encoder.base(), shape_encoder.length()),
+              string_view(view_encoder.base(), view_encoder.length()));
+  }
+}
+
+TEST(S2LaxPolygonView, SingleLoop) {
+  vector<S2Point> loop = s2textformat::ParsePointsOrDie("0:0, 0:3, 3:3");
+  S2LaxPolygonView view{S2PointLoopSpan(loop)};
+  S2LaxPolygonShape shape(vector<S2LaxPolygonShape::Loop>{loop});
+  s2testing::ExpectEqual(view, shape);
+  EXPECT_EQ(view.chain_vertex_span(0).data(), loop.data());
+
+  // An empty loop is the full loop.
+  S2LaxPolygonView full{S2PointLoopSpan()};
+  EXPECT_TRUE(full.is_full());
+
+  // The view can be indexed and queried like any other shape.
+  MutableS2ShapeIndex index;
+  index.Add(make_unique<S2LaxPolygonView>(S2PointLoopSpan(loop)));
+  auto query = MakeS2ContainsPointQuery(&index);
+  EXPECT_TRUE(query.Contains(s2textformat::MakePointOrDie("1:2")));
+  EXPECT_FALSE(query.Contains(s2textformat::MakePointOrDie("2:1")));
+}
@@ -85,9 +85,7 @@ bool S2LaxPolylineShape::Init(Decoder* decoder) {
   if (!vertices.Init(decoder)) return false;
   num_vertices_ = vertices.size();
   vertices_ = make_unique<S2Point[]>(vertices.size());
-  for (int i = 0; i < num_vertices_; ++i) {
-    vertices_[i] = vertices[i];
-  }
+  vertices.Decode(0, MakeSpan(vertices_.get(), num_vertices_));
   return true;
 }
 
@@ -124,9 +122,16 @@ S2Shape::ChainPosition S2LaxPolylineShape::chain_position(int e) const {
 }
 
 bool EncodedS2LaxPolylineShape::Init(Decoder* decoder) {
+  cached_vertices_.reset();
   return vertices_.Init(decoder);
 }
 
+void EncodedS2LaxPolylineShape::CacheVertices() {
+  if (cached_vertices_ || vertices_.is_uncompressed()) return;
+  cached_vertices_ = make_unique<S2Point[]>(num_vertices());
+  vertices_.Decode(0, MakeSpan(cached_vertices_.get(), num_vertices()));
+}
+
 // The encoding must be identical to S2LaxPolylineShape::Encode().
 void EncodedS2LaxPolylineShape::Encode(Encoder* encoder,
                                        s2coding::CodingHint) const {
@@ -155,3 +160,31 @@ S2Shape::Edge EncodedS2LaxPolylineShape::chain_edge(int i, int j) const {
 S2Shape::ChainPosition EncodedS2LaxPolylineShape::chain_position(int e) const {
   return S2Shape::ChainPosition(0, e);
 }
+
+void S2LaxPolylineView::Encode(Encoder* encoder,
+                               s2coding::CodingHint hint) const {
+  s2coding::EncodeS2PointVector(vertices_, hint, encoder);
+}
+
+S2Shape::Edge S2LaxPolylineView::edge(int e) const {
+  ABSL_DCHECK_LT(e, num_edges());
+  return Edge(vertex(e), vertex(e + 1));
+}
+
+int S2LaxPolylineView::num_chains() const {
+  return std::min(1, S2LaxPolylineView::num_edges());  // Avoid virtual call.
+}
+
+S2Shape::Chain S2LaxPolylineView::chain(int i) const {
+  return Chain(0, S2LaxPolylineView::num_edges());  // Avoid virtual call.
+}
+
+S2Shape::Edge S2LaxPolylineView::chain_edge(int i, int j) const {
+  ABSL_DCHECK_EQ(i, 0);
+  ABSL_DCHECK_LT(j, num_edges());
+  return Edge(vertex(j), vertex(j + 1));
+}
+
+S2Shape::ChainPosition S2LaxPolylineView::chain_position(int e) const {
+  return S2Shape::ChainPosition(0, e);
+}
@@ -29,6 +29,7 @@
 #include "s2/s2coder.h"
 #include "s2/s2error.h"
 #include "s2/s2point.h"
+#include "s2/s2point_span.h"
 #include "s2/s2polyline.h"
 #include "s2/s2shape.h"
 
@@ -97,6 +98,9 @@ class S2LaxPolylineShape : public S2Shape {
   Chain chain(int i) const final;
   Edge chain_edge(int i, int j) const final;
   ChainPosition chain_position(int e) const final;
+  S2PointSpan chain_vertex_span(int i) const final {
+    return S2PointSpan(vertices_.get(), num_vertices_);
+  }
   TypeTag type_tag() const override { return kTypeTag; }
 
  private:
@@ -135,7 +139,20 @@ class EncodedS2LaxPolylineShape : public S2Shape {
   void Encode(Encoder* encoder, s2coding::CodingHint hint) const override;
 
   int num_vertices() const { return vertices_.size(); }
-  S2Point vertex(int i) const { return vertices_[i]; }
+  S2Point vertex(int i) const {
+    return cached_vertices_ ? cached_vertices_[i] : vertices_[i];
+  }
+
+  // Decodes all vertices into memory owned by this shape, so that they no
+  // longer need to be decoded each time they are accessed.  This is
+  // worthwhile for "hot" shapes that are accessed many times (e.g. by
+  // repeated queries), at the cost of 24 bytes per vertex.  Does nothing if
+  // the vertices were encoded uncompressed (CodingHint::FAST), since they
+  // are then accessed directly.  The encoding is not affected.
+  //
+  // This method is not thread-safe; it must be called before the shape is
+  // accessed from multiple threads.
+  void CacheVertices();
 
   // S2Shape interface:
   int num_edges() const final { return std::max(0, num_vertices() - 1); }
@@ -152,6 +169,63 @@ class EncodedS2LaxPolylineShape : public S2Shape {
 
  private:
   s2coding::EncodedS2PointVector vertices_;
+
+  // The decoded vertices, if CacheVertices() has been called.
+  std::unique_ptr<S2Point[]> cached_vertices_;
+};
+
+// Exactly like S2LaxPolylineShape, except that the vertices are not copied:
+// the shape refers to a caller-owned vertex array, e.g. one that is part of
+// a memory-mapped file.  This avoids doubling the memory used by the
+// vertices and the time needed to copy them.  The shape can be used
+// anywhere that an S2Shape is accepted (S2ShapeIndex, s2shapeutil, the
+// query classes, etc), and the S2Polyline measures can be computed directly
+// from vertices() (see s2polyline_measures.h).
+class S2LaxPolylineView : public S2Shape {
+ public:
+  // The encoding is the same as S2LaxPolylineShape, so that encoded views
+  // can be decoded as S2LaxPolylineShape or EncodedS2LaxPolylineShape.
+  enum : TypeTag { kTypeTag = S2LaxPolylineShape::kTypeTag };
+
+  // Constructs an empty polyline.
+  S2LaxPolylineView() = default;
+
+  // Constructs a view of the given vertices.
+  //
+  // REQUIRES: "vertices" persists for the lifetime of this object.
+  explicit S2LaxPolylineView(S2PointSpan vertices) : vertices_(vertices) {}
+
+  // Changes the vertices referenced by this view.
+  //
+  // REQUIRES: "vertices" persists for the lifetime of this object.
+  void Init(S2PointSpan vertices) { vertices_ = vertices; }
+
+  S2PointSpan vertices() const { return vertices_; }
+  int num_vertices() const { return vertices_.size(); }
+  const S2Point& vertex(int i) const { return vertices_[i]; }
+
+  // Appends an encoded representation of the polyline to "encoder".
+  //
+  // REQUIRES: "encoder" uses the default constructor, so that its buffer
+  //           can be enlarged as necessary by calling Ensure(int).
+  void Encode(Encoder* encoder, s2coding::CodingHint hint) const override;
+
+  // S2Shape interface:
+  int num_edges() const final { return std::max(0, num_vertices() - 1); }
+  Edge edge(int e) const final;
+  int dimension() const final { return 1; }
+  ReferencePoint GetReferencePoint() const final {
+    return ReferencePoint::Contained(false);
+  }
+  int num_chains() const final;
+  Chain chain(int i) const final;
+  Edge chain_edge(int i, int j) const final;
+  ChainPosition chain_position(int e) const final;
+  S2PointSpan chain_vertex_span(int i) const final { return vertices_; }
+  TypeTag type_tag() const override { return kTypeTag; }
+
+ private:
+  S2PointSpan vertices_;
 };
 
 #endif  // S2_S2LAX_POLYLINE_SHAPE_H_
@@ -25,7 +25,9 @@
 #include "s2/util/coding/coder.h"
 #include "s2/s2coder.h"
 #include "s2/s2coder_testing.h"
+#include "s2/s2cell_id.h"
 #include "s2/s2error.h"
+#include "s2/s2latlng.h"
 #include "s2/s2point.h"
 #include "s2/s2shape.h"
 #include "s2/s2shapeutil_testing.h"
@@ -116,6 +118,37 @@ TEST(EncodedS2LaxPolylineShape, RoundtripEncoding) {
   s2testing::ExpectEqual(shape, b_shape);
 }
 
+TEST(EncodedS2LaxPolylineShape, CacheVertices) {
+  // Snap the vertices to cell centers so that the COMPACT encoding actually
+  // compresses them.
+  vector<S2Point> vertices;
+  for (int i = 0; i < 40; ++i) {
+    vertices.push_back(
+        S2CellId(S2LatLng::FromDegrees(0.1 * i, 0.05 * i * i)).parent(20)
+            .ToPoint());
+  }
+  S2LaxPolylineShape shape(vertices);
+  Encoder encoder;
+  shape.Encode(&encoder, s2coding::CodingHint::COMPACT);
+  ASSERT_LT(encoder.length(), vertices.size() * sizeof(S2Point));
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2LaxPolylineShape encoded;
+  ASSERT_TRUE(encoded.Init(&decoder));
+  encoded.CacheVertices();
+  s2testing::ExpectEqual(shape, encoded);
+
+  // The encoding is unchanged.
+  Encoder reencoder;
+  encoded.Encode(&reencoder, s2coding::CodingHint::COMPACT);
+  EXPECT_EQ(std::string(encoder.base(), encoder.length()),
+            std::string(reencoder.base(), reencoder.length()));
+
+  // Initializing the shape again discards the cached vertices.
+  Decoder decoder2(reencoder.base(), reencoder.length());
+  ASSERT_TRUE(encoded.Init(&decoder2));
+  s2testing::ExpectEqual(shape, encoded);
+}
+
 // TODO(b/222446546): Decoding EncodedS2PointVector on ARM isn't currently
 // supported, so comment out S2Coder test on ARM for now.
 #ifndef __arm__
@@ -191,3 +224,24 @@ TEST(S2LaxPolylineShape, ChainVertexIteratorWorks) {
 }
 
 #endif
+
+TEST(S2LaxPolylineView, MatchesS2LaxPolylineShape) {
+  for (const char* str : {"", "0:0", "0:0, 0:1, 1:1"}) {
+    vector<S2Point> vertices = s2textformat::ParsePointsOrDie(str);
+    S2LaxPolylineShape shape(vertices);
+    S2LaxPolylineView view(vertices);
+    EXPECT_EQ(view.num_vertices(), vertices.size());
+    s2testing::ExpectEqual(view, shape);
+
+    // The view refers to the caller's vertices rather than copying them.
+    EXPECT_EQ(view.vertices().data(), vertices.data());
+
+    // The encoding can be decoded as an S2LaxPolylineShape.
+    Encoder encoder;
+    view.Encode(&encoder, s2coding::CodingHint::COMPACT);
+    Decoder decoder(encoder.base(), encoder.length());
+    S2LaxPolylineShape decoded;
+    ASSERT_TRUE(decoded.Init(&decoder));
+    s2testing::ExpectEqual(decoded, shape);
+  }
+}
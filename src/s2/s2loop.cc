@@ -69,6 +69,7 @@
 #include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
 #include "s2/s2shapeutil_visit_crossing_edge_pairs.h"
+#include "s2/s2tuning.h"
 #include "s2/s2wedge_relations.h"
 #include "s2/util/coding/coder.h"
 #include "s2/util/math/matrix3x3.h"
@@ -123,6 +124,7 @@ S2Loop::S2Loop(S2Loop&& b)
       num_vertices_(std::exchange(b.num_vertices_, 0)),
       vertices_(std::move(b.vertices_)),
       s2debug_override_(std::move(b.s2debug_override_)),
+      indexing_mode_(b.indexing_mode_),
       origin_inside_(std::move(b.origin_inside_)),
       unindexed_contains_calls_(
           b.unindexed_contains_calls_.exchange(0, std::memory_order_relaxed)),
@@ -143,6 +145,7 @@ S2Loop& S2Loop::operator=(S2Loop&& b) {
   num_vertices_ = std::exchange(b.num_vertices_, 0);
   vertices_ = std::move(b.vertices_);
   s2debug_override_ = std::move(b.s2debug_override_);
+  indexing_mode_ = b.indexing_mode_;
   origin_inside_ = std::move(b.origin_inside_);
   unindexed_contains_calls_.store(
       b.unindexed_contains_calls_.exchange(0, std::memory_order_relaxed),
@@ -177,6 +180,15 @@ S2Debug S2Loop::s2debug_override() const {
   return s2debug_override_;
 }
 
+void S2Loop::set_indexing_mode(S2IndexingMode mode) {
+  indexing_mode_ = mode;
+  if (num_vertices() > 0 || index_.num_shape_ids() > 0) {
+    // The loop has already been initialized.
+    ClearIndex();
+    AddToIndex();
+  }
+}
+
 void S2Loop::ClearIndex() {
   unindexed_contains_calls_.store(0, std::memory_order_relaxed);
   index_.Clear();
@@ -200,8 +212,14 @@ bool S2Loop::IsValid() const {
 }
 
 bool S2Loop::FindValidationError(S2Error* error) const {
-  return (FindValidationErrorNoIndex(error) ||
-          s2shapeutil::FindSelfIntersection(index_, error));
+  return FindValidationError(1, error);
+}
+
+bool S2Loop::FindValidationError(int num_threads, S2Error* error) const {
+  if (FindValidationErrorNoIndex(error)) return true;
+  MutableS2ShapeIndex tmp;
+  return s2shapeutil::FindSelfIntersection(GetIndex(&tmp), num_threads,
+                                           error);
 }
 
 bool S2Loop::FindValidationErrorNoIndex(S2Error* error) const {
@@ -314,9 +332,8 @@ void S2Loop::InitBound() {
   // Note that a small clockwise loop near the equator contains both poles.
 
   S2LatLngRectBounder bounder;
-  for (int i = 0; i <= num_vertices(); ++i) {
-    bounder.AddPoint(vertex(i));
-  }
+  bounder.AddPoints(vertices_span());
+  bounder.AddPoint(vertex(0));
   S2LatLngRect b = bounder.GetBound();
   if (Contains(S2Point(0, 0, 1))) {
     b = S2LatLngRect(R1Interval(b.lat().lo(), M_PI_2), S1Interval::Full());
@@ -334,16 +351,29 @@ void S2Loop::InitBound() {
 }
 
 void S2Loop::InitIndex() {
-  index_.Add(make_unique<Shape>(this));
-  if (!absl::GetFlag(FLAGS_s2loop_lazy_indexing)) {
-    index_.ForceBuild();
-  }
+  AddToIndex();
   if (absl::GetFlag(FLAGS_s2debug) && s2debug_override_ == S2Debug::ALLOW) {
     // Note that FLAGS_s2debug is false in optimized builds (by default).
     ABSL_CHECK(IsValid());
   }
 }
 
+void S2Loop::AddToIndex() {
+  if (indexing_mode_ == S2IndexingMode::NONE) return;
+  index_.Add(make_unique<Shape>(this));
+  if (indexing_mode_ == S2IndexingMode::EAGER ||
+      (indexing_mode_ == S2IndexingMode::DEFAULT &&
+       !absl::GetFlag(FLAGS_s2loop_lazy_indexing))) {
+    index_.ForceBuild();
+  }
+}
+
+const MutableS2ShapeIndex& S2Loop::GetIndex(MutableS2ShapeIndex* tmp) const {
+  if (indexing_mode_ != S2IndexingMode::NONE) return index_;
+  tmp->Add(make_unique<Shape>(this));
+  return *tmp;
+}
+
 S2Loop::S2Loop(const S2Cell& cell)
     : depth_(0),
       num_vertices_(4),
@@ -365,6 +395,7 @@ S2Loop::S2Loop(const S2Loop& src)
       num_vertices_(src.num_vertices_),
       vertices_(make_unique<S2Point[]>(num_vertices_)),
       s2debug_override_(src.s2debug_override_),
+      indexing_mode_(src.indexing_mode_),
       origin_inside_(src.origin_inside_),
       unindexed_contains_calls_(0),
       bound_(src.bound_),
@@ -378,7 +409,7 @@ S2Loop* S2Loop::Clone() const {
 }
 
 int S2Loop::FindVertex(const S2Point& p) const {
-  if (num_vertices() < 10) {
+  if (num_vertices() < 10 || indexing_mode_ == S2IndexingMode::NONE) {
     // Exhaustive search.  Return value must be in the range [1..N].
     for (int i = 1; i <= num_vertices(); ++i) {
       if (vertex(i) == p) return i;
@@ -457,7 +488,8 @@ S1Angle S2Loop::GetDistanceToBoundary(const S2Point& x) const {
   S2ClosestEdgeQuery::Options options;
   options.set_include_interiors(false);
   S2ClosestEdgeQuery::PointTarget t(x);
-  return S2ClosestEdgeQuery(&index_, options).GetDistance(&t).ToAngle();
+  MutableS2ShapeIndex tmp;
+  return S2ClosestEdgeQuery(&GetIndex(&tmp), options).GetDistance(&t).ToAngle();
 }
 
 S2Point S2Loop::Project(const S2Point& x) const {
@@ -468,7 +500,8 @@ S2Point S2Loop::Project(const S2Point& x) const {
 S2Point S2Loop::ProjectToBoundary(const S2Point& x) const {
   S2ClosestEdgeQuery::Options options;
   options.set_include_interiors(false);
-  S2ClosestEdgeQuery q(&index_, options);
+  MutableS2ShapeIndex tmp;
+  S2ClosestEdgeQuery q(&GetIndex(&tmp), options);
   S2ClosestEdgeQuery::PointTarget target(x);
   S2ClosestEdgeQuery::Result edge = q.FindClosestEdge(&target);
   return q.Project(x, edge);
@@ -496,6 +529,10 @@ void S2Loop::GetCellUnionBound(vector<S2CellId>* cell_ids) const {
 }
 
 bool S2Loop::Contains(const S2Cell& target) const {
+  if (indexing_mode_ == S2IndexingMode::NONE) {
+    if (is_empty_or_full()) return is_full();
+    return !BoundaryApproxIntersects(target) && Contains(target.GetCenter());
+  }
   MutableS2ShapeIndex::Iterator it(&index_);
   S2CellRelation relation = it.Locate(target.id());
 
@@ -515,6 +552,11 @@ bool S2Loop::Contains(const S2Cell& target) const {
 }
 
 bool S2Loop::MayIntersect(const S2Cell& target) const {
+  if (indexing_mode_ == S2IndexingMode::NONE) {
+    if (is_empty_or_full()) return is_full();
+    if (!bound_.Intersects(target.GetRectBound())) return false;
+    return BoundaryApproxIntersects(target) || Contains(target.GetCenter());
+  }
   MutableS2ShapeIndex::Iterator it(&index_);
   S2CellRelation relation = it.Locate(target.id());
 
@@ -565,6 +607,21 @@ bool S2Loop::BoundaryApproxIntersects(const MutableS2ShapeIndex::Iterator& it,
   return false;
 }
 
+bool S2Loop::BoundaryApproxIntersects(const S2Cell& target) const {
+  static const double kMaxError = (S2::kFaceClipErrorUVCoord +
+                                   S2::kIntersectsRectErrorUVDist);
+  R2Rect bound = target.GetBoundUV().Expanded(kMaxError);
+  for (int i = 0; i < num_vertices(); ++i) {
+    R2Point v0, v1;
+    if (S2::ClipToPaddedFace(vertex(i), vertex(i+1), target.face(),
+                             kMaxError, &v0, &v1) &&
+        S2::IntersectsRect(v0, v1, bound)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 bool S2Loop::Contains(const S2Point& p) const {
   // NOTE(ericv): A bounds check slows down this function by about 50%.  It is
   // worthwhile only when it might allow us to delay building the index.
@@ -588,14 +645,12 @@ bool S2Loop::Contains(const S2Point& p) const {
   // competitive ratio of 2; look up "competitive algorithms" for details.)
   // We set the limit somewhat lower than this (20 rather than 50) because
   // building the index may be forced anyway by other API calls, and so we
-  // want to err on the side of building it too early.
-
-  static const int kMaxBruteForceVertices = 32;
-  static const int kMaxUnindexedContainsCalls = 20;  // See notes above.
+  // want to err on the side of building it too early.  Both thresholds can
+  // be recalibrated for the current host (see s2tuning.h).
   if (index_.num_shape_ids() == 0 ||  // InitIndex() not called yet
-      num_vertices() <= kMaxBruteForceVertices ||
-      (!index_.is_fresh() &&
-       ++unindexed_contains_calls_ != kMaxUnindexedContainsCalls)) {
+      num_vertices() <= s2tuning::max_brute_force_contains_vertices() ||
+      (!index_.is_fresh() && ++unindexed_contains_calls_ !=
+                                 s2tuning::max_unindexed_contains_calls())) {
     return BruteForceContains(p);
   }
   // Otherwise we look up the S2ShapeIndex cell containing this point.  Note
@@ -610,13 +665,9 @@ bool S2Loop::BruteForceContains(const S2Point& p) const {
   // zero vertices do, so we might as well handle them all at once.
   if (num_vertices() < 3) return origin_inside_;
 
-  S2Point origin = S2::Origin();
-  S2EdgeCrosser crosser(&origin, &p, &vertex(0));
-  bool inside = origin_inside_;
-  for (int i = 1; i <= num_vertices(); ++i) {
-    inside ^= crosser.EdgeOrVertexCrossing(&vertex(i));
-  }
-  return inside;
+  absl::Span<const S2Point> vertices(vertices_.get(), num_vertices());
+  return origin_inside_ ^
+         S2::EdgeOrVertexCrossingParity(S2::Origin(), p, vertices);
 }
 
 bool S2Loop::Contains(const MutableS2ShapeIndex::Iterator& it,
@@ -808,12 +859,15 @@ class LoopCrosser {
   // If "swapped" is true, the loops A and B have been swapped.  This affects
   // how arguments are passed to the given loop relation, since for example
   // A.Contains(B) is not the same as B.Contains(A).
+  //
+  // "b_index" is the index of loop B (see S2Loop::GetIndex).
   LoopCrosser(const S2Loop& a, const S2Loop& b,
-              LoopRelation* relation, bool swapped)
+              const MutableS2ShapeIndex& b_index, LoopRelation* relation,
+              bool swapped)
       : a_(a), b_(b), relation_(relation), swapped_(swapped),
         a_crossing_target_(relation->a_crossing_target()),
         b_crossing_target_(relation->b_crossing_target()),
-        b_query_(&b.index_) {
+        b_query_(&b_index) {
     using std::swap;
     if (swapped) swap(a_crossing_target_, b_crossing_target_);
   }
@@ -996,9 +1050,12 @@ bool LoopCrosser::HasCrossingRelation(RangeIterator* ai, RangeIterator* bi) {
                                             LoopRelation* relation) {
   // We look for S2CellId ranges where the indexes of A and B overlap, and
   // then test those edges for crossings.
-  RangeIterator ai(&a.index_), bi(&b.index_);
-  LoopCrosser ab(a, b, relation, false);  // Tests edges of A against B
-  LoopCrosser ba(b, a, relation, true);   // Tests edges of B against A
+  MutableS2ShapeIndex a_tmp, b_tmp;
+  const MutableS2ShapeIndex& a_index = a.GetIndex(&a_tmp);
+  const MutableS2ShapeIndex& b_index = b.GetIndex(&b_tmp);
+  RangeIterator ai(&a_index), bi(&b_index);
+  LoopCrosser ab(a, b, b_index, relation, false);  // Tests edges of A vs. B
+  LoopCrosser ba(b, a, a_index, relation, true);   // Tests edges of B vs. A
   while (!ai.Done() || !bi.Done()) {
     if (ai.range_max() < bi.range_min()) {
       // The A and B cells don't overlap, and A precedes B.
@@ -36,6 +36,7 @@
 #include "s2/s1chord_angle.h"
 #include "s2/s2debug.h"
 #include "s2/s2error.h"
+#include "s2/s2indexing_mode.h"
 #include "s2/s2latlng_rect.h"
 #include "s2/s2loop_measures.h"
 #include "s2/s2point.h"
@@ -171,6 +172,20 @@ class S2Loop final : public S2Region {
   void set_s2debug_override(S2Debug override);
   S2Debug s2debug_override() const;
 
+  // Controls whether this loop keeps an S2ShapeIndex to accelerate queries
+  // (see S2IndexingMode).  For example, to avoid storing an index for a loop
+  // that will only be encoded:
+  //
+  //   S2Loop loop;
+  //   loop.set_indexing_mode(S2IndexingMode::NONE);
+  //   loop.Init(...);
+  //
+  // If the loop is already initialized, its index is discarded or recreated
+  // as necessary.  This setting is preserved across calls to Init() and
+  // Decode(), and is copied by Clone().
+  void set_indexing_mode(S2IndexingMode mode);
+  S2IndexingMode indexing_mode() const { return indexing_mode_; }
+
   // Returns true if this is a valid loop.  Note that validity is checked
   // automatically during initialization when --s2debug is enabled (true by
   // default in debug binaries).
@@ -182,6 +197,11 @@ class S2Loop final : public S2Region {
   // REQUIRES: error != nullptr
   bool FindValidationError(S2Error* error) const;
 
+  // Like FindValidationError(), but uses up to "num_threads" threads to check
+  // for self-intersections.  The error reported is the same one that the
+  // single-threaded version reports.
+  bool FindValidationError(int num_threads, S2Error* error) const;
+
   int num_vertices() const { return num_vertices_; }
 
   // For convenience, we make two entire copies of the vertex list available:
@@ -505,6 +525,10 @@ class S2Loop final : public S2Region {
     ChainPosition chain_position(int e) const final {
       return ChainPosition(0, e);
     }
+    S2PointSpan chain_vertex_span(int i) const final {
+      if (loop_->is_empty_or_full()) return {};
+      return loop_->vertices_span();
+    }
 
    private:
     // Allow the move constructor/operator= to update `loop_`
@@ -646,6 +670,17 @@ class S2Loop final : public S2Region {
   // indexing structures need to be cleared since they become invalid.
   void ClearIndex();
 
+  // Adds this loop to index_ (and builds the index) as determined by
+  // indexing_mode_.
+  void AddToIndex();
+
+  // Returns index_, or if this loop does not have an index (i.e.,
+  // indexing_mode_ is NONE), adds the loop to "tmp" and returns it.
+  const MutableS2ShapeIndex& GetIndex(MutableS2ShapeIndex* tmp) const;
+
+  // Like BoundaryApproxIntersects() above, but tests every edge of the loop.
+  bool BoundaryApproxIntersects(const S2Cell& target) const;
+
   // The nesting depth, if this field belongs to an S2Polygon.  We define it
   // here to optimize field packing.
   int depth_ = 0;
@@ -657,6 +692,7 @@ class S2Loop final : public S2Region {
   std::unique_ptr<S2Point[]> vertices_;
 
   S2Debug s2debug_override_ = S2Debug::ALLOW;
+  S2IndexingMode indexing_mode_ = S2IndexingMode::DEFAULT;
   bool origin_inside_ = false;  // Does the loop contain S2::Origin()?
 
   // In general we build the index the first time it is needed, but we make an
@@ -676,7 +712,7 @@ class S2Loop final : public S2Region {
   // if A.Contains(B), then A.subregion_bound_.Contains(B.bound_).
   S2LatLngRect subregion_bound_;
 
-  // Spatial index for this loop.
+  // Spatial index for this loop.  It is empty if indexing_mode_ is NONE.
   MutableS2ShapeIndex index_;
 
   // SWIG doesn't understand "= delete".
@@ -22,6 +22,7 @@
 #include <cmath>
 #include <limits>
 #include <ostream>
+#include <type_traits>
 #include <vector>
 
 #include "absl/container/inlined_vector.h"
@@ -31,6 +32,7 @@
 #include "s2/s2measures.h"
 #include "s2/s2point.h"
 #include "s2/s2point_span.h"
+#include "s2/s2predicates.h"
 
 using std::fabs;
 using std::max;
@@ -48,6 +50,53 @@ S1Angle GetPerimeter(S2PointLoopSpan loop) {
   return perimeter;
 }
 
+namespace {
+// Returns the length of an edge as computed by S2Point::Angle().
+struct AngleLength {
+  double operator()(const S2Point& a, const S2Point& b) const {
+    return a.Angle(b);
+  }
+};
+}  // namespace
+
+// Computes the same sum as internal::GetSurfaceIntegral() for loops where the
+// origin of the triangle fan never needs to be moved away from V_0, which is
+// true for all loops that do not contain a vertex nearly antipodal to V_0.
+// The triangles are summed in the same order with the same arguments, but
+// each "spoke" (V_0, V_i) of the fan is shared by two consecutive triangles
+// and so its length only needs to be computed once.  "side" returns the
+// length of an edge and must be symmetric in its arguments, and "f_tri"
+// takes the triangle vertices followed by the lengths of the edges opposite
+// each vertex.  Returns false (leaving "sum" in an unspecified state) if the
+// origin would need to be moved, in which case the caller should fall back
+// to internal::GetSurfaceIntegral().
+template <class TSide, class TFunction, class TAccumulator>
+static bool GetFixedOriginSurfaceIntegral(S2PointLoopSpan loop, TSide side,
+                                          TFunction f_tri,
+                                          TAccumulator& sum) {
+  // This must match the value in internal::GetSurfaceIntegral().
+  static const double kMaxLength = M_PI - 1e-5;
+
+  if (loop.size() < 3) return true;
+  const S2Point& origin = loop[0];
+  double spoke = side(origin, loop[1]);
+  for (size_t i = 1; i + 1 < loop.size(); ++i) {
+    double angle = loop[i + 1].Angle(origin);
+    if (angle > kMaxLength) return false;
+    // Avoid computing the same length twice when "side" is AngleLength.
+    double next_spoke;
+    if constexpr (std::is_same_v<TSide, AngleLength>) {
+      next_spoke = angle;
+    } else {
+      next_spoke = side(loop[i + 1], origin);
+    }
+    sum += f_tri(origin, loop[i], loop[i + 1], side(loop[i], loop[i + 1]),
+                 next_spoke, spoke);
+    spoke = next_spoke;
+  }
+  return true;
+}
+
 double GetArea(S2PointLoopSpan loop) {
   double area = GetSignedArea(loop);
   ABSL_DCHECK_LE(fabs(area), 2 * M_PI);
@@ -122,7 +171,18 @@ double GetSignedArea(S2PointLoopSpan loop) {
 
   // The signed area should be between approximately -4*Pi and 4*Pi.
   // Normalize it to be in the range [-2*Pi, 2*Pi].
-  double area = GetSurfaceIntegralKahan(loop, S2::SignedArea);
+  internal::KahanSum<double> sum;
+  if (!GetFixedOriginSurfaceIntegral(
+          loop, internal::StableAngle,
+          [](const S2Point& a, const S2Point& b, const S2Point& c, double sa,
+             double sb, double sc) {
+            return s2pred::Sign(a, b, c) * internal::Area(a, b, c, sa, sb, sc);
+          },
+          sum)) {
+    sum = internal::KahanSum<double>();
+    internal::GetSurfaceIntegral(loop, S2::SignedArea, sum);
+  }
+  double area = static_cast<double>(sum);
   double max_error = GetCurvatureMaxError(loop);
 
   // Normalize the area to be in the range (-2*Pi, 2*Pi].  Effectively this
@@ -268,7 +328,16 @@ S2Point GetCentroid(S2PointLoopSpan loop) {
   // interior, or the negative of the integral of position over the loop
   // exterior.  But these two values are the same (!), because the integral of
   // position over the entire sphere is (0, 0, 0).
-  return GetSurfaceIntegral(loop, S2::TrueCentroid);
+  S2Point centroid;
+  if (!GetFixedOriginSurfaceIntegral(
+          loop, AngleLength(),
+          static_cast<S2Point (*)(const S2Point&, const S2Point&,
+                                  const S2Point&, double, double, double)>(
+              internal::TrueCentroid),
+          centroid)) {
+    centroid = GetSurfaceIntegral<S2Point>(loop, S2::TrueCentroid);
+  }
+  return centroid;
 }
 
 static inline bool IsOrderLess(LoopOrder order1, LoopOrder order2,
@@ -0,0 +1,55 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2loop_measures.h"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "s2/s1angle.h"
+#include "s2/s2point.h"
+#include "s2/s2testing.h"
+
+using std::vector;
+
+namespace {
+
+// Returns a regular loop with state.range(0) vertices and a radius of 10km.
+vector<S2Point> MakeLoop(const benchmark::State& state) {
+  S2Testing::rnd.Reset(1);
+  return S2Testing::MakeRegularPoints(S2Testing::RandomPoint(),
+                                      S2Testing::KmToAngle(10),
+                                      state.range(0));
+}
+
+void BM_GetSignedArea(benchmark::State& state) {
+  const vector<S2Point> loop = MakeLoop(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(S2::GetSignedArea(loop));
+  }
+  state.SetItemsProcessed(state.iterations() * loop.size());
+}
+BENCHMARK(BM_GetSignedArea)->Range(8, 1 << 16);
+
+void BM_GetCentroid(benchmark::State& state) {
+  const vector<S2Point> loop = MakeLoop(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(S2::GetCentroid(loop));
+  }
+  state.SetItemsProcessed(state.iterations() * loop.size());
+}
+BENCHMARK(BM_GetCentroid)->Range(8, 1 << 16);
+
+}  // namespace
@@ -32,6 +32,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "s2/s1angle.h"
+#include "s2/s2centroids.h"
 #include "s2/s2debug.h"
 #include "s2/s2latlng.h"
 #include "s2/s2loop.h"
@@ -544,6 +545,48 @@ TEST_F(LoopTestBase, GetCurvature) {
               0.01 * S2::GetCurvatureMaxError(spiral));
 }
 
+// Checks that GetSignedArea() and GetCentroid() compute exactly the same
+// triangle sums as GetSurfaceIntegral(), which they implement more efficiently
+// when the origin of the triangle fan does not need to be moved.
+static void TestMatchesSurfaceIntegral(const vector<S2Point>& loop) {
+  EXPECT_EQ(S2::GetSurfaceIntegral(loop, S2::TrueCentroid),
+            S2::GetCentroid(loop))
+      << "Failed loop: " << s2textformat::ToString(loop);
+
+  // GetSignedArea() may also adjust areas that are close to zero.
+  double area = remainder(S2::GetSurfaceIntegralKahan(loop, S2::SignedArea),
+                          4 * M_PI);
+  if (area == -2 * M_PI) area = 2 * M_PI;
+  if (fabs(area) > S2::GetCurvatureMaxError(loop)) {
+    EXPECT_EQ(area, S2::GetSignedArea(loop))
+        << "Failed loop: " << s2textformat::ToString(loop);
+  }
+}
+
+TEST_F(LoopTestBase, GetSignedAreaAndCentroidMatchSurfaceIntegral) {
+  // These loops include vertices that are antipodal to the first vertex, so
+  // the origin of the triangle fan must be moved.
+  TestMatchesSurfaceIntegral(north_hemi_);
+  TestMatchesSurfaceIntegral(west_hemi_);
+  TestMatchesSurfaceIntegral(east_hemi_);
+
+  TestMatchesSurfaceIntegral(north_hemi3_);
+  TestMatchesSurfaceIntegral(candy_cane_);
+  TestMatchesSurfaceIntegral(three_leaf_clover_);
+  TestMatchesSurfaceIntegral(tessellated_loop_);
+  for (int iter = 0; iter < 100; ++iter) {
+    const int num_vertices = 3 + S2Testing::rnd.Uniform(100);
+    TestMatchesSurfaceIntegral(S2Testing::MakeRegularPoints(
+        S2Testing::RandomPoint(),
+        S1Angle::Radians(M_PI * S2Testing::rnd.RandDouble()), num_vertices));
+    vector<S2Point> random_loop;
+    for (int i = 0; i < num_vertices; ++i) {
+      random_loop.push_back(S2Testing::RandomPoint());
+    }
+    TestMatchesSurfaceIntegral(random_loop);
+  }
+}
+
 TEST(KahanSum, DefaultValue) {
   S2::internal::KahanSum<double> sum;
   EXPECT_EQ(0.0, (double)sum);
@@ -43,12 +43,14 @@
 #include "s2/r1interval.h"
 #include "s2/s1angle.h"
 #include "s2/s1interval.h"
+#include "s2/s2cap.h"
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2debug.h"
 #include "s2/s2edge_crossings.h"
 #include "s2/s2edge_distances.h"
 #include "s2/s2error.h"
+#include "s2/s2indexing_mode.h"
 #include "s2/s2latlng.h"
 #include "s2/s2latlng_rect.h"
 #include "s2/s2latlng_rect_bounder.h"
@@ -1294,6 +1296,50 @@ TEST_F(S2LoopTestBase, MakeRegularLoop) {
   EXPECT_DOUBLE_EQ(26.392175948257943, S2LatLng(p3).lng().degrees());
 }
 
+TEST(S2Loop, IndexingModeNone) {
+  S2Testing::rnd.Reset(1);
+  const S2Point center = S2Testing::RandomPoint();
+  const vector<S2Point> vertices =
+      S2Testing::MakeRegularPoints(center, S1Angle::Degrees(10), 1000);
+  S2Loop indexed(vertices);
+  S2Loop unindexed;
+  unindexed.set_indexing_mode(S2IndexingMode::NONE);
+  unindexed.Init(vertices);
+  EXPECT_EQ(S2IndexingMode::NONE, unindexed.indexing_mode());
+  EXPECT_LT(unindexed.SpaceUsed(), indexed.SpaceUsed());
+
+  const S2Cap cap(center, S1Angle::Degrees(15));
+  for (int i = 0; i < 1000; ++i) {
+    const S2Point p = S2Testing::SamplePoint(cap);
+    ASSERT_EQ(indexed.Contains(p), unindexed.Contains(p));
+    // The S2Cell methods may be conservative, but they must be consistent
+    // with point containment.
+    const S2Cell cell(S2CellId(p).parent(S2Testing::rnd.Uniform(12)));
+    if (unindexed.Contains(cell)) {
+      ASSERT_TRUE(indexed.Contains(cell.GetCenter()));
+      ASSERT_TRUE(indexed.Contains(cell.GetVertex(0)));
+    }
+    if (!unindexed.MayIntersect(cell)) {
+      ASSERT_FALSE(indexed.Contains(cell.GetCenter()));
+    }
+  }
+  const S2Point far = S2Testing::SamplePoint(cap);
+  EXPECT_EQ(indexed.GetDistance(far), unindexed.GetDistance(far));
+
+  // Loop relations build temporary indexes as necessary.
+  S2Loop inner(
+      S2Testing::MakeRegularPoints(center, S1Angle::Degrees(5), 500));
+  EXPECT_TRUE(unindexed.Contains(inner));
+  EXPECT_TRUE(unindexed.Intersects(inner));
+  EXPECT_FALSE(inner.Contains(unindexed));
+  EXPECT_TRUE(unindexed.IsValid());
+
+  // Switching modes after initialization rebuilds the index.
+  unindexed.set_indexing_mode(S2IndexingMode::EAGER);
+  EXPECT_TRUE(unindexed.Contains(inner));
+  EXPECT_EQ(indexed.SpaceUsed(), unindexed.SpaceUsed());
+}
+
 TEST(S2LoopShape, Basic) {
   unique_ptr<S2Loop> loop = MakeLoopOrDie("0:0, 0:1, 1:0");
   S2Loop::Shape shape(loop.get());
@@ -63,6 +63,14 @@ bool S2MaxDistancePointTarget::UpdateMinDistance(
   return min_dist->UpdateMin(S2MaxDistance(cell.GetMaxDistance(point_)));
 }
 
+bool S2MaxDistancePointTarget::GetChildCellDistances(
+    const S2Cell& cell, S2MaxDistance distances[4]) {
+  S1ChordAngle angles[4];
+  cell.GetChildMaxDistances(point_, angles);
+  for (int i = 0; i < 4; ++i) distances[i] = S2MaxDistance(angles[i]);
+  return true;
+}
+
 bool S2MaxDistancePointTarget::VisitContainingShapeIds(
     const S2ShapeIndex& index,
     absl::FunctionRef<bool(int id, const S2Point& target)> visitor) {
@@ -87,6 +87,8 @@ class S2MaxDistancePointTarget : public S2MaxDistanceTarget {
                          S2MaxDistance* min_dist) final;
   bool UpdateMinDistance(const S2Cell& cell,
                          S2MaxDistance* min_dist) final;
+  bool GetChildCellDistances(const S2Cell& cell,
+                             S2MaxDistance distances[4]) final;
 
   bool VisitContainingShapeIds(
       const S2ShapeIndex& index,
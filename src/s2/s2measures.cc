@@ -78,13 +78,20 @@ double TurnAngle(const S2Point& a, const S2Point& b, const S2Point& c) {
 // Reference: Kahan, W. (2006, Jan 11). "How Futile are Mindless Assessments of
 //   Roundoff in Floating-Point Computation?"
 // (p. 47). https://people.eecs.berkeley.edu/~wkahan/Mindless.pdf
-double StableAngle(S2Point a, S2Point b) {
+double internal::StableAngle(const S2Point& a, const S2Point& b) {
   ABSL_DCHECK(IsUnitLength(a));
   ABSL_DCHECK(IsUnitLength(b));
   return 2 * atan2((a - b).Norm(), (a + b).Norm());
 }
 
 double Area(const S2Point& a, const S2Point& b, const S2Point& c) {
+  return internal::Area(a, b, c, internal::StableAngle(b, c),
+                        internal::StableAngle(c, a),
+                        internal::StableAngle(a, b));
+}
+
+double internal::Area(const S2Point& a, const S2Point& b, const S2Point& c,
+                      double sa, double sb, double sc) {
   ABSL_DCHECK(IsUnitLength(a));
   ABSL_DCHECK(IsUnitLength(b));
   ABSL_DCHECK(IsUnitLength(c));
@@ -125,9 +132,6 @@ double Area(const S2Point& a, const S2Point& b, const S2Point& c) {
   // more information.
   //
   // TODO(ericv): Implement rigorous error bounds (analysis already done).
-  double sa = StableAngle(b, c);
-  double sb = StableAngle(c, a);
-  double sc = StableAngle(a, b);
   double s = 0.5 * (sa + sb + sc);
   if (s >= 3e-4) {
     // Consider whether Girard's formula might be more accurate.
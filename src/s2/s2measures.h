@@ -73,6 +73,21 @@ double GirardArea(const S2Point& a, const S2Point& b, const S2Point& c);
 // and a negative value otherwise.
 double SignedArea(const S2Point& a, const S2Point& b, const S2Point& c);
 
+namespace internal {
+
+// Returns the angle between the unit vectors "a" and "b" as computed by
+// Area().  The result is symmetric in "a" and "b".
+double StableAngle(const S2Point& a, const S2Point& b);
+
+// Like Area(), but takes the side lengths of the triangle as computed by
+// StableAngle(b, c), StableAngle(c, a), and StableAngle(a, b).  This allows
+// callers that compute the areas of many triangles with shared edges (such as
+// triangle fans) to compute the length of each edge only once.  The result is
+// identical to Area(a, b, c).
+double Area(const S2Point& a, const S2Point& b, const S2Point& c, double sa,
+            double sb, double sc);
+
+}  // namespace internal
 }  // namespace S2
 
 #endif  // S2_S2MEASURES_H_
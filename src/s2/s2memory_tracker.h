@@ -22,6 +22,7 @@
 #include <cstdint>
 #include <functional>
 #include <limits>
+#include <utility>
 #include <vector>
 
 #include "absl/log/absl_check.h"
@@ -34,7 +35,8 @@
 // usage of S2 operations.  It provides the following functionality:
 //
 //  - Tracks the current and maximum memory usage of certain S2 classes
-//    (including S2Builder, S2BooleanOperation, and S2BufferOperation).
+//    (including S2Builder, S2BooleanOperation, S2BufferOperation,
+//    MutableS2ShapeIndex, and the S2ClosestEdgeQuery family).
 //
 //  - Supports cancelling the current operation if a given memory limit would
 //    otherwise be exceeded.
@@ -46,6 +48,10 @@
 //    thread or process is too high, a deadline was exceeded, an external
 //    cancellation request was received, etc.
 //
+//  - Invokes an optional callback whenever the peak memory usage grows by a
+//    given amount, so that peak usage can be monitored across many
+//    operations that share the same tracker.
+//
 // To use it, clients simply create an S2MemoryTracker object and pass it to
 // the desired S2 operations.  For example:
 //
@@ -174,12 +180,39 @@ class S2MemoryTracker {
   }
   const PeriodicCallback& periodic_callback() const { return callback_; }
 
+  // A function that is called to report a new peak in tracked memory usage.
+  using PeakUsageCallback = std::function<void (int64 max_usage_bytes)>;
+
+  // Sets a function that is called whenever max_usage_bytes() has grown by
+  // at least "peak_delta_bytes" since the previous call (or since this method
+  // was called).  This is useful for monitoring the peak memory usage of a
+  // long sequence of operations that share the same tracker, e.g.
+  //
+  //   tracker.set_peak_usage_callback(100 << 20 /*100 MB*/, [](int64 bytes) {
+  //     ABSL_LOG(INFO) << "S2 peak memory usage: " << bytes;
+  //   });
+  //
+  // Like the periodic callback, this function may call SetError() to cancel
+  // the current operation.  Once an error has occurred, further callbacks are
+  // suppressed.
+  void set_peak_usage_callback(int64 peak_delta_bytes,
+                               PeakUsageCallback peak_usage_callback) {
+    peak_delta_bytes_ = peak_delta_bytes;
+    peak_callback_ = std::move(peak_usage_callback);
+    peak_limit_bytes_ = max_usage_bytes_ + peak_delta_bytes_;
+  }
+  int64 peak_delta_bytes() const { return peak_delta_bytes_; }
+  const PeakUsageCallback& peak_usage_callback() const {
+    return peak_callback_;
+  }
+
   // Resets usage() and max_usage() to zero and clears any error.  Leaves all
   // other parameters unchanged.
   void Reset() {
     error_.Clear();
     usage_bytes_ = max_usage_bytes_ = alloc_bytes_ = 0;
     callback_alloc_limit_bytes_ = callback_alloc_delta_bytes_;
+    peak_limit_bytes_ = peak_delta_bytes_;
   }
 
   //////////////////////////////////////////////////////////////////////
@@ -273,15 +306,15 @@ class S2MemoryTracker {
 
     // Adds the memory used by the given vector to the current tally.  Returns
     // false if the current operation should be cancelled.
-    template <class T>
-    inline bool Tally(const std::vector<T>& v) {
+    template <class T, class A>
+    inline bool Tally(const std::vector<T, A>& v) {
       return Tally(v.capacity() * sizeof(v[0]));
     }
 
     // Subtracts the memory used by the given vector from the current tally.
     // Returns false if the current operation should be cancelled.
-    template <class T>
-    inline bool Untally(const std::vector<T>& v) {
+    template <class T, class A>
+    inline bool Untally(const std::vector<T, A>& v) {
       return Tally(-v.capacity() * sizeof(v[0]));
     }
 
@@ -304,12 +337,12 @@ class S2MemoryTracker {
     }
 
     // Deallocates storage for the given vector and updates the memory
-    // tracking accordingly.  Returns false if the current operation should be
-    // cancelled.
+    // tracking accordingly.  The vector keeps its allocator.  Returns false
+    // if the current operation should be cancelled.
     template <class T>
     inline bool Clear(T* v) {
       int64 old_capacity = v->capacity();
-      T().swap(*v);
+      T(v->get_allocator()).swap(*v);
       return Tally(-old_capacity * sizeof((*v)[0]));
     }
 
@@ -351,6 +384,9 @@ class S2MemoryTracker {
   PeriodicCallback callback_;
   int64 callback_alloc_delta_bytes_ = 0;
   int64 callback_alloc_limit_bytes_ = kNoLimit;
+  PeakUsageCallback peak_callback_;
+  int64 peak_delta_bytes_ = 0;
+  int64 peak_limit_bytes_ = kNoLimit;
 };
 
 
@@ -366,7 +402,13 @@ void S2MemoryTracker::SetError(S2Error::Code code,
 inline bool S2MemoryTracker::Tally(int64 delta_bytes) {
   usage_bytes_ += delta_bytes;
   alloc_bytes_ += std::max(int64{0}, delta_bytes);
-  max_usage_bytes_ = std::max(max_usage_bytes_, usage_bytes_);
+  if (usage_bytes_ > max_usage_bytes_) {
+    max_usage_bytes_ = usage_bytes_;
+    if (peak_callback_ && max_usage_bytes_ >= peak_limit_bytes_) {
+      peak_limit_bytes_ = max_usage_bytes_ + peak_delta_bytes_;
+      if (ok()) peak_callback_(max_usage_bytes_);
+    }
+  }
   if (usage_bytes_ > limit_bytes_ && ok()) SetLimitExceededError();
   if (callback_ && alloc_bytes_ >= callback_alloc_limit_bytes_) {
     callback_alloc_limit_bytes_ = alloc_bytes_ + callback_alloc_delta_bytes_;
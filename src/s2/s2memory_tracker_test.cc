@@ -17,7 +17,15 @@
 
 #include "s2/s2memory_tracker.h"
 
+#include <vector>
+
+#include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "s2/base/types.h"
+#include "s2/s2error.h"
+
+using std::vector;
+using testing::ElementsAre;
 
 TEST(S2MemoryTracker, PeriodicCallback) {
   S2MemoryTracker tracker;
@@ -48,3 +56,44 @@ TEST(S2MemoryTracker, PeriodicCallback) {
   client.Tally(1);
   EXPECT_EQ(callback_count, 4);
 }
+
+TEST(S2MemoryTracker, PeakUsageCallback) {
+  S2MemoryTracker tracker;
+  vector<int64> peaks;
+  S2MemoryTracker::Client client(&tracker);
+  tracker.set_peak_usage_callback(
+      100, [&](int64 max_usage_bytes) { peaks.push_back(max_usage_bytes); });
+  ASSERT_EQ(tracker.peak_delta_bytes(), 100);
+
+  // The callback is based on peak usage rather than total allocated bytes.
+  client.Tally(99);
+  EXPECT_THAT(peaks, ElementsAre());
+  client.Tally(-50);
+  client.Tally(50);
+  client.Tally(1);
+  EXPECT_THAT(peaks, ElementsAre(100));
+  client.Tally(-100);
+  client.Tally(199);
+  EXPECT_THAT(peaks, ElementsAre(100));
+  client.Tally(50);
+  EXPECT_THAT(peaks, ElementsAre(100, 249));
+
+  // The callback may cancel the operation, after which further callbacks
+  // are suppressed.
+  tracker.set_peak_usage_callback(1, [&](int64 max_usage_bytes) {
+    peaks.push_back(max_usage_bytes);
+    tracker.SetError(S2Error::CANCELLED, "Peak usage too high");
+  });
+  EXPECT_FALSE(client.Tally(1));
+  EXPECT_EQ(tracker.error().code(), S2Error::CANCELLED);
+  EXPECT_FALSE(client.Tally(10));
+  EXPECT_THAT(peaks, ElementsAre(100, 249, 250));
+
+  // Reset() restarts peak reporting from zero.
+  client.Tally(-client.client_usage_bytes());
+  tracker.set_peak_usage_callback(
+      1, [&](int64 max_usage_bytes) { peaks.push_back(max_usage_bytes); });
+  tracker.Reset();
+  EXPECT_TRUE(client.Tally(1));
+  EXPECT_THAT(peaks, ElementsAre(100, 249, 250, 1));
+}
@@ -36,91 +36,97 @@
 
 namespace S2 {
 
-const LengthMetric kMinAngleSpan(
+// The metrics are defined using constant expressions throughout (rather than
+// calling sqrt()) so that they are initialized at compile time.  These are
+// the correctly rounded values of sqrt(2/3) and sqrt(3).
+static constexpr double kSqrt2Over3 = 0.81649658092772603;
+static constexpr double kSqrt3 = 1.7320508075688772;
+
+constexpr LengthMetric kMinAngleSpan(
     S2_PROJECTION == S2_LINEAR_PROJECTION ? 1.0 :                      // 1.000
     S2_PROJECTION == S2_TAN_PROJECTION ? M_PI / 2 :                    // 1.571
     S2_PROJECTION == S2_QUADRATIC_PROJECTION ? 4. / 3 :                // 1.333
     0);
 
-const LengthMetric kMaxAngleSpan(
+constexpr LengthMetric kMaxAngleSpan(
     S2_PROJECTION == S2_LINEAR_PROJECTION ? 2 :                        // 2.000
     S2_PROJECTION == S2_TAN_PROJECTION ? M_PI / 2 :                    // 1.571
     S2_PROJECTION == S2_QUADRATIC_PROJECTION ? 1.704897179199218452 :  // 1.705
     0);
 
-const LengthMetric kAvgAngleSpan(M_PI / 2);                    // 1.571
+constexpr LengthMetric kAvgAngleSpan(M_PI / 2);                // 1.571
 // This is true for all projections.
 
-const LengthMetric kMinWidth(
-    S2_PROJECTION == S2_LINEAR_PROJECTION ? sqrt(2. / 3) :             // 0.816
-    S2_PROJECTION == S2_TAN_PROJECTION ? M_PI / (2 * sqrt(2)) :        // 1.111
-    S2_PROJECTION == S2_QUADRATIC_PROJECTION ? 2 * sqrt(2) / 3 :       // 0.943
+constexpr LengthMetric kMinWidth(
+    S2_PROJECTION == S2_LINEAR_PROJECTION ? kSqrt2Over3 :              // 0.816
+    S2_PROJECTION == S2_TAN_PROJECTION ? M_PI / (2 * M_SQRT2) :        // 1.111
+    S2_PROJECTION == S2_QUADRATIC_PROJECTION ? 2 * M_SQRT2 / 3 :       // 0.943
     0);
 
-const LengthMetric kMaxWidth(kMaxAngleSpan.deriv());
+constexpr LengthMetric kMaxWidth(kMaxAngleSpan.deriv());
 // This is true for all projections.
 
-const LengthMetric kAvgWidth(
+constexpr LengthMetric kAvgWidth(
     S2_PROJECTION == S2_LINEAR_PROJECTION ? 1.411459345844456965 :     // 1.411
     S2_PROJECTION == S2_TAN_PROJECTION ? 1.437318638925160885 :        // 1.437
     S2_PROJECTION == S2_QUADRATIC_PROJECTION ? 1.434523672886099389 :  // 1.435
     0);
 
-const LengthMetric kMinEdge(
-    S2_PROJECTION == S2_LINEAR_PROJECTION ? 2 * sqrt(2) / 3 :          // 0.943
-    S2_PROJECTION == S2_TAN_PROJECTION ? M_PI / (2 * sqrt(2)) :        // 1.111
-    S2_PROJECTION == S2_QUADRATIC_PROJECTION ? 2 * sqrt(2) / 3 :       // 0.943
+constexpr LengthMetric kMinEdge(
+    S2_PROJECTION == S2_LINEAR_PROJECTION ? 2 * M_SQRT2 / 3 :          // 0.943
+    S2_PROJECTION == S2_TAN_PROJECTION ? M_PI / (2 * M_SQRT2) :        // 1.111
+    S2_PROJECTION == S2_QUADRATIC_PROJECTION ? 2 * M_SQRT2 / 3 :       // 0.943
     0);
 
-const LengthMetric kMaxEdge(kMaxAngleSpan.deriv());
+constexpr LengthMetric kMaxEdge(kMaxAngleSpan.deriv());
 // This is true for all projections.
 
-const LengthMetric kAvgEdge(
+constexpr LengthMetric kAvgEdge(
     S2_PROJECTION == S2_LINEAR_PROJECTION ? 1.440034192955603643 :     // 1.440
     S2_PROJECTION == S2_TAN_PROJECTION ? 1.461667032546739266 :        // 1.462
     S2_PROJECTION == S2_QUADRATIC_PROJECTION ? 1.459213746386106062 :  // 1.459
     0);
 
-const LengthMetric kMinDiag(
-    S2_PROJECTION == S2_LINEAR_PROJECTION ? 2 * sqrt(2) / 3 :          // 0.943
-    S2_PROJECTION == S2_TAN_PROJECTION ? M_PI * sqrt(2) / 3 :          // 1.481
-    S2_PROJECTION == S2_QUADRATIC_PROJECTION ? 8 * sqrt(2) / 9 :       // 1.257
+constexpr LengthMetric kMinDiag(
+    S2_PROJECTION == S2_LINEAR_PROJECTION ? 2 * M_SQRT2 / 3 :          // 0.943
+    S2_PROJECTION == S2_TAN_PROJECTION ? M_PI * M_SQRT2 / 3 :          // 1.481
+    S2_PROJECTION == S2_QUADRATIC_PROJECTION ? 8 * M_SQRT2 / 9 :       // 1.257
     0);
 
-const LengthMetric kMaxDiag(
-    S2_PROJECTION == S2_LINEAR_PROJECTION ? 2 * sqrt(2) :              // 2.828
-    S2_PROJECTION == S2_TAN_PROJECTION ? M_PI * sqrt(2. / 3) :         // 2.565
+constexpr LengthMetric kMaxDiag(
+    S2_PROJECTION == S2_LINEAR_PROJECTION ? 2 * M_SQRT2 :              // 2.828
+    S2_PROJECTION == S2_TAN_PROJECTION ? M_PI * kSqrt2Over3 :          // 2.565
     S2_PROJECTION == S2_QUADRATIC_PROJECTION ? 2.438654594434021032 :  // 2.439
     0);
 
-const LengthMetric kAvgDiag(
+constexpr LengthMetric kAvgDiag(
     S2_PROJECTION == S2_LINEAR_PROJECTION ? 2.031817866418812674 :     // 2.032
     S2_PROJECTION == S2_TAN_PROJECTION ? 2.063623197195635753 :        // 2.064
     S2_PROJECTION == S2_QUADRATIC_PROJECTION ? 2.060422738998471683 :  // 2.060
     0);
 
-const AreaMetric kMinArea(
-    S2_PROJECTION == S2_LINEAR_PROJECTION ? 4 / (3 * sqrt(3)) :        // 0.770
-    S2_PROJECTION == S2_TAN_PROJECTION ? (M_PI*M_PI) / (4*sqrt(2)) :   // 1.745
-    S2_PROJECTION == S2_QUADRATIC_PROJECTION ? 8 * sqrt(2) / 9 :       // 1.257
+constexpr AreaMetric kMinArea(
+    S2_PROJECTION == S2_LINEAR_PROJECTION ? 4 / (3 * kSqrt3) :         // 0.770
+    S2_PROJECTION == S2_TAN_PROJECTION ? (M_PI*M_PI) / (4*M_SQRT2) :   // 1.745
+    S2_PROJECTION == S2_QUADRATIC_PROJECTION ? 8 * M_SQRT2 / 9 :       // 1.257
     0);
 
-const AreaMetric kMaxArea(
+constexpr AreaMetric kMaxArea(
     S2_PROJECTION == S2_LINEAR_PROJECTION ? 4 :                        // 4.000
     S2_PROJECTION == S2_TAN_PROJECTION ? M_PI * M_PI / 4 :             // 2.467
     S2_PROJECTION == S2_QUADRATIC_PROJECTION ? 2.635799256963161491 :  // 2.636
     0);
 
-const AreaMetric kAvgArea(4 * M_PI / 6);                       // 2.094
+constexpr AreaMetric kAvgArea(4 * M_PI / 6);                   // 2.094
 // This is true for all projections.
 
-const double kMaxEdgeAspect = (
-    S2_PROJECTION == S2_LINEAR_PROJECTION ? sqrt(2) :                  // 1.414
-    S2_PROJECTION == S2_TAN_PROJECTION ?  sqrt(2) :                    // 1.414
+constexpr double kMaxEdgeAspect = (
+    S2_PROJECTION == S2_LINEAR_PROJECTION ? M_SQRT2 :                  // 1.414
+    S2_PROJECTION == S2_TAN_PROJECTION ?  M_SQRT2 :                    // 1.414
     S2_PROJECTION == S2_QUADRATIC_PROJECTION ? 1.442615274452682920 :  // 1.443
     0);
 
-const double kMaxDiagAspect = sqrt(3);                             // 1.732
+constexpr double kMaxDiagAspect = kSqrt3;                          // 1.732
 // This is true for all projections.
 
 }  // namespace S2
@@ -44,7 +44,7 @@ template <int dim> class Metric {
 
   // The "deriv" value of a metric is a derivative, and must be multiplied by
   // a length or area in (s,t)-space to get a useful value.
-  double deriv() const { return deriv_; }
+  constexpr double deriv() const { return deriv_; }
 
   // Return the value of a metric for cells at the given level. The value is
   // either a length or an area on the unit sphere, depending on the
@@ -19,10 +19,14 @@
 
 #include <cmath>
 
+#include <cstddef>
 #include <memory>
+#include <queue>
 #include <utility>
+#include <vector>
 
 #include "absl/functional/function_ref.h"
+#include "absl/types/span.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s2cap.h"
 #include "s2/s2cell.h"
@@ -35,11 +39,14 @@
 #include "s2/s2distance_target.h"
 #include "s2/s2edge_distances.h"
 #include "s2/s2point.h"
+#include "s2/s2predicates.h"
 #include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
 #include "s2/s2shape_index_region.h"
 
+using absl::Span;
 using std::make_unique;
+using std::vector;
 
 S2Cap S2MinDistancePointTarget::GetCapBound() {
   return S2Cap(point_, S1ChordAngle::Zero());
@@ -60,6 +67,44 @@ bool S2MinDistancePointTarget::UpdateMinDistance(
   return min_dist->UpdateMin(S2MinDistance(cell.GetDistance(point_)));
 }
 
+bool S2MinDistancePointTarget::GetChildCellDistances(
+    const S2Cell& cell, S2MinDistance distances[4]) {
+  S1ChordAngle angles[4];
+  cell.GetChildDistances(point_, angles);
+  for (int i = 0; i < 4; ++i) distances[i] = S2MinDistance(angles[i]);
+  return true;
+}
+
+bool S2MinDistancePointTarget::GetEdgeCandidates(
+    const S2Shape& shape, Span<const int> edge_ids,
+    const S2MinDistance& min_dist, vector<int>* candidates) {
+  const size_t n = edge_ids.size();
+  for (auto& coords : coords_) coords.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    S2Shape::Edge edge = shape.edge(edge_ids[i]);
+    for (int j = 0; j < 3; ++j) {
+      coords_[j][i] = edge.v0[j];
+      coords_[3 + j][i] = edge.v1[j];
+    }
+  }
+  const size_t start = candidates->size();
+  S2::GetMinDistanceCandidates(point_, {coords_[0], coords_[1], coords_[2]},
+                               {coords_[3], coords_[4], coords_[5]}, min_dist,
+                               candidates);
+  // Convert the positions within "edge_ids" to edge ids.
+  for (size_t i = start; i < candidates->size(); ++i) {
+    (*candidates)[i] = edge_ids[(*candidates)[i]];
+  }
+  return true;
+}
+
+bool S2MinDistancePointTarget::GetPointCandidates(
+    const s2pred::PointArrays& points, const S2MinDistance& min_dist,
+    vector<int>* candidates) {
+  S2::GetMinPointDistanceCandidates(point_, points, min_dist, candidates);
+  return true;
+}
+
 bool S2MinDistancePointTarget::VisitContainingShapeIds(
     const S2ShapeIndex& index,
     absl::FunctionRef<bool(int shape_id, const S2Point& target_point)>
@@ -313,3 +358,155 @@ bool S2MinDistanceShapeIndexTarget::VisitContainingShapeIds(
   }
   return true;
 }
+
+namespace {
+
+// A cell in the traversal of an S2ShapeIndex by FindClosestEdge() below.
+// Each node is either an index cell or the smallest cell containing two or
+// more index cells.
+struct IndexNode {
+  S2CellId id;
+  const S2ShapeIndexCell* index_cell;  // Non-null iff "id" is an index cell.
+};
+
+// Sets "node" to the smallest cell that contains every index cell within
+// "id", and returns false if there are no such index cells.
+bool GetIndexNode(S2CellId id, S2ShapeIndex::Iterator* it, IndexNode* node) {
+  it->Seek(id.range_min());
+  if (it->done() || it->id() > id.range_max()) return false;
+  S2CellId first = it->id();
+  const S2ShapeIndexCell* first_cell = &it->cell();
+  it->Seek(id.range_max().next());
+  it->Prev();
+  if (it->id() == first) {
+    *node = {first, first_cell};
+  } else {
+    *node = {first.parent(first.GetCommonAncestorLevel(it->id())), nullptr};
+  }
+  return true;
+}
+
+// A pair of nodes (one from each index) together with a lower bound on the
+// distance between any of their edges.
+struct NodePair {
+  S1ChordAngle distance;
+  IndexNode a, b;
+
+  // Reversed so that std::priority_queue returns the closest pair first.
+  bool operator<(const NodePair& other) const {
+    return other.distance < distance;
+  }
+};
+
+}  // namespace
+
+bool S2MinDistanceShapeIndexTarget::FindClosestEdge(
+    const S2ShapeIndex& query_index, S2MinDistance* min_dist, int* shape_id,
+    int* edge_id) {
+  if (use_brute_force()) return false;
+  const S1ChordAngle max_error = query_->options().max_error();
+  S2MinDistance best = *min_dist, limit = *min_dist;
+  int best_shape_id = -1, best_edge_id = -1;
+
+  // If the interior of this target counts, then any connected component of
+  // "query_index" with a vertex inside this target is at distance zero.
+  // (Other components can only touch the interior by crossing its boundary,
+  // which is found by the edge traversal below.)
+  if (include_interiors() && S1ChordAngle::Zero() < limit) {
+    for (int id = 0; id < query_index.num_shape_ids() && best_shape_id < 0;
+         ++id) {
+      const S2Shape* shape = query_index.shape(id);
+      if (shape == nullptr) continue;
+      for (int c = 0; c < shape->num_chains(); ++c) {
+        S2Shape::Chain chain = shape->chain(c);
+        if (chain.length == 0) continue;
+        S2MinDistancePointTarget target(shape->chain_edge(c, 0).v0);
+        target.VisitContainingShapeIds(*index_, [&](int, const S2Point&) {
+          best_shape_id = id;
+          best_edge_id = chain.start;
+          return false;
+        });
+        if (best_shape_id >= 0) break;
+      }
+    }
+    if (best_shape_id >= 0) {
+      *min_dist = S2MinDistance::Zero();
+      *shape_id = best_shape_id;
+      *edge_id = best_edge_id;
+      return true;
+    }
+  }
+
+  // Otherwise traverse both indexes at once, always expanding the pair of
+  // cells with the smallest lower bound and splitting the larger of the two
+  // cells (unless it is an index cell).  The traversal stops once no
+  // remaining pair can contain a closer pair of edges.
+  S2ShapeIndex::Iterator a_iter(&query_index, S2ShapeIndex::UNPOSITIONED);
+  S2ShapeIndex::Iterator b_iter(index_, S2ShapeIndex::UNPOSITIONED);
+  vector<IndexNode> a_nodes, b_nodes;
+  for (int face = 0; face < 6; ++face) {
+    IndexNode node;
+    S2CellId id = S2CellId::FromFace(face);
+    if (GetIndexNode(id, &a_iter, &node)) a_nodes.push_back(node);
+    if (GetIndexNode(id, &b_iter, &node)) b_nodes.push_back(node);
+  }
+  std::priority_queue<NodePair> queue;
+  auto enqueue = [&queue, &limit](const IndexNode& a, const IndexNode& b) {
+    S1ChordAngle distance = S2Cell(a.id).GetDistance(S2Cell(b.id));
+    if (distance < limit) queue.push({distance, a, b});
+  };
+  for (const IndexNode& a : a_nodes) {
+    for (const IndexNode& b : b_nodes) enqueue(a, b);
+  }
+  while (!queue.empty()) {
+    NodePair pair = queue.top();
+    queue.pop();
+    if (!(pair.distance < limit)) break;
+    const IndexNode& a = pair.a;
+    const IndexNode& b = pair.b;
+    if (a.index_cell != nullptr && b.index_cell != nullptr) {
+      // Test every pair of edges.
+      for (int i = 0; i < a.index_cell->num_clipped(); ++i) {
+        const S2ClippedShape& a_clipped = a.index_cell->clipped(i);
+        const S2Shape& a_shape = *query_index.shape(a_clipped.shape_id());
+        for (int ai = 0; ai < a_clipped.num_edges(); ++ai) {
+          S2Shape::Edge ae = a_shape.edge(a_clipped.edge(ai));
+          for (int j = 0; j < b.index_cell->num_clipped(); ++j) {
+            const S2ClippedShape& b_clipped = b.index_cell->clipped(j);
+            const S2Shape& b_shape = *index_->shape(b_clipped.shape_id());
+            for (int bj = 0; bj < b_clipped.num_edges(); ++bj) {
+              S2Shape::Edge be = b_shape.edge(b_clipped.edge(bj));
+              if (S2::UpdateEdgePairMinDistance(ae.v0, ae.v1, be.v0, be.v1,
+                                                &best)) {
+                best_shape_id = a_clipped.shape_id();
+                best_edge_id = a_clipped.edge(ai);
+                limit = best - max_error;
+              }
+            }
+          }
+        }
+      }
+      continue;
+    }
+    // Split the larger cell into its children.
+    bool split_a = b.index_cell != nullptr ||
+                   (a.index_cell == nullptr && a.id.level() <= b.id.level());
+    S2CellId id = split_a ? a.id : b.id;
+    S2ShapeIndex::Iterator* it = split_a ? &a_iter : &b_iter;
+    for (int k = 0; k < 4; ++k) {
+      IndexNode child;
+      if (!GetIndexNode(id.child(k), it, &child)) continue;
+      if (split_a) {
+        enqueue(child, b);
+      } else {
+        enqueue(a, child);
+      }
+    }
+  }
+  if (best_shape_id >= 0) {
+    *min_dist = best;
+    *shape_id = best_shape_id;
+    *edge_id = best_edge_id;
+  }
+  return true;
+}
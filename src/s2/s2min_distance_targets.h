@@ -24,7 +24,9 @@
 #define S2_S2MIN_DISTANCE_TARGETS_H_
 
 #include <memory>
+#include <vector>
 
+#include "absl/types/span.h"
 #include "s2/_fp_contract_off.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
@@ -35,6 +37,8 @@
 #include "s2/s2distance_target.h"
 #include "s2/s2edge_distances.h"
 #include "s2/s2point.h"
+#include "s2/s2predicates.h"
+#include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
 
 // Forward references because these classes depend on the types defined here.
@@ -82,6 +86,14 @@ class S2MinDistancePointTarget : public S2MinDistanceTarget {
                          S2MinDistance* min_dist) final;
   bool UpdateMinDistance(const S2Cell& cell,
                          S2MinDistance* min_dist) final;
+  bool GetChildCellDistances(const S2Cell& cell,
+                             S2MinDistance distances[4]) final;
+  bool GetEdgeCandidates(const S2Shape& shape, absl::Span<const int> edge_ids,
+                         const S2MinDistance& min_dist,
+                         std::vector<int>* candidates) final;
+  bool GetPointCandidates(const s2pred::PointArrays& points,
+                          const S2MinDistance& min_dist,
+                          std::vector<int>* candidates) final;
   bool VisitContainingShapeIds(
       const S2ShapeIndex& index,
       absl::FunctionRef<bool(int shape_id, const S2Point& target)> visitor)
@@ -89,6 +101,10 @@ class S2MinDistancePointTarget : public S2MinDistanceTarget {
 
  private:
   S2Point point_;
+
+  // The edge endpoints passed to S2::GetMinDistanceCandidates(), in
+  // structure-of-arrays layout.  These are kept to avoid reallocation.
+  std::vector<double> coords_[6];
 };
 
 // An S2DistanceTarget subtype for computing the minimum distance to a edge.
@@ -231,6 +247,15 @@ class S2MinDistanceShapeIndexTarget : public S2MinDistanceTarget {
       const S2ShapeIndex& query_index,
       absl::FunctionRef<bool(int shape_id, const S2Point& target_point)>) final;
 
+  // Finds the closest edge of "query_index" by traversing the cells of both
+  // indexes simultaneously, pruning pairs of cells whose distance is at
+  // least the best distance found so far.  This is much faster than
+  // measuring the distance to this target from every cell and edge of
+  // "query_index" separately.  Returns false if use_brute_force() is true.
+  bool FindClosestEdge(const S2ShapeIndex& query_index,
+                       S2MinDistance* min_dist, int* shape_id,
+                       int* edge_id) final;
+
  private:
   bool UpdateMinDistance(S2MinDistanceTarget* target, S2MinDistance* min_dist);
 
@@ -0,0 +1,416 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2MOVING_POINT_INDEX_H_
+#define S2_S2MOVING_POINT_INDEX_H_
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/btree_map.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/log/absl_check.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "s2/base/types.h"
+#include "s2/s1chord_angle.h"
+#include "s2/s2cell.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2point.h"
+
+// S2MovingPointIndex is an index of points that move frequently, such as the
+// positions of a fleet of vehicles.  Unlike S2PointIndex, points are
+// identified by a client-supplied id and can be relocated in place, and
+// readers query immutable snapshots so that they are never blocked or
+// invalidated by updates.
+//
+// Points are grouped into buckets, one per S2Cell at a fixed "bucket level".
+// Moving a point within its bucket just overwrites its position; moving it
+// to another bucket removes it from one small array and appends it to
+// another.  Neither operation touches a btree node or any other point.
+//
+// Updates are made by a single writer thread (or several threads that
+// synchronize externally) and become visible to readers when Publish() is
+// called.  Any number of threads may call snapshot() and query the returned
+// Snapshot concurrently with the writer:
+//
+//   S2MovingPointIndex<VehicleInfo> index;
+//   // Writer thread, once per second:
+//   std::vector<S2MovingPointIndex<VehicleInfo>::Update> updates = ...;
+//   index.ApplyUpdates(updates);  // Calls Publish().
+//
+//   // Reader threads:
+//   auto snapshot = index.snapshot();
+//   std::vector<S2MovingPointIndex<VehicleInfo>::Result> results;
+//   snapshot->FindClosestPoints(target, 10, S1ChordAngle::Infinity(),
+//                               &results);
+//
+// Snapshots share unmodified buckets with each other and with the writer's
+// working state (copy-on-write), so publishing a batch costs time
+// proportional to the number of buckets plus the size of the buckets that
+// were modified, and a Snapshot remains valid and unchanged for as long as
+// a reader holds it.  Query latency therefore does not depend on the update
+// rate.
+//
+// REQUIRES: "Data" is copyable.
+template <class Data = std::tuple<> /*empty class*/>
+class S2MovingPointIndex {
+ public:
+  // The default bucket level, whose cells are about 1km across.  Queries are
+  // fastest when a bucket contains tens to hundreds of points.
+  static constexpr int kDefaultBucketLevel = 13;
+
+  // A point stored in the index.
+  struct Entry {
+    S2Point point;
+    int64 id;
+    Data data;
+  };
+
+  // A point returned by Snapshot::FindClosestPoints().
+  struct Result {
+    S1ChordAngle distance;
+    Entry entry;
+  };
+
+  // An update for ApplyUpdates().
+  struct Update {
+    enum class Type : uint8 { ADD, MOVE, REMOVE };
+
+    Type type = Type::MOVE;
+    int64 id = 0;
+    S2Point point;  // Ignored by REMOVE.
+    Data data{};    // Only used by ADD.
+  };
+
+ private:
+  using Bucket = std::vector<Entry>;
+
+ public:
+  // An immutable view of the index as of some call to Publish().
+  class Snapshot {
+   public:
+    // Returns the number of points in the snapshot.
+    int num_points() const { return num_points_; }
+
+    // Returns the version of the index that this snapshot represents, which
+    // is incremented by every call to Publish() that changes the index.
+    int64 version() const { return version_; }
+
+    // Sets "results" to the (at most) "max_results" points closest to
+    // "target" whose distance is less than "max_distance", sorted by
+    // distance.  Ties are broken arbitrarily.
+    void FindClosestPoints(const S2Point& target, int max_results,
+                           S1ChordAngle max_distance,
+                           std::vector<Result>* results) const;
+
+    // Calls "visitor" for every point in the snapshot, in bucket order.
+    template <class Visitor>
+    void VisitPoints(const Visitor& visitor) const {
+      for (const auto& [id, bucket] : buckets_) {
+        for (const Entry& entry : *bucket) visitor(entry);
+      }
+    }
+
+   private:
+    friend class S2MovingPointIndex;
+
+    int bucket_level_ = kDefaultBucketLevel;
+    int num_points_ = 0;
+    int64 version_ = 0;
+    // Non-empty buckets sorted by S2CellId.
+    std::vector<std::pair<S2CellId, std::shared_ptr<const Bucket>>> buckets_;
+  };
+
+  explicit S2MovingPointIndex(int bucket_level = kDefaultBucketLevel);
+
+  S2MovingPointIndex(const S2MovingPointIndex&) = delete;
+  S2MovingPointIndex& operator=(const S2MovingPointIndex&) = delete;
+
+  int bucket_level() const { return bucket_level_; }
+
+  // Returns the number of points in the working state, including updates
+  // that have not been published yet.
+  int num_points() const { return locations_.size(); }
+
+  // Returns true if a point with the given id is in the working state.
+  bool contains(int64 id) const { return locations_.contains(id); }
+
+  // Adds a point with the given id.  Returns false (and does nothing) if the
+  // id is already present.
+  bool Add(int64 id, const S2Point& point, const Data& data = Data());
+
+  // Moves the point with the given id to "point", keeping its data.  Returns
+  // false if the id is not present.
+  bool Move(int64 id, const S2Point& point);
+
+  // Removes the point with the given id.  Returns false if the id is not
+  // present.
+  bool Remove(int64 id);
+
+  // Applies the given updates in order and then calls Publish(), so that
+  // readers see either none or all of them.  Returns the number of updates
+  // that failed (see Add, Move, and Remove).
+  int ApplyUpdates(absl::Span<const Update> updates);
+
+  // Makes all the updates since the last call visible to snapshot().
+  void Publish();
+
+  // Returns the most recently published snapshot.  This method is
+  // thread-safe, and the snapshot may be used for as long as the caller
+  // likes, including after the index itself has been destroyed.
+  std::shared_ptr<const Snapshot> snapshot() const;
+
+ private:
+  // The position of a point in the working state.
+  struct Location {
+    S2CellId bucket_id;
+    int32 slot;
+  };
+
+  S2CellId BucketId(const S2Point& point) const {
+    return S2CellId(point).parent(bucket_level_);
+  }
+
+  // Returns the bucket with the given id for modification, copying it first
+  // if it is shared with a published snapshot.
+  Bucket* MutableBucket(S2CellId bucket_id);
+
+  // Removes the entry at "location", updating the location of the entry
+  // that is moved into its slot.
+  void RemoveEntry(const Location& location);
+
+  // Appends "entry" to the appropriate bucket and records its location.
+  void AppendEntry(Entry entry);
+
+  const int bucket_level_;
+
+  // The working state.  Buckets whose use_count() is greater than one are
+  // shared with a snapshot and must be copied before they are modified.
+  absl::btree_map<S2CellId, std::shared_ptr<Bucket>> buckets_;
+  absl::flat_hash_map<int64, Location> locations_;
+  bool modified_ = false;
+  int64 version_ = 0;
+
+  mutable absl::Mutex mutex_;
+  std::shared_ptr<const Snapshot> snapshot_ ABSL_GUARDED_BY(mutex_);
+};
+
+
+//////////////////   Implementation details follow   ////////////////////
+
+
+template <class Data>
+S2MovingPointIndex<Data>::S2MovingPointIndex(int bucket_level)
+    : bucket_level_(bucket_level) {
+  ABSL_DCHECK_GE(bucket_level, 0);
+  ABSL_DCHECK_LE(bucket_level, S2CellId::kMaxLevel);
+  auto snapshot = std::make_shared<Snapshot>();
+  snapshot->bucket_level_ = bucket_level;
+  absl::MutexLock lock(&mutex_);
+  snapshot_ = std::move(snapshot);
+}
+
+template <class Data>
+typename S2MovingPointIndex<Data>::Bucket*
+S2MovingPointIndex<Data>::MutableBucket(S2CellId bucket_id) {
+  std::shared_ptr<Bucket>& bucket = buckets_[bucket_id];
+  if (bucket == nullptr) {
+    bucket = std::make_shared<Bucket>();
+  } else if (bucket.use_count() > 1) {
+    // Only this thread can create new references, so a count of one means
+    // that no snapshot can see this bucket.
+    bucket = std::make_shared<Bucket>(*bucket);
+  }
+  modified_ = true;
+  return bucket.get();
+}
+
+template <class Data>
+void S2MovingPointIndex<Data>::RemoveEntry(const Location& location) {
+  Bucket* bucket = MutableBucket(location.bucket_id);
+  if (location.slot != static_cast<int32>(bucket->size()) - 1) {
+    (*bucket)[location.slot] = std::move(bucket->back());
+    locations_[(*bucket)[location.slot].id].slot = location.slot;
+  }
+  bucket->pop_back();
+  if (bucket->empty()) buckets_.erase(location.bucket_id);
+}
+
+template <class Data>
+void S2MovingPointIndex<Data>::AppendEntry(Entry entry) {
+  S2CellId bucket_id = BucketId(entry.point);
+  Bucket* bucket = MutableBucket(bucket_id);
+  locations_[entry.id] =
+      Location{bucket_id, static_cast<int32>(bucket->size())};
+  bucket->push_back(std::move(entry));
+}
+
+template <class Data>
+bool S2MovingPointIndex<Data>::Add(int64 id, const S2Point& point,
+                                   const Data& data) {
+  if (locations_.contains(id)) return false;
+  AppendEntry(Entry{point, id, data});
+  return true;
+}
+
+template <class Data>
+bool S2MovingPointIndex<Data>::Move(int64 id, const S2Point& point) {
+  auto it = locations_.find(id);
+  if (it == locations_.end()) return false;
+  const Location location = it->second;
+  if (BucketId(point) == location.bucket_id) {
+    (*MutableBucket(location.bucket_id))[location.slot].point = point;
+    return true;
+  }
+  Entry entry = (*buckets_[location.bucket_id])[location.slot];
+  entry.point = point;
+  RemoveEntry(location);
+  AppendEntry(std::move(entry));
+  return true;
+}
+
+template <class Data>
+bool S2MovingPointIndex<Data>::Remove(int64 id) {
+  auto it = locations_.find(id);
+  if (it == locations_.end()) return false;
+  const Location location = it->second;
+  locations_.erase(it);
+  RemoveEntry(location);
+  return true;
+}
+
+template <class Data>
+int S2MovingPointIndex<Data>::ApplyUpdates(absl::Span<const Update> updates) {
+  int num_failed = 0;
+  for (const Update& update : updates) {
+    bool ok = false;
+    switch (update.type) {
+      case Update::Type::ADD:
+        ok = Add(update.id, update.point, update.data);
+        break;
+      case Update::Type::MOVE:
+        ok = Move(update.id, update.point);
+        break;
+      case Update::Type::REMOVE:
+        ok = Remove(update.id);
+        break;
+    }
+    num_failed += !ok;
+  }
+  Publish();
+  return num_failed;
+}
+
+template <class Data>
+void S2MovingPointIndex<Data>::Publish() {
+  if (!modified_) return;
+  auto snapshot = std::make_shared<Snapshot>();
+  snapshot->bucket_level_ = bucket_level_;
+  snapshot->num_points_ = locations_.size();
+  snapshot->version_ = ++version_;
+  snapshot->buckets_.reserve(buckets_.size());
+  for (const auto& [id, bucket] : buckets_) {
+    snapshot->buckets_.emplace_back(id, bucket);
+  }
+  modified_ = false;
+  absl::MutexLock lock(&mutex_);
+  snapshot_ = std::move(snapshot);
+}
+
+template <class Data>
+std::shared_ptr<const typename S2MovingPointIndex<Data>::Snapshot>
+S2MovingPointIndex<Data>::snapshot() const {
+  absl::MutexLock lock(&mutex_);
+  return snapshot_;
+}
+
+template <class Data>
+void S2MovingPointIndex<Data>::Snapshot::FindClosestPoints(
+    const S2Point& target, int max_results, S1ChordAngle max_distance,
+    std::vector<Result>* results) const {
+  results->clear();
+  if (max_results <= 0 || buckets_.empty()) return;
+
+  // The results found so far, as a max-heap ordered by distance.
+  const auto result_less = [](const Result& x, const Result& y) {
+    return x.distance < y.distance;
+  };
+  const auto distance_limit = [&]() {
+    return static_cast<int>(results->size()) < max_results
+               ? max_distance
+               : results->front().distance;
+  };
+
+  // Cells that may contain closer points, ordered by their distance to the
+  // target (closest first).  A cell at the bucket level is a bucket, and
+  // any other cell is subdivided when it is removed from the queue.
+  using QueueEntry = std::pair<S1ChordAngle, S2CellId>;
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>,
+                      std::greater<QueueEntry>>
+      queue;
+
+  // Adds "id" to the queue if it contains any buckets.  If it contains
+  // exactly one bucket then the bucket is added instead.
+  const auto add_cell = [&](S2CellId id) {
+    auto first = std::lower_bound(
+        buckets_.begin(), buckets_.end(), id.range_min(),
+        [](const auto& bucket, S2CellId x) { return bucket.first < x; });
+    if (first == buckets_.end() || first->first > id.range_max()) return;
+    auto next = first + 1;
+    if (next == buckets_.end() || next->first > id.range_max()) {
+      id = first->first;
+    }
+    S1ChordAngle distance = S2Cell(id).GetDistance(target);
+    if (distance < distance_limit()) queue.emplace(distance, id);
+  };
+  for (int face = 0; face < 6; ++face) {
+    add_cell(S2CellId::FromFace(face));
+  }
+  while (!queue.empty() && queue.top().first < distance_limit()) {
+    const S2CellId id = queue.top().second;
+    queue.pop();
+    if (id.level() < bucket_level_) {
+      for (S2CellId child = id.child_begin(); child != id.child_end();
+           child = child.next()) {
+        add_cell(child);
+      }
+      continue;
+    }
+    auto it = std::lower_bound(
+        buckets_.begin(), buckets_.end(), id,
+        [](const auto& bucket, S2CellId x) { return bucket.first < x; });
+    ABSL_DCHECK(it != buckets_.end() && it->first == id);
+    for (const Entry& entry : *it->second) {
+      S1ChordAngle distance(target, entry.point);
+      if (distance >= distance_limit()) continue;
+      if (static_cast<int>(results->size()) == max_results) {
+        std::pop_heap(results->begin(), results->end(), result_less);
+        results->pop_back();
+      }
+      results->push_back(Result{distance, entry});
+      std::push_heap(results->begin(), results->end(), result_less);
+    }
+  }
+  std::sort_heap(results->begin(), results->end(), result_less);
+}
+
+#endif  // S2_S2MOVING_POINT_INDEX_H_
@@ -0,0 +1,192 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2moving_point_index.h"
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/container/flat_hash_map.h"
+#include "s2/base/types.h"
+#include "s2/s1angle.h"
+#include "s2/s1chord_angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2edge_distances.h"
+#include "s2/s2point.h"
+#include "s2/s2testing.h"
+
+using std::vector;
+
+namespace {
+
+using Index = S2MovingPointIndex<int>;
+
+// Returns the distances to the "max_results" points of "points" that are
+// closest to "target" and closer than "max_distance".
+vector<S1ChordAngle> BruteForceDistances(
+    const absl::flat_hash_map<int64, S2Point>& points, const S2Point& target,
+    int max_results, S1ChordAngle max_distance) {
+  vector<S1ChordAngle> distances;
+  for (const auto& [id, point] : points) {
+    S1ChordAngle distance(target, point);
+    if (distance < max_distance) distances.push_back(distance);
+  }
+  std::sort(distances.begin(), distances.end());
+  if (distances.size() > max_results) distances.resize(max_results);
+  return distances;
+}
+
+void CheckClosestPoints(const Index::Snapshot& snapshot,
+                        const absl::flat_hash_map<int64, S2Point>& points,
+                        const S2Cap& cap) {
+  ASSERT_EQ(snapshot.num_points(), points.size());
+  vector<Index::Result> results;
+  for (int i = 0; i < 20; ++i) {
+    const S2Point target = S2Testing::SamplePoint(cap);
+    const int max_results = 1 + S2Testing::rnd.Uniform(10);
+    const S1ChordAngle max_distance =
+        i % 2 ? S1ChordAngle::Infinity()
+              : S1ChordAngle(S1Angle::Degrees(0.01 * i));
+    snapshot.FindClosestPoints(target, max_results, max_distance, &results);
+    vector<S1ChordAngle> distances;
+    for (const Index::Result& result : results) {
+      distances.push_back(result.distance);
+      auto it = points.find(result.entry.id);
+      ASSERT_TRUE(it != points.end());
+      EXPECT_EQ(result.entry.point, it->second);
+      EXPECT_EQ(result.entry.data, result.entry.id * 10);
+    }
+    EXPECT_EQ(distances,
+              BruteForceDistances(points, target, max_results, max_distance));
+  }
+}
+
+TEST(S2MovingPointIndex, NoPoints) {
+  Index index;
+  auto snapshot = index.snapshot();
+  EXPECT_EQ(snapshot->num_points(), 0);
+  vector<Index::Result> results;
+  snapshot->FindClosestPoints(S2Point(1, 0, 0), 10, S1ChordAngle::Infinity(),
+                              &results);
+  EXPECT_TRUE(results.empty());
+  EXPECT_FALSE(index.Move(1, S2Point(1, 0, 0)));
+  EXPECT_FALSE(index.Remove(1));
+}
+
+TEST(S2MovingPointIndex, AddMoveRemove) {
+  Index index;
+  const S2Point a(1, 0, 0), b(0, 1, 0);
+  EXPECT_TRUE(index.Add(7, a, 70));
+  EXPECT_FALSE(index.Add(7, b, 70));
+  EXPECT_TRUE(index.contains(7));
+  EXPECT_EQ(index.num_points(), 1);
+
+  // Updates are not visible until they are published.
+  EXPECT_EQ(index.snapshot()->num_points(), 0);
+  index.Publish();
+  auto snapshot1 = index.snapshot();
+  EXPECT_EQ(snapshot1->num_points(), 1);
+
+  // Moving the point does not change existing snapshots.
+  EXPECT_TRUE(index.Move(7, b));
+  index.Publish();
+  auto snapshot2 = index.snapshot();
+  EXPECT_GT(snapshot2->version(), snapshot1->version());
+  vector<Index::Result> results;
+  snapshot1->FindClosestPoints(b, 1, S1ChordAngle::Infinity(), &results);
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_EQ(results[0].entry.point, a);
+  snapshot2->FindClosestPoints(b, 1, S1ChordAngle::Infinity(), &results);
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_EQ(results[0].entry.point, b);
+  EXPECT_EQ(results[0].entry.data, 70);
+
+  EXPECT_TRUE(index.Remove(7));
+  EXPECT_FALSE(index.contains(7));
+  index.Publish();
+  EXPECT_EQ(index.snapshot()->num_points(), 0);
+  EXPECT_EQ(snapshot2->num_points(), 1);
+}
+
+TEST(S2MovingPointIndex, RandomUpdates) {
+  S2Testing::rnd.Reset(1);
+  const S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+  Index index;
+  absl::flat_hash_map<int64, S2Point> points;
+  vector<Index::Update> updates;
+  for (int id = 0; id < 1000; ++id) {
+    S2Point point = S2Testing::SamplePoint(cap);
+    updates.push_back({Index::Update::Type::ADD, id, point, id * 10});
+    points[id] = point;
+  }
+  EXPECT_EQ(index.ApplyUpdates(updates), 0);
+  CheckClosestPoints(*index.snapshot(), points, cap);
+
+  for (int iter = 0; iter < 10; ++iter) {
+    // Move most points a short distance (usually within the same bucket),
+    // and remove and re-add some of them.
+    auto old_snapshot = index.snapshot();
+    const absl::flat_hash_map<int64, S2Point> old_points = points;
+    updates.clear();
+    for (auto& [id, point] : points) {
+      if (S2Testing::rnd.OneIn(10)) {
+        updates.push_back({Index::Update::Type::REMOVE, id, S2Point(), 0});
+        updates.push_back(
+            {Index::Update::Type::ADD, id, point, static_cast<int>(id * 10)});
+        continue;
+      }
+      point = S2::GetPointOnLine(point, S2Testing::RandomPoint(),
+                                 S1Angle::Degrees(0.005));
+      updates.push_back({Index::Update::Type::MOVE, id, point, 0});
+    }
+    updates.push_back({Index::Update::Type::MOVE, 12345, S2Point(), 0});
+    EXPECT_EQ(index.ApplyUpdates(updates), 1);
+    CheckClosestPoints(*index.snapshot(), points, cap);
+    CheckClosestPoints(*old_snapshot, old_points, cap);
+  }
+}
+
+TEST(S2MovingPointIndex, ConcurrentReaders) {
+  S2Testing::rnd.Reset(1);
+  const S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+  Index index;
+  for (int id = 0; id < 1000; ++id) {
+    index.Add(id, S2Testing::SamplePoint(cap), id * 10);
+  }
+  index.Publish();
+  const S2Point target = cap.center();
+  std::thread reader([&index, &target]() {
+    vector<Index::Result> results;
+    for (int i = 0; i < 200; ++i) {
+      auto snapshot = index.snapshot();
+      snapshot->FindClosestPoints(target, 5, S1ChordAngle::Infinity(),
+                                  &results);
+      EXPECT_EQ(results.size(), 5);
+      EXPECT_EQ(snapshot->num_points(), 1000);
+    }
+  });
+  for (int iter = 0; iter < 50; ++iter) {
+    for (int id = 0; id < 1000; ++id) {
+      index.Move(id, S2Testing::SamplePoint(cap));
+    }
+    index.Publish();
+  }
+  reader.join();
+}
+
+}  // namespace
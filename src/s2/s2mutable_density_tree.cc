@@ -0,0 +1,250 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2mutable_density_tree.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "absl/log/absl_check.h"
+#include "s2/base/types.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2density_tree.h"
+#include "s2/s2error.h"
+#include "s2/s2point.h"
+
+using std::vector;
+
+S2MutableDensityTree::S2MutableDensityTree(int max_level)
+    : max_level_(max_level) {
+  ABSL_DCHECK_GE(max_level, 0);
+  ABSL_DCHECK_LE(max_level, S2CellId::kMaxLevel);
+  faces_.fill(-1);
+}
+
+bool S2MutableDensityTree::Init(const S2DensityTree& tree, S2Error* error) {
+  ABSL_DCHECK(error != nullptr) << "error must be non-nullptr";
+  Clear();
+
+  // Trees built by S2DensityTree only stop subdividing cells that are
+  // entirely contained by the features that intersect them, so cells without
+  // children become contained weights and all other cells become partial
+  // weights.
+  tree.VisitCells(
+      [&](S2CellId cell_id, const S2DensityTree::Cell& cell) {
+        // The ancestors of each cell are visited first.
+        int32 parent = -1;
+        for (int level = 0; level < cell_id.level(); ++level) {
+          parent = Link(parent, cell_id, level);
+          ABSL_DCHECK_GE(parent, 0);
+        }
+        const int32 node = NewNode();
+        Link(parent, cell_id, cell_id.level()) = node;
+        if (cell_id.level() < max_level_ && cell.has_children()) {
+          nodes_[node].partial_weight = cell.weight();
+          return S2DensityTree::VisitAction::ENTER_CELL;
+        }
+        nodes_[node].contained_weight = cell.weight();
+        return S2DensityTree::VisitAction::SKIP_CELL;
+      },
+      error);
+  if (!error->ok()) {
+    Clear();
+    return false;
+  }
+  return true;
+}
+
+void S2MutableDensityTree::Add(const S2CellUnion& covering, int64 weight) {
+  ABSL_DCHECK_GE(weight, 0);
+  if (weight == 0) return;
+  Update(TruncateCovering(covering), weight);
+}
+
+void S2MutableDensityTree::Add(const S2Point& point, int64 weight) {
+  ABSL_DCHECK_GE(weight, 0);
+  if (weight == 0) return;
+  Update({S2CellId(point).parent(max_level_)}, weight);
+}
+
+void S2MutableDensityTree::Remove(const S2CellUnion& covering, int64 weight) {
+  ABSL_DCHECK_GE(weight, 0);
+  if (weight == 0) return;
+  Update(TruncateCovering(covering), -weight);
+}
+
+void S2MutableDensityTree::Remove(const S2Point& point, int64 weight) {
+  ABSL_DCHECK_GE(weight, 0);
+  if (weight == 0) return;
+  Update({S2CellId(point).parent(max_level_)}, -weight);
+}
+
+int64 S2MutableDensityTree::GetCellWeight(S2CellId cell_id) const {
+  ABSL_DCHECK(cell_id.is_valid());
+  const int target_level = std::min(cell_id.level(), max_level_);
+  int64 weight = 0;
+  int32 node = faces_[cell_id.face()];
+  for (int level = 0; node >= 0; ++level) {
+    const Node& n = nodes_[node];
+    weight += n.contained_weight;
+    if (level == target_level) return weight + n.partial_weight;
+    node = n.children[cell_id.child_position(level + 1)];
+  }
+  // No features intersect the cell without containing it.
+  return weight;
+}
+
+int64 S2MutableDensityTree::GetPointWeight(const S2Point& point) const {
+  return GetCellWeight(S2CellId(point));
+}
+
+S2DensityTree S2MutableDensityTree::ToDensityTree() const {
+  S2DensityTree::TreeEncoder encoder;
+  struct Entry {
+    S2CellId cell_id;
+    int32 node;
+    int64 inherited_weight;
+  };
+  vector<Entry> stack;
+  for (int face = 0; face < S2CellId::kNumFaces; ++face) {
+    if (faces_[face] >= 0) {
+      stack.push_back({S2CellId::FromFace(face), faces_[face], 0});
+    }
+  }
+  while (!stack.empty()) {
+    const Entry entry = stack.back();
+    stack.pop_back();
+    const Node& n = nodes_[entry.node];
+    const int64 inherited_weight = entry.inherited_weight + n.contained_weight;
+    encoder.Put(entry.cell_id,
+                std::min(inherited_weight + n.partial_weight,
+                         S2DensityTree::kMaxWeight));
+    for (int i = 0; i < 4; ++i) {
+      if (n.children[i] >= 0) {
+        stack.push_back(
+            {entry.cell_id.child(i), n.children[i], inherited_weight});
+      }
+    }
+  }
+  S2DensityTree tree;
+  encoder.Build(&tree);
+  return tree;
+}
+
+void S2MutableDensityTree::Clear() {
+  faces_.fill(-1);
+  nodes_.clear();
+  free_nodes_.clear();
+}
+
+size_t S2MutableDensityTree::SpaceUsed() const {
+  return sizeof(*this) + nodes_.capacity() * sizeof(Node) +
+         free_nodes_.capacity() * sizeof(int32);
+}
+
+vector<S2CellId> S2MutableDensityTree::TruncateCovering(
+    const S2CellUnion& covering) const {
+  vector<S2CellId> cell_ids;
+  cell_ids.reserve(covering.num_cells());
+  bool truncated = false;
+  for (S2CellId cell_id : covering) {
+    if (cell_id.level() > max_level_) {
+      cell_id = cell_id.parent(max_level_);
+      truncated = true;
+    }
+    cell_ids.push_back(cell_id);
+  }
+  // Truncation can create duplicates, and the covering itself might not be
+  // normalized.
+  if (truncated || !covering.IsNormalized()) {
+    S2CellUnion::Normalize(&cell_ids);
+  }
+  return cell_ids;
+}
+
+void S2MutableDensityTree::Update(const vector<S2CellId>& cell_ids,
+                                  int64 delta) {
+  S2CellId prev_id = S2CellId::None();
+  for (S2CellId cell_id : cell_ids) {
+    // Each feature contributes to a given ancestor only once.  Since the
+    // cells are sorted, the ancestors shared with earlier cells are exactly
+    // the ancestors shared with the previous cell.
+    const int first_level =
+        prev_id.is_valid() ? prev_id.GetCommonAncestorLevel(cell_id) + 1 : 0;
+    prev_id = cell_id;
+
+    // Nodes are referenced by index since NewNode() may reallocate nodes_.
+    int32 parent = -1;
+    for (int level = 0; level <= cell_id.level(); ++level) {
+      int32 node = Link(parent, cell_id, level);
+      if (node < 0) {
+        if (delta < 0) {
+          // The ancestor was removed while processing an earlier cell.
+          ABSL_DCHECK_LT(level, first_level) << "Removed unknown feature";
+          break;
+        }
+        node = NewNode();
+        Link(parent, cell_id, level) = node;
+      }
+      Node& n = nodes_[node];
+      if (level >= first_level) {
+        if (level == cell_id.level()) {
+          n.contained_weight += delta;
+        } else {
+          n.partial_weight += delta;
+        }
+        ABSL_DCHECK_GE(n.partial_weight, 0) << "Removed unknown feature";
+        ABSL_DCHECK_GE(n.contained_weight, 0) << "Removed unknown feature";
+        if (n.partial_weight == 0 && n.contained_weight == 0) {
+          // No other features intersect this cell.
+          Link(parent, cell_id, level) = -1;
+          FreeSubtree(node);
+          break;
+        }
+      }
+      parent = node;
+    }
+  }
+}
+
+int32 S2MutableDensityTree::NewNode() {
+  if (!free_nodes_.empty()) {
+    const int32 node = free_nodes_.back();
+    free_nodes_.pop_back();
+    return node;
+  }
+  nodes_.emplace_back();
+  return nodes_.size() - 1;
+}
+
+void S2MutableDensityTree::FreeSubtree(int32 node) {
+  vector<int32> stack{node};
+  while (!stack.empty()) {
+    const int32 i = stack.back();
+    stack.pop_back();
+    for (int32 child : nodes_[i].children) {
+      if (child >= 0) stack.push_back(child);
+    }
+    nodes_[i] = Node();
+    free_nodes_.push_back(i);
+  }
+  if (free_nodes_.size() == nodes_.size()) {
+    // Release the memory once the tree becomes empty.
+    nodes_.clear();
+    free_nodes_.clear();
+  }
+}
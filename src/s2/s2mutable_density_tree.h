@@ -0,0 +1,148 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2MUTABLE_DENSITY_TREE_H_
+#define S2_S2MUTABLE_DENSITY_TREE_H_
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "s2/base/types.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2density_tree.h"
+#include "s2/s2error.h"
+#include "s2/s2point.h"
+
+// S2MutableDensityTree is an in-memory counterpart of S2DensityTree that
+// supports adding and removing weighted features incrementally.  This is
+// useful for maintaining live load estimates, where rebuilding an
+// S2DensityTree from an S2ShapeIndex after every change would be too slow.
+//
+// Each feature is described by an S2CellUnion covering (e.g., as computed by
+// S2RegionCoverer) and a non-negative weight.  As with S2DensityTree, the
+// weight of a cell is the sum of the weights of the features that intersect
+// it, so a feature contributes its full weight to every cell it touches.
+// Covering cells below max_level() are replaced by their ancestors at
+// max_level().
+//
+// The tree is stored as an array of decoded nodes, so that GetCellWeight()
+// takes O(depth) time without any decoding.  ToDensityTree() encodes the
+// current state as an S2DensityTree at any time.
+//
+// Example usage:
+//
+//   S2MutableDensityTree tree(/*max_level=*/15);
+//   tree.Add(coverer.GetCovering(feature_region), feature_weight);
+//   int64 load = tree.GetCellWeight(shard_cell_id);
+//   S2DensityTree snapshot = tree.ToDensityTree();
+//
+// This class is not thread-safe for concurrent updates, but const methods
+// may be called concurrently.
+class S2MutableDensityTree {
+ public:
+  // Constructs an empty tree whose cells have levels at most 'max_level'.
+  explicit S2MutableDensityTree(int max_level = S2CellId::kMaxLevel);
+
+  // S2MutableDensityTrees can be freely moved and copied.
+  S2MutableDensityTree(const S2MutableDensityTree&) = default;
+  S2MutableDensityTree& operator=(const S2MutableDensityTree&) = default;
+  S2MutableDensityTree(S2MutableDensityTree&&) = default;
+  S2MutableDensityTree& operator=(S2MutableDensityTree&&) = default;
+
+  int max_level() const { return max_level_; }
+
+  // Replaces the contents of this tree with the weights of 'tree'.  Cells of
+  // 'tree' without children are treated as features that cover the whole
+  // cell, and cells below max_level() are ignored.  Returns false and sets
+  // 'error' if 'tree' could not be decoded.
+  bool Init(const S2DensityTree& tree, S2Error* error);
+
+  // Adds a feature with the given covering and weight.
+  // REQUIRES: weight >= 0
+  void Add(const S2CellUnion& covering, int64 weight);
+
+  // Adds a point feature with the given weight.
+  void Add(const S2Point& point, int64 weight);
+
+  // Removes a feature that was previously added with the same covering (or
+  // point) and weight.
+  void Remove(const S2CellUnion& covering, int64 weight);
+  void Remove(const S2Point& point, int64 weight);
+
+  // Returns the total weight of the features that intersect the given cell.
+  // Cells below max_level() are treated as their ancestor at max_level().
+  int64 GetCellWeight(S2CellId cell_id) const;
+
+  // Returns the total weight of the features that contain the given point,
+  // i.e. the weight of the leaf cell containing it.
+  int64 GetPointWeight(const S2Point& point) const;
+
+  // Returns an S2DensityTree with the same cell weights as this tree.  Cell
+  // weights are clamped to S2DensityTree::kMaxWeight.
+  S2DensityTree ToDensityTree() const;
+
+  // Removes all features from the tree.
+  void Clear();
+
+  // Returns true if the tree has no features.
+  bool empty() const { return num_nodes() == 0; }
+
+  // Returns the number of cells stored in the tree.
+  size_t num_nodes() const { return nodes_.size() - free_nodes_.size(); }
+
+  // Returns the approximate number of bytes used by this object.
+  size_t SpaceUsed() const;
+
+ private:
+  // Each node stores the weight of the features that intersect its cell
+  // without containing it ("partial_weight"), and the weight of the features
+  // whose covering includes exactly this cell ("contained_weight").  The
+  // latter applies to every descendant of the cell, so the weight of a cell
+  // is its partial weight plus the contained weights of its ancestors and
+  // itself.
+  struct Node {
+    int64 partial_weight = 0;
+    int64 contained_weight = 0;
+    std::array<int32, 4> children{-1, -1, -1, -1};
+  };
+
+  // Returns a copy of 'covering' where cells below max_level() are replaced
+  // by their ancestors.
+  std::vector<S2CellId> TruncateCovering(const S2CellUnion& covering) const;
+
+  // Adds 'delta' to the weights of the cells intersected by the given
+  // sorted, non-overlapping cells.
+  void Update(const std::vector<S2CellId>& cell_ids, int64 delta);
+
+  // Returns the link to the node of the ancestor of 'cell_id' at 'level',
+  // given the node of its parent (or -1 if 'level' is zero).  The link is
+  // invalidated by NewNode().
+  int32& Link(int32 parent, S2CellId cell_id, int level) {
+    return parent < 0 ? faces_[cell_id.face()]
+                      : nodes_[parent].children[cell_id.child_position(level)];
+  }
+
+  int32 NewNode();
+  void FreeSubtree(int32 node);
+
+  int max_level_;
+  std::array<int32, S2CellId::kNumFaces> faces_;
+  std::vector<Node> nodes_;
+  std::vector<int32> free_nodes_;
+};
+
+#endif  // S2_S2MUTABLE_DENSITY_TREE_H_
@@ -0,0 +1,186 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2mutable_density_tree.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/container/btree_map.h"
+#include "s2/base/types.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2density_tree.h"
+#include "s2/s2error.h"
+#include "s2/s2point.h"
+#include "s2/s2point_vector_shape.h"
+#include "s2/s2region_coverer.h"
+#include "s2/s2testing.h"
+
+using std::make_unique;
+using std::vector;
+
+namespace {
+
+constexpr int kMaxLevel = 12;
+
+struct Feature {
+  S2CellUnion covering;
+  int64 weight;
+};
+
+// Returns a random feature near "center" whose covering includes cells
+// below kMaxLevel.
+Feature GetRandomFeature(const S2Point& center) {
+  S2RegionCoverer::Options options;
+  options.set_max_cells(1 + S2Testing::rnd.Uniform(8));
+  options.set_max_level(kMaxLevel + 4);
+  S2RegionCoverer coverer(options);
+  S2Cap cap(S2Testing::SamplePoint(S2Cap(center, S1Angle::Degrees(1))),
+            S1Angle::Degrees(0.01 + 0.2 * S2Testing::rnd.RandDouble()));
+  return {coverer.GetCovering(cap), 1 + S2Testing::rnd.Uniform(100)};
+}
+
+// Returns the weight of "cell_id" computed directly from the features.
+int64 GetExpectedWeight(const vector<Feature>& features, S2CellId cell_id) {
+  if (cell_id.level() > kMaxLevel) cell_id = cell_id.parent(kMaxLevel);
+  int64 weight = 0;
+  for (const Feature& feature : features) {
+    for (S2CellId id : feature.covering) {
+      if (id.level() > kMaxLevel) id = id.parent(kMaxLevel);
+      if (id.intersects(cell_id)) {
+        weight += feature.weight;
+        break;
+      }
+    }
+  }
+  return weight;
+}
+
+void CheckWeights(const vector<Feature>& features, const S2Point& center,
+                  const S2MutableDensityTree& tree) {
+  for (int i = 0; i < 500; ++i) {
+    S2Point p = S2Testing::SamplePoint(S2Cap(center, S1Angle::Degrees(2)));
+    S2CellId id = S2CellId(p).parent(S2Testing::rnd.Uniform(20));
+    ASSERT_EQ(GetExpectedWeight(features, id), tree.GetCellWeight(id)) << id;
+    ASSERT_EQ(GetExpectedWeight(features, S2CellId(p)),
+              tree.GetPointWeight(p));
+  }
+}
+
+TEST(S2MutableDensityTree, Empty) {
+  S2MutableDensityTree tree(kMaxLevel);
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(0, tree.GetCellWeight(S2CellId::FromFace(1)));
+  EXPECT_EQ(0, tree.GetPointWeight(S2Point(1, 0, 0)));
+  S2Error error;
+  EXPECT_TRUE(tree.ToDensityTree().Decode(&error).empty());
+  EXPECT_TRUE(error.ok()) << error;
+}
+
+TEST(S2MutableDensityTree, AddAndRemoveMatchBruteForce) {
+  S2Testing::rnd.Reset(1);
+  const S2Point center = S2Testing::RandomPoint();
+  S2MutableDensityTree tree(kMaxLevel);
+  vector<Feature> features;
+  for (int i = 0; i < 200; ++i) {
+    features.push_back(GetRandomFeature(center));
+    tree.Add(features.back().covering, features.back().weight);
+  }
+  // Add some point features too.
+  for (int i = 0; i < 50; ++i) {
+    S2Point p = S2Testing::SamplePoint(S2Cap(center, S1Angle::Degrees(1)));
+    features.push_back({S2CellUnion({S2CellId(p)}), 7});
+    tree.Add(p, 7);
+  }
+  CheckWeights(features, center, tree);
+
+  // Remove every other feature.
+  vector<Feature> remaining;
+  for (int i = 0; i < features.size(); ++i) {
+    if (i % 2 == 0) {
+      remaining.push_back(features[i]);
+    } else if (features[i].covering.num_cells() == 1 &&
+               features[i].covering.cell_id(0).is_leaf()) {
+      tree.Remove(features[i].covering.cell_id(0).ToPoint(), 7);
+    } else {
+      tree.Remove(features[i].covering, features[i].weight);
+    }
+  }
+  CheckWeights(remaining, center, tree);
+
+  for (const Feature& feature : remaining) {
+    tree.Remove(feature.covering, feature.weight);
+  }
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(0, tree.GetCellWeight(S2CellId(center).parent(5)));
+}
+
+TEST(S2MutableDensityTree, ToDensityTree) {
+  S2Testing::rnd.Reset(2);
+  const S2Point center = S2Testing::RandomPoint();
+  S2MutableDensityTree tree(kMaxLevel);
+  for (int i = 0; i < 100; ++i) {
+    Feature feature = GetRandomFeature(center);
+    tree.Add(feature.covering, feature.weight);
+  }
+
+  S2Error error;
+  S2DensityTree encoded = tree.ToDensityTree();
+  absl::btree_map<S2CellId, int64> decoded = encoded.Decode(&error);
+  ASSERT_TRUE(error.ok()) << error;
+  EXPECT_EQ(tree.num_nodes(), decoded.size());
+  for (const auto& [cell_id, weight] : decoded) {
+    EXPECT_EQ(tree.GetCellWeight(cell_id), weight) << cell_id;
+  }
+
+  // Initializing from the encoded tree preserves the weights.
+  S2MutableDensityTree copy(kMaxLevel);
+  ASSERT_TRUE(copy.Init(encoded, &error)) << error;
+  EXPECT_EQ(decoded, copy.ToDensityTree().Decode(&error));
+}
+
+TEST(S2MutableDensityTree, InitFromShapeDensity) {
+  S2Testing::rnd.Reset(3);
+  MutableS2ShapeIndex index;
+  const S2Point center = S2Testing::RandomPoint();
+  for (int i = 0; i < 100; ++i) {
+    index.Add(make_unique<S2PointVectorShape>(vector<S2Point>{
+        S2Testing::SamplePoint(S2Cap(center, S1Angle::Degrees(1)))}));
+  }
+  S2Error error;
+  S2DensityTree density_tree;
+  ASSERT_TRUE(density_tree.InitToVertexDensity(index, 10'000, 20, &error))
+      << error;
+
+  S2MutableDensityTree tree(20);
+  ASSERT_TRUE(tree.Init(density_tree, &error)) << error;
+  absl::btree_map<S2CellId, int64> expected = density_tree.Decode(&error);
+  EXPECT_EQ(expected, tree.ToDensityTree().Decode(&error));
+
+  // Adding a feature and removing it again restores the original weights.
+  S2CellUnion covering({S2CellId(center).parent(8)});
+  tree.Add(covering, 5);
+  EXPECT_EQ(expected.at(S2CellId(center).parent(3)) + 5,
+            tree.GetCellWeight(S2CellId(center).parent(3)));
+  tree.Remove(covering, 5);
+  EXPECT_EQ(expected, tree.ToDensityTree().Decode(&error));
+}
+
+}  // namespace
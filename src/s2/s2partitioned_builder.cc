@@ -0,0 +1,222 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2partitioned_builder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/container/btree_map.h"
+#include "absl/container/btree_set.h"
+#include "absl/log/absl_check.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "s2/base/executor.h"
+#include "s2/base/types.h"
+#include "s2/s1angle.h"
+#include "s2/s1chord_angle.h"
+#include "s2/s2builder.h"
+#include "s2/s2builder_graph.h"
+#include "s2/s2builder_layer.h"
+#include "s2/s2cell.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2edge_distances.h"
+#include "s2/s2error.h"
+#include "s2/s2point.h"
+
+using std::make_unique;
+using std::vector;
+
+using Edge = S2PartitionedBuilder::Edge;
+
+S2PartitionedBuilder::Options::Options() = default;
+
+void S2PartitionedBuilder::Options::set_block_level(int block_level) {
+  ABSL_DCHECK_GE(block_level, 0);
+  ABSL_DCHECK_LE(block_level, S2CellId::kMaxLevel);
+  block_level_ = block_level;
+}
+
+/* static */
+bool S2PartitionedBuilder::EdgeLess(const Edge& x, const Edge& y) {
+  return std::tie(x.id, x.v0, x.v1) < std::tie(y.id, y.v0, y.v1);
+}
+
+S2PartitionedBuilder::S2PartitionedBuilder(const Options& options)
+    : options_(options) {}
+
+S1Angle S2PartitionedBuilder::margin() const {
+  const S2Builder::Options& builder_options = options_.builder_options();
+  return builder_options.snap_function().snap_radius() +
+         builder_options.max_edge_deviation() + options_.max_edge_length();
+}
+
+void S2PartitionedBuilder::GetBlockIds(const S2Point& v0, const S2Point& v1,
+                                       vector<S2CellId>* block_ids) const {
+  // The blocks within margin() of the edge are connected, so they can be
+  // found by a flood fill starting from the block that contains v0.  The
+  // distance limit is increased slightly so that edges are never assigned
+  // to too few blocks due to numerical errors.
+  S1ChordAngle limit(margin());
+  limit = limit.PlusError(S2::GetUpdateMinDistanceMaxError(limit));
+  const int level = options_.block_level();
+  absl::btree_set<S2CellId> found;
+  vector<S2CellId> frontier = {S2CellId(v0).parent(level)};
+  found.insert(frontier[0]);
+  vector<S2CellId> neighbors;
+  while (!frontier.empty()) {
+    S2CellId id = frontier.back();
+    frontier.pop_back();
+    neighbors.clear();
+    id.AppendAllNeighbors(level, &neighbors);
+    for (S2CellId neighbor : neighbors) {
+      if (found.contains(neighbor)) continue;
+      if (S2Cell(neighbor).GetDistance(v0, v1) > limit) continue;
+      found.insert(neighbor);
+      frontier.push_back(neighbor);
+    }
+  }
+  block_ids->insert(block_ids->end(), found.begin(), found.end());
+}
+
+namespace {
+
+// A layer that collects the snapped edges whose first vertex is contained
+// by the given block.
+class BlockEdgeLayer : public S2Builder::Layer {
+ public:
+  BlockEdgeLayer(S2CellId block_id, const vector<int64>* input_ids,
+                 vector<Edge>* output)
+      : block_id_(block_id), input_ids_(input_ids), output_(output) {}
+
+  GraphOptions graph_options() const override {
+    return GraphOptions(EdgeType::DIRECTED,
+                        GraphOptions::DegenerateEdges::DISCARD,
+                        GraphOptions::DuplicateEdges::KEEP,
+                        GraphOptions::SiblingPairs::KEEP);
+  }
+
+  void Build(const Graph& g, S2Error* error) override {
+    for (Graph::EdgeId e = 0; e < g.num_edges(); ++e) {
+      const S2Point& v0 = g.vertex(g.edge(e).first);
+      if (!block_id_.contains(S2CellId(v0))) continue;
+      // With DuplicateEdges::KEEP every edge is snapped from exactly one
+      // input edge.
+      auto ids = g.input_edge_ids(e);
+      ABSL_DCHECK_EQ(ids.size(), 1);
+      output_->push_back(
+          {v0, g.vertex(g.edge(e).second), (*input_ids_)[*ids.begin()]});
+    }
+  }
+
+ private:
+  S2CellId block_id_;
+  const vector<int64>* input_ids_;
+  vector<Edge>* output_;
+};
+
+}  // namespace
+
+bool S2PartitionedBuilder::SnapBlock(S2CellId block_id,
+                                     absl::Span<const Edge> edges,
+                                     vector<Edge>* output,
+                                     S2Error* error) const {
+  ABSL_DCHECK_EQ(block_id.level(), options_.block_level());
+  output->clear();
+  S2Builder::Options builder_options = options_.builder_options();
+  if (builder_options.simplify_edge_chains()) {
+    error->Init(S2Error::INVALID_ARGUMENT,
+                "simplify_edge_chains() is not supported");
+    return false;
+  }
+  builder_options.set_idempotent(false);
+
+  // Degenerate input edges are discarded by S2Builder::AddEdge(), so we
+  // keep track of the ids of the edges that are actually added.
+  vector<int64> input_ids;
+  input_ids.reserve(edges.size());
+  S2Builder builder(builder_options);
+  builder.StartLayer(
+      make_unique<BlockEdgeLayer>(block_id, &input_ids, output));
+  const S1ChordAngle max_edge_length(options_.max_edge_length());
+  for (const Edge& edge : edges) {
+    if (edge.v0 == edge.v1) continue;
+    if (S1ChordAngle(edge.v0, edge.v1) > max_edge_length) {
+      error->Init(S2Error::OUT_OF_RANGE,
+                  "Edge %d is longer than max_edge_length()", edge.id);
+      return false;
+    }
+    builder.AddEdge(edge.v0, edge.v1);
+    input_ids.push_back(edge.id);
+  }
+  if (!builder.Build(error)) return false;
+  std::sort(output->begin(), output->end(), EdgeLess);
+  return true;
+}
+
+bool S2PartitionedBuilder::SnapEdges(absl::Span<const Edge> edges,
+                                     vector<Edge>* output,
+                                     S2Error* error) const {
+  error->Clear();
+  output->clear();
+  absl::btree_map<S2CellId, vector<Edge>> blocks;
+  vector<S2CellId> block_ids;
+  for (const Edge& edge : edges) {
+    block_ids.clear();
+    GetBlockIds(edge.v0, edge.v1, &block_ids);
+    for (S2CellId id : block_ids) blocks[id].push_back(edge);
+  }
+
+  // Each block is snapped into its own vector, so that the output does not
+  // depend on how the blocks are scheduled.
+  vector<std::pair<S2CellId, vector<Edge>>> inputs(
+      std::make_move_iterator(blocks.begin()),
+      std::make_move_iterator(blocks.end()));
+  blocks.clear();
+  const int num_blocks = inputs.size();
+  vector<vector<Edge>> outputs(num_blocks);
+  std::atomic<int> next_block(0);
+  std::atomic<bool> failed(false);
+  absl::Mutex error_mutex;
+  s2base::RunConcurrently(
+      options_.executor(),
+      std::min(options_.num_threads(), std::max(num_blocks, 1)), [&]() {
+        S2Error block_error;
+        for (int i; !failed.load(std::memory_order_relaxed) &&
+                    (i = next_block.fetch_add(1)) < num_blocks;) {
+          if (!SnapBlock(inputs[i].first, inputs[i].second, &outputs[i],
+                         &block_error)) {
+            absl::MutexLock lock(&error_mutex);
+            if (!failed.exchange(true)) *error = block_error;
+            return;
+          }
+          vector<Edge>().swap(inputs[i].second);
+        }
+      });
+  if (!error->ok()) return false;
+
+  size_t num_edges = 0;
+  for (const vector<Edge>& block : outputs) num_edges += block.size();
+  output->reserve(num_edges);
+  for (const vector<Edge>& block : outputs) {
+    output->insert(output->end(), block.begin(), block.end());
+  }
+  std::sort(output->begin(), output->end(), EdgeLess);
+  return true;
+}
@@ -0,0 +1,183 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2PARTITIONED_BUILDER_H_
+#define S2_S2PARTITIONED_BUILDER_H_
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "s2/base/executor.h"
+#include "s2/base/types.h"
+#include "s2/s1angle.h"
+#include "s2/s2builder.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2error.h"
+#include "s2/s2point.h"
+
+// S2PartitionedBuilder snaps a collection of edges that is too large to be
+// processed by a single S2Builder, e.g. a planet-scale road network.  The
+// sphere is partitioned into the S2Cells of a fixed level ("blocks"), and
+// each input edge is assigned to every block that it passes within
+// margin() of, where the margin is the maximum distance that edges can
+// move during snapping plus the maximum input edge length.  The edges of
+// each block are then snapped independently by SnapBlock(), possibly on
+// different threads, processes or machines, and each block keeps only the
+// snapped edges whose first vertex it contains.
+// Since every snapped edge is owned by exactly one block, the snapped
+// blocks can simply be concatenated.
+//
+// The caller is responsible for distributing the edges.  For example, a
+// distributed pipeline might look like this:
+//
+//   S2PartitionedBuilder builder(options);
+//   // Map: emit (block_id, edge) for every block returned by GetBlockIds().
+//   // Reduce: for each block_id, call SnapBlock() with its edges.
+//   // Merge: sort the union of all output edges using EdgeLess().
+//
+// SnapEdges() does the same thing in memory using multiple threads, and is
+// mainly useful for testing and for inputs that fit in memory.
+//
+// Every block snaps its edges using the same S2Builder::Options, so the
+// output satisfies all of the S2Builder snapping guarantees (e.g. edges
+// move by at most max_edge_deviation()).  The output is also identical to
+// snapping all the edges with a single S2Builder, provided that the sites
+// (output vertices) chosen near each block boundary do not depend on input
+// edges farther than margin() away.  This is true of snap functions whose
+// sites are always separated by at least min_vertex_separation(), such as
+// S2CellIdSnapFunction and IntLatLngSnapFunction with their default snap
+// radius, where every snapped input vertex is a site.  Otherwise the
+// greedy selection of sites may differ near block boundaries, so that the
+// snapped edges owned by adjacent blocks may not share vertices there.
+//
+// The following S2Builder options are handled specially:
+//
+//  - idempotent() is treated as false, since the test of whether any
+//    snapping is needed is global.
+//  - simplify_edge_chains() is not supported, since chains may span any
+//    number of blocks.
+//
+// Degenerate edges are discarded, and duplicate edges and sibling pairs are
+// kept.  Each output edge is labelled with the id of the input edge that it
+// was snapped from.
+class S2PartitionedBuilder {
+ public:
+  class Options {
+   public:
+    Options();
+
+    // The options used to snap each block.
+    //
+    // DEFAULT: S2Builder::Options()
+    const S2Builder::Options& builder_options() const {
+      return builder_options_;
+    }
+    void set_builder_options(const S2Builder::Options& builder_options) {
+      builder_options_ = builder_options;
+    }
+
+    // The S2Cell level of the blocks.  Each block should typically contain
+    // at least several thousand edges, and its width should be much larger
+    // than margin().
+    //
+    // DEFAULT: 8
+    int block_level() const { return block_level_; }
+    void set_block_level(int block_level);
+
+    // The maximum length of an input edge.  Edges are assigned to blocks
+    // using a margin that includes this length, since the snapped edges near
+    // a block boundary may depend on input vertices anywhere along the input
+    // edges that they were snapped from.  Longer edges should be split into
+    // shorter ones before snapping (which does not change the snapped
+    // polylines significantly, since the new vertices lie on the old edges).
+    //
+    // DEFAULT: S1Angle::Degrees(0.01)  (about 1 km)
+    S1Angle max_edge_length() const { return max_edge_length_; }
+    void set_max_edge_length(S1Angle max_edge_length) {
+      max_edge_length_ = max_edge_length;
+    }
+
+    // The maximum number of threads used by SnapEdges().
+    //
+    // DEFAULT: 1
+    int num_threads() const { return num_threads_; }
+    void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
+    // If non-null, the additional threads requested by num_threads() are
+    // run as tasks on this executor (see s2base::RunConcurrently).
+    //
+    // DEFAULT: nullptr
+    s2base::Executor* executor() const { return executor_; }
+    void set_executor(s2base::Executor* executor) { executor_ = executor; }
+
+   private:
+    S2Builder::Options builder_options_;
+    int block_level_ = 8;
+    S1Angle max_edge_length_ = S1Angle::Degrees(0.01);
+    int num_threads_ = 1;
+    s2base::Executor* executor_ = nullptr;
+  };
+
+  // An input or output edge.  Output edges have the id of the input edge
+  // that they were snapped from.
+  struct Edge {
+    S2Point v0, v1;
+    int64 id;
+
+    friend bool operator==(const Edge& x, const Edge& y) {
+      return x.v0 == y.v0 && x.v1 == y.v1 && x.id == y.id;
+    }
+  };
+
+  // Orders edges by id and then by vertices.  The output of SnapBlock() and
+  // SnapEdges() is sorted in this order.
+  static bool EdgeLess(const Edge& x, const Edge& y);
+
+  explicit S2PartitionedBuilder(const Options& options = Options());
+
+  const Options& options() const { return options_; }
+
+  // Returns the distance by which each block is expanded when assigning
+  // edges to blocks, i.e. snap_radius() + max_edge_deviation() +
+  // max_edge_length().
+  S1Angle margin() const;
+
+  // Appends to "block_ids" the blocks whose distance to the edge (v0, v1)
+  // is at most margin().  The ids are appended in increasing order.
+  void GetBlockIds(const S2Point& v0, const S2Point& v1,
+                   std::vector<S2CellId>* block_ids) const;
+
+  // Snaps the given edges, which must include every input edge assigned to
+  // "block_id" by GetBlockIds(), and stores the snapped edges owned by this
+  // block (i.e., whose first vertex it contains) in "output" sorted by
+  // EdgeLess().  Edges that do not belong to the block are allowed but
+  // make the block more expensive to snap.  Returns false and sets "error"
+  // if any edge is longer than max_edge_length() (OUT_OF_RANGE) or the
+  // edges could not be snapped.  This method is thread-safe.
+  bool SnapBlock(S2CellId block_id, absl::Span<const Edge> edges,
+                 std::vector<Edge>* output, S2Error* error) const;
+
+  // Assigns the given edges to blocks, snaps the blocks using up to
+  // num_threads() threads, and stores the combined result in "output"
+  // sorted by EdgeLess().  Returns false and sets "error" if any block
+  // could not be snapped.
+  bool SnapEdges(absl::Span<const Edge> edges, std::vector<Edge>* output,
+                 S2Error* error) const;
+
+ private:
+  Options options_;
+};
+
+#endif  // S2_S2PARTITIONED_BUILDER_H_
@@ -0,0 +1,158 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2partitioned_builder.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/s1angle.h"
+#include "s2/s1chord_angle.h"
+#include "s2/s2builder.h"
+#include "s2/s2builderutil_snap_functions.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2error.h"
+#include "s2/s2point.h"
+#include "s2/s2testing.h"
+
+using std::vector;
+
+namespace {
+
+using Edge = S2PartitionedBuilder::Edge;
+
+// Returns the edges of "num_polylines" random polylines in the given cap.
+// Edge "j" of polyline "i" has id 1000 * i + j.
+vector<Edge> GetRandomEdges(const S2Cap& cap, int num_polylines,
+                            int num_edges) {
+  vector<Edge> edges;
+  for (int i = 0; i < num_polylines; ++i) {
+    S2Point v0 = S2Testing::SamplePoint(cap);
+    for (int j = 0; j < num_edges; ++j) {
+      S2Point v1 = S2Testing::SamplePoint(S2Cap(v0, S1Angle::Degrees(0.3)));
+      edges.push_back({v0, v1, 1000 * i + j});
+      v0 = v1;
+    }
+  }
+  return edges;
+}
+
+TEST(S2PartitionedBuilder, MatchesSingleBlock) {
+  // Snapping edges in many small blocks gives the same result as snapping
+  // them all at once (i.e., in a single level 0 block).
+  S2Testing::rnd.Reset(1);
+  const S2Cap cap(S2Point(1, 0.2, 0.3).Normalize(), S1Angle::Degrees(3));
+  vector<Edge> edges = GetRandomEdges(cap, 100, 20);
+
+  for (bool split_crossing_edges : {false, true}) {
+    S2Builder::Options builder_options(
+        s2builderutil::S2CellIdSnapFunction(16));
+    builder_options.set_split_crossing_edges(split_crossing_edges);
+    S2PartitionedBuilder::Options options;
+    options.set_builder_options(builder_options);
+    options.set_max_edge_length(S1Angle::Degrees(0.31));
+    options.set_block_level(0);
+    S2PartitionedBuilder single(options);
+    vector<Edge> expected;
+    S2Error error;
+    ASSERT_TRUE(single.SnapEdges(edges, &expected, &error)) << error;
+    EXPECT_GE(expected.size(), edges.size());
+
+    options.set_block_level(7);
+    options.set_num_threads(4);
+    S2PartitionedBuilder partitioned(options);
+    vector<Edge> actual;
+    ASSERT_TRUE(partitioned.SnapEdges(edges, &actual, &error)) << error;
+    EXPECT_TRUE(actual == expected) << split_crossing_edges;
+  }
+}
+
+TEST(S2PartitionedBuilder, GetBlockIds) {
+  S2Testing::rnd.Reset(2);
+  S2PartitionedBuilder::Options options;
+  options.set_block_level(5);
+  S2Builder::Options builder_options(
+      s2builderutil::S2CellIdSnapFunction(6));
+  options.set_builder_options(builder_options);
+  S2PartitionedBuilder builder(options);
+  const S1ChordAngle margin(builder.margin());
+  for (int iter = 0; iter < 20; ++iter) {
+    S2Point v0 = S2Testing::RandomPoint();
+    S2Point v1 = S2Testing::SamplePoint(S2Cap(v0, S1Angle::Degrees(10)));
+    vector<S2CellId> block_ids;
+    builder.GetBlockIds(v0, v1, &block_ids);
+    vector<S2CellId> expected;
+    for (S2CellId id = S2CellId::Begin(5); id != S2CellId::End(5);
+         id = id.next()) {
+      if (S2Cell(id).GetDistance(v0, v1) <= margin) expected.push_back(id);
+    }
+    EXPECT_EQ(block_ids, expected);
+  }
+}
+
+TEST(S2PartitionedBuilder, SnapBlockOwnsFirstVertex) {
+  S2Testing::rnd.Reset(3);
+  const S2Cap cap(S2Point(0.1, 1, 0.1).Normalize(), S1Angle::Degrees(1));
+  vector<Edge> edges = GetRandomEdges(cap, 10, 10);
+  // Degenerate edges are discarded.
+  edges.push_back({edges[0].v0, edges[0].v0, 12345});
+
+  S2PartitionedBuilder::Options options;
+  options.set_builder_options(
+      S2Builder::Options(s2builderutil::IntLatLngSnapFunction(5)));
+  options.set_max_edge_length(S1Angle::Degrees(0.31));
+  options.set_block_level(6);
+  S2PartitionedBuilder builder(options);
+  const S2CellId block_id = S2CellId(cap.center()).parent(6);
+  vector<Edge> output;
+  S2Error error;
+  ASSERT_TRUE(builder.SnapBlock(block_id, edges, &output, &error)) << error;
+  EXPECT_FALSE(output.empty());
+  for (const Edge& edge : output) {
+    EXPECT_TRUE(block_id.contains(S2CellId(edge.v0)));
+    EXPECT_NE(edge.id, 12345);
+  }
+  EXPECT_TRUE(std::is_sorted(output.begin(), output.end(),
+                             S2PartitionedBuilder::EdgeLess));
+}
+
+TEST(S2PartitionedBuilder, SimplifyEdgeChainsNotSupported) {
+  S2Builder::Options builder_options(
+      s2builderutil::IntLatLngSnapFunction(5));
+  builder_options.set_simplify_edge_chains(true);
+  S2PartitionedBuilder::Options options;
+  options.set_builder_options(builder_options);
+  S2PartitionedBuilder builder(options);
+  vector<Edge> output;
+  S2Error error;
+  EXPECT_FALSE(builder.SnapEdges(
+      {{S2Point(1, 0, 0), S2Point(0, 1, 0), 0}}, &output, &error));
+  EXPECT_EQ(error.code(), S2Error::INVALID_ARGUMENT);
+}
+
+TEST(S2PartitionedBuilder, EdgeTooLong) {
+  S2PartitionedBuilder builder;
+  vector<Edge> output;
+  S2Error error;
+  EXPECT_FALSE(builder.SnapEdges(
+      {{S2Point(1, 0, 0), S2Point(1, 1, 0).Normalize(), 7}}, &output,
+      &error));
+  EXPECT_EQ(error.code(), S2Error::OUT_OF_RANGE);
+}
+
+}  // namespace
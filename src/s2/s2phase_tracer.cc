@@ -0,0 +1,43 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2phase_tracer.h"
+
+#include <chrono>
+
+#include "absl/strings/string_view.h"
+#include "s2/s2memory_tracker.h"
+
+S2PhaseTracer::Scope::Scope(S2PhaseTracer* tracer, absl::string_view phase,
+                            const S2MemoryTracker* memory_tracker)
+    : tracer_(tracer), phase_(phase), memory_tracker_(memory_tracker) {
+  if (tracer_ == nullptr) return;
+  if (memory_tracker_ != nullptr) {
+    stats_.memory_delta_bytes = -memory_tracker_->usage_bytes();
+  }
+  tracer_->BeginPhase(phase_);
+  start_ = std::chrono::steady_clock::now();
+}
+
+S2PhaseTracer::Scope::~Scope() {
+  if (tracer_ == nullptr) return;
+  stats_.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start_);
+  if (memory_tracker_ != nullptr) {
+    stats_.memory_usage_bytes = memory_tracker_->usage_bytes();
+    stats_.memory_delta_bytes += stats_.memory_usage_bytes;
+  }
+  tracer_->EndPhase(phase_, stats_);
+}
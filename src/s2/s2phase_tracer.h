@@ -0,0 +1,105 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2PHASE_TRACER_H_
+#define S2_S2PHASE_TRACER_H_
+
+#include <chrono>
+
+#include "absl/strings/string_view.h"
+#include "s2/base/types.h"
+#include "s2/s2memory_tracker.h"
+
+// S2PhaseTracer is an interface for observing the phases of long-running
+// operations such as S2Builder::Build() and S2BooleanOperation::Build(), so
+// that clients can attach a tracing system and find out which phase
+// dominates for a given input.  For example:
+//
+//   class MyTracer : public S2PhaseTracer {
+//    public:
+//     void BeginPhase(absl::string_view phase) override {
+//       spans_.push_back(StartSpan(phase));
+//     }
+//     void EndPhase(absl::string_view phase,
+//                   const PhaseStats& stats) override {
+//       spans_.back().SetAttribute("items", stats.num_items);
+//       spans_.pop_back();
+//     }
+//   };
+//
+//   MyTracer tracer;
+//   S2Builder::Options options;
+//   options.set_tracer(&tracer);
+//
+// Phase names have the form "Class::Phase" (e.g. "S2Builder::SnapEdges")
+// and are string literals.  Phases nest: every BeginPhase() call is matched
+// by an EndPhase() call, and phases that begin while another phase is active
+// on the same thread end before it does.  When an operation uses several
+// threads, phases that are run concurrently (e.g. building independent
+// S2Builder output layers) may be reported from several threads at once, so
+// the tracer must then be thread-safe.
+class S2PhaseTracer {
+ public:
+  struct PhaseStats {
+    // The number of items produced or processed by the phase (e.g. the
+    // number of sites chosen or edges snapped), or -1 if not applicable.
+    // The meaning of this value is documented where each phase is defined.
+    int64 num_items = -1;
+
+    // The wall time taken by the phase.
+    std::chrono::nanoseconds elapsed{0};
+
+    // The change in S2MemoryTracker::usage_bytes() during the phase and its
+    // value when the phase ended, or zero if the operation does not have a
+    // memory tracker.  Memory that is released before the phase ends (e.g.
+    // temporary storage) is not included in memory_delta_bytes.
+    int64 memory_delta_bytes = 0;
+    int64 memory_usage_bytes = 0;
+  };
+
+  virtual ~S2PhaseTracer() = default;
+
+  virtual void BeginPhase(absl::string_view phase) = 0;
+  virtual void EndPhase(absl::string_view phase, const PhaseStats& stats) = 0;
+
+  // Reports a phase that lasts until this object is destroyed.  Does nothing
+  // if "tracer" is nullptr, so phases can be traced unconditionally:
+  //
+  //   S2PhaseTracer::Scope scope(options_.tracer(), "S2Builder::ChooseSites",
+  //                              options_.memory_tracker());
+  //   ...
+  //   scope.set_num_items(sites_.size());
+  class Scope {
+   public:
+    // "memory_tracker" may be nullptr.
+    Scope(S2PhaseTracer* tracer, absl::string_view phase,
+          const S2MemoryTracker* memory_tracker);
+    ~Scope();
+
+    void set_num_items(int64 num_items) { stats_.num_items = num_items; }
+
+    Scope(const Scope&) = delete;
+    void operator=(const Scope&) = delete;
+
+   private:
+    S2PhaseTracer* tracer_;
+    absl::string_view phase_;
+    const S2MemoryTracker* memory_tracker_;
+    std::chrono::steady_clock::time_point start_;
+    PhaseStats stats_;
+  };
+};
+
+#endif  // S2_S2PHASE_TRACER_H_
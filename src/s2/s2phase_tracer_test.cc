@@ -0,0 +1,82 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2phase_tracer.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "s2/s2memory_tracker.h"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+class RecordingTracer : public S2PhaseTracer {
+ public:
+  void BeginPhase(absl::string_view phase) override {
+    events.push_back(absl::StrCat("begin ", phase));
+  }
+  void EndPhase(absl::string_view phase, const PhaseStats& stats) override {
+    events.push_back(absl::StrCat("end ", phase));
+    last_stats = stats;
+  }
+
+  vector<string> events;
+  PhaseStats last_stats;
+};
+
+TEST(S2PhaseTracer, NullTracer) {
+  S2PhaseTracer::Scope scope(nullptr, "Test::Phase", nullptr);
+  scope.set_num_items(5);
+}
+
+TEST(S2PhaseTracer, NestedPhases) {
+  RecordingTracer tracer;
+  {
+    S2PhaseTracer::Scope outer(&tracer, "Test::Outer", nullptr);
+    {
+      S2PhaseTracer::Scope inner(&tracer, "Test::Inner", nullptr);
+      inner.set_num_items(7);
+    }
+    EXPECT_EQ(tracer.last_stats.num_items, 7);
+  }
+  EXPECT_EQ(tracer.events,
+            (vector<string>{"begin Test::Outer", "begin Test::Inner",
+                            "end Test::Inner", "end Test::Outer"}));
+  EXPECT_EQ(tracer.last_stats.num_items, -1);
+  EXPECT_GE(tracer.last_stats.elapsed.count(), 0);
+  EXPECT_EQ(tracer.last_stats.memory_delta_bytes, 0);
+}
+
+TEST(S2PhaseTracer, MemoryDelta) {
+  RecordingTracer tracer;
+  S2MemoryTracker memory_tracker;
+  S2MemoryTracker::Client client(&memory_tracker);
+  client.Tally(100);
+  {
+    S2PhaseTracer::Scope scope(&tracer, "Test::Phase", &memory_tracker);
+    client.Tally(1000);
+    client.Tally(-300);
+  }
+  EXPECT_EQ(tracer.last_stats.memory_delta_bytes, 700);
+  EXPECT_EQ(tracer.last_stats.memory_usage_bytes, 800);
+}
+
+}  // namespace
@@ -17,6 +17,8 @@
 #include "s2/s2point_compression.h"
 
 #include <algorithm>
+#include <cstddef>
+#include <limits>
 #include <utility>
 #include <vector>
 
@@ -26,6 +28,7 @@
 #include "absl/types/span.h"
 
 #include "s2/base/types.h"
+#include "s2/encoded_uint_vector.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2coords.h"
 #include "s2/s2point.h"
@@ -33,6 +36,7 @@
 #include "s2/util/coding/coder.h"
 #include "s2/util/coding/nth-derivative.h"
 #include "s2/util/coding/transforms.h"
+#include "s2/util/coding/varint.h"
 #include "s2/util/endian/endian.h"
 
 using absl::Span;
@@ -291,16 +295,13 @@ bool DecodeFirstPointFixedLength(Decoder* decoder,
   return true;
 }
 
-bool DecodePointCompressed(Decoder* decoder,
-                           int level,
+// Applies the varint-decoded value "interleaved_zig_zag_encoded_deriv_pi_qi"
+// (as written by EncodePointCompressed) to the derivative coders and returns
+// the resulting (pi, qi) coordinates in "vertex_pi_qi".
+void DecodePointCompressed(uint64 interleaved_zig_zag_encoded_deriv_pi_qi,
                            NthDerivativeCoder* pi_coder,
                            NthDerivativeCoder* qi_coder,
                            pair<int, int>* vertex_pi_qi) {
-  uint64 interleaved_zig_zag_encoded_deriv_pi_qi;
-  if (!decoder->get_varint64(&interleaved_zig_zag_encoded_deriv_pi_qi)) {
-    return false;
-  }
-
   uint32 zig_zag_encoded_deriv_pi, zig_zag_encoded_deriv_qi;
   util_bits::DeinterleaveUint32(interleaved_zig_zag_encoded_deriv_pi_qi,
                                 &zig_zag_encoded_deriv_pi,
@@ -310,8 +311,6 @@ bool DecodePointCompressed(Decoder* decoder,
       pi_coder->Decode(ZigZagDecode(zig_zag_encoded_deriv_pi));
   vertex_pi_qi->second =
       qi_coder->Decode(ZigZagDecode(zig_zag_encoded_deriv_qi));
-
-  return true;
 }
 
 }  // namespace
@@ -356,25 +355,34 @@ bool S2DecodePointsCompressed(Decoder* decoder, int level,
   NthDerivativeCoder pi_coder(kDerivativeEncodingOrder);
   NthDerivativeCoder qi_coder(kDerivativeEncodingOrder);
   Faces::Iterator faces_iterator = faces.GetIterator();
-  for (size_t i = 0; i < points.size(); ++i) {
+  if (!points.empty()) {
     pair<int, int> vertex_pi_qi;
-    if (i == 0) {
-      if (!DecodeFirstPointFixedLength(decoder, level, &pi_coder, &qi_coder,
-                                       &vertex_pi_qi)) {
-        return false;
-      }
-    } else {
-      if (!DecodePointCompressed(decoder, level, &pi_coder, &qi_coder,
-                                 &vertex_pi_qi)) {
-        return false;
-      }
+    if (!DecodeFirstPointFixedLength(decoder, level, &pi_coder, &qi_coder,
+                                     &vertex_pi_qi)) {
+      return false;
     }
-
     int face = faces_iterator.Next();
-    points[i] =
+    points[0] =
         FacePiQitoXYZ(face, vertex_pi_qi.first, vertex_pi_qi.second, level);
   }
 
+  // The remaining points are encoded as consecutive varints, which are
+  // decoded in blocks since this is much faster than decoding them one at
+  // a time.
+  constexpr size_t kBlockSize = 64;
+  uint64 values[kBlockSize];
+  for (size_t i = 1; i < points.size(); i += kBlockSize) {
+    const size_t n = std::min(kBlockSize, points.size() - i);
+    if (!decoder->get_varint64_array(values, n)) return false;
+    for (size_t j = 0; j < n; ++j) {
+      pair<int, int> vertex_pi_qi;
+      DecodePointCompressed(values[j], &pi_coder, &qi_coder, &vertex_pi_qi);
+      int face = faces_iterator.Next();
+      points[i + j] =
+          FacePiQitoXYZ(face, vertex_pi_qi.first, vertex_pi_qi.second, level);
+    }
+  }
+
   unsigned int num_off_center;
   if (!decoder->get_varint32(&num_off_center) ||
       num_off_center > points.size()) {
@@ -390,3 +398,102 @@ bool S2DecodePointsCompressed(Decoder* decoder, int level,
   }
   return true;
 }
+
+void S2BlockedCompressedPointVector::Encode(
+    Span<const S2XYZFaceSiTi> points, int level, Encoder* encoder,
+    int block_size) {
+  ABSL_DCHECK_GT(block_size, 0);
+  ABSL_DCHECK_LE(level, S2::kMaxCellLevel);
+
+  // Encode the blocks first so that the skip index can be written ahead of
+  // them.
+  Encoder blocks;
+  vector<uint32> block_ends;
+  for (size_t i = 0; i < points.size(); i += block_size) {
+    size_t n = std::min<size_t>(block_size, points.size() - i);
+    S2EncodePointsCompressed(points.subspan(i, n), level, &blocks);
+    block_ends.push_back(blocks.length());
+  }
+
+  // Encoding format:
+  //   varint64: number of points
+  //   varint32: block size
+  //   byte: level
+  //   EncodedUintVector<uint32>: end offset of each block
+  //   The blocks, each encoded by S2EncodePointsCompressed().
+  encoder->Ensure(Varint::kMax64 + Varint::kMax32 + 1);
+  encoder->put_varint64(points.size());
+  encoder->put_varint32(block_size);
+  encoder->put8(level);
+  s2coding::EncodeUintVector<uint32>(block_ends, encoder);
+  encoder->Ensure(blocks.length());
+  encoder->putn(blocks.base(), blocks.length());
+}
+
+bool S2BlockedCompressedPointVector::Init(Decoder* decoder) {
+  uint64 size;
+  uint32 block_size;
+  if (!decoder->get_varint64(&size)) return false;
+  if (!decoder->get_varint32(&block_size)) return false;
+  if (block_size == 0 || block_size > std::numeric_limits<int32>::max()) {
+    return false;
+  }
+  if (decoder->avail() < 1) return false;
+  int level = decoder->get8();
+  if (level > S2::kMaxCellLevel) return false;
+  if (!block_ends_.Init(decoder)) return false;
+
+  // Check that the skip index is consistent with the number of points and
+  // the remaining data, so that Decode() never reads outside the buffer.
+  uint64 num_blocks = size / block_size + (size % block_size != 0);
+  if (block_ends_.size() != num_blocks) return false;
+  uint32 prev_end = 0;
+  for (size_t i = 0; i < num_blocks; ++i) {
+    uint32 end = block_ends_[i];
+    if (end < prev_end) return false;
+    prev_end = end;
+  }
+  if (prev_end > decoder->avail()) return false;
+
+  size_ = size;
+  block_size_ = block_size;
+  level_ = level;
+  data_ = decoder->skip(0);
+  decoder->skip(prev_end);
+  return true;
+}
+
+bool S2BlockedCompressedPointVector::DecodeBlock(size_t block,
+                                                 Span<S2Point> out) const {
+  uint32 start = (block == 0) ? 0 : block_ends_[block - 1];
+  Decoder decoder(data_ + start, block_ends_[block] - start);
+  return S2DecodePointsCompressed(&decoder, level_, out);
+}
+
+bool S2BlockedCompressedPointVector::Decode(size_t begin,
+                                            Span<S2Point> out) const {
+  ABSL_DCHECK_LE(begin + out.size(), size());
+  absl::FixedArray<S2Point, kDefaultBlockSize> block_points(
+      out.empty() ? 0 : std::min<size_t>(block_size_, size_));
+  size_t i = begin;
+  const size_t end = begin + out.size();
+  while (i < end) {
+    const size_t block = i / block_size_;
+    const size_t block_begin = block * block_size_;
+    const size_t block_end = std::min(block_begin + block_size_, size_);
+    const size_t n = block_end - block_begin;
+    if (i == block_begin && block_end <= end) {
+      // The whole block is needed, so decode it directly into the output.
+      if (!DecodeBlock(block, out.subspan(i - begin, n))) return false;
+    } else {
+      Span<S2Point> points(block_points.data(), n);
+      if (!DecodeBlock(block, points)) return false;
+      const size_t last = std::min(block_end, end);
+      std::copy(points.begin() + (i - block_begin),
+                points.begin() + (last - block_begin),
+                out.begin() + (i - begin));
+    }
+    i = block_end;
+  }
+  return true;
+}
@@ -46,9 +46,13 @@
 #ifndef S2_S2POINT_COMPRESSION_H_
 #define S2_S2POINT_COMPRESSION_H_
 
+#include <cstddef>
+
 #include "absl/types/span.h"
 #include "s2/util/coding/coder.h"
 #include "s2/_fp_contract_off.h"
+#include "s2/base/types.h"
+#include "s2/encoded_uint_vector.h"
 #include "s2/s1angle.h"
 #include "s2/s2point.h"
 
@@ -77,4 +81,69 @@ void S2EncodePointsCompressed(absl::Span<const S2XYZFaceSiTi> points,
 bool S2DecodePointsCompressed(Decoder* decoder, int level,
                               absl::Span<S2Point> points);
 
+// A random-access variant of the format above.  The points are divided into
+// blocks of "block_size" points, each of which is encoded independently
+// using S2EncodePointsCompressed(), and a skip index records where each
+// block begins.  Any point or range of points can then be decoded in time
+// proportional to the block size rather than the number of points.  The
+// cost is a few bytes per block, since the face and first vertex of every
+// block are encoded in full.  For example:
+//
+//   S2BlockedCompressedPointVector::Encode(points, level, &encoder);
+//   ...
+//   S2BlockedCompressedPointVector v;
+//   if (!v.Init(&decoder)) return false;
+//   S2Point p;
+//   if (!v.Decode(i, absl::MakeSpan(&p, 1))) return false;
+class S2BlockedCompressedPointVector {
+ public:
+  // The default number of points per block.
+  static constexpr int kDefaultBlockSize = 32;
+
+  // Encodes the given points, using the compressed format for points at
+  // the center of a cell at "level".
+  //
+  // REQUIRES: block_size > 0
+  static void Encode(absl::Span<const S2XYZFaceSiTi> points, int level,
+                     Encoder* encoder, int block_size = kDefaultBlockSize);
+
+  // Constructs an uninitialized object; requires Init() to be called.
+  S2BlockedCompressedPointVector() = default;
+
+  // Initializes the vector from data written by Encode().  Only the header
+  // and skip index are decoded; the points are decoded on demand.  Returns
+  // false if the header or skip index is invalid.
+  //
+  // REQUIRES: The Decoder data buffer must outlive this object.
+  bool Init(Decoder* decoder);
+
+  // Returns the number of points.
+  size_t size() const { return size_; }
+
+  // Returns the number of points per block.
+  int block_size() const { return block_size_; }
+
+  // Returns the level passed to Encode().
+  int level() const { return level_; }
+
+  // Decodes the points [begin, begin + out.size()) into "out", decoding
+  // only the blocks that overlap this range.  Returns false if the encoded
+  // data for any of these blocks is invalid.
+  //
+  // REQUIRES: begin + out.size() <= size()
+  bool Decode(size_t begin, absl::Span<S2Point> out) const;
+
+ private:
+  // Decodes all the points of the given block into "out".
+  bool DecodeBlock(size_t block, absl::Span<S2Point> out) const;
+
+  size_t size_ = 0;
+  int block_size_ = 0;
+  int level_ = 0;
+
+  // The end offset of each block relative to "data_".
+  s2coding::EncodedUintVector<uint32> block_ends_;
+  const char* data_ = nullptr;
+};
+
 #endif  // S2_S2POINT_COMPRESSION_H_
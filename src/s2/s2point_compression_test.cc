@@ -16,6 +16,7 @@
 
 #include "s2/s2point_compression.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -24,6 +25,7 @@
 #include "absl/container/fixed_array.h"
 #include "absl/flags/flag.h"
 #include "absl/log/absl_check.h"
+#include "absl/random/random.h"
 #include "absl/types/span.h"
 
 #include "s2/base/commandlineflags.h"
@@ -34,6 +36,7 @@
 #include "s2/s2testing.h"
 #include "s2/s2text_format.h"
 #include "s2/util/coding/coder.h"
+#include "s2/util/coding/varint.h"
 
 using absl::FixedArray;
 using absl::MakeSpan;
@@ -309,4 +312,135 @@ TEST_F(S2PointCompressionTest, FirstPointOnFaceEdge) {
   ABSL_CHECK(result[1] == points[1].xyz);
 }
 
+TEST_F(S2PointCompressionTest, Roundtrips1000VertexLoop) {
+  // Use enough points to span several blocks of the batch varint decoder.
+  Roundtrip(MakeRegularPoints(1000, 0.1, S2::kMaxCellLevel),
+            S2::kMaxCellLevel);
+}
+
+TEST_F(S2PointCompressionTest, Roundtrips1000VertexLevel20Loop) {
+  Roundtrip(MakeRegularPoints(1000, 10.0, 20), 20);
+}
+
+TEST_F(S2PointCompressionTest, TruncatedInputFails) {
+  vector<S2Point> loop = MakeRegularPoints(200, 1.0, 25);
+  Encode(loop, 25);
+  vector<S2Point> result(loop.size());
+  for (size_t len = 0; len < encoder_.length(); ++len) {
+    Decoder decoder(encoder_.base(), len);
+    EXPECT_FALSE(S2DecodePointsCompressed(&decoder, 25, MakeSpan(result)))
+        << len;
+  }
+}
+
+TEST_F(S2PointCompressionTest, BlockedRoundtripsAllRanges) {
+  // Include points that are not cell centers, which are stored exactly.
+  vector<S2Point> loop = MakeRegularPoints(50, 1.0, 20);
+  for (int i = 0; i < loop.size(); i += 7) {
+    loop[i] = SnapPointToLevel(loop[i], 15);
+  }
+  loop[23] = S2Point(1, 2, 3).Normalize();
+  FixedArray<S2XYZFaceSiTi> pts(loop.size());
+  MakeXYZFaceSiTiPoints(loop, MakeSpan(pts));
+  for (int block_size : {1, 7, 32, 64}) {
+    Encoder encoder;
+    S2BlockedCompressedPointVector::Encode(pts, 20, &encoder, block_size);
+    Decoder decoder(encoder.base(), encoder.length());
+    S2BlockedCompressedPointVector v;
+    ASSERT_TRUE(v.Init(&decoder));
+    EXPECT_EQ(0, decoder.avail());
+    EXPECT_EQ(loop.size(), v.size());
+    EXPECT_EQ(block_size, v.block_size());
+    EXPECT_EQ(20, v.level());
+    for (size_t begin = 0; begin <= loop.size(); ++begin) {
+      for (size_t end = begin; end <= loop.size(); ++end) {
+        vector<S2Point> points(end - begin);
+        ASSERT_TRUE(v.Decode(begin, MakeSpan(points)));
+        ASSERT_TRUE(std::equal(points.begin(), points.end(),
+                               loop.begin() + begin))
+            << block_size << ": [" << begin << ", " << end << ")";
+      }
+    }
+  }
+}
+
+TEST_F(S2PointCompressionTest, BlockedEmpty) {
+  Encoder encoder;
+  S2BlockedCompressedPointVector::Encode({}, S2::kMaxCellLevel, &encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  S2BlockedCompressedPointVector v;
+  ASSERT_TRUE(v.Init(&decoder));
+  EXPECT_EQ(0, v.size());
+  EXPECT_TRUE(v.Decode(0, {}));
+}
+
+TEST_F(S2PointCompressionTest, BlockedSizeOverhead) {
+  // The per-block overhead should be small compared to the points.
+  FixedArray<S2XYZFaceSiTi> pts(loop_100_.size());
+  MakeXYZFaceSiTiPoints(loop_100_, MakeSpan(pts));
+  Encode(loop_100_, S2::kMaxCellLevel);
+  Encoder encoder;
+  S2BlockedCompressedPointVector::Encode(pts, S2::kMaxCellLevel, &encoder);
+  EXPECT_LT(encoder.length(), 2 * encoder_.length());
+}
+
+TEST_F(S2PointCompressionTest, BlockedInitRejectsTruncatedInput) {
+  vector<S2Point> loop = MakeRegularPoints(100, 1.0, 25);
+  FixedArray<S2XYZFaceSiTi> pts(loop.size());
+  MakeXYZFaceSiTiPoints(loop, MakeSpan(pts));
+  Encoder encoder;
+  S2BlockedCompressedPointVector::Encode(pts, 25, &encoder, 16);
+  for (size_t len = 0; len < encoder.length(); ++len) {
+    Decoder decoder(encoder.base(), len);
+    S2BlockedCompressedPointVector v;
+    EXPECT_FALSE(v.Init(&decoder)) << len;
+  }
+}
+
+TEST(VarintBatch, MatchesParse64) {
+  // Encodes random values of all lengths (with many short values, so that
+  // the 8-byte fast paths are exercised) and checks that the batch decoder
+  // agrees with Parse64WithLimit() for every prefix of every input.
+  absl::BitGen bitgen;
+  for (int iter = 0; iter < 200; ++iter) {
+    vector<uint64> values(absl::Uniform(bitgen, 0, 40));
+    for (uint64& value : values) {
+      int bits = absl::Bernoulli(bitgen, 0.5) ? absl::Uniform(bitgen, 0, 8)
+                                              : absl::Uniform(bitgen, 0, 65);
+      value = bits == 0 ? 0 : absl::Uniform<uint64>(bitgen) >> (64 - bits);
+    }
+    std::string data;
+    for (uint64 value : values) Varint::Append64(&data, value);
+    const char* limit = data.data() + data.size();
+    vector<uint64> expected(values.size()), actual(values.size());
+    for (size_t n = 0; n <= values.size(); ++n) {
+      const char* expected_end = data.data();
+      for (size_t i = 0; i < n; ++i) {
+        expected_end =
+            Varint::Parse64WithLimit(expected_end, limit, &expected[i]);
+      }
+      const char* actual_end =
+          Varint::Parse64BatchWithLimit(data.data(), limit, actual.data(), n);
+      ASSERT_EQ(expected_end, actual_end);
+      for (size_t i = 0; i < n; ++i) ASSERT_EQ(values[i], actual[i]);
+    }
+    // Truncating the input anywhere within the values must fail.
+    if (!values.empty()) {
+      size_t len = absl::Uniform<size_t>(bitgen, 0, data.size());
+      EXPECT_EQ(nullptr,
+                Varint::Parse64BatchWithLimit(data.data(), data.data() + len,
+                                              actual.data(), values.size()));
+    }
+  }
+}
+
+TEST(VarintBatch, RejectsMalformedValues) {
+  // An 11-byte value with all continuation bits set is not a varint64.
+  std::string data(11, '\x80');
+  data += std::string(16, '\x01');
+  uint64 values[4];
+  EXPECT_EQ(nullptr, Varint::Parse64BatchWithLimit(
+                         data.data(), data.data() + data.size(), values, 4));
+}
+
 }  // namespace
@@ -19,16 +19,26 @@
 #define S2_S2POINT_INDEX_H_
 
 #include <cstddef>
+#include <cstring>
 
+#include <algorithm>
+#include <new>
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/container/btree_map.h"
 #include "absl/log/absl_check.h"
+#include "absl/types/span.h"
 
+#include "s2/base/port.h"
+#include "s2/base/types.h"
+#include "s2/util/coding/coder.h"
+#include "s2/util/coding/varint.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_iterator.h"
+#include "s2/s2hilbert_sort.h"
 #include "s2/s2point.h"
 
 namespace s2internal {
@@ -98,6 +108,19 @@ class BTreeMultimap : public absl::btree_multimap<Key, Value> {
 //     DoSomething(it.id(), it.point(), it.data());
 //   }
 //
+// Large point sets that do not change should be loaded all at once using the
+// bulk-load constructor, which produces a "frozen" index:
+//
+//   std::vector<S2PointIndex<int>::PointData> points = ...;
+//   S2PointIndex<int> index(std::move(points), /*num_threads=*/8);
+//
+// A frozen index stores its points in a flat array sorted by S2CellId rather
+// than in a btree, which is much faster to build and uses less memory.  It
+// has the same Iterator interface and can be used with S2ClosestPointQuery.
+// A frozen index can also be encoded and later initialized directly from the
+// encoded data (e.g. a memory-mapped file) without copying it; see Init().
+// Calling Add() or Remove() on a frozen index converts it back to a btree.
+//
 // TODO(ericv): Consider adding an S2PointIndexRegion class, which could be
 // used to efficiently compute coverings of a collection of S2Points.
 //
@@ -135,9 +158,20 @@ class S2PointIndex {
   // TODO(b/252809194): Move definition back to .cc file.
   S2PointIndex() = default;
 
+  // Bulk-load constructor that creates a frozen index containing the given
+  // points (see above).  The points are sorted by S2CellId using up to
+  // "num_threads" threads.  Points in the same leaf cell keep their original
+  // relative order.
+  explicit S2PointIndex(std::vector<PointData> points, int num_threads = 1);
+
   // Returns the number of points in the index.
   int num_points() const;
 
+  // Returns true if the points are stored in a flat array rather than a
+  // btree, i.e. the index was bulk-loaded or decoded and has not been
+  // modified since.
+  bool is_frozen() const { return frozen_; }
+
   // Adds the given point to the index.  Invalidates all iterators.
   void Add(const S2Point& point, const Data& data);
   void Add(const PointData& point_data);
@@ -157,9 +191,48 @@ class S2PointIndex {
   // Resets the index to its original empty state.  Invalidates all iterators.
   void Clear();
 
-  // Returns the number of bytes currently occupied by the index.
+  // Returns the number of bytes currently occupied by the index.  (For an
+  // index initialized with Init(), this does not include the encoded data.)
   size_t SpaceUsed() const;
 
+  // Appends an encoded representation of the index to "encoder".  The points
+  // are stored as an array of S2CellIds followed by an array of PointData
+  // objects in their in-memory representation, so that Init() can use the
+  // encoded data without copying it.  This means that the encoding can only
+  // be decoded by code that uses the same "Data" type on an architecture
+  // with the same endianness and data layout.
+  //
+  // REQUIRES: "Data" is trivially copyable.
+  // REQUIRES: "encoder" uses the default constructor, so that its buffer
+  //           can be enlarged as necessary by calling Ensure(int).
+  void Encode(Encoder* encoder) const;
+
+  // Decodes an index encoded with Encode(), copying the points into a frozen
+  // index.  Returns false if the encoding is invalid or was produced for a
+  // different PointData layout.  Invalidates all iterators.
+  bool Decode(Decoder* decoder);
+
+  // Like Decode(), except that the frozen index refers to the encoded points
+  // directly rather than copying them, so that initialization takes constant
+  // time.  Returns false on architectures that do not support unaligned
+  // 64-bit loads.
+  //
+  // REQUIRES: The Decoder data buffer must outlive this object (or until the
+  //           index is modified or cleared).
+  bool Init(Decoder* decoder);
+
+  // Replaces the contents of the index with a frozen index containing the
+  // given points, which must already be sorted by S2CellId (e.g. because
+  // they were produced by S2ShardedPointIndex::Freeze).  This is faster than
+  // the bulk-load constructor because no sorting is done.  Invalidates all
+  // iterators.
+  //
+  // REQUIRES: ids.size() == points.size()
+  // REQUIRES: ids[i] == S2CellId(points[i].point()) for all i
+  // REQUIRES: "ids" is sorted
+  void InitFromSorted(std::vector<S2CellId> ids,
+                      std::vector<PointData> points);
+
  private:
   // Defined here because the Iterator class below uses it.
   using Map = s2internal::BTreeMultimap<S2CellId, PointData>;
@@ -234,14 +307,39 @@ class S2PointIndex {
     }
 
    private:
+    // If the index is frozen then map_ is nullptr, and the iterator is
+    // positioned at ids_[pos_] and points_[pos_].
     const Map* map_;
     typename Map::const_iterator iter_, end_;
+    absl::Span<const S2CellId> ids_;
+    const PointData* points_ = nullptr;
+    size_t pos_ = 0;
   };
 
  private:
   friend class Iterator;
+  template <class Distance, class D>
+  friend class S2ClosestPointQueryBase;
+
+  static constexpr unsigned char kCurrentEncodingVersionNumber = 0;
+
+  // Copies the points of a frozen index into map_.
+  void Thaw();
+
+  // Reads the encoding header and returns the number of points.
+  static bool DecodeHeader(Decoder* decoder, size_t* num_points);
+
   Map map_;
 
+  // When frozen_ is true the points are stored in "ids_" and "points_"
+  // (sorted by S2CellId) instead of "map_".  These refer either to
+  // id_storage_ and point_storage_ or to encoded data (see Init).
+  bool frozen_ = false;
+  absl::Span<const S2CellId> ids_;
+  absl::Span<const PointData> points_;
+  std::vector<S2CellId> id_storage_;
+  std::vector<PointData> point_storage_;
+
   S2PointIndex(const S2PointIndex&) = delete;
   void operator=(const S2PointIndex&) = delete;
 };
@@ -249,13 +347,43 @@ class S2PointIndex {
 
 //////////////////   Implementation details follow   ////////////////////
 
+template <class Data>
+S2PointIndex<Data>::S2PointIndex(std::vector<PointData> points,
+                                 int num_threads) {
+  S2::SortInHilbertOrderBy(
+      &points, [](const PointData& point_data) { return point_data.point(); },
+      num_threads);
+  id_storage_.reserve(points.size());
+  for (const PointData& point_data : points) {
+    id_storage_.push_back(S2CellId(point_data.point()));
+  }
+  point_storage_ = std::move(points);
+  ids_ = id_storage_;
+  points_ = point_storage_;
+  frozen_ = true;
+}
+
 template <class Data>
 inline int S2PointIndex<Data>::num_points() const {
-  return map_.size();
+  return frozen_ ? ids_.size() : map_.size();
+}
+
+template <class Data>
+void S2PointIndex<Data>::Thaw() {
+  ABSL_DCHECK(frozen_);
+  for (size_t i = 0; i < ids_.size(); ++i) {
+    map_.insert(map_.end(), std::make_pair(ids_[i], points_[i]));
+  }
+  frozen_ = false;
+  ids_ = {};
+  points_ = {};
+  id_storage_ = std::vector<S2CellId>();
+  point_storage_ = std::vector<PointData>();
 }
 
 template <class Data>
 void S2PointIndex<Data>::Add(const PointData& point_data) {
+  if (frozen_) Thaw();
   S2CellId id(point_data.point());
   map_.insert(std::make_pair(id, point_data));
 }
@@ -273,6 +401,7 @@ void S2PointIndex<Data>::Add(const S2Point& point) {
 
 template <class Data>
 bool S2PointIndex<Data>::Remove(const PointData& point_data) {
+  if (frozen_) Thaw();
   S2CellId id(point_data.point());
   for (typename Map::iterator it = map_.lower_bound(id), end = map_.end();
        it != end && it->first == id; ++it) {
@@ -298,11 +427,115 @@ void S2PointIndex<Data>::Remove(const S2Point& point) {
 template <class Data>
 void S2PointIndex<Data>::Clear() {
   map_.clear();
+  frozen_ = false;
+  ids_ = {};
+  points_ = {};
+  id_storage_ = std::vector<S2CellId>();
+  point_storage_ = std::vector<PointData>();
 }
 
 template <class Data>
 size_t S2PointIndex<Data>::SpaceUsed() const {
-  return sizeof(*this) - sizeof(map_) + map_.bytes_used();
+  return sizeof(*this) - sizeof(map_) + map_.bytes_used() +
+         id_storage_.capacity() * sizeof(S2CellId) +
+         point_storage_.capacity() * sizeof(PointData);
+}
+
+// The encoding format is:
+//
+//   byte:      version number (kCurrentEncodingVersionNumber)
+//   varint64:  sizeof(PointData)
+//   varint64:  number of points (N)
+//   N * 8:     leaf S2CellIds in increasing order
+//   N * sizeof(PointData): the corresponding PointData objects
+template <class Data>
+void S2PointIndex<Data>::Encode(Encoder* encoder) const {
+  static_assert(std::is_trivially_copyable<Data>::value,
+                "Data must be trivially copyable");
+  const size_t n = num_points();
+  encoder->Ensure(1 + 2 * Varint::kMax64 +
+                  n * (sizeof(S2CellId) + sizeof(PointData)));
+  encoder->put8(kCurrentEncodingVersionNumber);
+  encoder->put_varint64(sizeof(PointData));
+  encoder->put_varint64(n);
+  for (Iterator it(this); !it.done(); it.Next()) {
+    const S2CellId id = it.id();
+    encoder->putn(&id, sizeof(id));
+  }
+  for (Iterator it(this); !it.done(); it.Next()) {
+    // Copy into a zeroed buffer so that any padding bytes are deterministic.
+    alignas(PointData) char buf[sizeof(PointData)];
+    std::memset(buf, 0, sizeof(buf));
+    new (buf) PointData(it.point_data());
+    encoder->putn(buf, sizeof(buf));
+  }
+}
+
+template <class Data>
+bool S2PointIndex<Data>::DecodeHeader(Decoder* decoder, size_t* num_points) {
+  static_assert(std::is_trivially_copyable<Data>::value,
+                "Data must be trivially copyable");
+  if (decoder->avail() < 1) return false;
+  if (decoder->get8() != kCurrentEncodingVersionNumber) return false;
+  uint64 point_size, n;
+  if (!decoder->get_varint64(&point_size) || point_size != sizeof(PointData) ||
+      !decoder->get_varint64(&n)) {
+    return false;
+  }
+  if (n > decoder->avail() / (sizeof(S2CellId) + sizeof(PointData))) {
+    return false;
+  }
+  *num_points = n;
+  return true;
+}
+
+template <class Data>
+bool S2PointIndex<Data>::Decode(Decoder* decoder) {
+  size_t n;
+  if (!DecodeHeader(decoder, &n)) return false;
+  Clear();
+  id_storage_.resize(n);
+  point_storage_.resize(n);
+  decoder->getn(id_storage_.data(), n * sizeof(S2CellId));
+  decoder->getn(point_storage_.data(), n * sizeof(PointData));
+  ids_ = id_storage_;
+  points_ = point_storage_;
+  frozen_ = true;
+  return true;
+}
+
+template <class Data>
+void S2PointIndex<Data>::InitFromSorted(std::vector<S2CellId> ids,
+                                        std::vector<PointData> points) {
+  ABSL_DCHECK_EQ(ids.size(), points.size());
+  ABSL_DCHECK(std::is_sorted(ids.begin(), ids.end()));
+  map_.clear();
+  id_storage_ = std::move(ids);
+  point_storage_ = std::move(points);
+  ids_ = id_storage_;
+  points_ = point_storage_;
+  frozen_ = true;
+}
+
+template <class Data>
+bool S2PointIndex<Data>::Init(Decoder* decoder) {
+#if !defined(IS_LITTLE_ENDIAN) || defined(__arm__) || \
+  defined(ABSL_INTERNAL_NEED_ALIGNED_LOADS)
+  // See EncodedS2PointVector::InitUncompressedFormat().
+  return false;
+#endif
+  size_t n;
+  if (!DecodeHeader(decoder, &n)) return false;
+  Clear();
+  ids_ = absl::MakeConstSpan(
+      reinterpret_cast<const S2CellId*>(decoder->skip(n * sizeof(S2CellId))),
+      n);
+  points_ = absl::MakeConstSpan(
+      reinterpret_cast<const PointData*>(
+          decoder->skip(n * sizeof(PointData))),
+      n);
+  frozen_ = true;
+  return true;
 }
 
 template <class Data>
@@ -318,6 +551,13 @@ inline S2PointIndex<Data>::Iterator::Iterator(
 template <class Data>
 inline void S2PointIndex<Data>::Iterator::Init(
     const S2PointIndex<Data>* index) {
+  if (index->frozen_) {
+    map_ = nullptr;
+    ids_ = index->ids_;
+    points_ = index->points_.data();
+    pos_ = 0;
+    return;
+  }
   map_ = &index->map_;
   iter_ = map_->begin();
   end_ = map_->end();
@@ -326,59 +566,80 @@ inline void S2PointIndex<Data>::Iterator::Init(
 template <class Data>
 inline S2CellId S2PointIndex<Data>::Iterator::id() const {
   ABSL_DCHECK(!done());
-  return iter_->first;
+  return map_ ? iter_->first : ids_[pos_];
 }
 
 template <class Data>
 inline const S2Point& S2PointIndex<Data>::Iterator::point() const {
   ABSL_DCHECK(!done());
-  return iter_->second.point();
+  return point_data().point();
 }
 
 template <class Data>
 inline const Data& S2PointIndex<Data>::Iterator::data() const {
   ABSL_DCHECK(!done());
-  return iter_->second.data();
+  return point_data().data();
 }
 
 template <class Data>
 inline const typename S2PointIndex<Data>::PointData&
 S2PointIndex<Data>::Iterator::point_data() const {
   ABSL_DCHECK(!done());
-  return iter_->second;
+  return map_ ? iter_->second : points_[pos_];
 }
 
 template <class Data>
 inline bool S2PointIndex<Data>::Iterator::done() const {
-  return iter_ == end_;
+  return map_ ? iter_ == end_ : pos_ == ids_.size();
 }
 
 template <class Data>
 inline void S2PointIndex<Data>::Iterator::Begin() {
-  iter_ = map_->begin();
+  if (map_) {
+    iter_ = map_->begin();
+  } else {
+    pos_ = 0;
+  }
 }
 
 template <class Data>
 inline void S2PointIndex<Data>::Iterator::Finish() {
-  iter_ = end_;
+  if (map_) {
+    iter_ = end_;
+  } else {
+    pos_ = ids_.size();
+  }
 }
 
 template <class Data>
 inline void S2PointIndex<Data>::Iterator::Next() {
   ABSL_DCHECK(!done());
-  ++iter_;
+  if (map_) {
+    ++iter_;
+  } else {
+    ++pos_;
+  }
 }
 
 template <class Data>
 inline bool S2PointIndex<Data>::Iterator::Prev() {
-  if (iter_ == map_->begin()) return false;
-  --iter_;
+  if (map_) {
+    if (iter_ == map_->begin()) return false;
+    --iter_;
+  } else {
+    if (pos_ == 0) return false;
+    --pos_;
+  }
   return true;
 }
 
 template <class Data>
 inline void S2PointIndex<Data>::Iterator::Seek(S2CellId target) {
-  iter_ = map_->lower_bound(target);
+  if (map_) {
+    iter_ = map_->lower_bound(target);
+  } else {
+    pos_ = std::lower_bound(ids_.begin(), ids_.end(), target) - ids_.begin();
+  }
 }
 
 #endif  // S2_S2POINT_INDEX_H_
@@ -18,12 +18,15 @@
 #include "s2/s2point_index.h"
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_union.h"
 #include "s2/s2point.h"
 #include "s2/s2testing.h"
+#include "s2/util/coding/coder.h"
 
 class S2PointIndexTest : public ::testing::Test {
  protected:
@@ -45,14 +48,17 @@ class S2PointIndexTest : public ::testing::Test {
     index_.Remove(point, data);  // Invalidates "point".
   }
 
-  void Verify() {
-    VerifyContents();
-    VerifyIteratorMethods();
+  void Verify() { Verify(index_); }
+
+  void Verify(const Index& index) {
+    VerifyContents(index);
+    VerifyIteratorMethods(index);
   }
 
-  void VerifyContents() {
+  void VerifyContents(const Index& index) {
+    EXPECT_EQ(contents_.size(), index.num_points());
     Contents remaining = contents_;
-    for (Index::Iterator it(&index_); !it.done(); it.Next()) {
+    for (Index::Iterator it(&index); !it.done(); it.Next()) {
       Contents::iterator element = remaining.find(it.point_data());
       EXPECT_TRUE(element != remaining.end());
       remaining.erase(element);
@@ -60,8 +66,8 @@ class S2PointIndexTest : public ::testing::Test {
     EXPECT_TRUE(remaining.empty());
   }
 
-  void VerifyIteratorMethods() {
-    Index::Iterator it(&index_);
+  void VerifyIteratorMethods(const Index& index) {
+    Index::Iterator it(&index);
     EXPECT_FALSE(it.Prev());
     it.Finish();
     EXPECT_TRUE(it.done());
@@ -74,7 +80,7 @@ class S2PointIndexTest : public ::testing::Test {
       EXPECT_EQ(cellid, S2CellId(it.point()));
       EXPECT_GE(cellid, prev_cellid);
 
-      typename Index::Iterator it2(&index_);
+      typename Index::Iterator it2(&index);
       if (cellid == prev_cellid) {
         it2.Seek(cellid);
       }
@@ -136,6 +142,57 @@ TEST_F(S2PointIndexTest, RandomPoints) {
   }
 }
 
+TEST_F(S2PointIndexTest, BulkLoad) {
+  for (int i = 0; i < 1000; ++i) {
+    // Include some duplicate points.
+    Add(i % 10 == 0 ? S2Point(1, 0, 0) : S2Testing::RandomPoint(), i);
+  }
+  std::vector<PointData> points(contents_.begin(), contents_.end());
+  Index frozen(std::move(points), /*num_threads=*/4);
+  EXPECT_TRUE(frozen.is_frozen());
+  Verify(frozen);
+
+  // Modifying a frozen index converts it to a btree.
+  const PointData first = Index::Iterator(&frozen).point_data();
+  contents_.erase(contents_.find(first));
+  frozen.Remove(first);
+  frozen.Add(S2Point(0, 1, 0), 1000);
+  contents_.insert(PointData(S2Point(0, 1, 0), 1000));
+  EXPECT_FALSE(frozen.is_frozen());
+  Verify(frozen);
+}
+
+TEST_F(S2PointIndexTest, EncodeDecode) {
+  for (int i = 0; i < 100; ++i) {
+    Add(S2Testing::RandomPoint(), i);
+  }
+  Encoder encoder;
+  index_.Encode(&encoder);
+
+  Decoder decoder(encoder.base(), encoder.length());
+  Index decoded;
+  ASSERT_TRUE(decoded.Decode(&decoder));
+  EXPECT_EQ(0, decoder.avail());
+  EXPECT_TRUE(decoded.is_frozen());
+  Verify(decoded);
+
+  // Initializing the index from the encoded data does not copy it, so the
+  // encoding of the initialized index must be identical.
+  decoder.reset(encoder.base(), encoder.length());
+  Index initialized;
+  ASSERT_TRUE(initialized.Init(&decoder));
+  Verify(initialized);
+  Encoder encoder2;
+  initialized.Encode(&encoder2);
+  EXPECT_EQ(std::string(encoder.base(), encoder.length()),
+            std::string(encoder2.base(), encoder2.length()));
+
+  // Encodings for a different Data type are rejected.
+  decoder.reset(encoder.base(), encoder.length());
+  S2PointIndex<> wrong_type;
+  EXPECT_FALSE(wrong_type.Decode(&decoder));
+}
+
 TEST(S2PointIndex, EmptyData) {
   // Verify that when Data is an empty class, no space is used.
   EXPECT_EQ(sizeof(S2Point), sizeof(S2PointIndex<>::PointData));
@@ -26,6 +26,7 @@
 #include "s2/encoded_s2point_vector.h"
 #include "s2/s2coder.h"
 #include "s2/s2point.h"
+#include "s2/s2point_span.h"
 #include "s2/s2shape.h"
 
 // S2PointVectorShape is an S2Shape representing a set of S2Points. Each point
@@ -94,6 +95,9 @@ class S2PointVectorShape : public S2Shape {
   ChainPosition chain_position(int e) const final {
     return ChainPosition(e, 0);
   }
+  S2PointSpan chain_vertex_span(int i) const final {
+    return S2PointSpan(&points_[i], 1);
+  }
   TypeTag type_tag() const override { return kTypeTag; }
 
  private:
@@ -21,11 +21,13 @@
 #include <cmath>
 
 #include "absl/log/absl_check.h"
+#include "absl/types/span.h"
 #include "s2/s1angle.h"
 #include "s2/s2point.h"
 #include "s2/util/math/matrix3x3.h"
 
 using std::fabs;
+using std::sqrt;
 
 namespace S2 {
 
@@ -39,6 +41,17 @@ bool IsUnitLength(const S2Point& p) {
   return fabs(p.Norm2() - 1) <= 5 * DBL_EPSILON;  // About 1.11e-15
 }
 
+void NormalizePoints(absl::Span<S2Point> points) {
+  // This is the same arithmetic as Vector3::Normalize(), except that the
+  // branch is replaced by a select.  Note that points whose squared norm
+  // underflows are scaled by zero, just as in Normalize().
+  for (S2Point& p : points) {
+    const double n = sqrt(0.0 + p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+    const double scale = (n != 0.0) ? 1.0 / n : n;
+    p = S2Point(p[0] * scale, p[1] * scale, p[2] * scale);
+  }
+}
+
 bool ApproxEquals(const S2Point& a, const S2Point& b, S1Angle max_error) {
   ABSL_DCHECK_NE(a, S2Point());
   ABSL_DCHECK_NE(b, S2Point());
@@ -21,6 +21,8 @@
 #ifndef S2_S2POINTUTIL_H_
 #define S2_S2POINTUTIL_H_
 
+#include "absl/types/span.h"
+
 #include "s2/_fp_contract_off.h"
 #include "s2/s1angle.h"
 #include "s2/s2point.h"
@@ -42,6 +44,11 @@ inline S2Point Origin();
 // (this is mainly useful for assertions).
 bool IsUnitLength(const S2Point& p);
 
+// Replaces every point "p" with p.Normalize().  The results are identical to
+// calling Normalize() on each point, but the loop can be vectorized by the
+// compiler.
+void NormalizePoints(absl::Span<S2Point> points);
+
 // Returns true if two points are within the given distance of each other
 // (this is mainly useful for testing).  It is an error if either point is a
 // zero-length vector (default S2Point), but this is only checked in debug
@@ -20,9 +20,11 @@
 #include <cmath>
 
 #include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include "absl/log/absl_log.h"
+#include "absl/types/span.h"
 #include "s2/s1angle.h"
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
@@ -35,6 +37,8 @@
 #include "s2/s2testing.h"
 #include "s2/util/math/matrix3x3.h"
 
+using std::vector;
+
 TEST(S2, Frames) {
   Matrix3x3_d m;
   S2Point z = S2Point(0.2, 0.5, -3.3).Normalize();
@@ -116,6 +120,19 @@ static int GetMinExpensiveLevel(const S2Point& p) {
   return S2CellId::kMaxLevel + 1;
 }
 
+TEST(S2, NormalizePoints) {
+  vector<S2Point> points = {S2Point(0, 0, 0), S2Point(-0.0, 3, 4),
+                            S2Point(1e-200, 0, 0), S2Point(1e200, 1e200, 0)};
+  for (int i = 0; i < 100; ++i) {
+    points.push_back(S2Testing::RandomPoint() * S2Testing::rnd.RandDouble());
+  }
+  vector<S2Point> normalized = points;
+  S2::NormalizePoints(absl::MakeSpan(normalized));
+  for (size_t i = 0; i < points.size(); ++i) {
+    EXPECT_EQ(normalized[i], points[i].Normalize()) << points[i];
+  }
+}
+
 TEST(S2, OriginTest) {
   // To minimize the number of expensive Sign() calculations,
   // S2::Origin() should not be nearly collinear with any commonly used edges.
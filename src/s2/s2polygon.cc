@@ -26,6 +26,7 @@
 #include <queue>
 #include <stack>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -39,6 +40,7 @@
 
 #include "s2/base/casts.h"
 #include "s2/base/commandlineflags.h"
+#include "s2/base/executor.h"
 #include "s2/base/types.h"
 #include "s2/mutable_s2shape_index.h"
 #include "s2/r1interval.h"
@@ -64,6 +66,7 @@
 #include "s2/s2coords.h"
 #include "s2/s2debug.h"
 #include "s2/s2edge_crossings.h"
+#include "s2/s2edge_distances.h"
 #include "s2/s2error.h"
 #include "s2/s2latlng_rect.h"
 #include "s2/s2latlng_rect_bounder.h"
@@ -79,6 +82,7 @@
 #include "s2/s2shape_index.h"
 #include "s2/s2shape_index_region.h"
 #include "s2/s2shapeutil_visit_crossing_edge_pairs.h"
+#include "s2/s2tuning.h"
 #include "s2/util/coding/coder.h"
 
 using absl::flat_hash_set;
@@ -139,6 +143,8 @@ S2Polygon::S2Polygon(S2Polygon&& b)
       // NOLINTBEGIN(bugprone-use-after-move)
       loops_(std::move(b.loops_)),
       s2debug_override_(std::move(b.s2debug_override_)),
+      indexing_mode_(b.indexing_mode_),
+      nesting_algorithm_(b.nesting_algorithm_),
       error_inconsistent_loop_orientations_(
           std::exchange(b.error_inconsistent_loop_orientations_, 0)),
       num_vertices_(std::exchange(b.num_vertices_, 0)),
@@ -163,6 +169,8 @@ S2Polygon& S2Polygon::operator=(S2Polygon&& b) {
   S2Region::operator=(static_cast<S2Region&&>(b));
   loops_ = std::move(b.loops_);
   s2debug_override_ = std::move(b.s2debug_override_);
+  indexing_mode_ = b.indexing_mode_;
+  nesting_algorithm_ = b.nesting_algorithm_;
   error_inconsistent_loop_orientations_ =
       std::exchange(b.error_inconsistent_loop_orientations_, 0);
   num_vertices_ = std::exchange(b.num_vertices_, 0);
@@ -191,12 +199,23 @@ S2Debug S2Polygon::s2debug_override() const {
   return s2debug_override_;
 }
 
+void S2Polygon::set_indexing_mode(S2IndexingMode mode) {
+  indexing_mode_ = mode;
+  if (index_.num_shape_ids() > 0 || num_loops() > 0) {
+    // The polygon has already been initialized.
+    ClearIndex();
+    AddToIndex();
+  }
+}
+
 void S2Polygon::Copy(const S2Polygon& src) {
   ClearLoops();
   for (int i = 0; i < src.num_loops(); ++i) {
     loops_.emplace_back(src.loop(i)->Clone());
   }
   s2debug_override_ = src.s2debug_override_;
+  indexing_mode_ = src.indexing_mode_;
+  nesting_algorithm_ = src.nesting_algorithm_;
   // Don't copy error_inconsistent_loop_orientations_, since this is not a
   // property of the polygon but only of the way the polygon was constructed.
   num_vertices_ = src.num_vertices();
@@ -243,23 +262,58 @@ bool S2Polygon::IsValid() const {
 }
 
 bool S2Polygon::FindValidationError(S2Error* error) const {
-  for (int i = 0; i < num_loops(); ++i) {
-    // Check for loop errors that don't require building an S2ShapeIndex.
-    if (loop(i)->FindValidationErrorNoIndex(error)) {
-      error->Init(error->code(), "Loop %d: %s", i, error->text());
-      return true;
+  return FindValidationError(1, error);
+}
+
+// Calls "fn(i, error)" for each i in [0, n) using up to "num_threads" threads,
+// where "fn" returns true if it found an error.  If any call returned true,
+// sets "error" to the error for the smallest such "i" and returns true.
+// Calls for larger values of "i" may be skipped once an error is found.
+template <class Fn>
+static bool FindFirstError(int n, int num_threads, const Fn& fn,
+                           S2Error* error) {
+  if (num_threads <= 1 || n <= 1) {
+    for (int i = 0; i < n; ++i) {
+      if (fn(i, error)) return true;
     }
-    // Check that the full loop only appears in the full polygon.
-    if (loop(i)->is_full() && num_loops() > 1) {
-      error->Init(S2Error::POLYGON_EXCESS_FULL_LOOP,
-                  "Loop %d: full loop appears in non-full polygon", i);
-      return true;
+    return false;
+  }
+  vector<S2Error> errors(n);
+  std::atomic<int> next(0), first_error(n);
+  auto run = [&]() {
+    for (int i; (i = next.fetch_add(1)) < n; ) {
+      if (first_error.load(std::memory_order_relaxed) < i) return;
+      if (fn(i, &errors[i])) {
+        int prev = first_error.load();
+        while (i < prev && !first_error.compare_exchange_weak(prev, i)) {
+        }
+      }
     }
+  };
+  vector<std::thread> threads;
+  for (int i = 1; i < std::min(num_threads, n); ++i) {
+    threads.emplace_back(run);
+  }
+  run();
+  for (auto& thread : threads) thread.join();
+  if (first_error.load() == n) return false;
+  *error = errors[first_error.load()];
+  return true;
+}
+
+bool S2Polygon::FindValidationError(int num_threads, S2Error* error) const {
+  if (FindFirstError(num_loops(), num_threads,
+                     [this](int i, S2Error* e) { return FindLoopError(i, e); },
+                     error)) {
+    return true;
   }
 
   // Check for loop self-intersections and loop pairs that cross
   // (including duplicate edges and vertices).
-  if (s2shapeutil::FindSelfIntersection(index_, error)) return true;
+  MutableS2ShapeIndex tmp;
+  if (s2shapeutil::FindSelfIntersection(GetIndex(&tmp), num_threads, error)) {
+    return true;
+  }
 
   // Check whether InitOriented detected inconsistent loop orientations.
   if (error_inconsistent_loop_orientations_) {
@@ -269,10 +323,25 @@ bool S2Polygon::FindValidationError(S2Error* error) const {
   }
 
   // Finally, verify the loop nesting hierarchy.
-  return FindLoopNestingError(error);
+  return FindLoopNestingError(num_threads, error);
 }
 
-bool S2Polygon::FindLoopNestingError(S2Error* error) const {
+bool S2Polygon::FindLoopError(int i, S2Error* error) const {
+  // Check for loop errors that don't require building an S2ShapeIndex.
+  if (loop(i)->FindValidationErrorNoIndex(error)) {
+    error->Init(error->code(), "Loop %d: %s", i, error->text());
+    return true;
+  }
+  // Check that the full loop only appears in the full polygon.
+  if (loop(i)->is_full() && num_loops() > 1) {
+    error->Init(S2Error::POLYGON_EXCESS_FULL_LOOP,
+                "Loop %d: full loop appears in non-full polygon", i);
+    return true;
+  }
+  return false;
+}
+
+bool S2Polygon::FindLoopNestingError(int num_threads, S2Error* error) const {
   // First check that the loop depths make sense.
   for (int last_depth = -1, i = 0; i < num_loops(); ++i) {
     int depth = loop(i)->depth();
@@ -285,18 +354,23 @@ bool S2Polygon::FindLoopNestingError(S2Error* error) const {
   }
   // Then check that they correspond to the actual loop nesting.  This test
   // is quadratic in the number of loops but the cost per iteration is small.
-  for (int i = 0; i < num_loops(); ++i) {
-    int last = GetLastDescendant(i);
-    for (int j = 0; j < num_loops(); ++j) {
-      if (i == j) continue;
-      bool nested = (j >= i + 1) && (j <= last);
-      const bool reverse_b = false;
-      if (loop(i)->ContainsNonCrossingBoundary(*loop(j), reverse_b) != nested) {
-        error->Init(S2Error::POLYGON_INVALID_LOOP_NESTING,
-                    "Invalid nesting: loop %d should %scontain loop %d",
-                    i, nested ? "" : "not ", j);
-        return true;
-      }
+  return FindFirstError(
+      num_loops(), num_threads,
+      [this](int i, S2Error* e) { return FindLoopContainmentError(i, e); },
+      error);
+}
+
+bool S2Polygon::FindLoopContainmentError(int i, S2Error* error) const {
+  int last = GetLastDescendant(i);
+  for (int j = 0; j < num_loops(); ++j) {
+    if (i == j) continue;
+    bool nested = (j >= i + 1) && (j <= last);
+    const bool reverse_b = false;
+    if (loop(i)->ContainsNonCrossingBoundary(*loop(j), reverse_b) != nested) {
+      error->Init(S2Error::POLYGON_INVALID_LOOP_NESTING,
+                  "Invalid nesting: loop %d should %scontain loop %d",
+                  i, nested ? "" : "not ", j);
+      return true;
     }
   }
   return false;
@@ -338,6 +412,44 @@ void S2Polygon::InsertLoop(S2Loop* new_loop, S2Loop* parent,
   children->push_back(new_loop);
 }
 
+void S2Polygon::InsertLoopsIndexed(LoopMap* loop_map) {
+  // Since the loops do not cross or share edges, a point on the boundary of
+  // loop L is contained by exactly the loops that contain L.  (The loop L
+  // itself may or may not contain the point, so it is skipped.)  The parent
+  // of L is the deepest such loop.
+  MutableS2ShapeIndex index;
+  for (const auto& loop : loops_) {
+    index.Add(make_unique<S2Loop::Shape>(loop.get()));
+  }
+  auto query = MakeS2ContainsPointQuery(&index);
+  vector<vector<int>> containers(num_loops());
+  for (int i = 0; i < num_loops(); ++i) {
+    const S2Loop& l = *loop(i);
+    S2Point p = S2::Interpolate(l.vertex(0), l.vertex(1), 0.5);
+    query.VisitContainingShapeIds(p, [&](int shape_id) {
+      if (shape_id != i) containers[i].push_back(shape_id);
+      return true;
+    });
+  }
+  // Every loop needs an entry, and the children of each loop are added in
+  // input order (which matches the order produced by InsertLoop).
+  for (int i = 0; i < num_loops(); ++i) {
+    (*loop_map)[loop(i)];
+  }
+  for (int i = 0; i < num_loops(); ++i) {
+    S2Loop* parent = nullptr;
+    int parent_depth = -1;
+    for (int j : containers[i]) {
+      const int depth = containers[j].size();
+      if (depth > parent_depth) {
+        parent = loop(j);
+        parent_depth = depth;
+      }
+    }
+    (*loop_map)[parent].push_back(loop(i));
+  }
+}
+
 void S2Polygon::InitLoops(LoopMap* loop_map) {
   std::stack<S2Loop*> loop_stack({nullptr});
   int depth = -1;
@@ -360,16 +472,37 @@ void S2Polygon::InitLoops(LoopMap* loop_map) {
 
 void S2Polygon::InitIndex() {
   ABSL_DCHECK_EQ(0, index_.num_shape_ids());
-  index_.Add(make_unique<Shape>(this));
-  if (!absl::GetFlag(FLAGS_s2polygon_lazy_indexing)) {
-    index_.ForceBuild();
-  }
+  AddToIndex();
   if (absl::GetFlag(FLAGS_s2debug) && s2debug_override_ == S2Debug::ALLOW) {
     // Note that FLAGS_s2debug is false in optimized builds (by default).
     ABSL_CHECK(IsValid());
   }
 }
 
+void S2Polygon::AddToIndex() {
+  if (indexing_mode_ == S2IndexingMode::NONE) {
+    for (const auto& loop : loops_) {
+      if (loop->indexing_mode() != S2IndexingMode::NONE) {
+        loop->set_indexing_mode(S2IndexingMode::NONE);
+      }
+    }
+    return;
+  }
+  index_.Add(make_unique<Shape>(this));
+  if (indexing_mode_ == S2IndexingMode::EAGER ||
+      (indexing_mode_ == S2IndexingMode::DEFAULT &&
+       !absl::GetFlag(FLAGS_s2polygon_lazy_indexing))) {
+    index_.ForceBuild();
+  }
+}
+
+const MutableS2ShapeIndex& S2Polygon::GetIndex(
+    MutableS2ShapeIndex* tmp) const {
+  if (indexing_mode_ != S2IndexingMode::NONE) return index_;
+  tmp->Add(make_unique<Shape>(this));
+  return *tmp;
+}
+
 void S2Polygon::ClearIndex() {
   unindexed_contains_calls_.store(0, std::memory_order_relaxed);
   index_.Clear();
@@ -395,8 +528,12 @@ void S2Polygon::InitNested(vector<unique_ptr<S2Loop>> loops) {
     return;
   }
   LoopMap loop_map;
-  for (int i = 0; i < num_loops(); ++i) {
-    InsertLoop(loop(i), nullptr, &loop_map);
+  if (nesting_algorithm_ == NestingAlgorithm::INDEXED) {
+    InsertLoopsIndexed(&loop_map);
+  } else {
+    for (int i = 0; i < num_loops(); ++i) {
+      InsertLoop(loop(i), nullptr, &loop_map);
+    }
   }
   // Reorder the loops in depth-first traversal order.
   // Loops are now owned by loop_map, don't let them be
@@ -600,7 +737,8 @@ S1Angle S2Polygon::GetDistanceToBoundary(const S2Point& x) const {
   S2ClosestEdgeQuery::Options options;
   options.set_include_interiors(false);
   S2ClosestEdgeQuery::PointTarget t(x);
-  return S2ClosestEdgeQuery(&index_, options).GetDistance(&t).ToAngle();
+  MutableS2ShapeIndex tmp;
+  return S2ClosestEdgeQuery(&GetIndex(&tmp), options).GetDistance(&t).ToAngle();
 }
 
 /*static*/ pair<double, double> S2Polygon::GetOverlapFractions(
@@ -623,7 +761,8 @@ S2Point S2Polygon::Project(const S2Point& x) const {
 S2Point S2Polygon::ProjectToBoundary(const S2Point& x) const {
   S2ClosestEdgeQuery::Options options;
   options.set_include_interiors(false);
-  S2ClosestEdgeQuery q(&index_, options);
+  MutableS2ShapeIndex tmp;
+  S2ClosestEdgeQuery q(&GetIndex(&tmp), options);
   S2ClosestEdgeQuery::PointTarget target(x);
   S2ClosestEdgeQuery::Result edge = q.FindClosestEdge(&target);
   return q.Project(x, edge);
@@ -654,7 +793,8 @@ bool S2Polygon::Contains(const S2Polygon& b) const {
   // distinguish between the full and empty polygons).
   if (is_empty() && b.is_full()) return false;
 
-  return S2BooleanOperation::Contains(index_, b.index_);
+  MutableS2ShapeIndex a_tmp, b_tmp;
+  return S2BooleanOperation::Contains(GetIndex(&a_tmp), b.GetIndex(&b_tmp));
 }
 
 bool S2Polygon::Intersects(const S2Polygon& b) const {
@@ -666,7 +806,8 @@ bool S2Polygon::Intersects(const S2Polygon& b) const {
   // distinguish between the full and empty polygons).
   if (is_full() && b.is_full()) return true;
 
-  return S2BooleanOperation::Intersects(index_, b.index_);
+  MutableS2ShapeIndex a_tmp, b_tmp;
+  return S2BooleanOperation::Intersects(GetIndex(&a_tmp), b.GetIndex(&b_tmp));
 }
 
 S2Cap S2Polygon::GetCapBound() const {
@@ -674,10 +815,19 @@ S2Cap S2Polygon::GetCapBound() const {
 }
 
 void S2Polygon::GetCellUnionBound(vector<S2CellId> *cell_ids) const {
-  return MakeS2ShapeIndexRegion(&index_).GetCellUnionBound(cell_ids);
+  MutableS2ShapeIndex tmp;
+  return MakeS2ShapeIndexRegion(&GetIndex(&tmp)).GetCellUnionBound(cell_ids);
 }
 
 bool S2Polygon::Contains(const S2Cell& target) const {
+  if (indexing_mode_ == S2IndexingMode::NONE) {
+    // Use brute force rather than building an index for every cell.
+    if (is_full()) return true;
+    for (const auto& loop : loops_) {
+      if (loop->BoundaryApproxIntersects(target)) return false;
+    }
+    return Contains(target.GetCenter());
+  }
   return MakeS2ShapeIndexRegion(&index_).Contains(target);
 }
 
@@ -706,23 +856,42 @@ bool S2Polygon::ApproxEquals(const S2Polygon& b, S1Angle tolerance) const {
 }
 
 bool S2Polygon::MayIntersect(const S2Cell& target) const {
+  if (indexing_mode_ == S2IndexingMode::NONE) {
+    if (is_full()) return true;
+    if (!bound_.Intersects(target.GetRectBound())) return false;
+    for (const auto& loop : loops_) {
+      if (loop->BoundaryApproxIntersects(target)) return true;
+    }
+    return Contains(target.GetCenter());
+  }
   return MakeS2ShapeIndexRegion(&index_).MayIntersect(target);
 }
 
+void S2Polygon::GetChildRelations(const S2Cell children[4],
+                                  bool check_contains,
+                                  CellRelation relations[4]) const {
+  if (indexing_mode_ == S2IndexingMode::NONE) {
+    S2Region::GetChildRelations(children, check_contains, relations);
+  } else {
+    MakeS2ShapeIndexRegion(&index_).GetChildRelations(
+        children, check_contains, relations);
+  }
+}
+
 bool S2Polygon::Contains(const S2Point& p) const {
   // NOTE(ericv): A bounds check slows down this function by about 50%.  It is
   // worthwhile only when it might allow us to delay building the index.
-  if (!index_.is_fresh() && !bound_.Contains(p)) return false;
+  const bool unindexed = indexing_mode_ == S2IndexingMode::NONE;
+  if ((unindexed || !index_.is_fresh()) && !bound_.Contains(p)) return false;
 
   // For small polygons it is faster to just check all the crossings.
   // Otherwise we keep track of the number of calls to Contains() and only
   // build the index once enough calls have been made so that we think it is
   // worth the effort.  See S2Loop::Contains(S2Point) for detailed comments.
-  static const int kMaxBruteForceVertices = 32;
-  static const int kMaxUnindexedContainsCalls = 20;
-  if (num_vertices() <= kMaxBruteForceVertices ||
-      (!index_.is_fresh() &&
-       ++unindexed_contains_calls_ != kMaxUnindexedContainsCalls)) {
+  if (unindexed ||
+      num_vertices() <= s2tuning::max_brute_force_contains_vertices() ||
+      (!index_.is_fresh() && ++unindexed_contains_calls_ !=
+                                 s2tuning::max_unindexed_contains_calls())) {
     bool inside = false;
     for (int i = 0; i < num_loops(); ++i) {
       // Use brute force to avoid building the loop's S2ShapeIndex.
@@ -736,22 +905,23 @@ bool S2Polygon::Contains(const S2Point& p) const {
 
 void S2Polygon::Encode(Encoder* const encoder,
                        s2coding::CodingHint hint) const {
+  Encode(encoder, hint, 1);
+}
+
+void S2Polygon::Encode(Encoder* const encoder, s2coding::CodingHint hint,
+                       int num_threads) const {
   if (hint == s2coding::CodingHint::FAST) {
     EncodeUncompressed(encoder);
     return;
   }
 
   if (num_vertices_ == 0) {
-    EncodeCompressed(encoder, nullptr, S2::kMaxCellLevel);
+    EncodeCompressed(encoder, nullptr, S2::kMaxCellLevel, 1);
     return;
   }
   // Converts all the polygon vertices to S2XYZFaceSiTi format.
   absl::FixedArray<S2XYZFaceSiTi> all_vertices(num_vertices_);
-  S2XYZFaceSiTi* current_loop_vertices = all_vertices.data();
-  for (const unique_ptr<S2Loop>& loop : loops_) {
-    loop->GetXYZFaceSiTiVertices(current_loop_vertices);
-    current_loop_vertices += loop->num_vertices();
-  }
+  GetXYZFaceSiTiVertices(all_vertices.data(), num_threads);
   // Computes a histogram of the cell levels at which the vertices are snapped.
   // cell_level is -1 for unsnapped, or 0 through kMaxCellLevel if snapped,
   // so we add one to it to get a non-negative index.  (histogram[0] is the
@@ -784,12 +954,59 @@ void S2Polygon::Encode(Encoder* const encoder,
   int compressed_size = 4 * num_vertices_ + exact_point_size * num_unsnapped;
   int lossless_size = sizeof(S2Point) * num_vertices_;
   if (compressed_size < lossless_size) {
-    EncodeCompressed(encoder, all_vertices.data(), snap_level);
+    EncodeCompressed(encoder, all_vertices.data(), snap_level, num_threads);
   } else {
     EncodeUncompressed(encoder);
   }
 }
 
+void S2Polygon::EncodeWithSnapLevel(Encoder* encoder, int snap_level,
+                                    int num_threads) const {
+  ABSL_DCHECK_GE(snap_level, 0);
+  ABSL_DCHECK_LE(snap_level, S2::kMaxCellLevel);
+  absl::FixedArray<S2XYZFaceSiTi> all_vertices(num_vertices_);
+  GetXYZFaceSiTiVertices(all_vertices.data(), num_threads);
+  EncodeCompressed(encoder, all_vertices.data(), snap_level, num_threads);
+}
+
+// Polygons with at most this many vertices are encoded using a single
+// thread, and larger ones are converted to S2XYZFaceSiTi format in chunks of
+// this many vertices.
+static constexpr int kEncodeChunkSize = 8192;
+
+void S2Polygon::GetXYZFaceSiTiVertices(S2XYZFaceSiTi* all_vertices,
+                                       int num_threads) const {
+  if (num_threads <= 1 || num_vertices_ <= kEncodeChunkSize) {
+    for (const unique_ptr<S2Loop>& loop : loops_) {
+      loop->GetXYZFaceSiTiVertices(all_vertices);
+      all_vertices += loop->num_vertices();
+    }
+    return;
+  }
+  // Chunks may span several loops, so that a single large loop is also
+  // divided among the threads.
+  vector<int> loop_starts(1, 0);
+  for (const unique_ptr<S2Loop>& loop : loops_) {
+    loop_starts.push_back(loop_starts.back() + loop->num_vertices());
+  }
+  const int num_chunks = (num_vertices_ - 1) / kEncodeChunkSize + 1;
+  std::atomic<int> next_chunk(0);
+  s2base::RunConcurrently(nullptr, num_threads, [&]() {
+    for (int c; (c = next_chunk.fetch_add(1)) < num_chunks; ) {
+      const int begin = c * kEncodeChunkSize;
+      const int end = std::min(begin + kEncodeChunkSize, num_vertices_);
+      int i = std::upper_bound(loop_starts.begin(), loop_starts.end(), begin) -
+              loop_starts.begin() - 1;
+      for (int k = begin; k < end; ++k) {
+        while (k >= loop_starts[i + 1]) ++i;
+        S2XYZFaceSiTi& v = all_vertices[k];
+        v.xyz = loops_[i]->vertex(k - loop_starts[i]);
+        v.cell_level = S2::XYZtoFaceSiTi(v.xyz, &v.face, &v.si, &v.ti);
+      }
+    }
+  });
+}
+
 void S2Polygon::EncodeUncompressed(Encoder* const encoder) const {
   encoder->Ensure(10);  // Sufficient
   encoder->put8(kCurrentUncompressedEncodingVersionNumber);
@@ -947,7 +1164,8 @@ bool S2Polygon::InitToOperation(S2BooleanOperation::OpType op_type,
   options.set_snap_function(snap_function);
   S2BooleanOperation op(op_type, make_unique<S2PolygonLayer>(this),
                          options);
-  return op.Build(a.index_, b.index_, error);
+  MutableS2ShapeIndex a_tmp, b_tmp;
+  return op.Build(a.GetIndex(&a_tmp), b.GetIndex(&b_tmp), error);
 }
 
 void S2Polygon::InitToOperation(S2BooleanOperation::OpType op_type,
@@ -1242,7 +1460,8 @@ vector<unique_ptr<S2Polyline>> S2Polygon::OperationWithPolyline(
   MutableS2ShapeIndex a_index;
   a_index.Add(make_unique<S2Polyline::Shape>(&a));
   S2Error error;
-  if (!op.Build(a_index, index_, &error)) {
+  MutableS2ShapeIndex tmp;
+  if (!op.Build(a_index, GetIndex(&tmp), &error)) {
     ABSL_LOG(ERROR) << "Polyline "
                      << S2BooleanOperation::OpTypeToString(op_type)
                      << " operation failed: " << error;
@@ -1361,6 +1580,31 @@ unique_ptr<S2Polygon> S2Polygon::DestructiveUnion(
   return std::move(*queue.top());
 }
 
+unique_ptr<S2Polygon> S2Polygon::DestructiveUnion(
+    vector<unique_ptr<S2Polygon>> polygons,
+    const S2Builder::SnapFunction& snap_function, int num_threads) {
+  vector<const S2ShapeIndex*> regions;
+  regions.reserve(polygons.size());
+  for (const auto& polygon : polygons) {
+    // The polygons are owned by this function, so they can be indexed.
+    if (polygon->indexing_mode() == S2IndexingMode::NONE) {
+      polygon->set_indexing_mode(S2IndexingMode::LAZY);
+    }
+    regions.push_back(&polygon->index());
+  }
+  S2BooleanOperation::Options options;
+  options.set_snap_function(snap_function);
+  auto result = make_unique<S2Polygon>();
+  vector<unique_ptr<S2Builder::Layer>> layers;
+  layers.push_back(make_unique<S2PolygonLayer>(result.get()));
+  S2Error error;
+  if (!S2BooleanOperation::UnionAll(regions, std::move(layers), &error,
+                                    options, num_threads)) {
+    ABSL_LOG(ERROR) << "DestructiveUnion operation failed: " << error;
+  }
+  return result;
+}
+
 void S2Polygon::InitToCellUnionBorder(const S2CellUnion& cells) {
   // We use S2Builder to compute the union.  Due to rounding errors, we can't
   // compute an exact union - when a small cell is adjacent to a larger cell,
@@ -1496,7 +1740,7 @@ bool S2Polygon::BoundaryNear(const S2Polygon& b, S1Angle max_error) const {
 
 void S2Polygon::EncodeCompressed(Encoder* encoder,
                                  const S2XYZFaceSiTi* all_vertices,
-                                 int snap_level) const {
+                                 int snap_level, int num_threads) const {
   ABSL_CHECK_GE(snap_level, 0);
   // Sufficient for what we write. Typically enough for a 4 vertex polygon.
   encoder->Ensure(40);
@@ -1504,10 +1748,32 @@ void S2Polygon::EncodeCompressed(Encoder* encoder,
   encoder->put8(snap_level);
   encoder->put_varint32(num_loops());
   ABSL_DCHECK_GE(encoder->avail(), 0);
-  const S2XYZFaceSiTi* current_loop_vertices = all_vertices;
-  for (int i = 0; i < num_loops(); ++i) {
-    loops_[i]->EncodeCompressed(encoder, current_loop_vertices, snap_level);
-    current_loop_vertices += loops_[i]->num_vertices();
+  if (num_threads <= 1 || num_loops() <= 1 ||
+      num_vertices_ <= kEncodeChunkSize) {
+    const S2XYZFaceSiTi* current_loop_vertices = all_vertices;
+    for (int i = 0; i < num_loops(); ++i) {
+      loops_[i]->EncodeCompressed(encoder, current_loop_vertices, snap_level);
+      current_loop_vertices += loops_[i]->num_vertices();
+    }
+  } else {
+    // Encode the loops concurrently into separate buffers, then concatenate.
+    vector<const S2XYZFaceSiTi*> loop_vertices;
+    for (int i = 0; i < num_loops(); ++i) {
+      loop_vertices.push_back(all_vertices);
+      all_vertices += loops_[i]->num_vertices();
+    }
+    vector<Encoder> loop_encoders(num_loops());
+    std::atomic<int> next_loop(0);
+    s2base::RunConcurrently(nullptr, num_threads, [&]() {
+      for (int i; (i = next_loop.fetch_add(1)) < num_loops(); ) {
+        loops_[i]->EncodeCompressed(&loop_encoders[i], loop_vertices[i],
+                                    snap_level);
+      }
+    });
+    for (const Encoder& loop_encoder : loop_encoders) {
+      encoder->Ensure(loop_encoder.length());
+      encoder->putn(loop_encoder.base(), loop_encoder.length());
+    }
   }
   // Do not write the bound or num_vertices as they can be cheaply recomputed
   // by DecodeCompressed.  Microbenchmarks show the speed difference is
@@ -1602,6 +1868,14 @@ S2Shape::Chain S2Polygon::Shape::chain(int i) const {
   }
 }
 
+S2PointSpan S2Polygon::Shape::chain_vertex_span(int i) const {
+  ABSL_DCHECK_LT(i, Shape::num_chains());
+  // Holes are stored in the opposite order to their S2Shape edges.
+  const S2Loop* loop = polygon_->loop(i);
+  if (loop->is_hole() || loop->is_empty_or_full()) return {};
+  return loop->vertices_span();
+}
+
 size_t S2Polygon::SpaceUsed() const {
   size_t size = sizeof(*this);
   for (int i = 0; i < num_loops(); ++i) {
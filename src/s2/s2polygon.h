@@ -41,9 +41,11 @@
 #include "s2/s2coder.h"
 #include "s2/s2debug.h"
 #include "s2/s2error.h"
+#include "s2/s2indexing_mode.h"
 #include "s2/s2latlng_rect.h"
 #include "s2/s2loop.h"
 #include "s2/s2point.h"
+#include "s2/s2point_span.h"
 #include "s2/s2polyline.h"
 #include "s2/s2region.h"
 #include "s2/s2shape.h"
@@ -221,6 +223,44 @@ class S2Polygon final : public S2Region {
   void set_s2debug_override(S2Debug override);
   S2Debug s2debug_override() const;
 
+  // Controls whether this polygon keeps an S2ShapeIndex to accelerate queries
+  // (see S2IndexingMode).  With S2IndexingMode::NONE the polygon's loops do
+  // not keep an index either, which saves memory for polygons that are only
+  // encoded or measured:
+  //
+  //   S2Polygon polygon;
+  //   polygon.set_indexing_mode(S2IndexingMode::NONE);
+  //   polygon.Decode(&decoder);
+  //
+  // If the polygon is already initialized, its index is discarded or
+  // recreated as necessary.  This setting is preserved across calls to Init()
+  // and Decode(), and is copied by Copy() and Clone().
+  void set_indexing_mode(S2IndexingMode mode);
+  S2IndexingMode indexing_mode() const { return indexing_mode_; }
+
+  // The algorithm used by InitNested() and InitOriented() to determine which
+  // loops contain which other loops.
+  enum class NestingAlgorithm : uint8 {
+    // Inserts the loops one at a time into a tree of loops, testing each new
+    // loop against the children of its ancestors.  This is fast for polygons
+    // with few loops but takes quadratic time when one loop has many
+    // children (e.g., a shell with thousands of holes).
+    PAIRWISE,
+
+    // Builds a temporary S2ShapeIndex of all the loops and finds the loops
+    // that contain each loop using a point containment query.  This takes
+    // O(n log n) time for typical inputs, but has a higher fixed cost.
+    INDEXED,
+  };
+
+  // Sets the algorithm used to determine the loop nesting hierarchy.  Both
+  // algorithms yield exactly the same loop order.  This setting is preserved
+  // across calls to Init(), and is copied by Copy() and Clone().
+  void set_nesting_algorithm(NestingAlgorithm algorithm) {
+    nesting_algorithm_ = algorithm;
+  }
+  NestingAlgorithm nesting_algorithm() const { return nesting_algorithm_; }
+
   // Returns true if this is a valid polygon (including checking whether all
   // the loops are themselves valid).  Note that validity is checked
   // automatically during initialization when --s2debug is enabled (true by
@@ -236,6 +276,12 @@ class S2Polygon final : public S2Region {
   // REQUIRES: error != nullptr
   bool FindValidationError(S2Error* error) const;
 
+  // Like FindValidationError(), but uses up to "num_threads" threads.  The
+  // loops, the index cells (to find self-intersections), and the loop nesting
+  // hierarchy are each checked concurrently.  The error reported is the same
+  // one that the single-threaded version reports.
+  bool FindValidationError(int num_threads, S2Error* error) const;
+
   // Return true if this is the empty polygon (consisting of no loops).
   bool is_empty() const { return loops_.empty(); }
 
@@ -585,6 +631,14 @@ class S2Polygon final : public S2Region {
   static std::unique_ptr<S2Polygon> DestructiveUnion(
       std::vector<std::unique_ptr<S2Polygon> > polygons,
       const S2Builder::SnapFunction& snap_function);
+
+  // Like the function above, except that the polygons are grouped spatially
+  // and unioned in a balanced reduction tree using up to "num_threads"
+  // threads (see S2BooleanOperation::UnionAll).  This is much faster when
+  // there are many polygons, even when num_threads == 1.
+  static std::unique_ptr<S2Polygon> DestructiveUnion(
+      std::vector<std::unique_ptr<S2Polygon> > polygons,
+      const S2Builder::SnapFunction& snap_function, int num_threads);
 #endif  // !defined(SWIG)
 
   // Initialize this polygon to the outline of the given cell union.
@@ -671,6 +725,8 @@ class S2Polygon final : public S2Region {
 
   bool Contains(const S2Cell& cell) const override;
   bool MayIntersect(const S2Cell& cell) const override;
+  void GetChildRelations(const S2Cell children[4], bool check_contains,
+                         CellRelation relations[4]) const override;
 
   // The point 'p' does not need to be normalized.
   bool Contains(const S2Point& p) const override;
@@ -694,6 +750,23 @@ class S2Polygon final : public S2Region {
   void Encode(Encoder* const encoder,
               s2coding::CodingHint hint = s2coding::CodingHint::COMPACT) const;
 
+  // Like Encode(), but uses up to "num_threads" threads to convert large
+  // polygons to cell coordinates and to encode the loops of polygons with
+  // more than one loop.  The output does not depend on "num_threads".
+  void Encode(Encoder* encoder, s2coding::CodingHint hint,
+              int num_threads) const;
+
+  // Like Encode(), except that the compressed encoding is always used with
+  // the given snap level, rather than choosing the snap level and the
+  // encoding by examining the vertices.  This is useful when the snap level
+  // is already known, e.g. when the polygon was built using
+  // S2CellIdSnapFunction(snap_level).  Vertices that are not cell centers at
+  // this level are still encoded exactly (using 24 bytes each).
+  //
+  // REQUIRES: 0 <= snap_level <= S2::kMaxCellLevel
+  void EncodeWithSnapLevel(Encoder* encoder, int snap_level,
+                           int num_threads = 1) const;
+
   // Encodes the polygon's S2Points directly as three doubles using
   // (40 + 43 * num_loops + 24 * num_vertices) bytes.
   //
@@ -747,6 +820,7 @@ class S2Polygon final : public S2Region {
     Chain chain(int i) const final;
     Edge chain_edge(int i, int j) const final;
     ChainPosition chain_position(int e) const final;
+    S2PointSpan chain_vertex_span(int i) const final;
     TypeTag type_tag() const override { return kTypeTag; }
 
   void Encode(Encoder* encoder, s2coding::CodingHint hint) const override {
@@ -810,7 +884,8 @@ class S2Polygon final : public S2Region {
   //   S2ClosestEdgeQuery::ShapeIndexTarget target(&polygon2.index());
   //   S1ChordAngle distance = query.GetDistance(&target);
   //
-  // The index contains a single S2Polygon::Shape object.
+  // The index contains a single S2Polygon::Shape object, except that it is
+  // empty if indexing_mode() is S2IndexingMode::NONE.
   const MutableS2ShapeIndex& index() const { return index_; }
 
  private:
@@ -826,8 +901,16 @@ class S2Polygon final : public S2Region {
   // Deletes the contents of the loops_ vector and resets the polygon state.
   void ClearLoops();
 
+  // Return true if loop(i) is invalid, not counting errors that require its
+  // S2ShapeIndex.
+  bool FindLoopError(int i, S2Error* error) const;
+
   // Return true if there is an error in the loop nesting hierarchy.
-  bool FindLoopNestingError(S2Error* error) const;
+  bool FindLoopNestingError(int num_threads, S2Error* error) const;
+
+  // Return true if the nesting of loop(i) relative to the other loops does
+  // not match the loop depths.
+  bool FindLoopContainmentError(int i, S2Error* error) const;
 
   // A map from each loop to its immediate children with respect to nesting.
   // This map is built during initialization of multi-loop polygons to
@@ -835,6 +918,7 @@ class S2Polygon final : public S2Region {
   typedef absl::flat_hash_map<S2Loop*, std::vector<S2Loop*> > LoopMap;
 
   void InsertLoop(S2Loop* new_loop, S2Loop* parent, LoopMap* loop_map);
+  void InsertLoopsIndexed(LoopMap* loop_map);
   void InitLoops(LoopMap* loop_map);
 
   // Add the polygon's loops to the S2ShapeIndex.  (The actual work of
@@ -845,6 +929,14 @@ class S2Polygon final : public S2Region {
   // indexing structures need to be cleared since they become invalid.
   void ClearIndex();
 
+  // Adds this polygon to index_ (and builds the index) as determined by
+  // indexing_mode_.
+  void AddToIndex();
+
+  // Returns index_, or if this polygon does not have an index (i.e.,
+  // indexing_mode_ is NONE), adds the polygon to "tmp" and returns it.
+  const MutableS2ShapeIndex& GetIndex(MutableS2ShapeIndex* tmp) const;
+
   // Initializes the polygon to the result of the given boolean operation,
   // returning an error on failure.
   bool InitToOperation(S2BooleanOperation::OpType op_type,
@@ -879,7 +971,12 @@ class S2Polygon final : public S2Region {
   //
   // REQUIRES: snap_level >= 0.
   void EncodeCompressed(Encoder* encoder, const S2XYZFaceSiTi* all_vertices,
-                        int snap_level) const;
+                        int snap_level, int num_threads) const;
+
+  // Converts the vertices of all loops to the S2XYZFaceSiTi format (see
+  // S2Loop::GetXYZFaceSiTiVertices) using up to "num_threads" threads.
+  void GetXYZFaceSiTiVertices(S2XYZFaceSiTi* all_vertices,
+                              int num_threads) const;
 
   // Decode a polygon encoded with EncodeCompressed().
   bool DecodeCompressed(Decoder* decoder);
@@ -902,6 +999,8 @@ class S2Polygon final : public S2Region {
   // Allows overriding the automatic validity checking controlled by the
   // --s2debug flag.
   S2Debug s2debug_override_ = S2Debug::ALLOW;
+  S2IndexingMode indexing_mode_ = S2IndexingMode::DEFAULT;
+  NestingAlgorithm nesting_algorithm_ = NestingAlgorithm::PAIRWISE;
 
   // True if InitOriented() was called and the given loops had inconsistent
   // orientations (i.e., it is not possible to construct a polygon such that
@@ -931,7 +1030,8 @@ class S2Polygon final : public S2Region {
   // if A.Contains(B), then A.subregion_bound_.Contains(B.bound_).
   S2LatLngRect subregion_bound_;
 
-  // Spatial index containing this polygon.
+  // Spatial index containing this polygon.  It is empty if indexing_mode_ is
+  // NONE.
   MutableS2ShapeIndex index_;
 
 #ifndef SWIG
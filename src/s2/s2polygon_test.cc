@@ -66,6 +66,7 @@
 #include "s2/s2edge_distances.h"
 #include "s2/s2error.h"
 #include "s2/s2fractal.h"
+#include "s2/s2indexing_mode.h"
 #include "s2/s2latlng.h"
 #include "s2/s2latlng_rect.h"
 #include "s2/s2loop.h"
@@ -76,6 +77,7 @@
 #include "s2/s2polyline.h"
 #include "s2/s2region_coverer.h"
 #include "s2/s2shape.h"
+#include "s2/s2shapeutil_testing.h"
 #include "s2/s2testing.h"
 #include "s2/s2text_format.h"
 #include "s2/util/coding/coder.h"
@@ -633,6 +635,14 @@ static void TestDestructiveUnion(const S2Polygon& a, const S2Polygon& b) {
   unique_ptr<S2Polygon> c_destructive =
       S2Polygon::DestructiveUnion(std::move(polygons));
   CheckEqual(c, *c_destructive);
+
+  polygons.clear();
+  polygons.emplace_back(a.Clone());
+  polygons.emplace_back(b.Clone());
+  unique_ptr<S2Polygon> c_parallel = S2Polygon::DestructiveUnion(
+      std::move(polygons),
+      s2builderutil::IdentitySnapFunction(S2::kIntersectionMergeRadius), 2);
+  CheckEqual(c, *c_parallel);
 }
 
 static void TestRelationWithDesc(const S2Polygon& a, const S2Polygon& b,
@@ -1877,6 +1887,34 @@ TEST(S2Polygon, InitToCellUnionBorder) {
   }
 }
 
+TEST(S2Polygon, DestructiveUnionManyPolygons) {
+  // A grid of adjacent squares, whose union is a single square.
+  auto make_squares = []() {
+    vector<unique_ptr<S2Polygon>> squares;
+    for (int i = 0; i < 16; ++i) {
+      for (int j = 0; j < 16; ++j) {
+        squares.push_back(make_unique<S2Polygon>(make_unique<S2Loop>(
+            vector<S2Point>{S2LatLng::FromDegrees(i, j).ToPoint(),
+                            S2LatLng::FromDegrees(i, j + 1).ToPoint(),
+                            S2LatLng::FromDegrees(i + 1, j + 1).ToPoint(),
+                            S2LatLng::FromDegrees(i + 1, j).ToPoint()})));
+      }
+    }
+    return squares;
+  };
+  unique_ptr<S2Polygon> expected =
+      S2Polygon::DestructiveUnion(make_squares());
+  ASSERT_EQ(1, expected->num_loops());
+  for (int num_threads : {1, 4}) {
+    unique_ptr<S2Polygon> actual = S2Polygon::DestructiveUnion(
+        make_squares(),
+        s2builderutil::IdentitySnapFunction(S2::kIntersectionMergeRadius),
+        num_threads);
+    EXPECT_TRUE(actual->BoundaryEquals(*expected))
+        << "num_threads=" << num_threads;
+  }
+}
+
 TEST(S2Polygon, UnionWithAmbgiuousCrossings) {
   vector<S2Point> a_vertices = {
     S2Point(0.044856812877680216, -0.80679210859571904, 0.5891301722422051),
@@ -2168,6 +2206,57 @@ TEST_F(S2PolygonTestBase, CompressedEncodedPolygonDecodesApproxEqual) {
   EXPECT_EQ(1, decoded_polygon.loop(1)->depth());
 }
 
+// Returns a polygon with "num_loops" disjoint loops whose vertices are
+// snapped to the centers of cells at "snap_level".
+static unique_ptr<S2Polygon> MakeSnappedPolygon(int num_loops,
+                                                int num_vertices_per_loop,
+                                                int snap_level) {
+  vector<unique_ptr<S2Loop>> loops;
+  for (int i = 0; i < num_loops; ++i) {
+    S2Point center = S2LatLng::FromDegrees(0, 3 * i).ToPoint();
+    vector<S2Point> vertices = S2Testing::MakeRegularPoints(
+        center, S1Angle::Degrees(1), num_vertices_per_loop);
+    for (S2Point& v : vertices) v = S2CellId(v).parent(snap_level).ToPoint();
+    loops.push_back(make_unique<S2Loop>(vertices));
+  }
+  return make_unique<S2Polygon>(std::move(loops));
+}
+
+TEST(S2Polygon, EncodeNumThreadsDoesNotChangeOutput) {
+  // Both a single large loop and many smaller loops are divided among the
+  // threads.
+  for (int num_loops : {1, 10}) {
+    unique_ptr<S2Polygon> polygon =
+        MakeSnappedPolygon(num_loops, 20000 / num_loops, 20);
+    Encoder expected, actual;
+    polygon->Encode(&expected);
+    polygon->Encode(&actual, s2coding::CodingHint::COMPACT, 4);
+    EXPECT_EQ(string_view(expected.base(), expected.length()),
+              string_view(actual.base(), actual.length()));
+  }
+}
+
+TEST(S2Polygon, EncodeWithSnapLevel) {
+  unique_ptr<S2Polygon> polygon = MakeSnappedPolygon(3, 100, 20);
+  Encoder expected;
+  polygon->Encode(&expected);
+  for (int num_threads : {1, 4}) {
+    // Using the actual snap level yields the same encoding as Encode().
+    Encoder encoder;
+    polygon->EncodeWithSnapLevel(&encoder, 20, num_threads);
+    EXPECT_EQ(string_view(expected.base(), expected.length()),
+              string_view(encoder.base(), encoder.length()));
+
+    // Otherwise the vertices are encoded exactly.
+    Encoder exact_encoder;
+    polygon->EncodeWithSnapLevel(&exact_encoder, 10, num_threads);
+    Decoder decoder(exact_encoder.base(), exact_encoder.length());
+    S2Polygon decoded;
+    ASSERT_TRUE(decoded.Decode(&decoder));
+    EXPECT_TRUE(polygon->Equals(decoded));
+  }
+}
+
 // This test checks that S2Polygons created directly from S2Cells behave
 // identically to S2Polygons created from the vertices of those cells; this
 // previously was not the case, because S2Cells calculate their bounding
@@ -2367,11 +2456,18 @@ class IsValidTest : public testing::Test {
   }
 
   void CheckInvalid(absl::flat_hash_set<S2Error::Code> codes = {}) {
+    S2Polygon polygon = MakePolygon();
     S2Error error;
-    EXPECT_TRUE(MakePolygon().FindValidationError(&error));
+    EXPECT_TRUE(polygon.FindValidationError(&error));
     if (!codes.empty()) {
       EXPECT_THAT(codes, Contains(error.code()));
     }
+    // Parallel validation reports the same error.
+    S2Error parallel_error;
+    EXPECT_TRUE(polygon.FindValidationError(/*num_threads=*/4,
+                                            &parallel_error));
+    EXPECT_EQ(error.code(), parallel_error.code());
+    EXPECT_EQ(error.text(), parallel_error.text());
     Reset();
   }
 
@@ -2588,6 +2684,153 @@ TEST_F(IsValidTest, LoopNestingInvalid) {
   }
 }
 
+TEST(S2Polygon, IndexingModes) {
+  S2Testing::rnd.Reset(1);
+  const S2Point center = S2Testing::RandomPoint();
+  auto make_polygon = [&](S2IndexingMode mode) {
+    vector<unique_ptr<S2Loop>> loops;
+    loops.push_back(make_unique<S2Loop>(S2Testing::MakeRegularPoints(
+        center, S1Angle::Degrees(10), 1000)));
+    loops.push_back(make_unique<S2Loop>(S2Testing::MakeRegularPoints(
+        center, S1Angle::Degrees(5), 500)));
+    auto polygon = make_unique<S2Polygon>();
+    polygon->set_indexing_mode(mode);
+    polygon->InitNested(std::move(loops));
+    return polygon;
+  };
+  auto lazy = make_polygon(S2IndexingMode::LAZY);
+  auto eager = make_polygon(S2IndexingMode::EAGER);
+  auto unindexed = make_polygon(S2IndexingMode::NONE);
+  EXPECT_TRUE(eager->index().is_fresh());
+  EXPECT_EQ(0, unindexed->index().num_shape_ids());
+  EXPECT_EQ(S2IndexingMode::NONE, unindexed->loop(0)->indexing_mode());
+  EXPECT_LT(unindexed->SpaceUsed(), eager->SpaceUsed());
+  EXPECT_EQ(lazy->GetArea(), unindexed->GetArea());
+
+  const S2Cap cap(center, S1Angle::Degrees(15));
+  for (int i = 0; i < 1000; ++i) {
+    const S2Point p = S2Testing::SamplePoint(cap);
+    ASSERT_EQ(eager->Contains(p), unindexed->Contains(p));
+    const S2Cell cell(S2CellId(p).parent(S2Testing::rnd.Uniform(12)));
+    if (unindexed->Contains(cell)) {
+      ASSERT_TRUE(eager->Contains(cell.GetCenter()));
+    }
+    if (!unindexed->MayIntersect(cell)) {
+      ASSERT_FALSE(eager->Contains(cell.GetCenter()));
+    }
+  }
+  // Queries that need an index use a temporary one.
+  EXPECT_TRUE(unindexed->IsValid());
+  EXPECT_TRUE(unindexed->Equals(*eager));
+  EXPECT_TRUE(eager->Contains(*unindexed));
+  EXPECT_TRUE(unindexed->Intersects(*lazy));
+  S2Polygon difference;
+  difference.InitToDifference(*unindexed, *lazy);
+  EXPECT_TRUE(difference.is_empty());
+  EXPECT_EQ(0, unindexed->index().num_shape_ids());
+
+  // The mode survives encoding and copying.
+  Encoder encoder;
+  unindexed->Encode(&encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  S2Polygon decoded;
+  decoded.set_indexing_mode(S2IndexingMode::NONE);
+  ASSERT_TRUE(decoded.Decode(&decoder));
+  EXPECT_EQ(0, decoded.index().num_shape_ids());
+  EXPECT_TRUE(decoded.Equals(*eager));
+  unique_ptr<S2Polygon> copy(unindexed->Clone());
+  EXPECT_EQ(S2IndexingMode::NONE, copy->indexing_mode());
+
+  // Switching modes after initialization recreates the index.
+  unindexed->set_indexing_mode(S2IndexingMode::EAGER);
+  EXPECT_TRUE(unindexed->index().is_fresh());
+}
+
+TEST(S2Polygon, IndexedNestingMatchesPairwise) {
+  // A shell containing a grid of holes, some of which contain islands, with
+  // the loops given in random order.  "depths" is the expected depth of each
+  // loop.
+  vector<unique_ptr<S2Loop>> loops;
+  vector<int> depths;
+  loops.push_back(make_unique<S2Loop>(S2Testing::MakeRegularPoints(
+      S2LatLng::FromDegrees(0, 0).ToPoint(), S1Angle::Degrees(20), 100)));
+  depths.push_back(0);
+  for (int i = -10; i < 10; ++i) {
+    for (int j = -10; j < 10; ++j) {
+      const S2Point center = S2LatLng::FromDegrees(i + 0.5, j + 0.5).ToPoint();
+      loops.push_back(make_unique<S2Loop>(
+          S2Testing::MakeRegularPoints(center, S1Angle::Degrees(0.4), 8)));
+      depths.push_back(1);
+      if ((i + j) % 3 == 0) {
+        loops.push_back(make_unique<S2Loop>(
+            S2Testing::MakeRegularPoints(center, S1Angle::Degrees(0.2), 6)));
+        depths.push_back(2);
+      }
+    }
+  }
+  S2Testing::rnd.Reset(1);
+  for (int i = loops.size() - 1; i > 0; --i) {
+    const int j = S2Testing::rnd.Uniform(i + 1);
+    std::swap(loops[i], loops[j]);
+    std::swap(depths[i], depths[j]);
+  }
+  auto init = [&](S2Polygon::NestingAlgorithm algorithm, bool oriented) {
+    vector<unique_ptr<S2Loop>> copies;
+    for (int i = 0; i < loops.size(); ++i) {
+      copies.emplace_back(loops[i]->Clone());
+      if (oriented && depths[i] == 1) copies.back()->Invert();
+    }
+    auto polygon = make_unique<S2Polygon>();
+    polygon->set_nesting_algorithm(algorithm);
+    if (oriented) {
+      polygon->InitOriented(std::move(copies));
+    } else {
+      polygon->InitNested(std::move(copies));
+    }
+    return polygon;
+  };
+  for (bool oriented : {false, true}) {
+    auto pairwise = init(S2Polygon::NestingAlgorithm::PAIRWISE, oriented);
+    auto indexed = init(S2Polygon::NestingAlgorithm::INDEXED, oriented);
+    EXPECT_EQ(S2Polygon::NestingAlgorithm::INDEXED,
+              indexed->nesting_algorithm());
+    ASSERT_EQ(loops.size(), indexed->num_loops());
+    EXPECT_EQ(2, indexed->loop(2)->depth());
+    for (int i = 0; i < pairwise->num_loops(); ++i) {
+      EXPECT_TRUE(pairwise->loop(i)->Equals(*indexed->loop(i))) << i;
+      EXPECT_EQ(pairwise->loop(i)->depth(), indexed->loop(i)->depth()) << i;
+    }
+    EXPECT_TRUE(indexed->IsValid());
+  }
+}
+
+TEST(S2Polygon, ParallelValidationOfLargeLoops) {
+  S2Testing::rnd.Reset(1);
+  const S2Point center = S2Testing::RandomPoint();
+  vector<unique_ptr<S2Loop>> loops;
+  loops.push_back(make_unique<S2Loop>(S2Testing::MakeRegularPoints(
+      center, S1Angle::Degrees(10), 100000)));
+  loops.push_back(make_unique<S2Loop>(S2Testing::MakeRegularPoints(
+      center, S1Angle::Degrees(5), 50000)));
+  S2Polygon polygon(std::move(loops));
+  S2Error error;
+  EXPECT_FALSE(polygon.FindValidationError(/*num_threads=*/4, &error));
+
+  // Create self-intersections by swapping adjacent vertices in several
+  // places.  Both versions must report the same (first) error.
+  vector<S2Point> vertices =
+      S2Testing::MakeRegularPoints(center, S1Angle::Degrees(10), 100000);
+  for (int i : {7000, 31000, 64000, 90000}) {
+    std::swap(vertices[i], vertices[i + 1]);
+  }
+  S2Loop loop(vertices, S2Debug::DISABLE);
+  S2Error serial_error, parallel_error;
+  ASSERT_TRUE(loop.FindValidationError(&serial_error));
+  ASSERT_TRUE(loop.FindValidationError(/*num_threads=*/4, &parallel_error));
+  EXPECT_EQ(S2Error::LOOP_SELF_INTERSECTION, serial_error.code());
+  EXPECT_EQ(serial_error.text(), parallel_error.text());
+}
+
 TEST_F(IsValidTest, FuzzTest) {
   // Check that the S2Loop/S2Polygon constructors and IsValid() don't crash
   // when they receive arbitrary invalid input.  (We don't test large inputs;
@@ -3082,7 +3325,12 @@ void TestPolygonShape(const S2Polygon& polygon) {
       EXPECT_EQ(loop_i->oriented_vertex(j), edge.v0);
       EXPECT_EQ(loop_i->oriented_vertex(j+1), edge.v1);
     }
+    // Holes are stored with the opposite orientation to their edges, so
+    // their vertices are not available as a span.
+    EXPECT_EQ(loop_i->is_hole() ? 0 : loop_i->num_vertices(),
+              shape.chain_vertex_span(i).size());
   }
+  s2testing::ExpectChainVertexSpansValid(shape);
   EXPECT_EQ(2, shape.dimension());
   EXPECT_FALSE(shape.is_empty());
   EXPECT_FALSE(shape.is_full());
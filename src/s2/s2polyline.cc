@@ -36,8 +36,8 @@
 
 #include "s2/base/commandlineflags.h"
 #include "s2/base/types.h"
+#include "s2/mutable_s2shape_index.h"
 #include "s2/s1angle.h"
-#include "s2/s1interval.h"
 #include "s2/s2builder.h"
 #include "s2/s2builder_layer.h"
 #include "s2/s2builderutil_s2polyline_layer.h"
@@ -59,8 +59,10 @@
 #include "s2/s2polyline_measures.h"
 #include "s2/s2predicates.h"
 #include "s2/s2shape.h"
+#include "s2/s2shapeutil_shape_edge.h"
+#include "s2/s2shapeutil_subsample_chains.h"
+#include "s2/s2shapeutil_visit_crossing_edge_pairs.h"
 #include "s2/util/coding/coder.h"
-#include "s2/util/math/matrix3x3.h"
 
 using absl::flat_hash_set;
 using absl::Span;
@@ -74,6 +76,10 @@ using std::vector;
 static const unsigned char kCurrentLosslessEncodingVersionNumber = 1;
 static const unsigned char kCurrentCompressedEncodingVersionNumber = 2;
 
+// Intersects() tests every pair of edges directly when there are at most this
+// many pairs, and otherwise uses an S2ShapeIndex for each polyline.
+static const int64 kMaxBruteForceIntersectsEdgePairs = 1024;
+
 S2Polyline::S2Polyline()
   : s2debug_override_(S2Debug::ALLOW) {}
 
@@ -354,7 +360,17 @@ bool S2Polyline::Intersects(const S2Polyline& line) const {
     return false;
   }
 
-  // TODO(ericv): Use S2ShapeIndex here.
+  if (static_cast<int64>(num_vertices() - 1) * (line.num_vertices() - 1) >
+      kMaxBruteForceIntersectsEdgePairs) {
+    // Index both polylines so that only nearby edges are tested.
+    MutableS2ShapeIndex a_index, b_index;
+    a_index.Add(make_unique<Shape>(this));
+    b_index.Add(make_unique<Shape>(&line));
+    return !s2shapeutil::VisitCrossingEdgePairs(
+        a_index, b_index, s2shapeutil::CrossingType::ALL,
+        [](const s2shapeutil::ShapeEdge&, const s2shapeutil::ShapeEdge&,
+           bool) { return false; /*stop*/ });
+  }
   for (int i = 1; i < num_vertices(); ++i) {
     S2EdgeCrosser crosser(&vertex(i - 1), &vertex(i), &line.vertex(0));
     for (int j = 1; j < line.num_vertices(); ++j) {
@@ -374,9 +390,7 @@ void S2Polyline::Reverse() {
 
 S2LatLngRect S2Polyline::GetRectBound() const {
   S2LatLngRectBounder bounder;
-  for (int i = 0; i < num_vertices(); ++i) {
-    bounder.AddPoint(vertex(i));
-  }
+  bounder.AddPoints(vertices_span());
   return bounder.GetBound();
 }
 
@@ -552,103 +566,11 @@ bool S2Polyline::DecodeCompressed(Decoder* decoder) {
   return true;
 }
 
-namespace {
-
-// Given a polyline, a tolerance distance, and a start index, this function
-// returns the maximal end index such that the line segment between these two
-// vertices passes within "tolerance" of all interior vertices, in order.
-int FindEndVertex(const S2Polyline& polyline,
-                  S1Angle tolerance, int index) {
-  ABSL_DCHECK_GE(tolerance.radians(), 0);
-  ABSL_DCHECK_LT((index + 1), polyline.num_vertices());
-
-  // The basic idea is to keep track of the "pie wedge" of angles from the
-  // starting vertex such that a ray from the starting vertex at that angle
-  // will pass through the discs of radius "tolerance" centered around all
-  // vertices processed so far.
-
-  // First we define a "coordinate frame" for the tangent and normal spaces
-  // at the starting vertex.  Essentially this means picking three
-  // orthonormal vectors X,Y,Z such that X and Y span the tangent plane at
-  // the starting vertex, and Z is "up".  We use the coordinate frame to
-  // define a mapping from 3D direction vectors to a one-dimensional "ray
-  // angle" in the range (-Pi, Pi].  The angle of a direction vector is
-  // computed by transforming it into the X,Y,Z basis, and then calculating
-  // atan2(y,x).  This mapping allows us to represent a wedge of angles as a
-  // 1D interval.  Since the interval wraps around, we represent it as an
-  // S1Interval, i.e. an interval on the unit circle.
-  Matrix3x3_d frame;
-  const S2Point& origin = polyline.vertex(index);
-  S2::GetFrame(origin, &frame);
-
-  // As we go along, we keep track of the current wedge of angles and the
-  // distance to the last vertex (which must be non-decreasing).
-  S1Interval current_wedge = S1Interval::Full();
-  double last_distance = 0;
-
-  for (++index; index < polyline.num_vertices(); ++index) {
-    const S2Point& candidate = polyline.vertex(index);
-    double distance = origin.Angle(candidate);
-
-    // We don't allow simplification to create edges longer than 90 degrees,
-    // to avoid numeric instability as lengths approach 180 degrees.  (We do
-    // need to allow for original edges longer than 90 degrees, though.)
-    if (distance > M_PI/2 && last_distance > 0) break;
-
-    // Vertices must be in increasing order along the ray, except for the
-    // initial disc around the origin.
-    if (distance < last_distance && last_distance > tolerance.radians()) break;
-    last_distance = distance;
-
-    // Points that are within the tolerance distance of the origin do not
-    // constrain the ray direction, so we can ignore them.
-    if (distance <= tolerance.radians()) continue;
-
-    // If the current wedge of angles does not contain the angle to this
-    // vertex, then stop right now.  Note that the wedge of possible ray
-    // angles is not necessarily empty yet, but we can't continue unless we
-    // are willing to backtrack to the last vertex that was contained within
-    // the wedge (since we don't create new vertices).  This would be more
-    // complicated and also make the worst-case running time more than linear.
-    S2Point direction = S2::ToFrame(frame, candidate);
-    double center = atan2(direction.y(), direction.x());
-    if (!current_wedge.Contains(center)) break;
-
-    // To determine how this vertex constrains the possible ray angles,
-    // consider the triangle ABC where A is the origin, B is the candidate
-    // vertex, and C is one of the two tangent points between A and the
-    // spherical cap of radius "tolerance" centered at B.  Then from the
-    // spherical law of sines, sin(a)/sin(A) = sin(c)/sin(C), where "a" and
-    // "c" are the lengths of the edges opposite A and C.  In our case C is a
-    // 90 degree angle, therefore A = asin(sin(a) / sin(c)).  Angle A is the
-    // half-angle of the allowable wedge.
-
-    double half_angle = asin(sin(tolerance.radians()) / sin(distance));
-    S1Interval target = S1Interval::FromPoint(center).Expanded(half_angle);
-    current_wedge = current_wedge.Intersection(target);
-    ABSL_DCHECK(!current_wedge.is_empty());
-  }
-  // We break out of the loop when we reach a vertex index that can't be
-  // included in the line segment, so back up by one vertex.
-  return index - 1;
-}
-}  // namespace
 
 void S2Polyline::SubsampleVertices(S1Angle tolerance,
                                    vector<int>* indices) const {
   indices->clear();
-  if (num_vertices() == 0) return;
-
-  indices->push_back(0);
-  S1Angle clamped_tolerance = max(tolerance, S1Angle::Radians(0));
-  for (int index = 0; index + 1 < num_vertices(); ) {
-    int next_index = FindEndVertex(*this, clamped_tolerance, index);
-    // Don't create duplicate adjacent vertices.
-    if (vertex(next_index) != vertex(index)) {
-      indices->push_back(next_index);
-    }
-    index = next_index;
-  }
+  s2shapeutil::SubsampleVertices(vertices_span(), tolerance, indices);
 }
 
 bool S2Polyline::Equals(const S2Polyline& b) const {
@@ -226,9 +226,10 @@ class S2Polyline final : public S2Region {
   // polyline endpoint is the only intersection with the other polyline, the
   // function may return true or false arbitrarily.
   //
-  // The running time is quadratic in the number of vertices.  (To intersect
-  // polylines more efficiently, or compute the actual intersection geometry,
-  // use S2BooleanOperation.)
+  // Small polylines are tested by comparing every pair of edges.  Otherwise
+  // both polylines are temporarily indexed, so that the running time is
+  // O((n + m) log (n + m)) plus the number of nearby edge pairs.  (To compute
+  // the actual intersection geometry, use S2BooleanOperation.)
   bool Intersects(const S2Polyline& line) const;
 
   // Reverse the order of the polyline vertices.
@@ -375,6 +376,9 @@ class S2Polyline final : public S2Region {
     ChainPosition chain_position(int e) const final {
       return ChainPosition(0, e);
     }
+    S2PointSpan chain_vertex_span(int i) const final {
+      return polyline_->vertices_span();
+    }
     TypeTag type_tag() const override { return kTypeTag; }
 
     void Encode(Encoder* encoder, s2coding::CodingHint hint) const override {
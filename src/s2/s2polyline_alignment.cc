@@ -17,11 +17,13 @@
 #include "s2/s2polyline_alignment.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <memory>
 #include <ostream>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -31,6 +33,7 @@
 #include "s2/s2polyline_alignment_internal.h"
 
 using std::make_unique;
+using std::min;
 using std::string;
 using std::unique_ptr;
 using std::vector;
@@ -111,6 +114,20 @@ Window Window::Dilate(const int radius) const {
   return Window(new_strides);
 }
 
+Window SakoeChibaWindow(const int rows, const int cols, const int radius) {
+  ABSL_DCHECK(rows > 0 && cols > 0) << "Cannot construct empty window.";
+  ABSL_DCHECK(radius >= 0) << "Negative band radius.";
+  vector<ColumnStride> strides(rows);
+  for (int row = 0; row < rows; ++row) {
+    // The columns crossed by the diagonal within this row.
+    const int start = static_cast<int64_t>(row) * cols / rows;
+    const int end =
+        (static_cast<int64_t>(row + 1) * cols + rows - 1) / rows;
+    strides[row] = {std::max(0, start - radius), min(end + radius, cols)};
+  }
+  return Window(strides);
+}
+
 // Debug string implemented primarily for testing purposes.
 string Window::DebugString() const {
   std::stringstream buffer;
@@ -183,11 +200,18 @@ inline double BoundsCheckedTableCost(const int row, const int col,
 //
 // This method takes time proportional to the number of cells in the window,
 // which can range from O(max(a, b)) cells (best) to O(a*b) cells (worst)
+//
+// The `costs` table is reused across calls. It is grown as necessary, and
+// only the cells inside the window are written.
 VertexAlignment DynamicTimewarp(const S2Polyline& a, const S2Polyline& b,
-                                const Window& w) {
+                                const Window& w, CostTable* table) {
   const int rows = a.num_vertices();
   const int cols = b.num_vertices();
-  auto costs = CostTable(rows, vector<double>(cols));
+  if (table->size() < rows) table->resize(rows);
+  for (int row = 0; row < rows; ++row) {
+    if ((*table)[row].size() < cols) (*table)[row].resize(cols);
+  }
+  CostTable& costs = *table;
 
   ColumnStride curr;
   ColumnStride prev = ColumnStride::All();
@@ -241,7 +265,34 @@ VertexAlignment DynamicTimewarp(const S2Polyline& a, const S2Polyline& b,
     }
   }
   std::reverse(warp_path.begin(), warp_path.end());
-  return VertexAlignment(costs.back().back(), warp_path);
+  return VertexAlignment(costs[rows - 1][cols - 1], warp_path);
+}
+
+// Like DynamicTimewarp, but computes only the cost of the alignment, keeping
+// just two rows of the DP table in `buffer`.
+double DynamicTimewarpCost(const S2Polyline& a, const S2Polyline& b,
+                           const Window& w, vector<double>* buffer) {
+  const int rows = a.num_vertices();
+  const int cols = b.num_vertices();
+  buffer->resize(2 * cols);
+  double* prev_costs = buffer->data();
+  double* curr_costs = buffer->data() + cols;
+  ColumnStride prev = {0, 0};
+  for (int row = 0; row < rows; ++row) {
+    const ColumnStride curr = w.GetColumnStride(row);
+    for (int col = curr.start; col < curr.end; ++col) {
+      double d_cost = (row == 0 && col == 0) ? 0.0
+                      : (col > 0 && prev.InRange(col - 1)) ? prev_costs[col - 1]
+                                                           : DOUBLE_MAX;
+      double u_cost = prev.InRange(col) ? prev_costs[col] : DOUBLE_MAX;
+      double l_cost = (col > curr.start) ? curr_costs[col - 1] : DOUBLE_MAX;
+      curr_costs[col] = std::min({d_cost, u_cost, l_cost}) +
+                        (a.vertex(row) - b.vertex(col)).Norm();
+    }
+    std::swap(prev_costs, curr_costs);
+    prev = curr;
+  }
+  return prev_costs[cols - 1];
 }
 
 unique_ptr<S2Polyline> HalfResolution(const S2Polyline& in) {
@@ -254,17 +305,66 @@ unique_ptr<S2Polyline> HalfResolution(const S2Polyline& in) {
   return make_unique<S2Polyline>(vertices);
 }
 
+// The recursive implementation of GetApproxVertexAlignment, which reuses the
+// given DP table at every level.
+VertexAlignment ApproxVertexAlignment(const S2Polyline& a, const S2Polyline& b,
+                                      const int radius, CostTable* table);
+
+// Returns the default radius used by GetApproxVertexAlignment.
+int DefaultApproxRadius(const S2Polyline& a, const S2Polyline& b) {
+  const int max_length = std::max(a.num_vertices(), b.num_vertices());
+  return static_cast<int>(std::pow(max_length, 0.25));
+}
+
+// Buffers that are reused by all the alignments computed by one thread, so
+// that each alignment does not need to allocate a fresh cost table.
+struct Workspace {
+  CostTable table;
+  vector<double> buffer;
+};
+
 // Helper methods for GetMedoidPolyline and GetConsensusPolyline to auto-select
 // appropriate cost function / alignment functions.
-double CostFn(const S2Polyline& a, const S2Polyline& b, bool approx) {
-  return approx ? GetApproxVertexAlignment(a, b).alignment_cost
-                : GetExactVertexAlignmentCost(a, b);
+double CostFn(const S2Polyline& a, const S2Polyline& b, bool approx,
+              int band_radius, Workspace* workspace) {
+  if (approx) {
+    return ApproxVertexAlignment(a, b, DefaultApproxRadius(a, b),
+                                 &workspace->table)
+        .alignment_cost;
+  }
+  if (band_radius < 0) return GetExactVertexAlignmentCost(a, b);
+  const Window w =
+      SakoeChibaWindow(a.num_vertices(), b.num_vertices(), band_radius);
+  return DynamicTimewarpCost(a, b, w, &workspace->buffer);
 }
 
 VertexAlignment AlignmentFn(const S2Polyline& a, const S2Polyline& b,
-                            bool approx) {
-  return approx ? GetApproxVertexAlignment(a, b)
-                : GetExactVertexAlignment(a, b);
+                            bool approx, int band_radius,
+                            Workspace* workspace) {
+  if (approx) {
+    return ApproxVertexAlignment(a, b, DefaultApproxRadius(a, b),
+                                 &workspace->table);
+  }
+  const int a_n = a.num_vertices();
+  const int b_n = b.num_vertices();
+  const Window w = band_radius >= 0
+                       ? SakoeChibaWindow(a_n, b_n, band_radius)
+                       : Window(vector<ColumnStride>(a_n, {0, b_n}));
+  return DynamicTimewarp(a, b, w, &workspace->table);
+}
+
+// Calls fn(worker, i) for all 0 <= i < n using up to "num_threads" threads,
+// where 0 <= worker < num_threads identifies the calling thread.
+template <class Fn>
+static void ParallelFor(int n, int num_threads, const Fn& fn) {
+  std::atomic<int> next(0);
+  auto run = [&](int worker) {
+    for (int i; (i = next.fetch_add(1)) < n; ) fn(worker, i);
+  };
+  vector<std::thread> threads;
+  for (int i = 1; i < min(num_threads, n); ++i) threads.emplace_back(run, i);
+  run(0);
+  for (auto& thread : threads) thread.join();
 }
 
 // PUBLIC API IMPLEMENTATION DETAILS
@@ -297,12 +397,43 @@ VertexAlignment GetExactVertexAlignment(const S2Polyline& a,
   ABSL_CHECK(a_n > 0) << "A is empty polyline.";
   ABSL_CHECK(b_n > 0) << "B is empty polyline.";
   const auto w = Window(vector<ColumnStride>(a_n, {0, b_n}));
-  return DynamicTimewarp(a, b, w);
+  CostTable table;
+  return DynamicTimewarp(a, b, w, &table);
+}
+
+VertexAlignment GetBandedVertexAlignment(const S2Polyline& a,
+                                         const S2Polyline& b,
+                                         const int radius) {
+  const int a_n = a.num_vertices();
+  const int b_n = b.num_vertices();
+  ABSL_CHECK(a_n > 0) << "A is empty polyline.";
+  ABSL_CHECK(b_n > 0) << "B is empty polyline.";
+  ABSL_CHECK(radius >= 0) << "Radius is negative.";
+  CostTable table;
+  return DynamicTimewarp(a, b, SakoeChibaWindow(a_n, b_n, radius), &table);
+}
+
+double GetBandedVertexAlignmentCost(const S2Polyline& a, const S2Polyline& b,
+                                    const int radius) {
+  const int a_n = a.num_vertices();
+  const int b_n = b.num_vertices();
+  ABSL_CHECK(a_n > 0) << "A is empty polyline.";
+  ABSL_CHECK(b_n > 0) << "B is empty polyline.";
+  ABSL_CHECK(radius >= 0) << "Radius is negative.";
+  vector<double> buffer;
+  return DynamicTimewarpCost(a, b, SakoeChibaWindow(a_n, b_n, radius),
+                             &buffer);
 }
 
 VertexAlignment GetApproxVertexAlignment(const S2Polyline& a,
                                          const S2Polyline& b,
                                          const int radius) {
+  CostTable table;
+  return ApproxVertexAlignment(a, b, radius, &table);
+}
+
+VertexAlignment ApproxVertexAlignment(const S2Polyline& a, const S2Polyline& b,
+                                      const int radius, CostTable* table) {
   // Determined experimentally, through benchmarking, as about the points at
   // which ExactAlignment is faster than ApproxAlignment, so we use these as
   // our switchover points to exact computation mode.
@@ -317,13 +448,15 @@ VertexAlignment GetApproxVertexAlignment(const S2Polyline& a,
   // If we've hit the point where doing a full, direct solve is guaranteed to
   // be faster, then terminate the recursion and do that.
   if (a_n - radius < kSizeSwitchover || b_n - radius < kSizeSwitchover) {
-    return GetExactVertexAlignment(a, b);
+    return DynamicTimewarp(a, b, Window(vector<ColumnStride>(a_n, {0, b_n})),
+                           table);
   }
 
   // If we've hit the point where the window will be probably be so full that we
   // might as well compute an exact solution, then terminate recursion to do so.
   if (std::max(a_n, b_n) * (2 * radius + 1) > a_n * b_n * kDensitySwitchover) {
-    return GetExactVertexAlignment(a, b);
+    return DynamicTimewarp(a, b, Window(vector<ColumnStride>(a_n, {0, b_n})),
+                           table);
   }
 
   // Otherwise, shrink the input polylines, recursively compute the vertex
@@ -331,36 +464,60 @@ VertexAlignment GetApproxVertexAlignment(const S2Polyline& a,
   // the projected alignment `proj` on an upsampled, dilated window.
   const auto a_half = HalfResolution(a);
   const auto b_half = HalfResolution(b);
-  const auto proj = GetApproxVertexAlignment(*a_half, *b_half, radius);
+  const auto proj = ApproxVertexAlignment(*a_half, *b_half, radius, table);
   const auto w = Window(proj.warp_path).Upsample(a_n, b_n).Dilate(radius);
-  return DynamicTimewarp(a, b, w);
+  return DynamicTimewarp(a, b, w, table);
 }
 
 // This method calls the approx method with a reasonable default for radius.
 VertexAlignment GetApproxVertexAlignment(const S2Polyline& a,
                                          const S2Polyline& b) {
-  const int max_length = std::max(a.num_vertices(), b.num_vertices());
-  const int radius = static_cast<int>(std::pow(max_length, 0.25));
-  return GetApproxVertexAlignment(a, b, radius);
+  return GetApproxVertexAlignment(a, b, DefaultApproxRadius(a, b));
 }
 
 // We use some of the symmetry of our metric to avoid computing all N^2
 // alignments. Specifically, because cost_fn(a, b) = cost_fn(b, a), and
 // cost_fn(a, a) = 0, we can compute only the lower triangle of cost matrix
 // and then mirror it across the diagonal to save on cost_fn invocations.
+//
+// When using multiple threads, the rows of the lower triangle are computed in
+// parallel and then summed in the same order as the single-threaded version,
+// so that the result is identical.
 int GetMedoidPolyline(const vector<unique_ptr<S2Polyline>>& polylines,
                       const MedoidOptions options) {
   const int num_polylines = polylines.size();
   const bool approx = options.approx();
+  const int band_radius = options.band_radius();
   ABSL_CHECK_GT(num_polylines, 0);
 
   // costs[i] stores total cost of aligning [i] with all other polylines.
   vector<double> costs(num_polylines, 0.0);
-  for (int i = 0; i < num_polylines; ++i) {
-    for (int j = i + 1; j < num_polylines; ++j) {
-      double cost = CostFn(*polylines[i], *polylines[j], approx);
-      costs[i] += cost;
-      costs[j] += cost;
+  if (options.num_threads() <= 1) {
+    Workspace workspace;
+    for (int i = 0; i < num_polylines; ++i) {
+      for (int j = i + 1; j < num_polylines; ++j) {
+        double cost = CostFn(*polylines[i], *polylines[j], approx,
+                             band_radius, &workspace);
+        costs[i] += cost;
+        costs[j] += cost;
+      }
+    }
+  } else {
+    // pair_costs[i][j - i - 1] stores the cost of aligning [i] with [j].
+    vector<vector<double>> pair_costs(num_polylines);
+    vector<Workspace> workspaces(options.num_threads());
+    ParallelFor(num_polylines, options.num_threads(), [&](int worker, int i) {
+      for (int j = i + 1; j < num_polylines; ++j) {
+        pair_costs[i].push_back(CostFn(*polylines[i], *polylines[j], approx,
+                                       band_radius, &workspaces[worker]));
+      }
+    });
+    for (int i = 0; i < num_polylines; ++i) {
+      for (int j = i + 1; j < num_polylines; ++j) {
+        double cost = pair_costs[i][j - i - 1];
+        costs[i] += cost;
+        costs[j] += cost;
+      }
     }
   }
   return std::min_element(costs.begin(), costs.end()) - costs.begin();
@@ -391,27 +548,40 @@ unique_ptr<S2Polyline> GetConsensusPolyline(
   const int num_polylines = polylines.size();
   ABSL_CHECK_GT(num_polylines, 0);
   const bool approx = options.approx();
+  const int band_radius = options.band_radius();
+  const int num_threads = std::max(1, options.num_threads());
 
   // Seed a consensus polyline, either arbitrarily with first element, or with
-  // the medoid. If seeding with medoid, inherit approx parameter from options.
+  // the medoid. If seeding with medoid, inherit the alignment parameters from
+  // options.
   int seed_index = 0;
   if (options.seed_medoid()) {
     MedoidOptions medoid_options;
     medoid_options.set_approx(approx);
+    medoid_options.set_band_radius(band_radius);
+    medoid_options.set_num_threads(num_threads);
     seed_index = GetMedoidPolyline(polylines, medoid_options);
   }
   auto consensus = unique_ptr<S2Polyline>(polylines[seed_index]->Clone());
   const int num_consensus_vertices = consensus->num_vertices();
   ABSL_DCHECK_GT(num_consensus_vertices, 1);
 
+  // The alignments are computed in parallel, but the points are summed in
+  // order so that the result does not depend on the number of threads.
+  vector<Workspace> workspaces(num_threads);
+  vector<WarpPath> warp_paths(num_polylines);
   bool converged = false;
   int iterations = 0;
   while (!converged && iterations < options.iteration_cap()) {
+    ParallelFor(num_polylines, num_threads, [&](int worker, int i) {
+      warp_paths[i] = AlignmentFn(*consensus, *polylines[i], approx,
+                                  band_radius, &workspaces[worker])
+                          .warp_path;
+    });
     vector<S2Point> points(num_consensus_vertices, S2Point());
-    for (const auto& polyline : polylines) {
-      const auto alignment = AlignmentFn(*consensus, *polyline, approx);
-      for (const auto& pair : alignment.warp_path) {
-        points[pair.first] += polyline->vertex(pair.second);
+    for (int i = 0; i < num_polylines; ++i) {
+      for (const auto& pair : warp_paths[i]) {
+        points[pair.first] += polylines[i]->vertex(pair.second);
       }
     }
     for (S2Point& p : points) {
@@ -157,6 +157,24 @@ VertexAlignment GetApproxVertexAlignment(const S2Polyline& a,
 VertexAlignment GetApproxVertexAlignment(const S2Polyline& a,
                                          const S2Polyline& b);
 
+// GetBandedVertexAlignment takes two non-empty polylines `a` and `b` as input,
+// and returns the optimal alignment among warp paths that stay within a
+// Sakoe-Chiba band of half-width `radius` around the diagonal. Specifically,
+// vertex a.vertex(i) may only be paired with vertices b.vertex(j) whose index
+// j is within `radius` of i * b.num_vertices() / a.num_vertices(). This is
+// useful when the polylines are known to be roughly synchronized (e.g.,
+// trajectories resampled at the same rate), and yields the same result as
+// GetExactVertexAlignment if the optimal warp path lies inside the band.
+// This method is O(max(A, B) * radius) in time and O(A * B) in space.
+VertexAlignment GetBandedVertexAlignment(const S2Polyline& a,
+                                         const S2Polyline& b,
+                                         const int radius);
+
+// GetBandedVertexAlignmentCost returns the cost of the alignment computed by
+// GetBandedVertexAlignment, using O(B) space.
+double GetBandedVertexAlignmentCost(const S2Polyline& a, const S2Polyline& b,
+                                    const int radius);
+
 // GetMedoidPolyline returns the index `p` of a "medoid" polyline from a
 // non-empty collection of `polylines` such that
 //
@@ -179,8 +197,23 @@ class MedoidOptions {
   bool approx() const { return approx_; }
   void set_approx(bool approx) { approx_ = approx; }
 
+  // If options.band_radius >= 0 and options.approx = false, vertex alignment
+  // costs are computed with GetBandedVertexAlignmentCost using this radius.
+  // DEFAULT: -1 (alignments are not restricted to a band)
+  int band_radius() const { return band_radius_; }
+  void set_band_radius(int band_radius) { band_radius_ = band_radius; }
+
+  // The number of threads used to compute alignment costs. The result does
+  // not depend on the number of threads. Note that when num_threads > 1, the
+  // pairwise costs are stored, which takes O(N^2) space.
+  // DEFAULT: 1
+  int num_threads() const { return num_threads_; }
+  void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
  private:
   bool approx_ = true;
+  int band_radius_ = -1;
+  int num_threads_ = 1;
 };
 
 int GetMedoidPolyline(const std::vector<std::unique_ptr<S2Polyline>>& polylines,
@@ -233,10 +266,25 @@ class ConsensusOptions {
   int iteration_cap() const { return iteration_cap_; }
   void set_iteration_cap(int iteration_cap) { iteration_cap_ = iteration_cap; }
 
+  // If options.band_radius >= 0 and options.approx = false, vertex alignments
+  // are computed with GetBandedVertexAlignment using this radius.
+  // DEFAULT: -1 (alignments are not restricted to a band)
+  int band_radius() const { return band_radius_; }
+  void set_band_radius(int band_radius) { band_radius_ = band_radius; }
+
+  // The number of threads used to compute alignments (including the medoid,
+  // if options.seed_medoid = true). The result does not depend on the number
+  // of threads.
+  // DEFAULT: 1
+  int num_threads() const { return num_threads_; }
+  void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
  private:
   bool approx_ = true;
   bool seed_medoid_ = false;
   int iteration_cap_ = 5;
+  int band_radius_ = -1;
+  int num_threads_ = 1;
 };
 
 std::unique_ptr<S2Polyline> GetConsensusPolyline(
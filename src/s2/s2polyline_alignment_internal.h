@@ -148,6 +148,12 @@ class Window {
   bool IsValid() const;
 };
 
+// Returns a Sakoe-Chiba band window for aligning polylines with `rows` and
+// `cols` vertices: row i contains the columns within `radius` of the columns
+// crossed by the diagonal from (0, 0) to (rows - 1, cols - 1). Radius = 0
+// yields the narrowest window that still contains a warp path.
+Window SakoeChibaWindow(int rows, int cols, int radius);
+
 // Reduce the number of vertices of polyline `in` by selecting every other
 // vertex for inclusion in a new polyline. Specifically, we take even-index
 // vertices [0, 2, 4,...]. For an even-length polyline, the last vertex is not
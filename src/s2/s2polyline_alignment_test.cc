@@ -276,6 +276,26 @@ TEST(S2PolylineAlignmentTest, DilatesWindowByVeryLargeRadius) {
   EXPECT_EQ("\n" + w_d.DebugString(), expected_output);
 }
 
+TEST(S2PolylineAlignmentTest, CreatesSakoeChibaWindow) {
+  const Window w = SakoeChibaWindow(4, 6, 1);
+  const string expected_output = R"(
+ * * * . . .
+ * * * * . .
+ . . * * * *
+ . . . * * *
+)";
+  EXPECT_EQ("\n" + w.DebugString(), expected_output);
+
+  // A band of radius zero follows the diagonal.
+  const Window w_0 = SakoeChibaWindow(3, 5, 0);
+  const string expected_output_0 = R"(
+ * * . . .
+ . * * * .
+ . . . * *
+)";
+  EXPECT_EQ("\n" + w_0.DebugString(), expected_output_0);
+}
+
 TEST(S2PolylineAlignmentTest, HalvesZeroLengthPolyline) {
   const auto line = s2textformat::MakePolylineOrDie("");
   const auto halved = HalfResolution(*line);
@@ -488,6 +508,40 @@ TEST(S2PolylineAlignmentTest, FuzzedWithBruteForce) {
 
 // TESTS FOR TRAJECTORY CONSENSUS ALGORITHMS
 
+TEST(S2PolylineAlignmentTest, BandedMatchesExactForLargeRadius) {
+  S2Testing::rnd.Reset(1);
+  const auto polylines = GenPolylines(2, 100, 0.9);
+  const S2Polyline& a = *polylines[0];
+  const S2Polyline& b = *polylines[1];
+  const VertexAlignment exact = GetExactVertexAlignment(a, b);
+  const VertexAlignment banded = GetBandedVertexAlignment(a, b, 100);
+  EXPECT_EQ(exact.alignment_cost, banded.alignment_cost);
+  EXPECT_EQ(exact.warp_path, banded.warp_path);
+  EXPECT_EQ(exact.alignment_cost, GetBandedVertexAlignmentCost(a, b, 100));
+
+  // Narrower bands can only increase the cost.
+  double prev_cost = exact.alignment_cost;
+  for (int radius : {8, 2, 0}) {
+    const VertexAlignment alignment = GetBandedVertexAlignment(a, b, radius);
+    EXPECT_EQ(alignment.alignment_cost,
+              GetBandedVertexAlignmentCost(a, b, radius));
+    EXPECT_GE(alignment.alignment_cost, prev_cost);
+    EXPECT_EQ((std::pair<int, int>(0, 0)), alignment.warp_path.front());
+    EXPECT_EQ((std::pair<int, int>(99, 99)), alignment.warp_path.back());
+    prev_cost = alignment.alignment_cost;
+  }
+}
+
+TEST(S2PolylineAlignmentTest, BandedDifferentLengthPolylines) {
+  const auto a = s2textformat::MakePolylineOrDie("0:0, 0:1, 0:2, 0:3");
+  const auto b = s2textformat::MakePolylineOrDie("0:0, 0:3");
+  const VertexAlignment alignment = GetBandedVertexAlignment(*a, *b, 0);
+  const WarpPath expected = {{0, 0}, {1, 0}, {2, 1}, {3, 1}};
+  EXPECT_EQ(expected, alignment.warp_path);
+  EXPECT_EQ(alignment.alignment_cost,
+            GetBandedVertexAlignmentCost(*a, *b, 0));
+}
+
 // Tests for GetMedoidPolyline
 #if GTEST_HAS_DEATH_TEST
 TEST(S2PolylineAlignmentDeathTest, MedoidPolylineNoPolylines) {
@@ -597,6 +651,21 @@ TEST(S2PolylineAlignmentTest, MedoidPolylineFewLargePolylines) {
   EXPECT_EQ(approx_medoid, approx_medoid_index);
 }
 
+TEST(S2PolylineAlignmentTest, MedoidPolylineMultipleThreads) {
+  S2Testing::rnd.Reset(2);
+  const auto polylines = GenPolylines(20, 64, 0.9);
+  for (bool approx : {true, false}) {
+    for (int band_radius : {-1, 3}) {
+      MedoidOptions options;
+      options.set_approx(approx);
+      options.set_band_radius(band_radius);
+      const int expected = GetMedoidPolyline(polylines, options);
+      options.set_num_threads(4);
+      EXPECT_EQ(expected, GetMedoidPolyline(polylines, options));
+    }
+  }
+}
+
 // Tests for GetConsensusPolyline
 #if GTEST_HAS_DEATH_TEST
 TEST(S2PolylineAlignmentDeathTest, ConsensusPolylineNoPolylines) {
@@ -638,4 +707,19 @@ TEST(S2PolylineAlignmentTest, ConsensusPolylineOverlappingPolylines) {
   EXPECT_TRUE(result->ApproxEquals(*expected));
 }
 
+TEST(S2PolylineAlignmentTest, ConsensusPolylineMultipleThreads) {
+  S2Testing::rnd.Reset(3);
+  const auto polylines = GenPolylines(20, 64, 0.9);
+  for (bool approx : {true, false}) {
+    ConsensusOptions options;
+    options.set_approx(approx);
+    options.set_seed_medoid(true);
+    options.set_band_radius(approx ? -1 : 4);
+    const auto expected = GetConsensusPolyline(polylines, options);
+    options.set_num_threads(4);
+    const auto result = GetConsensusPolyline(polylines, options);
+    EXPECT_TRUE(result->Equals(*expected));
+  }
+}
+
 }  // namespace s2polyline_alignment
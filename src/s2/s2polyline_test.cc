@@ -31,11 +31,14 @@
 
 #include "s2/s1angle.h"
 #include "s2/s2builderutil_snap_functions.h"
+#include "s2/s2cap.h"
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2coder_testing.h"
 #include "s2/s2coords.h"
 #include "s2/s2debug.h"
+#include "s2/s2edge_crossings.h"
+#include "s2/s2edge_distances.h"
 #include "s2/s2error.h"
 #include "s2/s2latlng.h"
 #include "s2/s2latlng_rect.h"
@@ -360,6 +363,66 @@ TEST(S2Polyline, IntersectsVertexOnEdge)  {
       horizontal_right_to_left->Intersects(*vertical_top_to_bottom.get()));
 }
 
+// Returns a random walk of "n" vertices with steps of at most "step".
+unique_ptr<S2Polyline> MakeRandomWalk(const S2Point& start, int n,
+                                      S1Angle step) {
+  vector<S2Point> vertices = {start};
+  while (vertices.size() < n) {
+    vertices.push_back(
+        S2Testing::SamplePoint(S2Cap(vertices.back(), step)));
+  }
+  return make_unique<S2Polyline>(vertices);
+}
+
+bool BruteForceIntersects(const S2Polyline& a, const S2Polyline& b) {
+  for (int i = 1; i < a.num_vertices(); ++i) {
+    for (int j = 1; j < b.num_vertices(); ++j) {
+      if (S2::CrossingSign(a.vertex(i - 1), a.vertex(i), b.vertex(j - 1),
+                           b.vertex(j)) >= 0) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+TEST(S2Polyline, IntersectsLongPolylinesMatchesBruteForce) {
+  // These polylines are long enough that Intersects() indexes them.
+  S2Testing::rnd.Reset(1);
+  int num_intersecting = 0;
+  for (int iter = 0; iter < 50; ++iter) {
+    const S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+    auto a = MakeRandomWalk(S2Testing::SamplePoint(cap), 200,
+                            S1Angle::Degrees(0.02));
+    auto b = MakeRandomWalk(S2Testing::SamplePoint(cap), 100,
+                            S1Angle::Degrees(0.02));
+    const bool expected = BruteForceIntersects(*a, *b);
+    EXPECT_EQ(expected, a->Intersects(*b));
+    EXPECT_EQ(expected, b->Intersects(*a));
+    num_intersecting += expected;
+  }
+  // Make sure that both cases were tested.
+  EXPECT_GT(num_intersecting, 0);
+  EXPECT_LT(num_intersecting, 50);
+}
+
+TEST(S2Polyline, IntersectsLongPolylinesAtVertex) {
+  S2Testing::rnd.Reset(2);
+  const S2Point start = S2Testing::RandomPoint();
+  auto a = MakeRandomWalk(start, 200, S1Angle::Degrees(0.01));
+  // "b" starts far away and ends at a vertex of "a".
+  vector<S2Point> vertices;
+  const S2Point end = a->vertex(100);
+  const S2Point far = S2::Rotate(end, S2::Ortho(end), S1Angle::Degrees(5));
+  for (int i = 0; i <= 100; ++i) {
+    vertices.push_back(S2::Interpolate(far, end, i / 100.0));
+  }
+  vertices.back() = end;
+  S2Polyline b(vertices);
+  EXPECT_TRUE(a->Intersects(b));
+  EXPECT_TRUE(b.Intersects(*a));
+}
+
 TEST(S2Polyline, SpaceUsedEmptyPolyline)  {
   unique_ptr<S2Polyline> line(MakePolyline(""));
   EXPECT_GT(line->SpaceUsed(), 0);
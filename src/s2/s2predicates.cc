@@ -20,14 +20,24 @@
 #include <algorithm>
 #include <cfloat>
 #include <cmath>
+#include <initializer_list>
+#include <limits>
 #include <ostream>
 #include <utility>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include "absl/log/absl_check.h"
+#include "absl/types/span.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s2edge_crossings.h"
 #include "s2/s2point.h"
 #include "s2/s2predicates_internal.h"
+#include "s2/s2telemetry.h"
 #include "s2/util/math/exactfloat/exactfloat.h"
 
 using std::fabs;
@@ -40,11 +50,267 @@ namespace s2pred {
 // A predefined S1ChordAngle representing (approximately) 45 degrees.
 static const S1ChordAngle k45Degrees = S1ChordAngle::FromLength2(2 - M_SQRT2);
 
+// The statistics returned by GetPredicateStats() for the current thread.
+static thread_local PredicateStats predicate_stats;
+
+// Counts a case resolved by the given tier of the given predicate, both in the
+// per-thread PredicateStats and in the process-wide telemetry.
+#define COUNT_TIER(predicate, tier)                            \
+  do {                                                         \
+    ++predicate_stats.predicate.tier;                          \
+    S2_TELEMETRY_COUNTER_INC("s2pred." #predicate "." #tier);  \
+  } while (0)
+
+PredicateStats GetPredicateStats() {
+  return predicate_stats;
+}
+
+void ResetPredicateStats() {
+  predicate_stats = PredicateStats();
+}
+
 int Sign(const S2Point& a, const S2Point& b, const S2Point& c) {
   // We don't need RobustCrossProd() here because Sign() does its own
   // error estimation and calls ExpensiveSign() if there is any uncertainty
   // about the result.
-  return Sign(a, b, c, a.CrossProd(b));
+  Vector3_d a_cross_b = a.CrossProd(b);
+  int sign = TriageSign(a, b, c, a_cross_b);
+  if (sign != 0) {
+    COUNT_TIER(sign, triage);
+    return sign;
+  }
+  return ExpensiveSign(a, b, c);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Expansion arithmetic
+
+// Sets (*x + *y) to exactly (a + b), where *x is the rounded sum.
+static inline void TwoSum(double a, double b, double* x, double* y) {
+  double sum = a + b;
+  double b_virtual = sum - a;
+  double a_virtual = sum - b_virtual;
+  *y = (a - a_virtual) + (b - b_virtual);
+  *x = sum;
+}
+
+// Sets (*x + *y) to exactly (a * b), where *x is the rounded product.  This
+// requires that the product does not overflow or underflow.
+static inline void TwoProduct(double a, double b, double* x, double* y) {
+  double product = a * b;
+#ifdef FP_FAST_FMA
+  *y = std::fma(a, b, -product);
+#else
+  // Dekker's algorithm splits each argument into two halves of at most 26
+  // significant bits so that all the partial products below are exact.
+  constexpr double kSplitter = 134217729.0;  // 2**27 + 1
+  double ta = kSplitter * a;
+  double a_hi = ta - (ta - a), a_lo = a - a_hi;
+  double tb = kSplitter * b;
+  double b_hi = tb - (tb - b), b_lo = b - b_hi;
+  *y = (((a_hi * b_hi - product) + a_hi * b_lo) + a_lo * b_hi) + a_lo * b_lo;
+#endif
+  *x = product;
+}
+
+// The following functions operate on floating-point expansions, i.e. exact
+// sums of non-overlapping, non-zero doubles, stored as arrays of components
+// in increasing order of magnitude.  (The sign of an expansion is therefore
+// the sign of its last component.)  The output array must not overlap the
+// inputs and must have room for the maximum number of components indicated.
+// Each function returns the number of components in its result.
+
+// Sets "h" to the expansion (a * b), which has at most 2 components.
+static inline int ProductExpansion(double a, double b, double* h) {
+  double x, y;
+  TwoProduct(a, b, &x, &y);
+  int n = 0;
+  if (y != 0) h[n++] = y;
+  if (x != 0) h[n++] = x;
+  return n;
+}
+
+// Sets "h" to the sum of the expansions "e" and "f_sign * f", where "f_sign"
+// is either 1 or -1.  "h" has at most (en + fn) components.  This is
+// Shewchuk's FAST-EXPANSION-SUM with zero elimination: the components of
+// both expansions are merged in order of increasing magnitude, each one is
+// added to a running sum, and the roundoff error terms are emitted.
+static int SumExpansions(const double* e, int en, const double* f, int fn,
+                         double f_sign, double* h) {
+  if (en == 0) {
+    for (int j = 0; j < fn; ++j) h[j] = f_sign * f[j];
+    return fn;
+  }
+  int i = 0, j = 0, n = 0;
+  auto next = [&]() {
+    if (j == fn || (i < en && fabs(e[i]) < fabs(f[j]))) return e[i++];
+    return f_sign * f[j++];
+  };
+  double q = next();
+  while (i < en || j < fn) {
+    double err;
+    TwoSum(q, next(), &q, &err);
+    if (err != 0) h[n++] = err;
+  }
+  if (q != 0) h[n++] = q;
+  return n;
+}
+
+// Sets "h" to the expansion (e * b), which has at most (2 * en) components.
+// This is Shewchuk's SCALE-EXPANSION with zero elimination.
+static int ScaleExpansion(const double* e, int en, double b, double* h) {
+  if (en == 0 || b == 0) return 0;
+  int n = 0;
+  double q, err;
+  TwoProduct(e[0], b, &q, &err);
+  if (err != 0) h[n++] = err;
+  for (int i = 1; i < en; ++i) {
+    double p1, p0, sum;
+    TwoProduct(e[i], b, &p1, &p0);
+    TwoSum(q, p0, &sum, &err);
+    if (err != 0) h[n++] = err;
+    TwoSum(p1, sum, &q, &err);
+    if (err != 0) h[n++] = err;
+  }
+  if (q != 0) h[n++] = q;
+  return n;
+}
+
+// Expansion arithmetic is exact provided that no product of two components
+// underflows (which would discard low-order bits) and no intermediate value
+// overflows.  Since the predicates computed this way are homogeneous
+// polynomials, their signs do not change when all the input points are scaled by the same
+// positive factor.  This function finds a power of two "shift" such that,
+// after multiplying every coordinate by 2**shift, a polynomial of the given
+// degree can be evaluated exactly.  It returns false if there is no such
+// shift because the nonzero coordinates span too large a range.
+static bool GetExpansionShift(int degree,
+                              std::initializer_list<const S2Point*> points,
+                              int* shift) {
+  double min_abs = std::numeric_limits<double>::infinity(), max_abs = 0;
+  for (const S2Point* p : points) {
+    for (int i = 0; i < 3; ++i) {
+      double x = fabs((*p)[i]);
+      if (x == 0) continue;
+      min_abs = min(min_abs, x);
+      max_abs = max(max_abs, x);
+    }
+  }
+  *shift = 0;
+  if (max_abs == 0) return true;  // All coordinates are zero.
+  int min_exp = std::ilogb(min_abs), max_exp = std::ilogb(max_abs);
+
+  // Every nonzero coordinate is less than 2**(max_exp + 1) in magnitude, and
+  // is an integer multiple of 2**(min_exp - 52).  Therefore every nonzero
+  // intermediate value is an integer multiple of 2**(degree * (min_exp -
+  // 52)), and every product of components is at least this large.  The
+  // intermediate values are bounded by 2**(degree * (max_exp + 1)) times the
+  // sum of the absolute values of the polynomial coefficients, which we
+  // conservatively assume is less than 2**64.  We choose the largest shift that
+  // keeps these values below 2**kMaxExp, and then check that products of
+  // components stay well above the range of denormalized numbers.
+  constexpr int kMaxExp = 900;
+  constexpr int kMinExp = -960;
+  *shift = (kMaxExp - 64) / degree - 1 - max_exp;
+  return degree * (min_exp + *shift - 52) >= kMinExp;
+}
+
+// Returns "p" multiplied by 2**shift, where "shift" was computed by
+// GetExpansionShift() (and therefore the result is exact).
+static S2Point ScalePoint(const S2Point& p, int shift) {
+  return std::ldexp(1.0, shift) * p;
+}
+
+int ExpansionSign(const S2Point& a, const S2Point& b, const S2Point& c) {
+  int shift;
+  if (!GetExpansionShift(3, {&a, &b, &c}, &shift)) return 0;
+
+  // This is the same computation as ExactSign() without the permutations,
+  // i.e. the determinant is a.DotProd(b.CrossProd(c)), except that the
+  // intermediate expansions are kept on the stack.  Each component of the
+  // cross product has at most 4 components, each term of the dot product
+  // has at most 8, and the sum has at most 24.
+  S2Point sa = ScalePoint(a, shift);
+  S2Point sb = ScalePoint(b, shift);
+  S2Point sc = ScalePoint(c, shift);
+  double det[24];
+  int det_n = 0;
+  for (int i = 0; i < 3; ++i) {
+    int j = (i + 1) % 3, k = (i + 2) % 3;
+    double p[2], q[2], minor[4], term[8], sum[24];
+    int pn = ProductExpansion(sb[j], sc[k], p);
+    int qn = ProductExpansion(sb[k], sc[j], q);
+    int minor_n = SumExpansions(p, pn, q, qn, -1, minor);
+    int term_n = ScaleExpansion(minor, minor_n, sa[i], term);
+    det_n = SumExpansions(det, det_n, term, term_n, 1, sum);
+    std::copy(sum, sum + det_n, det);
+  }
+  return (det_n == 0) ? 0 : (det[det_n - 1] > 0) ? 1 : -1;
+}
+
+void BatchTriageSign(const Vector3_d& a_cross_b, const PointArrays& c,
+                     absl::Span<int> signs) {
+  ABSL_DCHECK_EQ(c.y.size(), c.size());
+  ABSL_DCHECK_EQ(c.z.size(), c.size());
+  ABSL_DCHECK_EQ(signs.size(), c.size());
+  // This must match the constant in TriageSign().
+  const double kMaxDetError = 3.6548 * DBL_EPSILON;
+  const double* x = c.x.data();
+  const double* y = c.y.data();
+  const double* z = c.z.data();
+  const size_t n = c.size();
+  size_t i = 0;
+
+  // The vectorized loops compute each determinant using exactly the same
+  // sequence of IEEE operations as Vector3::DotProd() (multiplications
+  // followed by left-to-right additions, without fused multiply-adds), so
+  // that the results are bitwise identical to TriageSign().
+#if defined(__AVX2__)
+  const __m256d nx = _mm256_set1_pd(a_cross_b[0]);
+  const __m256d ny = _mm256_set1_pd(a_cross_b[1]);
+  const __m256d nz = _mm256_set1_pd(a_cross_b[2]);
+  const __m256d max_error = _mm256_set1_pd(kMaxDetError);
+  const __m256d min_error = _mm256_set1_pd(-kMaxDetError);
+  for (; i + 4 <= n; i += 4) {
+    __m256d det = _mm256_mul_pd(nx, _mm256_loadu_pd(x + i));
+    det = _mm256_add_pd(det, _mm256_mul_pd(ny, _mm256_loadu_pd(y + i)));
+    det = _mm256_add_pd(det, _mm256_mul_pd(nz, _mm256_loadu_pd(z + i)));
+    int pos = _mm256_movemask_pd(_mm256_cmp_pd(det, max_error, _CMP_GT_OQ));
+    int neg = _mm256_movemask_pd(_mm256_cmp_pd(det, min_error, _CMP_LT_OQ));
+    for (int k = 0; k < 4; ++k) {
+      signs[i + k] = ((pos >> k) & 1) - ((neg >> k) & 1);
+    }
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  const float64x2_t nx = vdupq_n_f64(a_cross_b[0]);
+  const float64x2_t ny = vdupq_n_f64(a_cross_b[1]);
+  const float64x2_t nz = vdupq_n_f64(a_cross_b[2]);
+  const float64x2_t max_error = vdupq_n_f64(kMaxDetError);
+  const float64x2_t min_error = vdupq_n_f64(-kMaxDetError);
+  for (; i + 2 <= n; i += 2) {
+    float64x2_t det = vmulq_f64(nx, vld1q_f64(x + i));
+    det = vaddq_f64(det, vmulq_f64(ny, vld1q_f64(y + i)));
+    det = vaddq_f64(det, vmulq_f64(nz, vld1q_f64(z + i)));
+    uint64x2_t pos = vcgtq_f64(det, max_error);
+    uint64x2_t neg = vcltq_f64(det, min_error);
+    signs[i] = static_cast<int>(vgetq_lane_u64(pos, 0) & 1) -
+               static_cast<int>(vgetq_lane_u64(neg, 0) & 1);
+    signs[i + 1] = static_cast<int>(vgetq_lane_u64(pos, 1) & 1) -
+                   static_cast<int>(vgetq_lane_u64(neg, 1) & 1);
+  }
+#endif
+  for (; i < n; ++i) {
+    double det = a_cross_b.DotProd(S2Point(x[i], y[i], z[i]));
+    signs[i] = (det > kMaxDetError) - (det < -kMaxDetError);
+  }
+}
+
+void BatchSign(const S2Point& a, const S2Point& b, const PointArrays& c,
+               absl::Span<int> signs) {
+  BatchTriageSign(a.CrossProd(b), c, signs);
+  for (size_t i = 0; i < c.size(); ++i) {
+    if (signs[i] == 0) signs[i] = ExpensiveSign(a, b, c[i]);
+  }
 }
 
 // Compute the determinant in a numerically stable way.  Unlike TriageSign(),
@@ -256,6 +522,9 @@ int ExactSign(const S2Point& a, const S2Point& b, const S2Point& c,
     // sign of the determinant.
     det_sign = SymbolicallyPerturbedSign(xa, xb, xc, xb_cross_xc);
     ABSL_DCHECK_NE(0, det_sign);
+    COUNT_TIER(sign, symbolic);
+  } else {
+    COUNT_TIER(sign, exact);
   }
   return perm_sign * det_sign;
 }
@@ -266,15 +535,18 @@ int ExactSign(const S2Point& a, const S2Point& b, const S2Point& c,
 //
 // Below we define a floating-point type with enough precision so that it can
 // represent the exact determinant of any 3x3 matrix of floating-point
-// numbers.  It uses ExactFloat, which is based on the OpenSSL Bignum library
-// and therefore has a permissive BSD-style license.  (At one time we also
+// numbers.  It uses ExactFloat, which has its own bignum implementation and
+// therefore no external dependencies.  (At one time we also
 // supported an option based on MPFR, but that has an LGPL license and is
 // therefore not suited for some applications.)
 
 int ExpensiveSign(const S2Point& a, const S2Point& b, const S2Point& c,
                   bool perturb) {
   // Return zero if and only if two points are the same.  This ensures (1).
-  if (a == b || b == c || c == a) return 0;
+  if (a == b || b == c || c == a) {
+    COUNT_TIER(sign, triage);
+    return 0;
+  }
 
   // Next we try recomputing the determinant still using floating-point
   // arithmetic but in a more precise way.  This is more expensive than the
@@ -283,13 +555,19 @@ int ExpensiveSign(const S2Point& a, const S2Point& b, const S2Point& c,
   // compute the correct determinant sign in virtually all cases except when
   // the three points are truly collinear (e.g., three points on the equator).
   int det_sign = StableSign(a, b, c);
-  if (det_sign != 0) return det_sign;
-
-  // TODO(ericv): Create a templated version of StableSign so that we can
-  // retry in "long double" precision before falling back to ExactFloat.
+  if (det_sign != 0) {
+    COUNT_TIER(sign, stable);
+    return det_sign;
+  }
 
-  // TODO(ericv): Optimize ExactFloat so that it stores up to 32 bytes of
-  // mantissa inline (without requiring memory allocation).
+  // Next we compute the exact determinant using floating-point expansions,
+  // which is much cheaper than ExactFloat.  This only fails when the exact
+  // determinant is zero or the coordinates have a huge range of exponents.
+  det_sign = ExpansionSign(a, b, c);
+  if (det_sign != 0) {
+    COUNT_TIER(sign, expansion);
+    return det_sign;
+  }
 
   // Otherwise fall back to exact arithmetic and symbolic permutations.
   return ExactSign(a, b, c, perturb);
@@ -432,15 +710,6 @@ int SymbolicCompareDistances(const S2Point& x,
   return (a < b) ? 1 : (a > b) ? -1 : 0;
 }
 
-static int CompareSin2Distances(const S2Point& x,
-                                const S2Point& a, const S2Point& b) {
-  int sign = TriageCompareSin2Distances(x, a, b);
-  if (kHasLongDouble && sign == 0) {
-    sign = TriageCompareSin2Distances(ToLD(x), ToLD(a), ToLD(b));
-  }
-  return sign;
-}
-
 int CompareDistances(const S2Point& x, const S2Point& a, const S2Point& b) {
   // We start by comparing distances using dot products (i.e., cosine of the
   // angle), because (1) this is the cheapest technique, and (2) it is valid
@@ -448,10 +717,16 @@ int CompareDistances(const S2Point& x, const S2Point& a, const S2Point& b) {
   // technique if both angles are less than 90 degrees or both angles are
   // greater than 90 degrees.)
   int sign = TriageCompareCosDistances(x, a, b);
-  if (sign != 0) return sign;
+  if (sign != 0) {
+    COUNT_TIER(compare_distances, triage);
+    return sign;
+  }
 
   // Optimization for (a == b) to avoid falling back to exact arithmetic.
-  if (a == b) return 0;
+  if (a == b) {
+    COUNT_TIER(compare_distances, triage);
+    return 0;
+  }
 
   // It is much better numerically to compare distances using cos(angle) if
   // the distances are near 90 degrees and sin^2(angle) if the distances are
@@ -459,19 +734,29 @@ int CompareDistances(const S2Point& x, const S2Point& a, const S2Point& b) {
   // making this decision because the fact that the test above failed means
   // that angles "a" and "b" are very close together.
   double cos_ax = a.DotProd(x);
-  if (cos_ax > M_SQRT1_2) {
-    // Angles < 45 degrees.
-    sign = CompareSin2Distances(x, a, b);
-  } else if (cos_ax < -M_SQRT1_2) {
-    // Angles > 135 degrees.  sin^2(angle) is decreasing in this range.
-    sign = -CompareSin2Distances(x, a, b);
+  if (fabs(cos_ax) > M_SQRT1_2) {
+    // Angles < 45 degrees or > 135 degrees.  sin^2(angle) is decreasing in
+    // the latter range.
+    sign = TriageCompareSin2Distances(x, a, b);
+    if (sign != 0) {
+      COUNT_TIER(compare_distances, triage);
+    } else if (kHasLongDouble) {
+      sign = TriageCompareSin2Distances(ToLD(x), ToLD(a), ToLD(b));
+      if (sign != 0) COUNT_TIER(compare_distances, long_double);
+    }
+    if (cos_ax < 0) sign = -sign;
   } else if (kHasLongDouble) {
     // We've already tried double precision, so continue with "long double".
     sign = TriageCompareCosDistances(ToLD(x), ToLD(a), ToLD(b));
+    if (sign != 0) COUNT_TIER(compare_distances, long_double);
   }
   if (sign != 0) return sign;
   sign = ExactCompareDistances(ToExact(x), ToExact(a), ToExact(b));
-  if (sign != 0) return sign;
+  if (sign != 0) {
+    COUNT_TIER(compare_distances, exact);
+    return sign;
+  }
+  COUNT_TIER(compare_distances, symbolic);
   return SymbolicCompareDistances(x, a, b);
 }
 
@@ -772,6 +1057,145 @@ int CompareEdgeDistance(const S2Point& x, const S2Point& a0, const S2Point& a1,
   return ExactCompareEdgeDistance(x, a0, a1, r);
 }
 
+// The batch versions of CompareEdgeDistance() use two conservative tests
+// that are cheap to vectorize.  Letting N = (A0 - A1) x (A0 + A1) be the
+// computed edge normal, X is farther than "r" from the great circle through
+// the edge (and therefore from the edge) if
+//
+//   |X.N| > |N| * (sin(r) * (1 + 24 * DBL_ERR) + 32 * DBL_ERR) +
+//           128 * DBL_ERR * DBL_ERR
+//
+// since the error in N is at most (8.2 * |N| + 56 * DBL_ERR) * DBL_ERR (see
+// TriageCompareEdgeDistance), the dot product adds at most 3 * |N| * DBL_ERR,
+// and X is unit length to within 2 * DBL_ERR.  Similarly X is closer than
+// "r" to an endpoint A if
+//
+//   |X-A|^2 * (1 + 16 * DBL_ERR) + 16 * DBL_ERR * |X-A| + 32 * DBL_ERR^2 <
+//   r^2 * (1 - 4 * DBL_ERR)
+//
+// because projecting X and A onto the sphere moves them by at most
+// 2 * DBL_ERR each.  The constants include a safety factor of about 2 to
+// account for rounding errors in evaluating these expressions.
+namespace {
+
+struct EdgeDistanceLimits {
+  explicit EdgeDistanceLimits(S1ChordAngle r) {
+    const double r2 = r.length2();
+    // The great circle test is only valid when r < 90 degrees.
+    line_factor = (r2 >= 0 && r2 < 2)
+                      ? sqrt(r2 * (1 - 0.25 * r2)) * (1 + 24 * DBL_ERR) +
+                            32 * DBL_ERR
+                      : std::numeric_limits<double>::infinity();
+    vertex_limit = r2 * (1 - 4 * DBL_ERR);
+  }
+
+  // Returns +1 or -1 if the tests above decide the comparison, and 0
+  // otherwise.  "n1" is the length of "n".
+  int Triage(double x_dot_n, double n1, double xa0_2, double xa1_2) const {
+    const bool is_far = fabs(x_dot_n) > n1 * line_factor + kLineError;
+    const bool is_near = VertexNear(xa0_2) || VertexNear(xa1_2);
+    return is_near ? -1 : is_far ? 1 : 0;
+  }
+
+  bool VertexNear(double xa2) const {
+    return xa2 * (1 + 16 * DBL_ERR) + 16 * DBL_ERR * sqrt(xa2) +
+               32 * DBL_ERR * DBL_ERR <
+           vertex_limit;
+  }
+
+  static constexpr double kLineError = 128 * DBL_ERR * DBL_ERR;
+  double line_factor;
+  double vertex_limit;
+};
+
+}  // namespace
+
+void BatchCompareEdgeDistance(const PointArrays& x, const S2Point& a0,
+                              const S2Point& a1, S1ChordAngle r,
+                              absl::Span<int> results) {
+  ABSL_DCHECK_EQ(x.y.size(), x.size());
+  ABSL_DCHECK_EQ(x.z.size(), x.size());
+  ABSL_DCHECK_EQ(results.size(), x.size());
+  ABSL_DCHECK_NE(a0, -a1);
+  const EdgeDistanceLimits limits(r);
+  const Vector3_d n = (a0 - a1).CrossProd(a0 + a1);
+  const double n1 = n.Norm();
+  const double* xs = x.x.data();
+  const double* ys = x.y.data();
+  const double* zs = x.z.data();
+  const size_t size = x.size();
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256d nx = _mm256_set1_pd(n[0]);
+  const __m256d ny = _mm256_set1_pd(n[1]);
+  const __m256d nz = _mm256_set1_pd(n[2]);
+  const __m256d line_limit =
+      _mm256_set1_pd(n1 * limits.line_factor + limits.kLineError);
+  const __m256d vertex_limit = _mm256_set1_pd(limits.vertex_limit);
+  const __m256d scale = _mm256_set1_pd(1 + 16 * DBL_ERR);
+  const __m256d sqrt_scale = _mm256_set1_pd(16 * DBL_ERR);
+  const __m256d offset = _mm256_set1_pd(32 * DBL_ERR * DBL_ERR);
+  const __m256d sign_mask = _mm256_set1_pd(-0.0);
+  const __m256d a0x = _mm256_set1_pd(a0[0]), a0y = _mm256_set1_pd(a0[1]),
+                a0z = _mm256_set1_pd(a0[2]);
+  const __m256d a1x = _mm256_set1_pd(a1[0]), a1y = _mm256_set1_pd(a1[1]),
+                a1z = _mm256_set1_pd(a1[2]);
+  const auto vertex_near = [&](__m256d dx, __m256d dy, __m256d dz) {
+    __m256d d2 = _mm256_mul_pd(dx, dx);
+    d2 = _mm256_add_pd(d2, _mm256_mul_pd(dy, dy));
+    d2 = _mm256_add_pd(d2, _mm256_mul_pd(dz, dz));
+    __m256d bound = _mm256_add_pd(
+        _mm256_add_pd(_mm256_mul_pd(d2, scale),
+                      _mm256_mul_pd(sqrt_scale, _mm256_sqrt_pd(d2))),
+        offset);
+    return _mm256_cmp_pd(bound, vertex_limit, _CMP_LT_OQ);
+  };
+  for (; i + 4 <= size; i += 4) {
+    const __m256d px = _mm256_loadu_pd(xs + i);
+    const __m256d py = _mm256_loadu_pd(ys + i);
+    const __m256d pz = _mm256_loadu_pd(zs + i);
+    __m256d dot = _mm256_mul_pd(nx, px);
+    dot = _mm256_add_pd(dot, _mm256_mul_pd(ny, py));
+    dot = _mm256_add_pd(dot, _mm256_mul_pd(nz, pz));
+    const int is_far = _mm256_movemask_pd(_mm256_cmp_pd(
+        _mm256_andnot_pd(sign_mask, dot), line_limit, _CMP_GT_OQ));
+    const int is_near = _mm256_movemask_pd(_mm256_or_pd(
+        vertex_near(_mm256_sub_pd(px, a0x), _mm256_sub_pd(py, a0y),
+                    _mm256_sub_pd(pz, a0z)),
+        vertex_near(_mm256_sub_pd(px, a1x), _mm256_sub_pd(py, a1y),
+                    _mm256_sub_pd(pz, a1z))));
+    for (int k = 0; k < 4; ++k) {
+      results[i + k] = ((is_near >> k) & 1) ? -1 : ((is_far >> k) & 1);
+    }
+  }
+#endif
+  for (; i < size; ++i) {
+    const S2Point p(xs[i], ys[i], zs[i]);
+    results[i] = limits.Triage(p.DotProd(n), n1, (p - a0).Norm2(),
+                               (p - a1).Norm2());
+  }
+  for (i = 0; i < size; ++i) {
+    if (results[i] == 0) results[i] = CompareEdgeDistance(x[i], a0, a1, r);
+  }
+}
+
+void BatchCompareEdgeDistance(const S2Point& x, const PointArrays& a0,
+                              const PointArrays& a1, S1ChordAngle r,
+                              absl::Span<int> results) {
+  ABSL_DCHECK_EQ(a1.size(), a0.size());
+  ABSL_DCHECK_EQ(results.size(), a0.size());
+  const EdgeDistanceLimits limits(r);
+  for (size_t i = 0; i < a0.size(); ++i) {
+    const S2Point p0 = a0[i], p1 = a1[i];
+    const Vector3_d n = (p0 - p1).CrossProd(p0 + p1);
+    results[i] = limits.Triage(x.DotProd(n), n.Norm(), (x - p0).Norm2(),
+                               (x - p1).Norm2());
+  }
+  for (size_t i = 0; i < a0.size(); ++i) {
+    if (results[i] == 0) results[i] = CompareEdgeDistance(x, a0[i], a1[i], r);
+  }
+}
+
 int CompareEdgePairDistance(const S2Point& a0, const S2Point& a1,
                             const S2Point& b0, const S2Point& b1,
                             S1ChordAngle r) {
@@ -1083,6 +1507,32 @@ int CompareEdgeDirections(const S2Point& a0, const S2Point& a1,
                                     ToExact(b0), ToExact(b1));
 }
 
+void BatchCompareEdgeDirections(const S2Point& a0, const S2Point& a1,
+                                const PointArrays& b0, const PointArrays& b1,
+                                absl::Span<int> results) {
+  ABSL_DCHECK_EQ(b1.size(), b0.size());
+  ABSL_DCHECK_EQ(results.size(), b0.size());
+  ABSL_DCHECK_NE(a0, -a1);
+  // This evaluates the same expressions as TriageCompareEdgeDirections().
+  const Vector3_d na = (a0 - a1).CrossProd(a0 + a1);
+  const double na_len = na.Norm();
+  for (size_t i = 0; i < b0.size(); ++i) {
+    const S2Point p0 = b0[i], p1 = b1[i];
+    const Vector3_d nb = (p0 - p1).CrossProd(p0 + p1);
+    const double nb_len = nb.Norm();
+    const double cos_ab = na.DotProd(nb);
+    const double cos_ab_error = ((5 + 4 * sqrt(3)) * na_len * nb_len +
+                                 32 * sqrt(3) * DBL_ERR * (na_len + nb_len)) *
+                                DBL_ERR;
+    results[i] = (cos_ab > cos_ab_error) - (cos_ab < -cos_ab_error);
+  }
+  for (size_t i = 0; i < b0.size(); ++i) {
+    if (results[i] == 0) {
+      results[i] = CompareEdgeDirections(a0, a1, b0[i], b1[i]);
+    }
+  }
+}
+
 // If triangle ABC has positive sign, returns its circumcenter.  If ABC has
 // negative sign, returns the negated circumcenter.
 template <class T>
@@ -1324,22 +1774,35 @@ int EdgeCircumcenterSign(const S2Point& x0, const S2Point& x1,
 
   int abc_sign = Sign(a, b, c);
   int sign = TriageEdgeCircumcenterSign(x0, x1, a, b, c, abc_sign);
-  if (sign != 0) return sign;
+  if (sign != 0) {
+    COUNT_TIER(edge_circumcenter_sign, triage);
+    return sign;
+  }
 
   // Optimization for the cases that are going to return zero anyway, in order
   // to avoid falling back to exact arithmetic.
-  if (x0 == x1 || a == b || b == c || c == a) return 0;
+  if (x0 == x1 || a == b || b == c || c == a) {
+    COUNT_TIER(edge_circumcenter_sign, triage);
+    return 0;
+  }
   if (kHasLongDouble) {
     sign = TriageEdgeCircumcenterSign(
         ToLD(x0), ToLD(x1), ToLD(a), ToLD(b), ToLD(c), abc_sign);
-    if (sign != 0) return sign;
+    if (sign != 0) {
+      COUNT_TIER(edge_circumcenter_sign, long_double);
+      return sign;
+    }
   }
   sign = ExactEdgeCircumcenterSign(
       ToExact(x0), ToExact(x1), ToExact(a), ToExact(b), ToExact(c), abc_sign);
-  if (sign != 0) return sign;
+  if (sign != 0) {
+    COUNT_TIER(edge_circumcenter_sign, exact);
+    return sign;
+  }
 
   // Unlike the other methods, SymbolicEdgeCircumcenterSign does not depend
   // on the sign of triangle ABC.
+  COUNT_TIER(edge_circumcenter_sign, symbolic);
   return SymbolicEdgeCircumcenterSign(x0, x1, a, b, c);
 }
 
@@ -49,12 +49,15 @@
 
 #include <cfloat>
 #include <cmath>
+#include <cstddef>
 #include <iosfwd>
 #include <ostream>
 
 #include "absl/flags/flag.h"
 #include "absl/log/absl_check.h"
+#include "absl/types/span.h"
 #include "s2/_fp_contract_off.h"
+#include "s2/base/types.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s2debug.h"
 #include "s2/s2point.h"
@@ -86,6 +89,32 @@ namespace s2pred {
 // involving antipodal points.
 int Sign(const S2Point& a, const S2Point& b, const S2Point& c);
 
+// A read-only view of points stored in structure-of-arrays layout, as used
+// by the batch predicates below.  Point i is (x[i], y[i], z[i]).
+//
+// REQUIRES: x.size() == y.size() == z.size()
+struct PointArrays {
+  absl::Span<const double> x, y, z;
+
+  size_t size() const { return x.size(); }
+  S2Point operator[](size_t i) const { return S2Point(x[i], y[i], z[i]); }
+
+  // Returns the points [pos, pos + len).
+  PointArrays subspan(size_t pos, size_t len) const {
+    return {x.subspan(pos, len), y.subspan(pos, len), z.subspan(pos, len)};
+  }
+};
+
+// Sets signs[i] = Sign(a, b, c[i]) for all points in "c".  This is faster
+// than calling Sign() in a loop because the fast double-precision test is
+// vectorized (using AVX2 or NEON when available).  Only points where that
+// test is uncertain are passed to ExpensiveSign(), so the results are
+// always identical to Sign().
+//
+// REQUIRES: signs.size() == c.size()
+void BatchSign(const S2Point& a, const S2Point& b, const PointArrays& c,
+               absl::Span<int> signs);
+
 // Given 4 points on the unit sphere, return true if the edges OA, OB, and
 // OC are encountered in that order while sweeping CCW around the point O.
 // You can think of this as testing whether A <= B <= C with respect to the
@@ -134,6 +163,27 @@ int CompareDistance(const S2Point& x, const S2Point& y, S1ChordAngle r);
 int CompareEdgeDistance(const S2Point& x, const S2Point& a0, const S2Point& a1,
                         S1ChordAngle r);
 
+// Sets results[i] = CompareEdgeDistance(x[i], a0, a1, r) for all points in
+// "x".  This is faster than calling CompareEdgeDistance() in a loop because
+// the quantities that depend only on the edge are computed once, and a
+// vectorized test first decides the points that are clearly farther than "r"
+// from the great circle through the edge or clearly closer than "r" to one
+// of its endpoints.  The remaining points are passed to
+// CompareEdgeDistance(), so the results are always identical to it.
+//
+// REQUIRES: results.size() == x.size()
+void BatchCompareEdgeDistance(const PointArrays& x, const S2Point& a0,
+                              const S2Point& a1, S1ChordAngle r,
+                              absl::Span<int> results);
+
+// Sets results[i] = CompareEdgeDistance(x, a0[i], a1[i], r) for all edges
+// (a0[i], a1[i]), using the same test as the method above.
+//
+// REQUIRES: a0.size() == a1.size() == results.size()
+void BatchCompareEdgeDistance(const S2Point& x, const PointArrays& a0,
+                              const PointArrays& a1, S1ChordAngle r,
+                              absl::Span<int> results);
+
 // Returns -1, 0, or +1 according to whether the distance from edge A edge B
 // is less than, equal to, or greater than "r" respectively.  Distances are
 // measured with respect the positions of all points as though they were
@@ -164,6 +214,15 @@ int CompareEdgePairDistance(const S2Point& a0, const S2Point& a1,
 int CompareEdgeDirections(const S2Point& a0, const S2Point& a1,
                           const S2Point& b0, const S2Point& b1);
 
+// Sets results[i] = CompareEdgeDirections(a0, a1, b0[i], b1[i]) for all
+// edges (b0[i], b1[i]).  The normal of edge A is computed only once, and
+// the results are identical to CompareEdgeDirections().
+//
+// REQUIRES: b0.size() == b1.size() == results.size()
+void BatchCompareEdgeDirections(const S2Point& a0, const S2Point& a1,
+                                const PointArrays& b0, const PointArrays& b1,
+                                absl::Span<int> results);
+
 // Computes the exact sign of the dot product between A and B.
 //
 // REQUIRES: |a|^2 <= 2 and |b|^2 <= 2
@@ -342,6 +401,15 @@ inline int Sign(const S2Point& a, const S2Point& b, const S2Point& c,
 inline int TriageSign(const S2Point& a, const S2Point& b,
                       const S2Point& c, const Vector3_d& a_cross_b);
 
+// Sets signs[i] = TriageSign(a, b, c[i], a_cross_b) for all points in "c"
+// (i.e., uncertain results are zero).  Note that "a" and "b" are not needed
+// since TriageSign() only uses their cross product.
+//
+// REQUIRES: a_cross_b == a.CrossProd(b)
+// REQUIRES: signs.size() == c.size()
+void BatchTriageSign(const Vector3_d& a_cross_b, const PointArrays& c,
+                     absl::Span<int> signs);
+
 // This function is invoked by Sign() if the sign of the determinant is
 // uncertain.  It always returns a non-zero result unless two of the input
 // points are the same.  It uses a combination of multiple-precision
@@ -360,6 +428,41 @@ inline int TriageSign(const S2Point& a, const S2Point& b,
 int ExpensiveSign(const S2Point& a, const S2Point& b,
                   const S2Point& c, bool perturb = true);
 
+// Counts of how often each arithmetic tier resolved a predicate.  Uncertain
+// cases are retried with progressively more expensive methods: a fast
+// double-precision test ("triage"), a numerically stable double-precision
+// formula, "long double" arithmetic (on platforms where it is more precise
+// than "double"), floating-point expansions, ExactFloat, and finally symbolic
+// perturbations.  Not every predicate uses every tier: only Sign() has the
+// "stable" and "expansion" tiers, and Sign() does not use "long double".
+// Cases that are decided without any arithmetic (e.g., because two arguments
+// are equal) are counted as triage.
+struct PredicateTierCounts {
+  int64 triage = 0;
+  int64 stable = 0;
+  int64 long_double = 0;
+  int64 expansion = 0;
+  int64 exact = 0;
+  int64 symbolic = 0;
+};
+
+// Statistics for the most frequently used predicates.  "sign" counts
+// calls to the three-argument Sign() and to ExpensiveSign(); cases resolved
+// by calling TriageSign() directly (as S2EdgeCrosser and the four-argument
+// Sign() do) are not counted, so that the inlined fast path is not slowed
+// down.
+struct PredicateStats {
+  PredicateTierCounts sign;
+  PredicateTierCounts compare_distances;
+  PredicateTierCounts edge_circumcenter_sign;
+};
+
+// Returns the statistics for predicates evaluated by the calling thread since
+// it started or since ResetPredicateStats() was last called.  (Counters are
+// kept per thread so that concurrent queries do not contend for them.)
+PredicateStats GetPredicateStats();
+void ResetPredicateStats();
+
 //////////////////   Implementation details follow   ////////////////////
 
 inline int Sign(const S2Point& a, const S2Point& b, const S2Point& c,
@@ -79,6 +79,18 @@ inline static bool IsZero(const Vector3_xf& a) {
 
 int StableSign(const S2Point& a, const S2Point& b, const S2Point& c);
 
+// Returns the sign of the same determinant as ExactSign() (without symbolic
+// perturbations), computed exactly using floating-point expansions, i.e.
+// unevaluated sums of non-overlapping doubles.  This is several times
+// cheaper than ExactFloat.  Returns 0 if the determinant is exactly zero, or
+// if the input coordinates span too large a range of exponents for the
+// expansion arithmetic to be exact.
+//
+// Reference:
+//   "Adaptive Precision Floating-Point Arithmetic and Fast Robust Geometric
+//   Predicates" (Shewchuk, Discrete & Computational Geometry, 1997).
+int ExpansionSign(const S2Point& a, const S2Point& b, const S2Point& c);
+
 int ExactSign(const S2Point& a, const S2Point& b, const S2Point& c,
               bool perturb);
 
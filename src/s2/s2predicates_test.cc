@@ -35,6 +35,7 @@
 #include "absl/log/absl_log.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 
 #include "s2/base/commandlineflags.h"
 #include "s2/s1angle.h"
@@ -138,10 +139,45 @@ TEST(Sign, StableSignUnderflow) {
   S2Point c(1, 3.8163353663361477e-142, 1.4628419538608985e-131);
 
   EXPECT_EQ(StableSign(a, b, c), 0);
+  EXPECT_EQ(ExpansionSign(a, b, c), 1);
   EXPECT_EQ(ExactSign(a, b, c, true), 1);
   EXPECT_EQ(Sign(a, b, c), 1);
 }
 
+TEST(Sign, ExpansionSignFailsForHugeExponentRange) {
+  // ExpansionSign() returns zero (falling back to ExactFloat) when the input
+  // coordinates span too large a range of exponents to be represented
+  // exactly by expansions of doubles.
+  S2Point a(1, 1e-200, 1e-300);
+  S2Point b(1, 1e-300, 1e-200);
+  S2Point c(1, 0, 0);
+  EXPECT_EQ(ExpansionSign(a, b, c), 0);
+  EXPECT_EQ(Sign(a, b, c), ExactSign(a, b, c, true));
+}
+
+TEST(Sign, PredicateStats) {
+  ResetPredicateStats();
+  S2Point a(0.72571927877036835, 0.46058825605889098, 0.51106749730504852);
+  S2Point b(0.7257192746638208, 0.46058826573818168, 0.51106749441312738);
+  S2Point c(0.72571927671709457, 0.46058826089853633, 0.51106749585908795);
+  EXPECT_EQ(Sign(S2Point(1, 0, 0), S2Point(0, 1, 0), S2Point(0, 0, 1)), 1);
+  Sign(a, b, c);  // Exactly collinear, requires symbolic perturbations.
+  PredicateStats stats = GetPredicateStats();
+  EXPECT_EQ(stats.sign.triage, 1);
+  EXPECT_EQ(stats.sign.symbolic, 1);
+  EXPECT_EQ(stats.sign.stable + stats.sign.expansion + stats.sign.exact, 0);
+
+  // A point is equidistant from itself and itself.
+  EXPECT_EQ(CompareDistances(a, b, b), 0);
+  EXPECT_EQ(GetPredicateStats().compare_distances.triage, 1);
+
+  ResetPredicateStats();
+  stats = GetPredicateStats();
+  EXPECT_EQ(stats.sign.triage, 0);
+  EXPECT_EQ(stats.sign.symbolic, 0);
+  EXPECT_EQ(stats.compare_distances.triage, 0);
+}
+
 // This test repeatedly constructs some number of points that are on or nearly
 // on a given great circle.  Then it chooses one of these points as the
 // "origin" and sorts the other points in CCW order around it.  Of course,
@@ -369,6 +405,34 @@ TEST_F(SignTest, StressTest) {
   }
 }
 
+TEST_F(SignTest, BatchSignMatchesSign) {
+  // Use points near a great circle so that many determinants are uncertain
+  // and need to be resolved by ExpensiveSign().  The number of points is not
+  // a multiple of the vector width so that the scalar tail is also tested.
+  vector<S2Point> points = {S2Point(1, 0, 0), S2Point(0, 1, 0)};
+  while (points.size() < 30) AddDegeneracy(&points);
+  points.erase(std::remove(points.begin(), points.end(), S2Point(0, 0, 0)),
+               points.end());
+  for (int i = 0; i < 7; ++i) points.push_back(S2Testing::RandomPoint());
+
+  vector<double> x, y, z;
+  for (const S2Point& p : points) {
+    x.push_back(p.x());
+    y.push_back(p.y());
+    z.push_back(p.z());
+  }
+  s2pred::PointArrays c{x, y, z};
+  vector<int> signs(points.size());
+  for (const S2Point& a : points) {
+    for (const S2Point& b : points) {
+      s2pred::BatchSign(a, b, c, absl::MakeSpan(signs));
+      for (int i = 0; i < points.size(); ++i) {
+        ASSERT_EQ(Sign(a, b, points[i]), signs[i]);
+      }
+    }
+  }
+}
+
 class StableSignTest : public testing::Test {
  protected:
   // Estimate the probability that S2::StableSign() will not be able to compute
@@ -384,6 +448,10 @@ class StableSignTest : public testing::Test {
       S2Point b = (a - m * x).Normalize();
       S2Point c = (a + m * x).Normalize();
       int sign = s2pred::StableSign(a, b, c);
+      int expansion_sign = s2pred::ExpansionSign(a, b, c);
+      if (expansion_sign != 0) {
+        EXPECT_EQ(s2pred::ExactSign(a, b, c, false), expansion_sign);
+      }
       if (sign != 0) {
         EXPECT_EQ(s2pred::ExactSign(a, b, c, true), sign);
       } else {
@@ -1026,6 +1094,83 @@ TEST(CompareEdgeDistance, Consistency) {
   ABSL_LOG(ERROR) << stats.ToString();
 }
 
+// Returns the given points in structure-of-arrays layout.
+struct TestPointArrays {
+  explicit TestPointArrays(const vector<S2Point>& points) {
+    for (const S2Point& p : points) {
+      x.push_back(p.x());
+      y.push_back(p.y());
+      z.push_back(p.z());
+    }
+  }
+  s2pred::PointArrays arrays() const { return {x, y, z}; }
+  vector<double> x, y, z;
+};
+
+TEST(CompareEdgeDistance, BatchMatchesCompareEdgeDistance) {
+  // Like the consistency test above, this chooses points whose distance to
+  // the edge is very close to "r", together with points near the endpoints
+  // and random points.  The number of points is not a multiple of the vector
+  // width so that the scalar tail is also tested.
+  auto& rnd = S2Testing::rnd;
+  for (int iter = 0; iter < 300; ++iter) {
+    rnd.Reset(iter + 1);
+    S2Point a0 = ChoosePoint();
+    S1Angle len = S1Angle::Radians(M_PI * pow(1e-20, rnd.RandDouble()));
+    S2Point a1 = S2::GetPointOnLine(a0, ChoosePoint(), len);
+    if (rnd.OneIn(2)) a1 = -a1;
+    if (a0 == -a1) continue;  // Not allowed by API.
+    S2Point n = S2::RobustCrossProd(a0, a1).Normalize();
+    S1Angle r = S1Angle::Radians(M_PI_2 * pow(1e-20, rnd.RandDouble()));
+    if (rnd.OneIn(4)) r = S1Angle::Radians(M_PI_2) - r;
+    vector<S2Point> points, edges0, edges1;
+    for (int i = 0; i < 23; ++i) {
+      double f = rnd.OneIn(2) ? pow(1e-20, rnd.RandDouble()) : rnd.RandDouble();
+      S2Point a = ((1 - f) * a0 + f * a1).Normalize();
+      double delta = (rnd.RandDouble() - 0.5) * pow(1e-15, rnd.RandDouble());
+      S1Angle d = r * (1 + delta);
+      if (rnd.OneIn(2)) d = -d;
+      points.push_back(S2::GetPointOnLine(a, n, d));
+    }
+    for (int i = 0; i < 6; ++i) {
+      const S2Point& a = rnd.OneIn(2) ? a0 : a1;
+      points.push_back(
+          S2::GetPointOnLine(a, ChoosePoint(), r * rnd.RandDouble() * 1.01));
+    }
+    points.push_back(a0);
+    for (int i = 0; i < 7; ++i) points.push_back(ChoosePoint());
+
+    S1ChordAngle chord_r(r);
+    vector<int> results(points.size());
+    s2pred::BatchCompareEdgeDistance(TestPointArrays(points).arrays(), a0, a1,
+                                     chord_r, absl::MakeSpan(results));
+    for (int i = 0; i < points.size(); ++i) {
+      ASSERT_EQ(CompareEdgeDistance(points[i], a0, a1, chord_r), results[i])
+          << iter << " " << i;
+    }
+
+    // Now test one point against edges that are all nearly at distance "r".
+    const S2Point& x = points[0];
+    for (int i = 0; i < points.size(); ++i) {
+      // Each edge is the original edge translated so that "x" has
+      // approximately the same position relative to it as points[i].
+      S2Point b0 = x + (a0 - points[i]), b1 = x + (a1 - points[i]);
+      if (b0 == -b1) continue;
+      edges0.push_back(b0.Normalize());
+      edges1.push_back(b1.Normalize());
+    }
+    results.resize(edges0.size());
+    s2pred::BatchCompareEdgeDistance(x, TestPointArrays(edges0).arrays(),
+                                     TestPointArrays(edges1).arrays(), chord_r,
+                                     absl::MakeSpan(results));
+    for (int i = 0; i < edges0.size(); ++i) {
+      ASSERT_EQ(CompareEdgeDistance(x, edges0[i], edges1[i], chord_r),
+                results[i])
+          << iter << " " << i;
+    }
+  }
+}
+
 TEST(CompareEdgePairDistance, Coverage) {
   // Since CompareEdgePairDistance() is implemented using other predicates, we
   // only test to verify that those predicates are being used correctly.
@@ -1359,6 +1504,38 @@ TEST(CompareEdgeDirections, Consistency) {
   ABSL_LOG(ERROR) << stats.ToString();
 }
 
+TEST(CompareEdgeDirections, BatchMatchesCompareEdgeDirections) {
+  // Edge B is nearly perpendicular to edge A in most cases.
+  auto& rnd = S2Testing::rnd;
+  for (int iter = 0; iter < 300; ++iter) {
+    rnd.Reset(iter + 1);
+    S2Point a0 = ChoosePoint();
+    S1Angle a_len = S1Angle::Radians(M_PI * pow(1e-20, rnd.RandDouble()));
+    S2Point a1 = S2::GetPointOnLine(a0, ChoosePoint(), a_len);
+    if (a0 == -a1) continue;  // Not allowed by API.
+    S2Point a_norm = S2::RobustCrossProd(a0, a1).Normalize();
+    vector<S2Point> b0, b1;
+    for (int i = 0; i < 19; ++i) {
+      S2Point p0 = ChoosePoint();
+      S1Angle b_len = S1Angle::Radians(M_PI * pow(1e-20, rnd.RandDouble()));
+      S2Point p1 = S2::GetPointOnLine(
+          p0, rnd.OneIn(5) ? ChoosePoint() : a_norm, b_len);
+      if (p0 == -p1) continue;
+      b0.push_back(p0);
+      b1.push_back(p1);
+    }
+    b0.push_back(a0);  // A degenerate edge.
+    b1.push_back(a0);
+    vector<int> results(b0.size());
+    s2pred::BatchCompareEdgeDirections(a0, a1, TestPointArrays(b0).arrays(),
+                                       TestPointArrays(b1).arrays(),
+                                       absl::MakeSpan(results));
+    for (int i = 0; i < b0.size(); ++i) {
+      ASSERT_EQ(CompareEdgeDirections(a0, a1, b0[i], b1[i]), results[i]);
+    }
+  }
+}
+
 // Verifies that EdgeCircumcenterSign(x0, x1, a, b, c) == expected_sign, and
 // furthermore checks that the minimum required precision is "expected_prec".
 void TestEdgeCircumcenterSign(
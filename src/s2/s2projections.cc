@@ -17,17 +17,87 @@
 
 #include "s2/s2projections.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 
+#include "absl/base/casts.h"
+#include "absl/log/absl_check.h"
+#include "absl/types/span.h"
 #include "s2/r2.h"
 #include "s2/s1angle.h"
 #include "s2/s2latlng.h"
 #include "s2/s2point.h"
+#include "s2/s2point_span.h"
 
+using absl::Span;
 using std::fabs;
 
 namespace S2 {
 
+namespace {
+
+// The approximations below are written without branches or library calls so
+// that loops calling them can be vectorized.  Each is accurate to within a
+// few ulps, which is what kApproxProjectionError accounts for.
+
+// Returns atan(a) for 0 <= a <= 1.  Arguments larger than tan(Pi/12) are
+// reduced using atan(a) = Pi/6 + atan((a * sqrt(3) - 1) / (a + sqrt(3))),
+// after which the first 14 terms of the Taylor series have a truncation
+// error below 1e-18.
+inline double AtanUnit(double a) {
+  constexpr double kTanPi12 = 0.26794919243112270;
+  constexpr double kSqrt3 = 1.7320508075688772;
+  constexpr double kCoeffs[] = {
+    1.0,       -1.0 / 3,  1.0 / 5,  -1.0 / 7,  1.0 / 9,  -1.0 / 11,
+    1.0 / 13,  -1.0 / 15, 1.0 / 17, -1.0 / 19, 1.0 / 21, -1.0 / 23,
+    1.0 / 25,  -1.0 / 27,
+  };
+  const bool reduce = a > kTanPi12;
+  const double t = reduce ? (a * kSqrt3 - 1) / (a + kSqrt3) : a;
+  const double t2 = t * t;
+  double sum = kCoeffs[13];
+  for (int k = 12; k >= 0; --k) sum = sum * t2 + kCoeffs[k];
+  return (reduce ? M_PI / 6 : 0.0) + t * sum;
+}
+
+// Like atan2(y, x), except that -0.0 arguments must be normalized to +0.0
+// by the caller (as S2LatLng does).
+inline double Atan2Approx(double y, double x) {
+  const double ax = fabs(x), ay = fabs(y);
+  const double hi = std::max(ax, ay), lo = std::min(ax, ay);
+  double r = AtanUnit(hi > 0 ? lo / hi : 0.0);
+  r = (ay > ax) ? M_PI_2 - r : r;
+  r = std::signbit(x) ? M_PI - r : r;
+  return std::copysign(r, y);
+}
+
+// Returns log(x) for finite x > 0.  The argument is split into m * 2**e with
+// m in [sqrt(1/2), sqrt(2)), and log(m) = 2 * atanh((m - 1) / (m + 1)) is
+// evaluated using the first 11 terms of its Taylor series (which have a
+// truncation error below 1e-18).
+inline double LogApprox(double x) {
+  constexpr uint64_t kMantissaMask = (uint64_t{1} << 52) - 1;
+  constexpr uint64_t kExponentOne = uint64_t{1023} << 52;
+  constexpr double kCoeffs[] = {
+    1.0,      1.0 / 3,  1.0 / 5,  1.0 / 7,  1.0 / 9,  1.0 / 11,
+    1.0 / 13, 1.0 / 15, 1.0 / 17, 1.0 / 19, 1.0 / 21,
+  };
+  const uint64_t bits = absl::bit_cast<uint64_t>(x);
+  double e = static_cast<double>(static_cast<int64_t>(bits >> 52) - 1023);
+  double m = absl::bit_cast<double>((bits & kMantissaMask) | kExponentOne);
+  const bool halve = m > M_SQRT2;
+  m = halve ? 0.5 * m : m;
+  e = halve ? e + 1 : e;
+  const double u = (m - 1) / (m + 1);
+  const double u2 = u * u;
+  double sum = kCoeffs[10];
+  for (int k = 9; k >= 0; --k) sum = sum * u2 + kCoeffs[k];
+  return e * M_LN2 + 2 * u * sum;
+}
+
+}  // namespace
+
 R2Point Projection::WrapDestination(const R2Point& a, const R2Point& b) const {
   R2Point wrap = wrap_distance();
   double x = b.x(), y = b.y();
@@ -41,6 +111,18 @@ R2Point Projection::WrapDestination(const R2Point& a, const R2Point& b) const {
   return R2Point(x, y);
 }
 
+void Projection::ProjectPoints(S2PointSpan points,
+                               Span<R2Point> result) const {
+  ABSL_DCHECK_EQ(points.size(), result.size());
+  for (int i = 0; i < points.size(); ++i) result[i] = Project(points[i]);
+}
+
+void Projection::UnprojectPoints(Span<const R2Point> points,
+                                 Span<S2Point> result) const {
+  ABSL_DCHECK_EQ(points.size(), result.size());
+  for (int i = 0; i < points.size(); ++i) result[i] = Unproject(points[i]);
+}
+
 // Default implementation, suitable for any projection where edges are defined
 // as straight lines in the 2D projected space.
 R2Point Projection::Interpolate(double f,
@@ -76,6 +158,37 @@ R2Point PlateCarreeProjection::wrap_distance() const {
   return R2Point(x_wrap_, 0);
 }
 
+// The overrides below call the non-virtual implementations directly.
+void PlateCarreeProjection::ProjectPoints(S2PointSpan points,
+                                          Span<R2Point> result) const {
+  ABSL_DCHECK_EQ(points.size(), result.size());
+  for (int i = 0; i < points.size(); ++i) {
+    result[i] = PlateCarreeProjection::Project(points[i]);
+  }
+}
+
+void PlateCarreeProjection::UnprojectPoints(Span<const R2Point> points,
+                                            Span<S2Point> result) const {
+  ABSL_DCHECK_EQ(points.size(), result.size());
+  for (int i = 0; i < points.size(); ++i) {
+    result[i] = PlateCarreeProjection::Unproject(points[i]);
+  }
+}
+
+void PlateCarreeProjection::ProjectPointsApprox(S2PointSpan points,
+                                                Span<R2Point> result) const {
+  ABSL_DCHECK_EQ(points.size(), result.size());
+  const double scale = from_radians_;
+  for (int i = 0; i < points.size(); ++i) {
+    // See S2LatLng::Latitude() and S2LatLng::Longitude().
+    const S2Point& p = points[i];
+    const double r = sqrt(p[0] * p[0] + p[1] * p[1]);
+    const double lat = Atan2Approx(p[2] + 0.0, r);
+    const double lng = Atan2Approx(p[1] + 0.0, p[0] + 0.0);
+    result[i] = R2Point(scale * lng, scale * lat);
+  }
+}
+
 MercatorProjection::MercatorProjection(double max_x)
     : x_wrap_(2 * max_x),
       to_radians_(M_PI / max_x),
@@ -110,4 +223,38 @@ R2Point MercatorProjection::wrap_distance() const {
   return R2Point(x_wrap_, 0);
 }
 
+void MercatorProjection::ProjectPoints(S2PointSpan points,
+                                       Span<R2Point> result) const {
+  ABSL_DCHECK_EQ(points.size(), result.size());
+  for (int i = 0; i < points.size(); ++i) {
+    result[i] = MercatorProjection::Project(points[i]);
+  }
+}
+
+void MercatorProjection::UnprojectPoints(Span<const R2Point> points,
+                                         Span<S2Point> result) const {
+  ABSL_DCHECK_EQ(points.size(), result.size());
+  for (int i = 0; i < points.size(); ++i) {
+    result[i] = MercatorProjection::Unproject(points[i]);
+  }
+}
+
+void MercatorProjection::ProjectPointsApprox(S2PointSpan points,
+                                             Span<R2Point> result) const {
+  ABSL_DCHECK_EQ(points.size(), result.size());
+  const double scale = from_radians_;
+  for (int i = 0; i < points.size(); ++i) {
+    // Rather than 0.5 * log((1 + sin(lat)) / (1 - sin(lat))), which loses
+    // accuracy near the poles, we use the equivalent asinh(z / r) =
+    // log((|z| + |p|) / r) where "r" is the distance from the polar axis.
+    const S2Point& p = points[i];
+    const double z = p[2] + 0.0;
+    const double r = sqrt(p[0] * p[0] + p[1] * p[1]);
+    const double ratio = (fabs(z) + sqrt(r * r + z * z)) / r;
+    const double y = ratio < HUGE_VAL ? LogApprox(ratio) : HUGE_VAL;
+    const double lng = Atan2Approx(p[1] + 0.0, p[0] + 0.0);
+    result[i] = R2Point(scale * lng, scale * std::copysign(y, z));
+  }
+}
+
 }  // namespace S2
@@ -22,11 +22,14 @@
 #ifndef S2_S2PROJECTIONS_H_
 #define S2_S2PROJECTIONS_H_
 
+#include <cfloat>
 #include <cmath>
 
+#include "absl/types/span.h"
 #include "s2/r2.h"
 #include "s2/s2latlng.h"
 #include "s2/s2point.h"
+#include "s2/s2point_span.h"
 
 namespace S2 {
 
@@ -54,6 +57,17 @@ class Projection {
   // implementation may be more efficient.
   virtual S2LatLng ToLatLng(const R2Point& p) const = 0;
 
+  // Projects every point of "points" and stores the results in "result",
+  // which must have the same size.  This is equivalent to calling Project()
+  // on each point, but projections may override it to avoid per-point
+  // virtual dispatch and to convert many points at once.
+  virtual void ProjectPoints(S2PointSpan points,
+                             absl::Span<R2Point> result) const;
+
+  // Like ProjectPoints(), but calls Unproject() on each point.
+  virtual void UnprojectPoints(absl::Span<const R2Point> points,
+                               absl::Span<S2Point> result) const;
+
   // Returns the point obtained by interpolating the given fraction of the
   // distance along the line from A to B.  Almost all projections should
   // use the default implementation of this method, which simply interpolates
@@ -93,6 +107,10 @@ class Projection {
   R2Point WrapDestination(const R2Point& a, const R2Point& b) const;
 };
 
+// The maximum error of the ProjectPointsApprox() methods below (see their
+// comments for how it is measured).
+constexpr double kApproxProjectionError = 8 * DBL_EPSILON;
+
 // PlateCarreeProjection defines the "plate carree" (square plate) projection,
 // which converts points on the sphere to (longitude, latitude) pairs.
 // Coordinates can be scaled so that they represent radians, degrees, etc, but
@@ -117,6 +135,18 @@ class PlateCarreeProjection final : public Projection {
   R2Point FromLatLng(const S2LatLng& ll) const override;
   S2LatLng ToLatLng(const R2Point& p) const override;
   R2Point wrap_distance() const override;
+  void ProjectPoints(S2PointSpan points,
+                     absl::Span<R2Point> result) const override;
+  void UnprojectPoints(absl::Span<const R2Point> points,
+                       absl::Span<S2Point> result) const override;
+
+  // Like ProjectPoints(), but computes latitudes and longitudes using
+  // branch-free polynomial approximations rather than calls to atan2(),
+  // which allows the compiler to vectorize them.  When converted to radians,
+  // each coordinate is within kApproxProjectionError * max(1, |coordinate|)
+  // of its exact value.
+  void ProjectPointsApprox(S2PointSpan points,
+                           absl::Span<R2Point> result) const;
 
  private:
   double x_wrap_;
@@ -150,6 +180,20 @@ class MercatorProjection final : public Projection {
   R2Point FromLatLng(const S2LatLng& ll) const override;
   S2LatLng ToLatLng(const R2Point& p) const override;
   R2Point wrap_distance() const override;
+  void ProjectPoints(S2PointSpan points,
+                     absl::Span<R2Point> result) const override;
+  void UnprojectPoints(absl::Span<const R2Point> points,
+                       absl::Span<S2Point> result) const override;
+
+  // Like ProjectPoints(), but computes longitudes and "y" coordinates using
+  // branch-free polynomial approximations of atan2() and log() rather than
+  // library calls, which allows the compiler to vectorize them.  When
+  // converted to radians, each coordinate is within kApproxProjectionError *
+  // max(1, |coordinate|) of its exact value.  (Near the poles this is
+  // usually more accurate than Project(); the poles themselves still yield
+  // infinite "y" values.)
+  void ProjectPointsApprox(S2PointSpan points,
+                           absl::Span<R2Point> result) const;
 
  private:
   double x_wrap_;
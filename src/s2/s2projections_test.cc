@@ -17,14 +17,19 @@
 
 #include "s2/s2projections.h"
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
 #include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
+#include "absl/types/span.h"
 #include "s2/r2.h"
 #include "s2/s2latlng.h"
 #include "s2/s2point.h"
 #include "s2/s2pointutil.h"
+#include "s2/s2testing.h"
 
 namespace S2 {
 
@@ -78,4 +83,85 @@ TEST(MercatorProjection, ProjectUnproject) {
                        S2LatLng::FromRadians(1, 0).ToPoint());
 }
 
+// Returns random points, including many near the poles, the equator, and
+// the 180 degree meridian, plus a few points where Project() is exact.
+std::vector<S2Point> GetProjectionTestPoints() {
+  std::vector<S2Point> points = {
+      S2Point(1, 0, 0), S2Point(-1, 0, 0), S2Point(0, 1, 0),
+      S2Point(0, -1, 0), S2Point(0, 0, 1), S2Point(0, 0, -1),
+      S2Point(-1, -0.0, 0), S2Point(-0.0, 0, -1)};
+  S2Testing::Random* rnd = &S2Testing::rnd;
+  for (int i = 0; i < 10000; ++i) {
+    S2Point p = S2Testing::RandomPoint();
+    int axis = rnd->Uniform(4);
+    if (axis < 3) p[axis] *= std::pow(10.0, -rnd->Uniform(18));
+    points.push_back(p.Normalize());
+  }
+  return points;
+}
+
+template <class Proj>
+void TestProjectPoints(const Proj& proj) {
+  std::vector<S2Point> points = GetProjectionTestPoints();
+  std::vector<R2Point> projected(points.size());
+  proj.ProjectPoints(points, absl::MakeSpan(projected));
+  std::vector<S2Point> unprojected(points.size());
+  proj.UnprojectPoints(projected, absl::MakeSpan(unprojected));
+  for (int i = 0; i < points.size(); ++i) {
+    EXPECT_EQ(proj.Project(points[i]), projected[i]);
+    EXPECT_EQ(proj.Unproject(projected[i]), unprojected[i]);
+  }
+}
+
+TEST(PlateCarreeProjection, ProjectPoints) {
+  TestProjectPoints(PlateCarreeProjection(180));
+}
+
+TEST(MercatorProjection, ProjectPoints) {
+  TestProjectPoints(MercatorProjection(180));
+}
+
+// Checks that "actual" is within the documented error bound of "expected",
+// where both are expressed in radians.
+void ExpectWithinApproxError(long double expected, double actual) {
+  if (std::isinf(expected)) {
+    EXPECT_EQ(expected, actual);
+  } else {
+    long double bound =
+        kApproxProjectionError * std::max(1.0L, std::fabs(expected));
+    EXPECT_LE(std::fabs(actual - expected), bound)
+        << actual << " vs. " << static_cast<double>(expected);
+  }
+}
+
+TEST(PlateCarreeProjection, ProjectPointsApprox) {
+  // Use radians so that the results can be compared directly.
+  PlateCarreeProjection proj;
+  std::vector<S2Point> points = GetProjectionTestPoints();
+  std::vector<R2Point> projected(points.size());
+  proj.ProjectPointsApprox(points, absl::MakeSpan(projected));
+  for (int i = 0; i < points.size(); ++i) {
+    long double x = points[i].x() + 0.0, y = points[i].y() + 0.0,
+                z = points[i].z() + 0.0;
+    ExpectWithinApproxError(std::atan2(y, x), projected[i].x());
+    ExpectWithinApproxError(std::atan2(z, std::hypot(x, y)), projected[i].y());
+  }
+}
+
+TEST(MercatorProjection, ProjectPointsApprox) {
+  MercatorProjection proj(M_PI);
+  std::vector<S2Point> points = GetProjectionTestPoints();
+  std::vector<R2Point> projected(points.size());
+  proj.ProjectPointsApprox(points, absl::MakeSpan(projected));
+  for (int i = 0; i < points.size(); ++i) {
+    long double x = points[i].x() + 0.0, y = points[i].y() + 0.0,
+                z = points[i].z() + 0.0;
+    long double r = std::hypot(x, y);
+    ExpectWithinApproxError(std::atan2(y, x), projected[i].x());
+    ExpectWithinApproxError(
+        r == 0 ? std::copysign(HUGE_VALL, z) : std::asinh(z / r),
+        projected[i].y());
+  }
+}
+
 }  //  namespace S2
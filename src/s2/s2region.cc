@@ -0,0 +1,32 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2region.h"
+
+#include "s2/s2cell.h"
+
+void S2Region::GetChildRelations(const S2Cell children[4],
+                                 bool check_contains,
+                                 CellRelation relations[4]) const {
+  for (int i = 0; i < 4; ++i) {
+    if (!MayIntersect(children[i])) {
+      relations[i] = CellRelation::DISJOINT;
+    } else if (check_contains && Contains(children[i])) {
+      relations[i] = CellRelation::CONTAINS;
+    } else {
+      relations[i] = CellRelation::MAY_INTERSECT;
+    }
+  }
+}
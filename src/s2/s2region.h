@@ -100,6 +100,28 @@ class S2Region {
   // subtypes may relax this restriction.
   virtual bool Contains(const S2Point& p) const = 0;
 
+  // The relationship between the region and a cell, as determined by
+  // GetChildRelations().
+  enum class CellRelation {
+    DISJOINT,       // MayIntersect(cell) is false.
+    MAY_INTERSECT,  // MayIntersect(cell) is true, but Contains(cell) is
+                    // false or was not tested.
+    CONTAINS,       // MayIntersect(cell) and Contains(cell) are both true.
+  };
+
+  // Classifies the four children of a cell (in the order returned by
+  // S2Cell::Subdivide) with respect to the region.  If "check_contains" is
+  // false then Contains() is not tested, so that no child is classified as
+  // CONTAINS.  The results are identical to calling MayIntersect() and
+  // Contains() on each child, which is what the default implementation does.
+  // Subtypes override this method when the children can share work (e.g.,
+  // their common vertices).
+  //
+  // This method is not intended for direct use by client code; it is used by
+  // S2RegionCoverer to test all the children of a candidate at once.
+  virtual void GetChildRelations(const S2Cell children[4], bool check_contains,
+                                 CellRelation relations[4]) const;
+
   //////////////////////////////////////////////////////////////////////////
   // Many S2Region subtypes also define the following non-virtual methods.
   //////////////////////////////////////////////////////////////////////////
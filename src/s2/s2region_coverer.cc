@@ -18,17 +18,27 @@
 #include "s2/s2region_coverer.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_set.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 
 #include "s2/base/types.h"
+#include "s2/s2cap.h"
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_union.h"
+#include "s2/s2latlng_rect.h"
 #include "s2/s2point.h"
 #include "s2/s2region.h"
 
@@ -39,6 +49,7 @@ using std::vector;
 
 // Define storage for header file constants (the values are not needed here).
 constexpr int S2RegionCoverer::Options::kDefaultMaxCells;
+constexpr int S2RegionCoverer::Options::kNoWorkLimit;
 
 S2RegionCoverer::S2RegionCoverer(const S2RegionCoverer::Options& options) :
   options_(options) {
@@ -74,6 +85,12 @@ void S2RegionCoverer::Options::set_fixed_level(int level) {
   set_max_level(level);
 }
 
+void S2RegionCoverer::Options::set_max_region_predicates(
+    int max_region_predicates) {
+  ABSL_DCHECK_GE(max_region_predicates, 0);
+  max_region_predicates_ = max(0, max_region_predicates);
+}
+
 void S2RegionCoverer::Options::set_level_mod(int level_mod) {
   ABSL_DCHECK_GE(level_mod, 1);
   ABSL_DCHECK_LE(level_mod, 3);
@@ -85,27 +102,86 @@ int S2RegionCoverer::Options::true_max_level() const {
   return max_level_ - (max_level_ - min_level_) % level_mod_;
 }
 
+bool S2RegionCoverer::WorkLimitReached() {
+  if (work_limit_reached_) return true;
+  // absl::Now() is relatively expensive, so the deadline is only checked on
+  // every 16th call.
+  if (num_region_predicates_ >= options_.max_region_predicates() ||
+      ((num_work_checks_++ & 15) == 0 &&
+       options_.deadline() != absl::InfiniteFuture() &&
+       absl::Now() >= options_.deadline())) {
+    work_limit_reached_ = true;
+  }
+  return work_limit_reached_;
+}
+
+bool S2RegionCoverer::RegionMayIntersect(const S2Cell& cell) {
+  if (has_work_limit_ && WorkLimitReached()) {
+    // Exterior coverings must include every cell that might intersect the
+    // region, while interior coverings must not include any cell that might
+    // not be contained by it.
+    return !interior_covering_;
+  }
+  ++num_region_predicates_;
+  return region_->MayIntersect(cell);
+}
+
+inline bool S2RegionCoverer::ChecksContains(int level) const {
+  // Interior coverings need to know whether every cell is contained, while
+  // exterior coverings don't need to know for cells at the maximum level.
+  return level >= options_.min_level() &&
+         (interior_covering_ ||
+          level + options_.level_mod() <= options_.max_level());
+}
+
 S2RegionCoverer::Candidate* S2RegionCoverer::NewCandidate(const S2Cell& cell) {
+  if (has_work_limit_ && WorkLimitReached()) {
+    // Assume that the cell intersects the region without being contained by
+    // it, and don't expand it any further.
+    if (interior_covering_) return nullptr;
+    return AllocateCandidate(cell, true);
+  }
+  ++num_region_predicates_;
   if (!region_->MayIntersect(cell)) return nullptr;
+  S2Region::CellRelation relation = S2Region::CellRelation::MAY_INTERSECT;
+  if (ChecksContains(cell.level())) {
+    ++num_region_predicates_;
+    if (region_->Contains(cell)) relation = S2Region::CellRelation::CONTAINS;
+  }
+  return NewCandidate(cell, relation);
+}
 
+S2RegionCoverer::Candidate* S2RegionCoverer::NewCandidate(
+    const S2Cell& cell, S2Region::CellRelation relation) {
+  if (relation == S2Region::CellRelation::DISJOINT) return nullptr;
   bool is_terminal = false;
   if (cell.level() >= options_.min_level()) {
-    if (interior_covering_) {
-      if (region_->Contains(cell)) {
-        is_terminal = true;
-      } else if (cell.level() + options_.level_mod() > options_.max_level()) {
-        return nullptr;
-      }
-    } else {
-      if (cell.level() + options_.level_mod() > options_.max_level() ||
-          region_->Contains(cell)) {
-        is_terminal = true;
-      }
+    if (relation == S2Region::CellRelation::CONTAINS) {
+      is_terminal = true;
+    } else if (cell.level() + options_.level_mod() > options_.max_level()) {
+      // Interior coverings only include cells that are contained.
+      if (interior_covering_) return nullptr;
+      is_terminal = true;
     }
   }
+  return AllocateCandidate(cell, is_terminal);
+}
+
+S2RegionCoverer::Candidate* S2RegionCoverer::AllocateCandidate(
+    const S2Cell& cell, bool is_terminal) {
   ++candidates_created_counter_;
+  ++allocation_stats_.candidates_created;
+  const int size_class = is_terminal ? 0 : options_.level_mod();
+  vector<void*>* free_list = &free_candidates_[size_class];
+  if (free_list->empty()) {
+    AllocateSlab(size_class);
+  } else {
+    ++allocation_stats_.candidates_reused;
+  }
+  void* memory = free_list->back();
+  free_list->pop_back();
   const std::size_t max_children = is_terminal ? 0 : 1 << max_children_shift();
-  return new (max_children) Candidate(cell, max_children);
+  return new (memory) Candidate(cell, size_class, max_children);
 }
 
 void S2RegionCoverer::DeleteCandidate(Candidate* candidate,
@@ -114,7 +190,34 @@ void S2RegionCoverer::DeleteCandidate(Candidate* candidate,
     for (int i = 0; i < candidate->num_children; ++i)
       DeleteCandidate(candidate->children[i], true);
   }
-  delete candidate;
+  const int size_class = candidate->size_class;
+  candidate->~Candidate();
+  free_candidates_[size_class].push_back(candidate);
+}
+
+std::size_t S2RegionCoverer::CandidateBytes(int size_class) {
+  // The result is a multiple of alignof(Candidate) since sizeof(Candidate)
+  // is, and the children are pointers.
+  static_assert(alignof(Candidate) % alignof(Candidate*) == 0);
+  std::size_t max_children = size_class == 0 ? 0 : 1 << (2 * size_class);
+  return sizeof(Candidate) + max_children * sizeof(Candidate*);
+}
+
+void S2RegionCoverer::AllocateSlab(int size_class) {
+  const std::size_t bytes = CandidateBytes(size_class);
+  // Memory returned by new[] is suitably aligned for any fundamental type.
+  // (The memory is not value-initialized, unlike make_unique<char[]>.)
+  slabs_.emplace_back(new char[kCandidatesPerSlab * bytes]);
+  ++allocation_stats_.slabs_allocated;
+  allocation_stats_.slab_bytes_allocated += kCandidatesPerSlab * bytes;
+
+  // Candidates are pushed in reverse order so that they are handed out in
+  // address order.
+  char* base = slabs_.back().get();
+  vector<void*>* free_list = &free_candidates_[size_class];
+  for (int i = kCandidatesPerSlab - 1; i >= 0; --i) {
+    free_list->push_back(base + i * bytes);
+  }
 }
 
 int S2RegionCoverer::ExpandChildren(Candidate* candidate,
@@ -122,15 +225,36 @@ int S2RegionCoverer::ExpandChildren(Candidate* candidate,
   num_levels--;
   S2Cell child_cells[4];
   cell.Subdivide(child_cells);
+
+  // Unless there is a work limit (which is checked before each predicate),
+  // all four children are tested at once since this is faster for some
+  // regions.  The number of predicates is counted as if they were tested
+  // individually.
+  S2Region::CellRelation relations[4];
+  const bool batch = !has_work_limit_;
+  if (batch) {
+    const bool check_contains =
+        num_levels == 0 && ChecksContains(cell.level() + 1);
+    region_->GetChildRelations(child_cells, check_contains, relations);
+    for (int i = 0; i < 4; ++i) {
+      ++num_region_predicates_;
+      if (check_contains &&
+          relations[i] != S2Region::CellRelation::DISJOINT) {
+        ++num_region_predicates_;
+      }
+    }
+  }
   int num_terminals = 0;
   for (int i = 0; i < 4; ++i) {
     if (num_levels > 0) {
-      if (region_->MayIntersect(child_cells[i])) {
+      if (batch ? relations[i] != S2Region::CellRelation::DISJOINT
+                : RegionMayIntersect(child_cells[i])) {
         num_terminals += ExpandChildren(candidate, child_cells[i], num_levels);
       }
       continue;
     }
-    Candidate* child = NewCandidate(child_cells[i]);
+    Candidate* child = batch ? NewCandidate(child_cells[i], relations[i])
+                             : NewCandidate(child_cells[i]);
     if (child) {
       candidate->children[candidate->num_children++] = child;
       if (child->is_terminal) ++num_terminals;
@@ -149,6 +273,18 @@ void S2RegionCoverer::AddCandidate(Candidate* candidate) {
   }
   ABSL_DCHECK_EQ(0, candidate->num_children);
 
+  if (has_work_limit_ && WorkLimitReached()) {
+    if (interior_covering_) {
+      // The cell is not contained by the region.
+      DeleteCandidate(candidate, false);
+    } else {
+      // Use the cell itself rather than expanding its children.
+      candidate->is_terminal = true;
+      AddCandidate(candidate);
+    }
+    return;
+  }
+
   // Expand one level at a time until we hit min_level() to ensure that we
   // don't skip over it.
   int num_levels = ((candidate->cell.level() < options_.min_level()) ?
@@ -243,6 +379,12 @@ void S2RegionCoverer::GetCoveringInternal(const S2Region& region) {
   ABSL_DCHECK(result_.empty());
   region_ = &region;
   candidates_created_counter_ = 0;
+  has_work_limit_ =
+      options_.max_region_predicates() != Options::kNoWorkLimit ||
+      options_.deadline() != absl::InfiniteFuture();
+  work_limit_reached_ = false;
+  num_region_predicates_ = 0;
+  num_work_checks_ = 0;
 
   GetInitialCandidates();
   while (!pq_.empty() &&
@@ -293,27 +435,111 @@ void S2RegionCoverer::GetCoveringInternal(const S2Region& region) {
   // parameters specified (min_level, level_mod, etc).  This significantly
   // reduces the number of cells returned in many cases, and it is cheap
   // compared to computing the covering in the first place.
-  S2CellUnion::Normalize(&result_);
+  NormalizeCovering(&result_);
+  ABSL_DCHECK(IsCanonical(result_));
+}
+
+void S2RegionCoverer::NormalizeCovering(vector<S2CellId>* covering) const {
+  S2CellUnion::Normalize(covering);
   if (options_.min_level() > 0 || options_.level_mod() > 1) {
-    auto result_copy = result_;
-    S2CellUnion::Denormalize(result_copy, options_.min_level(),
-                             options_.level_mod(), &result_);
+    auto covering_copy = *covering;
+    S2CellUnion::Denormalize(covering_copy, options_.min_level(),
+                             options_.level_mod(), covering);
   }
-  ABSL_DCHECK(IsCanonical(result_));
 }
 
 void S2RegionCoverer::GetCovering(const S2Region& region,
                                   vector<S2CellId>* covering) {
   interior_covering_ = false;
   GetCoveringInternal(region);
-  *covering = std::move(result_);
+  // Swapping rather than moving lets both vectors keep their storage, so that
+  // repeated calls do not allocate once they have reached their final size.
+  covering->swap(result_);
+  result_.clear();
 }
 
 void S2RegionCoverer::GetInteriorCovering(const S2Region& region,
                                           vector<S2CellId>* interior) {
   interior_covering_ = true;
   GetCoveringInternal(region);
-  *interior = std::move(result_);
+  // Swapping rather than moving lets both vectors keep their storage, so that
+  // repeated calls do not allocate once they have reached their final size.
+  interior->swap(result_);
+  result_.clear();
+}
+
+namespace {
+
+// The part of a region that lies within a given cell union.  The predicates
+// are only as precise as those of the region, which is all that is needed to
+// reproduce its covering within the cell union.
+class ClippedRegion final : public S2Region {
+ public:
+  ClippedRegion(const S2Region& region, const S2CellUnion& clip)
+      : region_(region), clip_(clip) {}
+
+  ClippedRegion* Clone() const override {
+    return new ClippedRegion(region_, clip_);
+  }
+  S2Cap GetCapBound() const override { return clip_.GetCapBound(); }
+  S2LatLngRect GetRectBound() const override { return clip_.GetRectBound(); }
+  void GetCellUnionBound(vector<S2CellId>* cell_ids) const override {
+    clip_.GetCellUnionBound(cell_ids);
+  }
+  bool Contains(const S2Cell& cell) const override {
+    return clip_.Contains(cell.id()) && region_.Contains(cell);
+  }
+  bool MayIntersect(const S2Cell& cell) const override {
+    return clip_.Intersects(cell.id()) && region_.MayIntersect(cell);
+  }
+  bool Contains(const S2Point& p) const override {
+    return clip_.Contains(p) && region_.Contains(p);
+  }
+
+ private:
+  const S2Region& region_;
+  const S2CellUnion& clip_;
+};
+
+}  // namespace
+
+void S2RegionCoverer::UpdateCovering(const S2Region& region,
+                                     const S2Region& changed_region,
+                                     vector<S2CellId>* covering,
+                                     vector<S2CellId>* added,
+                                     vector<S2CellId>* removed) {
+  ABSL_DCHECK(IsCanonical(*covering));
+
+  // When max_cells() does not limit the covering, it consists of the cells
+  // at the deepest allowed level that intersect the region (as determined by
+  // its predicates), merged into ancestors wherever possible.  Since every
+  // such cell is either contained by or disjoint from "patch", the covering
+  // can be updated by replacing the part inside "patch" with a covering of
+  // the part of "region" inside "patch", and then merging cells again.
+  Options patch_options = options_;
+  patch_options.set_max_cells(Options::kDefaultMaxCells);
+  patch_options.set_max_region_predicates(Options::kNoWorkLimit);
+  patch_options.set_deadline(absl::InfiniteFuture());
+  S2RegionCoverer patch_coverer(patch_options);
+  const S2CellUnion patch = patch_coverer.GetCovering(changed_region);
+
+  interior_covering_ = false;
+  GetCoveringInternal(ClippedRegion(region, patch));
+  vector<S2CellId> new_covering =
+      S2CellUnion::FromVerbatim(*covering).Difference(patch).Release();
+  new_covering.insert(new_covering.end(), result_.begin(), result_.end());
+  result_.clear();
+  NormalizeCovering(&new_covering);
+
+  added->clear();
+  std::set_difference(new_covering.begin(), new_covering.end(),
+                      covering->begin(), covering->end(),
+                      std::back_inserter(*added));
+  removed->clear();
+  std::set_difference(covering->begin(), covering->end(),
+                      new_covering.begin(), new_covering.end(),
+                      std::back_inserter(*removed));
+  covering->swap(new_covering);
 }
 
 S2CellUnion S2RegionCoverer::GetCovering(const S2Region& region) {
@@ -328,6 +554,104 @@ S2CellUnion S2RegionCoverer::GetInteriorCovering(const S2Region& region) {
   return S2CellUnion::FromVerbatim(std::move(result_));
 }
 
+vector<S2CellUnion> S2RegionCoverer::GetCoverings(
+    absl::Span<const S2Region* const> regions, int num_threads) {
+  return GetCoveringsInternal(regions, num_threads, false);
+}
+
+vector<S2CellUnion> S2RegionCoverer::GetInteriorCoverings(
+    absl::Span<const S2Region* const> regions, int num_threads) {
+  return GetCoveringsInternal(regions, num_threads, true);
+}
+
+// The number of regions that a thread claims at once.  This is small enough
+// to balance the load well even when covering times vary widely, and large
+// enough that the shared counter is not contended.
+static constexpr size_t kRegionsPerChunk = 16;
+
+vector<S2CellUnion> S2RegionCoverer::GetCoveringsInternal(
+    absl::Span<const S2Region* const> regions, int num_threads,
+    bool interior_covering) {
+  vector<S2CellUnion> coverings(regions.size());
+  std::atomic<size_t> next_region(0);
+  auto run = [&regions, &coverings, &next_region,
+              interior_covering](S2RegionCoverer* coverer) {
+    size_t begin;
+    while ((begin = next_region.fetch_add(kRegionsPerChunk)) <
+           regions.size()) {
+      size_t end = min(begin + kRegionsPerChunk, regions.size());
+      for (size_t i = begin; i < end; ++i) {
+        coverer->interior_covering_ = interior_covering;
+        coverer->GetCoveringInternal(*regions[i]);
+        coverings[i] = S2CellUnion::FromVerbatim(std::move(coverer->result_));
+      }
+    }
+  };
+  const size_t num_chunks =
+      (regions.size() + kRegionsPerChunk - 1) / kRegionsPerChunk;
+  num_threads = min<size_t>(max(num_threads, 1), max<size_t>(num_chunks, 1));
+  vector<std::thread> threads;
+  for (int i = 1; i < num_threads; ++i) {
+    threads.emplace_back([this, &run]() {
+      S2RegionCoverer coverer(options_);
+      run(&coverer);
+    });
+  }
+  run(this);
+  for (auto& thread : threads) thread.join();
+  return coverings;
+}
+
+void S2RegionCoverer::GetCoveringRanges(const S2Region& region,
+                                        int max_ranges, uint64 max_gap,
+                                        vector<LeafCellRange>* ranges) {
+  ABSL_DCHECK_GE(max_ranges, 1);
+  interior_covering_ = false;
+  GetCoveringInternal(region);
+  ranges->clear();
+
+  // Consecutive leaf cells differ by 2 in their S2CellId values, so the
+  // number of leaf cells strictly between ranges "a" and "b" is
+  // (b.start - a.end) / 2 - 1.  Since the covering is sorted and disjoint
+  // this is never negative.
+  const auto gap = [](const LeafCellRange& a, const LeafCellRange& b) {
+    return (b.start.id() - a.end.id()) / 2 - 1;
+  };
+  for (S2CellId id : result_) {
+    LeafCellRange range{id.range_min(), id.range_max()};
+    if (!ranges->empty() && gap(ranges->back(), range) <= max_gap) {
+      ranges->back().end = range.end;
+    } else {
+      ranges->push_back(range);
+    }
+  }
+  if (ranges->size() > static_cast<size_t>(max_ranges)) {
+    // Merging the ranges separated by the (num_ranges - max_ranges) smallest
+    // gaps minimizes the number of extra leaf cells scanned.  Ties are broken
+    // by position so that exactly the required number of gaps is removed.
+    vector<std::pair<uint64, size_t>> gaps;
+    gaps.reserve(ranges->size() - 1);
+    for (size_t i = 1; i < ranges->size(); ++i) {
+      gaps.emplace_back(gap((*ranges)[i - 1], (*ranges)[i]), i);
+    }
+    const size_t num_merges = ranges->size() - max_ranges;
+    std::nth_element(gaps.begin(), gaps.begin() + (num_merges - 1),
+                     gaps.end());
+    vector<bool> merge(ranges->size(), false);
+    for (size_t i = 0; i < num_merges; ++i) merge[gaps[i].second] = true;
+    size_t out = 0;
+    for (size_t i = 1; i < ranges->size(); ++i) {
+      if (merge[i]) {
+        (*ranges)[out].end = (*ranges)[i].end;
+      } else {
+        (*ranges)[++out] = (*ranges)[i];
+      }
+    }
+    ranges->resize(out + 1);
+  }
+  result_.clear();
+}
+
 void S2RegionCoverer::GetFastCovering(const S2Region& region,
                                       vector<S2CellId>* covering) {
   region.GetCellUnionBound(covering);
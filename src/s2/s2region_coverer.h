@@ -20,6 +20,8 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <limits>
+#include <memory>
 #include <new>
 #include <queue>
 #include <utility>
@@ -27,6 +29,9 @@
 
 #include "absl/base/casts.h"
 #include "absl/base/macros.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "s2/base/types.h"
 #include "s2/_fp_contract_off.h"
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
@@ -155,11 +160,39 @@ class S2RegionCoverer {
     // This is the maximum level that will actually be used in coverings.
     int true_max_level() const;
 
+    // The following options bound the amount of work done by each covering.
+    // This can be used to bound the latency of coverings of regions whose
+    // predicates are expensive (e.g., S2ShapeIndexBufferedRegion), since
+    // max_cells() alone does not limit the number of cells that are tested.
+    // When a limit is reached the covering stops refining cells and returns
+    // the best covering found so far, and last_covering_approximate()
+    // returns true.  Such coverings are still valid (i.e., they cover the
+    // region, or are contained by it for interior coverings) and satisfy all
+    // the other options, but they may be much less tight.
+
+    // Specifies the maximum number of calls to the region's MayIntersect()
+    // and Contains() methods.  This limit may be exceeded by one call.
+    //
+    // DEFAULT: kNoWorkLimit
+    static constexpr int kNoWorkLimit = std::numeric_limits<int>::max();
+    int max_region_predicates() const { return max_region_predicates_; }
+    void set_max_region_predicates(int max_region_predicates);
+
+    // Specifies a time after which the covering should stop refining cells.
+    // The deadline is checked periodically rather than before every region
+    // predicate, so coverings may run slightly past it.
+    //
+    // DEFAULT: absl::InfiniteFuture()
+    absl::Time deadline() const { return deadline_; }
+    void set_deadline(absl::Time deadline) { deadline_ = deadline; }
+
    protected:
     int max_cells_ = kDefaultMaxCells;
     int min_level_ = 0;
     int max_level_ = S2CellId::kMaxLevel;
     int level_mod_ = 1;
+    int max_region_predicates_ = kNoWorkLimit;
+    absl::Time deadline_ = absl::InfiniteFuture();
   };
 
   // Constructs an S2RegionCoverer with the given options.
@@ -196,6 +229,88 @@ class S2RegionCoverer {
   void GetInteriorCovering(const S2Region& region,
                            std::vector<S2CellId>* interior);
 
+  // Updates "covering", which must have been returned by GetCovering() with
+  // the current options for a region that differs from "region" only within
+  // "changed_region" (e.g., a bounding cap or rectangle of the edges that
+  // were modified), so that it becomes the covering of "region".  Only the
+  // part of the covering near "changed_region" is recomputed, and the cells
+  // that were removed from and added to the covering are returned in
+  // "removed" and "added" (in sorted order), which is convenient for
+  // updating the terms of a spatial index.
+  //
+  // The result is identical to GetCovering(region) provided that
+  // max_cells() does not limit the covering, which is true if max_cells()
+  // is at least the number of cells in a covering of "region" at the
+  // deepest level allowed by max_level() and level_mod() (and also whenever
+  // min_level() == max_level()), and that no work limit is reached.  In
+  // other cases the covering remains valid but may differ from the result
+  // of GetCovering().
+  void UpdateCovering(const S2Region& region, const S2Region& changed_region,
+                      std::vector<S2CellId>* covering,
+                      std::vector<S2CellId>* added,
+                      std::vector<S2CellId>* removed);
+
+  // Returns true if the most recent GetCovering() or GetInteriorCovering()
+  // call stopped early because it reached one of the work limits specified
+  // in options() (see max_region_predicates() and deadline()).
+  bool last_covering_approximate() const { return work_limit_reached_; }
+
+  // Returns the number of calls to the region's MayIntersect() and Contains()
+  // methods made by the most recent GetCovering() or GetInteriorCovering()
+  // call.
+  int last_num_region_predicates() const { return num_region_predicates_; }
+
+  // Computes GetCovering() (or GetInteriorCovering()) for each of the given
+  // regions using up to "num_threads" threads, and returns the results in
+  // the same order as "regions".  This is intended for covering very large
+  // numbers of regions.  Regions are claimed by the threads in small chunks
+  // on demand, so that threads that finish early take over the remaining
+  // work.  Each thread uses a single S2RegionCoverer with the current
+  // options for all the regions that it covers, and therefore reuses its
+  // candidate storage.  The results are identical to calling GetCovering()
+  // on each region.
+  //
+  // REQUIRES: The const methods of the regions may be called concurrently
+  //           (which is true of all the S2Region types in this library).
+  std::vector<S2CellUnion> GetCoverings(
+      absl::Span<const S2Region* const> regions, int num_threads = 1);
+  std::vector<S2CellUnion> GetInteriorCoverings(
+      absl::Span<const S2Region* const> regions, int num_threads = 1);
+
+  // A range of leaf cells [start, end] (inclusive), as would be used for a
+  // range scan over features keyed by leaf S2CellId in an ordered key-value
+  // store.  Both endpoints are leaf cells (see S2CellId::range_min() and
+  // S2CellId::range_max()).
+  struct LeafCellRange {
+    S2CellId start;
+    S2CellId end;
+
+    bool operator==(const LeafCellRange& y) const {
+      return start == y.start && end == y.end;
+    }
+    bool operator!=(const LeafCellRange& y) const { return !(*this == y); }
+  };
+
+  // Like GetCovering(), but returns the covering as a sorted list of
+  // disjoint leaf cell ranges suitable for range scans, so that the number
+  // of seeks rather than the number of cells is bounded.  Cells of the
+  // covering whose leaf ranges are contiguous are always combined into a
+  // single range.  In addition, two consecutive ranges are merged if the
+  // number of leaf cells between them is at most "max_gap" (which trades
+  // scanning some keys outside the region for fewer seeks), and then the
+  // ranges separated by the smallest gaps are merged until there are at
+  // most "max_ranges" ranges.  The result is never empty unless the
+  // covering is empty.
+  //
+  // Note that the covering itself is still computed using the current
+  // options, so max_cells() should usually be set at least as large as
+  // "max_ranges" (a larger max_cells() gives a tighter covering that is then
+  // combined into the same number of ranges).
+  //
+  // REQUIRES: max_ranges >= 1
+  void GetCoveringRanges(const S2Region& region, int max_ranges,
+                         uint64 max_gap, std::vector<LeafCellRange>* ranges);
+
   // Like GetCovering(), except that this method is much faster and the
   // coverings are not as tight.  All of the usual parameters are respected
   // (max_cells, min_level, max_level, and level_mod), except that the
@@ -249,18 +364,30 @@ class S2RegionCoverer {
   S2CellUnion CanonicalizeCovering(const S2CellUnion& covering);
   void CanonicalizeCovering(std::vector<S2CellId>* covering);
 
+  // Statistics about the memory used for candidates, accumulated over all
+  // coverings computed by this S2RegionCoverer.  Candidates are allocated
+  // from slabs that are owned by the coverer and retained until it is
+  // destroyed, so that repeated calls to GetCovering() do not need to
+  // allocate any memory once the pool has grown to its steady-state size.
+  struct AllocationStats {
+    // The total number of candidates created.
+    int64 candidates_created = 0;
+
+    // The number of candidates that were served from the free list rather
+    // than from newly allocated slab memory.
+    int64 candidates_reused = 0;
+
+    // The number of heap allocations (slabs) made for candidates, and their
+    // total size in bytes.
+    int64 slabs_allocated = 0;
+    int64 slab_bytes_allocated = 0;
+  };
+  const AllocationStats& allocation_stats() const { return allocation_stats_; }
+
  private:
   struct Candidate {
-    void* operator new(std::size_t size, std::size_t max_children) {
-      return ::operator new (size + max_children * sizeof(Candidate *));
-    }
-
-    void operator delete(void* p) {
-      ::operator delete (p);
-    }
-
-    Candidate(const S2Cell& cell, const std::size_t max_children)
-        : cell(cell), is_terminal(max_children == 0) {
+    Candidate(const S2Cell& cell, int size_class, std::size_t max_children)
+        : cell(cell), is_terminal(max_children == 0), size_class(size_class) {
       std::fill_n(&children[0], max_children,
                   absl::implicit_cast<Candidate*>(nullptr));
     }
@@ -271,20 +398,57 @@ class S2RegionCoverer {
 
     S2Cell cell;
     bool is_terminal;        // Cell should not be expanded further.
+    int8 size_class;         // Index of the free list that owns this object.
     int num_children = 0;    // Number of children that intersect the region.
     Candidate* children[0];  // Actual size may be 0, 4, 16, or 64 elements.
   };
 
+  // Candidates are allocated in size classes according to the length of
+  // their "children" array: class 0 holds terminal candidates (no children)
+  // and class k >= 1 holds candidates with 4**k children.
+  static constexpr int kNumSizeClasses = 4;
+
+  // The number of candidates allocated at once when a free list is empty.
+  static constexpr int kCandidatesPerSlab = 64;
+
+  // Returns the number of bytes used by a candidate of the given size class.
+  static std::size_t CandidateBytes(int size_class);
+
   // If the cell intersects the given region, return a new candidate with no
   // children, otherwise return nullptr.  Also marks the candidate as "terminal"
   // if it should not be expanded further.
   Candidate* NewCandidate(const S2Cell& cell);
 
+  // Like the above, but where "relation" is the relationship between the
+  // cell and the region (see S2Region::GetChildRelations).  Contains() must
+  // have been tested if and only if ChecksContains(cell.level()) is true.
+  Candidate* NewCandidate(const S2Cell& cell, S2Region::CellRelation relation);
+
+  // Returns a new candidate with no children.
+  Candidate* AllocateCandidate(const S2Cell& cell, bool is_terminal);
+
+  // Returns true if NewCandidate() needs to know whether the region contains
+  // candidate cells at the given level.
+  bool ChecksContains(int level) const;
+
   // Returns the log base 2 of the maximum number of children of a candidate.
   int max_children_shift() const { return 2 * options().level_mod(); }
 
-  // Frees the memory associated with a candidate.
-  static void DeleteCandidate(Candidate* candidate, bool delete_children);
+  // Returns true if the current covering has reached one of the work limits
+  // specified in options().  Once this method returns true, it continues to
+  // do so until the covering is finished.
+  bool WorkLimitReached();
+
+  // Returns region_->MayIntersect(cell), or a conservative answer without
+  // calling the region if the work limit has been reached.
+  bool RegionMayIntersect(const S2Cell& cell);
+
+  // Returns the memory associated with a candidate to the free list.
+  void DeleteCandidate(Candidate* candidate, bool delete_children);
+
+  // Allocates a new slab for the given size class and adds its candidates
+  // to the corresponding free list.
+  void AllocateSlab(int size_class);
 
   // Processes a candidate by either adding it to the result_ vector or
   // expanding its children and inserting it into the priority queue.
@@ -302,6 +466,15 @@ class S2RegionCoverer {
   // Generates a covering and stores it in result_.
   void GetCoveringInternal(const S2Region& region);
 
+  // Normalizes "covering" and then replaces cells with their descendants as
+  // necessary to satisfy min_level() and level_mod().
+  void NormalizeCovering(std::vector<S2CellId>* covering) const;
+
+  // Implements GetCoverings() and GetInteriorCoverings().
+  std::vector<S2CellUnion> GetCoveringsInternal(
+      absl::Span<const S2Region* const> regions, int num_threads,
+      bool interior_covering);
+
   // If level > min_level(), then reduces "level" if necessary so that it also
   // satisfies level_mod().  Levels smaller than min_level() are not affected
   // (since cells at these levels are eventually expanded).
@@ -355,6 +528,18 @@ class S2RegionCoverer {
 
   // Counter of number of candidates created, for performance evaluation.
   int candidates_created_counter_;
+
+  // State used to enforce the work limits of the current covering.
+  bool has_work_limit_ = false;
+  bool work_limit_reached_ = false;
+  int num_region_predicates_ = 0;
+  int num_work_checks_ = 0;
+
+  // Storage for candidates.  Each free list holds the unused candidates of
+  // one size class; the memory itself is owned by "slabs_".
+  std::vector<void*> free_candidates_[kNumSizeClasses];
+  std::vector<std::unique_ptr<char[]>> slabs_;
+  AllocationStats allocation_stats_;
 };
 
 #endif  // S2_S2REGION_COVERER_H_
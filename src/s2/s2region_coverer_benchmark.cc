@@ -0,0 +1,89 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Benchmarks for S2RegionCoverer.
+
+#include "s2/s2region_coverer.h"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2fractal.h"
+#include "s2/s2loop.h"
+#include "s2/s2region.h"
+#include "s2/s2testing.h"
+
+using std::vector;
+
+namespace {
+
+// Computes coverings of random caps using at most state.range(0) cells.
+void BM_GetCoveringCap(benchmark::State& state) {
+  S2Testing::rnd.Reset(1);
+  vector<S2Cap> caps;
+  for (int i = 0; i < 256; ++i) {
+    caps.push_back(S2Testing::GetRandomCap(1e-10, 1e-1));
+  }
+  S2RegionCoverer::Options options;
+  options.set_max_cells(state.range(0));
+  S2RegionCoverer coverer(options);
+  int i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(coverer.GetCovering(caps[i]));
+    i = (i + 1) & 255;
+  }
+}
+BENCHMARK(BM_GetCoveringCap)->Range(8, 1 << 10);
+
+// Computes coverings of a fractal loop using at most state.range(0) cells.
+void BM_GetCoveringFractalLoop(benchmark::State& state) {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(1 << 12);
+  auto loop = fractal.MakeLoop(S2Testing::GetRandomFrame(),
+                               S1Angle::Degrees(5));
+  S2RegionCoverer::Options options;
+  options.set_max_cells(state.range(0));
+  S2RegionCoverer coverer(options);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(coverer.GetCovering(*loop));
+  }
+}
+BENCHMARK(BM_GetCoveringFractalLoop)->Range(8, 1 << 10);
+
+// Computes coverings of 4096 random caps in bulk using state.range(0)
+// threads.
+void BM_GetCoverings(benchmark::State& state) {
+  S2Testing::rnd.Reset(1);
+  vector<S2Cap> caps;
+  for (int i = 0; i < 4096; ++i) {
+    caps.push_back(S2Testing::GetRandomCap(1e-10, 1e-1));
+  }
+  vector<const S2Region*> regions;
+  for (const S2Cap& cap : caps) regions.push_back(&cap);
+  S2RegionCoverer::Options options;
+  options.set_max_cells(64);
+  S2RegionCoverer coverer(options);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(coverer.GetCoverings(regions, state.range(0)));
+  }
+  state.SetItemsProcessed(state.iterations() * regions.size());
+}
+BENCHMARK(BM_GetCoverings)->Arg(1)->Arg(4)->UseRealTime();
+
+}  // namespace
@@ -21,7 +21,9 @@
 
 #include <algorithm>
 #include <cmath>
+#include <iterator>
 #include <limits>
+#include <memory>
 #include <queue>
 #include <string>
 #include <utility>
@@ -35,6 +37,7 @@
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
+#include "absl/time/time.h"
 
 #include "s2/base/commandlineflags.h"
 #include "s2/base/log_severity.h"
@@ -46,7 +49,10 @@
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_union.h"
 #include "s2/s2latlng.h"
+#include "s2/s2latlng_rect.h"
+#include "s2/s2loop.h"
 #include "s2/s2point.h"
+#include "s2/s2polygon.h"
 #include "s2/s2polyline.h"
 #include "s2/s2region.h"
 #include "s2/s2testing.h"
@@ -61,10 +67,12 @@ namespace {
 
 using absl::flat_hash_map;
 using absl::StrCat;
+using std::make_unique;
 using std::max;
 using std::min;
 using std::priority_queue;
 using std::string;
+using std::unique_ptr;
 using std::vector;
 
 TEST(S2RegionCoverer, RandomCells) {
@@ -85,7 +93,7 @@ TEST(S2RegionCoverer, RandomCells) {
 static void CheckCovering(const S2RegionCoverer::Options& options,
                           const S2Region& region,
                           const vector<S2CellId>& covering,
-                          bool interior) {
+                          bool interior, bool check_tight = true) {
   // Keep track of how many cells have the same options.min_level() ancestor.
   flat_hash_map<S2CellId, int, S2CellIdHash> min_level_cells;
   for (S2CellId cell_id : covering) {
@@ -111,7 +119,7 @@ static void CheckCovering(const S2RegionCoverer::Options& options,
     }
   } else {
     S2CellUnion cell_union(covering);
-    S2Testing::CheckCovering(region, cell_union, true);
+    S2Testing::CheckCovering(region, cell_union, check_tight);
   }
 }
 
@@ -323,6 +331,219 @@ TEST(S2RegionCoverer, InteriorCovering) {
   }
 }
 
+TEST(S2RegionCoverer, GetCoveringsMatchesGetCovering) {
+  S2Testing::rnd.Reset(1);
+  vector<S2Cap> caps;
+  for (int i = 0; i < 300; ++i) {
+    caps.push_back(S2Testing::GetRandomCap(
+        S2Cell::AverageArea(S2CellId::kMaxLevel), 4 * M_PI));
+  }
+  vector<const S2Region*> regions;
+  for (const S2Cap& cap : caps) regions.push_back(&cap);
+
+  S2RegionCoverer::Options options;
+  options.set_max_cells(20);
+  S2RegionCoverer coverer(options);
+  for (int num_threads : {1, 4}) {
+    vector<S2CellUnion> coverings = coverer.GetCoverings(regions, num_threads);
+    vector<S2CellUnion> interiors =
+        coverer.GetInteriorCoverings(regions, num_threads);
+    ASSERT_EQ(coverings.size(), caps.size());
+    ASSERT_EQ(interiors.size(), caps.size());
+    for (size_t i = 0; i < caps.size(); ++i) {
+      EXPECT_EQ(coverings[i], coverer.GetCovering(caps[i]));
+      EXPECT_EQ(interiors[i], coverer.GetInteriorCovering(caps[i]));
+    }
+  }
+  EXPECT_TRUE(coverer.GetCoverings({}, 4).empty());
+}
+
+TEST(S2RegionCoverer, CandidatesAreReusedAcrossCalls) {
+  S2Testing::rnd.Reset(1);
+  S2Cap cap = S2Testing::GetRandomCap(1e-4, 1e-4);
+  S2RegionCoverer::Options options;
+  options.set_max_cells(1000);
+  S2RegionCoverer coverer(options);
+  S2CellUnion expected = coverer.GetCovering(cap);
+  const S2RegionCoverer::AllocationStats first = coverer.allocation_stats();
+  EXPECT_GT(first.candidates_created, 0);
+  EXPECT_GT(first.slabs_allocated, 0);
+  EXPECT_GT(first.slab_bytes_allocated, 0);
+
+  // The same covering again must not allocate any new slabs.
+  EXPECT_EQ(coverer.GetCovering(cap), expected);
+  const S2RegionCoverer::AllocationStats second = coverer.allocation_stats();
+  EXPECT_EQ(second.candidates_created, 2 * first.candidates_created);
+  EXPECT_EQ(second.candidates_reused - first.candidates_reused,
+            first.candidates_created);
+  EXPECT_EQ(second.slabs_allocated, first.slabs_allocated);
+
+  // Changing level_mod() uses a different size class.
+  coverer.mutable_options()->set_level_mod(2);
+  coverer.GetCovering(cap);
+  EXPECT_GT(coverer.allocation_stats().slabs_allocated,
+            second.slabs_allocated);
+}
+
+TEST(S2RegionCoverer, UpdateCoveringMatchesGetCovering) {
+  S2Testing::rnd.Reset(1);
+  const S2Point center = S2Testing::RandomPoint();
+  unique_ptr<S2Loop> loop =
+      S2Loop::MakeRegularLoop(center, S1Angle::Degrees(1), 100);
+  vector<S2Point> vertices(&loop->vertex(0), &loop->vertex(0) + 100);
+
+  vector<S2RegionCoverer::Options> all_options(3);
+  all_options[0].set_max_cells(INT_MAX);
+  all_options[0].set_max_level(14);
+  all_options[1].set_fixed_level(12);
+  all_options[2].set_max_cells(INT_MAX);
+  all_options[2].set_min_level(4);
+  all_options[2].set_max_level(15);
+  all_options[2].set_level_mod(3);
+  for (const S2RegionCoverer::Options& options : all_options) {
+    S2RegionCoverer coverer(options);
+    S2Polygon polygon(make_unique<S2Loop>(vertices));
+    vector<S2CellId> covering;
+    coverer.GetCovering(polygon, &covering);
+    int num_changed = 0;
+    for (int iter = 0; iter < 10; ++iter) {
+      // Move one vertex.  The polygon changes only within the bounding cap
+      // of the edges that were modified.
+      int i = S2Testing::rnd.Uniform(vertices.size());
+      const S2Point& prev = vertices[(i + vertices.size() - 1) % 100];
+      const S2Point& next = vertices[(i + 1) % 100];
+      S2Cap changed = S2Cap::FromPoint(vertices[i]);
+      changed.AddPoint(prev);
+      changed.AddPoint(next);
+      vertices[i] = S2Testing::SamplePoint(
+          S2Cap(vertices[i], S1Angle::Degrees(0.05)));
+      changed.AddPoint(vertices[i]);
+      polygon.Init(make_unique<S2Loop>(vertices));
+
+      vector<S2CellId> old_covering = covering, added, removed;
+      coverer.UpdateCovering(polygon, changed, &covering, &added, &removed);
+      EXPECT_EQ(covering, coverer.GetCovering(polygon).cell_ids());
+      vector<S2CellId> expected_added, expected_removed;
+      std::set_difference(covering.begin(), covering.end(),
+                          old_covering.begin(), old_covering.end(),
+                          std::back_inserter(expected_added));
+      std::set_difference(old_covering.begin(), old_covering.end(),
+                          covering.begin(), covering.end(),
+                          std::back_inserter(expected_removed));
+      EXPECT_EQ(added, expected_added);
+      EXPECT_EQ(removed, expected_removed);
+      num_changed += !added.empty() || !removed.empty();
+    }
+    EXPECT_GT(num_changed, 5);
+  }
+}
+
+// An S2Region that counts the calls to MayIntersect(S2Cell) and
+// Contains(S2Cell) of the region that it wraps.
+class CountingRegion final : public S2Region {
+ public:
+  explicit CountingRegion(const S2Region* region) : region_(region) {}
+
+  int num_predicates() const { return num_predicates_; }
+
+  CountingRegion* Clone() const override { return new CountingRegion(region_); }
+  S2Cap GetCapBound() const override { return region_->GetCapBound(); }
+  S2LatLngRect GetRectBound() const override {
+    return region_->GetRectBound();
+  }
+  void GetCellUnionBound(vector<S2CellId>* cell_ids) const override {
+    region_->GetCellUnionBound(cell_ids);
+  }
+  bool Contains(const S2Cell& cell) const override {
+    ++num_predicates_;
+    return region_->Contains(cell);
+  }
+  bool MayIntersect(const S2Cell& cell) const override {
+    ++num_predicates_;
+    return region_->MayIntersect(cell);
+  }
+  bool Contains(const S2Point& p) const override {
+    return region_->Contains(p);
+  }
+
+ private:
+  const S2Region* region_;
+  mutable int num_predicates_ = 0;
+};
+
+TEST(S2RegionCoverer, MaxRegionPredicates) {
+  static const int kMaxLevel = S2CellId::kMaxLevel;
+  S2Testing::rnd.Reset(1);
+  S2RegionCoverer::Options options;
+  for (int i = 0; i < 300; ++i) {
+    do {
+      options.set_min_level(S2Testing::rnd.Uniform(kMaxLevel + 1));
+      options.set_max_level(S2Testing::rnd.Uniform(kMaxLevel + 1));
+    } while (options.min_level() > options.max_level());
+    options.set_max_cells(S2Testing::rnd.Skewed(10));
+    options.set_level_mod(1 + S2Testing::rnd.Uniform(3));
+    double max_area =  min(4 * M_PI, (3 * options.max_cells() + 1) *
+                           S2Cell::AverageArea(options.min_level()));
+    S2Cap cap = S2Testing::GetRandomCap(0.1 * S2Cell::AverageArea(kMaxLevel),
+                                        max_area);
+    S2RegionCoverer coverer(options);
+    vector<S2CellId> expected_covering, expected_interior;
+    coverer.GetCovering(cap, &expected_covering);
+    const int num_covering_predicates = coverer.last_num_region_predicates();
+    EXPECT_FALSE(coverer.last_covering_approximate());
+    coverer.GetInteriorCovering(cap, &expected_interior);
+    const int num_interior_predicates = coverer.last_num_region_predicates();
+
+    const int limit = S2Testing::rnd.Uniform(num_covering_predicates + 1);
+    coverer.mutable_options()->set_max_region_predicates(limit);
+    CountingRegion region(&cap);
+    vector<S2CellId> covering, interior;
+    coverer.GetCovering(region, &covering);
+    EXPECT_EQ(region.num_predicates(), coverer.last_num_region_predicates());
+    EXPECT_LE(region.num_predicates(), limit + 1);
+    // Approximate coverings are valid but not necessarily tight.
+    CheckCovering(options, cap, covering, false,
+                  !coverer.last_covering_approximate());
+    if (!coverer.last_covering_approximate()) {
+      EXPECT_EQ(expected_covering, covering);
+    }
+
+    coverer.GetInteriorCovering(cap, &interior);
+    EXPECT_LE(coverer.last_num_region_predicates(), limit + 1);
+    CheckCovering(options, cap, interior, true);
+    if (limit >= num_interior_predicates) {
+      EXPECT_FALSE(coverer.last_covering_approximate());
+      EXPECT_EQ(expected_interior, interior);
+    }
+  }
+}
+
+TEST(S2RegionCoverer, DeadlineInPast) {
+  S2Testing::rnd.Reset(2);
+  S2Cap cap = S2Testing::GetRandomCap(1e-6, 1e-4);
+  S2RegionCoverer::Options options;
+  options.set_max_cells(100);
+  options.set_deadline(absl::InfinitePast());
+  S2RegionCoverer coverer(options);
+  CountingRegion region(&cap);
+  vector<S2CellId> covering, interior;
+  coverer.GetCovering(region, &covering);
+  EXPECT_TRUE(coverer.last_covering_approximate());
+  EXPECT_EQ(0, region.num_predicates());
+  CheckCovering(options, cap, covering, false, /*check_tight=*/false);
+
+  // No cells are known to be contained by the region.
+  coverer.GetInteriorCovering(region, &interior);
+  EXPECT_TRUE(coverer.last_covering_approximate());
+  EXPECT_TRUE(interior.empty());
+
+  // The covering is exact again once the deadline is removed.
+  coverer.mutable_options()->set_deadline(absl::InfiniteFuture());
+  coverer.GetCovering(region, &covering);
+  EXPECT_FALSE(coverer.last_covering_approximate());
+  EXPECT_GT(region.num_predicates(), 0);
+}
+
 TEST(GetFastCovering, HugeFixedLevelCovering) {
   // Test a "fast covering" with a huge number of cells due to min_level().
   S2RegionCoverer::Options options;
@@ -514,6 +735,75 @@ TEST(CanonicalizeCovering, MaxCellsMergesRepeatedly) {
       {"0/0121", "0/0123", "1/"}, options);
 }
 
+TEST(GetCoveringRanges, MergesByGapAndBudget) {
+  // Three leaf cells separated by gaps of 1 and 9 leaf cells.
+  S2CellId a = S2CellId::Begin(S2CellId::kMaxLevel);
+  S2CellId b = a.advance(2);
+  S2CellId c = b.advance(10);
+  S2CellUnion region({a, b, c});
+  S2RegionCoverer coverer;
+  using Range = S2RegionCoverer::LeafCellRange;
+  vector<Range> ranges;
+  coverer.GetCoveringRanges(region, 10, 0, &ranges);
+  EXPECT_EQ(ranges, (vector<Range>{{a, a}, {b, b}, {c, c}}));
+  coverer.GetCoveringRanges(region, 10, 1, &ranges);
+  EXPECT_EQ(ranges, (vector<Range>{{a, b}, {c, c}}));
+  coverer.GetCoveringRanges(region, 2, 0, &ranges);
+  EXPECT_EQ(ranges, (vector<Range>{{a, b}, {c, c}}));
+  coverer.GetCoveringRanges(region, 1, 0, &ranges);
+  EXPECT_EQ(ranges, (vector<Range>{{a, c}}));
+
+  coverer.GetCoveringRanges(S2CellUnion(), 1, 0, &ranges);
+  EXPECT_TRUE(ranges.empty());
+}
+
+TEST(GetCoveringRanges, RandomCaps) {
+  S2RegionCoverer coverer;
+  coverer.mutable_options()->set_max_cells(100);
+  vector<S2RegionCoverer::LeafCellRange> ranges;
+  for (int iter = 0; iter < 200; ++iter) {
+    S2Cap cap = S2Testing::GetRandomCap(1e-10, 1e-2);
+    int max_ranges = 1 + S2Testing::rnd.Uniform(20);
+    uint64 max_gap = S2Testing::rnd.OneIn(2) ? 0 :
+        S2Testing::rnd.Rand64() >> S2Testing::rnd.Uniform(64);
+    S2CellUnion covering = coverer.GetCovering(cap);
+    coverer.GetCoveringRanges(cap, max_ranges, max_gap, &ranges);
+    ASSERT_FALSE(ranges.empty());
+    EXPECT_LE(ranges.size(), max_ranges);
+
+    // The ranges are sorted, separated by gaps larger than "max_gap", and
+    // each one starts and ends with a leaf cell of the covering.
+    uint64 num_leaves = 0;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+      EXPECT_TRUE(ranges[i].start.is_leaf());
+      EXPECT_TRUE(ranges[i].end.is_leaf());
+      EXPECT_LE(ranges[i].start, ranges[i].end);
+      EXPECT_TRUE(covering.Contains(ranges[i].start));
+      EXPECT_TRUE(covering.Contains(ranges[i].end));
+      num_leaves += (ranges[i].end.id() - ranges[i].start.id()) / 2 + 1;
+      if (i > 0) {
+        EXPECT_GT((ranges[i].start.id() - ranges[i - 1].end.id()) / 2 - 1,
+                  max_gap);
+      }
+    }
+    // Every cell of the covering is contained by some range.
+    for (S2CellId id : covering) {
+      auto it = std::upper_bound(
+          ranges.begin(), ranges.end(), id.range_min(),
+          [](S2CellId x, const S2RegionCoverer::LeafCellRange& r) {
+            return x < r.start;
+          });
+      ASSERT_NE(it, ranges.begin());
+      --it;
+      EXPECT_LE(id.range_max(), it->end);
+    }
+    if (ranges.size() < max_ranges && max_gap == 0) {
+      // No merging beyond contiguous ranges was necessary.
+      EXPECT_EQ(num_leaves, covering.LeafCellsCovered());
+    }
+  }
+}
+
 vector<string> ToTokens(const S2CellUnion& cell_union) {
   vector<string> tokens;
   for (auto& cell_id : cell_union) {
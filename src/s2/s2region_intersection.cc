@@ -20,12 +20,19 @@
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/log/absl_check.h"
 #include "s2/s2cap.h"
+#include "s2/s2cell.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_index.h"
+#include "s2/s2cell_union.h"
 #include "s2/s2latlng_rect.h"
 #include "s2/s2point.h"
 #include "s2/s2region.h"
+#include "s2/s2region_coverer.h"
 
+using std::make_unique;
 using std::unique_ptr;
 using std::vector;
 
@@ -37,6 +44,7 @@ S2RegionIntersection::S2RegionIntersection(
 void S2RegionIntersection::Init(vector<unique_ptr<S2Region>> regions) {
   ABSL_DCHECK(regions_.empty());
   regions_ = std::move(regions);
+  index_.reset();
 }
 
 S2RegionIntersection::S2RegionIntersection(const S2RegionIntersection& src)
@@ -44,14 +52,43 @@ S2RegionIntersection::S2RegionIntersection(const S2RegionIntersection& src)
   for (int i = 0; i < num_regions(); ++i) {
     regions_[i].reset(src.region(i)->Clone());
   }
+  if (src.has_index()) BuildIndex(src.index_options_);
 }
 
 vector<unique_ptr<S2Region>> S2RegionIntersection::Release() {
   vector<unique_ptr<S2Region>> result;
   result.swap(regions_);
+  index_.reset();
   return result;
 }
 
+void S2RegionIntersection::BuildIndex(
+    const S2RegionCoverer::Options& options) {
+  index_ = make_unique<S2CellIndex>();
+  index_options_ = options;
+  S2RegionCoverer coverer(options);
+  S2CellUnion bound = S2CellUnion::WholeSphere();
+  for (int i = 0; i < num_regions(); ++i) {
+    S2CellUnion covering = coverer.GetCovering(*region(i));
+    index_->Add(covering, i);
+    bound = bound.Intersection(covering);
+  }
+  index_->Build();
+  index_bound_ = bound.Release();
+}
+
+bool S2RegionIntersection::AllCoveringsIntersect(S2CellId id) const {
+  // Each region's covering can intersect "id" in several cells, so we count
+  // the distinct labels.
+  absl::flat_hash_set<S2CellIndex::Label> labels;
+  index_->VisitIntersectingCells(id, [&labels](S2CellId,
+                                               S2CellIndex::Label label) {
+    labels.insert(label);
+    return true;
+  });
+  return labels.size() == static_cast<size_t>(num_regions());
+}
+
 S2RegionIntersection* S2RegionIntersection::Clone() const {
   return new S2RegionIntersection(*this);
 }
@@ -71,10 +108,15 @@ S2LatLngRect S2RegionIntersection::GetRectBound() const {
 }
 
 void S2RegionIntersection::GetCellUnionBound(vector<S2CellId>* cell_ids) const {
+  if (has_index()) {
+    *cell_ids = index_bound_;
+    return;
+  }
   GetCapBound().GetCellUnionBound(cell_ids);
 }
 
 bool S2RegionIntersection::Contains(const S2Cell& cell) const {
+  if (has_index() && !AllCoveringsIntersect(cell.id())) return false;
   for (int i = 0; i < num_regions(); ++i) {
     if (!region(i)->Contains(cell)) return false;
   }
@@ -82,6 +124,17 @@ bool S2RegionIntersection::Contains(const S2Cell& cell) const {
 }
 
 bool S2RegionIntersection::Contains(const S2Point& p) const {
+  if (has_index()) {
+    // The cells of each covering are disjoint, so each region's covering
+    // intersects the leaf cell containing "p" at most once.
+    int count = 0;
+    index_->VisitIntersectingCells(
+        S2CellId(p), [&count](S2CellId, S2CellIndex::Label) {
+          ++count;
+          return true;
+        });
+    if (count < num_regions()) return false;
+  }
   for (int i = 0; i < num_regions(); ++i) {
     if (!region(i)->Contains(p)) return false;
   }
@@ -89,6 +142,7 @@ bool S2RegionIntersection::Contains(const S2Point& p) const {
 }
 
 bool S2RegionIntersection::MayIntersect(const S2Cell& cell) const {
+  if (has_index() && !AllCoveringsIntersect(cell.id())) return false;
   for (int i = 0; i < num_regions(); ++i) {
     if (!region(i)->MayIntersect(cell)) return false;
   }
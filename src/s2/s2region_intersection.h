@@ -23,8 +23,11 @@
 #include "absl/base/macros.h"
 
 #include "s2/_fp_contract_off.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_index.h"
 #include "s2/s2point.h"
 #include "s2/s2region.h"
+#include "s2/s2region_coverer.h"
 
 class Decoder;
 class Encoder;
@@ -57,6 +60,18 @@ class S2RegionIntersection final : public S2Region {
   int num_regions() const { return regions_.size(); }
   const S2Region* region(int i) const { return regions_[i].get(); }
 
+  // Builds an S2CellIndex of coverings of the regions (computed with the
+  // given options).  Contains() and MayIntersect() then return false without
+  // testing any region unless the coverings of all the regions intersect the
+  // query point or cell, which is much faster for queries that are outside
+  // the intersection.  The index also makes GetCellUnionBound() return the
+  // intersection of the coverings.
+  //
+  // The index is discarded by Init() and Release().
+  void BuildIndex(const S2RegionCoverer::Options& options =
+                      S2RegionCoverer::Options());
+  bool has_index() const { return index_ != nullptr; }
+
   ////////////////////////////////////////////////////////////////////////
   // S2Region interface (see s2region.h for details):
 
@@ -73,8 +88,18 @@ class S2RegionIntersection final : public S2Region {
   // its argument.
   S2RegionIntersection(const S2RegionIntersection& src);
 
+  // Returns true if the indexed coverings of all the regions intersect "id".
+  // REQUIRES: has_index()
+  bool AllCoveringsIntersect(S2CellId id) const;
+
   std::vector<std::unique_ptr<S2Region>> regions_;
 
+  // The index built by BuildIndex() (if any), the options used to build it,
+  // and the intersection of the indexed coverings.
+  std::unique_ptr<S2CellIndex> index_;
+  S2RegionCoverer::Options index_options_;
+  std::vector<S2CellId> index_bound_;
+
   void operator=(const S2RegionIntersection&) = delete;
 };
 
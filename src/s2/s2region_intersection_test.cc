@@ -0,0 +1,91 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2region_intersection.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2latlng.h"
+#include "s2/s2latlng_rect.h"
+#include "s2/s2point.h"
+#include "s2/s2region.h"
+#include "s2/s2region_coverer.h"
+#include "s2/s2testing.h"
+
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+TEST(S2RegionIntersectionTest, Empty) {
+  S2RegionIntersection empty((vector<unique_ptr<S2Region>>()));
+  empty.BuildIndex();
+  EXPECT_TRUE(empty.Contains(S2Testing::RandomPoint()));
+  EXPECT_TRUE(empty.Contains(S2Cell::FromFace(0)));
+  vector<S2CellId> bound;
+  empty.GetCellUnionBound(&bound);
+  EXPECT_EQ(S2CellUnion(bound), S2CellUnion::WholeSphere());
+}
+
+TEST(S2RegionIntersectionTest, IndexMatchesLinearScan) {
+  // Overlapping caps around a common center, together with a rectangle.
+  S2Point center = S2Testing::RandomPoint();
+  vector<unique_ptr<S2Region>> regions;
+  for (int i = 0; i < 20; ++i) {
+    S2Cap cap(S2Testing::SamplePoint(S2Cap(center, S1Angle::Degrees(1))),
+              S1Angle::Degrees(2 + S2Testing::rnd.RandDouble()));
+    regions.push_back(make_unique<S2Cap>(cap));
+  }
+  S2LatLng ll(center);
+  regions.push_back(make_unique<S2LatLngRect>(S2LatLngRect::FromCenterSize(
+      ll, S2LatLng::FromDegrees(3, 3))));
+  S2RegionIntersection expected(std::move(regions));
+  unique_ptr<S2RegionIntersection> actual(expected.Clone());
+  actual->BuildIndex();
+  ASSERT_TRUE(actual->has_index());
+  EXPECT_TRUE(unique_ptr<S2RegionIntersection>(actual->Clone())->has_index());
+
+  S2Cap sample_cap(center, S1Angle::Degrees(4));
+  for (int i = 0; i < 1000; ++i) {
+    S2Point p = (i & 1) ? S2Testing::RandomPoint()
+                        : S2Testing::SamplePoint(sample_cap);
+    EXPECT_EQ(expected.Contains(p), actual->Contains(p));
+    S2Cell cell(S2CellId(p).parent(S2Testing::rnd.Uniform(20)));
+    EXPECT_EQ(expected.Contains(cell), actual->Contains(cell));
+    EXPECT_EQ(expected.MayIntersect(cell), actual->MayIntersect(cell));
+  }
+
+  // The bound is the intersection of the coverings, so it is contained by
+  // the covering of every region.
+  vector<S2CellId> bound;
+  actual->GetCellUnionBound(&bound);
+  S2CellUnion bound_union(bound);
+  S2RegionCoverer coverer;
+  for (int i = 0; i < actual->num_regions(); ++i) {
+    EXPECT_TRUE(coverer.GetCovering(*actual->region(i)).Contains(bound_union));
+  }
+  EXPECT_TRUE(bound_union.Contains(center));
+}
+
+}  // namespace
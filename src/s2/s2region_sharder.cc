@@ -15,19 +15,29 @@
 
 #include "s2/s2region_sharder.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 
 #include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/inlined_vector.h"
+#include "absl/log/absl_check.h"
 #include "absl/meta/type_traits.h"
+#include "absl/types/span.h"
+#include "s2/base/types.h"
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_index.h"
 #include "s2/s2cell_union.h"
+#include "s2/s2point.h"
 #include "s2/s2region.h"
 
+using absl::Span;
+using std::min;
+using std::pair;
 using std::vector;
 
 S2RegionSharder::S2RegionSharder(const vector<S2CellUnion>& shards) {
@@ -35,6 +45,24 @@ S2RegionSharder::S2RegionSharder(const vector<S2CellUnion>& shards) {
     index_.Add(shards[i], i);
   }
   index_.Build();
+
+  // Flatten the index into a table mapping each leaf cell range to the
+  // smallest shard that covers it, merging adjacent ranges with the same
+  // shard.
+  S2CellIndex::RangeIterator range(&index_);
+  S2CellIndex::ContentsIterator contents(&index_);
+  for (range.Begin(); !range.done(); range.Next()) {
+    int shard = -1;
+    // Clear() ensures that no labels are suppressed as duplicates.
+    contents.Clear();
+    for (contents.StartUnion(range); !contents.done(); contents.Next()) {
+      shard = (shard < 0) ? contents.label() : min(shard, contents.label());
+    }
+    if (!range_shards_.empty() && range_shards_.back() == shard) continue;
+    range_starts_.push_back(range.start_id());
+    range_shards_.push_back(shard);
+  }
+  range_starts_.push_back(S2CellId::End(S2CellId::kMaxLevel));
 }
 
 absl::flat_hash_map<int, S2CellUnion> ToS2CellUnionMap(
@@ -136,6 +164,86 @@ int S2RegionSharder::GetMostIntersectingShard(const S2Region& region,
   return best_shard;
 }
 
+int S2RegionSharder::GetLeafShard(S2CellId leaf, int default_shard) const {
+  // The first range starts at S2CellId::Begin(kMaxLevel), so "it" is always
+  // preceded by at least one range.
+  auto it = std::upper_bound(range_starts_.begin(), range_starts_.end(), leaf);
+  int shard = range_shards_[it - range_starts_.begin() - 1];
+  return shard >= 0 ? shard : default_shard;
+}
+
+int S2RegionSharder::GetContainingShard(const S2Point& point,
+                                        int default_shard) const {
+  return GetLeafShard(S2CellId(point), default_shard);
+}
+
+int S2RegionSharder::GetMostIntersectingShard(S2CellId cell_id,
+                                              int default_shard) const {
+  ABSL_DCHECK(cell_id.is_valid());
+  const S2CellId first = cell_id.range_min();
+  const S2CellId limit = cell_id.range_max().next();
+  size_t i = std::upper_bound(range_starts_.begin(), range_starts_.end(),
+                              first) - range_starts_.begin() - 1;
+  if (range_starts_[i + 1] >= limit) {
+    // The cell is contained by a single range (the common case).
+    return range_shards_[i] >= 0 ? range_shards_[i] : default_shard;
+  }
+  // Otherwise total the number of leaf cells covered by each shard.
+  absl::InlinedVector<pair<int, uint64>, 4> overlaps;
+  for (; range_starts_[i] < limit; ++i) {
+    int shard = range_shards_[i];
+    if (shard < 0) continue;
+    uint64 overlap = min(range_starts_[i + 1], limit).id() -
+                     std::max(range_starts_[i], first).id();
+    auto it = std::find_if(overlaps.begin(), overlaps.end(),
+                           [shard](const pair<int, uint64>& p) {
+                             return p.first == shard;
+                           });
+    if (it == overlaps.end()) {
+      overlaps.push_back({shard, overlap});
+    } else {
+      it->second += overlap;
+    }
+  }
+  int best_shard = default_shard;
+  uint64 best_overlap = 0;
+  for (const auto& [shard, overlap] : overlaps) {
+    if (overlap > best_overlap ||
+        (overlap == best_overlap && shard < best_shard)) {
+      best_shard = shard;
+      best_overlap = overlap;
+    }
+  }
+  return best_shard;
+}
+
+void S2RegionSharder::GetContainingShards(Span<const S2Point> points,
+                                          int default_shard,
+                                          Span<int> shards) const {
+  ABSL_DCHECK_EQ(points.size(), shards.size());
+  // Convert the points to leaf cells in batches, which is faster than
+  // converting them one at a time.
+  constexpr size_t kBatchSize = 256;
+  S2CellId ids[kBatchSize];
+  for (size_t i = 0; i < points.size(); i += kBatchSize) {
+    const size_t n = min(kBatchSize, points.size() - i);
+    S2CellId::FromPoints(points.subspan(i, n), S2CellId::kMaxLevel,
+                         Span<S2CellId>(ids, n));
+    for (size_t j = 0; j < n; ++j) {
+      shards[i + j] = GetLeafShard(ids[j], default_shard);
+    }
+  }
+}
+
+void S2RegionSharder::GetMostIntersectingShards(Span<const S2CellId> cell_ids,
+                                                int default_shard,
+                                                Span<int> shards) const {
+  ABSL_DCHECK_EQ(cell_ids.size(), shards.size());
+  for (size_t i = 0; i < cell_ids.size(); ++i) {
+    shards[i] = GetMostIntersectingShard(cell_ids[i], default_shard);
+  }
+}
+
 vector<int> S2RegionSharder::GetIntersectingShards(
     const S2Region& region) const {
   vector<int> shard_numbers;
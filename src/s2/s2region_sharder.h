@@ -19,8 +19,12 @@
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
+#include "s2/base/types.h"
+#include "s2/s2cell_id.h"
 #include "s2/s2cell_index.h"
 #include "s2/s2cell_union.h"
+#include "s2/s2point.h"
 #include "s2/s2region.h"
 
 // S2RegionSharder implements a sharding function that provides shard IDs whose
@@ -49,11 +53,47 @@ class S2RegionSharder {
   // no shards overlap, returns an empty vector.
   std::vector<int> GetIntersectingShards(const S2Region& region) const;
 
+  // The following methods are fast paths for points and cells, which are
+  // much faster than the S2Region methods above and do not allocate memory.
+  // They use a flattened table of the leaf cell ranges covered by each
+  // shard, and take O(log n) time where "n" is the number of ranges.  Where
+  // shards overlap, each range is assigned to the smallest shard number
+  // that covers it.
+
+  // Returns the shard containing the given point, or 'default_shard' if no
+  // shard contains it.  The point does not need to be normalized.
+  int GetContainingShard(const S2Point& point, int default_shard) const;
+
+  // Returns the shard whose covering has the most overlap with the given
+  // cell, or 'default_shard' if no shards overlap it.  Ties are broken in
+  // favor of the smallest shard number.
+  int GetMostIntersectingShard(S2CellId cell_id, int default_shard) const;
+
+  // Batch versions of the methods above, which set shards[k] to the shard
+  // for points[k] or cell_ids[k] respectively.
+  //
+  // REQUIRES: shards.size() == points.size() (or cell_ids.size())
+  void GetContainingShards(absl::Span<const S2Point> points,
+                           int default_shard, absl::Span<int> shards) const;
+  void GetMostIntersectingShards(absl::Span<const S2CellId> cell_ids,
+                                 int default_shard,
+                                 absl::Span<int> shards) const;
+
  private:
   absl::flat_hash_map<int, S2CellUnion> GetIntersectionsByShard(
       const S2Region& region) const;
 
+  // Returns the shard containing the given leaf cell, or 'default_shard'.
+  int GetLeafShard(S2CellId leaf, int default_shard) const;
+
   S2CellIndex index_;
+
+  // range_shards_[i] is the shard (or -1 if none) that covers the leaf cells
+  // in [range_starts_[i], range_starts_[i + 1]).  Adjacent ranges always
+  // have different shards, and the last element of range_starts_ is a
+  // sentinel value.
+  std::vector<S2CellId> range_starts_;
+  std::vector<int32> range_shards_;
 };
 
 #endif  // S2_S2REGION_SHARDER_H_
@@ -19,8 +19,12 @@
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "absl/types/span.h"
+#include "s2/base/types.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_union.h"
+#include "s2/s2point.h"
+#include "s2/s2testing.h"
 
 namespace {
 
@@ -91,4 +95,73 @@ TEST(S2RegionSharderTest, GetIntersectingShards) {
               testing::IsEmpty());
 }
 
+TEST(S2RegionSharderTest, PointAndCellFastPaths) {
+  vector<S2CellUnion> coverings{
+      S2CellUnion({S2CellId::FromFacePosLevel(0, 0, 10)}),
+      S2CellUnion({
+          S2CellId::FromFacePosLevel(1, 1, 9),
+          S2CellId::FromFacePosLevel(3, 0, 8),
+      }),
+      S2CellUnion({S2CellId::FromFacePosLevel(5, 0, 10)}),
+  };
+  S2RegionSharder sharder(coverings);
+
+  // Choose cells and points that are inside, outside, and overlapping the
+  // boundaries of the shards.
+  vector<S2CellId> cell_ids;
+  vector<S2Point> points;
+  for (const S2CellUnion& covering : coverings) {
+    for (S2CellId id : covering) {
+      for (int level = id.level() - 2; level <= id.level() + 2; ++level) {
+        for (S2CellId start : {id.range_min(), id.range_max()}) {
+          cell_ids.push_back(start.parent(level));
+          cell_ids.push_back(start.parent(level).next_wrap());
+          cell_ids.push_back(start.parent(level).prev_wrap());
+        }
+      }
+    }
+  }
+  for (int i = 0; i < 100; ++i) {
+    cell_ids.push_back(S2Testing::GetRandomCellId());
+  }
+  for (S2CellId id : cell_ids) points.push_back(id.ToPoint());
+
+  vector<int> point_shards(points.size()), cell_shards(cell_ids.size());
+  sharder.GetContainingShards(points, 42, absl::MakeSpan(point_shards));
+  sharder.GetMostIntersectingShards(cell_ids, 42, absl::MakeSpan(cell_shards));
+  for (int i = 0; i < cell_ids.size(); ++i) {
+    // Compute the expected results by brute force.  (The S2Region methods
+    // can't be used for this because they are approximate.)
+    int expected_point_shard = 42, expected_cell_shard = 42;
+    uint64 best_overlap = 0;
+    for (int j = 0; j < coverings.size(); ++j) {
+      if (coverings[j].Contains(points[i])) expected_point_shard = j;
+      uint64 overlap = 0;
+      S2CellUnion cell({cell_ids[i]});
+      for (S2CellId id : coverings[j].Intersection(cell)) overlap += id.lsb();
+      if (overlap > best_overlap) {
+        expected_cell_shard = j;
+        best_overlap = overlap;
+      }
+    }
+    EXPECT_EQ(expected_point_shard, sharder.GetContainingShard(points[i], 42));
+    EXPECT_EQ(expected_point_shard, point_shards[i]);
+    EXPECT_EQ(expected_cell_shard,
+              sharder.GetMostIntersectingShard(cell_ids[i], 42))
+        << cell_ids[i];
+    EXPECT_EQ(expected_cell_shard, cell_shards[i]);
+  }
+}
+
+TEST(S2RegionSharderTest, OverlappingShardsUseSmallestShard) {
+  S2CellId id = S2CellId::FromFacePosLevel(2, 0, 10);
+  S2RegionSharder sharder(
+      {S2CellUnion({id.child(1)}), S2CellUnion({id}), S2CellUnion({id})});
+  EXPECT_EQ(0, sharder.GetContainingShard(id.child(1).ToPoint(), -1));
+  EXPECT_EQ(1, sharder.GetContainingShard(id.child(2).ToPoint(), -1));
+  EXPECT_EQ(1, sharder.GetMostIntersectingShard(id, -1));
+  EXPECT_EQ(0, sharder.GetMostIntersectingShard(id.child(1), -1));
+  EXPECT_EQ(-1, sharder.GetMostIntersectingShard(id.next(), -1));
+}
+
 }  // namespace
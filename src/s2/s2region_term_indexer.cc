@@ -128,8 +128,9 @@ string S2RegionTermIndexer::GetTerm(TermType term_type, const S2CellId id,
   }
 }
 
-vector<string> S2RegionTermIndexer::GetIndexTerms(const S2Point& point,
-                                                  string_view prefix) {
+template <class Emit>
+void S2RegionTermIndexer::VisitIndexTerms(const S2Point& point,
+                                          Emit emit) const {
   // See the top of this file for an overview of the indexing strategy.
   //
   // The last cell generated by this loop is effectively the covering for
@@ -140,14 +141,25 @@ vector<string> S2RegionTermIndexer::GetIndexTerms(const S2Point& point,
   // max_level() != true_max_level() (see S2RegionCoverer::Options).
 
   const S2CellId id(point);
-  vector<string> terms;
-  terms.reserve((options_.true_max_level() - options_.min_level()) /
-                    options_.level_mod() +
-                1);
   for (int level = options_.min_level(); level <= options_.max_level();
        level += options_.level_mod()) {
-    terms.push_back(GetTerm(TermType::ANCESTOR, id.parent(level), prefix));
+    emit(TermType::ANCESTOR, id.parent(level));
   }
+}
+
+int S2RegionTermIndexer::NumIndexTermsForPoint() const {
+  return (options_.true_max_level() - options_.min_level()) /
+             options_.level_mod() +
+         1;
+}
+
+vector<string> S2RegionTermIndexer::GetIndexTerms(const S2Point& point,
+                                                  string_view prefix) {
+  vector<string> terms;
+  terms.reserve(NumIndexTermsForPoint());
+  VisitIndexTerms(point, [&](TermType term_type, S2CellId id) {
+    terms.push_back(GetTerm(term_type, id, prefix));
+  });
   return terms;
 }
 
@@ -159,8 +171,9 @@ vector<string> S2RegionTermIndexer::GetIndexTerms(const S2Region& region,
   return GetIndexTermsForCanonicalCovering(covering, prefix);
 }
 
-vector<string> S2RegionTermIndexer::GetIndexTermsForCanonicalCovering(
-    const S2CellUnion& covering, string_view prefix) {
+template <class CellRange, class Emit>
+void S2RegionTermIndexer::VisitIndexTerms(const CellRange& covering,
+                                          Emit emit) const {
   // See the top of this file for an overview of the indexing strategy.
   //
   // Cells in the covering are normally indexed as covering terms.  If we are
@@ -171,14 +184,6 @@ vector<string> S2RegionTermIndexer::GetIndexTermsForCanonicalCovering(
   // that query regions will never contain a descendant of these cells.
 
   ABSL_CHECK(!options_.index_contains_points_only());
-  if (google::DEBUG_MODE) {
-    *coverer_.mutable_options() = options_;
-    ABSL_CHECK(coverer_.IsCanonical(covering));
-  }
-  vector<string> terms;
-  // `covering.size()` is necessary.  Double it because we'll probably add
-  // more.  This could probably reasonably be even higher.
-  terms.reserve(2 * covering.size());
   S2CellId prev_id = S2CellId::None();
   int true_max_level = options_.true_max_level();
   for (S2CellId id : covering) {
@@ -191,11 +196,11 @@ vector<string> S2RegionTermIndexer::GetIndexTermsForCanonicalCovering(
 
     if (level < true_max_level) {
       // Add a covering term for this cell.
-      terms.push_back(GetTerm(TermType::COVERING, id, prefix));
+      emit(TermType::COVERING, id);
     }
     if (level == true_max_level || !options_.optimize_for_space()) {
       // Add an ancestor term for this cell at the constrained level.
-      terms.push_back(GetTerm(TermType::ANCESTOR, id.parent(level), prefix));
+      emit(TermType::ANCESTOR, id.parent(level));
     }
     // Finally, add ancestor terms for all the ancestors of this cell.
     while ((level -= options_.level_mod()) >= options_.min_level()) {
@@ -204,33 +209,60 @@ vector<string> S2RegionTermIndexer::GetIndexTermsForCanonicalCovering(
           prev_id.parent(level) == ancestor_id) {
         break;  // We have already processed this cell and its ancestors.
       }
-      terms.push_back(GetTerm(TermType::ANCESTOR, ancestor_id, prefix));
+      emit(TermType::ANCESTOR, ancestor_id);
     }
     prev_id = id;
   }
+}
+
+vector<string> S2RegionTermIndexer::GetIndexTermsForCanonicalCovering(
+    const S2CellUnion& covering, string_view prefix) {
+  if (google::DEBUG_MODE) {
+    *coverer_.mutable_options() = options_;
+    ABSL_CHECK(coverer_.IsCanonical(covering));
+  }
+  vector<string> terms;
+  // `covering.size()` is necessary.  Double it because we'll probably add
+  // more.  This could probably reasonably be even higher.
+  terms.reserve(2 * covering.size());
+  VisitIndexTerms(covering.cell_ids(), [&](TermType term_type, S2CellId id) {
+    terms.push_back(GetTerm(term_type, id, prefix));
+  });
   return terms;
 }
 
-vector<string> S2RegionTermIndexer::GetQueryTerms(const S2Point& point,
-                                                  string_view prefix) {
+template <class Emit>
+void S2RegionTermIndexer::VisitQueryTerms(const S2Point& point,
+                                          Emit emit) const {
   // See the top of this file for an overview of the indexing strategy.
 
   const S2CellId id(point);
-  vector<string> terms;
-  terms.reserve(options_.index_contains_points_only()
-                    ? 1
-                    : ((options_.true_max_level() - options_.min_level()) /
-                           options_.level_mod() +
-                       2));
   // Recall that all true_max_level() cells are indexed only as ancestor terms.
   int level = options_.true_max_level();
-  terms.push_back(GetTerm(TermType::ANCESTOR, id.parent(level), prefix));
-  if (options_.index_contains_points_only()) return terms;
+  emit(TermType::ANCESTOR, id.parent(level));
+  if (options_.index_contains_points_only()) return;
 
   // Add covering terms for all the ancestor cells.
   for (; level >= options_.min_level(); level -= options_.level_mod()) {
-    terms.push_back(GetTerm(TermType::COVERING, id.parent(level), prefix));
+    emit(TermType::COVERING, id.parent(level));
   }
+}
+
+int S2RegionTermIndexer::NumQueryTermsForPoint() const {
+  return options_.index_contains_points_only()
+             ? 1
+             : ((options_.true_max_level() - options_.min_level()) /
+                    options_.level_mod() +
+                2);
+}
+
+vector<string> S2RegionTermIndexer::GetQueryTerms(const S2Point& point,
+                                                  string_view prefix) {
+  vector<string> terms;
+  terms.reserve(NumQueryTermsForPoint());
+  VisitQueryTerms(point, [&](TermType term_type, S2CellId id) {
+    terms.push_back(GetTerm(term_type, id, prefix));
+  });
   return terms;
 }
 
@@ -242,16 +274,11 @@ vector<string> S2RegionTermIndexer::GetQueryTerms(const S2Region& region,
   return GetQueryTermsForCanonicalCovering(covering, prefix);
 }
 
-vector<string> S2RegionTermIndexer::GetQueryTermsForCanonicalCovering(
-    const S2CellUnion& covering, string_view prefix) {
+template <class CellRange, class Emit>
+void S2RegionTermIndexer::VisitQueryTerms(const CellRange& covering,
+                                          Emit emit) const {
   // See the top of this file for an overview of the indexing strategy.
 
-  if (google::DEBUG_MODE) {
-    *coverer_.mutable_options() = options_;
-    ABSL_CHECK(coverer_.IsCanonical(covering));
-  }
-  vector<string> terms;
-  terms.reserve(2 * covering.size());
   S2CellId prev_id = S2CellId::None();
   int true_max_level = options_.true_max_level();
   for (S2CellId id : covering) {
@@ -263,7 +290,7 @@ vector<string> S2RegionTermIndexer::GetQueryTermsForCanonicalCovering(
     ABSL_DCHECK_EQ(0, (level - options_.min_level()) % options_.level_mod());
 
     // Cells in the covering are always queried as ancestor terms.
-    terms.push_back(GetTerm(TermType::ANCESTOR, id, prefix));
+    emit(TermType::ANCESTOR, id);
 
     // If the index only contains points, there are no covering terms.
     if (options_.index_contains_points_only()) continue;
@@ -272,7 +299,7 @@ vector<string> S2RegionTermIndexer::GetQueryTermsForCanonicalCovering(
     // also queried as covering terms (except for true_max_level() cells,
     // which are indexed and queried as ancestor cells only).
     if (options_.optimize_for_space() && level < true_max_level) {
-      terms.push_back(GetTerm(TermType::COVERING, id, prefix));
+      emit(TermType::COVERING, id);
     }
     // Finally, add covering terms for all the ancestors of this cell.
     while ((level -= options_.level_mod()) >= options_.min_level()) {
@@ -281,9 +308,122 @@ vector<string> S2RegionTermIndexer::GetQueryTermsForCanonicalCovering(
           prev_id.parent(level) == ancestor_id) {
         break;  // We have already processed this cell and its ancestors.
       }
-      terms.push_back(GetTerm(TermType::COVERING, ancestor_id, prefix));
+      emit(TermType::COVERING, ancestor_id);
     }
     prev_id = id;
   }
+}
+
+vector<string> S2RegionTermIndexer::GetQueryTermsForCanonicalCovering(
+    const S2CellUnion& covering, string_view prefix) {
+  if (google::DEBUG_MODE) {
+    *coverer_.mutable_options() = options_;
+    ABSL_CHECK(coverer_.IsCanonical(covering));
+  }
+  vector<string> terms;
+  terms.reserve(2 * covering.size());
+  VisitQueryTerms(covering.cell_ids(), [&](TermType term_type, S2CellId id) {
+    terms.push_back(GetTerm(term_type, id, prefix));
+  });
   return terms;
 }
+
+// Returns the uint64 encoding of a term (see GetCoveringTerm).
+static uint64 GetIntTerm(bool is_covering, S2CellId id) {
+  return is_covering ? S2RegionTermIndexer::GetCoveringTerm(id)
+                     : S2RegionTermIndexer::GetAncestorTerm(id);
+}
+
+void S2RegionTermIndexer::ComputeCovering(const S2Region& region) {
+  // Note that options may have changed since the last call.
+  *coverer_.mutable_options() = options_;
+  coverer_.GetCovering(region, &covering_);
+}
+
+void S2RegionTermIndexer::GetIndexTerms(const S2Point& point,
+                                        vector<uint64>* terms) {
+  terms->clear();
+  VisitIndexTerms(point, [terms](TermType term_type, S2CellId id) {
+    terms->push_back(GetIntTerm(term_type == TermType::COVERING, id));
+  });
+}
+
+void S2RegionTermIndexer::GetIndexTerms(const S2Region& region,
+                                        vector<uint64>* terms) {
+  ComputeCovering(region);
+  terms->clear();
+  VisitIndexTerms(covering_, [terms](TermType term_type, S2CellId id) {
+    terms->push_back(GetIntTerm(term_type == TermType::COVERING, id));
+  });
+}
+
+void S2RegionTermIndexer::GetIndexTermsForCanonicalCovering(
+    const S2CellUnion& covering, vector<uint64>* terms) {
+  if (google::DEBUG_MODE) {
+    *coverer_.mutable_options() = options_;
+    ABSL_CHECK(coverer_.IsCanonical(covering));
+  }
+  terms->clear();
+  VisitIndexTerms(covering.cell_ids(), [terms](TermType term_type,
+                                               S2CellId id) {
+    terms->push_back(GetIntTerm(term_type == TermType::COVERING, id));
+  });
+}
+
+void S2RegionTermIndexer::GetIndexTermsForNormalizedCovering(
+    const S2CellUnion& covering, vector<uint64>* terms) {
+  terms->clear();
+  VisitIndexTerms(
+      covering.DenormalizedCells(options_.min_level(), options_.level_mod()),
+      [terms](TermType term_type, S2CellId id) {
+        terms->push_back(GetIntTerm(term_type == TermType::COVERING, id));
+      });
+}
+
+void S2RegionTermIndexer::GetQueryTerms(const S2Point& point,
+                                        vector<uint64>* terms) {
+  terms->clear();
+  const int true_max_level = options_.true_max_level();
+  VisitQueryTerms(point, [terms, true_max_level](TermType term_type,
+                                                 S2CellId id) {
+    // Covering terms are never indexed for true_max_level() cells, so they
+    // are omitted here.  (This also avoids encoding covering terms for leaf
+    // cells, which have no lower bit position available.)
+    if (term_type == TermType::COVERING && id.level() == true_max_level) {
+      return;
+    }
+    terms->push_back(GetIntTerm(term_type == TermType::COVERING, id));
+  });
+}
+
+void S2RegionTermIndexer::GetQueryTerms(const S2Region& region,
+                                        vector<uint64>* terms) {
+  ComputeCovering(region);
+  terms->clear();
+  VisitQueryTerms(covering_, [terms](TermType term_type, S2CellId id) {
+    terms->push_back(GetIntTerm(term_type == TermType::COVERING, id));
+  });
+}
+
+void S2RegionTermIndexer::GetQueryTermsForCanonicalCovering(
+    const S2CellUnion& covering, vector<uint64>* terms) {
+  if (google::DEBUG_MODE) {
+    *coverer_.mutable_options() = options_;
+    ABSL_CHECK(coverer_.IsCanonical(covering));
+  }
+  terms->clear();
+  VisitQueryTerms(covering.cell_ids(), [terms](TermType term_type,
+                                               S2CellId id) {
+    terms->push_back(GetIntTerm(term_type == TermType::COVERING, id));
+  });
+}
+
+void S2RegionTermIndexer::GetQueryTermsForNormalizedCovering(
+    const S2CellUnion& covering, vector<uint64>* terms) {
+  terms->clear();
+  VisitQueryTerms(
+      covering.DenormalizedCells(options_.min_level(), options_.level_mod()),
+      [terms](TermType term_type, S2CellId id) {
+        terms->push_back(GetIntTerm(term_type == TermType::COVERING, id));
+      });
+}
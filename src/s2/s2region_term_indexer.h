@@ -102,6 +102,7 @@
 
 #include "absl/strings/string_view.h"
 
+#include "s2/base/types.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_union.h"
 #include "s2/s2point.h"
@@ -289,14 +290,79 @@ class S2RegionTermIndexer {
   std::vector<std::string> GetQueryTermsForCanonicalCovering(
       const S2CellUnion& covering, absl::string_view prefix);
 
+  // Like the methods above, but returns each term as a uint64 rather than
+  // as a string.  This is intended for indexes whose posting lists are keyed
+  // by integers; once "terms" (which is cleared first) and the internal
+  // covering storage have grown to their steady-state size, these methods
+  // do not allocate any memory.  There is no prefix, so terms for different
+  // kinds of location information must be kept in separate posting lists.
+  //
+  // An ancestor term is simply the id of the corresponding S2CellId.  A
+  // covering term is the cell id with its lowest set bit moved down by one
+  // position, so that the lowest set bit is at an odd position (whereas it
+  // is always at an even position for valid S2CellIds).  The two kinds of
+  // terms therefore never collide, and both are valid only when the terms
+  // are generated with the same options for indexing and queries.
+  void GetIndexTerms(const S2Region& region, std::vector<uint64>* terms);
+  void GetQueryTerms(const S2Region& region, std::vector<uint64>* terms);
+  void GetIndexTerms(const S2Point& point, std::vector<uint64>* terms);
+  void GetQueryTerms(const S2Point& point, std::vector<uint64>* terms);
+  void GetIndexTermsForCanonicalCovering(const S2CellUnion& covering,
+                                         std::vector<uint64>* terms);
+  void GetQueryTermsForCanonicalCovering(const S2CellUnion& covering,
+                                         std::vector<uint64>* terms);
+
+  // Like the methods above, but "covering" is denormalized on the fly (see
+  // S2CellUnion::DenormalizedCells) so that its cells satisfy min_level() and
+  // level_mod(), without storing the denormalized cells.  For example, this
+  // accepts a normalized covering (which can have far fewer cells), or the
+  // union of several coverings.
+  //
+  // REQUIRES: No cell of "covering" is smaller than true_max_level().
+  void GetIndexTermsForNormalizedCovering(const S2CellUnion& covering,
+                                          std::vector<uint64>* terms);
+  void GetQueryTermsForNormalizedCovering(const S2CellUnion& covering,
+                                          std::vector<uint64>* terms);
+
+  // Returns the uint64 term of the given type for "id" (see above).  This
+  // can be used to build terms for known cells directly.
+  static uint64 GetCoveringTerm(S2CellId id);
+  static uint64 GetAncestorTerm(S2CellId id) { return id.id(); }
+
  private:
   enum TermType { ANCESTOR, COVERING };
 
   std::string GetTerm(TermType term_type, const S2CellId id,
                       absl::string_view prefix) const;
 
+  // Calls "emit(term_type, id)" for each term of the given point or
+  // covering.  These are shared by the string and uint64 versions above.
+  template <class Emit>
+  void VisitIndexTerms(const S2Point& point, Emit emit) const;
+  template <class CellRange, class Emit>
+  void VisitIndexTerms(const CellRange& covering, Emit emit) const;
+  template <class Emit>
+  void VisitQueryTerms(const S2Point& point, Emit emit) const;
+  template <class CellRange, class Emit>
+  void VisitQueryTerms(const CellRange& covering, Emit emit) const;
+
+  // Returns the number of terms that will be generated for a point.
+  int NumIndexTermsForPoint() const;
+  int NumQueryTermsForPoint() const;
+
+  // Sets covering_ to the covering of "region" using the current options.
+  void ComputeCovering(const S2Region& region);
+
   Options options_;
   S2RegionCoverer coverer_;
+
+  // Covering storage reused by the uint64 methods.
+  std::vector<S2CellId> covering_;
 };
 
+inline uint64 S2RegionTermIndexer::GetCoveringTerm(S2CellId id) {
+  // Leaf cells never have covering terms (see the .cc file).
+  return id.id() - (id.lsb() >> 1);
+}
+
 #endif  // S2_S2REGION_TERM_INDEXER_H_
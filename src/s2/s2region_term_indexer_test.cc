@@ -29,6 +29,7 @@
 #include "absl/strings/str_format.h"
 
 #include "s2/base/commandlineflags.h"
+#include "s2/base/types.h"
 #include "s2/s2cap.h"
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
@@ -212,6 +213,90 @@ TEST(S2RegionTermIndexer, MaxLevelSetLoosely) {
             indexer2.GetQueryTerms(cap, ""));
 }
 
+// Converts string terms (generated with an empty prefix) to the equivalent
+// uint64 terms.
+vector<uint64> ToIntTerms(const vector<string>& terms, char marker) {
+  vector<uint64> result;
+  for (const string& term : terms) {
+    if (term[0] == marker) {
+      result.push_back(S2RegionTermIndexer::GetCoveringTerm(
+          S2CellId::FromToken(term.substr(1))));
+    } else {
+      result.push_back(
+          S2RegionTermIndexer::GetAncestorTerm(S2CellId::FromToken(term)));
+    }
+  }
+  return result;
+}
+
+TEST(S2RegionTermIndexer, IntTermsMatchStringTerms) {
+  for (int max_level : {16, S2CellId::kMaxLevel}) {
+    for (bool optimize_for_space : {false, true}) {
+      S2RegionTermIndexer::Options options;
+      options.set_min_level(2);
+      options.set_max_level(max_level);
+      options.set_optimize_for_space(optimize_for_space);
+      S2RegionTermIndexer indexer(options);
+      const char marker = options.marker_character();
+      vector<uint64> terms;
+      for (int iter = 0; iter < 50; ++iter) {
+        S2Cap cap = S2Testing::GetRandomCap(
+            0.3 * S2Cell::AverageArea(options.max_level()),
+            4.0 * S2Cell::AverageArea(options.min_level()));
+        indexer.GetIndexTerms(cap, &terms);
+        EXPECT_EQ(ToIntTerms(indexer.GetIndexTerms(cap, ""), marker), terms);
+        indexer.GetQueryTerms(cap, &terms);
+        EXPECT_EQ(ToIntTerms(indexer.GetQueryTerms(cap, ""), marker), terms);
+
+        S2Point point = S2Testing::RandomPoint();
+        indexer.GetIndexTerms(point, &terms);
+        EXPECT_EQ(ToIntTerms(indexer.GetIndexTerms(point, ""), marker),
+                  terms);
+
+        // The uint64 query terms for a point omit the covering term for the
+        // true_max_level() cell, since such terms are never indexed.
+        vector<string> string_terms = indexer.GetQueryTerms(point, "");
+        string_terms.erase(string_terms.begin() + 1);
+        indexer.GetQueryTerms(point, &terms);
+        EXPECT_EQ(ToIntTerms(string_terms, marker), terms);
+      }
+    }
+  }
+}
+
+TEST(S2RegionTermIndexer, NormalizedCoveringTermsMatchCanonicalTerms) {
+  S2RegionTermIndexer::Options options;
+  options.set_min_level(3);
+  options.set_max_level(20);
+  options.set_level_mod(2);
+  S2RegionTermIndexer indexer(options);
+  S2RegionCoverer coverer(options);
+  vector<uint64> expected, actual;
+  for (int iter = 0; iter < 50; ++iter) {
+    S2Cap cap = S2Testing::GetRandomCap(
+        0.3 * S2Cell::AverageArea(options.max_level()),
+        4.0 * S2Cell::AverageArea(options.min_level()));
+    S2CellUnion covering = coverer.GetCovering(cap);
+    S2CellUnion normalized(covering.cell_ids());
+    indexer.GetIndexTermsForCanonicalCovering(covering, &expected);
+    indexer.GetIndexTermsForNormalizedCovering(normalized, &actual);
+    EXPECT_EQ(expected, actual);
+    indexer.GetQueryTermsForCanonicalCovering(covering, &expected);
+    indexer.GetQueryTermsForNormalizedCovering(normalized, &actual);
+    EXPECT_EQ(expected, actual);
+  }
+}
+
+TEST(S2RegionTermIndexer, CoveringTermsAreNotCellIds) {
+  for (int level = 0; level < S2CellId::kMaxLevel; ++level) {
+    S2CellId id = S2Testing::GetRandomCellId(level);
+    uint64 term = S2RegionTermIndexer::GetCoveringTerm(id);
+    EXPECT_FALSE(S2CellId(term).is_valid());
+    EXPECT_NE(term, S2RegionTermIndexer::GetAncestorTerm(id));
+    EXPECT_NE(term, S2RegionTermIndexer::GetAncestorTerm(id.child_begin()));
+  }
+}
+
 TEST(S2RegionTermIndexer, MoveConstructor) {
   S2RegionTermIndexer x;
   x.mutable_options()->set_max_cells(12345);
@@ -347,4 +347,60 @@ TEST_F(S2RegionEncodeDecodeTest, S2Polyline) {
 // TODO(user): When the remaining types implement Encode/Decode, add their
 // test cases here. i.e. S2R2Rect, S2RegionIntersection, S2RegionUnion, etc.
 
+// Checks that GetChildRelations() agrees with MayIntersect() and Contains()
+// for the children of "cell" and, recursively, those of their descendants
+// that intersect the region boundary (up to "max_level").
+void CheckChildRelations(const S2Region& region, const S2Cell& cell,
+                         int max_level) {
+  S2Cell children[4];
+  if (!cell.Subdivide(children)) return;
+  for (bool check_contains : {false, true}) {
+    S2Region::CellRelation relations[4];
+    region.GetChildRelations(children, check_contains, relations);
+    for (int i = 0; i < 4; ++i) {
+      S2Region::CellRelation expected = S2Region::CellRelation::DISJOINT;
+      if (region.MayIntersect(children[i])) {
+        expected = check_contains && region.Contains(children[i])
+                       ? S2Region::CellRelation::CONTAINS
+                       : S2Region::CellRelation::MAY_INTERSECT;
+      }
+      ASSERT_EQ(relations[i], expected) << children[i].id();
+    }
+  }
+  if (cell.level() + 1 >= max_level) return;
+  for (const S2Cell& child : children) {
+    if (region.MayIntersect(child) && !region.Contains(child)) {
+      CheckChildRelations(region, child, max_level);
+    }
+  }
+}
+
+void CheckChildRelations(const S2Region& region, int max_level) {
+  for (int face = 0; face < 6; ++face) {
+    CheckChildRelations(region, S2Cell::FromFace(face), max_level);
+  }
+}
+
+TEST(S2Region, GetChildRelationsCap) {
+  const S2Point center = S2Point(1, 2, 3).Normalize();
+  CheckChildRelations(S2Cap::Empty(), 3);
+  CheckChildRelations(S2Cap::Full(), 3);
+  CheckChildRelations(S2Cap::FromPoint(center), 10);
+  CheckChildRelations(S2Cap(center, S1Angle::Degrees(0.5)), 10);
+  CheckChildRelations(S2Cap(center, S1Angle::Degrees(40)), 7);
+  CheckChildRelations(S2Cap(center, S1Angle::Degrees(150)), 7);
+}
+
+TEST(S2Region, GetChildRelationsLatLngRect) {
+  CheckChildRelations(S2LatLngRect::FromPointPair(
+                          S2LatLng::FromDegrees(-10, 170),
+                          S2LatLng::FromDegrees(30, -160)), 7);
+}
+
+TEST(S2Region, GetChildRelationsPolygon) {
+  unique_ptr<S2Polygon> polygon = s2textformat::MakePolygonOrDie(
+      "0:0, 0:10, 10:10, 10:0; 2:2, 8:2, 8:8, 2:8; 40:40, 40:45, 45:40");
+  CheckChildRelations(*polygon, 9);
+}
+
 }  // namespace
@@ -23,10 +23,16 @@
 
 #include "absl/log/absl_check.h"
 #include "s2/s2cap.h"
+#include "s2/s2cell.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_index.h"
+#include "s2/s2cell_union.h"
 #include "s2/s2latlng_rect.h"
 #include "s2/s2point.h"
 #include "s2/s2region.h"
+#include "s2/s2region_coverer.h"
 
+using std::make_unique;
 using std::unique_ptr;
 using std::vector;
 
@@ -37,6 +43,7 @@ S2RegionUnion::S2RegionUnion(vector<unique_ptr<S2Region>> regions) {
 void S2RegionUnion::Init(vector<unique_ptr<S2Region>> regions) {
   ABSL_DCHECK(regions_.empty());
   regions_ = std::move(regions);
+  index_.reset();
 }
 
 S2RegionUnion::S2RegionUnion(const S2RegionUnion& src)
@@ -44,16 +51,34 @@ S2RegionUnion::S2RegionUnion(const S2RegionUnion& src)
   for (int i = 0; i < num_regions(); ++i) {
     regions_[i].reset(src.region(i)->Clone());
   }
+  if (src.has_index()) BuildIndex(src.index_options_);
 }
 
 vector<unique_ptr<S2Region>> S2RegionUnion::Release() {
   vector<unique_ptr<S2Region>> result;
   result.swap(regions_);
+  index_.reset();
   return result;
 }
 
 void S2RegionUnion::Add(unique_ptr<S2Region> region) {
   regions_.push_back(std::move(region));
+  index_.reset();
+}
+
+void S2RegionUnion::BuildIndex(const S2RegionCoverer::Options& options) {
+  index_ = make_unique<S2CellIndex>();
+  index_options_ = options;
+  index_bound_.clear();
+  S2RegionCoverer coverer(options);
+  vector<S2CellId> covering;
+  for (int i = 0; i < num_regions(); ++i) {
+    coverer.GetCovering(*region(i), &covering);
+    for (S2CellId id : covering) index_->Add(id, i);
+    index_bound_.insert(index_bound_.end(), covering.begin(), covering.end());
+  }
+  index_->Build();
+  S2CellUnion::Normalize(&index_bound_);
 }
 
 S2RegionUnion* S2RegionUnion::Clone() const {
@@ -75,12 +100,23 @@ S2LatLngRect S2RegionUnion::GetRectBound() const {
 }
 
 void S2RegionUnion::GetCellUnionBound(vector<S2CellId>* cell_ids) const {
+  if (has_index()) {
+    *cell_ids = index_bound_;
+    return;
+  }
   GetCapBound().GetCellUnionBound(cell_ids);
 }
 
 bool S2RegionUnion::Contains(const S2Cell& cell) const {
   // Note that this method is allowed to return false even if the cell
   // is contained by the region.
+  if (has_index()) {
+    // Only regions whose coverings intersect the cell can contain it.
+    return !index_->VisitIntersectingCells(
+        cell.id(), [this, &cell](S2CellId, S2CellIndex::Label label) {
+          return !region(label)->Contains(cell);
+        });
+  }
   for (int i = 0; i < num_regions(); ++i) {
     if (region(i)->Contains(cell)) return true;
   }
@@ -88,6 +124,12 @@ bool S2RegionUnion::Contains(const S2Cell& cell) const {
 }
 
 bool S2RegionUnion::Contains(const S2Point& p) const {
+  if (has_index()) {
+    return !index_->VisitIntersectingCells(
+        S2CellId(p), [this, &p](S2CellId, S2CellIndex::Label label) {
+          return !region(label)->Contains(p);
+        });
+  }
   for (int i = 0; i < num_regions(); ++i) {
     if (region(i)->Contains(p)) return true;
   }
@@ -95,6 +137,12 @@ bool S2RegionUnion::Contains(const S2Point& p) const {
 }
 
 bool S2RegionUnion::MayIntersect(const S2Cell& cell) const {
+  if (has_index()) {
+    return !index_->VisitIntersectingCells(
+        cell.id(), [this, &cell](S2CellId, S2CellIndex::Label label) {
+          return !region(label)->MayIntersect(cell);
+        });
+  }
   for (int i = 0; i < num_regions(); ++i) {
     if (region(i)->MayIntersect(cell)) return true;
   }
@@ -24,8 +24,11 @@
 #include "absl/base/macros.h"
 
 #include "s2/_fp_contract_off.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_index.h"
 #include "s2/s2point.h"
 #include "s2/s2region.h"
+#include "s2/s2region_coverer.h"
 
 class Decoder;
 class Encoder;
@@ -74,6 +77,19 @@ class S2RegionUnion final : public S2Region {
   const S2Region* region(int i) const { return regions_[i].get(); }
   S2Region* mutable_region(int i) { return regions_[i].get(); }
 
+  // Builds an S2CellIndex of coverings of the regions (computed with the
+  // given options), so that Contains() and MayIntersect() only need to test
+  // the regions whose coverings intersect the query point or cell rather
+  // than every region.  This is worthwhile for unions of many regions that
+  // are queried many times.  The index also makes GetCellUnionBound() return
+  // the union of the coverings, which gives tighter coverings of the union.
+  //
+  // The index is discarded by Init(), Add(), and Release().  BuildIndex()
+  // must be called again if any region is modified via mutable_region().
+  void BuildIndex(const S2RegionCoverer::Options& options =
+                      S2RegionCoverer::Options());
+  bool has_index() const { return index_ != nullptr; }
+
   ////////////////////////////////////////////////////////////////////////
   // S2Region interface (see s2region.h for details):
 
@@ -95,6 +111,12 @@ class S2RegionUnion final : public S2Region {
 
   std::vector<std::unique_ptr<S2Region>> regions_;
 
+  // The index built by BuildIndex() (if any), the options used to build it,
+  // and the normalized union of the indexed coverings.
+  std::unique_ptr<S2CellIndex> index_;
+  S2RegionCoverer::Options index_options_;
+  std::vector<S2CellId> index_bound_;
+
   void operator=(const S2RegionUnion&) = delete;
 };
 
@@ -28,11 +28,14 @@
 #include "s2/s2cap.h"
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
 #include "s2/s2latlng.h"
 #include "s2/s2latlng_rect.h"
+#include "s2/s2point.h"
 #include "s2/s2point_region.h"
 #include "s2/s2region.h"
 #include "s2/s2region_coverer.h"
+#include "s2/s2testing.h"
 #include "s2/s2text_format.h"
 
 using std::make_unique;
@@ -90,4 +93,46 @@ TEST(S2RegionUnionTest, Basic) {
   EXPECT_EQ(face0.id(), covering[0]);
 }
 
+TEST(S2RegionUnionTest, IndexMatchesLinearScan) {
+  // Many small caps scattered over the sphere, as used for geofencing.
+  vector<unique_ptr<S2Region>> caps;
+  for (int i = 0; i < 500; ++i) {
+    caps.push_back(make_unique<S2Cap>(S2Testing::GetRandomCap(1e-6, 1e-3)));
+  }
+  S2RegionUnion expected(std::move(caps));
+  unique_ptr<S2RegionUnion> actual(expected.Clone());
+  EXPECT_FALSE(actual->has_index());
+  actual->BuildIndex();
+  ASSERT_TRUE(actual->has_index());
+  unique_ptr<S2RegionUnion> clone(actual->Clone());
+  EXPECT_TRUE(clone->has_index());
+
+  for (int i = 0; i < 1000; ++i) {
+    // Half of the points are chosen inside the caps.
+    const S2Cap* cap =
+        static_cast<const S2Cap*>(expected.region(i % expected.num_regions()));
+    S2Point p = (i & 1) ? S2Testing::RandomPoint()
+                        : S2Testing::SamplePoint(*cap);
+    EXPECT_EQ(expected.Contains(p), actual->Contains(p));
+    EXPECT_EQ(expected.Contains(p), clone->Contains(p));
+    S2Cell cell(S2CellId(p).parent(S2Testing::rnd.Uniform(20)));
+    EXPECT_EQ(expected.Contains(cell), actual->Contains(cell));
+    EXPECT_EQ(expected.MayIntersect(cell), actual->MayIntersect(cell));
+  }
+
+  // Coverings computed from the tighter cell union bound of the indexed
+  // union still cover every region.
+  S2RegionCoverer coverer;
+  coverer.mutable_options()->set_max_cells(50);
+  S2CellUnion actual_covering = coverer.GetCovering(*actual);
+  for (int i = 0; i < expected.num_regions(); ++i) {
+    const S2Cap* cap = static_cast<const S2Cap*>(expected.region(i));
+    EXPECT_TRUE(actual_covering.Contains(cap->center()));
+  }
+
+  // Adding a region discards the index.
+  actual->Add(make_unique<S2Cap>(S2Testing::GetRandomCap(1e-6, 1e-3)));
+  EXPECT_FALSE(actual->has_index());
+}
+
 }  // namespace
@@ -20,12 +20,14 @@
 
 #include <iterator>
 
+#include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
 
 #include "s2/base/types.h"
 #include "s2/util/coding/coder.h"
 #include "s2/s2coder.h"
 #include "s2/s2point.h"
+#include "s2/s2point_span.h"
 #include "s2/s2pointutil.h"
 #include "s2/util/coding/coder.h"
 
@@ -259,6 +261,30 @@ class S2Shape {
   // where     pos == shape.chain_position(edge_id).
   virtual ChainPosition chain_position(int edge_id) const = 0;
 
+  // Returns the vertices of the given edge chain as a contiguous array, if
+  // the shape stores them that way, or an empty span otherwise.  This allows
+  // algorithms that visit every edge of a chain to iterate over memory
+  // directly rather than calling chain_edge() for each edge.
+  //
+  // If the span "v" is not empty, it contains either chain(chain_id).length
+  // vertices (for closed chains such as polygon loops) or one more than this
+  // (for open chains such as polylines), and edge "j" of the chain is
+  // (v[j], v[k]) where k = j + 1 if j + 1 < v.size() and k = 0 otherwise.
+  //
+  // The default implementation returns an empty span, which is always
+  // correct.  Chains with no edges may also return an empty span.
+  //
+  // REQUIRES: 0 <= chain_id < num_chains()
+  virtual S2PointSpan chain_vertex_span(int chain_id) const { return {}; }
+
+  // Returns edge "j" of a chain whose vertices are "v", where "v" is a
+  // non-empty span returned by chain_vertex_span().
+  static Edge ChainVertexSpanEdge(S2PointSpan v, int j) {
+    const int n = static_cast<int>(v.size());
+    ABSL_DCHECK_LT(j, n);
+    return Edge(v[j], v[j + 1 == n ? 0 : j + 1]);
+  }
+
   // Returns an integer that can be used to identify the type of an encoded
   // S2Shape (see TypeTag above).
   virtual TypeTag type_tag() const { return kNoTypeTag; }
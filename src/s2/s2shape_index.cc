@@ -17,12 +17,37 @@
 
 #include "s2/s2shape_index.h"
 
+#include <type_traits>
+
+#include "s2/base/commandlineflags.h"
 #include "s2/base/types.h"
 #include "absl/log/absl_check.h"
 #include "s2/util/coding/coder.h"
 #include "s2/util/coding/varint.h"
 #include "s2/util/gtl/compact_array.h"
 
+// FLAGS_s2shape_index_prefetch_distance
+//
+// Iterating through an index in S2CellId order is usually limited by the
+// latency of loading each cell, since the cells of a MutableS2ShapeIndex
+// (and the decoded cells of an EncodedS2ShapeIndex) are scattered through
+// memory.  When an iterator is advanced with Next(), it prefetches the cell
+// this many positions ahead, and the clipped shapes and edges of the cells
+// in between once they are likely to be in cache.  Seeking does not
+// prefetch anything, so iterators that mostly seek are not affected.  The
+// same flag enables prefetching the next cell to be processed by
+// S2ClosestEdgeQuery.  Zero disables prefetching.
+//
+// Prefetching is disabled by default because it only pays off for indexes
+// that are much larger than the CPU caches.  Scanning an index of 64K small
+// loops was up to 10% faster with a distance of 8-16, whereas scanning an
+// index that fits in cache was 25-50% slower due to the extra bookkeeping
+// (see s2shape_index_prefetch_benchmark.cc).
+S2_DEFINE_int32(
+    s2shape_index_prefetch_distance, 0,
+    "Number of cells ahead of the current position that S2ShapeIndex "
+    "iterators prefetch when advanced sequentially; 0 disables prefetching.");
+
 bool S2ClippedShape::ContainsEdge(int id) const {
   // Linear search is fast because the number of edges per shape is typically
   // very small (less than 10).
@@ -33,9 +58,14 @@ bool S2ClippedShape::ContainsEdge(int id) const {
 }
 
 S2ShapeIndexCell::~S2ShapeIndexCell() {
-  // Free memory for all shapes owned by this cell.
-  for (S2ClippedShape& s : shapes_)
-    s.Destruct();
+  // Free memory for all shapes owned by this cell.  Packed edges are freed
+  // all at once.
+  if (packed_edges_ != nullptr) {
+    delete[] packed_edges_;
+  } else {
+    for (S2ClippedShape& s : shapes_)
+      s.Destruct();
+  }
   shapes_.clear();
 }
 
@@ -183,7 +213,56 @@ void S2ShapeIndexCell::Encode(int num_shape_ids, Encoder* encoder) const {
   }
 }
 
+namespace {
+
+// A wrapper around Decoder used by S2ShapeIndexCell::DecodeTrusted() that
+// reads varints without checking for the end of the buffer.  The methods
+// always return true so that the compiler can remove the error checks in
+// S2ShapeIndexCell::DecodeImpl().
+class TrustedDecoder {
+ public:
+  explicit TrustedDecoder(Decoder* decoder) : decoder_(decoder) {}
+
+  bool get_varint32(uint32* v) {
+    const char* p = decoder_->skip(0);
+    const char* end = Varint::Parse32(p, v);
+    ABSL_DCHECK(end != nullptr);
+    decoder_->skip(end - p);
+    return true;
+  }
+
+  bool get_varint64(uint64* v) {
+    const char* p = decoder_->skip(0);
+    const char* end = Varint::Parse64(p, v);
+    ABSL_DCHECK(end != nullptr);
+    decoder_->skip(end - p);
+    return true;
+  }
+
+ private:
+  Decoder* decoder_;
+};
+
+// Returns true if decoding through "Reader" should validate the input.
+template <class Reader>
+constexpr bool ValidatesInput() {
+  return !std::is_same_v<Reader, TrustedDecoder>;
+}
+
+}  // namespace
+
 bool S2ShapeIndexCell::Decode(int num_shape_ids, Decoder* decoder) {
+  return DecodeImpl(num_shape_ids, decoder);
+}
+
+void S2ShapeIndexCell::DecodeTrusted(int num_shape_ids, Decoder* decoder) {
+  TrustedDecoder trusted(decoder);
+  bool success = DecodeImpl(num_shape_ids, &trusted);
+  ABSL_DCHECK(success);
+}
+
+template <class Reader>
+bool S2ShapeIndexCell::DecodeImpl(int num_shape_ids, Reader* decoder) {
   // This function inverts the encodings documented above.
   if (num_shape_ids == 1) {
     // Entire S2ShapeIndex contains only one shape.
@@ -298,9 +377,10 @@ inline void S2ShapeIndexCell::EncodeEdges(const S2ClippedShape& clipped,
   }
 }
 
+template <class Reader>
 inline bool S2ShapeIndexCell::DecodeEdges(int num_edges,
                                           S2ClippedShape* clipped,
-                                          Decoder* decoder) {
+                                          Reader* decoder) {
   // This function inverts the encodings documented above.
   int32 edge_id = 0;
   for (int i = 0; i < num_edges; ) {
@@ -319,7 +399,8 @@ inline bool S2ShapeIndexCell::DecodeEdges(int num_edges,
       }
 
       // Guard against overflowing edge memory for bad inputs.
-      if (static_cast<int32>(i + count) > num_edges) {
+      if (ValidatesInput<Reader>() &&
+          static_cast<int32>(i + count) > num_edges) {
         return false;
       }
 
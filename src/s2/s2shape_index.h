@@ -55,9 +55,12 @@
 #include "absl/log/absl_log.h"
 #include "absl/synchronization/mutex.h"
 
+#include "s2/base/commandlineflags_declare.h"
+#include "s2/base/port.h"
 #include "s2/base/spinlock.h"
 #include "s2/base/types.h"
 #include "s2/_fp_contract_off.h"
+#include "s2/r2rect.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_iterator.h"
 #include "s2/s2point.h"
@@ -104,6 +107,9 @@ class S2ClippedShape {
   // This class may be copied by value, but note that it does *not* own its
   // underlying data.  (It is owned by the containing S2ShapeIndexCell.)
 
+  friend class CompositeS2ShapeIndex;
+  friend class FrozenS2ShapeIndex;
+  friend class LayeredS2ShapeIndex;
   friend class MutableS2ShapeIndex;
   friend class S2ShapeIndexCell;
   friend class S2Stats;
@@ -128,7 +134,10 @@ class S2ClippedShape {
   // If there are more than two edges, this field holds a pointer.
   // Otherwise it holds an array of edge ids.
   union {
-    int32* edges_;  // Owned by the containing S2ShapeIndexCell.
+    // Owned by the containing S2ShapeIndexCell, either directly or as part
+    // of its packed edge array, except in FrozenS2ShapeIndex where it points
+    // into an arena owned by the index.
+    int32* edges_;
     std::array<int32, kMaxInlineEdges> inline_edges_;
   };
 };
@@ -165,6 +174,36 @@ class S2ShapeIndexCell {
   // shapes.
   int num_edges() const;
 
+  // Hints that the clipped shapes of this cell (or the edge ids of those
+  // clipped shapes) will be read soon.  These methods read the cell itself,
+  // so they are only useful once the cell is in cache (e.g., because it was
+  // prefetched earlier with S2Prefetch).  PrefetchEdges() should similarly
+  // be called some time after PrefetchClippedShapes().
+  void PrefetchClippedShapes() const;
+  void PrefetchEdges() const;
+
+  // The maximum number of consecutive edges of a clipped shape that are
+  // summarized by each rectangle of edge_run_bounds().
+  static constexpr int kEdgesPerRun = 8;
+
+  // Returns the number of rectangles that the given clipped shape contributes
+  // to edge_run_bounds().
+  static int num_edge_runs(const S2ClippedShape& clipped) {
+    return (clipped.num_edges() + kEdgesPerRun - 1) / kEdgesPerRun;
+  }
+
+  // Returns an optional summary of the edges in this cell that allows queries
+  // to skip edges far from the query region, or nullptr if the index did not
+  // compute one (see MutableS2ShapeIndex::Options::edge_run_bounds) or the
+  // cell has no edges.  The edges of each clipped shape are divided into
+  // runs of kEdgesPerRun consecutive edges (the last run may be shorter),
+  // and the (u,v)-coordinate bounds of all these runs are stored in the same
+  // order as the clipped shapes and their edges.  Each rectangle bounds the
+  // portions of its edges that intersect the cell, and is padded so that if
+  // an edge of the run crosses an edge E within the cell then the rectangle
+  // intersects the (u,v) bound of E as computed by S2::GetFaceSegments().
+  const R2Rect* edge_run_bounds() const { return edge_run_bounds_.get(); }
+
   // Appends an encoded representation of the S2ShapeIndexCell to "encoder".
   // "num_shape_ids" should be set to index.num_shape_ids(); this information
   // allows the encoding to be more compact in some cases.
@@ -177,19 +216,39 @@ class S2ShapeIndexCell {
   // "num_shape_ids" should be set to index.num_shape_ids().
   bool Decode(int num_shape_ids, Decoder* decoder);
 
+  // Like Decode(), but omits all bounds and consistency checks.  This is
+  // faster but may only be used for data that is known to be valid, e.g.
+  // because it was produced by Encode() in the same process or because it
+  // is protected by a checksum that has already been verified.  The
+  // behavior is undefined if the data is invalid.
+  void DecodeTrusted(int num_shape_ids, Decoder* decoder);
+
  private:
-  friend class MutableS2ShapeIndex;
+  friend class CompositeS2ShapeIndex;
   friend class EncodedS2ShapeIndex;
+  friend class FrozenS2ShapeIndex;
+  friend class LayeredS2ShapeIndex;
+  friend class MutableS2ShapeIndex;
   friend class S2Stats;
 
   // Internal methods are documented with their definitions.
   S2ClippedShape* add_shapes(int n);
   static void EncodeEdges(const S2ClippedShape& clipped, Encoder* encoder);
+  template <class Reader>
+  bool DecodeImpl(int num_shape_ids, Reader* decoder);
+  template <class Reader>
   static bool DecodeEdges(int num_edges, S2ClippedShape* clipped,
-                          Decoder* decoder);
+                          Reader* decoder);
 
   using S2ClippedShapeSet = gtl::compact_array<S2ClippedShape>;
   S2ClippedShapeSet shapes_;
+  std::unique_ptr<R2Rect[]> edge_run_bounds_;
+
+  // If non-null, the edge ids of all clipped shapes that do not store their
+  // edges inline are stored consecutively in this array (in the same order
+  // as the clipped shapes), rather than in a separate array per clipped
+  // shape.  See MutableS2ShapeIndex::Options::pack_cell_edges.
+  int32* packed_edges_ = nullptr;
 
   S2ShapeIndexCell(const S2ShapeIndexCell&) = delete;
   void operator=(const S2ShapeIndexCell&) = delete;
@@ -459,6 +518,18 @@ class S2ShapeIndex {
       return LocateImpl(*this, target);
     }
 
+    // Like Seek(), but uses the current position as a hint so that seeking
+    // to a nearby cell is cheaper (see S2CellIterator::SeekNear).
+    void SeekNear(S2CellId target) override { iter_->SeekNear(target); }
+
+    // Like Locate(), but uses SeekNear() to position the iterator.
+    bool LocateNear(const S2Point& target) override {
+      return LocateNearImpl(*this, target);
+    }
+    S2CellRelation LocateNear(S2CellId target) override {
+      return LocateNearImpl(*this, target);
+    }
+
    private:
     // Although S2ShapeIndex::Iterator can be used to iterate over any
     // index subtype, it is more efficient to use the subtype's iterator when
@@ -522,6 +593,14 @@ class S2ShapeIndex {
       const = 0;
 };
 
+// The number of cells ahead of the current position that the iterators of
+// MutableS2ShapeIndex and EncodedS2ShapeIndex prefetch when they are
+// advanced with Next(), and whether S2ClosestEdgeQuery prefetches the next
+// queued cell.  See the .cc file for details.
+//
+// DEFAULT: 0 (disabled)
+S2_DECLARE_int32(s2shape_index_prefetch_distance);
+
 //////////////////   Implementation details follow   ////////////////////
 
 
@@ -586,6 +665,20 @@ inline int S2ShapeIndexCell::num_edges() const {
   return n;
 }
 
+inline void S2ShapeIndexCell::PrefetchClippedShapes() const {
+  if (!shapes_.empty()) S2Prefetch(shapes_.begin());
+}
+
+inline void S2ShapeIndexCell::PrefetchEdges() const {
+  if (packed_edges_ != nullptr) {
+    S2Prefetch(packed_edges_);
+    return;
+  }
+  for (const S2ClippedShape& clipped : shapes_) {
+    if (!clipped.is_inline()) S2Prefetch(clipped.edges_);
+  }
+}
+
 inline const S2Shape* S2ShapeIndex::ShapeIterator::operator*() const {
   return index_->shape(shape_id_);
 }
@@ -18,8 +18,10 @@
 #include "s2/s2shape_index_buffered_region.h"
 
 #include <algorithm>
+#include <memory>
 #include <vector>
 
+#include "s2/base/types.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s2cap.h"
@@ -32,6 +34,7 @@
 #include "s2/s2shape_index.h"
 #include "s2/s2shape_index_region.h"
 
+using std::make_unique;
 using std::min;
 using std::vector;
 
@@ -43,6 +46,7 @@ void S2ShapeIndexBufferedRegion::Init(const S2ShapeIndex* index,
   radius_successor_ = radius.Successor();
   query_.Init(index);
   query_.mutable_options()->set_include_interiors(true);
+  index_region_ = make_unique<S2ShapeIndexRegion<S2ShapeIndex>>(index);
 }
 
 S2ShapeIndexBufferedRegion* S2ShapeIndexBufferedRegion::Clone() const {
@@ -69,15 +73,42 @@ void S2ShapeIndexBufferedRegion::GetCellUnionBound(vector<S2CellId> *cellids)
     return S2Cap::Full().GetCellUnionBound(cellids);
   }
 
-  // We start with a covering of the original S2ShapeIndex, and then expand it
-  // by replacing each cell with a block of 4 cells whose union contains the
-  // original cell buffered by the given radius.
-  //
-  // This increases the number of cells in the covering by a factor of 4 and
-  // increases the covered area by a factor of 16, so it is not a very good
-  // covering, but it is much better than always returning the 6 face cells.
+  // We start with the cells of the original S2ShapeIndex, coarsened to the
+  // finest level where at most kMaxCellUnionBoundCells distinct ancestors
+  // remain.  Since the index cells are sorted, the number of distinct
+  // ancestors at level L is one plus the number of adjacent pairs of cells
+  // whose lowest common ancestor is above level L.  This follows the index
+  // structure much more closely than S2ShapeIndexRegion::GetCellUnionBound,
+  // which returns at most one cell per face.
+  int num_ancestors[S2CellId::kMaxLevel + 2] = {};
+  vector<S2CellId> index_cellids;
+  for (S2ShapeIndex::Iterator it(&index(), S2ShapeIndex::BEGIN); !it.done();
+       it.Next()) {
+    if (!index_cellids.empty()) {
+      // Faces are handled by GetCommonAncestorLevel() returning -1.
+      ++num_ancestors[index_cellids.back().GetCommonAncestorLevel(it.id()) +
+                      1];
+    }
+    index_cellids.push_back(it.id());
+  }
+  int level = 0, count = 1 + num_ancestors[0];
+  while (level < S2CellId::kMaxLevel &&
+         count + num_ancestors[level + 1] <= kMaxCellUnionBoundCells) {
+    count += num_ancestors[++level];
+  }
   vector<S2CellId> orig_cellids;
-  MakeS2ShapeIndexRegion(&index()).GetCellUnionBound(&orig_cellids);
+  for (S2CellId id : index_cellids) {
+    if (id.level() > level) id = id.parent(level);
+    if (orig_cellids.empty() || orig_cellids.back() != id) {
+      orig_cellids.push_back(id);
+    }
+  }
+
+  // Then we expand the covering by replacing each cell with a block of 4
+  // cells whose union contains the original cell buffered by the given
+  // radius.  This increases the covered area by a factor of 16 for cells
+  // above max_level, but since the cells follow the index structure this is
+  // much better than always returning the 6 face cells.
   cellids->clear();
   for (S2CellId id : orig_cellids) {
     if (id.is_face()) {
@@ -97,7 +128,7 @@ bool S2ShapeIndexBufferedRegion::Contains(const S2Cell& cell) const {
   // cheaper to compute.
 
   // Return true if the unbuffered region contains this cell.
-  if (MakeS2ShapeIndexRegion(&index()).Contains(cell)) return true;
+  if (index_region_->Contains(cell)) return true;
 
   // Otherwise approximate the cell by its bounding cap.
   //
@@ -115,7 +146,13 @@ bool S2ShapeIndexBufferedRegion::Contains(const S2Cell& cell) const {
 }
 
 bool S2ShapeIndexBufferedRegion::MayIntersect(const S2Cell& cell) const {
-  // Return true if the distance is less than or equal to "radius_".
+  // Most cells tested by S2RegionCoverer either intersect the unbuffered
+  // geometry or are far away from it.  Testing the index cells directly is
+  // much cheaper than a distance query, since it does not need to expand a
+  // search around the cell.
+  if (index_region_->MayIntersect(cell)) return true;
+
+  // Otherwise return true if the distance is less than or equal to "radius_".
   S2ClosestEdgeQuery::CellTarget target(cell);
   return query_.IsDistanceLess(&target, radius_successor_);
 }
@@ -125,3 +162,49 @@ bool S2ShapeIndexBufferedRegion::Contains(const S2Point& p) const {
   // Return true if the distance is less than or equal to "radius_".
   return query_.IsDistanceLess(&target, radius_successor_);
 }
+
+S2SharedShapeIndexBufferedRegion::S2SharedShapeIndexBufferedRegion(
+    const S2ShapeIndex* index, S1ChordAngle radius)
+    : index_(index), radius_(radius), id_(s2internal::NewSharedRegionId()) {
+}
+
+S2ShapeIndexBufferedRegion&
+S2SharedShapeIndexBufferedRegion::GetThreadRegion() const {
+  thread_local uint64 region_id = 0;
+  thread_local std::unique_ptr<S2ShapeIndexBufferedRegion> region;
+  if (region_id != id_) {
+    region = make_unique<S2ShapeIndexBufferedRegion>(index_, radius_);
+    region_id = id_;
+  }
+  return *region;
+}
+
+S2SharedShapeIndexBufferedRegion* S2SharedShapeIndexBufferedRegion::Clone()
+    const {
+  return new S2SharedShapeIndexBufferedRegion(*this);
+}
+
+S2Cap S2SharedShapeIndexBufferedRegion::GetCapBound() const {
+  return GetThreadRegion().GetCapBound();
+}
+
+S2LatLngRect S2SharedShapeIndexBufferedRegion::GetRectBound() const {
+  return GetThreadRegion().GetRectBound();
+}
+
+void S2SharedShapeIndexBufferedRegion::GetCellUnionBound(
+    vector<S2CellId> *cellids) const {
+  GetThreadRegion().GetCellUnionBound(cellids);
+}
+
+bool S2SharedShapeIndexBufferedRegion::Contains(const S2Cell& cell) const {
+  return GetThreadRegion().Contains(cell);
+}
+
+bool S2SharedShapeIndexBufferedRegion::MayIntersect(const S2Cell& cell) const {
+  return GetThreadRegion().MayIntersect(cell);
+}
+
+bool S2SharedShapeIndexBufferedRegion::Contains(const S2Point& p) const {
+  return GetThreadRegion().Contains(p);
+}
@@ -18,8 +18,10 @@
 #ifndef S2_S2SHAPE_INDEX_BUFFERED_REGION_H_
 #define S2_S2SHAPE_INDEX_BUFFERED_REGION_H_
 
+#include <memory>
 #include <vector>
 
+#include "s2/base/types.h"
 #include "s2/s1angle.h"
 #include "s2/s1chord_angle.h"
 #include "s2/s2cap.h"
@@ -31,6 +33,7 @@
 #include "s2/s2point.h"
 #include "s2/s2region.h"
 #include "s2/s2shape_index.h"
+#include "s2/s2shape_index_region.h"
 
 // This class provides a way to expand an arbitrary collection of geometry by
 // a fixed radius (an operation variously known as "buffering", "offsetting",
@@ -56,7 +59,8 @@
 // }
 //
 // This class is not thread-safe.  To use it in parallel, each thread should
-// construct its own instance (this is not expensive).
+// construct its own instance (this is not expensive), or alternatively all
+// threads can share a single S2SharedShapeIndexBufferedRegion (see below).
 class S2ShapeIndexBufferedRegion final : public S2Region {
  public:
   // Default constructor; requires Init() to be called.
@@ -91,6 +95,10 @@ class S2ShapeIndexBufferedRegion final : public S2Region {
   // This method returns a small non-optimal covering that may include
   // duplicate or overlapping cells.  It should not be used directly.
   // Instead, use S2RegionCoverer::GetCovering or GetFastCovering.
+  //
+  // The covering is computed by expanding a coarsened version of the index
+  // cells by the buffer radius, and consists of at most 4 *
+  // kMaxCellUnionBoundCells cells.
   void GetCellUnionBound(std::vector<S2CellId> *cellids) const override;
 
   // The implementation is approximate but conservative; it always returns
@@ -99,13 +107,19 @@ class S2ShapeIndexBufferedRegion final : public S2Region {
   bool Contains(const S2Cell& cell) const override;
 
   // Returns true if any buffered shape intersects "cell" (to within a very
-  // small error margin).
+  // small error margin).  Cells that intersect the unbuffered geometry are
+  // recognized using the index structure alone, so that the more expensive
+  // distance query is only needed for cells near the buffer boundary.
   bool MayIntersect(const S2Cell& cell) const override;
 
   // Returns true if the given point is contained by the buffered region,
   // i.e. if it is within the given radius of any original shape.
   bool Contains(const S2Point& p) const override;
 
+  // The maximum number of coarsened index cells that GetCellUnionBound()
+  // expands by the buffer radius.
+  static constexpr int kMaxCellUnionBoundCells = 16;
+
  private:
   S1ChordAngle radius_;
 
@@ -115,6 +129,52 @@ class S2ShapeIndexBufferedRegion final : public S2Region {
   S1ChordAngle radius_successor_;
 
   mutable S2ClosestEdgeQuery query_;  // This class is not thread-safe!
+
+  // Used to test cells against the unbuffered geometry.  Reusing this object
+  // (rather than calling MakeS2ShapeIndexRegion() for every cell) avoids
+  // allocating a new index iterator on every call.
+  std::unique_ptr<S2ShapeIndexRegion<S2ShapeIndex>> index_region_;
+};
+
+// S2SharedShapeIndexBufferedRegion is a thread-safe version of
+// S2ShapeIndexBufferedRegion that can be shared by any number of threads.
+// Like S2SharedShapeIndexRegion, it only has const state; each thread lazily
+// constructs its own S2ShapeIndexBufferedRegion (including the
+// S2ClosestEdgeQuery) and reuses it for as long as it keeps using the same
+// shared region.
+//
+// The index must not be modified while the region is in use.
+class S2SharedShapeIndexBufferedRegion final : public S2Region {
+ public:
+  S2SharedShapeIndexBufferedRegion(const S2ShapeIndex* index,
+                                   S1ChordAngle radius);
+
+  // Convenience constructor that accepts an S1Angle for the radius.
+  // REQUIRES: radius >= S1Angle::Zero()
+  S2SharedShapeIndexBufferedRegion(const S2ShapeIndex* index, S1Angle radius)
+      : S2SharedShapeIndexBufferedRegion(index, S1ChordAngle(radius)) {}
+
+  const S2ShapeIndex& index() const { return *index_; }
+  S1ChordAngle radius() const { return radius_; }
+
+  ////////////////////////////////////////////////////////////////////////
+  // S2Region interface (see S2ShapeIndexBufferedRegion for details):
+
+  S2SharedShapeIndexBufferedRegion* Clone() const override;
+  S2Cap GetCapBound() const override;
+  S2LatLngRect GetRectBound() const override;
+  void GetCellUnionBound(std::vector<S2CellId> *cellids) const override;
+  bool Contains(const S2Cell& cell) const override;
+  bool MayIntersect(const S2Cell& cell) const override;
+  bool Contains(const S2Point& p) const override;
+
+ private:
+  // Returns the calling thread's S2ShapeIndexBufferedRegion for this object.
+  S2ShapeIndexBufferedRegion& GetThreadRegion() const;
+
+  const S2ShapeIndex* index_;
+  S1ChordAngle radius_;
+  uint64 id_;  // See S2SharedShapeIndexRegion.
 };
 
 
@@ -123,7 +183,10 @@ class S2ShapeIndexBufferedRegion final : public S2Region {
 
 inline S2ShapeIndexBufferedRegion::S2ShapeIndexBufferedRegion(
     const S2ShapeIndex* index, S1ChordAngle radius)
-    : radius_(radius), radius_successor_(radius.Successor()), query_(index) {
+    : radius_(radius),
+      radius_successor_(radius.Successor()),
+      query_(index),
+      index_region_(std::make_unique<S2ShapeIndexRegion<S2ShapeIndex>>(index)) {
   query_.mutable_options()->set_include_interiors(true);
 }
 
@@ -21,6 +21,8 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include "absl/log/absl_log.h"
@@ -36,6 +38,7 @@
 #include "s2/s2cell_union.h"
 #include "s2/s2closest_edge_query.h"
 #include "s2/s2point.h"
+#include "s2/s2point_vector_shape.h"
 #include "s2/s2polygon.h"
 #include "s2/s2region_coverer.h"
 #include "s2/s2shape.h"
@@ -48,6 +51,7 @@ using s2textformat::MakePointOrDie;
 using std::cout;
 using std::make_unique;
 using std::string;
+using std::vector;
 
 TEST(S2ShapeIndexBufferedRegion, EmptyIndex) {
   // Test buffering an empty S2ShapeIndex.
@@ -193,3 +197,71 @@ TEST(S2ShapeIndexBufferedRegion, HugeBufferRadius) {
   coverer.mutable_options()->set_max_cells(100);
   TestBufferIndex("10:20 # #", S1Angle::Degrees(200), &coverer);
 }
+
+TEST(S2ShapeIndexBufferedRegion, CellUnionBoundFollowsIndexCells) {
+  // Buffer two small clusters of points on the same face, using an index
+  // that puts each point in its own cell.  The cell union bound should cover
+  // the buffered points without covering the space between the clusters.
+  MutableS2ShapeIndex::Options options;
+  options.set_max_edges_per_cell(1);
+  MutableS2ShapeIndex index(options);
+  std::vector<S2Point> points =
+      s2textformat::ParsePointsOrDie("1:1, 1:1.01, 1:30, 1:30.01");
+  index.Add(make_unique<S2PointVectorShape>(points));
+  S1ChordAngle radius(S1Angle::Degrees(0.1));
+  S2ShapeIndexBufferedRegion region(&index, radius);
+  std::vector<S2CellId> bound;
+  region.GetCellUnionBound(&bound);
+  EXPECT_LE(bound.size(),
+            4 * S2ShapeIndexBufferedRegion::kMaxCellUnionBoundCells);
+  S2CellUnion bound_union(std::move(bound));
+  for (const S2Point& point : points) {
+    S2Testing::CheckCovering(S2Cap(point, radius), bound_union, false);
+  }
+  EXPECT_FALSE(bound_union.Contains(MakePointOrDie("1:15")));
+}
+
+TEST(S2ShapeIndexBufferedRegion, MayIntersectMatchesDistanceQuery) {
+  // Checks that the index-based shortcut in MayIntersect() agrees with the
+  // distance query on cells that intersect the unbuffered geometry.
+  auto index = MakeIndexOrDie("# 10:5, 20:30, -10:60 # 30:30, 30:40, 40:40");
+  S1ChordAngle radius(S1Angle::Degrees(1));
+  S2ShapeIndexBufferedRegion region(index.get(), radius);
+  S2ClosestEdgeQuery query(index.get());
+  query.mutable_options()->set_include_interiors(true);
+  for (int i = 0; i < 1000; ++i) {
+    S2Cell cell(S2Testing::GetRandomCellId(S2Testing::rnd.Uniform(12) + 4));
+    S2ClosestEdgeQuery::CellTarget target(cell);
+    EXPECT_EQ(region.MayIntersect(cell),
+              query.IsDistanceLess(&target, radius.Successor()))
+        << cell.id();
+  }
+}
+
+TEST(S2SharedShapeIndexBufferedRegion, ParallelCoveringsMatch) {
+  auto index = MakeIndexOrDie("10:10 # 0:0, 3:5, 6:0 # 20:20, 20:25, 25:20");
+  S1Angle radius = S1Angle::Degrees(2);
+  S2RegionCoverer::Options options;
+  options.set_max_cells(100);
+  S2CellUnion expected = S2RegionCoverer(options).GetCovering(
+      S2ShapeIndexBufferedRegion(index.get(), radius));
+
+  const S2SharedShapeIndexBufferedRegion region(index.get(), radius);
+  EXPECT_EQ(region.radius(), S1ChordAngle(radius));
+  constexpr int kNumThreads = 8;
+  vector<vector<S2CellUnion>> actual(kNumThreads);
+  vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < 10; ++i) {
+        actual[t].push_back(S2RegionCoverer(options).GetCovering(region));
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  for (const auto& coverings : actual) {
+    for (const S2CellUnion& covering : coverings) {
+      EXPECT_EQ(covering, expected);
+    }
+  }
+}
@@ -0,0 +1,229 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Benchmarks for queries run concurrently against a single shared index,
+// which measure how query throughput scales with the number of threads.
+//
+// Each benchmark is run with 1, 2, 4, ... threads up to the number of
+// hardware threads.  "items_per_second" is the total query throughput of all
+// threads, and "p50_us" and "p99_us" are the median and 99th percentile
+// query latencies (averaged over the threads).  The first argument selects
+// the index type (see IndexType below).  The lazily built and encoded indexes
+// are created anew for every run, so that the threads contend for building
+// the index or decoding its cells while the benchmark is running; this shows
+// up as a longer latency tail and lower throughput.
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "absl/log/absl_check.h"
+#include "s2/util/coding/coder.h"
+#include "s2/encoded_s2shape_index.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2closest_edge_query.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2crossing_edge_query.h"
+#include "s2/s2fractal.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2shape_index.h"
+#include "s2/s2shapeutil_coding.h"
+#include "s2/s2shapeutil_shape_edge.h"
+#include "s2/s2testing.h"
+
+using s2shapeutil::CrossingType;
+using std::make_unique;
+using std::pair;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+enum class IndexType {
+  MUTABLE,       // A MutableS2ShapeIndex that has already been built.
+  LAZY_MUTABLE,  // A MutableS2ShapeIndex that is built by the first query.
+  ENCODED,       // An EncodedS2ShapeIndex whose cells have not been decoded.
+};
+
+// The number of query points and edges (must be a power of two).
+constexpr int kNumQueries = 1024;
+
+// The geometry and queries shared by all benchmarks.  The index contains a
+// fractal loop with about 64K edges, and the queries are near the loop.
+struct TestData {
+  TestData() {
+    S2Testing::rnd.Reset(1);
+    S2Fractal fractal;
+    fractal.SetLevelForApproxMaxEdges(1 << 16);
+    S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+    unique_ptr<S2Loop> fractal_loop = fractal.MakeLoop(
+        S2Testing::GetRandomFrameAt(cap.center()), cap.GetRadius());
+    loop.assign(fractal_loop->vertices_span().begin(),
+                fractal_loop->vertices_span().end());
+    MutableS2ShapeIndex index;
+    index.Add(make_unique<S2LaxPolygonShape>(
+        vector<S2LaxPolygonShape::Loop>{loop}));
+    s2shapeutil::CompactEncodeTaggedShapes(index, &encoder);
+    index.Encode(&encoder);
+
+    S2Cap sample_cap(cap.center(), cap.GetRadius() * 1.2);
+    for (int i = 0; i < kNumQueries; ++i) {
+      S2Point a = S2Testing::SamplePoint(sample_cap);
+      S2Point b = S2Testing::SamplePoint(S2Cap(a, S1Angle::Degrees(0.002)));
+      points.push_back(a);
+      edges.push_back({a, b});
+    }
+  }
+
+  vector<S2Point> loop;
+  Encoder encoder;  // The encoded index.
+  vector<S2Point> points;
+  vector<pair<S2Point, S2Point>> edges;
+};
+
+const TestData& GetTestData() {
+  static const TestData* data = new TestData;
+  return *data;
+}
+
+// The index shared by all threads of the current benchmark run.  It is
+// created by SetUpIndex() before the threads start.
+MutableS2ShapeIndex* mutable_index = nullptr;
+EncodedS2ShapeIndex* encoded_index = nullptr;
+
+void SetUpIndex(const benchmark::State& state) {
+  const TestData& data = GetTestData();
+  switch (static_cast<IndexType>(state.range(0))) {
+    case IndexType::MUTABLE:
+    case IndexType::LAZY_MUTABLE:
+      mutable_index = new MutableS2ShapeIndex;
+      mutable_index->Add(make_unique<S2LaxPolygonShape>(
+          vector<S2LaxPolygonShape::Loop>{data.loop}));
+      if (static_cast<IndexType>(state.range(0)) == IndexType::MUTABLE) {
+        mutable_index->ForceBuild();
+      }
+      break;
+    case IndexType::ENCODED: {
+      Decoder decoder(data.encoder.base(), data.encoder.length());
+      encoded_index = new EncodedS2ShapeIndex;
+      ABSL_CHECK(encoded_index->Init(
+          &decoder, s2shapeutil::LazyDecodeShapeFactory(&decoder)));
+      break;
+    }
+  }
+}
+
+void TearDownIndex(const benchmark::State& state) {
+  delete mutable_index;
+  mutable_index = nullptr;
+  delete encoded_index;
+  encoded_index = nullptr;
+}
+
+// Calls "fn(index)" with the shared index of the current run.
+template <class Fn>
+void WithIndex(const Fn& fn) {
+  if (encoded_index != nullptr) {
+    fn(*encoded_index);
+  } else {
+    fn(*mutable_index);
+  }
+}
+
+// Runs "query(i)" for successive query numbers "i" and reports the query
+// throughput and latency percentiles.
+template <class Query>
+void RunQueries(benchmark::State& state, const Query& query) {
+  using Clock = std::chrono::steady_clock;
+  vector<double> latencies;
+  // Threads start at different queries to avoid running in lockstep.
+  int i = state.thread_index() * (kNumQueries / 8);
+  for (auto _ : state) {
+    Clock::time_point start = Clock::now();
+    benchmark::DoNotOptimize(query(i++ & (kNumQueries - 1)));
+    latencies.push_back(
+        std::chrono::duration<double, std::micro>(Clock::now() - start)
+            .count());
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (latencies.empty()) return;
+  const auto percentile = [&latencies](double fraction) {
+    auto it = latencies.begin() + fraction * (latencies.size() - 1);
+    std::nth_element(latencies.begin(), it, latencies.end());
+    return *it;
+  };
+  state.counters["p50_us"] =
+      benchmark::Counter(percentile(0.5), benchmark::Counter::kAvgThreads);
+  state.counters["p99_us"] =
+      benchmark::Counter(percentile(0.99), benchmark::Counter::kAvgThreads);
+}
+
+void BM_ContainsPoint(benchmark::State& state) {
+  const TestData& data = GetTestData();
+  WithIndex([&](const auto& index) {
+    auto query = MakeS2ContainsPointQuery(&index);
+    RunQueries(state, [&](int i) { return query.Contains(data.points[i]); });
+  });
+}
+
+void BM_FindClosestEdge(benchmark::State& state) {
+  const TestData& data = GetTestData();
+  WithIndex([&](const S2ShapeIndex& index) {
+    S2ClosestEdgeQuery query(&index);
+    RunQueries(state, [&](int i) {
+      S2ClosestEdgeQuery::PointTarget target(data.points[i]);
+      return query.FindClosestEdge(&target).distance();
+    });
+  });
+}
+
+void BM_GetCrossingEdges(benchmark::State& state) {
+  const TestData& data = GetTestData();
+  WithIndex([&](const S2ShapeIndex& index) {
+    S2CrossingEdgeQuery query(&index);
+    RunQueries(state, [&](int i) {
+      const auto& edge = data.edges[i];
+      return query.GetCrossingEdges(edge.first, edge.second, CrossingType::ALL)
+          .size();
+    });
+  });
+}
+
+// Runs the benchmark with each index type and with 1, 2, 4, ... threads.
+void ApplyConcurrencyArgs(benchmark::internal::Benchmark* b) {
+  b->ArgName("index_type")
+      ->DenseRange(0, static_cast<int>(IndexType::ENCODED))
+      ->Setup(SetUpIndex)
+      ->Teardown(TearDownIndex)
+      ->UseRealTime();
+  const int max_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int n = 1; n < 2 * max_threads; n *= 2) {
+    b->Threads(std::min(n, max_threads));
+  }
+}
+
+BENCHMARK(BM_ContainsPoint)->Apply(ApplyConcurrencyArgs);
+BENCHMARK(BM_FindClosestEdge)->Apply(ApplyConcurrencyArgs);
+BENCHMARK(BM_GetCrossingEdges)->Apply(ApplyConcurrencyArgs);
+
+}  // namespace
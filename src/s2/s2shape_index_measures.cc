@@ -18,15 +18,63 @@
 #include "s2/s2shape_index_measures.h"
 
 #include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 #include "s2/s1angle.h"
+#include "s2/s2latlng_rect.h"
 #include "s2/s2point.h"
 #include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
 #include "s2/s2shape_measures.h"
 
+using std::min;
+using std::vector;
+
 namespace S2 {
 
+namespace {
+
+// Calls fn(i) for all 0 <= i < n using up to "num_threads" threads.
+template <class Fn>
+void ParallelFor(int n, int num_threads, const Fn& fn) {
+  std::atomic<int> next(0);
+  auto run = [&]() {
+    for (int i; (i = next.fetch_add(1)) < n; ) fn(i);
+  };
+  vector<std::thread> threads;
+  for (int i = 1; i < min(num_threads, n); ++i) threads.emplace_back(run);
+  run();
+  for (auto& thread : threads) thread.join();
+}
+
+// Returns the sum of measure(*shape) over all the shapes in the index, using
+// up to "num_threads" threads.  Each block of kBlockSize consecutive shape
+// ids is summed separately, and then the block sums are added in order.
+template <class T, class Measure>
+T SumShapeMeasures(const S2ShapeIndex& index, int num_threads,
+                   const Measure& measure) {
+  constexpr int kBlockSize = 1024;
+  const int num_shape_ids = index.num_shape_ids();
+  const int num_blocks = (num_shape_ids + kBlockSize - 1) / kBlockSize;
+  vector<T> block_sums(num_blocks);
+  ParallelFor(num_blocks, num_threads, [&](int block) {
+    const int limit = min(num_shape_ids, (block + 1) * kBlockSize);
+    T sum = T();
+    for (int i = block * kBlockSize; i < limit; ++i) {
+      const S2Shape* shape = index.shape(i);
+      if (shape) sum += measure(*shape);
+    }
+    block_sums[block] = sum;
+  });
+  T total = T();
+  for (const T& sum : block_sums) total += sum;
+  return total;
+}
+
+}  // namespace
+
 int GetDimension(const S2ShapeIndex& index) {
   int dim = -1;
   for (int i = 0; i < index.num_shape_ids(); ++i) {
@@ -95,4 +143,69 @@ S2Point GetCentroid(const S2ShapeIndex& index) {
   return centroid;
 }
 
+S1Angle GetLength(const S2ShapeIndex& index, int num_threads) {
+  return SumShapeMeasures<S1Angle>(
+      index, num_threads,
+      [](const S2Shape& shape) { return GetLength(shape); });
+}
+
+S1Angle GetPerimeter(const S2ShapeIndex& index, int num_threads) {
+  return SumShapeMeasures<S1Angle>(
+      index, num_threads,
+      [](const S2Shape& shape) { return GetPerimeter(shape); });
+}
+
+double GetArea(const S2ShapeIndex& index, int num_threads) {
+  return SumShapeMeasures<double>(
+      index, num_threads, [](const S2Shape& shape) { return GetArea(shape); });
+}
+
+double GetApproxArea(const S2ShapeIndex& index, int num_threads) {
+  return SumShapeMeasures<double>(
+      index, num_threads,
+      [](const S2Shape& shape) { return GetApproxArea(shape); });
+}
+
+S2Point GetCentroid(const S2ShapeIndex& index, int num_threads) {
+  const int dim = GetDimension(index);
+  return SumShapeMeasures<S2Point>(
+      index, num_threads, [dim](const S2Shape& shape) {
+        return shape.dimension() == dim ? GetCentroid(shape) : S2Point();
+      });
+}
+
+vector<ShapeMeasures> GetShapeMeasures(const S2ShapeIndex& index,
+                                       int num_threads) {
+  constexpr int kBlockSize = 1024;
+  const int num_shape_ids = index.num_shape_ids();
+  const int num_blocks = (num_shape_ids + kBlockSize - 1) / kBlockSize;
+  vector<ShapeMeasures> result(num_shape_ids);
+  ParallelFor(num_blocks, num_threads, [&](int block) {
+    const int limit = min(num_shape_ids, (block + 1) * kBlockSize);
+    for (int i = block * kBlockSize; i < limit; ++i) {
+      const S2Shape* shape = index.shape(i);
+      if (shape == nullptr) continue;
+      result[i].area = GetArea(*shape);
+      result[i].centroid = GetCentroid(*shape);
+    }
+  });
+  return result;
+}
+
+vector<S2LatLngRect> GetShapeRectBounds(const S2ShapeIndex& index,
+                                        int num_threads) {
+  constexpr int kBlockSize = 1024;
+  const int num_shape_ids = index.num_shape_ids();
+  const int num_blocks = (num_shape_ids + kBlockSize - 1) / kBlockSize;
+  vector<S2LatLngRect> result(num_shape_ids, S2LatLngRect::Empty());
+  ParallelFor(num_blocks, num_threads, [&](int block) {
+    const int limit = min(num_shape_ids, (block + 1) * kBlockSize);
+    for (int i = block * kBlockSize; i < limit; ++i) {
+      const S2Shape* shape = index.shape(i);
+      if (shape != nullptr) result[i] = GetRectBound(*shape);
+    }
+  });
+  return result;
+}
+
 }  // namespace S2
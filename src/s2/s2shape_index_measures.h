@@ -22,7 +22,10 @@
 #ifndef S2_S2SHAPE_INDEX_MEASURES_H_
 #define S2_S2SHAPE_INDEX_MEASURES_H_
 
+#include <vector>
+
 #include "s2/s1angle.h"
+#include "s2/s2latlng_rect.h"
 #include "s2/s2point.h"
 #include "s2/s2shape_index.h"
 
@@ -95,6 +98,40 @@ double GetApproxArea(const S2ShapeIndex& index);
 // centroids can simply be summed).
 S2Point GetCentroid(const S2ShapeIndex& index);
 
+// Versions of the functions above that process the shapes using up to
+// "num_threads" threads.  The shapes are divided into fixed-size blocks whose
+// measures are summed separately, so the result does not depend on the number
+// of threads (although it may differ from the single-threaded functions
+// above due to rounding).
+S1Angle GetLength(const S2ShapeIndex& index, int num_threads);
+S1Angle GetPerimeter(const S2ShapeIndex& index, int num_threads);
+double GetArea(const S2ShapeIndex& index, int num_threads);
+double GetApproxArea(const S2ShapeIndex& index, int num_threads);
+S2Point GetCentroid(const S2ShapeIndex& index, int num_threads);
+
+// The measures of a single shape, as returned by GetShapeMeasures().
+struct ShapeMeasures {
+  // S2::GetArea(shape), which is zero for shapes of dimension 0 and 1.
+  double area = 0;
+
+  // S2::GetCentroid(shape), i.e. the centroid multiplied by the measure of
+  // the shape (see above).
+  S2Point centroid;
+};
+
+// Returns the measures of every shape in the index, indexed by shape id.
+// Missing (deleted) shapes have zero measures.  This is equivalent to (but
+// faster than) calling S2::GetArea() and S2::GetCentroid() on each shape,
+// since the shapes are processed by up to "num_threads" threads.
+std::vector<ShapeMeasures> GetShapeMeasures(const S2ShapeIndex& index,
+                                            int num_threads = 1);
+
+// Returns S2::GetRectBound(shape) for every shape in the index, indexed by
+// shape id, using up to "num_threads" threads.  Missing (deleted) shapes have
+// empty bounds.
+std::vector<S2LatLngRect> GetShapeRectBounds(const S2ShapeIndex& index,
+                                             int num_threads = 1);
+
 }  // namespace S2
 
 #endif  // S2_S2SHAPE_INDEX_MEASURES_H_
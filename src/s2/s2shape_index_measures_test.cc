@@ -25,18 +25,25 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include "s2/mutable_s2shape_index.h"
 #include "s2/s1angle.h"
+#include "s2/s2latlng_rect.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2lax_polyline_shape.h"
 #include "s2/s2point.h"
 #include "s2/s2point_vector_shape.h"
 #include "s2/s2pointutil.h"
 #include "s2/s2shape.h"
+#include "s2/s2shape_measures.h"
+#include "s2/s2testing.h"
 #include "s2/s2text_format.h"
 
 using s2textformat::MakeIndexOrDie;
 using std::make_unique;
+using std::vector;
 
 namespace {
 
@@ -139,3 +146,74 @@ TEST(GetCentroid, Polygon) {
 }
 
 }  // namespace
+
+// Returns an index containing many small polygons, polylines, and points,
+// with some shapes removed.
+static std::unique_ptr<MutableS2ShapeIndex> MakeLargeIndex() {
+  S2Testing::rnd.Reset(1);
+  auto index = make_unique<MutableS2ShapeIndex>();
+  for (int i = 0; i < 3000; ++i) {
+    const S2Point center = S2Testing::RandomPoint();
+    vector<S2Point> vertices = S2Testing::MakeRegularPoints(
+        center, S1Angle::Degrees(0.1 + S2Testing::rnd.RandDouble()), 5);
+    if (i % 3 == 0) {
+      index->Add(make_unique<S2LaxPolylineShape>(vertices));
+    } else if (i % 7 == 0) {
+      index->Add(make_unique<S2PointVectorShape>(vertices));
+    } else {
+      index->Add(make_unique<S2LaxPolygonShape>(
+          vector<vector<S2Point>>{vertices}));
+    }
+  }
+  for (int i = 0; i < 3000; i += 100) index->Release(i);
+  return index;
+}
+
+TEST(ParallelMeasures, MatchSingleThreaded) {
+  const auto index = MakeLargeIndex();
+  for (int num_threads : {1, 4}) {
+    EXPECT_NEAR(S2::GetLength(*index).radians(),
+                S2::GetLength(*index, num_threads).radians(), 1e-12);
+    EXPECT_NEAR(S2::GetPerimeter(*index).radians(),
+                S2::GetPerimeter(*index, num_threads).radians(), 1e-12);
+    EXPECT_NEAR(S2::GetArea(*index), S2::GetArea(*index, num_threads), 1e-12);
+    EXPECT_NEAR(S2::GetApproxArea(*index),
+                S2::GetApproxArea(*index, num_threads), 1e-12);
+    EXPECT_TRUE(S2::ApproxEquals(S2::GetCentroid(*index),
+                                 S2::GetCentroid(*index, num_threads),
+                                 S1Angle::Radians(1e-12)));
+  }
+  // The results do not depend on the number of threads.
+  EXPECT_EQ(S2::GetArea(*index, 1), S2::GetArea(*index, 3));
+  EXPECT_EQ(S2::GetCentroid(*index, 1), S2::GetCentroid(*index, 3));
+}
+
+TEST(GetShapeMeasures, MatchesPerShapeMeasures) {
+  const auto index = MakeLargeIndex();
+  const vector<S2::ShapeMeasures> measures = S2::GetShapeMeasures(*index, 4);
+  ASSERT_EQ(index->num_shape_ids(), measures.size());
+  for (int i = 0; i < index->num_shape_ids(); ++i) {
+    const S2Shape* shape = index->shape(i);
+    if (shape == nullptr) {
+      EXPECT_EQ(0, measures[i].area);
+      EXPECT_EQ(S2Point(), measures[i].centroid);
+    } else {
+      EXPECT_EQ(S2::GetArea(*shape), measures[i].area);
+      EXPECT_EQ(S2::GetCentroid(*shape), measures[i].centroid);
+    }
+  }
+}
+
+TEST(GetShapeRectBounds, MatchesPerShapeBounds) {
+  const auto index = MakeLargeIndex();
+  const vector<S2LatLngRect> bounds = S2::GetShapeRectBounds(*index, 4);
+  ASSERT_EQ(index->num_shape_ids(), bounds.size());
+  for (int i = 0; i < index->num_shape_ids(); ++i) {
+    const S2Shape* shape = index->shape(i);
+    if (shape == nullptr) {
+      EXPECT_TRUE(bounds[i].is_empty());
+    } else {
+      EXPECT_EQ(S2::GetRectBound(*shape), bounds[i]);
+    }
+  }
+}
@@ -0,0 +1,144 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Benchmarks for --s2shape_index_prefetch_distance.  Each benchmark takes the
+// prefetch distance as its last argument, so that zero is the baseline.
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "absl/flags/flag.h"
+#include "absl/flags/reflection.h"
+#include "s2/util/coding/coder.h"
+#include "s2/encoded_s2shape_index.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cell_iterator_join.h"
+#include "s2/s2closest_edge_query.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2point.h"
+#include "s2/s2shape_index.h"
+#include "s2/s2shapeutil_coding.h"
+#include "s2/s2testing.h"
+
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Returns an index of "num_loops" small loops at random locations.  Adding
+// the loops in random order leaves the index cells scattered through memory,
+// which is typical of indexes built incrementally.
+unique_ptr<MutableS2ShapeIndex> MakeRandomLoopIndex(int num_loops,
+                                                    uint32 seed) {
+  S2Testing::rnd.Reset(seed);
+  auto index = make_unique<MutableS2ShapeIndex>();
+  for (int i = 0; i < num_loops; ++i) {
+    // S2LaxPolygonShape is used so that the index can also be encoded.
+    vector<S2LaxPolygonShape::Loop> loops = {S2Testing::MakeRegularPoints(
+        S2Testing::RandomPoint(), S1Angle::Degrees(0.2), 32)};
+    index->Add(make_unique<S2LaxPolygonShape>(loops));
+    // Building in batches interleaves the allocation of cells.
+    if (i % 64 == 63) index->ForceBuild();
+  }
+  index->ForceBuild();
+  return index;
+}
+
+// Visits every edge id of every cell, as many algorithms that scan the whole
+// index do.
+template <class Iterator>
+int64 ScanIndex(Iterator* it) {
+  int64 sum = 0;
+  for (it->Begin(); !it->done(); it->Next()) {
+    for (const S2ClippedShape& clipped : it->cell().clipped_shapes()) {
+      for (int i = 0; i < clipped.num_edges(); ++i) sum += clipped.edge(i);
+    }
+  }
+  return sum;
+}
+
+void BM_ScanMutableIndex(benchmark::State& state) {
+  absl::FlagSaver fs;
+  absl::SetFlag(&FLAGS_s2shape_index_prefetch_distance, state.range(1));
+  auto index = MakeRandomLoopIndex(state.range(0), 1);
+  MutableS2ShapeIndex::Iterator it(index.get());
+  for (auto _ : state) benchmark::DoNotOptimize(ScanIndex(&it));
+}
+BENCHMARK(BM_ScanMutableIndex)
+    ->ArgsProduct({{1 << 12, 1 << 16}, {0, 4, 8, 16}});
+
+// Scans an EncodedS2ShapeIndex whose cells have all been decoded.
+void BM_ScanEncodedIndex(benchmark::State& state) {
+  absl::FlagSaver fs;
+  absl::SetFlag(&FLAGS_s2shape_index_prefetch_distance, state.range(1));
+  auto mutable_index = MakeRandomLoopIndex(state.range(0), 1);
+  Encoder encoder;
+  s2shapeutil::CompactEncodeTaggedShapes(*mutable_index, &encoder);
+  mutable_index->Encode(&encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex index;
+  if (!index.Init(&decoder, s2shapeutil::LazyDecodeShapeFactory(&decoder))) {
+    state.SkipWithError("Could not decode index");
+    return;
+  }
+  EncodedS2ShapeIndex::Iterator it(&index);
+  ScanIndex(&it);
+  for (auto _ : state) benchmark::DoNotOptimize(ScanIndex(&it));
+}
+BENCHMARK(BM_ScanEncodedIndex)
+    ->ArgsProduct({{1 << 12, 1 << 16}, {0, 4, 8, 16}});
+
+// Joins two indexes whose loops are at different random locations.
+void BM_JoinMutableIndexes(benchmark::State& state) {
+  absl::FlagSaver fs;
+  absl::SetFlag(&FLAGS_s2shape_index_prefetch_distance, state.range(1));
+  auto index_a = MakeRandomLoopIndex(state.range(0), 1);
+  auto index_b = MakeRandomLoopIndex(state.range(0), 2);
+  for (auto _ : state) {
+    int64 num_pairs = 0;
+    MakeS2CellIteratorJoin(index_a.get(), index_b.get())
+        .Join([&num_pairs](const MutableS2ShapeIndex::Iterator& a,
+                           const MutableS2ShapeIndex::Iterator& b) {
+          num_pairs += a.cell().num_clipped() * b.cell().num_clipped();
+          return true;
+        });
+    benchmark::DoNotOptimize(num_pairs);
+  }
+}
+BENCHMARK(BM_JoinMutableIndexes)
+    ->ArgsProduct({{1 << 12, 1 << 16}, {0, 8}});
+
+// Finds the edges within a small distance of random points, which processes
+// many queued index cells per query.
+void BM_FindClosestEdges(benchmark::State& state) {
+  absl::FlagSaver fs;
+  absl::SetFlag(&FLAGS_s2shape_index_prefetch_distance, state.range(1));
+  auto index = MakeRandomLoopIndex(state.range(0), 1);
+  S2ClosestEdgeQuery query(index.get());
+  query.mutable_options()->set_max_distance(S1Angle::Degrees(2));
+  vector<S2Point> points;
+  for (int i = 0; i < 256; ++i) points.push_back(S2Testing::RandomPoint());
+  int i = 0;
+  for (auto _ : state) {
+    S2ClosestEdgeQuery::PointTarget target(points[i++ & 255]);
+    benchmark::DoNotOptimize(query.FindClosestEdges(&target).size());
+  }
+}
+BENCHMARK(BM_FindClosestEdges)->ArgsProduct({{1 << 12, 1 << 16}, {0, 8}});
+
+}  // namespace
@@ -17,9 +17,13 @@
 #ifndef S2_S2SHAPE_INDEX_REGION_H_
 #define S2_S2SHAPE_INDEX_REGION_H_
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <utility>
 #include <vector>
 
+#include "s2/base/types.h"
 #include "absl/base/optimization.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/functional/function_ref.h"
@@ -36,6 +40,7 @@
 #include "s2/s2latlng_rect.h"
 #include "s2/s2point.h"
 #include "s2/s2region.h"
+#include "s2/s2region_coverer.h"
 #include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
 
@@ -68,7 +73,8 @@
 // }
 //
 // This class is not thread-safe.  To use it in parallel, each thread should
-// construct its own instance (this is not expensive).
+// construct its own instance (this is not expensive), or alternatively all
+// threads can share a single S2SharedShapeIndexRegion (see below).
 template <class IndexType>
 class S2ShapeIndexRegion final : public S2Region {
  public:
@@ -81,6 +87,23 @@ class S2ShapeIndexRegion final : public S2Region {
 
   const IndexType& index() const;
 
+  // Returns a covering (or interior covering) of the index that satisfies
+  // "options" (see S2RegionCoverer::Options), computed directly from the
+  // index cells rather than by searching with MayIntersect() and Contains().
+  // This is much faster than S2RegionCoverer for large indexes, since the
+  // index cells already subdivide space as finely as necessary.
+  //
+  // Each candidate cell is classified with a single index lookup and no edge
+  // tests, and cells are never subdivided beyond the index cells.  So the
+  // covering consists of cells that cover the index cells, and the interior
+  // covering consists of cells within index cells that are contained by some
+  // shape.  (With small index cells this makes little difference, but
+  // coverings of indexes with few edges may be less tight than those of
+  // S2RegionCoverer.)
+  S2CellUnion GetCovering(const S2RegionCoverer::Options& options) const;
+  S2CellUnion GetInteriorCovering(
+      const S2RegionCoverer::Options& options) const;
+
   ////////////////////////////////////////////////////////////////////////
   // S2Region interface (see s2region.h for details):
 
@@ -110,6 +133,11 @@ class S2ShapeIndexRegion final : public S2Region {
   // error is less than 10 * DBL_EPSILON radians (or about 15 nanometers).
   bool MayIntersect(const S2Cell& target) const override;
 
+  // Locates the children in the index only once, and does not locate them at
+  // all if their parent is contained by a single index cell.
+  void GetChildRelations(const S2Cell children[4], bool check_contains,
+                         CellRelation relations[4]) const override;
+
   // Visits all shapes that intersect an S2Cell, passing a shape id and a flag
   // indicating whether the S2Cell was fully contained by the shape to a
   // visitor.  Each shape is visited at most once.
@@ -157,12 +185,20 @@ class S2ShapeIndexRegion final : public S2Region {
   static void CoverRange(S2CellId first, S2CellId last,
                          std::vector<S2CellId> *cell_ids);
 
+  // Used by GetCovering() and GetInteriorCovering().
+  class IndexCellRegion;
+
   // Returns true if the indexed shape "clipped" in the indexed cell "id"
   // contains the point "p".
   //
   // REQUIRES: iter_.id() contains "p".
   bool Contains(const S2ClippedShape& clipped, const S2Point& p) const;
 
+  // Returns the relation of "target" to the region (see GetChildRelations),
+  // where "relation" is the result of iter_.Locate(target.id()).
+  CellRelation GetCellRelation(const S2Cell& target, S2CellRelation relation,
+                               bool check_contains) const;
+
   // Returns true if any edge of the indexed shape "clipped" intersects the
   // cell "target".  It may also return true if an edge is very close to
   // "target"; the maximum error is less than 10 * DBL_EPSILON radians (about
@@ -185,6 +221,77 @@ class S2ShapeIndexRegion final : public S2Region {
 template <class IndexType>
 S2ShapeIndexRegion<IndexType> MakeS2ShapeIndexRegion(const IndexType* index);
 
+// S2SharedShapeIndexRegion is a thread-safe version of S2ShapeIndexRegion.
+// A single instance can be shared by any number of threads, e.g. in order to
+// compute many coverings of the same index in parallel:
+//
+//   auto region = MakeS2SharedShapeIndexRegion(&index);
+//   // In each thread:
+//   S2CellUnion covering = S2RegionCoverer(options).GetCovering(region);
+//
+// The object itself only has const state.  Instead, each thread lazily
+// constructs its own S2ShapeIndexRegion (i.e., an index iterator and an
+// S2ContainsPointQuery) the first time that it uses a given shared region,
+// and reuses it for as long as it keeps using that region.  (Each thread
+// caches only one region per IndexType, so a thread that alternates between
+// several shared regions constructs a new S2ShapeIndexRegion whenever it
+// switches.)
+//
+// The index must not be modified while the region is in use.
+template <class IndexType>
+class S2SharedShapeIndexRegion final : public S2Region {
+ public:
+  // As with S2ShapeIndexRegion, the preferred idiom is to call
+  // MakeS2SharedShapeIndexRegion(&index) instead.
+  explicit S2SharedShapeIndexRegion(const IndexType* index);
+
+  const IndexType& index() const { return *index_; }
+
+  ////////////////////////////////////////////////////////////////////////
+  // S2Region interface (see S2ShapeIndexRegion for details):
+
+  // Clone() returns a *shallow* copy; it does not make a copy of the
+  // underlying S2ShapeIndex.
+  S2SharedShapeIndexRegion<IndexType>* Clone() const override;
+
+  S2Cap GetCapBound() const override;
+  S2LatLngRect GetRectBound() const override;
+  void GetCellUnionBound(std::vector<S2CellId>* cell_ids) const override;
+  bool Contains(const S2Cell& target) const override;
+  bool MayIntersect(const S2Cell& target) const override;
+  void GetChildRelations(const S2Cell children[4], bool check_contains,
+                         CellRelation relations[4]) const override;
+  bool Contains(const S2Point& p) const override;
+
+  // Equivalent to the S2ShapeIndexRegion methods.  These methods construct a
+  // temporary S2ShapeIndexRegion rather than using the thread's cached one,
+  // so "visitor" may call other methods of this object.
+  bool VisitIntersectingShapeIds(
+      const S2Cell& target,
+      absl::FunctionRef<bool(int shape_id, bool contains_target)> visitor)
+      const;
+  bool VisitIntersectingShapes(
+      const S2Cell& target,
+      absl::FunctionRef<bool(const S2Shape* shape, bool contains_target)>
+          visitor) const;
+
+ private:
+  // Returns the calling thread's S2ShapeIndexRegion for this object.
+  S2ShapeIndexRegion<IndexType>& GetThreadRegion() const;
+
+  const IndexType* index_;
+
+  // Identifies this object (and its copies) in the per-thread cache.  Ids
+  // are never reused, so a cached region can never be mistaken for that of
+  // a different object that happens to have the same address.
+  uint64 id_;
+};
+
+// Returns an S2SharedShapeIndexRegion that wraps the given S2ShapeIndex.
+template <class IndexType>
+S2SharedShapeIndexRegion<IndexType> MakeS2SharedShapeIndexRegion(
+    const IndexType* index);
+
 
 //////////////////   Implementation details follow   ////////////////////
 
@@ -279,6 +386,100 @@ void S2ShapeIndexRegion<IndexType>::GetCellUnionBound(
 // adds this cell to "cell_ids".
 //
 // REQUIRES: "first" and "last" have a common ancestor.
+// An S2Region consisting of the index cells of an S2ShapeIndexRegion, or
+// only those that are contained by some shape if "interior" is true.  Each
+// predicate locates the cell in the index and does not test any edges, and
+// cells within an index cell are never subdivided (since "Contains" is true
+// for them).  This lets S2RegionCoverer compute coverings of the index from
+// its cell structure alone.
+template <class IndexType>
+class S2ShapeIndexRegion<IndexType>::IndexCellRegion final : public S2Region {
+ public:
+  IndexCellRegion(const S2ShapeIndexRegion* region, bool interior)
+      : region_(region), interior_(interior) {}
+
+  IndexCellRegion* Clone() const override {
+    return new IndexCellRegion(*this);
+  }
+  S2Cap GetCapBound() const override { return region_->GetCapBound(); }
+  S2LatLngRect GetRectBound() const override {
+    return region_->GetRectBound();
+  }
+  void GetCellUnionBound(std::vector<S2CellId>* cell_ids) const override {
+    region_->GetCellUnionBound(cell_ids);
+  }
+  bool Contains(const S2Cell& cell) const override {
+    return GetRelation(region_->iter_.Locate(cell.id()), true) ==
+           CellRelation::CONTAINS;
+  }
+  bool MayIntersect(const S2Cell& cell) const override {
+    return GetRelation(region_->iter_.Locate(cell.id()), false) !=
+           CellRelation::DISJOINT;
+  }
+  bool Contains(const S2Point& p) const override {
+    return region_->Contains(p);
+  }
+  void GetChildRelations(const S2Cell children[4], bool check_contains,
+                         CellRelation relations[4]) const override {
+    // If the parent cell is disjoint from the index or contained by a single
+    // index cell, then the same is true of all its children.
+    const S2CellRelation parent =
+        region_->iter_.Locate(children[0].id().parent());
+    if (parent != S2CellRelation::SUBDIVIDED) {
+      std::fill(relations, relations + 4,
+                GetRelation(parent, check_contains));
+      return;
+    }
+    for (int i = 0; i < 4; ++i) {
+      relations[i] = GetRelation(region_->iter_.Locate(children[i].id()),
+                                 check_contains);
+    }
+  }
+
+ private:
+  // Returns the relation of a cell to this region, where "relation" is the
+  // result of locating it in the index.
+  CellRelation GetRelation(S2CellRelation relation,
+                           bool check_contains) const {
+    if (relation == S2CellRelation::DISJOINT) return CellRelation::DISJOINT;
+    if (relation == S2CellRelation::SUBDIVIDED) {
+      return CellRelation::MAY_INTERSECT;
+    }
+    // The cell is within an index cell, so it is never subdivided further.
+    if (interior_ && !IsInteriorCell()) return CellRelation::DISJOINT;
+    return check_contains ? CellRelation::CONTAINS
+                          : CellRelation::MAY_INTERSECT;
+  }
+
+  // Returns true if some shape contains the current index cell (i.e., the
+  // shape contains the cell center and has no edges in the cell).
+  bool IsInteriorCell() const {
+    const S2ShapeIndexCell& cell = region_->iter_.cell();
+    for (int s = 0; s < cell.num_clipped(); ++s) {
+      const S2ClippedShape& clipped = cell.clipped(s);
+      if (clipped.num_edges() == 0 && clipped.contains_center()) return true;
+    }
+    return false;
+  }
+
+  const S2ShapeIndexRegion* region_;
+  bool interior_;
+};
+
+template <class IndexType>
+S2CellUnion S2ShapeIndexRegion<IndexType>::GetCovering(
+    const S2RegionCoverer::Options& options) const {
+  S2RegionCoverer coverer(options);
+  return coverer.GetCovering(IndexCellRegion(this, false));
+}
+
+template <class IndexType>
+S2CellUnion S2ShapeIndexRegion<IndexType>::GetInteriorCovering(
+    const S2RegionCoverer::Options& options) const {
+  S2RegionCoverer coverer(options);
+  return coverer.GetInteriorCovering(IndexCellRegion(this, true));
+}
+
 template <class IndexType>
 inline void S2ShapeIndexRegion<IndexType>::CoverRange(
     S2CellId first, S2CellId last, std::vector<S2CellId> *cell_ids) {
@@ -359,6 +560,61 @@ bool S2ShapeIndexRegion<IndexType>::MayIntersect(const S2Cell& target) const {
   return false;
 }
 
+template <class IndexType>
+void S2ShapeIndexRegion<IndexType>::GetChildRelations(
+    const S2Cell children[4], bool check_contains,
+    CellRelation relations[4]) const {
+  // If the parent cell is disjoint from the index or contained by a single
+  // index cell, then the same is true of all its children.
+  const S2CellRelation parent_relation =
+      iter_.Locate(children[0].id().parent());
+  for (int i = 0; i < 4; ++i) {
+    const S2CellRelation relation =
+        parent_relation == S2CellRelation::SUBDIVIDED
+            ? iter_.Locate(children[i].id())
+            : parent_relation;
+    relations[i] = GetCellRelation(children[i], relation, check_contains);
+  }
+}
+
+template <class IndexType>
+S2Region::CellRelation S2ShapeIndexRegion<IndexType>::GetCellRelation(
+    const S2Cell& target, S2CellRelation relation,
+    bool check_contains) const {
+  // This is equivalent to calling MayIntersect() and Contains(), except that
+  // the edge and center tests for each shape are done only once.
+  if (relation == S2CellRelation::DISJOINT) return CellRelation::DISJOINT;
+  if (relation == S2CellRelation::SUBDIVIDED) {
+    return CellRelation::MAY_INTERSECT;
+  }
+  ABSL_DCHECK(iter_.id().contains(target.id()));
+  const S2ShapeIndexCell& cell = iter_.cell();
+  if (iter_.id() == target.id()) {
+    for (int s = 0; check_contains && s < cell.num_clipped(); ++s) {
+      const S2ClippedShape& clipped = cell.clipped(s);
+      if (clipped.num_edges() == 0 && clipped.contains_center()) {
+        return CellRelation::CONTAINS;
+      }
+    }
+    return CellRelation::MAY_INTERSECT;
+  }
+  bool may_intersect = false;
+  for (int s = 0; s < cell.num_clipped(); ++s) {
+    const S2ClippedShape& clipped = cell.clipped(s);
+    if (AnyEdgeIntersects(clipped, target)) {
+      may_intersect = true;
+    } else if (Contains(clipped, target.GetCenter())) {
+      may_intersect = true;
+      if (check_contains &&
+          index().shape(clipped.shape_id())->dimension() == 2) {
+        return CellRelation::CONTAINS;
+      }
+    }
+    if (may_intersect && !check_contains) break;
+  }
+  return may_intersect ? CellRelation::MAY_INTERSECT : CellRelation::DISJOINT;
+}
+
 template <class IndexType>
 bool S2ShapeIndexRegion<IndexType>::VisitIntersectingShapeIds(
     const S2Cell& target,
@@ -464,4 +720,102 @@ inline S2ShapeIndexRegion<IndexType> MakeS2ShapeIndexRegion(
   return S2ShapeIndexRegion<IndexType>(index);
 }
 
+namespace s2internal {
+// Returns a new id for S2SharedShapeIndexRegion (and similar classes).
+inline uint64 NewSharedRegionId() {
+  static std::atomic<uint64> next_id{1};
+  return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+}  // namespace s2internal
+
+template <class IndexType>
+S2SharedShapeIndexRegion<IndexType>::S2SharedShapeIndexRegion(
+    const IndexType* index)
+    : index_(index), id_(s2internal::NewSharedRegionId()) {
+}
+
+template <class IndexType>
+S2ShapeIndexRegion<IndexType>&
+S2SharedShapeIndexRegion<IndexType>::GetThreadRegion() const {
+  // Destroying a cached region at thread exit does not access its index, so
+  // it is safe for the index to be destroyed first.
+  thread_local uint64 region_id = 0;
+  thread_local std::unique_ptr<S2ShapeIndexRegion<IndexType>> region;
+  if (region_id != id_) {
+    region = std::make_unique<S2ShapeIndexRegion<IndexType>>(index_);
+    region_id = id_;
+  }
+  return *region;
+}
+
+template <class IndexType>
+S2SharedShapeIndexRegion<IndexType>*
+S2SharedShapeIndexRegion<IndexType>::Clone() const {
+  return new S2SharedShapeIndexRegion<IndexType>(*this);
+}
+
+template <class IndexType>
+S2Cap S2SharedShapeIndexRegion<IndexType>::GetCapBound() const {
+  return GetThreadRegion().GetCapBound();
+}
+
+template <class IndexType>
+S2LatLngRect S2SharedShapeIndexRegion<IndexType>::GetRectBound() const {
+  return GetThreadRegion().GetRectBound();
+}
+
+template <class IndexType>
+void S2SharedShapeIndexRegion<IndexType>::GetCellUnionBound(
+    std::vector<S2CellId>* cell_ids) const {
+  GetThreadRegion().GetCellUnionBound(cell_ids);
+}
+
+template <class IndexType>
+bool S2SharedShapeIndexRegion<IndexType>::Contains(
+    const S2Cell& target) const {
+  return GetThreadRegion().Contains(target);
+}
+
+template <class IndexType>
+bool S2SharedShapeIndexRegion<IndexType>::MayIntersect(
+    const S2Cell& target) const {
+  return GetThreadRegion().MayIntersect(target);
+}
+
+template <class IndexType>
+void S2SharedShapeIndexRegion<IndexType>::GetChildRelations(
+    const S2Cell children[4], bool check_contains,
+    CellRelation relations[4]) const {
+  GetThreadRegion().GetChildRelations(children, check_contains, relations);
+}
+
+template <class IndexType>
+bool S2SharedShapeIndexRegion<IndexType>::Contains(const S2Point& p) const {
+  return GetThreadRegion().Contains(p);
+}
+
+template <class IndexType>
+bool S2SharedShapeIndexRegion<IndexType>::VisitIntersectingShapeIds(
+    const S2Cell& target,
+    absl::FunctionRef<bool(int shape_id, bool contains_target)> visitor)
+    const {
+  return MakeS2ShapeIndexRegion(index_).VisitIntersectingShapeIds(target,
+                                                                  visitor);
+}
+
+template <class IndexType>
+bool S2SharedShapeIndexRegion<IndexType>::VisitIntersectingShapes(
+    const S2Cell& target,
+    absl::FunctionRef<bool(const S2Shape* shape, bool contains_target)>
+        visitor) const {
+  return MakeS2ShapeIndexRegion(index_).VisitIntersectingShapes(target,
+                                                                visitor);
+}
+
+template <class IndexType>
+inline S2SharedShapeIndexRegion<IndexType> MakeS2SharedShapeIndexRegion(
+    const IndexType* index) {
+  return S2SharedShapeIndexRegion<IndexType>(index);
+}
+
 #endif  // S2_S2SHAPE_INDEX_REGION_H_
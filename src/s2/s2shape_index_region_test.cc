@@ -18,6 +18,7 @@
 #include <algorithm>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -31,6 +32,7 @@
 #include "s2/s2cap.h"
 #include "s2/s2cell.h"
 #include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
 #include "s2/s2coords.h"
 #include "s2/s2edge_clipping.h"
 #include "s2/s2fractal.h"
@@ -41,6 +43,7 @@
 #include "s2/s2loop.h"
 #include "s2/s2point.h"
 #include "s2/s2point_vector_shape.h"
+#include "s2/s2region_coverer.h"
 #include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
 #include "s2/s2testing.h"
@@ -304,4 +307,135 @@ TEST(VisitIntersectingShapes, Polygons) {
   VisitIntersectingShapesTest(&index).Run();
 }
 
+// Returns an index containing a fractal loop with a hole and a polyline.
+unique_ptr<MutableS2ShapeIndex> MakeCoveringTestIndex() {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3000);
+  const S2Point center(1, 0, 0);
+  auto index = make_unique<MutableS2ShapeIndex>();
+  index->Add(make_unique<S2Loop::OwningShape>(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(center), S1Angle::Degrees(10))));
+  index->Add(make_unique<S2Loop::OwningShape>(
+      S2Loop::MakeRegularLoop(-center, S1Angle::Degrees(20), 100)));
+  index->Add(make_unique<S2LaxPolylineShape>(
+      vector<S2Point>{S2Point(0, 1, 0), S2Point(0, 1, 1).Normalize()}));
+  index->ForceBuild();
+  return index;
+}
+
+TEST(S2ShapeIndexRegion, GetCoveringFromIndexCells) {
+  auto index = MakeCoveringTestIndex();
+  auto region = MakeS2ShapeIndexRegion(index.get());
+  for (int max_cells : {4, 20, 100, 100000}) {
+    for (int level_mod : {1, 3}) {
+      S2RegionCoverer::Options options;
+      options.set_max_cells(max_cells);
+      options.set_min_level(2);
+      options.set_max_level(20);
+      options.set_level_mod(level_mod);
+      S2RegionCoverer coverer(options);
+      S2CellUnion covering = region.GetCovering(options);
+      EXPECT_TRUE(coverer.IsCanonical(covering));
+      // The covering must contain every index cell.
+      S2CellUnion normalized(covering.cell_ids());
+      for (MutableS2ShapeIndex::Iterator it(index.get(), S2ShapeIndex::BEGIN);
+           !it.done(); it.Next()) {
+        EXPECT_TRUE(normalized.Contains(it.id())) << it.id();
+      }
+    }
+  }
+}
+
+TEST(S2ShapeIndexRegion, GetInteriorCoveringFromIndexCells) {
+  auto index = MakeCoveringTestIndex();
+  auto region = MakeS2ShapeIndexRegion(index.get());
+  for (int max_cells : {4, 20, 100, 100000}) {
+    for (int level_mod : {1, 3}) {
+      S2RegionCoverer::Options options;
+      options.set_max_cells(max_cells);
+      options.set_min_level(2);
+      options.set_max_level(20);
+      options.set_level_mod(level_mod);
+      S2CellUnion interior = region.GetInteriorCovering(options);
+      EXPECT_GT(interior.num_cells(), 0);
+      EXPECT_LE(interior.num_cells(), max_cells);
+      for (S2CellId id : interior) {
+        EXPECT_GE(id.level(), options.min_level());
+        EXPECT_LE(id.level(), options.max_level());
+        EXPECT_EQ(0, (id.level() - options.min_level()) % level_mod);
+        EXPECT_TRUE(region.Contains(S2Cell(id))) << id;
+      }
+    }
+  }
+}
+
+TEST(S2SharedShapeIndexRegion, ParallelCoveringsMatch) {
+  // Compute coverings of a fractal loop with various numbers of cells, using
+  // one shared region from several threads at once.
+  MutableS2ShapeIndex index;
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3000);
+  index.Add(make_unique<S2Loop::OwningShape>(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(S2Point(1, 0, 0)), S1Angle::Degrees(10))));
+  index.ForceBuild();
+
+  constexpr int kNumCoverings = 20;
+  auto get_coverer = [](int i) {
+    S2RegionCoverer::Options options;
+    options.set_max_cells(4 + 10 * i);
+    return S2RegionCoverer(options);
+  };
+  vector<S2CellUnion> expected;
+  for (int i = 0; i < kNumCoverings; ++i) {
+    expected.push_back(
+        get_coverer(i).GetCovering(MakeS2ShapeIndexRegion(&index)));
+  }
+
+  const auto region = MakeS2SharedShapeIndexRegion(&index);
+  constexpr int kNumThreads = 8;
+  vector<vector<S2CellUnion>> actual(kNumThreads);
+  vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < kNumCoverings; ++i) {
+        actual[t].push_back(get_coverer(i).GetCovering(region));
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  for (int t = 0; t < kNumThreads; ++t) {
+    EXPECT_EQ(actual[t], expected);
+  }
+}
+
+TEST(S2SharedShapeIndexRegion, MatchesS2ShapeIndexRegion) {
+  MutableS2ShapeIndex index;
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(1000);
+  const S2Point center(0, 1, 0);
+  index.Add(make_unique<S2Loop::OwningShape>(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(center), S1Angle::Degrees(5))));
+  auto region = MakeS2ShapeIndexRegion(&index);
+  auto shared = MakeS2SharedShapeIndexRegion(&index);
+  unique_ptr<S2Region> clone(shared.Clone());
+  EXPECT_EQ(shared.GetCapBound(), region.GetCapBound());
+  EXPECT_EQ(shared.GetRectBound(), region.GetRectBound());
+  for (int i = 0; i < 1000; ++i) {
+    S2Cell cell(S2CellId(S2Testing::SamplePoint(
+        S2Cap(center, S1Angle::Degrees(6)))).parent(
+            S2Testing::rnd.Uniform(20)));
+    EXPECT_EQ(shared.Contains(cell), region.Contains(cell));
+    EXPECT_EQ(shared.MayIntersect(cell), region.MayIntersect(cell));
+    EXPECT_EQ(clone->MayIntersect(cell), region.MayIntersect(cell));
+    EXPECT_EQ(shared.Contains(cell.GetCenter()),
+              region.Contains(cell.GetCenter()));
+    // The visitor may use the shared region itself.
+    shared.VisitIntersectingShapeIds(cell, [&](int, bool contains) {
+      EXPECT_EQ(contains, shared.Contains(cell));
+      return true;
+    });
+  }
+}
+
 }  // namespace
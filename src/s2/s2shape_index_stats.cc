@@ -0,0 +1,167 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2shape_index_stats.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "s2/base/commandlineflags.h"
+#include "s2/base/types.h"
+#include "absl/flags/flag.h"
+#include "absl/functional/function_ref.h"
+#include "absl/numeric/bits.h"
+#include "absl/strings/string_view.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/r2rect.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2metrics.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+
+S2_DECLARE_double(s2shape_index_cell_size_to_long_edge_ratio);
+
+using std::unique_ptr;
+using std::vector;
+
+// S2Stats has access to the internals of S2ShapeIndexCell, S2ClippedShape,
+// and MutableS2ShapeIndex.
+class S2Stats {
+ public:
+  static void AddCellMemory(const S2ShapeIndexCell& cell,
+                            S2ShapeIndexStats* stats) {
+    stats->clipped_shape_bytes +=
+        cell.shapes_.capacity() * sizeof(S2ClippedShape);
+    for (const S2ClippedShape& clipped : cell.clipped_shapes()) {
+      if (!clipped.is_inline()) {
+        stats->edge_bytes += clipped.num_edges() * sizeof(int32);
+      }
+      if (cell.edge_run_bounds_ != nullptr) {
+        stats->edge_run_bound_bytes +=
+            S2ShapeIndexCell::num_edge_runs(clipped) * sizeof(R2Rect);
+      }
+    }
+  }
+
+  // Returns the first level at which the given edge is considered "long".
+  // "mutable_index" is nullptr for other types of index.
+  static int GetEdgeMaxLevel(const MutableS2ShapeIndex* mutable_index,
+                             const S2Shape::Edge& edge) {
+    if (mutable_index != nullptr) {
+      return mutable_index->GetEdgeMaxLevel(edge);
+    }
+    // This mirrors MutableS2ShapeIndex::GetEdgeMaxLevel().
+    return S2::kAvgEdge.GetLevelForMaxValue(
+        (edge.v0 - edge.v1).Norm() *
+        absl::GetFlag(FLAGS_s2shape_index_cell_size_to_long_edge_ratio));
+  }
+
+  static void AddIndexMemory(const S2ShapeIndex& index,
+                             const MutableS2ShapeIndex* mutable_index,
+                             S2ShapeIndexStats* stats) {
+    if (mutable_index != nullptr) {
+      stats->cell_map_bytes = mutable_index->cell_map_.bytes_used();
+      stats->shape_bytes =
+          mutable_index->shapes_.capacity() * sizeof(unique_ptr<S2Shape>);
+    } else {
+      stats->shape_bytes = index.num_shape_ids() * sizeof(S2Shape*);
+    }
+  }
+};
+
+namespace {
+
+// Increments the histogram bucket for the given value (see
+// S2ShapeIndexStats).
+void AddToHistogram(int64 value, vector<int64>* histogram) {
+  const int bucket = absl::bit_width(static_cast<uint64>(value));
+  if (static_cast<int>(histogram->size()) <= bucket) {
+    histogram->resize(bucket + 1);
+  }
+  ++(*histogram)[bucket];
+}
+
+}  // namespace
+
+void S2ShapeIndexStats::VisitCounters(
+    absl::FunctionRef<void(absl::string_view, int64)> visitor) const {
+  visitor("shapes", num_shapes);
+  visitor("shape_ids", num_shape_ids);
+  visitor("shape_edges", num_shape_edges);
+  visitor("cells", num_cells);
+  visitor("clipped_shapes", num_clipped_shapes);
+  visitor("clipped_edges", num_clipped_edges);
+  visitor("long_edges", num_long_edges);
+  visitor("contains_center", num_contains_center);
+  visitor("interior_cells", num_interior_cells);
+  visitor("max_cell_edges", max_cell_edges);
+  visitor("cell_map_bytes", cell_map_bytes);
+  visitor("cell_bytes", cell_bytes);
+  visitor("clipped_shape_bytes", clipped_shape_bytes);
+  visitor("edge_bytes", edge_bytes);
+  visitor("edge_run_bound_bytes", edge_run_bound_bytes);
+  visitor("shape_bytes", shape_bytes);
+  visitor("total_bytes", total_bytes);
+}
+
+namespace S2 {
+
+S2ShapeIndexStats GetIndexStats(const S2ShapeIndex& index) {
+  const auto* mutable_index = dynamic_cast<const MutableS2ShapeIndex*>(&index);
+  S2ShapeIndexStats stats;
+  stats.num_shape_ids = index.num_shape_ids();
+  for (const S2Shape* shape : index) {
+    if (shape == nullptr) continue;
+    ++stats.num_shapes;
+    stats.num_shape_edges += shape->num_edges();
+  }
+  // Iterating over the index applies any pending updates, so we do this
+  // before measuring the memory used by the index.
+  for (S2ShapeIndex::Iterator it(&index, S2ShapeIndex::BEGIN); !it.done();
+       it.Next()) {
+    const S2ShapeIndexCell& cell = it.cell();
+    const int level = it.id().level();
+    ++stats.num_cells;
+    ++stats.num_cells_per_level[level];
+    stats.num_clipped_shapes += cell.num_clipped();
+    int num_edges = 0;
+    for (const S2ClippedShape& clipped : cell.clipped_shapes()) {
+      num_edges += clipped.num_edges();
+      stats.num_contains_center += clipped.contains_center();
+      const S2Shape* shape = index.shape(clipped.shape_id());
+      for (int i = 0; i < clipped.num_edges(); ++i) {
+        S2Shape::Edge edge = shape->edge(clipped.edge(i));
+        stats.num_long_edges +=
+            (level >= S2Stats::GetEdgeMaxLevel(mutable_index, edge));
+      }
+    }
+    stats.num_clipped_edges += num_edges;
+    stats.num_interior_cells += (num_edges == 0);
+    if (num_edges > stats.max_cell_edges) {
+      stats.max_cell_edges = num_edges;
+      stats.max_cell_edges_id = it.id();
+    }
+    AddToHistogram(num_edges, &stats.cell_edges_histogram);
+    AddToHistogram(cell.num_clipped(), &stats.cell_clipped_shapes_histogram);
+    S2Stats::AddCellMemory(cell, &stats);
+  }
+  stats.cell_bytes = stats.num_cells * sizeof(S2ShapeIndexCell);
+  S2Stats::AddIndexMemory(index, mutable_index, &stats);
+  stats.total_bytes = index.SpaceUsed();
+  return stats;
+}
+
+}  // namespace S2
@@ -0,0 +1,110 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2SHAPE_INDEX_STATS_H_
+#define S2_S2SHAPE_INDEX_STATS_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "s2/base/types.h"
+#include "absl/functional/function_ref.h"
+#include "absl/strings/string_view.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2shape_index.h"
+
+// Statistics about the structure of an S2ShapeIndex, intended for capacity
+// planning and for finding out why some queries are much slower than others
+// (e.g., because of index cells that contain many edges).  For example:
+//
+//   S2ShapeIndexStats stats = S2::GetIndexStats(index);
+//   ABSL_LOG(INFO) << "Largest cell: " << stats.max_cell_edges << " edges at "
+//                  << stats.max_cell_edges_id;
+//
+// Histograms use power-of-two buckets: bucket 0 counts the cells where the
+// value is zero, and bucket k > 0 counts the cells where the value is in the
+// range [2**(k-1), 2**k).  They are trimmed so that the last bucket is
+// non-empty.
+struct S2ShapeIndexStats {
+  // The number of non-null shapes and the total number of shape ids (see
+  // S2ShapeIndex::num_shape_ids), and the total number of edges in all
+  // shapes.
+  int num_shapes = 0;
+  int num_shape_ids = 0;
+  int64 num_shape_edges = 0;
+
+  // The number of index cells, and the number of cells at each level.
+  int64 num_cells = 0;
+  int64 num_cells_per_level[S2CellId::kMaxLevel + 1] = {};
+
+  // The total number of clipped shapes and clipped edges in all cells.  An
+  // edge is counted once for each cell that it intersects.
+  int64 num_clipped_shapes = 0;
+  int64 num_clipped_edges = 0;
+
+  // The number of clipped edges that are "long" relative to the size of
+  // their cell and therefore do not count towards the limit on the number of
+  // edges per cell (see MutableS2ShapeIndex::Options::max_edges_per_cell).
+  // For indexes other than MutableS2ShapeIndex, edges are classified using
+  // the current value of --s2shape_index_cell_size_to_long_edge_ratio.
+  int64 num_long_edges = 0;
+
+  // The number of clipped shapes whose shape contains the cell center, and
+  // the number of cells that do not contain any edges (i.e., cells that are
+  // entirely in the interior of all their clipped shapes).
+  int64 num_contains_center = 0;
+  int64 num_interior_cells = 0;
+
+  // The maximum number of edges in any cell, and the id of the first cell
+  // with that many edges.  Cells with many edges make queries slower.
+  int max_cell_edges = 0;
+  S2CellId max_cell_edges_id = S2CellId::None();
+
+  // Histograms of the number of edges and clipped shapes per cell.
+  std::vector<int64> cell_edges_histogram;
+  std::vector<int64> cell_clipped_shapes_histogram;
+
+  // An approximate breakdown of the memory used by the index.  The cell
+  // fields describe the decoded cells, which for indexes that decode cells
+  // lazily (such as EncodedS2ShapeIndex) includes cells that have not been
+  // decoded yet.  "cell_map_bytes" is only computed for MutableS2ShapeIndex.
+  // The memory owned by the shapes themselves is not included.
+  size_t cell_map_bytes = 0;        // The map from S2CellId to cell.
+  size_t cell_bytes = 0;            // The S2ShapeIndexCell objects.
+  size_t clipped_shape_bytes = 0;   // The S2ClippedShape arrays.
+  size_t edge_bytes = 0;            // Edge ids not stored inline.
+  size_t edge_run_bound_bytes = 0;  // See S2ShapeIndexCell::edge_run_bounds.
+  size_t shape_bytes = 0;           // The index's vector of shapes.
+  size_t total_bytes = 0;           // S2ShapeIndex::SpaceUsed().
+
+  // Calls "visitor(name, value)" for each scalar statistic above, where
+  // "name" is the field name without any "num_" prefix.  The per-level
+  // counts and histograms are not included.
+  void VisitCounters(
+      absl::FunctionRef<void(absl::string_view, int64)> visitor) const;
+};
+
+namespace S2 {
+
+// Returns statistics about the given index.  This method visits every cell
+// of the index, and also every edge that intersects a cell (in order to
+// classify long edges), so it takes time proportional to the size of the
+// index.  Note that for indexes that decode cells lazily (such as
+// EncodedS2ShapeIndex), this causes every cell and shape to be decoded.
+S2ShapeIndexStats GetIndexStats(const S2ShapeIndex& index);
+
+}  // namespace S2
+
+#endif  // S2_S2SHAPE_INDEX_STATS_H_
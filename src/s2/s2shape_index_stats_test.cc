@@ -0,0 +1,134 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2shape_index_stats.h"
+
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/match.h"
+#include "absl/strings/string_view.h"
+#include "s2/util/coding/coder.h"
+#include "s2/encoded_s2shape_index.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2fractal.h"
+#include "s2/s2loop.h"
+#include "s2/s2shapeutil_coding.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+
+using std::make_unique;
+using std::string;
+using std::vector;
+
+namespace {
+
+int64 Sum(const vector<int64>& values) {
+  return std::accumulate(values.begin(), values.end(), int64{0});
+}
+
+TEST(GetIndexStats, EmptyIndex) {
+  MutableS2ShapeIndex index;
+  S2ShapeIndexStats stats = S2::GetIndexStats(index);
+  EXPECT_EQ(stats.num_shapes, 0);
+  EXPECT_EQ(stats.num_cells, 0);
+  EXPECT_EQ(stats.max_cell_edges_id, S2CellId::None());
+  EXPECT_TRUE(stats.cell_edges_histogram.empty());
+  EXPECT_EQ(stats.total_bytes, index.SpaceUsed());
+}
+
+TEST(GetIndexStats, SimpleIndex) {
+  auto index = s2textformat::MakeIndexOrDie(
+      "0:0 # 1:1, 2:2 # 0:0, 0:5, 5:0");
+  S2ShapeIndexStats stats = S2::GetIndexStats(*index);
+  EXPECT_EQ(stats.num_shapes, 3);
+  EXPECT_EQ(stats.num_shape_ids, 3);
+  EXPECT_EQ(stats.num_shape_edges, 1 + 1 + 3);
+
+  // The index is small enough that every shape is in a single cell.
+  ASSERT_EQ(stats.num_cells, 1);
+  EXPECT_EQ(stats.num_clipped_shapes, 3);
+  EXPECT_EQ(stats.num_clipped_edges, 5);
+  EXPECT_EQ(stats.max_cell_edges, 5);
+  MutableS2ShapeIndex::Iterator it(index.get(), S2ShapeIndex::BEGIN);
+  EXPECT_EQ(stats.max_cell_edges_id, it.id());
+  EXPECT_EQ(stats.num_cells_per_level[it.id().level()], 1);
+  EXPECT_EQ(stats.num_interior_cells, 0);
+  EXPECT_EQ(stats.cell_edges_histogram, (vector<int64>{0, 0, 0, 1}));
+  EXPECT_EQ(stats.cell_clipped_shapes_histogram, (vector<int64>{0, 0, 1}));
+  EXPECT_EQ(stats.total_bytes, index->SpaceUsed());
+  EXPECT_GT(stats.cell_map_bytes, 0);
+  EXPECT_GT(stats.edge_bytes, 0);  // The polygon has 3 edges.
+}
+
+TEST(GetIndexStats, FractalLoop) {
+  S2Testing::rnd.Reset(1);
+  S2Fractal fractal;
+  fractal.SetLevelForApproxMaxEdges(3000);
+  MutableS2ShapeIndex index;
+  index.Add(make_unique<S2Loop::OwningShape>(fractal.MakeLoop(
+      S2Testing::GetRandomFrameAt(S2Testing::RandomPoint()),
+      S1Angle::Degrees(10))));
+  S2ShapeIndexStats stats = S2::GetIndexStats(index);
+  EXPECT_GT(stats.num_cells, 1);
+  EXPECT_EQ(Sum(vector<int64>(std::begin(stats.num_cells_per_level),
+                              std::end(stats.num_cells_per_level))),
+            stats.num_cells);
+  EXPECT_EQ(Sum(stats.cell_edges_histogram), stats.num_cells);
+  EXPECT_EQ(Sum(stats.cell_clipped_shapes_histogram), stats.num_cells);
+  EXPECT_EQ(stats.cell_edges_histogram[0], stats.num_interior_cells);
+  EXPECT_GT(stats.num_interior_cells, 0);
+  EXPECT_GE(stats.num_clipped_edges, stats.num_shape_edges);
+  EXPECT_LE(stats.num_long_edges, stats.num_clipped_edges);
+  EXPECT_GT(stats.num_contains_center, 0);
+  EXPECT_EQ(stats.cell_bytes, stats.num_cells * sizeof(S2ShapeIndexCell));
+}
+
+TEST(GetIndexStats, EncodedIndexMatchesMutableIndex) {
+  auto index = s2textformat::MakeIndexOrDie(
+      "0:0 | 1:1 # 1:1, 2:2, 3:3 # 0:0, 0:5, 5:5, 5:0; 1:1, 1:4, 4:4");
+  Encoder encoder;
+  s2shapeutil::CompactEncodeTaggedShapes(*index, &encoder);
+  index->Encode(&encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  EncodedS2ShapeIndex encoded;
+  ASSERT_TRUE(encoded.Init(&decoder,
+                           s2shapeutil::LazyDecodeShapeFactory(&decoder)));
+
+  S2ShapeIndexStats expected = S2::GetIndexStats(*index);
+  S2ShapeIndexStats actual = S2::GetIndexStats(encoded);
+  absl::flat_hash_map<string, int64> expected_counters;
+  expected.VisitCounters([&](absl::string_view name, int64 value) {
+    expected_counters[name] = value;
+  });
+  actual.VisitCounters([&](absl::string_view name, int64 value) {
+    // The memory breakdown depends on the type of index.
+    if (absl::EndsWith(name, "bytes")) return;
+    EXPECT_EQ(value, expected_counters[name]) << name;
+  });
+  EXPECT_EQ(actual.max_cell_edges_id, expected.max_cell_edges_id);
+  EXPECT_EQ(actual.cell_edges_histogram, expected.cell_edges_histogram);
+  EXPECT_EQ(actual.cell_map_bytes, 0);
+  EXPECT_EQ(actual.total_bytes, encoded.SpaceUsed());
+}
+
+}  // namespace
@@ -0,0 +1,481 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2shape_index_tiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/container/btree_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/log/absl_check.h"
+#include "absl/synchronization/mutex.h"
+#include "s2/base/executor.h"
+#include "s2/r2.h"
+#include "s2/r2rect.h"
+#include "s2/s2builder.h"
+#include "s2/s2builderutil_lax_polygon_layer.h"
+#include "s2/s2builderutil_s2point_vector_layer.h"
+#include "s2/s2builderutil_s2polyline_vector_layer.h"
+#include "s2/s2builderutil_snap_functions.h"
+#include "s2/s2cell.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2coords.h"
+#include "s2/s2edge_clipping.h"
+#include "s2/s2error.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2point.h"
+#include "s2/s2polyline.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+
+using s2builderutil::IdentitySnapFunction;
+using s2builderutil::LaxPolygonLayer;
+using s2builderutil::S2PointVectorLayer;
+using s2builderutil::S2PolylineVectorLayer;
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+using Options = S2ShapeIndexTiler::Options;
+using Tile = S2ShapeIndexTiler::Tile;
+
+Options::Options()
+    : snap_function_(make_unique<IdentitySnapFunction>(S1Angle::Zero())) {}
+
+Options::Options(const Options& options)
+    : tile_level_(options.tile_level_),
+      snap_function_(options.snap_function_->Clone()),
+      num_threads_(options.num_threads_),
+      executor_(options.executor_) {}
+
+Options& Options::operator=(const Options& options) {
+  tile_level_ = options.tile_level_;
+  snap_function_ = options.snap_function_->Clone();
+  num_threads_ = options.num_threads_;
+  executor_ = options.executor_;
+  return *this;
+}
+
+int Options::tile_level() const { return tile_level_; }
+
+void Options::set_tile_level(int tile_level) {
+  ABSL_DCHECK_GE(tile_level, 0);
+  ABSL_DCHECK_LE(tile_level, S2CellId::kMaxLevel);
+  tile_level_ = tile_level;
+}
+
+const S2Builder::SnapFunction& Options::snap_function() const {
+  return *snap_function_;
+}
+
+void Options::set_snap_function(const S2Builder::SnapFunction& snap_function) {
+  snap_function_ = snap_function.Clone();
+}
+
+int Options::num_threads() const { return num_threads_; }
+
+void Options::set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
+s2base::Executor* Options::executor() const { return executor_; }
+
+void Options::set_executor(s2base::Executor* executor) {
+  executor_ = executor;
+}
+
+// TileClipper holds the state used to clip tiles on one thread.
+class S2ShapeIndexTiler::TileClipper {
+ public:
+  explicit TileClipper(const S2ShapeIndexTiler& tiler)
+      : tiler_(tiler), it_(tiler.index_), query_(tiler.index_) {}
+
+  bool ClipTile(S2CellId id, Tile* tile, S2Error* error);
+
+ private:
+  // A point where the clipped boundary of a polygon meets a side of the
+  // tile.  "t" is the distance from the start of the side in (u,v)-space.
+  struct BoundaryPoint {
+    double t;
+    bool is_corner;
+    R2Point uv;
+    S2Point point;
+
+    bool operator<(const BoundaryPoint& other) const {
+      // At equal positions, points from the polygon boundary sort first so
+      // that they are the ones kept (see AddTileBoundary).
+      if (t != other.t) return t < other.t;
+      return is_corner < other.is_corner;
+    }
+  };
+
+  // A polygon edge that lies along a side of the tile, from "t0" to "t1".
+  struct BoundaryEdge {
+    double t0, t1;
+  };
+
+  // The output of the S2Builder layer for one shape.
+  struct LayerOutput {
+    vector<S2Point> points;
+    vector<unique_ptr<S2Polyline>> polylines;
+    S2LaxPolygonShape polygon;
+  };
+
+  // Sets candidates_ to the edges of each shape that may intersect the
+  // tile.  Polygons that contain the tile but have no edges near it map to
+  // an empty edge vector.
+  void GetCandidates(S2CellId id);
+
+  // Clips the given edges of a polyline or polygon to the tile and adds them
+  // to "builder".  The points where polygon edges meet the tile boundary are
+  // added to boundary_.
+  void AddClippedEdges(const S2Shape& shape, const vector<int>& edges,
+                       S2Builder* builder);
+
+  // Returns the vertex to use for an endpoint "v" of an edge whose clipped
+  // endpoint is "uv", and updates "uv" to be the (u,v) coordinates of the
+  // result.  Vertices inside clip_rect_ are kept exactly, which ensures that
+  // adjacent edges are connected; all other endpoints are moved exactly
+  // onto the tile boundary.
+  S2Point GetClippedVertex(const S2Point& v, R2Point* uv) const;
+
+  // Returns a bit mask of the sides of the tile that "uv" lies on.
+  int GetSides(const R2Point& uv) const;
+
+  // Returns the distance of "uv" from the start of side "k".
+  double GetSideDistance(int k, const R2Point& uv) const;
+
+  // Adds "point" to boundary_ for every side of the tile that it lies on.
+  void AddBoundaryPoint(const R2Point& uv, const S2Point& point);
+
+  // Adds the portions of the tile boundary that are contained by the given
+  // polygon to "builder", oriented so that they close the loops formed by
+  // the clipped polygon edges.
+  void AddTileBoundary(int shape_id, S2Builder* builder);
+
+  const S2ShapeIndexTiler& tiler_;
+  S2ShapeIndex::Iterator it_;
+  S2ContainsPointQuery<S2ShapeIndex> query_;
+
+  // Vertices within this distance of the tile boundary in (u,v)-space are
+  // treated as being on the boundary.  This allows polygons whose edges
+  // follow tile boundaries (e.g. S2CellUnion borders) to be clipped exactly,
+  // even though the (u,v)-coordinates of their vertices are not exact.
+  static constexpr double kBoundaryTolerance = 2 * S2::kFaceClipErrorUVCoord;
+
+  // The tile being clipped, and its (u,v)-bound expanded by
+  // kBoundaryTolerance.
+  int face_;
+  R2Rect rect_, clip_rect_;
+  S2Point vertices_[4];
+
+  absl::btree_map<int, vector<int>> candidates_;
+  vector<BoundaryPoint> boundary_[4];
+  vector<BoundaryEdge> boundary_edges_[4];
+};
+
+void S2ShapeIndexTiler::TileClipper::GetCandidates(S2CellId id) {
+  candidates_.clear();
+  S2CellRelation r = it_.Locate(id);
+  if (r == S2CellRelation::INDEXED) {
+    const S2ShapeIndexCell& cell = it_.cell();
+    for (int i = 0; i < cell.num_clipped(); ++i) {
+      const S2ClippedShape& clipped = cell.clipped(i);
+      vector<int>& edges = candidates_[clipped.shape_id()];
+      for (int j = 0; j < clipped.num_edges(); ++j) {
+        edges.push_back(clipped.edge(j));
+      }
+    }
+  } else if (r == S2CellRelation::SUBDIVIDED) {
+    // Several index cells are contained by the tile, and an edge may belong
+    // to more than one of them.
+    for (S2CellId end = id.range_max(); !it_.done() && it_.id() <= end;
+         it_.Next()) {
+      const S2ShapeIndexCell& cell = it_.cell();
+      for (int i = 0; i < cell.num_clipped(); ++i) {
+        const S2ClippedShape& clipped = cell.clipped(i);
+        vector<int>& edges = candidates_[clipped.shape_id()];
+        for (int j = 0; j < clipped.num_edges(); ++j) {
+          edges.push_back(clipped.edge(j));
+        }
+      }
+    }
+    for (auto& [shape_id, edges] : candidates_) {
+      std::sort(edges.begin(), edges.end());
+      edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    }
+  }
+}
+
+S2Point S2ShapeIndexTiler::TileClipper::GetClippedVertex(const S2Point& v,
+                                                         R2Point* uv) const {
+  R2Point v_uv;
+  const bool keep_vertex =
+      S2::FaceXYZtoUV(face_, v, &v_uv) && clip_rect_.Contains(v_uv);
+  R2Point& p = *uv;
+  if (keep_vertex) p = v_uv;
+
+  // Move points within kBoundaryTolerance of a side exactly onto it.  This
+  // includes all endpoints clipped by ClipEdge(), since these are on the
+  // boundary of clip_rect_.
+  for (int d = 0; d < 2; ++d) {
+    if (p[d] <= rect_[d][0] + kBoundaryTolerance) {
+      p[d] = rect_[d][0];
+    } else if (p[d] >= rect_[d][1] - kBoundaryTolerance) {
+      p[d] = rect_[d][1];
+    }
+  }
+  if (keep_vertex) return v;
+  return S2::FaceUVtoXYZ(face_, p).Normalize();
+}
+
+// Side k of the tile goes from vertex k to vertex k+1, which means that the
+// sides are (v = lo), (u = hi), (v = hi), and (u = lo) respectively.
+int S2ShapeIndexTiler::TileClipper::GetSides(const R2Point& uv) const {
+  return (uv[1] == rect_[1][0]) | (uv[0] == rect_[0][1]) << 1 |
+         (uv[1] == rect_[1][1]) << 2 | (uv[0] == rect_[0][0]) << 3;
+}
+
+double S2ShapeIndexTiler::TileClipper::GetSideDistance(
+    int k, const R2Point& uv) const {
+  switch (k) {
+    case 0: return uv[0] - rect_[0][0];
+    case 1: return uv[1] - rect_[1][0];
+    case 2: return rect_[0][1] - uv[0];
+    default: return rect_[1][1] - uv[1];
+  }
+}
+
+void S2ShapeIndexTiler::TileClipper::AddBoundaryPoint(const R2Point& uv,
+                                                      const S2Point& point) {
+  const int sides = GetSides(uv);
+  for (int k = 0; k < 4; ++k) {
+    if (sides & (1 << k)) {
+      boundary_[k].push_back({GetSideDistance(k, uv), false, uv, point});
+    }
+  }
+}
+
+void S2ShapeIndexTiler::TileClipper::AddClippedEdges(const S2Shape& shape,
+                                                     const vector<int>& edges,
+                                                     S2Builder* builder) {
+  const bool is_polygon = shape.dimension() == 2;
+  for (int e : edges) {
+    S2Shape::Edge edge = shape.edge(e);
+    R2Point a_uv, b_uv, a_clipped, b_clipped;
+    if (!S2::ClipToPaddedFace(edge.v0, edge.v1, face_, 0.0, &a_uv, &b_uv) ||
+        !S2::ClipEdge(a_uv, b_uv, clip_rect_, &a_clipped, &b_clipped)) {
+      continue;
+    }
+    S2Point a = GetClippedVertex(edge.v0, &a_clipped);
+    S2Point b = GetClippedVertex(edge.v1, &b_clipped);
+    if (!is_polygon) {
+      builder->AddEdge(a, b);
+      continue;
+    }
+    AddBoundaryPoint(a_clipped, a);
+    AddBoundaryPoint(b_clipped, b);
+
+    // Polygon edges that lie along the tile boundary are not added, since
+    // the tile boundary is added separately (see AddTileBoundary).
+    const int sides = GetSides(a_clipped) & GetSides(b_clipped);
+    if (sides == 0) {
+      builder->AddEdge(a, b);
+    } else if (a != b) {
+      for (int k = 0; k < 4; ++k) {
+        if (sides & (1 << k)) {
+          boundary_edges_[k].push_back({GetSideDistance(k, a_clipped),
+                                        GetSideDistance(k, b_clipped)});
+        }
+      }
+    }
+  }
+}
+
+void S2ShapeIndexTiler::TileClipper::AddTileBoundary(int shape_id,
+                                                     S2Builder* builder) {
+  for (int k = 0; k < 4; ++k) {
+    vector<BoundaryPoint>& points = boundary_[k];
+    const R2Point start = rect_.GetVertex(k), end = rect_.GetVertex(k + 1);
+    points.push_back({0.0, true, start, vertices_[k]});
+    points.push_back({(end - start).Norm(), true, end, vertices_[(k + 1) & 3]});
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end(),
+                             [](const BoundaryPoint& x,
+                                const BoundaryPoint& y) { return x.t == y.t; }),
+                 points.end());
+
+    // Each portion of the side between two consecutive boundary points is
+    // either entirely inside or entirely outside the polygon.  If it is
+    // covered by a polygon edge then it is inside exactly when the polygon
+    // interior (which is to the left of the edge) is inside the tile;
+    // otherwise we test whether the polygon contains its midpoint.
+    for (int i = 0; i + 1 < points.size(); ++i) {
+      const BoundaryPoint& p = points[i];
+      const BoundaryPoint& q = points[i + 1];
+      int inside = -1;
+      for (const BoundaryEdge& edge : boundary_edges_[k]) {
+        if (std::min(edge.t0, edge.t1) <= p.t &&
+            q.t <= std::max(edge.t0, edge.t1)) {
+          inside = edge.t0 < edge.t1;
+          break;
+        }
+      }
+      if (inside < 0) {
+        S2Point mid = S2::FaceUVtoXYZ(face_, 0.5 * (p.uv + q.uv)).Normalize();
+        inside = query_.ShapeContains(shape_id, mid);
+      }
+      if (inside) builder->AddEdge(p.point, q.point);
+    }
+  }
+}
+
+bool S2ShapeIndexTiler::TileClipper::ClipTile(S2CellId id, Tile* tile,
+                                              S2Error* error) {
+  ABSL_DCHECK_EQ(id.level(), tiler_.options_.tile_level());
+  tile->id = id;
+  tile->shapes.clear();
+  GetCandidates(id);
+  if (candidates_.empty()) return true;
+
+  S2Cell cell(id);
+  face_ = cell.face();
+  rect_ = cell.GetBoundUV();
+  clip_rect_ = rect_.Expanded(kBoundaryTolerance);
+  for (int k = 0; k < 4; ++k) vertices_[k] = cell.GetVertex(k);
+
+  S2Builder builder{S2Builder::Options(tiler_.options_.snap_function())};
+  vector<LayerOutput> outputs(candidates_.size());
+  int i = 0;
+  for (const auto& [shape_id, edges] : candidates_) {
+    const S2Shape& shape = *tiler_.index_->shape(shape_id);
+    LayerOutput& output = outputs[i++];
+    switch (shape.dimension()) {
+      case 0:
+        builder.StartLayer(make_unique<S2PointVectorLayer>(&output.points));
+        for (int e : edges) {
+          const S2Point& p = shape.edge(e).v0;
+          if (id.contains(S2CellId(p))) builder.AddPoint(p);
+        }
+        break;
+
+      case 1:
+        builder.StartLayer(
+            make_unique<S2PolylineVectorLayer>(&output.polylines));
+        AddClippedEdges(shape, edges, &builder);
+        break;
+
+      default:
+        builder.StartLayer(make_unique<LaxPolygonLayer>(&output.polygon));
+        builder.AddIsFullPolygonPredicate(S2Builder::IsFullPolygon(false));
+        if (edges.empty()) {
+          // The polygon contains the entire tile.
+          for (int k = 0; k < 4; ++k) {
+            builder.AddEdge(vertices_[k], vertices_[(k + 1) & 3]);
+          }
+          break;
+        }
+        for (int k = 0; k < 4; ++k) {
+          boundary_[k].clear();
+          boundary_edges_[k].clear();
+        }
+        AddClippedEdges(shape, edges, &builder);
+        AddTileBoundary(shape_id, &builder);
+        break;
+    }
+  }
+  if (!builder.Build(error)) return false;
+
+  i = 0;
+  for (const auto& [shape_id, edges] : candidates_) {
+    const int dimension = tiler_.index_->shape(shape_id)->dimension();
+    const LayerOutput& output = outputs[i++];
+    ClippedShape clipped{shape_id, dimension, {}};
+    for (const S2Point& p : output.points) clipped.chains.push_back({p});
+    for (const auto& polyline : output.polylines) {
+      clipped.chains.emplace_back(polyline->vertices_span().begin(),
+                                  polyline->vertices_span().end());
+    }
+    for (int j = 0; j < output.polygon.num_loops(); ++j) {
+      vector<S2Point>& loop = clipped.chains.emplace_back();
+      for (int k = 0; k < output.polygon.num_loop_vertices(j); ++k) {
+        loop.push_back(output.polygon.loop_vertex(j, k));
+      }
+    }
+    if (!clipped.chains.empty()) tile->shapes.push_back(std::move(clipped));
+  }
+  return true;
+}
+
+S2ShapeIndexTiler::S2ShapeIndexTiler(const S2ShapeIndex* index,
+                                     const Options& options)
+    : index_(index), options_(options) {}
+
+vector<S2CellId> S2ShapeIndexTiler::GetTileIds() const {
+  const int level = options_.tile_level();
+  vector<S2CellId> ids;
+  for (S2ShapeIndex::Iterator it(index_, S2ShapeIndex::BEGIN); !it.done();
+       it.Next()) {
+    S2CellId id = it.id();
+    if (id.level() >= level) {
+      S2CellId tile = id.parent(level);
+      if (ids.empty() || ids.back() != tile) ids.push_back(tile);
+    } else {
+      for (S2CellId tile = id.child_begin(level); tile != id.child_end(level);
+           tile = tile.next()) {
+        ids.push_back(tile);
+      }
+    }
+  }
+  return ids;
+}
+
+bool S2ShapeIndexTiler::ClipTile(S2CellId id, Tile* tile,
+                                 S2Error* error) const {
+  error->Clear();
+  TileClipper clipper(*this);
+  return clipper.ClipTile(id, tile, error);
+}
+
+bool S2ShapeIndexTiler::VisitTiles(absl::FunctionRef<void(const Tile&)> visitor,
+                                   S2Error* error) const {
+  error->Clear();
+  const vector<S2CellId> ids = GetTileIds();
+  const int num_tiles = ids.size();
+  std::atomic<int> next_tile(0);
+  std::atomic<bool> failed(false);
+  absl::Mutex error_mutex;
+  s2base::RunConcurrently(
+      options_.executor(),
+      std::min(options_.num_threads(), std::max(num_tiles, 1)), [&]() {
+        TileClipper clipper(*this);
+        Tile tile;
+        S2Error tile_error;
+        for (int i; !failed.load(std::memory_order_relaxed) &&
+                    (i = next_tile.fetch_add(1)) < num_tiles;) {
+          if (!clipper.ClipTile(ids[i], &tile, &tile_error)) {
+            absl::MutexLock lock(&error_mutex);
+            if (!failed.exchange(true)) *error = tile_error;
+            return;
+          }
+          visitor(tile);
+        }
+      });
+  return error->ok();
+}
@@ -0,0 +1,159 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2SHAPE_INDEX_TILER_H_
+#define S2_S2SHAPE_INDEX_TILER_H_
+
+#include <memory>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "s2/base/executor.h"
+#include "s2/s2builder.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2error.h"
+#include "s2/s2point.h"
+#include "s2/s2shape_index.h"
+
+// S2ShapeIndexTiler clips the geometry of an S2ShapeIndex to the S2Cells of
+// a fixed level ("tiles"), e.g. in order to generate vector tiles.  This is
+// equivalent to intersecting every shape with S2Polygon(S2Cell(tile)) for
+// every tile, but is much faster: the candidate edges of each tile are found
+// using the cells of the index, each edge is clipped to the tile in (u,v)
+// coordinates using the s2edge_clipping functions, and polygon boundaries
+// are closed by walking along the tile boundary.  Tiles are clipped in
+// parallel, and each tile is assembled (and optionally snapped) using a
+// single S2Builder.
+//
+// Example usage:
+//
+//   S2ShapeIndexTiler::Options options;
+//   options.set_tile_level(12);
+//   options.set_num_threads(8);
+//   S2ShapeIndexTiler tiler(&index, options);
+//   S2Error error;
+//   absl::Mutex mutex;
+//   tiler.VisitTiles([&](const S2ShapeIndexTiler::Tile& tile) {
+//     absl::MutexLock lock(&mutex);
+//     WriteTile(tile);
+//   }, &error);
+//
+// Each clipped polygon is the closure of the intersection of the polygon
+// interior with the tile, so polygon edges that lie along a tile boundary
+// are kept only by the tile on their interior side.  The index must not be
+// modified while the tiler is in use.
+class S2ShapeIndexTiler {
+ public:
+  class Options {
+   public:
+    Options();
+
+    // The S2Cell level of the tiles.
+    //
+    // DEFAULT: 10
+    int tile_level() const;
+    void set_tile_level(int tile_level);
+
+    // The snap function used to assemble each tile.  The clipped geometry of
+    // each tile is snapped independently, so vertices on the boundary
+    // between two tiles may snap differently unless the snap function is an
+    // S2CellIdSnapFunction at a level of at least tile_level().
+    //
+    // DEFAULT: s2builderutil::IdentitySnapFunction(S1Angle::Zero())
+    //  - This does no snapping and preserves all input vertices exactly.
+    const S2Builder::SnapFunction& snap_function() const;
+    void set_snap_function(const S2Builder::SnapFunction& snap_function);
+
+    // The maximum number of threads used by VisitTiles().
+    //
+    // DEFAULT: 1
+    int num_threads() const;
+    void set_num_threads(int num_threads);
+
+    // If non-null, the additional threads requested by num_threads() are
+    // run as tasks on this executor (see s2base::RunConcurrently).
+    //
+    // DEFAULT: nullptr
+    s2base::Executor* executor() const;
+    void set_executor(s2base::Executor* executor);
+
+    // Options are copyable.
+    Options(const Options& options);
+    Options& operator=(const Options& options);
+
+   private:
+    int tile_level_ = 10;
+    std::unique_ptr<S2Builder::SnapFunction> snap_function_;
+    int num_threads_ = 1;
+    s2base::Executor* executor_ = nullptr;
+  };
+
+  // The portion of one input shape that intersects a tile.
+  struct ClippedShape {
+    // The id of the input shape.
+    int shape_id;
+
+    // The dimension of the input shape.
+    int dimension;
+
+    // The clipped geometry, in the same form as the chains of an S2Shape of
+    // the given dimension: one single-vertex chain per point, one chain per
+    // polyline, or one chain per polygon loop (so that an S2LaxPolygonShape
+    // can be constructed directly from "chains").
+    std::vector<std::vector<S2Point>> chains;
+  };
+
+  struct Tile {
+    S2CellId id;
+
+    // The shapes that intersect this tile, in increasing order of shape id.
+    // Shapes whose clipped geometry is empty (e.g. after snapping) are
+    // omitted.
+    std::vector<ClippedShape> shapes;
+  };
+
+  // REQUIRES: "index" is not modified while this object is in use.
+  explicit S2ShapeIndexTiler(const S2ShapeIndex* index,
+                             const Options& options = Options());
+
+  const S2ShapeIndex& index() const { return *index_; }
+  const Options& options() const { return options_; }
+
+  // Returns the tiles that intersect at least one index cell, in increasing
+  // order.  Note that a large polygon at a low level may intersect a very
+  // large number of tiles.
+  std::vector<S2CellId> GetTileIds() const;
+
+  // Clips the index to the given tile (which must be at tile_level()).
+  // Returns false and sets "error" if the clipped geometry could not be
+  // assembled.  This method is thread-safe.
+  bool ClipTile(S2CellId id, Tile* tile, S2Error* error) const;
+
+  // Clips the index to each tile returned by GetTileIds() and calls "visitor"
+  // with the result.  Tiles are clipped using up to num_threads() threads,
+  // and "visitor" may be called concurrently from any of them.  Returns false
+  // and sets "error" if any tile could not be clipped, in which case the
+  // remaining tiles may not be visited.
+  bool VisitTiles(absl::FunctionRef<void(const Tile&)> visitor,
+                  S2Error* error) const;
+
+ private:
+  class TileClipper;
+
+  const S2ShapeIndex* index_;
+  Options options_;
+};
+
+#endif  // S2_S2SHAPE_INDEX_TILER_H_
@@ -0,0 +1,213 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2shape_index_tiler.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/container/btree_map.h"
+#include "absl/container/btree_set.h"
+#include "absl/synchronization/mutex.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2builderutil_snap_functions.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2error.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2loop.h"
+#include "s2/s2point.h"
+#include "s2/s2point_vector_shape.h"
+#include "s2/s2polygon.h"
+#include "s2/s2polyline.h"
+#include "s2/s2region_coverer.h"
+#include "s2/s2shape_measures.h"
+#include "s2/s2shapeutil_contains_brute_force.h"
+#include "s2/s2testing.h"
+
+using std::make_unique;
+using std::vector;
+
+namespace {
+
+using Tile = S2ShapeIndexTiler::Tile;
+
+// Clips "index" to tiles at the given level and returns the tiles by id.
+absl::btree_map<S2CellId, Tile> GetTiles(
+    const S2ShapeIndex& index, S2ShapeIndexTiler::Options options) {
+  S2ShapeIndexTiler tiler(&index, options);
+  absl::btree_map<S2CellId, Tile> tiles;
+  absl::Mutex mutex;
+  S2Error error;
+  EXPECT_TRUE(tiler.VisitTiles(
+      [&](const Tile& tile) {
+        absl::MutexLock lock(&mutex);
+        EXPECT_TRUE(tiles.emplace(tile.id, tile).second);
+      },
+      &error))
+      << error;
+  return tiles;
+}
+
+TEST(S2ShapeIndexTiler, EmptyIndex) {
+  MutableS2ShapeIndex index;
+  S2ShapeIndexTiler tiler(&index);
+  EXPECT_TRUE(tiler.GetTileIds().empty());
+  EXPECT_TRUE(GetTiles(index, S2ShapeIndexTiler::Options()).empty());
+}
+
+TEST(S2ShapeIndexTiler, PolygonMatchesIntersection) {
+  S2Testing::rnd.Reset(1);
+  const S2Point center = S2Testing::RandomPoint();
+  S2Polygon polygon(
+      S2Loop::MakeRegularLoop(center, S1Angle::Degrees(5), 200));
+  MutableS2ShapeIndex index;
+  index.Add(make_unique<S2LaxPolygonShape>(polygon));
+
+  S2ShapeIndexTiler::Options options;
+  options.set_tile_level(6);
+  options.set_num_threads(3);
+  auto tiles = GetTiles(index, options);
+  ASSERT_GT(tiles.size(), 10);
+
+  double total_area = 0;
+  for (const auto& [id, tile] : tiles) {
+    S2Polygon expected;
+    expected.InitToIntersection(polygon, S2Polygon(S2Cell(id)));
+    if (tile.shapes.empty()) {
+      EXPECT_LT(expected.GetArea(), 1e-15) << id;
+      continue;
+    }
+    ASSERT_EQ(tile.shapes.size(), 1);
+    EXPECT_EQ(tile.shapes[0].shape_id, 0);
+    EXPECT_EQ(tile.shapes[0].dimension, 2);
+    S2LaxPolygonShape clipped(tile.shapes[0].chains);
+    const double area = S2::GetArea(clipped);
+    EXPECT_NEAR(area, expected.GetArea(), 1e-14) << id;
+    total_area += area;
+
+    // Points of the tile are in the clipped polygon exactly when they are
+    // in the original polygon.
+    S2Cell cell(id);
+    for (int i = 0; i < 20; ++i) {
+      S2Point p = S2Testing::SamplePoint(cell.GetCapBound());
+      if (!cell.Contains(p)) continue;
+      EXPECT_EQ(s2shapeutil::ContainsBruteForce(clipped, p),
+                polygon.Contains(p));
+    }
+  }
+  EXPECT_NEAR(total_area, polygon.GetArea(), 1e-12);
+}
+
+TEST(S2ShapeIndexTiler, TileAlignedPolygon) {
+  // A polygon that is a union of tiles is clipped to exactly those tiles,
+  // even though its edges lie along the boundaries of neighboring tiles.
+  constexpr int kLevel = 8;
+  S2RegionCoverer coverer;
+  coverer.mutable_options()->set_fixed_level(kLevel);
+  S2CellUnion covering = coverer.GetCovering(
+      S2Cap(S2Point(1, 2, 3).Normalize(), S1Angle::Degrees(1)));
+  S2Polygon polygon;
+  polygon.InitToCellUnionBorder(covering);
+  MutableS2ShapeIndex index;
+  index.Add(make_unique<S2Polygon::Shape>(&polygon));
+
+  S2ShapeIndexTiler::Options options;
+  options.set_tile_level(kLevel);
+  auto tiles = GetTiles(index, options);
+  absl::btree_set<S2CellId> nonempty;
+  for (const auto& [id, tile] : tiles) {
+    if (tile.shapes.empty()) continue;
+    nonempty.insert(id);
+    S2LaxPolygonShape clipped(tile.shapes[0].chains);
+    EXPECT_NEAR(S2::GetArea(clipped), S2Cell(id).ExactArea(), 1e-15);
+  }
+  EXPECT_EQ(vector<S2CellId>(nonempty.begin(), nonempty.end()),
+            covering.cell_ids());
+}
+
+TEST(S2ShapeIndexTiler, PolylinesAndPoints) {
+  S2Testing::rnd.Reset(2);
+  const S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(3));
+  vector<S2Point> vertices, points;
+  for (int i = 0; i < 100; ++i) vertices.push_back(S2Testing::SamplePoint(cap));
+  for (int i = 0; i < 1000; ++i) points.push_back(S2Testing::SamplePoint(cap));
+  S2Polyline polyline(vertices);
+  MutableS2ShapeIndex index;
+  index.Add(make_unique<S2Polyline::Shape>(&polyline));
+  index.Add(make_unique<S2PointVectorShape>(points));
+
+  S2ShapeIndexTiler::Options options;
+  options.set_tile_level(7);
+  options.set_num_threads(4);
+  S1Angle length;
+  int num_points = 0;
+  for (const auto& [id, tile] : GetTiles(index, options)) {
+    S2Cell cell(id);
+    for (const auto& shape : tile.shapes) {
+      for (const vector<S2Point>& chain : shape.chains) {
+        if (shape.dimension == 0) {
+          ASSERT_EQ(chain.size(), 1);
+          EXPECT_TRUE(id.contains(S2CellId(chain[0])));
+          ++num_points;
+        } else {
+          length += S2Polyline(chain).GetLength();
+          for (const S2Point& v : chain) {
+            EXPECT_LT(cell.GetDistance(v), S1ChordAngle::Radians(1e-15));
+          }
+        }
+      }
+    }
+  }
+  EXPECT_EQ(num_points, points.size());
+  // Each clipped endpoint may be moved by a few multiples of DBL_EPSILON.
+  EXPECT_NEAR(length.radians(), polyline.GetLength().radians(), 1e-11);
+}
+
+TEST(S2ShapeIndexTiler, SnapFunction) {
+  S2Testing::rnd.Reset(3);
+  S2Polygon polygon(S2Loop::MakeRegularLoop(S2Testing::RandomPoint(),
+                                            S1Angle::Degrees(2), 50));
+  MutableS2ShapeIndex index;
+  index.Add(make_unique<S2LaxPolygonShape>(polygon));
+
+  constexpr int kSnapLevel = 20;
+  S2ShapeIndexTiler::Options options;
+  options.set_tile_level(7);
+  options.set_snap_function(
+      s2builderutil::S2CellIdSnapFunction(kSnapLevel));
+  S2ShapeIndexTiler tiler(&index, options);
+  int num_vertices = 0;
+  for (S2CellId id : tiler.GetTileIds()) {
+    Tile tile;
+    S2Error error;
+    ASSERT_TRUE(tiler.ClipTile(id, &tile, &error)) << error;
+    for (const auto& shape : tile.shapes) {
+      for (const vector<S2Point>& loop : shape.chains) {
+        for (const S2Point& v : loop) {
+          EXPECT_EQ(v, S2CellId(v).parent(kSnapLevel).ToPoint());
+          ++num_vertices;
+        }
+      }
+    }
+  }
+  EXPECT_GT(num_vertices, 50);
+}
+
+}  // namespace
@@ -22,12 +22,18 @@
 
 #include "s2/base/log_severity.h"
 #include "absl/log/absl_check.h"
+#include "s2/r1interval.h"
 #include "s2/s1angle.h"
+#include "s2/s1interval.h"
+#include "s2/s2latlng.h"
+#include "s2/s2latlng_rect.h"
+#include "s2/s2latlng_rect_bounder.h"
 #include "s2/s2loop_measures.h"
 #include "s2/s2point.h"
 #include "s2/s2point_span.h"
 #include "s2/s2polyline_measures.h"
 #include "s2/s2shape.h"
+#include "s2/s2shapeutil_contains_brute_force.h"
 
 using std::fabs;
 using std::vector;
@@ -137,6 +143,41 @@ S2Point GetCentroid(const S2Shape& shape) {
   return centroid;
 }
 
+S2LatLngRect GetRectBound(const S2Shape& shape) {
+  const int dimension = shape.dimension();
+  if (dimension == 2 && shape.is_full()) return S2LatLngRect::Full();
+  S2LatLngRect bound = S2LatLngRect::Empty();
+  vector<S2Point> vertices;
+  int num_chains = shape.num_chains();
+  for (int chain_id = 0; chain_id < num_chains; ++chain_id) {
+    if (dimension == 0) {
+      bound.AddPoint(S2LatLng(shape.edge(chain_id).v0));
+      continue;
+    }
+    GetChainVertices(shape, chain_id, &vertices);
+    if (vertices.empty()) continue;
+    S2LatLngRectBounder bounder;
+    bounder.AddPoints(vertices);
+    if (dimension == 2) bounder.AddPoint(vertices[0]);
+    bound = bound.Union(bounder.GetBound());
+  }
+  if (dimension == 2 && !bound.is_empty()) {
+    // As with S2Loop, the shape may contain one or both poles.  If it
+    // contains the south pole, then either the edges wrap entirely around
+    // the sphere or the shape also contains the north pole, so the second
+    // test is only needed when the longitude range is full.
+    if (s2shapeutil::ContainsBruteForce(shape, S2Point(0, 0, 1))) {
+      bound = S2LatLngRect(R1Interval(bound.lat().lo(), M_PI_2),
+                           S1Interval::Full());
+    }
+    if (bound.lng().is_full() &&
+        s2shapeutil::ContainsBruteForce(shape, S2Point(0, 0, -1))) {
+      bound.mutable_lat()->set_lo(-M_PI_2);
+    }
+  }
+  return bound;
+}
+
 void GetChainVertices(const S2Shape& shape, int chain_id,
                       vector<S2Point>* vertices) {
   S2Shape::Chain chain = shape.chain(chain_id);
@@ -25,6 +25,7 @@
 #include <vector>
 
 #include "s2/s1angle.h"
+#include "s2/s2latlng_rect.h"
 #include "s2/s2point.h"
 #include "s2/s2shape.h"
 
@@ -81,6 +82,13 @@ double GetApproxArea(const S2Shape& shape);
 // centroids of all shapes in the collection whose dimension is maximal.)
 S2Point GetCentroid(const S2Shape& shape);
 
+// Returns a bounding latitude-longitude rectangle for the shape, computed
+// using S2LatLngRectBounder.  For shapes of dimension 1 and 2 the bound
+// includes the interiors of all edges, and for shapes of dimension 2 it
+// satisfies the same guarantee as S2Loop::GetRectBound(), i.e. it contains
+// the S2LatLng coordinates of all points contained by the shape.
+S2LatLngRect GetRectBound(const S2Shape& shape);
+
 // Overwrites "vertices" with the vertices of the given edge chain of "shape".
 // If dimension == 1, the chain will have (chain.length + 1) vertices, and
 // otherwise it will have (chain.length) vertices.
@@ -32,11 +32,14 @@
 #include "s2/mutable_s2shape_index.h"
 #include "s2/s1angle.h"
 #include "s2/s2edge_vector_shape.h"
+#include "s2/s2latlng.h"
+#include "s2/s2latlng_rect.h"
 #include "s2/s2lax_polygon_shape.h"
 #include "s2/s2lax_polyline_shape.h"
 #include "s2/s2point.h"
 #include "s2/s2pointutil.h"
 #include "s2/s2polygon.h"
+#include "s2/s2polyline.h"
 #include "s2/s2text_format.h"
 
 using s2textformat::MakeIndexOrDie;
@@ -145,4 +148,40 @@ TEST(GetCentroid, Polygon) {
       S2::GetCentroid(*MakeLaxPolygonOrDie("0:0, 0:90, 90:0"))));
 }
 
+TEST(GetRectBound, EmptyAndFull) {
+  EXPECT_TRUE(S2::GetRectBound(*MakeLaxPolygonOrDie("empty")).is_empty());
+  EXPECT_TRUE(S2::GetRectBound(*MakeLaxPolygonOrDie("full")).is_full());
+  EXPECT_TRUE(S2::GetRectBound(*MakeLaxPolylineOrDie("")).is_empty());
+}
+
+TEST(GetRectBound, Points) {
+  EXPECT_EQ(S2LatLngRect(S2LatLng::FromDegrees(-10, 5),
+                         S2LatLng::FromDegrees(20, 30)),
+            S2::GetRectBound(*MakeIndexOrDie("-10:5 | 20:30 # #")->shape(0)));
+}
+
+TEST(GetRectBound, MatchesPolyline) {
+  const auto polyline = s2textformat::MakePolylineOrDie("0:0, 80:90, 0:180");
+  EXPECT_EQ(polyline->GetRectBound(),
+            S2::GetRectBound(S2Polyline::Shape(polyline.get())));
+}
+
+TEST(GetRectBound, MatchesPolygon) {
+  // These polygons include the north pole, the south pole, and (after
+  // inverting the last polygon) both poles.
+  for (const char* str : {"0:0, 0:1, 1:0; 80:0, 80:120, 80:-120",
+                          "-80:0, -80:-120, -80:120",
+                          "0:0, 0:1, 1:0"}) {
+    const auto polygon = MakePolygonOrDie(str);
+    EXPECT_EQ(polygon->GetRectBound(),
+              S2::GetRectBound(S2Polygon::Shape(polygon.get())))
+        << str;
+  }
+  const auto polygon = MakePolygonOrDie("0:0, 0:1, 1:0");
+  polygon->Invert();
+  const S2LatLngRect bound = S2::GetRectBound(S2Polygon::Shape(polygon.get()));
+  EXPECT_TRUE(bound.is_full());
+  EXPECT_EQ(polygon->GetRectBound(), bound);
+}
+
 }  // namespace
@@ -17,16 +17,15 @@
 #include "s2/s2shape_nesting_query.h"
 
 #include <algorithm>
+#include <atomic>
 #include <limits>
 #include <vector>
 
+#include "s2/base/executor.h"
 #include "s2/base/types.h"
-#include "absl/container/fixed_array.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
-#include "absl/log/absl_vlog_is_on.h"
-#include "absl/strings/str_format.h"
-#include "s2/util/bitmap/bitmap.h"
 #include "s2/s2crossing_edge_query.h"
 #include "s2/s2point.h"
 #include "s2/s2predicates.h"
@@ -36,7 +35,6 @@
 #include "s2/s2shapeutil_shape_edge_id.h"
 
 using std::vector;
-using util::bitmap::Bitmap64;
 
 // Takes N equally spaced points from the given chain of the shape and finds
 // the one closest to the target point, returning its index.
@@ -90,11 +88,124 @@ void S2ShapeNestingQuery::Init(const S2ShapeIndex* index,
   options_ = options;
 }
 
-// Finds three consecutive vertices that aren't degenerate and stores them in
-// the given array.  Returns false if there aren't three consecutive
-// non-degenerate points.
+namespace {
+
+// Returns the set of chains that are candidate parents of "chain" relative to
+// the datum shell, i.e. the chains that separate it from the datum shell.
+// This is determined by counting the edges of each chain that are crossed by
+// a line segment from "start_point" on the datum shell to a nearby vertex of
+// "chain".  "crossed" is used as scratch space.
+vector<int32> GetCandidateParents(const S2Shape& shape, int shape_id,
+                                  int chain, int datum_shell,
+                                  const S2Point (&vertices)[3],
+                                  S2CrossingEdgeQuery* crossing_query,
+                                  vector<s2shapeutil::ShapeEdge>* edges,
+                                  absl::flat_hash_set<int32>* crossed) {
+  ABSL_VLOG(1) << "Processing chain " << chain;
+  const S2Point& start_point = vertices[1];
+  auto toggle = [crossed](int32 id) {
+    if (!crossed->insert(id).second) crossed->erase(id);
+  };
+  crossed->clear();
+
+  // Find a close point on the target chain out of 4 equally spaced ones.
+  int end_idx = ClosestOfNPoints(start_point, shape, chain, 4);
+  S2Point end_point = shape.chain_edge(chain, end_idx).v0;
+
+  // We need to know whether we're inside the datum shell at the end, so we
+  // need to properly seed its starting state.  If we start by entering the
+  // datum shell's interior _and_ end by arriving from the target chain's
+  // interior, the datum shell is a candidate parent.
+  //
+  // As we cross edges from the datum to the target chain the total number of
+  // datum shell _or_ target chain edges we'll cross is either even or odd.
+  // Each of these edges toggles our "insideness" relative to the datum shell.
+  if (s2pred::OrderedCCW(vertices[2], end_point, vertices[0], start_point)) {
+    ABSL_VLOG(1) << "  Edge starts into interior of datum chain";
+    toggle(datum_shell);
+  }
+
+  // Arriving from the interior of the target chain?
+  S2Point next = NextChainEdge(&shape, chain, end_idx).v0;
+  S2Point prev = PrevChainEdge(&shape, chain, end_idx).v0;
+  if (s2pred::OrderedCCW(next, start_point, prev, end_point)) {
+    ABSL_VLOG(1) << "  Edge ends from interior of target chain";
+    toggle(chain);
+  }
+
+  // Query all the edges crossed by the line from the datum shell to a point
+  // on this chain.  Only look at edges that belong to the requested shape.
+  // Using INTERIOR here will avoid returning the two edges on the datum and
+  // target shells that are touched by the endpoints of our line segment.
+  crossing_query->GetCrossingEdges(start_point, end_point, shape_id, shape,
+                                   s2shapeutil::CrossingType::INTERIOR,
+                                   edges);
+
+  // Walk through the intersected chains and toggle the corresponding chains.
+  // Chains crossed an even number of times do not separate the target chain
+  // from the datum shell.
+  for (const auto& edge : *edges) {
+    toggle(shape.chain_position(edge.id().edge_id).chain_id);
+  }
+
+  // The datum shell is a candidate parent only if both the datum shell and
+  // the target chain were toggled an odd number of times.  The target chain
+  // is not its own parent.
+  const bool datum_is_parent =
+      crossed->contains(datum_shell) && crossed->contains(chain);
+  crossed->erase(chain);
+  if (!datum_is_parent) crossed->erase(datum_shell);
+
+  vector<int32> parents(crossed->begin(), crossed->end());
+  std::sort(parents.begin(), parents.end());
+  return parents;
+}
+
+// Returns the nesting level of "chain", i.e. the length of the longest
+// sequence of candidate parents leading from "chain" to a chain without any
+// candidate parents.  Levels are memoized in "levels", where -1 indicates a
+// level that has not been computed yet.  (Setting the level to zero before
+// visiting the candidate parents ensures termination even if the candidate
+// parents are cyclic, which can only happen for invalid geometry.)
+int GetNestingLevel(const vector<vector<int32>>& parents, int chain,
+                    vector<int>* levels) {
+  if ((*levels)[chain] >= 0) return (*levels)[chain];
+  (*levels)[chain] = 0;
+  int level = 0;
+  for (int32 parent : parents[chain]) {
+    level = std::max(level, 1 + GetNestingLevel(parents, parent, levels));
+  }
+  return (*levels)[chain] = level;
+}
+
+}  // namespace
+
 vector<S2ShapeNestingQuery::ChainRelation>
 S2ShapeNestingQuery::ComputeShapeNesting(int shape_id) {
+  return ComputeShapeNesting(shape_id, options_.num_threads());
+}
+
+vector<vector<S2ShapeNestingQuery::ChainRelation>>
+S2ShapeNestingQuery::ComputeAllShapeNesting() {
+  const int num_shape_ids = index_->num_shape_ids();
+  vector<vector<ChainRelation>> result(num_shape_ids);
+  std::atomic<int> next_shape_id(0);
+  auto run = [&]() {
+    int shape_id;
+    while ((shape_id = next_shape_id.fetch_add(1)) < num_shape_ids) {
+      const S2Shape* shape = index_->shape(shape_id);
+      if (shape == nullptr || shape->dimension() != 2) continue;
+      result[shape_id] = ComputeShapeNesting(shape_id, 1);
+    }
+  };
+  const int num_threads =
+      std::min(std::max(options_.num_threads(), 1), std::max(num_shape_ids, 1));
+  s2base::RunConcurrently(options_.executor(), num_threads, run);
+  return result;
+}
+
+vector<S2ShapeNestingQuery::ChainRelation>
+S2ShapeNestingQuery::ComputeShapeNesting(int shape_id, int num_threads) {
   const S2Shape* shape = index_->shape(shape_id);
   if (shape == nullptr || shape->num_chains() == 0) {
     return {};
@@ -108,10 +219,6 @@ S2ShapeNestingQuery::ComputeShapeNesting(int shape_id) {
     return {ChainRelation::MakeShell()};
   }
 
-  // Sets to track possible parents and possible children for each chain.
-  absl::FixedArray<Bitmap64> parents(num_chains, Bitmap64(num_chains, false));
-  absl::FixedArray<Bitmap64> children(num_chains, Bitmap64(num_chains, false));
-
   // We'll compute edge crossings along a line segment from the datum shell to a
   // random point on the other chains.  This choice is arbitrary, so we'll use
   // the first vertex of edge 1 so we can easily get the next and previous
@@ -122,127 +229,47 @@ S2ShapeNestingQuery::ComputeShapeNesting(int shape_id) {
       shape->chain_edge(datum_shell, 1).v0,
       shape->chain_edge(datum_shell, 2).v0,
   };
-  const S2Point start_point = vertices[1];
-
-  S2CrossingEdgeQuery crossing_query(index_);
-  vector<s2shapeutil::ShapeEdge> edges;
-  for (int chain = 0; chain < num_chains; ++chain) {
-    if (chain == datum_shell) {
-      continue;
-    }
-    ABSL_VLOG(1) << "Processing chain " << chain;
-
-    // Find a close point on the target chain out of 4 equally spaced ones.
-    int end_idx = ClosestOfNPoints(start_point, *shape, chain, 4);
-    S2Point end_point = shape->chain_edge(chain, end_idx).v0;
-
-    // We need to know whether we're inside the datum shell at the end, so we
-    // need to properly seed its starting state.  If we start by entering the
-    // datum shell's interior _and_ end by arriving from the target chain's
-    // interior, we set it to true.
-    //
-    // As we cross edges from the datum to the target chain the total number of
-    // datum shell _or_ target chain edges we'll cross is either even or odd.
-    // Each of these edges toggles our "insideness" relative to the datum shell,
-    if (s2pred::OrderedCCW(vertices[2], end_point, vertices[0], start_point)) {
-      ABSL_VLOG(1) << "  Edge starts into interior of datum chain";
-      parents[chain].Set(datum_shell, true);
-      children[datum_shell].Set(chain, true);
-    }
 
-    // Arriving from the interior of the target chain?
-    S2Point next = NextChainEdge(shape, chain, end_idx).v0;
-    S2Point prev = PrevChainEdge(shape, chain, end_idx).v0;
-    if (s2pred::OrderedCCW(next, start_point, prev, end_point)) {
-      ABSL_VLOG(1) << "  Edge ends from interior of target chain";
-      parents[chain].Set(chain, true);
+  // The candidate parents of each chain.  These are stored sparsely since
+  // typically each chain has very few of them, even when the shape has tens
+  // of thousands of chains (e.g., a polygon with many holes).  The chains
+  // are independent of each other, so they are divided among several
+  // threads when requested.
+  vector<vector<int32>> parents(num_chains);
+  std::atomic<int> next_chain(0);
+  auto run = [&]() {
+    S2CrossingEdgeQuery crossing_query(index_);
+    vector<s2shapeutil::ShapeEdge> edges;
+    absl::flat_hash_set<int32> crossed;
+    int chain;
+    while ((chain = next_chain.fetch_add(1)) < num_chains) {
+      if (chain == datum_shell) continue;
+      parents[chain] =
+          GetCandidateParents(*shape, shape_id, chain, datum_shell, vertices,
+                              &crossing_query, &edges, &crossed);
     }
-    ABSL_VLOG(2) << "    Initial set: " << parents[chain].ToString(8);
-
-    // Query all the edges crossed by the line from the datum shell to a point
-    // on this chain.  Only look at edges that belong to the requested shape.
-    // Using INTERIOR here will avoid returning the two edges on the datum and
-    // target shells that are touched by the endpoints of our line segment.
-    crossing_query.GetCrossingEdges(start_point, end_point, shape_id, *shape,
-                                    s2shapeutil::CrossingType::INTERIOR,
-                                    &edges);
-
-    // Walk through the intersected chains and toggle corresponding bits.
-    for (const auto& edge : edges) {
-      int32 other_chain = shape->chain_position(edge.id().edge_id).chain_id;
-
-      parents[chain].Toggle(other_chain);
-      if (other_chain != chain) {
-        children[other_chain].Toggle(chain);
-      }
-      ABSL_VLOG(1) << "  Crosses chain " << other_chain;
-      ABSL_VLOG(2) << "    Parent set: " << parents[chain].ToString(8);
-    }
-
-    // Now set the final state.  Remove the target chain from its own parent set
-    // to make following logic simpler.  The datum shell is a potential parent
-    // if both parent and target chain bits are set.
-    parents[chain].Set(datum_shell, parents[chain].Get(datum_shell) &&
-                                        parents[chain].Get(chain));
-    parents[chain].Set(chain, false);
-  }
-
-  if (ABSL_VLOG_IS_ON(2)) {
-    ABSL_LOG(INFO) << "Current parent set";
-    for (int chain = 0; chain < num_chains; ++chain) {
-      ABSL_LOG(INFO) << "  " << absl::StrFormat("%2d", chain) << ": "
-                     << parents[chain].ToString(8);
-    }
-  }
-
-  // Look at each chain with a single parent and remove the parent from any of
-  // its child chains.  This enforces the constraint that if A is a parent of B
-  // and B is a parent of C, then A shouldn't directly be a parent of C.
-  for (int current_chain = 0; current_chain < num_chains; ++current_chain) {
-    if (parents[current_chain].GetOnesCount() != 1) {
-      continue;
-    }
-
-    Bitmap64::size_type parent_chain;
-    parents[current_chain].FindFirstSetBit(&parent_chain);
-
-    Bitmap64::size_type next_chain = current_chain;
-    Bitmap64::size_type child = 0;
-    for (; children[current_chain].FindNextSetBit(&child); child++) {
-      if (parents[child].Get(parent_chain)) {
-        parents[child].Set(parent_chain, false);
-
-        // If this chain has a single parent now, we have to process it as well,
-        // so if we've already passed it in the outer loop, we have to back up.
-        if (parents[child].GetOnesCount() == 1 && child < next_chain) {
-          next_chain = child;
-        }
-      }
-    }
-
-    ABSL_VLOG(1) << "Chain " << current_chain << " has one parent";
-    if (ABSL_VLOG_IS_ON(2)) {
-      ABSL_LOG(INFO) << "  Parent set now:";
-      for (int chain = 0; chain < num_chains; ++chain) {
-        ABSL_LOG(INFO) << "  " << absl::StrFormat("%2d", chain) << ": "
-                       << parents[chain].ToString(8);
-      }
-    }
-
-    // Backup current chain so next loop increment sets it properly
-    if (next_chain != static_cast<Bitmap64::size_type>(current_chain)) {
-      current_chain = next_chain - 1;
-    }
-  }
-
-  // Each chain now points to its immediate parent.  Scan through and set child
-  // to point to parent and vice-versa.
+  };
+  num_threads = std::min(std::max(num_threads, 1), num_chains);
+  s2base::RunConcurrently(options_.executor(), num_threads, run);
+
+  // The candidate parents of a chain are all the chains that enclose it
+  // (relative to the datum shell), so its immediate parent is the candidate
+  // that is most deeply nested itself.  This enforces the constraint that if
+  // A is a parent of B and B is a parent of C, then A shouldn't directly be a
+  // parent of C.
+  vector<int> levels(num_chains, -1);
   vector<ChainRelation> relations(num_chains);
   for (int chain = 0; chain < num_chains; ++chain) {
-    ABSL_DCHECK_LE(parents[chain].GetOnesCount(), 1);
-
-    Bitmap64::size_type parent;
-    if (parents[chain].FindFirstSetBit(&parent)) {
+    int parent = -1, parent_level = -1;
+    for (int32 candidate : parents[chain]) {
+      int level = GetNestingLevel(parents, candidate, &levels);
+      if (level > parent_level) {
+        parent = candidate;
+        parent_level = level;
+      }
+    }
+    if (parent >= 0) {
+      ABSL_VLOG(1) << "Chain " << chain << " has parent " << parent;
       relations[chain].SetParent(parent);
       relations[parent].AddHole(chain);
     }
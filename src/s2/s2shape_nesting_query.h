@@ -20,6 +20,7 @@
 #include <climits>
 #include <vector>
 
+#include "s2/base/executor.h"
 #include "s2/base/types.h"
 #include "absl/container/inlined_vector.h"
 #include "absl/types/span.h"
@@ -90,8 +91,32 @@ class S2ShapeNestingQuery {
       return *this;
     }
 
+    // The maximum number of threads used by ComputeShapeNesting(), which
+    // classifies the chains of a shape in parallel, and by
+    // ComputeAllShapeNesting(), which processes the shapes of the index in
+    // parallel.  The results do not depend on this value.
+    //
+    // DEFAULT: 1
+    int num_threads() const { return num_threads_; }
+    Options& set_num_threads(int num_threads) {
+      num_threads_ = num_threads;
+      return *this;
+    }
+
+    // If non-null, the additional threads requested by num_threads() are
+    // run as tasks on this executor (see s2base::RunConcurrently).
+    //
+    // DEFAULT: nullptr
+    s2base::Executor* executor() const { return executor_; }
+    Options& set_executor(s2base::Executor* executor) {
+      executor_ = executor;
+      return *this;
+    }
+
    private:
     S2DatumStrategy datum_strategy_;
+    int num_threads_ = 1;
+    s2base::Executor* executor_ = nullptr;
   };
 
   // `ChainRelation` models the parent/child relationship between chains in a
@@ -182,9 +207,22 @@ class S2ShapeNestingQuery {
   //
   // The returned `ChainRelation` instances are in 1:1 correspondence with the
   // chains in the shape, i.e. chain id 3 responds to `result[3]`.
+  //
+  // The running time is O(n * c) where "n" is the number of chains and "c"
+  // is the average number of edges crossed by a segment from the datum shell
+  // to another chain, and the memory required is proportional to the total
+  // nesting depth of all chains.
   std::vector<ChainRelation> ComputeShapeNesting(int shape_id);
 
+  // Returns ComputeShapeNesting(shape_id) for every shape in the index,
+  // indexed by shape id.  The result is empty for missing shapes and for
+  // shapes that are not two-dimensional.
+  std::vector<std::vector<ChainRelation>> ComputeAllShapeNesting();
+
  private:
+  std::vector<ChainRelation> ComputeShapeNesting(int shape_id,
+                                                 int num_threads);
+
   const S2ShapeIndex* index_;
   Options options_;
 };
@@ -478,3 +478,62 @@ INSTANTIATE_TEST_SUITE_P(
         {32, 32 / 3, true},
     }));
 
+
+TEST(S2ShapeNestingQuery, ManyHolesMultiThreaded) {
+  // A shell with a grid of holes, some of which contain shells of their own.
+  vector<RingSpec> specs = {RingSpec(S2LatLng::FromDegrees(0, 0), 20)};
+  for (int i = 0; i < 10; ++i) {
+    for (int j = 0; j < 10; ++j) {
+      S2LatLng center = S2LatLng::FromDegrees(-13.5 + 3 * i, -13.5 + 3 * j);
+      specs.emplace_back(center, 1, true);
+      if ((i + j) % 3 == 0) specs.emplace_back(center, 0.5);
+    }
+  }
+  MutableS2ShapeIndex index;
+  index.Add(RingShape(20, specs));
+  vector<S2ShapeNestingQuery::ChainRelation> expected =
+      S2ShapeNestingQuery(&index).ComputeShapeNesting(0);
+  ASSERT_EQ(expected.size(), specs.size());
+  for (int chain = 1; chain < static_cast<int>(specs.size()); ++chain) {
+    if (specs[chain].reverse) {
+      EXPECT_EQ(expected[chain].parent_id(), 0);
+    } else {
+      EXPECT_TRUE(expected[chain].is_shell());
+    }
+  }
+
+  S2ShapeNestingQuery::Options options;
+  options.set_num_threads(4);
+  S2ShapeNestingQuery query(&index, options);
+  vector<S2ShapeNestingQuery::ChainRelation> actual =
+      query.ComputeShapeNesting(0);
+  ASSERT_EQ(actual.size(), expected.size());
+  for (int chain = 0; chain < static_cast<int>(actual.size()); ++chain) {
+    EXPECT_EQ(actual[chain].parent_id(), expected[chain].parent_id());
+    EXPECT_EQ(vector<int32>(actual[chain].holes().begin(),
+                            actual[chain].holes().end()),
+              vector<int32>(expected[chain].holes().begin(),
+                            expected[chain].holes().end()));
+  }
+}
+
+TEST(S2ShapeNestingQuery, ComputeAllShapeNesting) {
+  MutableS2ShapeIndex index;
+  const RingSpec specs[] = {RingSpec(S2LatLng::FromDegrees(0, 0), 2),
+                            RingSpec(S2LatLng::FromDegrees(0, 0), 1, true)};
+  for (int i = 0; i < 5; ++i) index.Add(RingShape(10, specs));
+  index.Add(RingShape(10, absl::MakeConstSpan(specs, 1)));
+
+  S2ShapeNestingQuery::Options options;
+  options.set_num_threads(3);
+  S2ShapeNestingQuery query(&index, options);
+  auto all = query.ComputeAllShapeNesting();
+  ASSERT_EQ(all.size(), index.num_shape_ids());
+  for (int shape_id = 0; shape_id < 5; ++shape_id) {
+    ASSERT_EQ(all[shape_id].size(), 2);
+    EXPECT_TRUE(all[shape_id][0].is_shell());
+    EXPECT_EQ(all[shape_id][1].parent_id(), 0);
+  }
+  ASSERT_EQ(all[5].size(), 1);
+  EXPECT_TRUE(all[5][0].is_shell());
+}
@@ -17,16 +17,30 @@
 
 #include "s2/s2shapeutil_coding.h"
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/cleanup/cleanup.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/types/span.h"
 #include "s2/util/coding/coder.h"
+#include "s2/base/executor.h"
 #include "s2/encoded_string_vector.h"
+#include "s2/encoded_uint_vector.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_iterator.h"
+#include "s2/s2cell_union.h"
 #include "s2/s2coder.h"
+#include "s2/s2encoding_sink.h"
 #include "s2/s2lax_polygon_shape.h"
 #include "s2/s2lax_polyline_shape.h"
 #include "s2/s2point_vector_shape.h"
@@ -38,6 +52,10 @@
 
 using std::make_shared;
 using std::make_unique;
+using absl::Span;
+using std::min;
+using std::shared_ptr;
+using std::string;
 using std::unique_ptr;
 using std::vector;
 
@@ -154,6 +172,128 @@ bool CompactEncodeTaggedShapes(const S2ShapeIndex& index, Encoder* encoder) {
   return EncodeTaggedShapes(index, CompactEncodeShape, encoder);
 }
 
+bool EncodeTaggedShapes(const S2ShapeIndex& index,
+                        const ShapeEncoder& shape_encoder, Encoder* encoder,
+                        int num_threads, s2base::Executor* executor) {
+  ABSL_DCHECK_GE(num_threads, 1);
+  // Each block of consecutive shapes is encoded into its own buffer, along
+  // with the length of each shape so that the offsets can be written later.
+  struct Block {
+    Encoder data;
+    vector<uint64> lengths;
+  };
+  constexpr int kShapesPerBlock = 256;
+  const int num_shape_ids = index.num_shape_ids();
+  const int num_blocks = (num_shape_ids + kShapesPerBlock - 1) /
+                         kShapesPerBlock;
+  num_threads = min(num_threads, num_blocks);
+  if (num_threads <= 1) {
+    return EncodeTaggedShapes(index, shape_encoder, encoder);
+  }
+
+  vector<Block> blocks(num_blocks);
+  std::atomic<int> next_block(0);
+  std::atomic<bool> ok(true);
+  s2base::RunConcurrently(executor, num_threads, [&]() {
+    int b;
+    while (ok.load(std::memory_order_relaxed) &&
+           (b = next_block.fetch_add(1)) < num_blocks) {
+      Block& block = blocks[b];
+      const int limit = min(num_shape_ids, (b + 1) * kShapesPerBlock);
+      block.lengths.reserve(limit - b * kShapesPerBlock);
+      for (int id = b * kShapesPerBlock; id < limit; ++id) {
+        const size_t start = block.data.length();
+        const S2Shape* shape = index.shape(id);
+        if (shape != nullptr) {  // Missing shapes are encoded as zero bytes.
+          block.data.Ensure(Encoder::kVarintMax32);
+          block.data.put_varint32(shape->type_tag());
+          if (!shape_encoder(*shape, &block.data)) {
+            ok = false;
+            return;
+          }
+        }
+        block.lengths.push_back(block.data.length() - start);
+      }
+    }
+  });
+  if (!ok) return false;
+
+  // Write the offset table followed by the concatenated blocks.  This is the
+  // same format produced by StringVectorEncoder::Encode().
+  s2coding::StringVectorStreamEncoder shape_vector;
+  size_t total_length = 0;
+  for (const Block& block : blocks) {
+    for (uint64 length : block.lengths) shape_vector.AddLength(length);
+    total_length += block.data.length();
+  }
+  shape_vector.EncodeHeader(encoder);
+  for (const Block& block : blocks) {
+    for (uint64 length : block.lengths) {
+      shape_vector.EncodeOffset(length, encoder);
+    }
+  }
+  encoder->Ensure(total_length);
+  for (const Block& block : blocks) {
+    encoder->putn(block.data.base(), block.data.length());
+  }
+  return true;
+}
+
+bool FastEncodeTaggedShapes(const S2ShapeIndex& index, Encoder* encoder,
+                            int num_threads) {
+  return EncodeTaggedShapes(index, FastEncodeShape, encoder, num_threads);
+}
+
+bool CompactEncodeTaggedShapes(const S2ShapeIndex& index, Encoder* encoder,
+                               int num_threads) {
+  return EncodeTaggedShapes(index, CompactEncodeShape, encoder, num_threads);
+}
+
+bool EncodeTaggedShapes(const S2ShapeIndex& index,
+                        const ShapeEncoder& shape_encoder,
+                        S2EncodingSink* sink) {
+  // Encodes a shape in the same way as EncodeTaggedShapes() above.
+  auto encode_shape = [&shape_encoder](const S2Shape* shape,
+                                       Encoder* encoder) {
+    if (shape == nullptr) return true;  // Encode as zero bytes.
+    encoder->Ensure(Encoder::kVarintMax32);
+    encoder->put_varint32(shape->type_tag());
+    return shape_encoder(*shape, encoder);
+  };
+  // The first pass measures the shapes.  Their lengths are saved so that the
+  // offsets can be written without encoding the shapes a third time.
+  s2coding::StringVectorStreamEncoder shape_vector;
+  vector<uint64> lengths;
+  lengths.reserve(index.num_shape_ids());
+  Encoder scratch;
+  for (const S2Shape* shape : index) {
+    scratch.clear();
+    if (!encode_shape(shape, &scratch)) return false;
+    shape_vector.AddLength(scratch.length());
+    lengths.push_back(scratch.length());
+  }
+  S2SinkEncoder out(sink);
+  shape_vector.EncodeHeader(out.encoder());
+  for (uint64 length : lengths) {
+    shape_vector.EncodeOffset(length, out.encoder());
+    if (!out.MaybeFlush()) return false;
+  }
+  for (const S2Shape* shape : index) {
+    if (!encode_shape(shape, out.encoder())) return false;
+    if (!out.MaybeFlush()) return false;
+  }
+  return out.Flush();
+}
+
+bool FastEncodeTaggedShapes(const S2ShapeIndex& index, S2EncodingSink* sink) {
+  return EncodeTaggedShapes(index, FastEncodeShape, sink);
+}
+
+bool CompactEncodeTaggedShapes(const S2ShapeIndex& index,
+                               S2EncodingSink* sink) {
+  return EncodeTaggedShapes(index, CompactEncodeShape, sink);
+}
+
 TaggedShapeFactory::TaggedShapeFactory(const ShapeDecoder& shape_decoder,
                                        Decoder* decoder, S2Error& error)
     : shape_decoder_(shape_decoder) {
@@ -192,6 +332,275 @@ TaggedShapeFactory LazyDecodeShapeFactory(Decoder* decoder) {
   return TaggedShapeFactory(LazyDecodeShape, decoder, error);
 }
 
+// The chunked encoding consists of
+//
+//   fixed32: header length in bytes
+//   header:
+//     varint32: number of shapes
+//     varint32: shapes per chunk
+//     EncodedUintVector<uint64>: chunk limits (see State::chunk_limits)
+//   the chunks, where each chunk is encoded like EncodeTaggedShapes().
+//
+// The header length is stored first and at a fixed size so that a reader
+// can fetch the header without knowing its size in advance.
+bool EncodeChunkedTaggedShapes(const S2ShapeIndex& index,
+                               const ShapeEncoder& shape_encoder,
+                               int shapes_per_chunk, Encoder* encoder) {
+  ABSL_DCHECK_GT(shapes_per_chunk, 0);
+  const int num_shapes = index.num_shape_ids();
+  Encoder chunks;
+  vector<uint64> chunk_limits;
+  for (int begin = 0; begin < num_shapes; begin += shapes_per_chunk) {
+    const int end = min(num_shapes - begin, shapes_per_chunk) + begin;
+    s2coding::StringVectorEncoder shape_vector;
+    for (int id = begin; id < end; ++id) {
+      Encoder* sub_encoder = shape_vector.AddViaEncoder();
+      const S2Shape* shape = index.shape(id);
+      if (shape == nullptr) continue;  // Encode as zero bytes.
+
+      sub_encoder->Ensure(Encoder::kVarintMax32);
+      sub_encoder->put_varint32(shape->type_tag());
+      if (!shape_encoder(*shape, sub_encoder)) return false;
+    }
+    shape_vector.Encode(&chunks);
+    chunk_limits.push_back(chunks.length());
+  }
+  Encoder header;
+  header.Ensure(2 * Encoder::kVarintMax32);
+  header.put_varint32(num_shapes);
+  header.put_varint32(shapes_per_chunk);
+  s2coding::EncodeUintVector<uint64>(chunk_limits, &header);
+
+  encoder->Ensure(sizeof(uint32) + header.length() + chunks.length());
+  encoder->put32(header.length());
+  encoder->putn(header.base(), header.length());
+  encoder->putn(chunks.base(), chunks.length());
+  return true;
+}
+
+bool FastEncodeChunkedTaggedShapes(const S2ShapeIndex& index,
+                                   Encoder* encoder, int shapes_per_chunk) {
+  return EncodeChunkedTaggedShapes(index, FastEncodeShape, shapes_per_chunk,
+                                   encoder);
+}
+
+bool CompactEncodeChunkedTaggedShapes(const S2ShapeIndex& index,
+                                      Encoder* encoder, int shapes_per_chunk) {
+  return EncodeChunkedTaggedShapes(index, CompactEncodeShape,
+                                   shapes_per_chunk, encoder);
+}
+
+void BlockFetcher::FetchAsync(uint64 offset, uint64 length,
+                              FetchCallback done) const {
+  string data;
+  bool success = Fetch(offset, length, &data);
+  done(success, std::move(data));
+}
+
+bool AsyncBlockFetcher::Fetch(uint64 offset, uint64 length,
+                              string* data) const {
+  absl::Notification fetched;
+  bool result = false;
+  FetchAsync(offset, length, [&](bool success, string bytes) {
+    result = success;
+    *data = std::move(bytes);
+    fetched.Notify();
+  });
+  fetched.WaitForNotification();
+  return result;
+}
+
+ChunkedTaggedShapeFactory::ChunkedTaggedShapeFactory(
+    const ShapeDecoder& shape_decoder, shared_ptr<const BlockFetcher> fetcher,
+    S2Error& error)
+    : shape_decoder_(shape_decoder), state_(make_shared<State>()) {
+  state_->fetcher = std::move(fetcher);
+  string bytes;
+  if (!state_->fetcher->Fetch(0, sizeof(uint32), &bytes) ||
+      bytes.size() != sizeof(uint32)) {
+    error.Init(S2Error::DATA_LOSS, "Could not fetch chunked shapes header.");
+    return;
+  }
+  Decoder length_decoder(bytes.data(), bytes.size());
+  const uint32 header_length = length_decoder.get32();
+  if (!state_->fetcher->Fetch(sizeof(uint32), header_length, &bytes) ||
+      bytes.size() != header_length) {
+    error.Init(S2Error::DATA_LOSS, "Could not fetch chunked shapes header.");
+    return;
+  }
+  Decoder decoder(bytes.data(), bytes.size());
+  uint32 num_shapes, shapes_per_chunk;
+  s2coding::EncodedUintVector<uint64> chunk_limits;
+  if (!decoder.get_varint32(&num_shapes) ||
+      !decoder.get_varint32(&shapes_per_chunk) || shapes_per_chunk == 0 ||
+      num_shapes > static_cast<uint32>(std::numeric_limits<int>::max()) ||
+      !chunk_limits.Init(&decoder)) {
+    error.Init(S2Error::DATA_LOSS, "Corrupted chunked shapes header.");
+    return;
+  }
+  vector<uint64> limits = chunk_limits.Decode();
+  const uint64 num_chunks =
+      (uint64{num_shapes} + shapes_per_chunk - 1) / shapes_per_chunk;
+  if (limits.size() != num_chunks ||
+      !std::is_sorted(limits.begin(), limits.end())) {
+    error.Init(S2Error::DATA_LOSS, "Corrupted chunked shapes header.");
+    return;
+  }
+  state_->num_shapes = num_shapes;
+  state_->shapes_per_chunk = shapes_per_chunk;
+  state_->chunks_offset = sizeof(uint32) + header_length;
+  state_->chunk_limits = std::move(limits);
+  absl::MutexLock lock(&state_->mutex);
+  state_->slots.resize(num_chunks);
+}
+
+int ChunkedTaggedShapeFactory::num_fetched_chunks() const {
+  absl::MutexLock lock(&state_->mutex);
+  int count = 0;
+  for (const Slot& slot : state_->slots) count += (slot.chunk != nullptr);
+  return count;
+}
+
+unique_ptr<ChunkedTaggedShapeFactory::Chunk>
+ChunkedTaggedShapeFactory::DecodeChunk(const State& state, int i,
+                                       string data) {
+  auto chunk = make_unique<Chunk>();
+  chunk->data = std::move(data);
+  Decoder decoder(chunk->data.data(), chunk->data.size());
+  const size_t expected_size =
+      min(state.num_shapes - i * state.shapes_per_chunk,
+          state.shapes_per_chunk);
+  if (!chunk->shapes.Init(&decoder) || chunk->shapes.size() != expected_size) {
+    return nullptr;
+  }
+  return chunk;
+}
+
+void ChunkedTaggedShapeFactory::FetchChunk(shared_ptr<State> state, int i,
+                                           std::function<void()> done) {
+  bool fetched = false;
+  {
+    absl::MutexLock lock(&state->mutex);
+    Slot& slot = state->slots[i];
+    if (slot.chunk != nullptr) {
+      fetched = true;
+    } else {
+      slot.waiters.push_back(std::move(done));
+      if (slot.fetching) return;  // "done" is called by the current fetch.
+      slot.fetching = true;
+    }
+  }
+  if (fetched) {
+    done();
+    return;
+  }
+  // The mutex is not held while fetching, so that other threads can continue
+  // to use chunks that have already been fetched.
+  const uint64 begin = (i == 0) ? 0 : state->chunk_limits[i - 1];
+  const uint64 offset = state->chunks_offset + begin;
+  const uint64 length = state->chunk_limits[i] - begin;
+  const BlockFetcher& fetcher = *state->fetcher;
+  fetcher.FetchAsync(
+      offset, length,
+      [state = std::move(state), i, length](bool success, string data) {
+        unique_ptr<Chunk> chunk;
+        if (success && data.size() == length) {
+          chunk = DecodeChunk(*state, i, std::move(data));
+        }
+        vector<std::function<void()>> waiters;
+        {
+          absl::MutexLock lock(&state->mutex);
+          Slot& slot = state->slots[i];
+          slot.chunk = std::move(chunk);
+          slot.fetching = false;
+          waiters.swap(slot.waiters);
+        }
+        for (const auto& waiter : waiters) waiter();
+      });
+}
+
+const ChunkedTaggedShapeFactory::Chunk* ChunkedTaggedShapeFactory::GetChunk(
+    int i) const {
+  {
+    absl::MutexLock lock(&state_->mutex);
+    const Chunk* chunk = state_->slots[i].chunk.get();
+    if (chunk != nullptr) return chunk;
+  }
+  absl::Notification fetched;
+  FetchChunk(state_, i, [&fetched]() { fetched.Notify(); });
+  fetched.WaitForNotification();
+  absl::MutexLock lock(&state_->mutex);
+  return state_->slots[i].chunk.get();
+}
+
+void ChunkedTaggedShapeFactory::Prefetch(Span<const int> shape_ids,
+                                         std::function<void()> done) const {
+  vector<int> chunks;
+  for (int shape_id : shape_ids) {
+    ABSL_DCHECK_LT(shape_id, size());
+    chunks.push_back(shape_id / state_->shapes_per_chunk);
+  }
+  std::sort(chunks.begin(), chunks.end());
+  chunks.erase(std::unique(chunks.begin(), chunks.end()), chunks.end());
+
+  // "done" is called when the last chunk completes.  The count includes one
+  // extra reference that is released after all the fetches have started.
+  auto remaining = make_shared<std::atomic<int>>(chunks.size() + 1);
+  auto shared_done = make_shared<std::function<void()>>(std::move(done));
+  auto release = [remaining, shared_done]() {
+    if (remaining->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      (*shared_done)();
+    }
+  };
+  for (int i : chunks) FetchChunk(state_, i, release);
+  release();
+}
+
+void ChunkedTaggedShapeFactory::Prefetch(const S2ShapeIndex& index,
+                                         const S2CellUnion& cells,
+                                         std::function<void()> done) const {
+  vector<int> shape_ids;
+  auto add_cell = [&shape_ids](const S2ShapeIndexCell& cell) {
+    for (int i = 0; i < cell.num_clipped(); ++i) {
+      shape_ids.push_back(cell.clipped(i).shape_id());
+    }
+  };
+  S2ShapeIndex::Iterator iter(&index);
+  for (S2CellId id : cells) {
+    if (iter.Locate(id) == S2CellRelation::INDEXED) {
+      add_cell(iter.cell());
+      continue;
+    }
+    // Otherwise the iterator is positioned at the first index cell (if any)
+    // that is contained by "id".
+    for (; !iter.done() && iter.id() <= id.range_max(); iter.Next()) {
+      add_cell(iter.cell());
+    }
+  }
+  Prefetch(shape_ids, std::move(done));
+}
+
+unique_ptr<S2Shape> ChunkedTaggedShapeFactory::operator[](int shape_id) const {
+  ABSL_DCHECK_LT(shape_id, size());
+  const Chunk* chunk = GetChunk(shape_id / state_->shapes_per_chunk);
+  if (chunk == nullptr) return nullptr;
+  Decoder decoder =
+      chunk->shapes.GetDecoder(shape_id % state_->shapes_per_chunk);
+  S2Shape::TypeTag tag;
+  if (!decoder.get_varint32(&tag)) return nullptr;
+  return shape_decoder_(tag, &decoder);
+}
+
+ChunkedTaggedShapeFactory FullDecodeChunkedShapeFactory(
+    shared_ptr<const BlockFetcher> fetcher, S2Error& error) {
+  return ChunkedTaggedShapeFactory(FullDecodeShape, std::move(fetcher), error);
+}
+
+ChunkedTaggedShapeFactory LazyDecodeChunkedShapeFactory(
+    shared_ptr<const BlockFetcher> fetcher, S2Error& error) {
+  return ChunkedTaggedShapeFactory(LazyDecodeShape, std::move(fetcher), error);
+}
+
 VectorShapeFactory::VectorShapeFactory(vector<unique_ptr<S2Shape>> shapes)
     : shared_shapes_(
           make_shared<vector<unique_ptr<S2Shape>>>(std::move(shapes))) {
@@ -207,6 +616,62 @@ VectorShapeFactory SingletonShapeFactory(unique_ptr<S2Shape> shape) {
   return VectorShapeFactory(std::move(shapes));
 }
 
+VectorShapeFactory ParallelDecodeShapeFactory(const ShapeDecoder& shape_decoder,
+                                              Decoder* decoder,
+                                              int num_threads, S2Error& error,
+                                              s2base::Executor* executor) {
+  ABSL_DCHECK_GE(num_threads, 1);
+  s2coding::EncodedStringVector encoded_shapes;
+  if (!encoded_shapes.Init(decoder)) {
+    error.Init(S2Error::DATA_LOSS, "Corrupted encoded shapes.");
+    return VectorShapeFactory({});
+  }
+  constexpr int kShapesPerBlock = 256;
+  const int num_shapes = encoded_shapes.size();
+  const int num_blocks = (num_shapes + kShapesPerBlock - 1) / kShapesPerBlock;
+  vector<unique_ptr<S2Shape>> shapes(num_shapes);
+  std::atomic<int> next_block(0);
+  std::atomic<bool> ok(true);
+  s2base::RunConcurrently(executor, min(num_threads, num_blocks), [&]() {
+    int b;
+    while (ok.load(std::memory_order_relaxed) &&
+           (b = next_block.fetch_add(1)) < num_blocks) {
+      const int limit = min(num_shapes, (b + 1) * kShapesPerBlock);
+      for (int id = b * kShapesPerBlock; id < limit; ++id) {
+        Decoder shape_data = encoded_shapes.GetDecoder(id);
+        if (shape_data.avail() == 0) continue;  // Missing shape.
+        S2Shape::TypeTag tag;
+        if (shape_data.get_varint32(&tag)) {
+          shapes[id] = shape_decoder(tag, &shape_data);
+        }
+        if (shapes[id] == nullptr) {
+          ok = false;
+          return;
+        }
+      }
+    }
+  });
+  if (!ok) {
+    error.Init(S2Error::DATA_LOSS, "Corrupted encoded shape.");
+    return VectorShapeFactory({});
+  }
+  return VectorShapeFactory(std::move(shapes));
+}
+
+VectorShapeFactory ParallelFullDecodeShapeFactory(Decoder* decoder,
+                                                  int num_threads,
+                                                  S2Error& error) {
+  return ParallelDecodeShapeFactory(FullDecodeShape, decoder, num_threads,
+                                    error);
+}
+
+VectorShapeFactory ParallelLazyDecodeShapeFactory(Decoder* decoder,
+                                                  int num_threads,
+                                                  S2Error& error) {
+  return ParallelDecodeShapeFactory(LazyDecodeShape, decoder, num_threads,
+                                    error);
+}
+
 unique_ptr<S2Shape> WrappedShapeFactory::operator[](int shape_id) const {
   const S2Shape* shape = index_.shape(shape_id);
   if (shape == nullptr) return nullptr;
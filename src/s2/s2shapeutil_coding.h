@@ -35,15 +35,22 @@
 
 #include <functional>
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "s2/base/casts.h"
+#include "s2/base/executor.h"
 #include "absl/base/attributes.h"
+#include "absl/base/thread_annotations.h"
 #include "absl/log/absl_check.h"
+#include "absl/synchronization/mutex.h"
 #include "s2/util/coding/coder.h"
 #include "s2/encoded_string_vector.h"
+#include "absl/types/span.h"
+#include "s2/s2cell_union.h"
 #include "s2/s2coder.h"
+#include "s2/s2encoding_sink.h"
 #include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
 
@@ -140,6 +147,37 @@ bool FastEncodeTaggedShapes(const S2ShapeIndex& index, Encoder* encoder);
 //           can be enlarged as necessary by calling Ensure(int).
 bool CompactEncodeTaggedShapes(const S2ShapeIndex& index, Encoder* encoder);
 
+// Like the functions above, but encodes the shapes using up to "num_threads"
+// threads.  Each thread encodes blocks of consecutive shapes into its own
+// buffer, and the blocks are then concatenated after the offset table, so
+// the output is byte-for-byte identical to the single-threaded version.  If
+// "executor" is non-null, the additional threads are run as tasks on it (see
+// s2base::RunConcurrently).
+//
+// REQUIRES: "shape_encoder" and index.shape() may be called concurrently.
+// REQUIRES: "encoder" uses the default constructor, so that its buffer
+//           can be enlarged as necessary by calling Ensure(int).
+bool EncodeTaggedShapes(const S2ShapeIndex& index,
+                        const ShapeEncoder& shape_encoder, Encoder* encoder,
+                        int num_threads, s2base::Executor* executor = nullptr);
+bool FastEncodeTaggedShapes(const S2ShapeIndex& index, Encoder* encoder,
+                            int num_threads);
+bool CompactEncodeTaggedShapes(const S2ShapeIndex& index, Encoder* encoder,
+                               int num_threads);
+
+// Like the functions above, but writes the encoding to "sink" in chunks
+// rather than into a single buffer.  The output is identical.  Peak memory
+// usage is proportional to the largest encoded shape rather than to the
+// total encoding size, at the cost of encoding each shape twice (since the
+// shape offsets must be written before the shapes themselves).  Returns
+// false if a shape could not be encoded or the sink reported an error.
+bool EncodeTaggedShapes(const S2ShapeIndex& index,
+                        const ShapeEncoder& shape_encoder,
+                        S2EncodingSink* sink);
+bool FastEncodeTaggedShapes(const S2ShapeIndex& index, S2EncodingSink* sink);
+bool CompactEncodeTaggedShapes(const S2ShapeIndex& index,
+                               S2EncodingSink* sink);
+
 // A ShapeFactory that decodes a vector generated by EncodeTaggedShapes()
 // above.  Example usage:
 //
@@ -186,6 +224,212 @@ TaggedShapeFactory LazyDecodeShapeFactory(Decoder* decoder, S2Error& error);
 [[deprecated("Use version that accepts S2Error to detect encoding errors")]]
 TaggedShapeFactory LazyDecodeShapeFactory(Decoder* decoder);
 
+// The default number of shapes per chunk for EncodeChunkedTaggedShapes().
+inline constexpr int kDefaultShapesPerChunk = 64;
+
+// Like EncodeTaggedShapes(), except that the shapes are grouped into chunks
+// of "shapes_per_chunk" consecutive shapes, and each chunk is encoded as an
+// independent tagged shape vector.  The encoding starts with a small header
+// that records the byte range of every chunk, so that a reader can fetch
+// just the chunks that contain the shapes it needs (e.g., using ranged reads
+// from a file or from object storage).  See ChunkedTaggedShapeFactory.
+//
+// Smaller chunks reduce the number of bytes fetched per shape, while larger
+// chunks reduce the number of fetches and the per-chunk overhead.
+//
+// REQUIRES: shapes_per_chunk > 0.
+// REQUIRES: "encoder" uses the default constructor, so that its buffer
+//           can be enlarged as necessary by calling Ensure(int).
+bool EncodeChunkedTaggedShapes(const S2ShapeIndex& index,
+                               const ShapeEncoder& shape_encoder,
+                               int shapes_per_chunk, Encoder* encoder);
+
+// Convenience functions that call EncodeChunkedTaggedShapes using
+// FastEncodeShape or CompactEncodeShape as the ShapeEncoder.
+bool FastEncodeChunkedTaggedShapes(
+    const S2ShapeIndex& index, Encoder* encoder,
+    int shapes_per_chunk = kDefaultShapesPerChunk);
+bool CompactEncodeChunkedTaggedShapes(
+    const S2ShapeIndex& index, Encoder* encoder,
+    int shapes_per_chunk = kDefaultShapesPerChunk);
+
+// An interface for reading byte ranges of an encoded blob that is not
+// necessarily held in memory, e.g. a file or an object in remote storage.
+// Offsets are relative to the start of the blob.
+//
+// Implementations must be thread-safe, since shapes may be requested from
+// multiple threads at once (see ChunkedTaggedShapeFactory).
+class BlockFetcher {
+ public:
+  // The callback for FetchAsync().  If "success" is true, then "data"
+  // contains the requested bytes.
+  using FetchCallback = std::function<void(bool success, std::string data)>;
+
+  virtual ~BlockFetcher() = default;
+
+  // Sets "data" to the "length" bytes starting at "offset" and returns true.
+  // Returns false if the bytes could not be read (including the case where
+  // the requested range extends past the end of the blob).
+  virtual bool Fetch(uint64 offset, uint64 length,
+                     std::string* data) const = 0;
+
+  // Starts reading the "length" bytes starting at "offset", and calls "done"
+  // when the read completes.  "done" is called exactly once, either on
+  // another thread or before FetchAsync() returns.
+  //
+  // The default implementation simply calls Fetch() and then "done".
+  // Fetchers backed by slow storage should override it so that several
+  // reads can be in flight at once (see AsyncBlockFetcher).
+  virtual void FetchAsync(uint64 offset, uint64 length,
+                          FetchCallback done) const;
+};
+
+// A BlockFetcher for storage whose reads are naturally asynchronous, such as
+// a network service.  Subclasses implement only FetchAsync(), and Fetch()
+// blocks until the corresponding FetchAsync() call has completed.  Note that
+// this requires FetchAsync() to complete without any further action by the
+// calling thread.
+//
+// FetchAsync() can also be adapted to other asynchronous frameworks (e.g., by
+// wrapping it in an awaitable object), since it does not block.
+class AsyncBlockFetcher : public BlockFetcher {
+ public:
+  bool Fetch(uint64 offset, uint64 length, std::string* data) const final;
+
+  void FetchAsync(uint64 offset, uint64 length,
+                  FetchCallback done) const override = 0;
+};
+
+// A ShapeFactory that decodes a vector generated by EncodeChunkedTaggedShapes()
+// from the given BlockFetcher.  The constructor fetches only the chunk
+// header; each chunk is then fetched the first time one of its shapes is
+// requested, and is retained until the factory and all of its clones have
+// been destroyed.  Example usage:
+//
+//   S2Error error;
+//   s2shapeutil::ChunkedTaggedShapeFactory factory(
+//       s2shapeutil::LazyDecodeShape, fetcher, error);
+//   if (!error.ok()) ...
+//   index.Init(&index_decoder, factory);
+//
+// Shapes decoded lazily (e.g. by LazyDecodeShape) refer directly to the
+// retained chunk data, and therefore must not outlive the factory.  (This is
+// always true for shapes owned by an S2ShapeIndex, since the index owns the
+// factory.)  Clones share the retained chunks.
+//
+// This class is thread-safe.  If a chunk cannot be fetched or decoded, the
+// requested shape is returned as nullptr and the fetch is retried on the
+// next request.
+//
+// Requesting a shape whose chunk has not been fetched blocks until the fetch
+// completes.  Queries against slow storage can avoid blocking on each chunk
+// in turn by calling Prefetch() first, e.g.:
+//
+//   absl::Notification done;
+//   factory.Prefetch(index, region_covering, [&done]() { done.Notify(); });
+//   done.WaitForNotification();  // Or do other work, such as more queries.
+//   ... run the query against "index" ...
+class ChunkedTaggedShapeFactory : public S2ShapeIndex::ShapeFactory {
+ public:
+  // Fetches and decodes the chunk header.  Returns an empty vector and
+  // reports the problem to "error" if the header cannot be fetched or is
+  // invalid.
+  ChunkedTaggedShapeFactory(const ShapeDecoder& shape_decoder,
+                            std::shared_ptr<const BlockFetcher> fetcher,
+                            S2Error& error);
+
+  int size() const override { return state_->num_shapes; }
+
+  std::unique_ptr<S2Shape> operator[](int shape_id) const override;
+
+  std::unique_ptr<ShapeFactory> Clone() const override {
+    return std::make_unique<ChunkedTaggedShapeFactory>(*this);
+  }
+
+  // Returns the number of chunks in the encoding.
+  int num_chunks() const { return state_->chunk_limits.size(); }
+
+  // Returns the number of chunks that have been fetched so far.
+  int num_fetched_chunks() const;
+
+  // Starts fetching the chunks that contain the given shapes, and calls
+  // "done" once each of those chunks has either been fetched or failed to be
+  // fetched.  The fetches are issued concurrently using
+  // BlockFetcher::FetchAsync(), and chunks that have already been fetched or
+  // are being fetched are not fetched again.  "done" may be called on
+  // another thread or before Prefetch() returns.
+  void Prefetch(absl::Span<const int> shape_ids,
+                std::function<void()> done) const;
+
+  // Like the above, but prefetches every shape that has edges in an index
+  // cell intersecting "cells".  For example, a query can pass a covering of
+  // its target region in order to fetch all the shapes it is about to visit
+  // at once.  (The index cells themselves are decoded, but not the shapes.)
+  //
+  // REQUIRES: "index" uses this factory or one of its clones.
+  void Prefetch(const S2ShapeIndex& index, const S2CellUnion& cells,
+                std::function<void()> done) const;
+
+ private:
+  // A fetched chunk.  "shapes" points into "data".
+  struct Chunk {
+    std::string data;
+    s2coding::EncodedStringVector shapes;
+  };
+
+  // The fetch state of a chunk.
+  struct Slot {
+    std::unique_ptr<Chunk> chunk;
+
+    // True while a fetch of this chunk is in progress, in which case
+    // "waiters" are called when the fetch completes.
+    bool fetching = false;
+    std::vector<std::function<void()>> waiters;
+  };
+
+  // State shared by all clones of a factory.
+  struct State {
+    std::shared_ptr<const BlockFetcher> fetcher;
+    int num_shapes = 0;
+    int shapes_per_chunk = 1;
+
+    // The offset of the first chunk within the blob.
+    uint64 chunks_offset = 0;
+
+    // chunk_limits[i] is the offset where chunk "i" ends, relative to
+    // chunks_offset.
+    std::vector<uint64> chunk_limits;
+
+    mutable absl::Mutex mutex;
+    std::vector<Slot> slots ABSL_GUARDED_BY(mutex);
+  };
+
+  // Calls "done" once chunk "i" has been fetched or failed to be fetched,
+  // starting a fetch if necessary.  The callback passed to the fetcher holds
+  // a reference to "state", so the fetch may outlive the factory.
+  static void FetchChunk(std::shared_ptr<State> state, int i,
+                         std::function<void()> done);
+
+  // Decodes the given fetched bytes as chunk "i", or returns nullptr if they
+  // are not a valid encoding.
+  static std::unique_ptr<Chunk> DecodeChunk(const State& state, int i,
+                                            std::string data);
+
+  // Returns the given chunk, waiting for it to be fetched if necessary, or
+  // nullptr if the chunk could not be fetched or decoded.
+  const Chunk* GetChunk(int i) const;
+
+  ShapeDecoder shape_decoder_;
+  std::shared_ptr<State> state_;
+};
+
+// Convenience functions that construct a ChunkedTaggedShapeFactory using
+// FullDecodeShape or LazyDecodeShape as the ShapeDecoder.
+ChunkedTaggedShapeFactory FullDecodeChunkedShapeFactory(
+    std::shared_ptr<const BlockFetcher> fetcher, S2Error& error);
+ChunkedTaggedShapeFactory LazyDecodeChunkedShapeFactory(
+    std::shared_ptr<const BlockFetcher> fetcher, S2Error& error);
+
 // A ShapeFactory that simply returns shapes from the given vector.
 //
 // REQUIRES: Each shape is requested at most once.  (This implies that when
@@ -212,6 +456,40 @@ class VectorShapeFactory : public S2ShapeIndex::ShapeFactory {
 // A ShapeFactory that returns the single given S2Shape.  Useful for testing.
 VectorShapeFactory SingletonShapeFactory(std::unique_ptr<S2Shape> shape);
 
+// Decodes every shape of a vector generated by EncodeTaggedShapes() using up
+// to "num_threads" threads, and returns them as a VectorShapeFactory.  This
+// is useful when all the shapes will be needed anyway, e.g. when loading an
+// encoded index into a MutableS2ShapeIndex:
+//
+//   S2Error error;
+//   auto factory = s2shapeutil::ParallelFullDecodeShapeFactory(
+//       &decoder, /*num_threads=*/8, error);
+//   if (!error.ok()) ...
+//   index.Init(&decoder, factory);
+//
+// Shapes encoded as zero bytes (i.e., missing shapes) are decoded as nullptr.
+// If the vector or any shape cannot be decoded, returns an empty factory and
+// reports the problem to "error".  The shapes are the same as those returned
+// by TaggedShapeFactory, and the same REQUIRES clauses apply (see
+// VectorShapeFactory).  If "executor" is non-null, the additional threads are
+// run as tasks on it.
+//
+// REQUIRES: "shape_decoder" may be called concurrently.
+// REQUIRES: If "shape_decoder" decodes shapes lazily, the Decoder data buffer
+//           must outlive the returned shapes.
+VectorShapeFactory ParallelDecodeShapeFactory(
+    const ShapeDecoder& shape_decoder, Decoder* decoder, int num_threads,
+    S2Error& error, s2base::Executor* executor = nullptr);
+
+// Convenience functions that call ParallelDecodeShapeFactory using
+// FullDecodeShape or LazyDecodeShape as the ShapeDecoder.
+VectorShapeFactory ParallelFullDecodeShapeFactory(Decoder* decoder,
+                                                  int num_threads,
+                                                  S2Error& error);
+VectorShapeFactory ParallelLazyDecodeShapeFactory(Decoder* decoder,
+                                                  int num_threads,
+                                                  S2Error& error);
+
 // A ShapeFactory that wraps the shapes from the given index.  Used for testing.
 class WrappedShapeFactory : public S2ShapeIndex::ShapeFactory {
  public:
@@ -17,24 +17,40 @@
 
 #include "s2/s2shapeutil_coding.h"
 
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <memory_resource>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "s2/base/casts.h"
 #include <gtest/gtest.h>
 #include "absl/strings/escaping.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "s2/util/coding/coder.h"
+#include "s2/encoded_s2shape_index.h"
+#include "s2/encoded_string_vector.h"
 #include "s2/mutable_s2shape_index.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_union.h"
+#include "s2/s2latlng.h"
+#include "s2/s2encoding_sink.h"
+#include "s2/s2error.h"
 #include "s2/s2lax_polygon_shape.h"
 #include "s2/s2lax_polyline_shape.h"
 #include "s2/s2point_vector_shape.h"
 #include "s2/s2polygon.h"
 #include "s2/s2shape.h"
+#include "s2/s2shapeutil_testing.h"
 #include "s2/s2text_format.h"
 
+using std::make_shared;
 using std::make_unique;
 using std::string;
+using std::vector;
 
 namespace s2shapeutil {
 
@@ -64,6 +80,130 @@ TEST(FastEncodeTaggedShapes, MixedShapes) {
             s2textformat::ToString(decoded_index));
 }
 
+TEST(FastEncodeTaggedShapes, ArenaEncoderMatchesEncoder) {
+  auto index = s2textformat::MakeIndexOrDie(
+      "0:0 | 0:1 # 1:1, 1:2, 1:3 # 2:2; 2:3, 2:4, 3:3");
+  Encoder encoder;
+  ASSERT_TRUE(s2shapeutil::FastEncodeTaggedShapes(*index, &encoder));
+
+  // The arena fails if the encoding does not fit in its initial buffer, which
+  // checks that the Encoder allocates all its memory from the arena.
+  char buffer[4096];
+  std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer),
+                                            std::pmr::null_memory_resource());
+  Encoder arena_encoder(&arena);
+  EXPECT_EQ(&arena, arena_encoder.memory_resource());
+  for (int i = 0; i < 2; ++i) {
+    // Encode twice to check that reset() retains the resource.
+    arena_encoder.reset();
+    ASSERT_TRUE(s2shapeutil::FastEncodeTaggedShapes(*index, &arena_encoder));
+    EXPECT_EQ(string(encoder.base(), encoder.length()),
+              string(arena_encoder.base(), arena_encoder.length()));
+  }
+  Encoder moved(std::move(arena_encoder));
+  EXPECT_EQ(&arena, moved.memory_resource());
+  EXPECT_EQ(encoder.length(), moved.length());
+}
+
+TEST(CompactEncodeTaggedShapes, SinkMatchesEncoder) {
+  auto index = s2textformat::MakeIndexOrDie(
+      "0:0 | 0:1 # 1:1, 1:2, 1:3 # 2:2; 2:3, 2:4, 3:3");
+  index->Release(1);  // Removed shapes are encoded as zero bytes.
+  Encoder encoder;
+  ASSERT_TRUE(s2shapeutil::CompactEncodeTaggedShapes(*index, &encoder));
+  string streamed;
+  S2CallbackSink sink([&streamed](absl::string_view data) {
+    streamed.append(data.data(), data.size());
+    return true;
+  });
+  ASSERT_TRUE(s2shapeutil::CompactEncodeTaggedShapes(*index, &sink));
+  EXPECT_EQ(streamed, string(encoder.base(), encoder.length()));
+}
+
+// Returns an index with enough shapes that they are split into several
+// blocks by the multi-threaded encoding and decoding functions.
+static std::unique_ptr<MutableS2ShapeIndex> MakeManyShapesIndex() {
+  auto index = make_unique<MutableS2ShapeIndex>();
+  for (int i = 0; i < 1000; ++i) {
+    S2Point p = S2LatLng::FromDegrees(0.01 * i, 0.02 * i).ToPoint();
+    S2Point q = S2LatLng::FromDegrees(0.01 * i, 0.02 * i + 0.01).ToPoint();
+    if (i % 3 == 0) {
+      index->Add(make_unique<S2PointVectorShape>(vector<S2Point>{p}));
+    } else if (i % 3 == 1) {
+      index->Add(make_unique<S2LaxPolylineShape>(vector<S2Point>{p, q}));
+    } else {
+      S2Point r = S2LatLng::FromDegrees(0.01 * i + 0.01, 0.02 * i).ToPoint();
+      index->Add(make_unique<S2LaxPolygonShape>(
+          vector<S2LaxPolygonShape::Loop>{{p, q, r}}));
+    }
+  }
+  index->Release(1);  // Removed shapes are encoded as zero bytes.
+  index->Release(500);
+  return index;
+}
+
+TEST(EncodeTaggedShapes, MultiThreadedMatchesSingleThreaded) {
+  auto index = MakeManyShapesIndex();
+  Encoder expected;
+  ASSERT_TRUE(s2shapeutil::CompactEncodeTaggedShapes(*index, &expected));
+  for (int num_threads : {1, 2, 4}) {
+    Encoder encoder;
+    ASSERT_TRUE(
+        s2shapeutil::CompactEncodeTaggedShapes(*index, &encoder, num_threads));
+    EXPECT_EQ(string(expected.base(), expected.length()),
+              string(encoder.base(), encoder.length()))
+        << "num_threads = " << num_threads;
+  }
+}
+
+TEST(EncodeTaggedShapes, MultiThreadedReportsErrors) {
+  auto index = MakeManyShapesIndex();
+  auto encode_some = [](const S2Shape& shape, Encoder* encoder) {
+    return shape.type_tag() != S2LaxPolygonShape::kTypeTag &&
+           s2shapeutil::FastEncodeShape(shape, encoder);
+  };
+  Encoder encoder;
+  EXPECT_FALSE(s2shapeutil::EncodeTaggedShapes(*index, encode_some, &encoder,
+                                               /*num_threads=*/4));
+}
+
+TEST(ParallelDecodeShapeFactory, DecodesIndex) {
+  auto index = MakeManyShapesIndex();
+  Encoder encoder;
+  ASSERT_TRUE(s2shapeutil::FastEncodeTaggedShapes(*index, &encoder, 4));
+  index->Encode(&encoder);
+  for (bool lazy : {false, true}) {
+    Decoder decoder(encoder.base(), encoder.length());
+    S2Error error;
+    auto factory =
+        lazy ? s2shapeutil::ParallelLazyDecodeShapeFactory(&decoder, 4, error)
+             : s2shapeutil::ParallelFullDecodeShapeFactory(&decoder, 4, error);
+    ASSERT_TRUE(error.ok()) << error;
+    ASSERT_EQ(index->num_shape_ids(), factory.size());
+    MutableS2ShapeIndex decoded_index;
+    ASSERT_TRUE(decoded_index.Init(&decoder, factory));
+    EXPECT_EQ(nullptr, decoded_index.shape(1));
+    EXPECT_EQ(nullptr, decoded_index.shape(500));
+    EXPECT_EQ(s2textformat::ToString(*index),
+              s2textformat::ToString(decoded_index));
+  }
+}
+
+TEST(ParallelDecodeShapeFactory, CorruptedShape) {
+  s2coding::StringVectorEncoder shape_vector;
+  Encoder* sub_encoder = shape_vector.AddViaEncoder();
+  sub_encoder->Ensure(Encoder::kVarintMax32);
+  sub_encoder->put_varint32(S2Shape::kNoTypeTag);  // Unsupported type.
+  Encoder encoder;
+  shape_vector.Encode(&encoder);
+  Decoder decoder(encoder.base(), encoder.length());
+  S2Error error;
+  auto factory = s2shapeutil::ParallelFullDecodeShapeFactory(&decoder, 2,
+                                                             error);
+  EXPECT_FALSE(error.ok());
+  EXPECT_EQ(0, factory.size());
+}
+
 TEST(DecodeTaggedShapes, DecodeFromByteString) {
   auto index = s2textformat::MakeIndexOrDie(
       "0:0 | 0:1 # 1:1, 1:2, 1:3 # 2:2; 2:3, 2:4, 3:3");
@@ -121,6 +261,235 @@ TEST(DecodeTaggedShapes, DecodeFromEncoded) {
   ASSERT_EQ(lazy_shape->type_tag(), S2PointVectorShape::kTypeTag);
 }
 
+// A BlockFetcher that reads from a string and counts the fetches.
+class StringBlockFetcher : public BlockFetcher {
+ public:
+  explicit StringBlockFetcher(string data) : data_(std::move(data)) {}
+
+  bool Fetch(uint64 offset, uint64 length, string* data) const override {
+    ++num_fetches_;
+    if (offset > data_.size() || length > data_.size() - offset) return false;
+    data->assign(data_, offset, length);
+    return true;
+  }
+
+  int num_fetches() const { return num_fetches_; }
+
+ private:
+  string data_;
+  mutable std::atomic<int> num_fetches_{0};
+};
+
+TEST(ChunkedTaggedShapeFactory, FetchesOnlyRequestedChunks) {
+  auto index = s2textformat::MakeIndexOrDie(
+      "0:0 | 0:1 | 0:2 # 1:1, 1:2, 1:3 | 2:1, 2:2 # 2:2; 2:3, 2:4, 3:3 | "
+      "5:5, 5:6, 6:6");
+  index->Add(make_unique<S2LaxPolylineShape>(
+      s2textformat::ParsePointsOrDie("7:7, 7:8, 8:8")));
+  index->Release(2);  // Removed shapes are encoded as zero bytes.
+  Encoder encoder;
+  ASSERT_TRUE(CompactEncodeChunkedTaggedShapes(*index, &encoder, 2));
+  auto fetcher = make_shared<StringBlockFetcher>(
+      string(encoder.base(), encoder.length()));
+
+  S2Error error;
+  ChunkedTaggedShapeFactory factory =
+      LazyDecodeChunkedShapeFactory(fetcher, error);
+  ASSERT_TRUE(error.ok()) << error;
+  ASSERT_EQ(index->num_shape_ids(), factory.size());
+  EXPECT_EQ(3, factory.num_chunks());
+  EXPECT_EQ(0, factory.num_fetched_chunks());
+
+  // Decoding a shape fetches only its own chunk, and only once.
+  int header_fetches = fetcher->num_fetches();
+  auto shape = factory[4];
+  ASSERT_NE(shape, nullptr);
+  EXPECT_EQ(S2LaxPolygonShape::kTypeTag, shape->type_tag());
+  s2testing::ExpectEqual(*index->shape(4), *shape);
+  EXPECT_EQ(1, factory.num_fetched_chunks());
+  auto clone = factory.Clone();
+  s2testing::ExpectEqual(*index->shape(5), *(*clone)[5]);
+  EXPECT_EQ(header_fetches + 1, fetcher->num_fetches());
+
+  EXPECT_EQ(nullptr, factory[2]);
+  for (int id = 0; id < factory.size(); ++id) {
+    if (id == 2) continue;
+    s2testing::ExpectEqual(*index->shape(id), *factory[id]);
+  }
+  EXPECT_EQ(3, factory.num_fetched_chunks());
+  EXPECT_EQ(header_fetches + 3, fetcher->num_fetches());
+}
+
+TEST(ChunkedTaggedShapeFactory, DecodesIndex) {
+  auto index = s2textformat::MakeIndexOrDie(
+      "0:0 | 0:1 # 1:1, 1:2, 1:3 # 2:2; 2:3, 2:4, 3:3");
+  Encoder encoder;
+  ASSERT_TRUE(FastEncodeChunkedTaggedShapes(*index, &encoder));
+  Encoder index_encoder;
+  index->Encode(&index_encoder);
+
+  // The shapes are typically stored separately from the index, since the
+  // index is needed in full but the shapes are fetched on demand.
+  S2Error error;
+  ChunkedTaggedShapeFactory factory = FullDecodeChunkedShapeFactory(
+      make_shared<StringBlockFetcher>(string(encoder.base(), encoder.length())),
+      error);
+  ASSERT_TRUE(error.ok()) << error;
+  EXPECT_EQ(1, factory.num_chunks());
+  Decoder decoder(index_encoder.base(), index_encoder.length());
+  MutableS2ShapeIndex decoded_index;
+  ASSERT_TRUE(decoded_index.Init(&decoder, factory));
+  EXPECT_EQ(s2textformat::ToString(*index),
+            s2textformat::ToString(decoded_index));
+}
+
+TEST(ChunkedTaggedShapeFactory, TruncatedInput) {
+  auto index = s2textformat::MakeIndexOrDie(
+      "0:0 | 0:1 # 1:1, 1:2 # 3:3, 3:4, 4:4");
+  Encoder encoder;
+  ASSERT_TRUE(FastEncodeChunkedTaggedShapes(*index, &encoder, 1));
+
+  // A truncated header is reported as an error.
+  S2Error error;
+  ChunkedTaggedShapeFactory empty = FullDecodeChunkedShapeFactory(
+      make_shared<StringBlockFetcher>(string(encoder.base(), 5)), error);
+  EXPECT_EQ(S2Error::DATA_LOSS, error.code());
+  EXPECT_EQ(0, empty.size());
+
+  // Shapes whose chunks are missing are returned as nullptr.
+  error.Clear();
+  ChunkedTaggedShapeFactory factory = FullDecodeChunkedShapeFactory(
+      make_shared<StringBlockFetcher>(
+          string(encoder.base(), encoder.length() - 1)),
+      error);
+  ASSERT_TRUE(error.ok()) << error;
+  ASSERT_EQ(3, factory.size());
+  EXPECT_NE(nullptr, factory[0]);
+  EXPECT_EQ(nullptr, factory[2]);
+  EXPECT_EQ(1, factory.num_fetched_chunks());
+}
+
+// An AsyncBlockFetcher that reads from a string.  Unless "immediate" is set,
+// the fetches are queued until RunPending() is called.
+class QueuedBlockFetcher : public AsyncBlockFetcher {
+ public:
+  explicit QueuedBlockFetcher(string data) : data_(std::move(data)) {}
+
+  void FetchAsync(uint64 offset, uint64 length,
+                  FetchCallback done) const override {
+    auto fetch = [this, offset, length, done = std::move(done)]() {
+      string data;
+      bool success = fetcher_.Fetch(offset, length, &data);
+      done(success, std::move(data));
+    };
+    absl::MutexLock lock(&mutex_);
+    if (immediate_) {
+      fetch();
+    } else {
+      pending_.push_back(std::move(fetch));
+    }
+  }
+
+  void set_immediate(bool immediate) {
+    absl::MutexLock lock(&mutex_);
+    immediate_ = immediate;
+  }
+
+  int num_pending() const {
+    absl::MutexLock lock(&mutex_);
+    return pending_.size();
+  }
+
+  int num_fetches() const { return fetcher_.num_fetches(); }
+
+  void RunPending() {
+    vector<std::function<void()>> pending;
+    {
+      absl::MutexLock lock(&mutex_);
+      pending.swap(pending_);
+    }
+    for (const auto& fetch : pending) fetch();
+  }
+
+ private:
+  string data_;
+  StringBlockFetcher fetcher_{data_};
+  mutable absl::Mutex mutex_;
+  bool immediate_ ABSL_GUARDED_BY(mutex_) = false;
+  mutable vector<std::function<void()>> pending_ ABSL_GUARDED_BY(mutex_);
+};
+
+TEST(ChunkedTaggedShapeFactory, PrefetchIssuesConcurrentFetches) {
+  auto index = s2textformat::MakeIndexOrDie(
+      "0:0 # 1:1, 1:2 | 2:1, 2:2 | 3:1, 3:2 | 4:1, 4:2 # 5:5, 5:6, 6:6");
+  Encoder encoder;
+  ASSERT_TRUE(CompactEncodeChunkedTaggedShapes(*index, &encoder, 2));
+  auto fetcher = make_shared<QueuedBlockFetcher>(
+      string(encoder.base(), encoder.length()));
+
+  // The header is fetched synchronously by the constructor.
+  fetcher->set_immediate(true);
+  S2Error error;
+  ChunkedTaggedShapeFactory factory =
+      LazyDecodeChunkedShapeFactory(fetcher, error);
+  ASSERT_TRUE(error.ok()) << error;
+  ASSERT_EQ(6, factory.size());
+  fetcher->set_immediate(false);
+
+  // Both chunks are requested before either fetch completes.
+  int num_done = 0;
+  factory.Prefetch(vector<int>{5, 0, 4}, [&num_done]() { ++num_done; });
+  EXPECT_EQ(2, fetcher->num_pending());
+  factory.Prefetch(vector<int>{1}, [&num_done]() { ++num_done; });
+  EXPECT_EQ(2, fetcher->num_pending());
+  EXPECT_EQ(0, num_done);
+  fetcher->RunPending();
+  EXPECT_EQ(2, num_done);
+  EXPECT_EQ(2, factory.num_fetched_chunks());
+
+  // Prefetched shapes are decoded without further fetches.
+  int num_fetches = fetcher->num_fetches();
+  factory.Prefetch(vector<int>{4}, [&num_done]() { ++num_done; });
+  EXPECT_EQ(3, num_done);
+  for (int id : {0, 1, 4, 5}) {
+    s2testing::ExpectEqual(*index->shape(id), *factory[id]);
+  }
+  EXPECT_EQ(num_fetches, fetcher->num_fetches());
+
+  // The synchronous API waits for the fetch.
+  fetcher->set_immediate(true);
+  s2testing::ExpectEqual(*index->shape(2), *factory[2]);
+  EXPECT_EQ(num_fetches + 1, fetcher->num_fetches());
+}
+
+TEST(ChunkedTaggedShapeFactory, PrefetchIndexCells) {
+  auto index = s2textformat::MakeIndexOrDie(
+      "# 0:0, 0:1 | 0:90, 0:91 | 0:179, 0:178 | -80:0, -81:0 #");
+  Encoder encoder;
+  ASSERT_TRUE(FastEncodeChunkedTaggedShapes(*index, &encoder, 1));
+  Encoder index_encoder;
+  index->Encode(&index_encoder);
+
+  S2Error error;
+  ChunkedTaggedShapeFactory factory = LazyDecodeChunkedShapeFactory(
+      make_shared<StringBlockFetcher>(string(encoder.base(), encoder.length())),
+      error);
+  ASSERT_TRUE(error.ok()) << error;
+  Decoder decoder(index_encoder.base(), index_encoder.length());
+  EncodedS2ShapeIndex encoded_index;
+  ASSERT_TRUE(encoded_index.Init(&decoder, factory));
+
+  // The shapes are on different cube faces, so prefetching a cell near one
+  // of them fetches only its chunk.
+  bool done = false;
+  S2CellUnion cells({S2CellId(S2LatLng::FromDegrees(0, 90.5)).parent(8)});
+  factory.Prefetch(encoded_index, cells, [&done]() { done = true; });
+  EXPECT_TRUE(done);
+  EXPECT_EQ(1, factory.num_fetched_chunks());
+  s2testing::ExpectEqual(*index->shape(1), *encoded_index.shape(1));
+  EXPECT_EQ(1, factory.num_fetched_chunks());
+}
+
 TEST(SingletonShapeFactory, S2Polygon) {
   auto polygon = s2textformat::MakePolygonOrDie("0:0, 0:1, 1:0");
   auto shape = make_unique<S2Polygon::Shape>(polygon.get());
@@ -0,0 +1,276 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2shapeutil_columnar.h"
+
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/log/absl_check.h"
+#include "absl/types/span.h"
+#include "s2/base/types.h"
+#include "s2/s2error.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2lax_polyline_shape.h"
+#include "s2/s2point.h"
+#include "s2/s2point_span.h"
+#include "s2/s2point_vector_shape.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+
+namespace s2shapeutil {
+
+using absl::Span;
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Holds the loop starts of a LoopStartsLaxPolygonView.  This is a separate
+// base class so that it is constructed before S2LaxPolygonView.
+struct LoopStartsHolder {
+  vector<uint32> loop_starts;
+};
+
+// An S2LaxPolygonView that owns its loop starts.  The loop starts must be
+// copied since the view requires them to be relative to its first vertex,
+// whereas columnar offsets are relative to the whole vertex array.  (The
+// vertices themselves are not copied.)
+class LoopStartsLaxPolygonView final : private LoopStartsHolder,
+                                       public S2LaxPolygonView {
+ public:
+  LoopStartsLaxPolygonView(S2PointSpan vertices, vector<uint32> loop_starts)
+      : LoopStartsHolder{std::move(loop_starts)},
+        S2LaxPolygonView(vertices, LoopStartsHolder::loop_starts) {}
+};
+
+// Returns true if "offsets" is a valid offset array into an array of
+// "num_elements" elements.  An empty offset array represents no items.
+bool IsValidOffsets(Span<const int32> offsets, size_t num_elements) {
+  if (offsets.empty()) return true;
+  if (offsets.front() < 0) return false;
+  for (size_t i = 1; i < offsets.size(); ++i) {
+    if (offsets[i] < offsets[i - 1]) return false;
+  }
+  return static_cast<size_t>(offsets.back()) <= num_elements;
+}
+
+// Checks that the offsets in "columns" are valid and that every polyline has
+// at most one chain.
+bool ValidateColumnar(const ColumnarShapesView& columns, S2Error* error) {
+  if (columns.dimension < 0 || columns.dimension > 2) {
+    error->Init(S2Error::INVALID_DIMENSION, "Invalid dimension: %d",
+                columns.dimension);
+    return false;
+  }
+  if (columns.dimension == 0) {
+    if (!IsValidOffsets(columns.shape_offsets, columns.vertices.size())) {
+      error->Init(S2Error::INVALID_ARGUMENT, "Invalid shape offsets");
+      return false;
+    }
+    return true;
+  }
+  if (!IsValidOffsets(columns.chain_offsets, columns.vertices.size())) {
+    error->Init(S2Error::INVALID_ARGUMENT, "Invalid chain offsets");
+    return false;
+  }
+  const size_t num_chains =
+      columns.chain_offsets.empty() ? 0 : columns.chain_offsets.size() - 1;
+  if (!IsValidOffsets(columns.shape_offsets, num_chains)) {
+    error->Init(S2Error::INVALID_ARGUMENT, "Invalid shape offsets");
+    return false;
+  }
+  if (columns.dimension == 1) {
+    for (size_t i = 1; i < columns.shape_offsets.size(); ++i) {
+      if (columns.shape_offsets[i] - columns.shape_offsets[i - 1] > 1) {
+        error->Init(S2Error::UNIMPLEMENTED,
+                    "Polyline %d has more than one chain", i - 1);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Returns the vertices of chain "i".
+S2PointSpan ChainVertices(const ColumnarShapesView& columns, int i) {
+  const int32 begin = columns.chain_offsets[i];
+  return columns.vertices.subspan(begin, columns.chain_offsets[i + 1] - begin);
+}
+
+// Calls make_shape(columns, begin, end) for each shape, where "begin" and
+// "end" are the shape's offsets, and appends the results to "shapes".
+template <class MakeShape>
+bool MakeShapes(const ColumnarShapesView& columns, const MakeShape& make_shape,
+                vector<unique_ptr<S2Shape>>* shapes, S2Error* error) {
+  if (!ValidateColumnar(columns, error)) return false;
+  if (columns.shape_offsets.empty()) return true;
+  shapes->reserve(shapes->size() + columns.shape_offsets.size() - 1);
+  for (size_t i = 1; i < columns.shape_offsets.size(); ++i) {
+    shapes->push_back(make_shape(columns, columns.shape_offsets[i - 1],
+                                 columns.shape_offsets[i]));
+  }
+  return true;
+}
+
+}  // namespace
+
+bool ExportColumnar(const S2ShapeIndex& index, int dimension,
+                    ColumnarShapes* columns, S2Error* error) {
+  ABSL_DCHECK(dimension >= 0 && dimension <= 2);
+  *columns = ColumnarShapes();
+  columns->dimension = dimension;
+
+  // Count the vertices and chains first so that the arrays can be sized
+  // exactly and overflow can be detected before anything is copied.
+  int64 num_vertices = 0, num_chains = 0;
+  for (const S2Shape* shape : index) {
+    if (shape == nullptr || shape->dimension() != dimension) continue;
+    num_chains += shape->num_chains();
+    num_vertices += shape->num_edges();
+    if (dimension == 1) num_vertices += shape->num_chains();
+  }
+  constexpr int64 kMaxOffset = std::numeric_limits<int32>::max();
+  if (num_vertices > kMaxOffset || num_chains > kMaxOffset) {
+    error->Init(S2Error::OUT_OF_RANGE,
+                "Too many vertices (%d) or chains (%d) for int32 offsets",
+                num_vertices, num_chains);
+    return false;
+  }
+  columns->x.reserve(num_vertices);
+  columns->y.reserve(num_vertices);
+  columns->z.reserve(num_vertices);
+  if (dimension > 0) {
+    columns->chain_offsets.reserve(num_chains + 1);
+    columns->chain_offsets.push_back(0);
+  }
+  columns->shape_offsets.push_back(0);
+
+  auto add_vertex = [columns](const S2Point& p) {
+    columns->x.push_back(p.x());
+    columns->y.push_back(p.y());
+    columns->z.push_back(p.z());
+  };
+  for (int id = 0; id < index.num_shape_ids(); ++id) {
+    const S2Shape* shape = index.shape(id);
+    if (shape == nullptr || shape->dimension() != dimension) continue;
+    if (dimension == 0) {
+      for (int e = 0; e < shape->num_edges(); ++e) {
+        add_vertex(shape->edge(e).v0);
+      }
+      columns->shape_offsets.push_back(columns->x.size());
+    } else {
+      for (int i = 0; i < shape->num_chains(); ++i) {
+        S2Shape::Chain chain = shape->chain(i);
+        for (int j = 0; j < chain.length; ++j) {
+          add_vertex(shape->chain_edge(i, j).v0);
+        }
+        // Polylines also include the last vertex of each chain.
+        if (dimension == 1 && chain.length > 0) {
+          add_vertex(shape->chain_edge(i, chain.length - 1).v1);
+        }
+        columns->chain_offsets.push_back(columns->x.size());
+      }
+      columns->shape_offsets.push_back(columns->chain_offsets.size() - 1);
+    }
+    columns->shape_ids.push_back(id);
+  }
+  return true;
+}
+
+S2PointSpan InterleavedXyzAsPoints(Span<const double> xyz) {
+  ABSL_DCHECK(xyz.size() % 3 == 0);
+  static_assert(sizeof(S2Point) == 3 * sizeof(double));
+  // S2Point consists of exactly three doubles (see EncodedS2PointVector).
+  return S2PointSpan(reinterpret_cast<const S2Point*>(xyz.data()),
+                     xyz.size() / 3);
+}
+
+vector<S2Point> SeparatedXyzToPoints(Span<const double> x,
+                                     Span<const double> y,
+                                     Span<const double> z) {
+  ABSL_DCHECK_EQ(x.size(), y.size());
+  ABSL_DCHECK_EQ(x.size(), z.size());
+  vector<S2Point> points(x.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    points[i] = S2Point(x[i], y[i], z[i]);
+  }
+  return points;
+}
+
+bool MakeColumnarShapeViews(const ColumnarShapesView& columns,
+                            vector<unique_ptr<S2Shape>>* shapes,
+                            S2Error* error) {
+  return MakeShapes(
+      columns,
+      [](const ColumnarShapesView& columns, int32 begin,
+         int32 end) -> unique_ptr<S2Shape> {
+        if (columns.dimension == 0) {
+          auto points = columns.vertices.subspan(begin, end - begin);
+          return make_unique<S2PointVectorShape>(
+              vector<S2Point>(points.begin(), points.end()));
+        }
+        if (columns.dimension == 1) {
+          if (begin == end) return make_unique<S2LaxPolylineView>();
+          return make_unique<S2LaxPolylineView>(ChainVertices(columns, begin));
+        }
+        if (begin == end) return make_unique<S2LaxPolygonView>();
+        if (end - begin == 1) {
+          S2PointSpan loop = ChainVertices(columns, begin);
+          return make_unique<S2LaxPolygonView>(
+              S2PointLoopSpan(loop.data(), loop.size()));
+        }
+        const int32 first = columns.chain_offsets[begin];
+        vector<uint32> loop_starts;
+        loop_starts.reserve(end - begin + 1);
+        for (int32 i = begin; i <= end; ++i) {
+          loop_starts.push_back(columns.chain_offsets[i] - first);
+        }
+        return make_unique<LoopStartsLaxPolygonView>(
+            columns.vertices.subspan(first, loop_starts.back()),
+            std::move(loop_starts));
+      },
+      shapes, error);
+}
+
+bool ImportColumnar(const ColumnarShapesView& columns,
+                    vector<unique_ptr<S2Shape>>* shapes, S2Error* error) {
+  return MakeShapes(
+      columns,
+      [](const ColumnarShapesView& columns, int32 begin,
+         int32 end) -> unique_ptr<S2Shape> {
+        if (columns.dimension == 0) {
+          auto points = columns.vertices.subspan(begin, end - begin);
+          return make_unique<S2PointVectorShape>(
+              vector<S2Point>(points.begin(), points.end()));
+        }
+        if (columns.dimension == 1) {
+          if (begin == end) return make_unique<S2LaxPolylineShape>();
+          return make_unique<S2LaxPolylineShape>(ChainVertices(columns, begin));
+        }
+        vector<S2PointSpan> loops;
+        loops.reserve(end - begin);
+        for (int32 i = begin; i < end; ++i) {
+          loops.push_back(ChainVertices(columns, i));
+        }
+        return make_unique<S2LaxPolygonShape>(Span<const S2PointSpan>(loops));
+      },
+      shapes, error);
+}
+
+}  // namespace s2shapeutil
@@ -0,0 +1,145 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+// Helper functions for exchanging shapes with columnar formats such as
+// GeoArrow (and hence Arrow and Parquet readers).  A collection of shapes of
+// one dimension is represented by a vertex array and two offset arrays:
+//
+//  - The vertices are unit-length S2Points.  They are exported as separate
+//    x, y and z arrays (GeoArrow "separated" coordinates), and imported from
+//    an S2Point array, which has the same memory layout as GeoArrow
+//    "interleaved" xyz coordinates.
+//
+//  - chain_offsets[i] is the index of the first vertex of chain "i", and
+//    chain_offsets[i+1] is one past its last vertex (GeoArrow ring or
+//    linestring offsets).  Not used for points.
+//
+//  - shape_offsets[i] is the index of the first chain of shape "i" (or of
+//    its first vertex, for points), and shape_offsets[i+1] is one past its
+//    last chain (GeoArrow geometry offsets).
+//
+// Like GeoArrow, offset arrays have one more element than the number of
+// chains or shapes and need not start at zero (e.g., for a slice of a
+// larger array).  Polygon loops follow the S2 conventions rather than the
+// GeoArrow ones: the last vertex is not a copy of the first, the interior is
+// on the left, and the full loop is represented as a chain with no
+// vertices.  So for example, the shapes
+//
+//   polygon A:  loop (a0, a1, a2)
+//   polygon B:  loops (b0, b1, b2, b3) and (c0, c1, c2)
+//
+// are represented as
+//
+//   vertices:      a0 a1 a2 b0 b1 b2 b3 c0 c1 c2
+//   chain_offsets: 0, 3, 7, 10
+//   shape_offsets: 0, 1, 3
+//
+// Importing from a vertex array does not copy the vertices when
+// MakeColumnarShapeViews() is used, so that e.g. a memory-mapped Arrow
+// buffer can be indexed directly by MutableS2ShapeIndex::Add().
+
+#ifndef S2_S2SHAPEUTIL_COLUMNAR_H_
+#define S2_S2SHAPEUTIL_COLUMNAR_H_
+
+#include <memory>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "s2/base/types.h"
+#include "s2/s2error.h"
+#include "s2/s2point.h"
+#include "s2/s2point_span.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+
+namespace s2shapeutil {
+
+// An owning columnar representation of shapes, as described above.  The
+// arrays can be copied directly into Arrow buffers.
+struct ColumnarShapes {
+  // The dimension of all the shapes (0, 1, or 2).
+  int dimension = 0;
+
+  // The vertex coordinates.
+  std::vector<double> x, y, z;
+
+  // The offsets of each chain and each shape.  Unless they are empty, both
+  // vectors start with 0.  "chain_offsets" is empty when dimension == 0.
+  std::vector<int32> chain_offsets;
+  std::vector<int32> shape_offsets;
+
+  // The S2ShapeIndex shape id of each exported shape.
+  std::vector<int32> shape_ids;
+};
+
+// A non-owning columnar representation of shapes, as described above.
+struct ColumnarShapesView {
+  // The dimension of all the shapes (0, 1, or 2).
+  int dimension = 0;
+
+  S2PointSpan vertices;
+  absl::Span<const int32> chain_offsets;  // Unused when dimension == 0.
+  absl::Span<const int32> shape_offsets;
+};
+
+// Sets "columns" to the shapes of the given dimension in "index", in
+// increasing shape id order.  Shapes of other dimensions and missing shapes
+// are skipped.  Returns false and sets "error" if the vertices or chains do
+// not fit in int32 offsets.
+bool ExportColumnar(const S2ShapeIndex& index, int dimension,
+                    ColumnarShapes* columns, S2Error* error);
+
+// Returns a view of "xyz" (which contains 3 * n doubles in GeoArrow
+// "interleaved" xyz order) as an array of n S2Points, without copying.
+//
+// REQUIRES: xyz.size() % 3 == 0
+S2PointSpan InterleavedXyzAsPoints(absl::Span<const double> xyz);
+
+// Returns the points whose coordinates are given by "x", "y" and "z"
+// (GeoArrow "separated" coordinates), which can then be passed to the
+// functions below.  This is a single pass over the data.
+//
+// REQUIRES: x.size() == y.size() && x.size() == z.size()
+std::vector<S2Point> SeparatedXyzToPoints(absl::Span<const double> x,
+                                          absl::Span<const double> y,
+                                          absl::Span<const double> z);
+
+// Appends one S2Shape per shape in "columns" to "shapes" that refers to the
+// vertices in "columns" rather than copying them.  Polylines are returned as
+// S2LaxPolylineView and polygons as S2LaxPolygonView (see those classes).
+// Points are copied into S2PointVectorShapes, since there is no point view.
+// The shapes can be passed directly to MutableS2ShapeIndex::Add().
+//
+// Returns false and sets "error" (leaving "shapes" unchanged) if the offsets
+// are invalid, or if a polyline has more than one chain (since
+// S2LaxPolylineView represents a single chain, multi-linestrings should be
+// split into separate shapes).  The vertices are not validated.
+//
+// REQUIRES: columns.vertices persists for the lifetime of the shapes.
+bool MakeColumnarShapeViews(const ColumnarShapesView& columns,
+                            std::vector<std::unique_ptr<S2Shape>>* shapes,
+                            S2Error* error);
+
+// Like MakeColumnarShapeViews(), except that the vertices are copied into
+// owning S2PointVectorShape, S2LaxPolylineShape, and S2LaxPolygonShape
+// objects, so "columns" is not needed after this function returns.
+bool ImportColumnar(const ColumnarShapesView& columns,
+                    std::vector<std::unique_ptr<S2Shape>>* shapes,
+                    S2Error* error);
+
+}  // namespace s2shapeutil
+
+#endif  // S2_S2SHAPEUTIL_COLUMNAR_H_
@@ -0,0 +1,182 @@
+// Copyright 2026 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2shapeutil_columnar.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "s2/base/types.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s2error.h"
+#include "s2/s2point.h"
+#include "s2/s2point_span.h"
+#include "s2/s2shape.h"
+#include "s2/s2text_format.h"
+
+namespace s2shapeutil {
+namespace {
+
+using std::unique_ptr;
+using std::vector;
+
+// Exports the shapes of the given dimension from "index", imports them again
+// (either as views or by copying), and checks that the result is the same.
+void TestRoundTrip(const MutableS2ShapeIndex& index, int dimension,
+                   bool views) {
+  ColumnarShapes columns;
+  S2Error error;
+  ASSERT_TRUE(ExportColumnar(index, dimension, &columns, &error)) << error;
+  vector<S2Point> vertices =
+      SeparatedXyzToPoints(columns.x, columns.y, columns.z);
+  ColumnarShapesView view{dimension, vertices, columns.chain_offsets,
+                          columns.shape_offsets};
+  vector<unique_ptr<S2Shape>> shapes;
+  if (views) {
+    ASSERT_TRUE(MakeColumnarShapeViews(view, &shapes, &error)) << error;
+  } else {
+    ASSERT_TRUE(ImportColumnar(view, &shapes, &error)) << error;
+  }
+  ASSERT_EQ(columns.shape_ids.size(), shapes.size());
+  MutableS2ShapeIndex imported;
+  for (auto& shape : shapes) imported.Add(std::move(shape));
+  EXPECT_EQ(s2textformat::ToString(index), s2textformat::ToString(imported));
+}
+
+TEST(ExportColumnar, Polygons) {
+  auto index = s2textformat::MakeIndexOrDie(
+      "# # 0:0, 0:3, 3:0; 1:1, 2:1, 1:2 | 5:5, 5:6, 6:5 | full");
+  ColumnarShapes columns;
+  S2Error error;
+  ASSERT_TRUE(ExportColumnar(*index, 2, &columns, &error)) << error;
+  EXPECT_EQ(2, columns.dimension);
+  EXPECT_EQ(9, columns.x.size());
+  EXPECT_EQ(vector<int32>({0, 3, 6, 9, 9}), columns.chain_offsets);
+  EXPECT_EQ(vector<int32>({0, 2, 3, 4}), columns.shape_offsets);
+  EXPECT_EQ(vector<int32>({0, 1, 2}), columns.shape_ids);
+  EXPECT_EQ(s2textformat::MakePointOrDie("1:1"),
+            S2Point(columns.x[3], columns.y[3], columns.z[3]));
+}
+
+TEST(ExportColumnar, SkipsOtherDimensionsAndMissingShapes) {
+  auto index = s2textformat::MakeIndexOrDie(
+      "0:0 | 1:1 # 0:0, 1:1, 2:2 | 3:3, 4:4 # 5:5, 5:6, 6:5");
+  index->Release(2);
+  ColumnarShapes columns;
+  S2Error error;
+  ASSERT_TRUE(ExportColumnar(*index, 1, &columns, &error)) << error;
+  EXPECT_EQ(vector<int32>({0, 3}), columns.chain_offsets);
+  EXPECT_EQ(vector<int32>({0, 1}), columns.shape_offsets);
+  EXPECT_EQ(vector<int32>({1}), columns.shape_ids);
+  ASSERT_TRUE(ExportColumnar(*index, 0, &columns, &error)) << error;
+  EXPECT_TRUE(columns.chain_offsets.empty());
+  EXPECT_EQ(vector<int32>({0, 2}), columns.shape_offsets);
+  EXPECT_EQ(vector<int32>({0}), columns.shape_ids);
+}
+
+TEST(ColumnarShapes, RoundTrip) {
+  auto points = s2textformat::MakeIndexOrDie("0:0 | 1:1 | 2:2 # #");
+  auto polylines =
+      s2textformat::MakeIndexOrDie("# 0:0, 1:1, 2:2 | 3:3, 4:4 | 5:5, 6:6 #");
+  auto polygons = s2textformat::MakeIndexOrDie(
+      "# # 0:0, 0:3, 3:0; 1:1, 2:1, 1:2 | 5:5, 5:6, 6:5 | empty | full");
+  for (bool views : {false, true}) {
+    TestRoundTrip(*points, 0, views);
+    TestRoundTrip(*polylines, 1, views);
+    TestRoundTrip(*polygons, 2, views);
+  }
+}
+
+TEST(MakeColumnarShapeViews, DoesNotCopyVertices) {
+  // The vertices of two polygons in GeoArrow "interleaved" xyz order.
+  vector<double> xyz;
+  for (const char* str : {"0:0", "0:3", "3:0", "1:1", "2:1", "1:2",
+                          "5:5", "5:6", "6:5"}) {
+    S2Point p = s2textformat::MakePointOrDie(str);
+    xyz.insert(xyz.end(), {p.x(), p.y(), p.z()});
+  }
+  const vector<int32> chain_offsets = {0, 3, 6, 9};
+  const vector<int32> shape_offsets = {0, 2, 3};
+  S2PointSpan vertices = InterleavedXyzAsPoints(xyz);
+  ASSERT_EQ(9, vertices.size());
+  vector<unique_ptr<S2Shape>> shapes;
+  S2Error error;
+  ASSERT_TRUE(MakeColumnarShapeViews(
+      ColumnarShapesView{2, vertices, chain_offsets, shape_offsets}, &shapes,
+      &error)) << error;
+  ASSERT_EQ(2, shapes.size());
+  EXPECT_EQ(2, shapes[0]->num_chains());
+  EXPECT_EQ(1, shapes[1]->num_chains());
+  EXPECT_EQ(vertices.data() + 3, shapes[0]->chain_vertex_span(1).data());
+  EXPECT_EQ(vertices.data() + 6, shapes[1]->chain_vertex_span(0).data());
+
+  MutableS2ShapeIndex index;
+  for (auto& shape : shapes) index.Add(std::move(shape));
+  auto expected = s2textformat::MakeIndexOrDie(
+      "# # 0:0, 0:3, 3:0; 1:1, 2:1, 1:2 | 5:5, 5:6, 6:5");
+  EXPECT_EQ(s2textformat::ToString(*expected), s2textformat::ToString(index));
+}
+
+TEST(MakeColumnarShapeViews, OffsetsNeedNotStartAtZero) {
+  // A slice containing only the second of two polylines.
+  vector<S2Point> vertices = s2textformat::ParsePointsOrDie("0:0, 1:1, 2:2");
+  const vector<int32> chain_offsets = {0, 1, 3};
+  const vector<int32> shape_offsets = {1, 2};
+  vector<unique_ptr<S2Shape>> shapes;
+  S2Error error;
+  ASSERT_TRUE(MakeColumnarShapeViews(
+      ColumnarShapesView{1, vertices, chain_offsets, shape_offsets}, &shapes,
+      &error)) << error;
+  ASSERT_EQ(1, shapes.size());
+  EXPECT_EQ(1, shapes[0]->num_edges());
+  EXPECT_EQ(vertices[1], shapes[0]->edge(0).v0);
+}
+
+TEST(ImportColumnar, InvalidOffsets) {
+  vector<S2Point> vertices = s2textformat::ParsePointsOrDie("0:0, 1:1, 2:2");
+  const vector<int32> past_end = {0, 4};
+  const vector<int32> decreasing = {0, 2, 1};
+  const vector<int32> one_shape = {0, 1};
+  vector<unique_ptr<S2Shape>> shapes;
+  S2Error error;
+  EXPECT_FALSE(ImportColumnar(ColumnarShapesView{0, vertices, {}, past_end},
+                              &shapes, &error));
+  EXPECT_EQ(S2Error::INVALID_ARGUMENT, error.code());
+  EXPECT_FALSE(ImportColumnar(
+      ColumnarShapesView{2, vertices, decreasing, one_shape}, &shapes, &error));
+  EXPECT_EQ(S2Error::INVALID_ARGUMENT, error.code());
+  EXPECT_FALSE(ImportColumnar(
+      ColumnarShapesView{3, vertices, {}, one_shape}, &shapes, &error));
+  EXPECT_EQ(S2Error::INVALID_DIMENSION, error.code());
+  EXPECT_TRUE(shapes.empty());
+}
+
+TEST(ImportColumnar, MultiChainPolylineNotSupported) {
+  vector<S2Point> vertices = s2textformat::ParsePointsOrDie("0:0, 1:1, 2:2");
+  const vector<int32> chain_offsets = {0, 2, 3};
+  const vector<int32> shape_offsets = {0, 2};
+  vector<unique_ptr<S2Shape>> shapes;
+  S2Error error;
+  EXPECT_FALSE(ImportColumnar(
+      ColumnarShapesView{1, vertices, chain_offsets, shape_offsets}, &shapes,
+      &error));
+  EXPECT_EQ(S2Error::UNIMPLEMENTED, error.code());
+}
+
+}  // namespace
+}  // namespace s2shapeutil
@@ -19,6 +19,7 @@
 
 #include "s2/s2edge_crosser.h"
 #include "s2/s2point.h"
+#include "s2/s2point_span.h"
 #include "s2/s2shape.h"
 
 namespace s2shapeutil {
@@ -31,9 +32,23 @@ bool ContainsBruteForce(const S2Shape& shape, const S2Point& point) {
 
   S2CopyingEdgeCrosser crosser(ref_point.point, point);
   bool inside = ref_point.contained;
-  for (int e = 0; e < shape.num_edges(); ++e) {
-    auto edge = shape.edge(e);
-    inside ^= crosser.EdgeOrVertexCrossing(edge.v0, edge.v1);
+  for (int i = 0, num_chains = shape.num_chains(); i < num_chains; ++i) {
+    const int n = shape.chain(i).length;
+    S2PointSpan v = shape.chain_vertex_span(i);
+    const int m = v.size();
+    if (m > 0) {
+      // Process the chain as a sequence of vertices so that each vertex is
+      // only tested once.
+      crosser.RestartAt(v[0]);
+      for (int j = 1; j <= n; ++j) {
+        inside ^= crosser.EdgeOrVertexCrossing(v[j == m ? 0 : j]);
+      }
+    } else {
+      for (int j = 0; j < n; ++j) {
+        auto edge = shape.chain_edge(i, j);
+        inside ^= crosser.EdgeOrVertexCrossing(edge.v0, edge.v1);
+      }
+    }
   }
   return inside;
 }
@@ -22,8 +22,12 @@
 #include <vector>
 
 #include "absl/log/absl_check.h"
+#include "s2/s2debug.h"
+#include "s2/s2error.h"
 #include "s2/s2loop.h"
 #include "s2/s2point.h"
+#include "s2/s2point_span.h"
+#include "s2/s2pointutil.h"
 #include "s2/s2polygon.h"
 #include "s2/s2polyline.h"
 #include "s2/s2shape.h"
@@ -70,4 +74,75 @@ unique_ptr<S2Polygon> ShapeToS2Polygon(const S2Shape& poly) {
   return output_poly;
 }
 
+// Returns true and sets "error" if loop "i" with vertices "v" fails any of
+// the checks made by S2Loop::FindValidationErrorNoIndex().
+static bool FindCheapLoopError(int i, S2PointSpan v, S2Error* error) {
+  const int n = v.size();
+  if (n < 3) {
+    error->Init(S2Error::LOOP_NOT_ENOUGH_VERTICES,
+                "Loop %d: Non-empty, non-full loops must have at least 3 "
+                "vertices", i);
+    return true;
+  }
+  for (int j = 0; j < n; ++j) {
+    if (!S2::IsUnitLength(v[j])) {
+      error->Init(S2Error::NOT_UNIT_LENGTH,
+                  "Loop %d: Vertex %d is not unit length", i, j);
+      return true;
+    }
+  }
+  for (int j = 0; j < n; ++j) {
+    const S2Point& next = v[j + 1 == n ? 0 : j + 1];
+    if (v[j] == next) {
+      error->Init(S2Error::DUPLICATE_VERTICES,
+                  "Loop %d: Edge %d is degenerate (duplicate vertex)", i, j);
+      return true;
+    }
+    if (v[j] == -next) {
+      error->Init(S2Error::ANTIPODAL_VERTICES,
+                  "Loop %d: Vertices %d and %d are antipodal", i, j,
+                  (j + 1) % n);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ShapeToS2Polygon(const S2Shape& poly, ConversionValidation validation,
+                      S2Polygon* polygon, S2Error* error) {
+  error->Clear();
+  polygon->set_s2debug_override(S2Debug::DISABLE);
+  if (poly.is_full()) {
+    polygon->Init(make_unique<S2Loop>(S2Loop::kFull(), S2Debug::DISABLE));
+    return true;
+  }
+  ABSL_DCHECK_EQ(poly.dimension(), 2);
+  vector<unique_ptr<S2Loop>> loops;
+  loops.reserve(poly.num_chains());
+  vector<S2Point> vertices;
+  for (int i = 0; i < poly.num_chains(); ++i) {
+    // chain_vertex_span() may include a copy of the first vertex at the end.
+    S2PointSpan span = poly.chain_vertex_span(i);
+    const int n = poly.chain(i).length;
+    if (span.empty() && n > 0) {
+      S2::GetChainVertices(poly, i, &vertices);
+      span = vertices;
+    }
+    span = span.first(n);
+    if (validation != ConversionValidation::NONE &&
+        FindCheapLoopError(i, span, error)) {
+      polygon->InitNested({});
+      return false;
+    }
+    loops.push_back(make_unique<S2Loop>(span, S2Debug::DISABLE));
+  }
+  polygon->InitOriented(std::move(loops));
+  if (validation == ConversionValidation::FULL &&
+      polygon->FindValidationError(error)) {
+    polygon->InitNested({});
+    return false;
+  }
+  return true;
+}
+
 }  // namespace s2shapeutil
@@ -23,6 +23,8 @@
 #include <memory>
 #include <vector>
 
+#include "s2/base/types.h"
+#include "s2/s2error.h"
 #include "s2/s2point.h"
 #include "s2/s2polygon.h"
 #include "s2/s2polyline.h"
@@ -45,6 +47,37 @@ std::unique_ptr<S2Polyline> ShapeToS2Polyline(const S2Shape& line);
 // to an S2Loop and the vector of loops is used to construct the S2Polygon.
 std::unique_ptr<S2Polygon> ShapeToS2Polygon(const S2Shape& poly);
 
+// The validation performed by the version of ShapeToS2Polygon() below.
+enum class ConversionValidation : uint8 {
+  // The input is trusted to represent a valid polygon.  Invalid input yields
+  // an invalid S2Polygon.
+  NONE,
+
+  // Only the checks that take linear time and do not need an S2ShapeIndex:
+  // every loop has at least 3 vertices, all vertices are unit length, and
+  // adjacent vertices are neither equal nor antipodal.  (These are the
+  // conditions that are most often violated by data from other formats.)
+  CHEAP,
+
+  // All the checks done by S2Polygon::FindValidationError(), including loop
+  // self-intersections, crossings between loops, and loop orientations.
+  FULL,
+};
+
+// Like the function above, but intended for converting large numbers of
+// shapes that are known or expected to be valid (e.g. when converting
+// between formats).  The S2Loops are built directly from each chain's
+// vertices (without copying them when the shape supports
+// chain_vertex_span()), with S2Debug::DISABLE so that no validation is done
+// other than what "validation" requests.  Returns false and sets "error" if
+// validation fails, in which case "polygon" is left empty.
+//
+// The nesting algorithm and indexing mode of "polygon" are preserved (see
+// S2Polygon::set_nesting_algorithm), but its s2debug override is set to
+// S2Debug::DISABLE.
+bool ShapeToS2Polygon(const S2Shape& poly, ConversionValidation validation,
+                      S2Polygon* polygon, S2Error* error);
+
 }  // namespace s2shapeutil
 
 #endif  // S2_S2SHAPEUTIL_CONVERSION_H_
@@ -23,6 +23,7 @@
 
 #include <gtest/gtest.h>
 #include "absl/types/span.h"
+#include "s2/s2error.h"
 #include "s2/s2lax_polygon_shape.h"
 #include "s2/s2lax_polyline_shape.h"
 #include "s2/s2loop.h"
@@ -148,4 +149,50 @@ TEST(S2ShapeConversionUtilTest, FullPolygonToS2Polygon) {
 }
 
 }  // namespace
+TEST(S2ShapeConversionUtilTest, ShapeToS2PolygonWithValidation) {
+  auto lax_polygon = s2textformat::MakeLaxPolygonOrDie(
+      "0:0, 0:10, 10:10, 10:0; 4:4, 6:4, 6:6, 4:6");
+  unique_ptr<S2Polygon> expected = ShapeToS2Polygon(*lax_polygon);
+  for (auto validation :
+       {ConversionValidation::NONE, ConversionValidation::CHEAP,
+        ConversionValidation::FULL}) {
+    S2Polygon polygon;
+    S2Error error;
+    ASSERT_TRUE(ShapeToS2Polygon(*lax_polygon, validation, &polygon, &error))
+        << error.text();
+    EXPECT_TRUE(polygon.Equals(*expected));
+    EXPECT_TRUE(polygon.IsValid());
+  }
+
+  auto full = s2textformat::MakeLaxPolygonOrDie("full");
+  S2Polygon polygon;
+  S2Error error;
+  ASSERT_TRUE(ShapeToS2Polygon(*full, ConversionValidation::FULL, &polygon,
+                               &error));
+  EXPECT_TRUE(polygon.is_full());
+}
+
+TEST(S2ShapeConversionUtilTest, ShapeToS2PolygonValidationErrors) {
+  // A loop with a duplicate vertex is caught by the cheap checks.
+  auto duplicate = s2textformat::MakeLaxPolygonOrDie("0:0, 0:1, 0:1, 1:1");
+  S2Polygon polygon;
+  S2Error error;
+  EXPECT_TRUE(ShapeToS2Polygon(*duplicate, ConversionValidation::NONE,
+                               &polygon, &error));
+  EXPECT_FALSE(polygon.IsValid());
+  EXPECT_FALSE(ShapeToS2Polygon(*duplicate, ConversionValidation::CHEAP,
+                                &polygon, &error));
+  EXPECT_EQ(error.code(), S2Error::DUPLICATE_VERTICES);
+  EXPECT_TRUE(polygon.is_empty());
+
+  // Crossing loops are only caught by the full checks.
+  auto crossing = s2textformat::MakeLaxPolygonOrDie(
+      "0:0, 0:2, 2:2, 2:0; 1:1, 1:3, 3:3, 3:1");
+  EXPECT_TRUE(ShapeToS2Polygon(*crossing, ConversionValidation::CHEAP,
+                               &polygon, &error));
+  EXPECT_FALSE(ShapeToS2Polygon(*crossing, ConversionValidation::FULL,
+                                &polygon, &error));
+  EXPECT_TRUE(polygon.is_empty());
+}
+
 }  // namespace s2shapeutil
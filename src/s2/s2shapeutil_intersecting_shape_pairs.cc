@@ -0,0 +1,380 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2shapeutil_intersecting_shape_pairs.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/container/inlined_vector.h"
+#include "absl/functional/function_ref.h"
+#include "absl/types/span.h"
+#include "s2/s1chord_angle.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_iterator_join.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2edge_crosser.h"
+#include "s2/s2edge_distances.h"
+#include "s2/s2point.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+
+using std::pair;
+using std::vector;
+
+namespace s2shapeutil {
+namespace internal {
+
+void ForEachRange(int n, int num_threads,
+                  absl::FunctionRef<void(int thread, int begin, int end)> fn) {
+  if (num_threads <= 1) {
+    fn(0, 0, n);
+    return;
+  }
+  vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (int t = 0; t < num_threads; ++t) {
+    int begin = static_cast<int64_t>(n) * t / num_threads;
+    int end = static_cast<int64_t>(n) * (t + 1) / num_threads;
+    threads.emplace_back([fn, t, begin, end]() { fn(t, begin, end); });
+  }
+  for (auto& thread : threads) thread.join();
+}
+
+}  // namespace internal
+
+namespace {
+
+using internal::ForEachRange;
+
+// A shape pair (a_shape_id, b_shape_id) packed into 64 bits so that pairs
+// sort in the order that they are visited.
+using PairKey = uint64_t;
+
+inline PairKey MakePairKey(int a_shape_id, int b_shape_id) {
+  return (static_cast<PairKey>(a_shape_id) << 32) |
+         static_cast<uint32_t>(b_shape_id);
+}
+
+using PairSet = absl::flat_hash_set<PairKey>;
+
+// Returns true if "shape" is a polygon that contains the entire sphere.
+bool IsFullPolygon(const S2Shape& shape) {
+  return shape.dimension() == 2 && shape.num_edges() == 0 &&
+         shape.GetReferencePoint().contained;
+}
+
+// Adds the pairs in which a vertex of some chain of a shape in "index"
+// (which is A if "swapped" is false, otherwise B) is contained by a shape of
+// "other_index".  Only shapes in [begin, end) of "index" are considered.
+//
+// If two shapes intersect but no pair of their edges intersects, then every
+// chain of one shape is contained by the other shape (or one of the shapes
+// has no edges), so it suffices to test one vertex per chain.
+void AddContainedChainPairs(const S2ShapeIndex& index,
+                            const S2ShapeIndex& other_index, bool swapped,
+                            int begin, int end, PairSet* pairs) {
+  auto query = MakeS2ContainsPointQuery(
+      &other_index, S2ContainsPointQueryOptions(S2VertexModel::CLOSED));
+  for (int id = begin; id < end; ++id) {
+    const S2Shape* shape = index.shape(id);
+    if (shape == nullptr) continue;
+    for (int c = 0; c < shape->num_chains(); ++c) {
+      if (shape->chain(c).length == 0) continue;
+      query.VisitContainingShapeIds(
+          shape->chain_edge(c, 0).v0, [&](int other_id) {
+            pairs->insert(swapped ? MakePairKey(other_id, id)
+                                  : MakePairKey(id, other_id));
+            return true;
+          });
+    }
+  }
+}
+
+// The edges of one clipped shape within an index cell.
+struct ClippedEdges {
+  int shape_id;
+  absl::InlinedVector<S2Shape::Edge, 8> edges;
+};
+using CellEdges = absl::InlinedVector<ClippedEdges, 4>;
+
+void GetCellEdges(const S2ShapeIndex& index, const S2ShapeIndexCell& cell,
+                  CellEdges* cell_edges) {
+  cell_edges->clear();
+  for (int s = 0; s < cell.num_clipped(); ++s) {
+    const S2ClippedShape& clipped = cell.clipped(s);
+    if (clipped.num_edges() == 0) continue;
+    const S2Shape& shape = *index.shape(clipped.shape_id());
+    cell_edges->push_back({clipped.shape_id(), {}});
+    auto& edges = cell_edges->back().edges;
+    for (int i = 0; i < clipped.num_edges(); ++i) {
+      edges.push_back(shape.edge(clipped.edge(i)));
+    }
+  }
+}
+
+// Returns true if any edge in "a_edges" crosses or shares a vertex with any
+// edge in "b_edges" (if "distance" is zero), or is closer than "distance" to
+// any edge in "b_edges" (otherwise).
+bool AnyEdgesWithinDistance(const ClippedEdges& a_edges,
+                            const ClippedEdges& b_edges,
+                            S1ChordAngle distance) {
+  if (distance != S1ChordAngle::Zero()) {
+    for (const S2Shape::Edge& a : a_edges.edges) {
+      for (const S2Shape::Edge& b : b_edges.edges) {
+        if (S2::IsEdgePairDistanceLess(a.v0, a.v1, b.v0, b.v1, distance)) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+  for (const S2Shape::Edge& a : a_edges.edges) {
+    S2EdgeCrosser crosser(&a.v0, &a.v1);
+    for (const S2Shape::Edge& b : b_edges.edges) {
+      if (crosser.c() == nullptr || *crosser.c() != b.v0) {
+        crosser.RestartAt(&b.v0);
+      }
+      if (crosser.CrossingSign(&b.v1) >= 0) return true;
+    }
+  }
+  return false;
+}
+
+// Converts a sorted vector of distinct pairs to compressed sparse row format.
+void ToCompressedSparseRows(absl::Span<const PairKey> keys, int num_rows,
+                            vector<int>* row_offsets, vector<int>* columns) {
+  row_offsets->assign(num_rows + 1, 0);
+  columns->clear();
+  columns->reserve(keys.size());
+  for (PairKey key : keys) {
+    ++(*row_offsets)[(key >> 32) + 1];
+    columns->push_back(static_cast<uint32_t>(key));
+  }
+  for (int i = 0; i < num_rows; ++i) {
+    (*row_offsets)[i + 1] += (*row_offsets)[i];
+  }
+}
+
+// Finds the pairs of shapes that intersect (if "distance" is zero) or whose
+// distance is less than "distance" (otherwise).
+void FindShapePairs(const S2ShapeIndex& a_index, const S2ShapeIndex& b_index,
+                    S1ChordAngle distance, vector<int>* row_offsets,
+                    vector<int>* b_shape_ids, int num_threads) {
+  num_threads = std::max(num_threads, 1);
+  vector<PairSet> thread_pairs(num_threads);
+
+  // First find the pairs where a chain of one shape is contained by the
+  // other shape.  This is done first because it is cheap (one point query
+  // per chain) and it lets the second pass skip many edge comparisons.
+  ForEachRange(a_index.num_shape_ids(), num_threads,
+               [&](int t, int begin, int end) {
+                 AddContainedChainPairs(a_index, b_index, false, begin, end,
+                                        &thread_pairs[t]);
+               });
+  ForEachRange(b_index.num_shape_ids(), num_threads,
+               [&](int t, int begin, int end) {
+                 AddContainedChainPairs(b_index, a_index, true, begin, end,
+                                        &thread_pairs[t]);
+               });
+  PairSet contained_pairs = std::move(thread_pairs[0]);
+  for (int t = 1; t < num_threads; ++t) {
+    contained_pairs.insert(thread_pairs[t].begin(), thread_pairs[t].end());
+    thread_pairs[t].clear();
+  }
+  thread_pairs[0].clear();
+
+  // Two full polygons intersect even though neither one has any vertices.
+  vector<int> a_full, b_full;
+  for (int id = 0; id < a_index.num_shape_ids(); ++id) {
+    const S2Shape* shape = a_index.shape(id);
+    if (shape != nullptr && IsFullPolygon(*shape)) a_full.push_back(id);
+  }
+  for (int id = 0; id < b_index.num_shape_ids(); ++id) {
+    const S2Shape* shape = b_index.shape(id);
+    if (shape != nullptr && IsFullPolygon(*shape)) b_full.push_back(id);
+  }
+  for (int a_id : a_full) {
+    for (int b_id : b_full) contained_pairs.insert(MakePairKey(a_id, b_id));
+  }
+
+  // Now join the two indexes and collect every pair of index cells that both
+  // have edges and overlap (or are within "distance" of each other).  This is
+  // cheap compared to testing the edges, so it is done by a single thread.
+  vector<pair<const S2ShapeIndexCell*, const S2ShapeIndexCell*>> cell_pairs;
+  MakeS2CellIteratorJoin(&a_index, &b_index, distance)
+      .Join([&cell_pairs](const S2ShapeIndex::Iterator& ai,
+                          const S2ShapeIndex::Iterator& bi) {
+        if (ai.cell().num_edges() > 0 && bi.cell().num_edges() > 0) {
+          cell_pairs.emplace_back(&ai.cell(), &bi.cell());
+        }
+        return true;
+      });
+
+  // Test the edges of each pair of nearby cells.  The cell pairs are in
+  // S2CellId order, so each thread handles a contiguous range of cells.
+  ForEachRange(static_cast<int>(cell_pairs.size()), num_threads,
+               [&](int t, int begin, int end) {
+                 PairSet& pairs = thread_pairs[t];
+                 CellEdges a_edges, b_edges;
+                 for (int i = begin; i < end; ++i) {
+                   GetCellEdges(a_index, *cell_pairs[i].first, &a_edges);
+                   GetCellEdges(b_index, *cell_pairs[i].second, &b_edges);
+                   for (const ClippedEdges& a : a_edges) {
+                     for (const ClippedEdges& b : b_edges) {
+                       PairKey key = MakePairKey(a.shape_id, b.shape_id);
+                       if (contained_pairs.contains(key) ||
+                           pairs.contains(key)) {
+                         continue;
+                       }
+                       if (AnyEdgesWithinDistance(a, b, distance)) {
+                         pairs.insert(key);
+                       }
+                     }
+                   }
+                 }
+               });
+
+  // Merge the pairs (which are distinct within each set but not between
+  // sets) and convert them to compressed sparse row format.
+  vector<PairKey> keys(contained_pairs.begin(), contained_pairs.end());
+  for (const PairSet& pairs : thread_pairs) {
+    keys.insert(keys.end(), pairs.begin(), pairs.end());
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  ToCompressedSparseRows(keys, a_index.num_shape_ids(), row_offsets,
+                         b_shape_ids);
+}
+
+// Visits the pairs in the given compressed sparse row representation.
+bool VisitPairs(const vector<int>& row_offsets, const vector<int>& b_shape_ids,
+                const ShapePairVisitor& visitor) {
+  for (int a_id = 0; a_id + 1 < static_cast<int>(row_offsets.size()); ++a_id) {
+    for (int i = row_offsets[a_id]; i < row_offsets[a_id + 1]; ++i) {
+      if (!visitor(a_id, b_shape_ids[i])) return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+void FindIntersectingShapePairs(const S2ShapeIndex& a_index,
+                                const S2ShapeIndex& b_index,
+                                vector<int>* row_offsets,
+                                vector<int>* b_shape_ids, int num_threads) {
+  FindShapePairs(a_index, b_index, S1ChordAngle::Zero(), row_offsets,
+                 b_shape_ids, num_threads);
+}
+
+bool VisitIntersectingShapePairs(const S2ShapeIndex& a_index,
+                                 const S2ShapeIndex& b_index,
+                                 const ShapePairVisitor& visitor,
+                                 int num_threads) {
+  vector<int> row_offsets, b_shape_ids;
+  FindIntersectingShapePairs(a_index, b_index, &row_offsets, &b_shape_ids,
+                             num_threads);
+  return VisitPairs(row_offsets, b_shape_ids, visitor);
+}
+
+void FindShapePairsWithinDistance(const S2ShapeIndex& a_index,
+                                  const S2ShapeIndex& b_index,
+                                  S1ChordAngle distance,
+                                  vector<int>* row_offsets,
+                                  vector<int>* b_shape_ids, int num_threads) {
+  if (!(S1ChordAngle::Zero() < distance)) {
+    row_offsets->assign(a_index.num_shape_ids() + 1, 0);
+    b_shape_ids->clear();
+    return;
+  }
+  FindShapePairs(a_index, b_index, distance, row_offsets, b_shape_ids,
+                 num_threads);
+}
+
+bool VisitShapePairsWithinDistance(const S2ShapeIndex& a_index,
+                                   const S2ShapeIndex& b_index,
+                                   S1ChordAngle distance,
+                                   const ShapePairVisitor& visitor,
+                                   int num_threads) {
+  vector<int> row_offsets, b_shape_ids;
+  FindShapePairsWithinDistance(a_index, b_index, distance, &row_offsets,
+                               &b_shape_ids, num_threads);
+  return VisitPairs(row_offsets, b_shape_ids, visitor);
+}
+
+namespace internal {
+
+void FindPointShapePairsWithinDistance(
+    absl::Span<const S2Point> points,
+    absl::Span<const pair<S2CellId, const S2ShapeIndexCell*>> candidates,
+    const S2ShapeIndex& index, S1ChordAngle distance, int num_threads,
+    vector<int>* row_offsets, vector<int>* shape_ids) {
+  const int num_points = points.size();
+  num_threads = std::max(1, std::min(num_threads, num_points));
+  vector<vector<PairKey>> thread_keys(num_threads);
+  ForEachRange(num_points, num_threads, [&](int t, int begin, int end) {
+    auto query = MakeS2ContainsPointQuery(
+        &index, S2ContainsPointQueryOptions(S2VertexModel::CLOSED));
+    vector<PairKey>& keys = thread_keys[t];
+    for (int i = begin; i < end; ++i) {
+      const S2Point& point = points[i];
+      size_t first = keys.size();
+      // Polygons that contain the point are at distance zero.
+      query.VisitContainingShapeIds(point, [&](int shape_id) {
+        keys.push_back(MakePairKey(i, shape_id));
+        return true;
+      });
+      // Otherwise test the edges of the candidate cells near the point.
+      S2CellId id(point);
+      auto it = std::lower_bound(
+          candidates.begin(), candidates.end(), id,
+          [](const pair<S2CellId, const S2ShapeIndexCell*>& candidate,
+             S2CellId id) { return candidate.first < id; });
+      for (; it != candidates.end() && it->first == id; ++it) {
+        const S2ShapeIndexCell& cell = *it->second;
+        for (int s = 0; s < cell.num_clipped(); ++s) {
+          const S2ClippedShape& clipped = cell.clipped(s);
+          const S2Shape& shape = *index.shape(clipped.shape_id());
+          for (int j = 0; j < clipped.num_edges(); ++j) {
+            S2Shape::Edge edge = shape.edge(clipped.edge(j));
+            if (S2::IsDistanceLess(point, edge.v0, edge.v1, distance)) {
+              keys.push_back(MakePairKey(i, clipped.shape_id()));
+              break;
+            }
+          }
+        }
+      }
+      std::sort(keys.begin() + first, keys.end());
+      keys.erase(std::unique(keys.begin() + first, keys.end()), keys.end());
+    }
+  });
+  // Each thread's keys are sorted, and the threads handle consecutive
+  // ranges of points, so concatenating them yields sorted keys.
+  vector<PairKey> keys;
+  for (const vector<PairKey>& k : thread_keys) {
+    keys.insert(keys.end(), k.begin(), k.end());
+  }
+  ToCompressedSparseRows(keys, num_points, row_offsets, shape_ids);
+}
+
+}  // namespace internal
+
+}  // namespace s2shapeutil
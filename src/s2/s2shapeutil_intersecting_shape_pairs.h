@@ -0,0 +1,189 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2SHAPEUTIL_INTERSECTING_SHAPE_PAIRS_H_
+#define S2_S2SHAPEUTIL_INTERSECTING_SHAPE_PAIRS_H_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/types/span.h"
+#include "s2/s1chord_angle.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_iterator_join.h"
+#include "s2/s2point.h"
+#include "s2/s2point_index.h"
+#include "s2/s2shape_index.h"
+
+namespace s2shapeutil {
+
+// A function that is called with the ids of a shape from index A and a shape
+// from index B that intersect (or are within a given distance).  The function may return false in order to
+// request that no further pairs be visited.
+using ShapePairVisitor = absl::FunctionRef<bool(int a_shape_id,
+                                                int b_shape_id)>;
+
+// Visits every pair of shapes (one from "a_index" and one from "b_index")
+// that intersect, in increasing order of (a_shape_id, b_shape_id), and
+// terminates early if "visitor" returns false (in which case this function
+// returns false as well).  Each pair is visited exactly once.
+//
+// Shapes are treated as closed sets, i.e. polygons include their boundaries
+// and polylines include their endpoints, so shapes that only touch at a
+// vertex intersect.  For each pair of shapes the result is the same as
+// S2BooleanOperation::Intersects() with the CLOSED polygon and polyline
+// models, but both indexes are traversed only once (using an
+// S2CellIteratorJoin) rather than once per shape.
+//
+// The work is done in two passes.  First, every chain of each index is
+// tested for containment in the polygons of the other index (which also
+// handles shapes nested inside each other).  Second, the two indexes are
+// joined cell by cell and the edges of every pair of overlapping cells are
+// tested for crossings, skipping shape pairs that are already known to
+// intersect.  If "num_threads" > 1 then both passes are divided among that
+// many threads (the second by ranges of index cells); the results do not
+// depend on the number of threads.
+//
+// Note that all pairs are computed before the first one is visited.
+bool VisitIntersectingShapePairs(const S2ShapeIndex& a_index,
+                                 const S2ShapeIndex& b_index,
+                                 const ShapePairVisitor& visitor,
+                                 int num_threads = 1);
+
+// Like VisitIntersectingShapePairs(), but returns the pairs in compressed
+// sparse row format: the ids of the shapes in "b_index" that intersect shape
+// "i" of "a_index" are stored in increasing order in
+//
+//   (*b_shape_ids)[(*row_offsets)[i]], ..., (*b_shape_ids)[(*row_offsets)[i+1] - 1]
+//
+// where "row_offsets" has a_index.num_shape_ids() + 1 entries.
+void FindIntersectingShapePairs(const S2ShapeIndex& a_index,
+                                const S2ShapeIndex& b_index,
+                                std::vector<int>* row_offsets,
+                                std::vector<int>* b_shape_ids,
+                                int num_threads = 1);
+
+// Like VisitIntersectingShapePairs(), but visits every pair of shapes whose
+// distance is less than "distance".  (Shapes are still treated as closed
+// sets, so a polygon is at distance zero from the shapes that it contains.)
+// Visits nothing if "distance" is zero or negative.
+//
+// Candidate pairs of index cells are found by a tolerant S2CellIteratorJoin,
+// which pairs every cell of "a_index" with the cells of "b_index" that are
+// within "distance" of it, and the edges of each candidate pair are then
+// tested using S2::IsEdgePairDistanceLess().  This is much faster than
+// running an S2ClosestEdgeQuery for every shape when both indexes contain
+// many shapes.
+bool VisitShapePairsWithinDistance(const S2ShapeIndex& a_index,
+                                   const S2ShapeIndex& b_index,
+                                   S1ChordAngle distance,
+                                   const ShapePairVisitor& visitor,
+                                   int num_threads = 1);
+
+// Like VisitShapePairsWithinDistance(), but returns the pairs in the
+// compressed sparse row format described for FindIntersectingShapePairs().
+void FindShapePairsWithinDistance(const S2ShapeIndex& a_index,
+                                  const S2ShapeIndex& b_index,
+                                  S1ChordAngle distance,
+                                  std::vector<int>* row_offsets,
+                                  std::vector<int>* b_shape_ids,
+                                  int num_threads = 1);
+
+// Visits every pair consisting of a point of "a_index" and a shape of
+// "b_index" whose distance is less than "distance", and terminates early if
+// "visitor" returns false (in which case this function returns false as
+// well).  "visitor" is called as
+//
+//   bool visitor(const S2Point& point, const Data& data, int shape_id)
+//
+// Pairs are visited in S2PointIndex order, and for each point in increasing
+// order of shape id.  Visits nothing if "distance" is zero or negative.
+template <class Data, class Visitor>
+bool VisitPointShapePairsWithinDistance(const S2PointIndex<Data>& a_index,
+                                        const S2ShapeIndex& b_index,
+                                        S1ChordAngle distance,
+                                        Visitor visitor, int num_threads = 1);
+
+//////////////////   Implementation details follow   ////////////////////
+
+namespace internal {
+
+// Calls "fn(thread, begin, end)" for "num_threads" contiguous subranges of
+// [0, n), concurrently if num_threads > 1.
+void ForEachRange(int n, int num_threads,
+                  absl::FunctionRef<void(int thread, int begin, int end)> fn);
+
+// Finds the shapes of "index" within "distance" of each of the given points,
+// and returns them in compressed sparse row format (indexed by the position
+// of the point in "points").  "candidates" is a sorted list of the index
+// cells that are within "distance" of each point's leaf cell.
+void FindPointShapePairsWithinDistance(
+    absl::Span<const S2Point> points,
+    absl::Span<const std::pair<S2CellId, const S2ShapeIndexCell*>> candidates,
+    const S2ShapeIndex& index, S1ChordAngle distance, int num_threads,
+    std::vector<int>* row_offsets, std::vector<int>* shape_ids);
+
+}  // namespace internal
+
+template <class Data, class Visitor>
+bool VisitPointShapePairsWithinDistance(const S2PointIndex<Data>& a_index,
+                                        const S2ShapeIndex& b_index,
+                                        S1ChordAngle distance,
+                                        Visitor visitor, int num_threads) {
+  if (!(S1ChordAngle::Zero() < distance)) return true;
+
+  // Find the index cells of "b_index" that are near each point's leaf cell.
+  std::vector<std::pair<S2CellId, const S2ShapeIndexCell*>> candidates;
+  MakeS2CellIteratorJoin(&a_index, &b_index, distance)
+      .Join([&candidates](const typename S2PointIndex<Data>::Iterator& ai,
+                          const S2ShapeIndex::Iterator& bi) {
+        if (bi.cell().num_edges() > 0) {
+          candidates.emplace_back(ai.id(), &bi.cell());
+        }
+        return true;
+      });
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                   candidates.end());
+
+  std::vector<S2Point> points;
+  std::vector<const typename S2PointIndex<Data>::PointData*> point_data;
+  points.reserve(a_index.num_points());
+  point_data.reserve(a_index.num_points());
+  for (typename S2PointIndex<Data>::Iterator it(&a_index); !it.done();
+       it.Next()) {
+    points.push_back(it.point());
+    point_data.push_back(&it.point_data());
+  }
+  std::vector<int> row_offsets, shape_ids;
+  internal::FindPointShapePairsWithinDistance(points, candidates, b_index,
+                                              distance, num_threads,
+                                              &row_offsets, &shape_ids);
+  for (int i = 0; i < static_cast<int>(points.size()); ++i) {
+    for (int j = row_offsets[i]; j < row_offsets[i + 1]; ++j) {
+      if (!visitor(point_data[i]->point(), point_data[i]->data(),
+                   shape_ids[j])) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace s2shapeutil
+
+#endif  // S2_S2SHAPEUTIL_INTERSECTING_SHAPE_PAIRS_H_
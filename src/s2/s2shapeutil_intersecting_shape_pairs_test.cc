@@ -0,0 +1,292 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2shapeutil_intersecting_shape_pairs.h"
+
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2boolean_operation.h"
+#include "s2/s2cap.h"
+#include "s2/s2closest_edge_query.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2lax_polyline_shape.h"
+#include "s2/s1chord_angle.h"
+#include "s2/s2point.h"
+#include "s2/s2point_index.h"
+#include "s2/s2point_vector_shape.h"
+#include "s2/s2shape.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+#include "s2/s2wrapped_shape.h"
+
+using std::make_unique;
+using std::pair;
+using std::set;
+using std::vector;
+
+namespace s2shapeutil {
+namespace {
+
+using PolygonModel = S2BooleanOperation::PolygonModel;
+using PolylineModel = S2BooleanOperation::PolylineModel;
+
+vector<pair<int, int>> GetPairs(const S2ShapeIndex& a, const S2ShapeIndex& b,
+                                int num_threads) {
+  vector<pair<int, int>> pairs;
+  VisitIntersectingShapePairs(
+      a, b,
+      [&pairs](int a_id, int b_id) {
+        pairs.emplace_back(a_id, b_id);
+        return true;
+      },
+      num_threads);
+  return pairs;
+}
+
+// Returns the pairs found by testing every pair of shapes separately.
+vector<pair<int, int>> GetPairsBruteForce(const S2ShapeIndex& a,
+                                          const S2ShapeIndex& b) {
+  S2BooleanOperation::Options options;
+  options.set_polygon_model(PolygonModel::CLOSED);
+  options.set_polyline_model(PolylineModel::CLOSED);
+  vector<pair<int, int>> pairs;
+  for (int a_id = 0; a_id < a.num_shape_ids(); ++a_id) {
+    for (int b_id = 0; b_id < b.num_shape_ids(); ++b_id) {
+      MutableS2ShapeIndex a_shape, b_shape;
+      a_shape.Add(make_unique<S2WrappedShape>(a.shape(a_id)));
+      b_shape.Add(make_unique<S2WrappedShape>(b.shape(b_id)));
+      if (S2BooleanOperation::Intersects(a_shape, b_shape, options)) {
+        pairs.emplace_back(a_id, b_id);
+      }
+    }
+  }
+  return pairs;
+}
+
+vector<pair<int, int>> GetPairsWithinDistance(const S2ShapeIndex& a,
+                                              const S2ShapeIndex& b,
+                                              S1ChordAngle distance,
+                                              int num_threads) {
+  vector<pair<int, int>> pairs;
+  VisitShapePairsWithinDistance(
+      a, b, distance,
+      [&pairs](int a_id, int b_id) {
+        pairs.emplace_back(a_id, b_id);
+        return true;
+      },
+      num_threads);
+  return pairs;
+}
+
+// Returns the ids of the shapes in "index" closer than "distance" to
+// "target", in increasing order.
+set<int> GetShapesWithinDistance(const S2ShapeIndex& index,
+                                 S2MinDistanceTarget* target,
+                                 S1ChordAngle distance) {
+  S2ClosestEdgeQuery::Options options;
+  options.set_max_distance(distance);
+  S2ClosestEdgeQuery query(&index, options);
+  set<int> shape_ids;
+  for (const auto& result : query.FindClosestEdges(target)) {
+    shape_ids.insert(result.shape_id());
+  }
+  return shape_ids;
+}
+
+// Returns the pairs within "distance" found by an S2ClosestEdgeQuery for
+// every shape of "a".
+vector<pair<int, int>> GetPairsWithinDistanceBruteForce(
+    const S2ShapeIndex& a, const S2ShapeIndex& b, S1ChordAngle distance) {
+  vector<pair<int, int>> pairs;
+  for (int a_id = 0; a_id < a.num_shape_ids(); ++a_id) {
+    MutableS2ShapeIndex a_shape;
+    a_shape.Add(make_unique<S2WrappedShape>(a.shape(a_id)));
+    S2ClosestEdgeQuery::ShapeIndexTarget target(&a_shape);
+    target.set_include_interiors(true);
+    for (int b_id : GetShapesWithinDistance(b, &target, distance)) {
+      pairs.emplace_back(a_id, b_id);
+    }
+  }
+  return pairs;
+}
+
+// Adds a random point, polyline, or polygon within "cap" to "index".  Some
+// vertices are copied from "vertices" (so that shapes touch) and all new
+// vertices are added to it.
+void AddRandomShape(const S2Cap& cap, vector<S2Point>* vertices,
+                    MutableS2ShapeIndex* index) {
+  auto random_vertex = [&]() {
+    if (!vertices->empty() && S2Testing::rnd.OneIn(4)) {
+      return (*vertices)[S2Testing::rnd.Uniform(vertices->size())];
+    }
+    vertices->push_back(S2Testing::SamplePoint(cap));
+    return vertices->back();
+  };
+  switch (S2Testing::rnd.Uniform(3)) {
+    case 0:
+      index->Add(make_unique<S2PointVectorShape>(
+          vector<S2Point>{random_vertex(), random_vertex()}));
+      break;
+    case 1:
+      index->Add(make_unique<S2LaxPolylineShape>(
+          vector<S2Point>{random_vertex(), random_vertex(), random_vertex()}));
+      break;
+    default: {
+      S1Angle radius = cap.GetRadius() * S2Testing::rnd.RandDouble();
+      vector<S2Point> loop = S2Testing::MakeRegularPoints(
+          S2Testing::SamplePoint(cap), radius, 3 + S2Testing::rnd.Uniform(5));
+      vertices->insert(vertices->end(), loop.begin(), loop.end());
+      index->Add(make_unique<S2LaxPolygonShape>(
+          vector<vector<S2Point>>{std::move(loop)}));
+      break;
+    }
+  }
+}
+
+TEST(IntersectingShapePairs, EmptyIndexes) {
+  MutableS2ShapeIndex a, b;
+  vector<int> row_offsets, b_shape_ids;
+  FindIntersectingShapePairs(a, b, &row_offsets, &b_shape_ids);
+  EXPECT_EQ(row_offsets, vector<int>{0});
+  EXPECT_TRUE(b_shape_ids.empty());
+}
+
+TEST(IntersectingShapePairs, SimpleShapes) {
+  auto a = s2textformat::MakeIndexOrDie(
+      "5:5 | 20:20 # 0:0, 0:3 # 0:0, 0:2, 2:2, 2:0");
+  auto b = s2textformat::MakeIndexOrDie(
+      "1:1 | 30:30 # 0:3, 5:5 # 10:10, 10:12, 12:12, 12:10 | full");
+  // Shape ids: a = {points, polyline, polygon}, b = {points, polyline,
+  // polygon, full polygon}.
+  vector<pair<int, int>> expected = {
+      {0, 1}, {0, 3}, {1, 1}, {1, 3}, {2, 0}, {2, 3}};
+  EXPECT_EQ(GetPairs(*a, *b, 1), expected);
+  EXPECT_EQ(GetPairsBruteForce(*a, *b), expected);
+
+  vector<int> row_offsets, b_shape_ids;
+  FindIntersectingShapePairs(*a, *b, &row_offsets, &b_shape_ids);
+  EXPECT_EQ(row_offsets, (vector<int>{0, 2, 4, 6}));
+  EXPECT_EQ(b_shape_ids, (vector<int>{1, 3, 1, 3, 0, 3}));
+}
+
+TEST(IntersectingShapePairs, StopsEarly) {
+  auto a = s2textformat::MakeIndexOrDie("# 0:0, 1:1 | 2:2, 3:3 #");
+  auto b = s2textformat::MakeIndexOrDie("# # full");
+  int num_visited = 0;
+  EXPECT_FALSE(VisitIntersectingShapePairs(*a, *b, [&](int, int) {
+    ++num_visited;
+    return false;
+  }));
+  EXPECT_EQ(num_visited, 1);
+}
+
+TEST(IntersectingShapePairs, MatchesBruteForce) {
+  S2Testing::rnd.Reset(1);
+  for (int iter = 0; iter < 20; ++iter) {
+    S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+    vector<S2Point> vertices;
+    MutableS2ShapeIndex a, b;
+    for (int i = 0; i < 15; ++i) {
+      AddRandomShape(cap, &vertices, &a);
+      AddRandomShape(cap, &vertices, &b);
+    }
+    vector<pair<int, int>> expected = GetPairsBruteForce(a, b);
+    for (int num_threads : {1, 3}) {
+      EXPECT_EQ(GetPairs(a, b, num_threads), expected)
+          << "iter = " << iter << ", num_threads = " << num_threads;
+    }
+  }
+}
+
+TEST(ShapePairsWithinDistance, SimpleShapes) {
+  auto a = s2textformat::MakeIndexOrDie("5:5 # 0:0, 0:3 #");
+  auto b = s2textformat::MakeIndexOrDie(
+      "5:7 # 0:4, 0:8 # 10:10, 10:12, 12:12, 12:10");
+  // The point 5:5 is 2 degrees from 5:7, and the polyline is 1 degree from
+  // the polyline of "b".  The polygon is far from everything.
+  EXPECT_EQ(GetPairsWithinDistance(*a, *b, S1ChordAngle::Degrees(0.5), 1),
+            (vector<pair<int, int>>{}));
+  EXPECT_EQ(GetPairsWithinDistance(*a, *b, S1ChordAngle::Degrees(1.5), 1),
+            (vector<pair<int, int>>{{1, 1}}));
+  EXPECT_EQ(GetPairsWithinDistance(*a, *b, S1ChordAngle::Degrees(2.5), 1),
+            (vector<pair<int, int>>{{0, 0}, {1, 1}}));
+
+  // A distance of zero visits nothing, even though shapes intersect.
+  vector<int> row_offsets, b_shape_ids;
+  FindShapePairsWithinDistance(*a, *a, S1ChordAngle::Zero(), &row_offsets,
+                               &b_shape_ids);
+  EXPECT_EQ(row_offsets, (vector<int>{0, 0, 0}));
+  EXPECT_TRUE(b_shape_ids.empty());
+}
+
+TEST(ShapePairsWithinDistance, MatchesBruteForce) {
+  S2Testing::rnd.Reset(2);
+  for (int iter = 0; iter < 20; ++iter) {
+    S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+    vector<S2Point> vertices;
+    MutableS2ShapeIndex a, b;
+    for (int i = 0; i < 15; ++i) {
+      AddRandomShape(cap, &vertices, &a);
+      AddRandomShape(cap, &vertices, &b);
+    }
+    S1ChordAngle distance(S1Angle::Degrees(0.2 * S2Testing::rnd.RandDouble()));
+    vector<pair<int, int>> expected =
+        GetPairsWithinDistanceBruteForce(a, b, distance);
+    for (int num_threads : {1, 3}) {
+      EXPECT_EQ(GetPairsWithinDistance(a, b, distance, num_threads), expected)
+          << "iter = " << iter << ", num_threads = " << num_threads;
+    }
+  }
+}
+
+TEST(PointShapePairsWithinDistance, MatchesBruteForce) {
+  S2Testing::rnd.Reset(3);
+  S2Cap cap(S2Testing::RandomPoint(), S1Angle::Degrees(1));
+  vector<S2Point> vertices;
+  MutableS2ShapeIndex b;
+  for (int i = 0; i < 20; ++i) AddRandomShape(cap, &vertices, &b);
+  S2PointIndex<int> a;
+  for (int i = 0; i < 100; ++i) a.Add(S2Testing::SamplePoint(cap), i);
+  S1ChordAngle distance = S1ChordAngle::Degrees(0.05);
+
+  vector<pair<int, int>> expected;
+  for (S2PointIndex<int>::Iterator it(&a); !it.done(); it.Next()) {
+    S2ClosestEdgeQuery::PointTarget target(it.point());
+    for (int shape_id : GetShapesWithinDistance(b, &target, distance)) {
+      expected.emplace_back(it.data(), shape_id);
+    }
+  }
+  ASSERT_FALSE(expected.empty());
+  for (int num_threads : {1, 3}) {
+    vector<pair<int, int>> actual;
+    EXPECT_TRUE(VisitPointShapePairsWithinDistance(
+        a, b, distance,
+        [&actual](const S2Point&, const int& data, int shape_id) {
+          actual.emplace_back(data, shape_id);
+          return true;
+        },
+        num_threads));
+    EXPECT_EQ(actual, expected) << "num_threads = " << num_threads;
+  }
+}
+
+}  // namespace
+}  // namespace s2shapeutil
@@ -0,0 +1,238 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2shapeutil_subsample_chains.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/log/absl_check.h"
+#include "s2/s1angle.h"
+#include "s2/s1interval.h"
+#include "s2/s2point.h"
+#include "s2/s2point_span.h"
+#include "s2/s2pointutil.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+#include "s2/util/math/matrix3x3.h"
+
+using std::max;
+using std::min;
+using std::vector;
+
+namespace s2shapeutil {
+
+namespace {
+
+// Given a polyline, a tolerance distance, and a start index, this function
+// returns the maximal end index such that the line segment between these two
+// vertices passes within "tolerance" of all interior vertices, in order.
+int FindEndVertex(S2PointSpan vertices, S1Angle tolerance, int index) {
+  ABSL_DCHECK_GE(tolerance.radians(), 0);
+  ABSL_DCHECK_LT(index + 1, static_cast<int>(vertices.size()));
+
+  // The basic idea is to keep track of the "pie wedge" of angles from the
+  // starting vertex such that a ray from the starting vertex at that angle
+  // will pass through the discs of radius "tolerance" centered around all
+  // vertices processed so far.
+
+  // First we define a "coordinate frame" for the tangent and normal spaces
+  // at the starting vertex.  Essentially this means picking three
+  // orthonormal vectors X,Y,Z such that X and Y span the tangent plane at
+  // the starting vertex, and Z is "up".  We use the coordinate frame to
+  // define a mapping from 3D direction vectors to a one-dimensional "ray
+  // angle" in the range (-Pi, Pi].  The angle of a direction vector is
+  // computed by transforming it into the X,Y,Z basis, and then calculating
+  // atan2(y,x).  This mapping allows us to represent a wedge of angles as a
+  // 1D interval.  Since the interval wraps around, we represent it as an
+  // S1Interval, i.e. an interval on the unit circle.
+  Matrix3x3_d frame;
+  const S2Point& origin = vertices[index];
+  S2::GetFrame(origin, &frame);
+
+  // As we go along, we keep track of the current wedge of angles and the
+  // distance to the last vertex (which must be non-decreasing).
+  S1Interval current_wedge = S1Interval::Full();
+  double last_distance = 0;
+
+  for (++index; index < vertices.size(); ++index) {
+    const S2Point& candidate = vertices[index];
+    double distance = origin.Angle(candidate);
+
+    // We don't allow simplification to create edges longer than 90 degrees,
+    // to avoid numeric instability as lengths approach 180 degrees.  (We do
+    // need to allow for original edges longer than 90 degrees, though.)
+    if (distance > M_PI/2 && last_distance > 0) break;
+
+    // Vertices must be in increasing order along the ray, except for the
+    // initial disc around the origin.
+    if (distance < last_distance && last_distance > tolerance.radians()) break;
+    last_distance = distance;
+
+    // Points that are within the tolerance distance of the origin do not
+    // constrain the ray direction, so we can ignore them.
+    if (distance <= tolerance.radians()) continue;
+
+    // If the current wedge of angles does not contain the angle to this
+    // vertex, then stop right now.  Note that the wedge of possible ray
+    // angles is not necessarily empty yet, but we can't continue unless we
+    // are willing to backtrack to the last vertex that was contained within
+    // the wedge (since we don't create new vertices).  This would be more
+    // complicated and also make the worst-case running time more than linear.
+    S2Point direction = S2::ToFrame(frame, candidate);
+    double center = atan2(direction.y(), direction.x());
+    if (!current_wedge.Contains(center)) break;
+
+    // To determine how this vertex constrains the possible ray angles,
+    // consider the triangle ABC where A is the origin, B is the candidate
+    // vertex, and C is one of the two tangent points between A and the
+    // spherical cap of radius "tolerance" centered at B.  Then from the
+    // spherical law of sines, sin(a)/sin(A) = sin(c)/sin(C), where "a" and
+    // "c" are the lengths of the edges opposite A and C.  In our case C is a
+    // 90 degree angle, therefore A = asin(sin(a) / sin(c)).  Angle A is the
+    // half-angle of the allowable wedge.
+
+    double half_angle = asin(sin(tolerance.radians()) / sin(distance));
+    S1Interval target = S1Interval::FromPoint(center).Expanded(half_angle);
+    current_wedge = current_wedge.Intersection(target);
+    ABSL_DCHECK(!current_wedge.is_empty());
+  }
+  // We break out of the loop when we reach a vertex index that can't be
+  // included in the line segment, so back up by one vertex.
+  return index - 1;
+}
+
+// Calls fn(worker, i) for all 0 <= i < n using up to "num_threads" threads,
+// where 0 <= worker < num_threads identifies the calling thread.
+template <class Fn>
+void ParallelFor(int n, int num_threads, const Fn& fn) {
+  std::atomic<int> next(0);
+  auto run = [&](int worker) {
+    for (int i; (i = next.fetch_add(1)) < n; ) fn(worker, i);
+  };
+  vector<std::thread> threads;
+  for (int i = 1; i < min(num_threads, n); ++i) threads.emplace_back(run, i);
+  run(0);
+  for (auto& thread : threads) thread.join();
+}
+
+struct ChainId {
+  const S2Shape* shape;
+  int chain_id;
+};
+
+// Copies the vertices of the given chain into "vertices", reusing its
+// capacity.
+void GetChainVertices(const ChainId& chain, vector<S2Point>* vertices) {
+  vertices->clear();
+  const int n = chain.shape->chain(chain.chain_id).length;
+  if (n == 0) return;
+  for (int i = 0; i < n; ++i) {
+    vertices->push_back(chain.shape->chain_edge(chain.chain_id, i).v0);
+  }
+  vertices->push_back(chain.shape->chain_edge(chain.chain_id, n - 1).v1);
+}
+
+// Simplifies the given chains and appends the results to "result", which
+// must already contain the initial offset.
+void SubsampleChains(absl::Span<const ChainId> chains, S1Angle tolerance,
+                     vector<S2Point>* vertices, SubsampledChains* result) {
+  for (const ChainId& chain : chains) {
+    GetChainVertices(chain, vertices);
+    SubsampleVertices(*vertices, tolerance, &result->vertex_ids);
+    result->offsets.push_back(result->vertex_ids.size());
+  }
+}
+
+void SubsampleChains(const vector<ChainId>& chains, S1Angle tolerance,
+                     const SubsampleChainsOptions& options,
+                     SubsampledChains* result) {
+  result->offsets.assign(1, 0);
+  result->vertex_ids.clear();
+  if (options.num_threads() <= 1) {
+    vector<S2Point> vertices;
+    SubsampleChains(chains, tolerance, &vertices, result);
+    return;
+  }
+  // The chains are divided into batches that are simplified independently
+  // and then concatenated in order.
+  constexpr int kBatchSize = 256;
+  const int num_batches = (chains.size() + kBatchSize - 1) / kBatchSize;
+  vector<SubsampledChains> batches(num_batches);
+  vector<vector<S2Point>> vertices(options.num_threads());
+  ParallelFor(num_batches, options.num_threads(), [&](int worker, int i) {
+    const int begin = i * kBatchSize;
+    const int end = min<int>(begin + kBatchSize, chains.size());
+    batches[i].offsets.push_back(0);
+    SubsampleChains(absl::MakeConstSpan(chains.data() + begin,
+                                        chains.data() + end),
+                    tolerance, &vertices[worker], &batches[i]);
+  });
+  result->offsets.reserve(chains.size() + 1);
+  for (const SubsampledChains& batch : batches) {
+    const int base = result->vertex_ids.size();
+    result->vertex_ids.insert(result->vertex_ids.end(),
+                              batch.vertex_ids.begin(),
+                              batch.vertex_ids.end());
+    for (int j = 1; j < batch.offsets.size(); ++j) {
+      result->offsets.push_back(base + batch.offsets[j]);
+    }
+  }
+}
+
+}  // namespace
+
+void SubsampleVertices(S2PointSpan vertices, S1Angle tolerance,
+                       vector<int>* indices) {
+  if (vertices.empty()) return;
+
+  indices->push_back(0);
+  S1Angle clamped_tolerance = max(tolerance, S1Angle::Radians(0));
+  for (int index = 0; index + 1 < vertices.size(); ) {
+    int next_index = FindEndVertex(vertices, clamped_tolerance, index);
+    // Don't create duplicate adjacent vertices.
+    if (vertices[next_index] != vertices[index]) {
+      indices->push_back(next_index);
+    }
+    index = next_index;
+  }
+}
+
+void SubsampleChains(const S2Shape& shape, S1Angle tolerance,
+                     const SubsampleChainsOptions& options,
+                     SubsampledChains* result) {
+  ABSL_DCHECK_EQ(shape.dimension(), 1);
+  vector<ChainId> chains;
+  chains.reserve(shape.num_chains());
+  for (int i = 0; i < shape.num_chains(); ++i) chains.push_back({&shape, i});
+  SubsampleChains(chains, tolerance, options, result);
+}
+
+void SubsampleChains(const S2ShapeIndex& index, S1Angle tolerance,
+                     const SubsampleChainsOptions& options,
+                     SubsampledChains* result) {
+  vector<ChainId> chains;
+  for (const S2Shape* shape : index) {
+    if (shape == nullptr || shape->dimension() != 1) continue;
+    for (int i = 0; i < shape->num_chains(); ++i) chains.push_back({shape, i});
+  }
+  SubsampleChains(chains, tolerance, options, result);
+}
+
+}  // namespace s2shapeutil
@@ -0,0 +1,90 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2SHAPEUTIL_SUBSAMPLE_CHAINS_H_
+#define S2_S2SHAPEUTIL_SUBSAMPLE_CHAINS_H_
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "s2/s1angle.h"
+#include "s2/s2point_span.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+
+namespace s2shapeutil {
+
+// Appends to "indices" a subsequence of vertex indices such that the
+// polyline connecting these vertices is never further than "tolerance" from
+// the polyline with the given vertices.  This is the algorithm used by
+// S2Polyline::SubsampleVertices(); see there for details.
+void SubsampleVertices(S2PointSpan vertices, S1Angle tolerance,
+                       std::vector<int>* indices);
+
+class SubsampleChainsOptions {
+ public:
+  // The maximum number of threads used to simplify the chains.  Chains are
+  // claimed by the threads in batches, and the results do not depend on this
+  // value.
+  //
+  // DEFAULT: 1
+  int num_threads() const { return num_threads_; }
+  void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
+ private:
+  int num_threads_ = 1;
+};
+
+// The result of simplifying a collection of chains, in compressed sparse row
+// (CSR) form.  The simplified vertices of the i-th chain are
+// vertex_ids[offsets[i]], ..., vertex_ids[offsets[i + 1] - 1], where each
+// vertex id is an offset within the chain (as for S2Shape::chain_edge(), with
+// the last vertex of a chain of length n having id n).
+struct SubsampledChains {
+  // The number of entries is one more than the number of chains.
+  std::vector<int> offsets;
+  std::vector<int> vertex_ids;
+
+  int num_chains() const { return static_cast<int>(offsets.size()) - 1; }
+
+  // Returns the simplified vertex ids of the i-th chain.
+  absl::Span<const int> chain_vertex_ids(int i) const {
+    return absl::MakeConstSpan(vertex_ids.data() + offsets[i],
+                               vertex_ids.data() + offsets[i + 1]);
+  }
+};
+
+// Simplifies every chain of the given polyline shape as though by calling
+// S2Polyline::SubsampleVertices() on the chain's vertices, and stores the
+// results in "result" (one row per chain).  Apart from the output vectors and
+// one vertex buffer per thread, no memory is allocated per chain, and the
+// capacity of the output vectors is reused if "result" is reused.
+//
+// REQUIRES: shape.dimension() == 1
+void SubsampleChains(const S2Shape& shape, S1Angle tolerance,
+                     const SubsampleChainsOptions& options,
+                     SubsampledChains* result);
+
+// Like the above, but simplifies the chains of every polyline shape in the
+// given index.  The rows of "result" consist of the chains of each shape of
+// dimension 1 in turn, in order of increasing shape id; shapes of other
+// dimensions are skipped.
+void SubsampleChains(const S2ShapeIndex& index, S1Angle tolerance,
+                     const SubsampleChainsOptions& options,
+                     SubsampledChains* result);
+
+}  // namespace s2shapeutil
+
+#endif  // S2_S2SHAPEUTIL_SUBSAMPLE_CHAINS_H_
@@ -0,0 +1,120 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2shapeutil_subsample_chains.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2lax_polygon_shape.h"
+#include "s2/s2lax_polyline_shape.h"
+#include "s2/s2point.h"
+#include "s2/s2polyline.h"
+#include "s2/s2testing.h"
+#include "s2/s2text_format.h"
+
+using std::make_unique;
+using std::unique_ptr;
+using std::vector;
+
+namespace s2shapeutil {
+namespace {
+
+// Returns a random walk with the given number of vertices.
+vector<S2Point> MakeRandomWalk(int num_vertices) {
+  vector<S2Point> vertices;
+  S2Point v = S2Testing::RandomPoint();
+  for (int i = 0; i < num_vertices; ++i) {
+    vertices.push_back(v);
+    v = S2Testing::SamplePoint(S2Cap(v, S1Angle::Degrees(0.01)));
+  }
+  return vertices;
+}
+
+TEST(SubsampleChains, EmptyShape) {
+  S2LaxPolylineShape shape;
+  SubsampledChains result;
+  SubsampleChains(shape, S1Angle::Degrees(1), SubsampleChainsOptions(),
+                  &result);
+  EXPECT_EQ(0, result.num_chains());
+  EXPECT_TRUE(result.vertex_ids.empty());
+}
+
+TEST(SubsampleChains, MatchesSubsampleVertices) {
+  S2Testing::rnd.Reset(1);
+  const S1Angle tolerance = S1Angle::Degrees(0.005);
+  vector<unique_ptr<S2Polyline>> polylines;
+  MutableS2ShapeIndex index;
+  for (int i = 0; i < 1000; ++i) {
+    polylines.push_back(make_unique<S2Polyline>(
+        MakeRandomWalk(2 + S2Testing::rnd.Uniform(50))));
+    index.Add(make_unique<S2Polyline::Shape>(polylines.back().get()));
+    if (i == 10) {
+      // Shapes of other dimensions are skipped.
+      index.Add(s2textformat::MakeLaxPolygonOrDie("0:0, 0:1, 1:0"));
+    }
+  }
+  for (int num_threads : {1, 4}) {
+    SubsampleChainsOptions options;
+    options.set_num_threads(num_threads);
+    SubsampledChains result;
+    SubsampleChains(index, tolerance, options, &result);
+    ASSERT_EQ(polylines.size(), result.num_chains());
+    for (int i = 0; i < polylines.size(); ++i) {
+      vector<int> expected;
+      polylines[i]->SubsampleVertices(tolerance, &expected);
+      EXPECT_EQ(expected, vector<int>(result.chain_vertex_ids(i).begin(),
+                                      result.chain_vertex_ids(i).end()));
+    }
+  }
+}
+
+TEST(SubsampleChains, MultipleChains) {
+  const vector<vector<S2Point>> chains = {
+      s2textformat::ParsePointsOrDie("0:0, 0:1, 0:2, 0:3"),
+      s2textformat::ParsePointsOrDie("5:5, 6:6"),
+      s2textformat::ParsePointsOrDie("1:0, 2:0, 2:0.0001, 3:0")};
+  S2LaxPolylineShape shape2(chains[1]);
+  MutableS2ShapeIndex index;
+  index.Add(make_unique<S2LaxPolylineShape>(chains[0]));
+  index.Add(make_unique<S2LaxPolylineShape>(chains[1]));
+  index.Add(make_unique<S2LaxPolylineShape>(chains[2]));
+  SubsampledChains result;
+  SubsampleChains(index, S1Angle::Degrees(0.01), SubsampleChainsOptions(),
+                  &result);
+  ASSERT_EQ(3, result.num_chains());
+  EXPECT_EQ((vector<int>{0, 3}),
+            vector<int>(result.chain_vertex_ids(0).begin(),
+                        result.chain_vertex_ids(0).end()));
+  EXPECT_EQ((vector<int>{0, 1}),
+            vector<int>(result.chain_vertex_ids(1).begin(),
+                        result.chain_vertex_ids(1).end()));
+  EXPECT_EQ((vector<int>{0, 3}),
+            vector<int>(result.chain_vertex_ids(2).begin(),
+                        result.chain_vertex_ids(2).end()));
+
+  // The results are replaced when "result" is reused.
+  SubsampleChains(shape2, S1Angle::Degrees(0.01), SubsampleChainsOptions(),
+                  &result);
+  ASSERT_EQ(1, result.num_chains());
+  EXPECT_EQ((vector<int>{0, 1}), result.vertex_ids);
+}
+
+}  // namespace
+}  // namespace s2shapeutil
@@ -21,6 +21,7 @@
 
 #include <gtest/gtest.h>
 #include "s2/s2cell_id.h"
+#include "s2/s2point_span.h"
 #include "s2/s2shape.h"
 #include "s2/s2shape_index.h"
 
@@ -42,6 +43,21 @@ void ExpectEqual(const S2Shape& a, const S2Shape& b) {
       EXPECT_EQ(a.chain_edge(i, j), b.chain_edge(i, j));
     }
   }
+  ExpectChainVertexSpansValid(a);
+  ExpectChainVertexSpansValid(b);
+}
+
+void ExpectChainVertexSpansValid(const S2Shape& shape) {
+  for (int i = 0; i < shape.num_chains(); ++i) {
+    S2PointSpan v = shape.chain_vertex_span(i);
+    if (v.empty()) continue;
+    int chain_length = shape.chain(i).length;
+    EXPECT_TRUE(v.size() == chain_length || v.size() == chain_length + 1)
+        << "chain " << i << ": " << v.size() << " vs " << chain_length;
+    for (int j = 0; j < chain_length; ++j) {
+      EXPECT_EQ(shape.chain_edge(i, j), S2Shape::ChainVertexSpanEdge(v, j));
+    }
+  }
 }
 
 // Verifies that all methods of the two S2ShapeIndexes return identical
@@ -24,9 +24,14 @@
 namespace s2testing {
 
 // Verifies that all methods of the two S2Shapes return identical results,
-// except for id() and type_tag().
+// except for id() and type_tag().  Also verifies that any non-empty spans
+// returned by chain_vertex_span() are consistent with chain_edge().
 void ExpectEqual(const S2Shape& a, const S2Shape& b);
 
+// Verifies that every non-empty span returned by shape.chain_vertex_span()
+// has the required size and defines the same edges as shape.chain_edge().
+void ExpectChainVertexSpansValid(const S2Shape& shape);
+
 // Verifies that two S2ShapeIndexes have identical contents (including all the
 // S2Shapes in both indexes).
 void ExpectEqual(const S2ShapeIndex& a, const S2ShapeIndex& b);
@@ -17,11 +17,15 @@
 
 #include "s2/s2shapeutil_visit_crossing_edge_pairs.h"
 
+#include <algorithm>
+#include <atomic>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "s2/base/types.h"
 #include "absl/container/inlined_vector.h"
+#include "absl/functional/function_ref.h"
 #include "absl/log/absl_check.h"
 #include "absl/strings/str_format.h"
 #include "s2/s2cell_id.h"
@@ -37,6 +41,7 @@
 #include "s2/s2shapeutil_shape_edge_id.h"
 #include "s2/s2wedge_relations.h"
 
+using std::min;
 using std::vector;
 using ChainPosition = S2Shape::ChainPosition;
 
@@ -330,51 +335,203 @@ bool IndexCrosser::VisitCrossings(
   return true;
 }
 
-bool VisitCrossingEdgePairs(const S2ShapeIndex& a_index,
-                            const S2ShapeIndex& b_index,
-                            CrossingType type, const EdgePairVisitor& visitor) {
-  // We look for S2CellId ranges where the indexes of A and B overlap, and
-  // then test those edges for crossings.
-
-  // TODO(b/262264880): Use brute force if the total number of edges is small
-  // enough (using a larger threshold if the S2ShapeIndex is not constructed
-  // yet).
-  auto ai = MakeS2CellRangeIterator(&a_index);
-  auto bi = MakeS2CellRangeIterator(&b_index);
+// Visits the crossing edge pairs of A and B that are found in index cells
+// with range_min() <= "last", starting from the current positions of "ai"
+// and "bi".
+static bool VisitRangeCrossingEdgePairs(
+    const S2ShapeIndex& a_index, const S2ShapeIndex& b_index,
+    CrossingType type, const EdgePairVisitor& visitor,
+    S2CellRangeIterator<S2ShapeIndex::Iterator>* ai,
+    S2CellRangeIterator<S2ShapeIndex::Iterator>* bi, S2CellId last) {
   IndexCrosser ab(a_index, b_index, type, visitor, false);  // Tests A against B
   IndexCrosser ba(b_index, a_index, type, visitor, true);   // Tests B against A
-  while (!ai.done() || !bi.done()) {
-    if (ai.range_max() < bi.range_min()) {
+  while ((!ai->done() && ai->range_min() <= last) ||
+         (!bi->done() && bi->range_min() <= last)) {
+    if (ai->range_max() < bi->range_min()) {
       // The A and B cells don't overlap, and A precedes B.
-      ai.SeekTo(bi);
-    } else if (bi.range_max() < ai.range_min()) {
+      ai->SeekTo(*bi);
+    } else if (bi->range_max() < ai->range_min()) {
       // The A and B cells don't overlap, and B precedes A.
-      bi.SeekTo(ai);
+      bi->SeekTo(*ai);
     } else {
       // One cell contains the other.  Determine which cell is larger.
-      int64 ab_relation = ai.id().lsb() - bi.id().lsb();
+      int64 ab_relation = ai->id().lsb() - bi->id().lsb();
       if (ab_relation > 0) {
         // A's index cell is larger.
-        if (!ab.VisitCrossings(&ai, &bi)) return false;
+        if (!ab.VisitCrossings(ai, bi)) return false;
       } else if (ab_relation < 0) {
         // B's index cell is larger.
-        if (!ba.VisitCrossings(&bi, &ai)) return false;
+        if (!ba.VisitCrossings(bi, ai)) return false;
       } else {
         // The A and B cells are the same.
-        if (ai.iterator().cell().num_edges() > 0 &&
-            bi.iterator().cell().num_edges() > 0) {
-          if (!ab.VisitCellCellCrossings(ai.iterator().cell(),
-                                         bi.iterator().cell()))
+        if (ai->iterator().cell().num_edges() > 0 &&
+            bi->iterator().cell().num_edges() > 0) {
+          if (!ab.VisitCellCellCrossings(ai->iterator().cell(),
+                                         bi->iterator().cell()))
             return false;
         }
-        ai.Next();
-        bi.Next();
+        ai->Next();
+        bi->Next();
       }
     }
   }
   return true;
 }
 
+bool VisitCrossingEdgePairs(const S2ShapeIndex& a_index,
+                            const S2ShapeIndex& b_index,
+                            CrossingType type, const EdgePairVisitor& visitor) {
+  // We look for S2CellId ranges where the indexes of A and B overlap, and
+  // then test those edges for crossings.
+
+  // TODO(b/262264880): Use brute force if the total number of edges is small
+  // enough (using a larger threshold if the S2ShapeIndex is not constructed
+  // yet).
+  auto ai = MakeS2CellRangeIterator(&a_index);
+  auto bi = MakeS2CellRangeIterator(&b_index);
+  return VisitRangeCrossingEdgePairs(a_index, b_index, type, visitor, &ai, &bi,
+                                S2CellId::Sentinel());
+}
+
+bool VisitCrossingEdgePairs(const S2ShapeIndex& a_index,
+                            const S2ShapeIndex& b_index,
+                            CrossingType type, S2CellId face,
+                            const EdgePairVisitor& visitor) {
+  ABSL_DCHECK(face.is_face());
+  auto ai = MakeS2CellRangeIterator(&a_index);
+  auto bi = MakeS2CellRangeIterator(&b_index);
+  ai.Seek(face.range_min());
+  bi.Seek(face.range_min());
+  return VisitRangeCrossingEdgePairs(a_index, b_index, type, visitor, &ai, &bi,
+                                face.range_max());
+}
+
+// Calls "fn(i)" for each i in [0, n) using up to "num_threads" threads.  The
+// work items are handed out in order, and the calling thread also runs them.
+template <class Fn>
+static void ParallelFor(int n, int num_threads, const Fn& fn) {
+  std::atomic<int> next(0);
+  auto run = [&]() {
+    for (int i; (i = next.fetch_add(1)) < n; ) fn(i);
+  };
+  vector<std::thread> threads;
+  for (int i = 1; i < min(num_threads, n); ++i) threads.emplace_back(run);
+  run();
+  for (auto& thread : threads) thread.join();
+}
+
+// The multi-threaded algorithms divide the index cells into ranges of
+// consecutive S2CellIds, where range "i" starts at the i-th cell at
+// kRangeLevel.
+static constexpr int kRangeLevel = 3;
+static constexpr int kNumRanges = S2CellId::kNumFaces << (2 * kRangeLevel);
+
+// Returns the first leaf cell of range "i", or S2CellId::Sentinel() if "i"
+// is kNumRanges.
+static S2CellId GetRangeStart(int i) {
+  if (i == kNumRanges) return S2CellId::Sentinel();
+  return S2CellId::Begin(kRangeLevel).advance(i).range_min();
+}
+
+// Calls "visit_range(i, range_visitor)" for every range "i" using up to
+// "num_threads" threads, where "range_visitor" passes the crossings to
+// "visitor" in the given order.
+static bool VisitRangeCrossings(
+    int num_threads, CrossingOrder order, const EdgePairVisitor& visitor,
+    absl::FunctionRef<bool(int i, const EdgePairVisitor& range_visitor)>
+        visit_range) {
+  if (order == CrossingOrder::ANY) {
+    std::atomic<bool> cancelled(false);
+    EdgePairVisitor range_visitor = [&](const ShapeEdge& a, const ShapeEdge& b,
+                                        bool is_interior) {
+      if (cancelled.load(std::memory_order_relaxed)) return false;
+      if (visitor(a, b, is_interior)) return true;
+      cancelled.store(true, std::memory_order_relaxed);
+      return false;
+    };
+    ParallelFor(kNumRanges, num_threads, [&](int i) {
+      if (!cancelled.load(std::memory_order_relaxed)) {
+        visit_range(i, range_visitor);
+      }
+    });
+    return !cancelled.load();
+  }
+  struct Crossing {
+    ShapeEdge a, b;
+    bool is_interior;
+  };
+  vector<vector<Crossing>> crossings(kNumRanges);
+  ParallelFor(kNumRanges, num_threads, [&](int i) {
+    visit_range(i, [&crossings, i](const ShapeEdge& a, const ShapeEdge& b,
+                                   bool is_interior) {
+      crossings[i].push_back({a, b, is_interior});
+      return true;
+    });
+  });
+  for (const vector<Crossing>& range_crossings : crossings) {
+    for (const Crossing& crossing : range_crossings) {
+      if (!visitor(crossing.a, crossing.b, crossing.is_interior)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool VisitCrossingEdgePairs(const S2ShapeIndex& index, CrossingType type,
+                            int num_threads, CrossingOrder order,
+                            const EdgePairVisitor& visitor) {
+  if (num_threads <= 1) return VisitCrossingEdgePairs(index, type, visitor);
+  const bool need_adjacent = (type == CrossingType::ALL);
+  return VisitRangeCrossings(
+      num_threads, order, visitor,
+      [&](int i, const EdgePairVisitor& range_visitor) {
+        // Index cells whose ids fall between two ranges are assigned to the
+        // first one, as in FindSelfIntersection().
+        const S2CellId limit = GetRangeStart(i + 1);
+        ShapeEdgeVector shape_edges;
+        S2ShapeIndex::Iterator it(&index);
+        for (it.Seek(GetRangeStart(i)); !it.done() && it.id() < limit;
+             it.Next()) {
+          GetShapeEdges(index, it.cell(), &shape_edges);
+          if (!VisitCrossings(shape_edges, type, need_adjacent,
+                              range_visitor)) {
+            return false;
+          }
+        }
+        return true;
+      });
+}
+
+bool VisitCrossingEdgePairs(const S2ShapeIndex& a_index,
+                            const S2ShapeIndex& b_index, CrossingType type,
+                            int num_threads, CrossingOrder order,
+                            const EdgePairVisitor& visitor) {
+  if (num_threads <= 1) {
+    return VisitCrossingEdgePairs(a_index, b_index, type, visitor);
+  }
+  return VisitRangeCrossings(
+      num_threads, order, visitor,
+      [&](int i, const EdgePairVisitor& range_visitor) {
+        // Index cells that span several ranges are processed by the range
+        // that contains their range_min(), so they are skipped here if they
+        // start before this range.  Such cells are processed together with
+        // all the cells of the other index that they overlap.
+        const S2CellId start = GetRangeStart(i);
+        auto ai = MakeS2CellRangeIterator(&a_index);
+        auto bi = MakeS2CellRangeIterator(&b_index);
+        ai.Seek(start);
+        if (!ai.done() && ai.range_min() < start) ai.Next();
+        bi.Seek(start);
+        if (!bi.done() && bi.range_min() < start) bi.Next();
+        const S2CellId last = (i + 1 < kNumRanges)
+                                  ? GetRangeStart(i + 1).prev()
+                                  : S2CellId::Sentinel();
+        return VisitRangeCrossingEdgePairs(a_index, b_index, type,
+                                           range_visitor, &ai, &bi, last);
+      });
+}
+
 //////////////////////////////////////////////////////////////////////
 
 // Helper function that formats a loop error message.  If the loop belongs to
@@ -466,4 +623,47 @@ bool FindSelfIntersection(const S2ShapeIndex& index, S2Error* error) {
       });
 }
 
+bool FindSelfIntersection(const S2ShapeIndex& index, int num_threads,
+                          S2Error* error) {
+  if (num_threads <= 1) return FindSelfIntersection(index, error);
+  if (index.num_shape_ids() == 0) return false;
+  ABSL_DCHECK_EQ(1, index.num_shape_ids());
+  const S2Shape& shape = *index.shape(0);
+
+  // Index cells are divided into the ranges described above.  (Larger index
+  // cells have ids that fall between two such ranges, and are assigned to
+  // the first one.)  Each range is scanned in the same order as above, so the
+  // error found in the first range that has one is the error that the
+  // single-threaded version reports.  Later ranges are abandoned as soon as
+  // an error is found.
+  const int num_ranges = kNumRanges;
+  vector<S2Error> errors(num_ranges);
+  std::atomic<int> first_error_range(num_ranges);
+  ParallelFor(num_ranges, num_threads, [&](int i) {
+    const S2CellId limit = GetRangeStart(i + 1);
+    ShapeEdgeVector shape_edges;
+    S2ShapeIndex::Iterator it(&index);
+    for (it.Seek(GetRangeStart(i)); !it.done() && it.id() < limit;
+         it.Next()) {
+      if (first_error_range.load(std::memory_order_relaxed) < i) return;
+      GetShapeEdges(index, it.cell(), &shape_edges);
+      if (!VisitCrossings(
+              shape_edges, CrossingType::ALL, false /*need_adjacent*/,
+              [&](const ShapeEdge& a, const ShapeEdge& b, bool is_interior) {
+                return !FindCrossingError(shape, a, b, is_interior,
+                                          &errors[i]);
+              })) {
+        int prev = first_error_range.load();
+        while (i < prev && !first_error_range.compare_exchange_weak(prev, i)) {
+        }
+        return;
+      }
+    }
+  });
+  const int first = first_error_range.load();
+  if (first == num_ranges) return false;
+  *error = errors[first];
+  return true;
+}
+
 }  // namespace s2shapeutil
@@ -20,6 +20,7 @@
 
 #include <functional>
 
+#include "s2/s2cell_id.h"
 #include "s2/s2crossing_edge_query.h"
 #include "s2/s2error.h"
 #include "s2/s2shape_index.h"
@@ -56,6 +57,51 @@ bool VisitCrossingEdgePairs(const S2ShapeIndex& a_index,
                             const S2ShapeIndex& b_index,
                             CrossingType type, const EdgePairVisitor& visitor);
 
+// Like the above, but only visits the crossings found in index cells that
+// belong to the given cube face.  Visiting each of the six faces in order
+// yields exactly the same sequence of calls as the function above, which
+// allows the faces to be processed concurrently and the results to be
+// combined deterministically.
+//
+// REQUIRES: face.is_face()
+bool VisitCrossingEdgePairs(const S2ShapeIndex& a_index,
+                            const S2ShapeIndex& b_index,
+                            CrossingType type, S2CellId face,
+                            const EdgePairVisitor& visitor);
+
+// Specifies the order in which the multi-threaded versions of
+// VisitCrossingEdgePairs() visit crossings.
+enum class CrossingOrder {
+  // Crossings are visited by the worker threads as soon as they are found,
+  // in no particular order.  The visitor is called concurrently and must be
+  // thread-safe.  If it returns false, the remaining threads stop soon
+  // afterward (but may still visit a few more crossings).
+  ANY,
+
+  // The crossings found by each thread are buffered and then visited by the
+  // calling thread in exactly the same order as the single-threaded version,
+  // so the visitor does not need to be thread-safe.  Note that all crossings
+  // are found (and stored) before the first one is visited.
+  SEQUENTIAL,
+};
+
+// Like VisitCrossingEdgePairs(index, type, visitor), but uses up to
+// "num_threads" threads.  The index cells are divided into S2CellId ranges
+// that are processed concurrently.
+bool VisitCrossingEdgePairs(const S2ShapeIndex& index, CrossingType type,
+                            int num_threads, CrossingOrder order,
+                            const EdgePairVisitor& visitor);
+
+// Like VisitCrossingEdgePairs(a_index, b_index, type, visitor), but uses up
+// to "num_threads" threads.  The two indexes are divided into S2CellId ranges
+// that are processed concurrently.  Each index cell belongs to the range
+// that contains its range_min(), so no crossing is visited more often than
+// in the single-threaded version.
+bool VisitCrossingEdgePairs(const S2ShapeIndex& a_index,
+                            const S2ShapeIndex& b_index, CrossingType type,
+                            int num_threads, CrossingOrder order,
+                            const EdgePairVisitor& visitor);
+
 // Given an S2ShapeIndex containing a single polygonal shape (e.g., an
 // S2Polygon or S2Loop), return true if any loop has a self-intersection
 // (including duplicate vertices) or crosses any other loop (including vertex
@@ -69,6 +115,12 @@ bool VisitCrossingEdgePairs(const S2ShapeIndex& a_index,
 // duplicate vertices and edges are allowed, but loop crossings are not).
 bool FindSelfIntersection(const S2ShapeIndex& index, S2Error* error);
 
+// Like the above, but uses up to "num_threads" threads.  The index cells are
+// divided into S2CellId ranges that are checked concurrently, and the error
+// reported (if any) is the same one that the single-threaded version reports.
+bool FindSelfIntersection(const S2ShapeIndex& index, int num_threads,
+                          S2Error* error);
+
 }  // namespace s2shapeutil
 
 #endif  // S2_S2SHAPEUTIL_VISIT_CROSSING_EDGE_PAIRS_H_
@@ -22,15 +22,18 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 #include <gtest/gtest.h>
 
 #include "absl/log/absl_log.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/strings/string_view.h"
 
 #include "s2/mutable_s2shape_index.h"
+#include "s2/s2cell_id.h"
 #include "s2/s2crossing_edge_query.h"
 #include "s2/s2debug.h"
 #include "s2/s2edge_crossings.h"
@@ -241,6 +244,122 @@ TEST(GetCrossingEdgePairs, EdgeGridTwoIndexes) {
   TestGetCrossingEdgePairs(indexA, indexB, CrossingType::INTERIOR, 108);
 }
 
+TEST(VisitCrossingEdgePairs, FacesMatchWholeIndex) {
+  // Build two grids of edges that span several cube faces and check that
+  // visiting the crossings one face at a time yields the same sequence of
+  // calls as visiting the whole index.
+  MutableS2ShapeIndex indexA;
+  MutableS2ShapeIndex indexB;
+  auto shapeA = make_unique<S2EdgeVectorShape>();
+  auto shapeB = make_unique<S2EdgeVectorShape>();
+  for (int i = 0; i <= 20; ++i) {
+    shapeA->Add(S2LatLng::FromDegrees(-60, 8 * i - 70).ToPoint(),
+                S2LatLng::FromDegrees(60, 8 * i - 70).ToPoint());
+    for (int j = 0; j < 4; ++j) {
+      shapeB->Add(S2LatLng::FromDegrees(6 * i - 60, 40 * j - 70).ToPoint(),
+                  S2LatLng::FromDegrees(6 * i - 60, 40 * j - 30).ToPoint());
+    }
+  }
+  indexA.Add(std::move(shapeA));
+  indexB.Add(std::move(shapeB));
+  using Crossing = std::tuple<ShapeEdgeId, ShapeEdgeId, bool>;
+  vector<Crossing> expected, actual;
+  auto visitor = [](vector<Crossing>* crossings) {
+    return [crossings](const ShapeEdge& a, const ShapeEdge& b,
+                       bool is_interior) {
+      crossings->push_back({a.id(), b.id(), is_interior});
+      return true;  // Continue visiting.
+    };
+  };
+  VisitCrossingEdgePairs(indexA, indexB, CrossingType::ALL,
+                         visitor(&expected));
+  for (int face = 0; face < 6; ++face) {
+    VisitCrossingEdgePairs(indexA, indexB, CrossingType::ALL,
+                           S2CellId::FromFace(face), visitor(&actual));
+  }
+  EXPECT_GT(expected.size(), 300);
+  EXPECT_EQ(expected, actual);
+}
+
+// Adds grids of edges that span several cube faces to the two indexes,
+// plus some short edges that are indexed in small cells.
+void MakeParallelTestIndexes(MutableS2ShapeIndex* indexA,
+                             MutableS2ShapeIndex* indexB) {
+  auto shapeA = make_unique<S2EdgeVectorShape>();
+  auto shapeB = make_unique<S2EdgeVectorShape>();
+  for (int i = 0; i <= 20; ++i) {
+    shapeA->Add(S2LatLng::FromDegrees(-60, 8 * i - 70).ToPoint(),
+                S2LatLng::FromDegrees(60, 8 * i - 70).ToPoint());
+    for (int j = 0; j < 4; ++j) {
+      shapeB->Add(S2LatLng::FromDegrees(6 * i - 60, 40 * j - 70).ToPoint(),
+                  S2LatLng::FromDegrees(6 * i - 60, 40 * j - 30).ToPoint());
+    }
+  }
+  for (int i = 0; i < 200; ++i) {
+    shapeA->Add(S2LatLng::FromDegrees(0.01 * i, 10).ToPoint(),
+                S2LatLng::FromDegrees(0.01 * i + 0.5, 10.5).ToPoint());
+    shapeB->Add(S2LatLng::FromDegrees(0.01 * i, 10.5).ToPoint(),
+                S2LatLng::FromDegrees(0.01 * i + 0.5, 10).ToPoint());
+  }
+  indexA->Add(std::move(shapeA));
+  indexB->Add(std::move(shapeB));
+}
+
+TEST(VisitCrossingEdgePairs, ParallelMatchesSequential) {
+  MutableS2ShapeIndex indexA;
+  MutableS2ShapeIndex indexB;
+  MakeParallelTestIndexes(&indexA, &indexB);
+  MutableS2ShapeIndex indexAB;
+  MakeParallelTestIndexes(&indexAB, &indexAB);
+  using Crossing = std::tuple<ShapeEdgeId, ShapeEdgeId, bool>;
+  absl::Mutex mutex;
+  auto visitor = [&mutex](vector<Crossing>* crossings) {
+    return [&mutex, crossings](const ShapeEdge& a, const ShapeEdge& b,
+                               bool is_interior) {
+      absl::MutexLock lock(&mutex);
+      crossings->push_back({a.id(), b.id(), is_interior});
+      return true;  // Continue visiting.
+    };
+  };
+  for (CrossingType type : {CrossingType::ALL, CrossingType::INTERIOR}) {
+    vector<Crossing> expected_one, expected_two;
+    VisitCrossingEdgePairs(indexAB, type, visitor(&expected_one));
+    VisitCrossingEdgePairs(indexA, indexB, type, visitor(&expected_two));
+    EXPECT_GT(expected_one.size(), 1000);
+    EXPECT_GT(expected_two.size(), 1000);
+    for (CrossingOrder order : {CrossingOrder::SEQUENTIAL, CrossingOrder::ANY}) {
+      vector<Crossing> actual_one, actual_two;
+      EXPECT_TRUE(VisitCrossingEdgePairs(indexAB, type, 4, order,
+                                         visitor(&actual_one)));
+      EXPECT_TRUE(VisitCrossingEdgePairs(indexA, indexB, type, 4, order,
+                                         visitor(&actual_two)));
+      if (order == CrossingOrder::ANY) {
+        std::sort(actual_one.begin(), actual_one.end());
+        std::sort(actual_two.begin(), actual_two.end());
+        vector<Crossing> sorted_one = expected_one, sorted_two = expected_two;
+        std::sort(sorted_one.begin(), sorted_one.end());
+        std::sort(sorted_two.begin(), sorted_two.end());
+        EXPECT_EQ(sorted_one, actual_one);
+        EXPECT_EQ(sorted_two, actual_two);
+      } else {
+        EXPECT_EQ(expected_one, actual_one);
+        EXPECT_EQ(expected_two, actual_two);
+      }
+    }
+  }
+}
+
+TEST(VisitCrossingEdgePairs, ParallelStopsEarly) {
+  MutableS2ShapeIndex indexA;
+  MutableS2ShapeIndex indexB;
+  MakeParallelTestIndexes(&indexA, &indexB);
+  for (CrossingOrder order : {CrossingOrder::SEQUENTIAL, CrossingOrder::ANY}) {
+    EXPECT_FALSE(VisitCrossingEdgePairs(
+        indexA, indexB, CrossingType::ALL, 4, order,
+        [](const ShapeEdge&, const ShapeEdge&, bool) { return false; }));
+  }
+}
+
 // Return true if any loop crosses any other loop (including vertex crossings
 // and duplicate edges), or any loop has a self-intersection (including
 // duplicate vertices).
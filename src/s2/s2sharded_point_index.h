@@ -0,0 +1,294 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2SHARDED_POINT_INDEX_H_
+#define S2_S2SHARDED_POINT_INDEX_H_
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/log/absl_check.h"
+#include "absl/synchronization/mutex.h"
+#include "s2/base/types.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2cell_iterator.h"
+#include "s2/s2point.h"
+#include "s2/s2point_index.h"
+
+// S2ShardedPointIndex is an S2PointIndex that can be built by many threads
+// at once.  The S2CellId space is divided into shards, one per S2Cell at a
+// fixed "shard level", and each shard is an S2PointIndex with its own lock.
+// Threads that add points to different shards therefore never contend, and
+// since the shards are disjoint ranges of S2CellIds, iterating through the
+// shards in order visits the points in S2CellId order.
+//
+// Typical usage is to load the points using several threads, and then
+// freeze them into an ordinary S2PointIndex for use with S2ClosestPointQuery:
+//
+//   S2ShardedPointIndex<int> sharded_index;
+//   // On each of several threads:
+//   for (...) sharded_index.Add(point, data);
+//   // Once all the threads have finished:
+//   S2PointIndex<int> index;
+//   sharded_index.Freeze(&index, /*num_threads=*/8);
+//   S2ClosestPointQuery<int> query(&index);
+//
+// Freeze() does not need to sort the points and takes time proportional to
+// the number of points divided by "num_threads".  The index may also be
+// traversed directly with its Iterator, which implements S2CellIterator.
+//
+// Add() and Remove() may be called concurrently from any number of threads.
+// num_points(), Freeze(), and Iterator must not be used concurrently with
+// them.
+//
+// REQUIRES: "Data" has default and copy constructors.
+// REQUIRES: "Data" has operator== and operator<.
+template <class Data = std::tuple<> /*empty class*/>
+class S2ShardedPointIndex {
+ public:
+  using PointData = typename S2PointIndex<Data>::PointData;
+
+  // The default shard level, which gives 6 * 4**2 = 96 shards.  Points that
+  // are concentrated in a small area (e.g. one country) need a higher level
+  // so that they are spread over enough shards to avoid lock contention.
+  static constexpr int kDefaultShardLevel = 2;
+
+  // REQUIRES: 0 <= shard_level <= 10
+  explicit S2ShardedPointIndex(int shard_level = kDefaultShardLevel);
+
+  S2ShardedPointIndex(const S2ShardedPointIndex&) = delete;
+  void operator=(const S2ShardedPointIndex&) = delete;
+
+  int shard_level() const { return shard_level_; }
+  int num_shards() const { return num_shards_; }
+
+  // Returns the number of points in the index.
+  int num_points() const;
+
+  // Adds the given point to the index.  Thread-safe.
+  void Add(const S2Point& point, const Data& data);
+  void Add(const PointData& point_data);
+
+  // Removes the given point from the index.  Both the "point" and "data"
+  // fields must match the point to be removed.  Returns false if the given
+  // point was not present.  Thread-safe.
+  bool Remove(const S2Point& point, const Data& data);
+  bool Remove(const PointData& point_data);
+
+  // Replaces the contents of "index" with a frozen index containing all the
+  // points of this index, copying the shards using up to "num_threads"
+  // threads.  This index is not modified.
+  void Freeze(S2PointIndex<Data>* index, int num_threads = 1) const;
+
+  // An iterator that visits the points of all the shards in S2CellId order.
+  // It is invalidated when the index is modified.
+  class Iterator final : public S2CellIterator {
+   public:
+    // Default constructor; must be followed by a call to Init().
+    Iterator() = default;
+
+    // Convenience constructor that calls Init().
+    explicit Iterator(const S2ShardedPointIndex* index) { Init(index); }
+
+    // Initializes an iterator for the given index.  If the index is
+    // non-empty, the iterator is positioned at the first cell.
+    void Init(const S2ShardedPointIndex* index) {
+      index_ = index;
+      Begin();
+    }
+
+    S2CellId id() const override { return iter_.id(); }
+    const S2Point& point() const { return iter_.point(); }
+    const Data& data() const { return iter_.data(); }
+    const PointData& point_data() const { return iter_.point_data(); }
+    bool done() const override { return shard_ == index_->num_shards_; }
+    void Begin() override { SeekShard(0); }
+    void Finish() override { shard_ = index_->num_shards_; }
+    void Next() override;
+    bool Prev() override;
+    void Seek(S2CellId target) override;
+
+    bool Locate(const S2Point& target) override {
+      return LocateImpl(*this, target);
+    }
+
+    S2CellRelation Locate(S2CellId target) override {
+      return LocateImpl(*this, target);
+    }
+
+   private:
+    // Positions the iterator at the first point of the first non-empty shard
+    // at or after "shard", or at the end if there is no such shard.
+    void SeekShard(int shard);
+
+    const S2ShardedPointIndex* index_ = nullptr;
+    int shard_ = 0;
+    typename S2PointIndex<Data>::Iterator iter_;
+  };
+
+ private:
+  struct Shard {
+    mutable absl::Mutex mutex;
+    S2PointIndex<Data> index ABSL_GUARDED_BY(mutex);
+  };
+
+  // Returns the shard containing the given S2CellId, which may be
+  // num_shards_ for S2CellId::Sentinel().
+  int ShardIndex(S2CellId id) const {
+    return std::min<uint64>(id.id() >> shard_shift_, num_shards_);
+  }
+
+  // Returns the index of a shard without locking it.  Callers must ensure
+  // that the index is not being modified (see the class comment).
+  const S2PointIndex<Data>& shard_index(int shard) const
+      ABSL_NO_THREAD_SAFETY_ANALYSIS {
+    return shards_[shard].index;
+  }
+
+  const int shard_level_;
+  const int num_shards_;
+  const int shard_shift_;
+  std::unique_ptr<Shard[]> shards_;
+};
+
+
+//////////////////   Implementation details follow   ////////////////////
+
+
+template <class Data>
+S2ShardedPointIndex<Data>::S2ShardedPointIndex(int shard_level)
+    : shard_level_(shard_level),
+      num_shards_(6 << (2 * shard_level)),
+      shard_shift_(S2CellId::kPosBits - 2 * shard_level),
+      shards_(new Shard[num_shards_]) {
+  ABSL_DCHECK_GE(shard_level, 0);
+  ABSL_DCHECK_LE(shard_level, 10);
+}
+
+template <class Data>
+int S2ShardedPointIndex<Data>::num_points() const {
+  int num_points = 0;
+  for (int i = 0; i < num_shards_; ++i) {
+    num_points += shard_index(i).num_points();
+  }
+  return num_points;
+}
+
+template <class Data>
+void S2ShardedPointIndex<Data>::Add(const PointData& point_data) {
+  Shard& shard = shards_[ShardIndex(S2CellId(point_data.point()))];
+  absl::MutexLock lock(&shard.mutex);
+  shard.index.Add(point_data);
+}
+
+template <class Data>
+void S2ShardedPointIndex<Data>::Add(const S2Point& point, const Data& data) {
+  Add(PointData(point, data));
+}
+
+template <class Data>
+bool S2ShardedPointIndex<Data>::Remove(const PointData& point_data) {
+  Shard& shard = shards_[ShardIndex(S2CellId(point_data.point()))];
+  absl::MutexLock lock(&shard.mutex);
+  return shard.index.Remove(point_data);
+}
+
+template <class Data>
+bool S2ShardedPointIndex<Data>::Remove(const S2Point& point,
+                                       const Data& data) {
+  return Remove(PointData(point, data));
+}
+
+template <class Data>
+void S2ShardedPointIndex<Data>::Freeze(S2PointIndex<Data>* index,
+                                       int num_threads) const {
+  // The position of the first point of each shard in the output.
+  std::vector<int> offsets(num_shards_ + 1);
+  for (int i = 0; i < num_shards_; ++i) {
+    offsets[i + 1] = offsets[i] + shard_index(i).num_points();
+  }
+  std::vector<S2CellId> ids(offsets.back());
+  std::vector<PointData> points(offsets.back());
+
+  // Each thread repeatedly claims the next shard and copies it.
+  std::atomic<int> next_shard(0);
+  const auto copy_shards = [&]() {
+    int i;
+    while ((i = next_shard.fetch_add(1)) < num_shards_) {
+      int pos = offsets[i];
+      for (typename S2PointIndex<Data>::Iterator it(&shard_index(i));
+           !it.done(); it.Next(), ++pos) {
+        ids[pos] = it.id();
+        points[pos] = it.point_data();
+      }
+    }
+  };
+  num_threads = std::min(std::max(num_threads, 1), num_shards_);
+  std::vector<std::thread> threads;
+  for (int t = 1; t < num_threads; ++t) threads.emplace_back(copy_shards);
+  copy_shards();
+  for (std::thread& thread : threads) thread.join();
+  index->InitFromSorted(std::move(ids), std::move(points));
+}
+
+template <class Data>
+void S2ShardedPointIndex<Data>::Iterator::SeekShard(int shard) {
+  for (shard_ = shard; shard_ < index_->num_shards_; ++shard_) {
+    const S2PointIndex<Data>& shard_index = index_->shard_index(shard_);
+    if (shard_index.num_points() > 0) {
+      iter_.Init(&shard_index);
+      return;
+    }
+  }
+}
+
+template <class Data>
+void S2ShardedPointIndex<Data>::Iterator::Next() {
+  ABSL_DCHECK(!done());
+  iter_.Next();
+  if (iter_.done()) SeekShard(shard_ + 1);
+}
+
+template <class Data>
+bool S2ShardedPointIndex<Data>::Iterator::Prev() {
+  if (!done() && iter_.Prev()) return true;
+  for (int shard = shard_ - 1; shard >= 0; --shard) {
+    const S2PointIndex<Data>& shard_index = index_->shard_index(shard);
+    if (shard_index.num_points() > 0) {
+      shard_ = shard;
+      iter_.Init(&shard_index);
+      iter_.Finish();
+      iter_.Prev();
+      return true;
+    }
+  }
+  return false;
+}
+
+template <class Data>
+void S2ShardedPointIndex<Data>::Iterator::Seek(S2CellId target) {
+  shard_ = index_->ShardIndex(target);
+  if (done()) return;
+  iter_.Init(&index_->shard_index(shard_));
+  iter_.Seek(target);
+  if (iter_.done()) SeekShard(shard_ + 1);
+}
+
+#endif  // S2_S2SHARDED_POINT_INDEX_H_
@@ -0,0 +1,137 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2sharded_point_index.h"
+
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/s1angle.h"
+#include "s2/s2cap.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2closest_point_query.h"
+#include "s2/s2point.h"
+#include "s2/s2point_index.h"
+#include "s2/s2testing.h"
+
+using std::vector;
+
+namespace {
+
+using Index = S2ShardedPointIndex<int>;
+
+// Checks that iterating through "index" visits the same points in the same
+// order as iterating through "expected", and that Seek() and Prev() agree.
+void CheckIterator(const Index& index, const S2PointIndex<int>& expected) {
+  vector<std::pair<S2CellId, int>> actual_entries, expected_entries;
+  for (Index::Iterator it(&index); !it.done(); it.Next()) {
+    actual_entries.emplace_back(it.id(), it.data());
+  }
+  for (S2PointIndex<int>::Iterator it(&expected); !it.done(); it.Next()) {
+    expected_entries.emplace_back(it.id(), it.data());
+  }
+  ASSERT_EQ(actual_entries.size(), expected_entries.size());
+  for (int i = 0; i < actual_entries.size(); ++i) {
+    EXPECT_EQ(actual_entries[i].first, expected_entries[i].first);
+  }
+
+  Index::Iterator it(&index);
+  S2PointIndex<int>::Iterator expected_it(&expected);
+  for (int i = 0; i < 100; ++i) {
+    S2CellId target = S2Testing::GetRandomCellId();
+    it.Seek(target);
+    expected_it.Seek(target);
+    ASSERT_EQ(it.done(), expected_it.done());
+    if (!it.done()) EXPECT_EQ(it.id(), expected_it.id());
+    bool has_prev = it.Prev();
+    ASSERT_EQ(has_prev, expected_it.Prev());
+    if (has_prev) EXPECT_EQ(it.id(), expected_it.id());
+  }
+  it.Seek(S2CellId::Sentinel());
+  EXPECT_TRUE(it.done());
+}
+
+TEST(S2ShardedPointIndex, NoPoints) {
+  Index index;
+  EXPECT_EQ(index.num_shards(), 96);
+  EXPECT_EQ(index.num_points(), 0);
+  Index::Iterator it(&index);
+  EXPECT_TRUE(it.done());
+  EXPECT_FALSE(it.Prev());
+  S2PointIndex<int> frozen;
+  index.Freeze(&frozen);
+  EXPECT_EQ(frozen.num_points(), 0);
+}
+
+TEST(S2ShardedPointIndex, ConcurrentAddMatchesPointIndex) {
+  S2Testing::rnd.Reset(1);
+  constexpr int kNumThreads = 4;
+  constexpr int kPointsPerThread = 2000;
+  vector<vector<S2Point>> points(kNumThreads);
+  S2PointIndex<int> expected;
+  for (int t = 0; t < kNumThreads; ++t) {
+    for (int i = 0; i < kPointsPerThread; ++i) {
+      // Put half the points in a small area to exercise a few shards more.
+      S2Point point = i % 2 ? S2Testing::RandomPoint()
+                            : S2Testing::SamplePoint(S2Cap(
+                                  S2Point(1, 0, 0), S1Angle::Degrees(1)));
+      points[t].push_back(point);
+      expected.Add(point, t * kPointsPerThread + i);
+    }
+  }
+  Index index(/*shard_level=*/3);
+  vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&index, &points, t]() {
+      for (int i = 0; i < kPointsPerThread; ++i) {
+        index.Add(points[t][i], t * kPointsPerThread + i);
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  EXPECT_EQ(index.num_points(), kNumThreads * kPointsPerThread);
+  CheckIterator(index, expected);
+
+  // Remove some points.
+  for (int i = 0; i < kPointsPerThread; i += 3) {
+    EXPECT_TRUE(index.Remove(points[0][i], i));
+    EXPECT_TRUE(expected.Remove(points[0][i], i));
+  }
+  EXPECT_FALSE(index.Remove(points[0][0], 0));
+  CheckIterator(index, expected);
+
+  // Freezing the index gives the same results as S2ClosestPointQuery on the
+  // original index.
+  S2PointIndex<int> frozen;
+  index.Freeze(&frozen, /*num_threads=*/3);
+  EXPECT_TRUE(frozen.is_frozen());
+  EXPECT_EQ(frozen.num_points(), expected.num_points());
+  S2ClosestPointQuery<int> query(&frozen), expected_query(&expected);
+  query.mutable_options()->set_max_results(5);
+  expected_query.mutable_options()->set_max_results(5);
+  for (int i = 0; i < 20; ++i) {
+    S2ClosestPointQuery<int>::PointTarget target(S2Testing::RandomPoint());
+    auto results = query.FindClosestPoints(&target);
+    auto expected_results = expected_query.FindClosestPoints(&target);
+    ASSERT_EQ(results.size(), expected_results.size());
+    for (int j = 0; j < results.size(); ++j) {
+      EXPECT_EQ(results[j].point(), expected_results[j].point());
+    }
+  }
+}
+
+}  // namespace
@@ -0,0 +1,177 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2telemetry.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/numeric/bits.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "s2/base/types.h"
+
+using std::string;
+using std::vector;
+
+namespace s2telemetry {
+
+namespace {
+
+// The set of counters and histograms that currently exist.
+struct Registry {
+  absl::Mutex mutex;
+  vector<Counter*> counters ABSL_GUARDED_BY(mutex);
+  vector<Histogram*> histograms ABSL_GUARDED_BY(mutex);
+};
+
+Registry& GetRegistry() {
+  static Registry* registry = new Registry;
+  return *registry;
+}
+
+template <class T>
+void Unregister(vector<T*>* objects, T* object) {
+  objects->erase(std::find(objects->begin(), objects->end(), object));
+}
+
+}  // namespace
+
+Counter::Counter(absl::string_view name) : name_(name) {
+  Registry& registry = GetRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  registry.counters.push_back(this);
+}
+
+Counter::~Counter() {
+  Registry& registry = GetRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  Unregister(&registry.counters, this);
+}
+
+int64 Counter::value() const {
+  int64 sum = 0;
+  for (const Shard& shard : shards_) {
+    sum += shard.value.load(std::memory_order_relaxed);
+  }
+  return sum;
+}
+
+void Counter::Reset() {
+  for (Shard& shard : shards_) shard.value.store(0, std::memory_order_relaxed);
+}
+
+int64 HistogramSnapshot::Percentile(double fraction) const {
+  // The number of values that are at most the result.
+  int64 rank = std::max<int64>(1, std::ceil(fraction * count));
+  for (int i = 0; i < kNumBuckets; ++i) {
+    rank -= buckets[i];
+    if (rank <= 0) {
+      return i == 0 ? 0 : static_cast<int64>((~uint64_t{0}) >> (64 - i));
+    }
+  }
+  return 0;  // The histogram is empty.
+}
+
+HistogramSnapshot& HistogramSnapshot::operator+=(
+    const HistogramSnapshot& other) {
+  count += other.count;
+  sum += other.sum;
+  for (int i = 0; i < kNumBuckets; ++i) buckets[i] += other.buckets[i];
+  return *this;
+}
+
+Histogram::Histogram(absl::string_view name) : name_(name) {
+  Registry& registry = GetRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  registry.histograms.push_back(this);
+}
+
+Histogram::~Histogram() {
+  Registry& registry = GetRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  Unregister(&registry.histograms, this);
+}
+
+void Histogram::Record(int64 value) {
+  Shard& shard = shards_[internal::ThreadShard()];
+  int bucket = value <= 0 ? 0 : absl::bit_width(static_cast<uint64_t>(value));
+  shard.count.fetch_add(1, std::memory_order_relaxed);
+  shard.sum.fetch_add(value, std::memory_order_relaxed);
+  shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+HistogramSnapshot Histogram::snapshot() const {
+  HistogramSnapshot result;
+  for (const Shard& shard : shards_) {
+    result.count += shard.count.load(std::memory_order_relaxed);
+    result.sum += shard.sum.load(std::memory_order_relaxed);
+    for (int i = 0; i < kNumBuckets; ++i) {
+      result.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+    }
+  }
+  return result;
+}
+
+void Histogram::Reset() {
+  for (Shard& shard : shards_) {
+    shard.count.store(0, std::memory_order_relaxed);
+    shard.sum.store(0, std::memory_order_relaxed);
+    for (auto& bucket : shard.buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+string Snapshot::ToString() const {
+  string result;
+  for (const auto& [name, value] : counters) {
+    absl::StrAppend(&result, name, ": ", value, "\n");
+  }
+  for (const auto& [name, histogram] : histograms) {
+    absl::StrAppend(&result, name, ": count=", histogram.count,
+                    " mean=", histogram.mean(),
+                    " p50<=", histogram.Percentile(0.5),
+                    " p99<=", histogram.Percentile(0.99), "\n");
+  }
+  return result;
+}
+
+Snapshot GetSnapshot() {
+  Snapshot result;
+  Registry& registry = GetRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  for (const Counter* counter : registry.counters) {
+    result.counters[counter->name()] += counter->value();
+  }
+  for (const Histogram* histogram : registry.histograms) {
+    result.histograms[histogram->name()] += histogram->snapshot();
+  }
+  return result;
+}
+
+void ResetAll() {
+  Registry& registry = GetRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  for (Counter* counter : registry.counters) counter->Reset();
+  for (Histogram* histogram : registry.histograms) histogram->Reset();
+}
+
+}  // namespace s2telemetry
@@ -0,0 +1,239 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2TELEMETRY_H_
+#define S2_S2TELEMETRY_H_
+
+// Process-wide counters and histograms describing the work done by the S2
+// library, e.g. how often each arithmetic tier of the s2pred predicates is
+// used, how many cells and clipped edges are created while building
+// MutableS2ShapeIndex, how many cells are decoded by EncodedS2ShapeIndex, how
+// long the phases of S2Builder take, and how much work distance queries do.
+// This is intended for understanding the behavior of S2 in production, where
+// profilers are often not available.
+//
+// Telemetry is compiled out unless the library is built with S2_TELEMETRY
+// defined (e.g. using the CMake option S2_ENABLE_TELEMETRY).  Otherwise the
+// S2_TELEMETRY_* macros below expand to nothing and have no cost.  When it is
+// enabled, each update is a relaxed atomic addition to a counter shard that is
+// chosen by the calling thread, so that concurrent threads rarely contend.
+//
+// Example usage:
+//
+//   s2telemetry::Snapshot snapshot = s2telemetry::GetSnapshot();
+//   int64 exact = snapshot.counters["s2pred.sign.exact"];
+//   ABSL_LOG(INFO) << snapshot.ToString();
+//
+// The Counter and Histogram classes are always available, so clients may
+// also use them to report their own statistics.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "s2/base/types.h"
+
+namespace s2telemetry {
+
+// True if the library was built with telemetry enabled.
+#ifdef S2_TELEMETRY
+inline constexpr bool kEnabled = true;
+#else
+inline constexpr bool kEnabled = false;
+#endif
+
+// The number of shards per counter.  Threads are assigned to shards in
+// round-robin order.
+inline constexpr int kNumShards = 16;
+
+// The number of histogram buckets (see HistogramSnapshot::buckets).
+inline constexpr int kNumBuckets = 65;
+
+namespace internal {
+// Returns the shard used by the calling thread.
+inline int ThreadShard() {
+  static std::atomic<int> next_shard{0};
+  thread_local const int shard =
+      next_shard.fetch_add(1, std::memory_order_relaxed) & (kNumShards - 1);
+  return shard;
+}
+}  // namespace internal
+
+// A named counter that is registered for the lifetime of the object.
+// Counters with the same name are summed by GetSnapshot(), so the same
+// quantity may be counted in several places.
+//
+// This class is thread-safe.
+class Counter {
+ public:
+  explicit Counter(absl::string_view name);
+  ~Counter();
+
+  void Add(int64 n) {
+    shards_[internal::ThreadShard()].value.fetch_add(
+        n, std::memory_order_relaxed);
+  }
+  void Increment() { Add(1); }
+
+  const std::string& name() const { return name_; }
+
+  // Returns the sum of all shards.
+  int64 value() const;
+  void Reset();
+
+  Counter(const Counter&) = delete;
+  void operator=(const Counter&) = delete;
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<int64> value{0};
+  };
+
+  std::string name_;
+  std::array<Shard, kNumShards> shards_;
+};
+
+// The contents of a Histogram at one point in time.
+struct HistogramSnapshot {
+  int64 count = 0;
+  int64 sum = 0;
+
+  // buckets[0] counts values <= 0, and buckets[i] counts values in the range
+  // [2**(i-1), 2**i) for i >= 1.
+  std::vector<int64> buckets = std::vector<int64>(kNumBuckets);
+
+  double mean() const { return count == 0 ? 0 : double(sum) / count; }
+
+  // Returns an upper bound on the given fraction (e.g. 0.99) of values,
+  // namely the largest value in the bucket containing that percentile.
+  int64 Percentile(double fraction) const;
+
+  HistogramSnapshot& operator+=(const HistogramSnapshot& other);
+};
+
+// A named histogram of non-negative values (e.g. latencies in microseconds)
+// with power-of-two buckets.  Like Counter, histograms with the same name
+// are merged by GetSnapshot().
+//
+// This class is thread-safe.
+class Histogram {
+ public:
+  explicit Histogram(absl::string_view name);
+  ~Histogram();
+
+  void Record(int64 value);
+
+  const std::string& name() const { return name_; }
+
+  HistogramSnapshot snapshot() const;
+  void Reset();
+
+  Histogram(const Histogram&) = delete;
+  void operator=(const Histogram&) = delete;
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<int64> count{0};
+    std::atomic<int64> sum{0};
+    std::array<std::atomic<int64>, kNumBuckets> buckets{};
+  };
+
+  std::string name_;
+  std::array<Shard, kNumShards> shards_;
+};
+
+// Records the lifetime of this object in microseconds.
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(Histogram* histogram)
+      : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+
+  ~ScopedTimer() {
+    histogram_->Record(std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now() - start_)
+                           .count());
+  }
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  void operator=(const ScopedTimer&) = delete;
+
+ private:
+  Histogram* histogram_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// The values of all registered counters and histograms.  Counters and
+// histograms that are defined using the S2_TELEMETRY_* macros are registered
+// the first time that they are updated.
+struct Snapshot {
+  std::map<std::string, int64> counters;
+  std::map<std::string, HistogramSnapshot> histograms;
+
+  // Returns one line per counter and histogram, sorted by name.
+  std::string ToString() const;
+};
+
+Snapshot GetSnapshot();
+
+// Resets all registered counters and histograms to zero.  Updates made
+// concurrently with this call may or may not be included.
+void ResetAll();
+
+}  // namespace s2telemetry
+
+// Macros for updating counters and histograms that are defined at the point
+// of use.  "name" must be a string literal, e.g.
+//
+//   S2_TELEMETRY_COUNTER_ADD("mutable_s2shape_index.cells_created", 1);
+//
+// These macros expand to nothing unless S2_TELEMETRY is defined.
+#ifdef S2_TELEMETRY
+
+#define S2_TELEMETRY_COUNTER_ADD(name, n)                                     \
+  do {                                                                        \
+    static ::s2telemetry::Counter* const s2_telemetry_counter =               \
+        new ::s2telemetry::Counter(name);                                     \
+    s2_telemetry_counter->Add(n);                                             \
+  } while (0)
+
+#define S2_TELEMETRY_HISTOGRAM_RECORD(name, value)                            \
+  do {                                                                        \
+    static ::s2telemetry::Histogram* const s2_telemetry_histogram =           \
+        new ::s2telemetry::Histogram(name);                                   \
+    s2_telemetry_histogram->Record(value);                                    \
+  } while (0)
+
+// Records the time until the end of the enclosing scope (in microseconds).
+// At most one timer may be declared per scope.
+#define S2_TELEMETRY_SCOPED_TIMER(name)                                       \
+  static ::s2telemetry::Histogram* const s2_telemetry_timer_histogram =       \
+      new ::s2telemetry::Histogram(name);                                     \
+  ::s2telemetry::ScopedTimer s2_telemetry_timer(s2_telemetry_timer_histogram)
+
+#else  // S2_TELEMETRY
+
+#define S2_TELEMETRY_COUNTER_ADD(name, n) static_cast<void>(0)
+#define S2_TELEMETRY_HISTOGRAM_RECORD(name, value) static_cast<void>(0)
+#define S2_TELEMETRY_SCOPED_TIMER(name) static_cast<void>(0)
+
+#endif  // S2_TELEMETRY
+
+#define S2_TELEMETRY_COUNTER_INC(name) S2_TELEMETRY_COUNTER_ADD(name, 1)
+
+#endif  // S2_S2TELEMETRY_H_
@@ -0,0 +1,119 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2telemetry.h"
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s2point.h"
+#include "s2/s2predicates.h"
+#include "s2/s2text_format.h"
+
+using std::vector;
+
+namespace s2telemetry {
+namespace {
+
+TEST(S2Telemetry, CounterSumsThreads) {
+  Counter counter("s2telemetry_test.threads");
+  vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&counter]() {
+      for (int i = 0; i < 1000; ++i) counter.Increment();
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  EXPECT_EQ(counter.value(), 8000);
+  EXPECT_EQ(GetSnapshot().counters["s2telemetry_test.threads"], 8000);
+}
+
+TEST(S2Telemetry, CountersWithSameNameAreSummed) {
+  Counter a("s2telemetry_test.same_name"), b("s2telemetry_test.same_name");
+  a.Add(3);
+  b.Add(4);
+  EXPECT_EQ(GetSnapshot().counters["s2telemetry_test.same_name"], 7);
+}
+
+TEST(S2Telemetry, DestroyedCounterIsUnregistered) {
+  {
+    Counter counter("s2telemetry_test.destroyed");
+    counter.Increment();
+    EXPECT_EQ(GetSnapshot().counters.count("s2telemetry_test.destroyed"), 1);
+  }
+  EXPECT_EQ(GetSnapshot().counters.count("s2telemetry_test.destroyed"), 0);
+}
+
+TEST(S2Telemetry, Histogram) {
+  Histogram histogram("s2telemetry_test.histogram");
+  for (int64 value : {0, 1, 2, 3, 1000}) histogram.Record(value);
+  HistogramSnapshot snapshot =
+      GetSnapshot().histograms["s2telemetry_test.histogram"];
+  EXPECT_EQ(snapshot.count, 5);
+  EXPECT_EQ(snapshot.sum, 1006);
+  EXPECT_DOUBLE_EQ(snapshot.mean(), 1006 / 5.0);
+  EXPECT_EQ(snapshot.buckets[0], 1);
+  EXPECT_EQ(snapshot.buckets[1], 1);
+  EXPECT_EQ(snapshot.buckets[2], 2);
+  EXPECT_EQ(snapshot.buckets[10], 1);
+  EXPECT_EQ(snapshot.Percentile(0), 0);
+  EXPECT_EQ(snapshot.Percentile(0.5), 3);
+  EXPECT_EQ(snapshot.Percentile(1), 1023);
+  EXPECT_EQ(HistogramSnapshot().Percentile(0.5), 0);
+}
+
+TEST(S2Telemetry, ScopedTimer) {
+  Histogram histogram("s2telemetry_test.timer");
+  { ScopedTimer timer(&histogram); }
+  EXPECT_EQ(histogram.snapshot().count, 1);
+}
+
+TEST(S2Telemetry, ResetAll) {
+  Counter counter("s2telemetry_test.reset");
+  Histogram histogram("s2telemetry_test.reset");
+  counter.Add(5);
+  histogram.Record(5);
+  ResetAll();
+  EXPECT_EQ(counter.value(), 0);
+  EXPECT_EQ(histogram.snapshot().count, 0);
+}
+
+TEST(S2Telemetry, ToString) {
+  Snapshot snapshot;
+  snapshot.counters["a"] = 1;
+  snapshot.histograms["b"].count = 0;
+  EXPECT_EQ(snapshot.ToString(), "a: 1\nb: count=0 mean=0 p50<=0 p99<=0\n");
+}
+
+TEST(S2Telemetry, LibraryCounters) {
+  ResetAll();
+  s2pred::Sign(S2Point(1, 0, 0), S2Point(0, 1, 0), S2Point(0, 0, 1));
+  MutableS2ShapeIndex index;
+  index.Add(s2textformat::MakeLaxPolygonOrDie("0:0, 0:10, 10:10, 10:0"));
+  index.ForceBuild();
+  Snapshot snapshot = GetSnapshot();
+  if (kEnabled) {
+    EXPECT_GE(snapshot.counters["s2pred.sign.triage"], 1);
+    EXPECT_GE(snapshot.counters["mutable_s2shape_index.cells_created"], 1);
+    EXPECT_EQ(snapshot.histograms["mutable_s2shape_index.update_us"].count, 1);
+  } else {
+    EXPECT_TRUE(snapshot.counters.empty()) << snapshot.ToString();
+  }
+}
+
+}  // namespace
+}  // namespace s2telemetry
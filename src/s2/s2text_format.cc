@@ -20,17 +20,18 @@
 #include <utility>
 #include <vector>
 
+#include "absl/functional/function_ref.h"
 #include "absl/log/absl_check.h"
 #include "absl/strings/ascii.h"
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
-#include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 
 #include "s2/mutable_s2shape_index.h"
 #include "s2/s1angle.h"
+#include "s2/s2builder.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_union.h"
 #include "s2/s2debug.h"
@@ -55,13 +56,43 @@ using std::vector;
 
 namespace s2textformat {
 
-static vector<string_view> SplitString(string_view str, char separator) {
-  vector<string_view> result =
-      absl::StrSplit(str, separator, absl::SkipWhitespace());
-  for (auto& e : result) {
-    e = absl::StripAsciiWhitespace(e);
+// Splits "str" at each occurrence of "separator" and calls "fn" with each
+// piece, with leading and trailing whitespace removed.  Pieces that consist
+// entirely of whitespace are skipped.  Stops and returns false as soon as
+// "fn" returns false.
+template <class Fn>
+static bool ForEachPiece(string_view str, char separator, Fn fn) {
+  for (;;) {
+    const size_t end = str.find(separator);
+    const string_view piece = absl::StripAsciiWhitespace(str.substr(0, end));
+    if (!piece.empty() && !fn(piece)) return false;
+    if (end == string_view::npos) return true;
+    str.remove_prefix(end + 1);
+  }
+}
+
+// Calls "fn(lat, lng)" with each coordinate pair (in degrees) in a string
+// in the format accepted by ParseLatLngs().  This is the basis of all the
+// other parsing functions, and avoids allocating any memory.
+template <class Fn>
+static bool ForEachLatLngDegrees(string_view str, Fn fn) {
+  for (;;) {
+    const size_t end = str.find(',');
+    const string_view lat_lng = str.substr(0, end);
+    if (!lat_lng.empty()) {
+      const size_t colon = lat_lng.find(':');
+      if (colon == string_view::npos ||
+          lat_lng.find(':', colon + 1) != string_view::npos) {
+        return false;
+      }
+      double lat, lng;
+      if (!absl::SimpleAtod(lat_lng.substr(0, colon), &lat)) return false;
+      if (!absl::SimpleAtod(lat_lng.substr(colon + 1), &lng)) return false;
+      fn(lat, lng);
+    }
+    if (end == string_view::npos) return true;
+    str.remove_prefix(end + 1);
   }
-  return result;
 }
 
 vector<S2LatLng> ParseLatLngsOrDie(string_view str) {
@@ -71,16 +102,9 @@ vector<S2LatLng> ParseLatLngsOrDie(string_view str) {
 }
 
 bool ParseLatLngs(string_view str, vector<S2LatLng>* latlngs) {
-  for (const string_view lat_lng_str :
-       absl::StrSplit(str, ',', absl::SkipEmpty())) {
-    const vector<string_view> lat_lng = absl::StrSplit(lat_lng_str, ':');
-    if (lat_lng.size() != 2) return false;
-    double lat, lng;
-    if (!absl::SimpleAtod(lat_lng[0], &lat)) return false;
-    if (!absl::SimpleAtod(lat_lng[1], &lng)) return false;
+  return ForEachLatLngDegrees(str, [latlngs](double lat, double lng) {
     latlngs->push_back(S2LatLng::FromDegrees(lat, lng));
-  }
-  return true;
+  });
 }
 
 vector<S2Point> ParsePointsOrDie(string_view str) {
@@ -90,14 +114,23 @@ vector<S2Point> ParsePointsOrDie(string_view str) {
 }
 
 bool ParsePoints(string_view str, vector<S2Point>* vertices) {
+  // The coordinates are converted in a single batch, which is faster than
+  // converting each S2LatLng as it is parsed.
   vector<S2LatLng> latlngs;
   if (!ParseLatLngs(str, &latlngs)) return false;
-  for (const auto& latlng : latlngs) {
-    vertices->push_back(latlng.ToPoint());
-  }
+  const size_t size = vertices->size();
+  vertices->resize(size + latlngs.size());
+  S2LatLng::ToPoints(latlngs, absl::MakeSpan(*vertices).subspan(size));
   return true;
 }
 
+bool VisitPoints(string_view str,
+                 absl::FunctionRef<void(const S2Point&)> visitor) {
+  return ForEachLatLngDegrees(str, [visitor](double lat, double lng) {
+    visitor(S2LatLng::FromDegrees(lat, lng).ToPoint());
+  });
+}
+
 S2Point MakePointOrDie(string_view str) {
   S2Point point;
   ABSL_CHECK(MakePoint(str, &point)) << ": str == \"" << str << "\"";
@@ -105,17 +138,25 @@ S2Point MakePointOrDie(string_view str) {
 }
 
 bool MakePoint(string_view str, S2Point* point) {
-  vector<S2Point> vertices;
-  if (!ParsePoints(str, &vertices) || vertices.size() != 1) return false;
-  *point = vertices[0];
-  return true;
+  int num_points = 0;
+  if (!VisitPoints(str, [&](const S2Point& p) {
+        *point = p;
+        ++num_points;
+      })) {
+    return false;
+  }
+  return num_points == 1;
 }
 
 bool MakeLatLng(string_view str, S2LatLng* latlng) {
-  vector<S2LatLng> latlngs;
-  if (!ParseLatLngs(str, &latlngs) || latlngs.size() != 1) return false;
-  *latlng = latlngs[0];
-  return true;
+  int num_latlngs = 0;
+  if (!ForEachLatLngDegrees(str, [&](double lat, double lng) {
+        *latlng = S2LatLng::FromDegrees(lat, lng);
+        ++num_latlngs;
+      })) {
+    return false;
+  }
+  return num_latlngs == 1;
 }
 
 S2LatLng MakeLatLngOrDie(string_view str) {
@@ -153,10 +194,13 @@ S2CellId MakeCellIdOrDie(string_view str) {
 
 bool MakeCellUnion(string_view str, S2CellUnion* cell_union) {
   vector<S2CellId> cell_ids;
-  for (const auto& cell_str : SplitString(str, ',')) {
-    S2CellId cell_id;
-    if (!MakeCellId(cell_str, &cell_id)) return false;
-    cell_ids.push_back(cell_id);
+  if (!ForEachPiece(str, ',', [&cell_ids](string_view cell_str) {
+        S2CellId cell_id;
+        if (!MakeCellId(cell_str, &cell_id)) return false;
+        cell_ids.push_back(cell_id);
+        return true;
+      })) {
+    return false;
   }
   *cell_union = S2CellUnion(std::move(cell_ids));
   return true;
@@ -227,14 +271,16 @@ static bool InternalMakePolygon(string_view str,
                                 bool normalize_loops,
                                 unique_ptr<S2Polygon>* polygon) {
   if (str == "empty") str = "";
-  vector<string_view> loop_strs = SplitString(str, ';');
   vector<unique_ptr<S2Loop>> loops;
-  for (const auto& loop_str : loop_strs) {
-    unique_ptr<S2Loop> loop;
-    if (!MakeLoop(loop_str, &loop, debug_override)) return false;
-    // Don't normalize loops that were explicitly specified as "full".
-    if (normalize_loops && !loop->is_full()) loop->Normalize();
-    loops.push_back(std::move(loop));
+  if (!ForEachPiece(str, ';', [&](string_view loop_str) {
+        unique_ptr<S2Loop> loop;
+        if (!MakeLoop(loop_str, &loop, debug_override)) return false;
+        // Don't normalize loops that were explicitly specified as "full".
+        if (normalize_loops && !loop->is_full()) loop->Normalize();
+        loops.push_back(std::move(loop));
+        return true;
+      })) {
+    return false;
   }
   *polygon = make_unique<S2Polygon>(std::move(loops), debug_override);
   return true;
@@ -272,16 +318,17 @@ unique_ptr<S2LaxPolygonShape> MakeLaxPolygonOrDie(string_view str) {
 
 bool MakeLaxPolygon(string_view str,
                     unique_ptr<S2LaxPolygonShape>* lax_polygon) {
-  vector<string_view> loop_strs = SplitString(str, ';');
   vector<vector<S2Point>> loops;
-  for (const auto& loop_str : loop_strs) {
-    if (loop_str == "full") {
-      loops.push_back(vector<S2Point>());
-    } else if (loop_str != "empty") {
-      vector<S2Point> points;
-      if (!ParsePoints(loop_str, &points)) return false;
-      loops.push_back(points);
-    }
+  if (!ForEachPiece(str, ';', [&loops](string_view loop_str) {
+        if (loop_str == "full") {
+          loops.emplace_back();
+        } else if (loop_str != "empty") {
+          loops.emplace_back();
+          if (!ParsePoints(loop_str, &loops.back())) return false;
+        }
+        return true;
+      })) {
+    return false;
   }
   *lax_polygon = make_unique<S2LaxPolygonShape>(loops);
   return true;
@@ -293,30 +340,95 @@ unique_ptr<MutableS2ShapeIndex> MakeIndexOrDie(string_view str) {
   return index;
 }
 
+// Splits a string in the format accepted by MakeIndex() into its point,
+// polyline, and polygon sections.
+static bool SplitIndexString(string_view str, string_view sections[3]) {
+  for (int i = 0; i < 2; ++i) {
+    const size_t end = str.find('#');
+    if (end == string_view::npos) return false;
+    sections[i] = str.substr(0, end);
+    str.remove_prefix(end + 1);
+  }
+  sections[2] = str;
+  return str.find('#') == string_view::npos;
+}
+
 bool MakeIndex(string_view str, unique_ptr<MutableS2ShapeIndex>* index) {
-  vector<string_view> strs = absl::StrSplit(str, '#');
-  ABSL_DCHECK_EQ(3, strs.size()) << "Must contain two # characters: " << str;
+  string_view sections[3];
+  const bool split_ok = SplitIndexString(str, sections);
+  ABSL_DCHECK(split_ok) << "Must contain two # characters: " << str;
+  if (!split_ok) return false;
 
   vector<S2Point> points;
-  for (const auto& point_str : SplitString(strs[0], '|')) {
-    S2Point point;
-    if (!MakePoint(point_str, &point)) return false;
-    points.push_back(point);
+  if (!ForEachPiece(sections[0], '|', [&points](string_view point_str) {
+        S2Point point;
+        if (!MakePoint(point_str, &point)) return false;
+        points.push_back(point);
+        return true;
+      })) {
+    return false;
   }
   if (!points.empty()) {
     (*index)->Add(make_unique<S2PointVectorShape>(std::move(points)));
   }
-  for (const auto& line_str : SplitString(strs[1], '|')) {
-    unique_ptr<S2LaxPolylineShape> lax_polyline;
-    if (!MakeLaxPolyline(line_str, &lax_polyline)) return false;
-    (*index)->Add(std::move(lax_polyline));
+  if (!ForEachPiece(sections[1], '|', [index](string_view line_str) {
+        unique_ptr<S2LaxPolylineShape> lax_polyline;
+        if (!MakeLaxPolyline(line_str, &lax_polyline)) return false;
+        (*index)->Add(std::move(lax_polyline));
+        return true;
+      })) {
+    return false;
   }
-  for (const auto& polygon_str : SplitString(strs[2], '|')) {
+  return ForEachPiece(sections[2], '|', [index](string_view polygon_str) {
     unique_ptr<S2LaxPolygonShape> lax_polygon;
     if (!MakeLaxPolygon(polygon_str, &lax_polygon)) return false;
     (*index)->Add(std::move(lax_polygon));
+    return true;
+  });
+}
+
+bool AddToBuilder(string_view str, S2Builder* builder) {
+  string_view sections[3];
+  if (!SplitIndexString(str, sections)) return false;
+
+  // Points are added as degenerate edges.
+  if (!ForEachPiece(sections[0], '|', [builder](string_view point_str) {
+        return VisitPoints(point_str, [builder](const S2Point& p) {
+          builder->AddPoint(p);
+        });
+      })) {
+    return false;
   }
-  return true;
+  // Polylines and loops are added edge by edge as their vertices are parsed.
+  // A polyline consisting of a single vertex adds no edges, whereas a loop
+  // consisting of a single vertex adds a degenerate edge.
+  auto add_chain = [builder](string_view chain_str, bool closed) {
+    S2Point first, prev;
+    int num_vertices = 0;
+    if (!VisitPoints(chain_str, [&](const S2Point& p) {
+          if (num_vertices++ == 0) {
+            first = p;
+          } else {
+            builder->AddEdge(prev, p);
+          }
+          prev = p;
+        })) {
+      return false;
+    }
+    if (closed && num_vertices > 0) builder->AddEdge(prev, first);
+    return true;
+  };
+  if (!ForEachPiece(sections[1], '|', [&](string_view line_str) {
+        return add_chain(line_str, false);
+      })) {
+    return false;
+  }
+  return ForEachPiece(sections[2], '|', [&](string_view polygon_str) {
+    return ForEachPiece(polygon_str, ';', [&](string_view loop_str) {
+      if (loop_str == "empty" || loop_str == "full") return true;
+      return add_chain(loop_str, true);
+    });
+  });
 }
 
 static void AppendVertex(const S2LatLng& ll, string* out,
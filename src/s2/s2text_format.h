@@ -28,6 +28,7 @@
 #include <vector>
 
 #include "absl/base/macros.h"
+#include "absl/functional/function_ref.h"
 #include "absl/log/absl_check.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
@@ -48,6 +49,7 @@
 #include "s2/s2shape_index.h"
 
 class MutableS2ShapeIndex;
+class S2Builder;
 class S2LaxPolygonShape;
 class S2LaxPolylineShape;
 class S2Loop;
@@ -91,6 +93,14 @@ std::vector<S2Point> ParsePointsOrDie(absl::string_view str);
 ABSL_MUST_USE_RESULT bool ParsePoints(absl::string_view str,
                                std::vector<S2Point>* vertices);
 
+// Parses a string in the same format as ParseLatLngs and calls "visitor" with
+// each point in order, without allocating any intermediate storage.  This is
+// useful for very large inputs (e.g. debugging dumps with millions of
+// vertices).  Returns false on invalid input, in which case "visitor" may
+// already have been called for a prefix of the points.
+ABSL_MUST_USE_RESULT bool VisitPoints(
+    absl::string_view str, absl::FunctionRef<void(const S2Point&)> visitor);
+
 // Given a string in the same format as ParseLatLngs, returns a single S2LatLng.
 S2LatLng MakeLatLngOrDie(absl::string_view str);
 
@@ -242,6 +252,17 @@ std::unique_ptr<MutableS2ShapeIndex> MakeIndexOrDie(absl::string_view str);
 ABSL_MUST_USE_RESULT bool MakeIndex(absl::string_view str,
                              std::unique_ptr<MutableS2ShapeIndex>* index);
 
+// Parses a string in the format accepted by MakeIndex() and adds its
+// geometry directly to the current layer of "builder", without creating any
+// intermediate shapes or vertex vectors.  Points are added as degenerate
+// edges, polylines as chains of edges, and each polygon loop as a closed
+// chain of edges; "empty" and "full" loops do not add any edges.  (Note
+// that the output layer needs to be told about full polygons separately,
+// e.g. using S2Builder::IsFullPolygonPredicate.)  Returns false on invalid
+// input, in which case some of the edges may have been added already.
+ABSL_MUST_USE_RESULT bool AddToBuilder(absl::string_view str,
+                                       S2Builder* builder);
+
 // Convert an S2Point, S2LatLng, S2LatLngRect, S2CellId, S2CellUnion, loop,
 // polyline, or polygon to the string format above.
 std::string ToString(const S2Point& point);
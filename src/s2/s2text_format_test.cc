@@ -30,8 +30,13 @@
 #include "s2/base/types.h"
 #include "s2/mutable_s2shape_index.h"
 #include "s2/s1angle.h"
+#include "s2/s2boolean_operation.h"
+#include "s2/s2builder.h"
+#include "s2/s2builderutil_lax_polygon_layer.h"
+#include "s2/s2builderutil_s2polyline_layer.h"
 #include "s2/s2cell_id.h"
 #include "s2/s2cell_union.h"
+#include "s2/s2error.h"
 #include "s2/s2latlng.h"
 #include "s2/s2latlng_rect.h"
 #include "s2/s2lax_polygon_shape.h"
@@ -306,6 +311,23 @@ TEST(SafeParsePoints, InvalidInput) {
   EXPECT_FALSE(s2textformat::ParsePoints("blah", &vertices));
 }
 
+TEST(VisitPoints, ValidInput) {
+  vector<S2Point> vertices;
+  EXPECT_TRUE(s2textformat::VisitPoints(
+      " -20:150,, -20:151 , -19:150,",
+      [&](const S2Point& p) { vertices.push_back(p); }));
+  EXPECT_EQ(vertices, s2textformat::ParsePointsOrDie(
+                          "-20:150, -20:151, -19:150"));
+}
+
+TEST(VisitPoints, InvalidInput) {
+  auto ignore = [](const S2Point&) {};
+  EXPECT_FALSE(s2textformat::VisitPoints("blah", ignore));
+  EXPECT_FALSE(s2textformat::VisitPoints("1:2:3", ignore));
+  EXPECT_FALSE(s2textformat::VisitPoints("1:2, 3", ignore));
+  EXPECT_FALSE(s2textformat::VisitPoints("1:2, , 3:4", ignore));
+}
+
 TEST(SafeMakeLatLngRect, ValidInput) {
   S2LatLngRect rect;
   EXPECT_TRUE(s2textformat::MakeLatLngRect("-10:-10, 10:10", &rect));
@@ -500,4 +522,37 @@ TEST(SafeMakeIndex, InvalidInput) {
   EXPECT_FALSE(s2textformat::MakeIndex("# blah #", &index));
 }
 
+TEST(AddToBuilder, Polyline) {
+  S2Builder builder{S2Builder::Options()};
+  S2Polyline polyline;
+  builder.StartLayer(
+      make_unique<s2builderutil::S2PolylineLayer>(&polyline));
+  EXPECT_TRUE(s2textformat::AddToBuilder("# 0:0, 0:1, 1:1 #", &builder));
+  S2Error error;
+  ASSERT_TRUE(builder.Build(&error)) << error;
+  EXPECT_EQ("0:0, 0:1, 1:1", s2textformat::ToString(polyline));
+}
+
+TEST(AddToBuilder, PolygonsMatchMakeIndex) {
+  const string str = "# # 0:0, 0:3, 3:0; 1:1, 2:1, 1:2 | 5:5, 5:6, 6:5";
+  S2Builder builder{S2Builder::Options()};
+  auto polygon = make_unique<S2LaxPolygonShape>();
+  builder.StartLayer(
+      make_unique<s2builderutil::LaxPolygonLayer>(polygon.get()));
+  EXPECT_TRUE(s2textformat::AddToBuilder(str, &builder));
+  S2Error error;
+  ASSERT_TRUE(builder.Build(&error)) << error;
+  EXPECT_EQ(polygon->num_edges(), 9);
+  MutableS2ShapeIndex actual;
+  actual.Add(std::move(polygon));
+  EXPECT_TRUE(
+      S2BooleanOperation::Equals(actual, *s2textformat::MakeIndexOrDie(str)));
+}
+
+TEST(AddToBuilder, InvalidInput) {
+  S2Builder builder{S2Builder::Options()};
+  EXPECT_FALSE(s2textformat::AddToBuilder("# blah #", &builder));
+  EXPECT_FALSE(s2textformat::AddToBuilder("0:0 #", &builder));
+}
+
 }  // namespace
@@ -0,0 +1,408 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2tuning.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "absl/base/attributes.h"
+#include "absl/types/span.h"
+#include "s2/base/types.h"
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s1angle.h"
+#include "s2/s2cell.h"
+#include "s2/s2cell_id.h"
+#include "s2/s2closest_edge_query.h"
+#include "s2/s2contains_point_query.h"
+#include "s2/s2crossing_edge_query.h"
+#include "s2/s2edge_crosser.h"
+#include "s2/s2loop.h"
+#include "s2/s2metrics.h"
+#include "s2/s2min_distance_targets.h"
+#include "s2/s2point.h"
+#include "s2/s2pointutil.h"
+#include "s2/s2shape.h"
+#include "s2/s2shape_index.h"
+#include "s2/s2shapeutil_contains_brute_force.h"
+#include "s2/s2shapeutil_shape_edge_id.h"
+#include "s2/util/math/matrix3x3.h"
+
+using s2shapeutil::ShapeEdgeId;
+using std::make_unique;
+using std::max;
+using std::min;
+using std::unique_ptr;
+using std::vector;
+
+namespace s2tuning {
+
+namespace internal {
+
+ABSL_CONST_INIT AtomicThresholds thresholds = {
+    {Thresholds().max_brute_force_contains_vertices},
+    {Thresholds().max_unindexed_contains_calls},
+    {Thresholds().max_brute_force_crossing_edges},
+    {Thresholds().max_brute_force_closest_edge_point_target},
+    {Thresholds().max_brute_force_closest_edge_edge_target},
+    {Thresholds().max_brute_force_closest_edge_cell_target},
+    {Thresholds().max_brute_force_closest_edge_index_target},
+};
+
+}  // namespace internal
+
+bool Thresholds::operator==(const Thresholds& other) const {
+  return (max_brute_force_contains_vertices ==
+              other.max_brute_force_contains_vertices &&
+          max_unindexed_contains_calls == other.max_unindexed_contains_calls &&
+          max_brute_force_crossing_edges ==
+              other.max_brute_force_crossing_edges &&
+          max_brute_force_closest_edge_point_target ==
+              other.max_brute_force_closest_edge_point_target &&
+          max_brute_force_closest_edge_edge_target ==
+              other.max_brute_force_closest_edge_edge_target &&
+          max_brute_force_closest_edge_cell_target ==
+              other.max_brute_force_closest_edge_cell_target &&
+          max_brute_force_closest_edge_index_target ==
+              other.max_brute_force_closest_edge_index_target);
+}
+
+Thresholds GetThresholds() {
+  Thresholds result;
+  result.max_brute_force_contains_vertices =
+      max_brute_force_contains_vertices();
+  result.max_unindexed_contains_calls = max_unindexed_contains_calls();
+  result.max_brute_force_crossing_edges = max_brute_force_crossing_edges();
+  result.max_brute_force_closest_edge_point_target =
+      max_brute_force_closest_edge_point_target();
+  result.max_brute_force_closest_edge_edge_target =
+      max_brute_force_closest_edge_edge_target();
+  result.max_brute_force_closest_edge_cell_target =
+      max_brute_force_closest_edge_cell_target();
+  result.max_brute_force_closest_edge_index_target =
+      max_brute_force_closest_edge_index_target();
+  return result;
+}
+
+static void Store(std::atomic<int>* threshold, int value) {
+  threshold->store(max(0, value), std::memory_order_relaxed);
+}
+
+void SetThresholds(const Thresholds& t) {
+  internal::AtomicThresholds& a = internal::thresholds;
+  Store(&a.max_brute_force_contains_vertices,
+        t.max_brute_force_contains_vertices);
+  Store(&a.max_unindexed_contains_calls,
+        max(1, t.max_unindexed_contains_calls));
+  Store(&a.max_brute_force_crossing_edges, t.max_brute_force_crossing_edges);
+  Store(&a.max_brute_force_closest_edge_point_target,
+        t.max_brute_force_closest_edge_point_target);
+  Store(&a.max_brute_force_closest_edge_edge_target,
+        t.max_brute_force_closest_edge_edge_target);
+  Store(&a.max_brute_force_closest_edge_cell_target,
+        t.max_brute_force_closest_edge_cell_target);
+  Store(&a.max_brute_force_closest_edge_index_target,
+        t.max_brute_force_closest_edge_index_target);
+}
+
+void ResetThresholds() {
+  SetThresholds(Thresholds());
+}
+
+int FindCrossover(absl::Span<const CostSample> samples) {
+  if (samples.empty()) return 0;
+  vector<CostSample> sorted(samples.begin(), samples.end());
+  std::sort(sorted.begin(), sorted.end(),
+            [](const CostSample& a, const CostSample& b) {
+              return a.size < b.size;
+            });
+  // Timings are noisy, so we look for the largest size where brute force is
+  // no slower rather than the smallest size where it is slower.
+  auto margin = [](const CostSample& s) {
+    return s.indexed_cost - s.brute_force_cost;
+  };
+  const int n = sorted.size();
+  int i = n - 1;
+  while (i >= 0 && margin(sorted[i]) < 0) --i;
+  if (i < 0) return 0;
+  if (i == n - 1) return sorted[i].size;
+  const CostSample& a = sorted[i];
+  const CostSample& b = sorted[i + 1];
+  double fraction = margin(a) / (margin(a) - margin(b));
+  return a.size + static_cast<int>(fraction * (b.size - a.size));
+}
+
+namespace {
+
+// Targets that always use the index, so that the indexed algorithm can be
+// timed for small indexes.
+template <class Base>
+class IndexedTarget final : public Base {
+ public:
+  using Base::Base;
+  int max_brute_force_index_size() const override { return 0; }
+};
+
+// Prevents the compiler from optimizing away the timed computations.
+std::atomic<int64> sink{0};
+
+// Returns the minimum over several runs of the average time per call of
+// "fn(i)" for i in [0, num_queries), in nanoseconds.
+template <class Fn>
+double TimeNs(int num_queries, const Fn& fn) {
+  static constexpr int kNumRuns = 3;
+  double best = std::numeric_limits<double>::infinity();
+  int64 total = 0;
+  for (int run = 0; run < kNumRuns; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_queries; ++i) total += fn(i);
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = min(best, elapsed.count() / num_queries);
+  }
+  sink.fetch_add(total, std::memory_order_relaxed);
+  return best;
+}
+
+// The geometry used to measure the crossover points for one input size: a
+// regular loop, its index, and some random queries near the loop.
+class Workload {
+ public:
+  Workload(int num_vertices, int num_queries);
+
+  int num_vertices() const { return loop_->num_vertices(); }
+  const S2Shape& shape() const { return *index_.shape(0); }
+  const MutableS2ShapeIndex& index() const { return index_; }
+
+  // Returns a random point within twice the loop radius of its center.
+  S2Point SamplePoint();
+
+  // Builds a new index containing the loop and returns the time taken.
+  double TimeBuildIndexNs() const;
+
+  vector<S2Point> points;
+  vector<S2Point> edge_ends;  // Edge i is (points[i], edge_ends[i]).
+  vector<S2Cell> cells;
+  vector<unique_ptr<MutableS2ShapeIndex>> target_indexes;
+
+ private:
+  static constexpr double kRadiusDegrees = 0.1;
+
+  Matrix3x3_d frame_;
+  unique_ptr<S2Loop> loop_;
+  MutableS2ShapeIndex index_;
+  std::mt19937_64 rng_;
+};
+
+Workload::Workload(int num_vertices, int num_queries)
+    : frame_(S2::GetFrame(S2Point(1, 2, 3).Normalize())),
+      loop_(S2Loop::MakeRegularLoop(frame_, S1Angle::Degrees(kRadiusDegrees),
+                                    num_vertices)),
+      rng_(num_vertices) {
+  index_.Add(make_unique<S2Loop::Shape>(loop_.get()));
+  index_.ForceBuild();
+  S1Angle radius = S1Angle::Degrees(kRadiusDegrees);
+  int cell_level = S2::kAvgEdge.GetClosestLevel(radius.radians() / 4);
+  // A few loops of the same size around this one, for the ShapeIndexTarget
+  // measurements.
+  const int num_target_indexes = min(num_queries, 4);
+  for (int i = 0; i < num_target_indexes; ++i) {
+    double r = 2.5 * radius.radians();
+    double theta = 2 * M_PI * i / num_target_indexes;
+    Matrix3x3_d frame = S2::GetFrame(S2::FromFrame(
+        frame_, S2Point(std::sin(r) * std::cos(theta),
+                        std::sin(r) * std::sin(theta), std::cos(r))
+                    .Normalize()));
+    auto index = make_unique<MutableS2ShapeIndex>();
+    index->Add(make_unique<S2Loop::OwningShape>(
+        S2Loop::MakeRegularLoop(frame, radius, num_vertices)));
+    index->ForceBuild();
+    target_indexes.push_back(std::move(index));
+  }
+  for (int i = 0; i < num_queries; ++i) {
+    points.push_back(SamplePoint());
+    edge_ends.push_back(SamplePoint());
+    cells.push_back(S2Cell(S2CellId(SamplePoint()).parent(cell_level)));
+  }
+}
+
+S2Point Workload::SamplePoint() {
+  std::uniform_real_distribution<double> uniform(0, 1);
+  double r = 2 * S1Angle::Degrees(kRadiusDegrees).radians() *
+             std::sqrt(uniform(rng_));
+  double theta = 2 * M_PI * uniform(rng_);
+  return S2::FromFrame(frame_, S2Point(std::sin(r) * std::cos(theta),
+                                       std::sin(r) * std::sin(theta),
+                                       std::cos(r)))
+      .Normalize();
+}
+
+double Workload::TimeBuildIndexNs() const {
+  return TimeNs(1, [this](int) {
+    MutableS2ShapeIndex index;
+    index.Add(make_unique<S2Loop::Shape>(loop_.get()));
+    index.ForceBuild();
+    return index.num_shape_ids();
+  });
+}
+
+CostSample MeasureContains(Workload* w, int num_queries) {
+  auto query = MakeS2ContainsPointQuery(&w->index());
+  CostSample sample;
+  sample.size = w->num_vertices();
+  sample.brute_force_cost = TimeNs(num_queries, [w](int i) {
+    return s2shapeutil::ContainsBruteForce(w->shape(), w->points[i]);
+  });
+  sample.indexed_cost = TimeNs(num_queries, [w, &query](int i) {
+    return query.Contains(w->points[i]);
+  });
+  return sample;
+}
+
+CostSample MeasureCrossingEdges(Workload* w, int num_queries) {
+  S2CrossingEdgeQuery query(&w->index());
+  const S2Shape& shape = w->shape();
+  CostSample sample;
+  sample.size = shape.num_edges();
+  sample.brute_force_cost = TimeNs(num_queries, [w, &shape](int i) {
+    S2CopyingEdgeCrosser crosser(w->points[i], w->edge_ends[i]);
+    int count = 0;
+    for (int e = 0; e < shape.num_edges(); ++e) {
+      S2Shape::Edge edge = shape.edge(e);
+      count += crosser.CrossingSign(edge.v0, edge.v1) >= 0;
+    }
+    return count;
+  });
+  // This mirrors S2CrossingEdgeQuery::GetCrossingEdges() when the index is
+  // used: collect the candidates, remove duplicates, and test each one.
+  vector<ShapeEdgeId> candidates;
+  sample.indexed_cost = TimeNs(num_queries, [&](int i) {
+    candidates.clear();
+    query.VisitCells(w->points[i], w->edge_ends[i],
+                     [&candidates](const S2ShapeIndexCell& cell) {
+                       const S2ClippedShape& clipped = cell.clipped(0);
+                       for (int j = 0; j < clipped.num_edges(); ++j) {
+                         candidates.push_back(ShapeEdgeId(0, clipped.edge(j)));
+                       }
+                       return true;
+                     });
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                     candidates.end());
+    S2CopyingEdgeCrosser crosser(w->points[i], w->edge_ends[i]);
+    int count = 0;
+    for (ShapeEdgeId id : candidates) {
+      S2Shape::Edge edge = shape.edge(id.edge_id);
+      count += crosser.CrossingSign(edge.v0, edge.v1) >= 0;
+    }
+    return count;
+  });
+  return sample;
+}
+
+// Measures S2ClosestEdgeQuery::FindClosestEdge() for the targets returned by
+// "make_target(i, indexed)", where "indexed" requests a target that always
+// uses the index.
+template <class MakeTarget>
+CostSample MeasureClosestEdge(Workload* w, int num_queries,
+                              const MakeTarget& make_target) {
+  vector<unique_ptr<S2MinDistanceTarget>> brute_force_targets, indexed_targets;
+  for (int i = 0; i < num_queries; ++i) {
+    brute_force_targets.push_back(make_target(i, false));
+    indexed_targets.push_back(make_target(i, true));
+  }
+  S2ClosestEdgeQuery::Options brute_force_options;
+  brute_force_options.set_use_brute_force(true);
+  S2ClosestEdgeQuery brute_force_query(&w->index(), brute_force_options);
+  S2ClosestEdgeQuery indexed_query(&w->index());
+  CostSample sample;
+  sample.size = w->shape().num_edges();
+  sample.brute_force_cost = TimeNs(num_queries, [&](int i) {
+    return brute_force_query.FindClosestEdge(brute_force_targets[i].get())
+        .edge_id();
+  });
+  sample.indexed_cost = TimeNs(num_queries, [&](int i) {
+    return indexed_query.FindClosestEdge(indexed_targets[i].get()).edge_id();
+  });
+  return sample;
+}
+
+// Returns an S2ClosestEdgeQuery target of type "Base", which always uses the
+// index if "indexed" is true.
+template <class Base, class... Args>
+unique_ptr<S2MinDistanceTarget> MakeTarget(bool indexed, const Args&... args) {
+  if (indexed) return make_unique<IndexedTarget<Base>>(args...);
+  return make_unique<Base>(args...);
+}
+
+}  // namespace
+
+Thresholds Calibrate(const CalibrationOptions& options) {
+  const int max_size = max(4, options.max_size);
+  const int num_queries = max(1, options.num_queries);
+  vector<CostSample> contains, crossing, point, edge, cell, index;
+  double build_ns = 0, brute_force_contains_ns = 0, indexed_contains_ns = 0;
+  for (int size = 4;; size = min(max_size, size * 3 / 2)) {
+    Workload w(size, num_queries);
+    contains.push_back(MeasureContains(&w, num_queries));
+    crossing.push_back(MeasureCrossingEdges(&w, num_queries));
+    point.push_back(MeasureClosestEdge(&w, num_queries, [&](int i, bool idx) {
+      return MakeTarget<S2MinDistancePointTarget>(idx, w.points[i]);
+    }));
+    edge.push_back(MeasureClosestEdge(&w, num_queries, [&](int i, bool idx) {
+      return MakeTarget<S2MinDistanceEdgeTarget>(idx, w.points[i],
+                                                 w.edge_ends[i]);
+    }));
+    cell.push_back(MeasureClosestEdge(&w, num_queries, [&](int i, bool idx) {
+      return MakeTarget<S2MinDistanceCellTarget>(idx, w.cells[i]);
+    }));
+    index.push_back(MeasureClosestEdge(&w, num_queries, [&](int i, bool idx) {
+      const S2ShapeIndex* target_index =
+          w.target_indexes[i % w.target_indexes.size()].get();
+      return MakeTarget<S2MinDistanceShapeIndexTarget>(idx, target_index);
+    }));
+    if (size == max_size) {
+      build_ns = w.TimeBuildIndexNs();
+      brute_force_contains_ns = contains.back().brute_force_cost;
+      indexed_contains_ns = contains.back().indexed_cost;
+      break;
+    }
+  }
+  Thresholds result;
+  result.max_brute_force_contains_vertices = FindCrossover(contains);
+  result.max_brute_force_crossing_edges = FindCrossover(crossing);
+  result.max_brute_force_closest_edge_point_target = FindCrossover(point);
+  result.max_brute_force_closest_edge_edge_target = FindCrossover(edge);
+  result.max_brute_force_closest_edge_cell_target = FindCrossover(cell);
+  result.max_brute_force_closest_edge_index_target = FindCrossover(index);
+
+  // Building the index pays for itself once the time saved by the indexed
+  // Contains() calls equals the time taken to build it.  Like the default,
+  // we build it somewhat before this point (see S2Loop::Contains).
+  double saved_ns = brute_force_contains_ns - indexed_contains_ns;
+  if (saved_ns > 0) {
+    result.max_unindexed_contains_calls =
+        max(1, static_cast<int>(std::lround(0.4 * build_ns / saved_ns)));
+  }
+  return result;
+}
+
+}  // namespace s2tuning
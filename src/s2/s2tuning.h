@@ -0,0 +1,190 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef S2_S2TUNING_H_
+#define S2_S2TUNING_H_
+
+// Process-wide thresholds that S2 classes use to choose between brute-force
+// and indexed algorithms, e.g. the number of edges below which
+// S2CrossingEdgeQuery tests every edge rather than using the S2ShapeIndex.
+// The defaults were determined using the benchmarks on one machine, but the
+// actual crossover points depend on the CPU, the compiler, and the geometry
+// being queried.  Clients that care can measure them on the host at startup:
+//
+//   int main(int argc, char** argv) {
+//     ...
+//     s2tuning::SetThresholds(s2tuning::Calibrate());
+//
+// or compute them from timings sampled in production (see FindCrossover).
+//
+// The thresholds may be changed at any time and from any thread.  Queries
+// that are in progress may continue to use the old values, and an S2Loop or
+// S2Polygon whose Contains() call count is already past a lowered
+// max_unindexed_contains_calls keeps using brute force until it is modified.
+
+#include <atomic>
+
+#include "absl/types/span.h"
+#include "s2/base/types.h"
+
+namespace s2tuning {
+
+struct Thresholds {
+  // S2Loop::Contains(S2Point) and S2Polygon::Contains(S2Point) always use
+  // brute force when the geometry has at most this many vertices.
+  int max_brute_force_contains_vertices = 32;
+
+  // Otherwise they build the S2ShapeIndex once Contains() has been called
+  // this many times.  Building the index costs roughly as much as 50 calls
+  // to Contains(); the default is lower because the index may be built
+  // anyway by other API calls (see the notes in S2Loop::Contains).
+  int max_unindexed_contains_calls = 20;
+
+  // S2CrossingEdgeQuery tests every edge rather than using the S2ShapeIndex
+  // when the index (or shape) has at most this many edges.
+  int max_brute_force_crossing_edges = 27;
+
+  // S2ClosestEdgeQuery uses brute force when the index has at most this many
+  // edges.  The threshold depends on the target type.  Using the benchmarks
+  // (which find the single closest edge), the break-even points are:
+  //
+  //   PointTarget:       80, 100 and 250 edges
+  //   EdgeTarget:        40,  50 and 100 edges
+  //   CellTarget:        20,  25 and  40 edges
+  //   ShapeIndexTarget:  20,  30 and  40 edges (for a similar-sized index)
+  //
+  // for point cloud, fractal, and regular loop geometry respectively.
+  int max_brute_force_closest_edge_point_target = 120;
+  int max_brute_force_closest_edge_edge_target = 60;
+  int max_brute_force_closest_edge_cell_target = 30;
+  int max_brute_force_closest_edge_index_target = 25;
+
+  bool operator==(const Thresholds& other) const;
+  bool operator!=(const Thresholds& other) const { return !(*this == other); }
+};
+
+// Returns the current thresholds.
+Thresholds GetThresholds();
+
+// Replaces the current thresholds.  Negative values are treated as zero,
+// and max_unindexed_contains_calls is at least 1.
+void SetThresholds(const Thresholds& thresholds);
+
+// Restores the default thresholds.
+void ResetThresholds();
+
+// One measurement of the cost of a brute-force and an indexed algorithm on
+// inputs of the given size.  Costs may be in any units (e.g. nanoseconds per
+// query) as long as both are in the same units.
+struct CostSample {
+  int size = 0;
+  double brute_force_cost = 0;
+  double indexed_cost = 0;
+};
+
+// Returns the largest input size for which the brute-force algorithm is
+// estimated to be no slower than the indexed algorithm, interpolating
+// linearly between the samples on either side of the crossover.  Returns 0
+// if the indexed algorithm is faster for every sample, and the largest
+// sample size if brute force is never slower.  Samples may be given in any
+// order; this is intended for feeding timings sampled in production (e.g.
+// from S2ClosestEdgeQuery::last_query_stats()) back into the thresholds.
+int FindCrossover(absl::Span<const CostSample> samples);
+
+struct CalibrationOptions {
+  // The largest input size that is measured.  Thresholds that would be
+  // larger than this are clamped to it.
+  int max_size = 256;
+
+  // The number of queries timed for each algorithm and input size.  The
+  // minimum of several runs is used to reduce noise.
+  int num_queries = 50;
+};
+
+// Measures the crossover points on the current host using regular loops
+// (which is how most of the defaults were chosen) and returns the
+// corresponding thresholds.  This takes on the order of a second with the
+// default options and does not change the current thresholds.
+Thresholds Calibrate(const CalibrationOptions& options = CalibrationOptions());
+
+//////////////////   Implementation details follow   ////////////////////
+
+// These accessors are called by the library whenever it chooses between
+// algorithms, and are cheap enough to be called on every query.
+int max_brute_force_contains_vertices();
+int max_unindexed_contains_calls();
+int max_brute_force_crossing_edges();
+int max_brute_force_closest_edge_point_target();
+int max_brute_force_closest_edge_edge_target();
+int max_brute_force_closest_edge_cell_target();
+int max_brute_force_closest_edge_index_target();
+
+namespace internal {
+
+// The current thresholds, stored as relaxed atomics so that they can be read
+// without synchronization.  This struct is constant-initialized, so the
+// thresholds may be used during static initialization.
+struct AtomicThresholds {
+  std::atomic<int> max_brute_force_contains_vertices;
+  std::atomic<int> max_unindexed_contains_calls;
+  std::atomic<int> max_brute_force_crossing_edges;
+  std::atomic<int> max_brute_force_closest_edge_point_target;
+  std::atomic<int> max_brute_force_closest_edge_edge_target;
+  std::atomic<int> max_brute_force_closest_edge_cell_target;
+  std::atomic<int> max_brute_force_closest_edge_index_target;
+};
+
+extern AtomicThresholds thresholds;
+
+}  // namespace internal
+
+inline int max_brute_force_contains_vertices() {
+  return internal::thresholds.max_brute_force_contains_vertices.load(
+      std::memory_order_relaxed);
+}
+
+inline int max_unindexed_contains_calls() {
+  return internal::thresholds.max_unindexed_contains_calls.load(
+      std::memory_order_relaxed);
+}
+
+inline int max_brute_force_crossing_edges() {
+  return internal::thresholds.max_brute_force_crossing_edges.load(
+      std::memory_order_relaxed);
+}
+
+inline int max_brute_force_closest_edge_point_target() {
+  return internal::thresholds.max_brute_force_closest_edge_point_target.load(
+      std::memory_order_relaxed);
+}
+
+inline int max_brute_force_closest_edge_edge_target() {
+  return internal::thresholds.max_brute_force_closest_edge_edge_target.load(
+      std::memory_order_relaxed);
+}
+
+inline int max_brute_force_closest_edge_cell_target() {
+  return internal::thresholds.max_brute_force_closest_edge_cell_target.load(
+      std::memory_order_relaxed);
+}
+
+inline int max_brute_force_closest_edge_index_target() {
+  return internal::thresholds.max_brute_force_closest_edge_index_target.load(
+      std::memory_order_relaxed);
+}
+
+}  // namespace s2tuning
+
+#endif  // S2_S2TUNING_H_
@@ -0,0 +1,110 @@
+// Copyright 2024 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "s2/s2tuning.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "s2/mutable_s2shape_index.h"
+#include "s2/s2closest_edge_query.h"
+#include "s2/s2point.h"
+#include "s2/s2text_format.h"
+
+using std::vector;
+
+namespace s2tuning {
+namespace {
+
+// Restores the default thresholds when a test finishes.
+class S2TuningTest : public ::testing::Test {
+ protected:
+  void TearDown() override { ResetThresholds(); }
+};
+
+TEST_F(S2TuningTest, Defaults) {
+  Thresholds thresholds = GetThresholds();
+  EXPECT_EQ(thresholds, Thresholds());
+  EXPECT_EQ(thresholds.max_brute_force_contains_vertices, 32);
+  EXPECT_EQ(thresholds.max_unindexed_contains_calls, 20);
+  EXPECT_EQ(thresholds.max_brute_force_crossing_edges, 27);
+  EXPECT_EQ(max_brute_force_closest_edge_point_target(), 120);
+}
+
+TEST_F(S2TuningTest, SetThresholds) {
+  Thresholds thresholds;
+  thresholds.max_brute_force_crossing_edges = 5;
+  thresholds.max_unindexed_contains_calls = 0;
+  thresholds.max_brute_force_closest_edge_cell_target = -3;
+  SetThresholds(thresholds);
+  EXPECT_EQ(max_brute_force_crossing_edges(), 5);
+  EXPECT_EQ(max_unindexed_contains_calls(), 1);
+  EXPECT_EQ(max_brute_force_closest_edge_cell_target(), 0);
+  EXPECT_NE(GetThresholds(), Thresholds());
+  ResetThresholds();
+  EXPECT_EQ(GetThresholds(), Thresholds());
+}
+
+TEST_F(S2TuningTest, ThresholdsAffectClosestEdgeQuery) {
+  auto index = s2textformat::MakeIndexOrDie("# 0:0, 0:1, 0:2 #");
+  S2ClosestEdgeQuery::Options options;
+  options.set_record_stats(true);
+  S2ClosestEdgeQuery query(index.get(), options);
+  S2ClosestEdgeQuery::PointTarget target(s2textformat::MakePointOrDie("1:1"));
+  query.FindClosestEdge(&target);
+  EXPECT_EQ(query.last_query_stats().num_brute_force_queries, 1);
+
+  Thresholds thresholds;
+  thresholds.max_brute_force_closest_edge_point_target = 0;
+  SetThresholds(thresholds);
+  query.FindClosestEdge(&target);
+  EXPECT_EQ(query.last_query_stats().num_brute_force_queries, 0);
+}
+
+TEST(S2Tuning, FindCrossover) {
+  EXPECT_EQ(FindCrossover({}), 0);
+  // Brute force is never slower.
+  EXPECT_EQ(FindCrossover({{10, 1, 2}, {20, 2, 3}}), 20);
+  // The index is always faster.
+  EXPECT_EQ(FindCrossover({{10, 3, 2}, {20, 6, 3}}), 0);
+  // The costs are equal halfway between the samples, which are unsorted.
+  EXPECT_EQ(FindCrossover({{40, 8, 4}, {10, 2, 4}, {20, 3, 4}, {30, 6, 5}}),
+            25);
+  // Noise below the crossover is ignored.
+  EXPECT_EQ(FindCrossover({{10, 3, 2}, {20, 2, 3}, {30, 5, 3}}), 23);
+}
+
+TEST(S2Tuning, Calibrate) {
+  CalibrationOptions options;
+  options.max_size = 32;
+  options.num_queries = 5;
+  Thresholds thresholds = Calibrate(options);
+  for (int value : {thresholds.max_brute_force_contains_vertices,
+                    thresholds.max_brute_force_crossing_edges,
+                    thresholds.max_brute_force_closest_edge_point_target,
+                    thresholds.max_brute_force_closest_edge_edge_target,
+                    thresholds.max_brute_force_closest_edge_cell_target,
+                    thresholds.max_brute_force_closest_edge_index_target}) {
+    EXPECT_GE(value, 0);
+    EXPECT_LE(value, options.max_size);
+  }
+  EXPECT_GE(thresholds.max_unindexed_contains_calls, 1);
+  // Calibrate() does not change the current thresholds.
+  EXPECT_EQ(GetThresholds(), Thresholds());
+}
+
+}  // namespace
+}  // namespace s2tuning
@@ -18,10 +18,13 @@
 
 #include "s2/s2winding_operation.h"
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <utility>
 #include <vector>
 
+#include "s2/base/executor.h"
 #include "s2/base/types.h"
 #include "absl/base/optimization.h"
 #include "absl/log/absl_check.h"
@@ -84,11 +87,18 @@ class WindingOracle {
   // Returns the winding number at the given point after snapping.
   int GetWindingNumber(const S2Point& p);
 
+  // Sets (*windings)[i] to the winding number at points[i] for all i, using
+  // up to "num_threads" threads.  This is equivalent to calling
+  // GetWindingNumber() for each point, except that the current reference
+  // point is not changed.
+  void GetWindingNumbers(const vector<S2Point>& points, int num_threads,
+                         s2base::Executor* executor, vector<int>* windings);
+
   // Returns the winding number at the current reference point.
   int current_ref_winding() const { return ref_winding_; }
 
  private:
-  int SignedCrossingDelta(S2EdgeCrosser* crosser, EdgeId e);
+  int SignedCrossingDelta(S2EdgeCrosser* crosser, EdgeId e) const;
 
   const Graph& g_;
 
@@ -159,7 +169,7 @@ WindingOracle::WindingOracle(
 
 // Returns the change in winding number due to crossing the given graph edge.
 inline int WindingOracle::SignedCrossingDelta(S2EdgeCrosser* crosser,
-                                              EdgeId e) {
+                                              EdgeId e) const {
   return crosser->SignedEdgeOrVertexCrossing(&g_.vertex(g_.edge(e).first),
                                              &g_.vertex(g_.edge(e).second));
 }
@@ -190,6 +200,43 @@ int WindingOracle::GetWindingNumber(const S2Point& p) {
   return winding;
 }
 
+void WindingOracle::GetWindingNumbers(const vector<S2Point>& points,
+                                      int num_threads,
+                                      s2base::Executor* executor,
+                                      vector<int>* windings) {
+  // The index must be built before it is used by several threads.
+  index_.ForceBuild();
+  windings->resize(points.size());
+
+  // The points are divided into chunks of consecutive points.  Each chunk
+  // starts at the current reference point and then updates its own
+  // reference point as it goes along (see GetWindingNumber).
+  constexpr int kPointsPerChunk = 64;
+  const int n = points.size();
+  const int num_chunks = (n + kPointsPerChunk - 1) / kPointsPerChunk;
+  std::atomic<int> next_chunk(0);
+  s2base::RunConcurrently(
+      executor, std::min(num_threads, num_chunks), [&]() {
+        S2CrossingEdgeQuery query(&index_);
+        vector<ShapeEdgeId> candidates;
+        for (int c; (c = next_chunk.fetch_add(1)) < num_chunks; ) {
+          S2Point ref_p = ref_p_;
+          int winding = ref_winding_;
+          const int end = std::min(n, (c + 1) * kPointsPerChunk);
+          for (int i = c * kPointsPerChunk; i < end; ++i) {
+            const S2Point& p = points[i];
+            S2EdgeCrosser crosser(&ref_p, &p);
+            query.GetCandidates(ref_p, p, 0, *index_.shape(0), &candidates);
+            for (ShapeEdgeId id : candidates) {
+              winding += SignedCrossingDelta(&crosser, id.edge_id);
+            }
+            (*windings)[i] = winding;
+            ref_p = p;
+          }
+        }
+      });
+}
+
 // The actual winding number operation is implemented as an S2Builder layer.
 class WindingLayer : public S2Builder::Layer {
  public:
@@ -310,11 +357,16 @@ bool WindingLayer::ComputeBoundary(const Graph& g, WindingOracle* oracle,
                                    S2Error* error) {
   // We assemble the edges into loops using an algorithm similar to
   // S2Builder::Graph::GetDirectedComponents(), except that we also keep track
-  // of winding numbers and output the relevant edges as we go along.
+  // of winding numbers.  This is done in three steps.  First we visit each
+  // connected component and compute the winding number of every region
+  // relative to one vertex of the component.  Next we compute the winding
+  // number at those vertices, which is the expensive step when there are
+  // many components and can be done in parallel.  Finally we output the
+  // edges that bound the regions selected by the winding rule.
   //
-  // The following accounts for sibling_map, left_turn_map, and edge_winding
-  // (which have g.num_edges() elements each).
-  const int64 kTempUsage = 3 * sizeof(EdgeId) * g.num_edges();
+  // The following accounts for sibling_map, left_turn_map, edge_winding,
+  // and edge_order (which have g.num_edges() elements each).
+  const int64 kTempUsage = 4 * sizeof(EdgeId) * g.num_edges();
   if (!tracker_.Tally(kTempUsage)) return false;
 
   vector<EdgeId> sibling_map = g.GetSiblingMap();
@@ -322,23 +374,36 @@ bool WindingLayer::ComputeBoundary(const Graph& g, WindingOracle* oracle,
   g.GetLeftTurnMap(sibling_map, &left_turn_map, error);
   ABSL_DCHECK(error->ok()) << *error;
 
-  // A map from EdgeId to the winding number of the region it bounds.
+  // A map from EdgeId to the winding number of the region it bounds,
+  // relative to the winding number at the first vertex of its component.
   vector<int> edge_winding(g.num_edges());
+
+  // The edges in the order they were visited.  The edges of each connected
+  // component are contiguous, starting at component_begin[i].
+  vector<EdgeId> edge_order;
+  edge_order.reserve(g.num_edges());
+  vector<int> component_begin;
+  vector<S2Point> component_vertex;
+
   vector<EdgeId> frontier;  // Unexplored sibling edges.
   for (EdgeId e_min = 0; e_min < g.num_edges(); ++e_min) {
     if (left_turn_map[e_min] < 0) continue;  // Already visited.
 
     // We have found a new connected component of the graph.  Each component
     // consists of a set of loops that partition the sphere.  We start by
-    // choosing an arbitrary vertex "v0" and computing the winding number at
-    // this vertex.  Recall that point containment is defined such that when a
+    // choosing an arbitrary vertex "v0" whose winding number will be computed
+    // below.  Recall that point containment is defined such that when a
     // set of loops partition the sphere, every point is contained by exactly
     // one loop.  Therefore the winding number at "v0" is the same as the
     // winding number of the adjacent loop that contains it.  We choose "e0" to
     // be an arbitrary edge of this loop (it is the incoming edge to "v0").
     VertexId v0 = g.edge(e_min).second;
     EdgeId e0 = GetContainingLoopEdge(v0, e_min, g, left_turn_map, sibling_map);
-    edge_winding[e0] = oracle->GetWindingNumber(g.vertex(v0));
+    edge_winding[e0] = 0;
+    if (!tracker_.AddSpace(&component_begin, 1)) return false;
+    if (!tracker_.AddSpace(&component_vertex, 1)) return false;
+    component_begin.push_back(edge_order.size());
+    component_vertex.push_back(g.vertex(v0));
 
     // Now visit all loop edges in this connected component of the graph.
     // "frontier" is a stack of unexplored siblings of the edges visited far.
@@ -352,27 +417,17 @@ bool WindingLayer::ComputeBoundary(const Graph& g, WindingOracle* oracle,
       // Visit all edges of the loop starting at "e".
       int winding = edge_winding[e];
       for (EdgeId next; left_turn_map[e] >= 0; e = next) {
-        // Count signed edge crossings to determine the winding number of
-        // the sibling region.  Input edges that snapped to "e" decrease the
-        // winding number by one (since we cross them from left to right),
-        // while input edges that snapped to its sibling edge increase the
-        // winding number by one (since we cross them from right to left).
-        EdgeId sibling = sibling_map[e];
-        int winding_minus = g.input_edge_ids(e).size();
-        int winding_plus = g.input_edge_ids(sibling).size();
-        int sibling_winding = winding - winding_minus + winding_plus;
-
-        // Output all edges that bound the region selected by the winding
-        // rule, plus certain degenerate edges.
-        if ((MatchesRule(winding) && !MatchesRule(sibling_winding)) ||
-            MatchesDegeneracy(winding, winding_minus, winding_plus)) {
-          OutputEdge(g, e);
-        }
+        edge_winding[e] = winding;
+        edge_order.push_back(e);
         next = left_turn_map[e];
         left_turn_map[e] = -1;
         // If the sibling hasn't been visited yet, add it to the frontier.
+        // Its winding number is computed as described in the output loop
+        // below.
+        EdgeId sibling = sibling_map[e];
         if (left_turn_map[sibling] >= 0) {
-          edge_winding[sibling] = sibling_winding;
+          edge_winding[sibling] = winding - g.input_edge_ids(e).size() +
+                                  g.input_edge_ids(sibling).size();
           if (!tracker_.AddSpace(&frontier, 1)) return false;
           frontier.push_back(sibling);
         }
@@ -380,6 +435,50 @@ bool WindingLayer::ComputeBoundary(const Graph& g, WindingOracle* oracle,
     }
   }
   tracker_.Untally(frontier);
+  vector<EdgeId>().swap(frontier);
+
+  // Compute the winding number at the chosen vertex of each component.
+  const int num_components = component_vertex.size();
+  vector<int> component_winding;
+  if (!tracker_.AddSpaceExact(&component_winding, num_components)) {
+    return false;
+  }
+  const int num_threads = op_.options_.num_threads();
+  if (num_threads > 1 && num_components > 1) {
+    oracle->GetWindingNumbers(component_vertex, num_threads,
+                              op_.options_.executor(), &component_winding);
+  } else {
+    for (const S2Point& v : component_vertex) {
+      component_winding.push_back(oracle->GetWindingNumber(v));
+    }
+  }
+  if (!tracker_.AddSpace(&component_begin, 1)) return false;
+  component_begin.push_back(edge_order.size());
+
+  for (int i = 0; i < num_components; ++i) {
+    for (int j = component_begin[i]; j < component_begin[i + 1]; ++j) {
+      // Count signed edge crossings to determine the winding number of the
+      // sibling region.  Input edges that snapped to "e" decrease the winding
+      // number by one (since we cross them from left to right), while input
+      // edges that snapped to its sibling edge increase the winding number by
+      // one (since we cross them from right to left).
+      EdgeId e = edge_order[j];
+      int winding = component_winding[i] + edge_winding[e];
+      int winding_minus = g.input_edge_ids(e).size();
+      int winding_plus = g.input_edge_ids(sibling_map[e]).size();
+      int sibling_winding = winding - winding_minus + winding_plus;
+
+      // Output all edges that bound the region selected by the winding
+      // rule, plus certain degenerate edges.
+      if ((MatchesRule(winding) && !MatchesRule(sibling_winding)) ||
+          MatchesDegeneracy(winding, winding_minus, winding_plus)) {
+        OutputEdge(g, e);
+      }
+    }
+  }
+  tracker_.Untally(component_begin);
+  tracker_.Untally(component_vertex);
+  tracker_.Untally(component_winding);
   return tracker_.Tally(-kTempUsage);
 }
 
@@ -482,7 +581,9 @@ S2WindingOperation::Options::Options(const SnapFunction& snap_function)
 S2WindingOperation::Options::Options(const Options& options)
     : snap_function_(options.snap_function_->Clone()),
       include_degeneracies_(options.include_degeneracies_),
-      memory_tracker_(options.memory_tracker_) {
+      memory_tracker_(options.memory_tracker_),
+      num_threads_(options.num_threads_),
+      executor_(options.executor_) {
 }
 
 S2WindingOperation::Options& S2WindingOperation::Options::operator=(
@@ -490,6 +591,8 @@ S2WindingOperation::Options& S2WindingOperation::Options::operator=(
   snap_function_ = options.snap_function_->Clone();
   include_degeneracies_ = options.include_degeneracies_;
   memory_tracker_ = options.memory_tracker_;
+  num_threads_ = options.num_threads_;
+  executor_ = options.executor_;
   return *this;
 }
 
@@ -520,6 +623,22 @@ void S2WindingOperation::Options::set_memory_tracker(S2MemoryTracker* tracker) {
   memory_tracker_ = tracker;
 }
 
+int S2WindingOperation::Options::num_threads() const {
+  return num_threads_;
+}
+
+void S2WindingOperation::Options::set_num_threads(int num_threads) {
+  num_threads_ = num_threads;
+}
+
+s2base::Executor* S2WindingOperation::Options::executor() const {
+  return executor_;
+}
+
+void S2WindingOperation::Options::set_executor(s2base::Executor* executor) {
+  executor_ = executor;
+}
+
 S2WindingOperation::S2WindingOperation() = default;
 
 S2WindingOperation::S2WindingOperation(
@@ -533,6 +652,8 @@ void S2WindingOperation::Init(unique_ptr<S2Builder::Layer> result_layer,
   S2Builder::Options builder_options{options_.snap_function()};
   builder_options.set_split_crossing_edges(true);
   builder_options.set_memory_tracker(options.memory_tracker());
+  builder_options.set_num_threads(options.num_threads());
+  builder_options.set_executor(options.executor());
   builder_.Init(builder_options);
   builder_.StartLayer(make_unique<s2builderutil::WindingLayer>(
       this, std::move(result_layer)));
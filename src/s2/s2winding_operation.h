@@ -20,6 +20,7 @@
 
 #include <memory>
 
+#include "s2/base/executor.h"
 #include "absl/log/absl_log.h"
 #include "s2/s2builder.h"
 #include "s2/s2builder_graph.h"
@@ -150,6 +151,25 @@ class S2WindingOperation {
     S2MemoryTracker* memory_tracker() const;
     void set_memory_tracker(S2MemoryTracker* tracker);
 
+    // The maximum number of threads used by Build().  This value is passed
+    // to S2Builder (see S2Builder::Options::num_threads), and it is also used
+    // to compute the winding numbers of the connected components of the
+    // snapped edge graph in parallel.  This is worthwhile when there are many
+    // components, e.g. when the input consists of many small loops that
+    // overlap in clusters (as when counting the coverage of many polygons).
+    // The output does not depend on this value.
+    //
+    // DEFAULT: 1
+    int num_threads() const;
+    void set_num_threads(int num_threads);
+
+    // If non-null, the additional threads requested by num_threads() are
+    // run as tasks on this executor (see s2base::RunConcurrently).
+    //
+    // DEFAULT: nullptr
+    s2base::Executor* executor() const;
+    void set_executor(s2base::Executor* executor);
+
     // Options may be assigned and copied.
     Options(const Options& options);
     Options& operator=(const Options& options);
@@ -158,6 +178,8 @@ class S2WindingOperation {
     std::unique_ptr<S2Builder::SnapFunction> snap_function_;
     bool include_degeneracies_ = false;
     S2MemoryTracker* memory_tracker_ = nullptr;
+    int num_threads_ = 1;
+    s2base::Executor* executor_ = nullptr;
   };
 
   // Default constructor; requires Init() to be called.
@@ -288,6 +288,35 @@ TEST(S2WindingOperation, SymmetricDifferenceDegeneracies) {
       "", "2:2; 5:5");
 }
 
+TEST(S2WindingOperation, NumThreadsDoesNotChangeOutput) {
+  // Computes the region covered by at least two of many small loops, most of
+  // which do not overlap any other loop.  This yields many connected
+  // components whose winding numbers are computed in parallel.
+  S2Testing::rnd.Reset(1);
+  S2Point center = S2Testing::RandomPoint();
+  S2Cap cap(center, S1Angle::Degrees(20));
+  vector<vector<S2Point>> loops;
+  for (int i = 0; i < 1000; ++i) {
+    loops.push_back(S2Testing::MakeRegularPoints(
+        S2Testing::SamplePoint(cap),
+        S1Angle::Degrees(0.1 + 0.4 * S2Testing::rnd.RandDouble()), 8));
+  }
+  const auto build = [&](int num_threads) {
+    S2WindingOperation::Options options{IntLatLngSnapFunction(3)};
+    options.set_num_threads(num_threads);
+    S2LaxPolygonShape output;
+    S2WindingOperation op(
+        make_unique<s2builderutil::LaxPolygonLayer>(&output), options);
+    for (const auto& loop : loops) op.AddLoop(loop);
+    S2Error error;
+    EXPECT_TRUE(op.Build(-center, -1, WindingRule::POSITIVE, &error)) << error;
+    return s2textformat::ToString(output);
+  };
+  string expected = build(1);
+  EXPECT_NE(expected, "");
+  EXPECT_EQ(expected, build(4));
+}
+
 TEST(S2WindingOperationOptions, SetGetSnapFunction) {
   // Prevent these from being detected as dead code.
   S2WindingOperation::Options opts;
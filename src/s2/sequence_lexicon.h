@@ -42,6 +42,10 @@
 // need about 11 + 3*8 = 35 bytes.  Note also that sequences are referred to
 // using 32-bit ids rather than 64-bit pointers.
 //
+// The hash of each sequence is computed once when it is added, so looking up
+// a sequence costs one hash computation and usually one sequence comparison
+// regardless of how often the hash table is resized.
+//
 // This class has the same thread-safety properties as "string": const methods
 // are thread safe, and non-const methods are not thread safe.
 //
@@ -71,7 +75,9 @@ class SequenceLexicon {
   SequenceLexicon(SequenceLexicon&&);
   SequenceLexicon& operator=(SequenceLexicon&&);
 
-  // Clears all data from the lexicon.
+  // Clears all data from the lexicon.  Like std::vector::clear(), this does
+  // not release any memory, so that a lexicon that is cleared and then
+  // refilled to a similar size does not need to allocate again.
   void Clear();
 
   // Add the given sequence of values to the lexicon if it is not already
@@ -140,8 +146,12 @@ class SequenceLexicon {
 
   using IdSet = gtl::dense_hash_set<uint32, IdHasher, IdKeyEqual>;
 
+  // Returns the hash of the values in the range [begin, end).
+  size_t Hash(Iterator begin, Iterator end) const;
+
   std::vector<T> values_;
   std::vector<uint32> begins_;
+  std::vector<size_t> hashes_;  // The hash of each sequence.
   IdSet id_set_;
 };
 
@@ -165,12 +175,7 @@ const Hasher& SequenceLexicon<T, Hasher, KeyEqual>::IdHasher::hasher() const {
 template <class T, class Hasher, class KeyEqual>
 size_t SequenceLexicon<T, Hasher, KeyEqual>::IdHasher::operator()(
     uint32 id) const {
-  // TODO(user,b/205929456): Is there a way to use absl::Hash instead?
-  HashMix mix;
-  for (const auto& value : lexicon_->sequence(id)) {
-    mix.Mix(hasher_(value));
-  }
-  return mix.get();
+  return lexicon_->hashes_[id];
 }
 
 template <class T, class Hasher, class KeyEqual>
@@ -192,6 +197,7 @@ bool SequenceLexicon<T, Hasher, KeyEqual>::IdKeyEqual::operator()(
   if (id1 == lexicon_->kEmptyKey || id2 == lexicon_->kEmptyKey) {
     return false;
   }
+  if (lexicon_->hashes_[id1] != lexicon_->hashes_[id2]) return false;
   SequenceLexicon::Sequence seq1 = lexicon_->sequence(id1);
   SequenceLexicon::Sequence seq2 = lexicon_->sequence(id2);
   return (seq1.size() == seq2.size() &&
@@ -209,7 +215,7 @@ SequenceLexicon<T, Hasher, KeyEqual>::SequenceLexicon(const Hasher& hasher,
 
 template <class T, class Hasher, class KeyEqual>
 SequenceLexicon<T, Hasher, KeyEqual>::SequenceLexicon(const SequenceLexicon& x)
-    : values_(x.values_), begins_(x.begins_),
+    : values_(x.values_), begins_(x.begins_), hashes_(x.hashes_),
       // Unfortunately we can't copy "id_set_" because we need to change the
       // "this" pointers associated with hasher() and key_equal().
       id_set_(x.id_set_.begin(), x.id_set_.end(), kEmptyKey, 0,
@@ -220,6 +226,7 @@ SequenceLexicon<T, Hasher, KeyEqual>::SequenceLexicon(const SequenceLexicon& x)
 template <class T, class Hasher, class KeyEqual>
 SequenceLexicon<T, Hasher, KeyEqual>::SequenceLexicon(SequenceLexicon&& x)
     : values_(std::move(x.values_)), begins_(std::move(x.begins_)),
+      hashes_(std::move(x.hashes_)),
       // Unfortunately we can't move "id_set_" because we need to change the
       // "this" pointers associated with hasher() and key_equal().
       id_set_(x.id_set_.begin(), x.id_set_.end(), kEmptyKey, 0,
@@ -233,6 +240,7 @@ SequenceLexicon<T, Hasher, KeyEqual>::operator=(const SequenceLexicon& x) {
   // Note that self-assignment is handled correctly by this code.
   values_ = x.values_;
   begins_ = x.begins_;
+  hashes_ = x.hashes_;
   // Unfortunately we can't copy-assign "id_set_" because we need to change
   // the "this" pointers associated with hasher() and key_equal().
   id_set_ = IdSet(x.id_set_.begin(), x.id_set_.end(), kEmptyKey, 0,
@@ -247,6 +255,7 @@ SequenceLexicon<T, Hasher, KeyEqual>::operator=(SequenceLexicon&& x) {
   // Note that move self-assignment has undefined behavior.
   values_ = std::move(x.values_);
   begins_ = std::move(x.begins_);
+  hashes_ = std::move(x.hashes_);
   // Unfortunately we can't move-assign "id_set_" because we need to change
   // the "this" pointers associated with hasher() and key_equal().
   id_set_ = IdSet(x.id_set_.begin(), x.id_set_.end(), kEmptyKey, 0,
@@ -259,7 +268,8 @@ template <class T, class Hasher, class KeyEqual>
 void SequenceLexicon<T, Hasher, KeyEqual>::Clear() {
   values_.clear();
   begins_.clear();
-  id_set_.clear();
+  hashes_.clear();
+  id_set_.clear_no_resize();
   begins_.push_back(0);
 }
 
@@ -272,11 +282,13 @@ uint32 SequenceLexicon<T, Hasher, KeyEqual>::Add(FwdIterator begin,
   }
   begins_.push_back(values_.size());
   uint32 id = begins_.size() - 2;
+  hashes_.push_back(Hash(values_.begin() + begins_[id], values_.end()));
   auto result = id_set_.insert(id);
   if (result.second) {
     return id;
   } else {
     begins_.pop_back();
+    hashes_.pop_back();
     values_.resize(begins_.back());
     return *result.first;
   }
@@ -288,6 +300,18 @@ uint32 SequenceLexicon<T, Hasher, KeyEqual>::Add(const Container& container) {
   return Add(std::begin(container), std::end(container));
 }
 
+template <class T, class Hasher, class KeyEqual>
+size_t SequenceLexicon<T, Hasher, KeyEqual>::Hash(Iterator begin,
+                                                  Iterator end) const {
+  // TODO(user,b/205929456): Is there a way to use absl::Hash instead?
+  const Hasher& hasher = id_set_.hash_funct().hasher();
+  HashMix mix;
+  for (; begin != end; ++begin) {
+    mix.Mix(hasher(*begin));
+  }
+  return mix.get();
+}
+
 template <class T, class Hasher, class KeyEqual>
 inline uint32 SequenceLexicon<T, Hasher, KeyEqual>::size() const {
   return begins_.size() - 1;
@@ -22,6 +22,7 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <memory_resource>
 #include <tuple>
 #include <utility>
 
@@ -33,7 +34,8 @@ Encoder::Encoder(Encoder&& other)
     : buf_(std::exchange(other.buf_, nullptr)),
       limit_(std::exchange(other.limit_, nullptr)),
       underlying_buffer_(std::exchange(other.underlying_buffer_, nullptr)),
-      orig_(std::exchange(other.orig_, nullptr)) {}
+      orig_(std::exchange(other.orig_, nullptr)),
+      resource_(std::exchange(other.resource_, nullptr)) {}
 
 Encoder& Encoder::operator=(Encoder&& other) {
   if (this == &other) return *this;
@@ -42,6 +44,7 @@ Encoder& Encoder::operator=(Encoder&& other) {
   limit_ = std::exchange(other.limit_, nullptr);
   underlying_buffer_ = std::exchange(other.underlying_buffer_, nullptr);
   orig_ = std::exchange(other.orig_, nullptr);
+  resource_ = std::exchange(other.resource_, nullptr);
   return *this;
 }
 
@@ -55,11 +58,18 @@ int Encoder::varint32_length(uint32 v) { return Varint::Length32(v); }
 int Encoder::varint64_length(uint64 v) { return Varint::Length64(v); }
 
 std::pair<unsigned char*, size_t> Encoder::NewBuffer(size_t size) {
+  if (resource_ != nullptr) {
+    return {static_cast<unsigned char*>(resource_->allocate(size, 1)), size};
+  }
   auto* p = std::allocator<unsigned char>().allocate(size);
   return {p, size};
 }
 
 void Encoder::DeleteBuffer(unsigned char* buf, size_t size) {
+  if (resource_ != nullptr) {
+    if (buf != nullptr) resource_->deallocate(buf, size, 1);
+    return;
+  }
   std::allocator<unsigned char>().deallocate(buf, size);
 }
 
@@ -24,6 +24,7 @@
 
 #include <cstdint>
 #include <cstring>
+#include <memory_resource>
 #include <utility>
 
 // Avoid adding expensive includes here.
@@ -48,6 +49,21 @@ class Encoder {
   Encoder() = default;
   void reset();
 
+  // Like the constructor above, but allocates the buffer from "resource"
+  // rather than the heap.  This is useful when encoding many small objects,
+  // since a bump allocator such as std::pmr::monotonic_buffer_resource makes
+  // the allocations (including those made as the buffer grows) very cheap.
+  // Alternatively, std::pmr::monotonic_buffer_resource can be constructed
+  // with a caller-provided initial buffer so that small encodings do not
+  // allocate at all.  The resource is retained by reset() and must outlive
+  // the Encoder.  Passing nullptr is equivalent to the default constructor.
+  explicit Encoder(std::pmr::memory_resource* resource)
+      : resource_(resource) {}
+
+  // Returns the memory resource used to allocate the buffer, or nullptr if
+  // the buffer is allocated from the heap.
+  std::pmr::memory_resource* memory_resource() const { return resource_; }
+
   // Movable.
   Encoder(Encoder&& other);
   Encoder& operator=(Encoder&& other);
@@ -188,8 +204,8 @@ class Encoder {
 
   Writer writer() { return Writer(this); }
 
-  static std::pair<unsigned char*, size_t> NewBuffer(size_t size);
-  static void DeleteBuffer(unsigned char* buf, size_t size);
+  std::pair<unsigned char*, size_t> NewBuffer(size_t size);
+  void DeleteBuffer(unsigned char* buf, size_t size);
 
   void EnsureSlowPath(size_t N);
 
@@ -213,6 +229,10 @@ class Encoder {
   // orig_ points to the start of the encoding buffer, whether or not the
   // Encoder owns it.
   unsigned char* orig_ = nullptr;
+
+  // The resource used to allocate underlying_buffer_, or nullptr to use the
+  // heap.
+  std::pmr::memory_resource* resource_ = nullptr;
 };
 
 /* Class for decoding data from a memory buffer */
@@ -251,6 +271,9 @@ class Decoder {
   // "get_varint" actually checks bounds
   bool get_varint32(uint32* v);
   bool get_varint64(uint64* v);
+  // Decodes "n" consecutive varint64 values into v[0..n-1].  Returns false
+  // (without advancing the decoder) if the input is truncated or invalid.
+  bool get_varint64_array(uint64* v, size_t n);
 
   size_t pos() const;
   // Return number of bytes decoded so far
@@ -558,4 +581,15 @@ inline bool Decoder::get_varint64(uint64* v) {
   return true;
 }
 
+inline bool Decoder::get_varint64_array(uint64* v, size_t n) {
+  const char* const r = Varint::Parse64BatchWithLimit(
+      reinterpret_cast<const char*>(buf_),
+      reinterpret_cast<const char*>(limit_), v, n);
+  if (r == nullptr) {
+    return false;
+  }
+  buf_ = reinterpret_cast<const unsigned char*>(r);
+  return true;
+}
+
 #endif  // S2_UTIL_CODING_CODER_H_
@@ -23,6 +23,7 @@
 #include "absl/log/absl_check.h"
 
 #include "s2/base/types.h"
+#include "s2/util/endian/endian.h"
 
 char* Varint::Encode32(char* sptr, uint32 v) {
   return Encode32Inline(sptr, v);
@@ -270,6 +271,63 @@ const char* Varint::Parse64Fallback(const char* p, uint64* OUTPUT) {
   }
  }
 
+namespace {
+
+// Given up to 8 bytes of varint data stored in little-endian order with the
+// continuation bits already cleared, packs the 7-bit groups together.
+inline uint64 CompactVarintGroups(uint64 x) {
+  x = (x & 0x007f007f007f007f) | ((x & 0x7f007f007f007f00) >> 1);
+  x = (x & 0x00003fff00003fff) | ((x & 0x3fff00003fff0000) >> 2);
+  return (x & 0x000000000fffffff) | ((x & 0x0fffffff00000000) >> 4);
+}
+
+}  // namespace
+
+const char* Varint::Parse64BatchWithLimit(const char* p, const char* l,
+                                          uint64* OUTPUT, size_t n) {
+  constexpr uint64 kStopBits = 0x8080808080808080;
+  const char* ptr = p;
+  size_t i = 0;
+  while (i < n) {
+    if (l - ptr < 8) {
+      // Too close to the limit to load a whole word.
+      ptr = Parse64WithLimit(ptr, l, &OUTPUT[i++]);
+      if (ptr == nullptr) return nullptr;
+      continue;
+    }
+    const uint64 word = LittleEndian::Load64(ptr);
+    // The high bit of each byte of "stops" is set iff the corresponding byte
+    // is the last byte of a varint.
+    uint64 stops = ~word & kStopBits;
+    if (stops == kStopBits && n - i >= 8) {
+      // Eight single-byte values; this is the common case for small deltas.
+      for (int k = 0; k < 8; ++k) OUTPUT[i + k] = (word >> (8 * k)) & 0x7f;
+      i += 8;
+      ptr += 8;
+      continue;
+    }
+    if (stops == 0) {
+      // The next value is longer than 8 bytes.
+      ptr = Parse64WithLimit(ptr, l, &OUTPUT[i++]);
+      if (ptr == nullptr) return nullptr;
+      continue;
+    }
+    // Decode every value that ends within this word.
+    const uint64 payload = word & ~kStopBits;
+    int start = 0;
+    do {
+      int end = absl::countr_zero(stops) / 8 + 1;
+      uint64 bytes = payload >> (8 * start);
+      if (end - start < 8) bytes &= (uint64{1} << (8 * (end - start))) - 1;
+      OUTPUT[i++] = CompactVarintGroups(bytes);
+      start = end;
+      stops &= stops - 1;
+    } while (stops != 0 && i < n);
+    ptr += start;
+  }
+  return ptr;
+}
+
 const char* Varint::Skip32BackwardSlow(const char* p, const char* b) {
   const unsigned char* ptr = reinterpret_cast<const unsigned char*>(p);
   const unsigned char* base = reinterpret_cast<const unsigned char*>(b);
@@ -19,21 +19,19 @@
 
 #include <cstdio>
 #include <cstdlib>
-#include <cstring>
 
 #include <algorithm>
 #include <cmath>
 #include <cstdint>
 #include <limits>
 #include <string>
-
-#include <openssl/bn.h>
-#include <openssl/crypto.h>  // for OPENSSL_free
+#include <vector>
 
 #include "absl/base/macros.h"
 #include "absl/container/fixed_array.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
+#include "absl/numeric/bits.h"
 #include "absl/numeric/int128.h"
 
 #include "s2/base/port.h"
@@ -61,124 +59,218 @@ static_assert(
     ExactFloat::kMinExp - ExactFloat::kMaxPrec >= INT_MIN / 2,
     "exactfloat exponent might overflow");
 
-// We define a few simple extensions to the OpenSSL's BIGNUM interface.
-// In some cases these depend on BIGNUM internal fields, so they might
-// require tweaking if the BIGNUM implementation changes significantly.
-// These are just thin wrappers for BoringSSL.
-
-#ifdef OPENSSL_IS_BORINGSSL
+////////////////////////////////////////////////////////////////////////
+// BigNum
 
-inline static void BN_ext_set_uint64(BIGNUM* bn, uint64 v) {
-  ABSL_CHECK(BN_set_u64(bn, v));
+void ExactFloat::BigNum::Trim() {
+  while (!limbs_.empty() && limbs_.back() == 0) limbs_.pop_back();
 }
 
-// Return the absolute value of a BIGNUM as a 64-bit unsigned integer.
-// Requires that BIGNUM fits into 64 bits.
-inline static uint64 BN_ext_get_uint64(const BIGNUM* bn) {
-  uint64_t u64;
-  if (!BN_get_u64(bn, &u64)) {
-    ABSL_DCHECK(false) << "BN has " << BN_num_bits(bn) << " bits";
-    return 0;
-  }
-  return u64;
+void ExactFloat::BigNum::set_uint64(uint64 v) {
+  limbs_.clear();
+  if (v != 0) limbs_.push_back(v);
 }
 
-static int BN_ext_count_low_zero_bits(const BIGNUM* bn) {
-  return BN_count_low_zero_bits(bn);
+uint64 ExactFloat::BigNum::get_uint64() const {
+  ABSL_DCHECK_LE(limbs_.size(), 1) << "BigNum has " << num_bits() << " bits";
+  return limbs_.empty() ? 0 : limbs_[0];
 }
 
-#else  // !defined(OPENSSL_IS_BORINGSSL)
-
-// Set a BIGNUM to the given unsigned 64-bit value.
-inline static void BN_ext_set_uint64(BIGNUM* bn, uint64 v) {
-#if BN_BITS2 == 64
-  ABSL_CHECK(BN_set_word(bn, v));
-#else
-  static_assert(BN_BITS2 == 32, "at least 32 bit openssl build needed");
-  ABSL_CHECK(BN_set_word(bn, static_cast<uint32>(v >> 32)));
-  ABSL_CHECK(BN_lshift(bn, bn, 32));
-  ABSL_CHECK(BN_add_word(bn, static_cast<uint32>(v)));
-#endif
+int ExactFloat::BigNum::num_bits() const {
+  if (limbs_.empty()) return 0;
+  return 64 * limbs_.size() - absl::countl_zero(limbs_.back());
 }
 
-#if OPENSSL_VERSION_NUMBER < 0x10100000L
-
-// Return the absolute value of a BIGNUM as a 64-bit unsigned integer.
-// Requires that BIGNUM fits into 64 bits.
-inline static uint64 BN_ext_get_uint64(const BIGNUM* bn) {
-  ABSL_DCHECK_LE(BN_num_bytes(bn), sizeof(uint64));
-#if BN_BITS2 == 64
-  return BN_get_word(bn);
-#else
-  static_assert(BN_BITS2 == 32, "at least 32 bit openssl build needed");
-  if (bn->top == 0) return 0;
-  if (bn->top == 1) return BN_get_word(bn);
-  ABSL_DCHECK_EQ(bn->top, 2);
-  return (static_cast<uint64>(bn->d[1]) << 32) + bn->d[0];
-#endif
+bool ExactFloat::BigNum::is_bit_set(int n) const {
+  ABSL_DCHECK_GE(n, 0);
+  size_t i = n / 64;
+  return i < limbs_.size() && ((limbs_[i] >> (n % 64)) & 1) != 0;
 }
 
-// Count the number of low-order zero bits in the given BIGNUM (ignoring its
-// sign).  Returns 0 if the argument is zero.
-static int BN_ext_count_low_zero_bits(const BIGNUM* bn) {
-  int count = 0;
-  for (int i = 0; i < bn->top; ++i) {
-    BN_ULONG w = bn->d[i];
-    if (w == 0) {
-      count += 8 * sizeof(BN_ULONG);
-    } else {
-      for (; (w & 1) == 0; w >>= 1) {
-        ++count;
-      }
-      break;
+int ExactFloat::BigNum::count_low_zero_bits() const {
+  for (size_t i = 0; i < limbs_.size(); ++i) {
+    if (limbs_[i] != 0) return 64 * i + absl::countr_zero(limbs_[i]);
+  }
+  return 0;
+}
+
+void ExactFloat::BigNum::LeftShift(const BigNum& a, int n) {
+  ABSL_DCHECK_GE(n, 0);
+  Copy(a);
+  if (is_zero() || n == 0) return;
+  const size_t limb_shift = n / 64;
+  const int bit_shift = n % 64;
+  const size_t old_size = limbs_.size();
+  limbs_.resize(old_size + limb_shift + (bit_shift != 0));
+  // Work from the high-order end so that each source limb is read before it
+  // is overwritten.
+  if (bit_shift == 0) {
+    for (size_t i = old_size; i-- > 0;) limbs_[i + limb_shift] = limbs_[i];
+  } else {
+    limbs_[old_size + limb_shift] = limbs_[old_size - 1] >> (64 - bit_shift);
+    for (size_t i = old_size - 1; i > 0; --i) {
+      limbs_[i + limb_shift] = (limbs_[i] << bit_shift) |
+                               (limbs_[i - 1] >> (64 - bit_shift));
     }
+    limbs_[limb_shift] = limbs_[0] << bit_shift;
   }
-  return count;
+  std::fill(limbs_.begin(), limbs_.begin() + limb_shift, 0);
+  Trim();
+}
+
+void ExactFloat::BigNum::RightShift(const BigNum& a, int n) {
+  ABSL_DCHECK_GE(n, 0);
+  Copy(a);
+  const size_t limb_shift = n / 64;
+  const int bit_shift = n % 64;
+  if (limb_shift >= limbs_.size()) {
+    limbs_.clear();
+    return;
+  }
+  const size_t new_size = limbs_.size() - limb_shift;
+  if (bit_shift == 0) {
+    for (size_t i = 0; i < new_size; ++i) limbs_[i] = limbs_[i + limb_shift];
+  } else {
+    for (size_t i = 0; i + 1 < new_size; ++i) {
+      limbs_[i] = (limbs_[i + limb_shift] >> bit_shift) |
+                  (limbs_[i + limb_shift + 1] << (64 - bit_shift));
+    }
+    limbs_[new_size - 1] = limbs_[new_size - 1 + limb_shift] >> bit_shift;
+  }
+  limbs_.resize(new_size);
+  Trim();
+}
+
+void ExactFloat::BigNum::Add(const BigNum& a, const BigNum& b) {
+  // Let "x" be the argument with more limbs.  Resizing the result first is
+  // safe even if it is "y", since the new limbs of "y" are zero.
+  const BigNum& x = (a.limbs_.size() >= b.limbs_.size()) ? a : b;
+  const BigNum& y = (&x == &a) ? b : a;
+  const size_t x_size = x.limbs_.size(), y_size = y.limbs_.size();
+  limbs_.resize(x_size);
+  uint64 carry = 0;
+  for (size_t i = 0; i < y_size; ++i) {
+    uint64 sum = x.limbs_[i] + carry;
+    carry = (sum < carry);
+    sum += y.limbs_[i];
+    carry += (sum < y.limbs_[i]);
+    limbs_[i] = sum;
+  }
+  for (size_t i = y_size; i < x_size; ++i) {
+    uint64 sum = x.limbs_[i] + carry;
+    carry = (sum < carry);
+    limbs_[i] = sum;
+  }
+  if (carry != 0) limbs_.push_back(carry);
 }
 
-#else  // OPENSSL_VERSION_NUMBER >= 0x10100000L
-
-// Return the absolute value of a BIGNUM as a 64-bit unsigned integer.
-// Requires that BIGNUM fits into 64 bits.
-inline static uint64 BN_ext_get_uint64(const BIGNUM* bn) {
-  uint64 r;
-#ifdef IS_LITTLE_ENDIAN
-  ABSL_CHECK_EQ(BN_bn2lebinpad(bn, reinterpret_cast<unsigned char*>(&r),
-                sizeof(r)), sizeof(r));
-#elif defined(IS_BIG_ENDIAN)
-  ABSL_CHECK_EQ(BN_bn2binpad(bn, reinterpret_cast<unsigned char*>(&r),
-                sizeof(r)), sizeof(r));
-#else
-#error one of IS_LITTLE_ENDIAN or IS_BIG_ENDIAN should be defined!
-#endif
-  return r;
+void ExactFloat::BigNum::AddWord(uint64 w) {
+  for (size_t i = 0; i < limbs_.size() && w != 0; ++i) {
+    limbs_[i] += w;
+    w = (limbs_[i] < w);
+  }
+  if (w != 0) limbs_.push_back(w);
+}
+
+void ExactFloat::BigNum::Subtract(const BigNum& a, const BigNum& b) {
+  ABSL_DCHECK_GE(Compare(a, b), 0);
+  // As in Add(), resizing first is safe even if the result is "b".
+  const size_t a_size = a.limbs_.size(), b_size = b.limbs_.size();
+  limbs_.resize(a_size);
+  uint64 borrow = 0;
+  for (size_t i = 0; i < b_size; ++i) {
+    uint64 ai = a.limbs_[i], bi = b.limbs_[i];
+    uint64 diff = ai - bi - borrow;
+    borrow = (ai < bi) || (ai - bi < borrow);
+    limbs_[i] = diff;
+  }
+  for (size_t i = b_size; i < a_size; ++i) {
+    uint64 ai = a.limbs_[i];
+    limbs_[i] = ai - borrow;
+    borrow = (ai < borrow);
+  }
+  ABSL_DCHECK_EQ(borrow, 0);
+  Trim();
+}
+
+void ExactFloat::BigNum::Multiply(const BigNum& a, const BigNum& b) {
+  ABSL_DCHECK(this != &a && this != &b);
+  limbs_.clear();
+  if (a.is_zero() || b.is_zero()) return;
+  const size_t a_size = a.limbs_.size(), b_size = b.limbs_.size();
+  limbs_.resize(a_size + b_size);
+  for (size_t i = 0; i < a_size; ++i) {
+    uint64 carry = 0;
+    for (size_t j = 0; j < b_size; ++j) {
+      absl::uint128 t = absl::uint128(a.limbs_[i]) * b.limbs_[j] +
+                        limbs_[i + j] + carry;
+      limbs_[i + j] = absl::Uint128Low64(t);
+      carry = absl::Uint128High64(t);
+    }
+    limbs_[i + b_size] = carry;
+  }
+  Trim();
 }
 
-static int BN_ext_count_low_zero_bits(const BIGNUM* bn) {
-  // In OpenSSL >= 1.1, BIGNUM is an opaque type, so d and top
-  // cannot be accessed.  The bytes must be copied out at a ~25%
-  // performance penalty.
-  absl::FixedArray<unsigned char> bytes(BN_num_bytes(bn));
-  // "le" indicates little endian.
-  ABSL_CHECK_EQ(BN_bn2lebinpad(bn, bytes.data(), bytes.size()), bytes.size());
+void ExactFloat::BigNum::MultiplyWord(uint64 w) {
+  if (w == 0) {
+    limbs_.clear();
+    return;
+  }
+  uint64 carry = 0;
+  for (uint64& limb : limbs_) {
+    absl::uint128 t = absl::uint128(limb) * w + carry;
+    limb = absl::Uint128Low64(t);
+    carry = absl::Uint128High64(t);
+  }
+  if (carry != 0) limbs_.push_back(carry);
+}
 
-  int count = 0;
-  for (unsigned char c : bytes) {
-    if (c == 0) {
-      count += 8;
-    } else {
-      for (; (c & 1) == 0; c >>= 1) {
-        ++count;
-      }
-      break;
+int ExactFloat::BigNum::Compare(const BigNum& a, const BigNum& b) {
+  if (a.limbs_.size() != b.limbs_.size()) {
+    return (a.limbs_.size() < b.limbs_.size()) ? -1 : 1;
+  }
+  for (size_t i = a.limbs_.size(); i-- > 0;) {
+    if (a.limbs_[i] != b.limbs_[i]) {
+      return (a.limbs_[i] < b.limbs_[i]) ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+string ExactFloat::BigNum::ToDecimalString() const {
+  if (is_zero()) return "0";
+
+  // Repeatedly divide by 10**19 (the largest power of 10 that fits in a
+  // uint64), collecting the remainders as groups of 19 decimal digits from
+  // least to most significant.
+  constexpr uint64 kDivisor = 10000000000000000000ULL;
+  constexpr int kDigitsPerDivisor = 19;
+  absl::FixedArray<uint64> quotient(limbs_.begin(), limbs_.end());
+  size_t size = quotient.size();
+  std::vector<uint64> groups;
+  while (size > 0) {
+    uint64 remainder = 0;
+    for (size_t i = size; i-- > 0;) {
+      absl::uint128 t = absl::MakeUint128(remainder, quotient[i]);
+      quotient[i] = absl::Uint128Low64(t / kDivisor);
+      remainder = absl::Uint128Low64(t % kDivisor);
     }
+    groups.push_back(remainder);
+    while (size > 0 && quotient[size - 1] == 0) --size;
+  }
+  // The most significant group is printed without leading zeros.
+  string result = std::to_string(groups.back());
+  for (size_t i = groups.size() - 1; i-- > 0;) {
+    string group = std::to_string(groups[i]);
+    result.append(kDigitsPerDivisor - group.size(), '0');
+    result += group;
   }
-  return count;
+  return result;
 }
 
-#endif  // OPENSSL_VERSION_NUMBER >= 0x10100000L
-
-#endif  // !defined(OPENSSL_IS_BORINGSSL)
+////////////////////////////////////////////////////////////////////////
+// ExactFloat
 
 ExactFloat::ExactFloat(double v) {
   sign_ = std::signbit(v) ? -1 : 1;
@@ -196,7 +288,7 @@ ExactFloat::ExactFloat(double v) {
     int exp;
     double f = frexp(fabs(v), &exp);
     uint64 m = static_cast<uint64>(ldexp(f, kDoubleMantissaBits));
-    BN_ext_set_uint64(bn_.get(), m);
+    bn_.set_uint64(m);
     bn_exp_ = exp - kDoubleMantissaBits;
     Canonicalize();
   }
@@ -204,9 +296,9 @@ ExactFloat::ExactFloat(double v) {
 
 ExactFloat::ExactFloat(int v) {
   sign_ = (v >= 0) ? 1 : -1;
-  // Note that this works even for INT_MIN because the parameter type for
-  // BN_set_word() is unsigned.
-  ABSL_CHECK(BN_set_word(bn_.get(), abs(v)));
+  // Note that this works even for INT_MIN because the value is negated
+  // after conversion to 64 bits.
+  bn_.set_uint64(std::abs(static_cast<int64>(v)));
   bn_exp_ = 0;
   Canonicalize();
 }
@@ -214,7 +306,7 @@ ExactFloat::ExactFloat(int v) {
 ExactFloat::ExactFloat(const ExactFloat& b)
     : sign_(b.sign_),
       bn_exp_(b.bn_exp_) {
-  BN_copy(bn_.get(), b.bn_.get());
+  bn_.Copy(b.bn_);
 }
 
 ExactFloat ExactFloat::SignedZero(int sign) {
@@ -236,30 +328,30 @@ ExactFloat ExactFloat::NaN() {
 }
 
 int ExactFloat::prec() const {
-  return BN_num_bits(bn_.get());
+  return bn_.num_bits();
 }
 
 int ExactFloat::exp() const {
   ABSL_DCHECK(is_normal());
-  return bn_exp_ + BN_num_bits(bn_.get());
+  return bn_exp_ + bn_.num_bits();
 }
 
 void ExactFloat::set_zero(int sign) {
   sign_ = sign;
   bn_exp_ = kExpZero;
-  if (!BN_is_zero(bn_.get())) BN_zero(bn_.get());
+  bn_.set_zero();
 }
 
 void ExactFloat::set_inf(int sign) {
   sign_ = sign;
   bn_exp_ = kExpInfinity;
-  if (!BN_is_zero(bn_.get())) BN_zero(bn_.get());
+  bn_.set_zero();
 }
 
 void ExactFloat::set_nan() {
   sign_ = 1;
   bn_exp_ = kExpNaN;
-  if (!BN_is_zero(bn_.get())) BN_zero(bn_.get());
+  bn_.set_zero();
 }
 
 double ExactFloat::ToDouble() const {
@@ -273,7 +365,7 @@ double ExactFloat::ToDouble() const {
 }
 
 double ExactFloat::ToDoubleHelper() const {
-  ABSL_DCHECK_LE(BN_num_bits(bn_.get()), kDoubleMantissaBits);
+  ABSL_DCHECK_LE(bn_.num_bits(), kDoubleMantissaBits);
   if (!is_normal()) {
     if (is_zero()) return copysign(0, sign_);
     if (is_inf()) {
@@ -281,7 +373,7 @@ double ExactFloat::ToDoubleHelper() const {
     }
     return std::copysign(std::numeric_limits<double>::quiet_NaN(), sign_);
   }
-  uint64 d_mantissa = BN_ext_get_uint64(bn_.get());
+  uint64 d_mantissa = bn_.get_uint64();
   // We rely on ldexp() to handle overflow and underflow.  (It will return a
   // signed zero or infinity if the result is too small or too large.)
   return sign_ * ldexp(static_cast<double>(d_mantissa), bn_exp_);
@@ -332,11 +424,11 @@ ExactFloat ExactFloat::RoundToPowerOf2(int bit_exp, RoundingMode mode) const {
     // Never increment.
   } else if (mode == kRoundTiesAwayFromZero) {
     // Increment if the highest discarded bit is 1.
-    if (BN_is_bit_set(bn_.get(), shift - 1))
+    if (bn_.is_bit_set(shift - 1))
       increment = true;
   } else if (mode == kRoundAwayFromZero) {
     // Increment unless all discarded bits are zero.
-    if (BN_ext_count_low_zero_bits(bn_.get()) < shift)
+    if (bn_.count_low_zero_bits() < shift)
       increment = true;
   } else {
     ABSL_DCHECK_EQ(mode, kRoundTiesToEven);
@@ -346,16 +438,16 @@ ExactFloat ExactFloat::RoundToPowerOf2(int bit_exp, RoundingMode mode) const {
     //    0/10*       ->    Don't increment (fraction = 1/2, kept part even)
     //    1/10*       ->    Increment (fraction = 1/2, kept part odd)
     //    ./1.*1.*    ->    Increment (fraction > 1/2)
-    if (BN_is_bit_set(bn_.get(), shift - 1) &&
-        ((BN_is_bit_set(bn_.get(), shift) ||
-          BN_ext_count_low_zero_bits(bn_.get()) < shift - 1))) {
+    if (bn_.is_bit_set(shift - 1) &&
+        ((bn_.is_bit_set(shift) ||
+          bn_.count_low_zero_bits() < shift - 1))) {
       increment = true;
     }
   }
   r.bn_exp_ = bn_exp_ + shift;
-  ABSL_CHECK(BN_rshift(r.bn_.get(), bn_.get(), shift));
+  r.bn_.RightShift(bn_, shift);
   if (increment) {
-    ABSL_CHECK(BN_add_word(r.bn_.get(), 1));
+    r.bn_.AddWord(1);
   }
   r.sign_ = sign_;
   r.Canonicalize();
@@ -457,43 +549,43 @@ static void IncrementDecimalDigits(std::string* digits) {
 int ExactFloat::GetDecimalDigits(int max_digits, std::string* digits) const {
   ABSL_DCHECK(is_normal());
   // Convert the value to the form (bn * (10 ** bn_exp10)) where "bn" is a
-  // positive integer (BIGNUM).
-  BIGNUM* bn = BN_new();
+  // positive integer (BigNum).
+  BigNum bn;
   int bn_exp10;
   if (bn_exp_ >= 0) {
     // The easy case: bn = bn_ * (2 ** bn_exp_)), bn_exp10 = 0.
-    ABSL_CHECK(BN_lshift(bn, bn_.get(), bn_exp_));
+    bn.LeftShift(bn_, bn_exp_);
     bn_exp10 = 0;
   } else {
     // Set bn = bn_ * (5 ** -bn_exp_) and bn_exp10 = bn_exp_.  This is
-    // equivalent to the original value of (bn_ * (2 ** bn_exp_)).
-    BIGNUM* power = BN_new();
-    ABSL_CHECK(BN_set_word(power, -bn_exp_));
-    ABSL_CHECK(BN_set_word(bn, 5));
-    BN_CTX* ctx = BN_CTX_new();
-    ABSL_CHECK(BN_exp(bn, bn, power, ctx));
-    ABSL_CHECK(BN_mul(bn, bn, bn_.get(), ctx));
-    BN_CTX_free(ctx);
-    BN_free(power);
+    // equivalent to the original value of (bn_ * (2 ** bn_exp_)).  We
+    // multiply by 5**27 (the largest power of 5 that fits in a uint64) as
+    // many times as possible and then by the remaining smaller power.
+    constexpr uint64 kPow5_27 = 7450580596923828125ULL;
+    bn.Copy(bn_);
+    int power = -bn_exp_;
+    for (; power >= 27; power -= 27) bn.MultiplyWord(kPow5_27);
+    uint64 remainder = 1;
+    for (; power > 0; --power) remainder *= 5;
+    bn.MultiplyWord(remainder);
     bn_exp10 = bn_exp_;
   }
   // Now convert "bn" to a decimal string.
-  char* all_digits = BN_bn2dec(bn);
-  ABSL_DCHECK(all_digits != nullptr);
-  BN_free(bn);
+  const string all_digits = bn.ToDecimalString();
   // Check whether we have too many digits and round if necessary.
-  int num_digits = strlen(all_digits);
+  int num_digits = all_digits.size();
   if (num_digits <= max_digits) {
     *digits = all_digits;
   } else {
-    digits->assign(all_digits, max_digits);
+    digits->assign(all_digits, 0, max_digits);
     // Standard "printf" formatting rounds ties to an even number.  This means
     // that we round up (away from zero) if highest discarded digit is '5' or
     // more, unless all other discarded digits are zero in which case we round
     // up only if the lowest kept digit is odd.
     if (all_digits[max_digits] >= '5' &&
         ((all_digits[max_digits-1] & 1) == 1 ||
-         strpbrk(all_digits + max_digits + 1, "123456789") != nullptr)) {
+         all_digits.find_first_not_of('0', max_digits + 1) !=
+             string::npos)) {
       // This can increase the number of digits by 1, but in that case at
       // least one trailing zero will be stripped off below.
       IncrementDecimalDigits(digits);
@@ -501,8 +593,6 @@ int ExactFloat::GetDecimalDigits(int max_digits, std::string* digits) const {
     // Adjust the base-10 exponent to reflect the digits we have removed.
     bn_exp10 += num_digits - max_digits;
   }
-  OPENSSL_free(all_digits);
-
   // Now strip any trailing zeros.
   ABSL_DCHECK_NE((*digits)[0], '0');
   std::string::iterator pos = digits->end();
@@ -528,7 +618,7 @@ ExactFloat& ExactFloat::operator=(const ExactFloat& b) {
   if (this != &b) {
     sign_ = b.sign_;
     bn_exp_ = b.bn_exp_;
-    BN_copy(bn_.get(), b.bn_.get());
+    bn_.Copy(b.bn_);
   }
   return *this;
 }
@@ -576,26 +666,27 @@ ExactFloat ExactFloat::SignedSum(int a_sign, const ExactFloat* a,
   // Shift "a" if necessary so that both values have the same bn_exp_.
   ExactFloat r;
   if (a->bn_exp_ > b->bn_exp_) {
-    ABSL_CHECK(BN_lshift(r.bn_.get(), a->bn_.get(), a->bn_exp_ - b->bn_exp_));
+    r.bn_.LeftShift(a->bn_, a->bn_exp_ - b->bn_exp_);
     a = &r;  // The only field of "a" used below is bn_.
   }
   r.bn_exp_ = b->bn_exp_;
   if (a_sign == b_sign) {
-    ABSL_CHECK(BN_add(r.bn_.get(), a->bn_.get(), b->bn_.get()));
+    r.bn_.Add(a->bn_, b->bn_);
     r.sign_ = a_sign;
   } else {
-    // Note that the BIGNUM documentation is out of date -- all methods now
-    // allow the result to be the same as any input argument, so it is okay if
-    // (a == &r) due to the shift above.
-    ABSL_CHECK(BN_sub(r.bn_.get(), a->bn_.get(), b->bn_.get()));
-    if (BN_is_zero(r.bn_.get())) {
+    // All BigNum methods used here allow the result to be the same as an
+    // input argument, so it is okay if (a == &r) due to the shift above.
+    int cmp = BigNum::Compare(a->bn_, b->bn_);
+    if (cmp == 0) {
+      r.bn_.set_zero();
       r.sign_ = +1;
-    } else if (BN_is_negative(r.bn_.get())) {
+    } else if (cmp < 0) {
       // The magnitude of "b" was larger.
+      r.bn_.Subtract(b->bn_, a->bn_);
       r.sign_ = b_sign;
-      BN_set_negative(r.bn_.get(), false);
     } else {
-      // They were equal, or the magnitude of "a" was larger.
+      // The magnitude of "a" was larger.
+      r.bn_.Subtract(a->bn_, b->bn_);
       r.sign_ = a_sign;
     }
   }
@@ -609,16 +700,16 @@ void ExactFloat::Canonicalize() {
   // Underflow/overflow occurs if exp() is not in [kMinExp, kMaxExp].
   // We also convert a zero mantissa to signed zero.
   int my_exp = exp();
-  if (my_exp < kMinExp || BN_is_zero(bn_.get())) {
+  if (my_exp < kMinExp || bn_.is_zero()) {
     set_zero(sign_);
   } else if (my_exp > kMaxExp) {
     set_inf(sign_);
-  } else if (!BN_is_odd(bn_.get())) {
+  } else if (!bn_.is_odd()) {
     // Remove any low-order zero bits from the mantissa.
-    ABSL_DCHECK(!BN_is_zero(bn_.get()));
-    int shift = BN_ext_count_low_zero_bits(bn_.get());
+    ABSL_DCHECK(!bn_.is_zero());
+    int shift = bn_.count_low_zero_bits();
     if (shift > 0) {
-      ABSL_CHECK(BN_rshift(bn_.get(), bn_.get(), shift));
+      bn_.RightShift(bn_, shift);
       bn_exp_ += shift;
     }
   }
@@ -650,9 +741,7 @@ ExactFloat operator*(const ExactFloat& a, const ExactFloat& b) {
   ExactFloat r;
   r.sign_ = result_sign;
   r.bn_exp_ = a.bn_exp_ + b.bn_exp_;
-  BN_CTX* ctx = BN_CTX_new();
-  ABSL_CHECK(BN_mul(r.bn_.get(), a.bn_.get(), b.bn_.get(), ctx));
-  BN_CTX_free(ctx);
+  r.bn_.Multiply(a.bn_, b.bn_);
   r.Canonicalize();
   return r;
 }
@@ -670,14 +759,15 @@ bool operator==(const ExactFloat& a, const ExactFloat& b) {
 
   // Otherwise, the signs and mantissas must match.  Note that non-normal
   // values such as infinity have a mantissa of zero.
-  return a.sign_ == b.sign_ && BN_ucmp(a.bn_.get(), b.bn_.get()) == 0;
+  return a.sign_ == b.sign_ &&
+         ExactFloat::BigNum::Compare(a.bn_, b.bn_) == 0;
 }
 
 int ExactFloat::ScaleAndCompare(const ExactFloat& b) const {
   ABSL_DCHECK(is_normal() && b.is_normal() && bn_exp_ >= b.bn_exp_);
   ExactFloat tmp = *this;
-  ABSL_CHECK(BN_lshift(tmp.bn_.get(), tmp.bn_.get(), bn_exp_ - b.bn_exp_));
-  return BN_ucmp(tmp.bn_.get(), b.bn_.get());
+  tmp.bn_.LeftShift(tmp.bn_, bn_exp_ - b.bn_exp_);
+  return BigNum::Compare(tmp.bn_, b.bn_);
 }
 
 bool ExactFloat::UnsignedLess(const ExactFloat& b) const {
@@ -773,7 +863,7 @@ T ExactFloat::ToInteger(RoundingMode mode) const {
   if (!r.is_inf()) {
     // If the unsigned value has more than 63 bits it is always clamped.
     if (r.exp() < 64) {
-      int64 value = BN_ext_get_uint64(r.bn_.get()) << r.bn_exp_;
+      int64 value = r.bn_.get_uint64() << r.bn_exp_;
       if (r.sign_ < 0) value = -value;
       return max(kMinValue, min(kMaxValue, value));
     }
@@ -15,8 +15,8 @@
 
 // Author: ericv@google.com (Eric Veach)
 //
-// ExactFloat is a multiple-precision floating point type that uses the OpenSSL
-// Bignum library for numerical calculations.  It has the same interface as the
+// ExactFloat is a multiple-precision floating point type with a
+// self-contained bignum mantissa.  It has the same interface as the
 // built-in "float" and "double" types, but only supports the subset of
 // operators and intrinsics where it is possible to compute the result exactly.
 // So for example, ExactFloat supports addition and multiplication but not
@@ -27,8 +27,10 @@
 //
 // ExactFloat is a subset of the now-retired MPFloat class, which used the GNU
 // MPFR library for numerical calculations.  The main reason for the switch to
-// ExactFloat is that OpenSSL has a BSD-style license whereas MPFR has a much
-// more restrictive LGPL license.
+// ExactFloat was that MPFR has a restrictive LGPL license.  ExactFloat was
+// originally implemented using the OpenSSL BIGNUM library, but it now has its
+// own mantissa type that stores small values inline, which avoids both the
+// dependency and a heap allocation for every intermediate value.
 //
 // ExactFloat has the following features:
 //
@@ -119,13 +121,14 @@
 #include <ostream>
 #include <string>
 
-#include <openssl/bn.h>
+#include "absl/container/inlined_vector.h"
 
 #include "s2/base/types.h"
 
 class ExactFloat {
  public:
-  // The following limits are imposed by OpenSSL.
+  // The following limits keep the exponent arithmetic below from
+  // overflowing and bound the size of the mantissa.
 
   // The maximum exponent supported.  If a value has an exponent larger than
   // this, it is replaced by infinity (with the appropriate sign).
@@ -501,37 +504,75 @@ class ExactFloat {
   friend ExactFloat logb(const ExactFloat& a);
 
  protected:
-  // OpenSSL >= 1.1 does not have BN_init, and does not support stack-
-  // allocated BIGNUMS.  We use BN_init when possible, but BN_new otherwise.
-  // If the performance penalty is too high, an object pool can be added
-  // in the future.
-#if defined(OPENSSL_IS_BORINGSSL) || OPENSSL_VERSION_NUMBER < 0x10100000L
-  // BoringSSL and OpenSSL < 1.1 support stack allocated BIGNUMs and BN_init.
+  // A non-negative arbitrary-precision integer, stored as a little-endian
+  // sequence of 64-bit words ("limbs") with no high-order zero limbs (so
+  // that zero has no limbs at all).  Up to kInlineLimbs limbs are stored
+  // inline, which is enough for the sums and products of a few doubles
+  // computed by the exact geometric predicates in s2predicates.cc; only
+  // larger values allocate memory.
+  //
+  // Unless noted otherwise, the result of each operation may be the same
+  // object as any of its arguments.
   class BigNum {
    public:
-    BigNum() { BN_init(&bn_); }
+    BigNum() = default;
     // Prevent accidental, expensive, copying.
     BigNum(const BigNum&) = delete;
     BigNum& operator=(const BigNum&) = delete;
-    ~BigNum() { BN_free(&bn_); }
-    BIGNUM* get() { return &bn_; }
-    const BIGNUM* get() const { return &bn_; }
-   private:
-    BIGNUM bn_;
-  };
-#else
-  class BigNum {
-   public:
-    BigNum() : bn_(BN_new()) {}
-    BigNum(const BigNum&) = delete;
-    BigNum& operator=(const BigNum&) = delete;
-    ~BigNum() { BN_free(bn_); }
-    BIGNUM* get() { return bn_; }
-    const BIGNUM* get() const { return bn_; }
+
+    void Copy(const BigNum& b) {
+      if (this != &b) limbs_ = b.limbs_;
+    }
+
+    bool is_zero() const { return limbs_.empty(); }
+    bool is_odd() const { return !is_zero() && (limbs_[0] & 1) != 0; }
+    void set_zero() { limbs_.clear(); }
+
+    void set_uint64(uint64 v);
+
+    // Returns the value as a 64-bit unsigned integer.
+    // REQUIRES: num_bits() <= 64.
+    uint64 get_uint64() const;
+
+    // Returns the number of significant bits (zero for the value zero).
+    int num_bits() const;
+
+    // Returns true if bit "n" (where bit 0 is the low-order bit) is set.
+    bool is_bit_set(int n) const;
+
+    // Returns the number of low-order zero bits, or 0 if the value is zero.
+    int count_low_zero_bits() const;
+
+    // Sets this value to (a << n) or (a >> n).
+    void LeftShift(const BigNum& a, int n);
+    void RightShift(const BigNum& a, int n);
+
+    // Sets this value to (a + b).
+    void Add(const BigNum& a, const BigNum& b);
+    void AddWord(uint64 w);
+
+    // Sets this value to (a - b).  REQUIRES: a >= b.
+    void Subtract(const BigNum& a, const BigNum& b);
+
+    // Sets this value to (a * b).  REQUIRES: neither argument is *this.
+    void Multiply(const BigNum& a, const BigNum& b);
+    void MultiplyWord(uint64 w);
+
+    // Returns -1, 0, or 1 according to whether "a" is less than, equal to,
+    // or greater than "b".
+    static int Compare(const BigNum& a, const BigNum& b);
+
+    // Returns the value as a string of decimal digits.
+    std::string ToDecimalString() const;
+
    private:
-    BIGNUM* bn_;
+    static constexpr int kInlineLimbs = 4;
+
+    // Removes any high-order zero limbs.
+    void Trim();
+
+    absl::InlinedVector<uint64, kInlineLimbs> limbs_;
   };
-#endif
 
   // Non-normal numbers are represented using special exponent values and a
   // mantissa of zero.  Do not change these values; methods such as
@@ -543,7 +584,7 @@ class ExactFloat {
 
   // Normal numbers are represented as (sign_ * bn_ * (2 ** bn_exp_)), where:
   //  - sign_ is either +1 or -1
-  //  - bn_ is a BIGNUM with a positive value
+  //  - bn_ is a BigNum with a positive value
   //  - bn_exp_ is the base-2 exponent applied to bn_.
   int32 sign_;
   int32 bn_exp_;